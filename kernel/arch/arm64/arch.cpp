@@ -58,8 +58,8 @@ static_assert(TP_OFFSET(stack_guard) == ZX_TLS_STACK_GUARD_OFFSET, "");
 static_assert(TP_OFFSET(unsafe_sp) == ZX_TLS_UNSAFE_SP_OFFSET, "");
 #undef TP_OFFSET
 
-/* smp boot lock */
-static spin_lock_t arm_boot_cpu_lock = (spin_lock_t){1};
+/* smp boot lock, which starts out held: ticket 0 has been handed out and is being served */
+static spin_lock_t arm_boot_cpu_lock = (spin_lock_t){1u << 16, 0};
 static volatile int secondaries_to_init = 0;
 static thread_t _init_thread[SMP_MAX_CPUS - 1];
 arm64_sp_info_t arm64_secondary_sp_list[SMP_MAX_CPUS];
@@ -162,6 +162,11 @@ void arch_idle(void) {
     __asm__ volatile("wfi");
 }
 
+void arch_idle_wait(void) {
+    // wfi wakes up for a pending interrupt even while they are masked.
+    __asm__ volatile("wfi" ::: "memory");
+}
+
 /* switch to user mode, set the user stack pointer to user_stack_top, put the svc stack pointer to the top of the kernel stack */
 void arch_enter_uspace(uintptr_t pc, uintptr_t sp, uintptr_t arg1, uintptr_t arg2) {
     thread_t* ct = get_current_thread();
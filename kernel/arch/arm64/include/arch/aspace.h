@@ -8,6 +8,7 @@
 #pragma once
 
 #include <arch/arm64/mmu.h>
+#include <fbl/atomic.h>
 #include <fbl/canary.h>
 #include <fbl/mutex.h>
 #include <vm/arch_vm_aspace.h>
@@ -50,6 +51,10 @@ private:
         return (vaddr >= base_ && vaddr <= base_ + size_ - 1);
     }
 
+    uint16_t GetAsid() const {
+        return static_cast<uint16_t>(context_id_.load(fbl::memory_order_relaxed));
+    }
+
     // Page table management.
     volatile pte_t* GetPageTable(vaddr_t index, uint page_size_shift,
                                  volatile pte_t* page_table) TA_REQ(lock_);
@@ -58,6 +63,9 @@ private:
 
     void FreePageTable(void* vaddr, paddr_t paddr, uint page_size_shift) TA_REQ(lock_);
 
+    zx_status_t SplitBlock(vaddr_t vaddr, vaddr_t index, uint index_shift, uint page_size_shift,
+                           volatile pte_t* page_table) TA_REQ(lock_);
+
     ssize_t MapPageTable(vaddr_t vaddr_in, vaddr_t vaddr_rel_in,
                          paddr_t paddr_in, size_t size_in, pte_t attrs,
                          uint index_shift, uint page_size_shift,
@@ -94,7 +102,11 @@ private:
 
     fbl::Mutex lock_;
 
-    uint16_t asid_ = MMU_ARM64_UNUSED_ASID;
+    // For user address spaces, the ASID in the low bits and the generation
+    // it was allocated in above them, or MMU_ARM64_UNUSED_ASID until the
+    // first switch to the address space. See AsidAllocator.
+    // For guest address spaces, the VMID.
+    fbl::atomic<uint64_t> context_id_{MMU_ARM64_UNUSED_ASID};
 
     // Pointer to the translation table.
     paddr_t tt_phys_ = 0;
@@ -0,0 +1,38 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS
+
+// A static branch site is a nop while its key is disabled, and a b to the
+// enabled code while it is enabled.
+#define ARCH_STATIC_BRANCH_NOP "nop"
+#define ARCH_STATIC_BRANCH_SIZE 4
+
+// Fills in the instruction for the site at |site|.
+static inline void arch_static_branch_encode(uint8_t insn[ARCH_STATIC_BRANCH_SIZE],
+                                             uintptr_t site, uintptr_t target,
+                                             bool enabled) {
+    uint32_t word = 0xd503201f; // nop
+    if (enabled) {
+        // The kernel is a lot smaller than the +/-128MB a b reaches.
+        word = 0x14000000 | ((uint32_t)((int64_t)(target - site) >> 2) & 0x03ffffff);
+    }
+    memcpy(insn, &word, sizeof(word));
+}
+
+// Makes this cpu drop anything it fetched ahead of a patch.
+static inline void arch_static_branch_serialize(void) {
+    __asm__ volatile("isb" ::: "memory");
+}
+
+__END_CDECLS
@@ -19,6 +19,8 @@
 #include <fbl/auto_call.h>
 #include <fbl/auto_lock.h>
 #include <inttypes.h>
+#include <kernel/auto_lock.h>
+#include <kernel/cpu.h>
 #include <kernel/mutex.h>
 #include <lib/heap.h>
 #include <lib/ktrace.h>
@@ -63,67 +65,182 @@ pte_t* arm64_get_kernel_ptable() {
 
 namespace {
 
+// ASIDs are tagged with a generation in the bits above them, and are handed
+// out on the first switch into an address space rather than when it is
+// created. When they run out the generation is bumped, and each cpu flushes
+// its TLB before it next switches to an address space. Address spaces which
+// were running somewhere at the time keep their ASIDs (they are "reserved");
+// the rest pick up a new one the next time they are switched to, so there is
+// no limit on how many address spaces there may be.
 class AsidAllocator {
 public:
     AsidAllocator() { bitmap_.Reset(MMU_ARM64_MAX_USER_ASID + 1); }
     ~AsidAllocator() = default;
 
-    zx_status_t Alloc(uint16_t* asid);
-    zx_status_t Free(uint16_t asid);
+    // Returns the context id the current cpu should run the address space
+    // whose context id is |*context_id| with, updating it if it is from an
+    // old generation. Called with interrupts disabled.
+    uint64_t Activate(fbl::atomic<uint64_t>* context_id);
+
+    // Releases |context_id| early if it is from the current generation. The
+    // caller must have flushed the ASID from the TLB.
+    void Free(uint64_t context_id);
+
+    static uint16_t ToAsid(uint64_t context_id) {
+        return static_cast<uint16_t>(context_id & kAsidMask);
+    }
 
 private:
     DISALLOW_COPY_ASSIGN_AND_MOVE(AsidAllocator);
 
-    fbl::Mutex lock_;
+    static constexpr uint64_t kAsidMask = (1ul << MMU_ARM64_ASID_BITS) - 1;
+    static constexpr uint64_t kFirstGeneration = 1ul << MMU_ARM64_ASID_BITS;
+
+    bool IsCurrent(uint64_t context_id) const {
+        return ((context_id ^ generation_.load(fbl::memory_order_relaxed)) & ~kAsidMask) == 0;
+    }
+
+    uint64_t NewContextLocked(uint64_t context_id) TA_REQ(lock_);
+    bool UpdateReservedLocked(uint64_t context_id, uint64_t new_context_id) TA_REQ(lock_);
+    void RolloverLocked() TA_REQ(lock_);
+
+    SpinLock lock_;
+    fbl::atomic<uint64_t> generation_{kFirstGeneration};
     uint16_t last_ TA_GUARDED(lock_) = MMU_ARM64_FIRST_USER_ASID - 1;
 
     bitmap::RawBitmapGeneric<bitmap::FixedStorage<MMU_ARM64_MAX_USER_ASID + 1>> bitmap_ TA_GUARDED(lock_);
 
+    // The context id each cpu last switched to, or 0 if there has been a
+    // rollover since.
+    fbl::atomic<uint64_t> active_[SMP_MAX_CPUS] = {};
+    // The context id each cpu was running at the last rollover.
+    uint64_t reserved_[SMP_MAX_CPUS] TA_GUARDED(lock_) = {};
+    // Cpus which have yet to flush their TLB since the last rollover.
+    cpu_mask_t flush_pending_ TA_GUARDED(lock_) = 0;
+
     static_assert(MMU_ARM64_ASID_BITS <= 16, "");
 };
 
-zx_status_t AsidAllocator::Alloc(uint16_t* asid) {
-    uint16_t new_asid;
+uint64_t AsidAllocator::Activate(fbl::atomic<uint64_t>* context_id) {
+    DEBUG_ASSERT(arch_ints_disabled());
+
+    cpu_num_t cpu = arch_curr_cpu_num();
+    uint64_t id = context_id->load(fbl::memory_order_relaxed);
+
+    // The common case: the address space has an ASID from this generation,
+    // and there hasn't been a rollover since this cpu last switched. The
+    // exchange fails if a rollover zeroes active_ after the check, which
+    // then has to go the slow way and see the new generation.
+    uint64_t old_active = active_[cpu].load(fbl::memory_order_relaxed);
+    if (old_active != 0 && IsCurrent(id) &&
+        active_[cpu].compare_exchange_strong(&old_active, id, fbl::memory_order_relaxed,
+                                             fbl::memory_order_relaxed)) {
+        return id;
+    }
 
-    // use the bitmap allocator to allocate ids in the range of
-    // [MMU_ARM64_FIRST_USER_ASID, MMU_ARM64_MAX_USER_ASID]
-    // start the search from the last found id + 1 and wrap when hitting the end of the range
-    {
-        fbl::AutoLock al(&lock_);
-
-        size_t val;
-        bool notfound = bitmap_.Get(last_ + 1, MMU_ARM64_MAX_USER_ASID + 1, &val);
-        if (unlikely(notfound)) {
-            // search again from the start
-            notfound = bitmap_.Get(MMU_ARM64_FIRST_USER_ASID, MMU_ARM64_MAX_USER_ASID + 1, &val);
-            if (unlikely(notfound)) {
-                TRACEF("ARM64: out of ASIDs\n");
-                return ZX_ERR_NO_MEMORY;
-            }
-        }
-        bitmap_.SetOne(val);
+    AutoSpinLock al(&lock_);
 
-        DEBUG_ASSERT(val <= UINT16_MAX);
+    id = context_id->load(fbl::memory_order_relaxed);
+    if (!IsCurrent(id)) {
+        id = NewContextLocked(id);
+        context_id->store(id, fbl::memory_order_relaxed);
+    }
 
-        new_asid = (uint16_t)val;
-        last_ = new_asid;
+    if (flush_pending_ & cpu_num_to_mask(cpu)) {
+        flush_pending_ &= ~cpu_num_to_mask(cpu);
+        __asm__ volatile("tlbi vmalle1" ::: "memory");
+        __asm__ volatile("dsb nsh" ::: "memory");
+        ISB;
     }
 
-    LTRACEF("new asid %#x\n", new_asid);
+    active_[cpu].store(id, fbl::memory_order_relaxed);
 
-    *asid = new_asid;
+    return id;
+}
 
-    return ZX_OK;
+void AsidAllocator::Free(uint64_t context_id) {
+    LTRACEF("free context %#" PRIx64 "\n", context_id);
+
+    AutoSpinLockIrqSave al(&lock_);
+
+    // An ASID from an older generation is either free already or reserved,
+    // and will be released by the next rollover.
+    if (context_id != 0 && IsCurrent(context_id)) {
+        bitmap_.ClearOne(ToAsid(context_id));
+    }
 }
 
-zx_status_t AsidAllocator::Free(uint16_t asid) {
-    LTRACEF("free asid %#x\n", asid);
+uint64_t AsidAllocator::NewContextLocked(uint64_t context_id) {
+    uint64_t generation = generation_.load(fbl::memory_order_relaxed);
 
-    fbl::AutoLock al(&lock_);
+    if (context_id != 0) {
+        // Keep the same ASID if it was running at the last rollover, or if
+        // nobody has taken it since.
+        uint16_t old_asid = ToAsid(context_id);
+        uint64_t new_context_id = generation | old_asid;
+        if (UpdateReservedLocked(context_id, new_context_id)) {
+            return new_context_id;
+        }
+        if (!bitmap_.GetOne(old_asid)) {
+            bitmap_.SetOne(old_asid);
+            return new_context_id;
+        }
+    }
 
-    bitmap_.ClearOne(asid);
+    // Search from the last ASID handed out, wrapping around to the start of
+    // the range, and roll over to a new generation if they are all taken.
+    size_t val;
+    if (bitmap_.Get(last_ + 1, MMU_ARM64_MAX_USER_ASID + 1, &val) &&
+        bitmap_.Get(MMU_ARM64_FIRST_USER_ASID, MMU_ARM64_MAX_USER_ASID + 1, &val)) {
+        RolloverLocked();
+        generation = generation_.load(fbl::memory_order_relaxed);
+        // At most one ASID per cpu is reserved, so there is always one free.
+        __UNUSED bool full = bitmap_.Get(MMU_ARM64_FIRST_USER_ASID, MMU_ARM64_MAX_USER_ASID + 1, &val);
+        DEBUG_ASSERT(!full);
+    }
+    bitmap_.SetOne(val);
 
-    return ZX_OK;
+    DEBUG_ASSERT(val <= UINT16_MAX);
+
+    last_ = static_cast<uint16_t>(val);
+
+    LTRACEF("new asid %#zx generation %#" PRIx64 "\n", val, generation);
+
+    return generation | val;
+}
+
+bool AsidAllocator::UpdateReservedLocked(uint64_t context_id, uint64_t new_context_id) {
+    // Several cpus may have been running the same address space.
+    bool hit = false;
+    for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+        if (reserved_[i] == context_id) {
+            reserved_[i] = new_context_id;
+            hit = true;
+        }
+    }
+    return hit;
+}
+
+void AsidAllocator::RolloverLocked() {
+    LTRACEF("asid rollover\n");
+
+    generation_.fetch_add(kFirstGeneration, fbl::memory_order_relaxed);
+    bitmap_.ClearAll();
+
+    // Reserve whatever each cpu is running, or was running at the last
+    // rollover if it hasn't switched since.
+    for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+        uint64_t id = active_[i].exchange(0, fbl::memory_order_relaxed);
+        if (id == 0) {
+            id = reserved_[i];
+        }
+        if (id != 0) {
+            bitmap_.SetOne(ToAsid(id));
+        }
+        reserved_[i] = id;
+    }
+
+    flush_pending_ = CPU_MASK_ALL;
 }
 
 AsidAllocator asid;
@@ -420,6 +537,51 @@ volatile pte_t* ArmArchVmAspace::GetPageTable(vaddr_t index, uint page_size_shif
     }
 }
 
+// Replaces the block mapping at page_table[index], which maps vaddr, with a
+// table of next level entries mapping the same range with the same attributes,
+// so that part of the block can be unmapped or have its permissions changed.
+zx_status_t ArmArchVmAspace::SplitBlock(vaddr_t vaddr, vaddr_t index, uint index_shift,
+                                        uint page_size_shift, volatile pte_t* page_table) {
+    pte_t pte = page_table[index];
+    DEBUG_ASSERT((pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_BLOCK);
+    DEBUG_ASSERT(index_shift > page_size_shift);
+
+    paddr_t paddr;
+    zx_status_t ret = AllocPageTable(&paddr, page_size_shift);
+    if (ret) {
+        TRACEF("failed to allocate page table\n");
+        return ret;
+    }
+    volatile pte_t* next_page_table = static_cast<volatile pte_t*>(paddr_to_physmap(paddr));
+
+    const uint next_shift = index_shift - (page_size_shift - 3);
+    const pte_t attrs = pte & ~(MMU_PTE_OUTPUT_ADDR_MASK | MMU_PTE_DESCRIPTOR_MASK);
+    const pte_t descriptor = (next_shift > page_size_shift) ? MMU_PTE_L012_DESCRIPTOR_BLOCK
+                                                            : MMU_PTE_L3_DESCRIPTOR_PAGE;
+    const paddr_t block_paddr = pte & MMU_PTE_OUTPUT_ADDR_MASK;
+    const size_t count = 1U << (page_size_shift - 3);
+    for (size_t i = 0; i < count; i++) {
+        next_page_table[i] = (block_paddr + (i << next_shift)) | attrs | descriptor;
+    }
+
+    // ensure that the new table is observable from hardware page table walkers
+    DMB_ISHST;
+
+    // break before make, the block has to be gone from the TLBs before the
+    // table replaces it
+    page_table[index] = MMU_PTE_DESCRIPTOR_INVALID;
+    DMB_ISHST;
+    FlushTLBEntry(vaddr, true);
+    DSB;
+
+    page_table[index] = paddr | MMU_PTE_L012_DESCRIPTOR_TABLE;
+    LTRACEF("split block pte %p[%#" PRIxPTR "] = %#" PRIx64 " into table %#" PRIxPTR "\n",
+            page_table, index, pte, paddr);
+
+    DMB_ISHST;
+    return ZX_OK;
+}
+
 static bool page_table_is_clear(volatile pte_t* page_table, uint page_size_shift) {
     int i;
     int count = 1U << (page_size_shift - 3);
@@ -442,10 +604,10 @@ static bool page_table_is_clear(volatile pte_t* page_table, uint page_size_shift
 // terminal is set when flushing at the final level of the page table.
 void ArmArchVmAspace::FlushTLBEntry(vaddr_t vaddr, bool terminal) {
     if (flags_ & ARCH_ASPACE_FLAG_GUEST) {
-        paddr_t vttbr = arm64_vttbr(asid_, tt_phys_);
+        paddr_t vttbr = arm64_vttbr(GetAsid(), tt_phys_);
         __UNUSED zx_status_t status = arm64_el2_tlbi_ipa(vttbr, vaddr >> 12, terminal);
         DEBUG_ASSERT(status == ZX_OK);
-    } else if (asid_ == MMU_ARM64_GLOBAL_ASID) {
+    } else if (flags_ & ARCH_ASPACE_FLAG_KERNEL) {
         // flush this address on all ASIDs
         if (terminal) {
             ARM64_TLBI(vaale1is, vaddr >> 12);
@@ -453,11 +615,17 @@ void ArmArchVmAspace::FlushTLBEntry(vaddr_t vaddr, bool terminal) {
             ARM64_TLBI(vaae1is, vaddr >> 12);
         }
     } else {
+        // A context switch on another cpu may give this address space a new
+        // ASID, so read it only once the page table update is visible. Then
+        // either this sees the new ASID, or nothing stale was cached under it.
+        DMB;
+        vaddr_t asid = GetAsid();
+
         // flush this address for the specific asid
         if (terminal) {
-            ARM64_TLBI(vale1is, vaddr >> 12 | (vaddr_t)asid_ << 48);
+            ARM64_TLBI(vale1is, vaddr >> 12 | asid << 48);
         } else {
-            ARM64_TLBI(vae1is, vaddr >> 12 | (vaddr_t)asid_ << 48);
+            ARM64_TLBI(vae1is, vaddr >> 12 | asid << 48);
         }
     }
 }
@@ -490,6 +658,15 @@ ssize_t ArmArchVmAspace::UnmapPageTable(vaddr_t vaddr, vaddr_t vaddr_rel,
 
         pte = page_table[index];
 
+        // unmapping part of a block demotes it to a table of smaller entries,
+        // failing that the whole block goes and will be faulted back in
+        if (index_shift > page_size_shift && chunk_size != block_size &&
+            (pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_BLOCK &&
+            SplitBlock(vaddr - vaddr_rem, index, index_shift, page_size_shift,
+                       page_table) == ZX_OK) {
+            pte = page_table[index];
+        }
+
         if (index_shift > page_size_shift &&
             (pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_TABLE) {
             page_table_paddr = pte & MMU_PTE_OUTPUT_ADDR_MASK;
@@ -654,6 +831,15 @@ int ArmArchVmAspace::ProtectPageTable(vaddr_t vaddr_in, vaddr_t vaddr_rel_in,
         index = vaddr_rel >> index_shift;
         pte = page_table[index];
 
+        // changing part of a block demotes it to a table of smaller entries
+        if (index_shift > page_size_shift && chunk_size != block_size &&
+            (pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_BLOCK) {
+            ret = SplitBlock(vaddr - vaddr_rem, index, index_shift, page_size_shift, page_table);
+            if (ret != ZX_OK)
+                goto err;
+            pte = page_table[index];
+        }
+
         if (index_shift > page_size_shift &&
             (pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_TABLE) {
             page_table_paddr = pte & MMU_PTE_OUTPUT_ADDR_MASK;
@@ -703,7 +889,7 @@ ssize_t ArmArchVmAspace::MapPages(vaddr_t vaddr, paddr_t paddr, size_t size,
 
     LTRACEF("vaddr %#" PRIxPTR ", paddr %#" PRIxPTR ", size %#" PRIxPTR
             ", attrs %#" PRIx64 ", asid %#x\n",
-            vaddr, paddr, size, attrs, asid_);
+            vaddr, paddr, size, attrs, GetAsid());
 
     if (vaddr_rel > vaddr_rel_max - size || size > vaddr_rel_max) {
         TRACEF("vaddr %#" PRIxPTR ", size %#" PRIxPTR " out of range vaddr %#" PRIxPTR ", size %#" PRIxPTR "\n",
@@ -726,7 +912,7 @@ ssize_t ArmArchVmAspace::UnmapPages(vaddr_t vaddr, size_t size,
     vaddr_t vaddr_rel = vaddr - vaddr_base;
     vaddr_t vaddr_rel_max = 1UL << top_size_shift;
 
-    LTRACEF("vaddr 0x%lx, size 0x%lx, asid 0x%x\n", vaddr, size, asid_);
+    LTRACEF("vaddr 0x%lx, size 0x%lx, asid 0x%x\n", vaddr, size, GetAsid());
 
     if (vaddr_rel > vaddr_rel_max - size || size > vaddr_rel_max) {
         TRACEF("vaddr 0x%lx, size 0x%lx out of range vaddr 0x%lx, size 0x%lx\n",
@@ -750,7 +936,7 @@ zx_status_t ArmArchVmAspace::ProtectPages(vaddr_t vaddr, size_t size, pte_t attr
 
     LTRACEF("vaddr %#" PRIxPTR ", size %#" PRIxPTR ", attrs %#" PRIx64
             ", asid %#x\n",
-            vaddr, size, attrs, asid_);
+            vaddr, size, attrs, GetAsid());
 
     if (vaddr_rel > vaddr_rel_max - size || size > vaddr_rel_max) {
         TRACEF("vaddr %#" PRIxPTR ", size %#" PRIxPTR " out of range vaddr %#" PRIxPTR ", size %#" PRIxPTR "\n",
@@ -1004,14 +1190,12 @@ zx_status_t ArmArchVmAspace::Init(vaddr_t base, size_t size, uint flags) {
         size_ = size;
         tt_virt_ = arm64_kernel_translation_table;
         tt_phys_ = vaddr_to_paddr(const_cast<pte_t*>(tt_virt_));
-        asid_ = (uint16_t)MMU_ARM64_GLOBAL_ASID;
+        context_id_.store(MMU_ARM64_GLOBAL_ASID, fbl::memory_order_relaxed);
     } else {
         if (flags & ARCH_ASPACE_FLAG_GUEST) {
             DEBUG_ASSERT(base + size <= 1UL << MMU_GUEST_SIZE_SHIFT);
         } else {
             DEBUG_ASSERT(base + size <= 1UL << MMU_USER_SIZE_SHIFT);
-            if (asid.Alloc(&asid_) != ZX_OK)
-                return ZX_ERR_NO_MEMORY;
         }
 
         base_ = base;
@@ -1051,13 +1235,17 @@ zx_status_t ArmArchVmAspace::Destroy() {
     pmm_free_page(page);
 
     if (flags_ & ARCH_ASPACE_FLAG_GUEST) {
-        paddr_t vttbr = arm64_vttbr(asid_, tt_phys_);
+        paddr_t vttbr = arm64_vttbr(GetAsid(), tt_phys_);
         __UNUSED zx_status_t status = arm64_el2_tlbi_vmid(vttbr);
         DEBUG_ASSERT(status == ZX_OK);
     } else {
-        ARM64_TLBI(ASIDE1IS, asid_);
-        asid.Free(asid_);
-        asid_ = MMU_ARM64_UNUSED_ASID;
+        // an address space which never ran has no ASID, nor any TLB entries
+        uint64_t context_id = context_id_.exchange(MMU_ARM64_UNUSED_ASID);
+        if (context_id != MMU_ARM64_UNUSED_ASID) {
+            ARM64_TLBI(ASIDE1IS, (uint64_t)AsidAllocator::ToAsid(context_id) << 48);
+            DSB;
+            asid.Free(context_id);
+        }
     }
 
     return ZX_OK;
@@ -1074,7 +1262,8 @@ void ArmArchVmAspace::ContextSwitch(ArmArchVmAspace* old_aspace, ArmArchVmAspace
         DEBUG_ASSERT((aspace->flags_ & (ARCH_ASPACE_FLAG_KERNEL | ARCH_ASPACE_FLAG_GUEST)) == 0);
 
         tcr = MMU_TCR_FLAGS_USER;
-        ttbr = ((uint64_t)aspace->asid_ << 48) | aspace->tt_phys_;
+        uint64_t context_id = asid.Activate(&aspace->context_id_);
+        ttbr = ((uint64_t)AsidAllocator::ToAsid(context_id) << 48) | aspace->tt_phys_;
         ARM64_WRITE_SYSREG(ttbr0_el1, ttbr);
 
         if (TRACE_CONTEXT_SWITCH)
@@ -33,6 +33,7 @@ MODULE_SRCS += \
 MODULE_DEPS += \
 	kernel/dev/iommu/dummy \
 	kernel/lib/bitmap \
+	kernel/lib/code_patching \
 	kernel/object \
 	third_party/lib/fdt \
 
@@ -4,46 +4,107 @@
 // license that can be found in the LICENSE file or at
 // https://opensource.org/licenses/MIT
 
+#include <arch/arm64/feature.h>
 #include <arch/ops.h>
 #include <arch/spinlock.h>
 #include <kernel/atomic.h>
+#include <kernel/stats.h>
+#include <platform.h>
 
 // We need to disable thread safety analysis in this file, since we're
 // implementing the locks themselves.  Without this, the header-level
 // annotations cause Clang to detect violations.
 
-void arch_spin_lock(spin_lock_t* lock) TA_NO_THREAD_SAFETY_ANALYSIS {
-    unsigned long val = arch_curr_cpu_num() + 1;
-    uint64_t temp;
+namespace {
+
+constexpr uint32_t kNextTicket = 1u << 16;
+
+inline uint16_t serving(uint32_t tickets) { return static_cast<uint16_t>(tickets); }
+inline uint16_t next(uint32_t tickets) { return static_cast<uint16_t>(tickets >> 16); }
+
+// Waits for |ticket| to be served. The unlocking store to the low half of
+// the lock clears our exclusive monitor, which wakes us from wfe.
+__NO_INLINE void wait_for_ticket(spin_lock_t* lock, uint16_t ticket) {
+    uint64_t start = arch_cycle_count();
+    uint32_t tmp;
 
     __asm__ volatile(
         "sevl;"
         "1: wfe;"
-        "ldaxr   %[temp], [%[lock]];"
-        "cbnz    %[temp], 1b;"
-        "stxr    %w[temp], %[val], [%[lock]];"
-        "cbnz    %w[temp], 1b;"
-        : [temp] "=&r"(temp)
-        : [lock] "r"(&lock->value), [val] "r"(val)
+        "ldaxrh  %w[tmp], [%[lock]];"
+        "eor     %w[tmp], %w[tmp], %w[ticket];"
+        "cbnz    %w[tmp], 1b;"
+        : [tmp] "=&r"(tmp)
+        : [lock] "r"(&lock->tickets), [ticket] "r"(ticket)
         : "cc", "memory");
+
+    CPU_STATS_INC(spin_contended);
+    CPU_STATS_ADD(spin_wait_cycles, arch_cycle_count() - start);
 }
 
-int arch_spin_trylock(spin_lock_t* lock) TA_NO_THREAD_SAFETY_ANALYSIS {
-    unsigned long val = arch_curr_cpu_num() + 1;
-    uint64_t out;
+} // namespace
 
-    __asm__ volatile(
-        "ldaxr   %[out], [%[lock]];"
-        "cbnz    %[out], 1f;"
-        "stxr    %w[out], %[val], [%[lock]];"
-        "1:"
-        : [out] "=&r"(out)
-        : [lock] "r"(&lock->value), [val] "r"(val)
-        : "cc", "memory");
+void arch_spin_lock(spin_lock_t* lock) TA_NO_THREAD_SAFETY_ANALYSIS {
+#if WITH_LOCK_PROFILING
+    uint64_t wait_start = current_ticks();
+#endif
+    uint32_t tickets;
 
-    return (int)out;
+    // With the ARMv8.1 atomics taking a ticket is a single instruction,
+    // rather than an exclusive load/store pair which contending cpus keep
+    // making each other retry.
+    if (arm64_feature_test(ARM64_FEATURE_ISA_ATOMICS)) {
+        __asm__ volatile(
+            ".arch_extension lse;"
+            "ldadda  %w[inc], %w[tickets], [%[lock]];"
+            : [tickets] "=&r"(tickets)
+            : [lock] "r"(&lock->tickets), [inc] "r"(kNextTicket)
+            : "memory");
+    } else {
+        tickets = __atomic_fetch_add(&lock->tickets, kNextTicket, __ATOMIC_ACQUIRE);
+    }
+
+    bool contended = serving(tickets) != next(tickets);
+    if (unlikely(contended)) {
+        wait_for_ticket(lock, next(tickets));
+    }
+
+#if WITH_LOCK_PROFILING
+    lockprof_acquired(&lock->prof, lock, LOCKPROF_KIND_SPIN,
+                      reinterpret_cast<uintptr_t>(__GET_CALLER()), wait_start, contended);
+#endif
+
+    __atomic_store_n(&lock->holder, arch_curr_cpu_num() + 1, __ATOMIC_RELAXED);
+}
+
+int arch_spin_trylock(spin_lock_t* lock) TA_NO_THREAD_SAFETY_ANALYSIS {
+    uint32_t tickets = __atomic_load_n(&lock->tickets, __ATOMIC_RELAXED);
+    if (serving(tickets) != next(tickets) ||
+        !__atomic_compare_exchange_n(&lock->tickets, &tickets, tickets + kNextTicket, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return 1;
+    }
+
+#if WITH_LOCK_PROFILING
+    lockprof_acquired(&lock->prof, lock, LOCKPROF_KIND_SPIN,
+                      reinterpret_cast<uintptr_t>(__GET_CALLER()), 0, false);
+#endif
+    __atomic_store_n(&lock->holder, arch_curr_cpu_num() + 1, __ATOMIC_RELAXED);
+    return 0;
 }
 
 void arch_spin_unlock(spin_lock_t* lock) TA_NO_THREAD_SAFETY_ANALYSIS {
-    __atomic_store_n(&lock->value, 0UL, __ATOMIC_SEQ_CST);
+#if WITH_LOCK_PROFILING
+    lockprof_released(&lock->prof);
+#endif
+    __atomic_store_n(&lock->holder, 0u, __ATOMIC_RELAXED);
+
+    // Only the holder changes the low half, so serve the next ticket with a
+    // plain store to it; a 32 bit add could carry into the high half.
+    uint32_t ticket = serving(__atomic_load_n(&lock->tickets, __ATOMIC_RELAXED)) + 1u;
+    __asm__ volatile(
+        "stlrh   %w[ticket], [%[lock]];"
+        :
+        : [lock] "r"(&lock->tickets), [ticket] "r"(ticket)
+        : "memory");
 }
@@ -15,6 +15,7 @@
 #include <arch/x86/apic.h>
 #include <arch/x86/descriptor.h>
 #include <arch/x86/feature.h>
+#include <arch/x86/idle.h>
 #include <arch/x86/mmu.h>
 #include <arch/x86/mmu_mem_types.h>
 #include <arch/x86/mp.h>
@@ -64,6 +65,8 @@ void arch_init(void) {
 
     x86_perfmon_init();
     x86_processor_trace_init();
+
+    x86_idle_init();
 }
 
 void arch_enter_uspace(uintptr_t entry_point, uintptr_t sp,
@@ -7,7 +7,10 @@
 #include <arch/ops.h>
 #include <arch/x86/cpu_topology.h>
 #include <arch/x86/feature.h>
+#include <arch/x86/mp.h>
 #include <bits.h>
+#include <kernel/cpu.h>
+#include <kernel/sched.h>
 #include <pow2.h>
 #include <stdio.h>
 #include <string.h>
@@ -25,11 +28,18 @@ static uint32_t core_shift = 0;
 static uint32_t package_mask = ~0;
 static uint32_t package_shift = 0;
 
+// Number of low apic id bits that distinguish logical cpus sharing the last
+// level cache. If the cache topology cannot be determined, fall back to
+// assuming the LLC is shared by the whole package.
+static uint32_t cache_shift = 0;
+static bool cache_shift_valid = false;
+
 static int initialized;
 
 static void legacy_topology_init(void);
 static void modern_intel_topology_init(void);
 static void extended_amd_topology_init(void);
+static void cache_topology_init(enum x86_cpuid_leaf_num leaf_num);
 
 void x86_cpu_topology_init(void) {
     if (atomic_swap(&initialized, 1)) {
@@ -43,6 +53,41 @@ void x86_cpu_topology_init(void) {
     } else {
         legacy_topology_init();
     }
+
+    if (x86_vendor == X86_VENDOR_INTEL) {
+        cache_topology_init(X86_CPUID_CACHE_V2);
+    } else if (x86_vendor == X86_VENDOR_AMD && x86_feature_test(X86_FEATURE_AMD_TOPO)) {
+        cache_topology_init(X86_CPUID_AMD_CACHE_TOPOLOGY);
+    }
+}
+
+// Intel's leaf 4 and AMD's leaf 0x8000001d share a layout: one subleaf per
+// cache, terminated by a subleaf with a null cache type. Find the highest level
+// cache and compute how many apic id bits are covered by the cpus sharing it.
+static void cache_topology_init(enum x86_cpuid_leaf_num leaf_num) {
+    uint32_t highest_level = 0;
+    uint32_t max_sharing = 0;
+
+    struct cpuid_leaf leaf;
+    for (uint32_t i = 0; x86_get_cpuid_subleaf(leaf_num, i, &leaf); ++i) {
+        uint32_t type = BITS(leaf.a, 4, 0);
+        if (type == 0)
+            break;
+
+        uint32_t level = BITS_SHIFT(leaf.a, 7, 5);
+        if (level >= highest_level) {
+            highest_level = level;
+            max_sharing = BITS_SHIFT(leaf.a, 25, 14) + 1;
+        }
+    }
+
+    if (highest_level == 0)
+        return;
+
+    cache_shift = log2_uint_ceil(max_sharing);
+    cache_shift_valid = true;
+
+    LTRACEF("llc level %u shared by %u ids, shift %u\n", highest_level, max_sharing, cache_shift);
 }
 
 static void modern_intel_topology_init(void) {
@@ -148,4 +193,46 @@ void x86_cpu_topology_decode(uint32_t apic_id, x86_cpu_topology_t* topo) {
     topo->package_id = (apic_id & package_mask) >> package_shift;
     topo->core_id = (apic_id & core_mask) >> core_shift;
     topo->smt_id = apic_id & smt_mask;
+    topo->cache_id = cache_shift_valid ? (apic_id >> cache_shift) : topo->package_id;
+}
+
+void x86_cpu_topology_init_sched_domains(const uint32_t* apic_ids, uint32_t num_cpus) {
+    DEBUG_ASSERT(num_cpus <= SMP_MAX_CPUS);
+
+    x86_cpu_topology_t topo[SMP_MAX_CPUS];
+    cpu_num_t cpu_num[SMP_MAX_CPUS];
+    for (uint32_t i = 0; i < num_cpus; ++i) {
+        x86_cpu_topology_decode(apic_ids[i], &topo[i]);
+        int cpu = x86_apic_id_to_cpu_num(apic_ids[i]);
+        cpu_num[i] = (cpu < 0) ? INVALID_CPU : (cpu_num_t)cpu;
+    }
+
+    for (uint32_t i = 0; i < num_cpus; ++i) {
+        if (cpu_num[i] == INVALID_CPU)
+            continue;
+
+        cpu_mask_t domains[SCHED_DOMAIN_COUNT] = {};
+        for (uint32_t j = 0; j < num_cpus; ++j) {
+            if (cpu_num[j] == INVALID_CPU)
+                continue;
+
+            cpu_mask_t mask = cpu_num_to_mask(cpu_num[j]);
+            if (topo[j].package_id != topo[i].package_id)
+                continue;
+            domains[SCHED_DOMAIN_PACKAGE] |= mask;
+
+            if (topo[j].cache_id != topo[i].cache_id)
+                continue;
+            domains[SCHED_DOMAIN_LLC] |= mask;
+
+            if (topo[j].core_id == topo[i].core_id)
+                domains[SCHED_DOMAIN_SMT] |= mask;
+        }
+
+        LTRACEF("cpu %u: smt %#x llc %#x package %#x\n", cpu_num[i],
+                domains[SCHED_DOMAIN_SMT], domains[SCHED_DOMAIN_LLC],
+                domains[SCHED_DOMAIN_PACKAGE]);
+
+        sched_set_cpu_domains(cpu_num[i], domains);
+    }
 }
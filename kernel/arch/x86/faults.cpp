@@ -320,6 +320,12 @@ static void x86_iframe_process_pending_signals(x86_iframe_t* frame) {
 void x86_exception_handler(x86_iframe_t* frame) {
     // are we recursing?
     if (unlikely(arch_in_int_handler()) && frame->vector != X86_INT_NMI) {
+        // An interrupt handler reading user memory that isn't there.
+        struct x86_percpu* percpu = x86_get_percpu();
+        if (frame->vector == X86_INT_PAGE_FAULT && percpu->nofault_resume) {
+            frame->ip = reinterpret_cast<uintptr_t>(percpu->nofault_resume);
+            return;
+        }
         exception_die(frame, "recursion in interrupt handler\n");
     }
 
@@ -419,6 +425,13 @@ void x86_exception_handler(x86_iframe_t* frame) {
         /* no return */
         break;
     }
+    case X86_INT_IPI_POSTED: {
+        // Posted-interrupt notifications are consumed by the processor while
+        // a guest is running. One that reaches the host has nothing left to
+        // do, as the interrupts it announced are picked up on VM entry.
+        apic_issue_eoi();
+        break;
+    }
     case X86_INT_APIC_PMI: {
         ret = apic_pmi_interrupt_handler(frame);
         // Note: apic_pmi_interrupt_handler calls apic_issue_eoi().
@@ -9,6 +9,7 @@
 #include <hypervisor/guest_physical_address_space.h>
 #include <zircon/syscalls/hypervisor.h>
 
+#include "vmexit_priv.h"
 #include "vmx_cpu_state_priv.h"
 
 static void ignore_msr(VmxPage* msr_bitmaps_page, uint32_t msr) {
@@ -29,6 +30,21 @@ static void ignore_msr(VmxPage* msr_bitmaps_page, uint32_t msr) {
     msr_bitmaps[msr_byte] &= (uint8_t) ~(1 << msr_bit);
 }
 
+static void ignore_msr_write(VmxPage* msr_bitmaps_page, uint32_t msr) {
+    // From Volume 3, Section 24.6.9.
+    uint8_t* msr_bitmaps = msr_bitmaps_page->VirtualAddress<uint8_t>();
+    if (msr >= 0xc0000000)
+        msr_bitmaps += 1 << 10;
+
+    uint16_t msr_low = msr & 0x1fff;
+    uint16_t msr_byte = msr_low / 8;
+    uint8_t msr_bit = msr_low % 8;
+
+    // Ignore writes to the MSR.
+    msr_bitmaps += 2 << 10;
+    msr_bitmaps[msr_byte] &= (uint8_t) ~(1 << msr_bit);
+}
+
 // static
 zx_status_t Guest::Create(fbl::RefPtr<VmObject> physmem, fbl::unique_ptr<Guest>* out) {
     fbl::AllocChecker ac;
@@ -62,6 +78,19 @@ zx_status_t Guest::Create(fbl::RefPtr<VmObject> physmem, fbl::unique_ptr<Guest>*
     ignore_msr(&guest->msr_bitmaps_page_, X86_MSR_IA32_TSC_ADJUST);
     ignore_msr(&guest->msr_bitmaps_page_, X86_MSR_IA32_TSC_AUX);
 
+    // From Volume 3, Section 29.5: With virtual-interrupt delivery, writes to
+    // the x2APIC TPR, EOI, and self-IPI registers are virtualized by the
+    // processor, so they no longer need to exit.
+    ApicvInfo apicv_info;
+    if (apicv_info.virtual_interrupt_delivery) {
+        ignore_msr_write(&guest->msr_bitmaps_page_,
+                         static_cast<uint32_t>(X2ApicMsr::TPR));
+        ignore_msr_write(&guest->msr_bitmaps_page_,
+                         static_cast<uint32_t>(X2ApicMsr::EOI));
+        ignore_msr_write(&guest->msr_bitmaps_page_,
+                         static_cast<uint32_t>(X2ApicMsr::SELF_IPI));
+    }
+
     *out = fbl::move(guest);
     return ZX_OK;
 }
@@ -6,12 +6,16 @@
 
 #include <bits.h>
 
+#include <arch/x86/apic.h>
 #include <arch/x86/descriptor.h>
 #include <arch/x86/feature.h>
+#include <arch/x86/mp.h>
+#include <fbl/algorithm.h>
 #include <fbl/auto_call.h>
 #include <hypervisor/cpu.h>
 #include <hypervisor/guest_physical_address_space.h>
 #include <kernel/mp.h>
+#include <lib/counters.h>
 #include <vm/fault.h>
 #include <vm/physmap.h>
 #include <vm/pmm.h>
@@ -28,6 +32,11 @@ static const uint32_t kInterruptInfoValid = 1u << 31;
 static const uint32_t kInterruptInfoDeliverErrorCode = 1u << 11;
 static const uint32_t kInterruptTypeHardwareException = 3u << 8;
 
+static const uint64_t kPostedInterruptOutstanding = 1u << 0;
+
+KCOUNTER(vcpu_interrupts_posted, "kernel.hypervisor.interrupts.posted");
+KCOUNTER(vcpu_interrupts_kicked, "kernel.hypervisor.interrupts.kicked");
+
 static zx_status_t vmptrld(paddr_t pa) {
     uint8_t err;
 
@@ -251,7 +260,8 @@ static void edit_msr_list(VmxPage* msr_list_page, size_t index, uint32_t msr, ui
 
 zx_status_t vmcs_init(paddr_t vmcs_address, uint16_t vpid, uintptr_t ip, uintptr_t cr3,
                       paddr_t msr_bitmaps_address, paddr_t pml4_address, VmxState* vmx_state,
-                      VmxPage* host_msr_page, VmxPage* guest_msr_page) {
+                      VmxPage* host_msr_page, VmxPage* guest_msr_page,
+                      LocalApicState* local_apic_state) {
     zx_status_t status = vmclear(vmcs_address);
     if (status != ZX_OK)
         return status;
@@ -281,6 +291,23 @@ zx_status_t vmcs_init(paddr_t vmcs_address, uint16_t vpid, uintptr_t ip, uintptr
                     kProcbasedCtls2Invpcid,
                     0);
 
+    // From Volume 3, Section 29.2: With virtual-interrupt delivery, pending
+    // interrupts are recorded in the virtual APIC page and the processor
+    // delivers them once the guest can take them, without an interrupt-window
+    // exit. The guest's MSR bitmaps rely on this being enabled wherever it is
+    // available, so failure here is fatal.
+    ApicvInfo apicv_info;
+    if (apicv_info.virtual_interrupt_delivery) {
+        status = vmcs.SetControl(VmcsField32::PROCBASED_CTLS2,
+                                 read_msr(X86_MSR_IA32_VMX_PROCBASED_CTLS2),
+                                 vmcs.Read(VmcsField32::PROCBASED_CTLS2),
+                                 kProcbasedCtls2VirtIntDelivery,
+                                 0);
+        if (status != ZX_OK)
+            return status;
+        local_apic_state->virtual_interrupt_delivery = true;
+    }
+
     // Setup pin-based VMCS controls.
     status = vmcs.SetControl(VmcsField32::PINBASED_CTLS,
                              read_msr(X86_MSR_IA32_VMX_TRUE_PINBASED_CTLS),
@@ -293,6 +320,23 @@ zx_status_t vmcs_init(paddr_t vmcs_address, uint16_t vpid, uintptr_t ip, uintptr
     if (status != ZX_OK)
         return status;
 
+    // From Volume 3, Section 29.6: With posted interrupts, a notification
+    // vector received while the guest is running delivers the interrupts in
+    // the posted-interrupt descriptor, rather than causing a VM exit.
+    if (apicv_info.posted_interrupts) {
+        status = vmcs.SetControl(VmcsField32::PINBASED_CTLS,
+                                 read_msr(X86_MSR_IA32_VMX_TRUE_PINBASED_CTLS),
+                                 vmcs.Read(VmcsField32::PINBASED_CTLS),
+                                 kPinbasedCtlsPostedInterrupts,
+                                 0);
+        if (status == ZX_OK) {
+            vmcs.Write(VmcsField16::POSTED_INTERRUPT_NOTIFICATION_VECTOR, X86_INT_IPI_POSTED);
+            vmcs.Write(VmcsField64::POSTED_INTERRUPT_DESC_ADDRESS,
+                       local_apic_state->posted_interrupt_page.PhysicalAddress());
+            local_apic_state->posted_interrupts = true;
+        }
+    }
+
     // Setup primary processor-based VMCS controls.
     status = vmcs.SetControl(VmcsField32::PROCBASED_CTLS,
                              read_msr(X86_MSR_IA32_VMX_TRUE_PROCBASED_CTLS),
@@ -413,6 +457,21 @@ zx_status_t vmcs_init(paddr_t vmcs_address, uint16_t vpid, uintptr_t ip, uintptr
     // Setup MSR handling.
     vmcs.Write(VmcsField64::MSR_BITMAPS_ADDRESS, msr_bitmaps_address);
 
+    // Setup the virtual APIC. It backs the TPR shadow, and with
+    // virtual-interrupt delivery, the guest's IRR and ISR too. We don't need
+    // to know when the guest issues an EOI, so leave the EOI-exit bitmap
+    // clear.
+    vmcs.Write(VmcsField64::VIRTUAL_APIC_ADDRESS,
+               local_apic_state->virtual_apic_page.PhysicalAddress());
+    vmcs.Write(VmcsField32::TPR_THRESHOLD, 0);
+    if (local_apic_state->virtual_interrupt_delivery) {
+        vmcs.Write(VmcsField64::EOI_EXIT_BITMAP_0, 0);
+        vmcs.Write(VmcsField64::EOI_EXIT_BITMAP_1, 0);
+        vmcs.Write(VmcsField64::EOI_EXIT_BITMAP_2, 0);
+        vmcs.Write(VmcsField64::EOI_EXIT_BITMAP_3, 0);
+        vmcs.Write(VmcsField16::GUEST_INTERRUPT_STATUS, 0);
+    }
+
     edit_msr_list(host_msr_page, 0, X86_MSR_IA32_KERNEL_GS_BASE,
                   read_msr(X86_MSR_IA32_KERNEL_GS_BASE));
     edit_msr_list(host_msr_page, 1, X86_MSR_IA32_STAR, read_msr(X86_MSR_IA32_STAR));
@@ -586,6 +645,14 @@ zx_status_t Vcpu::Create(zx_vaddr_t ip, zx_vaddr_t cr3, paddr_t msr_bitmaps_addr
     if (status != ZX_OK)
         return status;
 
+    status = vcpu->local_apic_state_.virtual_apic_page.Alloc(vmx_info, 0);
+    if (status != ZX_OK)
+        return status;
+
+    status = vcpu->local_apic_state_.posted_interrupt_page.Alloc(vmx_info, 0);
+    if (status != ZX_OK)
+        return status;
+
     status = vcpu->vmcs_page_.Alloc(vmx_info, 0);
     if (status != ZX_OK)
         return status;
@@ -595,7 +662,7 @@ zx_status_t Vcpu::Create(zx_vaddr_t ip, zx_vaddr_t cr3, paddr_t msr_bitmaps_addr
     region->revision_id = vmx_info.revision_id;
     status = vmcs_init(vcpu->vmcs_page_.PhysicalAddress(), vpid, ip, cr3, msr_bitmaps_address,
                        gpas->table_phys(), &vcpu->vmx_state_, &vcpu->host_msr_page_,
-                       &vcpu->guest_msr_page_);
+                       &vcpu->guest_msr_page_, &vcpu->local_apic_state_);
     if (status != ZX_OK)
         return status;
 
@@ -604,7 +671,7 @@ zx_status_t Vcpu::Create(zx_vaddr_t ip, zx_vaddr_t cr3, paddr_t msr_bitmaps_addr
 }
 
 Vcpu::Vcpu(const thread_t* thread, uint16_t vpid, GuestPhysicalAddressSpace* gpas, TrapMap* traps)
-    : thread_(thread), vpid_(vpid), gpas_(gpas), traps_(traps),
+    : thread_(thread), vpid_(vpid), running_(false), gpas_(gpas), traps_(traps),
       vmx_state_(/* zero-init */) {}
 
 Vcpu::~Vcpu() {
@@ -619,8 +686,91 @@ Vcpu::~Vcpu() {
     DEBUG_ASSERT(status == ZX_OK);
 }
 
+static PostedInterruptDescriptor* posted_interrupt_desc(LocalApicState* local_apic_state) {
+    return local_apic_state->posted_interrupt_page.VirtualAddress<PostedInterruptDescriptor>();
+}
+
+// Records |vector| in the posted-interrupt descriptor. Returns whether a
+// notification needs to be sent for it.
+static bool local_apic_post_interrupt(LocalApicState* local_apic_state, uint32_t vector) {
+    PostedInterruptDescriptor* desc = posted_interrupt_desc(local_apic_state);
+    __atomic_fetch_or(&desc->pir[vector / 64], 1ul << (vector % 64), __ATOMIC_SEQ_CST);
+    uint64_t control = __atomic_fetch_or(&desc->control, kPostedInterruptOutstanding,
+                                         __ATOMIC_SEQ_CST);
+    return !(control & kPostedInterruptOutstanding);
+}
+
+void local_apic_drain_posted_interrupts(LocalApicState* local_apic_state) {
+    if (!local_apic_state->posted_interrupts)
+        return;
+    // Clear the outstanding notification first, as the processor does, so that
+    // anything posted from here on sends a new one.
+    PostedInterruptDescriptor* desc = posted_interrupt_desc(local_apic_state);
+    __atomic_fetch_and(&desc->control, ~kPostedInterruptOutstanding, __ATOMIC_SEQ_CST);
+    for (uint32_t i = 0; i < fbl::count_of(desc->pir); i++) {
+        uint64_t pir = __atomic_exchange_n(&desc->pir[i], 0, __ATOMIC_SEQ_CST);
+        while (pir != 0) {
+            uint32_t bit = __builtin_ctzl(pir);
+            pir &= pir - 1;
+            local_apic_state->interrupt_tracker.Track(i * 64 + bit);
+        }
+    }
+}
+
+static volatile uint32_t* virtual_apic_reg(const LocalApicState& local_apic_state,
+                                           uint32_t offset) {
+    uint8_t* page = local_apic_state.virtual_apic_page.VirtualAddress<uint8_t>();
+    return reinterpret_cast<volatile uint32_t*>(page + offset);
+}
+
+bool local_apic_virtual_interrupt_pending(const AutoVmcs& vmcs,
+                                          const LocalApicState& local_apic_state) {
+    // From Volume 3, Section 29.2.1: A virtual interrupt is delivered when the
+    // priority class of RVI is above that of VPPR.
+    uint8_t rvi = static_cast<uint8_t>(vmcs.Read(VmcsField16::GUEST_INTERRUPT_STATUS));
+    uint32_t vppr = *virtual_apic_reg(local_apic_state, kApicPpr);
+    return (rvi & 0xf0) > (vppr & 0xf0);
+}
+
+// Moves pending interrupts into the virtual APIC's IRR, for the processor to
+// deliver. Exceptions can't be delivered this way, so they are injected.
+static void local_apic_pend_virtual_interrupts(AutoVmcs* vmcs,
+                                               LocalApicState* local_apic_state) {
+    local_apic_drain_posted_interrupts(local_apic_state);
+
+    uint16_t interrupt_status = vmcs->Read(VmcsField16::GUEST_INTERRUPT_STATUS);
+    uint8_t rvi = static_cast<uint8_t>(interrupt_status);
+    uint32_t vector;
+    while (local_apic_state->interrupt_tracker.Pop(&vector) == ZX_OK) {
+        if (vector <= X86_INT_MAX_INTEL_DEFINED) {
+            // Vectors are popped highest first, so everything left is an
+            // exception too. Inject one, if nothing else is being injected.
+            if (vmcs->Read(VmcsField32::ENTRY_INTERRUPTION_INFORMATION) & kInterruptInfoValid) {
+                local_apic_state->interrupt_tracker.Track(vector);
+            } else {
+                vmcs->IssueInterrupt(vector);
+            }
+            break;
+        }
+        volatile uint32_t* irr = virtual_apic_reg(*local_apic_state, kApicIrr + 0x10 * (vector / 32));
+        *irr |= 1u << (vector % 32);
+        if (vector > rvi)
+            rvi = static_cast<uint8_t>(vector);
+    }
+
+    // From Volume 3, Section 24.4.2: RVI is the low byte of the guest
+    // interrupt status.
+    interrupt_status = static_cast<uint16_t>((interrupt_status & 0xff00) | rvi);
+    vmcs->Write(VmcsField16::GUEST_INTERRUPT_STATUS, interrupt_status);
+}
+
 // Injects an interrupt into the guest, if there is one pending.
 static void local_apic_maybe_interrupt(AutoVmcs* vmcs, LocalApicState* local_apic_state) {
+    if (local_apic_state->virtual_interrupt_delivery) {
+        local_apic_pend_virtual_interrupts(vmcs, local_apic_state);
+        return;
+    }
+
     uint32_t vector;
     zx_status_t status = local_apic_state->interrupt_tracker.Pop(&vector);
     if (status != ZX_OK)
@@ -642,6 +792,9 @@ zx_status_t Vcpu::Resume(zx_port_packet_t* packet) {
     zx_status_t status;
     do {
         AutoVmcs vmcs(vmcs_page_.PhysicalAddress());
+        // Mark ourselves as running before picking up pending interrupts, so
+        // that anything posted after this is delivered by notification.
+        running_.store(true);
         local_apic_maybe_interrupt(&vmcs, &local_apic_state_);
         if (x86_feature_test(X86_FEATURE_XSAVE)) {
             // Save the host XCR0, and load the guest XCR0.
@@ -649,6 +802,7 @@ zx_status_t Vcpu::Resume(zx_port_packet_t* packet) {
             x86_xsetbv(0, vmx_state_.guest_state.xcr0);
         }
         status = vmx_enter(&vmx_state_);
+        running_.store(false);
         if (x86_feature_test(X86_FEATURE_XSAVE)) {
             // Save the guest XCR0, and load the host XCR0.
             vmx_state_.guest_state.xcr0 = x86_xgetbv(0);
@@ -681,8 +835,33 @@ void vmx_exit(VmxState* vmx_state) {
 }
 
 zx_status_t Vcpu::Interrupt(uint32_t vector) {
+    if (vector >= X86_INT_COUNT)
+        return ZX_ERR_OUT_OF_RANGE;
+
     bool signaled;
-    zx_status_t status = local_apic_state_.interrupt_tracker.Interrupt(vector, true, &signaled);
+    zx_status_t status;
+    if (local_apic_state_.posted_interrupts && vector > X86_INT_MAX_INTEL_DEFINED) {
+        // Post the interrupt, then check if the VCPU is running. If it is, the
+        // notification delivers the interrupt without a VM exit. Otherwise, the
+        // VCPU has either yet to pick up the interrupt on VM entry, or is
+        // waiting for one, so take the slow path.
+        bool notify = local_apic_post_interrupt(&local_apic_state_, vector);
+        if (running_.load()) {
+            if (notify) {
+                DEBUG_ASSERT(!arch_ints_disabled());
+                arch_disable_ints();
+                apic_send_ipi(X86_INT_IPI_POSTED, x86_cpu_num_to_apic_id(cpu_of(vpid_)),
+                              DELIVERY_MODE_FIXED);
+                arch_enable_ints();
+            }
+            kcounter_add(vcpu_interrupts_posted, 1u);
+            return ZX_OK;
+        }
+        local_apic_drain_posted_interrupts(&local_apic_state_);
+        status = local_apic_state_.interrupt_tracker.Signal(true, &signaled);
+    } else {
+        status = local_apic_state_.interrupt_tracker.Interrupt(vector, true, &signaled);
+    }
     if (status != ZX_OK)
         return status;
 
@@ -693,8 +872,10 @@ zx_status_t Vcpu::Interrupt(uint32_t vector) {
         // If we did not signal the VCPU and we are not running on the same CPU,
         // it means the VCPU is currently running, therefore we should issue an
         // IPI to force a VM exit.
-        if (cpu != arch_curr_cpu_num())
+        if (cpu != arch_curr_cpu_num()) {
             mp_reschedule(MP_IPI_TARGET_MASK, cpu_num_to_mask(cpu), 0);
+            kcounter_add(vcpu_interrupts_kicked, 1u);
+        }
         arch_enable_ints();
     }
     return ZX_OK;
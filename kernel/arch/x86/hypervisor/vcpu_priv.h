@@ -25,6 +25,7 @@ static const uint32_t kProcbasedCtls2Ept                = 1u << 1;
 static const uint32_t kProcbasedCtls2Rdtscp             = 1u << 3;
 static const uint32_t kProcbasedCtls2x2Apic             = 1u << 4;
 static const uint32_t kProcbasedCtls2Vpid               = 1u << 5;
+static const uint32_t kProcbasedCtls2VirtIntDelivery    = 1u << 9;
 static const uint32_t kProcbasedCtls2Invpcid            = 1u << 12;
 
 // PROCBASED_CTLS flags.
@@ -42,6 +43,7 @@ static const uint32_t kProcbasedCtlsProcbasedCtls2      = 1u << 31;
 // PINBASED_CTLS flags.
 static const uint32_t kPinbasedCtlsExtIntExiting        = 1u << 0;
 static const uint32_t kPinbasedCtlsNmiExiting           = 1u << 3;
+static const uint32_t kPinbasedCtlsPostedInterrupts     = 1u << 7;
 
 // EXIT_CTLS flags.
 static const uint32_t kExitCtls64bitMode                = 1u << 9;
@@ -80,8 +82,10 @@ static const uint32_t kInterruptibilityMovSsBlocking    = 1u << 1;
 // VMCS fields.
 enum class VmcsField16 : uint64_t {
     VPID                                                = 0x0000,
+    POSTED_INTERRUPT_NOTIFICATION_VECTOR                = 0x0002,
     GUEST_CS_SELECTOR                                   = 0x0802,
     GUEST_TR_SELECTOR                                   = 0x080e,
+    GUEST_INTERRUPT_STATUS                              = 0x0810,
     HOST_ES_SELECTOR                                    = 0x0c00,
     HOST_CS_SELECTOR                                    = 0x0c02,
     HOST_SS_SELECTOR                                    = 0x0c04,
@@ -96,7 +100,13 @@ enum class VmcsField64 : uint64_t {
     EXIT_MSR_STORE_ADDRESS                              = 0x2006,
     EXIT_MSR_LOAD_ADDRESS                               = 0x2008,
     ENTRY_MSR_LOAD_ADDRESS                              = 0x200a,
+    VIRTUAL_APIC_ADDRESS                                = 0x2012,
+    POSTED_INTERRUPT_DESC_ADDRESS                       = 0x2016,
     EPT_POINTER                                         = 0x201a,
+    EOI_EXIT_BITMAP_0                                   = 0x201c,
+    EOI_EXIT_BITMAP_1                                   = 0x201e,
+    EOI_EXIT_BITMAP_2                                   = 0x2020,
+    EOI_EXIT_BITMAP_3                                   = 0x2022,
     GUEST_PHYSICAL_ADDRESS                              = 0x2400,
     LINK_POINTER                                        = 0x2800,
     GUEST_IA32_PAT                                      = 0x2804,
@@ -118,6 +128,7 @@ enum class VmcsField32 : uint64_t {
     ENTRY_MSR_LOAD_COUNT                                = 0x4014,
     ENTRY_INTERRUPTION_INFORMATION                      = 0x4016,
     ENTRY_EXCEPTION_ERROR_CODE                          = 0x4018,
+    TPR_THRESHOLD                                       = 0x401c,
     PROCBASED_CTLS2                                     = 0x401e,
     INSTRUCTION_ERROR                                   = 0x4400,
     EXIT_REASON                                         = 0x4402,
@@ -171,6 +182,12 @@ enum class VmcsFieldXX : uint64_t {
     HOST_RIP                                            = 0x6c16,
 };
 
+// Virtual APIC page offsets, from Volume 3, Section 29.1.
+static const uint32_t kApicTpr                          = 0x080;
+static const uint32_t kApicPpr                          = 0x0a0;
+static const uint32_t kApicIsr                          = 0x100;
+static const uint32_t kApicIrr                          = 0x200;
+
 // clang-format on
 
 // Loads a VMCS within a given scope.
@@ -209,3 +226,24 @@ private:
     cpu_mask_t prev_cpu_mask_;
     thread_t* thread_;
 };
+
+struct LocalApicState;
+
+// Posted-interrupt descriptor, from Volume 3, Section 29.6. While a VCPU is
+// running, interrupts recorded here are delivered to it without a VM exit when
+// its CPU receives the notification vector.
+struct PostedInterruptDescriptor {
+    // One bit per interrupt vector.
+    uint64_t pir[4];
+    // Bit 0 is set while there is a notification outstanding.
+    uint64_t control;
+    uint64_t reserved[3];
+};
+static_assert(sizeof(PostedInterruptDescriptor) == 64, "");
+
+// Moves any interrupts posted to |local_apic_state| into its interrupt tracker.
+void local_apic_drain_posted_interrupts(LocalApicState* local_apic_state);
+
+// Returns whether the virtual APIC has an interrupt the guest can take now.
+bool local_apic_virtual_interrupt_pending(const AutoVmcs& vmcs,
+                                          const LocalApicState& local_apic_state);
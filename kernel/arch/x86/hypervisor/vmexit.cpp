@@ -12,14 +12,17 @@
 #include <trace.h>
 
 #include <arch/hypervisor.h>
+#include <arch/ops.h>
 #include <arch/x86/apic.h>
 #include <arch/x86/feature.h>
 #include <arch/x86/mmu.h>
 #include <explicit-memory/bytes.h>
+#include <fbl/algorithm.h>
 #include <fbl/canary.h>
 #include <hypervisor/guest_physical_address_space.h>
 #include <hypervisor/interrupt_tracker.h>
 #include <kernel/auto_lock.h>
+#include <lib/counters.h>
 #include <platform.h>
 #include <platform/pc/timer.h>
 #include <vm/fault.h>
@@ -47,6 +50,10 @@ static const uint32_t kLastExtendedStateComponent = 9;
 static const uint32_t kXsaveLegacyRegionSize = 512;
 static const uint32_t kXsaveHeaderSize = 64;
 
+// Bounds of the window for which a VCPU polls for an interrupt on HLT.
+static const zx_duration_t kHaltPollStart = ZX_USEC(10);
+static const zx_duration_t kHaltPollMax = ZX_USEC(200);
+
 static const char kHypVendorId[] = "KVMKVMKVM\0\0\0";
 static const size_t kHypVendorIdLength = 12;
 static_assert(sizeof(kHypVendorId) - 1 == kHypVendorIdLength, "");
@@ -289,10 +296,63 @@ static zx_status_t handle_cpuid(const ExitInfo& exit_info, AutoVmcs* vmcs,
     }
 }
 
+KCOUNTER(halt_poll_succeeded, "kernel.hypervisor.halt_poll.succeeded");
+KCOUNTER(halt_poll_failed, "kernel.hypervisor.halt_poll.failed");
+
+// Waits for an interrupt, first spinning for the VCPU's halt-poll window so
+// that an interrupt arriving shortly after HLT doesn't cost a sleep and a
+// wakeup. The window grows while the VCPU is woken soon after blocking, and
+// shrinks once it blocks for longer than polling would ever cover.
+//
+// Host interrupts are masked for as long as the VMCS is loaded, so it is let
+// go of for the poll, just as it is for blocking, and must not be used again
+// by the caller.
+static zx_status_t wait_for_interrupt(AutoVmcs* vmcs, LocalApicState* local_apic_state) {
+    zx_time_t start = current_time();
+    zx_duration_t window = local_apic_state->halt_poll_window;
+    if (window > 0) {
+        vmcs->Invalidate();
+        arch_enable_ints();
+        zx_time_t deadline = start + window;
+        bool pending;
+        while (!(pending = local_apic_state->interrupt_tracker.Pending()) &&
+               current_time() < deadline) {
+            arch_spinloop_pause();
+        }
+        arch_disable_ints();
+
+        if (pending) {
+            kcounter_add(halt_poll_succeeded, 1u);
+            return ZX_OK;
+        }
+        kcounter_add(halt_poll_failed, 1u);
+    }
+
+    zx_status_t status = local_apic_state->interrupt_tracker.Wait(vmcs);
+    if (status != ZX_OK)
+        return status;
+
+    zx_duration_t halted = current_time() - start;
+    if (halted <= kHaltPollMax) {
+        window = window == 0 ? kHaltPollStart : fbl::min(window * 2, kHaltPollMax);
+    } else if (window > 0) {
+        window = window / 2 < kHaltPollStart ? 0 : window / 2;
+    }
+    local_apic_state->halt_poll_window = window;
+    return ZX_OK;
+}
+
 static zx_status_t handle_hlt(const ExitInfo& exit_info, AutoVmcs* vmcs,
                               LocalApicState* local_apic_state) {
     next_rip(exit_info, vmcs);
-    return local_apic_state->interrupt_tracker.Wait(vmcs);
+    local_apic_drain_posted_interrupts(local_apic_state);
+    // An interrupt already in the virtual APIC will be delivered on VM entry,
+    // so there is nothing to wait for.
+    if (local_apic_state->virtual_interrupt_delivery &&
+        local_apic_virtual_interrupt_pending(*vmcs, *local_apic_state)) {
+        return ZX_OK;
+    }
+    return wait_for_interrupt(vmcs, local_apic_state);
 }
 
 static zx_status_t handle_io_instruction(const ExitInfo& exit_info, AutoVmcs* vmcs,
@@ -359,10 +419,21 @@ static zx_status_t handle_apic_rdmsr(const ExitInfo& exit_info, AutoVmcs* vmcs,
         guest_state->rax = 0xff;
         return ZX_OK;
     case X2ApicMsr::TPR:
-    case X2ApicMsr::LDR:
     case X2ApicMsr::ISR_31_0... X2ApicMsr::ISR_255_224:
-    case X2ApicMsr::TMR_31_0... X2ApicMsr::TMR_255_224:
     case X2ApicMsr::IRR_31_0... X2ApicMsr::IRR_255_224:
+        // With virtual-interrupt delivery, the processor keeps these in the
+        // virtual APIC page. From Volume 3, Section 29.5: the MSR at 800H + n
+        // is at offset 10H * n of the page.
+        if (local_apic_state->virtual_interrupt_delivery) {
+            next_rip(exit_info, vmcs);
+            uint32_t offset = static_cast<uint32_t>(guest_state->rcx & 0xff) << 4;
+            uint8_t* page = local_apic_state->virtual_apic_page.VirtualAddress<uint8_t>();
+            guest_state->rax = *reinterpret_cast<volatile uint32_t*>(page + offset);
+            return ZX_OK;
+        }
+        // fallthrough
+    case X2ApicMsr::LDR:
+    case X2ApicMsr::TMR_31_0... X2ApicMsr::TMR_255_224:
     case X2ApicMsr::ESR:
         // These registers reset to 0. See Volume 3 Section 10.12.5.1.
         next_rip(exit_info, vmcs);
@@ -661,29 +732,36 @@ static zx_status_t fetch_data(const AutoVmcs& vmcs, GuestPhysicalAddressSpace* g
     return ZX_OK;
 }
 
+KCOUNTER(exit_bell_queued, "kernel.hypervisor.vmexit.bell_queued");
+
 static zx_status_t handle_trap(const ExitInfo& exit_info, AutoVmcs* vmcs, zx_vaddr_t guest_paddr,
                                GuestPhysicalAddressSpace* gpas, TrapMap* traps,
                                zx_port_packet_t* packet) {
-    if (exit_info.exit_instruction_length > X86_MAX_INST_LEN)
-        return ZX_ERR_INTERNAL;
-
     Trap* trap;
     zx_status_t status = traps->FindTrap(ZX_GUEST_TRAP_BELL, guest_paddr, &trap);
     if (status != ZX_OK)
         return status;
-    next_rip(exit_info, vmcs);
 
     switch (trap->kind()) {
     case ZX_GUEST_TRAP_BELL:
+        // A bell only needs the address that was accessed, so there is no
+        // instruction to fetch, and with a port the VCPU goes straight back
+        // into the guest.
+        next_rip(exit_info, vmcs);
         memset(packet, 0, sizeof(*packet));
         packet->key = trap->key();
         packet->type = ZX_PKT_TYPE_GUEST_BELL;
         packet->guest_bell.addr = guest_paddr;
-        if (trap->HasPort())
+        if (trap->HasPort()) {
+            kcounter_add(exit_bell_queued, 1u);
             return trap->Queue(*packet, vmcs);
+        }
         // If there was no port for the range, then return to user-space.
         break;
     case ZX_GUEST_TRAP_MEM:
+        if (exit_info.exit_instruction_length > X86_MAX_INST_LEN)
+            return ZX_ERR_INTERNAL;
+        next_rip(exit_info, vmcs);
         memset(packet, 0, sizeof(*packet));
         packet->key = trap->key();
         packet->type = ZX_PKT_TYPE_GUEST_MEM;
@@ -761,6 +839,17 @@ static zx_status_t handle_xsetbv(const ExitInfo& exit_info, AutoVmcs* vmcs,
     return ZX_OK;
 }
 
+KCOUNTER(exit_external_interrupt, "kernel.hypervisor.vmexit.external_interrupt");
+KCOUNTER(exit_interrupt_window, "kernel.hypervisor.vmexit.interrupt_window");
+KCOUNTER(exit_cpuid, "kernel.hypervisor.vmexit.cpuid");
+KCOUNTER(exit_hlt, "kernel.hypervisor.vmexit.hlt");
+KCOUNTER(exit_io_instruction, "kernel.hypervisor.vmexit.io_instruction");
+KCOUNTER(exit_rdmsr, "kernel.hypervisor.vmexit.rdmsr");
+KCOUNTER(exit_wrmsr, "kernel.hypervisor.vmexit.wrmsr");
+KCOUNTER(exit_ept_violation, "kernel.hypervisor.vmexit.ept_violation");
+KCOUNTER(exit_xsetbv, "kernel.hypervisor.vmexit.xsetbv");
+KCOUNTER(exit_other, "kernel.hypervisor.vmexit.other");
+
 zx_status_t vmexit_handler(AutoVmcs* vmcs, GuestState* guest_state,
                            LocalApicState* local_apic_state, GuestPhysicalAddressSpace* gpas,
                            TrapMap* traps, zx_port_packet_t* packet) {
@@ -768,23 +857,30 @@ zx_status_t vmexit_handler(AutoVmcs* vmcs, GuestState* guest_state,
 
     switch (exit_info.exit_reason) {
     case ExitReason::EXTERNAL_INTERRUPT:
+        kcounter_add(exit_external_interrupt, 1u);
         return handle_external_interrupt(vmcs, local_apic_state);
     case ExitReason::INTERRUPT_WINDOW:
         LTRACEF("handling interrupt window\n\n");
+        kcounter_add(exit_interrupt_window, 1u);
         return handle_interrupt_window(vmcs, local_apic_state);
     case ExitReason::CPUID:
         LTRACEF("handling CPUID instruction\n\n");
+        kcounter_add(exit_cpuid, 1u);
         return handle_cpuid(exit_info, vmcs, guest_state);
     case ExitReason::HLT:
         LTRACEF("handling HLT instruction\n\n");
+        kcounter_add(exit_hlt, 1u);
         return handle_hlt(exit_info, vmcs, local_apic_state);
     case ExitReason::IO_INSTRUCTION:
+        kcounter_add(exit_io_instruction, 1u);
         return handle_io_instruction(exit_info, vmcs, guest_state, traps, packet);
     case ExitReason::RDMSR:
         LTRACEF("handling RDMSR instruction %#" PRIx64 "\n\n", guest_state->rcx);
+        kcounter_add(exit_rdmsr, 1u);
         return handle_rdmsr(exit_info, vmcs, guest_state, local_apic_state);
     case ExitReason::WRMSR:
         LTRACEF("handling WRMSR instruction %#" PRIx64 "\n\n", guest_state->rcx);
+        kcounter_add(exit_wrmsr, 1u);
         return handle_wrmsr(exit_info, vmcs, guest_state, local_apic_state, packet);
     case ExitReason::ENTRY_FAILURE_GUEST_STATE:
     case ExitReason::ENTRY_FAILURE_MSR_LOADING:
@@ -792,14 +888,17 @@ zx_status_t vmexit_handler(AutoVmcs* vmcs, GuestState* guest_state,
         return ZX_ERR_BAD_STATE;
     case ExitReason::EPT_VIOLATION:
         LTRACEF("handling EPT violation\n\n");
+        kcounter_add(exit_ept_violation, 1u);
         return handle_ept_violation(exit_info, vmcs, gpas, traps, packet);
     case ExitReason::XSETBV:
         LTRACEF("handling XSETBV instruction\n\n");
+        kcounter_add(exit_xsetbv, 1u);
         return handle_xsetbv(exit_info, vmcs, guest_state);
     case ExitReason::EXCEPTION:
         // Currently all exceptions except NMI delivered to guest directly. NMI causes vmexit
         // and handled by host via IDT as any other interrupt/exception.
     default:
+        kcounter_add(exit_other, 1u);
         dprintf(CRITICAL, "Unhandled VM exit %u (%s)\n", static_cast<uint32_t>(exit_info.exit_reason),
                 exit_reason_name(exit_info.exit_reason));
         return ZX_ERR_NOT_SUPPORTED;
@@ -5,6 +5,7 @@
 // https://opensource.org/licenses/MIT
 
 #include "vmx_cpu_state_priv.h"
+#include "vcpu_priv.h"
 
 #include <assert.h>
 #include <bits.h>
@@ -56,6 +57,20 @@ VmxInfo::VmxInfo() {
     vmx_controls = BIT_SHIFT(basic_info, 55);
 }
 
+ApicvInfo::ApicvInfo() {
+    // From Volume 3, Appendix A.3: the allowed 1-settings of each control are
+    // in the upper 32 bits of its MSR.
+    uint32_t procbased_ctls2 =
+        static_cast<uint32_t>(BITS_SHIFT(read_msr(X86_MSR_IA32_VMX_PROCBASED_CTLS2), 63, 32));
+    uint32_t pinbased_ctls =
+        static_cast<uint32_t>(BITS_SHIFT(read_msr(X86_MSR_IA32_VMX_TRUE_PINBASED_CTLS), 63, 32));
+    virtual_interrupt_delivery = procbased_ctls2 & kProcbasedCtls2VirtIntDelivery;
+    // From Volume 3, Section 26.2.1.1: posted interrupts also need
+    // virtual-interrupt delivery.
+    posted_interrupts = virtual_interrupt_delivery &&
+                        (pinbased_ctls & kPinbasedCtlsPostedInterrupts);
+}
+
 EptInfo::EptInfo() {
     // From Volume 3, Appendix A.10.
     uint64_t ept_info = read_msr(X86_MSR_IA32_VMX_EPT_VPID_CAP);
@@ -51,6 +51,14 @@ struct EptInfo {
     EptInfo();
 };
 
+/* Stores APIC virtualization info from the VMX control MSRs. */
+struct ApicvInfo {
+    bool virtual_interrupt_delivery;
+    bool posted_interrupts;
+
+    ApicvInfo();
+};
+
 /* VMX region to be used with both VMXON and VMCS. */
 struct VmxRegion {
     uint32_t revision_id;
@@ -0,0 +1,102 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <arch/defines.h>
+#include <arch/ops.h>
+#include <arch/x86/feature.h>
+#include <arch/x86/idle.h>
+#include <inttypes.h>
+#include <kernel/idle.h>
+#include <trace.h>
+#include <zircon/types.h>
+
+#define LOCAL_TRACE 0
+
+namespace {
+
+// CPUID leaf 5 ecx: the mwait extensions are enumerated, and interrupts
+// wake it up even while they are masked. The latter is also the one
+// extension mwait takes in ecx.
+constexpr uint32_t kMwaitExtensions = 1u << 0;
+constexpr uint32_t kMwaitIntBreak = 1u << 1;
+constexpr uint32_t kMwaitBreakOnMaskedInterrupt = 1u << 0;
+
+// The hardware doesn't report how long its C-states take to get out of, so
+// these are for the first sub-state of each C-state of an mwait hint, on the
+// conservative side of what recent Intel parts document. Intel names them
+// by their power savings rather than their hint, C3 for C2 and so on.
+struct MwaitCState {
+    const char* name;
+    zx_duration_t exit_latency;
+    zx_duration_t target_residency;
+};
+
+constexpr MwaitCState kCStates[] = {
+    {"C1", ZX_USEC(2), ZX_USEC(2)},
+    {"C2", ZX_USEC(80), ZX_USEC(200)},
+    {"C3", ZX_USEC(100), ZX_USEC(400)},
+    {"C4", ZX_USEC(150), ZX_USEC(800)},
+    {"C5", ZX_USEC(250), ZX_USEC(1000)},
+    {"C6", ZX_USEC(500), ZX_USEC(5000)},
+    {"C7", ZX_USEC(1000), ZX_USEC(5000)},
+};
+
+// Each cpu monitors a line of its own which nothing writes to, so that only
+// interrupts wake it up.
+struct alignas(MAX_CACHE_LINE) MonitorLine {
+    uint8_t bytes[MAX_CACHE_LINE];
+};
+
+MonitorLine monitor_lines[SMP_MAX_CPUS];
+
+void mwait_enter(const struct idle_state* state) {
+    __asm__ volatile("monitor" ::"a"(&monitor_lines[arch_curr_cpu_num()]), "c"(0), "d"(0));
+    __asm__ volatile("mwait" ::"a"(static_cast<uint32_t>(state->arg)),
+                     "c"(kMwaitBreakOnMaskedInterrupt)
+                     : "memory");
+}
+
+} // namespace
+
+void x86_idle_init(void) {
+    if (!x86_feature_test(X86_FEATURE_MON))
+        return;
+
+    const struct cpuid_leaf* leaf = x86_get_cpuid_leaf(X86_CPUID_MON);
+    if (!leaf || (leaf->c & (kMwaitExtensions | kMwaitIntBreak)) !=
+                     (kMwaitExtensions | kMwaitIntBreak))
+        return;
+
+    // Below C1 the local apic timer stops, unless it is always running.
+    bool arat = x86_feature_test(X86_FEATURE_ARAT);
+
+    // edx holds the number of sub-states of C0 through C7, four bits each.
+    struct idle_state states[IDLE_STATES_MAX];
+    uint count = 0;
+    for (uint i = 0; i < countof(kCStates) && count < IDLE_STATES_MAX; i++) {
+        uint substates = (leaf->d >> (4 * (i + 1))) & 0xf;
+        if (substates == 0)
+            continue;
+        if (i > 0 && !arat)
+            break;
+
+        states[count].name = kCStates[i].name;
+        states[count].exit_latency = kCStates[i].exit_latency;
+        states[count].target_residency = kCStates[i].target_residency;
+        states[count].enter = mwait_enter;
+        states[count].arg = i << 4;
+        LTRACEF("mwait %s hint %#" PRIx64 " substates %u\n",
+                states[count].name, states[count].arg, substates);
+        count++;
+    }
+
+    // mwait C1 replaces hlt, without it there is nothing as cheap to fall
+    // back to.
+    if (count == 0 || states[0].arg != 0)
+        return;
+
+    idle_register_states(states, count);
+}
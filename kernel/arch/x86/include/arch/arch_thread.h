@@ -15,6 +15,8 @@
 
 __BEGIN_CDECLS
 
+struct x86_ipt_thread_trace;
+
 struct arch_thread {
     vaddr_t sp;
 #if __has_feature(safe_stack)
@@ -45,6 +47,10 @@ struct arch_thread {
 
     /* if non-NULL, address to return to on page fault */
     void *page_fault_resume;
+
+    /* the processor trace this thread is traced into while it runs, if any,
+     * changed with the thread lock held. See x86_ipt_context_switch(). */
+    struct x86_ipt_thread_trace *ipt_trace;
 };
 
 static inline void x86_set_suspended_general_regs(struct arch_thread *thread,
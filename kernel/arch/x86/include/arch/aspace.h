@@ -41,8 +41,7 @@ private:
     IntermediatePtFlags intermediate_flags() final;
     PtFlags terminal_flags(PageTableLevel level, uint flags) final;
     PtFlags split_flags(PageTableLevel level, PtFlags flags) final;
-    void TlbInvalidatePage(PageTableLevel level, vaddr_t vaddr, bool global_page,
-                           bool was_terminal) final;
+    void TlbInvalidate(PendingTlbInvalidation* pending) final;
     uint pt_flags_to_mmu_flags(PtFlags flags, PageTableLevel level) final;
     bool needs_cache_flushes() final { return false; }
 
@@ -64,8 +63,7 @@ private:
     IntermediatePtFlags intermediate_flags() final;
     PtFlags terminal_flags(PageTableLevel level, uint flags) final;
     PtFlags split_flags(PageTableLevel level, PtFlags flags) final;
-    void TlbInvalidatePage(PageTableLevel level, vaddr_t vaddr, bool global_page,
-                           bool was_terminal) final;
+    void TlbInvalidate(PendingTlbInvalidation* pending) final;
     uint pt_flags_to_mmu_flags(PtFlags flags, PageTableLevel level) final;
     bool needs_cache_flushes() final { return false; }
 };
@@ -98,6 +96,10 @@ public:
 
     int active_cpus() { return active_cpus_.load(); }
 
+    // Called when the TLB entries of cpus not currently running this aspace
+    // are left stale, so they flush them when they next switch to it.
+    void MarkTlbStale() { tlb_generation_.fetch_add(1); }
+
     IoBitmap& io_bitmap() { return io_bitmap_; }
 
     static void ContextSwitch(X86ArchVmAspace* from, X86ArchVmAspace* to);
@@ -131,6 +133,16 @@ private:
     // CPUs that are currently executing in this aspace.
     // Actually an mp_cpu_mask_t, but header dependencies.
     fbl::atomic_int active_cpus_{0};
+
+    // The PCID tagging this aspace's TLB entries, or 0 if it has none and
+    // every switch to it flushes the TLB.
+    uint16_t pcid_ = 0;
+
+    // Moves on whenever a shootdown skips the cpus not running this aspace.
+    // A cpu whose generation for the aspace is behind flushes its PCID when
+    // switching to it.
+    fbl::atomic<uint64_t> tlb_generation_{1};
+    uint64_t cpu_tlb_generation_[SMP_MAX_CPUS] = {};
 };
 
 using ArchVmAspace = X86ArchVmAspace;
@@ -12,6 +12,7 @@
 #include <bitmap/raw-bitmap.h>
 #include <bitmap/storage.h>
 #include <fbl/array.h>
+#include <fbl/atomic.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_ptr.h>
 #include <hypervisor/interrupt_tracker.h>
@@ -82,6 +83,17 @@ struct LocalApicState {
     uint32_t lvt_timer = LVT_MASKED; // Initial state is masked (Vol 3 Section 10.12.5.1).
     uint32_t lvt_initial_count;
     uint32_t lvt_divide_config;
+    // Whether interrupts are delivered through the virtual APIC page by the
+    // processor, rather than injected on VM entry.
+    bool virtual_interrupt_delivery = false;
+    // Whether interrupts can be posted to the VCPU while it is running.
+    bool posted_interrupts = false;
+    // Virtual APIC page, for TPR shadowing and virtual-interrupt delivery.
+    VmxPage virtual_apic_page;
+    // Holds the posted-interrupt descriptor.
+    VmxPage posted_interrupt_page;
+    // How long to poll for an interrupt on HLT before blocking.
+    zx_duration_t halt_poll_window = 0;
 };
 
 // Represents a virtual CPU within a guest.
@@ -101,6 +113,8 @@ public:
 private:
     const thread_t* thread_;
     const uint16_t vpid_;
+    // Whether the VCPU is executing the guest, and so can take posted interrupts.
+    fbl::atomic<bool> running_;
     LocalApicState local_apic_state_;
     GuestPhysicalAddressSpace* gpas_;
     TrapMap* traps_;
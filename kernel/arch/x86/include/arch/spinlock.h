@@ -9,7 +9,9 @@
 
 #include <arch/x86.h>
 #include <kernel/atomic.h>
+#include <kernel/lockprof.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <zircon/compiler.h>
 #include <zircon/thread_annotations.h>
 
@@ -17,8 +19,16 @@ __BEGIN_CDECLS
 
 #define SPIN_LOCK_INITIAL_VALUE (spin_lock_t){0}
 
+/* A ticket lock: each cpu takes the next ticket and waits for it to be
+ * served, so the lock is handed over in the order it was asked for. */
 typedef struct TA_CAP("mutex") spin_lock {
-    unsigned long value;
+    /* the ticket being served in the low 16 bits, the next to hand out in the high 16 */
+    uint32_t tickets;
+    /* the holder's cpu number + 1, or 0 */
+    uint32_t holder;
+#if WITH_LOCK_PROFILING
+    struct lockprof_hold prof;
+#endif
 } spin_lock_t;
 
 typedef x86_flags_t spin_lock_saved_state_t;
@@ -35,12 +45,13 @@ static inline void arch_spin_lock_init(spin_lock_t *lock)
 
 static inline bool arch_spin_lock_held(spin_lock_t *lock)
 {
-    return __atomic_load_n(&lock->value, __ATOMIC_RELAXED) != 0;
+    uint32_t tickets = __atomic_load_n(&lock->tickets, __ATOMIC_RELAXED);
+    return (tickets & 0xffff) != (tickets >> 16);
 }
 
 static inline uint arch_spin_lock_holder_cpu(spin_lock_t *lock)
 {
-    return (uint)__atomic_load_n(&lock->value, __ATOMIC_RELAXED) - 1;
+    return (uint)__atomic_load_n(&lock->holder, __ATOMIC_RELAXED) - 1;
 }
 
 /* flags are unused on x86 */
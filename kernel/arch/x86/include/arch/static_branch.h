@@ -0,0 +1,42 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS
+
+// A static branch site is a 5 byte nop while its key is disabled, and a
+// jmp rel32 to the enabled code while it is enabled.
+#define ARCH_STATIC_BRANCH_NOP ".byte 0x0f, 0x1f, 0x44, 0x00, 0x00"
+#define ARCH_STATIC_BRANCH_SIZE 5
+
+// Fills in the instruction for the site at |site|.
+static inline void arch_static_branch_encode(uint8_t insn[ARCH_STATIC_BRANCH_SIZE],
+                                             uintptr_t site, uintptr_t target,
+                                             bool enabled) {
+    static const uint8_t nop[ARCH_STATIC_BRANCH_SIZE] = {0x0f, 0x1f, 0x44, 0x00, 0x00};
+    if (!enabled) {
+        memcpy(insn, nop, sizeof(nop));
+        return;
+    }
+    int32_t rel = (int32_t)(target - (site + ARCH_STATIC_BRANCH_SIZE));
+    insn[0] = 0xe9;
+    memcpy(&insn[1], &rel, sizeof(rel));
+}
+
+// Makes this cpu drop anything it fetched ahead of a patch.
+static inline void arch_static_branch_serialize(void) {
+    uint32_t a = 0, b, c = 0, d;
+    __asm__ volatile("cpuid"
+                     : "+a"(a), "=b"(b), "+c"(c), "=d"(d)::"memory");
+}
+
+__END_CDECLS
@@ -16,9 +16,16 @@ typedef struct {
     uint32_t package_id;
     uint32_t core_id;
     uint32_t smt_id;
+    /* id of the last level cache shared by this logical cpu, unique across packages */
+    uint32_t cache_id;
 } x86_cpu_topology_t;
 
 void x86_cpu_topology_init(void);
 void x86_cpu_topology_decode(uint32_t apic_id, x86_cpu_topology_t *topo);
 
+/* decode the topology of the |num_cpus| cpus in |apic_ids| and publish it to the
+ * scheduler as SMT, LLC, and package domains. Must be called after the apic id to
+ * cpu number mapping has been established. */
+void x86_cpu_topology_init_sched_domains(const uint32_t *apic_ids, uint32_t num_cpus);
+
 __END_CDECLS
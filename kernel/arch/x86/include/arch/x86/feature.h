@@ -43,6 +43,7 @@ enum x86_cpuid_leaf_num {
     X86_CPUID_EXT_BASE = 0x80000000,
     X86_CPUID_BRAND = 0x80000002,
     X86_CPUID_ADDR_WIDTH = 0x80000008,
+    X86_CPUID_AMD_CACHE_TOPOLOGY = 0x8000001d,
     X86_CPUID_AMD_TOPOLOGY = 0x8000001e,
 };
 
@@ -128,6 +129,7 @@ void x86_feature_debug(void);
 #define X86_FEATURE_SSE          X86_CPUID_BIT(0x1, 3, 25)
 #define X86_FEATURE_SSE2         X86_CPUID_BIT(0x1, 3, 26)
 #define X86_FEATURE_TM           X86_CPUID_BIT(0x1, 3, 29)
+#define X86_FEATURE_ARAT         X86_CPUID_BIT(0x6, 0, 2)
 #define X86_FEATURE_HWP          X86_CPUID_BIT(0x6, 0, 7)
 #define X86_FEATURE_HWP_NOT      X86_CPUID_BIT(0x6, 0, 8)
 #define X86_FEATURE_HWP_ACT      X86_CPUID_BIT(0x6, 0, 9)
@@ -147,6 +149,7 @@ void x86_feature_debug(void);
 #define X86_FEATURE_PT           X86_CPUID_BIT(0x7, 1, 25)
 #define X86_FEATURE_UMIP         X86_CPUID_BIT(0x7, 2, 2)
 #define X86_FEATURE_PKU          X86_CPUID_BIT(0x7, 2, 3)
+#define X86_FEATURE_FSRM         X86_CPUID_BIT(0x7, 3, 4)
 #define X86_FEATURE_AMD_TOPO     X86_CPUID_BIT(0x80000001, 2, 22)
 #define X86_FEATURE_SYSCALL      X86_CPUID_BIT(0x80000001, 3, 11)
 #define X86_FEATURE_NX           X86_CPUID_BIT(0x80000001, 3, 20)
@@ -0,0 +1,16 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS
+
+// Registers the mwait C-states the cpu supports with the idle governor.
+void x86_idle_init(void);
+
+__END_CDECLS
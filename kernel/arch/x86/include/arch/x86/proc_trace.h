@@ -38,4 +38,28 @@ zx_status_t x86_ipt_stage_cpu_data(uint32_t options, const zx_x86_pt_regs_t* reg
 
 zx_status_t x86_ipt_get_cpu_data(uint32_t options, zx_x86_pt_regs_t* regs);
 
+struct thread;
+
+// Thread traces are identified by their descriptor, less than
+// IPT_MAX_NUM_THREAD_TRACES. The caller keeps assigned threads alive until
+// they are released, or the trace is freed.
+
+zx_status_t x86_ipt_assign_thread(uint32_t descriptor, struct thread* thread);
+
+zx_status_t x86_ipt_release_thread(uint32_t descriptor, struct thread* thread);
+
+zx_status_t x86_ipt_stage_thread_data(uint32_t descriptor, const zx_x86_pt_regs_t* regs);
+
+zx_status_t x86_ipt_get_thread_data(uint32_t descriptor, zx_x86_pt_regs_t* regs);
+
+zx_status_t x86_ipt_thread_mode_start();
+
+zx_status_t x86_ipt_thread_mode_stop();
+
+zx_status_t x86_ipt_pause_thread(uint32_t descriptor);
+
+zx_status_t x86_ipt_resume_thread(uint32_t descriptor);
+
+void x86_ipt_context_switch(struct thread* new_thread);
+
 #endif // __cplusplus
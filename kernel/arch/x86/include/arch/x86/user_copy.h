@@ -21,4 +21,9 @@ zx_status_t _x86_copy_to_or_from_user(
         size_t len,
         void **fault_return);
 
+/* Like arch_copy_from_user(), but callable from interrupt handlers: rather
+ * than being paged in, user memory that isn't mapped fails the copy with
+ * ZX_ERR_INVALID_ARGS. */
+zx_status_t x86_copy_from_user_nofault(void *dst, const void *src, size_t len);
+
 __END_CDECLS
@@ -16,7 +16,12 @@
 #include <arch/x86/feature.h>
 #include <arch/x86/mmu.h>
 #include <arch/x86/mmu_mem_types.h>
+#include <fbl/algorithm.h>
+#include <fbl/auto_lock.h>
+#include <fbl/mutex.h>
+#include <kernel/cmdline.h>
 #include <kernel/mp.h>
+#include <lib/counters.h>
 #include <vm/arch_vm_aspace.h>
 #include <vm/pmm.h>
 #include <vm/vm.h>
@@ -33,6 +38,22 @@ uint8_t g_paddr_width = 32;
 /* True if the system supports 1GB pages */
 static bool supports_huge_pages = false;
 
+/* True if user address spaces get their own PCID, so that switching between
+ * them keeps their TLB entries around */
+static bool pcid_enabled = false;
+
+/* PCIDs handed out to user address spaces, PCID 0 is the kernel's and is used
+ * by any address space that couldn't get one */
+static const uint kNumPcids = X86_CR3_PCID_MASK + 1;
+static fbl::Mutex pcid_lock;
+static uint64_t pcid_bitmap[kNumPcids / 64] TA_GUARDED(pcid_lock) = {1};
+
+KCOUNTER(tlb_shootdowns, "kernel.x86.tlb.shootdowns");
+KCOUNTER(tlb_shootdowns_skipped, "kernel.x86.tlb.shootdowns_skipped");
+KCOUNTER(tlb_pages_invalidated, "kernel.x86.tlb.pages_invalidated");
+KCOUNTER(tlb_full_invalidations, "kernel.x86.tlb.full_invalidations");
+KCOUNTER(tlb_pcid_flushes, "kernel.x86.tlb.pcid_flushes");
+
 /* top level kernel page tables, initialized in start.S */
 volatile pt_entry_t pml4[NO_OF_PT_ENTRIES] __ALIGNED(PAGE_SIZE);
 volatile pt_entry_t pdp[NO_OF_PT_ENTRIES] __ALIGNED(PAGE_SIZE); /* temporary */
@@ -119,55 +140,70 @@ static void x86_tlb_global_invalidate() {
     }
 }
 
-/* Task used for invalidating a TLB entry on each CPU */
+/**
+ * @brief  invalidate all non-global TLB entries of the current PCID
+ */
+static void x86_tlb_nonglobal_invalidate() {
+    x86_set_cr3(x86_get_cr3());
+}
+
+/* Task used for invalidating a batch of TLB entries on each CPU */
 struct TlbInvalidatePage_context {
     ulong target_cr3;
-    vaddr_t vaddr;
-    enum PageTableLevel level;
-    bool global_page;
+    const PendingTlbInvalidation* pending;
 };
 static void TlbInvalidatePage_task(void* raw_context) {
     DEBUG_ASSERT(arch_ints_disabled());
     TlbInvalidatePage_context* context = (TlbInvalidatePage_context*)raw_context;
+    const PendingTlbInvalidation* pending = context->pending;
 
-    ulong cr3 = x86_get_cr3();
-    if (context->target_cr3 != cr3 && !context->global_page) {
+    ulong cr3 = x86_get_cr3() & ~(ulong)X86_CR3_PCID_MASK;
+    bool current_aspace = context->target_cr3 == cr3;
+    if (!current_aspace && !pending->contains_global) {
         /* This invalidation doesn't apply to this CPU, ignore it */
         return;
     }
 
-    switch (context->level) {
-    case PML4_L:
-        x86_tlb_global_invalidate();
-        break;
-    case PDP_L:
-    case PD_L:
-    case PT_L:
-        __asm__ volatile("invlpg %0" ::"m"(*(uint8_t*)context->vaddr));
-        break;
+    if (pending->full_shootdown) {
+        if (pending->contains_global) {
+            x86_tlb_global_invalidate();
+        } else {
+            x86_tlb_nonglobal_invalidate();
+        }
+        return;
+    }
+
+    for (uint i = 0; i < pending->count; ++i) {
+        const auto& item = pending->items[i];
+        if (!current_aspace && !item.is_global) {
+            continue;
+        }
+        __asm__ volatile("invlpg %0" ::"m"(*(uint8_t*)item.vaddr));
     }
 }
 
 /**
- * @brief Invalidate a single page at a given page table level
+ * @brief Invalidate a batch of TLB entries of a page table
  *
- * @param pt The page table we're invalidating for (if nullptr, assume for current one)
- * @param vaddr The virtual address we are invalidating the TLB entry for
- * @param level The page table level that maps this vaddr
- * @param global_page True if we are invalidating a global mapping
+ * @param pt The page table we're invalidating for
+ * @param pending The entries that changed
  *
- * TODO(ZX-979): Optimize this.  This is horribly inefficient.
- * We should also change this to pool invalidations from a single
- * "transaction" and then only execute a single mp_sync_exec for that
- * transaction, rather than one per page.
+ * Only CPUs currently running the page table's aspace are interrupted.  The
+ * others pick up the change when they next switch to it, either because the
+ * CR3 load flushes the TLB or, with PCIDs, because the aspace's TLB
+ * generation moved on.
  */
-static void x86_tlb_invalidate_page(X86PageTableBase* pt, vaddr_t vaddr,
-                                    enum PageTableLevel level, bool global_page) {
-    ulong cr3 = pt ? pt->phys() : x86_get_cr3();
+static void x86_tlb_invalidate(X86PageTableBase* pt, const PendingTlbInvalidation* pending) {
     struct TlbInvalidatePage_context task_context = {
-        .target_cr3 = cr3, .vaddr = vaddr, .level = level, .global_page = global_page,
+        .target_cr3 = pt->phys(), .pending = pending,
     };
 
+    if (pending->full_shootdown) {
+        kcounter_add(tlb_full_invalidations, 1);
+    } else {
+        kcounter_add(tlb_pages_invalidated, pending->count);
+    }
+
     /* Target only CPUs this aspace is active on.  It may be the case that some
      * other CPU will become active in it after this load, or will have left it
      * just before this load.  In the former case, it is becoming active after
@@ -175,16 +211,47 @@ static void x86_tlb_invalidate_page(X86PageTableBase* pt, vaddr_t vaddr,
      * case, it will get a spurious request to flush. */
     mp_ipi_target_t target;
     cpu_mask_t target_mask = 0;
-    if (global_page || pt == nullptr) {
+    if (pending->contains_global) {
         target = MP_IPI_TARGET_ALL;
     } else {
+        auto aspace = static_cast<X86ArchVmAspace*>(pt->ctx());
+        // This has to be ordered before loading the active cpus, see
+        // X86ArchVmAspace::ContextSwitch.
+        aspace->MarkTlbStale();
+
         target = MP_IPI_TARGET_MASK;
-        target_mask = static_cast<X86ArchVmAspace*>(pt->ctx())->active_cpus();
+        target_mask = aspace->active_cpus();
+        if (target_mask == 0) {
+            kcounter_add(tlb_shootdowns_skipped, 1);
+            return;
+        }
     }
 
+    kcounter_add(tlb_shootdowns, 1);
     mp_sync_exec(target, target_mask, TlbInvalidatePage_task, &task_context);
 }
 
+/* Returns a free PCID, or 0 if they are all in use. */
+static uint16_t x86_pcid_alloc() {
+    fbl::AutoLock a(&pcid_lock);
+    for (uint i = 0; i < fbl::count_of(pcid_bitmap); i++) {
+        if (~pcid_bitmap[i] == 0) {
+            continue;
+        }
+        uint bit = __builtin_ctzll(~pcid_bitmap[i]);
+        pcid_bitmap[i] |= 1ull << bit;
+        return static_cast<uint16_t>(i * 64 + bit);
+    }
+    return 0;
+}
+
+static void x86_pcid_free(uint16_t pcid) {
+    DEBUG_ASSERT(pcid != 0 && pcid < kNumPcids);
+    fbl::AutoLock a(&pcid_lock);
+    DEBUG_ASSERT(pcid_bitmap[pcid / 64] & (1ull << (pcid % 64)));
+    pcid_bitmap[pcid / 64] &= ~(1ull << (pcid % 64));
+}
+
 bool X86PageTableMmu::check_paddr(paddr_t paddr) {
     return x86_mmu_check_paddr(paddr);
 }
@@ -282,9 +349,8 @@ X86PageTableBase::PtFlags X86PageTableMmu::split_flags(PageTableLevel level,
     return flags;
 }
 
-void X86PageTableMmu::TlbInvalidatePage(PageTableLevel level, vaddr_t vaddr, bool global_page,
-                                        bool was_terminal) {
-    x86_tlb_invalidate_page(this, vaddr, level, global_page);
+void X86PageTableMmu::TlbInvalidate(PendingTlbInvalidation* pending) {
+    x86_tlb_invalidate(this, pending);
 }
 
 uint X86PageTableMmu::pt_flags_to_mmu_flags(PtFlags flags, PageTableLevel level) {
@@ -392,8 +458,7 @@ X86PageTableBase::PtFlags X86PageTableEpt::split_flags(PageTableLevel level,
     return flags;
 }
 
-void X86PageTableEpt::TlbInvalidatePage(PageTableLevel level, vaddr_t vaddr, bool global_page,
-                                        bool was_terminal) {
+void X86PageTableEpt::TlbInvalidate(PendingTlbInvalidation* pending) {
     // TODO(ZX-981): Implement this.
 }
 
@@ -418,9 +483,9 @@ void x86_mmu_early_init() {
 
     x86_mmu_mem_type_init();
 
-    // Unmap the lower identity mapping.
+    // Unmap the lower identity mapping.  The other cpus haven't been started yet.
     pml4[0] = 0;
-    x86_tlb_invalidate_page(nullptr, 0, PML4_L, false);
+    x86_tlb_global_invalidate();
 
     /* get the address width from the CPU */
     uint8_t vaddr_width = x86_linear_address_width();
@@ -439,7 +504,18 @@ void x86_mmu_early_init() {
     LTRACEF("paddr_width %u vaddr_width %u\n", g_paddr_width, g_vaddr_width);
 }
 
-void x86_mmu_init(void) {}
+void x86_mmu_init(void) {
+    // The command line isn't available yet during early init, so PCIDs are
+    // turned on here for the boot cpu and by x86_mmu_percpu_init for the rest.
+    pcid_enabled = x86_feature_test(X86_FEATURE_PCID) &&
+                   cmdline_get_bool("kernel.x86.pcid", true);
+    if (pcid_enabled) {
+        // PCIDE can only be set while running with PCID 0.
+        DEBUG_ASSERT((x86_get_cr3() & X86_CR3_PCID_MASK) == 0);
+        x86_set_cr4(x86_get_cr4() | X86_CR4_PCIDE);
+    }
+    dprintf(INFO, "x86: PCIDs %s\n", pcid_enabled ? "enabled" : "disabled");
+}
 
 X86PageTableBase::X86PageTableBase() {
 }
@@ -532,6 +608,10 @@ zx_status_t X86ArchVmAspace::Init(vaddr_t base, size_t size, uint mmu_flags) {
             return status;
         }
 
+        if (pcid_enabled) {
+            pcid_ = x86_pcid_alloc();
+        }
+
         LTRACEF("user aspace: pt phys %#" PRIxPTR ", virt %p\n", pt_->phys(), pt_->virt());
     }
     fbl::atomic_init(&active_cpus_, 0);
@@ -548,6 +628,13 @@ zx_status_t X86ArchVmAspace::Destroy() {
     } else {
         static_cast<X86PageTableMmu*>(pt_)->Destroy(base_, size_);
     }
+
+    // A later owner of the PCID flushes it before first use on every cpu, since
+    // its per-cpu generations start out behind.
+    if (pcid_ != 0) {
+        x86_pcid_free(pcid_);
+        pcid_ = 0;
+    }
     return ZX_OK;
 }
 
@@ -582,17 +669,35 @@ zx_status_t X86ArchVmAspace::Protect(vaddr_t vaddr, size_t count, uint mmu_flags
 }
 
 void X86ArchVmAspace::ContextSwitch(X86ArchVmAspace* old_aspace, X86ArchVmAspace* aspace) {
-    cpu_mask_t cpu_bit = cpu_num_to_mask(arch_curr_cpu_num());
+    cpu_num_t cpu = arch_curr_cpu_num();
+    cpu_mask_t cpu_bit = cpu_num_to_mask(cpu);
     if (aspace != nullptr) {
         aspace->canary_.Assert();
         paddr_t phys = aspace->pt_phys();
         LTRACEF_LEVEL(3, "switching to aspace %p, pt %#" PRIXPTR "\n", aspace, phys);
-        x86_set_cr3(phys);
+
+        // Mark ourselves active before looking at the TLB generation.  A
+        // concurrent shootdown bumps the generation before loading the active
+        // cpus, so it either sends us an IPI or we see the new generation.
+        aspace->active_cpus_.fetch_or(cpu_bit);
+
+        ulong cr3 = phys;
+        if (aspace->pcid_ != 0) {
+            cr3 |= aspace->pcid_;
+            uint64_t generation = aspace->tlb_generation_.load();
+            if (aspace->cpu_tlb_generation_[cpu] == generation) {
+                // Nothing changed since this cpu last flushed the PCID.
+                cr3 |= X86_CR3_NOFLUSH;
+            } else {
+                aspace->cpu_tlb_generation_[cpu] = generation;
+                kcounter_add(tlb_pcid_flushes, 1);
+            }
+        }
+        x86_set_cr3(cr3);
 
         if (old_aspace != nullptr) {
             old_aspace->active_cpus_.fetch_and(~cpu_bit);
         }
-        aspace->active_cpus_.fetch_or(cpu_bit);
     } else {
         LTRACEF_LEVEL(3, "switching to kernel aspace, pt %#" PRIxPTR "\n", kernel_pt_phys);
         x86_set_cr3(kernel_pt_phys);
@@ -631,6 +736,8 @@ void x86_mmu_percpu_init(void) {
         cr4 |= X86_CR4_SMEP;
     if (x86_feature_test(X86_FEATURE_SMAP))
         cr4 |= X86_CR4_SMAP;
+    if (pcid_enabled)
+        cr4 |= X86_CR4_PCIDE;
     x86_set_cr4(cr4);
 
     // Set NXE bit in X86_MSR_IA32_EFER.
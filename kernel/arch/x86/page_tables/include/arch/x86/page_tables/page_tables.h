@@ -7,7 +7,9 @@
 #pragma once
 
 #include <fbl/canary.h>
+#include <fbl/macros.h>
 #include <fbl/mutex.h>
+#include <list.h>
 
 typedef uint64_t pt_entry_t;
 #define PRIxPTE PRIx64
@@ -20,6 +22,43 @@ enum PageTableLevel {
     PML4_L,
 };
 
+// The TLB invalidations needed by a single page table operation.  They are
+// gathered while the tables are changed and sent to the other cpus as one
+// batch at the end, instead of one round of IPIs per entry.
+struct PendingTlbInvalidation {
+    struct Item {
+        vaddr_t vaddr;
+        PageTableLevel level;
+        bool is_global;
+        bool is_terminal;
+    };
+
+    PendingTlbInvalidation();
+    ~PendingTlbInvalidation();
+
+    // Add address |v|, translated at depth |level|, to the set of addresses to
+    // be invalidated.
+    void enqueue(vaddr_t v, PageTableLevel level, bool is_global_page, bool is_terminal);
+
+    // Forget everything that was enqueued.
+    void clear();
+
+    // If true, ignore |items| and invalidate everything in the context.
+    bool full_shootdown = false;
+    // If true, at least one enqueued entry was for a global page.
+    bool contains_global = false;
+    // Number of valid elements in |items|.
+    uint count = 0;
+    Item items[32];
+
+    // Page table pages removed by the operation.  They can only be freed once
+    // the invalidation is done, since other cpus may still be walking them.
+    list_node freed_pages;
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(PendingTlbInvalidation);
+};
+
 class X86PageTableBase {
 public:
     X86PageTableBase();
@@ -74,9 +113,8 @@ protected:
     // Return the hardware flags to use on smaller pages after a splitting a
     // large page with flags |flags|.
     virtual PtFlags split_flags(PageTableLevel level, PtFlags flags) = 0;
-    // Invalidate a single page at the given level
-    virtual void TlbInvalidatePage(PageTableLevel level, vaddr_t vaddr, bool global_page,
-                                   bool was_terminal) = 0;
+    // Perform the TLB invalidations in |pending|
+    virtual void TlbInvalidate(PendingTlbInvalidation* pending) = 0;
     // Convert PtFlags to ARCH_MMU_* flags.
     virtual uint pt_flags_to_mmu_flags(PtFlags flags, PageTableLevel level) = 0;
     // Returns true if a cache flush is necessary for pagetable changes to be
@@ -102,24 +140,30 @@ private:
 
     zx_status_t AddMapping(volatile pt_entry_t* table, uint mmu_flags,
                            PageTableLevel level, const MappingCursor& start_cursor,
-                           MappingCursor* new_cursor) TA_REQ(lock_);
+                           MappingCursor* new_cursor,
+                           PendingTlbInvalidation* pending) TA_REQ(lock_);
     zx_status_t AddMappingL0(volatile pt_entry_t* table, uint mmu_flags,
                              const MappingCursor& start_cursor,
-                             MappingCursor* new_cursor) TA_REQ(lock_);
+                             MappingCursor* new_cursor,
+                             PendingTlbInvalidation* pending) TA_REQ(lock_);
 
     bool RemoveMapping(volatile pt_entry_t* table,
                        PageTableLevel level, const MappingCursor& start_cursor,
-                       MappingCursor* new_cursor) TA_REQ(lock_);
+                       MappingCursor* new_cursor,
+                       PendingTlbInvalidation* pending) TA_REQ(lock_);
     bool RemoveMappingL0(volatile pt_entry_t* table,
                          const MappingCursor& start_cursor,
-                         MappingCursor* new_cursor) TA_REQ(lock_);
+                         MappingCursor* new_cursor,
+                         PendingTlbInvalidation* pending) TA_REQ(lock_);
 
     zx_status_t UpdateMapping(volatile pt_entry_t* table, uint mmu_flags,
                               PageTableLevel level, const MappingCursor& start_cursor,
-                              MappingCursor* new_cursor) TA_REQ(lock_);
+                              MappingCursor* new_cursor,
+                              PendingTlbInvalidation* pending) TA_REQ(lock_);
     zx_status_t UpdateMappingL0(volatile pt_entry_t* table, uint mmu_flags,
                                 const MappingCursor& start_cursor,
-                                MappingCursor* new_cursor) TA_REQ(lock_);
+                                MappingCursor* new_cursor,
+                                PendingTlbInvalidation* pending) TA_REQ(lock_);
 
     zx_status_t GetMapping(volatile pt_entry_t* table, vaddr_t vaddr,
                            PageTableLevel level,
@@ -130,15 +174,18 @@ private:
                              volatile pt_entry_t** mapping) TA_REQ(lock_);
 
     zx_status_t SplitLargePage(PageTableLevel level, vaddr_t vaddr,
-                               volatile pt_entry_t* pte) TA_REQ(lock_);
+                               volatile pt_entry_t* pte,
+                               PendingTlbInvalidation* pending) TA_REQ(lock_);
 
-    void UpdateEntry(CacheLineFlusher* flusher,
+    void UpdateEntry(CacheLineFlusher* flusher, PendingTlbInvalidation* pending,
                      PageTableLevel level, vaddr_t vaddr, volatile pt_entry_t* pte,
                      paddr_t paddr, PtFlags flags, bool was_terminal) TA_REQ(lock_);
-    void UnmapEntry(CacheLineFlusher* flusher,
+    void UnmapEntry(CacheLineFlusher* flusher, PendingTlbInvalidation* pending,
                     PageTableLevel level, vaddr_t vaddr, volatile pt_entry_t* pte,
                     bool was_terminal) TA_REQ(lock_);
 
+    void FlushPending(PendingTlbInvalidation* pending) TA_REQ(lock_);
+
     fbl::Canary<fbl::magic("X86P")> canary_;
 
     // low lock to protect the mmu code
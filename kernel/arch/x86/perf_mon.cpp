@@ -41,9 +41,11 @@
 #include <arch/mmu.h>
 #include <arch/x86.h>
 #include <arch/x86/apic.h>
+#include <arch/x86/descriptor.h>
 #include <arch/x86/feature.h>
 #include <arch/x86/mmu.h>
 #include <arch/x86/perf_mon.h>
+#include <arch/x86/user_copy.h>
 #include <assert.h>
 #include <dev/pci_common.h>
 #include <err.h>
@@ -157,7 +159,8 @@ static_assert(1
 static uint64_t kGlobalCtrlWritableBits;
 static uint64_t kFixedCounterCtrlWritableBits;
 
-static constexpr size_t kMaxRecordSize = sizeof(cpuperf_pc_record_t);
+static constexpr size_t kMaxRecordSize =
+    CPUPERF_CALLSTACK_RECORD_SIZE(CPUPERF_MAX_CALLSTACK_FRAMES);
 
 // Commented out values represent currently unsupported features.
 // They remain present for documentation purposes.
@@ -576,6 +579,49 @@ static cpuperf_record_header_t* x86_perfmon_write_pc_record(
     return reinterpret_cast<cpuperf_record_header_t*>(rec);
 }
 
+// Follows the frame pointer chain of the interrupted user thread. Frames
+// that aren't mapped in, or that don't lead further up the stack, end it.
+static uint32_t x86_perfmon_read_user_callstack(const x86_iframe_t* frame,
+                                                uint64_t* frames) {
+    uint64_t fp = frame->rbp;
+    uint32_t num_frames = 0;
+    while (num_frames < CPUPERF_MAX_CALLSTACK_FRAMES) {
+        if (fp == 0 || fp % sizeof(uint64_t) != 0)
+            break;
+        // The saved frame pointer and the return address.
+        uint64_t pair[2];
+        if (x86_copy_from_user_nofault(pair, reinterpret_cast<void*>(fp), sizeof(pair)) != ZX_OK)
+            break;
+        if (pair[1] == 0)
+            break;
+        frames[num_frames++] = pair[1];
+        if (pair[0] <= fp)
+            break;
+        fp = pair[0];
+    }
+    return num_frames;
+}
+
+static cpuperf_record_header_t* x86_perfmon_write_callstack_record(
+        cpuperf_record_header_t* hdr,
+        cpuperf_event_id_t event, const x86_iframe_t* frame) {
+    auto rec = reinterpret_cast<cpuperf_callstack_record_t*>(hdr);
+    x86_perfmon_write_header(&rec->header, CPUPERF_RECORD_CALLSTACK, event);
+    thread_t* thread = get_current_thread();
+    rec->pid = thread->user_pid;
+    rec->tid = thread->user_tid;
+    rec->pc = frame->ip;
+    rec->num_frames = 0;
+    // The frames follow the record, which may not leave them aligned.
+    if (SELECTOR_PL(frame->cs) != 0) {
+        uint64_t frames[CPUPERF_MAX_CALLSTACK_FRAMES];
+        rec->num_frames = x86_perfmon_read_user_callstack(frame, frames);
+        memcpy(rec + 1, frames, rec->num_frames * sizeof(uint64_t));
+    }
+    return reinterpret_cast<cpuperf_record_header_t*>(
+        reinterpret_cast<char*>(rec) + CPUPERF_CALLSTACK_RECORD_SIZE(rec->num_frames));
+}
+
 zx_status_t x86_ipm_get_properties(zx_x86_ipm_properties_t* props) {
     fbl::AutoLock al(&perfmon_lock);
 
@@ -702,6 +748,11 @@ static zx_status_t x86_ipm_verify_fixed_config(
                 TRACEF("Unused bits set in |fixed_flags[%u]|\n", i);
                 return ZX_ERR_INVALID_ARGS;
             }
+            if ((config->fixed_flags[i] & IPM_CONFIG_FLAG_PC) &&
+                    (config->fixed_flags[i] & IPM_CONFIG_FLAG_CALLSTACK)) {
+                TRACEF("Both pc and callstack requested for |fixed_flags[%u]|\n", i);
+                return ZX_ERR_INVALID_ARGS;
+            }
             if ((config->fixed_flags[i] & IPM_CONFIG_FLAG_TIMEBASE) &&
                     config->timebase_id == CPUPERF_EVENT_ID_NONE) {
                 TRACEF("Timebase requested for |fixed_flags[%u]|, but not provided\n", i);
@@ -760,6 +811,11 @@ static zx_status_t x86_ipm_verify_programmable_config(
                 TRACEF("Unused bits set in |programmable_flags[%u]|\n", i);
                 return ZX_ERR_INVALID_ARGS;
             }
+            if ((config->programmable_flags[i] & IPM_CONFIG_FLAG_PC) &&
+                    (config->programmable_flags[i] & IPM_CONFIG_FLAG_CALLSTACK)) {
+                TRACEF("Both pc and callstack requested for |programmable_flags[%u]|\n", i);
+                return ZX_ERR_INVALID_ARGS;
+            }
             if ((config->programmable_flags[i] & IPM_CONFIG_FLAG_TIMEBASE) &&
                     config->timebase_id == CPUPERF_EVENT_ID_NONE) {
                 TRACEF("Timebase requested for |programmable_flags[%u]|, but not provided\n", i);
@@ -801,7 +857,7 @@ static zx_status_t x86_ipm_verify_misc_config(
             }
             // Currently we only support the MCHBAR counters.
             // They cannot provide pc. We ignore the OS/USER bits.
-            if (config->misc_flags[i] & IPM_CONFIG_FLAG_PC) {
+            if (config->misc_flags[i] & (IPM_CONFIG_FLAG_PC | IPM_CONFIG_FLAG_CALLSTACK)) {
                 TRACEF("Invalid bits (0x%x) in |misc_flags[%u]|\n",
                        config->misc_flags[i], i);
                 return ZX_ERR_INVALID_ARGS;
@@ -1769,7 +1825,9 @@ static bool pmi_interrupt_handler(x86_iframe_t *frame, PerfmonState* state) {
             } else if (state->programmable_flags[i] & IPM_CONFIG_FLAG_TIMEBASE) {
                 continue;
             }
-            if (state->programmable_flags[i] & IPM_CONFIG_FLAG_PC) {
+            if (state->programmable_flags[i] & IPM_CONFIG_FLAG_CALLSTACK) {
+                next = x86_perfmon_write_callstack_record(next, id, frame);
+            } else if (state->programmable_flags[i] & IPM_CONFIG_FLAG_PC) {
                 next = x86_perfmon_write_pc_record(next, id, cr3, frame->ip);
             } else {
                 next = x86_perfmon_write_tick_record(next, id);
@@ -1793,7 +1851,9 @@ static bool pmi_interrupt_handler(x86_iframe_t *frame, PerfmonState* state) {
             } else if (state->fixed_flags[i] & IPM_CONFIG_FLAG_TIMEBASE) {
                 continue;
             }
-            if (state->fixed_flags[i] & IPM_CONFIG_FLAG_PC) {
+            if (state->fixed_flags[i] & IPM_CONFIG_FLAG_CALLSTACK) {
+                next = x86_perfmon_write_callstack_record(next, id, frame);
+            } else if (state->fixed_flags[i] & IPM_CONFIG_FLAG_PC) {
                 next = x86_perfmon_write_pc_record(next, id, cr3, frame->ip);
             } else {
                 next = x86_perfmon_write_tick_record(next, id);
@@ -18,19 +18,19 @@
 // IPT tracing has two "modes":
 // - per-cpu tracing
 // - thread-specific tracing
-// Tracing can only be done in one mode at a time. This is because saving/
-// restoring thread PT state via the xsaves/xrstors instructions is a global
-// flag in the XSS msr.
-// Plus once a trace has been done with IPT_TRACE_THREADS one cannot go back
-// to IPT_TRACE_CPUS: supporting this requires flushing trace state from all
-// threads which is a bit of work. For now it's easy enough to just require
-// the user to reboot. ZX-892
+// Tracing can only be done in one mode at a time.
+// Thread-specific tracing keeps each traced thread's PT msrs in its
+// x86_ipt_thread_trace while it's switched out, and x86_ipt_context_switch()
+// swaps them in and out of the msrs. Only threads being traced pay for this.
+// The xsaves/xrstors support for PT state (XSS.PT) isn't used: there's no
+// way yet to write a thread's PT state into its compacted xsave area.
 
 #include <arch/arch_ops.h>
 #include <arch/mmu.h>
 #include <arch/x86.h>
 #include <arch/x86/feature.h>
 #include <arch/x86/mmu.h>
+#include <arch/x86/mp.h>
 #include <arch/x86/proc_trace.h>
 #include <err.h>
 #include <fbl/auto_lock.h>
@@ -98,10 +98,24 @@ struct ipt_cpu_state_t {
     } addr_ranges[IPT_MAX_NUM_ADDR_RANGES];
 };
 
+// A trace of one thread in IPT_TRACE_THREADS mode. Its msrs live here while
+// the thread is switched out, or while its tracing is paused.
+struct x86_ipt_thread_trace {
+    ipt_cpu_state_t state;
+    // The thread being traced, nullptr if none. mtrace holds a reference to
+    // its dispatcher until it is released, which keeps it around.
+    thread_t* thread;
+    // True if tracing of this thread was paused while tracing is active,
+    // so that its trace can be read.
+    bool paused;
+};
+
 static fbl::Mutex ipt_lock;
 
 static ipt_cpu_state_t* ipt_cpu_state TA_GUARDED(ipt_lock);
 
+static x86_ipt_thread_trace* ipt_thread_traces TA_GUARDED(ipt_lock);
+
 static bool active TA_GUARDED(ipt_lock) = false;
 
 static ipt_trace_mode_t trace_mode TA_GUARDED(ipt_lock) = IPT_TRACE_CPUS;
@@ -141,6 +155,67 @@ void arch_trace_process_create(uint64_t pid, paddr_t pt_phys) {
            (uint32_t)cr3, (uint32_t)(cr3 >> 32));
 }
 
+// Load the msrs from |state| and start tracing, with interrupts disabled.
+static void ipt_load_msrs(const ipt_cpu_state_t* state) {
+    DEBUG_ASSERT(arch_ints_disabled());
+    DEBUG_ASSERT(!(read_msr(IA32_RTIT_CTL) & IPT_CTL_TRACE_EN_MASK));
+
+    // Load the ToPA configuration
+    write_msr(IA32_RTIT_OUTPUT_BASE, state->output_base);
+    write_msr(IA32_RTIT_OUTPUT_MASK_PTRS, state->output_mask_ptrs);
+
+    // Load all other msrs, prior to enabling tracing.
+    write_msr(IA32_RTIT_STATUS, state->status);
+    if (supports_cr3_filtering)
+        write_msr(IA32_RTIT_CR3_MATCH, state->cr3_match);
+
+    // Enable the trace
+    write_msr(IA32_RTIT_CTL, state->ctl);
+}
+
+// Stop tracing and retrieve the msr values h/w updates into |state|, with
+// interrupts disabled. |state->ctl| is left for the caller.
+static void ipt_save_msrs(ipt_cpu_state_t* state) {
+    DEBUG_ASSERT(arch_ints_disabled());
+
+    // Disable the trace
+    write_msr(IA32_RTIT_CTL, 0);
+
+    // Retrieve msr values for later providing to userspace
+    state->status = read_msr(IA32_RTIT_STATUS);
+    state->output_base = read_msr(IA32_RTIT_OUTPUT_BASE);
+    state->output_mask_ptrs = read_msr(IA32_RTIT_OUTPUT_MASK_PTRS);
+
+    // Zero all MSRs so that we are in the XSAVE initial configuration.
+    // This allows h/w to do some optimizations regarding the state.
+    write_msr(IA32_RTIT_STATUS, 0);
+    write_msr(IA32_RTIT_OUTPUT_BASE, 0);
+    write_msr(IA32_RTIT_OUTPUT_MASK_PTRS, 0);
+    if (supports_cr3_filtering)
+        write_msr(IA32_RTIT_CR3_MATCH, 0);
+
+    // TODO(dje): Make it explicit that packets have been completely written.
+    // See Intel Vol 3 chapter 36.2.4.
+
+    // TODO(teisenbe): Clear ADDR* MSRs depending on leaf 1
+}
+
+// Sideband info needed by the trace reader.
+static void ipt_write_start_sideband() {
+    uint64_t kernel_cr3 = x86_kernel_cr3();
+    TRACEF("Starting processor trace, kernel cr3: 0x%" PRIxPTR "\n",
+           kernel_cr3);
+
+    uint64_t platform_msr = read_msr(IA32_PLATFORM_INFO);
+    unsigned nom_freq = (platform_msr >> 8) & 0xff;
+    ktrace(TAG_IPT_START, (uint32_t)nom_freq, 0,
+           (uint32_t)kernel_cr3, (uint32_t)(kernel_cr3 >> 32));
+    const struct x86_model_info* model_info = x86_get_model();
+    ktrace(TAG_IPT_CPU_INFO, model_info->processor_type,
+           model_info->display_family, model_info->display_model,
+           model_info->stepping);
+}
+
 // Worker for x86_ipt_alloc_trace to be executed on all cpus.
 // This is invoked via mp_sync_exec which thread safety analysis cannot follow.
 static void x86_ipt_set_mode_task(void* raw_context) TA_NO_THREAD_SAFETY_ANALYSIS {
@@ -148,10 +223,6 @@ static void x86_ipt_set_mode_task(void* raw_context) TA_NO_THREAD_SAFETY_ANALYSI
     DEBUG_ASSERT(!active);
 
     // When changing modes make sure all PT MSRs are in the init state.
-    // We don't want a value to appear in the xsave buffer and have xrstors
-    // #gp because XCOMP_BV has the PT bit set that's not set in XSS.
-    // We still need to do this, even with ZX-892, when transitioning
-    // from IPT_TRACE_CPUS to IPT_TRACE_THREADS.
     write_msr(IA32_RTIT_CTL, 0);
     write_msr(IA32_RTIT_STATUS, 0);
     write_msr(IA32_RTIT_OUTPUT_BASE, 0);
@@ -159,12 +230,6 @@ static void x86_ipt_set_mode_task(void* raw_context) TA_NO_THREAD_SAFETY_ANALYSI
     if (supports_cr3_filtering)
         write_msr(IA32_RTIT_CR3_MATCH, 0);
     // TODO(dje): addr range msrs
-
-    ipt_trace_mode_t new_mode = static_cast<ipt_trace_mode_t>(reinterpret_cast<uintptr_t>(raw_context));
-
-    // PT state saving, if supported, was enabled during boot so there's no
-    // need to recalculate the xsave space needed.
-    x86_set_extended_register_pt_state(new_mode == IPT_TRACE_THREADS);
 }
 
 zx_status_t x86_ipt_alloc_trace(ipt_trace_mode_t mode) {
@@ -176,16 +241,9 @@ zx_status_t x86_ipt_alloc_trace(ipt_trace_mode_t mode) {
         return ZX_ERR_NOT_SUPPORTED;
     if (active)
         return ZX_ERR_BAD_STATE;
-    if (ipt_cpu_state)
+    if (ipt_cpu_state || ipt_thread_traces)
         return ZX_ERR_BAD_STATE;
 
-    // ZX-892: We don't support changing the mode from IPT_TRACE_THREADS to
-    // IPT_TRACE_CPUS: We can't turn off XSS.PT until we're sure all threads
-    // have no PT state, and that's too tricky to do right now. Instead,
-    // require the developer to reboot.
-    if (trace_mode == IPT_TRACE_THREADS && mode == IPT_TRACE_CPUS)
-        return ZX_ERR_NOT_SUPPORTED;
-
     if (mode == IPT_TRACE_CPUS) {
         uint32_t num_cpus = arch_max_num_cpus();
         ipt_cpu_state =
@@ -194,12 +252,14 @@ zx_status_t x86_ipt_alloc_trace(ipt_trace_mode_t mode) {
         if (!ipt_cpu_state)
             return ZX_ERR_NO_MEMORY;
     } else {
-        // TODO(dje): support for IPT_TRACE_THREADS
-        return ZX_ERR_NOT_SUPPORTED;
+        ipt_thread_traces =
+            reinterpret_cast<x86_ipt_thread_trace*>(calloc(IPT_MAX_NUM_THREAD_TRACES,
+                                                           sizeof(*ipt_thread_traces)));
+        if (!ipt_thread_traces)
+            return ZX_ERR_NO_MEMORY;
     }
 
-    mp_sync_exec(MP_IPI_TARGET_ALL, 0, x86_ipt_set_mode_task,
-                 reinterpret_cast<void*>(static_cast<uintptr_t>(mode)));
+    mp_sync_exec(MP_IPI_TARGET_ALL, 0, x86_ipt_set_mode_task, nullptr);
 
     trace_mode = mode;
     return ZX_OK;
@@ -208,19 +268,23 @@ zx_status_t x86_ipt_alloc_trace(ipt_trace_mode_t mode) {
 // Free resources obtained by x86_ipt_alloc_trace().
 // This doesn't care if resources have already been freed to save callers
 // from having to care during any cleanup.
+// Threads still assigned to a trace are released.
 
 zx_status_t x86_ipt_free_trace() {
     AutoLock al(&ipt_lock);
 
     if (!supports_pt)
         return ZX_ERR_NOT_SUPPORTED;
-    if (trace_mode == IPT_TRACE_THREADS)
-        return ZX_ERR_BAD_STATE;
     if (active)
         return ZX_ERR_BAD_STATE;
 
     free(ipt_cpu_state);
     ipt_cpu_state = nullptr;
+
+    // Not being active no thread has its trace armed, see
+    // x86_ipt_thread_mode_stop().
+    free(ipt_thread_traces);
+    ipt_thread_traces = nullptr;
     return ZX_OK;
 }
 
@@ -231,21 +295,7 @@ static void x86_ipt_start_cpu_task(void* raw_context) TA_NO_THREAD_SAFETY_ANALYS
 
     ipt_cpu_state_t* context = reinterpret_cast<ipt_cpu_state_t*>(raw_context);
     uint32_t cpu = arch_curr_cpu_num();
-    ipt_cpu_state_t* state = &context[cpu];
-
-    DEBUG_ASSERT(!(read_msr(IA32_RTIT_CTL) & IPT_CTL_TRACE_EN_MASK));
-
-    // Load the ToPA configuration
-    write_msr(IA32_RTIT_OUTPUT_BASE, state->output_base);
-    write_msr(IA32_RTIT_OUTPUT_MASK_PTRS, state->output_mask_ptrs);
-
-    // Load all other msrs, prior to enabling tracing.
-    write_msr(IA32_RTIT_STATUS, state->status);
-    if (supports_cr3_filtering)
-        write_msr(IA32_RTIT_CR3_MATCH, state->cr3_match);
-
-    // Enable the trace
-    write_msr(IA32_RTIT_CTL, state->ctl);
+    ipt_load_msrs(&context[cpu]);
 }
 
 // Begin the trace.
@@ -262,10 +312,6 @@ zx_status_t x86_ipt_cpu_mode_start() {
     if (!ipt_cpu_state)
         return ZX_ERR_BAD_STATE;
 
-    uint64_t kernel_cr3 = x86_kernel_cr3();
-    TRACEF("Starting processor trace, kernel cr3: 0x%" PRIxPTR "\n",
-           kernel_cr3);
-
     if (LOCAL_TRACE) {
         uint32_t num_cpus = arch_max_num_cpus();
         for (uint32_t cpu = 0; cpu < num_cpus; ++cpu) {
@@ -278,15 +324,7 @@ zx_status_t x86_ipt_cpu_mode_start() {
 
     active = true;
 
-    // Sideband info needed by the trace reader.
-    uint64_t platform_msr = read_msr(IA32_PLATFORM_INFO);
-    unsigned nom_freq = (platform_msr >> 8) & 0xff;
-    ktrace(TAG_IPT_START, (uint32_t)nom_freq, 0,
-           (uint32_t)kernel_cr3, (uint32_t)(kernel_cr3 >> 32));
-    const struct x86_model_info* model_info = x86_get_model();
-    ktrace(TAG_IPT_CPU_INFO, model_info->processor_type,
-           model_info->display_family, model_info->display_model,
-           model_info->stepping);
+    ipt_write_start_sideband();
 
     mp_sync_exec(MP_IPI_TARGET_ALL, 0, x86_ipt_start_cpu_task, ipt_cpu_state);
     return ZX_OK;
@@ -301,27 +339,8 @@ static void x86_ipt_stop_cpu_task(void* raw_context) TA_NO_THREAD_SAFETY_ANALYSI
     uint32_t cpu = arch_curr_cpu_num();
     ipt_cpu_state_t* state = &context[cpu];
 
-    // Disable the trace
-    write_msr(IA32_RTIT_CTL, 0);
-
-    // Retrieve msr values for later providing to userspace
+    ipt_save_msrs(state);
     state->ctl = 0;
-    state->status = read_msr(IA32_RTIT_STATUS);
-    state->output_base = read_msr(IA32_RTIT_OUTPUT_BASE);
-    state->output_mask_ptrs = read_msr(IA32_RTIT_OUTPUT_MASK_PTRS);
-
-    // Zero all MSRs so that we are in the XSAVE initial configuration.
-    // This allows h/w to do some optimizations regarding the state.
-    write_msr(IA32_RTIT_STATUS, 0);
-    write_msr(IA32_RTIT_OUTPUT_BASE, 0);
-    write_msr(IA32_RTIT_OUTPUT_MASK_PTRS, 0);
-    if (supports_cr3_filtering)
-        write_msr(IA32_RTIT_CR3_MATCH, 0);
-
-    // TODO(dje): Make it explicit that packets have been completely written.
-    // See Intel Vol 3 chapter 36.2.4.
-
-    // TODO(teisenbe): Clear ADDR* MSRs depending on leaf 1
 }
 
 // This can be called while not active, so the caller doesn't have to care
@@ -407,3 +426,251 @@ zx_status_t x86_ipt_get_cpu_data(uint32_t cpu, zx_x86_pt_regs_t* regs) {
 
     return ZX_OK;
 }
+
+// Called by arch_context_switch() when this cpu has a thread trace loaded or
+// |new_thread| is being traced. Interrupts are disabled and the thread lock
+// is held, which keeps |new_thread->arch.ipt_trace| from changing under us.
+void x86_ipt_context_switch(thread_t* new_thread) {
+    DEBUG_ASSERT(arch_ints_disabled());
+
+    struct x86_percpu* percpu = x86_get_percpu();
+    if (percpu->ipt_trace) {
+        ipt_save_msrs(&percpu->ipt_trace->state);
+        percpu->ipt_trace = nullptr;
+    }
+
+    x86_ipt_thread_trace* trace = new_thread->arch.ipt_trace;
+    if (trace) {
+        ipt_load_msrs(&trace->state);
+        percpu->ipt_trace = trace;
+    }
+}
+
+// Arm or disarm the trace of a thread: an armed trace is loaded whenever its
+// thread is switched in.
+static void ipt_arm_thread_trace(x86_ipt_thread_trace* trace, bool arm) {
+    AutoThreadLock lock;
+    trace->thread->arch.ipt_trace = arm ? trace : nullptr;
+}
+
+// Start tracing the current thread if its trace was just armed, rather than
+// waiting for it to be switched in again.
+// This is invoked via mp_sync_exec which thread safety analysis cannot follow.
+static void x86_ipt_load_thread_task(void* raw_context) TA_NO_THREAD_SAFETY_ANALYSIS {
+    DEBUG_ASSERT(arch_ints_disabled());
+
+    struct x86_percpu* percpu = x86_get_percpu();
+    x86_ipt_thread_trace* trace = get_current_thread()->arch.ipt_trace;
+    if (trace && percpu->ipt_trace != trace) {
+        DEBUG_ASSERT(!percpu->ipt_trace);
+        ipt_load_msrs(&trace->state);
+        percpu->ipt_trace = trace;
+    }
+}
+
+// Unload the thread trace |raw_context| from the cpu, or any thread trace if
+// it's nullptr, once the trace was disarmed.
+// This is invoked via mp_sync_exec which thread safety analysis cannot follow.
+static void x86_ipt_save_thread_task(void* raw_context) TA_NO_THREAD_SAFETY_ANALYSIS {
+    DEBUG_ASSERT(arch_ints_disabled());
+
+    struct x86_percpu* percpu = x86_get_percpu();
+    x86_ipt_thread_trace* only = reinterpret_cast<x86_ipt_thread_trace*>(raw_context);
+    if (percpu->ipt_trace && (!only || percpu->ipt_trace == only)) {
+        ipt_save_msrs(&percpu->ipt_trace->state);
+        percpu->ipt_trace = nullptr;
+    }
+}
+
+static zx_status_t ipt_get_thread_trace(uint32_t descriptor, x86_ipt_thread_trace** out_trace)
+    TA_REQ(ipt_lock) {
+    if (!supports_pt)
+        return ZX_ERR_NOT_SUPPORTED;
+    if (trace_mode != IPT_TRACE_THREADS)
+        return ZX_ERR_BAD_STATE;
+    if (!ipt_thread_traces)
+        return ZX_ERR_BAD_STATE;
+    if (descriptor >= IPT_MAX_NUM_THREAD_TRACES)
+        return ZX_ERR_INVALID_ARGS;
+
+    *out_trace = &ipt_thread_traces[descriptor];
+    return ZX_OK;
+}
+
+zx_status_t x86_ipt_assign_thread(uint32_t descriptor, thread_t* thread) {
+    AutoLock al(&ipt_lock);
+
+    x86_ipt_thread_trace* trace;
+    zx_status_t status = ipt_get_thread_trace(descriptor, &trace);
+    if (status != ZX_OK)
+        return status;
+    if (active)
+        return ZX_ERR_BAD_STATE;
+    for (uint32_t i = 0; i < IPT_MAX_NUM_THREAD_TRACES; ++i) {
+        if (ipt_thread_traces[i].thread == thread)
+            return ZX_ERR_ALREADY_BOUND;
+    }
+    if (trace->thread)
+        return ZX_ERR_ALREADY_BOUND;
+
+    trace->thread = thread;
+    trace->paused = false;
+    return ZX_OK;
+}
+
+zx_status_t x86_ipt_release_thread(uint32_t descriptor, thread_t* thread) {
+    AutoLock al(&ipt_lock);
+
+    x86_ipt_thread_trace* trace;
+    zx_status_t status = ipt_get_thread_trace(descriptor, &trace);
+    if (status != ZX_OK)
+        return status;
+    if (active)
+        return ZX_ERR_BAD_STATE;
+    if (trace->thread != thread)
+        return ZX_ERR_INVALID_ARGS;
+
+    trace->thread = nullptr;
+    return ZX_OK;
+}
+
+zx_status_t x86_ipt_stage_thread_data(uint32_t descriptor, const zx_x86_pt_regs_t* regs) {
+    AutoLock al(&ipt_lock);
+
+    x86_ipt_thread_trace* trace;
+    zx_status_t status = ipt_get_thread_trace(descriptor, &trace);
+    if (status != ZX_OK)
+        return status;
+    if (active && !trace->paused)
+        return ZX_ERR_BAD_STATE;
+
+    trace->state.ctl = regs->ctl;
+    trace->state.status = regs->status;
+    trace->state.output_base = regs->output_base;
+    trace->state.output_mask_ptrs = regs->output_mask_ptrs;
+    trace->state.cr3_match = regs->cr3_match;
+    static_assert(sizeof(trace->state.addr_ranges) == sizeof(regs->addr_ranges), "addr_ranges size mismatch");
+    memcpy(trace->state.addr_ranges, regs->addr_ranges, sizeof(regs->addr_ranges));
+
+    return ZX_OK;
+}
+
+zx_status_t x86_ipt_get_thread_data(uint32_t descriptor, zx_x86_pt_regs_t* regs) {
+    AutoLock al(&ipt_lock);
+
+    x86_ipt_thread_trace* trace;
+    zx_status_t status = ipt_get_thread_trace(descriptor, &trace);
+    if (status != ZX_OK)
+        return status;
+    if (active && !trace->paused)
+        return ZX_ERR_BAD_STATE;
+
+    regs->ctl = trace->state.ctl;
+    regs->status = trace->state.status;
+    regs->output_base = trace->state.output_base;
+    regs->output_mask_ptrs = trace->state.output_mask_ptrs;
+    regs->cr3_match = trace->state.cr3_match;
+    static_assert(sizeof(regs->addr_ranges) == sizeof(trace->state.addr_ranges), "addr_ranges size mismatch");
+    memcpy(regs->addr_ranges, trace->state.addr_ranges, sizeof(regs->addr_ranges));
+
+    return ZX_OK;
+}
+
+// Begin tracing the assigned threads, wherever they run.
+
+zx_status_t x86_ipt_thread_mode_start() {
+    AutoLock al(&ipt_lock);
+
+    if (!supports_pt)
+        return ZX_ERR_NOT_SUPPORTED;
+    if (trace_mode != IPT_TRACE_THREADS)
+        return ZX_ERR_BAD_STATE;
+    if (active)
+        return ZX_ERR_BAD_STATE;
+    if (!ipt_thread_traces)
+        return ZX_ERR_BAD_STATE;
+
+    active = true;
+
+    ipt_write_start_sideband();
+
+    for (uint32_t i = 0; i < IPT_MAX_NUM_THREAD_TRACES; ++i) {
+        x86_ipt_thread_trace* trace = &ipt_thread_traces[i];
+        if (trace->thread) {
+            LTRACEF("Trace %u: ctl 0x%" PRIx64 ", base 0x%" PRIx64 ", mask 0x%" PRIx64 "\n",
+                    i, trace->state.ctl, trace->state.output_base,
+                    trace->state.output_mask_ptrs);
+            trace->paused = false;
+            ipt_arm_thread_trace(trace, true);
+        }
+    }
+
+    mp_sync_exec(MP_IPI_TARGET_ALL, 0, x86_ipt_load_thread_task, nullptr);
+    return ZX_OK;
+}
+
+// This can be called while not active, so the caller doesn't have to care
+// during any cleanup.
+
+zx_status_t x86_ipt_thread_mode_stop() {
+    AutoLock al(&ipt_lock);
+
+    if (!supports_pt)
+        return ZX_ERR_NOT_SUPPORTED;
+    if (trace_mode != IPT_TRACE_THREADS)
+        return ZX_ERR_BAD_STATE;
+    if (!ipt_thread_traces)
+        return ZX_ERR_BAD_STATE;
+
+    TRACEF("Stopping processor trace\n");
+
+    for (uint32_t i = 0; i < IPT_MAX_NUM_THREAD_TRACES; ++i) {
+        x86_ipt_thread_trace* trace = &ipt_thread_traces[i];
+        if (trace->thread)
+            ipt_arm_thread_trace(trace, false);
+        trace->paused = false;
+    }
+
+    // Disarmed traces are no longer loaded by a context switch, unload those
+    // of the threads running now.
+    mp_sync_exec(MP_IPI_TARGET_ALL, 0, x86_ipt_save_thread_task, nullptr);
+    ktrace(TAG_IPT_STOP, 0, 0, 0, 0);
+    active = false;
+    return ZX_OK;
+}
+
+// Stop tracing one thread while the others carry on, so that its trace can
+// be read: with a circular buffer this takes a snapshot of what the thread
+// was last up to.
+
+zx_status_t x86_ipt_pause_thread(uint32_t descriptor) {
+    AutoLock al(&ipt_lock);
+
+    x86_ipt_thread_trace* trace;
+    zx_status_t status = ipt_get_thread_trace(descriptor, &trace);
+    if (status != ZX_OK)
+        return status;
+    if (!active || !trace->thread || trace->paused)
+        return ZX_ERR_BAD_STATE;
+
+    ipt_arm_thread_trace(trace, false);
+    mp_sync_exec(MP_IPI_TARGET_ALL, 0, x86_ipt_save_thread_task, trace);
+    trace->paused = true;
+    return ZX_OK;
+}
+
+zx_status_t x86_ipt_resume_thread(uint32_t descriptor) {
+    AutoLock al(&ipt_lock);
+
+    x86_ipt_thread_trace* trace;
+    zx_status_t status = ipt_get_thread_trace(descriptor, &trace);
+    if (status != ZX_OK)
+        return status;
+    if (!active || !trace->paused)
+        return ZX_ERR_BAD_STATE;
+
+    trace->paused = false;
+    ipt_arm_thread_trace(trace, true);
+    mp_sync_exec(MP_IPI_TARGET_ALL, 0, x86_ipt_load_thread_task, nullptr);
+    return ZX_OK;
+}
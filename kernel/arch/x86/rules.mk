@@ -50,6 +50,7 @@ MODULE_SRCS += \
 	$(LOCAL_DIR)/gdt.S \
 	$(LOCAL_DIR)/header.S \
 	$(LOCAL_DIR)/hwp.cpp \
+	$(LOCAL_DIR)/idle.cpp \
 	$(LOCAL_DIR)/idt.cpp \
 	$(LOCAL_DIR)/ioapic.cpp \
 	$(LOCAL_DIR)/ioport.cpp \
@@ -63,6 +64,7 @@ MODULE_SRCS += \
 	$(LOCAL_DIR)/perf_mon.cpp \
 	$(LOCAL_DIR)/proc_trace.cpp \
 	$(LOCAL_DIR)/registers.cpp \
+	$(LOCAL_DIR)/spinlock.cpp \
 	$(LOCAL_DIR)/start.S \
 	$(LOCAL_DIR)/syscall.S \
 	$(LOCAL_DIR)/thread.cpp \
@@ -77,6 +79,7 @@ MODULE_DEPS += \
 	kernel/dev/iommu/dummy \
 	kernel/lib/bitmap \
 	kernel/lib/code_patching \
+	kernel/lib/counters \
 	kernel/lib/fbl \
 	kernel/object
 
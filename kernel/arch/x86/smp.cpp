@@ -12,6 +12,7 @@
 #include <arch/x86.h>
 #include <arch/x86/apic.h>
 #include <arch/x86/bootstrap16.h>
+#include <arch/x86/cpu_topology.h>
 #include <arch/x86/descriptor.h>
 #include <arch/x86/mmu_mem_types.h>
 #include <arch/x86/mp.h>
@@ -31,6 +32,8 @@ void x86_init_smp(uint32_t* apic_ids, uint32_t num_cpus) {
         return;
     }
 
+    x86_cpu_topology_init_sched_domains(apic_ids, num_cpus);
+
     lk_init_secondary_cpus(num_cpus - 1);
 }
 
@@ -0,0 +1,84 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <arch/ops.h>
+#include <arch/spinlock.h>
+#include <arch/x86/mp.h>
+#include <kernel/stats.h>
+#include <platform.h>
+
+// We need to disable thread safety analysis in this file, since we're
+// implementing the locks themselves.  Without this, the header-level
+// annotations cause Clang to detect violations.
+
+namespace {
+
+constexpr uint32_t kNextTicket = 1u << 16;
+
+inline uint16_t serving(uint32_t tickets) { return static_cast<uint16_t>(tickets); }
+inline uint16_t next(uint32_t tickets) { return static_cast<uint16_t>(tickets >> 16); }
+
+__NO_INLINE void wait_for_ticket(spin_lock_t* lock, uint16_t ticket) {
+    uint64_t start = arch_cycle_count();
+
+    while (serving(__atomic_load_n(&lock->tickets, __ATOMIC_ACQUIRE)) != ticket) {
+        arch_spinloop_pause();
+    }
+
+    CPU_STATS_INC(spin_contended);
+    CPU_STATS_ADD(spin_wait_cycles, arch_cycle_count() - start);
+}
+
+} // namespace
+
+void arch_spin_lock(spin_lock_t* lock) TA_NO_THREAD_SAFETY_ANALYSIS {
+#if WITH_LOCK_PROFILING
+    uint64_t wait_start = current_ticks();
+#endif
+    uint32_t tickets = __atomic_fetch_add(&lock->tickets, kNextTicket, __ATOMIC_ACQUIRE);
+
+    bool contended = serving(tickets) != next(tickets);
+    if (unlikely(contended)) {
+        wait_for_ticket(lock, next(tickets));
+    }
+
+#if WITH_LOCK_PROFILING
+    lockprof_acquired(&lock->prof, lock, LOCKPROF_KIND_SPIN,
+                      reinterpret_cast<uintptr_t>(__GET_CALLER()), wait_start, contended);
+#endif
+
+    __atomic_store_n(&lock->holder, arch_curr_cpu_num() + 1, __ATOMIC_RELAXED);
+}
+
+int arch_spin_trylock(spin_lock_t* lock) TA_NO_THREAD_SAFETY_ANALYSIS {
+    uint32_t tickets = __atomic_load_n(&lock->tickets, __ATOMIC_RELAXED);
+    if (serving(tickets) != next(tickets) ||
+        !__atomic_compare_exchange_n(&lock->tickets, &tickets, tickets + kNextTicket, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return 1;
+    }
+
+#if WITH_LOCK_PROFILING
+    lockprof_acquired(&lock->prof, lock, LOCKPROF_KIND_SPIN,
+                      reinterpret_cast<uintptr_t>(__GET_CALLER()), 0, false);
+#endif
+    __atomic_store_n(&lock->holder, arch_curr_cpu_num() + 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+void arch_spin_unlock(spin_lock_t* lock) TA_NO_THREAD_SAFETY_ANALYSIS {
+#if WITH_LOCK_PROFILING
+    lockprof_released(&lock->prof);
+#endif
+    __atomic_store_n(&lock->holder, 0u, __ATOMIC_RELAXED);
+
+    // Only the holder changes the low half, so it doesn't need a locked
+    // instruction, and a 16 bit add can't carry into the high half. Stores
+    // aren't reordered with older loads or stores, so this releases the lock.
+    __asm__ volatile("addw $1, %0" : "+m"(*reinterpret_cast<volatile uint16_t*>(&lock->tickets))
+                     :
+                     : "cc", "memory");
+}
@@ -11,6 +11,7 @@
 #include <arch/x86/descriptor.h>
 #include <arch/x86/feature.h>
 #include <arch/x86/mp.h>
+#include <arch/x86/proc_trace.h>
 #include <arch/x86/registers.h>
 #include <arch/x86/x86intrin.h>
 #include <assert.h>
@@ -64,6 +65,8 @@ void arch_thread_initialize(thread_t* t, vaddr_t entry_point) {
     // initialize the fs, gs and kernel bases to 0.
     t->arch.fs_base = 0;
     t->arch.gs_base = 0;
+
+    t->arch.ipt_trace = nullptr;
 }
 
 void arch_thread_construct_first(thread_t* t) {
@@ -86,6 +89,11 @@ void* arch_thread_get_blocked_fp(struct thread* t) {
 }
 
 __NO_SAFESTACK __attribute__((target("fsgsbase"))) void arch_context_switch(thread_t* oldthread, thread_t* newthread) {
+    /* Swap processor traces before anything else, to keep the context
+     * switch out of them as much as possible. */
+    if (unlikely(x86_get_percpu()->ipt_trace || newthread->arch.ipt_trace))
+        x86_ipt_context_switch(newthread);
+
     x86_extended_register_context_switch(oldthread, newthread);
 
     //printf("cs 0x%llx\n", kstack_top);
@@ -11,6 +11,7 @@
 #include <arch/user_copy.h>
 #include <arch/x86.h>
 #include <arch/x86/feature.h>
+#include <arch/x86/mp.h>
 #include <arch/x86/user_copy.h>
 #include <kernel/thread.h>
 #include <lib/code_patching.h>
@@ -21,6 +22,7 @@
 
 CODE_TEMPLATE(kStacInstruction, "stac");
 CODE_TEMPLATE(kClacInstruction, "clac");
+CODE_TEMPLATE(kRepMovsbInstruction, "rep movsb");
 static const uint8_t kNopInstruction = 0x90;
 
 extern "C" {
@@ -46,6 +48,25 @@ void fill_out_clac_instruction(const CodePatchInfo* patch) {
         memset(patch->dest_addr, kNopInstruction, kSize);
     }
 }
+
+// With fast short rep movsb there's no point in the unrolled small copy,
+// so the check that branches to it is removed.
+void x86_user_copy_select_small(const CodePatchInfo* patch) {
+    if (x86_feature_test(X86_FEATURE_FSRM)) {
+        memset(patch->dest_addr, kNopInstruction, patch->dest_size);
+    }
+}
+
+// The bulk copy defaults to rep movsq followed by rep movsb for the
+// tail.  With enhanced rep movsb a single rep movsb is at least as fast.
+void x86_user_copy_select_bulk(const CodePatchInfo* patch) {
+    if (x86_feature_test(X86_FEATURE_ERMS)) {
+        const size_t kSize = kRepMovsbInstructionEnd - kRepMovsbInstruction;
+        DEBUG_ASSERT(patch->dest_size >= kSize);
+        memcpy(patch->dest_addr, kRepMovsbInstruction, kSize);
+        memset(patch->dest_addr + kSize, kNopInstruction, patch->dest_size - kSize);
+    }
+}
 }
 
 static inline bool ac_flag(void) {
@@ -76,6 +97,17 @@ zx_status_t arch_copy_from_user(void* dst, const void* src, size_t len) {
     return status;
 }
 
+zx_status_t x86_copy_from_user_nofault(void* dst, const void* src, size_t len) {
+    DEBUG_ASSERT(arch_ints_disabled());
+
+    if (!can_access(src, len))
+        return ZX_ERR_INVALID_ARGS;
+
+    // The interrupted code may itself be copying from user memory, so this
+    // doesn't use the thread's fault return.
+    return _x86_copy_to_or_from_user(dst, src, len, &x86_get_percpu()->nofault_resume);
+}
+
 zx_status_t arch_copy_to_user(void* dst, const void* src, size_t len) {
     DEBUG_ASSERT(!ac_flag());
 
@@ -206,6 +206,30 @@ static zx_status_t gic_unmask_interrupt(unsigned int vector)
     return ZX_OK;
 }
 
+static zx_status_t gic_set_affinity(unsigned int vector, cpu_mask_t mask)
+{
+    // Only SPIs are routed by the distributor.
+    if ((vector >= max_irqs) || (vector < GIC_BASE_SPI))
+        return ZX_ERR_INVALID_ARGS;
+
+    // GICD_ITARGETSR holds a CPU interface mask per interrupt, and the
+    // distributor delivers to any one of the targeted interfaces.
+    uint32_t targets = mask & mp_get_online_mask() & 0xff;
+    if (!targets)
+        return ZX_ERR_INVALID_ARGS;
+
+    uint reg = vector / 4;
+    uint shift = (vector % 4) * 8;
+
+    spin_lock_saved_state_t state;
+    spin_lock_save(&gicd_lock, &state, GICD_LOCK_FLAGS);
+    gicd_itargetsr[reg] = (gicd_itargetsr[reg] & ~(0xffu << shift)) | (targets << shift);
+    GICREG(0, GICD_ITARGETSR(reg)) = gicd_itargetsr[reg];
+    spin_unlock_restore(&gicd_lock, state, GICD_LOCK_FLAGS);
+
+    return ZX_OK;
+}
+
 static zx_status_t gic_configure_interrupt(unsigned int vector,
                                            enum interrupt_trigger_mode tm,
                                            enum interrupt_polarity pol)
@@ -349,6 +373,7 @@ static const struct pdev_interrupt_ops gic_ops = {
     .get_config = gic_get_interrupt_config,
     .is_valid = gic_is_valid_interrupt,
     .remap = gic_remap_interrupt,
+    .set_affinity = gic_set_affinity,
     .send_ipi = gic_send_ipi,
     .init_percpu_early = gic_init_percpu_early,
     .init_percpu = gic_init_percpu,
@@ -169,4 +169,18 @@ void arm_gicv2m_mask_unmask_msi(const pcie_msi_block_t* block,
     else      unmask_interrupt(block->base_irq_id + msi_id);
 }
 
+zx_status_t arm_gicv2m_set_msi_affinity(pcie_msi_block_t* block, cpu_mask_t mask) {
+    DEBUG_ASSERT(block && block->allocated);
+
+    /* Each MSI is an SPI at the distributor, so the frame's doorbell address
+     * stays the same and the SPIs are routed instead. */
+    for (uint i = 0; i < block->num_irq; i++) {
+        zx_status_t status = set_interrupt_affinity(block->base_irq_id + i, mask);
+        if (status != ZX_OK)
+            return status;
+    }
+
+    return ZX_OK;
+}
+
 #endif  // WITH_DEV_PCIE
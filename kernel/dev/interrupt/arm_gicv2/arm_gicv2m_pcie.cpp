@@ -50,6 +50,10 @@ public:
                        bool                    mask) override {
         arm_gicv2m_mask_unmask_msi(block, msi_id, mask);
     }
+
+    zx_status_t SetMsiAffinity(pcie_msi_block_t* block, cpu_mask_t mask) override {
+        return arm_gicv2m_set_msi_affinity(block, mask);
+    }
 };
 
 static void arm_gicv2_pcie_init(mdi_node_ref_t* node, uint level) {
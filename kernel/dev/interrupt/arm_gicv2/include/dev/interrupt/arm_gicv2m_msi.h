@@ -52,6 +52,11 @@ void arm_gicv2m_mask_unmask_msi(const pcie_msi_block_t* block,
                                 uint                    msi_id,
                                 bool                    mask);
 
+/**
+ * @see PciePlatformInterface::SetMsiAffinity in dev/pcie_platform.h
+ */
+zx_status_t arm_gicv2m_set_msi_affinity(pcie_msi_block_t* block, cpu_mask_t mask);
+
 __END_CDECLS
 #endif  // WITH_DEV_PCIE
 
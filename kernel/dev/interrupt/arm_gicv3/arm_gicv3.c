@@ -224,6 +224,28 @@ static zx_status_t gic_unmask_interrupt(unsigned int vector)
     return ZX_OK;
 }
 
+static zx_status_t gic_set_affinity(unsigned int vector, cpu_mask_t mask)
+{
+    LTRACEF("vector %u mask %#x\n", vector, mask);
+
+    // Only SPIs are routed by the distributor.
+    if ((vector >= gic_max_int) || (vector < 32))
+        return ZX_ERR_INVALID_ARGS;
+
+    mask &= mp_get_online_mask();
+    if (!mask)
+        return ZX_ERR_INVALID_ARGS;
+
+    // Route to a single PE (IRM == 0), the lowest numbered one in the mask.
+    // 1-of-N distribution is optional in GICv3 and would be unable to honor
+    // any mask other than "all CPUs" anyway.
+    uint cpu = __builtin_ctz(mask);
+    uint64_t route = (arch_cpu_num_to_cluster_id(cpu) << 8) | arch_cpu_num_to_cpu_id(cpu);
+    GICREG64(0, GICD_IROUTER(vector)) = route;
+
+    return ZX_OK;
+}
+
 static zx_status_t gic_configure_interrupt(unsigned int vector,
                                            enum interrupt_trigger_mode tm,
                                            enum interrupt_polarity pol)
@@ -369,6 +391,7 @@ static const struct pdev_interrupt_ops gic_ops = {
     .get_config = gic_get_interrupt_config,
     .is_valid = gic_is_valid_interrupt,
     .remap = gic_remap_interrupt,
+    .set_affinity = gic_set_affinity,
     .send_ipi = gic_send_ipi,
     .init_percpu_early = gic_init_percpu_early,
     .init_percpu = gic_init_percpu,
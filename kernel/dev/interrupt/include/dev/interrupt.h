@@ -38,6 +38,11 @@ zx_status_t get_interrupt_config(unsigned int vector,
                                  enum interrupt_trigger_mode* tm,
                                  enum interrupt_polarity* pol);
 
+// Restrict delivery of the specified interrupt vector to the CPUs in |mask|.
+// The interrupt controller may deliver to any subset of the mask; controllers
+// which can only target a single CPU pick the lowest numbered online one.
+zx_status_t set_interrupt_affinity(unsigned int vector, cpu_mask_t mask);
+
 typedef enum handler_return (*int_handler)(void* arg);
 
 zx_status_t register_int_handler(unsigned int vector, int_handler handler, void* arg);
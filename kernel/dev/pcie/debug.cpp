@@ -17,6 +17,7 @@
 #include <dev/pcie_bridge.h>
 #include <dev/pcie_bus_driver.h>
 #include <dev/pcie_device.h>
+#include <dev/pcie_root.h>
 #include <fbl/algorithm.h>
 #include <fbl/auto_lock.h>
 
@@ -47,6 +48,7 @@ typedef struct lspci_params {
     uint func_id;
     uint cfg_dump_amt;
     bool force_dump_cfg;
+    bool scan_times;
     uint found;
 } lspci_params_t;
 
@@ -396,6 +398,12 @@ static void dump_pcie_bridge(const PcieBridge& bridge, lspci_params_t* params)
     LSPCI_PRINTF("Bridge Control    : 0x%04x\n", cfg->Read(PciConfig::kBridgeControl));
 }
 
+static void dump_scan_time(const PcieUpstreamNode& node)
+{
+    printf("Bus %02x scanned in %" PRIi64 " uSec\n",
+           node.managed_bus_id(), node.scan_time() / ZX_USEC(1));
+}
+
 static void dump_pcie_raw_config(uint amt, const PciConfig* cfg)
 {
     DEBUG_ASSERT(amt == PCIE_BASE_CONFIG_SIZE || amt == PCIE_EXTENDED_CONFIG_SIZE);
@@ -576,6 +584,10 @@ int PcieDebugConsole::CmdLsPci(int argc, const cmd_args *argv, uint32_t flags) {
                         params.verbose = true;
                         break;
 
+                    case 't':
+                        params.scan_times = true;
+                        break;
+
                     default:
                         confused = true;
                         break;
@@ -613,6 +625,7 @@ int PcieDebugConsole::CmdLsPci(int argc, const cmd_args *argv, uint32_t flags) {
 
         if (confused) {
             printf("usage: %s [-t] [-l] [<bus_id>] [<dev_id>] [<func_id>]\n", argv[0].str);
+            printf("       -t : Report how long the most recent scan of each bus took.\n");
             printf("       -l : Be verbose when dumping info about discovered devices.\n");
             printf("       -c : Dump raw standard config (implies -l)\n");
             printf("       -e : Dump raw extended config (implies -l -c)\n");
@@ -645,6 +658,20 @@ int PcieDebugConsole::CmdLsPci(int argc, const cmd_args *argv, uint32_t flags) {
         printf("PCIe scan discovered %u device%s\n", params.found, (params.found == 1) ? "" : "s");
     }
 
+    if (params.scan_times) {
+        bus_drv->ForeachRoot(
+            [](const fbl::RefPtr<PcieRoot>& root, void* ctx) -> bool {
+                dump_scan_time(*root);
+                return true;
+            }, nullptr);
+        bus_drv->ForeachDevice(
+            [](const fbl::RefPtr<PcieDevice>& dev, void* ctx, uint level) -> bool {
+                if (dev->is_bridge())
+                    dump_scan_time(*static_cast<PcieBridge*>(dev.get()));
+                return true;
+            }, nullptr);
+    }
+
     return ZX_OK;
 }
 
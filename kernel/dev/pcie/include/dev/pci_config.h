@@ -10,7 +10,7 @@
 #include <endian.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/ref_counted.h>
-#include <fbl/intrusive_single_list.h>
+#include <fbl/intrusive_wavl_tree.h>
 #include <dev/pci_common.h>
 
 class PciReg8 {
@@ -51,7 +51,7 @@ private:
 
 /* PciConfig supplies the factory for creating the appropriate pci config
  * object based on the address space of the pci device. */
-class PciConfig : public fbl::SinglyLinkedListable<fbl::RefPtr<PciConfig>>
+class PciConfig : public fbl::WAVLTreeContainable<fbl::RefPtr<PciConfig>>
                 , public fbl::RefCounted<PciConfig> {
 public:
     // Standard PCI configuration space values. Offsets from PCI Firmware Spec ch 6.
@@ -122,6 +122,9 @@ public:
     inline uintptr_t base() const { return base_; }
     inline PciAddrSpace addr_space() const { return addr_space_; }
 
+    // WAVLTree properties; the bus driver indexes its configs by base address.
+    uintptr_t GetKey() const { return base_; }
+
     // Virtuals
     void DumpConfig(uint16_t len) const;
     virtual uint8_t Read(const PciReg8 addr) const = 0;
@@ -138,3 +141,29 @@ protected:
     const PciAddrSpace addr_space_;
     const uintptr_t base_;
 };
+
+/* PciConfigShadow holds a copy of the registers in a function's base config
+ * space which cannot change while it stays enumerated; its IDs, class codes,
+ * header type and capability list links.  Reads of those registers may be
+ * served from the shadow instead of going out to the bus. */
+class PciConfigShadow {
+public:
+    /** Read a register from |cfg| and remember its value. */
+    uint8_t Capture(const PciConfig& cfg, const PciReg8 addr);
+    uint16_t Capture(const PciConfig& cfg, const PciReg16 addr);
+    uint32_t Capture(const PciConfig& cfg, const PciReg32 addr);
+
+    /** Fetch |width| (1, 2 or 4) bytes at |offset| from the shadow.
+     *
+     * @return true if every byte requested has been captured, false otherwise.
+     */
+    bool Read(uint16_t offset, size_t width, uint32_t* out_val) const;
+
+private:
+    static constexpr size_t kBitsPerWord = sizeof(uint64_t) * 8;
+
+    void Record(uint16_t offset, size_t width, uint32_t val);
+
+    uint8_t data_[PCIE_BASE_CONFIG_SIZE] = { };
+    uint64_t valid_[PCIE_BASE_CONFIG_SIZE / kBitsPerWord] = { };
+};
@@ -11,6 +11,7 @@
 #include <dev/pcie_platform.h>
 #include <kernel/auto_lock.h>
 #include <kernel/mutex.h>
+#include <fbl/atomic.h>
 #include <fbl/intrusive_single_list.h>
 #include <fbl/intrusive_wavl_tree.h>
 #include <fbl/macros.h>
@@ -180,11 +181,16 @@ public:
     static void        ShutdownDriver();
 
     // Debug/ASSERT routine, used by devices and bridges to assert that the
-    // rescan lock is currently being held.
-    bool RescanLockIsHeld() const { return bus_rescan_lock_.IsHeld(); };
+    // rescan lock is currently being held.  Threads helping a scan in parallel
+    // (see PcieUpstreamNode::ScanDownstream) run on behalf of the thread
+    // holding the lock, and pass as well.
+    bool RescanLockIsHeld() const {
+        return bus_rescan_lock_.IsHeld() || (scan_workers_.load() > 0);
+    }
 
 private:
     friend class PcieDebugConsole;
+    friend class PcieUpstreamNode;
     static constexpr size_t REGION_BOOKKEEPING_SLAB_SIZE = 16  << 10;
     static constexpr size_t REGION_BOOKKEEPING_MAX_MEM   = 128 << 10;
 
@@ -239,12 +245,20 @@ private:
 
     static void RunQuirks(const fbl::RefPtr<PcieDevice>& device);
 
+    // Parallel scanning support.  A scan may farm the subtrees below the
+    // bridges it discovers out to worker threads, up to one per CPU.
+    bool ClaimScanWorker();
+    void ReleaseScanWorker() { scan_workers_.fetch_sub(1u); }
+
     State                               state_ = State::NOT_STARTED;
     fbl::Mutex                         bus_topology_lock_;
     fbl::Mutex                         bus_rescan_lock_;
     mutable fbl::Mutex                 start_lock_;
     RootCollection                      roots_;
-    fbl::SinglyLinkedList<fbl::RefPtr<PciConfig>> configs_;
+    fbl::atomic<uint>                  scan_workers_{0u};
+
+    fbl::Mutex                         configs_lock_;
+    fbl::WAVLTree<uintptr_t, fbl::RefPtr<PciConfig>> configs_;
 
     bool                                is_mmio_ = true;
     RegionAllocator::RegionPool::RefPtr region_bookkeeping_;
@@ -280,6 +280,34 @@ public:
      */
     zx_status_t MaskUnmaskIrq(uint irq_id, bool mask);
 
+    /**
+     * Set the set of CPUs the specified IRQ may be delivered to.
+     *
+     * In LEGACY mode the IRQ is shared with other devices, and they are all
+     * moved along with this one.  In MSI mode every vector of the device
+     * shares a single target address, so the whole block is moved; vectors
+     * which were unmasked are unmasked again once the device has been
+     * reprogrammed.
+     *
+     * @param irq_id The ID of the IRQ to steer.
+     * @param mask The set of CPUs the IRQ may be delivered to.  The platform
+     * may deliver to any subset of it.
+     *
+     * @return A zx_status_t indicating the success or failure of the operation.
+     * Status codes may include (but are not limited to)...
+     *
+     * ++ ZX_ERR_UNAVAILABLE
+     *    The device has become unplugged and is waiting to be released.
+     * ++ ZX_ERR_BAD_STATE
+     *    The device is in the DISABLED IRQ mode.
+     * ++ ZX_ERR_INVALID_ARGS
+     *    The irq_id parameter is out of range for the currently configured
+     *    mode, or mask contains no online CPUs.
+     * ++ ZX_ERR_NOT_SUPPORTED
+     *    The platform cannot steer this kind of IRQ.
+     */
+    zx_status_t SetIrqAffinity(uint irq_id, cpu_mask_t mask);
+
     void SetQuirksDone() { quirks_done_ = true; }
 
     /**
@@ -289,6 +317,7 @@ public:
     zx_status_t UnmaskIrq(uint irq_id) { return MaskUnmaskIrq(irq_id, false); }
 
     const PciConfig*     config()      const { return cfg_; }
+    const PciConfigShadow& config_shadow() const { return cfg_shadow_; }
     paddr_t              config_phys() const { return cfg_phys_; }
     PcieBusDriver&       driver()            { return bus_drv_; }
 
@@ -358,6 +387,7 @@ protected:
     PcieBusDriver& bus_drv_;        // Reference to our bus driver state.
     const PciConfig*         cfg_ = nullptr;  // Pointer to the memory mapped ECAM (kernel vaddr)
     paddr_t        cfg_phys_ = 0;   // The physical address of the device's ECAM
+    PciConfigShadow cfg_shadow_;    // Read-only config registers captured during Init
     SpinLock       cmd_reg_lock_;   // Protection for access to the command register.
     const bool     is_bridge_;      // True if this device is also a bridge
     const uint     bus_id_;         // The bus ID this bridge/device exists on
@@ -393,6 +423,7 @@ private:
     zx_status_t SetIrqModeLocked(pcie_irq_mode_t mode, uint requested_irqs);
     zx_status_t RegisterIrqHandlerLocked(uint irq_id, pcie_irq_handler_fn_t handler, void* ctx);
     zx_status_t MaskUnmaskIrqLocked(uint irq_id, bool mask);
+    zx_status_t SetIrqAffinityLocked(uint irq_id, cpu_mask_t mask);
 
     // Internal Legacy IRQ support.
     zx_status_t MaskUnmaskLegacyIrq(bool mask);
@@ -409,6 +440,7 @@ private:
 
     bool        MaskUnmaskMsiIrqLocked(uint irq_id, bool mask);
     zx_status_t MaskUnmaskMsiIrq(uint irq_id, bool mask);
+    zx_status_t SetMsiAffinity(cpu_mask_t mask);
     void        MaskAllMsiVectors();
     void        SetMsiTarget(uint64_t tgt_addr, uint32_t tgt_data);
     void        FreeMsiBlock();
@@ -146,6 +146,20 @@ public:
         DEBUG_ASSERT(false);
     }
 
+    /**
+     * Method used to steer a block of MSIs to a set of CPUs.  Platforms either
+     * route the block's IRQs at the interrupt controller, or update the
+     * block's tgt_addr/tgt_data, in which case the bus driver reprograms the
+     * device.  Platforms which cannot steer MSIs need not override this.
+     *
+     * @param block A pointer to a block of MSIs allocated using a platform supplied
+     *        platform_alloc_msi_block_t callback.
+     * @param mask The set of CPUs the block's IRQs may be delivered to.
+     */
+    virtual zx_status_t SetMsiAffinity(pcie_msi_block_t* block, cpu_mask_t mask) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
     DISALLOW_COPY_ASSIGN_AND_MOVE(PciePlatformInterface);
 protected:
     enum class MsiSupportLevel { NONE, MSI, MSI_WITH_MASKING };
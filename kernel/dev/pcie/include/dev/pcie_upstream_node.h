@@ -41,6 +41,10 @@ public:
     Type type()           const { return type_; }
     uint managed_bus_id() const { return managed_bus_id_; }
 
+    // How long the most recent scan of this node's downstream bus took, not
+    // counting the buses behind any bridges found on it.
+    zx_time_t scan_time() const { return scan_time_; }
+
     virtual RegionAllocator& mmio_lo_regions() = 0;
     virtual RegionAllocator& mmio_hi_regions() = 0;
     virtual RegionAllocator& pio_regions() = 0;
@@ -60,10 +64,16 @@ protected:
     fbl::RefPtr<PcieDevice> ScanDevice(const PciConfig* cfg, uint dev_id, uint func_id);
 
 private:
+    static constexpr uint kMaxScanWorkersPerBus = 8;
+    static constexpr size_t kBridgeMapWords = PCIE_MAX_FUNCTIONS_PER_BUS / (sizeof(uint64_t) * 8);
+
+    void ScanBridgesDownstream(const uint64_t* bridge_map);
+    static int ScanDownstreamThread(void* ctx);
 
     PcieBusDriver& bus_drv_;         // TODO(johngro) : Eliminate this, see ZX-325
     const Type     type_;
     const uint     managed_bus_id_;  // The ID of the downstream bus which this node manages.
+    zx_time_t      scan_time_ = 0;
 
     // An array of pointers for all the possible functions which exist on the
     // downstream bus of this node.
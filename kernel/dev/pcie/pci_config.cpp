@@ -196,3 +196,48 @@ void PciConfig::DumpConfig(uint16_t len) const {
         } while (pos < PCIE_BASE_CONFIG_SIZE);
     }
 }
+
+void PciConfigShadow::Record(uint16_t offset, size_t width, uint32_t val) {
+    DEBUG_ASSERT(offset + width <= PCIE_BASE_CONFIG_SIZE);
+    for (size_t i = 0; i < width; i++, val >>= 8) {
+        size_t pos = offset + i;
+        data_[pos] = static_cast<uint8_t>(val & 0xFF);
+        valid_[pos / kBitsPerWord] |= 1ull << (pos % kBitsPerWord);
+    }
+}
+
+uint8_t PciConfigShadow::Capture(const PciConfig& cfg, const PciReg8 addr) {
+    uint8_t val = cfg.Read(addr);
+    Record(addr.offset(), sizeof(val), val);
+    return val;
+}
+
+uint16_t PciConfigShadow::Capture(const PciConfig& cfg, const PciReg16 addr) {
+    uint16_t val = cfg.Read(addr);
+    Record(addr.offset(), sizeof(val), val);
+    return val;
+}
+
+uint32_t PciConfigShadow::Capture(const PciConfig& cfg, const PciReg32 addr) {
+    uint32_t val = cfg.Read(addr);
+    Record(addr.offset(), sizeof(val), val);
+    return val;
+}
+
+bool PciConfigShadow::Read(uint16_t offset, size_t width, uint32_t* out_val) const {
+    if ((width != 1u && width != 2u && width != 4u) ||
+        (offset + width > PCIE_BASE_CONFIG_SIZE)) {
+        return false;
+    }
+
+    uint32_t val = 0;
+    for (size_t i = 0; i < width; i++) {
+        size_t pos = offset + i;
+        if (!(valid_[pos / kBitsPerWord] & (1ull << (pos % kBitsPerWord))))
+            return false;
+        val |= static_cast<uint32_t>(data_[pos]) << (8 * i);
+    }
+
+    *out_val = val;
+    return true;
+}
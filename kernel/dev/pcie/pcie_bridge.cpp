@@ -109,13 +109,11 @@ zx_status_t PcieBridge::Init(PcieUpstreamNode& upstream) {
         return res;
 
     // Things went well, flag the device as plugged in and link ourselves up to
-    // the graph.
+    // the graph.  The upstream node scanning us will scan our downstream bus
+    // once it is done with its own.
     plugged_in_ = true;
     driver().LinkDeviceToUpstream(*this, upstream);
 
-    // Release the device lock, then recurse and scan for downstream devices.
-    dev_lock.release();
-    ScanDownstream();
     return res;
 }
 
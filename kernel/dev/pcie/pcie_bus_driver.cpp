@@ -533,9 +533,10 @@ const PciConfig* PcieBusDriver::GetConfig(uint bus_id,
                                static_cast<uint8_t>(func_id), 0);
     }
 
-    auto cfg_iter = configs_.find_if([addr](const PciConfig& cfg) {
-                                        return (cfg.base() == addr);
-                                        });
+    // Every function probed during a scan passes through here, present or
+    // not, so the configs are indexed by address instead of searched.
+    AutoLock configs_lock(&configs_lock_);
+    auto cfg_iter = configs_.find(addr);
     /* An entry for this bdf config has been found in cache, return it */
     if (cfg_iter.IsValid()) {
         return &(*cfg_iter);
@@ -543,8 +544,26 @@ const PciConfig* PcieBusDriver::GetConfig(uint bus_id,
 
     // Nothing found, create a new PciConfig for this address
     auto cfg = PciConfig::Create(addr, (is_mmio_) ? PciAddrSpace::MMIO : PciAddrSpace::PIO);
-    configs_.push_front(cfg);
-    return cfg.get();
+    if (cfg == nullptr) {
+        return nullptr;
+    }
+
+    const PciConfig* ret = cfg.get();
+    configs_.insert(fbl::move(cfg));
+    return ret;
+}
+
+bool PcieBusDriver::ClaimScanWorker() {
+    uint max_workers = arch_max_num_cpus();
+    uint workers = scan_workers_.load();
+    do {
+        if (workers >= max_workers)
+            return false;
+    } while (!scan_workers_.compare_exchange_strong(&workers, workers + 1,
+                                                    fbl::memory_order_seq_cst,
+                                                    fbl::memory_order_seq_cst));
+
+    return true;
 }
 
 zx_status_t PcieBusDriver::AddEcamRegion(const EcamRegion& ecam) {
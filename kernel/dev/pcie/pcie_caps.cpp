@@ -276,7 +276,7 @@ inline zx_status_t validate_capability_offset(uint8_t offset) {
 
 zx_status_t PcieDevice::ParseStdCapabilitiesLocked() {
     zx_status_t res = ZX_OK;
-    uint8_t cap_offset = cfg_->Read(PciConfig::kCapabilitiesPtr);
+    uint8_t cap_offset = cfg_shadow_.Capture(*cfg_, PciConfig::kCapabilitiesPtr);
     uint8_t caps_found = 0;
     fbl::AllocChecker ac;
 
@@ -297,7 +297,7 @@ zx_status_t PcieDevice::ParseStdCapabilitiesLocked() {
             break;
         }
 
-        uint8_t id = cfg_->Read(PciReg8(cap_offset));
+        uint8_t id = cfg_shadow_.Capture(*cfg_, PciReg8(cap_offset));
 
         LTRACEF("Found capability (#%u, id = 0x%02x) for device %02x:%02x.%01x (%04hx:%04hx)\n",
                 caps_found, id,
@@ -331,7 +331,8 @@ zx_status_t PcieDevice::ParseStdCapabilitiesLocked() {
         }
 
         caps_.detected.push_front(fbl::unique_ptr<PciStdCapability>(cap));
-        cap_offset  = cfg_->Read(PciReg8(static_cast<uint16_t>(cap_offset + 0x1))) & 0xFC;
+        cap_offset  = cfg_shadow_.Capture(*cfg_,
+                                          PciReg8(static_cast<uint16_t>(cap_offset + 0x1))) & 0xFC;
         caps_found++;
     }
 
@@ -127,13 +127,21 @@ zx_status_t PcieDevice::InitLocked(PcieUpstreamNode& upstream) {
         return ZX_ERR_BAD_STATE;
     }
 
-    // Cache basic device info
-    vendor_id_ = cfg_->Read(PciConfig::kVendorId);
-    device_id_ = cfg_->Read(PciConfig::kDeviceId);
-    class_id_  = cfg_->Read(PciConfig::kBaseClass);
-    subclass_  = cfg_->Read(PciConfig::kSubClass);
-    prog_if_   = cfg_->Read(PciConfig::kProgramInterface);
-    rev_id_    = cfg_->Read(PciConfig::kRevisionId);
+    // Cache basic device info.  These registers (and the few other read-only
+    // ones captured below) are also kept in the config shadow, so that users
+    // reading them later don't have to go out to the bus.
+    vendor_id_ = cfg_shadow_.Capture(*cfg_, PciConfig::kVendorId);
+    device_id_ = cfg_shadow_.Capture(*cfg_, PciConfig::kDeviceId);
+    class_id_  = cfg_shadow_.Capture(*cfg_, PciConfig::kBaseClass);
+    subclass_  = cfg_shadow_.Capture(*cfg_, PciConfig::kSubClass);
+    prog_if_   = cfg_shadow_.Capture(*cfg_, PciConfig::kProgramInterface);
+    rev_id_    = cfg_shadow_.Capture(*cfg_, PciConfig::kRevisionId);
+    cfg_shadow_.Capture(*cfg_, PciConfig::kInterruptPin);
+    uint8_t header_type = cfg_shadow_.Capture(*cfg_, PciConfig::kHeaderType);
+    if ((header_type & PCI_HEADER_TYPE_MASK) == PCI_HEADER_TYPE_STANDARD) {
+        cfg_shadow_.Capture(*cfg_, PciConfig::kSubsystemVendorId);
+        cfg_shadow_.Capture(*cfg_, PciConfig::kSubsystemId);
+    }
 
     // Determine the details of each of the BARs, but do not actually allocate
     // space on the bus for them yet.
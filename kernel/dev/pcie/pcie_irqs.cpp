@@ -368,6 +368,42 @@ void PcieDevice::SetMsiTarget(uint64_t tgt_addr, uint32_t tgt_data) {
     cfg_->Write(irq_.msi->data_reg(), static_cast<uint16_t>(tgt_data & 0xFFFF));
 }
 
+zx_status_t PcieDevice::SetMsiAffinity(cpu_mask_t mask) {
+    DEBUG_ASSERT(irq_.mode == PCIE_IRQ_MODE_MSI);
+    DEBUG_ASSERT(irq_.msi->irq_block_.allocated);
+
+    pcie_msi_block_t* block = &irq_.msi->irq_block_;
+    uint64_t old_addr = block->tgt_addr;
+    uint32_t old_data = block->tgt_data;
+    zx_status_t res = bus_drv_.platform().SetMsiAffinity(block, mask);
+    if (res != ZX_OK)
+        return res;
+
+    /* Platforms which route MSIs at the interrupt controller leave the
+     * device's target alone; there is nothing to reprogram. */
+    if ((block->tgt_addr == old_addr) && (block->tgt_data == old_data))
+        return ZX_OK;
+
+    /* SetMsiTarget disables MSI and masks every vector before touching the
+     * address register, so remember which vectors need to come back. */
+    uint32_t unmasked = 0;
+    for (uint i = 0; i < irq_.handler_count; i++) {
+        AutoSpinLockIrqSave handler_lock(&irq_.handlers[i].lock);
+        if (!irq_.handlers[i].masked)
+            unmasked |= (static_cast<uint32_t>(1u) << i);
+    }
+
+    SetMsiTarget(block->tgt_addr, block->tgt_data);
+
+    for (uint i = 0; i < irq_.handler_count; i++) {
+        if (unmasked & (static_cast<uint32_t>(1u) << i))
+            MaskUnmaskMsiIrq(i, false);
+    }
+    SetMsiEnb(true);
+
+    return ZX_OK;
+}
+
 void PcieDevice::FreeMsiBlock() {
     /* If no block has been allocated, there is nothing to do */
     if (!irq_.msi->irq_block_.allocated)
@@ -748,6 +784,29 @@ zx_status_t PcieDevice::MaskUnmaskIrqLocked(uint irq_id, bool mask) {
     return ZX_OK;
 }
 
+zx_status_t PcieDevice::SetIrqAffinityLocked(uint irq_id, cpu_mask_t mask) {
+    DEBUG_ASSERT(plugged_in_);
+    DEBUG_ASSERT(dev_lock_.IsHeld());
+
+    if (irq_.mode == PCIE_IRQ_MODE_DISABLED)
+        return ZX_ERR_BAD_STATE;
+
+    DEBUG_ASSERT(irq_.handlers);
+    DEBUG_ASSERT(irq_.handler_count);
+
+    if (irq_id >= irq_.handler_count)
+        return ZX_ERR_INVALID_ARGS;
+
+    switch (irq_.mode) {
+    case PCIE_IRQ_MODE_LEGACY: return set_interrupt_affinity(irq_.legacy.irq_id, mask);
+    case PCIE_IRQ_MODE_MSI:    return SetMsiAffinity(mask);
+    case PCIE_IRQ_MODE_MSI_X:  return ZX_ERR_NOT_SUPPORTED;
+    default:
+        DEBUG_ASSERT(false); /* This should be un-possible! */
+        return ZX_ERR_INTERNAL;
+    }
+}
+
 /******************************************************************************
  *
  * Kernel API; prototypes in dev/pcie_irqs.h
@@ -800,6 +859,14 @@ zx_status_t PcieDevice::MaskUnmaskIrq(uint irq_id, bool mask) {
         : ZX_ERR_BAD_STATE;
 }
 
+zx_status_t PcieDevice::SetIrqAffinity(uint irq_id, cpu_mask_t mask) {
+    AutoLock dev_lock(&dev_lock_);
+
+    return (plugged_in_ && !disabled_)
+        ? SetIrqAffinityLocked(irq_id, mask)
+        : ZX_ERR_BAD_STATE;
+}
+
 
 // Map from a device's interrupt pin ID to the proper system IRQ ID.  Follow the
 // PCIe graph up to the root, swizzling as we traverse PCIe switches,
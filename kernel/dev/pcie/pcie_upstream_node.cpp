@@ -12,6 +12,7 @@
 #include <inttypes.h>
 #include <kernel/mutex.h>
 #include <kernel/spinlock.h>
+#include <kernel/thread.h>
 #include <vm/vm.h>
 #include <lk/init.h>
 #include <fbl/algorithm.h>
@@ -69,6 +70,11 @@ void PcieUpstreamNode::UnplugDownstream() {
 void PcieUpstreamNode::ScanDownstream() {
     DEBUG_ASSERT(driver().RescanLockIsHeld());
 
+    // The bridges found on this bus.  The buses behind them are scanned once
+    // we are finished with this one.
+    uint64_t bridge_map[kBridgeMapWords] = { };
+    zx_time_t start = current_time();
+
     for (uint dev_id = 0; dev_id < PCIE_MAX_DEVICES_PER_BUS; ++dev_id) {
         for (uint func_id = 0; func_id < PCIE_MAX_FUNCTIONS_PER_DEVICE; ++func_id) {
             /* If we can find the config, and it has a valid vendor ID, go ahead
@@ -93,19 +99,17 @@ void PcieUpstreamNode::ScanDownstream() {
 
                 auto downstream_device = GetDownstream(ndx);
                 if (!downstream_device) {
-                    auto new_dev = ScanDevice(cfg, dev_id, func_id);
-                    if (new_dev == nullptr) {
+                    downstream_device = ScanDevice(cfg, dev_id, func_id);
+                    if (downstream_device == nullptr) {
                         TRACEF("Failed to initialize device %02x:%02x.%01x; This is Very Bad.  "
                                "Device (and any of its children) will be inaccessible!\n",
                                managed_bus_id_, dev_id, func_id);
                         good_device = false;
                     }
-                } else if (downstream_device->is_bridge()) {
-                    // TODO(johngro) : Instead of going up and down the class graph with static
-                    // casts, would it be better to do this with vtable tricks?
-                    static_cast<PcieUpstreamNode*>(
-                    static_cast<PcieBridge*>(downstream_device.get()))->ScanDownstream();
                 }
+
+                if (good_device && downstream_device->is_bridge())
+                    bridge_map[ndx / 64] |= 1ull << (ndx % 64);
             }
 
             /* If this was function zero, and there is either no device, or the
@@ -116,6 +120,62 @@ void PcieUpstreamNode::ScanDownstream() {
                 break;
         }
     }
+
+    scan_time_ = current_time() - start;
+    LTRACEF("Scanned bus %02x in %" PRIi64 " uSec\n", managed_bus_id_, scan_time_ / ZX_USEC(1));
+
+    ScanBridgesDownstream(bridge_map);
+}
+
+void PcieUpstreamNode::ScanBridgesDownstream(const uint64_t* bridge_map) {
+    // The buses behind different bridges are independent of each other, so
+    // scan them in parallel where we can.  The bus driver limits the number of
+    // scan workers system wide; bridges which can't get one are scanned on
+    // this thread while the workers run.
+    struct {
+        thread_t* thread;
+        fbl::RefPtr<PcieDevice> bridge;
+    } workers[kMaxScanWorkersPerBus];
+    uint worker_count = 0;
+
+    for (uint ndx = 0; ndx < PCIE_MAX_FUNCTIONS_PER_BUS; ++ndx) {
+        if (!(bridge_map[ndx / 64] & (1ull << (ndx % 64))))
+            continue;
+
+        auto bridge = GetDownstream(ndx);
+        if (bridge == nullptr)
+            continue;
+
+        // TODO(johngro) : Instead of going up and down the class graph with static
+        // casts, would it be better to do this with vtable tricks?
+        auto upstream = static_cast<PcieUpstreamNode*>(static_cast<PcieBridge*>(bridge.get()));
+
+        if ((worker_count < fbl::count_of(workers)) && driver().ClaimScanWorker()) {
+            thread_t* t = thread_create("pcie-scan", ScanDownstreamThread, upstream,
+                                        DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+            if (t != nullptr) {
+                workers[worker_count].thread = t;
+                workers[worker_count].bridge = fbl::move(bridge);
+                worker_count++;
+                thread_resume(t);
+                continue;
+            }
+            driver().ReleaseScanWorker();
+        }
+
+        upstream->ScanDownstream();
+    }
+
+    for (uint i = 0; i < worker_count; ++i) {
+        thread_join(workers[i].thread, nullptr, ZX_TIME_INFINITE);
+        workers[i].bridge.reset();
+        driver().ReleaseScanWorker();
+    }
+}
+
+int PcieUpstreamNode::ScanDownstreamThread(void* ctx) {
+    static_cast<PcieUpstreamNode*>(ctx)->ScanDownstream();
+    return 0;
 }
 
 fbl::RefPtr<PcieDevice> PcieUpstreamNode::ScanDevice(const PciConfig* cfg,
@@ -31,6 +31,7 @@ struct pdev_interrupt_ops {
                               enum interrupt_polarity* pol);
     bool (*is_valid)(unsigned int vector, uint32_t flags);
     unsigned int (*remap)(unsigned int vector);
+    zx_status_t (*set_affinity)(unsigned int vector, cpu_mask_t mask);
     zx_status_t (*send_ipi)(cpu_mask_t target, mp_ipi_t ipi);
     void (*init_percpu_early)(void);
     void (*init_percpu)(void);
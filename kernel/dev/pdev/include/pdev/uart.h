@@ -19,6 +19,10 @@ struct pdev_uart_ops {
     /* panic-time uart accessors, intended to be run with interrupts disabled */
     int (*pputc)(char c);
     int (*pgetc)(void);
+
+    /* optional: write a string, sleeping on a full tx fifo if |block| is set
+     * rather than spinning; |map_NL| turns \n into \r\n */
+    void (*dputs)(const char* str, size_t len, bool block, bool map_NL);
 };
 
 void pdev_register_uart(const struct pdev_uart_ops* ops);
@@ -71,6 +71,10 @@ static unsigned int default_remap(unsigned int vector) {
     return 0;
 }
 
+static zx_status_t default_set_affinity(unsigned int vector, cpu_mask_t mask) {
+    return ZX_ERR_NOT_SUPPORTED;
+}
+
 static zx_status_t default_send_ipi(cpu_mask_t target, mp_ipi_t ipi) {
     return ZX_ERR_NOT_CONFIGURED;
 }
@@ -99,6 +103,7 @@ static const struct pdev_interrupt_ops default_ops = {
     .get_config = default_get_config,
     .is_valid = default_is_valid,
     .remap = default_remap,
+    .set_affinity = default_set_affinity,
     .send_ipi = default_send_ipi,
     .init_percpu_early = default_init_percpu_early,
     .init_percpu = default_init_percpu,
@@ -135,6 +140,10 @@ unsigned int remap_interrupt(unsigned int vector) {
     return intr_ops->remap(vector);
 }
 
+zx_status_t set_interrupt_affinity(unsigned int vector, cpu_mask_t mask) {
+    return intr_ops->set_affinity(vector, mask);
+}
+
 zx_status_t interrupt_send_ipi(cpu_mask_t target, mp_ipi_t ipi) {
     return intr_ops->send_ipi(target, ipi);
 }
@@ -48,6 +48,20 @@ int uart_getc(bool wait)
     return uart_ops->getc(wait);
 }
 
+void uart_dputs(const char* str, size_t len, bool block, bool map_NL) {
+    if (uart_ops->dputs) {
+        uart_ops->dputs(str, len, block, map_NL);
+        return;
+    }
+    while (len-- > 0) {
+        char c = *str++;
+        if (map_NL && c == '\n') {
+            uart_ops->putc('\r');
+        }
+        uart_ops->putc(c);
+    }
+}
+
 int uart_pputc(char c) {
     return uart_ops->pputc(c);
 }
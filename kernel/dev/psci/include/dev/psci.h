@@ -68,3 +68,16 @@ static inline void psci_system_reset(void) {
 
     do_psci_call(PSCI64_SYSTEM_RESET, 0, 0, 0);
 }
+
+/* enters a standby power state until an interrupt is pending, returns 0 once woken up.
+ * Power down states would come back through |entry| instead, which we don't support. */
+static inline uint32_t psci_cpu_suspend(uint32_t power_state) {
+
+    return (uint32_t)do_psci_call(PSCI64_CPU_SUSPEND, power_state, 0, 0);
+}
+
+/* returns the feature flags of |function_id|, negative if it isn't implemented */
+static inline int32_t psci_features(uint32_t function_id) {
+
+    return (int32_t)do_psci_call(PSCI64_PSCI_FEATURES, function_id, 0, 0);
+}
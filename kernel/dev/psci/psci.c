@@ -6,6 +6,12 @@
 
 #include <dev/psci.h>
 
+#include <arch/ops.h>
+#include <debug.h>
+#include <inttypes.h>
+#include <kernel/idle.h>
+#include <zircon/types.h>
+
 #if WITH_DEV_PDEV
 #include <pdev/driver.h>
 #include <mdi/mdi.h>
@@ -23,6 +29,87 @@ psci_call_proc do_psci_call = psci_smc_call;
 #endif
 
 #if WITH_DEV_PDEV
+/* the power_state StateType bit of the original and the extended format */
+#define PSCI_POWER_STATE_POWERDOWN          (1u << 16)
+#define PSCI_POWER_STATE_POWERDOWN_EXT      (1u << 30)
+#define PSCI_FEATURES_CPU_SUSPEND_EXT       (1u << 1)
+
+static void psci_idle_wfi(const struct idle_state* state) {
+    arch_idle_wait();
+}
+
+static void psci_idle_standby(const struct idle_state* state) {
+    psci_cpu_suspend((uint32_t)state->arg);
+}
+
+static struct idle_state psci_idle_states[IDLE_STATES_MAX] = {
+    {.name = "wfi", .exit_latency = ZX_USEC(1), .target_residency = ZX_USEC(1),
+     .enter = psci_idle_wfi, .arg = 0},
+};
+static uint psci_idle_state_count = 1;
+
+static void psci_add_idle_state(mdi_node_ref_t* node) {
+    uint32_t power_state = 0;
+    uint32_t exit_latency = 0;
+    uint32_t min_residency = 0;
+    bool got_power_state = false;
+
+    mdi_node_ref_t child;
+    mdi_each_child(node, &child) {
+        switch (mdi_id(&child)) {
+        case MDI_ARM_PSCI_IDLE_STATE_POWER_STATE:
+            got_power_state = mdi_node_uint32(&child, &power_state) == ZX_OK;
+            break;
+        case MDI_ARM_PSCI_IDLE_STATE_EXIT_LATENCY:
+            mdi_node_uint32(&child, &exit_latency);
+            break;
+        case MDI_ARM_PSCI_IDLE_STATE_MIN_RESIDENCY:
+            mdi_node_uint32(&child, &min_residency);
+            break;
+        }
+    }
+
+    if (!got_power_state || psci_idle_state_count == IDLE_STATES_MAX) {
+        printf("PSCI: ignoring idle state %#x\n", power_state);
+        return;
+    }
+
+    struct idle_state* state = &psci_idle_states[psci_idle_state_count++];
+    state->name = "standby";
+    state->exit_latency = ZX_USEC(exit_latency);
+    state->target_residency = ZX_USEC(min_residency);
+    state->enter = psci_idle_standby;
+    state->arg = power_state;
+}
+
+/* hands the standby states to the idle governor, once we know how to tell them apart
+ * from power down states */
+static void psci_register_idle_states(void) {
+    if (psci_idle_state_count == 1)
+        return;
+
+    uint32_t powerdown = PSCI_POWER_STATE_POWERDOWN;
+    if ((psci_get_version() >> 16) >= 1) {
+        int32_t features = psci_features(PSCI64_CPU_SUSPEND);
+        if (features < 0) {
+            printf("PSCI: CPU_SUSPEND not supported, not using idle states\n");
+            return;
+        }
+        if (features & PSCI_FEATURES_CPU_SUSPEND_EXT)
+            powerdown = PSCI_POWER_STATE_POWERDOWN_EXT;
+    }
+
+    for (uint i = 1; i < psci_idle_state_count; i++) {
+        if (psci_idle_states[i].arg & powerdown) {
+            printf("PSCI: idle state %#" PRIx64 " powers down, not using idle states\n",
+                   psci_idle_states[i].arg);
+            return;
+        }
+    }
+
+    idle_register_states(psci_idle_states, psci_idle_state_count);
+}
+
 static void arm_psci_init(mdi_node_ref_t* node, uint level) {
     bool use_smc = false;
     bool use_hvc = false;
@@ -36,6 +123,9 @@ static void arm_psci_init(mdi_node_ref_t* node, uint level) {
         case MDI_ARM_PSCI_USE_HVC:
             mdi_node_boolean(&child, &use_hvc);
             break;
+        case MDI_ARM_PSCI_IDLE_STATE:
+            psci_add_idle_state(&child);
+            break;
         }
     }
 
@@ -46,6 +136,8 @@ static void arm_psci_init(mdi_node_ref_t* node, uint level) {
         panic("neither use-smc and use-hvc set in arm_psci_init\n");
     }
     do_psci_call = use_smc ? psci_smc_call : psci_hvc_call;
+
+    psci_register_idle_states();
 }
 
 LK_PDEV_INIT(arm_psci_init, MDI_ARM_PSCI, arm_psci_init, LK_INIT_LEVEL_PLATFORM_EARLY);
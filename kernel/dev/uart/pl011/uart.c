@@ -9,6 +9,8 @@
 #include <stdio.h>
 #include <trace.h>
 #include <lib/cbuf.h>
+#include <kernel/event.h>
+#include <kernel/spinlock.h>
 #include <kernel/thread.h>
 #include <dev/interrupt.h>
 #include <dev/uart.h>
@@ -36,7 +38,16 @@
 
 #define UARTREG(base, reg)  (*REG32((base)  + (reg)))
 
-#define RXBUF_SIZE 16
+// Big enough to hold a few milliseconds of input at high baud rates, so that
+// a burst doesn't get the rx interrupt masked while the reader catches up.
+#define RXBUF_SIZE 1024
+
+#define UART_FR_RXFE (1 << 4)
+#define UART_FR_TXFF (1 << 5)
+
+#define UART_INT_RX (1 << 4)
+#define UART_INT_TX (1 << 5)
+#define UART_INT_RT (1 << 6)
 
 // values read from MDI
 static uint64_t uart_base = 0;
@@ -44,6 +55,30 @@ static uint32_t uart_irq = 0;
 
 static cbuf_t uart_rx_buf;
 
+// Set once the irq handler is installed, after which writers that are allowed
+// to block sleep on |uart_dputc_event| instead of spinning on a full tx fifo.
+static bool uart_tx_irq_enabled = false;
+static event_t uart_dputc_event = EVENT_INITIAL_VALUE(uart_dputc_event, true,
+                                                      EVENT_FLAG_AUTOUNSIGNAL);
+
+static spin_lock_t uart_spinlock = SPIN_LOCK_INITIAL_VALUE;
+
+static inline void pl011_mask_irqs(uint32_t mask)
+{
+    spin_lock_saved_state_t state;
+    spin_lock_irqsave(&uart_spinlock, state);
+    UARTREG(uart_base, UART_IMSC) &= ~mask;
+    spin_unlock_irqrestore(&uart_spinlock, state);
+}
+
+static inline void pl011_unmask_irqs(uint32_t mask)
+{
+    spin_lock_saved_state_t state;
+    spin_lock_irqsave(&uart_spinlock, state);
+    UARTREG(uart_base, UART_IMSC) |= mask;
+    spin_unlock_irqrestore(&uart_spinlock, state);
+}
+
 static enum handler_return pl011_uart_irq(void *arg)
 {
     bool resched = false;
@@ -51,12 +86,15 @@ static enum handler_return pl011_uart_irq(void *arg)
     /* read interrupt status and mask */
     uint32_t isr = UARTREG(uart_base, UART_TMIS);
 
-    if (isr & ((1<<4) | (1<<6))) { // rxmis
+    // The rx interrupt fires at the fifo trigger level and the receive
+    // timeout fires when the line goes idle with bytes still in the fifo, so
+    // either way drain everything that is there.
+    if (isr & (UART_INT_RX | UART_INT_RT)) {
         /* while fifo is not empty, read chars out of it */
-        while ((UARTREG(uart_base, UART_FR) & (1<<4)) == 0) {
+        while ((UARTREG(uart_base, UART_FR) & UART_FR_RXFE) == 0) {
             /* if we're out of rx buffer, mask the irq instead of handling it */
             if (cbuf_space_avail(&uart_rx_buf) == 0) {
-                UARTREG(uart_base, UART_IMSC) &= ~((1<<4)|(1<<6)); // !rxim
+                pl011_mask_irqs(UART_INT_RX | UART_INT_RT);
                 break;
             }
 
@@ -67,6 +105,13 @@ static enum handler_return pl011_uart_irq(void *arg)
         }
     }
 
+    if (isr & UART_INT_TX) {
+        // The tx fifo has drained to its trigger level; wake the writer.
+        pl011_mask_irqs(UART_INT_TX);
+        event_signal(&uart_dputc_event, false);
+        resched = true;
+    }
+
     return resched ? INT_RESCHEDULE : INT_NO_RESCHEDULE;
 }
 
@@ -82,35 +127,74 @@ static void pl011_uart_init(mdi_node_ref_t* node, uint level)
     // clear all irqs
     UARTREG(uart_base, UART_ICR) = 0x3ff;
 
-    // set fifo trigger level
-    UARTREG(uart_base, UART_IFLS) = 0; // 1/8 rxfifo, 1/8 txfifo
+    // set fifo trigger levels: interrupt once the rx fifo is half full,
+    // taking one interrupt per several bytes rather than one per two, and
+    // once the tx fifo has drained to 1/8 so a writer can refill nearly all
+    // of it at a time.
+    UARTREG(uart_base, UART_IFLS) = (2 << 3) | 0; // 1/2 rxfifo, 1/8 txfifo
 
-    // enable rx interrupt
-    UARTREG(uart_base, UART_IMSC) = (1 <<4 ) |  //  rxim
-                                    (1 << 6);   //  rtim
+    // enable rx and receive timeout interrupts
+    UARTREG(uart_base, UART_IMSC) = UART_INT_RX | UART_INT_RT;
 
     // enable receive
     UARTREG(uart_base, UART_CR) |= (1<<9); // rxen
 
     // enable interrupt
     unmask_interrupt(uart_irq);
+
+    uart_tx_irq_enabled = true;
 }
 
 static int pl011_uart_putc(char c)
 {
     /* spin while fifo is full */
-    while (UARTREG(uart_base, UART_FR) & (1<<5))
+    while (UARTREG(uart_base, UART_FR) & UART_FR_TXFF)
         ;
     UARTREG(uart_base, UART_DR) = c;
 
     return 1;
 }
 
+static void pl011_dputs(const char* str, size_t len, bool block, bool map_NL)
+{
+    spin_lock_saved_state_t state;
+    bool copied_CR = false;
+
+    if (!uart_tx_irq_enabled) {
+        block = false;
+    }
+    spin_lock_irqsave(&uart_spinlock, state);
+    while (len > 0) {
+        // Fill the fifo as far as it goes, then either sleep until the tx
+        // interrupt says it has drained or spin if we can't block here.
+        while (UARTREG(uart_base, UART_FR) & UART_FR_TXFF) {
+            if (block) {
+                UARTREG(uart_base, UART_IMSC) |= UART_INT_TX;
+                spin_unlock_irqrestore(&uart_spinlock, state);
+                event_wait(&uart_dputc_event);
+            } else {
+                spin_unlock_irqrestore(&uart_spinlock, state);
+                arch_spinloop_pause();
+            }
+            spin_lock_irqsave(&uart_spinlock, state);
+        }
+        if (!copied_CR && map_NL && *str == '\n') {
+            copied_CR = true;
+            UARTREG(uart_base, UART_DR) = '\r';
+        } else {
+            copied_CR = false;
+            UARTREG(uart_base, UART_DR) = *str++;
+            len--;
+        }
+    }
+    spin_unlock_irqrestore(&uart_spinlock, state);
+}
+
 static int pl011_uart_getc(bool wait)
 {
     char c;
     if (cbuf_read_char(&uart_rx_buf, &c, wait) == 1) {
-        UARTREG(uart_base, UART_IMSC) = ((1<<4)|(1<<6)); // rxim
+        pl011_unmask_irqs(UART_INT_RX | UART_INT_RT);
         return c;
     }
 
@@ -121,7 +205,7 @@ static int pl011_uart_getc(bool wait)
 static int pl011_uart_pputc(char c)
 {
     /* spin while fifo is full */
-    while (UARTREG(uart_base, UART_FR) & (1<<5))
+    while (UARTREG(uart_base, UART_FR) & UART_FR_TXFF)
         ;
     UARTREG(uart_base, UART_DR) = c;
 
@@ -130,7 +214,7 @@ static int pl011_uart_pputc(char c)
 
 static int pl011_uart_pgetc(void)
 {
-    if ((UARTREG(uart_base, UART_FR) & (1<<4)) == 0) {
+    if ((UARTREG(uart_base, UART_FR) & UART_FR_RXFE) == 0) {
         return UARTREG(uart_base, UART_DR);
     } else {
         return -1;
@@ -142,6 +226,7 @@ static const struct pdev_uart_ops uart_ops = {
     .getc = pl011_uart_getc,
     .pputc = pl011_uart_pputc,
     .pgetc = pl011_uart_pgetc,
+    .dputs = pl011_dputs,
 };
 
 static void pl011_uart_init_early(mdi_node_ref_t* node, uint level) {
@@ -53,6 +53,10 @@ void arch_flush_state_and_halt(event_t *flush_done) __NO_RETURN;
 
 void arch_idle(void);
 
+/* wait for an interrupt with interrupts disabled, returning with them still disabled. Where
+ * the instruction can't wake up for a masked interrupt the interrupt is taken inside. */
+void arch_idle_wait(void);
+
 /* function to call in spinloops to idle */
 static void arch_spinloop_pause(void);
 /* function to call when an event happens that may trigger the exit from
@@ -19,6 +19,10 @@ void uart_init_early(void);
 int uart_putc(char c);
 int uart_getc(bool wait);
 
+/* write a string, sleeping while the tx fifo drains if |block| is set and the
+ * driver supports it; |map_NL| turns \n into \r\n */
+void uart_dputs(const char* str, size_t len, bool block, bool map_NL);
+
 /* panic-time uart accessors, intended to be run with interrupts disabled */
 int uart_pputc(char c);
 int uart_pgetc(void);
@@ -79,6 +79,10 @@ static inline void atomic_fence_acquire(void) {
     __atomic_thread_fence(__ATOMIC_ACQUIRE);
 }
 
+static inline void atomic_fence_release(void) {
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
 // 64-bit versions. Assumes the compiler/platform is LLP so int is 32 bits.
 static inline int64_t atomic_swap_64(volatile int64_t* ptr, int64_t val) {
     return __atomic_exchange_n(ptr, val, __ATOMIC_SEQ_CST);
@@ -19,6 +19,15 @@ static_assert(SMP_MAX_CPUS <= sizeof(cpu_mask_t) * CHAR_BIT, "");
 #define INVALID_CPU ((cpu_num_t)-1)
 #define CPU_MASK_ALL ((cpu_mask_t)-1)
 
+// scheduling domains, from the most to the least tightly coupled. Each domain
+// of a cpu is the mask of cpus (including itself) that share the resource.
+enum sched_domain {
+    SCHED_DOMAIN_SMT,     // logical cpus sharing a physical core
+    SCHED_DOMAIN_LLC,     // cpus sharing a last level cache
+    SCHED_DOMAIN_PACKAGE, // cpus sharing a physical package
+    SCHED_DOMAIN_COUNT,
+};
+
 static inline bool is_valid_cpu_num(cpu_num_t num) {
     return (num < SMP_MAX_CPUS);
 }
@@ -5,7 +5,7 @@
 // https://opensource.org/licenses/MIT
 #pragma once
 
-#include <list.h>
+#include <kernel/cpu.h>
 #include <sys/types.h>
 #include <zircon/compiler.h>
 #include <zircon/types.h>
@@ -18,17 +18,19 @@ struct dpc;
 typedef void (*dpc_func_t)(struct dpc*);
 
 typedef struct dpc {
-    struct list_node node;
+    struct dpc* next;
+    volatile int queued;
 
     dpc_func_t func;
     void* arg;
 } dpc_t;
 
-#define DPC_INITIAL_VALUE                   \
-    {                                       \
-        .node = LIST_INITIAL_CLEARED_VALUE, \
-        .func = 0,                          \
-        .arg = 0,                           \
+#define DPC_INITIAL_VALUE \
+    {                     \
+        .next = 0,        \
+        .queued = 0,      \
+        .func = 0,        \
+        .arg = 0,         \
     }
 
 /* initializes dpc for the current cpu */
@@ -38,6 +40,11 @@ void dpc_init_for_cpu(void);
 /* the deferred procedure runs in a dedicated thread that runs at DPC_THREAD_PRIORITY */
 zx_status_t dpc_queue(dpc_t* dpc, bool reschedule);
 
+/* queue an already filled out dpc to run in the dpc thread of a particular cpu */
+/* returns ZX_ERR_INVALID_ARGS if the cpu is not online */
+/* the caller is responsible for not racing with the cpu being taken offline */
+zx_status_t dpc_queue_on_cpu(dpc_t* dpc, cpu_num_t cpu, bool reschedule);
+
 /* queue a dpc, but must be holding the thread lock */
 /* does not force a reschedule */
 zx_status_t dpc_queue_thread_locked(dpc_t* dpc);
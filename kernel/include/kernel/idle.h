@@ -0,0 +1,61 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+#pragma once
+
+#include <list.h>
+#include <sys/types.h>
+#include <zircon/compiler.h>
+#include <zircon/types.h>
+
+__BEGIN_CDECLS
+
+struct thread;
+
+#define IDLE_STATES_MAX 8 /* idle states the governor picks between, shallowest first */
+#define IDLE_HISTORY 8    /* recent idle periods used to predict the next one */
+
+/* a low power state the idle thread can put the cpu in */
+struct idle_state {
+    const char* name;
+    zx_duration_t exit_latency;     /* worst case time from a wakeup event to running again */
+    zx_duration_t target_residency; /* shortest stay for which it saves more than it costs */
+
+    /* called with interrupts disabled, returns with them still disabled once an interrupt
+     * is pending, or has been taken when the state can't help but take it */
+    void (*enter)(const struct idle_state* state);
+    uint64_t arg; /* for |enter|, such as an mwait hint or a psci power_state */
+};
+
+/* per cpu idle governor state */
+struct idle_governor {
+    zx_duration_t history[IDLE_HISTORY];
+    uint history_next;
+
+    /* wakeup latency this cpu has to keep to, the least tolerated by the latency critical
+     * threads blocked on it, ZX_TIME_INFINITE if there are none */
+    zx_duration_t latency_tolerance;
+    struct list_node latency_waiters;
+};
+
+/* replace the idle states every cpu picks between, called by the architecture or platform
+ * once it has found out what the hardware supports. The first state has to be as cheap to
+ * leave as the arch_idle_wait() default, which it takes the place of. */
+void idle_register_states(const struct idle_state* states, uint count);
+
+/* pick an idle state for the local cpu from its next timer and how long it stayed idle
+ * recently, within its latency tolerance, and sit in it until an interrupt comes in */
+void idle_enter(void);
+
+/* track the wakeup latency tolerated by threads blocked on each cpu, see
+ * thread_set_idle_latency(). Called by the scheduler with the thread lock held, block for
+ * the current thread and unblock before |t| is given a cpu to run on. */
+void idle_latency_block(struct thread* t);
+void idle_latency_unblock(struct thread* t);
+
+/* the latency |t| tolerates changed, called with the thread lock held */
+void idle_latency_update(struct thread* t);
+
+__END_CDECLS
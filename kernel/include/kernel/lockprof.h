@@ -0,0 +1,68 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS
+
+/* Lock profiling, built in with ENABLE_LOCK_PROFILING=true.
+ *
+ * Every acquisition of a mutex or a spin lock is bucketed by the code it was acquired
+ * from, which stands in for the lock's class: all the Handle mutexes are taken from a
+ * handful of places, while a global lock like thread_lock shows up as many sites that
+ * record the same lock address. Times are in current_ticks(). */
+
+#define LOCKPROF_SITES 1024
+
+#define LOCKPROF_KIND_MUTEX 0u
+#define LOCKPROF_KIND_SPIN 1u
+
+struct lockprof_site;
+
+/* lives in each profiled lock, written by the holder only */
+struct lockprof_hold {
+    struct lockprof_site* site;
+    uint64_t acquired;
+};
+
+/* one site's statistics, as read by lockprof_read() */
+struct lockprof_stats {
+    uintptr_t caller;    /* the return address of the call that acquired the lock */
+    uintptr_t lock;      /* the lock most recently acquired from there */
+    uint kind;           /* LOCKPROF_KIND_* */
+    uint64_t acquires;
+    uint64_t contended;  /* acquires that had to spin or block */
+    uint64_t wait_total; /* ticks from the first failed attempt until acquired */
+    uint64_t wait_max;
+    uint64_t hold_total; /* ticks from acquired until released */
+    uint64_t hold_max;
+};
+
+#if WITH_LOCK_PROFILING
+
+/* record that |lock| was acquired from |caller|; |wait_start| is when the first attempt
+ * failed and is only looked at if |contended| */
+void lockprof_acquired(struct lockprof_hold* hold, const void* lock, uint kind,
+                       uintptr_t caller, uint64_t wait_start, bool contended);
+
+void lockprof_record_hold(struct lockprof_hold* hold);
+
+/* record the hold time, called by the holder before it lets go of the lock */
+static inline void lockprof_released(struct lockprof_hold* hold) {
+    if (hold->site)
+        lockprof_record_hold(hold);
+}
+
+/* copy out site |index| of LOCKPROF_SITES, returns false for unused sites */
+bool lockprof_read(size_t index, struct lockprof_stats* stats);
+
+#endif // WITH_LOCK_PROFILING
+
+__END_CDECLS
@@ -11,6 +11,7 @@
 #include <assert.h>
 #include <debug.h>
 #include <kernel/atomic.h>
+#include <kernel/lockprof.h>
 #include <kernel/thread.h>
 #include <stdint.h>
 #include <zircon/compiler.h>
@@ -29,6 +30,9 @@ typedef struct TA_CAP("mutex") mutex {
     uint32_t magic;
     uintptr_t val;
     wait_queue_t wait;
+#if WITH_LOCK_PROFILING
+    struct lockprof_hold prof;
+#endif
 } mutex_t;
 
 #define MUTEX_FLAG_QUEUED ((uintptr_t)1)
@@ -44,12 +48,22 @@ static inline thread_t* mutex_holder(const mutex_t* m) {
     return (thread_t*)(mutex_val(m) & ~MUTEX_FLAG_QUEUED);
 }
 
+#if WITH_LOCK_PROFILING
 #define MUTEX_INITIAL_VALUE(m)                      \
     {                                               \
         .magic = MUTEX_MAGIC,                       \
         .val = 0,                                   \
         .wait = WAIT_QUEUE_INITIAL_VALUE((m).wait), \
+        .prof = {NULL, 0},                          \
     }
+#else
+#define MUTEX_INITIAL_VALUE(m)                      \
+    {                                               \
+        .magic = MUTEX_MAGIC,                       \
+        .val = 0,                                   \
+        .wait = WAIT_QUEUE_INITIAL_VALUE((m).wait), \
+    }
+#endif
 
 /* Rules for Mutexes:
  * - Mutexes are only safe to use from thread context.
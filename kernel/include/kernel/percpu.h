@@ -8,6 +8,7 @@
 #include <arch/ops.h>
 #include <kernel/align.h>
 #include <kernel/event.h>
+#include <kernel/idle.h>
 #include <kernel/stats.h>
 #include <kernel/thread.h>
 #include <kernel/timer.h>
@@ -18,16 +19,43 @@
 __BEGIN_CDECLS
 
 struct percpu {
-    /* per cpu timer queue */
+    /* per cpu timer queue, holds near term timers sorted by deadline */
     struct list_node timer_queue;
 
+    /* per cpu timer wheel, holds timers further out than the timer queue */
+    struct timer_wheel timer_wheel;
+
     /* per cpu preemption timer */
     timer_t preempt_timer;
 
+    /* set while the running thread has the cpu to itself and the preemption timer is
+     * left off; the next reschedule that finds another thread queued here restarts it */
+    bool preempt_tick_stopped;
+
+    /* thread queued here by a directed wakeup that has not run yet, and the timer that
+     * gives it a normal wakeup if the thread that woke it does not block soon */
+    thread_t* handoff_thread;
+    timer_t handoff_timer;
+
     /* per cpu run queue and bitmap to indicate which queues are non empty */
     struct list_node run_queue[NUM_PRIORITIES];
     uint32_t run_queue_bitmap;
 
+    /* deadline threads with capacity left, sorted by absolute deadline. Always runs
+     * ahead of the priority run queues. */
+    struct list_node deadline_queue;
+
+    /* number of threads sitting in the run queues, not counting the running thread */
+    uint32_t run_queue_count;
+
+    /* cpus this cpu has queued work for while holding the thread lock, which still need a
+     * reschedule IPI once it lets go of the lock */
+    cpu_mask_t deferred_resched_mask;
+
+    /* masks of cpus sharing each level of the cache/core topology with this one, set by
+     * the architecture via sched_set_cpu_domains(); default to just this cpu */
+    cpu_mask_t sched_domain[SCHED_DOMAIN_COUNT];
+
     /* timestamp of the last reschedule IPI sent to this cpu */
     /* 0 means no pending IPI */
     zx_time_t ipi_timestamp;
@@ -35,15 +63,20 @@ struct percpu {
     /* thread/cpu level statistics */
     struct cpu_stats stats;
 
-    /* per cpu idle thread */
+    /* per cpu idle thread, and the state it uses to pick how deeply to idle */
     thread_t idle_thread;
+    struct idle_governor idle;
 
     /* kernel counters arena */
     uint64_t* counters;
 
-    /* dpc context */
-    list_node_t dpc_list;
+    /* dpc context, pending dpcs are pushed lock free onto a lifo list
+     * that the dpc thread takes in one go */
+    struct dpc* dpc_pending;
     event_t dpc_event;
+
+    /* number of quiescent states this cpu has passed through, for rcu grace periods */
+    uint64_t rcu_quiescent_count;
 } __CPU_ALIGN;
 
 /* the kernel per-cpu structure */
@@ -0,0 +1,130 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+#pragma once
+
+#include <arch/ops.h>
+#include <kernel/spinlock.h>
+#include <zircon/compiler.h>
+#include <zircon/listnode.h>
+
+__BEGIN_CDECLS
+
+/* Read-copy-update style deferred reclamation.
+ *
+ * Lock-free readers bracket their use of shared data with rcu_read_lock() and
+ * rcu_read_unlock(). A writer unpublishes an object, so that new readers can no
+ * longer find it, and hands it to rcu_call(). The callback runs once every cpu
+ * has passed through a quiescent state, by which point no reader that could
+ * have found the object is still using it.
+ *
+ * A read-side critical section keeps interrupts disabled on the local cpu, so
+ * it can't be preempted and must not block. It touches no shared memory, so
+ * readers on different cpus never contend. A cpu is quiescent whenever it
+ * context switches or passes through the idle loop. A cpu that does neither
+ * for a while is sent an interrupt instead, which it can only take outside a
+ * read-side critical section. */
+
+struct rcu_head;
+typedef void (*rcu_func_t)(struct rcu_head*);
+
+typedef struct rcu_head {
+    struct rcu_head* next;
+    rcu_func_t func;
+} rcu_head_t;
+
+typedef spin_lock_saved_state_t rcu_read_state_t;
+
+/* read-side critical sections may nest */
+static inline void rcu_read_lock(rcu_read_state_t* state) {
+    arch_interrupt_save(state, SPIN_LOCK_FLAG_INTERRUPTS);
+}
+
+static inline void rcu_read_unlock(rcu_read_state_t state) {
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+}
+
+/* queue |func| to be called with |head| after a grace period */
+/* callbacks run in order in a dedicated thread, and may block */
+/* must not be called with the thread lock held */
+void rcu_call(rcu_head_t* head, rcu_func_t func);
+
+/* block until a grace period has passed: every read-side critical section
+ * that was in progress when this was called has ended */
+void rcu_synchronize(void);
+
+/* record that the current cpu is in a quiescent state */
+/* called by the scheduler on context switch and by the idle loop */
+void rcu_note_quiescent_state(void);
+
+__END_CDECLS
+
+#ifdef __cplusplus
+
+#include <fbl/macros.h>
+#include <fbl/ref_ptr.h>
+
+// Holds a read-side critical section for its lifetime.
+class AutoRcuReadLock {
+public:
+    AutoRcuReadLock() {
+        rcu_read_lock(&state_);
+    }
+
+    ~AutoRcuReadLock() {
+        rcu_read_unlock(state_);
+    }
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(AutoRcuReadLock);
+
+private:
+    rcu_read_state_t state_;
+};
+
+// Mix-in that lets a T be queued with rcu_call(), and hands the callback
+// the T back. A T that isn't standard-layout can't use containerof() to get
+// from an rcu_head_t member to itself, but it can from this base.
+template <typename T>
+class RcuCallable {
+protected:
+    // Calls Func with this object after a grace period. An object may only
+    // have one call pending at a time.
+    template <void (*Func)(T*)>
+    void RcuCall() {
+        rcu_call(&rcu_head_, [](rcu_head_t* head) {
+            Func(static_cast<T*>(containerof(head, RcuCallable, rcu_head_)));
+        });
+    }
+
+private:
+    rcu_head_t rcu_head_;
+};
+
+// Mix-in for a refcounted T whose references lock-free readers may take
+// within a read-side critical section. The holder of the published
+// reference drops it with RcuRelease() once the object is unpublished, so
+// that a reader racing with the release never resurrects a dead object.
+//
+//   class Foo : public fbl::RefCounted<Foo>, public RcuReleasable<Foo> { ... };
+template <typename T>
+class RcuReleasable : public RcuCallable<T> {
+public:
+    // Drops |ptr|'s reference after a grace period. An object may only
+    // have one release pending at a time.
+    static void RcuRelease(fbl::RefPtr<T> ptr) {
+        if (!ptr)
+            return;
+        RcuReleasable* self = ptr.leak_ref();
+        self->template RcuCall<&RcuReleasable::DropRef>();
+    }
+
+private:
+    static void DropRef(T* object) {
+        // Adopts the reference RcuRelease() leaked, and drops it.
+        fbl::RefPtr<T> ptr = fbl::internal::MakeRefPtrNoAdopt(object);
+    }
+};
+
+#endif // __cplusplus
@@ -11,6 +11,8 @@
 #include <stdbool.h>
 #include <zircon/compiler.h>
 
+__BEGIN_CDECLS
+
 /* scheduler interface, used internally by thread.c */
 /* not intended to be used by regular kernel code */
 void sched_init_early(void);
@@ -23,9 +25,37 @@ void sched_resched_internal(void);
 void sched_unblock_idle(thread_t* t);
 void sched_migrate(thread_t* t);
 
+/* ask the cpus in |mask| to reschedule, once the local cpu drops the thread lock */
+void sched_defer_reschedule_ipi(cpu_mask_t mask);
+
 /* return true if the thread was placed on the current cpu's run queue */
 /* this usually means the caller should locally reschedule soon */
 bool sched_unblock(thread_t* t) __WARN_UNUSED_RESULT;
 bool sched_unblock_list(struct list_node* list) __WARN_UNUSED_RESULT;
 
 void sched_transition_off_cpu(cpu_num_t old_cpu);
+
+/* change the deadline class parameters of a thread, passing 0 capacity removes it from the class */
+zx_status_t sched_set_deadline(thread_t* t, zx_duration_t capacity, zx_duration_t deadline,
+                               zx_duration_t period);
+
+/* the priority the scheduler is currently running |t| at, including boosts */
+int sched_get_effective_priority(const thread_t* t);
+
+/* let |t| run at no less than |priority| until it is called again, LOWEST_PRIORITY drops
+ * the inherited priority. Used to pass the priority of blocked waiters on to the owner of
+ * the lock they are waiting for. */
+void sched_inherit_priority(thread_t* t, int priority);
+
+/* arm a directed wakeup: the next thread the current thread unblocks is queued at the front
+ * of this cpu, with the rest of our time slice, instead of being sent to an idle cpu. Meant
+ * for a thread that is about to block on the work it just handed off, such as a synchronous
+ * channel call. If the current thread keeps running for more than SCHED_HANDOFF_GRACE the
+ * woken thread gets a normal wakeup. */
+void sched_handoff_arm(void);
+void sched_handoff_disarm(void);
+
+/* called by the architecture layer once it has discovered the cpu topology */
+void sched_set_cpu_domains(cpu_num_t cpu, const cpu_mask_t domains[SCHED_DOMAIN_COUNT]);
+
+__END_CDECLS
@@ -5,12 +5,24 @@
 // https://opensource.org/licenses/MIT
 #pragma once
 
+#include <kernel/idle.h>
 #include <sys/types.h>
 #include <zircon/compiler.h>
 #include <zircon/types.h>
 
 __BEGIN_CDECLS
 
+/* per cpu scheduler histograms */
+#define SCHED_HIST_LATENCY_BUCKETS 32 /* log2 of the wakeup to run latency in ns */
+#define SCHED_HIST_DEPTH_BUCKETS 32   /* run queue depth, the last bucket counts anything deeper */
+#define SCHED_HIST_SLICE_BUCKETS 10   /* tenths of the granted time slice that were used */
+
+struct sched_histograms {
+    ulong wakeup_latency[SCHED_HIST_LATENCY_BUCKETS];
+    ulong run_queue_depth[SCHED_HIST_DEPTH_BUCKETS];
+    ulong slice_usage[SCHED_HIST_SLICE_BUCKETS];
+};
+
 /* per cpu kernel level statistics */
 struct cpu_stats {
     zx_duration_t idle_time;
@@ -20,6 +32,16 @@ struct cpu_stats {
     ulong preempts;
     ulong yields;
 
+    /* load balancing */
+    ulong steals;       /* threads pulled off another cpu's run queue while idle */
+    ulong steal_kicks;  /* idle cpus poked to come steal from this cpu's run queue */
+
+    /* directed wakeups */
+    ulong handoffs;         /* threads woken onto this cpu to run when the waker blocks */
+    ulong handoff_timeouts; /* of those, ones the waker did not block for in time */
+
+    struct sched_histograms sched_hist;
+
     /* cpu level interrupts and exceptions */
     ulong interrupts;  /* hardware interrupts, minus timer interrupts or inter-processor interrupts */
     ulong timer_ints;  /* timer interrupts */
@@ -30,6 +52,18 @@ struct cpu_stats {
     /* inter-processor interrupts */
     ulong reschedule_ipis;
     ulong generic_ipis;
+
+    /* ipc */
+    ulong channel_msg_cache_hits;   /* message packets allocated from the per-cpu slabs */
+    ulong channel_msg_cache_misses; /* message packets allocated from the heap */
+
+    /* idle states, indexed as registered with idle_register_states() */
+    ulong idle_state_entries[IDLE_STATES_MAX];
+    zx_duration_t idle_state_time[IDLE_STATES_MAX]; /* time spent in each, from entry to exit */
+
+    /* spin locks */
+    ulong spin_contended;   /* acquisitions which had to wait for another cpu */
+    ulong spin_wait_cycles; /* cycles spent waiting in those */
 };
 
 __END_CDECLS
@@ -41,3 +75,8 @@ __END_CDECLS
     do {                                                                           \
         __atomic_fetch_add(&get_local_percpu()->stats.name, 1u, __ATOMIC_RELAXED); \
     } while (0)
+
+#define CPU_STATS_ADD(name, val)                                                      \
+    do {                                                                              \
+        __atomic_fetch_add(&get_local_percpu()->stats.name, (val), __ATOMIC_RELAXED); \
+    } while (0)
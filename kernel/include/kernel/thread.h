@@ -13,6 +13,7 @@
 #include <debug.h>
 #include <kernel/cpu.h>
 #include <kernel/spinlock.h>
+#include <kernel/timer.h>
 #include <kernel/wait.h>
 #include <list.h>
 #include <sys/types.h>
@@ -78,6 +79,18 @@ typedef void (*thread_tls_callback_t)(void* tls_value);
 
 struct vmm_aspace;
 
+/* deadline scheduling class state, see thread_set_deadline() */
+struct thread_deadline {
+    zx_duration_t capacity; /* run time granted per period, 0 if not a deadline thread */
+    zx_duration_t deadline; /* relative deadline from the start of each period */
+    zx_duration_t period;
+
+    zx_time_t period_start;  /* start of the current period */
+    zx_duration_t remaining; /* capacity left in the current period */
+    zx_time_t last_charge;   /* time up to which run time has been charged to |remaining| */
+    bool missed;             /* a miss has already been reported for the current period */
+};
+
 typedef struct thread {
     int magic;
     struct list_node thread_list_node;
@@ -87,15 +100,29 @@ typedef struct thread {
     enum thread_state state;
     zx_time_t last_started_running;
     zx_duration_t remaining_time_slice;
+    zx_duration_t granted_time_slice; /* what was left of the time slice when it last started running */
+    zx_time_t last_woken;             /* when it was last made runnable by an unblock, 0 once it runs */
     unsigned int flags;
     unsigned int signals;
 
     int base_priority;
     int priority_boost;
+    int inherited_priority; /* floor on the effective priority, passed on by blocked waiters */
+    bool handoff_armed;     /* hand the next thread we unblock our cpu, see sched_handoff_arm() */
+
+    /* deadline scheduling parameters, runs ahead of the priority bands while it has capacity */
+    struct thread_deadline deadline;
+
+    /* wakeup latency this thread tolerates, see thread_set_idle_latency(). While it is
+     * blocked with a finite one it sits on the idle governor list of the cpu it blocked on */
+    zx_duration_t idle_latency;
+    struct list_node idle_latency_node;
+    cpu_num_t idle_latency_cpu;
 
     /* current cpu the thread is either running on or in the ready queue, undefined otherwise */
     cpu_num_t curr_cpu;
     cpu_num_t last_cpu;      /* last cpu the thread ran on, INVALID_CPU if it's never run */
+    uint32_t migrations;     /* times it started running on a cpu other than last_cpu */
     cpu_mask_t cpu_affinity; /* mask of cpus that this thread can run on */
 
     /* pointer to the kernel address space this thread is associated with */
@@ -123,6 +150,11 @@ typedef struct thread {
     /* are we allowed to be interrupted on the current thing we're blocked/sleeping on */
     bool interruptable;
 
+    /* least slack for the deadlines this thread sleeps or blocks until, and how to apply it.
+     * Zero for kernel threads, user threads get it from their job's policy */
+    zx_duration_t timer_slack;
+    enum slack_mode timer_slack_mode;
+
     /* non-NULL if stopped in an exception */
     const struct arch_exception_context* exception_context;
 
@@ -215,6 +247,20 @@ zx_status_t thread_join(thread_t* t, int* retcode, zx_time_t deadline);
 zx_status_t thread_detach_and_resume(thread_t* t);
 zx_status_t thread_set_real_time(thread_t* t);
 
+/* place the thread in the deadline scheduling class: in every |period| it is guaranteed
+ * |capacity| of cpu time, to be delivered no later than |deadline| after the period starts.
+ * Passing a zero capacity returns the thread to its normal priority band.
+ * Returns ZX_ERR_NO_RESOURCES if admitting the thread would overcommit the system.
+ */
+zx_status_t thread_set_deadline(thread_t* t, zx_duration_t capacity, zx_duration_t deadline,
+                                zx_duration_t period);
+
+/* keep the cpu |t| blocks on out of idle states it takes longer than |latency| to wake up
+ * from, until it runs again. ZX_TIME_INFINITE, the default, lets the idle governor pick
+ * freely; deadline threads are held to the slack of their deadline regardless.
+ */
+zx_status_t thread_set_idle_latency(thread_t* t, zx_duration_t latency);
+
 /* scheduler routines to be used by regular kernel code */
 void thread_yield(void);      /* give up the cpu and time slice voluntarily */
 void thread_preempt(void);    /* get preempted at irq time */
@@ -285,18 +331,33 @@ static inline bool thread_is_real_time_or_idle(thread_t* t) {
     return !!(t->flags & (THREAD_FLAG_REAL_TIME | THREAD_FLAG_IDLE));
 }
 
+static inline bool thread_is_deadline(const thread_t* t) {
+    return t->deadline.capacity != 0;
+}
+
 /* the current thread */
 #include <arch/current_thread.h>
 thread_t* get_current_thread(void);
 void set_current_thread(thread_t*);
 
-/* scheduler lock */
+/* scheduler lock
+ *
+ * One lock still covers every run queue, every wait queue and the scheduling state of every
+ * thread.  Thread state, wait queue membership, priority inheritance, timeouts and the handoff
+ * of the lock across a context switch all depend on that, so it has not been split into per-cpu
+ * run queue and per-wait queue locks.  What can be done without holding it is done outside it:
+ * reschedule IPIs go out after it is dropped, and redundant event signals never take it. */
 extern spin_lock_t thread_lock;
 
 #define THREAD_LOCK(state)         \
     spin_lock_saved_state_t state; \
     spin_lock_irqsave(&thread_lock, state)
-#define THREAD_UNLOCK(state) spin_unlock_irqrestore(&thread_lock, state)
+#define THREAD_UNLOCK(state) thread_lock_release_irqrestore(state)
+
+/* Drop the thread lock, then send any reschedule IPIs the scheduler held back while it was
+ * held.  Every release of the thread lock must go through one of these. */
+void thread_lock_release(void) TA_REL(thread_lock);
+void thread_lock_release_irqrestore(spin_lock_saved_state_t state) TA_REL(thread_lock);
 
 static inline bool thread_lock_held(void) {
     return spin_lock_held(&thread_lock);
@@ -371,7 +432,7 @@ public:
     }
 
     ~AutoThreadLock() {
-        spin_unlock_irqrestore(&thread_lock, state_);
+        thread_lock_release_irqrestore(state_);
     }
 
     DISALLOW_COPY_ASSIGN_AND_MOVE(AutoThreadLock);
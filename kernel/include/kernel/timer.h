@@ -38,6 +38,11 @@ typedef struct timer {
     timer_callback callback;
     void* arg;
 
+    // Requested slack, held on to while the timer sits in the timer wheel so
+    // that it can still be coalesced once it moves to the near term queue.
+    zx_duration_t early_slack;
+    zx_duration_t late_slack;
+
     volatile int active_cpu; // <0 if inactive
     volatile bool cancel;    // true if cancel is pending
 } timer_t;
@@ -50,10 +55,43 @@ typedef struct timer {
         .slack = 0,                         \
         .callback = NULL,                   \
         .arg = NULL,                        \
+        .early_slack = 0,                   \
+        .late_slack = 0,                    \
         .active_cpu = -1,                   \
         .cancel = false,                    \
     }
 
+// Per cpu hierarchical timer wheel.
+//
+// Timers due within the next couple of milliseconds live in the sorted, slack
+// coalescing per cpu timer_queue. Anything further out is dropped into an
+// unsorted bucket of the wheel in O(1), and cancelled from it in O(1). Level 0
+// buckets are TIMER_WHEEL_GRANULARITY wide and each level above is
+// TIMER_WHEEL_SLOTS times coarser. As time advances, buckets are cascaded down
+// a level and eventually drained into the timer_queue.
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_SLOT_SHIFT 6
+#define TIMER_WHEEL_SLOTS (1u << TIMER_WHEEL_SLOT_SHIFT)
+#define TIMER_WHEEL_GRANULARITY_SHIFT 20 // ~1ms level 0 buckets
+
+struct timer_wheel {
+    // Start of the next level 0 bucket to be drained. Every timer due before
+    // this is in the timer_queue.
+    zx_time_t clk;
+
+    // Time the hardware timer is currently programmed for, ZX_TIME_INFINITE if none.
+    zx_time_t next_event;
+
+    // Bitmaps of possibly non empty buckets per level. Bits may be left set on a
+    // bucket that has been emptied by a cancel on another cpu and are cleaned up lazily.
+    uint64_t pending[TIMER_WHEEL_LEVELS];
+
+    struct list_node bucket[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+
+    // Timers too far out for the top level.
+    struct list_node overflow;
+};
+
 /* Rules for Timers:
  * - Timer callbacks occur from interrupt context
  * - Timers may be programmed or canceled from interrupt or thread context
@@ -131,6 +169,11 @@ void timer_transition_off_cpu(uint old_cpu);
  */
 void timer_thaw_percpu(void);
 
+/* When the hardware timer of the current cpu is next due to fire, ZX_TIME_INFINITE if it is
+ * stopped. Must be called with interrupts disabled; used by the idle governor.
+ */
+zx_time_t timer_next_event_local(void);
+
 /* Special helper routine to simultaneously try to acquire a spinlock and check for
  * timer cancel, which is needed in a few special cases.
  * returns ZX_OK if spinlock was acquired, ZX_ERR_TIMED_OUT if timer was canceled.
@@ -63,6 +63,7 @@ zx_status_t wait_queue_block_with_mask(wait_queue_t*, zx_time_t deadline,
  */
 int wait_queue_wake_one(wait_queue_t*, bool reschedule, zx_status_t wait_queue_error);
 int wait_queue_wake_all(wait_queue_t*, bool reschedule, zx_status_t wait_queue_error);
+int wait_queue_wake_one_lifo(wait_queue_t*, bool reschedule, zx_status_t wait_queue_error);
 struct thread* wait_queue_dequeue_one(wait_queue_t* wait, zx_status_t wait_queue_error);
 
 /* is the wait queue currently empty */
@@ -15,6 +15,8 @@ __BEGIN_CDECLS
 
 #if WITH_LIB_KTRACE
 
+#include <lib/static_branch.h>
+
 typedef struct ktrace_probe_info ktrace_probe_info_t;
 
 struct ktrace_probe_info {
@@ -23,12 +25,29 @@ struct ktrace_probe_info {
     uint32_t num;
 } __ALIGNED(16); // align on multiple of 16 to match linker packing of the ktrace_probe section
 
-void* ktrace_open(uint32_t tag);
-void ktrace_tiny(uint32_t tag, uint32_t arg);
+// Whether any of the KTRACE_GRP_* in |grp| might be traced. For a single
+// group known at compile time, which is what the tracepoints below pass,
+// this is a static branch and costs a nop while the group is off.
+// Otherwise it leaves it to the write to check.
+static inline __ALWAYS_INLINE bool ktrace_group_enabled(uint32_t grp) {
+    if (__builtin_constant_p(grp) && grp != 0 && (grp & (grp - 1)) == 0)
+        return static_branch_enabled(STATIC_BRANCH_KEY_KTRACE + __builtin_ctz(grp));
+    return true;
+}
+
+// Writes a record whose payload, KTRACE_LEN(tag) - KTRACE_HDRSIZE bytes of it,
+// is copied from |payload|. Returns false if the record's group isn't being
+// traced or there was no room for it.
+bool ktrace_write(uint32_t tag, const void* payload);
+void ktrace_write_tiny(uint32_t tag, uint32_t arg);
+static inline void ktrace_tiny(uint32_t tag, uint32_t arg) {
+    if (ktrace_group_enabled(KTRACE_GROUP(tag)))
+        ktrace_write_tiny(tag, arg);
+}
 static inline void ktrace(uint32_t tag, uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
-    uint32_t* data = (uint32_t*) ktrace_open(tag);
-    if (data) {
-        data[0] = a; data[1] = b; data[2] = c; data[3] = d;
+    if (ktrace_group_enabled(KTRACE_GROUP(tag))) {
+        uint32_t args[4] = { a, b, c, d };
+        ktrace_write(tag, args);
     }
 }
 
@@ -39,23 +58,23 @@ static inline void ktrace(uint32_t tag, uint32_t a, uint32_t b, uint32_t c, uint
 
 #define ktrace_probe0(_name) do {                               \
     _ktrace_probe_prologue(_name);                              \
-    ktrace_open(TAG_PROBE_16(info.num));                        \
+    if (ktrace_group_enabled(KTRACE_GRP_PROBE))                 \
+        ktrace_write(TAG_PROBE_16(info.num), NULL);             \
 } while (0)
 
 #define ktrace_probe2(_name,arg0,arg1) do {                  \
     _ktrace_probe_prologue(_name);                           \
-    uint32_t* args = (uint32_t*)ktrace_open(TAG_PROBE_24(info.num));    \
-    if (args) {                                              \
-      args[0] = arg0;                                        \
-      args[1] = arg1;                                        \
+    if (ktrace_group_enabled(KTRACE_GRP_PROBE)) {            \
+        uint32_t args[2] = { arg0, arg1 };                   \
+        ktrace_write(TAG_PROBE_24(info.num), args);          \
     }                                                        \
 } while (0)
 
 #define ktrace_probe64(_name,arg) do {                  \
     _ktrace_probe_prologue(_name);                           \
-    uint64_t* args = (uint64_t*)ktrace_open(TAG_PROBE_24(info.num));    \
-    if (args) {                                              \
-      *args = arg;                                           \
+    if (ktrace_group_enabled(KTRACE_GRP_PROBE)) {            \
+        uint64_t args = arg;                                 \
+        ktrace_write(TAG_PROBE_24(info.num), &args);         \
     }                                                        \
 } while (0)
 
@@ -63,7 +82,7 @@ void ktrace_name(uint32_t tag, uint32_t id, uint32_t arg, const char* name);
 int ktrace_read_user(void* ptr, uint32_t off, uint32_t len);
 zx_status_t ktrace_control(uint32_t action, uint32_t options, void* ptr);
 #else
-static inline void* ktrace_open(uint32_t tag) { return NULL; }
+static inline bool ktrace_write(uint32_t tag, const void* payload) { return false; }
 static inline void ktrace_tiny(uint32_t tag, uint32_t arg) {}
 static inline void ktrace(uint32_t tag, uint32_t a, uint32_t b, uint32_t c, uint32_t d) {}
 static inline void ktrace_probe0(const char* name) {}
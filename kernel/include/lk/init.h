@@ -8,6 +8,7 @@
 #pragma once
 
 #include <zircon/compiler.h>
+#include <stdint.h>
 #include <sys/types.h>
 
 __BEGIN_CDECLS
@@ -43,10 +44,19 @@ enum lk_init_flags {
     LK_INIT_FLAG_ALL_CPUS        = LK_INIT_FLAG_PRIMARY_CPU | LK_INIT_FLAG_SECONDARY_CPUS,
     LK_INIT_FLAG_CPU_SUSPEND     = 0x4,
     LK_INIT_FLAG_CPU_RESUME      = 0x8,
+
+    /* The hook doesn't have to finish before later levels run, including the
+     * start of userspace. From LK_INIT_LEVEL_THREADING on, the primary cpu runs
+     * it in a thread of its own and moves straight on to the next hook. Code
+     * that needs its work done calls lk_init_wait_async() first. */
+    LK_INIT_FLAG_ASYNC           = 0x10,
 };
 
 void lk_init_level(enum lk_init_flags flags, uint start_level, uint stop_level);
 
+/* block until every async hook started so far has returned */
+void lk_init_wait_async(void);
+
 static inline void lk_primary_cpu_init_level(uint start_level, uint stop_level)
 {
     lk_init_level(LK_INIT_FLAG_PRIMARY_CPU, start_level, stop_level);
@@ -76,4 +86,21 @@ struct lk_init_struct {
 #define LK_INIT_HOOK(_name, _hook, _level) \
     LK_INIT_HOOK_FLAGS(_name, _hook, _level, LK_INIT_FLAG_PRIMARY_CPU)
 
+#define LK_INIT_HOOK_ASYNC(_name, _hook, _level) \
+    LK_INIT_HOOK_FLAGS(_name, _hook, _level, LK_INIT_FLAG_PRIMARY_CPU | LK_INIT_FLAG_ASYNC)
+
+/* The boot timeline: one entry for each hook run while bringing up the
+ * primary and secondary cpus, in the order they started. |end| is 0 until
+ * the hook returns. Times are in current_ticks(). */
+typedef struct lk_init_timing {
+    const struct lk_init_struct *init;
+    uint index; /* of |init| among all the hooks, for naming it */
+    uint cpu;
+    uint64_t start;
+    uint64_t end;
+} lk_init_timing_t;
+
+/* returns the number of entries in the timeline so far */
+size_t lk_init_get_timeline(const lk_init_timing_t **timeline);
+
 __END_CDECLS
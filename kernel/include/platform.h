@@ -45,6 +45,11 @@ uint64_t ticks_per_second(void);
 /* high-precision timer current_ticks */
 uint64_t current_ticks(void);
 
+/* if current_time() is current_ticks() scaled by a fixed ratio, and the ticks
+ * are readable from user mode, fills in that ratio and returns true */
+struct fp_32_64;
+bool platform_current_time_from_ticks(struct fp_32_64* ns_per_tick);
+
 /* super early platform initialization, before almost everything */
 void platform_early_init(void);
 
@@ -128,8 +128,12 @@ static int cmd_threadstats(int argc, const cmd_args* argv, uint32_t flags) {
         printf("\tcontext_switches: %lu\n", percpu[i].stats.context_switches);
         printf("\tpreempts: %lu\n", percpu[i].stats.preempts);
         printf("\tyields: %lu\n", percpu[i].stats.yields);
+        printf("\tsteals: %lu\n", percpu[i].stats.steals);
+        printf("\tsteal kicks: %lu\n", percpu[i].stats.steal_kicks);
         printf("\ttimer interrupts: %lu\n", percpu[i].stats.timer_ints);
         printf("\ttimers: %lu\n", percpu[i].stats.timers);
+        printf("\tcontended spin locks: %lu\n", percpu[i].stats.spin_contended);
+        printf("\tspin lock wait cycles: %lu\n", percpu[i].stats.spin_wait_cycles);
     }
 
     return 0;
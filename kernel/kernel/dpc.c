@@ -6,61 +6,110 @@
 
 #include <assert.h>
 #include <err.h>
-#include <list.h>
 #include <trace.h>
 
+#include <kernel/atomic.h>
 #include <kernel/dpc.h>
 #include <kernel/event.h>
+#include <kernel/mp.h>
 #include <kernel/percpu.h>
 #include <kernel/spinlock.h>
+#include <kernel/thread.h>
 #include <lk/init.h>
 
-static spin_lock_t dpc_lock = SPIN_LOCK_INITIAL_VALUE;
+// Each cpu's pending dpcs are kept on a singly linked lifo list that any cpu
+// can push onto with a compare and swap. The only consumer is that cpu's dpc
+// thread, which swaps the whole list out at once and runs it oldest first, so
+// there is no ABA hazard and no lock needed on either side.
 
-zx_status_t dpc_queue(dpc_t* dpc, bool reschedule) {
+static bool dpc_push(struct percpu* cpu, dpc_t* dpc) {
+    dpc_t* head = __atomic_load_n(&cpu->dpc_pending, __ATOMIC_RELAXED);
+    do {
+        dpc->next = head;
+    } while (!__atomic_compare_exchange_n(&cpu->dpc_pending, &head, dpc, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    // if there was already work pending the dpc thread has been signaled
+    return head == NULL;
+}
+
+// takes every pending dpc of |cpu|, returned in the order they were queued
+static dpc_t* dpc_take_all(struct percpu* cpu) {
+    dpc_t* list = __atomic_exchange_n(&cpu->dpc_pending, NULL, __ATOMIC_ACQUIRE);
+
+    dpc_t* fifo = NULL;
+    while (list) {
+        dpc_t* next = list->next;
+        list->next = fifo;
+        fifo = list;
+        list = next;
+    }
+    return fifo;
+}
+
+static bool dpc_mark_queued(dpc_t* dpc) {
+    int expected = 0;
+    return atomic_cmpxchg(&dpc->queued, &expected, 1);
+}
+
+static zx_status_t dpc_queue_etc(dpc_t* dpc, struct percpu* cpu, bool reschedule) {
     DEBUG_ASSERT(dpc);
     DEBUG_ASSERT(dpc->func);
 
-    // disable interrupts before finding lock
-    spin_lock_saved_state_t state;
-    spin_lock_irqsave(&dpc_lock, state);
+    if (!dpc_mark_queued(dpc))
+        return ZX_ERR_ALREADY_EXISTS;
+
+    // put the dpc on the list and signal the worker if it may be idle
+    if (dpc_push(cpu, dpc))
+        event_signal(&cpu->dpc_event, reschedule);
+
+    return ZX_OK;
+}
 
-    if (list_in_list(&dpc->node)) {
-        spin_unlock_irqrestore(&dpc_lock, state);
+zx_status_t dpc_queue(dpc_t* dpc, bool reschedule) {
+    DEBUG_ASSERT(dpc);
+    DEBUG_ASSERT(dpc->func);
+
+    if (!dpc_mark_queued(dpc))
         return ZX_ERR_ALREADY_EXISTS;
-    }
 
-    struct percpu* cpu = get_local_percpu();
+    // stay on this cpu until the dpc is on its queue and the worker signaled,
+    // otherwise the cpu could go offline in between, after its list was moved
+    // by dpc_transition_off_cpu(), and the dpc would never run
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
 
-    // put the dpc at the tail of the list and signal the worker
-    list_add_tail(&cpu->dpc_list, &dpc->node);
+    struct percpu* cpu = get_local_percpu();
+    bool woke = dpc_push(cpu, dpc) && event_signal(&cpu->dpc_event, false) > 0;
 
-    spin_unlock_irqrestore(&dpc_lock, state);
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
 
-    event_signal(&cpu->dpc_event, reschedule);
+    if (reschedule && woke)
+        thread_reschedule();
 
     return ZX_OK;
 }
 
+zx_status_t dpc_queue_on_cpu(dpc_t* dpc, cpu_num_t cpu, bool reschedule) {
+    if (cpu >= SMP_MAX_CPUS || !mp_is_cpu_online(cpu))
+        return ZX_ERR_INVALID_ARGS;
+
+    return dpc_queue_etc(dpc, &percpu[cpu], reschedule);
+}
+
 zx_status_t dpc_queue_thread_locked(dpc_t* dpc) {
     DEBUG_ASSERT(dpc);
     DEBUG_ASSERT(dpc->func);
 
     // interrupts are already disabled
-    spin_lock(&dpc_lock);
-
-    if (list_in_list(&dpc->node)) {
-        spin_unlock(&dpc_lock);
+    if (!dpc_mark_queued(dpc))
         return ZX_ERR_ALREADY_EXISTS;
-    }
 
     struct percpu* cpu = get_local_percpu();
 
-    // put the dpc at the tail of the list and signal the worker
-    list_add_tail(&cpu->dpc_list, &dpc->node);
-    event_signal_thread_locked(&cpu->dpc_event);
-
-    spin_unlock(&dpc_lock);
+    // put the dpc on the list and signal the worker
+    if (dpc_push(cpu, dpc))
+        event_signal_thread_locked(&cpu->dpc_event);
 
     return ZX_OK;
 }
@@ -69,32 +118,30 @@ void dpc_transition_off_cpu(uint cpu_id) {
     DEBUG_ASSERT(cpu_id < SMP_MAX_CPUS);
 
     spin_lock_saved_state_t state;
-    spin_lock_irqsave(&dpc_lock, state);
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
 
     uint cur_cpu = arch_curr_cpu_num();
     DEBUG_ASSERT(cpu_id != cur_cpu);
 
-    list_node_t* src_list = &percpu[cpu_id].dpc_list;
-    list_node_t* dst_list = &percpu[cur_cpu].dpc_list;
-
-    dpc_t* dpc;
-    while ((dpc = list_remove_head_type(src_list, dpc_t, node))) {
-        list_add_tail(dst_list, &dpc->node);
+    // the old cpu's dpc thread is no longer running, so it is safe to consume its list here
+    dpc_t* dpc = dpc_take_all(&percpu[cpu_id]);
+    while (dpc) {
+        dpc_t* next = dpc->next;
+        dpc_push(&percpu[cur_cpu], dpc);
+        dpc = next;
     }
-    spin_unlock_irqrestore(&dpc_lock, state);
+
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
 
     event_signal(&percpu[cur_cpu].dpc_event, false);
 }
 
 static int dpc_thread(void* arg) {
-    dpc_t dpc_local;
-
     spin_lock_saved_state_t state;
     arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
 
     struct percpu* cpu = get_local_percpu();
     event_t* event = &cpu->dpc_event;
-    list_node_t* list = &cpu->dpc_list;
 
     arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
 
@@ -103,24 +150,21 @@ static int dpc_thread(void* arg) {
         __UNUSED zx_status_t err = event_wait(event);
         DEBUG_ASSERT(err == ZX_OK);
 
-        spin_lock_irqsave(&dpc_lock, state);
+        // unsignal before looking at the list, anything queued after we take
+        // the list signals the event again
+        event_unsignal(event);
 
-        // pop a dpc off the list, make a local copy.
-        dpc_t* dpc = list_remove_head_type(list, dpc_t, node);
+        dpc_t* dpc = dpc_take_all(cpu);
+        while (dpc) {
+            // make a local copy and release the dpc before calling it, it may
+            // be requeued or freed from the callback
+            dpc_t dpc_local = *dpc;
+            atomic_store(&dpc->queued, 0);
 
-        // if the list is now empty, unsignal the event so we block until it is
-        if (!dpc) {
-            event_unsignal(event);
-            dpc_local.func = NULL;
-        } else {
-           dpc_local = *dpc;
-        }
-
-        spin_unlock_irqrestore(&dpc_lock, state);
-
-        // call the dpc
-        if (dpc_local.func)
             dpc_local.func(&dpc_local);
+
+            dpc = dpc_local.next;
+        }
     }
 
     return 0;
@@ -130,7 +174,7 @@ void dpc_init_for_cpu(void) {
     struct percpu* cpu = get_local_percpu();
     uint cpu_num = arch_curr_cpu_num();
 
-    list_initialize(&cpu->dpc_list);
+    cpu->dpc_pending = NULL;
     event_init(&cpu->dpc_event, false, 0);
 
     char name[10];
@@ -139,6 +139,16 @@ static int event_signal_internal(event_t* e, bool reschedule, zx_status_t wait_r
     DEBUG_ASSERT(e->magic == EVENT_MAGIC);
     DEBUG_ASSERT(!reschedule || !arch_in_int_handler());
 
+    // Signaling an event which is already signaled, and stays that way until
+    // someone unsignals it, changes nothing; don't take the thread lock just to
+    // find that out.  The fence orders the caller's earlier stores ahead of the
+    // check, as taking the lock would have.
+    if (!thread_lock_held && !(e->flags & EVENT_FLAG_AUTOUNSIGNAL)) {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&e->signaled, __ATOMIC_RELAXED))
+            return 0;
+    }
+
     // conditionally acquire/release the thread lock
     // NOTE: using the manual spinlock grab/release instead of THREAD_LOCK because
     // the state variable needs to exit in either path.
@@ -168,7 +178,7 @@ static int event_signal_internal(event_t* e, bool reschedule, zx_status_t wait_r
 
     // conditionally THREAD_UNLOCK
     if (!thread_lock_held)
-        spin_unlock_irqrestore(&thread_lock, state);
+        THREAD_UNLOCK(state);
 
     return wake_count;
 }
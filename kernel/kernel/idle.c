@@ -0,0 +1,260 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <kernel/idle.h>
+
+#include <arch/ops.h>
+#include <assert.h>
+#include <debug.h>
+#include <inttypes.h>
+#include <kernel/mp.h>
+#include <kernel/percpu.h>
+#include <kernel/rcu.h>
+#include <kernel/spinlock.h>
+#include <kernel/stats.h>
+#include <kernel/thread.h>
+#include <kernel/timer.h>
+#include <platform.h>
+#include <trace.h>
+#include <zircon/types.h>
+
+#define LOCAL_TRACE 0
+
+/* idle periods longer than this all look alike to the governor, which also keeps the sums
+ * of squares in idle_typical() from overflowing */
+#define IDLE_HISTORY_CAP ZX_SEC(1)
+
+/* the recent idle periods count as regular if their standard deviation is no more than
+ * this, or than a sixth of their mean */
+#define IDLE_TYPICAL_STDDEV ZX_USEC(20)
+
+struct idle_table {
+    uint count;
+    struct idle_state states[IDLE_STATES_MAX];
+};
+
+static void idle_wait(const struct idle_state* state) {
+    arch_idle_wait();
+}
+
+/* until the architecture registers something better, just wait for an interrupt */
+static struct idle_table default_table = {
+    .count = 1,
+    .states = {
+        {.name = "wait", .exit_latency = 0, .target_residency = 0, .enter = idle_wait, .arg = 0},
+    },
+};
+
+static struct idle_table registered_table;
+
+/* published once with a release store, the idle threads pick it up on their next pass */
+static struct idle_table* current_table = &default_table;
+
+void idle_register_states(const struct idle_state* states, uint count) {
+    DEBUG_ASSERT(count > 0 && count <= IDLE_STATES_MAX);
+    DEBUG_ASSERT(current_table == &default_table);
+
+    for (uint i = 0; i < count; i++) {
+        DEBUG_ASSERT(states[i].enter);
+        DEBUG_ASSERT(i == 0 || states[i].exit_latency >= states[i - 1].exit_latency);
+        registered_table.states[i] = states[i];
+        LTRACEF("idle state %u: %s, exit latency %" PRIi64 " target residency %" PRIi64 "\n",
+                i, states[i].name, states[i].exit_latency, states[i].target_residency);
+    }
+    registered_table.count = count;
+
+    __atomic_store_n(&current_table, &registered_table, __ATOMIC_RELEASE);
+}
+
+/* the length of the recent idle periods if they were regular enough to expect another one
+ * like them, ZX_TIME_INFINITE otherwise. The longest are dropped a few times over to look
+ * for a pattern, a wakeup that came late says little about the next one. */
+static zx_duration_t idle_typical(const struct idle_governor* gov) {
+    zx_duration_t threshold = ZX_TIME_INFINITE;
+
+    for (int round = 0; round < 3; round++) {
+        uint64_t sum = 0;
+        uint count = 0;
+        zx_duration_t max = 0;
+        for (uint i = 0; i < IDLE_HISTORY; i++) {
+            zx_duration_t v = gov->history[i];
+            if (v <= threshold) {
+                sum += v;
+                count++;
+                max = MAX(max, v);
+            }
+        }
+
+        /* give up once more than a quarter of them would be left out */
+        if (count * 4 < IDLE_HISTORY * 3)
+            break;
+
+        uint64_t avg = sum / count;
+        uint64_t variance = 0;
+        for (uint i = 0; i < IDLE_HISTORY; i++) {
+            zx_duration_t v = gov->history[i];
+            if (v <= threshold) {
+                int64_t diff = v - (int64_t)avg;
+                variance += (uint64_t)(diff * diff);
+            }
+        }
+        variance /= count;
+
+        if (variance <= (uint64_t)IDLE_TYPICAL_STDDEV * IDLE_TYPICAL_STDDEV ||
+            variance <= avg * avg / 36)
+            return (zx_duration_t)avg;
+
+        threshold = max - 1;
+    }
+
+    return ZX_TIME_INFINITE;
+}
+
+void idle_enter(void) {
+    arch_disable_ints();
+
+    /* the idle thread is never in a read-side critical section */
+    rcu_note_quiescent_state();
+
+    struct percpu* c = get_local_percpu();
+    struct idle_governor* gov = &c->idle;
+    const struct idle_table* table = __atomic_load_n(&current_table, __ATOMIC_ACQUIRE);
+    zx_time_t now = current_time();
+
+    /* go as deep as the expected idle period pays for and the threads waiting on this cpu
+     * can take the exit latency of */
+    uint index = 0;
+    if (table->count > 1) {
+        zx_time_t next_event = timer_next_event_local();
+        zx_duration_t predicted = (next_event == ZX_TIME_INFINITE) ? ZX_TIME_INFINITE
+                                                                  : MAX(next_event - now, 0);
+        predicted = MIN(predicted, idle_typical(gov));
+        zx_duration_t tolerance = __atomic_load_n(&gov->latency_tolerance, __ATOMIC_RELAXED);
+
+        for (uint i = 1; i < table->count; i++) {
+            const struct idle_state* state = &table->states[i];
+            if (state->target_residency > predicted || state->exit_latency > tolerance)
+                break;
+            index = i;
+        }
+    }
+
+    const struct idle_state* state = &table->states[index];
+    ulong context_switches = c->stats.context_switches;
+
+    state->enter(state);
+
+    /* a state that had to take the wakeup interrupt may have been preempted by it, so the
+     * time until now tells nothing about how long the cpu was idle */
+    if (c->stats.context_switches == context_switches) {
+        zx_duration_t idle = current_time() - now;
+        c->stats.idle_state_time[index] += idle;
+        gov->history[gov->history_next] = MIN(idle, IDLE_HISTORY_CAP);
+        gov->history_next = (gov->history_next + 1) % IDLE_HISTORY;
+    }
+    c->stats.idle_state_entries[index]++;
+
+    arch_enable_ints();
+}
+
+/* the wakeup latency |t| tolerates from the cpu it blocks on */
+static zx_duration_t thread_latency(const thread_t* t) {
+    zx_duration_t latency = t->idle_latency;
+    if (thread_is_deadline(t))
+        latency = MIN(latency, t->deadline.deadline - t->deadline.capacity);
+    return latency;
+}
+
+static void latency_recompute(cpu_num_t cpu) {
+    struct idle_governor* gov = &percpu[cpu].idle;
+    zx_duration_t tolerance = ZX_TIME_INFINITE;
+
+    thread_t* t;
+    list_for_every_entry (&gov->latency_waiters, t, thread_t, idle_latency_node) {
+        tolerance = MIN(tolerance, thread_latency(t));
+    }
+
+    __atomic_store_n(&gov->latency_tolerance, tolerance, __ATOMIC_RELAXED);
+}
+
+void idle_latency_block(thread_t* t) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    zx_duration_t latency = thread_latency(t);
+    if (likely(latency == ZX_TIME_INFINITE))
+        return;
+
+    cpu_num_t cpu = arch_curr_cpu_num();
+    struct idle_governor* gov = &percpu[cpu].idle;
+
+    t->idle_latency_cpu = cpu;
+    list_add_head(&gov->latency_waiters, &t->idle_latency_node);
+    if (latency < gov->latency_tolerance)
+        __atomic_store_n(&gov->latency_tolerance, latency, __ATOMIC_RELAXED);
+}
+
+void idle_latency_unblock(thread_t* t) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    if (likely(!list_in_list(&t->idle_latency_node)))
+        return;
+
+    list_delete(&t->idle_latency_node);
+    latency_recompute(t->idle_latency_cpu);
+}
+
+void idle_latency_update(thread_t* t) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    /* anything else picks it up the next time it blocks */
+    if (t->state != THREAD_BLOCKED && t->state != THREAD_SLEEPING)
+        return;
+
+    cpu_num_t cpu = t->last_cpu;
+    if (list_in_list(&t->idle_latency_node)) {
+        cpu = t->idle_latency_cpu;
+        list_delete(&t->idle_latency_node);
+    }
+
+    if (thread_latency(t) != ZX_TIME_INFINITE) {
+        t->idle_latency_cpu = cpu;
+        list_add_head(&percpu[cpu].idle.latency_waiters, &t->idle_latency_node);
+    }
+    latency_recompute(cpu);
+}
+
+#if WITH_LIB_CONSOLE
+#include <lib/console.h>
+
+static int cmd_idle(int argc, const cmd_args* argv, uint32_t flags) {
+    const struct idle_table* table = __atomic_load_n(&current_table, __ATOMIC_ACQUIRE);
+
+    for (uint i = 0; i < table->count; i++) {
+        printf("state %u: %-12s exit latency %8" PRIi64 " target residency %8" PRIi64 "\n",
+               i, table->states[i].name, table->states[i].exit_latency,
+               table->states[i].target_residency);
+    }
+
+    for (uint cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        if (!mp_is_cpu_active(cpu))
+            continue;
+
+        zx_duration_t tolerance = percpu[cpu].idle.latency_tolerance;
+        printf("cpu %u: latency tolerance %" PRIi64 "\n", cpu, tolerance);
+        for (uint i = 0; i < table->count; i++) {
+            printf("\t%-12s entries %10lu time %16" PRIi64 "\n", table->states[i].name,
+                   percpu[cpu].stats.idle_state_entries[i], percpu[cpu].stats.idle_state_time[i]);
+        }
+    }
+
+    return 0;
+}
+
+STATIC_COMMAND_START
+STATIC_COMMAND("idle", "idle states and their residency", &cmd_idle)
+STATIC_COMMAND_END(idle);
+
+#endif // WITH_LIB_CONSOLE
@@ -0,0 +1,214 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <kernel/lockprof.h>
+
+#include <assert.h>
+#include <debug.h>
+#include <inttypes.h>
+#include <kernel/atomic.h>
+#include <kernel/cmdline.h>
+#include <lk/init.h>
+#include <platform.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zircon/types.h>
+
+#if WITH_LOCK_PROFILING
+
+#define LOCKPROF_PROBES 16
+
+/* Everything here runs inside the lock primitives, often with interrupts disabled and
+ * the very locks being profiled held, so it sticks to atomics on a fixed table. */
+struct lockprof_site {
+    uint64_t caller;
+    uint64_t lock;
+    uint64_t kind;
+    uint64_t acquires;
+    uint64_t contended;
+    uint64_t wait_total;
+    uint64_t wait_max;
+    uint64_t hold_total;
+    uint64_t hold_max;
+};
+static struct lockprof_site sites[LOCKPROF_SITES];
+static uint64_t sites_dropped;
+
+/* set from kernel.lockprof.enable, and by the console command */
+static bool lockprof_enabled;
+
+static struct lockprof_site* lockprof_find_site(uintptr_t caller) {
+    uint64_t key = caller;
+    size_t hash = (size_t)((key >> 2) * 0x9e3779b97f4a7c15ull >> 32);
+
+    for (size_t probe = 0; probe < LOCKPROF_PROBES; probe++) {
+        struct lockprof_site* site = &sites[(hash + probe) % LOCKPROF_SITES];
+
+        uint64_t cur = atomic_load_u64_relaxed(&site->caller);
+        if (cur == 0) {
+            /* claim the empty slot, if someone beat us to it see if it was for our caller */
+            if (!atomic_cmpxchg_u64(&site->caller, &cur, key) && cur != key)
+                continue;
+        } else if (cur != key) {
+            continue;
+        }
+        return site;
+    }
+
+    atomic_add_u64(&sites_dropped, 1u);
+    return NULL;
+}
+
+static void lockprof_max(uint64_t* max, uint64_t val) {
+    uint64_t cur = __atomic_load_n(max, __ATOMIC_RELAXED);
+    while (val > cur) {
+        if (__atomic_compare_exchange_n(max, &cur, val, false, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED))
+            break;
+    }
+}
+
+void lockprof_acquired(struct lockprof_hold* hold, const void* lock, uint kind,
+                       uintptr_t caller, uint64_t wait_start, bool contended) {
+    hold->site = NULL;
+    if (!__atomic_load_n(&lockprof_enabled, __ATOMIC_RELAXED))
+        return;
+
+    struct lockprof_site* site = lockprof_find_site(caller);
+    if (!site)
+        return;
+
+    uint64_t now = current_ticks();
+    __atomic_store_n(&site->lock, (uintptr_t)lock, __ATOMIC_RELAXED);
+    __atomic_store_n(&site->kind, kind, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&site->acquires, 1u, __ATOMIC_RELAXED);
+    if (contended) {
+        uint64_t wait = now - wait_start;
+        __atomic_fetch_add(&site->contended, 1u, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&site->wait_total, wait, __ATOMIC_RELAXED);
+        lockprof_max(&site->wait_max, wait);
+    }
+
+    hold->site = site;
+    hold->acquired = now;
+}
+
+void lockprof_record_hold(struct lockprof_hold* hold) {
+    struct lockprof_site* site = hold->site;
+    uint64_t held = current_ticks() - hold->acquired;
+
+    hold->site = NULL;
+    __atomic_fetch_add(&site->hold_total, held, __ATOMIC_RELAXED);
+    lockprof_max(&site->hold_max, held);
+}
+
+bool lockprof_read(size_t index, struct lockprof_stats* stats) {
+    DEBUG_ASSERT(index < LOCKPROF_SITES);
+    const struct lockprof_site* site = &sites[index];
+
+    /* the counters are read one by one without stopping anyone, so they can be off
+     * from each other by the acquisitions that are in flight */
+    stats->caller = (uintptr_t)__atomic_load_n(&site->caller, __ATOMIC_RELAXED);
+    if (stats->caller == 0)
+        return false;
+    stats->lock = (uintptr_t)__atomic_load_n(&site->lock, __ATOMIC_RELAXED);
+    stats->kind = (uint)__atomic_load_n(&site->kind, __ATOMIC_RELAXED);
+    stats->acquires = __atomic_load_n(&site->acquires, __ATOMIC_RELAXED);
+    stats->contended = __atomic_load_n(&site->contended, __ATOMIC_RELAXED);
+    stats->wait_total = __atomic_load_n(&site->wait_total, __ATOMIC_RELAXED);
+    stats->wait_max = __atomic_load_n(&site->wait_max, __ATOMIC_RELAXED);
+    stats->hold_total = __atomic_load_n(&site->hold_total, __ATOMIC_RELAXED);
+    stats->hold_max = __atomic_load_n(&site->hold_max, __ATOMIC_RELAXED);
+    return true;
+}
+
+static void lockprof_init(uint level) {
+    __atomic_store_n(&lockprof_enabled, cmdline_get_bool("kernel.lockprof.enable", true),
+                     __ATOMIC_RELAXED);
+}
+
+/* the kernel command line is only known after the platform's early init, the locks
+ * taken before that go unrecorded */
+LK_INIT_HOOK(lockprof, lockprof_init, LK_INIT_LEVEL_PLATFORM_EARLY);
+
+#if WITH_LIB_CONSOLE
+#include <lib/console.h>
+
+static struct lockprof_stats dump_stats[LOCKPROF_SITES];
+
+static int lockprof_cmp_wait(const void* a, const void* b) {
+    const struct lockprof_stats* sa = a;
+    const struct lockprof_stats* sb = b;
+    if (sa->wait_total != sb->wait_total)
+        return sa->wait_total > sb->wait_total ? -1 : 1;
+    return sa->hold_total > sb->hold_total ? -1 : sa->hold_total < sb->hold_total;
+}
+
+static uint64_t ticks_to_usec(uint64_t ticks) {
+    uint64_t per_usec = ticks_per_second() / 1000000;
+    return ticks / (per_usec ? per_usec : 1);
+}
+
+static void lockprof_dump(size_t max) {
+    size_t count = 0;
+    for (size_t i = 0; i < LOCKPROF_SITES; i++) {
+        if (lockprof_read(i, &dump_stats[count]))
+            count++;
+    }
+    qsort(dump_stats, count, sizeof(dump_stats[0]), lockprof_cmp_wait);
+
+    printf("%18s %18s %5s %10s %10s %12s %10s %12s %10s\n", "caller", "lock", "kind",
+           "acquires", "contended", "wait us", "max", "hold us", "max");
+    for (size_t i = 0; i < MIN(count, max); i++) {
+        const struct lockprof_stats* s = &dump_stats[i];
+        printf("%#18" PRIxPTR " %#18" PRIxPTR " %5s %10" PRIu64 " %10" PRIu64
+               " %12" PRIu64 " %10" PRIu64 " %12" PRIu64 " %10" PRIu64 "\n",
+               s->caller, s->lock, s->kind == LOCKPROF_KIND_SPIN ? "spin" : "mutex",
+               s->acquires, s->contended, ticks_to_usec(s->wait_total),
+               ticks_to_usec(s->wait_max), ticks_to_usec(s->hold_total),
+               ticks_to_usec(s->hold_max));
+    }
+    if (sites_dropped)
+        printf("%" PRIu64 " acquisitions from untracked sites\n", sites_dropped);
+}
+
+static int cmd_lockprof(int argc, const cmd_args* argv, uint32_t flags) {
+    if (argc < 2) {
+    usage:
+        printf("usage:\n");
+        printf("%s dump [count]  : dump the acquisition sites that waited the longest\n",
+               argv[0].str);
+        printf("%s reset         : clear the statistics\n", argv[0].str);
+        printf("%s start         : start recording\n", argv[0].str);
+        printf("%s stop          : stop recording\n", argv[0].str);
+        return ZX_ERR_INTERNAL;
+    }
+
+    if (!strcmp(argv[1].str, "dump")) {
+        lockprof_dump(argc > 2 ? argv[2].u : 20);
+    } else if (!strcmp(argv[1].str, "reset")) {
+        /* a lock held across the reset adds its hold time to the cleared site */
+        memset(sites, 0, sizeof(sites));
+        sites_dropped = 0;
+    } else if (!strcmp(argv[1].str, "start")) {
+        __atomic_store_n(&lockprof_enabled, true, __ATOMIC_RELAXED);
+    } else if (!strcmp(argv[1].str, "stop")) {
+        __atomic_store_n(&lockprof_enabled, false, __ATOMIC_RELAXED);
+    } else {
+        goto usage;
+    }
+
+    return ZX_OK;
+}
+
+STATIC_COMMAND_START
+STATIC_COMMAND("lockprof", "kernel lock contention profile", &cmd_lockprof)
+STATIC_COMMAND_END(lockprof);
+
+#endif // WITH_LIB_CONSOLE
+
+#endif // WITH_LOCK_PROFILING
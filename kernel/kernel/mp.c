@@ -245,7 +245,7 @@ static void mp_unplug_trampoline(void) {
      * should be quick), then this CPU may execute the task. */
     mp_set_curr_cpu_online(false);
 
-    spin_unlock(&thread_lock);
+    thread_lock_release();
 
     /* do *not* enable interrupts, we want this CPU to never receive another
      * interrupt */
@@ -22,12 +22,100 @@
 #include <inttypes.h>
 #include <kernel/sched.h>
 #include <kernel/thread.h>
+#include <lib/counters.h>
 #include <lib/ktrace.h>
+#include <platform.h>
+#include <stdio.h>
+#include <string.h>
 #include <trace.h>
 #include <zircon/types.h>
 
 #define LOCAL_TRACE 0
 
+/* disable adaptive spinning on contended mutexes */
+#define NO_SPIN 0
+
+/* upper bound on how many times a contended acquire polls the mutex while the owner
+ * is running on another cpu before giving up and blocking. Each iteration is a load
+ * and a cpu relax hint, so this works out to a few tens of microseconds at most.
+ */
+#define MUTEX_SPIN_MAX_ITERATIONS 4096
+
+/* number of distinct callers tracked by the contention statistics */
+#define MUTEX_CONTENTION_SITES 128
+#define MUTEX_CONTENTION_PROBES 8
+
+KCOUNTER(mutex_spin_acquire_count, "kernel.mutex.spin.acquire");
+KCOUNTER(mutex_spin_fail_count, "kernel.mutex.spin.fail");
+KCOUNTER(mutex_block_count, "kernel.mutex.block");
+
+/* contention statistics, bucketed by the code that called mutex_acquire() */
+struct mutex_contention_site {
+    uint64_t caller;
+    uint64_t spins;  /* contended acquires satisfied by spinning */
+    uint64_t blocks; /* contended acquires that had to block */
+};
+static struct mutex_contention_site contention_sites[MUTEX_CONTENTION_SITES];
+static uint64_t contention_sites_dropped;
+
+static void mutex_record_contention(uintptr_t caller, bool blocked) {
+    uint64_t key = caller;
+    size_t hash = (size_t)((key >> 2) * 0x9e3779b97f4a7c15ull >> 32);
+
+    for (size_t probe = 0; probe < MUTEX_CONTENTION_PROBES; probe++) {
+        struct mutex_contention_site* site =
+            &contention_sites[(hash + probe) % MUTEX_CONTENTION_SITES];
+
+        uint64_t cur = atomic_load_u64_relaxed(&site->caller);
+        if (cur == 0) {
+            /* claim the empty slot, if someone beat us to it see if it was for our caller */
+            if (!atomic_cmpxchg_u64(&site->caller, &cur, key) && cur != key)
+                continue;
+        } else if (cur != key) {
+            continue;
+        }
+
+        atomic_add_u64(blocked ? &site->blocks : &site->spins, 1u);
+        return;
+    }
+
+    atomic_add_u64(&contention_sites_dropped, 1u);
+}
+
+/* spin while the mutex is held by a thread that is running on another cpu, in the hope that
+ * it will be released soon and we can skip the block/wakeup round trip through the scheduler.
+ * Returns true if the mutex was acquired.
+ */
+static bool mutex_spin_acquire(mutex_t* m, thread_t* ct) {
+    if (NO_SPIN)
+        return false;
+
+    for (uint i = 0; i < MUTEX_SPIN_MAX_ITERATIONS; i++) {
+        uintptr_t val = mutex_val(m);
+        if (val == 0) {
+            if (atomic_cmpxchg_u64(&m->val, &val, (uintptr_t)ct))
+                return true;
+            continue;
+        }
+
+        /* once there are waiters the release hands the mutex directly to one of them */
+        if (val & MUTEX_FLAG_QUEUED)
+            return false;
+
+        /* A thread cannot exit while it holds a mutex, and thread structures live in
+         * memory that stays mapped, so if the holder releases the mutex and goes away
+         * between our loads the stale read below just ends the spin early.
+         */
+        thread_t* holder = (thread_t*)val;
+        if (__atomic_load_n(&holder->state, __ATOMIC_RELAXED) != THREAD_RUNNING)
+            return false;
+
+        arch_spinloop_pause();
+    }
+
+    return false;
+}
+
 /**
  * @brief  Initialize a mutex_t
  */
@@ -69,21 +157,49 @@ void mutex_acquire(mutex_t* m) TA_NO_THREAD_SAFETY_ANALYSIS {
     thread_t* ct = get_current_thread();
     uintptr_t oldval;
 
+#if WITH_LOCK_PROFILING
+    uint64_t wait_start = 0;
+    bool contended = false;
+#endif
+
 retry:
     // fast path: assume its unheld, try to grab it
     oldval = 0;
     if (likely(atomic_cmpxchg_u64(&m->val, &oldval, (uintptr_t)ct))) {
         // acquired it cleanly
+#if WITH_LOCK_PROFILING
+        lockprof_acquired(&m->prof, m, LOCKPROF_KIND_MUTEX, (uintptr_t)__GET_CALLER(),
+                          wait_start, contended);
+#endif
         return;
     }
 
+#if WITH_LOCK_PROFILING
+    if (!contended) {
+        wait_start = current_ticks();
+        contended = true;
+    }
+#endif
+
 #if LK_DEBUGLEVEL > 0
     if (unlikely(ct == mutex_holder(m)))
         panic("mutex_acquire: thread %p (%s) tried to acquire mutex %p it already owns.\n",
               ct, ct->name, m);
 #endif
 
-    // we contended with someone else, will probably need to block
+    // we contended with someone else, see if the holder is about to let go
+    if (mutex_spin_acquire(m, ct)) {
+        kcounter_add(mutex_spin_acquire_count, 1u);
+        mutex_record_contention((uintptr_t)__GET_CALLER(), false);
+#if WITH_LOCK_PROFILING
+        lockprof_acquired(&m->prof, m, LOCKPROF_KIND_MUTEX, (uintptr_t)__GET_CALLER(),
+                          wait_start, true);
+#endif
+        return;
+    }
+    kcounter_add(mutex_spin_fail_count, 1u);
+
+    // will probably need to block
     THREAD_LOCK(state);
 
     // save the current state and check to see if it wasn't released in the interim
@@ -100,6 +216,9 @@ retry:
         goto retry;
     }
 
+    kcounter_add(mutex_block_count, 1u);
+    mutex_record_contention((uintptr_t)__GET_CALLER(), true);
+
     // we have signalled that we're blocking, so drop into the wait queue
     zx_status_t ret = wait_queue_block(&m->wait, ZX_TIME_INFINITE);
     if (unlikely(ret < ZX_OK)) {
@@ -112,6 +231,11 @@ retry:
     // someone must have woken us up, we should own the mutex now
     DEBUG_ASSERT(ct == mutex_holder(m));
 
+#if WITH_LOCK_PROFILING
+    lockprof_acquired(&m->prof, m, LOCKPROF_KIND_MUTEX, (uintptr_t)__GET_CALLER(),
+                      wait_start, true);
+#endif
+
     THREAD_UNLOCK(state);
 }
 
@@ -121,6 +245,11 @@ static inline void mutex_release_internal(mutex_t* m, bool reschedule, bool thre
     thread_t* ct = get_current_thread();
     uintptr_t oldval;
 
+#if WITH_LOCK_PROFILING
+    // record the hold time while we still own the mutex, the next holder reuses the state
+    lockprof_released(&m->prof);
+#endif
+
     // in case there's no contention, try the fast path
     oldval = (uintptr_t)ct;
     if (likely(atomic_cmpxchg_u64(&m->val, &oldval, 0))) {
@@ -167,7 +296,7 @@ static inline void mutex_release_internal(mutex_t* m, bool reschedule, bool thre
 
     // conditionally THREAD_UNLOCK
     if (!thread_lock_held)
-        spin_unlock_irqrestore(&thread_lock, state);
+        THREAD_UNLOCK(state);
 }
 
 void mutex_release(mutex_t* m) TA_NO_THREAD_SAFETY_ANALYSIS {
@@ -188,3 +317,46 @@ void mutex_release_thread_locked(mutex_t* m, bool reschedule) TA_NO_THREAD_SAFET
     // the thread_lock
     mutex_release_internal(m, reschedule, true);
 }
+
+#if WITH_LIB_CONSOLE
+#include <lib/console.h>
+
+static int cmd_mutex(int argc, const cmd_args* argv, uint32_t flags) {
+    if (argc < 2) {
+    usage:
+        printf("usage:\n");
+        printf("%s contention        : dump contended mutex_acquire() call sites\n", argv[0].str);
+        printf("%s contention reset  : clear the contention statistics\n", argv[0].str);
+        return ZX_ERR_INTERNAL;
+    }
+
+    if (strcmp(argv[1].str, "contention"))
+        goto usage;
+
+    if (argc > 2) {
+        if (strcmp(argv[2].str, "reset"))
+            goto usage;
+        memset(contention_sites, 0, sizeof(contention_sites));
+        contention_sites_dropped = 0;
+        return ZX_OK;
+    }
+
+    printf("%18s %12s %12s\n", "caller", "spins", "blocks");
+    for (size_t i = 0; i < MUTEX_CONTENTION_SITES; i++) {
+        const struct mutex_contention_site* site = &contention_sites[i];
+        if (site->caller == 0)
+            continue;
+        printf("%#18" PRIx64 " %12" PRIu64 " %12" PRIu64 "\n",
+               site->caller, site->spins, site->blocks);
+    }
+    if (contention_sites_dropped)
+        printf("%" PRIu64 " contention events from untracked callers\n", contention_sites_dropped);
+
+    return ZX_OK;
+}
+
+STATIC_COMMAND_START
+STATIC_COMMAND("mutex", "kernel mutex statistics", &cmd_mutex)
+STATIC_COMMAND_END(mutex);
+
+#endif // WITH_LIB_CONSOLE
@@ -0,0 +1,152 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <kernel/rcu.h>
+
+#include <assert.h>
+#include <kernel/event.h>
+#include <kernel/mp.h>
+#include <kernel/percpu.h>
+#include <kernel/thread.h>
+#include <lib/counters.h>
+#include <lk/init.h>
+#include <zircon/types.h>
+
+// Pending callbacks are pushed lock free onto a lifo list, which the rcu
+// thread takes in one go. Everything it takes was queued before the grace
+// period it then waits for starts, so the whole batch can run at its end.
+//
+// Each cpu counts its quiescent states. A grace period snapshots the counts
+// of the online cpus, gives them a moment to move on by themselves, and then
+// interrupts the stragglers: a cpu can only take the interrupt outside a
+// read-side critical section, which keeps interrupts disabled.
+
+// how long a grace period waits for cpus to pass through a quiescent state
+// by themselves before interrupting them
+#define RCU_QUIESCENT_WAIT ZX_MSEC(1)
+
+KCOUNTER(rcu_grace_periods, "kernel.rcu.grace_periods");
+KCOUNTER(rcu_callbacks, "kernel.rcu.callbacks");
+KCOUNTER(rcu_forced_cpus, "kernel.rcu.forced_cpus");
+
+static rcu_head_t* rcu_pending;
+static event_t rcu_event = EVENT_INITIAL_VALUE(rcu_event, false, EVENT_FLAG_AUTOUNSIGNAL);
+
+void rcu_note_quiescent_state(void) {
+    DEBUG_ASSERT(arch_ints_disabled());
+    // only this cpu writes its count
+    struct percpu* c = get_local_percpu();
+    __atomic_store_n(&c->rcu_quiescent_count, c->rcu_quiescent_count + 1, __ATOMIC_RELEASE);
+}
+
+void rcu_call(rcu_head_t* head, rcu_func_t func) {
+    DEBUG_ASSERT(func);
+    head->func = func;
+
+    rcu_head_t* old = __atomic_load_n(&rcu_pending, __ATOMIC_RELAXED);
+    do {
+        head->next = old;
+    } while (!__atomic_compare_exchange_n(&rcu_pending, &old, head, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    // if there was already work pending the rcu thread has been signaled
+    if (old == NULL)
+        event_signal(&rcu_event, false);
+}
+
+struct rcu_sync {
+    rcu_head_t head;
+    event_t done;
+};
+
+static void rcu_sync_done(rcu_head_t* head) {
+    struct rcu_sync* sync = containerof(head, struct rcu_sync, head);
+    event_signal(&sync->done, true);
+}
+
+void rcu_synchronize(void) {
+    struct rcu_sync sync;
+    event_init(&sync.done, false, 0);
+    rcu_call(&sync.head, rcu_sync_done);
+    event_wait(&sync.done);
+    event_destroy(&sync.done);
+}
+
+// running this at all is the quiescent state
+static void rcu_quiescent_task(void* context) {}
+
+static void rcu_wait_for_grace_period(void) {
+    uint64_t counts[SMP_MAX_CPUS];
+    cpu_mask_t online = mp_get_online_mask();
+
+    // order the unpublishing of everything in the batch before the snapshot
+    smp_mb();
+    for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+        if (online & cpu_num_to_mask(i))
+            counts[i] = __atomic_load_n(&percpu[i].rcu_quiescent_count, __ATOMIC_ACQUIRE);
+    }
+
+    thread_sleep_relative(RCU_QUIESCENT_WAIT);
+
+    cpu_mask_t stragglers = 0;
+    for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+        if ((online & cpu_num_to_mask(i)) &&
+            __atomic_load_n(&percpu[i].rcu_quiescent_count, __ATOMIC_ACQUIRE) == counts[i])
+            stragglers |= cpu_num_to_mask(i);
+    }
+
+    // the cpu this thread runs on is quiescent already, and mp_sync_exec
+    // leaves it out
+    if (stragglers != 0) {
+        kcounter_add(rcu_forced_cpus, __builtin_popcount(stragglers));
+        mp_sync_exec(MP_IPI_TARGET_MASK, stragglers, rcu_quiescent_task, NULL);
+    }
+    smp_mb();
+
+    kcounter_add(rcu_grace_periods, 1u);
+}
+
+// takes every pending callback, returned in the order they were queued
+static rcu_head_t* rcu_take_all(void) {
+    rcu_head_t* list = __atomic_exchange_n(&rcu_pending, NULL, __ATOMIC_ACQUIRE);
+
+    rcu_head_t* fifo = NULL;
+    while (list) {
+        rcu_head_t* next = list->next;
+        list->next = fifo;
+        fifo = list;
+        list = next;
+    }
+    return fifo;
+}
+
+static int rcu_thread(void* arg) {
+    for (;;) {
+        event_wait(&rcu_event);
+
+        rcu_head_t* head = rcu_take_all();
+        if (head == NULL)
+            continue;
+
+        rcu_wait_for_grace_period();
+
+        while (head) {
+            // the callback may free the memory holding |head|
+            rcu_head_t* next = head->next;
+            head->func(head);
+            kcounter_add(rcu_callbacks, 1u);
+            head = next;
+        }
+    }
+    return 0;
+}
+
+static void rcu_init(unsigned int level) {
+    thread_t* t = thread_create("rcu", &rcu_thread, NULL, DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+    thread_detach_and_resume(t);
+}
+
+LK_INIT_HOOK(rcu, rcu_init, LK_INIT_LEVEL_THREADING);
@@ -23,10 +23,13 @@ MODULE_SRCS := \
 	$(LOCAL_DIR)/debug.c \
 	$(LOCAL_DIR)/dpc.c \
 	$(LOCAL_DIR)/event.c \
+	$(LOCAL_DIR)/idle.c \
 	$(LOCAL_DIR)/init.c \
+	$(LOCAL_DIR)/lockprof.c \
 	$(LOCAL_DIR)/mp.c \
 	$(LOCAL_DIR)/mutex.c \
 	$(LOCAL_DIR)/percpu.c \
+	$(LOCAL_DIR)/rcu.c \
 	$(LOCAL_DIR)/sched.c \
 	$(LOCAL_DIR)/thread.c \
 	$(LOCAL_DIR)/timer.c \
@@ -10,9 +10,13 @@
 #include <debug.h>
 #include <err.h>
 #include <inttypes.h>
+#include <kernel/idle.h>
 #include <kernel/mp.h>
 #include <kernel/percpu.h>
+#include <kernel/rcu.h>
+#include <kernel/stats.h>
 #include <kernel/thread.h>
+#include <lib/counters.h>
 #include <lib/ktrace.h>
 #include <list.h>
 #include <platform.h>
@@ -52,15 +56,144 @@
 /* threads get 10ms to run before they use up their time slice and the scheduler is invoked */
 #define THREAD_INITIAL_TIME_SLICE ZX_MSEC(10)
 
+/* disable idle work stealing */
+#define NO_STEAL 0
+
+/* minimum number of queued (not running) threads a cpu must have before an idle
+ * cpu is allowed to steal from it, or before it kicks an idle cpu to come steal */
+#define STEAL_MIN_QUEUE_DEPTH 1
+
+/* how long a thread that armed a directed wakeup may keep running before the thread it
+ * woke is sent to another cpu after all */
+#define SCHED_HANDOFF_GRACE ZX_USEC(50)
+
+/* bounds on the period of a deadline thread */
+#define DEADLINE_MIN_PERIOD ZX_USEC(100)
+#define DEADLINE_MAX_PERIOD ZX_SEC(10)
+
+/* share of each active cpu, in parts per million, that admission control will hand out
+ * to deadline threads. The rest is held back so that a full set of reservations cannot
+ * starve the priority bands. */
+#define DEADLINE_MAX_UTILIZATION_PPM 750000u
+
+/* sum of capacity / period over every deadline thread in the system, in parts per million */
+static uint64_t deadline_utilization_ppm; /* protected by thread_lock */
+
+KCOUNTER(sched_deadline_miss_count, "kernel.sched.deadline.miss");
+KCOUNTER(sched_deadline_reject_count, "kernel.sched.deadline.reject");
+KCOUNTER(sched_steal_count, "kernel.sched.steal");
+KCOUNTER(sched_steal_fail_count, "kernel.sched.steal.fail");
+KCOUNTER(sched_steal_kick_count, "kernel.sched.steal.kick");
+KCOUNTER(sched_wakeup_count, "kernel.sched.wakeup_latency.count");
+KCOUNTER(sched_wakeup_latency_total, "kernel.sched.wakeup_latency.total_ns");
+KCOUNTER(sched_slice_granted_total, "kernel.sched.slice.granted_ns");
+KCOUNTER(sched_slice_used_total, "kernel.sched.slice.used_ns");
+
 static bool local_migrate_if_needed(thread_t* curr_thread);
 
 /* compute the effective priority of a thread */
 static int effec_priority(const thread_t* t) {
-    int ep = t->base_priority + t->priority_boost;
+    int ep = MAX(t->base_priority + t->priority_boost, t->inherited_priority);
     DEBUG_ASSERT(ep >= LOWEST_PRIORITY && ep <= HIGHEST_PRIORITY);
     return ep;
 }
 
+/* a deadline thread with capacity left in its current period runs ahead of the priority
+ * bands, ordered by absolute deadline. Once its capacity is used up it falls back to its
+ * normal priority until the next period begins. */
+static bool deadline_is_eligible(const thread_t* t) {
+    return thread_is_deadline(t) && t->deadline.remaining > 0;
+}
+
+static zx_time_t deadline_absolute(const thread_t* t) {
+    return t->deadline.period_start + t->deadline.deadline;
+}
+
+static uint64_t deadline_utilization(zx_duration_t capacity, zx_duration_t period) {
+    return ((uint64_t)capacity * 1000000u) / (uint64_t)period;
+}
+
+/* start a new period for the thread if its current one is over */
+static void deadline_replenish(thread_t* t, zx_time_t now) {
+    struct thread_deadline* d = &t->deadline;
+    if (now < d->period_start + d->period)
+        return;
+
+    /* stay phase aligned if we only slipped into the next period, otherwise the thread
+     * has been blocked for a while and its new period starts now */
+    if (now < d->period_start + 2 * d->period) {
+        d->period_start += d->period;
+    } else {
+        d->period_start = now;
+    }
+    d->remaining = d->capacity;
+    d->missed = false;
+}
+
+/* charge the time the thread has run since it was last charged against its capacity.
+ * Running past the absolute deadline with capacity left over means the work for this
+ * period completed late, which is reported once per period.
+ */
+static void deadline_charge(thread_t* t, zx_time_t now) {
+    struct thread_deadline* d = &t->deadline;
+
+    zx_time_t since = MAX(t->last_started_running, d->last_charge);
+    d->last_charge = now;
+    if (now <= since)
+        return;
+
+    zx_time_t abs_deadline = deadline_absolute(t);
+    if (d->remaining > 0 && now > abs_deadline && !d->missed) {
+        zx_duration_t lateness = now - abs_deadline;
+        d->missed = true;
+
+        kcounter_add(sched_deadline_miss_count, 1u);
+        ktrace(TAG_DEADLINE_MISS, (uint32_t)t->user_tid, (uint32_t)lateness,
+               (uint32_t)(lateness >> 32), arch_curr_cpu_num());
+    }
+
+    d->remaining -= MIN(now - since, d->remaining);
+    deadline_replenish(t, now);
+}
+
+/* charge the current thread for its run time if it is in the deadline class */
+static void deadline_charge_current(thread_t* current_thread) {
+    if (thread_is_deadline(current_thread))
+        deadline_charge(current_thread, current_time());
+}
+
+/* histogram accounting, called on the local cpu with the thread lock held */
+static void sched_hist_wakeup(struct percpu* c, thread_t* t, zx_time_t now) {
+    if (t->last_woken == 0)
+        return;
+
+    zx_duration_t latency = now - t->last_woken;
+    t->last_woken = 0;
+
+    uint bucket = (latency > 1) ? (63 - __builtin_clzll(latency)) : 0;
+    c->stats.sched_hist.wakeup_latency[MIN(bucket, SCHED_HIST_LATENCY_BUCKETS - 1u)]++;
+
+    kcounter_add(sched_wakeup_count, 1u);
+    kcounter_add(sched_wakeup_latency_total, latency);
+}
+
+static void sched_hist_run_queue_depth(struct percpu* c) {
+    uint32_t depth = MIN(c->run_queue_count, SCHED_HIST_DEPTH_BUCKETS - 1u);
+    c->stats.sched_hist.run_queue_depth[depth]++;
+}
+
+static void sched_hist_slice(struct percpu* c, thread_t* t, zx_duration_t used) {
+    zx_duration_t granted = t->granted_time_slice;
+    if (granted == 0)
+        return;
+
+    uint64_t tenths = MIN(used * SCHED_HIST_SLICE_BUCKETS / granted, SCHED_HIST_SLICE_BUCKETS - 1u);
+    c->stats.sched_hist.slice_usage[tenths]++;
+
+    kcounter_add(sched_slice_granted_total, granted);
+    kcounter_add(sched_slice_used_total, MIN(used, granted));
+}
+
 /* boost the priority of the thread by +1 */
 static void boost_thread(thread_t* t) {
     if (NO_BOOST)
@@ -135,6 +268,50 @@ static cpu_mask_t rand_cpu(cpu_mask_t mask) {
     }
 }
 
+/* return the subset of |idle_mask| made up of cpus whose smt siblings are all idle too */
+static cpu_mask_t idle_core_mask(cpu_mask_t idle_mask) {
+    cpu_mask_t result = 0;
+    cpu_mask_t remaining = idle_mask;
+    while (remaining) {
+        cpu_num_t cpu = lowest_cpu_set(remaining);
+        remaining &= ~cpu_num_to_mask(cpu);
+
+        if ((percpu[cpu].sched_domain[SCHED_DOMAIN_SMT] & ~idle_mask) == 0)
+            result |= cpu_num_to_mask(cpu);
+    }
+    return result;
+}
+
+/* narrow a non empty mask of candidate idle cpus down using the topology around the
+ * cpu the thread last ran on. In order of preference:
+ *  - a fully idle physical core that shares the last level cache
+ *  - any idle logical cpu that shares the last level cache
+ *  - a fully idle physical core in the same package
+ *  - a fully idle physical core anywhere
+ *  - anything in the candidate mask
+ */
+static cpu_mask_t find_idle_cpu_mask_by_topology(cpu_num_t last_cpu, cpu_mask_t idle_mask) {
+    DEBUG_ASSERT(idle_mask != 0);
+
+    cpu_mask_t idle_cores = idle_core_mask(idle_mask);
+
+    if (is_valid_cpu_num(last_cpu)) {
+        const cpu_mask_t* domain = percpu[last_cpu].sched_domain;
+
+        if (idle_cores & domain[SCHED_DOMAIN_LLC])
+            return idle_cores & domain[SCHED_DOMAIN_LLC];
+        if (idle_mask & domain[SCHED_DOMAIN_LLC])
+            return idle_mask & domain[SCHED_DOMAIN_LLC];
+        if (idle_cores & domain[SCHED_DOMAIN_PACKAGE])
+            return idle_cores & domain[SCHED_DOMAIN_PACKAGE];
+    }
+
+    if (idle_cores)
+        return idle_cores;
+
+    return idle_mask;
+}
+
 /* find a cpu to wake up */
 static cpu_mask_t find_cpu_mask(thread_t* t) {
     /* get the last cpu the thread ran on */
@@ -167,7 +344,7 @@ static cpu_mask_t find_cpu_mask(thread_t* t) {
 
         /* pick an idle_cpu */
         DEBUG_ASSERT((idle_cpu_mask & mp_get_active_mask()) == idle_cpu_mask);
-        return rand_cpu(idle_cpu_mask);
+        return rand_cpu(find_idle_cpu_mask_by_topology(t->last_cpu, idle_cpu_mask));
     }
 
     /* no idle cpus in our affinity mask */
@@ -195,13 +372,48 @@ static cpu_mask_t find_cpu_mask(thread_t* t) {
 }
 
 /* run queue manipulation */
+
+/* if the thread is an eligible deadline thread, queue it by absolute deadline and return true */
+static bool insert_in_deadline_queue(cpu_num_t cpu, thread_t* t) {
+    if (likely(!thread_is_deadline(t)))
+        return false;
+
+    deadline_replenish(t, current_time());
+    if (!deadline_is_eligible(t))
+        return false;
+
+    struct percpu* c = &percpu[cpu];
+    zx_time_t abs_deadline = deadline_absolute(t);
+
+    /* keep FIFO order among equal deadlines */
+    thread_t* entry;
+    list_for_every_entry (&c->deadline_queue, entry, thread_t, queue_node) {
+        if (deadline_absolute(entry) > abs_deadline) {
+            list_add_before(&entry->queue_node, &t->queue_node);
+            goto inserted;
+        }
+    }
+    list_add_tail(&c->deadline_queue, &t->queue_node);
+
+inserted:
+    c->run_queue_count++;
+
+    /* mark the cpu as busy since the run queue now has at least one item in it */
+    mp_set_cpu_busy(cpu);
+    return true;
+}
+
 static void insert_in_run_queue_head(cpu_num_t cpu, thread_t* t) {
     DEBUG_ASSERT(!list_in_list(&t->queue_node));
 
+    if (insert_in_deadline_queue(cpu, t))
+        return;
+
     int ep = effec_priority(t);
 
     list_add_head(&percpu[cpu].run_queue[ep], &t->queue_node);
     percpu[cpu].run_queue_bitmap |= (1u << ep);
+    percpu[cpu].run_queue_count++;
 
     /* mark the cpu as busy since the run queue now has at least one item in it */
     mp_set_cpu_busy(cpu);
@@ -210,10 +422,14 @@ static void insert_in_run_queue_head(cpu_num_t cpu, thread_t* t) {
 static void insert_in_run_queue_tail(cpu_num_t cpu, thread_t* t) {
     DEBUG_ASSERT(!list_in_list(&t->queue_node));
 
+    if (insert_in_deadline_queue(cpu, t))
+        return;
+
     int ep = effec_priority(t);
 
     list_add_tail(&percpu[cpu].run_queue[ep], &t->queue_node);
     percpu[cpu].run_queue_bitmap |= (1u << ep);
+    percpu[cpu].run_queue_count++;
 
     /* mark the cpu as busy since the run queue now has at least one item in it */
     mp_set_cpu_busy(cpu);
@@ -224,6 +440,24 @@ static thread_t* sched_get_top_thread(cpu_num_t cpu) {
      * queued up on the passed in cpu.
      */
     struct percpu* c = &percpu[cpu];
+
+    /* eligible deadline threads go first, earliest deadline first */
+    if (unlikely(!list_is_empty(&c->deadline_queue))) {
+        thread_t* newthread = list_remove_head_type(&c->deadline_queue, thread_t, queue_node);
+
+        DEBUG_ASSERT(newthread);
+        DEBUG_ASSERT(newthread->curr_cpu == cpu);
+        DEBUG_ASSERT(c->run_queue_count > 0);
+        c->run_queue_count--;
+        if (newthread == c->handoff_thread)
+            c->handoff_thread = NULL;
+
+        LOCAL_KTRACE2("sched_get_top deadline", (uint32_t)newthread->user_tid,
+                      (uint32_t)newthread->deadline.remaining);
+
+        return newthread;
+    }
+
     if (likely(c->run_queue_bitmap)) {
         uint highest_queue = HIGHEST_PRIORITY - __builtin_clz(c->run_queue_bitmap) -
                              (sizeof(c->run_queue_bitmap) * CHAR_BIT - NUM_PRIORITIES);
@@ -239,6 +473,11 @@ static thread_t* sched_get_top_thread(cpu_num_t cpu) {
         if (list_is_empty(&c->run_queue[highest_queue]))
             c->run_queue_bitmap &= ~(1u << highest_queue);
 
+        DEBUG_ASSERT(c->run_queue_count > 0);
+        c->run_queue_count--;
+        if (newthread == c->handoff_thread)
+            c->handoff_thread = NULL;
+
         LOCAL_KTRACE2("sched_get_top", newthread->priority_boost, newthread->base_priority);
 
         return newthread;
@@ -248,24 +487,210 @@ static thread_t* sched_get_top_thread(cpu_num_t cpu) {
     return &c->idle_thread;
 }
 
+/* pull a thread out of the middle of |cpu|'s run queue */
+static void remove_from_run_queue(cpu_num_t cpu, thread_t* t) {
+    DEBUG_ASSERT(list_in_list(&t->queue_node));
+
+    struct percpu* c = &percpu[cpu];
+
+    list_delete(&t->queue_node);
+
+    /* eligibility only changes while a thread runs, so this tells us which queue it was in */
+    if (!deadline_is_eligible(t)) {
+        int pri = effec_priority(t);
+        if (list_is_empty(&c->run_queue[pri])) {
+            c->run_queue_bitmap &= ~(1u << pri);
+        }
+    }
+
+    DEBUG_ASSERT(c->run_queue_count > 0);
+    c->run_queue_count--;
+    if (t == c->handoff_thread)
+        c->handoff_thread = NULL;
+}
+
+/* find the cpu in |mask| with the deepest run queue */
+static cpu_num_t find_busiest_cpu_in_mask(cpu_mask_t mask) {
+    cpu_num_t busiest = INVALID_CPU;
+    uint32_t busiest_count = STEAL_MIN_QUEUE_DEPTH - 1;
+    while (mask) {
+        cpu_num_t i = lowest_cpu_set(mask);
+        mask &= ~cpu_num_to_mask(i);
+
+        if (percpu[i].run_queue_count > busiest_count) {
+            busiest = i;
+            busiest_count = percpu[i].run_queue_count;
+        }
+    }
+
+    return busiest;
+}
+
+/* find the active cpu other than |cpu| with the deepest run queue, preferring
+ * cpus that share a last level cache with |cpu| */
+static cpu_num_t find_busiest_cpu(cpu_num_t cpu) {
+    cpu_mask_t active = mp_get_active_mask() & ~cpu_num_to_mask(cpu);
+
+    cpu_num_t busiest = find_busiest_cpu_in_mask(active & percpu[cpu].sched_domain[SCHED_DOMAIN_LLC]);
+    if (busiest == INVALID_CPU)
+        busiest = find_busiest_cpu_in_mask(active);
+
+    return busiest;
+}
+
+/* called on an otherwise idle cpu to try to pull a runnable thread off of the cpu with
+ * the most threads waiting to run. Walks the victim's run queues from the highest priority
+ * down, taking the thread at the tail of each queue since it is the one that would wait the
+ * longest and is the least likely to still have a warm cache on the victim.
+ * Returns NULL if there was nothing eligible to steal.
+ */
+static thread_t* sched_steal_thread(cpu_num_t cpu) {
+    if (NO_STEAL)
+        return NULL;
+
+    cpu_num_t victim = find_busiest_cpu(cpu);
+    if (victim == INVALID_CPU)
+        return NULL;
+
+    struct percpu* vc = &percpu[victim];
+    cpu_mask_t cpu_mask = cpu_num_to_mask(cpu);
+    uint32_t bitmap = vc->run_queue_bitmap;
+    while (bitmap) {
+        int pri = HIGHEST_PRIORITY - __builtin_clz(bitmap) -
+                  (int)(sizeof(bitmap) * CHAR_BIT - NUM_PRIORITIES);
+        bitmap &= ~(1u << pri);
+
+        thread_t* t = list_peek_tail_type(&vc->run_queue[pri], thread_t, queue_node);
+        while (t) {
+            DEBUG_ASSERT(t->magic == THREAD_MAGIC);
+            DEBUG_ASSERT(t->state == THREAD_READY);
+            DEBUG_ASSERT(t->curr_cpu == victim);
+
+            if (t->cpu_affinity & cpu_mask) {
+                remove_from_run_queue(victim, t);
+                t->curr_cpu = cpu;
+
+                CPU_STATS_INC(steals);
+                kcounter_add(sched_steal_count, 1u);
+                LOCAL_KTRACE2("sched_steal", (uint32_t)t->user_tid, victim);
+
+                return t;
+            }
+
+            t = list_prev_type(&vc->run_queue[pri], &t->queue_node, thread_t, queue_node);
+        }
+    }
+
+    /* everything queued on the victim is pinned away from us */
+    kcounter_add(sched_steal_fail_count, 1u);
+    return NULL;
+}
+
+/* called on a busy cpu whose run queue is backed up to poke an idle cpu into
+ * rescheduling, which will cause it to come steal from us via sched_steal_thread().
+ * This is the periodic half of the balancer: it is driven off of quantum expiration,
+ * so a cpu that is idle costs nothing until somebody else has work for it.
+ */
+static void kick_idle_cpu_if_needed(cpu_num_t cpu) {
+    if (NO_STEAL)
+        return;
+
+    if (percpu[cpu].run_queue_count < STEAL_MIN_QUEUE_DEPTH)
+        return;
+
+    cpu_mask_t idle = mp_get_idle_mask() & mp_get_active_mask() & ~cpu_num_to_mask(cpu);
+    if (idle == 0)
+        return;
+
+    cpu_mask_t target = rand_cpu(idle);
+    if (target == 0)
+        return;
+
+    CPU_STATS_INC(steal_kicks);
+    kcounter_add(sched_steal_kick_count, 1u);
+    sched_defer_reschedule_ipi(target);
+}
+
+/* Sending an IPI is not free, and the cpus we send them to head straight for the thread lock,
+ * so hold them back until this cpu lets go of it; see thread_lock_release(). */
+void sched_defer_reschedule_ipi(cpu_mask_t mask) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    get_local_percpu()->deferred_resched_mask |= mask;
+}
+
 void sched_block(void) {
     DEBUG_ASSERT(spin_lock_held(&thread_lock));
 
-    __UNUSED thread_t* current_thread = get_current_thread();
+    thread_t* current_thread = get_current_thread();
 
     DEBUG_ASSERT(current_thread->magic == THREAD_MAGIC);
     DEBUG_ASSERT(current_thread->state != THREAD_RUNNING);
 
     LOCAL_KTRACE0("sched_block");
 
+    deadline_charge_current(current_thread);
+    idle_latency_block(current_thread);
+
     /* we are blocking on something. the blocking code should have already stuck us on a queue */
     sched_resched_internal();
 }
 
+/* the waker kept running past its grace period, give the thread it handed off to a normal
+ * wakeup so it is not stuck behind it */
+static enum handler_return sched_handoff_timeout(timer_t* timer, zx_time_t now,
+                                                 void* arg) TA_NO_THREAD_SAFETY_ANALYSIS;
+
+/* if the current thread armed a directed wakeup, queue |t| at the front of the local cpu
+ * and return true */
+static bool handoff_insert(thread_t* t) {
+    thread_t* current_thread = get_current_thread();
+    if (likely(!current_thread->handoff_armed) || arch_in_int_handler())
+        return false;
+
+    /* only the first thread woken gets the cpu */
+    current_thread->handoff_armed = false;
+
+    cpu_num_t cpu = arch_curr_cpu_num();
+    if (!(t->cpu_affinity & cpu_num_to_mask(cpu)) || thread_is_deadline(t) ||
+        thread_is_idle(current_thread))
+        return false;
+
+    struct percpu* c = &percpu[cpu];
+    if (c->handoff_thread)
+        return false;
+
+    /* donate what is left of our time slice */
+    zx_time_t now = current_time();
+    zx_duration_t used = now - current_thread->last_started_running;
+    zx_duration_t left = current_thread->remaining_time_slice -
+                         MIN(used, current_thread->remaining_time_slice);
+    if (left > t->remaining_time_slice)
+        t->remaining_time_slice = left;
+
+    t->curr_cpu = cpu;
+    insert_in_run_queue_head(cpu, t);
+
+    c->handoff_thread = t;
+    timer_reset_oneshot_local(&c->handoff_timer, now + SCHED_HANDOFF_GRACE,
+                              sched_handoff_timeout, NULL);
+
+    CPU_STATS_INC(handoffs);
+    LOCAL_KTRACE2("sched_handoff", (uint32_t)t->user_tid, (uint32_t)left);
+    return true;
+}
+
+static void sched_restart_tick(cpu_num_t cpu, thread_t* t);
+
 /* find a cpu to run the thread on, put it in the run queue for that cpu, and accumulate a list
  * of cpus we'll need to reschedule, including the local cpu.
  */
 static void find_cpu_and_insert(thread_t* t, bool* local_resched, cpu_mask_t* accum_cpu_mask) {
+    /* a directed wakeup runs it here as soon as the current thread blocks, so there is
+     * nothing to reschedule now */
+    if (handoff_insert(t))
+        return;
+
     /* find a core to run it on */
     cpu_mask_t cpu = find_cpu_mask(t);
     cpu_num_t cpu_num;
@@ -285,6 +710,14 @@ static void find_cpu_and_insert(thread_t* t, bool* local_resched, cpu_mask_t* ac
     } else {
         insert_in_run_queue_tail(cpu_num, t);
     }
+
+    /* a waker that doesn't reschedule, like a semaphore post or a dpc, would leave the
+     * current thread with the cpu to itself and no tick to preempt it. other cpus restart
+     * theirs when the reschedule ipi comes in. */
+    thread_t* current_thread = get_current_thread();
+    if (cpu_num == arch_curr_cpu_num() && unlikely(percpu[cpu_num].preempt_tick_stopped) &&
+        !thread_is_real_time_or_idle(current_thread))
+        sched_restart_tick(cpu_num, current_thread);
 }
 
 bool sched_unblock(thread_t* t) {
@@ -296,16 +729,18 @@ bool sched_unblock(thread_t* t) {
 
     /* thread is being woken up, boost its priority */
     boost_thread(t);
+    idle_latency_unblock(t);
 
     /* stuff the new thread in the run queue */
     t->state = THREAD_READY;
+    t->last_woken = current_time();
 
     bool local_resched = false;
     cpu_mask_t mask = 0;
     find_cpu_and_insert(t, &local_resched, &mask);
 
     if (mask)
-        mp_reschedule(MP_IPI_TARGET_MASK, mask, 0);
+        sched_defer_reschedule_ipi(mask);
     return local_resched;
 }
 
@@ -318,6 +753,7 @@ bool sched_unblock_list(struct list_node* list) {
     /* pop the list of threads and shove into the scheduler */
     bool local_resched = false;
     cpu_mask_t accum_cpu_mask = 0;
+    zx_time_t now = current_time();
     thread_t* t;
     while ((t = list_remove_tail_type(list, thread_t, queue_node))) {
         DEBUG_ASSERT(t->magic == THREAD_MAGIC);
@@ -325,14 +761,16 @@ bool sched_unblock_list(struct list_node* list) {
 
         /* thread is being woken up, boost its priority */
         boost_thread(t);
+        idle_latency_unblock(t);
 
         /* stuff the new thread in the run queue */
         t->state = THREAD_READY;
+        t->last_woken = now;
         find_cpu_and_insert(t, &local_resched, &accum_cpu_mask);
     }
 
     if (accum_cpu_mask)
-        mp_reschedule(MP_IPI_TARGET_MASK, accum_cpu_mask, 0);
+        sched_defer_reschedule_ipi(accum_cpu_mask);
 
     return local_resched;
 }
@@ -362,6 +800,8 @@ void sched_yield(void) {
 
     LOCAL_KTRACE0("sched_yield");
 
+    deadline_charge_current(current_thread);
+
     /* consume the rest of the time slice, deboost ourself, and go to the end of a queue */
     current_thread->remaining_time_slice = 0;
     deboost_thread(current_thread, false);
@@ -386,6 +826,8 @@ void sched_preempt(void) {
     DEBUG_ASSERT(current_thread->last_cpu == current_thread->curr_cpu);
     LOCAL_KTRACE0("sched_preempt");
 
+    deadline_charge_current(current_thread);
+
     current_thread->state = THREAD_READY;
 
     /* idle thread doesn't go in the run queue */
@@ -402,6 +844,10 @@ void sched_preempt(void) {
             insert_in_run_queue_head(curr_cpu, current_thread);
         } else {
             insert_in_run_queue_tail(curr_cpu, current_thread);
+
+            /* we used up a full quantum and are about to go to the back of the line,
+             * see if someone idle could be running us instead */
+            kick_idle_cpu_if_needed(curr_cpu);
         }
     }
 
@@ -424,6 +870,8 @@ void sched_reschedule(void) {
     DEBUG_ASSERT(current_thread->last_cpu == current_thread->curr_cpu);
     LOCAL_KTRACE0("sched_reschedule");
 
+    deadline_charge_current(current_thread);
+
     current_thread->state = THREAD_READY;
 
     /* idle thread doesn't go in the run queue */
@@ -451,10 +899,11 @@ static void migrate_current_thread(thread_t* current_thread) {
     cpu_mask_t accum_cpu_mask = 0;
 
     // current thread, so just shove ourself into another cpu's queue and reschedule locally
+    deadline_charge_current(current_thread);
     current_thread->state = THREAD_READY;
     find_cpu_and_insert(current_thread, &local_resched, &accum_cpu_mask);
     if (accum_cpu_mask)
-        mp_reschedule(MP_IPI_TARGET_MASK, accum_cpu_mask, 0);
+        sched_defer_reschedule_ipi(accum_cpu_mask);
     sched_resched_internal();
 }
 
@@ -474,7 +923,7 @@ void sched_transition_off_cpu(cpu_num_t old_cpu) {
     }
 
     if (accum_cpu_mask) {
-        mp_reschedule(MP_IPI_TARGET_MASK, accum_cpu_mask, 0);
+        sched_defer_reschedule_ipi(accum_cpu_mask);
     }
 }
 
@@ -528,15 +977,9 @@ void sched_migrate(thread_t* t) {
 
         // it's sitting in a run queue somewhere, so pull it out of that one and find a new home
         DEBUG_ASSERT_MSG(list_in_list(&t->queue_node), "thread %p name %s curr_cpu %u\n", t, t->name, t->curr_cpu);
-        list_delete(&t->queue_node);
-
         DEBUG_ASSERT(is_valid_cpu_num(t->curr_cpu));
 
-        struct percpu* c = &percpu[t->curr_cpu];
-        int pri = effec_priority(t);
-        if (list_is_empty(&c->run_queue[pri])) {
-            c->run_queue_bitmap &= ~(1u << pri);
-        }
+        remove_from_run_queue(t->curr_cpu, t);
 
         find_cpu_and_insert(t, &local_resched, &accum_cpu_mask);
         break;
@@ -547,13 +990,20 @@ void sched_migrate(thread_t* t) {
 
     // send some ipis based on the previous code
     if (accum_cpu_mask) {
-        mp_reschedule(MP_IPI_TARGET_MASK, accum_cpu_mask, 0);
+        sched_defer_reschedule_ipi(accum_cpu_mask);
     }
     if (local_resched) {
         sched_reschedule();
     }
 }
 
+/* a thread that has nothing else queued behind it on its cpu has nobody to share its time
+ * slice with, so there is no point taking preemption interrupts. Deadline threads are the
+ * exception, the timer also enforces their capacity. */
+static bool sched_can_stop_tick(cpu_num_t cpu, thread_t* t) {
+    return percpu[cpu].run_queue_count == 0 && !deadline_is_eligible(t);
+}
+
 /* preemption timer that is set whenever a thread is scheduled */
 static enum handler_return sched_timer_tick(timer_t* t, zx_time_t now, void* arg) {
     /* if the preemption timer went off on the idle or a real time thread, ignore it */
@@ -563,6 +1013,17 @@ static enum handler_return sched_timer_tick(timer_t* t, zx_time_t now, void* arg
 
     LOCAL_KTRACE2("timer_tick", (uint32_t)current_thread->user_tid, current_thread->remaining_time_slice);
 
+    /* has a deadline thread used up its capacity for this period? */
+    if (deadline_is_eligible(current_thread)) {
+        zx_time_t since = MAX(current_thread->last_started_running,
+                              current_thread->deadline.last_charge);
+        if (now - since >= current_thread->deadline.remaining) {
+            /* let sched_preempt() charge it and drop it back into its priority band */
+            timer_set_oneshot(t, now + THREAD_INITIAL_TIME_SLICE, sched_timer_tick, NULL);
+            return INT_RESCHEDULE;
+        }
+    }
+
     /* did this tick complete the time slice? */
     DEBUG_ASSERT(now > current_thread->last_started_running);
     zx_time_t delta = now - current_thread->last_started_running;
@@ -570,8 +1031,14 @@ static enum handler_return sched_timer_tick(timer_t* t, zx_time_t now, void* arg
         /* we completed the time slice, do not restart it and let the scheduler run */
         current_thread->remaining_time_slice = 0;
 
-        /* set a timer to go off on the time slice interval from now */
-        timer_set_oneshot(t, now + THREAD_INITIAL_TIME_SLICE, sched_timer_tick, NULL);
+        /* set a timer to go off on the time slice interval from now, unless there is nobody
+         * waiting for the cpu */
+        cpu_num_t cpu = arch_curr_cpu_num();
+        if (sched_can_stop_tick(cpu, current_thread)) {
+            percpu[cpu].preempt_tick_stopped = true;
+        } else {
+            timer_set_oneshot(t, now + THREAD_INITIAL_TIME_SLICE, sched_timer_tick, NULL);
+        }
 
         /* the irq handler will call back into us with sched_preempt() */
         return INT_RESCHEDULE;
@@ -583,6 +1050,26 @@ static enum handler_return sched_timer_tick(timer_t* t, zx_time_t now, void* arg
     }
 }
 
+/* another thread has become runnable behind the current one, which had the cpu to itself,
+ * so start charging it for the cpu again. Time spent running alone is not held against it. */
+static void sched_restart_tick(cpu_num_t cpu, thread_t* t) {
+    DEBUG_ASSERT(arch_ints_disabled());
+    DEBUG_ASSERT(!thread_is_real_time_or_idle(t));
+
+    zx_time_t now = current_time();
+    t->runtime_ns += now - t->last_started_running;
+    t->last_started_running = now;
+    if (t->remaining_time_slice == 0)
+        t->remaining_time_slice = THREAD_INITIAL_TIME_SLICE;
+
+    zx_time_t preempt_time = now + t->remaining_time_slice;
+    if (deadline_is_eligible(t))
+        preempt_time = MIN(preempt_time, now + t->deadline.remaining);
+
+    percpu[cpu].preempt_tick_stopped = false;
+    timer_reset_oneshot_local(&percpu[cpu].preempt_timer, preempt_time, sched_timer_tick, NULL);
+}
+
 // On ARM64 with safe-stack, it's no longer possible to use the unsafe-sp
 // after set_current_thread (we'd now see newthread's unsafe-sp instead!).
 // Hence this function and everything it calls between this point and the
@@ -610,12 +1097,20 @@ void sched_resched_internal(void) {
     DEBUG_ASSERT(!arch_in_int_handler());
 
     CPU_STATS_INC(reschedules);
+    sched_hist_run_queue_depth(&percpu[cpu]);
 
     /* pick a new thread to run */
     thread_t* newthread = sched_get_top_thread(cpu);
 
     DEBUG_ASSERT(newthread);
 
+    /* nothing to do locally, see if we can take some work off of a busier cpu */
+    if (thread_is_idle(newthread) && mp_is_cpu_active(cpu)) {
+        thread_t* stolen = sched_steal_thread(cpu);
+        if (stolen)
+            newthread = stolen;
+    }
+
     newthread->state = THREAD_RUNNING;
 
     thread_t* oldthread = current_thread;
@@ -624,8 +1119,12 @@ void sched_resched_internal(void) {
     LOCAL_KTRACE2("resched new pri", (uint32_t)newthread->user_tid, effec_priority(newthread));
 
     /* if it's the same thread as we're already running, exit */
-    if (newthread == oldthread)
+    if (newthread == oldthread) {
+        if (unlikely(percpu[cpu].preempt_tick_stopped) &&
+            !thread_is_real_time_or_idle(newthread) && !sched_can_stop_tick(cpu, newthread))
+            sched_restart_tick(cpu, newthread);
         return;
+    }
 
     zx_time_t now = current_time();
 
@@ -634,6 +1133,8 @@ void sched_resched_internal(void) {
     zx_duration_t old_runtime = now - oldthread->last_started_running;
     oldthread->runtime_ns += old_runtime;
     oldthread->remaining_time_slice -= MIN(old_runtime, oldthread->remaining_time_slice);
+    if (!thread_is_idle(oldthread))
+        sched_hist_slice(&percpu[cpu], oldthread, old_runtime);
 
     /* set up quantum for the new thread if it was consumed */
     if (newthread->remaining_time_slice == 0) {
@@ -641,10 +1142,14 @@ void sched_resched_internal(void) {
     }
 
     newthread->last_started_running = now;
+    newthread->granted_time_slice = newthread->remaining_time_slice;
+    sched_hist_wakeup(&percpu[cpu], newthread, now);
 
     /* mark the cpu ownership of the threads */
     if (oldthread->state != THREAD_READY)
         oldthread->curr_cpu = INVALID_CPU;
+    if (newthread->last_cpu != cpu && newthread->last_cpu != INVALID_CPU)
+        newthread->migrations++;
     newthread->last_cpu = cpu;
     newthread->curr_cpu = cpu;
 
@@ -662,6 +1167,9 @@ void sched_resched_internal(void) {
 
     CPU_STATS_INC(context_switches);
 
+    /* read-side critical sections can't span a context switch */
+    rcu_note_quiescent_state();
+
     if (thread_is_idle(oldthread)) {
         percpu[cpu].stats.idle_time += now - oldthread->last_started_running;
     }
@@ -672,14 +1180,17 @@ void sched_resched_internal(void) {
     ktrace(TAG_CONTEXT_SWITCH, (uint32_t)newthread->user_tid, cpu | (oldthread->state << 16),
            (uint32_t)(uintptr_t)oldthread, (uint32_t)(uintptr_t)newthread);
 
-    if (thread_is_real_time_or_idle(newthread)) {
+    percpu[cpu].preempt_tick_stopped = false;
+    if (thread_is_real_time_or_idle(newthread) || sched_can_stop_tick(cpu, newthread)) {
         if (!thread_is_real_time_or_idle(oldthread)) {
-            /* if we're switching from a non real time to a real time, cancel
-             * the preemption timer. */
+            /* if we're switching from a non real time to a real time, or to a thread that
+             * has the cpu to itself, cancel the preemption timer. */
             TRACE_CONTEXT_SWITCH("stop preempt, cpu %u, old %p (%s), new %p (%s)\n",
                                  cpu, oldthread, oldthread->name, newthread, newthread->name);
             timer_cancel(&percpu[cpu].preempt_timer);
         }
+        if (!thread_is_real_time_or_idle(newthread))
+            percpu[cpu].preempt_tick_stopped = true;
     } else {
         /* set up a one shot timer to handle the remaining time slice on this thread */
         TRACE_CONTEXT_SWITCH("start preempt, cpu %u, old %p (%s), new %p (%s)\n",
@@ -691,7 +1202,13 @@ void sched_resched_internal(void) {
         /* use a special version of the timer set api that lets it reset an existing timer efficiently, given
          * that we cannot possibly race with our own timer because interrupts are disabled.
          */
-        timer_reset_oneshot_local(&percpu[cpu].preempt_timer, now + newthread->remaining_time_slice, sched_timer_tick, NULL);
+        zx_time_t preempt_time = now + newthread->remaining_time_slice;
+
+        /* a deadline thread also needs to be stopped when it runs out of capacity */
+        if (deadline_is_eligible(newthread))
+            preempt_time = MIN(preempt_time, now + newthread->deadline.remaining);
+
+        timer_reset_oneshot_local(&percpu[cpu].preempt_timer, preempt_time, sched_timer_tick, NULL);
     }
 
     /* set some optional target debug leds */
@@ -736,9 +1253,164 @@ void sched_resched_internal(void) {
     final_context_switch(oldthread, newthread);
 }
 
+zx_status_t sched_set_deadline(thread_t* t, zx_duration_t capacity, zx_duration_t deadline,
+                               zx_duration_t period) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+    DEBUG_ASSERT(t->magic == THREAD_MAGIC);
+
+    if (thread_is_idle(t))
+        return ZX_ERR_INVALID_ARGS;
+
+    if (capacity == 0) {
+        if (!thread_is_deadline(t))
+            return ZX_OK;
+        deadline = period = 0;
+    } else if (period < DEADLINE_MIN_PERIOD || period > DEADLINE_MAX_PERIOD ||
+               deadline > period || capacity > deadline) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    /* admission control: the sum of all reservations must fit in the share of the active cpus
+     * we are willing to give up, and a single thread can only ever use one cpu at a time */
+    uint64_t old_util = thread_is_deadline(t) ?
+        deadline_utilization(t->deadline.capacity, t->deadline.period) : 0;
+    uint64_t new_util = capacity ? deadline_utilization(capacity, period) : 0;
+    uint64_t limit = (uint64_t)DEADLINE_MAX_UTILIZATION_PPM *
+                     (uint64_t)__builtin_popcount(mp_get_active_mask());
+    if (new_util > old_util &&
+        (new_util > DEADLINE_MAX_UTILIZATION_PPM ||
+         deadline_utilization_ppm - old_util + new_util > limit)) {
+        kcounter_add(sched_deadline_reject_count, 1u);
+        return ZX_ERR_NO_RESOURCES;
+    }
+    deadline_utilization_ppm = deadline_utilization_ppm - old_util + new_util;
+
+    /* a queued thread may have to move between the deadline and priority queues */
+    bool requeue = (t->state == THREAD_READY);
+    if (requeue)
+        remove_from_run_queue(t->curr_cpu, t);
+
+    zx_time_t now = current_time();
+    t->deadline.capacity = capacity;
+    t->deadline.deadline = deadline;
+    t->deadline.period = period;
+    t->deadline.period_start = now;
+    t->deadline.remaining = capacity;
+    t->deadline.last_charge = now;
+    t->deadline.missed = false;
+
+    if (requeue) {
+        cpu_num_t cpu = t->curr_cpu;
+        insert_in_run_queue_tail(cpu, t);
+        if (cpu != arch_curr_cpu_num())
+            sched_defer_reschedule_ipi(cpu_num_to_mask(cpu));
+    }
+
+    return ZX_OK;
+}
+
+int sched_get_effective_priority(const thread_t* t) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    return effec_priority(t);
+}
+
+void sched_inherit_priority(thread_t* t, int priority) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+    DEBUG_ASSERT(priority >= LOWEST_PRIORITY && priority <= HIGHEST_PRIORITY);
+
+    int old_ep = effec_priority(t);
+    bool requeue = (t->state == THREAD_READY) && !deadline_is_eligible(t);
+
+    /* a queued thread has to move to the run queue of its new priority */
+    if (requeue && MAX(t->base_priority + t->priority_boost, priority) != old_ep)
+        remove_from_run_queue(t->curr_cpu, t);
+    else
+        requeue = false;
+
+    t->inherited_priority = priority;
+
+    int new_ep = effec_priority(t);
+    if (new_ep == old_ep)
+        return;
+
+    LOCAL_KTRACE2("sched_inherit", (uint32_t)t->user_tid, new_ep);
+
+    if (requeue) {
+        cpu_num_t cpu = t->curr_cpu;
+        insert_in_run_queue_head(cpu, t);
+        if (cpu != arch_curr_cpu_num())
+            sched_defer_reschedule_ipi(cpu_num_to_mask(cpu));
+    } else if (t->state == THREAD_RUNNING && new_ep < old_ep &&
+               t->curr_cpu != arch_curr_cpu_num()) {
+        /* losing the boost may let a queued thread preempt it */
+        sched_defer_reschedule_ipi(cpu_num_to_mask(t->curr_cpu));
+    }
+}
+
+static enum handler_return sched_handoff_timeout(timer_t* timer, zx_time_t now, void* arg) {
+    struct percpu* c = get_local_percpu();
+
+    /* the handoff timer is only ever set on its own cpu with interrupts disabled, so nobody
+     * holding the thread lock can be waiting on us */
+    spin_lock(&thread_lock);
+
+    bool local_resched = false;
+    thread_t* t = c->handoff_thread;
+    if (t) {
+        DEBUG_ASSERT(t->state == THREAD_READY);
+        DEBUG_ASSERT(t->curr_cpu == arch_curr_cpu_num());
+
+        remove_from_run_queue(t->curr_cpu, t);
+
+        cpu_mask_t mask = 0;
+        find_cpu_and_insert(t, &local_resched, &mask);
+        if (mask)
+            sched_defer_reschedule_ipi(mask);
+
+        CPU_STATS_INC(handoff_timeouts);
+    }
+
+    thread_lock_release();
+
+    /* if it landed back here, the waker has to give way to it now rather than at some
+     * unrelated reschedule */
+    return local_resched ? INT_RESCHEDULE : INT_NO_RESCHEDULE;
+}
+
+void sched_handoff_arm(void) {
+    get_current_thread()->handoff_armed = true;
+}
+
+void sched_handoff_disarm(void) {
+    get_current_thread()->handoff_armed = false;
+}
+
+void sched_set_cpu_domains(cpu_num_t cpu, const cpu_mask_t domains[SCHED_DOMAIN_COUNT]) {
+    DEBUG_ASSERT(is_valid_cpu_num(cpu));
+
+    THREAD_LOCK(state);
+    for (unsigned int i = 0; i < SCHED_DOMAIN_COUNT; i++) {
+        /* every domain must at least contain the cpu itself and nest inside the next one */
+        DEBUG_ASSERT(domains[i] & cpu_num_to_mask(cpu));
+        DEBUG_ASSERT(i == 0 || (domains[i - 1] & ~domains[i]) == 0);
+        percpu[cpu].sched_domain[i] = domains[i] | cpu_num_to_mask(cpu);
+    }
+    THREAD_UNLOCK(state);
+}
+
 void sched_init_early(void) {
     /* initialize the run queues */
-    for (unsigned int cpu = 0; cpu < SMP_MAX_CPUS; cpu++)
+    for (unsigned int cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
         for (unsigned int i = 0; i < NUM_PRIORITIES; i++)
             list_initialize(&percpu[cpu].run_queue[i]);
+        list_initialize(&percpu[cpu].deadline_queue);
+
+        list_initialize(&percpu[cpu].idle.latency_waiters);
+        percpu[cpu].idle.latency_tolerance = ZX_TIME_INFINITE;
+
+        /* until the architecture tells us otherwise, every cpu is its own domain */
+        for (unsigned int i = 0; i < SCHED_DOMAIN_COUNT; i++)
+            percpu[cpu].sched_domain[i] = cpu_num_to_mask(cpu);
+    }
 }
@@ -24,6 +24,7 @@
 
 #include <kernel/atomic.h>
 #include <kernel/dpc.h>
+#include <kernel/idle.h>
 #include <kernel/mp.h>
 #include <kernel/percpu.h>
 #include <kernel/sched.h>
@@ -63,6 +64,26 @@ static struct list_node thread_list = LIST_INITIAL_VALUE(thread_list);
 /* master thread spinlock */
 spin_lock_t thread_lock = SPIN_LOCK_INITIAL_VALUE;
 
+void thread_lock_release(void) TA_NO_THREAD_SAFETY_ANALYSIS {
+    DEBUG_ASSERT(arch_ints_disabled());
+
+    /* interrupts stay disabled until our caller restores them, so we are still on the cpu
+     * that queued these */
+    struct percpu* c = get_local_percpu();
+    cpu_mask_t mask = c->deferred_resched_mask;
+    c->deferred_resched_mask = 0;
+
+    spin_unlock(&thread_lock);
+
+    if (mask)
+        mp_reschedule(MP_IPI_TARGET_MASK, mask, 0);
+}
+
+void thread_lock_release_irqrestore(spin_lock_saved_state_t state) TA_NO_THREAD_SAFETY_ANALYSIS {
+    thread_lock_release();
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+}
+
 /* local routines */
 static int idle_thread_routine(void*) __NO_RETURN;
 static void thread_exit_locked(thread_t* current_thread, int retcode) __NO_RETURN;
@@ -73,6 +94,7 @@ static void init_thread_struct(thread_t* t, const char* name) {
     t->magic = THREAD_MAGIC;
     strlcpy(t->name, name, sizeof(t->name));
     wait_queue_init(&t->retcode_wait_queue);
+    t->idle_latency = ZX_TIME_INFINITE;
 }
 
 static void initial_thread_func(void) TA_REQ(thread_lock) __NO_RETURN;
@@ -80,7 +102,7 @@ static void initial_thread_func(void) {
     int ret;
 
     /* release the thread lock that was implicitly held across the reschedule */
-    spin_unlock(&thread_lock);
+    thread_lock_release();
     arch_enable_ints();
 
     thread_t* ct = get_current_thread();
@@ -141,6 +163,8 @@ thread_t* thread_create_etc(
     t->arg = arg;
     t->base_priority = priority;
     t->priority_boost = 0;
+    t->inherited_priority = LOWEST_PRIORITY;
+    t->handoff_armed = false;
     t->state = THREAD_INITIAL;
     t->signals = 0;
     t->blocking_wait_queue = NULL;
@@ -268,6 +292,52 @@ zx_status_t thread_set_real_time(thread_t* t) {
     return ZX_OK;
 }
 
+/**
+ * @brief  Place a thread in the deadline scheduling class
+ *
+ * While a deadline thread has capacity left in its current period it is run
+ * ahead of every priority band, earliest absolute deadline first. Once the
+ * capacity is used up it runs at its normal priority until the next period.
+ *
+ * @param t         Thread to change
+ * @param capacity  Run time guaranteed per period, or 0 to leave the class
+ * @param deadline  Time from the start of a period by which |capacity| is delivered
+ * @param period    Length of a period
+ *
+ * @return ZX_OK on success, ZX_ERR_INVALID_ARGS for inconsistent parameters, or
+ * ZX_ERR_NO_RESOURCES if admission control rejected the reservation.
+ */
+zx_status_t thread_set_deadline(thread_t* t, zx_duration_t capacity, zx_duration_t deadline,
+                                zx_duration_t period) {
+    if (!t)
+        return ZX_ERR_INVALID_ARGS;
+
+    DEBUG_ASSERT(t->magic == THREAD_MAGIC);
+
+    THREAD_LOCK(state);
+    zx_status_t status = (t->state == THREAD_DEATH) ? ZX_ERR_BAD_STATE :
+                         sched_set_deadline(t, capacity, deadline, period);
+    if (status == ZX_OK)
+        idle_latency_update(t);
+    THREAD_UNLOCK(state);
+
+    return status;
+}
+
+zx_status_t thread_set_idle_latency(thread_t* t, zx_duration_t latency) {
+    if (!t || latency < 0)
+        return ZX_ERR_INVALID_ARGS;
+
+    DEBUG_ASSERT(t->magic == THREAD_MAGIC);
+
+    THREAD_LOCK(state);
+    t->idle_latency = latency;
+    idle_latency_update(t);
+    THREAD_UNLOCK(state);
+
+    return ZX_OK;
+}
+
 /**
  * @brief  Make a suspended thread executable.
  *
@@ -356,7 +426,7 @@ zx_status_t thread_suspend(thread_t* t) {
         /* The following call is not essential.  It just makes the
              * thread suspension happen sooner rather than at the next
              * timer interrupt or syscall. */
-        mp_reschedule(MP_IPI_TARGET_MASK, cpu_num_to_mask(t->curr_cpu), 0);
+        sched_defer_reschedule_ipi(cpu_num_to_mask(t->curr_cpu));
         break;
     case THREAD_SUSPENDED:
         /* thread is suspended already */
@@ -488,7 +558,11 @@ __NO_RETURN static void thread_exit_locked(thread_t* current_thread, int retcode
     /* must be put at top scope in this function to force the compiler to keep it from
      * reusing the stack before the function exits
      */
-    dpc_t free_dpc;
+    dpc_t free_dpc = DPC_INITIAL_VALUE;
+
+    /* give back any deadline reservation */
+    if (thread_is_deadline(current_thread))
+        sched_set_deadline(current_thread, 0, 0, 0);
 
     /* enter the dead state */
     current_thread->state = THREAD_DEATH;
@@ -535,6 +609,10 @@ void thread_forget(thread_t* t) {
     DEBUG_ASSERT(current_thread != t);
 
     list_delete(&t->thread_list_node);
+
+    /* a thread that never ran still has to give back its deadline reservation */
+    if (thread_is_deadline(t))
+        sched_set_deadline(t, 0, 0, 0);
     THREAD_UNLOCK(state);
 
     DEBUG_ASSERT(!list_in_list(&t->queue_node));
@@ -605,7 +683,7 @@ void thread_kill(thread_t* t) {
         /* The following call is not essential.  It just makes the
              * thread termination happen sooner rather than at the next
              * timer interrupt or syscall. */
-        mp_reschedule(MP_IPI_TARGET_MASK, cpu_num_to_mask(t->curr_cpu), 0);
+        sched_defer_reschedule_ipi(cpu_num_to_mask(t->curr_cpu));
         break;
     case THREAD_SUSPENDED:
         /* thread is suspended, resume it so it can get the kill signal */
@@ -753,7 +831,7 @@ void thread_process_pending_signals(void) {
 
 __NO_RETURN static int idle_thread_routine(void* arg) {
     for (;;)
-        arch_idle();
+        idle_enter();
 }
 
 /**
@@ -842,7 +920,7 @@ static enum handler_return thread_sleep_handler(timer_t* timer, zx_time_t now,
         return INT_NO_RESCHEDULE;
 
     if (t->state != THREAD_SLEEPING) {
-        spin_unlock(&thread_lock);
+        thread_lock_release();
         return INT_NO_RESCHEDULE;
     }
 
@@ -852,7 +930,7 @@ static enum handler_return thread_sleep_handler(timer_t* timer, zx_time_t now,
     if (sched_unblock(t))
         sched_reschedule();
 
-    spin_unlock(&thread_lock);
+    thread_lock_release();
 
     return INT_NO_RESCHEDULE;
 }
@@ -914,7 +992,12 @@ zx_status_t thread_sleep_etc(zx_time_t deadline, bool interruptable) {
 
     /* set a one shot timer to wake us up and reschedule */
     uint64_t slack = sleep_slack(deadline, now);
-    timer_set(&timer, deadline, TIMER_SLACK_LATE, slack, thread_sleep_handler, current_thread);
+    enum slack_mode mode = TIMER_SLACK_LATE;
+    if (current_thread->timer_slack > slack) {
+        slack = current_thread->timer_slack;
+        mode = current_thread->timer_slack_mode;
+    }
+    timer_set(&timer, deadline, mode, slack, thread_sleep_handler, current_thread);
 
     current_thread->state = THREAD_SLEEPING;
     current_thread->blocked_status = ZX_OK;
@@ -975,6 +1058,8 @@ void thread_construct_first(thread_t* t, const char* name) {
     init_thread_struct(t, name);
     t->base_priority = HIGHEST_PRIORITY;
     t->priority_boost = 0;
+    t->inherited_priority = LOWEST_PRIORITY;
+    t->handoff_armed = false;
     t->state = THREAD_RUNNING;
     t->flags = THREAD_FLAG_DETACHED;
     t->signals = 0;
@@ -1013,6 +1098,7 @@ void thread_init_early(void) {
 void thread_init(void) {
     for (uint i = 0; i < SMP_MAX_CPUS; i++) {
         timer_init(&percpu[i].preempt_timer);
+        timer_init(&percpu[i].handoff_timer);
     }
 }
 
@@ -32,6 +32,7 @@
 #include <malloc.h>
 #include <platform.h>
 #include <platform/timer.h>
+#include <stdlib.h>
 #include <trace.h>
 #include <zircon/types.h>
 
@@ -157,6 +158,232 @@ static void insert_timer_in_queue(uint cpu, timer_t* timer,
     list_add_tail(&percpu[cpu].timer_queue, &timer->node);
 }
 
+// Timers due within this much of the current time are kept in the sorted timer
+// queue, where they are coalesced against each other as they are inserted.
+// Anything further out goes into the timer wheel.
+#define TIMER_NEAR_HORIZON ((zx_duration_t)2 << TIMER_WHEEL_GRANULARITY_SHIFT)
+
+// The overflow list is sorted back into the wheel every full turn of the top level.
+#define TIMER_WHEEL_OVERFLOW_SHIFT \
+    (TIMER_WHEEL_GRANULARITY_SHIFT + TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOT_SHIFT)
+
+static inline uint wheel_shift(uint level) {
+    return TIMER_WHEEL_GRANULARITY_SHIFT + level * TIMER_WHEEL_SLOT_SHIFT;
+}
+
+static inline zx_time_t wheel_next_boundary(zx_time_t t, uint shift) {
+    return ROUNDUP(t + 1, (zx_time_t)1 << shift);
+}
+
+// Returns the distance from |from| to the next set bit of |pending|, wrapping around.
+static inline uint wheel_next_pending(uint64_t pending, uint from) {
+    DEBUG_ASSERT(pending != 0);
+    uint64_t rotated = (from == 0) ? pending : ((pending >> from) | (pending << (64 - from)));
+    return __builtin_ctzll(rotated);
+}
+
+// Queues |timer| on |cpu|, either in the timer queue if it is due soon or in the
+// timer wheel otherwise. Uses the slack saved in the timer. Returns the time at which
+// the hardware timer has to fire to service the timer.
+static zx_time_t enqueue_timer(uint cpu, timer_t* timer) {
+    struct timer_wheel* wheel = &percpu[cpu].timer_wheel;
+    zx_time_t deadline = timer->scheduled_time;
+
+    if (deadline < wheel->clk) {
+        insert_timer_in_queue(cpu, timer, timer->early_slack, timer->late_slack);
+        return timer->scheduled_time;
+    }
+
+    // Use the finest level that can hold the deadline. This never picks the bucket
+    // that is current for a level above 0, since that always fits one level lower.
+    timer->slack = 0;
+    for (uint level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        uint shift = wheel_shift(level);
+        if ((deadline >> shift) - (wheel->clk >> shift) < TIMER_WHEEL_SLOTS) {
+            uint slot = (deadline >> shift) % TIMER_WHEEL_SLOTS;
+            list_add_tail(&wheel->bucket[level][slot], &timer->node);
+            wheel->pending[level] |= (1ull << slot);
+
+            // level 0 buckets are drained when their earliest timer is due, buckets
+            // further up are cascaded when their interval begins.
+            return (level == 0) ? deadline : ((deadline >> shift) << shift);
+        }
+    }
+
+    list_add_tail(&wheel->overflow, &timer->node);
+    return wheel_next_boundary(wheel->clk, TIMER_WHEEL_OVERFLOW_SHIFT);
+}
+
+// Removes |timer| from whatever timer queue or wheel bucket it is in. A wheel
+// bucket's pending bit is left alone since the timer may belong to another cpu;
+// it is cleared lazily once the bucket is found to be empty.
+static inline void dequeue_timer(timer_t* timer) {
+    list_delete(&timer->node);
+}
+
+// Moves every timer in a wheel bucket into the timer queue.
+static void wheel_drain_bucket(uint cpu, struct list_node* bucket) {
+    timer_t* timer;
+    while ((timer = list_remove_head_type(bucket, timer_t, node)) != NULL) {
+        insert_timer_in_queue(cpu, timer, timer->early_slack, timer->late_slack);
+    }
+}
+
+// Sorts every timer in a wheel bucket (or the overflow list) back into the wheel
+// relative to its current clock, which moves them down at least one level.
+static void wheel_requeue_bucket(uint cpu, struct list_node* bucket) {
+    struct list_node timers = LIST_INITIAL_VALUE(timers);
+    list_move(bucket, &timers);
+
+    timer_t* timer;
+    while ((timer = list_remove_head_type(&timers, timer_t, node)) != NULL) {
+        enqueue_timer(cpu, timer);
+    }
+}
+
+// Cascades the buckets whose interval starts at the wheel's current clock.
+static void wheel_cascade(uint cpu, struct timer_wheel* wheel) {
+    const zx_time_t clk = wheel->clk;
+
+    if ((clk & (((zx_time_t)1 << TIMER_WHEEL_OVERFLOW_SHIFT) - 1)) == 0)
+        wheel_requeue_bucket(cpu, &wheel->overflow);
+
+    for (uint level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+        uint shift = wheel_shift(level);
+        if (clk & (((zx_time_t)1 << shift) - 1))
+            continue;
+
+        uint slot = (clk >> shift) % TIMER_WHEEL_SLOTS;
+        if (wheel->pending[level] & (1ull << slot)) {
+            wheel->pending[level] &= ~(1ull << slot);
+            wheel_requeue_bucket(cpu, &wheel->bucket[level][slot]);
+        }
+    }
+}
+
+// Returns how far the wheel's clock can move next without stepping over a non
+// empty bucket or a cascade, stopping at the first level 0 bucket past |limit|.
+static zx_time_t wheel_next_clk(struct timer_wheel* wheel, zx_time_t limit) {
+    const zx_time_t step = (zx_time_t)1 << TIMER_WHEEL_GRANULARITY_SHIFT;
+
+    if (wheel->pending[0] != 0)
+        return wheel->clk + step;
+
+    // Nothing on level 0, skip ahead to the next interval of the lowest level
+    // that has anything in it.
+    uint level = 1;
+    while (level < TIMER_WHEEL_LEVELS && wheel->pending[level] == 0)
+        level++;
+
+    zx_time_t end = ROUNDDOWN(limit, step) + step;
+    if (level < TIMER_WHEEL_LEVELS)
+        return MIN(end, wheel_next_boundary(wheel->clk, wheel_shift(level)));
+    if (!list_is_empty(&wheel->overflow))
+        return MIN(end, wheel_next_boundary(wheel->clk, TIMER_WHEEL_OVERFLOW_SHIFT));
+    return end;
+}
+
+// Advances the wheel of |cpu| so that every timer due before |limit| is in the
+// timer queue.
+static void wheel_advance(uint cpu, zx_time_t limit) {
+    struct timer_wheel* wheel = &percpu[cpu].timer_wheel;
+
+    while (wheel->clk <= limit) {
+        uint slot = (wheel->clk >> TIMER_WHEEL_GRANULARITY_SHIFT) % TIMER_WHEEL_SLOTS;
+        if (wheel->pending[0] & (1ull << slot)) {
+            wheel->pending[0] &= ~(1ull << slot);
+            wheel_drain_bucket(cpu, &wheel->bucket[0][slot]);
+        }
+
+        wheel->clk = wheel_next_clk(wheel, limit);
+        wheel_cascade(cpu, wheel);
+    }
+}
+
+// Returns the earliest time the hardware timer has to fire to service the wheel
+// of |cpu|, ZX_TIME_INFINITE if it is empty. Unless |exact| is set this is
+// the start of the first pending bucket of each level, so that buckets are
+// cascaded on time. Cascading late is harmless, wheel_advance() catches up,
+// so with |exact| set it is the earliest deadline of any timer in the wheel,
+// at the cost of walking the buckets that hold the nearest ones.
+static zx_time_t wheel_next_event(uint cpu, bool exact) {
+    struct timer_wheel* wheel = &percpu[cpu].timer_wheel;
+    zx_time_t next = ZX_TIME_INFINITE;
+
+    for (uint level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        uint shift = wheel_shift(level);
+        zx_time_t index = wheel->clk >> shift;
+
+        while (wheel->pending[level] != 0) {
+            zx_time_t target = index +
+                wheel_next_pending(wheel->pending[level], index % TIMER_WHEEL_SLOTS);
+            uint slot = target % TIMER_WHEEL_SLOTS;
+            struct list_node* bucket = &wheel->bucket[level][slot];
+
+            if (list_is_empty(bucket)) {
+                // emptied by a cancel
+                wheel->pending[level] &= ~(1ull << slot);
+                continue;
+            }
+
+            if (level == 0 || exact) {
+                timer_t* t;
+                list_for_every_entry (bucket, t, timer_t, node) {
+                    next = MIN(next, t->scheduled_time);
+                }
+            } else {
+                next = MIN(next, target << shift);
+            }
+            break;
+        }
+    }
+
+    if (!list_is_empty(&wheel->overflow)) {
+        if (exact) {
+            timer_t* t;
+            list_for_every_entry (&wheel->overflow, t, timer_t, node) {
+                next = MIN(next, t->scheduled_time);
+            }
+        } else {
+            next = MIN(next, wheel_next_boundary(wheel->clk, TIMER_WHEEL_OVERFLOW_SHIFT));
+        }
+    }
+
+    return next;
+}
+
+// Makes sure the hardware timer of |cpu| fires no later than |when|.
+static void update_hw_timer(uint cpu, zx_time_t when) {
+    struct timer_wheel* wheel = &percpu[cpu].timer_wheel;
+
+    if (when < wheel->next_event) {
+        LTRACEF("setting new timer for %" PRIu64 " nsecs\n", when);
+        wheel->next_event = when;
+        platform_set_oneshot_timer(when);
+    }
+}
+
+// Programs the hardware timer of |cpu| for its earliest event, stopping it if
+// there is none and |stop_if_idle| is set. An idle cpu is only woken up for
+// a timer that is actually due, not to keep the wheel tidy.
+static void reprogram_hw_timer(uint cpu, bool stop_if_idle) {
+    struct timer_wheel* wheel = &percpu[cpu].timer_wheel;
+
+    zx_time_t next = wheel_next_event(cpu, mp_is_cpu_idle(cpu));
+    timer_t* head = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
+    if (head)
+        next = MIN(next, head->scheduled_time);
+
+    wheel->next_event = next;
+    if (next != ZX_TIME_INFINITE) {
+        LTRACEF("setting new timer for %" PRIu64 " nsecs\n", next);
+        platform_set_oneshot_timer(next);
+    } else if (stop_if_idle) {
+        LTRACEF("clearing old hw timer, nothing in the queue\n");
+        platform_stop_timer();
+    }
+}
+
 void timer_set(timer_t* timer, zx_time_t deadline,
                enum slack_mode mode, uint64_t slack,
                timer_callback callback, void* arg) {
@@ -211,6 +438,8 @@ void timer_set(timer_t* timer, zx_time_t deadline,
 
     // Set up the structure.
     timer->scheduled_time = deadline;
+    timer->early_slack = early_slack;
+    timer->late_slack = late_slack;
     timer->callback = callback;
     timer->arg = arg;
     timer->cancel = false;
@@ -218,13 +447,10 @@ void timer_set(timer_t* timer, zx_time_t deadline,
 
     LTRACEF("scheduled time %" PRIu64 "\n", timer->scheduled_time);
 
-    insert_timer_in_queue(cpu, timer, early_slack, late_slack);
+    // Catch the wheel up first in case this cpu has not taken a timer interrupt in a while.
+    wheel_advance(cpu, current_time() + TIMER_NEAR_HORIZON);
 
-    if (list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node) == timer) {
-        /* we just modified the head of the timer queue */
-        LTRACEF("setting new timer for %" PRIu64 " nsecs\n", deadline);
-        platform_set_oneshot_timer(deadline);
-    }
+    update_hw_timer(cpu, enqueue_timer(cpu, timer));
 
 out:
     spin_unlock_irqrestore(&timer_lock, state);
@@ -253,11 +479,13 @@ void timer_reset_oneshot_local(timer_t* timer, zx_time_t deadline, timer_callbac
 
     /* remove it from the queue if it was present */
     if (list_in_list(&timer->node))
-        list_delete(&timer->node);
+        dequeue_timer(timer);
 
     /* set up the structure */
     timer->scheduled_time = deadline;
     timer->slack = 0;
+    timer->early_slack = 0;
+    timer->late_slack = 0;
     timer->callback = callback;
     timer->arg = arg;
     timer->cancel = false;
@@ -265,13 +493,7 @@ void timer_reset_oneshot_local(timer_t* timer, zx_time_t deadline, timer_callbac
 
     LTRACEF("scheduled time %" PRIu64 "\n", timer->scheduled_time);
 
-    insert_timer_in_queue(cpu, timer, 0u, 0u);
-
-    if (list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node) == timer) {
-        /* we just modified the head of the timer queue */
-        LTRACEF("setting new timer for %" PRIu64 " nsecs\n", deadline);
-        platform_set_oneshot_timer(deadline);
-    }
+    update_hw_timer(cpu, enqueue_timer(cpu, timer));
 
     spin_unlock(&timer_lock);
 }
@@ -308,27 +530,17 @@ bool timer_cancel(timer_t* timer) {
     if (list_in_list(&timer->node)) {
         callback_not_running = true;
 
-        /* save a copy of the old head of the queue */
-        timer_t* oldhead = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
-
         /* remove our timer from the queue */
-        list_delete(&timer->node);
+        dequeue_timer(timer);
 
         /* TODO(cpu): if  after removing |timer| there is one other single timer with
            the same scheduled_time and slack non-zero then it is possible to return
            that timer to the ideal scheduled_time */
 
-        /* see if we've just modified the head of this cpu's timer queue */
-        /* if we modified another cpu's queue, we'll just let it fire and sort itself out */
-        if (unlikely(oldhead == timer)) {
-            timer_t* newhead = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
-            if (newhead) {
-                LTRACEF("setting new timer to %" PRIu64 "\n", newhead->scheduled_time);
-                platform_set_oneshot_timer(newhead->scheduled_time);
-            } else {
-                LTRACEF("clearing old hw timer, nothing in the queue\n");
-                platform_stop_timer();
-            }
+        /* see if this cpu's hardware timer was set for it */
+        /* if it was on another cpu, we'll just let it fire and sort itself out */
+        if (unlikely(timer->scheduled_time == percpu[cpu].timer_wheel.next_event)) {
+            reprogram_hw_timer(cpu, true);
         }
     } else {
         callback_not_running = false;
@@ -363,6 +575,12 @@ enum handler_return timer_tick(zx_time_t now) {
 
     spin_lock(&timer_lock);
 
+    /* the hardware timer has fired, it will be programmed again below */
+    percpu[cpu].timer_wheel.next_event = ZX_TIME_INFINITE;
+
+    /* pull in everything from the wheel that is due soon */
+    wheel_advance(cpu, now + TIMER_NEAR_HORIZON);
+
     for (;;) {
         /* see if there's an event to process */
         timer = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
@@ -378,7 +596,7 @@ enum handler_return timer_tick(zx_time_t now) {
         DEBUG_ASSERT_MSG(timer && timer->magic == TIMER_MAGIC,
                          "ASSERT: timer failed magic check: timer %p, magic 0x%x\n",
                          timer, (uint)timer->magic);
-        list_delete(&timer->node);
+        dequeue_timer(timer);
 
         /* mark the timer busy */
         timer->active_cpu = cpu;
@@ -407,16 +625,12 @@ enum handler_return timer_tick(zx_time_t now) {
         arch_spinloop_signal();
     }
 
-    /* reset the timer to the next event */
+    /* has to be the case or it would have fired already */
     timer = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
-    if (timer) {
-        /* has to be the case or it would have fired already */
-        DEBUG_ASSERT(timer->scheduled_time > now);
+    DEBUG_ASSERT(!timer || timer->scheduled_time > now);
 
-        LTRACEF("setting new timer for %" PRIu64 " nsecs for event %p\n", timer->scheduled_time,
-                timer);
-        platform_set_oneshot_timer(timer->scheduled_time);
-    }
+    /* reset the timer to the next event */
+    reprogram_hw_timer(cpu, false);
 
     /* we're done manipulating the timer queue */
     spin_unlock(&timer_lock);
@@ -446,23 +660,28 @@ void timer_transition_off_cpu(uint old_cpu) {
     spin_lock_irqsave(&timer_lock, state);
     uint cpu = arch_curr_cpu_num();
 
-    timer_t* old_head = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
+    wheel_advance(cpu, current_time() + TIMER_NEAR_HORIZON);
 
-    timer_t *entry = NULL, *tmp_entry = NULL;
     /* Move all timers from old_cpu to this cpu */
-    list_for_every_entry_safe (&percpu[old_cpu].timer_queue, entry, tmp_entry, timer_t, node) {
-        list_delete(&entry->node);
-        // We lost the original asymmetric slack information so when we combine them
-        // with the other timer queue they are not coalesced again.
-        // TODO(cpu): figure how important this case is.
-        insert_timer_in_queue(cpu, entry, 0u, 0u);
+    timer_t* entry;
+    while ((entry = list_remove_head_type(&percpu[old_cpu].timer_queue, timer_t, node)) != NULL) {
+        // Undo any coalescing on the old cpu so it can be coalesced against this cpu's timers.
+        entry->scheduled_time -= entry->slack;
+        update_hw_timer(cpu, enqueue_timer(cpu, entry));
     }
 
-    timer_t* new_head = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
-    if (new_head != NULL && new_head != old_head) {
-        /* we just modified the head of the timer queue */
-        LTRACEF("setting new timer for %" PRIu64 " nsecs\n", new_head->scheduled_time);
-        platform_set_oneshot_timer(new_head->scheduled_time);
+    struct timer_wheel* old_wheel = &percpu[old_cpu].timer_wheel;
+    for (uint level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (uint slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            while ((entry = list_remove_head_type(&old_wheel->bucket[level][slot],
+                                                  timer_t, node)) != NULL) {
+                update_hw_timer(cpu, enqueue_timer(cpu, entry));
+            }
+        }
+        old_wheel->pending[level] = 0;
+    }
+    while ((entry = list_remove_head_type(&old_wheel->overflow, timer_t, node)) != NULL) {
+        update_hw_timer(cpu, enqueue_timer(cpu, entry));
     }
 
     spin_unlock_irqrestore(&timer_lock, state);
@@ -474,19 +693,34 @@ void timer_thaw_percpu(void) {
 
     uint cpu = arch_curr_cpu_num();
 
-    timer_t* t = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
-    if (t) {
-        LTRACEF("rescheduling timer for %" PRIu64 " nsecs\n", t->scheduled_time);
-        platform_set_oneshot_timer(t->scheduled_time);
-    }
+    reprogram_hw_timer(cpu, false);
 
     spin_unlock(&timer_lock);
 }
 
+zx_time_t timer_next_event_local(void) {
+    DEBUG_ASSERT(arch_ints_disabled());
+
+    // Only the local cpu programs its hardware timer, so with interrupts
+    // off this can't change underneath us.
+    return get_local_percpu()->timer_wheel.next_event;
+}
+
 void timer_queue_init(void) {
     timer_lock = SPIN_LOCK_INITIAL_VALUE;
     for (uint i = 0; i < SMP_MAX_CPUS; i++) {
         list_initialize(&percpu[i].timer_queue);
+
+        struct timer_wheel* wheel = &percpu[i].timer_wheel;
+        wheel->clk = 0;
+        wheel->next_event = ZX_TIME_INFINITE;
+        for (uint level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+            wheel->pending[level] = 0;
+            for (uint slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+                list_initialize(&wheel->bucket[level][slot]);
+            }
+        }
+        list_initialize(&wheel->overflow);
     }
 }
 
@@ -512,6 +746,18 @@ static void dump_timer_queues(char* buf, size_t len) {
                                 t->scheduled_time, delta_now, delta_last, t->callback, t->arg);
                 last = t->scheduled_time;
             }
+
+            struct timer_wheel* wheel = &percpu[i].timer_wheel;
+            for (uint level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+                size_t count = 0;
+                for (uint slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+                    count += list_length(&wheel->bucket[level][slot]);
+                }
+                ptr += snprintf(buf + ptr, len - ptr, "\twheel level %u: %zu timers\n",
+                                level, count);
+            }
+            ptr += snprintf(buf + ptr, len - ptr, "\twheel overflow: %zu timers\n",
+                            list_length(&wheel->overflow));
         }
     }
 
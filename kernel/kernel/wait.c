@@ -39,7 +39,7 @@ static enum handler_return wait_queue_timeout_handler(timer_t* timer, zx_time_t
         sched_reschedule();
     }
 
-    spin_unlock(&thread_lock);
+    thread_lock_release();
 
     return INT_NO_RESCHEDULE;
 }
@@ -77,7 +77,8 @@ static zx_status_t wait_queue_block_worker(wait_queue_t* wait, zx_time_t deadlin
     /* if the deadline is nonzero or noninfinite, set a callback to yank us out of the queue */
     if (deadline != ZX_TIME_INFINITE) {
         timer_init(&timer);
-        timer_set_oneshot(&timer, deadline, wait_queue_timeout_handler, (void*)current_thread);
+        timer_set(&timer, deadline, current_thread->timer_slack_mode, current_thread->timer_slack,
+                  wait_queue_timeout_handler, (void*)current_thread);
     }
 
     ktrace(TAG_KWAIT_BLOCK, (uintptr_t)wait >> 32, (uintptr_t)wait, 0, 0);
@@ -184,6 +185,55 @@ int wait_queue_wake_one(wait_queue_t* wait, bool reschedule, zx_status_t wait_qu
     return ret;
 }
 
+/* how many of the most recent waiters wait_queue_wake_one_lifo() looks at */
+#define WAIT_QUEUE_LIFO_SCAN 4
+
+/**
+ * @brief  Wake the most recently blocked thread on a wait queue
+ *
+ * Like wait_queue_wake_one(), except that the thread taken is the one that
+ * has been waiting the shortest time, whose cache state is most likely
+ * still around. Among the few most recent waiters one that last ran on the
+ * current cpu is preferred.
+ *
+ * @param wait  The wait queue to wake
+ * @param reschedule  If true, the newly-woken thread will run immediately.
+ * @param wait_queue_error  The return value which the new thread will receive
+ * from wait_queue_block().
+ *
+ * @return  The number of threads woken (zero or one)
+ */
+int wait_queue_wake_one_lifo(wait_queue_t* wait, bool reschedule, zx_status_t wait_queue_error) {
+    DEBUG_ASSERT(wait->magic == WAIT_QUEUE_MAGIC);
+    DEBUG_ASSERT(arch_ints_disabled());
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    thread_t* newest = list_peek_tail_type(&wait->list, thread_t, queue_node);
+    if (!newest)
+        return 0;
+
+    cpu_num_t cpu = arch_curr_cpu_num();
+    thread_t* t = newest;
+    for (int i = 0; t && i < WAIT_QUEUE_LIFO_SCAN; i++) {
+        if (t->last_cpu == cpu)
+            break;
+        t = list_prev_type(&wait->list, &t->queue_node, thread_t, queue_node);
+    }
+    if (!t || t->last_cpu != cpu)
+        t = newest;
+
+    bool local_resched;
+    __UNUSED zx_status_t status = wait_queue_unblock_thread(t, wait_queue_error, &local_resched);
+    DEBUG_ASSERT(status == ZX_OK);
+
+    ktrace(TAG_KWAIT_WAKE, (uintptr_t)wait >> 32, (uintptr_t)wait, 0, 0);
+
+    if (reschedule && local_resched)
+        sched_reschedule();
+
+    return 1;
+}
+
 thread_t* wait_queue_dequeue_one(wait_queue_t* wait, zx_status_t wait_queue_error) {
     thread_t* t;
 
@@ -15,7 +15,7 @@
 // needed, for example, for memcpy and memset.
 #define APPLY_CODE_PATCH_FUNC_WITH_DEFAULT(patch_func, loc, size_in_bytes) \
     /* Add "struct CodePatchInfo" entry to the code_patch_table array. */  \
-    .pushsection code_patch_table,"a",%progbits;                           \
+    .pushsection .data.rel.ro.code_patch_table,"aw",%progbits;             \
     .balign 8;                                                             \
     .quad patch_func; /* apply_func field */                               \
     .quad loc; /* dest_addr field */                                       \
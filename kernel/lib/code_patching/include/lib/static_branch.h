@@ -0,0 +1,64 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <arch/static_branch.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS
+
+// Static branches are conditions that are almost always false and are
+// checked on hot paths, like whether a tracepoint's group is being traced.
+// Each use of static_branch_enabled() is a nop that falls through to the
+// disabled code, and static_branch_set() patches all the uses of a key
+// into jumps to the enabled code while the key is on. Keys are small
+// compile time constants, handed out below.
+#define STATIC_BRANCH_KEYS 64
+
+// ktrace's groups, one key for each KTRACE_GRP_* bit
+#define STATIC_BRANCH_KEY_KTRACE 0
+
+// One entry for each use of static_branch_enabled() in the kernel.
+struct static_branch_site {
+    uintptr_t site;   // the nop
+    uintptr_t target; // where it jumps to while enabled
+    uintptr_t key;
+};
+
+// Keys that are enabled, bit n for key n.
+extern uint64_t static_branch_keys;
+
+#if defined(__clang__)
+// TODO: Clang can't yet do asm goto, so builds with it test the key's bit.
+static inline __ALWAYS_INLINE bool static_branch_enabled(unsigned int key) {
+    return (__atomic_load_n(&static_branch_keys, __ATOMIC_RELAXED) >> key) & 1;
+}
+#else
+// |key| must be a compile time constant.
+static inline __ALWAYS_INLINE bool static_branch_enabled(unsigned int key) {
+    __asm__ goto("1: " ARCH_STATIC_BRANCH_NOP "\n"
+                 ".pushsection .data.rel.ro.static_branch,\"aw\",%%progbits\n"
+                 ".balign 8\n"
+                 ".quad 1b, %l[enabled], %c0\n"
+                 ".popsection"
+                 :
+                 : "i"(key)
+                 :
+                 : enabled);
+    return false;
+enabled:
+    return true;
+}
+#endif
+
+// Patches every use of |key|. This stops all the cpus while it patches, and
+// must be called from thread context.
+void static_branch_set(unsigned int key, bool enabled);
+
+__END_CDECLS
@@ -10,5 +10,6 @@ MODULE := $(LOCAL_DIR)
 
 MODULE_SRCS += \
     $(LOCAL_DIR)/code_patching.cpp \
+    $(LOCAL_DIR)/static_branch.cpp \
 
 include make/module.mk
@@ -0,0 +1,99 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <lib/static_branch.h>
+
+#include <arch/ops.h>
+#include <assert.h>
+#include <debug.h>
+#include <fbl/auto_lock.h>
+#include <kernel/atomic.h>
+#include <kernel/mp.h>
+#include <kernel/mutex.h>
+#include <string.h>
+#include <vm/physmap.h>
+#include <vm/pmm.h>
+#include <vm/vm.h>
+
+extern const static_branch_site __start_static_branch[];
+extern const static_branch_site __stop_static_branch[];
+
+uint64_t static_branch_keys;
+
+static mutex_t static_branch_lock = MUTEX_INITIAL_VALUE(static_branch_lock);
+
+namespace {
+
+struct PatchContext {
+    unsigned int key;
+    bool enabled;
+    // Kernel code is mapped read-only, so the sites are written through the
+    // physmap. The kernel is loaded in one piece, so this is the same for
+    // every site.
+    uintptr_t code_to_physmap;
+    int cpus;
+    int arrived;
+    int done;
+};
+
+void patch_sites(const PatchContext* ctx) {
+    for (const static_branch_site* s = __start_static_branch; s < __stop_static_branch; ++s) {
+        if (s->key != ctx->key)
+            continue;
+        uint8_t insn[ARCH_STATIC_BRANCH_SIZE];
+        arch_static_branch_encode(insn, s->site, s->target, ctx->enabled);
+        memcpy(reinterpret_cast<void*>(s->site + ctx->code_to_physmap), insn, sizeof(insn));
+        arch_sync_cache_range(s->site, sizeof(insn));
+    }
+}
+
+// Runs on every cpu at once. None of them may be executing the sites while
+// they change, so the first one in patches once the rest are all parked
+// here with interrupts disabled.
+void patch_task(void* arg) {
+    PatchContext* ctx = static_cast<PatchContext*>(arg);
+    if (atomic_add(&ctx->arrived, 1) == 0) {
+        while (atomic_load(&ctx->arrived) != ctx->cpus)
+            arch_spinloop_pause();
+        patch_sites(ctx);
+        atomic_store(&ctx->done, 1);
+    } else {
+        while (!atomic_load(&ctx->done))
+            arch_spinloop_pause();
+    }
+    arch_static_branch_serialize();
+}
+
+} // namespace
+
+void static_branch_set(unsigned int key, bool enabled) {
+    DEBUG_ASSERT(key < STATIC_BRANCH_KEYS);
+    DEBUG_ASSERT(!arch_ints_disabled());
+
+    fbl::AutoLock lock(&static_branch_lock);
+
+    const uint64_t bit = 1ull << key;
+    if (!!(static_branch_keys & bit) == enabled)
+        return;
+
+    if (enabled) {
+        __atomic_fetch_or(&static_branch_keys, bit, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_and(&static_branch_keys, ~bit, __ATOMIC_RELAXED);
+    }
+
+    const uintptr_t code = reinterpret_cast<uintptr_t>(__code_start);
+    PatchContext ctx = {};
+    ctx.key = key;
+    ctx.enabled = enabled;
+    ctx.code_to_physmap =
+        reinterpret_cast<uintptr_t>(paddr_to_physmap(vaddr_to_paddr(__code_start))) - code;
+
+    // Keep the set of cpus fixed until they have all checked in.
+    fbl::AutoLock hotplug(&mp.hotplug_lock);
+    ctx.cpus = __builtin_popcount(mp_get_online_mask());
+    mp_sync_exec(MP_IPI_TARGET_ALL, 0, patch_task, &ctx);
+}
@@ -11,9 +11,12 @@
 #include <err.h>
 #include <explicit-memory/bytes.h>
 #include <fbl/algorithm.h>
+#include <fbl/atomic.h>
+#include <kernel/align.h>
 #include <kernel/auto_lock.h>
 #include <kernel/cmdline.h>
 #include <kernel/mutex.h>
+#include <kernel/spinlock.h>
 #include <lib/crypto/cryptolib.h>
 #include <lib/crypto/entropy/collector.h>
 #include <lib/crypto/entropy/jitterentropy_collector.h>
@@ -38,6 +41,95 @@ PRNG* GetInstance() {
     return kGlobalPrng;
 }
 
+// A per-CPU PRNG is only used by its own CPU, with interrupts disabled, so it
+// needs no lock of its own.  Each one lives on its own cache line.
+struct __CPU_ALIGN PerCpuPrng {
+    PRNG* prng;
+    // The value of |reseed_generation| when this PRNG was last seeded.
+    uint64_t generation;
+    // Bytes drawn since this PRNG was last seeded.
+    uint64_t drawn;
+};
+
+static PerCpuPrng per_cpu_prngs[SMP_MAX_CPUS];
+
+// Set once the per-CPU PRNGs exist; until then Draw() uses the global PRNG.
+static bool per_cpu_ready = false;
+
+// Bumped whenever entropy is added to the global PRNG, so that every per-CPU
+// PRNG reseeds before its next draw.  Starts ahead of the per-CPU copies so
+// that each of them is seeded before first use.
+static fbl::atomic<uint64_t> reseed_generation(1);
+
+// How much a per-CPU PRNG produces before it reseeds from the global one, and
+// the largest single draw done with interrupts disabled.
+static constexpr uint64_t kReseedInterval = 1ULL << 20;
+static constexpr size_t kMaxPerCpuDraw = 256;
+
+// Draws |size| bytes (at most kMaxPerCpuDraw) from the current CPU's PRNG,
+// seeding it from the global PRNG first if needed.
+static void DrawLocal(uint8_t* out, size_t size) {
+    uint8_t seed[PRNG::kMinEntropy];
+    uint64_t seed_generation = 0;
+    bool have_seed = false;
+
+    while (true) {
+        // With interrupts off, this thread stays on this CPU, and nothing
+        // else can use its PRNG until they are restored.
+        spin_lock_saved_state_t state;
+        arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+        PerCpuPrng* local = &per_cpu_prngs[arch_curr_cpu_num()];
+        const uint64_t generation = reseed_generation.load();
+        const bool stale = (local->generation != generation ||
+                            local->drawn + size > kReseedInterval);
+        if (!stale || have_seed) {
+            if (stale) {
+                local->prng->AddEntropy(seed, sizeof(seed));
+                local->generation = seed_generation;
+                local->drawn = 0;
+            }
+            local->prng->Draw(out, size);
+            local->drawn += size;
+            arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+            break;
+        }
+        arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+        // Drawing from the global PRNG may block, so fetch the seed with
+        // interrupts enabled and then retry on whichever CPU we are on.
+        // Note the generation first, so that entropy added while we draw
+        // causes another reseed.
+        seed_generation = reseed_generation.load();
+        kGlobalPrng->Draw(seed, sizeof(seed));
+        have_seed = true;
+    }
+
+    if (have_seed) {
+        mandatory_memset(seed, 0, sizeof(seed));
+    }
+}
+
+void Draw(void* out, size_t size) {
+    ASSERT(kGlobalPrng);
+    if (!per_cpu_ready) {
+        kGlobalPrng->Draw(out, size);
+        return;
+    }
+    uint8_t* buf = static_cast<uint8_t*>(out);
+    while (size > 0) {
+        const size_t chunk = fbl::min(size, kMaxPerCpuDraw);
+        DrawLocal(buf, chunk);
+        buf += chunk;
+        size -= chunk;
+    }
+}
+
+void AddEntropy(const void* data, size_t size) {
+    ASSERT(kGlobalPrng);
+    kGlobalPrng->AddEntropy(data, size);
+    reseed_generation.fetch_add(1);
+}
+
 // Returns true if the kernel cmdline provided at least PRNG::kMinEntropy bytes
 // of entropy, and false otherwise.
 //
@@ -162,9 +254,18 @@ static void EarlyBootSeed(uint level) {
     }
 }
 
-// Migrate the global PRNG to enter thread-safe mode.
+// Migrate the global PRNG to enter thread-safe mode, and create the per-CPU
+// PRNGs.  These start unseeded, and seed themselves on first use.
 static void BecomeThreadSafe(uint level) {
     GetInstance()->BecomeThreadSafe();
+
+    alignas(alignof(PRNG)) static uint8_t per_cpu_space[SMP_MAX_CPUS][sizeof(PRNG)];
+    for (size_t i = 0; i < SMP_MAX_CPUS; ++i) {
+        per_cpu_prngs[i].prng = new (&per_cpu_space[i]) PRNG(nullptr, 0, PRNG::NonThreadSafeTag());
+        per_cpu_prngs[i].generation = 0;
+        per_cpu_prngs[i].drawn = 0;
+    }
+    per_cpu_ready = true;
 }
 
 } //namespace GlobalPRNG
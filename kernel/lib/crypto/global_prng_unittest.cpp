@@ -7,6 +7,7 @@
 #include <lib/crypto/global_prng.h>
 
 #include <stdint.h>
+#include <string.h>
 #include <unittest.h>
 
 namespace crypto {
@@ -24,10 +25,38 @@ bool identical(void*) {
     END_TEST;
 }
 
+bool per_cpu_draw(void*) {
+    BEGIN_TEST;
+
+    // Successive draws must differ, whether or not they land on the same CPU
+    // or cause a reseed in between.
+    uint8_t a[32];
+    uint8_t b[32];
+    GlobalPRNG::Draw(a, sizeof(a));
+    GlobalPRNG::Draw(b, sizeof(b));
+    EXPECT_NE(0, memcmp(a, b, sizeof(a)), "");
+
+    uint8_t entropy[PRNG::kMinEntropy] = {0};
+    GlobalPRNG::AddEntropy(entropy, sizeof(entropy));
+    GlobalPRNG::Draw(b, sizeof(b));
+    EXPECT_NE(0, memcmp(a, b, sizeof(a)), "");
+
+    // Draws larger than one per-CPU chunk are filled completely; the chance
+    // of an all-zero tail is negligible.
+    uint8_t big[1000];
+    memset(big, 0, sizeof(big));
+    GlobalPRNG::Draw(big, sizeof(big));
+    static const uint8_t zeros[32] = {0};
+    EXPECT_NE(0, memcmp(big + sizeof(big) - sizeof(zeros), zeros, sizeof(zeros)), "");
+
+    END_TEST;
+}
+
 } // namespace
 
 UNITTEST_START_TESTCASE(global_prng_tests)
 UNITTEST("Identical", identical)
+UNITTEST("Per-CPU draws", per_cpu_draw)
 UNITTEST_END_TESTCASE(global_prng_tests, "global_prng",
                       "Validate global PRNG singleton",
                       nullptr, nullptr);
@@ -16,6 +16,20 @@ namespace GlobalPRNG {
 // guaranteed to be non-null.
 PRNG* GetInstance();
 
+// Fills |out| with |size| bytes of pseudorandom output from the calling CPU's
+// own PRNG, so that concurrent callers on different CPUs don't contend on the
+// global instance's lock.  Each per-CPU PRNG is seeded from the global one,
+// and reseeded after it has produced a fixed amount of output or after more
+// entropy is added through AddEntropy() below.
+//
+// Like PRNG::Draw(), this may block until the global PRNG has been seeded, so
+// it must not be called with interrupts disabled or a spinlock held.
+void Draw(void* out, size_t size);
+
+// Mixes |size| bytes of entropy at |data| into the global PRNG, and makes
+// every per-CPU PRNG reseed from it before its next Draw().
+void AddEntropy(const void* data, size_t size);
+
 } //namespace GlobalPRNG
 
 } // namespace crypto
@@ -8,6 +8,7 @@
 
 #include <err.h>
 #include <dev/udisplay.h>
+#include <kernel/atomic.h>
 #include <kernel/spinlock.h>
 #include <kernel/thread.h>
 #include <lib/io.h>
@@ -21,16 +22,34 @@
 #define DLOG_SIZE (128u * 1024u)
 #define DLOG_MASK (DLOG_SIZE - 1u)
 
+#define ALIGN8(n) (((n) + 7) & (~7))
+
+// Each record in the fifo is preceded by a stamp, which is the value
+// of head the record was reserved at.
+#define DLOG_STAMP_SIZE 8u
+#define DLOG_WIRESIZE(datalen) (DLOG_STAMP_SIZE + DLOG_MIN_RECORD + ALIGN8(datalen))
+
+// head and the stamps carry the fifo position in their low bits and a
+// count of records written above it.
+#define DLOG_POS_BITS 40
+#define DLOG_POS_MASK ((1ull << DLOG_POS_BITS) - 1)
+#define DLOG_POS(n) ((n) & DLOG_POS_MASK)
+#define DLOG_SEQ(n) ((n) >> DLOG_POS_BITS)
+#define DLOG_ONE_RECORD (1ull << DLOG_POS_BITS)
+
+#define DLOG_MARK_SIZE (DLOG_SIZE / DLOG_MARKS)
+
 static_assert((DLOG_SIZE & DLOG_MASK) == 0u, "must be power of two");
 static_assert(DLOG_MAX_RECORD <= DLOG_SIZE, "wat");
-static_assert((DLOG_MAX_RECORD & 3) == 0, "E_DONT_DO_THAT");
+static_assert((DLOG_MAX_RECORD & 7) == 0, "E_DONT_DO_THAT");
+static_assert((DLOG_MARK_SIZE & (DLOG_MARK_SIZE - 1)) == 0, "must be power of two");
+static_assert(DLOG_WIRESIZE(DLOG_MAX_DATA) < DLOG_MARK_SIZE, "");
 
-static uint8_t DLOG_DATA[DLOG_SIZE];
+static uint8_t DLOG_DATA[DLOG_SIZE] __ALIGNED(8);
 
 static dlog_t DLOG = {
-    .lock = SPIN_LOCK_INITIAL_VALUE,
-    .head = 0,
-    .tail = 0,
+    // start the count at one so the zeroed fifo holds no valid stamps
+    .head = DLOG_ONE_RECORD,
     .data = DLOG_DATA,
     .event = EVENT_INITIAL_VALUE(DLOG.event, 0, EVENT_FLAG_AUTOUNSIGNAL),
 
@@ -40,32 +59,70 @@ static dlog_t DLOG = {
 
 // The debug log maintains a circular buffer of debug log records,
 // consisting of a common header (dlog_header_t) followed by up
-// to 224 bytes of textual log message.  Records are aligned on
-// uint32_t boundaries, so the header word which indicates the
-// true size of the record and the space it takes in the fifo
-// can always be read with a single uint32_t* read (the header
-// or body may wrap but the initial header word never does).
+// to 224 bytes of textual log message.  In the fifo every record
+// is preceded by a 64 bit stamp and padded to a multiple of 8 bytes,
+// so the stamp can always be accessed with a single uint64_t* access
+// (the header or body may wrap but the stamp never does).
 //
-// The ring buffer position is maintained by continuously incrementing
-// head and tail pointers (type size_t, so uint64_t on 64bit systems),
+// There is no lock.  A writer reserves space for its record with a
+// single atomic add to head, copies the record in and then publishes
+// it by storing its stamp, which is head as it was before the add.
+// The oldest records are overwritten as head moves on; nothing keeps
+// track of where the valid records start.
 //
-// This allows readers to trivial compute if their local tail
-// pointer has "fallen out" of the fifo (an entire fifo's worth
-// of messages were written since they last tried to read) and then
-// they can snap their tail to the global tail and restart
+// The ring buffer position is continuously incremented and is clipped
+// to the actual buffer by DLOG_MASK.  Above it head counts records,
+// so a reader that has been lapped can tell how many it missed.
 //
+// Each reader owns its cursor, the head value of the next record it
+// wants.  A record is readable if the stamp at the cursor matches it,
+// and was intact if, once it is copied out, head has not moved more
+// than a fifo's worth beyond the cursor.  A reader that is lapped has
+// no way to walk the records it lost, so writers leave the head value
+// of the first record in each DLOG_MARK_SIZE chunk in marks[] for it
+// to resume from.
 //
-// Tail indicates the oldest message in the debug log to read
-// from, Head indicates the next space in the debug log to write
-// a new message to.  They are clipped to the actual buffer by
-// DLOG_MASK.
-//
-//       T                     T
+//       C                     C
 //  [....XXXX....]  [XX........XX]
 //           H         H
 
+// How far |to| is ahead of |from| in the fifo.
+static inline uint64_t dlog_distance(uint64_t from, uint64_t to) {
+    return DLOG_POS(to - from);
+}
 
-#define ALIGN4(n) (((n) + 3) & (~3))
+// How many records were written between |from| and |to|.
+static inline uint64_t dlog_records(uint64_t from, uint64_t to) {
+    return DLOG_SEQ((to & ~DLOG_POS_MASK) - (from & ~DLOG_POS_MASK));
+}
+
+static void dlog_copy_in(dlog_t* log, uint64_t pos, const void* ptr, size_t len) {
+    size_t offset = (pos & DLOG_MASK);
+    size_t fifospace = DLOG_SIZE - offset;
+
+    if (fifospace >= len) {
+        memcpy(log->data + offset, ptr, len);
+    } else {
+        memcpy(log->data + offset, ptr, fifospace);
+        memcpy(log->data, ptr + fifospace, len - fifospace);
+    }
+}
+
+static void dlog_copy_out(dlog_t* log, uint64_t pos, void* ptr, size_t len) {
+    size_t offset = (pos & DLOG_MASK);
+    size_t fifospace = DLOG_SIZE - offset;
+
+    if (fifospace >= len) {
+        memcpy(ptr, log->data + offset, len);
+    } else {
+        memcpy(ptr, log->data + offset, fifospace);
+        memcpy(ptr + fifospace, log->data, len - fifospace);
+    }
+}
+
+static inline volatile uint64_t* dlog_stamp(dlog_t* log, uint64_t pos) {
+    return (volatile uint64_t*) (log->data + (pos & DLOG_MASK));
+}
 
 zx_status_t dlog_write(uint32_t flags, const void* ptr, size_t len) {
     dlog_t* log = &DLOG;
@@ -78,14 +135,11 @@ zx_status_t dlog_write(uint32_t flags, const void* ptr, size_t len) {
         return ZX_ERR_BAD_STATE;
     }
 
-    // Our size "on the wire" must be a multiple of 4, so we know
-    // that worst case there will be room for a header skipping
-    // the last n bytes when the fifo wraps
-    size_t wiresize = DLOG_MIN_RECORD + ALIGN4(len);
+    size_t wiresize = DLOG_WIRESIZE(len);
 
-    // Prepare the record header before taking the lock
+    // Prepare the record header before reserving space
     dlog_header_t hdr;
-    hdr.header = DLOG_HDR_SET(wiresize, DLOG_MIN_RECORD + len);
+    hdr.dropped = 0;
     hdr.datalen = len;
     hdr.flags = flags;
     hdr.timestamp = current_time();
@@ -98,43 +152,35 @@ zx_status_t dlog_write(uint32_t flags, const void* ptr, size_t len) {
         hdr.tid = 0;
     }
 
+    // Keep interrupts off between reserving the space and publishing
+    // the record, so that a writer isn't preempted in the middle and
+    // readers aren't left waiting on it.  If a writer were lapped while
+    // it was copying it could still scribble on a newer record; with
+    // interrupts off that takes a fifo's worth of writes from the other
+    // cpus in the time it takes to copy one record.
     spin_lock_saved_state_t state;
-    spin_lock_irqsave(&log->lock, state);
+    arch_interrupt_save(&state, ARCH_DEFAULT_SPIN_LOCK_FLAG_INTERRUPTS);
 
-    // Discard records at tail until there is enough
-    // space for the new record.
-    while ((log->head - log->tail) > (DLOG_SIZE - wiresize)) {
-        uint32_t header = *((uint32_t*) (log->data + (log->tail & DLOG_MASK)));
-        log->tail += DLOG_HDR_GET_FIFOLEN(header);
-    }
+    uint64_t stamp = atomic_add_u64(&log->head, DLOG_ONE_RECORD + wiresize);
+    uint64_t next = stamp + DLOG_ONE_RECORD + wiresize;
 
-    size_t offset = (log->head & DLOG_MASK);
+    // readers that see any of the record must also see head moved past it
+    atomic_fence_release();
 
-    size_t fifospace = DLOG_SIZE - offset;
+    dlog_copy_in(log, stamp + DLOG_STAMP_SIZE, &hdr, sizeof(hdr));
+    dlog_copy_in(log, stamp + DLOG_STAMP_SIZE + sizeof(hdr), ptr, len);
 
-    if (fifospace >= wiresize) {
-        // everything fits in one write, simple case!
-        memcpy(log->data + offset, &hdr, sizeof(hdr));
-        memcpy(log->data + offset + sizeof(hdr), ptr, len);
-    } else if (fifospace < sizeof(hdr)) {
-        // the wrap happens in the header
-        memcpy(log->data + offset, &hdr, fifospace);
-        memcpy(log->data, ((void*) &hdr) + fifospace, sizeof(hdr) - fifospace);
-        memcpy(log->data + (sizeof(hdr) - fifospace), ptr, len);
-    } else {
-        // the wrap happens in the data
-        memcpy(log->data + offset, &hdr, sizeof(hdr));
-        offset += sizeof(hdr);
-        fifospace -= sizeof(hdr);
-        memcpy(log->data + offset, ptr, fifospace);
-        memcpy(log->data, ptr + fifospace, len - fifospace);
+    // if the next record is the first in its chunk, mark where it starts
+    if ((DLOG_POS(stamp) / DLOG_MARK_SIZE) != (DLOG_POS(next) / DLOG_MARK_SIZE)) {
+        atomic_store_u64(&log->marks[(DLOG_POS(next) / DLOG_MARK_SIZE) % DLOG_MARKS], next);
     }
-    log->head += wiresize;
 
-    // Need to check this before re-releasing the log lock, since we may
-    // re-enable interrupts while doing that.  If interrupts are enabled when we
-    // make this check, we could see the following sequence of events between
-    // two CPUs and incorrectly conclude we are holding the thread lock:
+    atomic_store_u64(dlog_stamp(log, stamp), stamp);
+
+    // Need to check this before re-enabling interrupts.  If interrupts are
+    // enabled when we make this check, we could see the following sequence
+    // of events between two CPUs and incorrectly conclude we are holding
+    // the thread lock:
     // C2: Acquire thread_lock
     // C1: Running this thread, evaluate spin_lock_holder_cpu(&thread_lock) -> C2
     // C1: Context switch away
@@ -143,7 +189,7 @@ zx_status_t dlog_write(uint32_t flags, const void* ptr, size_t len) {
     // C2: Running this thread, evaluate arch_curr_cpu_num() -> C2
     bool holding_thread_lock = spin_lock_holder_cpu(&thread_lock) == arch_curr_cpu_num();
 
-    spin_unlock_irqrestore(&log->lock, state);
+    arch_interrupt_restore(state, ARCH_DEFAULT_SPIN_LOCK_FLAG_INTERRUPTS);
 
     // if we happen to be called from within the global thread lock, use a
     // special version of event signal
@@ -156,78 +202,111 @@ zx_status_t dlog_write(uint32_t flags, const void* ptr, size_t len) {
     return ZX_OK;
 }
 
-// TODO: support reading multiple messages at a time
+// Returns the oldest record a reader can still safely start from, given
+// the current value of head.
+static uint64_t dlog_oldest(dlog_t* log, uint64_t head) {
+    // nothing has been overwritten until the fifo fills up once
+    if (DLOG_POS(head) <= DLOG_SIZE) {
+        return DLOG_ONE_RECORD;
+    }
+
+    // resume at a chunk that leaves a record's worth of room for writers
+    // that reserve space while we catch up
+    uint64_t chunk = (DLOG_POS(head) - DLOG_SIZE) / DLOG_MARK_SIZE + 2;
+    uint64_t mark = atomic_load_u64(&log->marks[chunk % DLOG_MARKS]);
+
+    // a mark left from a previous lap, or one still to be written, is no use
+    if (DLOG_POS(mark) / DLOG_MARK_SIZE != chunk) {
+        return head;
+    }
+    return mark;
+}
+
 // TODO: filter with flags
-zx_status_t dlog_read(dlog_reader_t* rdr, uint32_t flags, void* ptr, size_t len, size_t* _actual) {
+zx_status_t dlog_read(dlog_reader_t* rdr, uint32_t flags, void* _ptr, size_t len, size_t* _actual) {
     // must be room for worst-case read
     if (len < DLOG_MAX_RECORD) {
         return ZX_ERR_BUFFER_TOO_SMALL;
     }
 
     dlog_t* log = rdr->log;
-    zx_status_t status = ZX_ERR_SHOULD_WAIT;
+    uint8_t* ptr = _ptr;
+    uint64_t cursor = rdr->cursor;
+    size_t offset = 0;
+    size_t actual = 0;
 
-    spin_lock_saved_state_t state;
-    spin_lock_irqsave(&log->lock, state);
+    for (;;) {
+        uint64_t head = atomic_load_u64(&log->head);
+        if (cursor == head) {
+            break;
+        }
 
-    size_t rtail = rdr->tail;
+        // If the cursor has fallen more than a fifo behind head, this
+        // reader has been lapped by a writer and skips ahead.
+        if (dlog_distance(cursor, head) > DLOG_SIZE) {
+            uint64_t oldest = dlog_oldest(log, head);
+            rdr->dropped += dlog_records(cursor, oldest);
+            cursor = oldest;
+            continue;
+        }
 
-    // If the read-tail is not within the range of log-tail..log-head
-    // this reader has been lapped by a writer and we reset our read-tail
-    // to the current log-tail.
-    //
-    if ((log->head - log->tail) < (log->head - rtail)) {
-        rtail = log->tail;
-    }
+        // not published yet; the writer will signal when it is
+        if (atomic_load_u64(dlog_stamp(log, cursor)) != cursor) {
+            break;
+        }
 
-    if (rtail != log->head) {
-        size_t offset = (rtail & DLOG_MASK);
-        uint32_t header = *((uint32_t*) (log->data + offset));
+        dlog_header_t hdr;
+        dlog_copy_out(log, cursor + DLOG_STAMP_SIZE, &hdr, sizeof(hdr));
 
-        size_t actual = DLOG_HDR_GET_READLEN(header);
-        size_t fifospace = DLOG_SIZE - offset;
+        // the length may be garbage if the record is being overwritten,
+        // in which case the check below throws it away
+        size_t datalen = MIN(hdr.datalen, DLOG_MAX_DATA);
+        if (offset + DLOG_MIN_RECORD + datalen > len) {
+            break;
+        }
+        dlog_copy_out(log, cursor + DLOG_STAMP_SIZE + sizeof(hdr),
+                      ptr + offset + sizeof(hdr), datalen);
 
-        if (fifospace >= actual) {
-            memcpy(ptr, log->data + offset, actual);
-        } else {
-            memcpy(ptr, log->data + offset, fifospace);
-            memcpy(ptr + fifospace, log->data, actual - fifospace);
+        atomic_fence_acquire();
+        if (dlog_distance(cursor, atomic_load_u64_relaxed(&log->head)) > DLOG_SIZE) {
+            continue;
         }
 
-        *_actual = actual;
-        status = ZX_OK;
+        hdr.dropped = (uint32_t) MIN(rdr->dropped, UINT32_MAX);
+        rdr->dropped = 0;
+        memcpy(ptr + offset, &hdr, sizeof(hdr));
 
-        rtail += DLOG_HDR_GET_FIFOLEN(header);
+        actual = offset + DLOG_MIN_RECORD + datalen;
+        offset = ALIGN8(actual);
+        cursor += DLOG_ONE_RECORD + DLOG_WIRESIZE(datalen);
     }
 
-    rdr->tail = rtail;
-
-    spin_unlock_irqrestore(&log->lock, state);
+    rdr->cursor = cursor;
 
-    return status;
+    if (actual == 0) {
+        return ZX_ERR_SHOULD_WAIT;
+    }
+    *_actual = actual;
+    return ZX_OK;
 }
 
 void dlog_reader_init(dlog_reader_t* rdr, void (*notify)(void*), void* cookie) {
     dlog_t* log = &DLOG;
 
     rdr->log = log;
+    rdr->dropped = 0;
     rdr->notify = notify;
     rdr->cookie = cookie;
 
     mutex_acquire(&log->readers_lock);
     list_add_tail(&log->readers, &rdr->node);
 
-    bool do_notify = false;
-
-    spin_lock_saved_state_t state;
-    spin_lock_irqsave(&log->lock, state);
-    rdr->tail = log->tail;
-    do_notify = (log->tail != log->head);
-    spin_unlock_irqrestore(&log->lock, state);
+    uint64_t head = atomic_load_u64(&log->head);
+    rdr->cursor = dlog_oldest(log, head);
 
     // simulate notify callback for events that arrived
     // before we were initialized
-    if(do_notify && notify) {
+    if ((rdr->cursor != head) && notify) {
         notify(cookie);
     }
 
@@ -278,10 +357,8 @@ static int debuglog_dumper(void *arg) {
     // assembly buffer with room for log text plus header text
     char tmp[DLOG_MAX_DATA + 128];
 
-    struct {
-        dlog_header_t hdr;
-        char data[DLOG_MAX_DATA + 1];
-    } rec;
+    // records come out a batch at a time
+    uint64_t batch[DLOG_MAX_RECORD * 4 / sizeof(uint64_t)];
 
     event_t event = EVENT_INITIAL_VALUE(event, 0, EVENT_FLAG_AUTOUNSIGNAL);
 
@@ -293,22 +370,32 @@ static int debuglog_dumper(void *arg) {
 
         // dump records to kernel console
         size_t actual;
-        while (dlog_read(&reader, 0, &rec, DLOG_MAX_RECORD, &actual) == ZX_OK) {
-            if (rec.hdr.datalen && (rec.data[rec.hdr.datalen - 1] == '\n')) {
-                rec.data[rec.hdr.datalen - 1] = 0;
-            } else {
-                rec.data[rec.hdr.datalen] = 0;
-            }
-            int n;
-            n = snprintf(tmp, sizeof(tmp), "[%05d.%03d] %05" PRIu64 ".%05" PRIu64 "> %s\n",
-                         (int) (rec.hdr.timestamp / ZX_SEC(1)),
-                         (int) ((rec.hdr.timestamp / ZX_MSEC(1)) % 1000ULL),
-                         rec.hdr.pid, rec.hdr.tid, rec.data);
-            if (n > (int)sizeof(tmp)) {
-                n = sizeof(tmp);
+        while (dlog_read(&reader, 0, batch, sizeof(batch), &actual) == ZX_OK) {
+            for (size_t offset = 0; offset < actual;) {
+                dlog_record_t* rec = (dlog_record_t*) ((uint8_t*) batch + offset);
+                offset = ALIGN8(offset + DLOG_MIN_RECORD + rec->hdr.datalen);
+
+                int datalen = rec->hdr.datalen;
+                if (datalen && (rec->data[datalen - 1] == '\n')) {
+                    datalen--;
+                }
+                int n;
+                if (rec->hdr.dropped) {
+                    n = snprintf(tmp, sizeof(tmp), "[dlog] %u records dropped\n",
+                                 rec->hdr.dropped);
+                    __kernel_console_write(tmp, n);
+                    __kernel_serial_write(tmp, n);
+                }
+                n = snprintf(tmp, sizeof(tmp), "[%05d.%03d] %05" PRIu64 ".%05" PRIu64 "> %.*s\n",
+                             (int) (rec->hdr.timestamp / ZX_SEC(1)),
+                             (int) ((rec->hdr.timestamp / ZX_MSEC(1)) % 1000ULL),
+                             rec->hdr.pid, rec->hdr.tid, datalen, rec->data);
+                if (n > (int)sizeof(tmp)) {
+                    n = sizeof(tmp);
+                }
+                __kernel_console_write(tmp, n);
+                __kernel_serial_write(tmp, n);
             }
-            __kernel_console_write(tmp, n);
-            __kernel_serial_write(tmp, n);
         }
     }
 
@@ -20,14 +20,19 @@ typedef struct dlog_header dlog_header_t;
 typedef struct dlog_record dlog_record_t;
 typedef struct dlog_reader dlog_reader_t;
 
-struct dlog {
-    spin_lock_t lock;
+#define DLOG_MARKS               (32u)
 
-    size_t head;
-    size_t tail;
+struct dlog {
+    // next position to write a record at, with the count of records
+    // written packed above it. writers reserve space by adding to it.
+    uint64_t head;
 
     void* data;
 
+    // record boundaries at DLOG_SIZE / DLOG_MARKS intervals, used by
+    // readers that have been lapped to find somewhere to resume
+    uint64_t marks[DLOG_MARKS];
+
     bool panic;
 
     event_t event;
@@ -40,24 +45,24 @@ struct dlog_reader {
     struct list_node node;
 
     dlog_t* log;
-    size_t tail;
+
+    // owned by the reader: the record it will read next, and how many
+    // records it has missed since the last one it read
+    uint64_t cursor;
+    uint64_t dropped;
 
     void (*notify)(void* cookie);
     void *cookie;
 };
 
-#define DLOG_HDR_SET(fifosize, readsize) \
-    ((((readsize) & 0xFFF) << 12) | ((fifosize) & 0xFFF))
-
-#define DLOG_HDR_GET_FIFOLEN(n)   ((n) & 0xFFF)
-#define DLOG_HDR_GET_READLEN(n)  (((n) >> 12) & 0xFFF)
-
 #define DLOG_MIN_RECORD          (32u)
 #define DLOG_MAX_DATA            (224u)
 #define DLOG_MAX_RECORD          (DLOG_MIN_RECORD + DLOG_MAX_DATA)
 
 struct dlog_header {
-    uint32_t header;
+    // filled in on read with the number of records the reader missed
+    // immediately before this one
+    uint32_t dropped;
     uint16_t datalen;
     uint16_t flags;
     uint64_t timestamp;
@@ -76,6 +81,10 @@ static_assert(sizeof(dlog_record_t) == DLOG_MAX_RECORD, "");
 void dlog_reader_init(dlog_reader_t* rdr, void (*notify)(void*), void* cookie);
 void dlog_reader_destroy(dlog_reader_t* rdr);
 zx_status_t dlog_write(uint32_t flags, const void* ptr, size_t len);
+
+// Reads as many whole records as fit in |len| bytes, which must have room
+// for at least DLOG_MAX_RECORD. Records start at 8 byte aligned offsets
+// and |actual| is the end of the last one.
 zx_status_t dlog_read(dlog_reader_t* rdr, uint32_t flags, void* ptr, size_t len, size_t* actual);
 
 // bluescreen_init should be called at the "start" of a fatal fault or
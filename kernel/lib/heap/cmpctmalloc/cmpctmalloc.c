@@ -15,9 +15,11 @@
 
 #include <debug.h>
 #include <err.h>
+#include <kernel/align.h>
 #include <kernel/mutex.h>
 #include <kernel/spinlock.h>
 #include <kernel/thread.h>
+#include <arch/ops.h>
 #include <vm/vm.h>
 #include <lib/heap.h>
 #include <platform.h>
@@ -206,6 +208,9 @@ struct heap {
 static struct heap theheap;
 
 static ssize_t heap_grow(size_t len, free_t** bucket);
+static void* heap_alloc(size_t size, int start_bucket, size_t rounded_up);
+static void heap_free(void* payload);
+static void magazines_drain(void);
 
 static void lock(void) TA_ACQ(theheap.lock) {
     mutex_acquire(&theheap.lock);
@@ -481,6 +486,314 @@ static void FixLeftPointer(header_t* right, header_t* new_left) {
     right->left = (header_t*)(((uintptr_t)new_left & ~1) | tag);
 }
 
+// Per-cpu magazines.
+//
+// Allocations and frees in the small buckets are first tried against magazines
+// of cached objects, which are per-cpu and so don't need the heap lock. Each
+// cpu keeps a loaded and a previous magazine per bucket and swaps them when the
+// loaded one runs empty (or full, on free), so flipping between allocating and
+// freeing around a magazine boundary doesn't go any further. Past that, full
+// and empty magazines are traded with the bucket's depot, which is also how
+// objects freed on one cpu end up allocated on another. The heap proper is
+// only used when neither can help. To the heap, the objects sitting in
+// magazines are still allocated.
+//
+// With CMPCT_DEBUG every alloc and free has to go through the heap for the
+// fill checks to mean anything, so there are no magazines.
+
+// Buckets 0 to 31, for up to 512 bytes.
+#define MAGAZINE_BUCKETS 32
+#define MAGAZINE_MAX_SIZE 512
+#define MAGAZINE_ROUNDS 15
+// How many magazines of each kind a depot holds on to per bucket. Past that,
+// frees go to the heap and spare empty magazines are freed.
+#define DEPOT_MAX_MAGAZINES 8
+
+typedef struct magazine {
+    struct magazine* next;
+    size_t rounds;
+    void* objs[MAGAZINE_ROUNDS];
+} magazine_t;
+
+typedef struct magazine_bucket {
+    magazine_t* loaded;
+    magazine_t* previous;
+
+    // Served from the cpu's magazines, or by the heap instead.
+    uint64_t alloc_hits;
+    uint64_t alloc_misses;
+    uint64_t free_hits;
+    uint64_t free_misses;
+} magazine_bucket_t;
+
+typedef struct magazine_cpu {
+    spin_lock_t lock;
+    magazine_bucket_t buckets[MAGAZINE_BUCKETS];
+} __CPU_ALIGN magazine_cpu_t;
+
+typedef struct depot {
+    spin_lock_t lock;
+    magazine_t* full;
+    magazine_t* empty;
+    size_t full_count;
+    size_t empty_count;
+
+    // Full magazines handed out to allocating cpus and taken in from freeing
+    // ones.
+    uint64_t full_out;
+    uint64_t full_in;
+} __CPU_ALIGN depot_t;
+
+static magazine_cpu_t magazine_cpus[SMP_MAX_CPUS];
+static depot_t depots[MAGAZINE_BUCKETS];
+
+#ifdef CMPCT_DEBUG
+static bool magazines_enabled = false;
+#else
+static bool magazines_enabled = true;
+#endif
+
+static_assert(MAGAZINE_BUCKETS <= NUMBER_OF_BUCKETS, "");
+
+// The size of the objects in a bucket, not including the header.
+static size_t bucket_size(int bucket) {
+    if (bucket < 15) {
+        return (bucket + 1) * 8;
+    }
+    int row_column = bucket + 32 - 15;
+    return (8 + (row_column & 7)) << (row_column >> 3);
+}
+
+static void magazine_push(magazine_t** list, magazine_t* mag) {
+    if (mag != NULL) {
+        mag->next = *list;
+        *list = mag;
+    }
+}
+
+static magazine_t* magazine_pop(magazine_t** list) {
+    magazine_t* mag = *list;
+    if (mag != NULL) {
+        *list = mag->next;
+    }
+    return mag;
+}
+
+// Magazines themselves come from the heap proper, so that they don't end up
+// in magazines for their own size.
+static magazine_t* magazine_create(void) {
+    size_t rounded_up;
+    int bucket = size_to_index_allocating(sizeof(magazine_t), &rounded_up);
+    magazine_t* mag = heap_alloc(sizeof(magazine_t), bucket, rounded_up);
+    if (mag != NULL) {
+        mag->next = NULL;
+        mag->rounds = 0;
+    }
+    return mag;
+}
+
+// Gives |list| and everything in it back to the heap.
+static void magazines_release(magazine_t* list) {
+    magazine_t* mag;
+    while ((mag = magazine_pop(&list)) != NULL) {
+        while (mag->rounds > 0) {
+            heap_free(mag->objs[--mag->rounds]);
+        }
+        heap_free(mag);
+    }
+}
+
+static void* magazine_alloc(int bucket) {
+    DEBUG_ASSERT(bucket < MAGAZINE_BUCKETS);
+
+    // If we move cpus after picking one, we just use its magazines from here.
+    magazine_cpu_t* cpu = &magazine_cpus[arch_curr_cpu_num()];
+    magazine_bucket_t* b = &cpu->buckets[bucket];
+    magazine_t* spare = NULL;
+    void* result = NULL;
+
+    spin_lock_saved_state_t state;
+    spin_lock_irqsave(&cpu->lock, state);
+
+    if (b->loaded == NULL || b->loaded->rounds == 0) {
+        if (b->previous != NULL && b->previous->rounds > 0) {
+            magazine_t* tmp = b->loaded;
+            b->loaded = b->previous;
+            b->previous = tmp;
+        } else {
+            // Trade the previous magazine, which is empty, for a full one.
+            depot_t* depot = &depots[bucket];
+            spin_lock(&depot->lock);
+            magazine_t* full = magazine_pop(&depot->full);
+            if (full != NULL) {
+                depot->full_count--;
+                depot->full_out++;
+                if (depot->empty_count < DEPOT_MAX_MAGAZINES) {
+                    magazine_push(&depot->empty, b->previous);
+                    depot->empty_count += (b->previous != NULL);
+                } else {
+                    spare = b->previous;
+                }
+                b->previous = b->loaded;
+                b->loaded = full;
+            }
+            spin_unlock(&depot->lock);
+        }
+    }
+
+    if (b->loaded != NULL && b->loaded->rounds > 0) {
+        result = b->loaded->objs[--b->loaded->rounds];
+        b->alloc_hits++;
+    } else {
+        b->alloc_misses++;
+    }
+
+    spin_unlock_irqrestore(&cpu->lock, state);
+
+    if (spare != NULL) {
+        heap_free(spare);
+    }
+    return result;
+}
+
+// Returns false if the object has to go to the heap instead.
+static bool magazine_free(int bucket, void* payload) {
+    DEBUG_ASSERT(bucket < MAGAZINE_BUCKETS);
+
+    magazine_cpu_t* cpu = &magazine_cpus[arch_curr_cpu_num()];
+    magazine_bucket_t* b = &cpu->buckets[bucket];
+    depot_t* depot = &depots[bucket];
+    magazine_t* fresh = NULL;
+
+    for (;;) {
+        spin_lock_saved_state_t state;
+        spin_lock_irqsave(&cpu->lock, state);
+
+        if (b->loaded == NULL || b->loaded->rounds == MAGAZINE_ROUNDS) {
+            if (b->previous != NULL && b->previous->rounds < MAGAZINE_ROUNDS) {
+                magazine_t* tmp = b->loaded;
+                b->loaded = b->previous;
+                b->previous = tmp;
+            } else {
+                // Trade the previous magazine, which is full, for an empty
+                // one.
+                spin_lock(&depot->lock);
+                if (depot->full_count < DEPOT_MAX_MAGAZINES || b->previous == NULL) {
+                    magazine_t* empty = fresh;
+                    if (empty != NULL) {
+                        fresh = NULL;
+                    } else if ((empty = magazine_pop(&depot->empty)) != NULL) {
+                        depot->empty_count--;
+                    }
+                    if (empty != NULL) {
+                        if (b->previous != NULL) {
+                            magazine_push(&depot->full, b->previous);
+                            depot->full_count++;
+                            depot->full_in++;
+                        }
+                        b->previous = b->loaded;
+                        b->loaded = empty;
+                    }
+                }
+                bool need_empty = b->loaded == NULL || (b->loaded->rounds == MAGAZINE_ROUNDS &&
+                                                        depot->full_count < DEPOT_MAX_MAGAZINES);
+                spin_unlock(&depot->lock);
+
+                // The depot had no empty magazine to give, so make one
+                // without any locks held and try again.
+                if (need_empty && fresh == NULL) {
+                    spin_unlock_irqrestore(&cpu->lock, state);
+                    fresh = magazine_create();
+                    if (fresh != NULL) {
+                        continue;
+                    }
+                    spin_lock_irqsave(&cpu->lock, state);
+                }
+            }
+        }
+
+        bool cached = b->loaded != NULL && b->loaded->rounds < MAGAZINE_ROUNDS;
+        if (cached) {
+            b->loaded->objs[b->loaded->rounds++] = payload;
+            b->free_hits++;
+        } else {
+            b->free_misses++;
+        }
+
+        spin_unlock_irqrestore(&cpu->lock, state);
+
+        if (fresh != NULL) {
+            heap_free(fresh);
+        }
+        return cached;
+    }
+}
+
+// Gives everything held in magazines back to the heap.
+static void magazines_drain(void) {
+    magazine_t* list = NULL;
+
+    for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+        magazine_cpu_t* cpu = &magazine_cpus[i];
+        spin_lock_saved_state_t state;
+        spin_lock_irqsave(&cpu->lock, state);
+        for (int bucket = 0; bucket < MAGAZINE_BUCKETS; bucket++) {
+            magazine_push(&list, cpu->buckets[bucket].loaded);
+            magazine_push(&list, cpu->buckets[bucket].previous);
+            cpu->buckets[bucket].loaded = NULL;
+            cpu->buckets[bucket].previous = NULL;
+        }
+        spin_unlock_irqrestore(&cpu->lock, state);
+    }
+
+    for (int bucket = 0; bucket < MAGAZINE_BUCKETS; bucket++) {
+        depot_t* depot = &depots[bucket];
+        spin_lock_saved_state_t state;
+        spin_lock_irqsave(&depot->lock, state);
+        magazine_t* mag;
+        while ((mag = magazine_pop(&depot->full)) != NULL) {
+            magazine_push(&list, mag);
+        }
+        while ((mag = magazine_pop(&depot->empty)) != NULL) {
+            magazine_push(&list, mag);
+        }
+        depot->full_count = 0;
+        depot->empty_count = 0;
+        spin_unlock_irqrestore(&depot->lock, state);
+    }
+
+    magazines_release(list);
+}
+
+void cmpct_dump_magazines(bool panic_time) TA_NO_THREAD_SAFETY_ANALYSIS {
+    // The counts are read without the locks. At panic time that's all we can
+    // do, and otherwise being a little stale is harmless.
+    dprintf(INFO, "Heap magazines (%s, %d rounds):\n",
+            magazines_enabled ? "enabled" : "disabled", MAGAZINE_ROUNDS);
+    dprintf(INFO, "\t%6s %10s %10s %10s %10s %6s %6s %10s %10s\n",
+            "size", "alloc hit", "miss", "free hit", "miss",
+            "full", "empty", "depot out", "in");
+    for (int bucket = 0; bucket < MAGAZINE_BUCKETS; bucket++) {
+        uint64_t alloc_hits = 0, alloc_misses = 0, free_hits = 0, free_misses = 0;
+        for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+            const magazine_bucket_t* b = &magazine_cpus[i].buckets[bucket];
+            alloc_hits += b->alloc_hits;
+            alloc_misses += b->alloc_misses;
+            free_hits += b->free_hits;
+            free_misses += b->free_misses;
+        }
+        const depot_t* depot = &depots[bucket];
+        if (alloc_hits + alloc_misses + free_hits + free_misses == 0) {
+            continue;
+        }
+        dprintf(INFO, "\t%6zu %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64
+                      " %6zu %6zu %10" PRIu64 " %10" PRIu64 "\n",
+                bucket_size(bucket), alloc_hits, alloc_misses, free_hits, free_misses,
+                depot->full_count, depot->empty_count, depot->full_out, depot->full_in);
+    }
+    (void)panic_time;
+}
+
 static void WasteFreeMemory(void) {
     while (theheap.remaining != 0) {
         cmpct_alloc(1);
@@ -741,6 +1054,12 @@ static void cmpct_test_return_to_os(void) {
 }
 
 void cmpct_test(void) {
+    // The tests below look at where things land in the heap proper, so keep
+    // the magazines out of the way while they run.
+    bool magazines_were_enabled = magazines_enabled;
+    magazines_enabled = false;
+    magazines_drain();
+
     cmpct_test_buckets();
     cmpct_test_get_back_newly_freed();
     cmpct_test_return_to_os();
@@ -799,6 +1118,8 @@ void cmpct_test(void) {
     }
 
     cmpct_dump(false);
+
+    magazines_enabled = magazines_were_enabled;
 }
 
 static void check_free_fill(void* ptr, size_t size) {
@@ -851,6 +1172,9 @@ static void* large_alloc(size_t size) {
 }
 
 void cmpct_trim(void) {
+    // Whatever the magazines are holding on to can't be trimmed.
+    magazines_drain();
+
     // Look at free list entries that are at least as large as one page plus a
     // header. They might be at the start or the end of a block, so we can trim
     // them and free the page(s).
@@ -960,6 +1284,17 @@ void* cmpct_alloc(size_t size) {
     size_t rounded_up;
     int start_bucket = size_to_index_allocating(size, &rounded_up);
 
+    if (start_bucket < MAGAZINE_BUCKETS && magazines_enabled) {
+        void* result = magazine_alloc(start_bucket);
+        if (result != NULL) {
+            return result;
+        }
+    }
+
+    return heap_alloc(size, start_bucket, rounded_up);
+}
+
+static void* heap_alloc(size_t size, int start_bucket, size_t rounded_up) {
     rounded_up += sizeof(header_t);
 
     lock();
@@ -1045,6 +1380,20 @@ void cmpct_free(void* payload) {
     }
     header_t* header = (header_t*)payload - 1;
     DEBUG_ASSERT(!is_tagged_as_free(header)); // Double free!
+
+    size_t usable = header->size - sizeof(header_t);
+    if (usable <= 2 * MAGAZINE_MAX_SIZE && magazines_enabled) {
+        int bucket = size_to_index_freeing(usable);
+        if (bucket < MAGAZINE_BUCKETS && magazine_free(bucket, payload)) {
+            return;
+        }
+    }
+
+    heap_free(payload);
+}
+
+static void heap_free(void* payload) {
+    header_t* header = (header_t*)payload - 1;
     size_t size = header->size;
     lock();
     header_t* left = header->left;
@@ -21,6 +21,7 @@ void* cmpct_memalign(size_t size, size_t alignment);
 
 void cmpct_init(void);
 void cmpct_dump(bool panic_time);
+void cmpct_dump_magazines(bool panic_time);
 void cmpct_get_info(size_t* size_bytes, size_t* free_bytes);
 void cmpct_test(void);
 void cmpct_trim(void);
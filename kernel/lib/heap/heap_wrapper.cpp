@@ -186,6 +186,7 @@ notenoughargs:
 usage:
         printf("usage:\n");
         printf("\t%s info\n", argv[0].str);
+        printf("\t%s mag\n", argv[0].str);
         if (!(flags & CMD_FLAG_PANIC)) {
             printf("\t%s trace\n", argv[0].str);
             printf("\t%s trim\n", argv[0].str);
@@ -198,6 +199,8 @@ usage:
 
     if (strcmp(argv[1].str, "info") == 0) {
         heap_dump(flags & CMD_FLAG_PANIC);
+    } else if (strcmp(argv[1].str, "mag") == 0) {
+        cmpct_dump_magazines(flags & CMD_FLAG_PANIC);
     } else if (!(flags & CMD_FLAG_PANIC) && strcmp(argv[1].str, "test") == 0) {
         heap_test();
     } else if (!(flags & CMD_FLAG_PANIC) && strcmp(argv[1].str, "trace") == 0) {
@@ -63,6 +63,7 @@ zx_status_t GuestPhysicalAddressSpace::Create(fbl::RefPtr<VmObject> guest_phys_m
         guest_phys_mem, /* vmo_offset */ 0, kMmuFlags, "guest_phys_mem_vmo", &mapping);
     if (status != ZX_OK)
         return status;
+    gpas->guest_phys_mapping_ = fbl::move(mapping);
 
     *_gpas = fbl::move(gpas);
     return ZX_OK;
@@ -79,6 +80,16 @@ GuestPhysicalAddressSpace::~GuestPhysicalAddressSpace() {
         paspace_->Destroy();
 }
 
+zx_status_t GuestPhysicalAddressSpace::Populate() {
+    // Commit the VMO first: a VMO created with ZX_VMO_LARGE_PAGES is then
+    // backed by large pages, which MapRange() coalesces into contiguous runs.
+    uint64_t committed;
+    zx_status_t status = guest_phys_mem_->CommitRange(0, guest_phys_mem_->size(), &committed);
+    if (status != ZX_OK)
+        return status;
+    return guest_phys_mapping_->MapRange(0, guest_phys_mapping_->size(), false);
+}
+
 zx_status_t GuestPhysicalAddressSpace::MapInterruptController(vaddr_t guest_paddr,
                                                               paddr_t host_paddr, size_t size) {
     fbl::RefPtr<VmObject> vmo;
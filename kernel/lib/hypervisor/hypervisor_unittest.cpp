@@ -7,6 +7,7 @@
 #include <assert.h>
 #include <err.h>
 #include <hypervisor/guest_physical_address_space.h>
+#include <hypervisor/trap_map.h>
 #include <vm/vm.h>
 #include <vm/pmm.h>
 #include <vm/vm_address_region.h>
@@ -14,6 +15,7 @@
 #include <vm/vm_object.h>
 #include <vm/vm_object_paged.h>
 #include <unittest.h>
+#include <zircon/syscalls/hypervisor.h>
 
 static zx_status_t get_paddr(void* context, size_t offset, size_t index, paddr_t pa) {
     *static_cast<paddr_t*>(context) = pa;
@@ -174,6 +176,41 @@ static bool guest_physical_address_space_get_page_complex(void* context) {
     END_TEST;
 }
 
+static bool trap_map_find_trap(void* context) {
+    BEGIN_TEST;
+
+    TrapMap traps;
+    zx_status_t status = traps.InsertTrap(ZX_GUEST_TRAP_BELL, 0x1000, PAGE_SIZE, nullptr, 1);
+    EXPECT_EQ(ZX_OK, status, "Failed to insert bell trap\n");
+    status = traps.InsertTrap(ZX_GUEST_TRAP_MEM, 0x3000, PAGE_SIZE, nullptr, 2);
+    EXPECT_EQ(ZX_OK, status, "Failed to insert mem trap\n");
+    status = traps.InsertTrap(ZX_GUEST_TRAP_IO, 0x1000, 8, nullptr, 3);
+    EXPECT_EQ(ZX_OK, status, "Failed to insert io trap\n");
+
+    // Look up each trap twice, so the second lookup is answered by the cache
+    // of the last trap found.
+    Trap* trap;
+    for (int i = 0; i < 2; i++) {
+        status = traps.FindTrap(ZX_GUEST_TRAP_BELL, 0x1008, &trap);
+        EXPECT_EQ(ZX_OK, status, "Failed to find bell trap\n");
+        EXPECT_EQ(1u, trap->key(), "Found the wrong trap\n");
+        status = traps.FindTrap(ZX_GUEST_TRAP_IO, 0x1004, &trap);
+        EXPECT_EQ(ZX_OK, status, "Failed to find io trap\n");
+        EXPECT_EQ(3u, trap->key(), "Found the wrong trap\n");
+    }
+
+    // Lookups that miss the cached trap still find the right one.
+    status = traps.FindTrap(ZX_GUEST_TRAP_MEM, 0x3ff8, &trap);
+    EXPECT_EQ(ZX_OK, status, "Failed to find mem trap\n");
+    EXPECT_EQ(2u, trap->key(), "Found the wrong trap\n");
+    status = traps.FindTrap(ZX_GUEST_TRAP_MEM, 0x2000, &trap);
+    EXPECT_EQ(ZX_ERR_NOT_FOUND, status, "Found a trap between traps\n");
+    status = traps.FindTrap(ZX_GUEST_TRAP_IO, 0x1008, &trap);
+    EXPECT_EQ(ZX_ERR_NOT_FOUND, status, "Found a trap past the end of a trap\n");
+
+    END_TEST;
+}
+
 #if ARCH_X86_64
 static bool guest_physical_address_space_map_apic_page(void* context) {
     BEGIN_TEST;
@@ -213,6 +250,7 @@ HYPERVISOR_UNITTEST(guest_physical_address_space_unmap_range)
 HYPERVISOR_UNITTEST(guest_physical_address_space_get_page)
 HYPERVISOR_UNITTEST(guest_physical_address_space_get_page_complex)
 HYPERVISOR_UNITTEST(guest_physical_address_space_get_page_not_present)
+HYPERVISOR_UNITTEST(trap_map_find_trap)
 #if ARCH_X86_64
 HYPERVISOR_UNITTEST(guest_physical_address_space_map_apic_page)
 #endif // ARCH_X86_64
@@ -22,6 +22,11 @@ public:
     // TODO(abdulla): Remove this function.
     zx_paddr_t table_phys() { return paspace_->arch_aspace().arch_table_phys(); }
 
+    // Commits all of guest physical memory and maps it up front, so the guest
+    // doesn't take an EPT violation the first time it touches each page.
+    // Physically contiguous, aligned runs of the VMO are mapped with large
+    // pages where the page tables support them.
+    zx_status_t Populate();
     zx_status_t MapInterruptController(vaddr_t guest_paddr, paddr_t host_paddr, size_t size);
     zx_status_t UnmapRange(vaddr_t guest_paddr, size_t size);
     zx_status_t GetPage(vaddr_t guest_paddr, paddr_t* host_paddr);
@@ -29,6 +34,7 @@ public:
 private:
     fbl::RefPtr<VmAspace> paspace_;
     fbl::RefPtr<VmObject> guest_phys_mem_;
+    fbl::RefPtr<VmMapping> guest_phys_mapping_;
 
     explicit GuestPhysicalAddressSpace(fbl::RefPtr<VmObject> guest_phys_mem);
 };
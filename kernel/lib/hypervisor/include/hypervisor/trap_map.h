@@ -70,5 +70,12 @@ private:
     TrapTree mem_traps_ TA_GUARDED(mutex_);
     TrapTree io_traps_ TA_GUARDED(mutex_);
 
+    // The last trap found in each tree. Guests tend to hit the same doorbell
+    // over and over, and as traps are never removed while the map is alive,
+    // these can be checked atomically without taking |mutex_|.
+    Trap* last_mem_trap_ = nullptr;
+    Trap* last_io_trap_ = nullptr;
+
     TrapTree* TreeOf(uint32_t kind);
+    Trap** LastTrapOf(uint32_t kind);
 };
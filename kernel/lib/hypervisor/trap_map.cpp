@@ -91,6 +91,12 @@ zx_status_t TrapMap::FindTrap(uint32_t kind, zx_vaddr_t addr, Trap** trap) {
     TrapTree* traps = TreeOf(kind);
     if (traps == nullptr)
         return ZX_ERR_INVALID_ARGS;
+    Trap** last_trap = LastTrapOf(kind);
+    Trap* cached = __atomic_load_n(last_trap, __ATOMIC_ACQUIRE);
+    if (cached != nullptr && cached->Contains(addr)) {
+        *trap = cached;
+        return ZX_OK;
+    }
     TrapTree::iterator iter;
     {
         fbl::AutoLock lock(&mutex_);
@@ -100,6 +106,7 @@ zx_status_t TrapMap::FindTrap(uint32_t kind, zx_vaddr_t addr, Trap** trap) {
     if (!iter.IsValid() || !iter->Contains(addr))
         return ZX_ERR_NOT_FOUND;
     *trap = const_cast<Trap*>(&*iter);
+    __atomic_store_n(last_trap, *trap, __ATOMIC_RELEASE);
     return ZX_OK;
 }
 
@@ -114,3 +121,15 @@ TrapMap::TrapTree* TrapMap::TreeOf(uint32_t kind) {
         return nullptr;
     }
 }
+
+Trap** TrapMap::LastTrapOf(uint32_t kind) {
+    switch (kind) {
+    case ZX_GUEST_TRAP_BELL:
+    case ZX_GUEST_TRAP_MEM:
+        return &last_mem_trap_;
+    case ZX_GUEST_TRAP_IO:
+        return &last_io_trap_;
+    default:
+        return nullptr;
+    }
+}
@@ -16,7 +16,7 @@
 #define LOCAL_TRACE 0
 
 /*
- *  Calc total size of iovec buffers
+ *  Calc total size of iovec buffers, failing if it doesn't fit in a ssize_t
  */
 ssize_t iovec_size (const iovec_t *iov, uint iov_cnt)
 {
@@ -25,6 +25,8 @@ ssize_t iovec_size (const iovec_t *iov, uint iov_cnt)
 
     size_t c = 0;
     for (uint i = 0; i < iov_cnt; i++, iov++) {
+        if (iov->iov_len > (size_t) SSIZE_MAX - c)
+            return (ssize_t) ZX_ERR_OUT_OF_RANGE;
         c += iov->iov_len;
     }
     return (ssize_t) c;
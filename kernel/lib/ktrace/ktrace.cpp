@@ -6,11 +6,15 @@
 
 #include <debug.h>
 #include <err.h>
+#include <limits.h>
 #include <platform.h>
 #include <string.h>
 
 #include <arch/ops.h>
 #include <arch/user_copy.h>
+#include <fbl/atomic.h>
+#include <fbl/auto_lock.h>
+#include <kernel/align.h>
 #include <kernel/cmdline.h>
 #include <vm/vm_aspace.h>
 #include <lib/ktrace.h>
@@ -18,9 +22,11 @@
 #include <zircon/thread_annotations.h>
 #include <object/thread_dispatcher.h>
 
-#define ktrace_timestamp() current_ticks();
+#define ktrace_timestamp() current_ticks()
 #define ktrace_ticks_per_ms() (ticks_per_second() / 1000)
 
+using fbl::AutoLock;
+
 static void ktrace_name_etc(uint32_t tag, uint32_t id, uint32_t arg, const char* name, bool always);
 
 // Generated struct that has the syscall index and name.
@@ -77,40 +83,250 @@ static void ktrace_report_probes(void) {
     mutex_release(&probe_list_lock);
 }
 
-typedef struct ktrace_state {
-    // where the next record will be written
-    int offset;
+// Each cpu writes its records into its own part of the trace buffer, so
+// tracing on one cpu doesn't bounce cachelines with another. Space is claimed
+// by moving |tail| forward, and a record becomes visible once its tag, the
+// first word, is written. Until then the tag reads as zero.
+//
+// Normally nothing is ever taken out again, and each cpu's part fills up and
+// then drops what doesn't fit. In streaming mode reads consume records,
+// moving |head| forward, and each part is a ring. A record that runs past the
+// end of the ring is written into the slack after it rather than wrapped, so
+// every record can be read in one piece.
+typedef struct ktrace_cpu {
+    // Where the next record goes and where the reader picks up from. Both
+    // only ever grow; reduce them modulo the buffer size for the offset.
+    fbl::atomic<uint64_t> tail;
+    fbl::atomic<uint64_t> head;
+
+    // Records that didn't fit, and how many of those a reader has been told
+    // about with a TAG_DROPPED record.
+    fbl::atomic<uint64_t> dropped;
+    uint64_t dropped_reported;
 
+    uint8_t* buffer;
+} __CPU_ALIGN ktrace_cpu_t;
+
+typedef struct ktrace_state {
     // mask of groups we allow, 0 == tracing disabled
     int grpmask;
 
-    // total size of the trace buffer
-    uint32_t bufsize;
+    // whether reads consume records, see KTRACE_ACTION_START_STREAMING
+    bool streaming;
 
-    // offset where tracing was stopped, 0 if tracing active
-    uint32_t marker;
+    // size of each cpu's buffer, not counting the slack
+    uint32_t cpu_bufsize;
 
-    // raw trace buffer
-    uint8_t* buffer;
+    // most each cpu may have outstanding; this leaves room for a
+    // TAG_DROPPED record at the end when tracing is stopped
+    uint32_t limit;
+
+    uint32_t num_cpus;
+    ktrace_cpu_t cpus[SMP_MAX_CPUS];
 } ktrace_state_t;
 
+// The largest record is smaller than this.
+#define KTRACE_SLACK 256u
+
 static ktrace_state_t KTRACE_STATE;
 
+static mutex_t read_lock = MUTEX_INITIAL_VALUE(read_lock);
+
+// The tracepoints in ktrace.h skip groups that are off with static branches,
+// which are patched to match the mask here.
+static void ktrace_set_grpmask(ktrace_state_t* ks, uint32_t grpmask) {
+    atomic_store(&ks->grpmask, grpmask);
+    grpmask = KTRACE_GROUP(grpmask);
+    for (uint grp = 0; grp < 12; grp++) {
+        static_branch_set(STATIC_BRANCH_KEY_KTRACE + grp, grpmask & (1u << grp));
+    }
+}
+
+static void* ktrace_reserve(ktrace_state_t* ks, uint cpu, uint32_t len) {
+    ktrace_cpu_t* kc = &ks->cpus[cpu];
+
+    // A reader clears space before it hands it back.
+    uint64_t head = kc->head.load(fbl::memory_order_acquire);
+    uint64_t tail = kc->tail.load(fbl::memory_order_relaxed);
+    do {
+        if (tail + len - head > ks->limit) {
+            kc->dropped.fetch_add(1, fbl::memory_order_relaxed);
+            return nullptr;
+        }
+    } while (!kc->tail.compare_exchange_weak(&tail, tail + len, fbl::memory_order_relaxed,
+                                             fbl::memory_order_relaxed));
+
+    return kc->buffer + (tail % ks->cpu_bufsize);
+}
+
+// Makes a record visible to readers. Everything else in it must be written.
+static inline void ktrace_commit(void* rec, uint32_t tag) {
+    __atomic_store_n(static_cast<uint32_t*>(rec), tag, __ATOMIC_RELEASE);
+}
+
+static uint32_t ktrace_peek_tag(const ktrace_state_t* ks, const ktrace_cpu_t* kc, uint64_t pos) {
+    return __atomic_load_n(reinterpret_cast<const uint32_t*>(kc->buffer + (pos % ks->cpu_bufsize)),
+                           __ATOMIC_ACQUIRE);
+}
+
+static void ktrace_write_init_hook(ktrace_state_t* ks, uint32_t tag, uint64_t ts,
+                                   const lk_init_timing_t& t) {
+    ktrace_rec_32b_t* rec = (ktrace_rec_32b_t*) ktrace_reserve(ks, 0, KTRACE_RECSIZE);
+    if (rec) {
+        rec->tid = 0;
+        rec->ts = ts;
+        rec->a = t.index;
+        rec->b = t.init->level;
+        rec->c = t.cpu;
+        rec->d = 0;
+        ktrace_commit(rec, tag);
+    }
+}
+
+// Most of boot is over by the time ktrace is set up, so each trace gets the
+// init hooks' start and end times from the record lk_init_level() keeps.
+static void ktrace_report_init_timeline(ktrace_state_t* ks) {
+    const lk_init_timing_t* timeline;
+    size_t count = lk_init_get_timeline(&timeline);
+    for (size_t i = 0; i < count; i++) {
+        const lk_init_timing_t& t = timeline[i];
+        uint64_t end = __atomic_load_n(&t.end, __ATOMIC_ACQUIRE);
+        if (end == 0)
+            continue;
+
+        // Hooks run on every secondary cpu show up once per cpu, but only
+        // need naming once.
+        bool named = false;
+        for (size_t j = 0; j < i && !named; j++) {
+            named = (timeline[j].index == t.index);
+        }
+        if (!named)
+            ktrace_name_etc(TAG_INIT_HOOK_NAME, t.index, t.init->level, t.init->name, true);
+
+        ktrace_write_init_hook(ks, TAG_INIT_HOOK_START, t.start, t);
+        ktrace_write_init_hook(ks, TAG_INIT_HOOK_END, end, t);
+    }
+}
+
+static void ktrace_write_metadata(ktrace_state_t* ks) {
+    // These go first on cpu 0, which is read first.
+    uint64_t n = ktrace_ticks_per_ms();
+    ktrace_rec_32b_t* rec = (ktrace_rec_32b_t*) ktrace_reserve(ks, 0, KTRACE_RECSIZE);
+    if (rec) {
+        rec->a = KTRACE_VERSION;
+        ktrace_commit(rec, TAG_VERSION);
+    }
+    rec = (ktrace_rec_32b_t*) ktrace_reserve(ks, 0, KTRACE_RECSIZE);
+    if (rec) {
+        rec->a = (uint32_t)n;
+        rec->b = (uint32_t)(n >> 32);
+        ktrace_commit(rec, TAG_TICKS_PER_MS);
+    }
+    ktrace_report_syscalls(kt_syscall_info);
+    ktrace_report_probes();
+    ktrace_report_init_timeline(ks);
+}
+
+static void ktrace_fill_dropped(ktrace_rec_32b_t* rec, uint cpu, uint64_t dropped) {
+    rec->tid = 0;
+    rec->ts = ktrace_timestamp();
+    rec->a = cpu;
+    rec->b = (uint32_t)dropped;
+    rec->c = (uint32_t)(dropped >> 32);
+    rec->d = 0;
+}
+
+// Once tracing stops, notes how much each cpu dropped in the space
+// ktrace_reserve() keeps for the purpose.
+static void ktrace_write_dropped(ktrace_state_t* ks) {
+    for (uint cpu = 0; cpu < ks->num_cpus; cpu++) {
+        ktrace_cpu_t* kc = &ks->cpus[cpu];
+        uint64_t dropped = kc->dropped.load();
+        if (dropped == kc->dropped_reported)
+            continue;
+        uint64_t tail = kc->tail.fetch_add(KTRACE_RECSIZE);
+        ktrace_rec_32b_t* rec = (ktrace_rec_32b_t*) (kc->buffer + (tail % ks->cpu_bufsize));
+        ktrace_fill_dropped(rec, cpu, dropped);
+        ktrace_commit(rec, TAG_DROPPED);
+        kc->dropped_reported = dropped;
+    }
+}
+
+// Streaming reads take whatever each cpu has ready, in whole records, and
+// give the space back for more.
+static int ktrace_drain_user(ktrace_state_t* ks, uint8_t* ptr, uint32_t len) TA_REQ(read_lock) {
+    const uint32_t size = ks->cpu_bufsize;
+    uint32_t copied = 0;
+
+    for (uint cpu = 0; cpu < ks->num_cpus; cpu++) {
+        ktrace_cpu_t* kc = &ks->cpus[cpu];
+
+        uint64_t dropped = kc->dropped.load(fbl::memory_order_relaxed);
+        if (dropped != kc->dropped_reported) {
+            if (len - copied < KTRACE_RECSIZE)
+                break;
+            ktrace_rec_32b_t rec;
+            rec.tag = TAG_DROPPED;
+            ktrace_fill_dropped(&rec, cpu, dropped);
+            if (arch_copy_to_user(ptr + copied, &rec, sizeof(rec)) != ZX_OK)
+                return ZX_ERR_INVALID_ARGS;
+            copied += KTRACE_RECSIZE;
+            kc->dropped_reported = dropped;
+        }
+
+        uint64_t head = kc->head.load(fbl::memory_order_relaxed);
+        uint64_t tail = kc->tail.load(fbl::memory_order_relaxed);
+        while (head < tail) {
+            // Take the committed records that lie end to end in the buffer.
+            uint64_t end = head;
+            while (end < tail) {
+                uint32_t rlen = KTRACE_LEN(ktrace_peek_tag(ks, kc, end));
+                if (rlen == 0 || end - head + rlen > len - copied)
+                    break;
+                bool at_end = (end % size) + rlen >= size;
+                end += rlen;
+                if (at_end)
+                    break;
+            }
+            if (end == head)
+                break;
+
+            uint8_t* start = kc->buffer + (head % size);
+            uint32_t span = (uint32_t)(end - head);
+            if (arch_copy_to_user(ptr + copied, start, span) != ZX_OK)
+                return ZX_ERR_INVALID_ARGS;
+            // Writers count on free space reading as zero.
+            memset(start, 0, span);
+            copied += span;
+            head = end;
+            kc->head.store(head, fbl::memory_order_release);
+        }
+    }
+
+    return copied;
+}
+
 int ktrace_read_user(void* ptr, uint32_t off, uint32_t len) {
     ktrace_state_t* ks = &KTRACE_STATE;
 
-    // Buffer size is limited by the marker if set,
-    // otherwise limited by offset (last written point).
-    // Offset can end up pointing past the end, so clip
-    // it to the actual buffer size to be safe.
-    uint32_t max;
-    if (ks->marker) {
-        max = ks->marker;
-    } else {
-        max = ks->offset;
-        if (max > ks->bufsize) {
-            max = ks->bufsize;
+    AutoLock lock(&read_lock);
+
+    if (ks->streaming) {
+        // null read is a query for how much is waiting
+        if (ptr == nullptr) {
+            uint64_t total = 0;
+            for (uint cpu = 0; cpu < ks->num_cpus; cpu++) {
+                total += ks->cpus[cpu].tail.load() - ks->cpus[cpu].head.load();
+            }
+            return (int)MIN(total, (uint64_t)INT_MAX);
         }
+        return ktrace_drain_user(ks, static_cast<uint8_t*>(ptr), len);
+    }
+
+    // Otherwise the trace reads as each cpu's records in turn.
+    uint32_t max = 0;
+    for (uint cpu = 0; cpu < ks->num_cpus; cpu++) {
+        max += (uint32_t)MIN(ks->cpus[cpu].tail.load(), (uint64_t)ks->cpu_bufsize);
     }
 
     // null read is a query for trace buffer size
@@ -126,37 +342,67 @@ int ktrace_read_user(void* ptr, uint32_t off, uint32_t len) {
         len = max - off;
     }
 
-    if (arch_copy_to_user(ptr, ks->buffer + off, len) != ZX_OK) {
-        return ZX_ERR_INVALID_ARGS;
+    uint32_t copied = 0;
+    for (uint cpu = 0; cpu < ks->num_cpus && copied < len; cpu++) {
+        uint32_t used = (uint32_t)MIN(ks->cpus[cpu].tail.load(), (uint64_t)ks->cpu_bufsize);
+        if (off >= used) {
+            off -= used;
+            continue;
+        }
+        uint32_t n = MIN(used - off, len - copied);
+        if (arch_copy_to_user(static_cast<uint8_t*>(ptr) + copied,
+                              ks->cpus[cpu].buffer + off, n) != ZX_OK) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        copied += n;
+        off = 0;
+    }
+    return copied;
+}
+
+static void ktrace_rewind(ktrace_state_t* ks) {
+    AutoLock lock(&read_lock);
+    ks->streaming = false;
+    for (uint cpu = 0; cpu < ks->num_cpus; cpu++) {
+        ktrace_cpu_t* kc = &ks->cpus[cpu];
+        memset(kc->buffer, 0, ks->cpu_bufsize + KTRACE_SLACK);
+        kc->tail.store(0);
+        kc->head.store(0);
+        kc->dropped.store(0);
+        kc->dropped_reported = 0;
     }
-    return len;
 }
 
 zx_status_t ktrace_control(uint32_t action, uint32_t options, void* ptr) {
     ktrace_state_t* ks = &KTRACE_STATE;
     switch (action) {
+    case KTRACE_ACTION_START_STREAMING:
+        if (ks->num_cpus == 0) {
+            return ZX_ERR_BAD_STATE;
+        }
+        {
+            AutoLock lock(&read_lock);
+            ks->streaming = true;
+        }
+        // fallthrough
     case KTRACE_ACTION_START:
         options = KTRACE_GRP_TO_MASK(options);
-        ks->marker = 0;
-        atomic_store(&ks->grpmask, options ? options : KTRACE_GRP_TO_MASK(KTRACE_GRP_ALL));
+        ktrace_set_grpmask(ks, options ? options : KTRACE_GRP_TO_MASK(KTRACE_GRP_ALL));
         ktrace_report_live_processes();
         ktrace_report_live_threads();
         break;
     case KTRACE_ACTION_STOP: {
-        atomic_store(&ks->grpmask, 0);
-        uint32_t n = ks->offset;
-        if (n > ks->bufsize) {
-            ks->marker = ks->bufsize;
-        } else {
-            ks->marker = n;
+        ktrace_set_grpmask(ks, 0);
+        AutoLock lock(&read_lock);
+        if (!ks->streaming) {
+            ktrace_write_dropped(ks);
         }
         break;
     }
     case KTRACE_ACTION_REWIND:
-        // roll back to just after the metadata
-        atomic_store(&ks->offset, KTRACE_RECSIZE * 2);
-        ktrace_report_syscalls(kt_syscall_info);
-        ktrace_report_probes();
+        // start over with just the metadata
+        ktrace_rewind(ks);
+        ktrace_write_metadata(ks);
         break;
     case KTRACE_ACTION_NEW_PROBE: {
         ktrace_probe_info_t* probe;
@@ -197,43 +443,47 @@ void ktrace_init(unsigned level) {
 
     mb *= (1024*1024);
 
+    // register all static probes. their names are written out along with
+    // the rest of the metadata once the buffers are set up.
+    mutex_acquire(&probe_list_lock);
+    for (auto probe = __start_ktrace_probe;
+         probe != __stop_ktrace_probe;
+         ++probe) {
+        ktrace_add_probe(*probe);
+    }
+    mutex_release(&probe_list_lock);
+
+    uint32_t num_cpus = arch_max_num_cpus();
+    uint32_t stride = ROUNDDOWN(mb / num_cpus, 8);
+    if (stride < KTRACE_SLACK + KTRACE_RECSIZE * 64) {
+        dprintf(INFO, "ktrace: buffer too small for %u cpus\n", num_cpus);
+        return;
+    }
+
     zx_status_t status;
+    uint8_t* buffer;
     VmAspace* aspace = VmAspace::kernel_aspace();
-    if ((status = aspace->Alloc("ktrace", mb, (void**)&ks->buffer, 0, VmAspace::VMM_FLAG_COMMIT,
+    if ((status = aspace->Alloc("ktrace", mb, (void**)&buffer, 0, VmAspace::VMM_FLAG_COMMIT,
                                 ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE)) < 0) {
         dprintf(INFO, "ktrace: cannot alloc buffer %d\n", status);
         return;
     }
 
-    // The last packet written can overhang the end of the buffer,
-    // so we reduce the reported size by the max size of a record
-    ks->bufsize = mb - 256;
-
-    dprintf(INFO, "ktrace: buffer at %p (%u bytes)\n", ks->buffer, mb);
-
-    // register all static probes
-    mutex_acquire(&probe_list_lock);
-    for (auto probe = __start_ktrace_probe;
-         probe != __stop_ktrace_probe;
-         ++probe) {
-        ktrace_add_probe(*probe);
+    // The last record written can overhang the end of a cpu's buffer,
+    // so each one is followed by room for the largest record.
+    ks->cpu_bufsize = stride - KTRACE_SLACK;
+    ks->limit = ks->cpu_bufsize - KTRACE_RECSIZE;
+    for (uint cpu = 0; cpu < num_cpus; cpu++) {
+        ks->cpus[cpu].buffer = buffer + cpu * stride;
     }
-    mutex_release(&probe_list_lock);
+    ks->num_cpus = num_cpus;
 
-    // write metadata to the first two event slots
-    uint64_t n = ktrace_ticks_per_ms();
-    ktrace_rec_32b_t* rec = (ktrace_rec_32b_t*) ks->buffer;
-    rec[0].tag = TAG_VERSION;
-    rec[0].a = KTRACE_VERSION;
-    rec[1].tag = TAG_TICKS_PER_MS;
-    rec[1].a = (uint32_t)n;
-    rec[1].b = (uint32_t)(n >> 32);
+    dprintf(INFO, "ktrace: buffer at %p (%u bytes, %u per cpu)\n", buffer, mb, ks->cpu_bufsize);
 
     // enable tracing
-    atomic_store(&ks->offset, KTRACE_RECSIZE * 2);
-    ktrace_report_syscalls(kt_syscall_info);
-    ktrace_report_probes();
-    atomic_store(&ks->grpmask, KTRACE_GRP_TO_MASK(grpmask));
+    ktrace_rewind(ks);
+    ktrace_write_metadata(ks);
+    ktrace_set_grpmask(ks, KTRACE_GRP_TO_MASK(grpmask));
 
     // report names of existing threads
     ktrace_report_live_threads();
@@ -245,41 +495,39 @@ void ktrace_init(unsigned level) {
     ktrace_probe0("ktrace_ready");
 }
 
-void ktrace_tiny(uint32_t tag, uint32_t arg) {
+void ktrace_write_tiny(uint32_t tag, uint32_t arg) {
     ktrace_state_t* ks = &KTRACE_STATE;
     if (tag & atomic_load(&ks->grpmask)) {
         tag = (tag & 0xFFFFFFF0) | 2;
-        int off;
-        if ((off = atomic_add(&ks->offset, KTRACE_HDRSIZE)) >= (int)ks->bufsize) {
-            // if we arrive at the end, stop
-            atomic_store(&ks->grpmask, 0);
-        } else {
-            ktrace_header_t* hdr = (ktrace_header_t*) (ks->buffer + off);
+        ktrace_header_t* hdr =
+            (ktrace_header_t*) ktrace_reserve(ks, arch_curr_cpu_num(), KTRACE_HDRSIZE);
+        if (hdr) {
             hdr->ts = ktrace_timestamp();
-            hdr->tag = tag;
             hdr->tid = arg;
+            ktrace_commit(hdr, tag);
         }
     }
 }
 
-void* ktrace_open(uint32_t tag) {
+bool ktrace_write(uint32_t tag, const void* payload) {
     ktrace_state_t* ks = &KTRACE_STATE;
     if (!(tag & atomic_load(&ks->grpmask))) {
-        return nullptr;
+        return false;
     }
 
-    int off;
-    if ((off = atomic_add(&ks->offset, KTRACE_LEN(tag))) >= (int)ks->bufsize) {
-        // if we arrive at the end, stop
-        atomic_store(&ks->grpmask, 0);
-        return nullptr;
+    uint32_t len = KTRACE_LEN(tag);
+    ktrace_header_t* hdr = (ktrace_header_t*) ktrace_reserve(ks, arch_curr_cpu_num(), len);
+    if (!hdr) {
+        return false;
     }
 
-    ktrace_header_t* hdr = (ktrace_header_t*) (ks->buffer + off);
     hdr->ts = ktrace_timestamp();
-    hdr->tag = tag;
     hdr->tid = (uint32_t)get_current_thread()->user_tid;
-    return hdr + 1;
+    if (len > KTRACE_HDRSIZE) {
+        memcpy(hdr + 1, payload, len - KTRACE_HDRSIZE);
+    }
+    ktrace_commit(hdr, tag);
+    return true;
 }
 
 static void ktrace_name_etc(uint32_t tag, uint32_t id, uint32_t arg, const char* name, bool always) {
@@ -290,17 +538,14 @@ static void ktrace_name_etc(uint32_t tag, uint32_t id, uint32_t arg, const char*
         // set size to: sizeof(hdr) + len + 1, round up to multiple of 8
         tag = (tag & 0xFFFFFFF0) | ((KTRACE_NAMESIZE + len + 1 + 7) >> 3);
 
-        int off;
-        if ((off = atomic_add(&ks->offset, KTRACE_LEN(tag))) >= (int)ks->bufsize) {
-            // if we arrive at the end, stop
-            atomic_store(&ks->grpmask, 0);
-        } else {
-            ktrace_rec_name_t* rec = (ktrace_rec_name_t*) (ks->buffer + off);
-            rec->tag = tag;
+        ktrace_rec_name_t* rec =
+            (ktrace_rec_name_t*) ktrace_reserve(ks, arch_curr_cpu_num(), KTRACE_LEN(tag));
+        if (rec) {
             rec->id = id;
             rec->arg = arg;
             memcpy(rec->name, name, len);
             rec->name[len] = 0;
+            ktrace_commit(rec, tag);
         }
     }
 }
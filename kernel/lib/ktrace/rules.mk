@@ -11,4 +11,7 @@ MODULE := $(LOCAL_DIR)
 MODULE_SRCS += \
 	$(LOCAL_DIR)/ktrace.cpp
 
+MODULE_DEPS += \
+	kernel/lib/code_patching
+
 include make/module.mk
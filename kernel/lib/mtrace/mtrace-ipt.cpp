@@ -17,12 +17,36 @@
 #include "lib/mtrace.h"
 #include "trace.h"
 
+#include <fbl/auto_lock.h>
+#include <fbl/mutex.h>
+#include <object/process_dispatcher.h>
+#include <object/thread_dispatcher.h>
 #include <zircon/mtrace.h>
+#include <zircon/thread_annotations.h>
 
 #include "arch/x86/proc_trace.h"
 
 #define LOCAL_TRACE 0
 
+static fbl::Mutex ipt_threads_lock;
+
+// The threads assigned to thread traces, kept alive while they are traced.
+static fbl::RefPtr<ThreadDispatcher> ipt_threads[IPT_MAX_NUM_THREAD_TRACES]
+    TA_GUARDED(ipt_threads_lock);
+
+static zx_status_t mtrace_ipt_get_thread(user_inout_ptr<void> arg, uint32_t size,
+                                         fbl::RefPtr<ThreadDispatcher>* out_thread) {
+    zx_handle_t handle;
+    if (size != sizeof(handle))
+        return ZX_ERR_INVALID_ARGS;
+    zx_status_t status = arg.reinterpret<zx_handle_t>().copy_from_user(&handle);
+    if (status != ZX_OK)
+        return status;
+
+    auto up = ProcessDispatcher::GetCurrent();
+    return up->GetDispatcherWithRights(handle, ZX_RIGHT_WRITE, out_thread);
+}
+
 zx_status_t mtrace_ipt_control(uint32_t action, uint32_t options,
                                user_inout_ptr<void> arg, uint32_t size) {
     TRACEF("action %u, options 0x%x, arg %p, size 0x%x\n",
@@ -49,10 +73,17 @@ zx_status_t mtrace_ipt_control(uint32_t action, uint32_t options,
         }
     }
 
-    case MTRACE_IPT_FREE_TRACE:
+    case MTRACE_IPT_FREE_TRACE: {
         if (options != 0 || size != 0)
             return ZX_ERR_INVALID_ARGS;
-        return x86_ipt_free_trace();
+        fbl::AutoLock lock(&ipt_threads_lock);
+        zx_status_t status = x86_ipt_free_trace();
+        if (status != ZX_OK)
+            return status;
+        for (auto& thread : ipt_threads)
+            thread.reset();
+        return ZX_OK;
+    }
 
     case MTRACE_IPT_STAGE_CPU_DATA: {
         zx_x86_pt_regs_t regs;
@@ -97,6 +128,90 @@ zx_status_t mtrace_ipt_control(uint32_t action, uint32_t options,
             return ZX_ERR_INVALID_ARGS;
         return x86_ipt_cpu_mode_stop();
 
+    case MTRACE_IPT_STAGE_THREAD_DATA: {
+        zx_x86_pt_regs_t regs;
+        if (size != sizeof(regs))
+            return ZX_ERR_INVALID_ARGS;
+        zx_status_t status = arg.reinterpret<zx_x86_pt_regs_t>().copy_from_user(&regs);
+        if (status != ZX_OK)
+            return status;
+        uint32_t descriptor = MTRACE_IPT_OPTIONS_TRACE(options);
+        if ((options & ~MTRACE_IPT_OPTIONS_CPU_MASK) != 0)
+            return ZX_ERR_INVALID_ARGS;
+        TRACEF("action %u, trace %u, ctl 0x%" PRIx64 ", output_base 0x%" PRIx64 "\n",
+               action, descriptor, regs.ctl, regs.output_base);
+        return x86_ipt_stage_thread_data(descriptor, &regs);
+    }
+
+    case MTRACE_IPT_GET_THREAD_DATA: {
+        zx_x86_pt_regs_t regs;
+        if (size != sizeof(regs))
+            return ZX_ERR_INVALID_ARGS;
+        uint32_t descriptor = MTRACE_IPT_OPTIONS_TRACE(options);
+        if ((options & ~MTRACE_IPT_OPTIONS_CPU_MASK) != 0)
+            return ZX_ERR_INVALID_ARGS;
+        auto status = x86_ipt_get_thread_data(descriptor, &regs);
+        if (status != ZX_OK)
+            return status;
+        TRACEF("action %u, trace %u, ctl 0x%" PRIx64 ", output_base 0x%" PRIx64 "\n",
+               action, descriptor, regs.ctl, regs.output_base);
+        return arg.reinterpret<zx_x86_pt_regs_t>().copy_to_user(regs);
+    }
+
+    case MTRACE_IPT_ASSIGN_THREAD: {
+        uint32_t descriptor = MTRACE_IPT_OPTIONS_TRACE(options);
+        if ((options & ~MTRACE_IPT_OPTIONS_CPU_MASK) != 0 ||
+            descriptor >= IPT_MAX_NUM_THREAD_TRACES)
+            return ZX_ERR_INVALID_ARGS;
+        fbl::RefPtr<ThreadDispatcher> thread;
+        zx_status_t status = mtrace_ipt_get_thread(arg, size, &thread);
+        if (status != ZX_OK)
+            return status;
+        fbl::AutoLock lock(&ipt_threads_lock);
+        status = x86_ipt_assign_thread(descriptor, thread->thread());
+        if (status != ZX_OK)
+            return status;
+        ipt_threads[descriptor] = fbl::move(thread);
+        return ZX_OK;
+    }
+
+    case MTRACE_IPT_RELEASE_THREAD: {
+        uint32_t descriptor = MTRACE_IPT_OPTIONS_TRACE(options);
+        if ((options & ~MTRACE_IPT_OPTIONS_CPU_MASK) != 0 ||
+            descriptor >= IPT_MAX_NUM_THREAD_TRACES)
+            return ZX_ERR_INVALID_ARGS;
+        fbl::RefPtr<ThreadDispatcher> thread;
+        zx_status_t status = mtrace_ipt_get_thread(arg, size, &thread);
+        if (status != ZX_OK)
+            return status;
+        fbl::AutoLock lock(&ipt_threads_lock);
+        status = x86_ipt_release_thread(descriptor, thread->thread());
+        if (status != ZX_OK)
+            return status;
+        ipt_threads[descriptor].reset();
+        return ZX_OK;
+    }
+
+    case MTRACE_IPT_THREAD_MODE_START:
+        if (options != 0 || size != 0)
+            return ZX_ERR_INVALID_ARGS;
+        return x86_ipt_thread_mode_start();
+
+    case MTRACE_IPT_THREAD_MODE_STOP:
+        if (options != 0 || size != 0)
+            return ZX_ERR_INVALID_ARGS;
+        return x86_ipt_thread_mode_stop();
+
+    case MTRACE_IPT_PAUSE_THREAD:
+        if ((options & ~MTRACE_IPT_OPTIONS_CPU_MASK) != 0 || size != 0)
+            return ZX_ERR_INVALID_ARGS;
+        return x86_ipt_pause_thread(MTRACE_IPT_OPTIONS_TRACE(options));
+
+    case MTRACE_IPT_RESUME_THREAD:
+        if ((options & ~MTRACE_IPT_OPTIONS_CPU_MASK) != 0 || size != 0)
+            return ZX_ERR_INVALID_ARGS;
+        return x86_ipt_resume_thread(MTRACE_IPT_OPTIONS_TRACE(options));
+
     default:
         return ZX_ERR_INVALID_ARGS;
     }
@@ -12,12 +12,32 @@
 // redline.
 typedef void(oom_lowmem_callback_t)(size_t shortfall_bytes);
 
+// How much memory pressure the system is under, by how far free memory has
+// fallen towards the redline.
+enum oom_pressure_level {
+    OOM_PRESSURE_NORMAL,
+    OOM_PRESSURE_WARNING,
+    OOM_PRESSURE_CRITICAL,
+    OOM_PRESSURE_LEVELS,
+};
+
+// Called from the memory-watcher thread whenever the pressure level changes.
+// The level starts out at OOM_PRESSURE_NORMAL.
+typedef void(oom_pressure_callback_t)(oom_pressure_level level);
+
 // Initializes the out-of-memory system. If |enable| is true, starts the
 // memory-watcher thread, which calls |lowmem_callback| when the PMM has less
 // than |redline_bytes| free memory, sleeping for |sleep_duration_ns| between
 // checks.
 //
+// Before that it calls |pressure_callback| as free memory drops below
+// |warning_bytes| and |critical_bytes|, and again once it recovers, so that
+// caches can be shrunk before anything has to be killed. It checks four
+// times as often while the level is not normal.
+//
 // If |enable| is false, the thread can be started manually using 'k oom start'.
 // TODO(dbort): Add a programmatic way to start/stop the thread.
 void oom_init(bool enable, uint64_t sleep_duration_ns, size_t redline_bytes,
-              oom_lowmem_callback_t* lowmem_callback);
+              size_t critical_bytes, size_t warning_bytes,
+              oom_lowmem_callback_t* lowmem_callback,
+              oom_pressure_callback_t* pressure_callback);
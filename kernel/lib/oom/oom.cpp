@@ -28,6 +28,9 @@ static fbl::Mutex oom_mutex;
 // Function to call when we hit a low-memory condition.
 static oom_lowmem_callback_t* oom_lowmem_callback TA_GUARDED(oom_mutex);
 
+// Function to call when the memory pressure level changes.
+static oom_pressure_callback_t* oom_pressure_callback TA_GUARDED(oom_mutex);
+
 // The thread, if it's running; nullptr otherwise.
 static thread_t* oom_thread TA_GUARDED(oom_mutex);
 
@@ -40,12 +43,40 @@ static uint64_t oom_sleep_duration_ns TA_GUARDED(oom_mutex);
 // If the PMM has fewer than this many bytes free, start killing processes.
 static uint64_t oom_redline_bytes TA_GUARDED(oom_mutex);
 
+// If the PMM has fewer than this many bytes free, report each pressure level.
+static uint64_t oom_pressure_bytes[OOM_PRESSURE_LEVELS] TA_GUARDED(oom_mutex);
+
+// The pressure level last reported.
+static oom_pressure_level oom_level TA_GUARDED(oom_mutex);
+
+static const char* const oom_level_names[OOM_PRESSURE_LEVELS] = {
+    "normal",
+    "warning",
+    "critical",
+};
+
 // True if the thread should print the current free value when it runs.
 static bool oom_printing TA_GUARDED(oom_mutex);
 
 // True if the thread should simulate a low-memory condition on its next loop.
 static bool oom_simulate_lowmem TA_GUARDED(oom_mutex);
 
+// Returns the pressure level for |free_bytes|. A level is only left once free
+// memory is back above its threshold by an eighth, so that free memory hovering
+// around a threshold doesn't keep waking up everyone watching it.
+static oom_pressure_level pressure_level_locked(size_t free_bytes) TA_REQ(oom_mutex) {
+    for (int level = OOM_PRESSURE_CRITICAL; level > OOM_PRESSURE_NORMAL; level--) {
+        uint64_t threshold = oom_pressure_bytes[level];
+        if (oom_level >= level) {
+            threshold += threshold / 8;
+        }
+        if (free_bytes < threshold) {
+            return static_cast<oom_pressure_level>(level);
+        }
+    }
+    return OOM_PRESSURE_NORMAL;
+}
+
 static int oom_loop(void* arg) {
     const size_t total_bytes = pmm_count_total_bytes();
     char total_buf[MAX_FORMAT_SIZE_LEN];
@@ -59,6 +90,9 @@ static int oom_loop(void* arg) {
         bool printing = false;
         size_t shortfall_bytes = 0;
         oom_lowmem_callback_t* lowmem_callback = nullptr;
+        oom_pressure_level level = OOM_PRESSURE_NORMAL;
+        bool level_changed = false;
+        oom_pressure_callback_t* pressure_callback = nullptr;
         uint64_t sleep_duration_ns = 0;
         {
             AutoLock lock(&oom_mutex);
@@ -77,11 +111,22 @@ static int oom_loop(void* arg) {
             }
             oom_simulate_lowmem = false;
 
+            level = pressure_level_locked(free_bytes);
+            level_changed = level != oom_level;
+            oom_level = level;
+
             printing =
-                lowmem || (oom_printing && free_bytes != last_free_bytes);
+                lowmem || level_changed ||
+                (oom_printing && free_bytes != last_free_bytes);
             lowmem_callback = oom_lowmem_callback;
             DEBUG_ASSERT(lowmem_callback != nullptr);
+            pressure_callback = oom_pressure_callback;
+            DEBUG_ASSERT(pressure_callback != nullptr);
+            // Memory runs out quicker than usual once it is already low.
             sleep_duration_ns = oom_sleep_duration_ns;
+            if (level != OOM_PRESSURE_NORMAL) {
+                sleep_duration_ns /= 4;
+            }
         }
 
         if (printing) {
@@ -97,14 +142,19 @@ static int oom_loop(void* arg) {
             char delta_buf[MAX_FORMAT_SIZE_LEN];
             format_size(delta_buf, sizeof(delta_buf), free_delta_bytes);
 
-            printf("OOM: %s free (%c%s) / %s total\n",
+            printf("OOM: %s free (%c%s) / %s total, %s pressure\n",
                    free_buf,
                    delta_sign,
                    delta_buf,
-                   total_buf);
+                   total_buf,
+                   oom_level_names[level]);
         }
         last_free_bytes = free_bytes;
 
+        if (level_changed) {
+            pressure_callback(level);
+        }
+
         if (lowmem) {
             lowmem_callback(shortfall_bytes);
         }
@@ -131,16 +181,31 @@ static void start_thread_locked() TA_REQ(oom_mutex) {
 }
 
 void oom_init(bool enable, uint64_t sleep_duration_ns, size_t redline_bytes,
-              oom_lowmem_callback_t* lowmem_callback) {
+              size_t critical_bytes, size_t warning_bytes,
+              oom_lowmem_callback_t* lowmem_callback,
+              oom_pressure_callback_t* pressure_callback) {
     DEBUG_ASSERT(sleep_duration_ns > 0);
     DEBUG_ASSERT(redline_bytes > 0);
     DEBUG_ASSERT(lowmem_callback != nullptr);
+    DEBUG_ASSERT(pressure_callback != nullptr);
+
+    // Each level has to come before the next one, or it would never be seen.
+    if (critical_bytes <= redline_bytes || warning_bytes <= critical_bytes) {
+        printf("OOM: pressure levels out of order, using twice and four times the redline\n");
+        critical_bytes = redline_bytes * 2;
+        warning_bytes = redline_bytes * 4;
+    }
 
     AutoLock lock(&oom_mutex);
     DEBUG_ASSERT(oom_lowmem_callback == nullptr);
     oom_lowmem_callback = lowmem_callback;
+    oom_pressure_callback = pressure_callback;
     oom_sleep_duration_ns = sleep_duration_ns;
     oom_redline_bytes = redline_bytes;
+    oom_pressure_bytes[OOM_PRESSURE_NORMAL] = 0;
+    oom_pressure_bytes[OOM_PRESSURE_WARNING] = warning_bytes;
+    oom_pressure_bytes[OOM_PRESSURE_CRITICAL] = critical_bytes;
+    oom_level = OOM_PRESSURE_NORMAL;
     oom_printing = false;
     oom_simulate_lowmem = false;
     if (enable) {
@@ -202,6 +267,12 @@ static int cmd_oom(int argc, const cmd_args* argv, uint32_t flags) {
         char buf[MAX_FORMAT_SIZE_LEN];
         format_size_fixed(buf, sizeof(buf), oom_redline_bytes, 'M');
         printf("  redline: %s (%" PRIu64 " bytes)\n", buf, oom_redline_bytes);
+        for (int level = OOM_PRESSURE_CRITICAL; level > OOM_PRESSURE_NORMAL; level--) {
+            format_size_fixed(buf, sizeof(buf), oom_pressure_bytes[level], 'M');
+            printf("  %s: %s (%" PRIu64 " bytes)\n",
+                   oom_level_names[level], buf, oom_pressure_bytes[level]);
+        }
+        printf("  pressure: %s\n", oom_level_names[oom_level]);
     } else if (strcmp(argv[1].str, "print") == 0) {
         oom_printing = !oom_printing;
         printf("OOM print is now %s\n", oom_printing ? "on" : "off");
@@ -9,7 +9,7 @@
 #pragma once
 
 #include <err.h>
-#include <kernel/mutex.h>
+#include <kernel/spinlock.h>
 #include <list.h>
 #include <zircon/types.h>
 #include <sys/types.h>
@@ -27,15 +27,21 @@ __BEGIN_CDECLS
  * Its primary use is as a utility library for plaforms who need to manage
  * allocating blocks MSI IRQ IDs on behalf of the PCI bus driver, but could (in
  * theory) be used for other things).
+ *
+ * Free blocks are tracked with one bitmap per block size for each range, so
+ * allocating and freeing never touch the heap and may be done with a spinlock
+ * held.  Finding a free block is a find-first-set over the bitmap of the
+ * smallest size which has any free blocks.
  */
 
+#define P2RA_MAX_BUCKETS (32u)
+
 typedef struct p2ra_state {
-    mutex_t           lock;
-    struct list_node  ranges;
-    struct list_node  unused_blocks;
-    struct list_node  allocated_blocks;
-    struct list_node* free_block_buckets;
+    spin_lock_t       lock;
+    struct list_node  ranges;           /* sorted by start */
     uint              bucket_count;
+    uint              free_count[P2RA_MAX_BUCKETS];
+    uint              allocated_count;
 } p2ra_state_t;
 
 /**
@@ -94,11 +100,27 @@ zx_status_t p2ra_add_range(p2ra_state_t* state, uint range_start, uint range_len
  *    ++ out_range_start is NULL.
  * ++ ZX_ERR_NO_RESOURCES No contiguous, aligned region could be found to satisfy
  *    the allocation request.
- * ++ ZX_ERR_NO_MEMORY A region could be found, but memory required for bookkeeping
- *    could not be allocated.
  */
 zx_status_t p2ra_allocate_range(p2ra_state_t* state, uint size, uint* out_range_start);
 
+/**
+ * Allocate |count| ranges of the same size at once, as if by |count| calls to
+ * p2ra_allocate_range, but taking the allocator's lock only once.  Either all
+ * of the ranges are allocated, or none are.
+ *
+ * @param state A pointer to the state structure to allocate from.
+ * @param size The size of each range; the same constraints as for
+ * p2ra_allocate_range apply.
+ * @param count The number of ranges to allocate.
+ * @param out_range_starts An array of |count| entries which will hold the
+ * starts of the allocated ranges upon success.
+ *
+ * @return A status code indicating the success or failure of the operation.
+ * The possible values are the same as for p2ra_allocate_range.
+ */
+zx_status_t p2ra_allocate_ranges(p2ra_state_t* state, uint size, uint count,
+                                 uint* out_range_starts);
+
 /**
  * Free a range previously allocated using p2ra_allocate_range.
  *
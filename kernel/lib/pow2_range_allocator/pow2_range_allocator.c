@@ -15,114 +15,128 @@
 
 #define LOCAL_TRACE 0
 
-typedef struct p2ra_block {
-    struct list_node node;
-    uint             bucket;
-    uint             start;
-} p2ra_block_t;
-
+#define P2RA_BITMAP_BITS (64u)
+
+/* Each range tracks its free blocks with one bitmap per bucket.  Bit |i| of
+ * bucket |b|'s bitmap is set when the block [base + (i << b), base + ((i + 1)
+ * << b)) is free as a whole, where |base| is the start of the range rounded
+ * down to the largest block size.  A block is only ever marked free in one
+ * bucket at a time; when both halves of a block are free they are merged into
+ * it, as in a buddy allocator. */
 typedef struct p2ra_range {
     struct list_node node;
     uint             start, len;
+    uint             base;
+    uint             free_count[P2RA_MAX_BUCKETS];
+    uint             words[P2RA_MAX_BUCKETS];
+    uint64_t*        bitmap[P2RA_MAX_BUCKETS];
+    uint64_t         storage[];
 } p2ra_range_t;
 
-static inline p2ra_block_t* p2ra_get_unused_block(p2ra_state_t* state) {
-    DEBUG_ASSERT(state);
-
-    if (!list_is_empty(&state->unused_blocks))
-        return list_remove_head_type(&state->unused_blocks, p2ra_block_t, node);
+static inline bool p2ra_test_bit(const p2ra_range_t* range, uint bucket, uint index) {
+    return (range->bitmap[bucket][index / P2RA_BITMAP_BITS] >> (index % P2RA_BITMAP_BITS)) & 1;
+}
 
-    return (p2ra_block_t*)calloc(1, sizeof(p2ra_block_t));
+static inline void p2ra_set_free(p2ra_state_t* state, p2ra_range_t* range,
+                                 uint bucket, uint index) {
+    DEBUG_ASSERT(!p2ra_test_bit(range, bucket, index));
+    range->bitmap[bucket][index / P2RA_BITMAP_BITS] |= 1ull << (index % P2RA_BITMAP_BITS);
+    range->free_count[bucket]++;
+    state->free_count[bucket]++;
 }
 
-static inline void p2ra_free_block_list(struct list_node* block_list) {
-    p2ra_block_t* block;
-    while ((block = list_remove_head_type(block_list, p2ra_block_t, node)) != NULL)
-        free(block);
+static inline void p2ra_clear_free(p2ra_state_t* state, p2ra_range_t* range,
+                                   uint bucket, uint index) {
+    DEBUG_ASSERT(p2ra_test_bit(range, bucket, index));
+    range->bitmap[bucket][index / P2RA_BITMAP_BITS] &= ~(1ull << (index % P2RA_BITMAP_BITS));
+    range->free_count[bucket]--;
+    state->free_count[bucket]--;
 }
 
-static inline void p2ra_free_range_list(struct list_node* range_list) {
+static p2ra_range_t* p2ra_find_range(p2ra_state_t* state, uint value) {
     p2ra_range_t* range;
-    while ((range = list_remove_head_type(range_list, p2ra_range_t, node)) != NULL)
-        free(range);
+    list_for_every_entry(&state->ranges, range, p2ra_range_t, node) {
+        if ((value >= range->start) && ((value - range->start) < range->len))
+            return range;
+    }
+    return NULL;
 }
 
-static void p2ra_return_free_block(p2ra_state_t* state,
-                                   p2ra_block_t* block,
-                                   bool merge_allowed) {
-    DEBUG_ASSERT(state);
-    DEBUG_ASSERT(block);
-    DEBUG_ASSERT(block->bucket < state->bucket_count);
-    DEBUG_ASSERT(!list_in_list(&block->node));
-    DEBUG_ASSERT(!(block->start & ((1u << block->bucket) - 1)));
-
-    /* Return the block to its proper free bucket, sorted by base ID.  Start by
-     * finding the block which should come after this block in the list. */
-    struct list_node* l         = &state->free_block_buckets[block->bucket];
-    p2ra_block_t*     after     = list_peek_head_type(l, p2ra_block_t, node);
-    uint              block_len = 1u << block->bucket;
-
-    while (after) {
-        /* We do not allow ranges to overlap */
-        __UNUSED uint after_len = 1u << after->bucket;
-        DEBUG_ASSERT((block->start >= (after->start + after_len)) ||
-                     (after->start >= (block->start + block_len)));
-
-        if (after->start > block->start) {
-            list_add_before(&after->node, &block->node);
+/* Returns the block [block_start, block_start + (1 << bucket)) to its range,
+ * merging it with its buddy for as long as the buddy is free as well. */
+static void p2ra_return_free_block(p2ra_state_t* state, p2ra_range_t* range,
+                                   uint bucket, uint block_start) {
+    DEBUG_ASSERT(bucket < state->bucket_count);
+    DEBUG_ASSERT(!(block_start & ((1u << bucket) - 1)));
+
+    uint index = (block_start - range->base) >> bucket;
+
+    /* Don't merge blocks in the largest bucket. */
+    while (bucket + 1 < state->bucket_count) {
+        uint buddy = index ^ 1;
+        if ((buddy >= range->words[bucket] * P2RA_BITMAP_BITS) ||
+            !p2ra_test_bit(range, bucket, buddy))
             break;
-        }
 
-        /* Advance the iterator */
-        after = list_next_type(l, &after->node, p2ra_block_t, node);
+        p2ra_clear_free(state, range, bucket, buddy);
+        index >>= 1;
+        bucket++;
     }
 
-    /* If no block comes after this one, it goes on the end of the list */
-    if (!after)
-        list_add_tail(l, &block->node);
+    p2ra_set_free(state, range, bucket, index);
+}
 
-    /* Don't merge blocks in the largest bucket. */
-    if (block->bucket + 1 == state->bucket_count)
-        return;
-
-    /* Check to see if we should be merging this block into a larger aligned block. */
-    p2ra_block_t* first;
-    p2ra_block_t* second;
-    if (block->start & ((block_len << 1) - 1)) {
-        /* Odd alignment.  This might be the second block of a merge pair */
-        second = block;
-        first  = list_prev_type(l, &block->node, p2ra_block_t, node);
-    } else {
-        /* Even alignment.  This might be the first block of a merge pair */
-        first  = block;
-        second = list_next_type(l, &block->node, p2ra_block_t, node);
+/* Allocates a block of 1 << |bucket| IDs.  Must be called with the lock held. */
+static zx_status_t p2ra_allocate_locked(p2ra_state_t* state, uint orig_bucket,
+                                        uint* out_range_start) {
+    /* Find the smallest sized chunk which can hold the allocation */
+    uint bucket = orig_bucket;
+    while ((bucket < state->bucket_count) && !state->free_count[bucket])
+        bucket++;
+
+    if (bucket >= state->bucket_count)
+        return ZX_ERR_NO_RESOURCES;
+
+    /* Take the lowest free block of that size.  Ranges are sorted, so this is
+     * the free block of that size with the lowest start. */
+    p2ra_range_t* range;
+    list_for_every_entry(&state->ranges, range, p2ra_range_t, node) {
+        if (range->free_count[bucket])
+            break;
     }
+    DEBUG_ASSERT(range && range->free_count[bucket]);
 
-    /* Do these chunks fit together? */
-    if (first && second) {
-        uint first_len = 1u << first->bucket;
-        if ((first->start + first_len) == second->start) {
-            /* Assert that we are allowed to perform a merge.  If the caller is
-             * not expecting us to have to merge anything, then there is a fatal
-             * bookkeeping error somewhere */
-            DEBUG_ASSERT(merge_allowed);
-            DEBUG_ASSERT(first->bucket == second->bucket);
-
-            /* Remove the two blocks' bookkeeping from their bucket */
-            list_delete(&first->node);
-            list_delete(&second->node);
-
-            /* Place one half of the bookkeeping back on the unused list */
-            list_add_tail(&state->unused_blocks, &second->node);
-
-            /* Reuse the other half to track the newly merged block, and place
-             * it in the next bucket size up. */
-            first->bucket++;
-            p2ra_return_free_block(state, first, merge_allowed);
+    uint index = 0;
+    for (uint w = 0; w < range->words[bucket]; ++w) {
+        uint64_t word = range->bitmap[bucket][w];
+        if (word) {
+            index = (w * P2RA_BITMAP_BITS) + (uint)__builtin_ctzll(word);
+            break;
         }
     }
+    p2ra_clear_free(state, range, bucket, index);
+
+    /* Split it as many times as needed to match the requested size, returning
+     * the second half of each split to the free pool. */
+    while (bucket > orig_bucket) {
+        bucket--;
+        index <<= 1;
+        p2ra_set_free(state, range, bucket, index + 1);
+    }
+
+    state->allocated_count++;
+    *out_range_start = range->base + (index << bucket);
+    return ZX_OK;
 }
 
+static void p2ra_free_locked(p2ra_state_t* state, uint range_start, uint bucket) {
+    p2ra_range_t* range = p2ra_find_range(state, range_start);
+    ASSERT(range);
+    DEBUG_ASSERT(state->allocated_count);
+
+    state->allocated_count--;
+    p2ra_return_free_block(state, range, bucket, range_start);
+}
 
 zx_status_t p2ra_init(p2ra_state_t* state, uint max_alloc_size) {
     if (!state)
@@ -133,21 +147,13 @@ zx_status_t p2ra_init(p2ra_state_t* state, uint max_alloc_size) {
         return ZX_ERR_INVALID_ARGS;
     }
 
-    /* Allocate the storage for our free buckets */
+    memset(state, 0, sizeof(*state));
     state->bucket_count = log2_uint_floor(max_alloc_size) + 1;
-    state->free_block_buckets = malloc(state->bucket_count * sizeof(state->free_block_buckets[0]));
-    if (!state->free_block_buckets) {
-        TRACEF("Failed to allocate storage for %u free bucket lists!\n", state->bucket_count);
-        return ZX_ERR_NO_MEMORY;
-    }
+    DEBUG_ASSERT(state->bucket_count <= P2RA_MAX_BUCKETS);
 
     /* Initialize the rest of our bookeeping */
-    mutex_init(&state->lock);
+    spin_lock_init(&state->lock);
     list_initialize(&state->ranges);
-    list_initialize(&state->unused_blocks);
-    list_initialize(&state->allocated_blocks);
-    for (uint i = 0; i < state->bucket_count; ++i)
-        list_initialize(&state->free_block_buckets[i]);
 
     return ZX_OK;
 }
@@ -155,16 +161,12 @@ zx_status_t p2ra_init(p2ra_state_t* state, uint max_alloc_size) {
 void p2ra_free(p2ra_state_t* state) {
     DEBUG_ASSERT(state);
     DEBUG_ASSERT(state->bucket_count);
-    DEBUG_ASSERT(state->free_block_buckets);
-    DEBUG_ASSERT(list_is_empty(&state->allocated_blocks));
+    DEBUG_ASSERT(!state->allocated_count);
 
-    p2ra_free_range_list(&state->ranges);
-    p2ra_free_block_list(&state->unused_blocks);
-    p2ra_free_block_list(&state->allocated_blocks);
-    for (uint i = 0; i < state->bucket_count; ++i)
-        p2ra_free_block_list(&state->free_block_buckets[i]);
+    p2ra_range_t* range;
+    while ((range = list_remove_head_type(&state->ranges, p2ra_range_t, node)) != NULL)
+        free(range);
 
-    mutex_destroy(&state->lock);
     memset(state, 0, sizeof(*state));
 }
 
@@ -176,41 +178,64 @@ zx_status_t p2ra_add_range(p2ra_state_t* state, uint range_start, uint range_len
         ((range_start + range_len) < range_start))
         return ZX_ERR_INVALID_ARGS;
 
-    zx_status_t      ret       = ZX_OK;
-    p2ra_range_t*    new_range = NULL;
-    struct list_node new_blocks;
-    list_initialize(&new_blocks);
+    /* Size and allocate the bitmaps before taking the lock; the allocator's
+     * lock is a spinlock, and allocation and free never touch the heap. */
+    DEBUG_ASSERT(state->bucket_count);
+    uint     max_csize = 1u << (state->bucket_count - 1);
+    uint     base      = range_start & ~(max_csize - 1);
+    uint64_t span      = (uint64_t)range_start + range_len - base;
+    size_t   total     = 0;
+    uint     words[P2RA_MAX_BUCKETS];
+    for (uint b = 0; b < state->bucket_count; ++b) {
+        uint64_t blocks = (span + (1ull << b) - 1) >> b;
+        words[b] = (uint)((blocks + P2RA_BITMAP_BITS - 1) / P2RA_BITMAP_BITS);
+        total += words[b];
+    }
+
+    p2ra_range_t* new_range = calloc(1, sizeof(*new_range) + (total * sizeof(uint64_t)));
+    if (!new_range)
+        return ZX_ERR_NO_MEMORY;
+
+    new_range->start = range_start;
+    new_range->len   = range_len;
+    new_range->base  = base;
+    uint64_t* next = new_range->storage;
+    for (uint b = 0; b < state->bucket_count; ++b) {
+        new_range->words[b]  = words[b];
+        new_range->bitmap[b] = next;
+        next += words[b];
+    }
 
     /* Enter the lock and check for overlap with pre-existing ranges */
-    mutex_acquire(&state->lock);
+    spin_lock_saved_state_t irqstate;
+    spin_lock_irqsave(&state->lock, irqstate);
 
     p2ra_range_t* range;
+    p2ra_range_t* after = NULL;
     list_for_every_entry(&state->ranges, range, p2ra_range_t, node) {
         if (((range->start >= range_start)  && (range->start < (range_start  + range_len))) ||
             ((range_start  >= range->start) && (range_start  < (range->start + range->len)))) {
             TRACEF("Range [%u, %u] overlaps with existing range [%u, %u].\n",
                     range_start,  range_start  + range_len  - 1,
                     range->start, range->start + range->len - 1);
-            ret = ZX_ERR_ALREADY_EXISTS;
-            goto finished;
+            spin_unlock_irqrestore(&state->lock, irqstate);
+            free(new_range);
+            return ZX_ERR_ALREADY_EXISTS;
         }
+        if (!after && (range->start > range_start))
+            after = range;
     }
 
-    /* Allocate our range state */
-    new_range = calloc(1, sizeof(*new_range));
-    if (!new_range) {
-        ret = ZX_ERR_NO_MEMORY;
-        goto finished;
-    }
-    new_range->start = range_start;
-    new_range->len   = range_len;
+    /* Keep the ranges sorted, so that allocation prefers low IDs. */
+    if (after)
+        list_add_before(&after->node, &new_range->node);
+    else
+        list_add_tail(&state->ranges, &new_range->node);
 
-    /* Break the range we were given into power of two aligned chunks, and place
-     * them on the new blocks list to be added to the free-blocks buckets */
-    DEBUG_ASSERT(state->bucket_count && state->free_block_buckets);
-    uint bucket     = state->bucket_count - 1;
-    uint csize      = (1u << bucket);
-    uint max_csize  = csize;
+    /* Break the range we were given into power of two aligned chunks, and mark
+     * them free in the appropriate buckets. */
+    uint bucket = state->bucket_count - 1;
+    uint csize  = max_csize;
     while (range_len) {
         /* Shrink the chunk size until it is aligned with the start of the
          * range, and not larger than the number of irqs we have left. */
@@ -242,123 +267,77 @@ zx_status_t p2ra_add_range(p2ra_state_t* state, uint range_start, uint range_len
         DEBUG_ASSERT(csize <= range_len);
         DEBUG_ASSERT(csize);
 
-        p2ra_block_t* block = p2ra_get_unused_block(state);
-        if (!block) {
-            TRACEF("WARNING! Failed to allocate block bookkeeping with sub-range "
-                   "[%u, %u] still left to track.\n",
-                   range_start, range_start + range_len - 1);
-            ret = ZX_ERR_NO_MEMORY;
-            goto finished;
-        }
-
-        block->bucket = bucket;
-        block->start  = range_start;
-        list_add_tail(&new_blocks, &block->node);
+        p2ra_set_free(state, new_range, bucket, (range_start - base) >> bucket);
 
         range_start += csize;
         range_len   -= csize;
     }
 
-    /* Looks like we managed to allocate everything we needed to.  Go ahead and
-     * add all of our newly allocated bookkeeping to the state. */
-    list_add_tail(&state->ranges, &new_range->node);
-
-    p2ra_block_t* block;
-    while ((block = list_remove_head_type(&new_blocks, p2ra_block_t, node)) != NULL)
-        p2ra_return_free_block(state, block, false);
-
-
-finished:
-    mutex_release(&state->lock);
-
-    if (ret != ZX_OK) {
-        if (new_range) {
-            DEBUG_ASSERT(!list_in_list(&new_range->node));
-            free(new_range);
-        }
-
-        p2ra_free_block_list(&new_blocks);
-    }
-
-    return ret;
+    spin_unlock_irqrestore(&state->lock, irqstate);
+    return ZX_OK;
 }
 
-zx_status_t p2ra_allocate_range(p2ra_state_t* state, uint size, uint* out_range_start) {
-    if (!state || !out_range_start)
-        return ZX_ERR_INVALID_ARGS;
-
+static zx_status_t p2ra_size_to_bucket(p2ra_state_t* state, uint size, uint* out_bucket) {
     if (!size || !ispow2(size)) {
         TRACEF("Size (%u) is not an integer power of 2.\n", size);
         return ZX_ERR_INVALID_ARGS;
     }
 
-    uint orig_bucket = log2_uint_floor(size);
-    uint bucket      = orig_bucket;
+    uint bucket = log2_uint_floor(size);
     if (bucket >= state->bucket_count) {
         TRACEF("Invalid size (%u).  Valid sizes are integer powers of 2 from [1, %u]\n",
                 size, 1u << (state->bucket_count - 1));
         return ZX_ERR_INVALID_ARGS;
     }
 
-    /* Lock state during allocation */
-    p2ra_block_t* block = NULL;
-    zx_status_t   ret   = ZX_OK;
-    mutex_acquire(&state->lock);
+    *out_bucket = bucket;
+    return ZX_OK;
+}
 
-    /* Find the smallest sized chunk which can hold the allocation and is
-     * compatible with the requested addressing capabilities */
-    while (bucket < state->bucket_count) {
-        block = list_remove_head_type(&state->free_block_buckets[bucket], p2ra_block_t, node);
-        if (block)
-            break;
-        bucket++;
-    }
+zx_status_t p2ra_allocate_range(p2ra_state_t* state, uint size, uint* out_range_start) {
+    if (!state || !out_range_start)
+        return ZX_ERR_INVALID_ARGS;
 
-    /* Nothing found, unlock and get out */
-    if (!block) {
-        ret = ZX_ERR_NO_RESOURCES;
-        goto finished;
-    }
+    uint bucket;
+    zx_status_t ret = p2ra_size_to_bucket(state, size, &bucket);
+    if (ret != ZX_OK)
+        return ret;
 
-    /* Looks like we have a chunk which can satisfy this allocation request.
-     * Split it as many times as needed to match the requested size. */
-    DEBUG_ASSERT(block->bucket == bucket);
-    DEBUG_ASSERT(bucket >= orig_bucket);
+    spin_lock_saved_state_t irqstate;
+    spin_lock_irqsave(&state->lock, irqstate);
+    ret = p2ra_allocate_locked(state, bucket, out_range_start);
+    spin_unlock_irqrestore(&state->lock, irqstate);
 
-    while (bucket > orig_bucket) {
-        p2ra_block_t* split_block = p2ra_get_unused_block(state);
-
-        /* If we failed to allocate bookkeeping for the split block, put the block
-         * we failed to split back into the free list (merging if required),
-         * then fail the allocation */
-        if (!split_block) {
-            TRACEF("Failed to allocated free bookkeeping block when attempting to "
-                   "split for allocation\n");
-            p2ra_return_free_block(state, block, true);
-            ret = ZX_ERR_NO_MEMORY;
-            goto finished;
-        }
+    return ret;
+}
 
-        DEBUG_ASSERT(bucket);
-        bucket--;
+zx_status_t p2ra_allocate_ranges(p2ra_state_t* state, uint size, uint count,
+                                 uint* out_range_starts) {
+    if (!state || !out_range_starts)
+        return ZX_ERR_INVALID_ARGS;
 
-        /* Cut the first chunk in half */
-        block->bucket = bucket;
+    uint bucket;
+    zx_status_t ret = p2ra_size_to_bucket(state, size, &bucket);
+    if (ret != ZX_OK)
+        return ret;
 
-        /* Fill out the bookkeeping for the second half of the chunk */
-        split_block->start  = block->start + (1u << block->bucket);
-        split_block->bucket = bucket;
+    spin_lock_saved_state_t irqstate;
+    spin_lock_irqsave(&state->lock, irqstate);
 
-        /* Return the second half of the chunk to the free pool */
-        p2ra_return_free_block(state, split_block, false);
+    uint done;
+    for (done = 0; done < count; ++done) {
+        ret = p2ra_allocate_locked(state, bucket, &out_range_starts[done]);
+        if (ret != ZX_OK)
+            break;
     }
 
-    /* Success! Mark the block as allocated and return the block to the user */
-    list_add_head(&state->allocated_blocks, &block->node);
-    *out_range_start = block->start;
+    /* All or nothing; give back what we got if we could not get everything. */
+    if (ret != ZX_OK) {
+        while (done)
+            p2ra_free_locked(state, out_range_starts[--done], bucket);
+    }
 
-finished:
-    mutex_release(&state->lock);
+    spin_unlock_irqrestore(&state->lock, irqstate);
     return ret;
 }
 
@@ -367,34 +346,10 @@ void p2ra_free_range(p2ra_state_t* state, uint range_start, uint size) {
     DEBUG_ASSERT(size && ispow2(size));
 
     uint bucket = log2_uint_floor(size);
+    DEBUG_ASSERT(bucket < state->bucket_count);
 
-    mutex_acquire(&state->lock);
-
-    /* In a debug build, find the specific block being returned in the list of
-     * allocated blocks and use it as the bookkeeping for returning to the free
-     * bucket.  Because this is an O(n) operation, and serves only as a sanity
-     * check, we only do this in debug builds.  In release builds, we just grab
-     * any piece of bookkeeping memory off the allocated_blocks list and use
-     * that instead. */
-    p2ra_block_t* block;
-#if DEBUG_ASSERT_IMPLEMENTED
-    block = list_peek_head_type(&state->allocated_blocks, p2ra_block_t, node);
-    while (block) {
-        if ((block->start == range_start) && (block->bucket == bucket)) {
-            list_delete(&block->node);
-            break;
-        }
-        block = list_next_type(&state->allocated_blocks, &block->node, p2ra_block_t, node);
-    }
-    ASSERT(block);
-#else
-    block         = list_remove_head_type(&state->allocated_blocks, p2ra_block_t, node);
-    ASSERT(block);
-    block->start  = range_start;
-    block->bucket = bucket;
-#endif
-
-    /* Return the block to the free buckets (merging as needed) and we are done */
-    p2ra_return_free_block(state, block, true);
-    mutex_release(&state->lock);
+    spin_lock_saved_state_t irqstate;
+    spin_lock_irqsave(&state->lock, irqstate);
+    p2ra_free_locked(state, range_start, bucket);
+    spin_unlock_irqrestore(&state->lock, irqstate);
 }
@@ -11,7 +11,7 @@
 // environments.  It must use only the basic types so that struct
 // layouts match exactly in both contexts.
 
-#define VDSO_CONSTANTS_SIZE (4 * 4 + 2 * 8)
+#define VDSO_CONSTANTS_SIZE (4 * 4 + 2 * 8 + 4 * 4)
 #define VDSO_CONSTANTS_ALIGN 8
 
 #ifndef __ASSEMBLER__
@@ -39,6 +39,17 @@ struct vdso_constants {
 
     // Total amount of physical memory in the system, in bytes.
     uint64_t physmem;
+
+    // Nonzero if ZX_CLOCK_MONOTONIC is the zx_ticks_get value scaled by
+    // ns_per_tick, so the vDSO can compute it without entering the kernel.
+    uint32_t monotonic_from_ticks;
+
+    // Nanoseconds per tick, as the l0, l32 and l64 words of a struct
+    // fp_32_64 (see <lib/fixed_point.h>) so the result matches the
+    // kernel's to the nanosecond.
+    uint32_t ns_per_tick_l0;
+    uint32_t ns_per_tick_l32;
+    uint32_t ns_per_tick_l64;
 };
 
 static_assert(VDSO_CONSTANTS_SIZE == sizeof(vdso_constants),
@@ -10,6 +10,7 @@
 #include <fbl/alloc_checker.h>
 #include <fbl/type_support.h>
 #include <kernel/cmdline.h>
+#include <lib/fixed_point.h>
 #include <object/handle.h>
 #include <platform.h>
 #include <vm/pmm.h>
@@ -221,6 +222,8 @@ const VDso* VDso::Create() {
     KernelVmoWindow<vdso_constants> constants_window(
         "vDSO constants", vdso->vmo()->vmo(), VDSO_DATA_CONSTANTS);
     uint64_t per_second = ticks_per_second();
+    struct fp_32_64 ns_per_tick = {};
+    bool monotonic_from_ticks = platform_current_time_from_ticks(&ns_per_tick);
 
     // Initialize the constants that should be visible to the vDSO.
     // Rather than assigning each member individually, do this with
@@ -232,6 +235,10 @@ const VDso* VDso::Create() {
         arch_icache_line_size(),
         per_second,
         pmm_count_total_bytes(),
+        monotonic_from_ticks,
+        ns_per_tick.l0,
+        ns_per_tick.l32,
+        ns_per_tick.l64,
     };
 
     // If ticks_per_second has not been calibrated, it will return 0. In this
@@ -240,6 +247,9 @@ const VDso* VDso::Create() {
         // Make zx_ticks_per_second return nanoseconds per second.
         constants_window.data()->ticks_per_second = ZX_SEC(1);
 
+        // Soft ticks come from zx_time_get, so it can't come from them.
+        constants_window.data()->monotonic_from_ticks = 0;
+
         // Adjust the zx_ticks_get entry point to be soft_ticks_get.
         VDsoDynSymWindow dynsym_window(vdso->vmo()->vmo());
         REDIRECT_SYSCALL(dynsym_window, zx_ticks_get, soft_ticks_get);
@@ -13,6 +13,7 @@
 #include <trace.h>
 
 #include <kernel/event.h>
+#include <kernel/sched.h>
 #include <platform.h>
 #include <object/handle.h>
 #include <object/message_packet.h>
@@ -163,6 +164,39 @@ zx_status_t ChannelDispatcher::Read(uint32_t* msg_size,
     return rv;
 }
 
+zx_status_t ChannelDispatcher::ReadMany(size_t count,
+                                        const uint32_t* max_sizes,
+                                        const uint32_t* max_handle_counts,
+                                        MessageList* msgs,
+                                        uint32_t* next_size,
+                                        uint32_t* next_handle_count) {
+    canary_.Assert();
+
+    AutoLock lock(&lock_);
+
+    if (messages_.is_empty())
+        return other_ ? ZX_ERR_SHOULD_WAIT : ZX_ERR_PEER_CLOSED;
+
+    for (size_t ix = 0; ix != count && !messages_.is_empty(); ++ix) {
+        const MessagePacket& next = messages_.front();
+        if (next.data_size() > max_sizes[ix] || next.num_handles() > max_handle_counts[ix]) {
+            if (ix == 0) {
+                *next_size = next.data_size();
+                *next_handle_count = next.num_handles();
+                return ZX_ERR_BUFFER_TOO_SMALL;
+            }
+            break;
+        }
+        msgs->push_back(messages_.pop_front());
+        message_count_--;
+    }
+
+    if (messages_.is_empty())
+        UpdateState(ZX_CHANNEL_READABLE, 0u);
+
+    return ZX_OK;
+}
+
 zx_status_t ChannelDispatcher::Write(fbl::unique_ptr<MessagePacket> msg) {
     canary_.Assert();
 
@@ -184,6 +218,23 @@ zx_status_t ChannelDispatcher::Write(fbl::unique_ptr<MessagePacket> msg) {
     return ZX_OK;
 }
 
+zx_status_t ChannelDispatcher::WriteMany(MessageList* msgs) {
+    canary_.Assert();
+
+    fbl::RefPtr<ChannelDispatcher> other;
+    {
+        AutoLock lock(&lock_);
+        if (!other_)
+            return ZX_ERR_PEER_CLOSED;
+        other = other_;
+    }
+
+    if (other->WriteSelfMany(msgs) > 0)
+        thread_reschedule();
+
+    return ZX_OK;
+}
+
 zx_status_t ChannelDispatcher::Call(fbl::unique_ptr<MessagePacket> msg,
                                     zx_time_t deadline, bool* return_handles,
                                     fbl::unique_ptr<MessagePacket>* reply) {
@@ -216,8 +267,12 @@ zx_status_t ChannelDispatcher::Call(fbl::unique_ptr<MessagePacket> msg,
         waiters_.push_back(waiter);
     }
 
-    // (1) Write outbound message to opposing endpoint.
+    // (1) Write outbound message to opposing endpoint. We block for the
+    // reply right after, so a server thread woken by the message can have
+    // this cpu directly instead of going through an idle one.
+    sched_handoff_arm();
     other->WriteSelf(fbl::move(msg));
+    sched_handoff_disarm();
 
     // Reuse the code from the half-call used for retrying a Call after thread
     // suspend.
@@ -259,24 +314,35 @@ zx_status_t ChannelDispatcher::ResumeInterruptedCall(MessageWaiter* waiter,
     return status;
 }
 
+ChannelDispatcher::MessageWaiter* ChannelDispatcher::TakeWaiterLocked(zx_txid_t txid) {
+    // If the far side is waiting for replies to messages
+    // send via "call", see if this message has a matching
+    // txid to one of the waiters, and if so, remove it from
+    // the list so the message can be delivered to it.
+    for (auto& waiter: waiters_) {
+        if (waiter.get_txid() == txid) {
+            waiters_.erase(waiter);
+            return &waiter;
+        }
+    }
+    return nullptr;
+}
+
 int ChannelDispatcher::WriteSelf(fbl::unique_ptr<MessagePacket> msg) {
     canary_.Assert();
 
     AutoLock lock(&lock_);
 
     if (!waiters_.is_empty()) {
-        // If the far side is waiting for replies to messages
-        // send via "call", see if this message has a matching
-        // txid to one of the waiters, and if so, deliver it.
-        zx_txid_t txid = msg->get_txid();
-        for (auto& waiter: waiters_) {
-            // (3C) Deliver message to waiter.
-            // Remove waiter from list.
-            if (waiter.get_txid() == txid) {
-                waiters_.erase(waiter);
-                // we return how many threads have been woken up, or zero.
-                return waiter.Deliver(fbl::move(msg));
-            }
+        // (3C) Deliver message to waiter.
+        if (auto waiter = TakeWaiterLocked(msg->get_txid())) {
+            // A reply usually comes from a server about to wait for its next
+            // request, so hand the caller this cpu too.
+            sched_handoff_arm();
+            // we return how many threads have been woken up, or zero.
+            int woken = waiter->Deliver(fbl::move(msg));
+            sched_handoff_disarm();
+            return woken;
         }
     }
     messages_.push_back(fbl::move(msg));
@@ -286,6 +352,34 @@ int ChannelDispatcher::WriteSelf(fbl::unique_ptr<MessagePacket> msg) {
     return 0;
 }
 
+int ChannelDispatcher::WriteSelfMany(MessageList* msgs) {
+    canary_.Assert();
+
+    AutoLock lock(&lock_);
+
+    int woken = 0;
+    bool queued = false;
+    while (!msgs->is_empty()) {
+        auto msg = msgs->pop_front();
+        if (!waiters_.is_empty()) {
+            // (3C) Deliver message to waiter.
+            if (auto waiter = TakeWaiterLocked(msg->get_txid())) {
+                sched_handoff_arm();
+                woken += waiter->Deliver(fbl::move(msg));
+                sched_handoff_disarm();
+                continue;
+            }
+        }
+        messages_.push_back(fbl::move(msg));
+        message_count_++;
+        queued = true;
+    }
+
+    if (queued)
+        UpdateState(0u, ZX_CHANNEL_READABLE);
+    return woken;
+}
+
 zx_status_t ChannelDispatcher::user_signal(uint32_t clear_mask, uint32_t set_mask, bool peer) {
     canary_.Assert();
 
@@ -91,7 +91,8 @@ private:
 Dispatcher::Dispatcher(zx_signals_t signals)
     : koid_(GenerateKernelObjectId()),
       handle_count_(0u),
-      signals_(signals) {
+      signals_(signals),
+      has_observers_(false) {
 
     kcounter_add(dispatcher_create_count, 1u);
 }
@@ -149,7 +150,8 @@ namespace {
 
 template <typename Func>
 StateObserver::Flags CancelWithFunc(Dispatcher::ObserverList* observers,
-                                    fbl::Mutex* observer_lock, Func f) {
+                                    fbl::Mutex* observer_lock,
+                                    fbl::atomic<bool>* has_observers, Func f) {
     StateObserver::Flags flags = 0;
 
     Dispatcher::ObserverList obs_to_remove;
@@ -167,6 +169,7 @@ StateObserver::Flags CancelWithFunc(Dispatcher::ObserverList* observers,
                 ++it;
             }
         }
+        has_observers->store(!observers->is_empty());
     }
 
     while (!obs_to_remove.is_empty()) {
@@ -194,9 +197,15 @@ void Dispatcher::AddObserverHelper(StateObserver* observer,
     {
         AutoLock lock(mutex);
 
-        flags = observer->OnInitialize(signals_, cinfo);
+        // Publish the observer before reading the signals. UpdateState
+        // changes the signals before it looks for observers, so either it
+        // notifies this observer or the observer sees its change here.
+        has_observers_.store(true);
+        flags = observer->OnInitialize(signals_.load(), cinfo);
         if (!(flags & StateObserver::kNeedRemoval))
             observers_.push_front(observer);
+        else
+            UpdateHasObserversLocked();
     }
     if (flags & StateObserver::kNeedRemoval)
         observer->OnRemoved();
@@ -221,12 +230,14 @@ void Dispatcher::RemoveObserver(StateObserver* observer) {
     AutoLock lock(&lock_);
     DEBUG_ASSERT(observer != nullptr);
     observers_.erase(*observer);
+    UpdateHasObserversLocked();
 }
 
 bool Dispatcher::Cancel(Handle* handle) {
     ZX_DEBUG_ASSERT(has_state_tracker());
 
-    StateObserver::Flags flags = CancelWithFunc(&observers_, &lock_, [handle](StateObserver* obs) {
+    StateObserver::Flags flags = CancelWithFunc(&observers_, &lock_, &has_observers_,
+                                                [handle](StateObserver* obs) {
         return obs->OnCancel(handle);
     });
 
@@ -241,7 +252,8 @@ bool Dispatcher::Cancel(Handle* handle) {
 bool Dispatcher::CancelByKey(Handle* handle, const void* port, uint64_t key) {
     ZX_DEBUG_ASSERT(has_state_tracker());
 
-    StateObserver::Flags flags = CancelWithFunc(&observers_, &lock_, [handle, port, key](StateObserver* obs) {
+    StateObserver::Flags flags = CancelWithFunc(&observers_, &lock_, &has_observers_,
+                                                [handle, port, key](StateObserver* obs) {
         return obs->OnCancelByKey(handle, port, key);
     });
 
@@ -255,25 +267,59 @@ bool Dispatcher::CancelByKey(Handle* handle, const void* port, uint64_t key) {
 
 // Since this conditionally takes the dispatcher's |lock_|, based on
 // the type of Mutex (either fbl::Mutex or fbl::NullLock), the thread
-// safety analysis is unable to prove that the accesses to |signals_|
+// safety analysis is unable to prove that the accesses to |observers_|
 // are always protected.
+//
+// While nothing observes the object the signals are changed without the
+// lock, and an update which leaves the signals as they were never takes
+// it. Otherwise they are changed under the lock, so that observers are
+// given the state each update produced, in order: a set followed by a
+// clear reaches them as two updates, not as no change at all.
 template <typename Mutex>
 void Dispatcher::UpdateStateHelper(zx_signals_t clear_mask,
                                    zx_signals_t set_mask,
                                    Mutex* mutex) TA_NO_THREAD_SAFETY_ANALYSIS {
+    // Applies the masks, returning false if they changed nothing.
+    auto exchange = [this, clear_mask, set_mask](zx_signals_t* signals) {
+        zx_signals_t previous_signals = signals_.load();
+        do {
+            *signals = (previous_signals & ~clear_mask) | set_mask;
+            if (*signals == previous_signals)
+                return false;
+        } while (!signals_.compare_exchange_strong(&previous_signals, *signals,
+                                                   fbl::memory_order_seq_cst,
+                                                   fbl::memory_order_seq_cst));
+        return true;
+    };
+
+    zx_signals_t signals = signals_.load();
+    if (((signals & ~clear_mask) | set_mask) == signals)
+        return;
+
+    bool exchanged = false;
+    if (!has_observers_.load()) {
+        if (!exchange(&signals))
+            return;
+        // See AddObserverHelper() for why this can't miss an observer.
+        if (!has_observers_.load())
+            return;
+        exchanged = true;
+    }
+
     StateObserver::Flags flags;
     Dispatcher::ObserverList obs_to_remove;
 
     {
         AutoLock lock(mutex);
-        auto previous_signals = signals_;
-        signals_ &= ~clear_mask;
-        signals_ |= set_mask;
-
-        if (previous_signals == signals_)
+        if (exchanged) {
+            // We raced with the first observer being added, which may or
+            // may not have seen our change; either way the latest state is
+            // the one to pass on.
+            signals = signals_.load();
+        } else if (!exchange(&signals)) {
             return;
-
-        flags = UpdateInternalLocked(&obs_to_remove, signals_);
+        }
+        flags = UpdateInternalLocked(&obs_to_remove, signals);
     }
 
     while (!obs_to_remove.is_empty()) {
@@ -370,6 +416,13 @@ StateObserver::Flags Dispatcher::UpdateInternalLocked(ObserverList* obs_to_remov
         }
     }
 
+    if (!obs_to_remove->is_empty())
+        UpdateHasObserversLocked();
+
     // Filter out NeedRemoval flag because we processed that here
     return flags & (~StateObserver::kNeedRemoval);
 }
+
+void Dispatcher::UpdateHasObserversLocked() {
+    has_observers_.store(!observers_.is_empty());
+}
@@ -12,9 +12,21 @@
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_lock.h>
 #include <object/handle.h>
+#include <vm/physmap.h>
+#include <vm/pmm.h>
+#include <vm/vm_object_paged.h>
 
 using fbl::AutoLock;
 
+namespace {
+
+zx_status_t get_paddr(void* context, size_t offset, size_t index, paddr_t pa) {
+    static_cast<paddr_t*>(context)[index] = pa;
+    return ZX_OK;
+}
+
+} // namespace
+
 // static
 zx_status_t FifoDispatcher::Create(uint32_t count, uint32_t elemsize, uint32_t options,
                                    fbl::RefPtr<Dispatcher>* dispatcher0,
@@ -29,22 +41,68 @@ zx_status_t FifoDispatcher::Create(uint32_t count, uint32_t elemsize, uint32_t o
         return ZX_ERR_OUT_OF_RANGE;
     }
 
+    if (options & ~ZX_FIFO_MAPPABLE)
+        return ZX_ERR_INVALID_ARGS;
+
     fbl::AllocChecker ac;
-    auto data0 = fbl::unique_ptr<uint8_t[]>(new (&ac) uint8_t[count * elemsize]);
-    if (!ac.check())
-        return ZX_ERR_NO_MEMORY;
+    fbl::unique_ptr<uint8_t[]> data0;
+    fbl::unique_ptr<uint8_t[]> data1;
+    fbl::RefPtr<VmObject> vmo;
+    zx_fifo_ring_t* ring0 = nullptr;
+    zx_fifo_ring_t* ring1 = nullptr;
+    uint8_t* slots0 = nullptr;
+    uint8_t* slots1 = nullptr;
+
+    if (options & ZX_FIFO_MAPPABLE) {
+        // Both rings live in one committed vmo: a page of headers followed
+        // by a page of slots per direction. Each endpoint keeps it pinned so
+        // the kernel can use the physmap and the pages cannot go away.
+        zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, ZX_FIFO_RING_VMO_SIZE, &vmo);
+        if (status != ZX_OK)
+            return status;
+        status = vmo->CommitRange(0, ZX_FIFO_RING_VMO_SIZE, nullptr);
+        if (status != ZX_OK)
+            return status;
+
+        paddr_t pa[ZX_FIFO_RING_VMO_SIZE / PAGE_SIZE];
+        status = vmo->Lookup(0, ZX_FIFO_RING_VMO_SIZE, 0, get_paddr, pa);
+        if (status != ZX_OK)
+            return status;
+
+        // endpoint 0 writes ring 0 and reads ring 1, endpoint 1 the reverse
+        auto headers = reinterpret_cast<zx_fifo_ring_t*>(paddr_to_physmap(pa[0]));
+        ring0 = &headers[1];
+        ring1 = &headers[0];
+        slots0 = reinterpret_cast<uint8_t*>(paddr_to_physmap(pa[ZX_FIFO_RING_DATA_OFFSET(1) / PAGE_SIZE]));
+        slots1 = reinterpret_cast<uint8_t*>(paddr_to_physmap(pa[ZX_FIFO_RING_DATA_OFFSET(0) / PAGE_SIZE]));
+    } else {
+        data0.reset(new (&ac) uint8_t[count * elemsize]);
+        if (!ac.check())
+            return ZX_ERR_NO_MEMORY;
+        data1.reset(new (&ac) uint8_t[count * elemsize]);
+        if (!ac.check())
+            return ZX_ERR_NO_MEMORY;
+    }
 
-    auto fifo0 = fbl::AdoptRef(new (&ac) FifoDispatcher(options, count, elemsize, fbl::move(data0)));
-    if (!ac.check())
+    if (vmo && vmo->Pin(0, ZX_FIFO_RING_VMO_SIZE) != ZX_OK)
         return ZX_ERR_NO_MEMORY;
-
-    auto data1 = fbl::unique_ptr<uint8_t[]>(new (&ac) uint8_t[count * elemsize]);
-    if (!ac.check())
+    auto fifo0 = fbl::AdoptRef(new (&ac) FifoDispatcher(options, count, elemsize, fbl::move(data0),
+                                                        vmo, 1u, ring0, slots0));
+    if (!ac.check()) {
+        if (vmo)
+            vmo->Unpin(0, ZX_FIFO_RING_VMO_SIZE);
         return ZX_ERR_NO_MEMORY;
+    }
 
-    auto fifo1 = fbl::AdoptRef(new (&ac) FifoDispatcher(options, count, elemsize, fbl::move(data1)));
-    if (!ac.check())
+    if (vmo && vmo->Pin(0, ZX_FIFO_RING_VMO_SIZE) != ZX_OK)
+        return ZX_ERR_NO_MEMORY;
+    auto fifo1 = fbl::AdoptRef(new (&ac) FifoDispatcher(options, count, elemsize, fbl::move(data1),
+                                                        vmo, 0u, ring1, slots1));
+    if (!ac.check()) {
+        if (vmo)
+            vmo->Unpin(0, ZX_FIFO_RING_VMO_SIZE);
         return ZX_ERR_NO_MEMORY;
+    }
 
     fifo0->Init(fifo1);
     fifo1->Init(fifo0);
@@ -56,13 +114,18 @@ zx_status_t FifoDispatcher::Create(uint32_t count, uint32_t elemsize, uint32_t o
 }
 
 FifoDispatcher::FifoDispatcher(uint32_t /*options*/, uint32_t count, uint32_t elem_size,
-                               fbl::unique_ptr<uint8_t[]> data)
+                               fbl::unique_ptr<uint8_t[]> buffer, fbl::RefPtr<VmObject> vmo,
+                               uint32_t ring_rx, zx_fifo_ring_t* ring, uint8_t* data)
     : Dispatcher(ZX_FIFO_WRITABLE),
       elem_count_(count), elem_size_(elem_size), mask_(count - 1),
-      peer_koid_(0u), head_(0u), tail_(0u), data_(fbl::move(data)) {
+      peer_koid_(0u), vmo_(fbl::move(vmo)), ring_rx_(ring_rx),
+      local_ring_{}, ring_(ring ? ring : &local_ring_),
+      buffer_(fbl::move(buffer)), data_(data ? data : buffer_.get()) {
 }
 
 FifoDispatcher::~FifoDispatcher() {
+    if (vmo_)
+        vmo_->Unpin(0, ZX_FIFO_RING_VMO_SIZE);
 }
 
 // Thread safety analysis disabled as this happens during creation only,
@@ -143,13 +206,23 @@ zx_status_t FifoDispatcher::WriteSelf(user_in_ptr<const uint8_t> ptr, size_t byt
 
     AutoLock lock(&lock_);
 
-    uint32_t old_head = head_;
+    // only we produce into this ring from the kernel, but userspace may too
+    uint32_t head = __atomic_load_n(&ring_->head, __ATOMIC_RELAXED);
+    uint32_t old_head = head;
 
     // total number of available empty slots in the fifo
-    size_t avail = elem_count_ - (head_ - tail_);
-
-    if (avail == 0)
-        return ZX_ERR_SHOULD_WAIT;
+    size_t avail = elem_count_ - used();
+
+    if (avail == 0) {
+        set_waiting(ZX_FIFO_RING_WRITER_WAITING);
+        avail = elem_count_ - used();
+        if (avail == 0) {
+            // a mapped peer may have filled the ring without telling us
+            if (other_)
+                other_->UpdateState(ZX_FIFO_WRITABLE, 0u);
+            return ZX_ERR_SHOULD_WAIT;
+        }
+    }
 
     bool was_empty = (avail == elem_count_);
 
@@ -157,7 +230,7 @@ zx_status_t FifoDispatcher::WriteSelf(user_in_ptr<const uint8_t> ptr, size_t byt
         count = avail;
 
     while (count > 0) {
-        uint32_t offset = (head_ & mask_);
+        uint32_t offset = (head & mask_);
 
         // number of slots from target to end, inclusive
         uint32_t n = elem_count_ - offset;
@@ -168,27 +241,32 @@ zx_status_t FifoDispatcher::WriteSelf(user_in_ptr<const uint8_t> ptr, size_t byt
         zx_status_t status = ptr.copy_array_from_user(&data_[offset * elem_size_],
                                                       to_copy * elem_size_);
         if (status != ZX_OK) {
-            // roll back, in case this is the second copy
-            head_ = old_head;
+            // nothing has been published yet, the head is only stored below
             return ZX_ERR_INVALID_ARGS;
         }
 
         // adjust head and count
         // due to size limitations on fifo, to_copy will always fit in a u32
-        head_ += static_cast<uint32_t>(to_copy);
+        head += static_cast<uint32_t>(to_copy);
         count -= to_copy;
         ptr = ptr.byte_offset(to_copy * elem_size_);
     }
 
+    __atomic_store_n(&ring_->head, head, __ATOMIC_SEQ_CST);
+    clear_waiting(ZX_FIFO_RING_READER_WAITING);
+
     // if was empty, we've become readable
-    if (was_empty)
+    if (was_empty || vmo_)
         UpdateState(0u, ZX_FIFO_READABLE);
 
     // if now full, we're no longer writable
-    if (elem_count_ == (head_ - tail_))
-        other_->UpdateState(ZX_FIFO_WRITABLE, 0u);
+    if (elem_count_ == used()) {
+        set_waiting(ZX_FIFO_RING_WRITER_WAITING);
+        if (elem_count_ == used() && other_)
+            other_->UpdateState(ZX_FIFO_WRITABLE, 0u);
+    }
 
-    *actual = (head_ - old_head);
+    *actual = (head - old_head);
     return ZX_OK;
 }
 
@@ -201,13 +279,21 @@ zx_status_t FifoDispatcher::ReadToUser(user_out_ptr<uint8_t> ptr, size_t bytelen
 
     AutoLock lock(&lock_);
 
-    uint32_t old_tail = tail_;
+    uint32_t tail = __atomic_load_n(&ring_->tail, __ATOMIC_RELAXED);
+    uint32_t old_tail = tail;
 
     // total number of available entries to read from the fifo
-    size_t avail = (head_ - tail_);
-
-    if (avail == 0)
-        return ZX_ERR_SHOULD_WAIT;
+    size_t avail = used();
+
+    if (avail == 0) {
+        set_waiting(ZX_FIFO_RING_READER_WAITING);
+        avail = used();
+        if (avail == 0) {
+            // a mapped peer may have drained the ring without telling us
+            UpdateState(ZX_FIFO_READABLE, 0u);
+            return ZX_ERR_SHOULD_WAIT;
+        }
+    }
 
     bool was_full = (avail == elem_count_);
 
@@ -215,7 +301,7 @@ zx_status_t FifoDispatcher::ReadToUser(user_out_ptr<uint8_t> ptr, size_t bytelen
         count = avail;
 
     while (count > 0) {
-        uint32_t offset = (tail_ & mask_);
+        uint32_t offset = (tail & mask_);
 
         // number of slots from target to end, inclusive
         uint32_t n = elem_count_ - offset;
@@ -226,26 +312,105 @@ zx_status_t FifoDispatcher::ReadToUser(user_out_ptr<uint8_t> ptr, size_t bytelen
         zx_status_t status = ptr.copy_array_to_user(&data_[offset * elem_size_],
                                                     to_copy * elem_size_);
         if (status != ZX_OK) {
-            // roll back, in case this is the second copy
-            tail_ = old_tail;
+            // nothing has been published yet, the tail is only stored below
             return ZX_ERR_INVALID_ARGS;
         }
 
         // adjust tail and count
         // due to size limitations on fifo, to_copy will always fit in a u32
-        tail_ += static_cast<uint32_t>(to_copy);
+        tail += static_cast<uint32_t>(to_copy);
         count -= to_copy;
         ptr = ptr.byte_offset(to_copy * elem_size_);
     }
 
+    __atomic_store_n(&ring_->tail, tail, __ATOMIC_SEQ_CST);
+    clear_waiting(ZX_FIFO_RING_WRITER_WAITING);
+
     // if we were full, we have become writable
-    if (was_full && other_)
+    if ((was_full || vmo_) && other_ && used() < elem_count_)
         other_->UpdateState(0u, ZX_FIFO_WRITABLE);
 
     // if we've become empty, we're no longer readable
-    if ((head_ - tail_) == 0)
-        UpdateState(ZX_FIFO_READABLE, 0u);
+    if (used() == 0) {
+        set_waiting(ZX_FIFO_RING_READER_WAITING);
+        if (used() == 0)
+            UpdateState(ZX_FIFO_READABLE, 0u);
+    }
+
+    *actual = (tail - old_tail);
+    return ZX_OK;
+}
+
+uint32_t FifoDispatcher::used() const {
+    uint32_t head = __atomic_load_n(&ring_->head, __ATOMIC_ACQUIRE);
+    uint32_t tail = __atomic_load_n(&ring_->tail, __ATOMIC_ACQUIRE);
+    uint32_t used = head - tail;
+    return used > elem_count_ ? elem_count_ : used;
+}
+
+// Tells a mapped peer that the kernel side is about to wait, so it rings
+// the doorbell after its next update. Callers check the ring again after
+// setting the bit; the peer stores its index before reading the bits.
+void FifoDispatcher::set_waiting(uint32_t bit) {
+    if (vmo_)
+        __atomic_fetch_or(&ring_->waiters, bit, __ATOMIC_SEQ_CST);
+}
+
+// The signals raised by the kernel path wake any waiter, so it answers the
+// doorbell request on the peer's behalf.
+void FifoDispatcher::clear_waiting(uint32_t bit) {
+    if (vmo_)
+        __atomic_fetch_and(&ring_->waiters, ~bit, __ATOMIC_RELAXED);
+}
+
+zx_status_t FifoDispatcher::GetRing(fbl::RefPtr<VmObject>* vmo, uint32_t* index) {
+    canary_.Assert();
+
+    if (!vmo_)
+        return ZX_ERR_NOT_SUPPORTED;
 
-    *actual = (tail_ - old_tail);
+    *vmo = vmo_;
+    *index = ring_rx_ ^ 1u;
     return ZX_OK;
 }
+
+zx_status_t FifoDispatcher::RingUpdate() {
+    canary_.Assert();
+
+    if (!vmo_)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    fbl::RefPtr<FifoDispatcher> other;
+    {
+        AutoLock lock(&lock_);
+        other = other_;
+    }
+
+    // each endpoint refreshes the signals that depend on the ring it reads:
+    // its own readability and the writability of its peer
+    RingUpdateSelf();
+    if (other)
+        other->RingUpdateSelf();
+    return ZX_OK;
+}
+
+void FifoDispatcher::RingUpdateSelf() {
+    canary_.Assert();
+
+    AutoLock lock(&lock_);
+
+    uint32_t n = used();
+    if (n == 0) {
+        UpdateState(ZX_FIFO_READABLE, 0u);
+    } else {
+        UpdateState(0u, ZX_FIFO_READABLE);
+    }
+
+    if (!other_)
+        return;
+    if (n == elem_count_) {
+        other_->UpdateState(ZX_FIFO_WRITABLE, 0u);
+    } else {
+        other_->UpdateState(0u, ZX_FIFO_WRITABLE);
+    }
+}
@@ -26,17 +26,45 @@ FutexContext::~FutexContext() {
 
     // All of the threads should have removed themselves from wait queues
     // by the time the process has exited.
-    DEBUG_ASSERT(futex_table_.is_empty());
+    for (const auto& shard : shards_) {
+        DEBUG_ASSERT(shard.table.is_empty());
+    }
+}
+
+FutexContext::Shard* FutexContext::ShardFor(uintptr_t futex_key) {
+    // The hash tables bucket on the low bits of the key, so pick the shard
+    // from a multiplicative hash of the whole key instead.
+    uint64_t hash = (static_cast<uint64_t>(futex_key) >> 2) * 0x9e3779b97f4a7c15ull;
+    static_assert((kNumShards & (kNumShards - 1)) == 0, "");
+    return &shards_[hash >> (64 - __builtin_ctzll(kNumShards))];
 }
 
 zx_status_t FutexContext::FutexWait(user_in_ptr<const int> value_ptr, int current_value, zx_time_t deadline) {
     LTRACE_ENTRY;
 
+    return WaitInternal(value_ptr, current_value, nullptr, deadline);
+}
+
+zx_status_t FutexContext::FutexWaitOwned(user_in_ptr<const int> value_ptr, int current_value,
+                                         fbl::RefPtr<ThreadDispatcher> owner, zx_time_t deadline) {
+    LTRACE_ENTRY;
+
+    // Waiting on ourselves would only ever time out.
+    if (owner.get() == ThreadDispatcher::GetCurrent())
+        return ZX_ERR_INVALID_ARGS;
+
+    return WaitInternal(value_ptr, current_value, fbl::move(owner), deadline);
+}
+
+zx_status_t FutexContext::WaitInternal(user_in_ptr<const int> value_ptr, int current_value,
+                                       fbl::RefPtr<ThreadDispatcher> owner, zx_time_t deadline) {
+
     uintptr_t futex_key = reinterpret_cast<uintptr_t>(value_ptr.get());
     if (futex_key % sizeof(int))
         return ZX_ERR_INVALID_ARGS;
 
     FutexNode* node;
+    Shard* shard = ShardFor(futex_key);
 
     // FutexWait() checks that the address value_ptr still contains
     // current_value, and if so it sleeps awaiting a FutexWake() on value_ptr.
@@ -44,16 +72,16 @@ zx_status_t FutexContext::FutexWait(user_in_ptr<const int> value_ptr, int curren
     // If a FutexWake() operation could occur between them, a userland mutex
     // operation built on top of futexes would have a race condition that
     // could miss wakeups.
-    lock_.Acquire();
+    shard->lock.Acquire();
 
     int value;
     zx_status_t result = value_ptr.copy_from_user(&value);
     if (result != ZX_OK) {
-        lock_.Release();
+        shard->lock.Release();
         return result;
     }
     if (value != current_value) {
-        lock_.Release();
+        shard->lock.Release();
         return ZX_ERR_BAD_STATE;
     }
 
@@ -62,10 +90,14 @@ zx_status_t FutexContext::FutexWait(user_in_ptr<const int> value_ptr, int curren
     node->set_hash_key(futex_key);
     node->SetAsSingletonList();
 
-    QueueNodesLocked(node);
+    QueueNodesLocked(shard, node);
 
-    // Block current thread.  This releases lock_ and does not reacquire it.
-    result = node->BlockThread(&lock_, deadline);
+    // Lend our priority to the owner until we are woken or give up.
+    if (owner)
+        node->SetPiOwner(fbl::move(owner));
+
+    // Block current thread.  This releases the shard lock and does not reacquire it.
+    result = node->BlockThread(&shard->lock, deadline);
     if (result == ZX_OK) {
         DEBUG_ASSERT(!node->IsInQueue());
         // All the work necessary for removing us from the hash table was done by FutexWake()
@@ -78,8 +110,7 @@ zx_status_t FutexContext::FutexWait(user_in_ptr<const int> value_ptr, int curren
     //
     // We need to ensure that the thread's node is removed from the wait
     // queue, because FutexWake() probably didn't do that.
-    AutoLock lock(&lock_);
-    if (UnqueueNodeLocked(node)) {
+    if (UnqueueNode(node)) {
         return result;
     }
     // The current thread was not found on the wait queue.  This means
@@ -114,9 +145,10 @@ zx_status_t FutexContext::FutexWake(user_in_ptr<const int> value_ptr,
     if (futex_key % sizeof(int))
         return ZX_ERR_INVALID_ARGS;
 
-    AutoLock lock(&lock_);
+    Shard* shard = ShardFor(futex_key);
+    AutoLock lock(&shard->lock);
 
-    FutexNode* node = futex_table_.erase(futex_key);
+    FutexNode* node = shard->table.erase(futex_key);
     if (!node) {
         // nothing blocked on this futex if we can't find it
         return ZX_OK;
@@ -129,7 +161,7 @@ zx_status_t FutexContext::FutexWake(user_in_ptr<const int> value_ptr,
 
     if (remaining_waiters) {
         DEBUG_ASSERT(remaining_waiters->GetKey() == futex_key);
-        futex_table_.insert(remaining_waiters);
+        shard->table.insert(remaining_waiters);
     }
 
     if (any_woken) {
@@ -140,15 +172,88 @@ zx_status_t FutexContext::FutexWake(user_in_ptr<const int> value_ptr,
     return ZX_OK;
 }
 
+zx_status_t FutexContext::FutexWakeSingleOwner(user_in_ptr<const int> value_ptr) {
+    LTRACE_ENTRY;
+
+    uintptr_t futex_key = reinterpret_cast<uintptr_t>(value_ptr.get());
+    if (futex_key % sizeof(int))
+        return ZX_ERR_INVALID_ARGS;
+
+    Shard* shard = ShardFor(futex_key);
+    AutoLock lock(&shard->lock);
+
+    FutexNode* node = shard->table.erase(futex_key);
+    if (!node) {
+        // nothing blocked on this futex if we can't find it
+        return ZX_OK;
+    }
+    DEBUG_ASSERT(node->GetKey() == futex_key);
+
+    // Hand the remaining waiters to the thread we are about to wake. Waking it
+    // unlinks it from us, which drops whatever priority it lent us.
+    FutexNode::TransferPiOwnership(node);
+
+    bool any_woken = false;
+    FutexNode* remaining_waiters =
+        FutexNode::WakeThreads(node, 1, futex_key, &any_woken);
+
+    if (remaining_waiters) {
+        DEBUG_ASSERT(remaining_waiters->GetKey() == futex_key);
+        shard->table.insert(remaining_waiters);
+    }
+
+    lock.release();
+
+    // Our inherited priority may have dropped even if the wakeup raced with a
+    // timeout, so let the scheduler look again either way.
+    thread_reschedule();
+
+    return ZX_OK;
+}
+
 zx_status_t FutexContext::FutexRequeue(user_in_ptr<const int> wake_ptr, uint32_t wake_count, int current_value,
-                                       user_in_ptr<const int> requeue_ptr, uint32_t requeue_count) {
+                                       user_in_ptr<const int> requeue_ptr, uint32_t requeue_count)
+                                       TA_NO_THREAD_SAFETY_ANALYSIS {
     LTRACE_ENTRY;
 
     if ((requeue_ptr.get() == nullptr) && requeue_count)
         return ZX_ERR_INVALID_ARGS;
 
-    AutoLock lock(&lock_);
+    uintptr_t wake_key = reinterpret_cast<uintptr_t>(wake_ptr.get());
+    uintptr_t requeue_key = reinterpret_cast<uintptr_t>(requeue_ptr.get());
+
+    // The wake and requeue futexes may live in different shards, in which case
+    // both locks are held for the whole operation, taken in address order so
+    // that two requeues in opposite directions cannot deadlock. Requeued nodes
+    // change key, and therefore shard, only while both locks are held, which is
+    // what UnqueueNode() relies on.
+    Shard* wake_shard = ShardFor(wake_key);
+    Shard* requeue_shard = requeue_count ? ShardFor(requeue_key) : wake_shard;
+    Shard* first = (wake_shard < requeue_shard) ? wake_shard : requeue_shard;
+    Shard* second = (wake_shard < requeue_shard) ? requeue_shard : wake_shard;
+
+    first->lock.Acquire();
+    if (second != first)
+        second->lock.Acquire();
+
+    bool any_woken = false;
+    zx_status_t result = RequeueLocked(wake_shard, wake_ptr, wake_count, current_value,
+                                       requeue_shard, requeue_ptr, requeue_count, &any_woken);
 
+    if (second != first)
+        second->lock.Release();
+    first->lock.Release();
+
+    if (any_woken)
+        thread_reschedule();
+
+    return result;
+}
+
+zx_status_t FutexContext::RequeueLocked(Shard* wake_shard, user_in_ptr<const int> wake_ptr,
+                                        uint32_t wake_count, int current_value,
+                                        Shard* requeue_shard, user_in_ptr<const int> requeue_ptr,
+                                        uint32_t requeue_count, bool* out_any_woken) {
     int value;
     zx_status_t result = wake_ptr.copy_from_user(&value);
     if (result != ZX_OK) return result;
@@ -161,17 +266,16 @@ zx_status_t FutexContext::FutexRequeue(user_in_ptr<const int> wake_ptr, uint32_t
         return ZX_ERR_INVALID_ARGS;
 
     // This must happen before RemoveFromHead() calls set_hash_key() on
-    // nodes below, because operations on futex_table_ look at the GetKey
+    // nodes below, because operations on the shard tables look at the GetKey
     // field of the list head nodes for wake_key and requeue_key.
-    FutexNode* node = futex_table_.erase(wake_key);
+    FutexNode* node = wake_shard->table.erase(wake_key);
     if (!node) {
         // nothing blocked on this futex if we can't find it
         return ZX_OK;
     }
 
-    bool any_woken = false;
     if (wake_count > 0) {
-        node = FutexNode::WakeThreads(node, wake_count, wake_key, &any_woken);
+        node = FutexNode::WakeThreads(node, wake_count, wake_key, out_any_woken);
     }
 
     // node is now the head of wake_ptr futex after possibly removing some threads to wake
@@ -184,26 +288,21 @@ zx_status_t FutexContext::FutexRequeue(user_in_ptr<const int> wake_ptr, uint32_t
 
             // now requeue our nodes to requeue_ptr mutex
             DEBUG_ASSERT(requeue_head->GetKey() == requeue_key);
-            QueueNodesLocked(requeue_head);
+            QueueNodesLocked(requeue_shard, requeue_head);
         }
     }
 
     // add any remaining nodes back to wake_key futex
     if (node != nullptr) {
         DEBUG_ASSERT(node->GetKey() == wake_key);
-        futex_table_.insert(node);
-    }
-
-    if (any_woken) {
-        lock.release();
-        thread_reschedule();
+        wake_shard->table.insert(node);
     }
 
     return ZX_OK;
 }
 
-void FutexContext::QueueNodesLocked(FutexNode* head) {
-    DEBUG_ASSERT(lock_.IsHeld());
+void FutexContext::QueueNodesLocked(Shard* shard, FutexNode* head) {
+    DEBUG_ASSERT(shard->lock.IsHeld());
 
     FutexNode::HashTable::iterator iter;
 
@@ -211,29 +310,36 @@ void FutexContext::QueueNodesLocked(FutexNode* head) {
     // succeeds, then the current thread is first to block on this futex and we
     // are finished.  If the insert fails, then there is already a thread
     // waiting on this futex.  Add ourselves to that thread's list.
-    if (!futex_table_.insert_or_find(head, &iter))
+    if (!shard->table.insert_or_find(head, &iter))
         iter->AppendList(head);
 }
 
 // This attempts to unqueue a thread (which may or may not be waiting on a
 // futex), given its FutexNode.  This returns whether the FutexNode was
 // found and removed from a futex wait queue.
-bool FutexContext::UnqueueNodeLocked(FutexNode* node) {
-    DEBUG_ASSERT(lock_.IsHeld());
-
-    if (!node->IsInQueue())
-        return false;
-
+bool FutexContext::UnqueueNode(FutexNode* node) {
     // Note: When UnqueueNode() is called from FutexWait(), it might be
     // tempting to reuse the futex key that was passed to FutexWait().
     // However, that could be out of date if the thread was requeued by
-    // FutexRequeue(), so we need to re-get the hash table key here.
-    uintptr_t futex_key = node->GetKey();
-
-    FutexNode* old_head = futex_table_.erase(futex_key);
-    DEBUG_ASSERT(old_head);
-    FutexNode* new_head = FutexNode::RemoveNodeFromList(old_head, node);
-    if (new_head)
-        futex_table_.insert(new_head);
-    return true;
+    // FutexRequeue(), so we need to re-get the hash table key here. A
+    // requeue can also move the node to another shard while we wait for
+    // the lock, in which case we try again with the new key.
+    for (;;) {
+        uintptr_t futex_key = node->GetKey();
+        Shard* shard = ShardFor(futex_key);
+        AutoLock lock(&shard->lock);
+
+        if (!node->IsInQueue())
+            return false;
+        if (node->GetKey() != futex_key)
+            continue;
+
+        FutexNode* old_head = shard->table.erase(futex_key);
+        DEBUG_ASSERT(old_head);
+        FutexNode* new_head = FutexNode::RemoveNodeFromList(old_head, node);
+        if (new_head)
+            shard->table.insert(new_head);
+        node->ClearPiOwner();
+        return true;
+    }
 }
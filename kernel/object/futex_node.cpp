@@ -8,14 +8,18 @@
 
 #include <assert.h>
 #include <err.h>
+#include <fbl/algorithm.h>
 #include <fbl/mutex.h>
+#include <kernel/sched.h>
+#include <object/thread_dispatcher.h>
 #include <platform.h>
 #include <trace.h>
 #include <zircon/types.h>
 
 #define LOCAL_TRACE 0
 
-FutexNode::FutexNode() {
+FutexNode::FutexNode(ThreadDispatcher* thread)
+    : thread_(thread) {
     LTRACE_ENTRY;
 
     wait_queue_ = WAIT_QUEUE_INITIAL_VALUE(wait_queue_);
@@ -25,6 +29,8 @@ FutexNode::~FutexNode() {
     LTRACE_ENTRY;
 
     DEBUG_ASSERT(!IsInQueue());
+    DEBUG_ASSERT(!pi_owner_);
+    DEBUG_ASSERT(pi_waiters_.is_empty());
 
     wait_queue_destroy(&wait_queue_);
 }
@@ -175,16 +181,19 @@ bool FutexNode::WakeThread() {
     // cases to consider:
     //  1) The thread's wait times out, or the thread is killed or
     //     suspended.  In those cases, FutexWait() will reacquire the
-    //     FutexContext lock.  We are currently holding that lock, so
-    //     FutexWait() will not race with us.
+    //     lock of the futex's FutexContext shard.  We are currently
+    //     holding that lock, so FutexWait() will not race with us.
     //  2) The thread is woken by our wait_queue_wake_one() call.  In
-    //     this case, FutexWait() will *not* reacquire the FutexContext
+    //     this case, FutexWait() will *not* reacquire the shard
     //     lock.  To handle this correctly, we must not access |this|
     //     after wait_queue_wake_one().
 
     // We must do this before we wake the thread, to handle case 2.
     MarkAsNotInQueue();
 
+    // The reference to our owner, if any, is dropped after the thread lock.
+    fbl::RefPtr<ThreadDispatcher> pi_owner;
+
     // Place the waiting thread in the runnable state, but do not
     // reschedule yet.  Our caller is currently holding the main
     // futex_lock, and any threads which get woken by this action are going
@@ -193,9 +202,69 @@ bool FutexNode::WakeThread() {
     // will release the lock and then arrange for a reschedule operation
     // (which leads to a smoother transition).
     AutoThreadLock lock;
+    pi_owner = UnlinkFromPiOwnerLocked();
     return wait_queue_wake_one(&wait_queue_, /* reschedule */ false, ZX_OK);
 }
 
+void FutexNode::SetPiOwner(fbl::RefPtr<ThreadDispatcher> owner) {
+    DEBUG_ASSERT(thread_ == ThreadDispatcher::GetCurrent());
+    DEBUG_ASSERT(owner.get() != thread_);
+
+    AutoThreadLock lock;
+    pi_priority_ = sched_get_effective_priority(get_current_thread());
+    LinkToPiOwnerLocked(fbl::move(owner));
+}
+
+fbl::RefPtr<ThreadDispatcher> FutexNode::ClearPiOwner() {
+    AutoThreadLock lock;
+    return UnlinkFromPiOwnerLocked();
+}
+
+void FutexNode::TransferPiOwnership(FutexNode* list_head) {
+    DEBUG_ASSERT(list_head->IsInQueue());
+
+    // The thread is still blocked, so it has not dropped the reference it
+    // holds on itself while running.
+    fbl::RefPtr<ThreadDispatcher> new_owner = fbl::WrapRefPtr(list_head->thread_);
+
+    for (FutexNode* node = list_head->queue_next_; node != list_head; node = node->queue_next_) {
+        fbl::RefPtr<ThreadDispatcher> old_owner;
+        AutoThreadLock lock;
+        if (node->pi_owner_ && node->pi_owner_ != new_owner) {
+            old_owner = node->UnlinkFromPiOwnerLocked();
+            node->LinkToPiOwnerLocked(new_owner);
+        }
+    }
+}
+
+void FutexNode::LinkToPiOwnerLocked(fbl::RefPtr<ThreadDispatcher> owner) {
+    DEBUG_ASSERT(!pi_owner_);
+
+    owner->futex_node()->pi_waiters_.push_back(this);
+    pi_owner_ = fbl::move(owner);
+    UpdatePiPriorityLocked(pi_owner_.get());
+}
+
+fbl::RefPtr<ThreadDispatcher> FutexNode::UnlinkFromPiOwnerLocked() {
+    if (!pi_owner_)
+        return nullptr;
+
+    pi_owner_->futex_node()->pi_waiters_.erase(*this);
+    UpdatePiPriorityLocked(pi_owner_.get());
+    return fbl::move(pi_owner_);
+}
+
+// Every waiter runs the owner at the priority the waiter had when it blocked.
+// Inheritance is not transitive: an owner that is itself blocked on another
+// owner does not pass the boost further along.
+void FutexNode::UpdatePiPriorityLocked(ThreadDispatcher* owner) {
+    int priority = LOWEST_PRIORITY;
+    for (const auto& waiter : owner->futex_node()->pi_waiters_)
+        priority = fbl::max(priority, waiter.pi_priority_);
+
+    sched_inherit_priority(owner->thread(), priority);
+}
+
 // Set |node1| and |node2|'s list pointers so that |node1| is immediately
 // before |node2| in the linked list.
 void FutexNode::RelinkAsAdjacent(FutexNode* node1, FutexNode* node2) {
@@ -20,14 +20,17 @@
 #include <lib/oom.h>
 
 #include <object/diagnostics.h>
+#include <object/event_dispatcher.h>
 #include <object/excp_port.h>
 #include <object/job_dispatcher.h>
 #include <object/policy_manager.h>
 #include <object/port_dispatcher.h>
 #include <object/process_dispatcher.h>
+#include <object/thread_dispatcher.h>
 
 #include <fbl/function.h>
 
+#include <zircon/syscalls/system.h>
 #include <zircon/types.h>
 
 #define LOCAL_TRACE 0
@@ -56,6 +59,25 @@ PolicyManager* GetSystemPolicyManager() {
     return policy_manager;
 }
 
+// One event per memory pressure level, only the current level's is signaled.
+static fbl::RefPtr<EventDispatcher> memory_pressure_events[OOM_PRESSURE_LEVELS];
+
+zx_status_t GetSystemEvent(uint32_t kind, fbl::RefPtr<EventDispatcher>* event) {
+    switch (kind) {
+    case ZX_SYSTEM_EVENT_MEMORY_PRESSURE_NORMAL:
+        *event = memory_pressure_events[OOM_PRESSURE_NORMAL];
+        return ZX_OK;
+    case ZX_SYSTEM_EVENT_MEMORY_PRESSURE_WARNING:
+        *event = memory_pressure_events[OOM_PRESSURE_WARNING];
+        return ZX_OK;
+    case ZX_SYSTEM_EVENT_MEMORY_PRESSURE_CRITICAL:
+        *event = memory_pressure_events[OOM_PRESSURE_CRITICAL];
+        return ZX_OK;
+    default:
+        return ZX_ERR_INVALID_ARGS;
+    }
+}
+
 // Counts and optionally prints all job/process descendants of a job.
 namespace {
 class OomJobEnumerator final : public JobEnumerator {
@@ -119,9 +141,27 @@ private:
 };
 } // namespace
 
+// Called from the OOM thread when the memory pressure level changes.
+static void oom_pressure(oom_pressure_level level) {
+    // Clear the old level before signaling the new one, so that nobody
+    // watching several levels at once can see both.
+    for (int i = 0; i < OOM_PRESSURE_LEVELS; i++) {
+        if (i != level) {
+            memory_pressure_events[i]->user_signal(ZX_EVENT_SIGNALED, 0, false);
+        }
+    }
+    memory_pressure_events[level]->user_signal(0, ZX_EVENT_SIGNALED, false);
+
+    // Give back what the kernel itself holds on to before anyone is killed.
+    if (level == OOM_PRESSURE_CRITICAL) {
+        printf("OOM: Freed %zu cached kernel stacks\n", ThreadDispatcher::TrimStackCache());
+    }
+}
+
 // Called from a dedicated kernel thread when the system is low on memory.
 static void oom_lowmem(size_t shortfall_bytes) {
     printf("OOM: oom_lowmem(shortfall_bytes=%zu) called\n", shortfall_bytes);
+    printf("OOM: Freed %zu cached kernel stacks\n", ThreadDispatcher::TrimStackCache());
     printf("OOM: Process mapped committed bytes:\n");
     DumpProcessMemoryUsage("OOM:   ", /*min_pages=*/8 * MB / PAGE_SIZE);
     printf("OOM: Finding a job to kill...\n");
@@ -183,11 +223,25 @@ static void object_glue_init(uint level) TA_NO_THREAD_SAFETY_ANALYSIS {
     root_job = JobDispatcher::CreateRootJob();
     policy_manager = PolicyManager::Create();
     PortDispatcher::Init();
+
+    for (auto& event : memory_pressure_events) {
+        fbl::RefPtr<Dispatcher> dispatcher;
+        zx_rights_t rights;
+        zx_status_t status = EventDispatcher::Create(0u, &dispatcher, &rights);
+        if (status != ZX_OK) {
+            panic("unable to create memory pressure event: %d\n", status);
+        }
+        event = DownCastDispatcher<EventDispatcher>(&dispatcher);
+    }
+    memory_pressure_events[OOM_PRESSURE_NORMAL]->user_signal(0, ZX_EVENT_SIGNALED, false);
+
     // Be sure to update kernel_cmdline.md if any of these defaults change.
     oom_init(cmdline_get_bool("kernel.oom.enable", true),
              ZX_SEC(cmdline_get_uint64("kernel.oom.sleep-sec", 1)),
              cmdline_get_uint64("kernel.oom.redline-mb", 50) * MB,
-             oom_lowmem);
+             cmdline_get_uint64("kernel.oom.critical-mb", 100) * MB,
+             cmdline_get_uint64("kernel.oom.warning-mb", 300) * MB,
+             oom_lowmem, oom_pressure);
 }
 
 LK_INIT_HOOK(libobject, object_glue_init, LK_INIT_LEVEL_THREADING);
@@ -7,12 +7,13 @@
 #include <object/guest_dispatcher.h>
 
 #include <arch/hypervisor.h>
+#include <hypervisor/guest_physical_address_space.h>
 #include <vm/vm_object.h>
 #include <zircon/rights.h>
 #include <fbl/alloc_checker.h>
 
 // static
-zx_status_t GuestDispatcher::Create(fbl::RefPtr<VmObject> physmem,
+zx_status_t GuestDispatcher::Create(fbl::RefPtr<VmObject> physmem, uint32_t options,
                                     fbl::RefPtr<Dispatcher>* dispatcher,
                                     zx_rights_t* rights) {
     fbl::unique_ptr<Guest> guest;
@@ -20,6 +21,12 @@ zx_status_t GuestDispatcher::Create(fbl::RefPtr<VmObject> physmem,
     if (status != ZX_OK)
         return status;
 
+    if (options & ZX_GUEST_OPT_POPULATE) {
+        status = guest->AddressSpace()->Populate();
+        if (status != ZX_OK)
+            return status;
+    }
+
     fbl::AllocChecker ac;
     auto disp = new (&ac) GuestDispatcher(fbl::move(guest));
     if (!ac.check())
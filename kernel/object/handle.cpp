@@ -6,6 +6,7 @@
 
 #include <object/handle.h>
 
+#include <arch/ops.h>
 #include <object/dispatcher.h>
 #include <fbl/arena.h>
 #include <fbl/auto_lock.h>
@@ -46,10 +47,26 @@ static_assert(((3 << 30) ^ kHandleGenerationMask ^ kHandleIndexMask) ==
                   0xffffffffu,
               "Masks do not agree");
 
+// Each cpu keeps a magazine of free arena slots in front of the arena, so
+// that allocating and freeing handles normally only takes the lock of the
+// local magazine. A magazine that runs empty is refilled from the arena, and
+// one that fills up gives half of its slots back, in batches of kMagazineBatch
+// under the arena lock.
+constexpr size_t kMagazineSize = 64;
+constexpr size_t kMagazineBatch = kMagazineSize / 2;
+
 }  // namespace
 
+struct Handle::Magazine {
+    fbl::Mutex lock;
+    size_t count TA_GUARDED(lock) = 0;
+    void* slots[kMagazineSize] TA_GUARDED(lock);
+};
+
 fbl::Mutex Handle::mutex_;
 fbl::Arena Handle::arena_;
+Handle::Magazine Handle::magazines_[SMP_MAX_CPUS];
+fbl::atomic<size_t> Handle::outstanding_handles_;
 
 void Handle::Init() TA_NO_THREAD_SAFETY_ANALYSIS {
     arena_.Init("handles", sizeof(Handle), kMaxHandleCount);
@@ -58,7 +75,7 @@ void Handle::Init() TA_NO_THREAD_SAFETY_ANALYSIS {
 // Returns a new |base_value| based on the value stored in the free
 // arena slot pointed to by |addr|. The new value will be different
 // from the last |base_value| used by this slot.
-uint32_t Handle::GetNewBaseValue(void* addr) TA_REQ(mutex_) {
+uint32_t Handle::GetNewBaseValue(void* addr) {
     // Get the index of this slot within the arena.
     uint32_t handle_index = HandleToIndex(reinterpret_cast<Handle*>(addr));
     DEBUG_ASSERT((handle_index & ~kHandleIndexMask) == 0);
@@ -76,33 +93,71 @@ uint32_t Handle::GetNewBaseValue(void* addr) TA_REQ(mutex_) {
     return (handle_index | new_gen);
 }
 
+// Takes a free slot from the local magazine, refilling it from the arena
+// if it is empty. Near the arena limit the free slots may all be sitting in
+// other cpus' magazines, so look there before giving up.
+void* Handle::AllocSlot() {
+    Magazine* local = &magazines_[arch_curr_cpu_num()];
+    {
+        AutoLock lock(&local->lock);
+        if (local->count == 0) {
+            AutoLock arena_lock(&mutex_);
+            while (local->count < kMagazineBatch) {
+                void* addr = arena_.Alloc();
+                if (!addr)
+                    break;
+                local->slots[local->count++] = addr;
+            }
+        }
+        if (likely(local->count > 0))
+            return local->slots[--local->count];
+    }
+
+    for (auto& magazine : magazines_) {
+        AutoLock lock(&magazine.lock);
+        if (magazine.count > 0)
+            return magazine.slots[--magazine.count];
+    }
+    return nullptr;
+}
+
+// Puts a free slot in the local magazine, first giving half of the
+// magazine back to the arena if it is full.
+void Handle::FreeSlot(void* addr) {
+    Magazine* local = &magazines_[arch_curr_cpu_num()];
+
+    AutoLock lock(&local->lock);
+    if (local->count == kMagazineSize) {
+        AutoLock arena_lock(&mutex_);
+        while (local->count > kMagazineSize - kMagazineBatch)
+            arena_.Free(local->slots[--local->count]);
+    }
+    local->slots[local->count++] = addr;
+}
+
 // Allocate space for a Handle from the arena, but don't instantiate the
 // object.  |base_value| gets the value for Handle::base_value_.  |what|
 // says whether this is allocation or duplication, for the error message.
 void* Handle::Alloc(const fbl::RefPtr<Dispatcher>& dispatcher,
                     const char* what, uint32_t* base_value) {
-    size_t outstanding_handles;
-    {
-        AutoLock lock(&mutex_);
-        void* addr = arena_.Alloc();
-        outstanding_handles = arena_.DiagnosticCount();
-        if (likely(addr)) {
-            if (outstanding_handles > kHighHandleCount) {
-                // TODO: Avoid calling this for every handle after
-                // kHighHandleCount; printfs are slow and we're
-                // holding the mutex.
-                printf("WARNING: High handle count: %zu handles\n",
-                       outstanding_handles);
-            }
-            dispatcher->increment_handle_count();
-            *base_value = GetNewBaseValue(addr);
-            return addr;
-        }
+    void* addr = AllocSlot();
+    if (unlikely(!addr)) {
+        printf("WARNING: Could not allocate %s handle (%zu outstanding)\n",
+               what, outstanding_handles_.load());
+        return nullptr;
     }
 
-    printf("WARNING: Could not allocate %s handle (%zu outstanding)\n",
-           what, outstanding_handles);
-    return nullptr;
+    size_t outstanding_handles = outstanding_handles_.fetch_add(1) + 1;
+    if (unlikely(outstanding_handles > kHighHandleCount)) {
+        // TODO: Avoid calling this for every handle after
+        // kHighHandleCount; printfs are slow.
+        printf("WARNING: High handle count: %zu handles\n",
+               outstanding_handles);
+    }
+
+    dispatcher->increment_handle_count();
+    *base_value = GetNewBaseValue(addr);
+    return addr;
 }
 
 HandleOwner Handle::Make(fbl::RefPtr<Dispatcher> dispatcher,
@@ -143,7 +198,7 @@ Handle::Handle(Handle* rhs, zx_rights_t rights, uint32_t base_value)
 // Destroys, but does not free, the Handle, and fixes up its memory to protect
 // against stale pointers to it. Also stashes the Handle's base_value for reuse
 // the next time this slot is allocated.
-void Handle::TearDown() TA_EXCL(mutex_) {
+void Handle::TearDown() {
     uint32_t old_base_value = base_value();
 
     // Calling the handle dtor can cause many things to happen, so it is
@@ -172,44 +227,53 @@ void Handle::Delete() {
     if (disp->has_state_tracker())
         disp->Cancel(this);
 
-    TearDown();
+    bool zero_handles = disp->decrement_handle_count();
 
-    bool zero_handles = false;
-    {
-        AutoLock lock(&mutex_);
-        zero_handles = disp->decrement_handle_count();
-        arena_.Free(this);
-    }
+    // A lock-free lookup may have found this handle just before it was
+    // removed from its process, and still be reading it.
+    RcuCall<&Handle::Reclaim>();
 
     if (zero_handles)
         disp->on_zero_handles();
 
-    // If |disp| is the last reference then the dispatcher object
-    // gets destroyed here.
+    // If the handle held the last reference other than |disp| then the
+    // dispatcher object gets destroyed once the handle is reclaimed.
+}
+
+void Handle::Reclaim(Handle* handle) {
+    handle->TearDown();
+    outstanding_handles_.fetch_sub(1);
+    FreeSlot(handle);
 }
 
 Handle* Handle::FromU32(uint32_t value) TA_NO_THREAD_SAFETY_ANALYSIS {
+    // The bounds of the arena never change after Init(), so this does not
+    // need the arena lock. Free slots, whether in a magazine or back in the
+    // arena, have a zero base_value_ and never match.
     Handle* handle = IndexToHandle(value & kHandleIndexMask);
-    {
-        AutoLock lock(&mutex_);
-        if (unlikely(!arena_.in_range(handle)))
-            return nullptr;
-    }
+    if (unlikely(!arena_.in_range(handle)))
+        return nullptr;
     return likely(handle->base_value() == value) ? handle : nullptr;
 }
 
 uint32_t Handle::Count(const fbl::RefPtr<const Dispatcher>& dispatcher) {
-    // Handle::mutex_ also guards Dispatcher::handle_count_.
-    AutoLock lock(&mutex_);
     return dispatcher->current_handle_count();
 }
 
 size_t Handle::diagnostics::OutstandingHandles() {
-    AutoLock lock(&mutex_);
-    return arena_.DiagnosticCount();
+    return outstanding_handles_.load();
 }
 
 void Handle::diagnostics::DumpTableInfo() {
+    // Slots cached in the magazines count as allocated in the arena.
+    size_t cached = 0;
+    for (auto& magazine : magazines_) {
+        AutoLock lock(&magazine.lock);
+        cached += magazine.count;
+    }
+
     AutoLock lock(&mutex_);
     arena_.Dump();
+    printf("  %zu free slots cached per-cpu, %zu handles outstanding\n",
+           cached, outstanding_handles_.load());
 }
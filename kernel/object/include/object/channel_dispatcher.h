@@ -23,6 +23,8 @@ class ChannelDispatcher final : public Dispatcher {
 public:
     class MessageWaiter;
 
+    using MessageList = fbl::DoublyLinkedList<fbl::unique_ptr<MessagePacket>>;
+
     static zx_status_t Create(fbl::RefPtr<Dispatcher>* dispatcher0,
                               fbl::RefPtr<Dispatcher>* dispatcher1, zx_rights_t* rights);
 
@@ -45,8 +47,25 @@ public:
                      fbl::unique_ptr<MessagePacket>* msg,
                      bool may_disard);
 
+    // Read up to |count| messages from this endpoint's message queue onto the end of |msgs|.
+    // The i-th message read may be at most |max_sizes[i]| bytes and |max_handle_counts[i]|
+    // handles; reading stops at the first message that does not fit. Returns ZX_OK if at least
+    // one message was read. Otherwise the result is as for Read() without |may_discard|, and on
+    // ZX_ERR_BUFFER_TOO_SMALL |*next_size| and |*next_handle_count| give the next message's size.
+    zx_status_t ReadMany(size_t count,
+                         const uint32_t* max_sizes,
+                         const uint32_t* max_handle_counts,
+                         MessageList* msgs,
+                         uint32_t* next_size,
+                         uint32_t* next_handle_count);
+
     // Write to the opposing endpoint's message queue.
     zx_status_t Write(fbl::unique_ptr<MessagePacket> msg);
+
+    // Write all of |msgs|, in order, to the opposing endpoint's message queue under a single
+    // acquisition of its lock, signaling it at most once. On ZX_ERR_PEER_CLOSED |msgs| is left
+    // untouched so the caller can put the handles back.
+    zx_status_t WriteMany(MessageList* msgs);
     zx_status_t Call(fbl::unique_ptr<MessagePacket> msg,
                      zx_time_t deadline, bool* return_handles,
                      fbl::unique_ptr<MessagePacket>* reply);
@@ -93,7 +112,6 @@ public:
     };
 
 private:
-    using MessageList = fbl::DoublyLinkedList<fbl::unique_ptr<MessagePacket>>;
     using WaiterList = fbl::DoublyLinkedList<MessageWaiter*>;
 
     void RemoveWaiter(MessageWaiter* waiter);
@@ -101,6 +119,8 @@ private:
     ChannelDispatcher();
     void Init(fbl::RefPtr<ChannelDispatcher> other);
     int WriteSelf(fbl::unique_ptr<MessagePacket> msg);
+    int WriteSelfMany(MessageList* msgs);
+    MessageWaiter* TakeWaiterLocked(zx_txid_t txid) TA_REQ(lock_);
     zx_status_t UserSignalSelf(uint32_t clear_mask, uint32_t set_mask);
     void OnPeerZeroHandles();
 
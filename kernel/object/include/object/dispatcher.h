@@ -10,6 +10,7 @@
 #include <stdint.h>
 #include <stdint.h>
 
+#include <fbl/atomic.h>
 #include <fbl/canary.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/intrusive_single_list.h>
@@ -59,6 +60,8 @@ DECLARE_DISPTAG(GuestDispatcher, ZX_OBJ_TYPE_GUEST)
 DECLARE_DISPTAG(VcpuDispatcher, ZX_OBJ_TYPE_VCPU)
 DECLARE_DISPTAG(TimerDispatcher, ZX_OBJ_TYPE_TIMER)
 DECLARE_DISPTAG(IommuDispatcher, ZX_OBJ_TYPE_IOMMU)
+DECLARE_DISPTAG(PagerDispatcher, ZX_OBJ_TYPE_PAGER)
+DECLARE_DISPTAG(RingDispatcher, ZX_OBJ_TYPE_RING)
 
 #undef DECLARE_DISPTAG
 
@@ -72,21 +75,19 @@ public:
 
     zx_koid_t get_koid() const { return koid_; }
 
-    // Must be called under the handle table lock.
+    // Only called by Handle.
     void increment_handle_count() {
-        ++handle_count_;
+        handle_count_.fetch_add(1u, fbl::memory_order_relaxed);
     }
 
-    // Must be called under the handle table lock.
+    // Only called by Handle.
     // Returns true exactly when the handle count goes to zero.
     bool decrement_handle_count() {
-        --handle_count_;
-        return handle_count_ == 0u;
+        return handle_count_.fetch_sub(1u, fbl::memory_order_acq_rel) == 1u;
     }
 
-    // Must be called under the handle table lock.
     uint32_t current_handle_count() const {
-        return handle_count_;
+        return handle_count_.load(fbl::memory_order_relaxed);
     }
 
     // The following are only to be called when |has_state_tracker| reports true.
@@ -157,7 +158,7 @@ protected:
 
     zx_signals_t GetSignalsState() const {
         ZX_DEBUG_ASSERT(has_state_tracker());
-        return signals_;
+        return signals_.load();
     }
 
     // Dispatcher subtypes should use this lock to protect their internal state.
@@ -180,20 +181,23 @@ private:
     // Returns flag kHandled if one of the observers have been signaled.
     StateObserver::Flags UpdateInternalLocked(ObserverList* obs_to_remove, zx_signals_t signals) TA_REQ(lock_);
 
+    // Keeps |has_observers_| in step with |observers_| after observers are
+    // removed.
+    void UpdateHasObserversLocked() TA_REQ(lock_);
+
     const zx_koid_t koid_;
-    uint32_t handle_count_;
-
-    // TODO(kulakowski) Make signals_ TA_GUARDED(lock_).
-    // Right now, signals_ is almost entirely accessed under the
-    // common dispatcher lock_. Once we migrate the per-object locks
-    // to instead use the common dispatcher lock_, all of the unlocked
-    // accesses (all of which go via GetSignalsState) will be
-    // statically under this lock_, rather than maybe under this lock
-    // or the more specific object lock.
-    zx_signals_t signals_;
-
-    // Active observers are elements in |observers_|.
+    fbl::atomic<uint32_t> handle_count_;
+
+    // |signals_| is changed without holding |lock_| while nothing observes
+    // the object, so that those updates don't take it. Once there are
+    // observers it is only changed under |lock_|, which they are notified
+    // under.
+    fbl::atomic<zx_signals_t> signals_;
+
+    // Active observers are elements in |observers_|. |has_observers_| is
+    // only written under |lock_|, but is read without it by UpdateState.
     ObserverList observers_ TA_GUARDED(lock_);
+    fbl::atomic<bool> has_observers_;
 
     // Used to store this dispatcher on the dispatcher deleter list.
     fbl::SinglyLinkedListNodeState<Dispatcher*> deleter_ll_;
@@ -28,3 +28,7 @@ private:
     fbl::Canary<fbl::magic("EVTD")> canary_;
     CookieJar cookie_jar_;
 };
+
+// Returns the event the kernel signals for |kind|, one of the
+// ZX_SYSTEM_EVENT_* values.
+zx_status_t GetSystemEvent(uint32_t kind, fbl::RefPtr<EventDispatcher>* event);
@@ -9,7 +9,9 @@
 #include <stdint.h>
 
 #include <object/dispatcher.h>
+#include <vm/vm_object.h>
 
+#include <zircon/syscalls/fifo.h>
 #include <zircon/types.h>
 #include <fbl/canary.h>
 #include <fbl/mutex.h>
@@ -34,12 +36,31 @@ public:
     zx_status_t WriteFromUser(user_in_ptr<const uint8_t> src, size_t len, uint32_t* actual);
     zx_status_t ReadToUser(user_out_ptr<uint8_t> dst, size_t len, uint32_t* actual);
 
+    // For ZX_FIFO_MAPPABLE fifos, returns the shared ring vmo and the index
+    // of the ring this endpoint writes.
+    zx_status_t GetRing(fbl::RefPtr<VmObject>* vmo, uint32_t* index);
+
+    // For ZX_FIFO_MAPPABLE fifos, recomputes the readable and writable
+    // signals of both endpoints from the state of the rings.
+    zx_status_t RingUpdate();
+
 private:
+    // |ring| and |data| point at the header and the slots of the ring this
+    // endpoint reads. For a mapped fifo they are physmap addresses within
+    // |vmo|, which the caller has pinned once on behalf of this endpoint.
     FifoDispatcher(uint32_t options, uint32_t elem_count, uint32_t elem_size,
-                   fbl::unique_ptr<uint8_t[]> data);
+                   fbl::unique_ptr<uint8_t[]> buffer, fbl::RefPtr<VmObject> vmo,
+                   uint32_t ring_rx, zx_fifo_ring_t* ring, uint8_t* data);
     void Init(fbl::RefPtr<FifoDispatcher> other);
     zx_status_t WriteSelf(user_in_ptr<const uint8_t> ptr, size_t len, uint32_t* actual);
     zx_status_t UserSignalSelf(uint32_t clear_mask, uint32_t set_mask);
+    void RingUpdateSelf();
+
+    // Number of elements waiting to be read. For mapped fifos the indices
+    // can be scribbled on by userspace, so this is clamped to the capacity.
+    uint32_t used() const TA_REQ(lock_);
+    void set_waiting(uint32_t bit) TA_REQ(lock_);
+    void clear_waiting(uint32_t bit) TA_REQ(lock_);
 
     void OnPeerZeroHandles();
 
@@ -49,11 +70,17 @@ private:
     const uint32_t mask_;
     zx_koid_t peer_koid_;
 
+    // Set for ZX_FIFO_MAPPABLE fifos only, shared with the peer.
+    const fbl::RefPtr<VmObject> vmo_;
+    const uint32_t ring_rx_;
+
     fbl::Mutex lock_;
     fbl::RefPtr<FifoDispatcher> other_ TA_GUARDED(lock_);
-    uint32_t head_ TA_GUARDED(lock_);
-    uint32_t tail_ TA_GUARDED(lock_);
-    fbl::unique_ptr<uint8_t[]> data_ TA_GUARDED(lock_);
+    // The head and tail of an unmapped fifo, |ring_| points here.
+    zx_fifo_ring_t local_ring_ TA_GUARDED(lock_);
+    zx_fifo_ring_t* const ring_;
+    fbl::unique_ptr<uint8_t[]> buffer_ TA_GUARDED(lock_);
+    uint8_t* const data_;
 
     static constexpr uint32_t kMaxSizeBytes = PAGE_SIZE;
 };
@@ -9,11 +9,16 @@
 #include <lib/user_copy/user_ptr.h>
 #include <zircon/types.h>
 #include <fbl/mutex.h>
+#include <fbl/ref_ptr.h>
 #include <object/futex_node.h>
 
+class ThreadDispatcher;
+
 // FutexContext is a class that encapsulates support for futex operations.
-// FutexContext uses a hash table keyed on the futex address (a pointer to integer in userspace)
-// to contain all active futexes.
+// FutexContext uses hash tables keyed on the futex address (a pointer to integer in userspace)
+// to contain all active futexes. The futexes are spread over a fixed number of shards, each
+// with its own lock and hash table, so that operations on unrelated futexes within one process
+// do not contend with each other.
 // A futex is considered active if there is one or more threads blocked on the futex.
 // After no threads are left blocked on a futex it is removed from the hash table.
 // The value in the futex hash table is the FutexNode object associated with the head
@@ -35,9 +40,20 @@ public:
     // on the same |value_ptr| futex.
     zx_status_t FutexWait(user_in_ptr<const int> value_ptr, int current_value, zx_time_t deadline);
 
+    // FutexWaitOwned is FutexWait on a futex held by |owner|. For as long as the
+    // current thread is blocked, |owner| runs at no lower a priority than the
+    // current thread had when it blocked.
+    zx_status_t FutexWaitOwned(user_in_ptr<const int> value_ptr, int current_value,
+                               fbl::RefPtr<ThreadDispatcher> owner, zx_time_t deadline);
+
     // FutexWake will wake up to |count| number of threads blocked on the |value_ptr| futex.
     zx_status_t FutexWake(user_in_ptr<const int> value_ptr, uint32_t count);
 
+    // FutexWakeSingleOwner wakes the first thread blocked on the |value_ptr| futex and
+    // makes it the owner of the threads that remain blocked on it, so that the
+    // priority they lent to the current thread now goes to the woken thread.
+    zx_status_t FutexWakeSingleOwner(user_in_ptr<const int> value_ptr);
+
     // FutexWait first verifies that the integer pointed to by |wake_ptr|
     // still equals |current_value|. If the test fails, FutexWait returns FAILED_PRECONDITION.
     // Otherwise it will wake up to |wake_count| number of threads blocked on the |wake_ptr| futex.
@@ -51,14 +67,33 @@ private:
     FutexContext(const FutexContext&) = delete;
     FutexContext& operator=(const FutexContext&) = delete;
 
-    void QueueNodesLocked(FutexNode* head) TA_REQ(lock_);
+    static constexpr size_t kNumShards = 16;
+
+    struct Shard {
+        // protects table
+        fbl::Mutex lock;
+
+        // Key is futex address, value is the FutexNode for the head of futex's blocked
+        // thread list.
+        FutexNode::HashTable table TA_GUARDED(lock);
+    };
+
+    Shard* ShardFor(uintptr_t futex_key);
+
+    zx_status_t WaitInternal(user_in_ptr<const int> value_ptr, int current_value,
+                             fbl::RefPtr<ThreadDispatcher> owner, zx_time_t deadline);
+
+    zx_status_t RequeueLocked(Shard* wake_shard, user_in_ptr<const int> wake_ptr,
+                              uint32_t wake_count, int current_value,
+                              Shard* requeue_shard, user_in_ptr<const int> requeue_ptr,
+                              uint32_t requeue_count, bool* out_any_woken)
+        TA_REQ(wake_shard->lock, requeue_shard->lock);
 
-    bool UnqueueNodeLocked(FutexNode* node) TA_REQ(lock_);
+    static void QueueNodesLocked(Shard* shard, FutexNode* head) TA_REQ(shard->lock);
 
-    // protects futex_table_
-    fbl::Mutex lock_;
+    // Removes |node| from whatever futex it is waiting on, if any. Takes the lock of the
+    // shard the node currently belongs to.
+    bool UnqueueNode(FutexNode* node);
 
-    // Hash table for futexes in this context.
-    // Key is futex address, value is the FutexNode for the head of futex's blocked thread list.
-    FutexNode::HashTable futex_table_ TA_GUARDED(lock_);
+    Shard shards_[kNumShards];
 };
@@ -10,16 +10,22 @@
 #include <kernel/wait.h>
 #include <list.h>
 #include <zircon/types.h>
+#include <fbl/intrusive_double_list.h>
 #include <fbl/intrusive_hash_table.h>
 #include <fbl/mutex.h>
+#include <fbl/ref_ptr.h>
+
+class ThreadDispatcher;
 
 // Node for linked list of threads blocked on a futex
 // Intended to be embedded within a ThreadDispatcher Instance
 class FutexNode : public fbl::SinglyLinkedListable<FutexNode*> {
 public:
-    using HashTable = fbl::HashTable<uintptr_t, FutexNode*>;
+    // Each FutexContext has several of these, keep them small.
+    using HashTable = fbl::HashTable<uintptr_t, FutexNode*,
+                                     fbl::SinglyLinkedList<FutexNode*>, size_t, 13>;
 
-    FutexNode();
+    explicit FutexNode(ThreadDispatcher* thread);
     ~FutexNode();
 
     FutexNode(const FutexNode &) = delete;
@@ -44,6 +50,20 @@ public:
     // This must be called with |mutex| held and returns without |mutex| held.
     zx_status_t BlockThread(fbl::Mutex* mutex, zx_time_t deadline) TA_REL(mutex);
 
+    // Priority inheritance. While a node that names an owner is queued, it is
+    // linked on the owner's list of waiters and the owner runs at no less than
+    // the priority of its highest priority waiter. These must be called with
+    // the lock of the node's FutexContext shard held.
+    //
+    // SetPiOwner() is called on the current thread's node before it blocks.
+    void SetPiOwner(fbl::RefPtr<ThreadDispatcher> owner);
+    // Unlinks the node from its owner and returns the reference to the owner,
+    // which the caller drops once it no longer holds any spinlocks.
+    fbl::RefPtr<ThreadDispatcher> ClearPiOwner();
+    // Makes the thread of |list_head| the owner of every other priority
+    // inheriting waiter in its list. Must be called before |list_head| is woken.
+    static void TransferPiOwnership(FutexNode* list_head);
+
     void set_hash_key(uintptr_t key) {
         hash_key_ = key;
     }
@@ -60,6 +80,20 @@ private:
 
     void MarkAsNotInQueue();
 
+    void LinkToPiOwnerLocked(fbl::RefPtr<ThreadDispatcher> owner);
+    fbl::RefPtr<ThreadDispatcher> UnlinkFromPiOwnerLocked();
+    static void UpdatePiPriorityLocked(ThreadDispatcher* owner);
+
+    struct PiWaiterTraits {
+        static fbl::DoublyLinkedListNodeState<FutexNode*>& node_state(FutexNode& node) {
+            return node.pi_node_state_;
+        }
+    };
+    using PiWaiterList = fbl::DoublyLinkedList<FutexNode*, PiWaiterTraits>;
+
+    // The thread this node is embedded in.
+    ThreadDispatcher* const thread_;
+
     // hash_key_ contains the futex address.  This field has two roles:
     //  * It is used by FutexWait() to determine which queue to remove the
     //    thread from when a wait operation times out.
@@ -78,4 +112,15 @@ private:
     //  * When the thread is not waiting on a futex, queue_next_ is null.
     FutexNode* queue_prev_ = nullptr;
     FutexNode* queue_next_ = nullptr;
+
+    // The following are protected by the thread lock.
+    //
+    // The owner named by a priority inheriting wait, the priority the waiter
+    // had when it blocked, and the node state for the owner's list.
+    fbl::RefPtr<ThreadDispatcher> pi_owner_;
+    int pi_priority_ = 0;
+    fbl::DoublyLinkedListNodeState<FutexNode*> pi_node_state_;
+
+    // The waiters, on any futex, that named this node's thread as their owner.
+    PiWaiterList pi_waiters_;
 };
@@ -15,7 +15,7 @@ class VmObject;
 
 class GuestDispatcher final : public Dispatcher {
 public:
-    static zx_status_t Create(fbl::RefPtr<VmObject> physmem,
+    static zx_status_t Create(fbl::RefPtr<VmObject> physmem, uint32_t options,
                               fbl::RefPtr<Dispatcher>* dispatcher,
                               zx_rights_t* rights);
     ~GuestDispatcher();
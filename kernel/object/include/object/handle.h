@@ -12,6 +12,7 @@
 #include <fbl/macros.h>
 #include <fbl/mutex.h>
 #include <fbl/ref_ptr.h>
+#include <kernel/rcu.h>
 #include <stdint.h>
 #include <zircon/types.h>
 
@@ -76,7 +77,8 @@ private:
 };
 
 // A Handle is how a specific process refers to a specific Dispatcher.
-class Handle final : public fbl::DoublyLinkedListable<Handle*> {
+class Handle final : public fbl::DoublyLinkedListable<Handle*>,
+                     public RcuCallable<Handle> {
 public:
     // Returns the Dispatcher to which this instance points.
     const fbl::RefPtr<Dispatcher>& dispatcher() const { return dispatcher_; }
@@ -146,12 +148,17 @@ private:
     static void* Alloc(const fbl::RefPtr<Dispatcher>&, const char* what,
                        uint32_t* base_value);
     static uint32_t GetNewBaseValue(void* addr);
+    static void* AllocSlot();
+    static void FreeSlot(void* addr);
 
     // Handle should never be destroyed by anything other than Delete,
-    // which uses TearDown to do the actual destruction.
+    // which uses TearDown to do the actual destruction. Processes look
+    // handles up without a lock, so the memory is only torn down and freed
+    // by Reclaim once no such lookup can still be using it.
     ~Handle() = default;
-    void TearDown() TA_EXCL(mutex_);
+    void TearDown();
     void Delete();
+    static void Reclaim(Handle* handle);
 
     // Only HandleOwner is allowed to call Delete.
     friend class HandleOwner;
@@ -164,10 +171,17 @@ private:
     const zx_rights_t rights_;
     const uint32_t base_value_;
 
-    // The handle arena and its mutex; also guards Dispatcher::handle_count_.
+    // The handle arena and its mutex.
     static fbl::Mutex mutex_;
     static fbl::Arena TA_GUARDED(mutex_) arena_;
 
+    // Per-cpu caches of free arena slots, defined in handle.cpp.
+    struct Magazine;
+    static Magazine magazines_[SMP_MAX_CPUS];
+
+    // The number of live handles, not counting free slots in the magazines.
+    static fbl::atomic<size_t> outstanding_handles_;
+
     // NOTE! This can return an invalid pointer.
     // It must be checked against the arena bounds before being used.
     static Handle* IndexToHandle(uint32_t index) TA_NO_THREAD_SAFETY_ANALYSIS {
@@ -6,12 +6,15 @@
 
 #pragma once
 
+#include <kernel/cpu.h>
 #include <kernel/event.h>
+#include <kernel/spinlock.h>
 #include <zircon/types.h>
 #include <fbl/atomic.h>
 #include <fbl/mutex.h>
 #include <fbl/vector.h>
 #include <object/dispatcher.h>
+#include <object/port_dispatcher.h>
 #include <sys/types.h>
 
 #define SIGNAL_MASK(signal) (1ul << (signal))
@@ -30,12 +33,20 @@ public:
     zx_status_t UserSignal(uint32_t slot, zx_time_t timestamp);
     zx_status_t WaitForInterrupt(uint64_t* out_slots);
     zx_status_t GetTimeStamp(uint32_t slot, zx_time_t* out_timestamp);
+    // Restrict delivery of the interrupt bound to |slot| to the CPUs in |mask|.
+    zx_status_t SetAffinity(uint32_t slot, cpu_mask_t mask);
+
+    // Deliver interrupts as packets on |port| instead of to WaitForInterrupt().
+    // Slots reported in a packet are not unmasked until Ack() is called.
+    zx_status_t BindPort(fbl::RefPtr<PortDispatcher> port, uint64_t key);
+    zx_status_t Ack();
 
 protected:
     virtual void MaskInterrupt(uint32_t vector) = 0;
     virtual void UnmaskInterrupt(uint32_t vector) = 0;
     virtual zx_status_t RegisterInterruptHandler(uint32_t vector, void* data) = 0;
     virtual void UnregisterInterruptHandler(uint32_t vector) = 0;
+    virtual zx_status_t SetInterruptAffinity(uint32_t vector, cpu_mask_t mask) = 0;
 
     zx_status_t AddSlot(uint32_t slot, uint32_t vector, uint32_t flags) TA_REQ(lock_);
 
@@ -44,10 +55,9 @@ protected:
 
     void on_zero_handles() final;
 
-    int Signal(uint64_t signals, bool reschedule) {
-        signals_.fetch_or(signals);
-        return event_signal_etc(&event_, reschedule, ZX_OK);
-    }
+    // Returns the number of threads woken. May be called from interrupt
+    // context with |reschedule| false.
+    int Signal(uint64_t signals, bool reschedule);
 
     // slot used for canceling wait on last handle closed
     static constexpr uint64_t INTERRUPT_CANCEL_MASK = SIGNAL_MASK(63);
@@ -68,6 +78,9 @@ protected:
     fbl::Mutex lock_;
 
 private:
+    // Unmasks the interrupts reported since the last call which need it.
+    void UnmaskReportedInterrupts();
+
     // interrupts bound to this dispatcher
     fbl::Vector<Interrupt> interrupts_;
 
@@ -79,4 +92,9 @@ private:
     fbl::atomic<uint64_t> signals_;
     // the signaled slots most recently returned from WaitForInterrupt()
     fbl::atomic<uint64_t> reported_signals_;
+
+    // Set once by BindPort(); read from interrupt context.
+    SpinLock port_lock_;
+    fbl::RefPtr<PortDispatcher> port_ TA_GUARDED(port_lock_);
+    PortInterruptPacket port_packet_;
 };
@@ -95,6 +95,8 @@ public:
     // Set policy. |mode| is is either ZX_JOB_POL_RELATIVE or ZX_JOB_POL_ABSOLUTE and
     // in_policy is an array of |count| elements.
     zx_status_t SetPolicy(uint32_t mode, const zx_policy_basic* in_policy, size_t policy_count);
+    // Set the timer slack policy, with the same |mode| semantics as SetPolicy().
+    zx_status_t SetTimerSlackPolicy(uint32_t mode, const zx_policy_timer_slack& in_policy);
     pol_cookie_t GetPolicy();
 
     // Updates a partial ordering between jobs so that this job will be killed
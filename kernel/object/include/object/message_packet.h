@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include <list.h>
 #include <stdint.h>
 
 #include <lib/user_copy/user_ptr.h>
@@ -38,9 +39,13 @@ public:
 
     // Copies the packet's |data_size()| bytes to |buf|.
     // Returns an error if |buf| points to a bad user address.
-    zx_status_t CopyDataTo(user_out_ptr<void> buf) const {
-        return buf.copy_array_to_user(data(), data_size_);
-    }
+    //
+    // Payloads written from user mode that are a whole number of pages are
+    // kept in pages of their own rather than in the packet. If |buf| is page
+    // aligned and lies in a writable mapping of a paged vmo, those pages are
+    // moved into the vmo instead of being copied, so this can only be done
+    // once per packet.
+    zx_status_t CopyDataTo(user_out_ptr<void> buf);
 
     uint32_t num_handles() const { return num_handles_; }
     Handle* const* handles() const { return handles_; }
@@ -58,8 +63,11 @@ public:
         }
     }
 
+    bool is_page_backed() const { return page_backed_; }
+
 private:
-    MessagePacket(uint32_t data_size, uint32_t num_handles, Handle** handles);
+    MessagePacket(uint32_t data_size, uint32_t num_handles, Handle** handles,
+                  bool page_backed);
     ~MessagePacket();
 
     // Allocates a new packet that can hold the specified amount of
@@ -67,18 +75,32 @@ private:
     static zx_status_t NewPacket(uint32_t data_size, uint32_t num_handles,
                                  fbl::unique_ptr<MessagePacket>* msg);
 
-    // Create() uses malloc(), so we must delete using free().
-    static void operator delete(void* ptr) {
-        free(ptr);
-    }
+    // Same, but the data goes in freshly allocated pages rather than after
+    // the handles. |data_size| must be a multiple of PAGE_SIZE.
+    static zx_status_t NewPagedPacket(uint32_t data_size, uint32_t num_handles,
+                                      fbl::unique_ptr<MessagePacket>* msg);
+
+    // The page backed versions of Create() and CopyDataTo().
+    zx_status_t CopyDataFromUserToPages(user_in_ptr<const void> data);
+    zx_status_t CopyDataFromPagesToUser(user_out_ptr<void> buf);
+    bool MovePagesToUser(user_out_ptr<void> buf);
+
+    // Create() allocates from per-cpu slabs or the heap, so we must delete
+    // by handing the memory back to the right one of those.
+    static void operator delete(void* ptr);
     friend class fbl::unique_ptr<MessagePacket>;
 
     // Handles and data are stored in the same buffer: num_handles_ Handle*
-    // entries first, then the data buffer.
-    void* data() const { return static_cast<void*>(handles_ + num_handles_); }
+    // entries first, then the data buffer. For page backed packets the data
+    // is in |pages_| instead and this is the first of them.
+    void* data() const;
 
     Handle** const handles_;
     const uint32_t data_size_;
     const uint16_t num_handles_;
     bool owns_handles_;
+    bool page_backed_;
+
+    // The pages holding the data of a page backed packet, in order.
+    list_node pages_;
 };
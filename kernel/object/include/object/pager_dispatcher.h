@@ -0,0 +1,73 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <fbl/canary.h>
+#include <fbl/intrusive_double_list.h>
+#include <fbl/mutex.h>
+#include <fbl/ref_ptr.h>
+#include <object/dispatcher.h>
+#include <object/port_dispatcher.h>
+#include <vm/page_source.h>
+#include <zircon/thread_annotations.h>
+#include <zircon/types.h>
+
+#include <sys/types.h>
+
+class PagerDispatcher;
+
+// The page source of a vmo created by a pager. Requests for pages go out as
+// ZX_PKT_TYPE_PAGE_REQUEST packets on the port the vmo was created with.
+class PagerSource final : public PageSource,
+                          public fbl::DoublyLinkedListable<fbl::RefPtr<PagerSource>> {
+public:
+    PagerSource(fbl::RefPtr<PagerDispatcher> pager, fbl::RefPtr<PortDispatcher> port,
+                uint64_t key);
+
+    const PagerDispatcher* pager() const { return pager_.get(); }
+
+private:
+    ~PagerSource() final;
+    friend fbl::RefPtr<PagerSource>;
+
+    zx_status_t SendReadRequest(uint64_t offset, uint64_t len) final;
+    void OnClose() final;
+
+    zx_status_t QueuePacket(uint16_t command, uint64_t offset, uint64_t len);
+
+    const fbl::RefPtr<PagerDispatcher> pager_;
+    const fbl::RefPtr<PortDispatcher> port_;
+    const uint64_t key_;
+};
+
+class PagerDispatcher final : public Dispatcher {
+public:
+    static zx_status_t Create(uint32_t options, fbl::RefPtr<Dispatcher>* dispatcher,
+                              zx_rights_t* rights);
+
+    ~PagerDispatcher() final;
+    zx_obj_type_t get_type() const final { return ZX_OBJ_TYPE_PAGER; }
+    void on_zero_handles() final;
+
+    // Creates the source for a new vmo, whose page requests are queued on
+    // |port| with |key|.
+    zx_status_t CreateSource(fbl::RefPtr<PortDispatcher> port, uint64_t key,
+                             fbl::RefPtr<PageSource>* src);
+
+private:
+    friend PagerSource;
+
+    PagerDispatcher();
+
+    // called by a source once it's closed
+    void RemoveSource(PagerSource* src);
+
+    fbl::Canary<fbl::magic("PGRD")> canary_;
+
+    fbl::Mutex lock_;
+    fbl::DoublyLinkedList<fbl::RefPtr<PagerSource>> sources_ TA_GUARDED(lock_);
+};
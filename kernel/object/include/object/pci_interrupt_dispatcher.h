@@ -31,6 +31,7 @@ protected:
     void UnmaskInterrupt(uint32_t vector) final;
     zx_status_t RegisterInterruptHandler(uint32_t vector, void* data) final;
     void UnregisterInterruptHandler(uint32_t vector) final;
+    zx_status_t SetInterruptAffinity(uint32_t vector, cpu_mask_t mask) final;
 
 private:
     static pcie_irq_handler_retval_t IrqThunk(const PcieDevice& dev,
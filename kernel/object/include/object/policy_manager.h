@@ -13,6 +13,7 @@
 #include <fbl/ref_ptr.h>
 
 struct zx_policy_basic;
+struct zx_policy_timer_slack;
 class PortDispatcher;
 
 typedef uint64_t pol_cookie_t;
@@ -71,6 +72,17 @@ public:
     // ZX_POL_ACTION_DENY all other failure modes.
     uint32_t QueryBasicPolicy(pol_cookie_t policy, uint32_t condition);
 
+    // Creates a |new_policy| based on |existing_policy| that also carries
+    // the timer slack in |slack|, with the same |mode| semantics as
+    // AddPolicy(). The slack is kept rounded down to a power of two.
+    zx_status_t AddTimerSlack(
+        uint32_t mode, pol_cookie_t existing_policy,
+        const zx_policy_timer_slack& slack, pol_cookie_t* new_policy);
+
+    // Returns the minimum timer slack of |policy| and the ZX_TIMER_SLACK_xxx
+    // mode to apply it with; no slack if the policy doesn't set one.
+    void QueryTimerSlack(pol_cookie_t policy, zx_duration_t* slack, uint32_t* slack_mode);
+
 private:
     explicit PolicyManager(uint32_t default_action);
     ~PolicyManager() = default;
@@ -6,10 +6,12 @@
 
 #pragma once
 
+#include <kernel/spinlock.h>
 #include <object/dispatcher.h>
 #include <object/semaphore.h>
 #include <object/state_observer.h>
 
+#include <zircon/syscalls/object.h>
 #include <zircon/syscalls/port.h>
 #include <zircon/types.h>
 #include <fbl/canary.h>
@@ -105,6 +107,15 @@ struct PortPacket final : public fbl::DoublyLinkedListable<PortPacket*> {
     static size_t DiagnosticAllocationCount();
 };
 
+// A packet queued from interrupt context by an InterruptDispatcher bound to
+// a port. It is owned by the interrupt, never allocated, and is queued at
+// most once; interrupts which fire while it is queued are merged into it.
+struct PortInterruptPacket final : public fbl::DoublyLinkedListable<PortInterruptPacket*> {
+    uint64_t key = 0u;
+    uint64_t slots = 0u;
+    zx_time_t timestamp = 0;
+};
+
 // Observers are weakly contained in state trackers until |remove_| member
 // is false at the end of one of OnInitialize(), OnStateChange() or OnCancel()
 // callbacks.
@@ -150,8 +161,22 @@ public:
 
     zx_status_t Queue(PortPacket* port_packet, zx_signals_t observed, uint64_t count);
     zx_status_t QueueUser(const zx_port_packet_t& packet);
+
+    // Queues |port_packet| or, if it is already queued, adds |slots| to it.
+    // Safe to call from interrupt context. Returns the number of threads
+    // woken, for the caller to reschedule as appropriate.
+    int QueueInterrupt(PortInterruptPacket* port_packet, uint64_t slots);
+
+    // Removes |port_packet| if it is queued. Called by the owning
+    // interrupt before the packet goes away.
+    void CancelInterrupt(PortInterruptPacket* port_packet);
     zx_status_t Dequeue(zx_time_t deadline, zx_port_packet_t* packet);
 
+    // Waits like Dequeue() for at least one packet, then takes as many as
+    // are queued, up to |max_count|. Their number is returned in |count|.
+    zx_status_t DequeueMany(zx_time_t deadline, zx_port_packet_t* packets, size_t max_count,
+                            size_t* count);
+
     // Decides who is going to destroy the observer. If it returns |true| it
     // is the duty of the caller. If it is false it is the duty of the port.
     bool CanReap(PortObserver* observer, PortPacket* port_packet);
@@ -163,6 +188,8 @@ public:
     // removed from the queue.
     bool CancelQueued(const void* handle, uint64_t key);
 
+    void GetInfo(zx_info_port_t* info);
+
 private:
     friend class ExceptionPort;
 
@@ -182,5 +209,12 @@ private:
     Semaphore sema_;
     bool zero_handles_ TA_GUARDED(lock_);
     fbl::DoublyLinkedList<PortPacket*> packets_ TA_GUARDED(lock_);
+    uint64_t num_packets_ TA_GUARDED(lock_) = 0u;
+    zx_info_port_t stats_ TA_GUARDED(lock_) = {};
     fbl::DoublyLinkedList<fbl::RefPtr<ExceptionPort>> eports_ TA_GUARDED(lock_);
+
+    // Interrupt packets are queued from interrupt context, so they live on
+    // their own list under a spinlock, and are dequeued ahead of the rest.
+    SpinLock interrupt_lock_;
+    fbl::DoublyLinkedList<PortInterruptPacket*> interrupt_packets_ TA_GUARDED(interrupt_lock_);
 };
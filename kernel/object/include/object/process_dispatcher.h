@@ -9,6 +9,7 @@
 #include <kernel/event.h>
 #include <kernel/thread.h>
 #include <vm/vm_aspace.h>
+#include <vm/vm_attribution.h>
 #include <object/dispatcher.h>
 #include <object/futex_context.h>
 #include <object/handle.h>
@@ -18,6 +19,7 @@
 #include <zircon/syscalls/object.h>
 #include <zircon/types.h>
 #include <fbl/array.h>
+#include <fbl/atomic.h>
 #include <fbl/canary.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/mutex.h>
@@ -179,6 +181,9 @@ public:
     FutexContext* futex_context() { return &futex_context_; }
     State state() const;
     fbl::RefPtr<VmAspace> aspace() { return aspace_; }
+
+    // Counts the pages committed to the VMOs this process created.
+    const fbl::RefPtr<VmAttribution>& vm_attribution() const { return vm_attribution_; }
     fbl::RefPtr<JobDispatcher> job();
 
     void get_name(char out_name[ZX_MAX_NAME_LEN]) const final;
@@ -190,6 +195,10 @@ public:
     // Syscall helpers
     zx_status_t GetInfo(zx_info_process_t* info);
     zx_status_t GetStats(zx_info_task_stats_t* stats);
+
+    // A summary cheap enough to take of every process in the system at
+    // once; see ZX_INFO_JOB_PROCESS_SNAPSHOT.
+    void GetSnapshot(zx_info_process_snapshot_t* info);
     // NOTE: Code outside of the syscall layer should not typically know about
     // user_ptrs; do not use this pattern as an example.
     zx_status_t GetAspaceMaps(user_out_ptr<zx_info_maps_t> maps, size_t max,
@@ -243,6 +252,10 @@ public:
     //     // Ok to create a channel.
     zx_status_t QueryPolicy(uint32_t condition) const;
 
+    // The minimum slack the job policy applies to the timers and wait
+    // deadlines of this process, and the ZX_TIMER_SLACK_xxx mode for it.
+    void GetTimerSlack(zx_duration_t* slack, uint32_t* slack_mode) const;
+
     // return a cached copy of the vdso code address or compute a new one
     uintptr_t vdso_code_address() {
         if (unlikely(vdso_code_address_ == 0)) {
@@ -273,6 +286,11 @@ private:
                                                 fbl::RefPtr<Dispatcher>* dispatcher_out,
                                                 zx_rights_t* out_rights);
 
+    // Lock-free handle lookup. A reader may only use the Handle* it returns
+    // within an rcu read-side critical section; handles are not freed until
+    // every reader that could have seen them has left its own.
+    Handle* LookupHandle(zx_handle_t handle_value);
+
     // Thread lifecycle support
     friend class ThreadDispatcher;
     zx_status_t AddThread(ThreadDispatcher* t, bool initial_thread);
@@ -303,9 +321,15 @@ private:
     using ThreadList = fbl::DoublyLinkedList<ThreadDispatcher*, ThreadDispatcher::ThreadListTraits>;
     ThreadList thread_list_ TA_GUARDED(state_lock_);
 
+    // the time spent running by threads no longer in |thread_list_|
+    zx_duration_t exited_threads_runtime_ TA_GUARDED(state_lock_) = 0;
+
     // our address space
     fbl::RefPtr<VmAspace> aspace_;
 
+    // counts the pages of the VMOs we create
+    fbl::RefPtr<VmAttribution> vm_attribution_;
+
     // our list of handles
     mutable fbl::Mutex handle_table_lock_; // protects |handles_|.
     fbl::DoublyLinkedList<Handle*> handles_ TA_GUARDED(handle_table_lock_);
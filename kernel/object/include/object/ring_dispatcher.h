@@ -0,0 +1,63 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <stdint.h>
+
+#include <fbl/canary.h>
+#include <fbl/mutex.h>
+#include <fbl/ref_ptr.h>
+#include <object/dispatcher.h>
+#include <vm/vm_object.h>
+#include <zircon/syscalls/ring.h>
+#include <zircon/thread_annotations.h>
+#include <zircon/types.h>
+
+// A pair of queues shared with userspace: operations are submitted into one
+// and their results come back in the other. The kernel only looks at the
+// queues when the owner calls zx_ring_enter(), and runs the operations in
+// that thread, so one system call carries a whole batch of them.
+class RingDispatcher final : public Dispatcher {
+public:
+    // Runs one submission and returns the status to complete it with.
+    using ExecuteFn = zx_status_t (*)(const zx_ring_sqe_t& sqe);
+
+    static zx_status_t Create(uint32_t options, fbl::RefPtr<Dispatcher>* dispatcher,
+                              zx_rights_t* rights, fbl::RefPtr<VmObject>* vmo);
+
+    ~RingDispatcher() final;
+    zx_obj_type_t get_type() const final { return ZX_OBJ_TYPE_RING; }
+    bool has_state_tracker() const final { return true; }
+
+    // Takes up to |count| submissions off the ring, runs each one with
+    // |execute| and posts its completion. Stops early once the submission
+    // queue is empty or the completion queue is full. |actual| gets the
+    // number of submissions taken.
+    zx_status_t Enter(uint32_t count, ExecuteFn execute, uint32_t* actual);
+
+private:
+    // |sq| and |cq| point at the queue headers and |sqes| and |cqes| at the
+    // entries, all physmap addresses within |vmo|, which the caller has
+    // pinned on behalf of the ring.
+    RingDispatcher(fbl::RefPtr<VmObject> vmo, zx_ring_queue_t* sq, zx_ring_queue_t* cq,
+                   zx_ring_sqe_t* sqes, zx_ring_cqe_t* cqes);
+
+    fbl::Canary<fbl::magic("RING")> canary_;
+
+    const fbl::RefPtr<VmObject> vmo_;
+    zx_ring_queue_t* const sq_;
+    zx_ring_queue_t* const cq_;
+    zx_ring_sqe_t* const sqes_;
+    zx_ring_cqe_t* const cqes_;
+
+    // Serializes callers of Enter(). Only the kernel advances the tail of
+    // the submission queue and the head of the completion queue, so those
+    // are kept here rather than trusted from the shared pages.
+    fbl::Mutex enter_lock_;
+    uint32_t sq_tail_ TA_GUARDED(enter_lock_) = 0;
+    uint32_t cq_head_ TA_GUARDED(enter_lock_) = 0;
+};
@@ -13,7 +13,9 @@
 // You probably don't want to use this class.
 class Semaphore {
 public:
-    explicit Semaphore(int64_t initial_count = 0);
+    // If |lifo| is true Post() wakes the most recent waiter rather than the
+    // one that has waited longest.
+    explicit Semaphore(int64_t initial_count = 0, bool lifo = false);
     ~Semaphore();
 
     Semaphore(const Semaphore&) = delete;
@@ -28,5 +30,6 @@ public:
 
 private:
     int64_t count_;
+    const bool lifo_;
     wait_queue_t waitq_;
 };
@@ -12,6 +12,7 @@
 #include <object/dispatcher.h>
 #include <object/handle.h>
 #include <object/mbuf.h>
+#include <object/socket_ring.h>
 
 #include <zircon/types.h>
 #include <fbl/canary.h>
@@ -59,26 +60,51 @@ public:
 
     zx_status_t CheckShareable(SocketDispatcher* to_send);
 
+    // For ZX_SOCKET_RING sockets, returns the shared ring vmo and the index
+    // of the ring this endpoint writes.
+    zx_status_t GetRing(fbl::RefPtr<VmObject>* vmo, uint32_t* index);
+
+    // For ZX_SOCKET_RING sockets, recomputes the readable and writable
+    // signals of both endpoints from the state of the rings, after userspace
+    // has moved data through the mapped vmo.
+    zx_status_t RingUpdate();
+
 private:
     // The control_msg must be either nullptr or an allocation of
     // size kControlMsgSize.
     SocketDispatcher(zx_signals_t starting_signals, uint32_t flags,
-                     fbl::unique_ptr<char[]> control_msg);
+                     fbl::unique_ptr<char[]> control_msg,
+                     fbl::RefPtr<SocketRing> ring, uint32_t ring_rx);
     void Init(fbl::RefPtr<SocketDispatcher> other);
+    void RingUpdateSelf();
     zx_status_t WriteSelf(user_in_ptr<const void> src, size_t len, size_t* nwritten);
     zx_status_t WriteControlSelf(user_in_ptr<const void> src, size_t len);
     zx_status_t UserSignalSelf(uint32_t clear_mask, uint32_t set_mask);
     zx_status_t ShutdownOther(uint32_t how);
     zx_status_t ShareSelf(Handle* h);
 
-    bool is_full() const TA_REQ(lock_) { return data_.is_full(); }
-    bool is_empty() const TA_REQ(lock_) { return data_.is_empty(); }
+    // These describe the data waiting to be read from this endpoint: the
+    // mbuf chain, or for ring sockets the ring written by the peer.
+    bool is_full() const TA_REQ(lock_) {
+        return ring_ ? ring_->WritableBytes(ring_rx_) == 0 : data_.is_full();
+    }
+    bool is_empty() const TA_REQ(lock_) {
+        return ring_ ? ring_->ReadableBytes(ring_rx_) == 0 : data_.is_empty();
+    }
+    size_t size() const TA_REQ(lock_) {
+        return ring_ ? ring_->ReadableBytes(ring_rx_) : data_.size();
+    }
 
     fbl::Canary<fbl::magic("SOCK")> canary_;
 
     uint32_t flags_;
     zx_koid_t peer_koid_;
 
+    // Shared by both endpoints of a ZX_SOCKET_RING socket. This endpoint
+    // reads ring |ring_rx_| and its peer writes it.
+    const fbl::RefPtr<SocketRing> ring_;
+    const uint32_t ring_rx_;
+
     // The |lock_| protects all members below.
     fbl::Mutex lock_;
     MBufChain data_ TA_GUARDED(lock_);
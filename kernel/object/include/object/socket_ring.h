@@ -0,0 +1,53 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <stdint.h>
+
+#include <lib/user_copy/user_ptr.h>
+#include <vm/vm_object.h>
+
+#include <zircon/syscalls/socket.h>
+#include <zircon/types.h>
+#include <fbl/ref_counted.h>
+#include <fbl/ref_ptr.h>
+
+// The pair of byte rings shared by both endpoints of a ZX_SOCKET_RING socket,
+// laid out as described in <zircon/syscalls/socket.h>.
+//
+// The whole vmo is committed and pinned for the life of the socket so the
+// headers can be accessed through the physmap and userspace cannot decommit
+// or shrink the data out from under the kernel. Everything in the vmo is
+// writable by userspace, so the indices are treated as untrusted: a ring whose
+// head and tail are further apart than its size reads as full to writers and
+// as holding ZX_SOCKET_RING_SIZE bytes to readers, and all copies stay within
+// the ring's data area.
+class SocketRing final : public fbl::RefCounted<SocketRing> {
+public:
+    static zx_status_t Create(fbl::RefPtr<SocketRing>* ring);
+
+    ~SocketRing();
+
+    const fbl::RefPtr<VmObject>& vmo() const { return vmo_; }
+
+    // Bytes that can be read from, or written to, ring |index|.
+    size_t ReadableBytes(uint32_t index) const;
+    size_t WritableBytes(uint32_t index) const;
+
+    // Copies up to |len| bytes between userspace and ring |index|, advancing
+    // the ring's head or tail by the amount copied.
+    zx_status_t Write(uint32_t index, user_in_ptr<const void> src, size_t len, size_t* written);
+    zx_status_t Read(uint32_t index, user_out_ptr<void> dst, size_t len, size_t* nread);
+
+private:
+    SocketRing(fbl::RefPtr<VmObject> vmo, zx_socket_ring_t* headers);
+
+    zx_socket_ring_t* header(uint32_t index) const { return &headers_[index & 1]; }
+
+    fbl::RefPtr<VmObject> vmo_;
+    zx_socket_ring_t* headers_;
+};
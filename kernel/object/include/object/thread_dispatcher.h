@@ -88,6 +88,10 @@ public:
         return reinterpret_cast<ThreadDispatcher*>(get_current_thread()->user_thread);
     }
 
+    // Frees the kernel stacks cached for reuse by new threads, returning how
+    // many were freed.
+    static size_t TrimStackCache();
+
     // Dispatcher implementation.
     zx_obj_type_t get_type() const final { return ZX_OBJ_TYPE_THREAD; }
     bool has_state_tracker() const final { return true; }
@@ -104,10 +108,20 @@ public:
     zx_status_t Suspend();
     zx_status_t Resume();
 
+    // Place the thread in (or, with a zero |capacity|, remove it from) the
+    // kernel's deadline scheduling class.
+    zx_status_t SetDeadline(zx_duration_t capacity, zx_duration_t deadline, zx_duration_t period);
+
+    // The wakeup latency the thread tolerates from an idle cpu, see
+    // thread_set_idle_latency().
+    zx_status_t SetIdleLatency(zx_duration_t latency);
+    zx_duration_t idle_latency() const { return thread_.idle_latency; }
+
     // accessors
     ProcessDispatcher* process() const { return process_.get(); }
 
     FutexNode* futex_node() { return &futex_node_; }
+    thread_t* thread() { return &thread_; }
     zx_status_t set_name(const char* name, size_t len) final;
     void get_name(char out_name[ZX_MAX_NAME_LEN]) const final;
     uint64_t runtime_ns() const { return thread_runtime(&thread_); }
@@ -201,7 +215,7 @@ private:
     fbl::Mutex state_lock_;
 
     // Node for linked list of threads blocked on a futex
-    FutexNode futex_node_;
+    FutexNode futex_node_{this};
 
     // A thread-level exception port for this thread.
     fbl::RefPtr<ExceptionPort> exception_port_ TA_GUARDED(state_lock_);
@@ -216,7 +230,7 @@ private:
         EVENT_INITIAL_VALUE(exception_event_, false, EVENT_FLAG_AUTOUNSIGNAL);
 
     // cleanup dpc structure
-    dpc_t cleanup_dpc_ = {LIST_INITIAL_CLEARED_VALUE, nullptr, nullptr};
+    dpc_t cleanup_dpc_ = {nullptr, 0, nullptr, nullptr};
 
     // Used to protect thread name read/writes
     mutable SpinLock name_lock_;
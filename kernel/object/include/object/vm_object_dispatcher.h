@@ -8,6 +8,7 @@
 
 #include <zircon/types.h>
 #include <fbl/canary.h>
+#include <iovec.h>
 #include <object/dispatcher.h>
 
 #include <lib/user_copy/user_ptr.h>
@@ -33,6 +34,8 @@ public:
                      uint64_t offset, size_t* actual);
     zx_status_t Write(user_in_ptr<const void> user_data, size_t length,
                       uint64_t offset, size_t* actual);
+    zx_status_t ReadVector(const iovec_t* vec, size_t count, uint64_t offset, size_t* actual);
+    zx_status_t WriteVector(const iovec_t* vec, size_t count, uint64_t offset, size_t* actual);
     zx_status_t SetSize(uint64_t);
     zx_status_t GetSize(uint64_t* size);
     zx_status_t RangeOp(uint32_t op, uint64_t offset, uint64_t size, user_inout_ptr<void> buffer,
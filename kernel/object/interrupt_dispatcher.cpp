@@ -7,6 +7,8 @@
 #include <object/interrupt_dispatcher.h>
 
 #include <fbl/auto_lock.h>
+#include <kernel/auto_lock.h>
+#include <kernel/thread.h>
 
 InterruptDispatcher::InterruptDispatcher() : signals_(0) {
     event_init(&event_, false, EVENT_FLAG_AUTOUNSIGNAL);
@@ -52,7 +54,74 @@ zx_status_t InterruptDispatcher::AddSlot(uint32_t slot, uint32_t vector, uint32_
     return ZX_OK;
 }
 
+void InterruptDispatcher::UnmaskReportedInterrupts() {
+    uint64_t last_signals = reported_signals_.exchange(0);
+    for (auto& interrupt : interrupts_) {
+        if ((interrupt.flags & INTERRUPT_UNMASK_PREWAIT) &&
+                (last_signals & (SIGNAL_MASK(interrupt.slot)))) {
+            UnmaskInterrupt(interrupt.vector);
+        }
+    }
+}
+
+int InterruptDispatcher::Signal(uint64_t signals, bool reschedule) {
+    int wake_count;
+    {
+        AutoSpinLockIrqSave guard(&port_lock_);
+        if (!port_) {
+            guard.release();
+            signals_.fetch_or(signals);
+            return event_signal_etc(&event_, reschedule, ZX_OK);
+        }
+
+        // Once queued, the slots count as reported; Ack() unmasks them.
+        reported_signals_.fetch_or(signals);
+        wake_count = port_->QueueInterrupt(&port_packet_, signals);
+    }
+    if (reschedule && wake_count)
+        thread_reschedule();
+    return wake_count;
+}
+
+zx_status_t InterruptDispatcher::BindPort(fbl::RefPtr<PortDispatcher> port, uint64_t key) {
+    uint64_t pending;
+    int wake_count;
+    {
+        AutoSpinLockIrqSave guard(&port_lock_);
+        if (port_)
+            return ZX_ERR_ALREADY_BOUND;
+        port_packet_.key = key;
+        port_ = fbl::move(port);
+
+        // Anything which fired before the port was bound goes out now.
+        pending = signals_.exchange(0) & ~INTERRUPT_CANCEL_MASK;
+        if (!pending)
+            return ZX_OK;
+        reported_signals_.fetch_or(pending);
+        wake_count = port_->QueueInterrupt(&port_packet_, pending);
+    }
+    if (wake_count)
+        thread_reschedule();
+    return ZX_OK;
+}
+
+zx_status_t InterruptDispatcher::Ack() {
+    {
+        AutoSpinLockIrqSave guard(&port_lock_);
+        if (!port_)
+            return ZX_ERR_BAD_STATE;
+    }
+    UnmaskReportedInterrupts();
+    return ZX_OK;
+}
+
 zx_status_t InterruptDispatcher::WaitForInterrupt(uint64_t* out_slots) {
+    {
+        AutoSpinLockIrqSave guard(&port_lock_);
+        if (port_)
+            return ZX_ERR_BAD_STATE;
+    }
+
     while (true) {
         uint64_t signals = signals_.exchange(0);
         if (signals) {
@@ -70,13 +139,7 @@ zx_status_t InterruptDispatcher::WaitForInterrupt(uint64_t* out_slots) {
             return ZX_OK;
         }
 
-        uint64_t last_signals = reported_signals_.exchange(0);
-        for (auto& interrupt : interrupts_) {
-            if ((interrupt.flags & INTERRUPT_UNMASK_PREWAIT) &&
-                    (last_signals & (SIGNAL_MASK(interrupt.slot)))) {
-                UnmaskInterrupt(interrupt.vector);
-            }
-        }
+        UnmaskReportedInterrupts();
 
         zx_status_t status = event_wait_deadline(&event_, ZX_TIME_INFINITE, true);
         if (status != ZX_OK) {
@@ -123,6 +186,23 @@ zx_status_t InterruptDispatcher::UserSignal(uint32_t slot, zx_time_t timestamp)
     return ZX_OK;
 }
 
+zx_status_t InterruptDispatcher::SetAffinity(uint32_t slot, cpu_mask_t mask) {
+    if (slot > ZX_INTERRUPT_MAX_SLOTS)
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::AutoLock lock(&lock_);
+
+    uint8_t index = slot_map_[slot];
+    if (index == 0xff)
+        return ZX_ERR_NOT_FOUND;
+
+    Interrupt& interrupt = interrupts_[index];
+    if (interrupt.flags & INTERRUPT_VIRTUAL)
+        return ZX_ERR_BAD_STATE;
+
+    return SetInterruptAffinity(interrupt.vector, mask);
+}
+
 void InterruptDispatcher::on_zero_handles() {
     for (const auto& interrupt : interrupts_) {
         if (!(interrupt.flags & INTERRUPT_VIRTUAL)) {
@@ -131,5 +211,15 @@ void InterruptDispatcher::on_zero_handles() {
         }
     }
 
+    // With the handlers gone nothing can queue the packet again, so it can be
+    // pulled back from the port.
+    fbl::RefPtr<PortDispatcher> port;
+    {
+        AutoSpinLockIrqSave guard(&port_lock_);
+        port = fbl::move(port_);
+    }
+    if (port)
+        port->CancelInterrupt(&port_packet_);
+
     Signal(INTERRUPT_CANCEL_MASK, true);
 }
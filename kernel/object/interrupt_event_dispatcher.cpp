@@ -149,3 +149,7 @@ zx_status_t InterruptEventDispatcher::RegisterInterruptHandler(uint32_t vector,
 void InterruptEventDispatcher::UnregisterInterruptHandler(uint32_t vector) {
     register_int_handler(vector, nullptr, nullptr);
 }
+
+zx_status_t InterruptEventDispatcher::SetInterruptAffinity(uint32_t vector, cpu_mask_t mask) {
+    return set_interrupt_affinity(vector, mask);
+}
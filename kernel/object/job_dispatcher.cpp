@@ -359,6 +359,24 @@ zx_status_t JobDispatcher::SetPolicy(
     return ZX_OK;
 }
 
+zx_status_t JobDispatcher::SetTimerSlackPolicy(
+    uint32_t mode, const zx_policy_timer_slack& in_policy) {
+    // Can't set policy when there are active processes or jobs.
+    AutoLock lock(&lock_);
+
+    if (!procs_.is_empty() || !jobs_.is_empty())
+        return ZX_ERR_BAD_STATE;
+
+    pol_cookie_t new_policy;
+    auto status = GetSystemPolicyManager()->AddTimerSlack(mode, policy_, in_policy, &new_policy);
+
+    if (status < 0)
+        return status;
+
+    policy_ = new_policy;
+    return ZX_OK;
+}
+
 bool JobDispatcher::EnumerateChildren(JobEnumerator* je, bool recurse) {
     canary_.Assert();
 
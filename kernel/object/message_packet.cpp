@@ -10,8 +10,128 @@
 #include <stdint.h>
 #include <string.h>
 
+#include <arch/ops.h>
+#include <kernel/stats.h>
+#include <lib/counters.h>
+#include <vm/physmap.h>
+#include <vm/pmm.h>
+#include <vm/vm_address_region.h>
+#include <vm/vm_aspace.h>
+#include <vm/vm_object.h>
 #include <zxcpp/new.h>
 #include <object/handle.h>
+#include <object/process_dispatcher.h>
+
+#include <fbl/mutex.h>
+#include <fbl/slab_allocator.h>
+
+KCOUNTER(channel_pages_moved, "kernel.channel.pages_moved");
+KCOUNTER(channel_pages_copied, "kernel.channel.pages_copied");
+
+namespace {
+
+// Most messages are small, so rather than taking the heap lock for each
+// one, packets that fit are carved out of per-cpu slabs of fixed size
+// buffers. A tag in front of the MessagePacket records where the memory
+// came from, and the packet goes back to the allocator of the cpu it was
+// allocated on, whichever cpu frees it. Each cpu is limited to
+// kMaxSlabsPerCpu slabs per size class, past that packets come from the
+// heap again.
+constexpr size_t kMaxSlabsPerCpu = 8;
+
+template <size_t kSize> struct PacketBuffer;
+
+template <size_t kSize>
+using PacketBufferTraits = fbl::ManualDeleteSlabAllocatorTraits<PacketBuffer<kSize>*>;
+
+template <size_t kSize>
+struct PacketBuffer : public fbl::SlabAllocated<PacketBufferTraits<kSize>> {
+    alignas(8) char storage[kSize];
+};
+
+using SmallPacketBuffer = PacketBuffer<256>;
+using MediumPacketBuffer = PacketBuffer<512>;
+static_assert(sizeof(SmallPacketBuffer) == 256, "");
+static_assert(sizeof(MediumPacketBuffer) == 512, "");
+
+enum class PacketSource : uint16_t {
+    kHeap,
+    kSmallSlab,
+    kMediumSlab,
+};
+
+struct PacketTag {
+    PacketSource source;
+    uint16_t cpu;
+    uint32_t reserved;
+};
+static_assert(sizeof(PacketTag) % alignof(void*) == 0, "");
+
+struct PacketCache {
+    fbl::SlabAllocator<PacketBufferTraits<256>> small{kMaxSlabsPerCpu};
+    fbl::SlabAllocator<PacketBufferTraits<512>> medium{kMaxSlabsPerCpu};
+};
+
+PacketCache packet_cache[SMP_MAX_CPUS];
+
+// Returns storage for |size| bytes that must be released with
+// FreePacketStorage().
+void* AllocPacketStorage(size_t size) {
+    size += sizeof(PacketTag);
+
+    // It does not matter if we migrate after this, the tag remembers which
+    // allocator to go back to.
+    cpu_num_t cpu = arch_curr_cpu_num();
+
+    void* mem = nullptr;
+    PacketSource source = PacketSource::kHeap;
+    if (size <= sizeof(SmallPacketBuffer)) {
+        SmallPacketBuffer* buffer = packet_cache[cpu].small.New();
+        if (buffer) {
+            mem = buffer->storage;
+            source = PacketSource::kSmallSlab;
+        }
+    } else if (size <= sizeof(MediumPacketBuffer)) {
+        MediumPacketBuffer* buffer = packet_cache[cpu].medium.New();
+        if (buffer) {
+            mem = buffer->storage;
+            source = PacketSource::kMediumSlab;
+        }
+    }
+
+    if (mem) {
+        CPU_STATS_INC(channel_msg_cache_hits);
+    } else {
+        CPU_STATS_INC(channel_msg_cache_misses);
+        mem = malloc(size);
+        if (mem == nullptr)
+            return nullptr;
+    }
+
+    PacketTag* tag = static_cast<PacketTag*>(mem);
+    tag->source = source;
+    tag->cpu = static_cast<uint16_t>(cpu);
+    return tag + 1;
+}
+
+void FreePacketStorage(void* ptr) {
+    PacketTag* tag = static_cast<PacketTag*>(ptr) - 1;
+
+    // The buffers have no other members, so the storage is the buffer.
+    switch (tag->source) {
+    case PacketSource::kSmallSlab:
+        packet_cache[tag->cpu].small.Delete(reinterpret_cast<SmallPacketBuffer*>(tag));
+        break;
+    case PacketSource::kMediumSlab:
+        packet_cache[tag->cpu].medium.Delete(reinterpret_cast<MediumPacketBuffer*>(tag));
+        break;
+    case PacketSource::kHeap:
+        free(tag);
+        break;
+    }
+}
+
+} // namespace
 
 // static
 zx_status_t MessagePacket::NewPacket(uint32_t data_size, uint32_t num_handles,
@@ -25,12 +145,12 @@ zx_status_t MessagePacket::NewPacket(uint32_t data_size, uint32_t num_handles,
 
     // Allocate space for the MessagePacket object followed by num_handles
     // Handle*s followed by data_size bytes.
-    // TODO(dbort): Use mbuf-style memory for data_size, ideally allocating from
+    // TODO(dbort): Use mbuf-style memory for large data_size, allocating from
     // somewhere other than the heap. Lets us better track and isolate channel
     // memory usage.
-    char* ptr = static_cast<char*>(malloc(sizeof(MessagePacket) +
-                                          num_handles * sizeof(Handle*) +
-                                          data_size));
+    char* ptr = static_cast<char*>(AllocPacketStorage(sizeof(MessagePacket) +
+                                                      num_handles * sizeof(Handle*) +
+                                                      data_size));
     if (ptr == nullptr) {
         return ZX_ERR_NO_MEMORY;
     }
@@ -41,14 +161,130 @@ zx_status_t MessagePacket::NewPacket(uint32_t data_size, uint32_t num_handles,
     // of the object.
     msg->reset(new (ptr) MessagePacket(
         data_size, num_handles,
-        reinterpret_cast<Handle**>(ptr + sizeof(MessagePacket))));
+        reinterpret_cast<Handle**>(ptr + sizeof(MessagePacket)), false));
     return ZX_OK;
 }
 
+// static
+zx_status_t MessagePacket::NewPagedPacket(uint32_t data_size, uint32_t num_handles,
+                                          fbl::unique_ptr<MessagePacket>* msg) {
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(data_size));
+    if (data_size > kMaxMessageSize || num_handles > kMaxMessageHandles) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    // Only the MessagePacket and the handles live in the packet storage.
+    char* ptr = static_cast<char*>(AllocPacketStorage(sizeof(MessagePacket) +
+                                                      num_handles * sizeof(Handle*)));
+    if (ptr == nullptr) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    msg->reset(new (ptr) MessagePacket(
+        data_size, num_handles,
+        reinterpret_cast<Handle**>(ptr + sizeof(MessagePacket)), true));
+
+    // The pages are completely overwritten by the caller, so there is no
+    // need to zero them.
+    const size_t count = data_size / PAGE_SIZE;
+    if (pmm_alloc_pages(count, PMM_ALLOC_FLAG_ANY, &(*msg)->pages_) != count) {
+        msg->reset();
+        return ZX_ERR_NO_MEMORY;
+    }
+    return ZX_OK;
+}
+
+zx_status_t MessagePacket::CopyDataFromUserToPages(user_in_ptr<const void> data) {
+    size_t offset = 0;
+    vm_page_t* p;
+    list_for_every_entry(&pages_, p, vm_page_t, free.node) {
+        void* dst = paddr_to_physmap(vm_page_to_paddr(p));
+        if (data.byte_offset(offset).copy_array_from_user(dst, PAGE_SIZE) != ZX_OK) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        offset += PAGE_SIZE;
+    }
+    return ZX_OK;
+}
+
+zx_status_t MessagePacket::CopyDataFromPagesToUser(user_out_ptr<void> buf) {
+    // Pages that were already moved out are at the front of the payload.
+    const size_t remaining = list_length(&pages_);
+    size_t offset = data_size_ - remaining * PAGE_SIZE;
+    kcounter_add(channel_pages_copied, remaining);
+
+    vm_page_t* p;
+    list_for_every_entry(&pages_, p, vm_page_t, free.node) {
+        const void* src = paddr_to_physmap(vm_page_to_paddr(p));
+        if (buf.byte_offset(offset).copy_array_to_user(src, PAGE_SIZE) != ZX_OK) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        offset += PAGE_SIZE;
+    }
+    return ZX_OK;
+}
+
+bool MessagePacket::MovePagesToUser(user_out_ptr<void> buf) {
+    const vaddr_t va = reinterpret_cast<vaddr_t>(buf.get());
+    if (!IS_PAGE_ALIGNED(va)) {
+        return false;
+    }
+
+    auto region = ProcessDispatcher::GetCurrent()->aspace()->FindRegion(va);
+    if (!region) {
+        return false;
+    }
+    auto mapping = region->as_vm_mapping();
+    if (!mapping) {
+        return false;
+    }
+
+    // Moving the pages in is the same as the receiver writing them through
+    // this mapping, which checks that it is allowed to under the aspace
+    // lock. The mapping may have been unmapped since it was found.
+    const size_t count = data_size_ / PAGE_SIZE;
+    const zx_status_t status = mapping->ReplacePages(va, &pages_, count);
+    kcounter_add(channel_pages_moved, count - list_length(&pages_));
+    return status == ZX_OK;
+}
+
+zx_status_t MessagePacket::CopyDataTo(user_out_ptr<void> buf) {
+    if (!page_backed_) {
+        return buf.copy_array_to_user(data(), data_size_);
+    }
+
+    // Whatever could not be moved is copied.
+    if (MovePagesToUser(buf)) {
+        return ZX_OK;
+    }
+    return CopyDataFromPagesToUser(buf);
+}
+
+void* MessagePacket::data() const {
+    if (page_backed_) {
+        auto pages = const_cast<list_node*>(&pages_);
+        vm_page_t* p = list_peek_head_type(pages, vm_page_t, free.node);
+        return p ? paddr_to_physmap(vm_page_to_paddr(p)) : nullptr;
+    }
+    return static_cast<void*>(handles_ + num_handles_);
+}
+
 // static
 zx_status_t MessagePacket::Create(user_in_ptr<const void> data, uint32_t data_size,
                                   uint32_t num_handles,
                                   fbl::unique_ptr<MessagePacket>* msg) {
+    // Payloads of whole pages are put in pages of their own, which the
+    // reader may be able to take as they are. If we are short on pages
+    // they go in the packet like everything else.
+    if (data_size > 0u && IS_PAGE_ALIGNED(data_size) &&
+        NewPagedPacket(data_size, num_handles, msg) == ZX_OK) {
+        if ((*msg)->CopyDataFromUserToPages(data) != ZX_OK) {
+            msg->reset();
+            return ZX_ERR_INVALID_ARGS;
+        }
+        return ZX_OK;
+    }
+
     zx_status_t status = NewPacket(data_size, num_handles, msg);
     if (status != ZX_OK) {
         return status;
@@ -76,6 +312,11 @@ zx_status_t MessagePacket::Create(const void* data, uint32_t data_size,
     return ZX_OK;
 }
 
+// static
+void MessagePacket::operator delete(void* ptr) {
+    FreePacketStorage(ptr);
+}
+
 MessagePacket::~MessagePacket() {
     if (owns_handles_) {
         for (size_t ix = 0; ix != num_handles_; ++ix) {
@@ -83,11 +324,16 @@ MessagePacket::~MessagePacket() {
             HandleOwner ho(handles_[ix]);
         }
     }
+    if (page_backed_ && !list_is_empty(&pages_)) {
+        pmm_free(&pages_);
+    }
 }
 
 MessagePacket::MessagePacket(uint32_t data_size,
-                             uint32_t num_handles, Handle** handles)
+                             uint32_t num_handles, Handle** handles, bool page_backed)
     : handles_(handles), data_size_(data_size),
       // NewPacket ensures that num_handles fits in 16 bits.
-      num_handles_(static_cast<uint16_t>(num_handles)), owns_handles_(false) {
+      num_handles_(static_cast<uint16_t>(num_handles)), owns_handles_(false),
+      page_backed_(page_backed) {
+    list_initialize(&pages_);
 }
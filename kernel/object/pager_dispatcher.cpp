@@ -0,0 +1,127 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <object/pager_dispatcher.h>
+
+#include <err.h>
+#include <inttypes.h>
+#include <trace.h>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/auto_lock.h>
+#include <zircon/rights.h>
+#include <zircon/syscalls/port.h>
+
+#define LOCAL_TRACE 0
+
+using fbl::AutoLock;
+
+PagerSource::PagerSource(fbl::RefPtr<PagerDispatcher> pager, fbl::RefPtr<PortDispatcher> port,
+                         uint64_t key)
+    : pager_(fbl::move(pager)), port_(fbl::move(port)), key_(key) {
+    LTRACEF("%p key %#" PRIx64 "\n", this, key_);
+}
+
+PagerSource::~PagerSource() {
+    LTRACEF("%p\n", this);
+    DEBUG_ASSERT(!InContainer());
+}
+
+zx_status_t PagerSource::QueuePacket(uint16_t command, uint64_t offset, uint64_t len) {
+    auto port_packet = PortDispatcher::DefaultPortAllocator()->Alloc();
+    if (!port_packet)
+        return ZX_ERR_NO_MEMORY;
+
+    port_packet->packet.key = key_;
+    port_packet->packet.type = ZX_PKT_TYPE_PAGE_REQUEST;
+    port_packet->packet.status = ZX_OK;
+    port_packet->packet.page_request.command = command;
+    port_packet->packet.page_request.flags = 0;
+    port_packet->packet.page_request.reserved0 = 0;
+    port_packet->packet.page_request.offset = offset;
+    port_packet->packet.page_request.length = len;
+    port_packet->packet.page_request.reserved1 = 0;
+
+    zx_status_t status = port_->Queue(port_packet, 0u, 0u);
+    if (status != ZX_OK)
+        port_packet->Free();
+    return status;
+}
+
+zx_status_t PagerSource::SendReadRequest(uint64_t offset, uint64_t len) {
+    LTRACEF("%p offset %#" PRIx64 " len %#" PRIx64 "\n", this, offset, len);
+    return QueuePacket(ZX_PAGER_VMO_READ, offset, len);
+}
+
+void PagerSource::OnClose() {
+    LTRACEF("%p\n", this);
+
+    // let the pager know it can forget about the vmo. nothing is waiting on
+    // this, so if the packet can't be queued there is nobody to tell either.
+    QueuePacket(ZX_PAGER_VMO_COMPLETE, 0, 0);
+
+    pager_->RemoveSource(this);
+}
+
+zx_status_t PagerDispatcher::Create(uint32_t options, fbl::RefPtr<Dispatcher>* dispatcher,
+                                    zx_rights_t* rights) {
+    if (options != 0)
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::AllocChecker ac;
+    auto disp = new (&ac) PagerDispatcher();
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    *rights = ZX_DEFAULT_PAGER_RIGHTS;
+    *dispatcher = fbl::AdoptRef<Dispatcher>(disp);
+    return ZX_OK;
+}
+
+PagerDispatcher::PagerDispatcher() {}
+
+PagerDispatcher::~PagerDispatcher() {
+    DEBUG_ASSERT(sources_.is_empty());
+}
+
+zx_status_t PagerDispatcher::CreateSource(fbl::RefPtr<PortDispatcher> port, uint64_t key,
+                                          fbl::RefPtr<PageSource>* src) {
+    canary_.Assert();
+
+    fbl::AllocChecker ac;
+    auto source = fbl::AdoptRef(new (&ac) PagerSource(fbl::WrapRefPtr(this), fbl::move(port), key));
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    AutoLock lock(&lock_);
+    sources_.push_back(source);
+    *src = fbl::move(source);
+    return ZX_OK;
+}
+
+void PagerDispatcher::RemoveSource(PagerSource* src) {
+    AutoLock lock(&lock_);
+    if (src->InContainer())
+        sources_.erase(*src);
+}
+
+void PagerDispatcher::on_zero_handles() {
+    canary_.Assert();
+
+    // nobody is left to supply pages, so fail everything that is waiting on
+    // them. the sources call back into RemoveSource() as they close, so close
+    // them without holding the lock.
+    for (;;) {
+        fbl::RefPtr<PagerSource> source;
+        {
+            AutoLock lock(&lock_);
+            if (sources_.is_empty())
+                break;
+            source = sources_.pop_front();
+        }
+        source->Close();
+    }
+}
@@ -9,6 +9,7 @@
 #include <object/pci_device_dispatcher.h>
 
 #include <kernel/auto_lock.h>
+#include <lk/init.h>
 #include <zircon/rights.h>
 #include <object/pci_interrupt_dispatcher.h>
 #include <object/process_dispatcher.h>
@@ -26,6 +27,9 @@ zx_status_t PciDeviceDispatcher::Create(uint32_t                  index,
                                         zx_pcie_device_info_t*    out_info,
                                         fbl::RefPtr<Dispatcher>* out_dispatcher,
                                         zx_rights_t*              out_rights) {
+    // The bus driver is set up by an async init hook.
+    lk_init_wait_async();
+
     auto bus_drv = PcieBusDriver::GetDriver();
     if (bus_drv == nullptr)
         return ZX_ERR_BAD_STATE;
@@ -121,4 +121,8 @@ void PciInterruptDispatcher::UnregisterInterruptHandler(uint32_t vector) {
     device_->RegisterIrqHandler(vector, nullptr, nullptr);
 }
 
+zx_status_t PciInterruptDispatcher::SetInterruptAffinity(uint32_t vector, cpu_mask_t mask) {
+    return device_->SetIrqAffinity(vector, mask);
+}
+
 #endif  // if WITH_DEV_PCIE
@@ -8,6 +8,7 @@
 #include <err.h>
 
 #include <zircon/types.h>
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 
 namespace {
@@ -22,6 +23,9 @@ namespace {
 // - When the top bit is 0 then its the default policy and other bits
 //   should be zero so that kPolicyEmpty == 0 meets the requirement of
 //   all entries being default.
+//
+// The timer slack is stored as the log2 of the slack plus one, and its
+// ZX_TIMER_SLACK_xxx mode plus one, so zero again means no slack.
 
 union Encoding {
     static constexpr uint8_t kExplicitBit = 0b1000;
@@ -43,7 +47,9 @@ union Encoding {
         uint64_t new_socket      :  4;
         uint64_t new_fifo        :  4;
         uint64_t new_timer       :  4;
-        uint64_t unused_bits     : 19;
+        uint64_t timer_slack     :  6;
+        uint64_t timer_slack_mode:  2;
+        uint64_t unused_bits     : 11;
         uint64_t cookie_mode     :  1;  // see kPolicyInCookie.
     };
 
@@ -156,6 +162,49 @@ uint32_t PolicyManager::QueryBasicPolicy(pol_cookie_t policy, uint32_t condition
     }
 }
 
+zx_status_t PolicyManager::AddTimerSlack(
+    uint32_t mode, pol_cookie_t existing_policy,
+    const zx_policy_timer_slack& slack, pol_cookie_t* new_policy) {
+
+    if (slack.default_mode > ZX_TIMER_SLACK_LATE)
+        return ZX_ERR_INVALID_ARGS;
+
+    Encoding existing = { existing_policy };
+    Encoding result = {0};
+    if (slack.min_slack > 0) {
+        // 2^62 ns is over a century, anything larger is clamped to it.
+        uint64_t log2 = 63 - __builtin_clzll(slack.min_slack);
+        result.timer_slack = fbl::min<uint64_t>(log2, 62u) + 1;
+        result.timer_slack_mode = slack.default_mode + 1;
+    }
+
+    if (!Encoding::is_default(existing.timer_slack) &&
+        (existing.timer_slack != result.timer_slack ||
+         existing.timer_slack_mode != result.timer_slack_mode)) {
+        if (mode == ZX_JOB_POL_ABSOLUTE)
+            return ZX_ERR_ALREADY_EXISTS;
+        *new_policy = existing_policy;
+        return ZX_OK;
+    }
+
+    existing.timer_slack = result.timer_slack;
+    existing.timer_slack_mode = result.timer_slack_mode;
+    *new_policy = existing.encoded;
+    return ZX_OK;
+}
+
+void PolicyManager::QueryTimerSlack(pol_cookie_t policy, zx_duration_t* slack,
+                                    uint32_t* slack_mode) {
+    Encoding existing = { policy };
+    if (Encoding::is_default(existing.timer_slack)) {
+        *slack = 0;
+        *slack_mode = ZX_TIMER_SLACK_CENTER;
+        return;
+    }
+    *slack = static_cast<zx_duration_t>(1) << (existing.timer_slack - 1);
+    *slack_mode = existing.timer_slack_mode - 1;
+}
+
 uint32_t PolicyManager::GetEffectiveAction(uint64_t policy) {
     return Encoding::is_default(policy) ?
         default_action_ : Encoding::action(policy);
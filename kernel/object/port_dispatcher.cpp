@@ -14,6 +14,7 @@
 #include <fbl/alloc_checker.h>
 #include <fbl/arena.h>
 #include <fbl/auto_lock.h>
+#include <kernel/auto_lock.h>
 #include <object/excp_port.h>
 #include <object/handle.h>
 #include <zircon/compiler.h>
@@ -33,6 +34,8 @@ static_assert(sizeof(zx_packet_guest_io_t) == sizeof(zx_packet_user_t),
               "size of zx_packet_guest_io_t must match zx_packet_user_t");
 static_assert(sizeof(zx_packet_guest_vcpu_t) == sizeof(zx_packet_user_t),
               "size of zx_packet_guest_vcpu_t must match zx_packet_user_t");
+static_assert(sizeof(zx_packet_interrupt_t) == sizeof(zx_packet_user_t),
+              "size of zx_packet_interrupt_t must match zx_packet_user_t");
 
 class ArenaPortAllocator final : public PortAllocator {
 public:
@@ -166,7 +169,7 @@ PortAllocator* PortDispatcher::DefaultPortAllocator() {
 
 zx_status_t PortDispatcher::Create(uint32_t options, fbl::RefPtr<Dispatcher>* dispatcher,
                                    zx_rights_t* rights) {
-    DEBUG_ASSERT(options == 0);
+    DEBUG_ASSERT((options & ~ZX_PORT_LIFO) == 0);
     fbl::AllocChecker ac;
     auto disp = new (&ac) PortDispatcher(options);
     if (!ac.check())
@@ -177,8 +180,8 @@ zx_status_t PortDispatcher::Create(uint32_t options, fbl::RefPtr<Dispatcher>* di
     return ZX_OK;
 }
 
-PortDispatcher::PortDispatcher(uint32_t /*options*/)
-    : zero_handles_(false) {
+PortDispatcher::PortDispatcher(uint32_t options)
+    : sema_(0, (options & ZX_PORT_LIFO) != 0), zero_handles_(false) {
 }
 
 PortDispatcher::~PortDispatcher() {
@@ -241,6 +244,8 @@ zx_status_t PortDispatcher::Queue(PortPacket* port_packet, zx_signals_t observed
         }
 
         packets_.push_back(port_packet);
+        if (++num_packets_ > stats_.max_queue_depth)
+            stats_.max_queue_depth = num_packets_;
         wake_count = sema_.Post();
     }
 
@@ -250,36 +255,109 @@ zx_status_t PortDispatcher::Queue(PortPacket* port_packet, zx_signals_t observed
     return ZX_OK;
 }
 
+int PortDispatcher::QueueInterrupt(PortInterruptPacket* port_packet, uint64_t slots) {
+    canary_.Assert();
+
+    {
+        AutoSpinLockIrqSave guard(&interrupt_lock_);
+        if (port_packet->InContainer()) {
+            port_packet->slots |= slots;
+            return 0;
+        }
+        port_packet->slots = slots;
+        port_packet->timestamp = current_time();
+        interrupt_packets_.push_back(port_packet);
+    }
+
+    return sema_.Post();
+}
+
+void PortDispatcher::CancelInterrupt(PortInterruptPacket* port_packet) {
+    canary_.Assert();
+
+    AutoSpinLockIrqSave guard(&interrupt_lock_);
+    if (port_packet->InContainer())
+        interrupt_packets_.erase(*port_packet);
+}
+
 zx_status_t PortDispatcher::Dequeue(zx_time_t deadline, zx_port_packet_t* out_packet) {
+    size_t count;
+    return DequeueMany(deadline, out_packet, 1u, &count);
+}
+
+zx_status_t PortDispatcher::DequeueMany(zx_time_t deadline, zx_port_packet_t* packets,
+                                        size_t max_count, size_t* count) {
     canary_.Assert();
+    DEBUG_ASSERT(max_count > 0u);
 
+    zx_time_t blocked_at = 0;
     while (true) {
+        size_t taken = 0u;
         {
             AutoLock al(&lock_);
 
-            PortPacket* port_packet = packets_.pop_front();
-            if (port_packet == nullptr)
-                goto wait;
-
-            if (out_packet != nullptr)
-                *out_packet = port_packet->packet;
-
-            PortObserver* observer = port_packet->observer;
+            if (blocked_at != 0) {
+                const zx_duration_t waited = current_time() - blocked_at;
+                stats_.waits++;
+                stats_.total_wait_time += waited;
+                if (waited > stats_.max_wait_time)
+                    stats_.max_wait_time = waited;
+                blocked_at = 0;
+            }
 
-            if (observer) {
-                // Deleting the observer under the lock is fine because
-                // the reference that holds to this PortDispatcher is by
-                // construction not the last one. We need to do this under
-                // the lock because another thread can call CanReap().
-                delete observer;
-            } else if (port_packet->is_ephemeral()) {
-                port_packet->Free();
+            {
+                AutoSpinLockIrqSave guard(&interrupt_lock_);
+                for (; taken != max_count; ++taken) {
+                    PortInterruptPacket* port_packet = interrupt_packets_.pop_front();
+                    if (port_packet == nullptr)
+                        break;
+
+                    if (packets != nullptr) {
+                        zx_port_packet_t& packet = packets[taken];
+                        packet = {};
+                        packet.key = port_packet->key;
+                        packet.type = ZX_PKT_TYPE_INTERRUPT;
+                        packet.status = ZX_OK;
+                        packet.interrupt.timestamp = port_packet->timestamp;
+                        packet.interrupt.slots = port_packet->slots;
+                    }
+                }
+            }
+            const size_t interrupt_taken = taken;
+
+            for (; taken != max_count; ++taken) {
+                PortPacket* port_packet = packets_.pop_front();
+                if (port_packet == nullptr)
+                    break;
+
+                if (packets != nullptr)
+                    packets[taken] = port_packet->packet;
+
+                PortObserver* observer = port_packet->observer;
+
+                if (observer) {
+                    // Deleting the observer under the lock is fine because
+                    // the reference that holds to this PortDispatcher is by
+                    // construction not the last one. We need to do this under
+                    // the lock because another thread can call CanReap().
+                    delete observer;
+                } else if (port_packet->is_ephemeral()) {
+                    port_packet->Free();
+                }
             }
+
+            num_packets_ -= taken - interrupt_taken;
+            stats_.packets_dequeued += taken;
         }
 
-        return ZX_OK;
+        // Packets taken past the first leave the semaphore count high, which
+        // only costs a spurious trip around this loop later.
+        if (taken != 0u) {
+            *count = taken;
+            return ZX_OK;
+        }
 
-wait:
+        blocked_at = current_time();
         zx_status_t st = sema_.Wait(deadline, nullptr);
         if (st != ZX_OK)
             return st;
@@ -366,6 +444,7 @@ bool PortDispatcher::CancelQueued(const void* handle, uint64_t key) {
         if ((it->handle == handle) && (it->key() == key)) {
             auto to_remove = it++;
             delete packets_.erase(to_remove)->observer;
+            --num_packets_;
             packet_removed = true;
         } else {
             ++it;
@@ -375,6 +454,13 @@ bool PortDispatcher::CancelQueued(const void* handle, uint64_t key) {
     return packet_removed;
 }
 
+void PortDispatcher::GetInfo(zx_info_port_t* info) {
+    canary_.Assert();
+
+    AutoLock al(&lock_);
+    *info = stats_;
+    info->queue_depth = num_packets_;
+}
 
 void PortDispatcher::LinkExceptionPort(ExceptionPort* eport) {
     canary_.Assert();
@@ -15,6 +15,7 @@
 
 #include <arch/defines.h>
 
+#include <kernel/rcu.h>
 #include <kernel/thread.h>
 #include <vm/vm.h>
 #include <vm/vm_aspace.h>
@@ -100,8 +101,7 @@ ProcessDispatcher::ProcessDispatcher(fbl::RefPtr<JobDispatcher> job,
 
     // Generate handle XOR mask with top bit and bottom two bits cleared
     uint32_t secret;
-    auto prng = crypto::GlobalPRNG::GetInstance();
-    prng->Draw(&secret, sizeof(secret));
+    crypto::GlobalPRNG::Draw(&secret, sizeof(secret));
 
     // Handle values cannot be negative values, so we mask the high bit.
     handle_rand_ = (secret << 2) & INT_MAX;
@@ -148,6 +148,11 @@ zx_status_t ProcessDispatcher::Initialize() {
         return ZX_ERR_NO_MEMORY;
     }
 
+    fbl::AllocChecker ac;
+    vm_attribution_ = fbl::AdoptRef(new (&ac) VmAttribution());
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
     return ZX_OK;
 }
 
@@ -265,6 +270,7 @@ void ProcessDispatcher::RemoveThread(ThreadDispatcher* t) {
         // remove the thread from our list
         DEBUG_ASSERT(t != nullptr);
         thread_list_.erase(*t);
+        exited_threads_runtime_ += t->runtime_ns();
 
         // if this was the last thread, transition directly to DEAD state
         if (thread_list_.is_empty()) {
@@ -377,8 +383,8 @@ zx_handle_t ProcessDispatcher::MapHandleToValue(const HandleOwner& handle) const
 }
 
 Handle* ProcessDispatcher::GetHandleLocked(zx_handle_t handle_value) {
-    auto handle = map_value_to_handle(handle_value, handle_rand_);
-    if (handle && handle->process_id() == get_koid())
+    auto handle = LookupHandle(handle_value);
+    if (handle)
         return handle;
 
     // Handle lookup failed.  We potentially generate an exception,
@@ -389,6 +395,19 @@ Handle* ProcessDispatcher::GetHandleLocked(zx_handle_t handle_value) {
     return nullptr;
 }
 
+// Lookups of a handle value resolve straight to the Handle through the
+// global arena, so the table lock is only needed to change the table. A
+// lock-free reader holds a read-side critical section while it uses the
+// Handle* it finds. A removed Handle keeps its dispatcher and rights until
+// it is deleted, and Handle::Delete() only frees it after a grace period,
+// so a reader never sees a Handle that has been freed or reused.
+Handle* ProcessDispatcher::LookupHandle(zx_handle_t handle_value) {
+    auto handle = map_value_to_handle(handle_value, handle_rand_);
+    if (handle && handle->process_id() == get_koid())
+        return handle;
+    return nullptr;
+}
+
 void ProcessDispatcher::AddHandle(HandleOwner handle) {
     AutoLock lock(&handle_table_lock_);
     AddHandleLocked(fbl::move(handle));
@@ -412,6 +431,10 @@ HandleOwner ProcessDispatcher::RemoveHandleLocked(zx_handle_t handle_value) {
     handle->set_process_id(0u);
     handles_.erase(*handle);
 
+    // Lock-free lookups may still be reading the handle. They are not waited
+    // for here, under |handle_table_lock_|, which would serialize every close
+    // behind them; Handle::Delete() defers reclaiming it past a grace period
+    // instead.
     return HandleOwner(handle);
 }
 
@@ -421,24 +444,31 @@ void ProcessDispatcher::UndoRemoveHandleLocked(zx_handle_t handle_value) {
 }
 
 zx_koid_t ProcessDispatcher::GetKoidForHandle(zx_handle_t handle_value) {
-    AutoLock lock(&handle_table_lock_);
-    Handle* handle = GetHandleLocked(handle_value);
-    if (!handle)
+    fbl::RefPtr<Dispatcher> dispatcher;
+    if (GetDispatcherInternal(handle_value, &dispatcher, nullptr) != ZX_OK)
         return ZX_KOID_INVALID;
-    return handle->dispatcher()->get_koid();
+    return dispatcher->get_koid();
 }
 
 zx_status_t ProcessDispatcher::GetDispatcherInternal(zx_handle_t handle_value,
                                                      fbl::RefPtr<Dispatcher>* dispatcher,
                                                      zx_rights_t* rights) {
-    AutoLock lock(&handle_table_lock_);
-    Handle* handle = GetHandleLocked(handle_value);
-    if (!handle)
-        return ZX_ERR_BAD_HANDLE;
+    Handle* handle;
+    {
+        AutoRcuReadLock rcu;
+        handle = LookupHandle(handle_value);
+        if (handle) {
+            *dispatcher = handle->dispatcher();
+            if (rights)
+                *rights = handle->rights();
+        }
+    }
 
-    *dispatcher = handle->dispatcher();
-    if (rights)
-        *rights = handle->rights();
+    if (!handle) {
+        // See GetHandleLocked() for why the result is ignored.
+        QueryPolicy(ZX_POL_BAD_HANDLE);
+        return ZX_ERR_BAD_HANDLE;
+    }
     return ZX_OK;
 }
 
@@ -446,18 +476,24 @@ zx_status_t ProcessDispatcher::GetDispatcherWithRightsInternal(zx_handle_t handl
                                                                zx_rights_t desired_rights,
                                                                fbl::RefPtr<Dispatcher>* dispatcher_out,
                                                                zx_rights_t* out_rights) {
-    AutoLock lock(&handle_table_lock_);
-    Handle* handle = GetHandleLocked(handle_value);
-    if (!handle)
-        return ZX_ERR_BAD_HANDLE;
-
-    if (!handle->HasRights(desired_rights))
-        return ZX_ERR_ACCESS_DENIED;
+    zx_status_t status = ZX_OK;
+    {
+        AutoRcuReadLock rcu;
+        Handle* handle = LookupHandle(handle_value);
+        if (!handle) {
+            status = ZX_ERR_BAD_HANDLE;
+        } else if (!handle->HasRights(desired_rights)) {
+            status = ZX_ERR_ACCESS_DENIED;
+        } else {
+            *dispatcher_out = handle->dispatcher();
+            if (out_rights)
+                *out_rights = handle->rights();
+        }
+    }
 
-    *dispatcher_out = handle->dispatcher();
-    if (out_rights)
-        *out_rights = handle->rights();
-    return ZX_OK;
+    if (status == ZX_ERR_BAD_HANDLE)
+        QueryPolicy(ZX_POL_BAD_HANDLE);
+    return status;
 }
 
 zx_status_t ProcessDispatcher::GetInfo(zx_info_process_t* info) {
@@ -507,6 +543,35 @@ zx_status_t ProcessDispatcher::GetStats(zx_info_task_stats_t* stats) {
     return ZX_OK;
 }
 
+void ProcessDispatcher::GetSnapshot(zx_info_process_snapshot_t* info) {
+    *info = {};
+    info->koid = get_koid();
+    info->job_koid = job_->get_koid();
+    get_name(info->name);
+    info->mem_committed_bytes = vm_attribution_->committed_pages() * PAGE_SIZE;
+
+    AutoLock lock(&state_lock_);
+    switch (state_) {
+    case State::INITIAL:
+        info->state = ZX_INFO_PROCESS_STATE_INITIAL;
+        break;
+    case State::RUNNING:
+        info->state = ZX_INFO_PROCESS_STATE_RUNNING;
+        break;
+    case State::DYING:
+        info->state = ZX_INFO_PROCESS_STATE_DYING;
+        break;
+    case State::DEAD:
+        info->state = ZX_INFO_PROCESS_STATE_DEAD;
+        break;
+    }
+    info->cpu_time = exited_threads_runtime_;
+    for (auto& thread : thread_list_) {
+        info->cpu_time += thread.runtime_ns();
+        info->threads++;
+    }
+}
+
 zx_status_t ProcessDispatcher::GetAspaceMaps(
     user_out_ptr<zx_info_maps_t> maps, size_t max,
     size_t* actual, size_t* available) {
@@ -738,6 +803,10 @@ zx_status_t ProcessDispatcher::QueryPolicy(uint32_t condition) const {
     return (action & ZX_POL_ACTION_DENY) ? ZX_ERR_ACCESS_DENIED : ZX_OK;
 }
 
+void ProcessDispatcher::GetTimerSlack(zx_duration_t* slack, uint32_t* slack_mode) const {
+    GetSystemPolicyManager()->QueryTimerSlack(policy_, slack, slack_mode);
+}
+
 uintptr_t ProcessDispatcher::cache_vdso_code_address() {
     AutoLock a(&state_lock_);
     vdso_code_address_ = aspace_->vdso_code_address();
@@ -759,6 +828,13 @@ const char* StateToString(ProcessDispatcher::State state) {
 }
 
 bool ProcessDispatcher::IsHandleValid(zx_handle_t handle_value) {
-    AutoLock lock(&handle_table_lock_);
-    return (GetHandleLocked(handle_value) != nullptr);
+    bool valid;
+    {
+        AutoRcuReadLock rcu;
+        valid = LookupHandle(handle_value) != nullptr;
+    }
+
+    if (!valid)
+        QueryPolicy(ZX_POL_BAD_HANDLE);
+    return valid;
 }
@@ -0,0 +1,140 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <object/ring_dispatcher.h>
+
+#include <string.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/auto_lock.h>
+#include <lib/counters.h>
+#include <vm/physmap.h>
+#include <vm/pmm.h>
+#include <vm/vm_object_paged.h>
+#include <zircon/rights.h>
+
+using fbl::AutoLock;
+
+// counts the submissions run by zx_ring_enter(), and the calls it took
+KCOUNTER(ring_enter_count, "kernel.ring.enter");
+KCOUNTER(ring_submission_count, "kernel.ring.submissions");
+
+namespace {
+
+static_assert(sizeof(zx_ring_sqe_t) == 64, "");
+static_assert(sizeof(zx_ring_cqe_t) == 16, "");
+static_assert(ZX_RING_CQ_ENTRIES >= ZX_RING_SQ_ENTRIES, "");
+
+zx_status_t get_paddr(void* context, size_t offset, size_t index, paddr_t pa) {
+    static_cast<paddr_t*>(context)[index] = pa;
+    return ZX_OK;
+}
+
+} // namespace
+
+// static
+zx_status_t RingDispatcher::Create(uint32_t options, fbl::RefPtr<Dispatcher>* dispatcher,
+                                   zx_rights_t* rights, fbl::RefPtr<VmObject>* vmo_out) {
+    if (options != 0)
+        return ZX_ERR_INVALID_ARGS;
+
+    // The queues live in one committed vmo, which the ring keeps pinned so
+    // the kernel can use the physmap and the pages cannot go away.
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, ZX_RING_VMO_SIZE, &vmo);
+    if (status != ZX_OK)
+        return status;
+    status = vmo->CommitRange(0, ZX_RING_VMO_SIZE, nullptr);
+    if (status != ZX_OK)
+        return status;
+
+    paddr_t pa[ZX_RING_VMO_SIZE / PAGE_SIZE];
+    status = vmo->Lookup(0, ZX_RING_VMO_SIZE, 0, get_paddr, pa);
+    if (status != ZX_OK)
+        return status;
+
+    auto headers = reinterpret_cast<uint8_t*>(paddr_to_physmap(pa[0]));
+    auto sq = reinterpret_cast<zx_ring_queue_t*>(headers + ZX_RING_SQ_HEADER_OFFSET);
+    auto cq = reinterpret_cast<zx_ring_queue_t*>(headers + ZX_RING_CQ_HEADER_OFFSET);
+    auto sqes = reinterpret_cast<zx_ring_sqe_t*>(
+        paddr_to_physmap(pa[ZX_RING_SQ_OFFSET / PAGE_SIZE]));
+    auto cqes = reinterpret_cast<zx_ring_cqe_t*>(
+        paddr_to_physmap(pa[ZX_RING_CQ_OFFSET / PAGE_SIZE]));
+
+    status = vmo->Pin(0, ZX_RING_VMO_SIZE);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::AllocChecker ac;
+    auto ring = fbl::AdoptRef(new (&ac) RingDispatcher(vmo, sq, cq, sqes, cqes));
+    if (!ac.check()) {
+        vmo->Unpin(0, ZX_RING_VMO_SIZE);
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    *rights = ZX_DEFAULT_RING_RIGHTS;
+    *dispatcher = fbl::move(ring);
+    *vmo_out = fbl::move(vmo);
+    return ZX_OK;
+}
+
+RingDispatcher::RingDispatcher(fbl::RefPtr<VmObject> vmo, zx_ring_queue_t* sq,
+                               zx_ring_queue_t* cq, zx_ring_sqe_t* sqes, zx_ring_cqe_t* cqes)
+    : vmo_(fbl::move(vmo)), sq_(sq), cq_(cq), sqes_(sqes), cqes_(cqes) {
+}
+
+RingDispatcher::~RingDispatcher() {
+    vmo_->Unpin(0, ZX_RING_VMO_SIZE);
+}
+
+zx_status_t RingDispatcher::Enter(uint32_t count, ExecuteFn execute, uint32_t* actual) {
+    canary_.Assert();
+
+    AutoLock lock(&enter_lock_);
+
+    // Userspace owns the other ends of the queues and may have scribbled on
+    // them; a queue that claims to hold more than it can is not used at all.
+    uint32_t sq_head = __atomic_load_n(&sq_->head, __ATOMIC_ACQUIRE);
+    uint32_t cq_tail = __atomic_load_n(&cq_->tail, __ATOMIC_ACQUIRE);
+    uint32_t submitted = sq_head - sq_tail_;
+    uint32_t completed = cq_head_ - cq_tail;
+    if (submitted > ZX_RING_SQ_ENTRIES || completed > ZX_RING_CQ_ENTRIES)
+        return ZX_ERR_BAD_STATE;
+
+    uint32_t n = fbl::min(fbl::min(count, submitted),
+                          static_cast<uint32_t>(ZX_RING_CQ_ENTRIES) - completed);
+    for (uint32_t i = 0; i < n; i++) {
+        // Copy the submission out first, so that userspace can't change it
+        // while it runs.
+        zx_ring_sqe_t sqe;
+        memcpy(&sqe, &sqes_[sq_tail_ % ZX_RING_SQ_ENTRIES], sizeof(sqe));
+        sq_tail_++;
+
+        zx_ring_cqe_t cqe = {};
+        cqe.user_data = sqe.user_data;
+        cqe.status = execute(sqe);
+        memcpy(&cqes_[cq_head_ % ZX_RING_CQ_ENTRIES], &cqe, sizeof(cqe));
+        cq_head_++;
+    }
+
+    __atomic_store_n(&sq_->tail, sq_tail_, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&cq_->head, cq_head_, __ATOMIC_SEQ_CST);
+
+    // Userspace takes completions without telling us, so this is only as
+    // fresh as the tail read above.
+    if (cq_head_ != cq_tail) {
+        UpdateState(0u, ZX_RING_READABLE);
+    } else {
+        UpdateState(ZX_RING_READABLE, 0u);
+    }
+
+    kcounter_add(ring_enter_count, 1u);
+    kcounter_add(ring_submission_count, n);
+
+    *actual = n;
+    return ZX_OK;
+}
@@ -10,7 +10,8 @@
 #include <zircon/compiler.h>
 #include <zircon/types.h>
 
-Semaphore::Semaphore(int64_t initial_count) : count_(initial_count) {
+Semaphore::Semaphore(int64_t initial_count, bool lifo)
+    : count_(initial_count), lifo_(lifo) {
     wait_queue_init(&waitq_);
 }
 
@@ -22,8 +23,11 @@ int Semaphore::Post() {
     // If the count is or was negative then a thread is waiting for a resource,
     // otherwise it's safe to just increase the count available with no downsides.
     AutoThreadLock lock;
-    if (unlikely(++count_ <= 0))
+    if (unlikely(++count_ <= 0)) {
+        if (lifo_)
+            return wait_queue_wake_one_lifo(&waitq_, false, ZX_OK);
         return wait_queue_wake_one(&waitq_, false, ZX_OK);
+    }
     return 0;
 }
 
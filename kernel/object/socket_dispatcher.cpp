@@ -38,6 +38,10 @@ zx_status_t SocketDispatcher::Create(uint32_t flags,
     if (flags & ~ZX_SOCKET_CREATE_MASK)
         return ZX_ERR_INVALID_ARGS;
 
+    // The shared rings carry a byte stream only.
+    if ((flags & ZX_SOCKET_RING) && (flags & ZX_SOCKET_DATAGRAM))
+        return ZX_ERR_INVALID_ARGS;
+
     fbl::AllocChecker ac;
 
     zx_signals_t starting_signals = ZX_SOCKET_WRITABLE;
@@ -61,11 +65,21 @@ zx_status_t SocketDispatcher::Create(uint32_t flags,
             return ZX_ERR_NO_MEMORY;
     }
 
-    auto socket0 = fbl::AdoptRef(new (&ac) SocketDispatcher(starting_signals, flags, fbl::move(control0)));
+    fbl::RefPtr<SocketRing> ring;
+    if (flags & ZX_SOCKET_RING) {
+        zx_status_t status = SocketRing::Create(&ring);
+        if (status != ZX_OK)
+            return status;
+    }
+
+    // Endpoint 0 writes ring 0 and reads ring 1, endpoint 1 the reverse.
+    auto socket0 = fbl::AdoptRef(new (&ac) SocketDispatcher(starting_signals, flags,
+                                                            fbl::move(control0), ring, 1u));
     if (!ac.check())
         return ZX_ERR_NO_MEMORY;
 
-    auto socket1 = fbl::AdoptRef(new (&ac) SocketDispatcher(starting_signals, flags, fbl::move(control1)));
+    auto socket1 = fbl::AdoptRef(new (&ac) SocketDispatcher(starting_signals, flags,
+                                                            fbl::move(control1), ring, 0u));
     if (!ac.check())
         return ZX_ERR_NO_MEMORY;
 
@@ -79,10 +93,13 @@ zx_status_t SocketDispatcher::Create(uint32_t flags,
 }
 
 SocketDispatcher::SocketDispatcher(zx_signals_t starting_signals, uint32_t flags,
-                                   fbl::unique_ptr<char[]> control_msg)
+                                   fbl::unique_ptr<char[]> control_msg,
+                                   fbl::RefPtr<SocketRing> ring, uint32_t ring_rx)
     : Dispatcher(starting_signals),
       flags_(flags),
       peer_koid_(0u),
+      ring_(fbl::move(ring)),
+      ring_rx_(ring_rx),
       control_msg_(fbl::move(control_msg)),
       control_msg_len_(0),
       read_disabled_(false) {
@@ -302,7 +319,9 @@ zx_status_t SocketDispatcher::WriteSelf(user_in_ptr<const void> src, size_t len,
 
     size_t st = 0u;
     zx_status_t status;
-    if (flags_ & ZX_SOCKET_DATAGRAM) {
+    if (ring_) {
+        status = ring_->Write(ring_rx_, src, len, &st);
+    } else if (flags_ & ZX_SOCKET_DATAGRAM) {
         status = data_.WriteDatagram(src, len, &st);
     } else {
         status = data_.WriteStream(src, len, &st);
@@ -332,7 +351,7 @@ zx_status_t SocketDispatcher::Read(user_out_ptr<void> dst, size_t len,
 
     // Just query for bytes outstanding.
     if (!dst && len == 0) {
-        *nread = data_.size();
+        *nread = size();
         return ZX_OK;
     }
 
@@ -351,7 +370,14 @@ zx_status_t SocketDispatcher::Read(user_out_ptr<void> dst, size_t len,
 
     bool was_full = is_full();
 
-    auto st = data_.Read(dst, len, flags_ & ZX_SOCKET_DATAGRAM);
+    size_t st;
+    if (ring_) {
+        zx_status_t status = ring_->Read(ring_rx_, dst, len, &st);
+        if (status != ZX_OK)
+            return status;
+    } else {
+        st = data_.Read(dst, len, flags_ & ZX_SOCKET_DATAGRAM);
+    }
 
     if (is_empty()) {
         uint32_t set_mask = 0u;
@@ -363,7 +389,7 @@ zx_status_t SocketDispatcher::Read(user_out_ptr<void> dst, size_t len,
     if (other_ && was_full && (st > 0))
         other_->UpdateState(0u, ZX_SOCKET_WRITABLE);
 
-    *nread = static_cast<size_t>(st);
+    *nread = st;
     return ZX_OK;
 }
 
@@ -462,3 +488,54 @@ zx_status_t SocketDispatcher::Accept(HandleOwner* h) {
 
     return ZX_OK;
 }
+
+zx_status_t SocketDispatcher::GetRing(fbl::RefPtr<VmObject>* vmo, uint32_t* index) {
+    canary_.Assert();
+
+    if (!ring_)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    *vmo = ring_->vmo();
+    *index = ring_rx_ ^ 1u;
+    return ZX_OK;
+}
+
+zx_status_t SocketDispatcher::RingUpdate() {
+    canary_.Assert();
+
+    if (!ring_)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    fbl::RefPtr<SocketDispatcher> other;
+    {
+        AutoLock lock(&lock_);
+        other = other_;
+    }
+
+    // Each endpoint refreshes the signals that depend on the ring it reads:
+    // its own readability and the writability of its peer.
+    RingUpdateSelf();
+    if (other)
+        other->RingUpdateSelf();
+    return ZX_OK;
+}
+
+void SocketDispatcher::RingUpdateSelf() {
+    canary_.Assert();
+
+    AutoLock lock(&lock_);
+
+    if (is_empty()) {
+        UpdateState(ZX_SOCKET_READABLE, read_disabled_ ? ZX_SOCKET_READ_DISABLED : 0u);
+    } else {
+        UpdateState(0u, ZX_SOCKET_READABLE);
+    }
+
+    if (!other_)
+        return;
+    if (is_full()) {
+        other_->UpdateState(ZX_SOCKET_WRITABLE, 0u);
+    } else if (!(other_->GetSignalsState() & ZX_SOCKET_WRITE_DISABLED)) {
+        other_->UpdateState(0u, ZX_SOCKET_WRITABLE);
+    }
+}
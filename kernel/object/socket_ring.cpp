@@ -0,0 +1,142 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <object/socket_ring.h>
+
+#include <assert.h>
+#include <err.h>
+#include <trace.h>
+
+#include <vm/physmap.h>
+#include <vm/pmm.h>
+#include <vm/vm_object_paged.h>
+
+#include <fbl/alloc_checker.h>
+
+#define LOCAL_TRACE 0
+
+static_assert(ZX_SOCKET_RING_DATA_OFFSET(0) == PAGE_SIZE, "");
+static_assert(ZX_SOCKET_RING_HEADER_OFFSET(2) <= PAGE_SIZE, "");
+static_assert(IS_PAGE_ALIGNED(ZX_SOCKET_RING_SIZE), "");
+static_assert((ZX_SOCKET_RING_SIZE & (ZX_SOCKET_RING_SIZE - 1)) == 0, "");
+
+namespace {
+
+zx_status_t get_header_paddr(void* context, size_t offset, size_t index, paddr_t pa) {
+    *static_cast<paddr_t*>(context) = pa;
+    return ZX_OK;
+}
+
+uint32_t ring_used(const zx_socket_ring_t* hdr) {
+    uint32_t head = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+    uint32_t tail = __atomic_load_n(&hdr->tail, __ATOMIC_ACQUIRE);
+    return head - tail;
+}
+
+} // namespace
+
+// static
+zx_status_t SocketRing::Create(fbl::RefPtr<SocketRing>* ring) {
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, ZX_SOCKET_RING_VMO_SIZE, &vmo);
+    if (status != ZX_OK)
+        return status;
+
+    status = vmo->CommitRange(0, ZX_SOCKET_RING_VMO_SIZE, nullptr);
+    if (status != ZX_OK)
+        return status;
+
+    status = vmo->Pin(0, ZX_SOCKET_RING_VMO_SIZE);
+    if (status != ZX_OK)
+        return status;
+
+    paddr_t pa;
+    status = vmo->Lookup(0, PAGE_SIZE, 0, get_header_paddr, &pa);
+    if (status != ZX_OK) {
+        vmo->Unpin(0, ZX_SOCKET_RING_VMO_SIZE);
+        return status;
+    }
+
+    auto headers = reinterpret_cast<zx_socket_ring_t*>(paddr_to_physmap(pa));
+
+    fbl::AllocChecker ac;
+    *ring = fbl::AdoptRef(new (&ac) SocketRing(vmo, headers));
+    if (!ac.check()) {
+        vmo->Unpin(0, ZX_SOCKET_RING_VMO_SIZE);
+        return ZX_ERR_NO_MEMORY;
+    }
+    return ZX_OK;
+}
+
+SocketRing::SocketRing(fbl::RefPtr<VmObject> vmo, zx_socket_ring_t* headers)
+    : vmo_(fbl::move(vmo)), headers_(headers) {
+}
+
+SocketRing::~SocketRing() {
+    vmo_->Unpin(0, ZX_SOCKET_RING_VMO_SIZE);
+}
+
+size_t SocketRing::ReadableBytes(uint32_t index) const {
+    return MIN(ring_used(header(index)), ZX_SOCKET_RING_SIZE);
+}
+
+size_t SocketRing::WritableBytes(uint32_t index) const {
+    uint32_t used = ring_used(header(index));
+    return used >= ZX_SOCKET_RING_SIZE ? 0u : ZX_SOCKET_RING_SIZE - used;
+}
+
+zx_status_t SocketRing::Write(uint32_t index, user_in_ptr<const void> src, size_t len,
+                              size_t* written) {
+    zx_socket_ring_t* hdr = header(index);
+    const uint64_t data = ZX_SOCKET_RING_DATA_OFFSET(index & 1);
+
+    len = MIN(len, WritableBytes(index));
+    uint32_t head = __atomic_load_n(&hdr->head, __ATOMIC_RELAXED);
+
+    size_t copied = 0;
+    while (copied < len) {
+        uint32_t offset = head & (ZX_SOCKET_RING_SIZE - 1);
+        size_t chunk = MIN(len - copied, ZX_SOCKET_RING_SIZE - offset);
+
+        size_t actual;
+        zx_status_t status = vmo_->WriteUser(src.byte_offset(copied), data + offset, chunk, &actual);
+        if (status != ZX_OK)
+            return status;
+
+        head += static_cast<uint32_t>(chunk);
+        copied += chunk;
+    }
+
+    __atomic_store_n(&hdr->head, head, __ATOMIC_RELEASE);
+    *written = copied;
+    return ZX_OK;
+}
+
+zx_status_t SocketRing::Read(uint32_t index, user_out_ptr<void> dst, size_t len, size_t* nread) {
+    zx_socket_ring_t* hdr = header(index);
+    const uint64_t data = ZX_SOCKET_RING_DATA_OFFSET(index & 1);
+
+    len = MIN(len, ReadableBytes(index));
+    uint32_t tail = __atomic_load_n(&hdr->tail, __ATOMIC_RELAXED);
+
+    size_t copied = 0;
+    while (copied < len) {
+        uint32_t offset = tail & (ZX_SOCKET_RING_SIZE - 1);
+        size_t chunk = MIN(len - copied, ZX_SOCKET_RING_SIZE - offset);
+
+        size_t actual;
+        zx_status_t status = vmo_->ReadUser(dst.byte_offset(copied), data + offset, chunk, &actual);
+        if (status != ZX_OK)
+            return status;
+
+        tail += static_cast<uint32_t>(chunk);
+        copied += chunk;
+    }
+
+    __atomic_store_n(&hdr->tail, tail, __ATOMIC_RELEASE);
+    *nread = copied;
+    return ZX_OK;
+}
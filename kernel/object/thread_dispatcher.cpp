@@ -17,6 +17,7 @@
 #include <arch/exception.h>
 
 #include <kernel/thread.h>
+#include <lib/counters.h>
 #include <vm/vm.h>
 #include <vm/vm_aspace.h>
 #include <vm/vm_address_region.h>
@@ -40,6 +41,82 @@ using fbl::AutoLock;
 
 #define LOCAL_TRACE 0
 
+KCOUNTER(kstack_cache_hit_count, "kernel.thread.kstack_cache.hit");
+KCOUNTER(kstack_cache_miss_count, "kernel.thread.kstack_cache.miss");
+
+namespace {
+
+// Creating a kernel stack takes a VMO, a VMAR with guard pages around the
+// stack, a mapping and a fault for every page, which dominates the cost of
+// a short lived thread. Instead of being destroyed, the stacks of dead
+// threads are kept fully mapped in a small per-cpu cache, and the next
+// thread created on that cpu takes one from there. The cache is emptied when
+// the system runs low on memory.
+struct CachedStack {
+    fbl::RefPtr<VmMapping> mapping;
+    fbl::RefPtr<VmAddressRegion> vmar;
+};
+
+constexpr size_t kStackCacheDepth = 4;
+
+struct StackCache {
+    SpinLock lock;
+    size_t count TA_GUARDED(lock) = 0;
+    CachedStack stacks[kStackCacheDepth] TA_GUARDED(lock);
+};
+
+// Indexed by whether the stack is an unsafe stack, then by cpu.
+StackCache stack_cache[2][SMP_MAX_CPUS];
+
+StackCache* local_stack_cache(bool unsafe) {
+    return &stack_cache[unsafe][arch_curr_cpu_num()];
+}
+
+bool stack_cache_get(bool unsafe, fbl::RefPtr<VmMapping>* out_kstack_mapping,
+                     fbl::RefPtr<VmAddressRegion>* out_kstack_vmar) {
+    StackCache* cache = local_stack_cache(unsafe);
+
+    AutoSpinLock lock(&cache->lock);
+    if (cache->count == 0)
+        return false;
+
+    CachedStack* stack = &cache->stacks[--cache->count];
+    *out_kstack_mapping = fbl::move(stack->mapping);
+    *out_kstack_vmar = fbl::move(stack->vmar);
+    return true;
+}
+
+bool stack_cache_put(bool unsafe, fbl::RefPtr<VmMapping>* kstack_mapping,
+                     fbl::RefPtr<VmAddressRegion>* kstack_vmar) {
+    StackCache* cache = local_stack_cache(unsafe);
+
+    AutoSpinLock lock(&cache->lock);
+    if (cache->count == kStackCacheDepth)
+        return false;
+
+    CachedStack* stack = &cache->stacks[cache->count++];
+    stack->mapping = fbl::move(*kstack_mapping);
+    stack->vmar = fbl::move(*kstack_vmar);
+    return true;
+}
+
+void free_stack(bool unsafe, fbl::RefPtr<VmMapping>* kstack_mapping,
+                fbl::RefPtr<VmAddressRegion>* kstack_vmar) {
+    // both are set once the stack is fully constructed
+    if (*kstack_mapping && *kstack_vmar &&
+        stack_cache_put(unsafe, kstack_mapping, kstack_vmar)) {
+        return;
+    }
+
+    kstack_mapping->reset();
+    if (*kstack_vmar) {
+        (*kstack_vmar)->Destroy();
+        kstack_vmar->reset();
+    }
+}
+
+} // namespace
+
 // static
 zx_status_t ThreadDispatcher::Create(fbl::RefPtr<ProcessDispatcher> process, uint32_t flags,
                                      fbl::StringPiece name,
@@ -88,17 +165,9 @@ ThreadDispatcher::~ThreadDispatcher() {
     }
 
     // free the kernel stack
-    kstack_mapping_.reset();
-    if (kstack_vmar_) {
-        kstack_vmar_->Destroy();
-        kstack_vmar_.reset();
-    }
+    free_stack(false, &kstack_mapping_, &kstack_vmar_);
 #if __has_feature(safe_stack)
-    unsafe_kstack_mapping_.reset();
-    if (unsafe_kstack_vmar_) {
-        unsafe_kstack_vmar_->Destroy();
-        unsafe_kstack_vmar_.reset();
-    }
+    free_stack(true, &unsafe_kstack_mapping_, &unsafe_kstack_vmar_);
 #endif
 
     event_destroy(&exception_event_);
@@ -109,6 +178,12 @@ namespace {
 zx_status_t allocate_stack(const fbl::RefPtr<VmAddressRegion>& vmar, bool unsafe,
                            fbl::RefPtr<VmMapping>* out_kstack_mapping,
                            fbl::RefPtr<VmAddressRegion>* out_kstack_vmar) {
+    if (stack_cache_get(unsafe, out_kstack_mapping, out_kstack_vmar)) {
+        kcounter_add(kstack_cache_hit_count, 1);
+        return ZX_OK;
+    }
+    kcounter_add(kstack_cache_miss_count, 1);
+
     LTRACEF("allocating %s stack\n", unsafe ? "unsafe" : "safe");
 
     // Create a VMO for our stack
@@ -175,6 +250,34 @@ zx_status_t allocate_stack(const fbl::RefPtr<VmAddressRegion>& vmar, bool unsafe
 
 } // namespace
 
+// static
+size_t ThreadDispatcher::TrimStackCache() {
+    size_t freed = 0;
+
+    for (auto& caches : stack_cache) {
+        for (auto& cache : caches) {
+            CachedStack stacks[kStackCacheDepth];
+            size_t count;
+            {
+                AutoSpinLock lock(&cache.lock);
+                count = cache.count;
+                for (size_t i = 0; i < count; i++)
+                    stacks[i] = fbl::move(cache.stacks[i]);
+                cache.count = 0;
+            }
+
+            // tear the mappings down without holding the spinlock
+            for (size_t i = 0; i < count; i++) {
+                stacks[i].mapping.reset();
+                stacks[i].vmar->Destroy();
+                freed++;
+            }
+        }
+    }
+
+    return freed;
+}
+
 // complete initialization of the thread object outside of the constructor
 zx_status_t ThreadDispatcher::Initialize(const char* name, size_t len) {
     LTRACE_ENTRY_OBJ;
@@ -232,6 +335,18 @@ zx_status_t ThreadDispatcher::Initialize(const char* name, size_t len) {
     // set the per-thread pointer
     lkthread->user_thread = reinterpret_cast<void*>(this);
 
+    // apply the job's timer slack to everything this thread waits for
+    uint32_t slack_mode;
+    process_->GetTimerSlack(&lkthread->timer_slack, &slack_mode);
+    switch (slack_mode) {
+    case ZX_TIMER_SLACK_EARLY: lkthread->timer_slack_mode = TIMER_SLACK_EARLY;
+        break;
+    case ZX_TIMER_SLACK_LATE: lkthread->timer_slack_mode = TIMER_SLACK_LATE;
+        break;
+    default: lkthread->timer_slack_mode = TIMER_SLACK_CENTER;
+        break;
+    };
+
     // associate the proc's address space with this thread
     process_->aspace()->AttachToThread(lkthread);
 
@@ -385,6 +500,30 @@ zx_status_t ThreadDispatcher::Resume() {
     return thread_resume(&thread_);
 }
 
+zx_status_t ThreadDispatcher::SetDeadline(zx_duration_t capacity, zx_duration_t deadline,
+                                          zx_duration_t period) {
+    canary_.Assert();
+
+    AutoLock lock(&state_lock_);
+
+    // the LK thread only exists between Initialize and exit
+    if (state_ != State::INITIALIZED && state_ != State::RUNNING && state_ != State::SUSPENDED)
+        return ZX_ERR_BAD_STATE;
+
+    return thread_set_deadline(&thread_, capacity, deadline, period);
+}
+
+zx_status_t ThreadDispatcher::SetIdleLatency(zx_duration_t latency) {
+    canary_.Assert();
+
+    AutoLock lock(&state_lock_);
+
+    if (state_ != State::INITIALIZED && state_ != State::RUNNING && state_ != State::SUSPENDED)
+        return ZX_ERR_BAD_STATE;
+
+    return thread_set_idle_latency(&thread_, latency);
+}
+
 static void ThreadCleanupDpc(dpc_t *d) {
     LTRACEF("dpc %p\n", d);
 
@@ -866,6 +1005,9 @@ zx_status_t ThreadDispatcher::GetStatsForUserspace(zx_info_thread_stats_t* info)
     *info = {};
 
     info->total_runtime = runtime_ns();
+    static_assert(INVALID_CPU == ZX_INFO_INVALID_CPU, "");
+    info->last_scheduled_cpu = thread_.last_cpu;
+    info->migrations = thread_.migrations;
     return ZX_OK;
 }
 
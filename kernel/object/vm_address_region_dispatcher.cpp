@@ -75,6 +75,14 @@ zx_status_t split_syscall_flags(uint32_t flags, uint32_t* vmar_flags, uint* arch
         vmar |= VMAR_FLAG_CAN_MAP_EXECUTE;
         flags &= ~ZX_VM_FLAG_CAN_MAP_EXECUTE;
     }
+    if (flags & ZX_VM_FLAG_ACCESS_SEQUENTIAL) {
+        vmar |= VMAR_FLAG_ACCESS_SEQUENTIAL;
+        flags &= ~ZX_VM_FLAG_ACCESS_SEQUENTIAL;
+    }
+    if (flags & ZX_VM_FLAG_ACCESS_RANDOM) {
+        vmar |= VMAR_FLAG_ACCESS_RANDOM;
+        flags &= ~ZX_VM_FLAG_ACCESS_RANDOM;
+    }
 
     if (flags != 0)
         return ZX_ERR_INVALID_ARGS;
@@ -175,11 +183,27 @@ zx_status_t VmAddressRegionDispatcher::Map(size_t vmar_offset, fbl::RefPtr<VmObj
     if (status != ZX_OK)
         return status;
 
+    // Line mappings that can use large pages up with the object's large page
+    // boundaries, which only works out if the object offset is itself aligned.
+    uint8_t align_pow2 = 0;
+    if (!(vmar_flags & (VMAR_FLAG_SPECIFIC | VMAR_FLAG_SPECIFIC_OVERWRITE)) &&
+        len >= LARGE_PAGE_SIZE &&
+        IS_ALIGNED(vmo_offset, LARGE_PAGE_SIZE) && vmo->prefers_large_pages()) {
+        align_pow2 = LARGE_PAGE_SIZE_SHIFT;
+    }
+
     fbl::RefPtr<VmMapping> result(nullptr);
-    status = vmar_->CreateVmMapping(vmar_offset, len, /* align_pow2 */ 0,
-                                    vmar_flags, fbl::move(vmo), vmo_offset,
+    status = vmar_->CreateVmMapping(vmar_offset, len, align_pow2,
+                                    vmar_flags, vmo, vmo_offset,
                                     arch_mmu_flags, "useralloc",
                                     &result);
+    if (status == ZX_ERR_NO_MEMORY && align_pow2 != 0) {
+        // no aligned spot left, settle for small pages
+        status = vmar_->CreateVmMapping(vmar_offset, len, /* align_pow2 */ 0,
+                                        vmar_flags, fbl::move(vmo), vmo_offset,
+                                        arch_mmu_flags, "useralloc",
+                                        &result);
+    }
     if (status != ZX_OK) {
         return status;
     }
@@ -35,9 +35,13 @@ zx_status_t VmObjectDispatcher::Create(fbl::RefPtr<VmObject> vmo,
 }
 
 VmObjectDispatcher::VmObjectDispatcher(fbl::RefPtr<VmObject> vmo)
-    : vmo_(vmo) {}
+    : vmo_(vmo) {
+    vmo_->AddHolder();
+}
 
 VmObjectDispatcher::~VmObjectDispatcher() {
+    vmo_->RemoveHolder();
+
     // Intentionally leave vmo_->user_id() set to our koid even though we're
     // dying and the koid will no longer map to a Dispatcher. koids are never
     // recycled, and it could be a useful breadcrumb.
@@ -71,6 +75,20 @@ zx_status_t VmObjectDispatcher::Write(user_in_ptr<const void> user_data,
     return vmo_->WriteUser(user_data, offset, length, bytes_written);
 }
 
+zx_status_t VmObjectDispatcher::ReadVector(const iovec_t* vec, size_t count, uint64_t offset,
+                                           size_t* bytes_read) {
+    canary_.Assert();
+
+    return vmo_->ReadUserVector(vec, count, offset, bytes_read);
+}
+
+zx_status_t VmObjectDispatcher::WriteVector(const iovec_t* vec, size_t count, uint64_t offset,
+                                            size_t* bytes_written) {
+    canary_.Assert();
+
+    return vmo_->WriteUserVector(vec, count, offset, bytes_written);
+}
+
 zx_status_t VmObjectDispatcher::SetSize(uint64_t size) {
     canary_.Assert();
 
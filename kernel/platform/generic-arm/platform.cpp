@@ -652,13 +652,11 @@ static void platform_init_postvm(uint level) {
 LK_INIT_HOOK(platform_postvm, platform_init_postvm, LK_INIT_LEVEL_VM);
 
 void platform_dputs(const char* str, size_t len) {
-    while (len-- > 0) {
-        char c = *str++;
-        if (c == '\n') {
-            uart_putc('\r');
-        }
-        uart_putc(c);
-    }
+    // Only sleep on the uart from a context that may block; everything else,
+    // including the idle thread and panic, keeps spinning.
+    thread_t* t = get_current_thread();
+    bool block = !arch_ints_disabled() && t && !(t->flags & THREAD_FLAG_IDLE);
+    uart_dputs(str, len, block, true);
 }
 
 int platform_dgetc(char* c, bool wait) {
@@ -10,12 +10,14 @@
 
 #include <assert.h>
 #include <err.h>
+#include <inttypes.h>
 #include <trace.h>
 
 #include <lk/init.h>
 
 #include <arch/x86/apic.h>
 #include <platform/pc/acpi.h>
+#include <vm/pmm.h>
 #include <zircon/types.h>
 
 #define LOCAL_TRACE 0
@@ -56,6 +58,125 @@ void platform_init_acpi_tables(uint level) {
 /* initialize ACPI tables as soon as we have a working VM */
 LK_INIT_HOOK(acpi_tables, &platform_init_acpi_tables, LK_INIT_LEVEL_VM + 1);
 
+/* NUMA nodes are numbered in the order their proximity domains first show
+ * up in the SRAT. The node of each cpu is kept by APIC ID until the cpus
+ * are numbered, see platform_numa_node_of_apic_id(). */
+static uint32_t numa_domains[PMM_MAX_NODES];
+static uint numa_domain_count;
+
+static struct {
+    uint32_t apic_id;
+    uint node;
+} numa_cpus[SMP_MAX_CPUS];
+static uint numa_cpu_count;
+
+static zx_status_t acpi_numa_node(uint32_t domain, uint* node) {
+    for (uint i = 0; i < numa_domain_count; i++) {
+        if (numa_domains[i] == domain) {
+            *node = i;
+            return ZX_OK;
+        }
+    }
+    if (numa_domain_count == PMM_MAX_NODES) {
+        TRACEF("too many NUMA nodes, ignoring proximity domain %u\n", domain);
+        return ZX_ERR_NO_RESOURCES;
+    }
+    numa_domains[numa_domain_count] = domain;
+    *node = numa_domain_count++;
+    return ZX_OK;
+}
+
+static void acpi_numa_add_cpu(uint32_t apic_id, uint32_t domain) {
+    uint node;
+    if (acpi_numa_node(domain, &node) != ZX_OK)
+        return;
+    if (numa_cpu_count == countof(numa_cpus))
+        return;
+    numa_cpus[numa_cpu_count].apic_id = apic_id;
+    numa_cpus[numa_cpu_count].node = node;
+    numa_cpu_count++;
+}
+
+/**
+ * @brief  Assign memory to NUMA nodes from the SRAT
+ *
+ * Runs right after the tables come up, while the boot cpu is still the only
+ * one running, so that the pmm can split its arenas at the node boundaries.
+ */
+static void platform_init_acpi_numa(uint level) {
+    if (!acpi_initialized)
+        return;
+
+    ACPI_TABLE_HEADER* table = NULL;
+    ACPI_STATUS status = AcpiGetTable((char*)ACPI_SIG_SRAT, 1, &table);
+    if (status != AE_OK) {
+        LTRACEF("no SRAT, memory is not NUMA\n");
+        return;
+    }
+
+    uintptr_t records_start = ((uintptr_t)table) + sizeof(ACPI_TABLE_SRAT);
+    uintptr_t records_end = ((uintptr_t)table) + table->Length;
+    ACPI_SUBTABLE_HEADER* record_hdr;
+    for (uintptr_t addr = records_start; addr < records_end; addr += record_hdr->Length) {
+        record_hdr = (ACPI_SUBTABLE_HEADER*)addr;
+        if (record_hdr->Length == 0 || addr + record_hdr->Length > records_end) {
+            TRACEF("malformed SRAT\n");
+            return;
+        }
+
+        switch (record_hdr->Type) {
+        case ACPI_SRAT_TYPE_CPU_AFFINITY: {
+            ACPI_SRAT_CPU_AFFINITY* cpu = (ACPI_SRAT_CPU_AFFINITY*)record_hdr;
+            if (!(cpu->Flags & ACPI_SRAT_CPU_ENABLED))
+                break;
+            uint32_t domain = cpu->ProximityDomainLo |
+                              ((uint32_t)cpu->ProximityDomainHi[0] << 8) |
+                              ((uint32_t)cpu->ProximityDomainHi[1] << 16) |
+                              ((uint32_t)cpu->ProximityDomainHi[2] << 24);
+            acpi_numa_add_cpu(cpu->ApicId, domain);
+            break;
+        }
+        case ACPI_SRAT_TYPE_X2APIC_CPU_AFFINITY: {
+            ACPI_SRAT_X2APIC_CPU_AFFINITY* cpu = (ACPI_SRAT_X2APIC_CPU_AFFINITY*)record_hdr;
+            if (!(cpu->Flags & ACPI_SRAT_CPU_ENABLED))
+                break;
+            acpi_numa_add_cpu(cpu->ApicId, cpu->ProximityDomain);
+            break;
+        }
+        case ACPI_SRAT_TYPE_MEMORY_AFFINITY: {
+            ACPI_SRAT_MEM_AFFINITY* mem = (ACPI_SRAT_MEM_AFFINITY*)record_hdr;
+            if (!(mem->Flags & ACPI_SRAT_MEM_ENABLED) || mem->Length == 0)
+                break;
+            uint node;
+            if (acpi_numa_node(mem->ProximityDomain, &node) != ZX_OK)
+                break;
+            LTRACEF("memory [%#" PRIx64 ", %#" PRIx64 ") is on node %u\n",
+                    mem->BaseAddress, mem->BaseAddress + mem->Length, node);
+            zx_status_t status = pmm_set_node_range(mem->BaseAddress, mem->Length, node);
+            if (status != ZX_OK)
+                TRACEF("failed to assign memory to node %u: %d\n", node, status);
+            break;
+        }
+        }
+    }
+
+    dprintf(INFO, "ACPI: %u NUMA node%s\n", numa_domain_count, numa_domain_count == 1 ? "" : "s");
+}
+
+LK_INIT_HOOK(acpi_numa, &platform_init_acpi_numa, LK_INIT_LEVEL_VM + 2);
+
+/* @brief Return the NUMA node of the cpu with the given APIC ID
+ *
+ * @return The node, or 0 if the SRAT didn't say.
+ */
+uint platform_numa_node_of_apic_id(uint32_t apic_id) {
+    for (uint i = 0; i < numa_cpu_count; i++) {
+        if (numa_cpus[i].apic_id == apic_id)
+            return numa_cpus[i].node;
+    }
+    return 0;
+}
+
 static zx_status_t acpi_get_madt_record_limits(uintptr_t* start, uintptr_t* end) {
     ACPI_TABLE_HEADER* table = NULL;
     ACPI_STATUS status = AcpiGetTable((char*)ACPI_SIG_MADT, 1, &table);
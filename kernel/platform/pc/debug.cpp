@@ -173,7 +173,9 @@ void platform_dputs(const char* str, size_t len) {
 }
 
 int platform_dgetc(char* c, bool wait) {
-    return static_cast<int>(cbuf_read_char(&console_input_buf, c, wait));
+    if (cbuf_read_char(&console_input_buf, c, wait) != 1)
+        return -1;
+    return 0;
 }
 
 // panic time polling IO for the panic shell
@@ -36,5 +36,6 @@ zx_status_t platform_enumerate_interrupt_source_overrides(
     uint32_t len,
     uint32_t* num_isos);
 zx_status_t platform_find_hpet(struct acpi_hpet_descriptor* hpet);
+uint platform_numa_node_of_apic_id(uint32_t apic_id);
 
 __END_CDECLS
@@ -10,6 +10,7 @@
 #include <arch/x86.h>
 #include <arch/x86/apic.h>
 #include <arch/x86/interrupts.h>
+#include <arch/x86/mp.h>
 #include <assert.h>
 #include <debug.h>
 #include <dev/interrupt.h>
@@ -174,6 +175,43 @@ zx_status_t configure_interrupt(unsigned int vector,
     return ZX_OK;
 }
 
+// Picks the CPU an interrupt with affinity |mask| is delivered to.  Interrupts
+// are delivered in physical destination mode, so only a single CPU can be
+// targeted; we take the lowest numbered online CPU in the mask.
+static zx_status_t x86_affinity_to_apic_id(cpu_mask_t mask, uint8_t* apic_id) {
+    mask &= mp_get_online_mask();
+    if (!mask)
+        return ZX_ERR_INVALID_ARGS;
+
+    uint32_t id = x86_cpu_num_to_apic_id(__builtin_ctz(mask));
+    // Neither the IOAPIC nor the MSI address format can address APIC IDs
+    // which need more than 8 bits without interrupt remapping.
+    if (id > 0xff)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    *apic_id = static_cast<uint8_t>(id);
+    return ZX_OK;
+}
+
+zx_status_t set_interrupt_affinity(unsigned int vector, cpu_mask_t mask) {
+    if (!apic_io_is_valid_irq(vector))
+        return ZX_ERR_INVALID_ARGS;
+
+    uint8_t apic_id;
+    zx_status_t status = x86_affinity_to_apic_id(mask, &apic_id);
+    if (status != ZX_OK)
+        return status;
+
+    spin_lock_saved_state_t state;
+    spin_lock_irqsave(&lock, state);
+
+    apic_io_configure_irq_dst(vector, DST_MODE_PHYSICAL, apic_id);
+
+    spin_unlock_irqrestore(&lock, state);
+
+    return ZX_OK;
+}
+
 zx_status_t get_interrupt_config(unsigned int vector,
                                  enum interrupt_trigger_mode* tm,
                                  enum interrupt_polarity* pol) {
@@ -293,6 +331,17 @@ void shutdown_interrupts(void) {
 }
 
 #ifdef WITH_DEV_PCIE
+// Compute the MSI target address for delivery to the Local APIC |apic_id|.
+// See section 10.11.1 of the Intel 64 and IA-32 Architectures Software
+// Developer's Manual Volume 3A.
+static uint32_t x86_msi_tgt_addr(uint8_t apic_id) {
+    uint32_t tgt_addr = 0xFEE00000;         // base addr
+    tgt_addr |= ((uint32_t)apic_id) << 12;  // Dest ID
+    tgt_addr |= 0x08;                       // Redir hint == 1
+    tgt_addr &= ~0x04;                      // Dest Mode == Physical
+    return tgt_addr;
+}
+
 zx_status_t x86_alloc_msi_block(uint requested_irqs,
                                 bool can_target_64bit,
                                 bool is_msix,
@@ -312,19 +361,9 @@ zx_status_t x86_alloc_msi_block(uint requested_irqs,
 
     res = p2ra_allocate_range(&x86_irq_vector_allocator, alloc_size, &alloc_start);
     if (res == ZX_OK) {
-        // Compute the target address.
-        // See section 10.11.1 of the Intel 64 and IA-32 Architectures Software
-        // Developer's Manual Volume 3A.
-        //
-        // TODO(johngro) : don't just bind this block to the Local APIC of the
-        // processor which is active when calling alloc_msi_block.  Instead,
-        // there should either be a system policy (like, always send to any
-        // processor, or just processor 0, or something), or the decision of
-        // which CPUs to bind to should be left to the caller.
-        uint32_t tgt_addr = 0xFEE00000;              // base addr
-        tgt_addr |= ((uint32_t)apic_bsp_id()) << 12; // Dest ID == the BSP APIC ID
-        tgt_addr |= 0x08;                            // Redir hint == 1
-        tgt_addr &= ~0x04;                           // Dest Mode == Physical
+        // Blocks start out targeting the BSP.  Drivers which want their
+        // interrupts elsewhere can move them with x86_set_msi_affinity.
+        uint32_t tgt_addr = x86_msi_tgt_addr(apic_bsp_id());
 
         // Compute the target data.
         // See section 10.11.2 of the Intel 64 and IA-32 Architectures Software
@@ -356,6 +395,18 @@ void x86_free_msi_block(pcie_msi_block_t* block) {
     memset(block, 0, sizeof(*block));
 }
 
+zx_status_t x86_set_msi_affinity(pcie_msi_block_t* block, cpu_mask_t mask) {
+    DEBUG_ASSERT(block && block->allocated);
+
+    uint8_t apic_id;
+    zx_status_t status = x86_affinity_to_apic_id(mask, &apic_id);
+    if (status != ZX_OK)
+        return status;
+
+    block->tgt_addr = x86_msi_tgt_addr(apic_id);
+    return ZX_OK;
+}
+
 void x86_register_msi_handler(const pcie_msi_block_t* block,
                               uint msi_id,
                               int_handler handler,
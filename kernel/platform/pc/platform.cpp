@@ -686,6 +686,10 @@ void platform_mexec(mexec_asm_func mexec_assembly, memmov_ops_t* ops,
     // Leaving PCI running will also leave DMA running which may cause memory
     // corruption after boot.
     // Disabling PCI may cause devices to fail to enumerate after boot.
+    // Make sure the APs and the PCIe bus driver are all set up before we
+    // start taking them down.
+    lk_init_wait_async();
+
     if (cmdline_get_bool("kernel.mexec-pci-shutdown", true)) {
         PcieBusDriver::GetDriver()->DisableBus();
     }
@@ -783,6 +787,11 @@ void platform_early_init(void) {
     platform_preserve_ramdisk();
 }
 
+// The apic ids of the APs left for platform_bringup_aps() to start, and how
+// many there are.
+static fbl::unique_ptr<uint32_t[]> ap_apic_ids;
+static uint32_t ap_count;
+
 static void platform_init_smp(void) {
     uint32_t num_cpus = 0;
 
@@ -872,6 +881,13 @@ static void platform_init_smp(void) {
 
     x86_init_smp(apic_ids.get(), num_cpus);
 
+    // now that the cpus are numbered, tell the pmm where they are
+    for (uint i = 0; i < num_cpus; ++i) {
+        int cpu = x86_apic_id_to_cpu_num(apic_ids[i]);
+        if (cpu >= 0)
+            pmm_set_cpu_node(cpu, platform_numa_node_of_apic_id(apic_ids[i]));
+    }
+
     // trim the boot cpu out of the apic id list before passing to the AP booting routine
     for (uint i = 0; i < num_cpus - 1; ++i) {
         if (apic_ids[i] == bsp_apic_id) {
@@ -880,9 +896,22 @@ static void platform_init_smp(void) {
         }
     }
 
-    x86_bringup_aps(apic_ids.get(), num_cpus - 1);
+    ap_apic_ids = fbl::move(apic_ids);
+    ap_count = num_cpus - 1;
 }
 
+// The APs are all started together, but waiting for them to report in takes
+// at least the 10ms between the INIT and STARTUP IPIs. Nothing up to and
+// including starting userspace needs them online, so the wait happens in its
+// own thread while the boot cpu carries on.
+static void platform_bringup_aps(uint level) {
+    if (ap_count > 0)
+        x86_bringup_aps(ap_apic_ids.get(), ap_count);
+    ap_apic_ids.reset();
+}
+
+LK_INIT_HOOK_ASYNC(bringup_aps, platform_bringup_aps, LK_INIT_LEVEL_PLATFORM);
+
 zx_status_t platform_mp_prep_cpu_unplug(uint cpu_id) {
     // TODO: Make sure the IOAPIC and PCI have nothing for this CPU
     return arch_mp_prep_cpu_unplug(cpu_id);
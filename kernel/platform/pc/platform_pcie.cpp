@@ -37,6 +37,10 @@ public:
         x86_free_msi_block(block);
     }
 
+    zx_status_t SetMsiAffinity(pcie_msi_block_t* block, cpu_mask_t mask) override {
+        return x86_set_msi_affinity(block, mask);
+    }
+
     void RegisterMsiHandler(const pcie_msi_block_t* block,
                             uint msi_id,
                             int_handler handler,
@@ -137,6 +141,8 @@ static void x86_pcie_init_hook(uint level) {
     }
 }
 
-LK_INIT_HOOK(x86_pcie_init, x86_pcie_init_hook, LK_INIT_LEVEL_PLATFORM);
+// Only the zx_pci_* syscalls and mexec use the bus driver, and they wait for
+// this to finish, so the rest of boot doesn't have to.
+LK_INIT_HOOK_ASYNC(x86_pcie_init, x86_pcie_init_hook, LK_INIT_LEVEL_PLATFORM);
 
 #endif // WITH_DEV_PCIE
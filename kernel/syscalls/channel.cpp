@@ -129,6 +129,82 @@ zx_status_t sys_channel_read(zx_handle_t handle_value, uint32_t options,
     return result;
 }
 
+zx_status_t sys_channel_read_many(zx_handle_t handle_value, uint32_t options,
+                                  user_inout_ptr<zx_channel_read_msg_t> user_msgs,
+                                  uint32_t num_msgs, user_out_ptr<uint32_t> actual) {
+    LTRACEF("handle %x msgs %p num_msgs %u\n", handle_value, user_msgs.get(), num_msgs);
+
+    if (options)
+        return ZX_ERR_INVALID_ARGS;
+    if (num_msgs == 0u || num_msgs > ZX_CHANNEL_MAX_BATCH_MSGS)
+        return ZX_ERR_OUT_OF_RANGE;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<ChannelDispatcher> channel;
+    zx_status_t result = up->GetDispatcherWithRights(handle_value, ZX_RIGHT_READ, &channel);
+    if (result != ZX_OK)
+        return result;
+
+    uint32_t max_sizes[ZX_CHANNEL_MAX_BATCH_MSGS];
+    uint32_t max_handle_counts[ZX_CHANNEL_MAX_BATCH_MSGS];
+    for (uint32_t ix = 0; ix != num_msgs; ++ix) {
+        zx_channel_read_msg_t m;
+        if (user_msgs.element_offset(ix).copy_from_user(&m) != ZX_OK)
+            return ZX_ERR_INVALID_ARGS;
+        max_sizes[ix] = m.num_bytes;
+        max_handle_counts[ix] = m.num_handles;
+    }
+
+    ChannelDispatcher::MessageList msgs;
+    uint32_t next_size = 0u;
+    uint32_t next_handle_count = 0u;
+    result = channel->ReadMany(num_msgs, max_sizes, max_handle_counts, &msgs,
+                               &next_size, &next_handle_count);
+    if (result == ZX_ERR_BUFFER_TOO_SMALL) {
+        // As with zx_channel_read(), report the size of the message that did not fit.
+        zx_channel_read_msg_t m;
+        if (user_msgs.copy_from_user(&m) != ZX_OK)
+            return ZX_ERR_INVALID_ARGS;
+        m.actual_bytes = next_size;
+        m.actual_handles = next_handle_count;
+        if (user_msgs.copy_to_user(m) != ZX_OK)
+            return ZX_ERR_INVALID_ARGS;
+        return result;
+    }
+    if (result != ZX_OK)
+        return result;
+
+    // Each message is copied out as zx_channel_read() would, data before handles.
+    uint32_t count = 0u;
+    for (; !msgs.is_empty(); ++count) {
+        auto msg = msgs.pop_front();
+        auto user_msg = user_msgs.element_offset(count);
+
+        zx_channel_read_msg_t m;
+        if (user_msg.copy_from_user(&m) != ZX_OK)
+            return ZX_ERR_INVALID_ARGS;
+        m.actual_bytes = msg->data_size();
+        m.actual_handles = msg->num_handles();
+
+        if (m.actual_bytes > 0u) {
+            if (msg->CopyDataTo(make_user_out_ptr(m.bytes)) != ZX_OK)
+                return ZX_ERR_INVALID_ARGS;
+        }
+        if (m.actual_handles > 0u)
+            msg_get_handles(up, msg.get(), make_user_out_ptr(m.handles), m.actual_handles);
+        if (user_msg.copy_to_user(m) != ZX_OK)
+            return ZX_ERR_INVALID_ARGS;
+
+        ktrace(TAG_CHANNEL_READ, (uint32_t)channel->get_koid(),
+               m.actual_bytes, m.actual_handles, 0);
+    }
+
+    if (actual)
+        return actual.copy_to_user(count);
+    return ZX_OK;
+}
+
 static zx_status_t channel_read_out(ProcessDispatcher* up,
                                     fbl::unique_ptr<MessagePacket> reply,
                                     zx_channel_call_args_t* args,
@@ -280,6 +356,75 @@ zx_status_t sys_channel_write(zx_handle_t handle_value, uint32_t options,
     return ZX_OK;
 }
 
+zx_status_t sys_channel_write_many(zx_handle_t handle_value, uint32_t options,
+                                   user_in_ptr<const zx_channel_write_msg_t> user_msgs,
+                                   uint32_t num_msgs, user_out_ptr<uint32_t> actual) {
+    LTRACEF("handle %x msgs %p num_msgs %u\n", handle_value, user_msgs.get(), num_msgs);
+
+    if (options)
+        return ZX_ERR_INVALID_ARGS;
+    if (num_msgs == 0u || num_msgs > ZX_CHANNEL_MAX_BATCH_MSGS)
+        return ZX_ERR_OUT_OF_RANGE;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<ChannelDispatcher> channel;
+    zx_status_t result = up->GetDispatcherWithRights(handle_value, ZX_RIGHT_WRITE, &channel);
+    if (result != ZX_OK)
+        return result;
+
+    // Build every packet before touching the channel. A bad message ends the
+    // batch; the messages before it are still written.
+    ChannelDispatcher::MessageList msgs;
+    uint32_t count = 0u;
+    uint32_t total_bytes = 0u;
+    uint32_t total_handles = 0u;
+    for (; count != num_msgs; ++count) {
+        zx_channel_write_msg_t m;
+        if (user_msgs.element_offset(count).copy_from_user(&m) != ZX_OK) {
+            result = ZX_ERR_INVALID_ARGS;
+            break;
+        }
+
+        fbl::unique_ptr<MessagePacket> msg;
+        result = MessagePacket::Create(make_user_in_ptr(m.bytes), m.num_bytes, m.num_handles, &msg);
+        if (result != ZX_OK)
+            break;
+
+        if (m.num_handles > 0u) {
+            zx_handle_t handles[kMaxMessageHandles];
+            result = msg_put_handles(up, msg.get(), handles, make_user_in_ptr(m.handles),
+                                     m.num_handles, static_cast<Dispatcher*>(channel.get()));
+            if (result)
+                break;
+        }
+
+        total_bytes += m.num_bytes;
+        total_handles += m.num_handles;
+        msgs.push_back(fbl::move(msg));
+    }
+    if (count == 0u)
+        return result;
+
+    result = channel->WriteMany(&msgs);
+    if (result != ZX_OK) {
+        // Write failed, put back the handles into this process.
+        AutoLock lock(up->handle_table_lock());
+        for (auto& msg : msgs) {
+            msg.set_owns_handles(false);
+            for (uint32_t ix = 0; ix != msg.num_handles(); ++ix)
+                up->AddHandleLocked(HandleOwner(msg.handles()[ix]));
+        }
+        return result;
+    }
+
+    ktrace(TAG_CHANNEL_WRITE, (uint32_t)channel->get_koid(), total_bytes, total_handles, 0);
+
+    if (actual)
+        return actual.copy_to_user(count);
+    return ZX_OK;
+}
+
 zx_status_t sys_channel_call_noretry(zx_handle_t handle_value, uint32_t options,
                                      zx_time_t deadline,
                                      user_in_ptr<const zx_channel_call_args_t> user_args,
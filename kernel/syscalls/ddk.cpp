@@ -22,6 +22,7 @@
 #include <object/interrupt_dispatcher.h>
 #include <object/interrupt_event_dispatcher.h>
 #include <object/iommu_dispatcher.h>
+#include <object/port_dispatcher.h>
 #include <object/process_dispatcher.h>
 #include <object/resources.h>
 #include <object/vm_object_dispatcher.h>
@@ -136,6 +137,52 @@ zx_status_t sys_interrupt_signal(zx_handle_t handle, uint32_t slot, zx_time_t ti
     return interrupt->UserSignal(slot, timestamp);
 }
 
+zx_status_t sys_interrupt_set_affinity(zx_handle_t handle, uint32_t slot, uint64_t cpu_mask) {
+    LTRACEF("handle %x\n", handle);
+
+    auto up = ProcessDispatcher::GetCurrent();
+    fbl::RefPtr<InterruptDispatcher> interrupt;
+    zx_status_t status = up->GetDispatcher(handle, &interrupt);
+    if (status != ZX_OK)
+        return status;
+
+    // Bits for CPUs the kernel can't have are ignored, like offline ones.
+    return interrupt->SetAffinity(slot, static_cast<cpu_mask_t>(cpu_mask));
+}
+
+zx_status_t sys_interrupt_bind_port(zx_handle_t handle, zx_handle_t port_handle,
+                                    uint64_t key, uint32_t options) {
+    LTRACEF("handle %x\n", handle);
+
+    if (options != 0u)
+        return ZX_ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+    fbl::RefPtr<InterruptDispatcher> interrupt;
+    zx_status_t status = up->GetDispatcher(handle, &interrupt);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<PortDispatcher> port;
+    status = up->GetDispatcherWithRights(port_handle, ZX_RIGHT_WRITE, &port);
+    if (status != ZX_OK)
+        return status;
+
+    return interrupt->BindPort(fbl::move(port), key);
+}
+
+zx_status_t sys_interrupt_ack(zx_handle_t handle) {
+    LTRACEF("handle %x\n", handle);
+
+    auto up = ProcessDispatcher::GetCurrent();
+    fbl::RefPtr<InterruptDispatcher> interrupt;
+    zx_status_t status = up->GetDispatcher(handle, &interrupt);
+    if (status != ZX_OK)
+        return status;
+
+    return interrupt->Ack();
+}
+
 zx_status_t sys_vmo_create_contiguous(zx_handle_t hrsrc, size_t size,
                                       uint32_t alignment_log2,
                                       user_out_handle* out) {
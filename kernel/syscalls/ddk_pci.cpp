@@ -16,6 +16,7 @@
 #include <vm/vm_object_physical.h>
 #include <lib/pci/pio.h>
 #include <lib/user_copy/user_ptr.h>
+#include <lk/init.h>
 #include <object/handle.h>
 #include <object/process_dispatcher.h>
 #include <object/resources.h>
@@ -104,6 +105,9 @@ zx_status_t sys_pci_add_subtract_io_range(zx_handle_t handle, bool mmio, uint64_
         return status;
     }
 
+    // The bus driver is set up by an async init hook.
+    lk_init_wait_async();
+
     auto pcie = PcieBusDriver::GetDriver();
     if (pcie == nullptr) {
         return ZX_ERR_BAD_STATE;
@@ -132,6 +136,8 @@ zx_status_t sys_pci_init(zx_handle_t handle, user_in_ptr<const zx_pci_init_arg_t
         return ZX_ERR_INVALID_ARGS;
     }
 
+    lk_init_wait_async();
+
     auto pcie = PcieBusDriver::GetDriver();
     if (pcie == nullptr)
         return ZX_ERR_BAD_STATE;
@@ -337,6 +343,13 @@ zx_status_t sys_pci_config_read(zx_handle_t handle, uint16_t offset, size_t widt
         return ZX_ERR_INVALID_ARGS;
     }
 
+    // Registers which cannot change (IDs, class codes, capability list links)
+    // are answered from the device's shadow copy without touching the bus.
+    uint32_t shadowed_val;
+    if (device->config_shadow().Read(offset, width, &shadowed_val)) {
+        return out_val.copy_to_user(shadowed_val);
+    }
+
     // Based on the width passed in we can use the type safety of the PciConfig layer
     // to ensure we're getting correctly sized data back and return errors in the PIO
     // cases.
@@ -30,6 +30,7 @@
 #define LOCAL_TRACE 0
 
 constexpr uint32_t kMaxDebugWriteSize = 256u;
+constexpr uint32_t kMaxDebugReadSize = 256u;
 
 zx_status_t sys_debug_read(zx_handle_t handle, user_out_ptr<void> ptr, uint32_t len) {
     LTRACEF("ptr %p\n", ptr.get());
@@ -40,23 +41,25 @@ zx_status_t sys_debug_read(zx_handle_t handle, user_out_ptr<void> ptr, uint32_t
         return status;
     }
 
-    // TODO: remove this cast.
-    auto uptr = ptr.reinterpret<uint8_t>();
+    if (len > kMaxDebugReadSize)
+        len = kMaxDebugReadSize;
 
+    // Wait for the first character, then hand back whatever else has already
+    // arrived rather than waiting for all |len| of them.
+    char buf[kMaxDebugReadSize];
     uint32_t idx = 0;
     for (; idx < len; ++idx) {
-        int c = getchar();
-        if (c < 0)
+        char c;
+        if (platform_dgetc(&c, idx == 0) < 0)
             break;
 
         if (c == '\r')
             c = '\n';
-
-        auto cur = uptr.byte_offset(idx);
-        if (cur.copy_to_user(static_cast<uint8_t>(c)) != ZX_OK)
-            break;
+        buf[idx] = c;
     }
-    // TODO: fix this cast, which can overflow.
+
+    if (ptr.reinterpret<char>().copy_array_to_user(buf, idx) != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
     return static_cast<zx_status_t>(idx);
 }
 
@@ -144,14 +147,11 @@ zx_status_t sys_ktrace_write(zx_handle_t handle, uint32_t event_id, uint32_t arg
         return ZX_ERR_INVALID_ARGS;
     }
 
-    uint32_t* args = static_cast<uint32_t*>(ktrace_open(TAG_PROBE_24(event_id)));
-    if (!args) {
+    uint32_t args[2] = { arg0, arg1 };
+    if (!ktrace_write(TAG_PROBE_24(event_id), args)) {
         //  There is not a single reason for failure. Assume it reached the end.
         return ZX_ERR_UNAVAILABLE;
     }
-
-    args[0] = arg0;
-    args[1] = arg1;
     return ZX_OK;
 }
 
@@ -15,6 +15,7 @@
 #include <object/fifo_dispatcher.h>
 #include <object/handle.h>
 #include <object/process_dispatcher.h>
+#include <object/vm_object_dispatcher.h>
 
 #include <zircon/syscalls/policy.h>
 #include <fbl/ref_ptr.h>
@@ -84,3 +85,42 @@ zx_status_t sys_fifo_read(zx_handle_t handle, user_out_ptr<void> entries, size_t
 
     return ZX_OK;
 }
+
+zx_status_t sys_fifo_get_ring(zx_handle_t handle, user_out_handle* vmo_out,
+                              user_out_ptr<uint32_t> index_out) {
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<FifoDispatcher> fifo;
+    zx_status_t status = up->GetDispatcherWithRights(handle, ZX_RIGHT_READ | ZX_RIGHT_WRITE, &fifo);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<VmObject> vmo;
+    uint32_t index;
+    status = fifo->GetRing(&vmo, &index);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<Dispatcher> dispatcher;
+    zx_rights_t rights;
+    status = VmObjectDispatcher::Create(fbl::move(vmo), &dispatcher, &rights);
+    if (status != ZX_OK)
+        return status;
+
+    status = index_out.copy_to_user(index);
+    if (status != ZX_OK)
+        return status;
+
+    return vmo_out->make(fbl::move(dispatcher), rights & ~ZX_RIGHT_EXECUTE);
+}
+
+zx_status_t sys_fifo_ring_update(zx_handle_t handle) {
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<FifoDispatcher> fifo;
+    zx_status_t status = up->GetDispatcherWithRights(handle, ZX_RIGHT_WRITE, &fifo);
+    if (status != ZX_OK)
+        return status;
+
+    return fifo->RingUpdate();
+}
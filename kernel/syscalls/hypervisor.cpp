@@ -20,7 +20,7 @@
 
 zx_status_t sys_guest_create(zx_handle_t resource, uint32_t options, zx_handle_t physmem_vmo,
                              user_out_handle* out) {
-    if (options != 0u)
+    if (options & ~ZX_GUEST_OPT_POPULATE)
         return ZX_ERR_INVALID_ARGS;
 
     zx_status_t status = validate_resource(resource, ZX_RSRC_KIND_HYPERVISOR);
@@ -35,7 +35,7 @@ zx_status_t sys_guest_create(zx_handle_t resource, uint32_t options, zx_handle_t
         return status;
 
     fbl::RefPtr<Dispatcher> dispatcher;
-    status = GuestDispatcher::Create(physmem->vmo(), &dispatcher, &rights);
+    status = GuestDispatcher::Create(physmem->vmo(), options, &dispatcher, &rights);
     if (status != ZX_OK)
         return status;
 
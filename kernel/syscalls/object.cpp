@@ -8,6 +8,7 @@
 #include <inttypes.h>
 #include <trace.h>
 
+#include <kernel/lockprof.h>
 #include <kernel/mp.h>
 #include <kernel/stats.h>
 #include <vm/pmm.h>
@@ -18,11 +19,13 @@
 #include <object/diagnostics.h>
 #include <object/handle.h>
 #include <object/job_dispatcher.h>
+#include <object/port_dispatcher.h>
 #include <object/process_dispatcher.h>
 #include <object/resource_dispatcher.h>
 #include <object/resources.h>
 #include <object/thread_dispatcher.h>
 #include <object/vm_address_region_dispatcher.h>
+#include <object/vm_object_dispatcher.h>
 
 #include <fbl/ref_ptr.h>
 
@@ -78,6 +81,36 @@ private:
     size_t avail_ = 0;
 };
 
+// Takes a snapshot of every process under a job.
+class SnapshotJobEnumerator final : public JobEnumerator {
+public:
+    SnapshotJobEnumerator(user_out_ptr<zx_info_process_snapshot_t> ptr, size_t max)
+        : ptr_(ptr), max_(max) {}
+
+    size_t get_avail() const { return avail_; }
+    size_t get_count() const { return count_; }
+
+private:
+    bool OnProcess(ProcessDispatcher* proc) override {
+        avail_++;
+        if (count_ < max_) {
+            zx_info_process_snapshot_t info;
+            proc->GetSnapshot(&info);
+            if (ptr_.copy_array_to_user(&info, 1, count_) != ZX_OK) {
+                return false;
+            }
+            count_++;
+        }
+        return true;
+    }
+
+    const user_out_ptr<zx_info_process_snapshot_t> ptr_;
+    const size_t max_;
+
+    size_t count_ = 0;
+    size_t avail_ = 0;
+};
+
 zx_status_t single_record_result(user_out_ptr<void> _buffer, size_t buffer_size,
                                  user_out_ptr<size_t> _actual,
                                  user_out_ptr<size_t> _avail,
@@ -238,6 +271,30 @@ zx_status_t sys_object_get_info(zx_handle_t handle, uint32_t topic,
             }
             return ZX_OK;
         }
+        case ZX_INFO_JOB_PROCESS_SNAPSHOT: {
+            fbl::RefPtr<JobDispatcher> job;
+            auto error = up->GetDispatcherWithRights(handle, ZX_RIGHT_ENUMERATE, &job);
+            if (error < 0)
+                return error;
+
+            size_t max = buffer_size / sizeof(zx_info_process_snapshot_t);
+            SnapshotJobEnumerator sje(_buffer.reinterpret<zx_info_process_snapshot_t>(), max);
+
+            // Every descendant, not just the direct children.
+            if (!job->EnumerateChildren(&sje, /* recurse */ true))
+                return ZX_ERR_INVALID_ARGS;
+            if (_actual) {
+                zx_status_t status = _actual.copy_to_user(sje.get_count());
+                if (status != ZX_OK)
+                    return status;
+            }
+            if (_avail) {
+                zx_status_t status = _avail.copy_to_user(sje.get_avail());
+                if (status != ZX_OK)
+                    return status;
+            }
+            return ZX_OK;
+        }
         case ZX_INFO_THREAD: {
             // TODO(ZX-458): Handle forward/backward compatibility issues
             // with changes to the struct.
@@ -395,6 +452,18 @@ zx_status_t sys_object_get_info(zx_handle_t handle, uint32_t topic,
             return single_record_result(
                 _buffer, buffer_size, _actual, _avail, &info, sizeof(info));
         }
+        case ZX_INFO_PORT: {
+            fbl::RefPtr<PortDispatcher> port;
+            zx_status_t status = up->GetDispatcher(handle, &port);
+            if (status != ZX_OK)
+                return status;
+
+            zx_info_port_t info;
+            port->GetInfo(&info);
+
+            return single_record_result(
+                _buffer, buffer_size, _actual, _avail, &info, sizeof(info));
+        }
         case ZX_INFO_CPU_STATS: {
             auto status = validate_resource(handle, ZX_RSRC_KIND_ROOT);
             if (status != ZX_OK)
@@ -403,6 +472,8 @@ zx_status_t sys_object_get_info(zx_handle_t handle, uint32_t topic,
             // TODO: figure out a better handle to hang this off to and push this copy code into
             // that dispatcher.
 
+            static_assert(ZX_INFO_CPU_IDLE_STATES == IDLE_STATES_MAX, "");
+
             size_t num_cpus = arch_max_num_cpus();
             size_t num_space_for = buffer_size / sizeof(zx_info_cpu_stats_t);
             size_t num_to_copy = MIN(num_cpus, num_space_for);
@@ -446,6 +517,14 @@ zx_status_t sys_object_get_info(zx_handle_t handle, uint32_t topic,
                 stats.syscalls = cpu->stats.syscalls;
                 stats.reschedule_ipis = cpu->stats.reschedule_ipis;
                 stats.generic_ipis = cpu->stats.generic_ipis;
+                stats.channel_msg_cache_hits = cpu->stats.channel_msg_cache_hits;
+                stats.channel_msg_cache_misses = cpu->stats.channel_msg_cache_misses;
+                stats.handoffs = cpu->stats.handoffs;
+                stats.handoff_timeouts = cpu->stats.handoff_timeouts;
+                for (uint j = 0; j < IDLE_STATES_MAX; j++) {
+                    stats.idle_state_entries[j] = cpu->stats.idle_state_entries[j];
+                    stats.idle_state_time[j] = cpu->stats.idle_state_time[j];
+                }
 
                 // copy out one at a time
                 if (cpu_buf.copy_array_to_user(&stats, 1, i) != ZX_OK)
@@ -464,6 +543,52 @@ zx_status_t sys_object_get_info(zx_handle_t handle, uint32_t topic,
             }
             return ZX_OK;
         }
+        case ZX_INFO_CPU_SCHED_HISTOGRAMS: {
+            auto status = validate_resource(handle, ZX_RSRC_KIND_ROOT);
+            if (status != ZX_OK)
+                return status;
+
+            static_assert(ZX_INFO_SCHED_LATENCY_BUCKETS == SCHED_HIST_LATENCY_BUCKETS, "");
+            static_assert(ZX_INFO_SCHED_DEPTH_BUCKETS == SCHED_HIST_DEPTH_BUCKETS, "");
+            static_assert(ZX_INFO_SCHED_SLICE_BUCKETS == SCHED_HIST_SLICE_BUCKETS, "");
+
+            size_t num_cpus = arch_max_num_cpus();
+            size_t num_space_for = buffer_size / sizeof(zx_info_cpu_sched_histograms_t);
+            size_t num_to_copy = MIN(num_cpus, num_space_for);
+
+            user_out_ptr<zx_info_cpu_sched_histograms_t> hist_buf =
+                _buffer.reinterpret<zx_info_cpu_sched_histograms_t>();
+
+            for (unsigned int i = 0; i < static_cast<unsigned int>(num_to_copy); i++) {
+                const auto& hist = percpu[i].stats.sched_hist;
+
+                // same caveat as ZX_INFO_CPU_STATS, the buckets are read without a lock
+                zx_info_cpu_sched_histograms_t info = {};
+                info.cpu_number = i;
+                info.flags = mp_is_cpu_online(i) ? ZX_INFO_CPU_STATS_FLAG_ONLINE : 0;
+                for (size_t b = 0; b < SCHED_HIST_LATENCY_BUCKETS; b++)
+                    info.wakeup_latency[b] = hist.wakeup_latency[b];
+                for (size_t b = 0; b < SCHED_HIST_DEPTH_BUCKETS; b++)
+                    info.run_queue_depth[b] = hist.run_queue_depth[b];
+                for (size_t b = 0; b < SCHED_HIST_SLICE_BUCKETS; b++)
+                    info.slice_usage[b] = hist.slice_usage[b];
+
+                if (hist_buf.copy_array_to_user(&info, 1, i) != ZX_OK)
+                    return ZX_ERR_INVALID_ARGS;
+            }
+
+            if (_actual) {
+                zx_status_t status = _actual.copy_to_user(num_to_copy);
+                if (status != ZX_OK)
+                    return status;
+            }
+            if (_avail) {
+                zx_status_t status = _avail.copy_to_user(num_cpus);
+                if (status != ZX_OK)
+                    return status;
+            }
+            return ZX_OK;
+        }
         case ZX_INFO_KMEM_STATS: {
             auto status = validate_resource(handle, ZX_RSRC_KIND_ROOT);
             if (status != ZX_OK)
@@ -541,12 +666,72 @@ zx_status_t sys_object_get_info(zx_handle_t handle, uint32_t topic,
             return single_record_result(
                 _buffer, buffer_size, _actual, _avail, &info, sizeof(info));
         }
+        case ZX_INFO_LOCK_PROFILE: {
+#if WITH_LOCK_PROFILING
+            auto status = validate_resource(handle, ZX_RSRC_KIND_ROOT);
+            if (status != ZX_OK)
+                return status;
+
+            static_assert(ZX_INFO_LOCK_KIND_MUTEX == LOCKPROF_KIND_MUTEX, "");
+            static_assert(ZX_INFO_LOCK_KIND_SPIN == LOCKPROF_KIND_SPIN, "");
+
+            size_t num_space_for = buffer_size / sizeof(zx_info_lock_profile_t);
+            size_t num_copied = 0;
+            size_t num_sites = 0;
+
+            user_out_ptr<zx_info_lock_profile_t> prof_buf =
+                _buffer.reinterpret<zx_info_lock_profile_t>();
+
+            for (size_t i = 0; i < LOCKPROF_SITES; i++) {
+                lockprof_stats stats;
+                if (!lockprof_read(i, &stats))
+                    continue;
+                num_sites++;
+                if (num_copied == num_space_for)
+                    continue;
+
+                zx_info_lock_profile_t info = {};
+                info.caller = stats.caller;
+                info.lock = stats.lock;
+                info.kind = stats.kind;
+                info.acquires = stats.acquires;
+                info.contended = stats.contended;
+                info.wait_total = stats.wait_total;
+                info.wait_max = stats.wait_max;
+                info.hold_total = stats.hold_total;
+                info.hold_max = stats.hold_max;
+
+                if (prof_buf.copy_array_to_user(&info, 1, num_copied) != ZX_OK)
+                    return ZX_ERR_INVALID_ARGS;
+                num_copied++;
+            }
+
+            if (_actual) {
+                zx_status_t status = _actual.copy_to_user(num_copied);
+                if (status != ZX_OK)
+                    return status;
+            }
+            if (_avail) {
+                zx_status_t status = _avail.copy_to_user(num_sites);
+                if (status != ZX_OK)
+                    return status;
+            }
+            return ZX_OK;
+#else
+            return ZX_ERR_NOT_SUPPORTED;
+#endif
+        }
 
         default:
             return ZX_ERR_NOT_SUPPORTED;
     }
 }
 
+// the vm objects take the policy values straight from the property
+static_assert(ZX_VMO_NUMA_POLICY_LOCAL == PMM_NODE_POLICY_LOCAL, "");
+static_assert(ZX_VMO_NUMA_POLICY_INTERLEAVE == PMM_NODE_POLICY_INTERLEAVE, "");
+static_assert(ZX_VMO_NUMA_POLICY_BIND == PMM_NODE_POLICY_BIND, "");
+
 zx_status_t sys_object_get_property(zx_handle_t handle_value, uint32_t property,
                                     user_out_ptr<void> _value, size_t size) {
     if (!_value)
@@ -619,6 +804,26 @@ zx_status_t sys_object_get_property(zx_handle_t handle_value, uint32_t property,
                 return status;
             return ZX_OK;
         }
+        case ZX_PROP_VMO_NUMA_POLICY: {
+            if (size != sizeof(zx_vmo_numa_policy_t))
+                return ZX_ERR_BUFFER_TOO_SMALL;
+            auto vmo = DownCastDispatcher<VmObjectDispatcher>(&dispatcher);
+            if (!vmo)
+                return ZX_ERR_WRONG_TYPE;
+            zx_vmo_numa_policy_t value;
+            zx_status_t status = vmo->vmo()->GetNodePolicy(&value.policy, &value.node);
+            if (status != ZX_OK)
+                return status;
+            return _value.reinterpret<zx_vmo_numa_policy_t>().copy_to_user(value);
+        }
+        case ZX_PROP_THREAD_IDLE_LATENCY: {
+            if (size != sizeof(zx_duration_t))
+                return ZX_ERR_BUFFER_TOO_SMALL;
+            auto thread = DownCastDispatcher<ThreadDispatcher>(&dispatcher);
+            if (!thread)
+                return ZX_ERR_WRONG_TYPE;
+            return _value.reinterpret<zx_duration_t>().copy_to_user(thread->idle_latency());
+        }
         default:
             return ZX_ERR_INVALID_ARGS;
     }
@@ -699,6 +904,31 @@ zx_status_t sys_object_set_property(zx_handle_t handle_value, uint32_t property,
             return job->set_importance(
                 static_cast<zx_job_importance_t>(value));
         }
+        case ZX_PROP_VMO_NUMA_POLICY: {
+            if (size != sizeof(zx_vmo_numa_policy_t))
+                return ZX_ERR_BUFFER_TOO_SMALL;
+            auto vmo = DownCastDispatcher<VmObjectDispatcher>(&dispatcher);
+            if (!vmo)
+                return ZX_ERR_WRONG_TYPE;
+            zx_vmo_numa_policy_t value;
+            zx_status_t status = _value.reinterpret<const zx_vmo_numa_policy_t>()
+                .copy_from_user(&value);
+            if (status != ZX_OK)
+                return status;
+            return vmo->vmo()->SetNodePolicy(value.policy, value.node);
+        }
+        case ZX_PROP_THREAD_IDLE_LATENCY: {
+            if (size != sizeof(zx_duration_t))
+                return ZX_ERR_BUFFER_TOO_SMALL;
+            auto thread = DownCastDispatcher<ThreadDispatcher>(&dispatcher);
+            if (!thread)
+                return ZX_ERR_WRONG_TYPE;
+            zx_duration_t value;
+            zx_status_t status = _value.reinterpret<const zx_duration_t>().copy_from_user(&value);
+            if (status != ZX_OK)
+                return status;
+            return thread->SetIdleLatency(value);
+        }
     }
 
     return ZX_ERR_INVALID_ARGS;
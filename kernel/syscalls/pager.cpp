@@ -0,0 +1,134 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <err.h>
+#include <inttypes.h>
+#include <trace.h>
+
+#include <vm/vm_object_paged.h>
+
+#include <object/handle.h>
+#include <object/pager_dispatcher.h>
+#include <object/port_dispatcher.h>
+#include <object/process_dispatcher.h>
+#include <object/vm_object_dispatcher.h>
+
+#include <fbl/ref_ptr.h>
+
+#include <zircon/types.h>
+
+#include "priv.h"
+
+#define LOCAL_TRACE 0
+
+zx_status_t sys_pager_create(uint32_t options, user_out_handle* out) {
+    LTRACEF("options %#x\n", options);
+
+    fbl::RefPtr<Dispatcher> dispatcher;
+    zx_rights_t rights;
+    zx_status_t result = PagerDispatcher::Create(options, &dispatcher, &rights);
+    if (result != ZX_OK)
+        return result;
+
+    return out->make(fbl::move(dispatcher), rights);
+}
+
+zx_status_t sys_pager_create_vmo(zx_handle_t pager, zx_handle_t port, uint64_t key,
+                                 uint64_t size, uint32_t options, user_out_handle* out) {
+    LTRACEF("pager %x port %x key %#" PRIx64 " size %#" PRIx64 "\n", pager, port, key, size);
+
+    if (options != 0)
+        return ZX_ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+    zx_status_t status = up->QueryPolicy(ZX_POL_NEW_VMO);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<PagerDispatcher> pager_dispatcher;
+    status = up->GetDispatcherWithRights(pager, ZX_RIGHT_WRITE, &pager_dispatcher);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<PortDispatcher> port_dispatcher;
+    status = up->GetDispatcherWithRights(port, ZX_RIGHT_WRITE, &port_dispatcher);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<PageSource> src;
+    status = pager_dispatcher->CreateSource(fbl::move(port_dispatcher), key, &src);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<VmObject> vmo;
+    status = VmObjectPaged::CreateExternal(src, size, &vmo);
+    if (status != ZX_OK) {
+        // the source never made it into an object that would close it
+        src->Close();
+        return status;
+    }
+
+    fbl::RefPtr<Dispatcher> dispatcher;
+    zx_rights_t rights;
+    status = VmObjectDispatcher::Create(fbl::move(vmo), &dispatcher, &rights);
+    if (status != ZX_OK)
+        return status;
+
+    return out->make(fbl::move(dispatcher), rights);
+}
+
+zx_status_t sys_pager_supply_pages(zx_handle_t pager, zx_handle_t pager_vmo, uint64_t offset,
+                                   uint64_t length, zx_handle_t aux_vmo, uint64_t aux_offset) {
+    LTRACEF("pager %x vmo %x offset %#" PRIx64 " length %#" PRIx64 " aux %x offset %#" PRIx64 "\n",
+            pager, pager_vmo, offset, length, aux_vmo, aux_offset);
+
+    if (!IS_PAGE_ALIGNED(offset) || !IS_PAGE_ALIGNED(length) || !IS_PAGE_ALIGNED(aux_offset))
+        return ZX_ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<PagerDispatcher> pager_dispatcher;
+    zx_status_t status = up->GetDispatcherWithRights(pager, ZX_RIGHT_WRITE, &pager_dispatcher);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<VmObjectDispatcher> pager_vmo_dispatcher;
+    status = up->GetDispatcher(pager_vmo, &pager_vmo_dispatcher);
+    if (status != ZX_OK)
+        return status;
+
+    // the pages of the aux vmo are taken away from it, which is a write to it
+    fbl::RefPtr<VmObjectDispatcher> aux_vmo_dispatcher;
+    status = up->GetDispatcherWithRights(aux_vmo, ZX_RIGHT_READ | ZX_RIGHT_WRITE,
+                                         &aux_vmo_dispatcher);
+    if (status != ZX_OK)
+        return status;
+
+    // only the pager a vmo was created by gets to fill it in. pagers create
+    // the only objects that have a page source.
+    const fbl::RefPtr<VmObject>& vmo = pager_vmo_dispatcher->vmo();
+    if (!vmo->is_paged())
+        return ZX_ERR_INVALID_ARGS;
+    auto paged = static_cast<VmObjectPaged*>(vmo.get());
+    auto src = static_cast<const PagerSource*>(paged->page_source().get());
+    if (!src || src->pager() != pager_dispatcher.get())
+        return ZX_ERR_INVALID_ARGS;
+
+    const fbl::RefPtr<VmObject>& aux = aux_vmo_dispatcher->vmo();
+    if (!aux->is_paged())
+        return ZX_ERR_INVALID_ARGS;
+
+    if (length == 0)
+        return ZX_OK;
+
+    list_node pages;
+    list_initialize(&pages);
+    status = static_cast<VmObjectPaged*>(aux.get())->TakePages(aux_offset, length, &pages);
+    if (status != ZX_OK)
+        return status;
+
+    return paged->SupplyPages(offset, length, &pages);
+}
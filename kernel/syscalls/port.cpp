@@ -18,6 +18,7 @@
 #include <fbl/ref_ptr.h>
 
 #include <zircon/syscalls/policy.h>
+#include <zircon/syscalls/port.h>
 #include <zircon/types.h>
 
 #include "priv.h"
@@ -27,8 +28,7 @@
 zx_status_t sys_port_create(uint32_t options, user_out_handle* out) {
     LTRACEF("options %u\n", options);
 
-    // No options are supported.
-    if (options != 0u)
+    if (options & ~ZX_PORT_LIFO)
         return ZX_ERR_INVALID_ARGS;
 
     auto up = ProcessDispatcher::GetCurrent();
@@ -105,6 +105,41 @@ zx_status_t sys_port_wait(zx_handle_t handle, zx_time_t deadline,
     return ZX_OK;
 }
 
+zx_status_t sys_port_wait_many(zx_handle_t handle, zx_time_t deadline,
+                               user_out_ptr<zx_port_packet_t> packets_out, size_t count,
+                               user_out_ptr<size_t> actual) {
+    LTRACEF("handle %x count %zu\n", handle, count);
+
+    if (count == 0u || count > ZX_PORT_MAX_BATCH_PACKETS)
+        return ZX_ERR_OUT_OF_RANGE;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<PortDispatcher> port;
+    zx_status_t status = up->GetDispatcherWithRights(handle, ZX_RIGHT_READ, &port);
+    if (status != ZX_OK)
+        return status;
+
+    ktrace(TAG_PORT_WAIT, (uint32_t)port->get_koid(), 0, 0, 0);
+
+    zx_port_packet_t pp[ZX_PORT_MAX_BATCH_PACKETS];
+    size_t num_packets = 0u;
+    zx_status_t st = port->DequeueMany(deadline, pp, count, &num_packets);
+
+    ktrace(TAG_PORT_WAIT_DONE, (uint32_t)port->get_koid(), st, (uint32_t)num_packets, 0);
+
+    if (st != ZX_OK)
+        return st;
+
+    status = packets_out.copy_array_to_user(pp, num_packets);
+    if (status != ZX_OK)
+        return status;
+
+    if (actual)
+        return actual.copy_to_user(num_packets);
+    return ZX_OK;
+}
+
 zx_status_t sys_port_cancel(zx_handle_t handle, zx_handle_t source, uint64_t key) {
     auto up = ProcessDispatcher::GetCurrent();
 
@@ -0,0 +1,146 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <err.h>
+#include <inttypes.h>
+#include <trace.h>
+
+#include <object/handle.h>
+#include <object/process_dispatcher.h>
+#include <object/ring_dispatcher.h>
+#include <object/vm_object_dispatcher.h>
+
+#include <fbl/limits.h>
+#include <fbl/ref_ptr.h>
+
+#include <zircon/syscalls/ring.h>
+#include <zircon/types.h>
+
+#include "priv.h"
+
+#define LOCAL_TRACE 0
+
+namespace {
+
+template <typename T>
+user_in_ptr<const T> in_arg(uint64_t arg) {
+    return make_user_in_ptr(reinterpret_cast<const T*>(static_cast<uintptr_t>(arg)));
+}
+
+template <typename T>
+user_out_ptr<T> out_arg(uint64_t arg) {
+    return make_user_out_ptr(reinterpret_cast<T*>(static_cast<uintptr_t>(arg)));
+}
+
+bool fits_u32(uint64_t arg) {
+    return arg <= fbl::numeric_limits<uint32_t>::max();
+}
+
+// Runs one submission as the system call it stands for, on behalf of the
+// thread that entered the ring. See zircon/syscalls/ring.h for the layout
+// of each operation's arguments.
+zx_status_t ExecuteRingOp(const zx_ring_sqe_t& sqe) {
+    const uint64_t* args = sqe.args;
+
+    switch (sqe.op) {
+    case ZX_RING_OP_NOP:
+        return ZX_OK;
+
+    case ZX_RING_OP_CHANNEL_WRITE:
+        if (!fits_u32(args[1]) || !fits_u32(args[3]))
+            return ZX_ERR_INVALID_ARGS;
+        return sys_channel_write(sqe.handle, 0u,
+                                 in_arg<void>(args[0]), static_cast<uint32_t>(args[1]),
+                                 in_arg<zx_handle_t>(args[2]), static_cast<uint32_t>(args[3]));
+
+    case ZX_RING_OP_CHANNEL_READ:
+        if (!fits_u32(args[2]) || !fits_u32(args[3]))
+            return ZX_ERR_INVALID_ARGS;
+        return sys_channel_read(sqe.handle, 0u,
+                                out_arg<void>(args[0]), out_arg<zx_handle_t>(args[1]),
+                                static_cast<uint32_t>(args[2]), static_cast<uint32_t>(args[3]),
+                                out_arg<uint32_t>(args[4]), out_arg<uint32_t>(args[5]));
+
+    case ZX_RING_OP_VMO_READ:
+        return sys_vmo_read(sqe.handle, out_arg<void>(args[0]), args[1],
+                            static_cast<size_t>(args[2]), out_arg<size_t>(args[3]));
+
+    case ZX_RING_OP_VMO_WRITE:
+        return sys_vmo_write(sqe.handle, in_arg<void>(args[0]), args[1],
+                             static_cast<size_t>(args[2]), out_arg<size_t>(args[3]));
+
+    case ZX_RING_OP_PORT_QUEUE:
+        return sys_port_queue(sqe.handle, in_arg<zx_port_packet_t>(args[0]), 1u);
+
+    case ZX_RING_OP_OBJECT_SIGNAL:
+        if (!fits_u32(args[0]) || !fits_u32(args[1]))
+            return ZX_ERR_INVALID_ARGS;
+        return sys_object_signal(sqe.handle, static_cast<uint32_t>(args[0]),
+                                 static_cast<uint32_t>(args[1]));
+
+    case ZX_RING_OP_OBJECT_SIGNAL_PEER:
+        if (!fits_u32(args[0]) || !fits_u32(args[1]))
+            return ZX_ERR_INVALID_ARGS;
+        return sys_object_signal_peer(sqe.handle, static_cast<uint32_t>(args[0]),
+                                      static_cast<uint32_t>(args[1]));
+
+    default:
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+}
+
+} // namespace
+
+zx_status_t sys_ring_create(uint32_t options, user_out_handle* out, user_out_handle* vmo_out) {
+    LTRACEF("options %#x\n", options);
+
+    auto up = ProcessDispatcher::GetCurrent();
+    zx_status_t status = up->QueryPolicy(ZX_POL_NEW_VMO);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<Dispatcher> dispatcher;
+    zx_rights_t rights;
+    fbl::RefPtr<VmObject> vmo;
+    status = RingDispatcher::Create(options, &dispatcher, &rights, &vmo);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<Dispatcher> vmo_dispatcher;
+    zx_rights_t vmo_rights;
+    status = VmObjectDispatcher::Create(fbl::move(vmo), &vmo_dispatcher, &vmo_rights);
+    if (status != ZX_OK)
+        return status;
+
+    status = out->make(fbl::move(dispatcher), rights);
+    if (status != ZX_OK)
+        return status;
+    return vmo_out->make(fbl::move(vmo_dispatcher), vmo_rights & ~ZX_RIGHT_EXECUTE);
+}
+
+zx_status_t sys_ring_enter(zx_handle_t handle, uint32_t options, uint32_t count,
+                           user_out_ptr<uint32_t> actual_out) {
+    LTRACEF("handle %x count %u\n", handle, count);
+
+    if (options != 0)
+        return ZX_ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<RingDispatcher> ring;
+    zx_status_t status = up->GetDispatcherWithRights(handle, ZX_RIGHT_WRITE, &ring);
+    if (status != ZX_OK)
+        return status;
+
+    uint32_t actual;
+    status = ring->Enter(count, ExecuteRingOp, &actual);
+    if (status != ZX_OK)
+        return status;
+
+    if (actual_out)
+        return actual_out.copy_to_user(actual);
+    return ZX_OK;
+}
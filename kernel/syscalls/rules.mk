@@ -13,6 +13,7 @@ MODULE_DEPS := \
     kernel/lib/console \
     kernel/lib/crypto \
     kernel/lib/fbl \
+    kernel/lib/iovec \
     kernel/lib/pci \
     kernel/lib/user_copy \
     kernel/lib/vdso \
@@ -32,8 +33,10 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/zircon.cpp \
     $(LOCAL_DIR)/object.cpp \
     $(LOCAL_DIR)/object_wait.cpp \
+    $(LOCAL_DIR)/pager.cpp \
     $(LOCAL_DIR)/port.cpp \
     $(LOCAL_DIR)/resource.cpp \
+    $(LOCAL_DIR)/ring.cpp \
     $(LOCAL_DIR)/socket.cpp \
     $(LOCAL_DIR)/system.cpp \
     $(LOCAL_DIR)/bootdata_unittest.cpp \
@@ -17,6 +17,7 @@
 #include <object/handle.h>
 #include <object/process_dispatcher.h>
 #include <object/socket_dispatcher.h>
+#include <object/vm_object_dispatcher.h>
 
 #include <zircon/syscalls/policy.h>
 #include <fbl/auto_lock.h>
@@ -169,3 +170,44 @@ zx_status_t sys_socket_accept(zx_handle_t handle, user_out_handle* out) {
 
     return out->transfer(fbl::move(outhandle));
 }
+
+zx_status_t sys_socket_get_ring(zx_handle_t handle, user_out_handle* vmo_out,
+                                user_out_ptr<uint32_t> index_out) {
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<SocketDispatcher> socket;
+    zx_status_t status = up->GetDispatcherWithRights(handle, ZX_RIGHT_READ | ZX_RIGHT_WRITE,
+                                                     &socket);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<VmObject> vmo;
+    uint32_t index;
+    status = socket->GetRing(&vmo, &index);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<Dispatcher> dispatcher;
+    zx_rights_t rights;
+    status = VmObjectDispatcher::Create(fbl::move(vmo), &dispatcher, &rights);
+    if (status != ZX_OK)
+        return status;
+
+    status = index_out.copy_to_user(index);
+    if (status != ZX_OK)
+        return status;
+
+    // The ring is only ever mapped for data.
+    return vmo_out->make(fbl::move(dispatcher), rights & ~ZX_RIGHT_EXECUTE);
+}
+
+zx_status_t sys_socket_ring_update(zx_handle_t handle) {
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<SocketDispatcher> socket;
+    zx_status_t status = up->GetDispatcherWithRights(handle, ZX_RIGHT_WRITE, &socket);
+    if (status != ZX_OK)
+        return status;
+
+    return socket->RingUpdate();
+}
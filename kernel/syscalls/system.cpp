@@ -17,10 +17,13 @@
 #include <vm/vm_aspace.h>
 #include <zircon/boot/bootdata.h>
 #include <zircon/compiler.h>
+#include <zircon/rights.h>
 #include <zircon/syscalls/resource.h>
 #include <zircon/syscalls/system.h>
 #include <zircon/types.h>
 #include <mexec.h>
+#include <object/event_dispatcher.h>
+#include <object/job_dispatcher.h>
 #include <object/resources.h>
 #include <object/process_dispatcher.h>
 #include <object/vm_object_dispatcher.h>
@@ -28,6 +31,7 @@
 #include <string.h>
 #include <trace.h>
 
+#include "priv.h"
 #include "system_priv.h"
 
 #define LOCAL_TRACE 0
@@ -391,3 +395,27 @@ zx_status_t sys_system_powerctl(zx_handle_t root_rsrc, uint32_t cmd,
         default: return ZX_ERR_INVALID_ARGS;
     }
 }
+
+zx_status_t sys_system_get_event(zx_handle_t root_job, uint32_t kind, user_out_handle* out) {
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<JobDispatcher> job;
+    zx_status_t status = up->GetDispatcherWithRights(root_job, ZX_RIGHT_NONE, &job);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    // Only the root job can hand out the system events.
+    if (job != GetRootJobDispatcher()) {
+        return ZX_ERR_ACCESS_DENIED;
+    }
+
+    fbl::RefPtr<EventDispatcher> event;
+    status = GetSystemEvent(kind, &event);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    // Only the kernel signals them, everyone else just waits.
+    return out->make(fbl::move(event), ZX_DEFAULT_EVENT_RIGHTS & ~ZX_RIGHT_SIGNAL);
+}
@@ -237,6 +237,21 @@ zx_status_t sys_thread_write_state(zx_handle_t handle, uint32_t state_kind,
     return status;
 }
 
+zx_status_t sys_thread_set_deadline(zx_handle_t handle, zx_duration_t capacity,
+                                    zx_duration_t deadline, zx_duration_t period) {
+    LTRACEF("handle %x, capacity %" PRIu64 " deadline %" PRIu64 " period %" PRIu64 "\n",
+            handle, capacity, deadline, period);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<ThreadDispatcher> thread;
+    zx_status_t status = up->GetDispatcherWithRights(handle, ZX_RIGHT_WRITE, &thread);
+    if (status != ZX_OK)
+        return status;
+
+    return thread->SetDeadline(capacity, deadline, period);
+}
+
 // See ZX-940
 zx_status_t sys_thread_set_priority(int32_t prio) {
 #if THREAD_SET_PRIORITY_EXPERIMENT
@@ -584,6 +599,26 @@ zx_status_t sys_job_create(zx_handle_t parent_job, uint32_t options,
     return status;
 }
 
+static zx_status_t job_set_timer_slack_policy(zx_handle_t job_handle, uint32_t options,
+                                              user_in_ptr<const void> _policy, uint32_t count) {
+    if (count != 1u)
+        return ZX_ERR_INVALID_ARGS;
+
+    zx_policy_timer_slack policy;
+    auto status = _policy.reinterpret<const zx_policy_timer_slack>().copy_from_user(&policy);
+    if (status != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<JobDispatcher> job;
+    status = up->GetDispatcherWithRights(job_handle, ZX_RIGHT_SET_POLICY, &job);
+    if (status != ZX_OK)
+        return status;
+
+    return job->SetTimerSlackPolicy(options, policy);
+}
+
 zx_status_t sys_job_set_policy(zx_handle_t job_handle, uint32_t options,
                                uint32_t topic, user_in_ptr<const void> _policy,
                                uint32_t count) {
@@ -593,6 +628,9 @@ zx_status_t sys_job_set_policy(zx_handle_t job_handle, uint32_t options,
     if (!_policy || (count == 0u))
         return ZX_ERR_INVALID_ARGS;
 
+    if (topic == ZX_JOB_POL_TIMER_SLACK)
+        return job_set_timer_slack_policy(job_handle, options, _policy, count);
+
     if (topic != ZX_JOB_POL_BASIC)
         return ZX_ERR_INVALID_ARGS;
 
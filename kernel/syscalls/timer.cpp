@@ -14,6 +14,7 @@
 #include <object/process_dispatcher.h>
 #include <object/timer_dispatcher.h>
 
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/ref_ptr.h>
 
@@ -50,7 +51,12 @@ zx_status_t sys_timer_set(
     if (status != ZX_OK)
         return status;
 
-    return timer->Set(deadline, slack);
+    // The job may ask for coarser wakeups than the caller does.
+    zx_duration_t min_slack;
+    uint32_t slack_mode;
+    up->GetTimerSlack(&min_slack, &slack_mode);
+
+    return timer->Set(deadline, fbl::max(slack, min_slack));
 }
 
 
@@ -119,6 +119,12 @@ zx_status_t sys_vmar_map(zx_handle_t vmar_handle, size_t vmar_offset,
         map_flags &= ~ZX_VM_FLAG_MAP_RANGE;
     }
 
+    bool do_populate = false;
+    if (map_flags & ZX_VM_FLAG_MAP_POPULATE) {
+        do_populate = true;
+        map_flags &= ~ZX_VM_FLAG_MAP_POPULATE;
+    }
+
     // Usermode is not allowed to specify these flags on mappings, though we may
     // set them below.
     if (map_flags & (ZX_VM_FLAG_CAN_MAP_READ | ZX_VM_FLAG_CAN_MAP_WRITE | ZX_VM_FLAG_CAN_MAP_EXECUTE)) {
@@ -158,8 +164,22 @@ zx_status_t sys_vmar_map(zx_handle_t vmar_handle, size_t vmar_offset,
         vm_mapping->Destroy();
     });
 
-    if (do_map_range) {
-        status = vm_mapping->MapRange(vmo_offset, len, false);
+    if (do_populate) {
+        // Allocate all of the missing pages in one batch, without holding the
+        // aspace lock while any of them are fetched from a page source, and
+        // then map the whole range.  If either step fails the cleanup handler
+        // tears down the mapping, so a partially populated mapping is never
+        // handed back.
+        status = vmo->vmo()->CommitRange(vmo_offset, len, nullptr);
+        if (status != ZX_OK && status != ZX_ERR_NOT_SUPPORTED) {
+            return status;
+        }
+        status = vm_mapping->MapRange(0, len, true);
+        if (status != ZX_OK) {
+            return status;
+        }
+    } else if (do_map_range) {
+        status = vm_mapping->MapRange(0, len, false);
         if (status != ZX_OK) {
             return status;
         }
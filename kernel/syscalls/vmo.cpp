@@ -6,6 +6,8 @@
 
 #include <err.h>
 #include <inttypes.h>
+#include <iovec.h>
+#include <stddef.h>
 #include <trace.h>
 
 #include <vm/vm_object.h>
@@ -27,7 +29,7 @@ zx_status_t sys_vmo_create(uint64_t size, uint32_t options,
                            user_out_handle* out) {
     LTRACEF("size %#" PRIx64 "\n", size);
 
-    if (options != 0u)
+    if (options & ~ZX_VMO_LARGE_PAGES)
         return ZX_ERR_INVALID_ARGS;
 
     auto up = ProcessDispatcher::GetCurrent();
@@ -35,11 +37,16 @@ zx_status_t sys_vmo_create(uint64_t size, uint32_t options,
     if (res != ZX_OK)
         return res;
 
+    uint32_t vmo_options = 0;
+    if (options & ZX_VMO_LARGE_PAGES)
+        vmo_options |= VmObjectPaged::kLargePages;
+
     // create a vm object
     fbl::RefPtr<VmObject> vmo;
-    res = VmObjectPaged::Create(0, size, &vmo);
+    res = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, vmo_options, size, &vmo);
     if (res != ZX_OK)
         return res;
+    vmo->SetAttribution(up->vm_attribution());
 
     // create a Vm Object dispatcher
     fbl::RefPtr<Dispatcher> dispatcher;
@@ -52,6 +59,52 @@ zx_status_t sys_vmo_create(uint64_t size, uint32_t options,
     return out->make(fbl::move(dispatcher), rights);
 }
 
+// Force map the range, even if it crosses multiple mappings.
+// TODO(ZX-730): This is a workaround for this bug.  If we start decommitting
+// things, the bug will come back.  We should fix this more properly.
+static zx_status_t force_map_out(user_out_ptr<uint8_t> data, size_t len) {
+    uint8_t byte = 0;
+    for (size_t i = 0; i < len; i += PAGE_SIZE) {
+        zx_status_t status = data.copy_array_to_user(&byte, 1, i);
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+    if (len > 0) {
+        return data.copy_array_to_user(&byte, 1, len - 1);
+    }
+    return ZX_OK;
+}
+
+static zx_status_t force_map_in(user_in_ptr<const uint8_t> data, size_t len) {
+    uint8_t byte = 0;
+    for (size_t i = 0; i < len; i += PAGE_SIZE) {
+        zx_status_t status = data.copy_array_from_user(&byte, 1, i);
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+    if (len > 0) {
+        return data.copy_array_from_user(&byte, 1, len - 1);
+    }
+    return ZX_OK;
+}
+
+// Copies in the user's vectors, which must number no more than
+// ZX_VMO_VECTOR_MAX_ITEMS.
+static zx_status_t copy_vectors_from_user(user_in_ptr<const zx_iovec_t> _vectors,
+                                          uint32_t num_vectors, iovec_t* vectors) {
+    static_assert(sizeof(zx_iovec_t) == sizeof(iovec_t), "");
+    static_assert(offsetof(zx_iovec_t, buffer) == offsetof(iovec_t, iov_base), "");
+    static_assert(offsetof(zx_iovec_t, length) == offsetof(iovec_t, iov_len), "");
+
+    if (num_vectors > ZX_VMO_VECTOR_MAX_ITEMS)
+        return ZX_ERR_OUT_OF_RANGE;
+    if (_vectors.reinterpret<const iovec_t>().copy_array_from_user(vectors, num_vectors) != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+    return ZX_OK;
+}
+
 zx_status_t sys_vmo_read(zx_handle_t handle, user_out_ptr<void> _data,
                          uint64_t offset, size_t len, user_out_ptr<size_t> _actual) {
     LTRACEF("handle %x, data %p, offset %#" PRIx64 ", len %#zx\n",
@@ -65,25 +118,9 @@ zx_status_t sys_vmo_read(zx_handle_t handle, user_out_ptr<void> _data,
     if (status != ZX_OK)
         return status;
 
-    // Force map the range, even if it crosses multiple mappings.
-    // TODO(ZX-730): This is a workaround for this bug.  If we start decommitting
-    // things, the bug will come back.  We should fix this more properly.
-    {
-        uint8_t byte = 0;
-        auto int_data = _data.reinterpret<uint8_t>();
-        for (size_t i = 0; i < len; i += PAGE_SIZE) {
-            status = int_data.copy_array_to_user(&byte, 1, i);
-            if (status != ZX_OK) {
-                return status;
-            }
-        }
-        if (len > 0) {
-            status = int_data.copy_array_to_user(&byte, 1, len - 1);
-            if (status != ZX_OK) {
-                return status;
-            }
-        }
-    }
+    status = force_map_out(_data.reinterpret<uint8_t>(), len);
+    if (status != ZX_OK)
+        return status;
 
     // do the read operation
     size_t nread;
@@ -107,25 +144,9 @@ zx_status_t sys_vmo_write(zx_handle_t handle, user_in_ptr<const void> _data,
     if (status != ZX_OK)
         return status;
 
-    // Force map the range, even if it crosses multiple mappings.
-    // TODO(ZX-730): This is a workaround for this bug.  If we start decommitting
-    // things, the bug will come back.  We should fix this more properly.
-    {
-        uint8_t byte = 0;
-        auto int_data = _data.reinterpret<const uint8_t>();
-        for (size_t i = 0; i < len; i += PAGE_SIZE) {
-            status = int_data.copy_array_from_user(&byte, 1, i);
-            if (status != ZX_OK) {
-                return status;
-            }
-        }
-        if (len > 0) {
-            status = int_data.copy_array_from_user(&byte, 1, len - 1);
-            if (status != ZX_OK) {
-                return status;
-            }
-        }
-    }
+    status = force_map_in(_data.reinterpret<const uint8_t>(), len);
+    if (status != ZX_OK)
+        return status;
 
     // do the write operation
     size_t nwritten;
@@ -136,6 +157,75 @@ zx_status_t sys_vmo_write(zx_handle_t handle, user_in_ptr<const void> _data,
     return status;
 }
 
+zx_status_t sys_vmo_read_vector(zx_handle_t handle, user_in_ptr<const zx_iovec_t> _vectors,
+                                uint32_t num_vectors, uint64_t offset,
+                                user_out_ptr<size_t> _actual) {
+    LTRACEF("handle %x, vectors %p, count %u offset %#" PRIx64 "\n",
+            handle, _vectors.get(), num_vectors, offset);
+
+    iovec_t vectors[ZX_VMO_VECTOR_MAX_ITEMS];
+    zx_status_t status = copy_vectors_from_user(_vectors, num_vectors, vectors);
+    if (status != ZX_OK)
+        return status;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<VmObjectDispatcher> vmo;
+    status = up->GetDispatcherWithRights(handle, ZX_RIGHT_READ, &vmo);
+    if (status != ZX_OK)
+        return status;
+
+    for (uint32_t i = 0; i < num_vectors; i++) {
+        status = force_map_out(make_user_out_ptr(static_cast<uint8_t*>(vectors[i].iov_base)),
+                               vectors[i].iov_len);
+        if (status != ZX_OK)
+            return status;
+    }
+
+    // the whole vector is copied under a single acquisition of the vmo lock
+    size_t nread;
+    status = vmo->ReadVector(vectors, num_vectors, offset, &nread);
+    if (status == ZX_OK)
+        status = _actual.copy_to_user(nread);
+
+    return status;
+}
+
+zx_status_t sys_vmo_write_vector(zx_handle_t handle, user_in_ptr<const zx_iovec_t> _vectors,
+                                 uint32_t num_vectors, uint64_t offset,
+                                 user_out_ptr<size_t> _actual) {
+    LTRACEF("handle %x, vectors %p, count %u offset %#" PRIx64 "\n",
+            handle, _vectors.get(), num_vectors, offset);
+
+    iovec_t vectors[ZX_VMO_VECTOR_MAX_ITEMS];
+    zx_status_t status = copy_vectors_from_user(_vectors, num_vectors, vectors);
+    if (status != ZX_OK)
+        return status;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<VmObjectDispatcher> vmo;
+    status = up->GetDispatcherWithRights(handle, ZX_RIGHT_WRITE, &vmo);
+    if (status != ZX_OK)
+        return status;
+
+    for (uint32_t i = 0; i < num_vectors; i++) {
+        status = force_map_in(make_user_in_ptr(static_cast<const uint8_t*>(vectors[i].iov_base)),
+                              vectors[i].iov_len);
+        if (status != ZX_OK)
+            return status;
+    }
+
+    // the target range of the vmo is committed up front, and the whole
+    // vector is copied under a single acquisition of the vmo lock
+    size_t nwritten;
+    status = vmo->WriteVector(vectors, num_vectors, offset, &nwritten);
+    if (status == ZX_OK)
+        status = _actual.copy_to_user(nwritten);
+
+    return status;
+}
+
 zx_status_t sys_vmo_get_size(zx_handle_t handle, user_out_ptr<uint64_t> _size) {
     LTRACEF("handle %x, sizep %p\n", handle, _size.get());
 
@@ -238,6 +328,7 @@ zx_status_t sys_vmo_clone(zx_handle_t handle, uint32_t options,
             return status;
 
         DEBUG_ASSERT(clone_vmo);
+        clone_vmo->SetAttribution(up->vm_attribution());
     }
 
     // create a Vm Object dispatcher
@@ -26,6 +26,7 @@
 #include <object/resources.h>
 #include <object/thread_dispatcher.h>
 
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/atomic.h>
 #include <fbl/ref_ptr.h>
@@ -57,7 +58,7 @@ zx_status_t sys_nanosleep(zx_time_t deadline) {
 // This must be accessed atomically from any given thread.
 static fbl::atomic<int64_t> utc_offset;
 
-uint64_t sys_time_get(uint32_t clock_id) {
+uint64_t sys_time_get_kernel(uint32_t clock_id) {
     switch (clock_id) {
     case ZX_CLOCK_MONOTONIC:
         return current_time();
@@ -189,7 +190,7 @@ zx_status_t sys_debuglog_read(zx_handle_t log_handle, uint32_t options,
                               user_out_ptr<void> ptr, size_t len) {
     LTRACEF("log handle %x, opt %x, ptr 0x%p, len %zu\n", log_handle, options, ptr.get(), len);
 
-    if (options != 0)
+    if (options & ~ZX_LOG_READ_BATCH)
         return ZX_ERR_INVALID_ARGS;
 
     auto up = ProcessDispatcher::GetCurrent();
@@ -199,15 +200,38 @@ zx_status_t sys_debuglog_read(zx_handle_t log_handle, uint32_t options,
     if (status != ZX_OK)
         return status;
 
-    char buf[DLOG_MAX_RECORD];
-    size_t actual;
-    if ((status = log->Read(options, buf, DLOG_MAX_RECORD, &actual)) < 0)
+    if (!(options & ZX_LOG_READ_BATCH))
+        len = DLOG_MAX_RECORD;
+    if (len < DLOG_MAX_RECORD)
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    if (len > INT32_MAX)
+        len = INT32_MAX;
+
+    // copy out a bounce buffer's worth of records at a time until the
+    // reader catches up or the next record might not fit
+    char buf[DLOG_MAX_RECORD * 4] __ALIGNED(8);
+    size_t offset = 0;
+    size_t end = 0;
+    while (offset + DLOG_MAX_RECORD <= len) {
+        size_t chunk = fbl::min(sizeof(buf), len - offset);
+        size_t actual;
+        status = log->Read(0, buf, chunk, &actual);
+        if (status != ZX_OK)
+            break;
+        if (ptr.byte_offset(offset).copy_array_to_user(buf, actual) != ZX_OK)
+            return ZX_ERR_INVALID_ARGS;
+        end = offset + actual;
+        offset = ROUNDUP(end, 8);
+
+        // the reader has caught up if the read stopped short of the
+        // space it had
+        if (ROUNDUP(actual, 8) + DLOG_MAX_RECORD <= chunk)
+            break;
+    }
+    if (end == 0)
         return status;
 
-    if (ptr.copy_array_to_user(buf, actual) != ZX_OK)
-        return ZX_ERR_INVALID_ARGS;
-
-    return static_cast<zx_status_t>(actual);
+    return static_cast<zx_status_t>(end);
 }
 
 zx_status_t sys_log_write(zx_handle_t log_handle, uint32_t len, user_in_ptr<const void> ptr, uint32_t options) {
@@ -227,9 +251,7 @@ zx_status_t sys_cprng_draw(user_out_ptr<void> buffer, size_t len, user_out_ptr<s
     // returns.
     explicit_memory::ZeroDtor<uint8_t> zero_guard(kernel_buf, sizeof(kernel_buf));
 
-    auto prng = crypto::GlobalPRNG::GetInstance();
-    ASSERT(prng->is_thread_safe());
-    prng->Draw(kernel_buf, static_cast<int>(len));
+    crypto::GlobalPRNG::Draw(kernel_buf, len);
 
     if (buffer.copy_array_to_user(kernel_buf, len) != ZX_OK)
         return ZX_ERR_INVALID_ARGS;
@@ -252,9 +274,7 @@ zx_status_t sys_cprng_add_entropy(user_in_ptr<const void> buffer, size_t len) {
     if (buffer.copy_array_from_user(kernel_buf, len) != ZX_OK)
         return ZX_ERR_INVALID_ARGS;
 
-    auto prng = crypto::GlobalPRNG::GetInstance();
-    ASSERT(prng->is_thread_safe());
-    prng->AddEntropy(kernel_buf, static_cast<int>(len));
+    crypto::GlobalPRNG::AddEntropy(kernel_buf, len);
 
     return ZX_OK;
 }
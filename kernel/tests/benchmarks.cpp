@@ -8,7 +8,9 @@
 #include "tests.h"
 
 #include <arch/ops.h>
+#include <arch/user_copy.h>
 #include <err.h>
+#include <fbl/ref_ptr.h>
 #include <inttypes.h>
 #include <kernel/mp.h>
 #include <kernel/mutex.h>
@@ -20,6 +22,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
+#include <vm/vm.h>
+#include <vm/vm_aspace.h>
 
 const size_t BUFSIZE = (8 * 1024 * 1024);
 const size_t ITER = (1UL * 1024 * 1024 * 1024 / BUFSIZE); // enough iterations to have to copy/set 1GB of memory
@@ -235,6 +239,56 @@ __NO_INLINE static void bench_mutex() {
     printf("%" PRIu64 " cycles to acquire/release uncontended mutex %u times (%" PRIu64 " cycles per)\n", c, count, c / count);
 }
 
+// Cycles through |n| user address spaces, reading a byte from each page of
+// a buffer in each one after switching to it. With one address space there
+// is no switch, which gives the cost of the reads alone. TLB entries tagged
+// with an address space id survive the switches, so more of the reads hit.
+__NO_INLINE static void bench_aspace_switch() {
+    static const size_t kMaxAspaces = 16;
+    static const size_t kPages = 16;
+    static const uint count = 64 * 1024;
+
+    fbl::RefPtr<VmAspace> aspaces[kMaxAspaces];
+    uint8_t* bufs[kMaxAspaces];
+    vmm_aspace_t* old_aspace = get_current_thread()->aspace;
+
+    size_t created = 0;
+    for (; created < kMaxAspaces; created++) {
+        fbl::RefPtr<VmAspace> aspace = VmAspace::Create(0, "bench");
+        if (!aspace)
+            break;
+        void* buf;
+        if (aspace->Alloc("bench buf", kPages * PAGE_SIZE, &buf, 0, VmAspace::VMM_FLAG_COMMIT,
+                          ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_USER) != ZX_OK) {
+            aspace->Destroy();
+            break;
+        }
+        aspaces[created] = fbl::move(aspace);
+        bufs[created] = static_cast<uint8_t*>(buf);
+    }
+
+    for (size_t n = 1; n <= created; n *= 2) {
+        uint64_t c = arch_cycle_count();
+        for (size_t i = 0; i < count; i++) {
+            size_t a = i % n;
+            vmm_set_active_aspace(reinterpret_cast<vmm_aspace_t*>(aspaces[a].get()));
+            for (size_t j = 0; j < kPages; j++) {
+                uint8_t byte;
+                arch_copy_from_user(&byte, bufs[a] + j * PAGE_SIZE, 1);
+            }
+        }
+        c = arch_cycle_count() - c;
+
+        printf("%" PRIu64 " cycles per switch among %zu address spaces, reading %zu pages in each\n",
+               c / count, n, kPages);
+    }
+
+    vmm_set_active_aspace(old_aspace);
+    for (size_t i = 0; i < created; i++) {
+        aspaces[i]->Destroy();
+    }
+}
+
 void benchmarks() {
     bench_set_overhead();
     bench_memcpy();
@@ -251,4 +305,6 @@ void benchmarks() {
 
     bench_spinlock();
     bench_mutex();
+
+    bench_aspace_switch();
 }
@@ -23,6 +23,7 @@ MODULE_SRCS += \
     $(LOCAL_DIR)/tests.cpp \
     $(LOCAL_DIR)/thread_tests.cpp \
     $(LOCAL_DIR)/timer_tests.cpp \
+    $(LOCAL_DIR)/user_copy_tests.cpp \
 
 
 MODULE_DEPS += \
@@ -28,6 +28,7 @@ STATIC_COMMAND("fibo", "threaded fibonacci", (console_cmd)&fibo)
 STATIC_COMMAND("spinner", "create a spinning thread", (console_cmd)&spinner)
 STATIC_COMMAND("sync_ipi_tests", "test synchronous IPIs", (console_cmd)&sync_ipi_tests)
 STATIC_COMMAND("timer_tests", "tests timers", (console_cmd)&timer_tests)
+STATIC_COMMAND("user_copy_bench", "benchmark copies to and from user memory", (console_cmd)&user_copy_bench)
 STATIC_COMMAND_END(tests);
 
 #endif
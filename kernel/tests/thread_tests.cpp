@@ -15,6 +15,7 @@
 #include <kernel/event.h>
 #include <kernel/mp.h>
 #include <kernel/mutex.h>
+#include <kernel/stats.h>
 #include <kernel/thread.h>
 #include <platform.h>
 #include <pow2.h>
@@ -450,6 +451,90 @@ static void spinlock_test(void) {
     printf("seems to work\n");
 }
 
+struct spinlock_handoff_state {
+    spin_lock_t lock = SPIN_LOCK_INITIAL_VALUE;
+    volatile bool start = false;
+    volatile bool shutdown = false;
+    uint64_t total = 0; // guarded by lock
+    uint64_t counts[SMP_MAX_CPUS] = {};
+};
+
+static int spinlock_handoff_thread(void* arg) {
+    spinlock_handoff_state* state = static_cast<spinlock_handoff_state*>(arg);
+    cpu_num_t cpu = arch_curr_cpu_num();
+
+    while (!state->start)
+        arch_spinloop_pause();
+
+    uint64_t count = 0;
+    while (!state->shutdown) {
+        spin_lock_saved_state_t irqstate;
+        spin_lock_irqsave(&state->lock, irqstate);
+        state->total++;
+        spin_unlock_irqrestore(&state->lock, irqstate);
+        count++;
+    }
+    state->counts[cpu] = count;
+
+    return 0;
+}
+
+// one thread pinned to each online cpu takes and drops the same spin lock as
+// fast as it can. reports how many times a second the lock changes hands,
+// and how evenly it was shared out.
+static void spinlock_handoff_test(void) {
+    printf("testing spinlock handoff:\n");
+
+    cpu_mask_t online = mp_get_online_mask();
+    if (!online || ispow2(online)) {
+        printf("skipping, not enough online cpus\n");
+        return;
+    }
+
+    spinlock_handoff_state state;
+    thread_t* threads[SMP_MAX_CPUS] = {};
+    for (cpu_num_t i = 0; i < SMP_MAX_CPUS; i++) {
+        if (!(online & cpu_num_to_mask(i)))
+            continue;
+        threads[i] = thread_create("spinlock handoff", &spinlock_handoff_thread, &state,
+                                   DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+        thread_set_cpu_affinity(threads[i], cpu_num_to_mask(i));
+        thread_resume(threads[i]);
+    }
+
+    static const zx_duration_t duration = ZX_SEC(2);
+    thread_sleep_relative(ZX_MSEC(10));
+    uint64_t stats_before = 0;
+    for (cpu_num_t i = 0; i < SMP_MAX_CPUS; i++)
+        stats_before += percpu[i].stats.spin_contended;
+    state.start = true;
+    thread_sleep_relative(duration);
+    state.shutdown = true;
+
+    uint64_t min = UINT64_MAX;
+    uint64_t max = 0;
+    uint64_t stats_after = 0;
+    for (cpu_num_t i = 0; i < SMP_MAX_CPUS; i++) {
+        if (!threads[i])
+            continue;
+        thread_join(threads[i], NULL, ZX_TIME_INFINITE);
+        min = MIN(min, state.counts[i]);
+        max = MAX(max, state.counts[i]);
+    }
+    for (cpu_num_t i = 0; i < SMP_MAX_CPUS; i++)
+        stats_after += percpu[i].stats.spin_contended;
+
+    uint64_t sum = 0;
+    for (cpu_num_t i = 0; i < SMP_MAX_CPUS; i++)
+        sum += state.counts[i];
+    ASSERT(sum == state.total);
+
+    printf("%" PRIu64 " acquisitions/sec over %u cpus, %" PRIu64 " contended, "
+           "fewest on one cpu %" PRIu64 ", most %" PRIu64 "\n",
+           state.total * ZX_SEC(1) / duration, __builtin_popcount(online),
+           stats_after - stats_before, min, max);
+}
+
 static void sleeper_thread_exit(enum thread_user_state_change new_state, void* arg) {
     TRACEF("arg %p\n", arg);
 }
@@ -693,6 +778,42 @@ static void tls_tests() {
     printf("done with tls tests\n");
 }
 
+static int idle_latency_waiter(void* arg) {
+    event_wait(static_cast<event_t*>(arg));
+    return 0;
+}
+
+static void idle_latency_test(void) {
+    printf("starting idle latency test\n");
+
+    event_t e;
+    event_init(&e, false, 0);
+
+    thread_t* t = thread_create("idle-latency", idle_latency_waiter, &e, LOW_PRIORITY,
+                                DEFAULT_STACK_SIZE);
+    thread_set_idle_latency(t, ZX_USEC(10));
+    thread_resume(t);
+    thread_sleep_relative(ZX_MSEC(100));
+
+    // while it is blocked the cpu it blocked on keeps to its latency
+    ASSERT(list_in_list(&t->idle_latency_node));
+    ASSERT(percpu[t->idle_latency_cpu].idle.latency_tolerance <= ZX_USEC(10));
+
+    // and stops as soon as it no longer asks for one
+    thread_set_idle_latency(t, ZX_TIME_INFINITE);
+    ASSERT(!list_in_list(&t->idle_latency_node));
+
+    // or starts to, while it is blocked
+    thread_set_idle_latency(t, ZX_USEC(10));
+    ASSERT(list_in_list(&t->idle_latency_node));
+
+    event_signal(&e, true);
+    thread_join(t, nullptr, ZX_TIME_INFINITE);
+    event_destroy(&e);
+
+    printf("done with idle latency test\n");
+}
+
 int thread_tests(void) {
     kill_tests();
 
@@ -700,6 +821,7 @@ int thread_tests(void) {
     event_test();
 
     spinlock_test();
+    spinlock_handoff_test();
     atomic_test();
 
     thread_sleep_relative(ZX_MSEC(200));
@@ -713,6 +835,8 @@ int thread_tests(void) {
 
     tls_tests();
 
+    idle_latency_test();
+
     return 0;
 }
 
@@ -190,10 +190,70 @@ static void timer_far_deadline(void) {
     event_destroy(&event);
 }
 
+struct wheel_test_timer {
+    timer_t timer;
+    zx_time_t deadline;
+    zx_time_t fired;
+};
+
+static enum handler_return timer_cb_wheel(timer_t* timer, zx_time_t now, void* arg) {
+    wheel_test_timer* t = containerof(timer, wheel_test_timer, timer);
+    t->fired = now;
+    atomic_add((int*)arg, 1);
+    return INT_NO_RESCHEDULE;
+}
+
+// Timers further out than a couple of milliseconds live in the timer wheel
+// and get cascaded down its levels as time advances.
+static void timer_test_wheel(void) {
+    printf("testing timer wheel\n");
+
+    const zx_duration_t offsets[] = {
+        ZX_MSEC(3), ZX_MSEC(20), ZX_MSEC(80), ZX_MSEC(150), ZX_MSEC(250), ZX_MSEC(400),
+    };
+    const size_t count = countof(offsets);
+
+    int timer_count = 0;
+    wheel_test_timer timers[countof(offsets)];
+    zx_time_t now = current_time();
+
+    for (size_t ix = 0; ix != count; ++ix) {
+        timer_init(&timers[ix].timer);
+        timers[ix].deadline = now + offsets[ix];
+        timers[ix].fired = 0;
+        timer_set(&timers[ix].timer, timers[ix].deadline, TIMER_SLACK_CENTER, 0,
+                  timer_cb_wheel, &timer_count);
+    }
+
+    // Cancel every other timer before it gets a chance to fire.
+    for (size_t ix = 1; ix < count; ix += 2) {
+        if (!timer_cancel(&timers[ix].timer)) {
+            printf("error: timer %zu was not pending\n", ix);
+        }
+    }
+
+    while (atomic_load(&timer_count) != (int)(count + 1) / 2) {
+        thread_sleep(current_time() + ZX_MSEC(5));
+    }
+    thread_sleep(current_time() + ZX_MSEC(50));
+
+    for (size_t ix = 0; ix != count; ++ix) {
+        if (ix % 2) {
+            if (timers[ix].fired != 0) {
+                printf("error: cancelled timer %zu fired\n", ix);
+            }
+        } else if (timers[ix].fired < timers[ix].deadline) {
+            printf("error: timer %zu fired early at %" PRIu64 ", deadline %" PRIu64 "\n",
+                   ix, timers[ix].fired, timers[ix].deadline);
+        }
+    }
+}
+
 void timer_tests(void) {
     timer_test_coalescing_center();
     timer_test_coalescing_late();
     timer_test_coalescing_early();
     timer_test_all_cpus();
+    timer_test_wheel();
     timer_far_deadline();
 }
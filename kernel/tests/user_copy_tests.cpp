@@ -0,0 +1,185 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include "tests.h"
+
+#include <arch/ops.h>
+#include <arch/user_copy.h>
+#include <err.h>
+#include <fbl/ref_ptr.h>
+#include <inttypes.h>
+#include <kernel/thread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unittest.h>
+#include <vm/vm.h>
+#include <vm/vm_aspace.h>
+
+namespace {
+
+constexpr size_t kUserBufSize = 1024 * 1024;
+constexpr uint kUserMmuFlags =
+    ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE | ARCH_MMU_FLAG_PERM_USER;
+
+// A committed buffer in a fresh user address space, which is made active on
+// the current thread while this is in scope. |hole()| is a page with nothing
+// mapped in it.
+class UserBuffer {
+public:
+    UserBuffer() {
+        aspace_ = VmAspace::Create(0, "user copy test");
+        if (!aspace_)
+            return;
+        old_aspace_ = get_current_thread()->aspace;
+        vmm_set_active_aspace(reinterpret_cast<vmm_aspace_t*>(aspace_.get()));
+
+        if (aspace_->Alloc("user copy buf", kUserBufSize, &buf_, 0,
+                           VmAspace::VMM_FLAG_COMMIT, kUserMmuFlags) != ZX_OK) {
+            buf_ = nullptr;
+        }
+        if (aspace_->Alloc("user copy hole", PAGE_SIZE, &hole_, 0, 0, kUserMmuFlags) != ZX_OK ||
+            aspace_->FindRegion(reinterpret_cast<vaddr_t>(hole_))->Destroy() != ZX_OK) {
+            hole_ = nullptr;
+        }
+    }
+
+    ~UserBuffer() {
+        if (!aspace_)
+            return;
+        vmm_set_active_aspace(old_aspace_);
+        aspace_->Destroy();
+    }
+
+    uint8_t* buf() const { return static_cast<uint8_t*>(buf_); }
+    uint8_t* hole() const { return static_cast<uint8_t*>(hole_); }
+
+private:
+    fbl::RefPtr<VmAspace> aspace_;
+    vmm_aspace_t* old_aspace_ = nullptr;
+    void* buf_ = nullptr;
+    void* hole_ = nullptr;
+};
+
+// Sizes around each of the thresholds where the copy changes strategy.
+const size_t kTestSizes[] = {
+    0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, 128,
+    255, 4095, 4096, 4097, 256 * 1024 - 1, 256 * 1024, 256 * 1024 + 65, kUserBufSize - 16,
+};
+
+bool copy_round_trip(const UserBuffer& user, uint8_t* src, uint8_t* dst,
+                     size_t len, size_t user_off, size_t src_off) {
+    BEGIN_TEST;
+
+    for (size_t i = 0; i < len; i++)
+        src[src_off + i] = static_cast<uint8_t>(i * 7 + len);
+
+    // clear the user buffer around the copy so overruns show up
+    size_t guard = MIN(user_off, 8u);
+    size_t window = MIN(len + 16, kUserBufSize - (user_off - guard));
+    memset(dst, 0xaa, window);
+    REQUIRE_EQ(ZX_OK, arch_copy_to_user(user.buf() + user_off - guard, dst, window), "");
+
+    REQUIRE_EQ(ZX_OK, arch_copy_to_user(user.buf() + user_off, src + src_off, len), "");
+    REQUIRE_EQ(ZX_OK, arch_copy_from_user(dst, user.buf() + user_off - guard, window), "");
+
+    for (size_t i = 0; i < guard; i++)
+        REQUIRE_EQ(0xaa, dst[i], "copy underran");
+    REQUIRE_EQ(0, memcmp(dst + guard, src + src_off, len), "copy mismatch");
+    for (size_t i = guard + len; i < window; i++)
+        REQUIRE_EQ(0xaa, dst[i], "copy overran");
+
+    END_TEST;
+}
+
+bool user_copy_sizes(void* context) {
+    BEGIN_TEST;
+
+    UserBuffer user;
+    REQUIRE_NONNULL(user.buf(), "");
+
+    uint8_t* src = static_cast<uint8_t*>(malloc(kUserBufSize + 16));
+    uint8_t* dst = static_cast<uint8_t*>(malloc(kUserBufSize + 32));
+    REQUIRE_NONNULL(src, "");
+    REQUIRE_NONNULL(dst, "");
+
+    for (size_t len : kTestSizes) {
+        for (size_t off = 0; off < 8; off += 3) {
+            if (!copy_round_trip(user, src, dst, len, 8 + off, off)) {
+                printf("failed copying %zu bytes at offset %zu\n", len, off);
+                all_ok = false;
+            }
+        }
+    }
+
+    free(dst);
+    free(src);
+    END_TEST;
+}
+
+bool user_copy_faults(void* context) {
+    BEGIN_TEST;
+
+    UserBuffer user;
+    REQUIRE_NONNULL(user.hole(), "");
+
+    uint8_t buf[1024] = {};
+    const size_t kFaultSizes[] = {1, 8, 48, 512, sizeof(buf)};
+    for (size_t len : kFaultSizes) {
+        // starting in the hole, and running into it from mapped memory
+        EXPECT_NE(ZX_OK, arch_copy_to_user(user.hole(), buf, len), "");
+        EXPECT_NE(ZX_OK, arch_copy_from_user(buf, user.hole(), len), "");
+        EXPECT_NE(ZX_OK, arch_copy_to_user(user.hole() + PAGE_SIZE - len / 2, buf, len), "");
+    }
+
+    // a copy big enough to use streaming stores
+    uint8_t* big = static_cast<uint8_t*>(malloc(kUserBufSize));
+    REQUIRE_NONNULL(big, "");
+    EXPECT_NE(ZX_OK, arch_copy_from_user(big, user.hole() - kUserBufSize / 2, kUserBufSize), "");
+    free(big);
+
+    END_TEST;
+}
+
+} // namespace
+
+// Reports the cost of copying to and from user memory across a range of sizes.
+int user_copy_bench(int argc, const cmd_args* argv) {
+    UserBuffer user;
+    uint8_t* buf = static_cast<uint8_t*>(malloc(kUserBufSize));
+    if (!user.buf() || !buf) {
+        printf("failed to set up buffers\n");
+        free(buf);
+        return ZX_ERR_NO_MEMORY;
+    }
+    memset(buf, 0x5a, kUserBufSize);
+
+    for (size_t len = 8; len <= kUserBufSize; len *= 4) {
+        const size_t iter = MAX(16u, (64u * 1024 * 1024) / len);
+
+        uint64_t to = arch_cycle_count();
+        for (size_t i = 0; i < iter; i++)
+            arch_copy_to_user(user.buf(), buf, len);
+        to = arch_cycle_count() - to;
+
+        uint64_t from = arch_cycle_count();
+        for (size_t i = 0; i < iter; i++)
+            arch_copy_from_user(buf, user.buf(), len);
+        from = arch_cycle_count() - from;
+
+        printf("%8zu bytes: to user %" PRIu64 " cycles per copy, from user %" PRIu64
+               " cycles per copy\n", len, to / iter, from / iter);
+    }
+
+    free(buf);
+    return 0;
+}
+
+UNITTEST_START_TESTCASE(user_copy_tests)
+UNITTEST("copies of many sizes", user_copy_sizes)
+UNITTEST("copies that fault", user_copy_faults)
+UNITTEST_END_TESTCASE(user_copy_tests, "user_copy", "Tests of copying to and from user memory",
+                      nullptr, nullptr);
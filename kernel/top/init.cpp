@@ -15,8 +15,14 @@
 
 #include <assert.h>
 #include <debug.h>
+#include <kernel/atomic.h>
+#include <kernel/event.h>
+#include <kernel/mutex.h>
+#include <kernel/thread.h>
+#include <platform.h>
 #include <trace.h>
 #include <zircon/compiler.h>
+#include <zircon/thread_annotations.h>
 
 #define LOCAL_TRACE 0
 #define TRACE_INIT (LK_DEBUGLEVEL >= 2)
@@ -27,6 +33,82 @@
 extern const struct lk_init_struct __start_lk_init[];
 extern const struct lk_init_struct __stop_lk_init[];
 
+// Room for every primary cpu hook plus a few per secondary cpu. Hooks that
+// don't fit are still run, just not timed.
+#define TIMELINE_SIZE 256
+
+static lk_init_timing_t timeline[TIMELINE_SIZE];
+static int timeline_count;
+
+// async hooks that haven't returned yet
+static mutex_t async_lock = MUTEX_INITIAL_VALUE(async_lock);
+static uint async_pending TA_GUARDED(async_lock);
+static event_t async_done = EVENT_INITIAL_VALUE(async_done, true, 0);
+
+static void call_hook(const struct lk_init_struct* init, uint level, uint flags) {
+    // Suspend and resume hooks run over and over; only boot is timed.
+    lk_init_timing_t* t = nullptr;
+    if (flags & LK_INIT_FLAG_ALL_CPUS) {
+        int n = atomic_add(&timeline_count, 1);
+        if (n < TIMELINE_SIZE) {
+            t = &timeline[n];
+            t->init = init;
+            t->index = static_cast<uint>(init - __start_lk_init);
+            t->cpu = arch_curr_cpu_num();
+            t->start = current_ticks();
+        }
+    }
+
+    init->hook(level);
+
+    if (t != nullptr)
+        __atomic_store_n(&t->end, current_ticks(), __ATOMIC_RELEASE);
+}
+
+static int async_hook_thread(void* arg) {
+    auto init = static_cast<const struct lk_init_struct*>(arg);
+
+    call_hook(init, init->level, LK_INIT_FLAG_PRIMARY_CPU);
+
+    mutex_acquire(&async_lock);
+    if (--async_pending == 0)
+        event_signal(&async_done, true);
+    mutex_release(&async_lock);
+    return 0;
+}
+
+// Starts |init| in a thread of its own. Returns false if it has to be run
+// inline instead.
+static bool start_async_hook(const struct lk_init_struct* init) {
+    mutex_acquire(&async_lock);
+    if (async_pending++ == 0)
+        event_unsignal(&async_done);
+    mutex_release(&async_lock);
+
+    thread_t* t = thread_create(init->name, &async_hook_thread, const_cast<lk_init_struct*>(init),
+                                DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+    if (t == nullptr) {
+        mutex_acquire(&async_lock);
+        if (--async_pending == 0)
+            event_signal(&async_done, true);
+        mutex_release(&async_lock);
+        return false;
+    }
+
+    thread_detach_and_resume(t);
+    return true;
+}
+
+void lk_init_wait_async(void) {
+    event_wait(&async_done);
+}
+
+size_t lk_init_get_timeline(const lk_init_timing_t** out) {
+    *out = timeline;
+    int count = atomic_load(&timeline_count);
+    return count < TIMELINE_SIZE ? count : TIMELINE_SIZE;
+}
+
 void lk_init_level(enum lk_init_flags required_flag, uint start_level, uint stop_level) {
     LTRACEF("flags %#x, start_level %#x, stop_level %#x\n",
             (uint)required_flag, start_level, stop_level);
@@ -82,7 +164,11 @@ void lk_init_level(enum lk_init_flags required_flag, uint start_level, uint stop
             }
         }
 
-        found->hook(found->level);
+        bool async = (found->flags & LK_INIT_FLAG_ASYNC) &&
+                     (required_flag == LK_INIT_FLAG_PRIMARY_CPU) &&
+                     (found->level >= LK_INIT_LEVEL_THREADING);
+        if (!async || !start_async_hook(found))
+            call_hook(found, found->level, required_flag);
         last_called_level = found->level;
         last = found;
     }
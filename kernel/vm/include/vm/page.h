@@ -17,6 +17,16 @@ class VmObject;
 #define VM_PAGE_OBJECT_PIN_COUNT_BITS 5
 #define VM_PAGE_OBJECT_MAX_PIN_COUNT ((1ul << VM_PAGE_OBJECT_PIN_COUNT_BITS) - 1)
 
+// vm_page_t flags
+// The page belongs to the vm object and offset recorded in |object|, and while
+// it is not pinned its contents may be migrated to another physical page.
+#define VM_PAGE_FLAG_MOVABLE (1u << 0)
+// The page's physical address was handed out to userspace by a lookup, which
+// may have given it to a device, so the object holds on to the page as if it
+// were pinned until the object goes away. Such a page is never
+// VM_PAGE_FLAG_MOVABLE.
+#define VM_PAGE_FLAG_LOOKED_UP (1u << 1)
+
 // core per page structure
 typedef struct vm_page {
     struct {
@@ -31,9 +41,9 @@ typedef struct vm_page {
             struct list_node node;
         } free;
         struct {
-            // attached to a vm object
-            uint64_t offset; // unused currently
-            VmObject* obj;   // unused currently
+            // attached to a vm object, only meaningful with VM_PAGE_FLAG_MOVABLE
+            uint64_t offset;
+            VmObject* obj;
 
             uint8_t pin_count : VM_PAGE_OBJECT_PIN_COUNT_BITS;
             // If true, one pin slot is used by the VmObject to keep a run
@@ -65,5 +75,12 @@ static inline bool page_is_free(const vm_page_t* page) {
     return page->state == VM_PAGE_STATE_FREE;
 }
 
+// a page that compaction may move elsewhere, as far as can be told without
+// the owning object's lock
+static inline bool page_is_movable(const vm_page_t* page) {
+    return page->state == VM_PAGE_STATE_OBJECT && (page->flags & VM_PAGE_FLAG_MOVABLE) &&
+           page->object.pin_count == 0;
+}
+
 const char* page_state_to_string(unsigned int state);
 void dump_page(const vm_page_t* page);
@@ -0,0 +1,120 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <fbl/auto_lock.h>
+#include <fbl/intrusive_double_list.h>
+#include <fbl/macros.h>
+#include <fbl/mutex.h>
+#include <fbl/ref_counted.h>
+#include <fbl/ref_ptr.h>
+#include <kernel/event.h>
+#include <stdint.h>
+#include <zircon/thread_annotations.h>
+#include <zircon/types.h>
+
+class PageSource;
+
+// A range of a PageSource that has been asked for and not yet supplied.
+// Threads that need a page in the range wait on its event.
+class PageSourceRequest : public fbl::RefCounted<PageSourceRequest>,
+                          public fbl::DoublyLinkedListable<fbl::RefPtr<PageSourceRequest>> {
+public:
+    PageSourceRequest(uint64_t offset, uint64_t len);
+    ~PageSourceRequest();
+
+    uint64_t offset() const { return offset_; }
+    uint64_t end() const { return offset_ + len_; }
+
+private:
+    friend PageSource;
+    friend class PageRequest;
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(PageSourceRequest);
+
+    const uint64_t offset_;
+    const uint64_t len_;
+    event_t event_;
+};
+
+// Handed to GetPageLocked() by callers that are able to wait for a page that is
+// not resident yet. When the lookup fails with ZX_ERR_SHOULD_WAIT, the caller
+// drops every lock it holds, calls Wait() and then retries the lookup.
+class PageRequest {
+public:
+    PageRequest() = default;
+    ~PageRequest() = default;
+
+    // Blocks until the page source handles the request. Returns ZX_OK when the
+    // lookup should be retried, and an error when the source was detached or
+    // the thread is being killed.
+    zx_status_t Wait();
+
+private:
+    friend PageSource;
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(PageRequest);
+
+    fbl::RefPtr<PageSourceRequest> request_;
+};
+
+// Supplies the contents of a paged vm object on demand, in place of the zero
+// fill that an ordinary object gets. The object asks for a page it does not
+// have with GetPage(), and the source asks whoever is providing the contents
+// for a batch of pages around it. Pages go straight into the object once they
+// arrive, after which OnPagesSupplied() wakes up the threads waiting for them.
+class PageSource : public fbl::RefCounted<PageSource> {
+public:
+    // Number of pages asked for at once when a missing page has no request
+    // covering it yet, so that sequential faults come in one round trip.
+    static constexpr uint64_t kBatchPages = 16;
+
+    // Asks for the page at |offset| of an object of |size| bytes, unless an
+    // outstanding request already covers it. Returns ZX_ERR_SHOULD_WAIT with
+    // |req| (if not null) set up to wait for the request, or ZX_ERR_BAD_STATE
+    // once the source has been closed.
+    zx_status_t GetPage(uint64_t offset, uint64_t size, PageRequest* req);
+
+    // Called once the pages of [offset, offset + len) were added to the object.
+    // Wakes up the waiters of every request the range touches; the parts of a
+    // request that are still missing stay outstanding.
+    void OnPagesSupplied(uint64_t offset, uint64_t len);
+
+    // Detaches the source. Outstanding and future requests fail with
+    // ZX_ERR_BAD_STATE. Safe to call more than once.
+    void Close();
+
+    bool is_closed() const {
+        fbl::AutoLock guard(&lock_);
+        return closed_;
+    }
+
+protected:
+    PageSource() = default;
+    virtual ~PageSource();
+    friend fbl::RefPtr<PageSource>;
+
+    // Passes a request for [offset, offset + len) on to the provider. Called
+    // with the source lock held, so must not call back into the source.
+    virtual zx_status_t SendReadRequest(uint64_t offset, uint64_t len) = 0;
+
+    // Called once when the source is closed, without the source lock held.
+    virtual void OnClose() = 0;
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(PageSource);
+
+    using RequestList = fbl::DoublyLinkedList<fbl::RefPtr<PageSourceRequest>>;
+
+    // re-adds the part of |req| outside of [start, end) to outstanding_
+    void QueueRemainderLocked(const PageSourceRequest& req, uint64_t start, uint64_t end)
+        TA_REQ(lock_);
+
+    mutable fbl::Mutex lock_;
+    bool closed_ TA_GUARDED(lock_) = false;
+    RequestList outstanding_ TA_GUARDED(lock_);
+};
@@ -21,6 +21,9 @@ typedef struct pmm_arena_info {
 
     paddr_t base;
     size_t size;
+
+    // the NUMA node the memory is local to, see pmm_set_node_range()
+    uint node;
 } pmm_arena_info_t;
 
 #define PMM_ARENA_FLAG_KMAP (0x1) // this arena is already mapped and useful for kallocs
@@ -28,9 +31,42 @@ typedef struct pmm_arena_info {
 // Add a pre-filled memory arena to the physical allocator.
 zx_status_t pmm_add_arena(const pmm_arena_info_t* arena) __NONNULL((1));
 
+// NUMA nodes. Every arena and cpu starts out on node 0, until the platform
+// says otherwise from its firmware tables.
+#define PMM_MAX_NODES (8u)
+// stands for the node of the cpu doing the allocation
+#define PMM_NODE_LOCAL (~0u)
+
+// Assigns the memory of [base, base + size) to |node|, splitting any arena
+// that straddles the edge of the range. Only for boot, before the secondary
+// cpus are started.
+zx_status_t pmm_set_node_range(paddr_t base, size_t size, uint node);
+
+// Records the node |cpu| is local to.
+void pmm_set_cpu_node(uint cpu, uint node);
+
+// Returns the node of |cpu|, or of the page |page| comes from.
+uint pmm_cpu_node(uint cpu);
+uint pmm_page_node(const vm_page_t* page) __NONNULL((1));
+
+// Returns the number of nodes, which is at least 1.
+uint pmm_node_count(void);
+
+// How a vm object spreads the pages it allocates over the nodes.
+#define PMM_NODE_POLICY_LOCAL (0u)      // the node of the cpu allocating the page
+#define PMM_NODE_POLICY_INTERLEAVE (1u) // every node in turn
+#define PMM_NODE_POLICY_BIND (2u)       // only the one node
+
 // flags for allocation routines below
-#define PMM_ALLOC_FLAG_ANY (0x0)  // no restrictions on which arena to allocate from
-#define PMM_ALLOC_FLAG_KMAP (0x1) // allocate only from arenas marked KMAP
+#define PMM_ALLOC_FLAG_ANY (0x0)    // no restrictions on which arena to allocate from
+#define PMM_ALLOC_FLAG_KMAP (0x1)   // allocate only from arenas marked KMAP
+#define PMM_ALLOC_FLAG_ZEROED (0x2) // return zeroed pages, only for pmm_alloc_page(s)
+// move pages out of the way if no run is free, only for pmm_alloc_contiguous,
+// and only when the caller holds no vm object locks
+#define PMM_ALLOC_FLAG_COMPACT (0x4)
+// only allocate from the node asked for, rather than falling back to the
+// others when it runs out, only for the _node routines below
+#define PMM_ALLOC_FLAG_NODE_STRICT (0x8)
 
 // Allocate count pages of physical memory, adding to the tail of the passed list.
 // The list must be initialized.
@@ -40,11 +76,19 @@ size_t pmm_alloc_pages(size_t count, uint alloc_flags, struct list_node* list) _
 // Allocate a single page of physical memory.
 vm_page_t* pmm_alloc_page(uint alloc_flags, paddr_t* pa);
 
+// Same as the above, but from |node| (or PMM_NODE_LOCAL) when it has free
+// pages. The plain versions allocate from the local node.
+size_t pmm_alloc_pages_node(size_t count, uint alloc_flags, uint node, struct list_node* list)
+    __NONNULL((4));
+vm_page_t* pmm_alloc_page_node(uint alloc_flags, uint node, paddr_t* pa);
+
 // Allocate a specific range of physical pages, adding to the tail of the passed list.
 // Returns the number of pages allocated.
 size_t pmm_alloc_range(paddr_t address, size_t count, struct list_node* list);
 
 // Allocate a run of contiguous pages, aligned on log2 byte boundary (0-31)
+// With PMM_ALLOC_FLAG_COMPACT, a run of free and movable pages will be cleared
+// by migrating the movable ones if no free run is left.
 // If the optional physical address pointer is passed, return the address.
 // If the optional list is passed, append the allocate page structures to the tail of the list.
 size_t pmm_alloc_contiguous(size_t count, uint alloc_flags, uint8_t align_log2, paddr_t* pa,
@@ -19,6 +19,11 @@
 #define ROUNDUP_PAGE_SIZE(x) ROUNDUP((x), PAGE_SIZE)
 #define IS_PAGE_ALIGNED(x) IS_ALIGNED((x), PAGE_SIZE)
 
+// the size of the smallest large page, a page table's worth of pages, which
+// mappings use for suitably aligned physically contiguous runs
+#define LARGE_PAGE_SIZE_SHIFT (PAGE_SIZE_SHIFT + PAGE_SIZE_SHIFT - 3)
+#define LARGE_PAGE_SIZE (1UL << LARGE_PAGE_SIZE_SHIFT)
+
 // kernel address space
 static_assert(KERNEL_ASPACE_BASE + (KERNEL_ASPACE_SIZE - 1) > KERNEL_ASPACE_BASE, "");
 
@@ -7,6 +7,7 @@
 #pragma once
 
 #include <assert.h>
+#include <fbl/algorithm.h>
 #include <fbl/canary.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/intrusive_wavl_tree.h>
@@ -43,6 +44,15 @@
 // mapping can gain this permission.
 #define VMAR_FLAG_CAN_MAP_EXECUTE (1 << 6)
 
+// Hint that the region will be accessed sequentially, so page faults should
+// map more of the resident pages ahead of the faulting address.
+#define VMAR_FLAG_ACCESS_SEQUENTIAL (1 << 7)
+// Hint that the region will be accessed randomly, so page faults should only
+// map the faulting page.
+#define VMAR_FLAG_ACCESS_RANDOM (1 << 8)
+
+#define VMAR_ACCESS_HINT_FLAGS (VMAR_FLAG_ACCESS_SEQUENTIAL | VMAR_FLAG_ACCESS_RANDOM)
+
 #define VMAR_CAN_RWX_FLAGS (VMAR_FLAG_CAN_MAP_READ |  \
                             VMAR_FLAG_CAN_MAP_WRITE | \
                             VMAR_FLAG_CAN_MAP_EXECUTE)
@@ -115,7 +125,9 @@ public:
 
     // Page fault in an address within the region.  Recursively traverses
     // the regions to find the target mapping, if it exists.
-    virtual zx_status_t PageFault(vaddr_t va, uint pf_flags) = 0;
+    // Fails with ZX_ERR_SHOULD_WAIT if the page has to come from a page source,
+    // with |page_request| set up to wait on once the aspace lock is dropped.
+    virtual zx_status_t PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) = 0;
 
     // WAVL tree key function
     vaddr_t GetKey() const { return base(); }
@@ -197,6 +209,57 @@ protected:
 
     // node for element in list of parent's children.
     fbl::WAVLTreeNodeState<fbl::RefPtr<VmAddressRegionOrMapping>, bool> subregion_list_node_;
+
+    // Summary of the subtree rooted at this node in the parent's child list,
+    // which lets the allocators skip subtrees with no gap big enough for them.
+    struct SubtreeState {
+        // base of the lowest region and last byte of the highest region
+        vaddr_t first_base = 0;
+        vaddr_t last_byte = 0;
+        // largest gap between two neighbouring regions
+        size_t max_gap = 0;
+    };
+    SubtreeState subtree_state_;
+
+    // keeps subtree_state_ current as the child list changes shape
+    struct WAVLTreeObserver : public fbl::tests::intrusive_containers::DefaultWAVLTreeObserver {
+        template <typename Iter>
+        static void RecordSubtreeChange(Iter node) {
+            for (; node.IsValid(); node = node.parent()) {
+                UpdateSubtreeState(node);
+            }
+        }
+
+        template <typename Iter>
+        static void RecordRotation(Iter child, Iter parent) {
+            UpdateSubtreeState(child);
+            UpdateSubtreeState(parent);
+        }
+
+        template <typename Iter>
+        static void UpdateSubtreeState(Iter node) {
+            SubtreeState& state = node->subtree_state_;
+            const vaddr_t last_byte = node->base() + node->size() - 1;
+
+            state.first_base = node->base();
+            state.last_byte = last_byte;
+            state.max_gap = 0;
+
+            Iter left = node.left();
+            if (left.IsValid()) {
+                const SubtreeState& l = left->subtree_state_;
+                state.first_base = l.first_base;
+                state.max_gap = fbl::max(l.max_gap, node->base() - l.last_byte - 1);
+            }
+            Iter right = node.right();
+            if (right.IsValid()) {
+                const SubtreeState& r = right->subtree_state_;
+                state.last_byte = r.last_byte;
+                state.max_gap = fbl::max(state.max_gap,
+                                         fbl::max(r.max_gap, r.first_base - last_byte - 1));
+            }
+        }
+    };
 };
 
 // A representation of a contiguous range of virtual address space
@@ -235,7 +298,7 @@ public:
     bool is_mapping() const override { return false; }
 
     void Dump(uint depth, bool verbose) const override;
-    zx_status_t PageFault(vaddr_t va, uint pf_flags) override;
+    zx_status_t PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) override;
 
 protected:
     // constructor for use in creating a VmAddressRegionDummy
@@ -253,13 +316,15 @@ protected:
     friend class VmMapping;
     // Remove *region* from the subregion list
     void RemoveSubregion(VmAddressRegionOrMapping* region);
+    // Update the subregion list after *region* has changed size in place
+    void SubregionResized(VmAddressRegionOrMapping* region);
 
     friend fbl::RefPtr<VmAddressRegion>;
 
 private:
     using ChildList = fbl::WAVLTree<vaddr_t, fbl::RefPtr<VmAddressRegionOrMapping>,
                                     fbl::DefaultKeyedObjectTraits<vaddr_t, VmAddressRegionOrMapping>,
-                                    WAVLTreeTraits>;
+                                    WAVLTreeTraits, WAVLTreeObserver>;
 
     DISALLOW_COPY_ASSIGN_AND_MOVE(VmAddressRegion);
 
@@ -322,9 +387,17 @@ private:
     // Utility for allocators for iterating over gaps between allocations
     // F should have a signature of bool func(vaddr_t gap_base, size_t gap_size).
     // If func returns false, the iteration stops.  gap_base will be aligned in
-    // accordance with align_pow2.
+    // accordance with align_pow2.  Every gap of at least min_gap bytes is
+    // reported, but smaller gaps may be skipped.
+    template <typename F>
+    void ForEachGap(F func, uint8_t align_pow2, size_t min_gap);
+
+    // Helper for ForEachGap() that walks the subtree at *node*.  *prev_end* is
+    // the aligned end of the region before the subtree, and is advanced past
+    // it.  Returns false if func stopped the iteration.
     template <typename F>
-    void ForEachGap(F func, uint8_t align_pow2);
+    bool ForEachGapInSubtree(const ChildList::iterator& node, F& func, vaddr_t align,
+                             size_t min_gap, vaddr_t* prev_end);
 
     // list of subregions, indexed by base address
     ChildList subregions_;
@@ -368,7 +441,7 @@ public:
         return;
     }
 
-    zx_status_t PageFault(vaddr_t va, uint pf_flags) override {
+    zx_status_t PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) override {
         // We should never be trying to page fault on this...
         ASSERT(false);
         return ZX_ERR_BAD_STATE;
@@ -414,6 +487,12 @@ public:
     // offset modification and locking.
     zx_status_t DecommitRange(size_t offset, size_t len, size_t* decommitted);
 
+    // Convenience wrapper for vmo()->ReplacePages() at the object offset
+    // mapped at |va|, with the necessary locking. Since this stands in for
+    // writing the pages through the mapping, it fails with
+    // ZX_ERR_ACCESS_DENIED unless the mapping is user writable and cached.
+    zx_status_t ReplacePages(vaddr_t va, list_node* pages, size_t count);
+
     // Map in pages from the underlying vm object, optionally committing pages as it goes
     zx_status_t MapRange(size_t offset, size_t len, bool commit);
 
@@ -432,7 +511,7 @@ public:
     bool is_mapping() const override { return true; }
 
     void Dump(uint depth, bool verbose) const override;
-    zx_status_t PageFault(vaddr_t va, uint pf_flags) override;
+    zx_status_t PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) override;
 
 protected:
     ~VmMapping() override;
@@ -477,6 +556,16 @@ private:
     // in Clang around capability aliasing, we need to relax the analysis.
     void ActivateLocked();
 
+    // Tries to handle a fault at |va| by mapping the whole aligned large page
+    // around it, when the object can back that with one contiguous run.
+    // Requires the object_ lock, see ActivateLocked() for the lack of annotation.
+    zx_status_t PageFaultLargeLocked(vaddr_t va, uint pf_flags) TA_NO_THREAD_SAFETY_ANALYSIS;
+
+    // Maps the resident pages of the object around the just faulted in |va|,
+    // as far as the mapping's access hint allows.
+    // Requires the object_ lock, see ActivateLocked() for the lack of annotation.
+    void FaultAroundLocked(vaddr_t va, uint pf_flags) TA_NO_THREAD_SAFETY_ANALYSIS;
+
     // pointer and region of the object we are mapping
     fbl::RefPtr<VmObject> object_;
     uint64_t object_offset_ = 0;
@@ -0,0 +1,35 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <fbl/atomic.h>
+#include <fbl/macros.h>
+#include <fbl/ref_counted.h>
+#include <stdint.h>
+
+// Counts the pages committed to a set of VMOs, kept up to date as their
+// pages come and go so that reading it costs nothing. Each process has one
+// for the VMOs it creates; it lives on as long as any of them do.
+class VmAttribution final : public fbl::RefCounted<VmAttribution> {
+public:
+    VmAttribution() = default;
+    DISALLOW_COPY_ASSIGN_AND_MOVE(VmAttribution);
+
+    void AddPages(int64_t delta) {
+        committed_pages_.fetch_add(delta, fbl::memory_order_relaxed);
+    }
+
+    uint64_t committed_pages() const {
+        // VMOs move pages between them under their own locks, so a reader
+        // can see a page leave one before it arrives in the other.
+        int64_t pages = committed_pages_.load(fbl::memory_order_relaxed);
+        return pages > 0 ? static_cast<uint64_t>(pages) : 0;
+    }
+
+private:
+    fbl::atomic<int64_t> committed_pages_{0};
+};
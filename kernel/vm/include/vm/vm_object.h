@@ -14,6 +14,7 @@
 #include <fbl/name.h>
 #include <fbl/ref_counted.h>
 #include <fbl/ref_ptr.h>
+#include <iovec.h>
 #include <kernel/mutex.h>
 #include <lib/user_copy/user_ptr.h>
 #include <list.h>
@@ -24,6 +25,7 @@
 #include <zircon/thread_annotations.h>
 #include <zircon/types.h>
 
+class PageRequest;
 class VmMapping;
 
 typedef zx_status_t (*vmo_lookup_fn_t)(void* context, size_t offset, size_t index, paddr_t pa);
@@ -55,6 +57,10 @@ public:
         return AllocatedPagesInRange(0, size());
     }
 
+    // Counts the pages allocated to the object in |attribution| from now on,
+    // moving the ones it has already from whatever counted them before.
+    virtual void SetAttribution(fbl::RefPtr<VmAttribution> attribution) {}
+
     // find physical pages to back the range of the object
     virtual zx_status_t CommitRange(uint64_t offset, uint64_t len, uint64_t* committed) {
         return ZX_ERR_NOT_SUPPORTED;
@@ -71,6 +77,14 @@ public:
         return ZX_ERR_NOT_SUPPORTED;
     }
 
+    // replace the pages backing a page aligned range of the vmo with the pages
+    // on |pages|, taking them off the list in order, as if new contents had
+    // been written over the range. pages left on the list still belong to the
+    // caller if this fails part way.
+    virtual zx_status_t ReplacePages(uint64_t offset, list_node* pages, size_t count) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
     // Pin the given range of the vmo.  If any pages are not committed, this
     // returns a ZX_ERR_NO_MEMORY.
     virtual zx_status_t Pin(uint64_t offset, uint64_t len) {
@@ -107,6 +121,17 @@ public:
         return ZX_ERR_NOT_SUPPORTED;
     }
 
+    // scatter/gather versions of the above, where the range starting at
+    // |offset| is copied to or from each of the |count| user buffers in turn
+    virtual zx_status_t ReadUserVector(const iovec_t* vec, size_t count, uint64_t offset,
+                                       size_t* bytes_read) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    virtual zx_status_t WriteUserVector(const iovec_t* vec, size_t count, uint64_t offset,
+                                        size_t* bytes_written) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
     // translate a range of the vmo to physical addresses and store in the buffer
     virtual zx_status_t LookupUser(uint64_t offset, uint64_t len, user_inout_ptr<paddr_t> buffer,
                                    size_t buffer_size) {
@@ -156,6 +181,16 @@ public:
         return ZX_ERR_NOT_SUPPORTED;
     }
 
+    // get/set how the object spreads the pages it allocates over the NUMA
+    // nodes, one of PMM_NODE_POLICY_*, and the node for PMM_NODE_POLICY_BIND
+    virtual zx_status_t GetNodePolicy(uint32_t* policy, uint32_t* node) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    virtual zx_status_t SetNodePolicy(uint32_t policy, uint32_t node) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
     // create a copy-on-write clone vmo at the page-aligned offset and length
     // note: it's okay to start or extend past the size of the parent
     virtual zx_status_t CloneCOW(uint64_t offset, uint64_t size, bool copy_name,
@@ -167,14 +202,35 @@ public:
     // TODO: If more types of clones appear, replace this with a method that
     // returns an enum rather than adding a new method for each clone type.
     bool is_cow_clone() const;
+    bool is_cow_clone_locked() const TA_REQ(lock_) { return parent_ != nullptr; }
+
+    // Returns the number of parents between this VMO and the root of its
+    // clone tree, which is how many objects a page lookup may have to visit.
+    uint32_t chain_depth() const;
 
     // get a pointer to the page structure and/or physical address at the specified offset.
     // valid flags are VMM_PF_FLAG_*
+    // if the page has to come from a page source, fails with ZX_ERR_SHOULD_WAIT and, when
+    // |page_request| is not null, sets it up for the caller to wait on once it drops its locks
     virtual zx_status_t GetPageLocked(uint64_t offset, uint pf_flags, list_node* free_list,
+                                      PageRequest* page_request,
                                       vm_page_t** page, paddr_t* pa) TA_REQ(lock_) {
         return ZX_ERR_NOT_SUPPORTED;
     }
 
+    // Returns true if mappings of this object should be placed so that they
+    // can use large pages.
+    virtual bool prefers_large_pages() const { return false; }
+
+    // get the physical address of a run of 1 << |size_shift| bytes at |offset|, which
+    // must be aligned to the run size, if one physically contiguous and equally aligned
+    // run of pages backs all of it, so that it can be mapped with a single large page.
+    // valid flags are VMM_PF_FLAG_*, a fault may commit the whole run at once.
+    virtual zx_status_t GetLargePageLocked(uint64_t offset, uint8_t size_shift, uint pf_flags,
+                                           paddr_t* pa) TA_REQ(lock_) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
     fbl::Mutex* lock() TA_RET_CAP(lock_) { return &lock_; }
     fbl::Mutex& lock_ref() TA_RET_CAP(lock_) { return lock_; }
 
@@ -194,6 +250,13 @@ public:
     void RemoveChildLocked(VmObject* r) TA_REQ(lock_);
     uint32_t num_children() const;
 
+    // Record a user of the object from outside the vm, such as the dispatcher
+    // behind its handles. Along with mappings and pins, holders keep a clone's
+    // parent from being merged into the clone; other references, such as the
+    // clone's own or those taken by walks of every object, don't count.
+    void AddHolder();
+    void RemoveHolder();
+
     // Calls the provided |func(const VmObject&)| on every VMO in the system,
     // from oldest to newest. Stops if |func| returns an error, returning the
     // error value.
@@ -209,6 +272,12 @@ public:
         return ZX_OK;
     }
 
+    // Returns a reference to the VMO after |prev| in the global list, or to
+    // the oldest VMO if |prev| is null, skipping any that are being destroyed.
+    // The caller must hold a reference to |prev|. Lets walks of every VMO in
+    // the system drop the list lock between objects.
+    static fbl::RefPtr<VmObject> NextInGlobalList(VmObject* prev);
+
 protected:
     // private constructor (use Create())
     explicit VmObject(fbl::RefPtr<VmObject> parent);
@@ -221,6 +290,8 @@ protected:
 
     DISALLOW_COPY_ASSIGN_AND_MOVE(VmObject);
 
+    uint32_t chain_depth_locked() const TA_REQ(lock_);
+
     // inform all mappings and children that a range of this vmo's pages were added or removed.
     void RangeChangeUpdateLocked(uint64_t offset, uint64_t len) TA_REQ(lock_);
 
@@ -255,6 +326,9 @@ protected:
     uint32_t mapping_list_len_ TA_GUARDED(lock_) = 0;
     uint32_t children_list_len_ TA_GUARDED(lock_) = 0;
 
+    // see AddHolder()
+    uint32_t holder_count_ TA_GUARDED(lock_) = 0;
+
     uint64_t user_id_ TA_GUARDED(lock_) = 0;
 
     // The user-friendly VMO name. For debug purposes only. That
@@ -17,6 +17,7 @@
 #include <lib/user_copy/user_ptr.h>
 #include <list.h>
 #include <stdint.h>
+#include <vm/page_source.h>
 #include <vm/pmm.h>
 #include <vm/vm.h>
 #include <vm/vm_object.h>
@@ -27,10 +28,23 @@
 // the main VM object type, holding a list of pages
 class VmObjectPaged final : public VmObject {
 public:
+    // options for Create()
+    enum : uint32_t {
+        // back the object with large physically contiguous runs of pages where possible
+        kLargePages = (1u << 0),
+    };
+
     static zx_status_t Create(uint32_t pmm_alloc_flags, uint64_t size, fbl::RefPtr<VmObject>* vmo);
+    static zx_status_t Create(uint32_t pmm_alloc_flags, uint32_t options, uint64_t size,
+                              fbl::RefPtr<VmObject>* vmo);
 
     static zx_status_t CreateFromROData(const void* data, size_t size, fbl::RefPtr<VmObject>* vmo);
 
+    // Creates an object whose pages come from |src| the first time they are
+    // needed, instead of being zero filled. These objects can't be resized.
+    static zx_status_t CreateExternal(fbl::RefPtr<PageSource> src, uint64_t size,
+                                      fbl::RefPtr<VmObject>* vmo);
+
     zx_status_t Resize(uint64_t size) override;
     zx_status_t ResizeLocked(uint64_t size) override TA_REQ(lock_);
     uint64_t size() const override
@@ -38,13 +52,16 @@ public:
         // any deadlocks.
         TA_NO_THREAD_SAFETY_ANALYSIS { return size_; }
     bool is_paged() const override { return true; }
+    bool prefers_large_pages() const override { return large_pages_; }
 
     size_t AllocatedPagesInRange(uint64_t offset, uint64_t len) const override;
+    void SetAttribution(fbl::RefPtr<VmAttribution> attribution) override;
 
     zx_status_t CommitRange(uint64_t offset, uint64_t len, uint64_t* committed) override;
     zx_status_t CommitRangeContiguous(uint64_t offset, uint64_t len, uint64_t* committed,
                                       uint8_t alignment_log2) override;
     zx_status_t DecommitRange(uint64_t offset, uint64_t len, uint64_t* decommitted) override;
+    zx_status_t ReplacePages(uint64_t offset, list_node* pages, size_t count) override;
 
     zx_status_t Pin(uint64_t offset, uint64_t len) override;
     void Unpin(uint64_t offset, uint64_t len) override;
@@ -58,6 +75,10 @@ public:
                          size_t* bytes_read) override;
     zx_status_t WriteUser(user_in_ptr<const void> ptr, uint64_t offset, size_t len,
                           size_t* bytes_written) override;
+    zx_status_t ReadUserVector(const iovec_t* vec, size_t count, uint64_t offset,
+                               size_t* bytes_read) override;
+    zx_status_t WriteUserVector(const iovec_t* vec, size_t count, uint64_t offset,
+                                size_t* bytes_written) override;
 
     zx_status_t LookupUser(uint64_t offset, uint64_t len, user_inout_ptr<paddr_t> buffer,
                            size_t buffer_size) override;
@@ -69,10 +90,15 @@ public:
     zx_status_t CleanInvalidateCache(const uint64_t offset, const uint64_t len) override;
     zx_status_t SyncCache(const uint64_t offset, const uint64_t len) override;
 
+    zx_status_t GetNodePolicy(uint32_t* policy, uint32_t* node) override;
+    zx_status_t SetNodePolicy(uint32_t policy, uint32_t node) override;
+
     zx_status_t GetPageLocked(uint64_t offset, uint pf_flags, list_node* free_list,
-                              vm_page_t**, paddr_t*) override
+                              PageRequest* page_request, vm_page_t**, paddr_t*) override
         // Calls a Locked method of the parent, which confuses analysis.
         TA_NO_THREAD_SAFETY_ANALYSIS;
+    zx_status_t GetLargePageLocked(uint64_t offset, uint8_t size_shift, uint pf_flags,
+                                   paddr_t* pa) override TA_REQ(lock_);
 
     zx_status_t CloneCOW(uint64_t offset, uint64_t size, bool copy_name,
                          fbl::RefPtr<VmObject>* clone_vmo) override
@@ -83,6 +109,49 @@ public:
         // Called under the parent's lock, which confuses analysis.
         TA_NO_THREAD_SAFETY_ANALYSIS;
 
+    // Merges every ancestor that only this object still references into this
+    // object, so later lookups have fewer parents to walk. Returns the number
+    // of parents removed from the chain.
+    uint32_t CollapseChain();
+
+    // Collapses the chains of the objects that page lookups found sitting on
+    // top of such a parent. Normally run by a background thread.
+    static void CollapseQueued();
+
+    // Frees committed pages that hold nothing but zeroes, so that they read
+    // back through the shared zero page until written again. Pinned pages,
+    // large page objects and objects mapped into the kernel are left alone.
+    // Returns the number of pages freed.
+    size_t FreeZeroPages();
+
+    // Runs FreeZeroPages() over every paged object in the system. Normally
+    // run periodically by a background thread.
+    static size_t ScanForZeroPages();
+
+    // Moves the contents of every movable page in the physical range of
+    // |count| pages at |pa| to a page outside of it, so the pmm can hand the
+    // range out as a contiguous run. The vacated pages, and any free pages of
+    // the range that turn up while allocating, are added to |vacated| in the
+    // ALLOC state. Returns the number of pages moved. Must not be called with
+    // any vm object lock held.
+    static size_t EvacuateRange(paddr_t pa, size_t count, list_node* vacated);
+
+    // The source this object was created with by CreateExternal(), if any.
+    const fbl::RefPtr<PageSource>& page_source() const { return page_source_; }
+
+    // Moves the pages of the page aligned range [offset, offset + len) out of
+    // this object and onto the tail of |pages| in the ALLOC state, in offset
+    // order. Holes in the range are committed first. Only works on objects
+    // that aren't clones or backed by a page source, and fails if any page of
+    // the range is pinned.
+    zx_status_t TakePages(uint64_t offset, uint64_t len, list_node* pages);
+
+    // Hands |pages|, as taken by TakePages(), to an object backed by a page
+    // source as the contents of the page aligned range [offset, offset + len),
+    // and lets the source know they are in. Pages for offsets that are
+    // already present are freed instead. |pages| is always left empty.
+    zx_status_t SupplyPages(uint64_t offset, uint64_t len, list_node* pages);
+
 private:
     // private constructor (use Create())
     explicit VmObjectPaged(uint32_t pmm_alloc_flags, fbl::RefPtr<VmObject> parent);
@@ -110,7 +179,10 @@ private:
     zx_status_t PinLocked(uint64_t offset, uint64_t len) TA_REQ(lock_);
     void UnpinLocked(uint64_t offset, uint64_t len) TA_REQ(lock_);
 
-    // internal check if any pages in a range are pinned
+    zx_status_t CommitRangeLocked(uint64_t offset, uint64_t len, uint64_t* committed) TA_REQ(lock_);
+
+    // internal check if any pages in a range are pinned, counting pages whose
+    // addresses were looked up, which are held just the same
     bool AnyPagesPinnedLocked(uint64_t offset, size_t len) TA_REQ(lock_);
 
     // internal read/write routine that takes a templated copy function to help share some code
@@ -121,14 +193,80 @@ private:
     // set our offset within our parent
     zx_status_t SetParentOffsetLocked(uint64_t o) TA_REQ(lock_);
 
+    // if our parent is an intermediate object that nothing but us refers to,
+    // move the pages of it we can see into us and take its place in the chain.
+    // the unlinked parent is handed back in |dead| so the caller can drop it
+    // once the lock is released.
+    bool CollapseParentLocked(fbl::RefPtr<VmObject>* dead)
+        // Walks objects that share our lock, which confuses analysis.
+        TA_NO_THREAD_SAFETY_ANALYSIS;
+    bool ParentCollapsibleLocked() const
+        // Looks at the parent under our shared lock, which confuses analysis.
+        TA_NO_THREAD_SAFETY_ANALYSIS;
+
+    // hand this object to the background thread that collapses chains
+    void QueueCollapseLocked() TA_REQ(lock_);
+
+    // true if a kernel address space maps this object, where faults can't be
+    // taken to bring a freed page back
+    bool MappedIntoKernelLocked() const TA_REQ(lock_);
+
+    // record where a page added to the page list lives, so compaction can find
+    // its way back to us to move it
+    void SetPageOwnerLocked(vm_page_t* p, uint64_t offset) TA_REQ(lock_);
+
+    // our part of EvacuateRange()
+    size_t EvacuatePages(paddr_t pa, size_t count, list_node* vacated);
+
+    // allocate pages for the object from the nodes its node policy picks
+    vm_page_t* AllocPageLocked(uint alloc_flags, paddr_t* pa) TA_REQ(lock_);
+    size_t AllocPagesLocked(size_t count, uint alloc_flags, list_node* pages) TA_REQ(lock_);
+
+    // drops our lock while waiting on a page source for the request that
+    // GetPageLocked() set up in |page_request|
+    zx_status_t WaitForPageLocked(PageRequest* page_request) TA_REQ(lock_);
+
     // maximum size of a VMO is one page less than the full 64bit range
     static const uint64_t MAX_SIZE = ROUNDDOWN(UINT64_MAX, PAGE_SIZE);
 
     // members
     uint64_t size_ TA_GUARDED(lock_) = 0;
     uint64_t parent_offset_ TA_GUARDED(lock_) = 0;
+    // our parent's pages are only visible below this offset, set when a
+    // collapse takes us past a parent that was smaller than our view of it
+    uint64_t parent_limit_ TA_GUARDED(lock_) = MAX_SIZE;
     uint32_t pmm_alloc_flags_ TA_GUARDED(lock_) = PMM_ALLOC_FLAG_ANY;
+    bool large_pages_ = false;
+
+    // see SetNodePolicy(), interleave_next_ is the node the next page of an
+    // interleaved object comes from
+    uint32_t node_policy_ TA_GUARDED(lock_) = PMM_NODE_POLICY_LOCAL;
+    uint32_t policy_node_ TA_GUARDED(lock_) = 0;
+    uint32_t interleave_next_ TA_GUARDED(lock_) = 0;
+
+    // where our pages come from if we were created with CreateExternal(), and
+    // whether we or one of our ancestors were
+    fbl::RefPtr<PageSource> page_source_;
+    bool source_backed_ = false;
 
     // a tree of pages
     VmPageList page_list_ TA_GUARDED(lock_);
+
+    // Per-node state for the queue of objects waiting for their chain to be collapsed.
+    using CollapseNodeState = fbl::DoublyLinkedListNodeState<fbl::RefPtr<VmObjectPaged>>;
+    CollapseNodeState collapse_list_state_;
+    bool collapse_queued_ TA_GUARDED(lock_) = false;
+
+    // set once LookupUser() has handed out the address of one of our pages,
+    // after which we are never collapsed into a child
+    bool pages_looked_up_ TA_GUARDED(lock_) = false;
+
+    struct CollapseListTraits {
+        static CollapseNodeState& node_state(VmObjectPaged& vmo) {
+            return vmo.collapse_list_state_;
+        }
+    };
+    using CollapseList = fbl::DoublyLinkedList<fbl::RefPtr<VmObjectPaged>, CollapseListTraits>;
+    static fbl::Mutex collapse_lock_;
+    static CollapseList collapse_list_ TA_GUARDED(collapse_lock_);
 };
@@ -40,7 +40,13 @@ public:
     void Dump(uint depth, bool verbose) override;
 
     zx_status_t GetPageLocked(uint64_t offset, uint pf_flags, list_node* free_list,
-                              vm_page_t**, paddr_t* pa) override TA_REQ(lock_);
+                              PageRequest* page_request, vm_page_t**, paddr_t* pa) override
+        TA_REQ(lock_);
+
+    // physical objects are contiguous, so any suitably aligned range can use large pages
+    bool prefers_large_pages() const override { return true; }
+    zx_status_t GetLargePageLocked(uint64_t offset, uint8_t size_shift, uint pf_flags,
+                                   paddr_t* pa) override TA_REQ(lock_);
 
     zx_status_t GetMappingCachePolicy(uint32_t* cache_policy) override;
     zx_status_t SetMappingCachePolicy(const uint32_t cache_policy) override;
@@ -10,8 +10,10 @@
 #include <fbl/canary.h>
 #include <fbl/intrusive_wavl_tree.h>
 #include <fbl/macros.h>
+#include <fbl/ref_ptr.h>
 #include <fbl/unique_ptr.h>
 #include <vm/vm.h>
+#include <vm/vm_attribution.h>
 #include <zircon/types.h>
 
 struct vm_page;
@@ -189,9 +191,30 @@ public:
 
     zx_status_t AddPage(vm_page*, uint64_t offset);
     vm_page* GetPage(uint64_t offset);
+    // puts |p| in place of the page at |offset| and returns the old page, or
+    // returns nullptr and leaves the list alone if there is no page there
+    vm_page* ReplacePage(vm_page* p, uint64_t offset);
+    // takes the page at |offset| out of the list and returns it, or nullptr if there is none
+    vm_page* RemovePage(uint64_t offset);
     zx_status_t FreePage(uint64_t offset);
     size_t FreeAllPages();
 
+    // the number of pages in the list, kept as they are added and removed
+    size_t count() const { return count_; }
+
+    // counts the pages in the list, now and as they change, in |attribution|
+    // rather than whatever counted them before
+    void SetAttribution(fbl::RefPtr<VmAttribution> attribution);
+
 private:
+    void AdjustCount(int64_t delta) {
+        count_ += delta;
+        if (attribution_) {
+            attribution_->AddPages(delta);
+        }
+    }
+
     fbl::WAVLTree<uint64_t, fbl::unique_ptr<VmPageListNode>> list_;
+    size_t count_ = 0;
+    fbl::RefPtr<VmAttribution> attribution_;
 };
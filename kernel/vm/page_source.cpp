@@ -0,0 +1,147 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <vm/page_source.h>
+
+#include "vm_priv.h"
+
+#include <assert.h>
+#include <err.h>
+#include <fbl/alloc_checker.h>
+#include <inttypes.h>
+#include <lib/counters.h>
+#include <trace.h>
+#include <vm/vm.h>
+
+#define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
+
+using fbl::AutoLock;
+
+KCOUNTER(vm_page_source_requests, "kernel.vm.page_source.requests");
+
+PageSourceRequest::PageSourceRequest(uint64_t offset, uint64_t len)
+    : offset_(offset), len_(len) {
+    event_init(&event_, false, 0);
+}
+
+PageSourceRequest::~PageSourceRequest() {
+    event_destroy(&event_);
+}
+
+zx_status_t PageRequest::Wait() {
+    DEBUG_ASSERT(request_);
+
+    // the request is kept alive by our reference even once the source is done with it
+    zx_status_t status = event_wait_deadline(&request_->event_, ZX_TIME_INFINITE, true);
+    request_.reset();
+    return status;
+}
+
+PageSource::~PageSource() {
+    DEBUG_ASSERT(outstanding_.is_empty());
+}
+
+zx_status_t PageSource::GetPage(uint64_t offset, uint64_t size, PageRequest* req) {
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(offset));
+    DEBUG_ASSERT(offset < size);
+
+    AutoLock guard(&lock_);
+
+    if (closed_)
+        return ZX_ERR_BAD_STATE;
+
+    for (auto& r : outstanding_) {
+        if (offset >= r.offset() && offset < r.end()) {
+            if (req)
+                req->request_ = fbl::WrapRefPtr(&r);
+            return ZX_ERR_SHOULD_WAIT;
+        }
+    }
+
+    // ask for the aligned batch around the page, clipped to the object and to
+    // the requests that are already outstanding so no page is asked for twice
+    const uint64_t batch = kBatchPages * PAGE_SIZE;
+    uint64_t start = ROUNDDOWN(offset, batch);
+    uint64_t end = MIN(start + batch, ROUNDUP(size, PAGE_SIZE));
+    for (const auto& r : outstanding_) {
+        if (r.end() <= offset && r.end() > start)
+            start = r.end();
+        if (r.offset() > offset && r.offset() < end)
+            end = r.offset();
+    }
+
+    fbl::AllocChecker ac;
+    fbl::RefPtr<PageSourceRequest> request =
+        fbl::AdoptRef(new (&ac) PageSourceRequest(start, end - start));
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    LTRACEF("source %p requesting [%#" PRIx64 ", %#" PRIx64 ") for %#" PRIx64 "\n",
+            this, start, end, offset);
+
+    zx_status_t status = SendReadRequest(start, end - start);
+    if (status != ZX_OK)
+        return status;
+    kcounter_add(vm_page_source_requests, 1);
+
+    if (req)
+        req->request_ = request;
+    outstanding_.push_back(fbl::move(request));
+
+    return ZX_ERR_SHOULD_WAIT;
+}
+
+void PageSource::QueueRemainderLocked(const PageSourceRequest& req, uint64_t start, uint64_t end) {
+    // the provider still owes us these pages and knows it, so track them without
+    // asking again. if we're out of memory, the next fault on them asks again.
+    const uint64_t pieces[2][2] = {
+        {req.offset(), MIN(start, req.end())},
+        {MAX(end, req.offset()), req.end()},
+    };
+    for (const auto& piece : pieces) {
+        if (piece[0] >= piece[1])
+            continue;
+        fbl::AllocChecker ac;
+        fbl::RefPtr<PageSourceRequest> remainder =
+            fbl::AdoptRef(new (&ac) PageSourceRequest(piece[0], piece[1] - piece[0]));
+        if (ac.check())
+            outstanding_.push_front(fbl::move(remainder));
+    }
+}
+
+void PageSource::OnPagesSupplied(uint64_t offset, uint64_t len) {
+    const uint64_t end = offset + len;
+
+    AutoLock guard(&lock_);
+
+    for (auto iter = outstanding_.begin(); iter != outstanding_.end();) {
+        auto cur = iter++;
+        if (cur->end() <= offset || cur->offset() >= end)
+            continue;
+
+        // waiters retry their lookup, and wait again on the remainder if the
+        // page they wanted is not in yet
+        fbl::RefPtr<PageSourceRequest> request = outstanding_.erase(cur);
+        QueueRemainderLocked(*request, offset, end);
+        event_signal_etc(&request->event_, false, ZX_OK);
+    }
+}
+
+void PageSource::Close() {
+    {
+        AutoLock guard(&lock_);
+        if (closed_)
+            return;
+        closed_ = true;
+
+        while (!outstanding_.is_empty()) {
+            fbl::RefPtr<PageSourceRequest> request = outstanding_.pop_front();
+            event_signal_etc(&request->event_, false, ZX_ERR_BAD_STATE);
+        }
+    }
+
+    OnClose();
+}
@@ -10,7 +10,11 @@
 #include <assert.h>
 #include <err.h>
 #include <inttypes.h>
+#include <kernel/align.h>
+#include <kernel/event.h>
 #include <kernel/mp.h>
+#include <kernel/spinlock.h>
+#include <kernel/thread.h>
 #include <kernel/timer.h>
 #include <lib/console.h>
 #include <lk/init.h>
@@ -22,10 +26,12 @@
 #include <vm/bootalloc.h>
 #include <vm/physmap.h>
 #include <vm/vm.h>
+#include <vm/vm_object_paged.h>
 
 #include "pmm_arena.h"
 #include "vm_priv.h"
 
+#include <fbl/alloc_checker.h>
 #include <fbl/auto_lock.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/mutex.h>
@@ -42,6 +48,386 @@ static fbl::Mutex arena_lock;
 static fbl::DoublyLinkedList<PmmArena*> arena_list TA_GUARDED(arena_lock);
 static size_t arena_cumulative_size TA_GUARDED(arena_lock);
 
+// The NUMA topology. Like the arena list, this is only written during boot,
+// so it is read without the lock.
+static uint node_count = 1;
+static uint8_t cpu_nodes[SMP_MAX_CPUS];
+
+namespace {
+
+// Each cpu keeps a small cache of free pages in front of the arenas so that
+// single page allocations and frees, such as those done by page faults, do
+// not all serialize on the arena lock. Caches are refilled from and drained
+// to the arenas kPcpuCacheBatch pages at a time. Pages sitting in a cache are
+// in the ALLOC state as far as the arenas are concerned, and only serve
+// allocations that have no arena restrictions. With more than one NUMA node
+// a cache only holds pages local to its cpu.
+constexpr size_t kPcpuCacheBatch = 32;
+// Free fill checking happens in the arenas, so it needs every page to pass through them.
+constexpr bool kPcpuCacheEnabled = !PMM_ENABLE_FREE_FILL;
+constexpr size_t kPcpuCacheMax = 2 * kPcpuCacheBatch;
+
+struct pmm_pcpu_cache {
+    SpinLock lock;
+    list_node pages TA_GUARDED(lock) = LIST_INITIAL_VALUE(pages);
+    size_t count TA_GUARDED(lock) = 0;
+
+    // Statistics for the pmm console command. These are plain per-cpu
+    // values rather than kcounters since the pmm is in use before the
+    // kcounters are set up.
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t drains = 0;
+    uint64_t lock_acquires = 0;
+    uint64_t lock_contended = 0;
+} __CPU_ALIGN;
+
+pmm_pcpu_cache pcpu_caches[SMP_MAX_CPUS];
+
+// A pool of free pages that a low priority thread has already zeroed, so that
+// PMM_ALLOC_FLAG_ZEROED allocations, which back most anonymous memory, do not
+// have to clear pages inline. Like the cpu caches, pooled pages are in the
+// ALLOC state as far as the arenas are concerned. The thread tops the pool up
+// to kZeroPoolMax whenever it falls below kZeroPoolLow, as long as it would
+// leave the arenas with more than kZeroPoolReserve free pages. Every NUMA
+// node has a pool of its own pages.
+constexpr bool kZeroPoolEnabled = !PMM_ENABLE_FREE_FILL;
+constexpr size_t kZeroPoolMax = 1024;
+constexpr size_t kZeroPoolLow = kZeroPoolMax / 2;
+constexpr size_t kZeroPoolReserve = 4096;
+
+struct pmm_zero_pool {
+    SpinLock lock;
+    list_node pages TA_GUARDED(lock) = LIST_INITIAL_VALUE(pages);
+    size_t count TA_GUARDED(lock) = 0;
+
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t zeroed = 0;
+};
+
+pmm_zero_pool zero_pools[PMM_MAX_NODES];
+
+// signaled when a pool drops below kZeroPoolLow
+event_t zero_pool_event = EVENT_INITIAL_VALUE(zero_pool_event, false, EVENT_FLAG_AUTOUNSIGNAL);
+
+// When pmm_alloc_contiguous finds no free run and may compact, it picks the
+// run needing the fewest movable pages moved, reserves its free pages and has
+// the owners of the rest migrate them elsewhere. A run that can't be fully
+// cleared, for instance because one of its pages was pinned in the meantime,
+// is given back and the next best one tried, up to kCompactMaxRuns times.
+// Compactions are serialized so that two of them don't split a run.
+constexpr int kCompactMaxRuns = 4;
+
+struct pmm_compaction {
+    fbl::Mutex lock;
+
+    // statistics for the pmm console command, see pmm_pcpu_cache
+    uint64_t requests = 0;
+    uint64_t successes = 0;
+    uint64_t runs_abandoned = 0;
+    uint64_t pages_moved = 0;
+};
+
+pmm_compaction compaction;
+
+pmm_pcpu_cache& local_cache() {
+    // we may migrate right after this, which is harmless since every cache
+    // has its own lock
+    return pcpu_caches[arch_curr_cpu_num()];
+}
+
+void stat_inc(uint64_t* stat) {
+    __atomic_fetch_add(stat, 1, __ATOMIC_RELAXED);
+}
+
+// Takes the arena lock, counting the times some other thread already had it.
+class TA_SCOPED_CAP ArenaAutoLock {
+public:
+    ArenaAutoLock() TA_ACQ(arena_lock) {
+        pmm_pcpu_cache& cache = local_cache();
+        stat_inc(&cache.lock_acquires);
+        if (mutex_holder(arena_lock.GetInternal()) != nullptr)
+            stat_inc(&cache.lock_contended);
+        arena_lock.Acquire();
+    }
+    ~ArenaAutoLock() TA_REL() { arena_lock.Release(); }
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(ArenaAutoLock);
+};
+
+} // namespace
+
+static size_t pmm_alloc_pages_locked(size_t count, uint alloc_flags, uint node,
+                                     struct list_node* list) TA_REQ(arena_lock);
+static size_t pmm_free_locked(struct list_node* list) TA_REQ(arena_lock);
+static size_t pmm_count_free_pages_locked() TA_REQ(arena_lock);
+
+// Moves up to |count| pages from the local cache to the tail of |list|.
+static size_t pcpu_cache_take(size_t count, list_node* list) {
+    pmm_pcpu_cache& cache = local_cache();
+
+    spin_lock_saved_state_t state;
+    cache.lock.AcquireIrqSave(state);
+    size_t taken = 0;
+    while (taken < count && cache.count > 0) {
+        vm_page_t* page = list_remove_head_type(&cache.pages, vm_page_t, free.node);
+        list_add_tail(list, &page->free.node);
+        cache.count--;
+        taken++;
+    }
+    cache.lock.ReleaseIrqRestore(state);
+
+    return taken;
+}
+
+// Adds the pages on |list| to the front of the local cache, so they are the
+// next to be handed out while still warm. If that takes the cache over
+// kPcpuCacheMax, a batch of the coldest pages goes back to the arenas.
+static void pcpu_cache_put(list_node* list) {
+    pmm_pcpu_cache& cache = local_cache();
+
+    list_node excess = LIST_INITIAL_VALUE(excess);
+
+    spin_lock_saved_state_t state;
+    cache.lock.AcquireIrqSave(state);
+    list_node* node;
+    while ((node = list_remove_head(list)) != nullptr) {
+        list_add_head(&cache.pages, node);
+        cache.count++;
+    }
+    if (cache.count > kPcpuCacheMax) {
+        while (cache.count > kPcpuCacheMax - kPcpuCacheBatch) {
+            list_add_tail(&excess, list_remove_tail(&cache.pages));
+            cache.count--;
+        }
+    }
+    cache.lock.ReleaseIrqRestore(state);
+
+    if (!list_is_empty(&excess)) {
+        stat_inc(&cache.drains);
+        ArenaAutoLock al;
+        pmm_free_locked(&excess);
+    }
+}
+
+// Allocates |count| pages without arena restrictions, preferring the local
+// cache and refilling it with a batch from the arenas when it runs dry.
+// Returns the number of pages added to the tail of |list|.
+static size_t pcpu_cache_alloc(size_t count, list_node* list) {
+    size_t allocated = pcpu_cache_take(count, list);
+    if (allocated == count) {
+        stat_inc(&local_cache().hits);
+        return allocated;
+    }
+    stat_inc(&local_cache().misses);
+
+    list_node batch = LIST_INITIAL_VALUE(batch);
+    {
+        ArenaAutoLock al;
+        pmm_alloc_pages_locked(count - allocated + kPcpuCacheBatch, PMM_ALLOC_FLAG_ANY,
+                               PMM_NODE_LOCAL, &batch);
+    }
+    while (allocated < count && !list_is_empty(&batch)) {
+        list_add_tail(list, list_remove_head(&batch));
+        allocated++;
+    }
+    if (!list_is_empty(&batch))
+        pcpu_cache_put(&batch);
+
+    return allocated;
+}
+
+// Returns every cached page to the arenas, for when a request can only be
+// met with particular pages or the caches may be holding the last free ones.
+static void pcpu_cache_drain_all() {
+    list_node pages = LIST_INITIAL_VALUE(pages);
+    for (auto& cache : pcpu_caches) {
+        spin_lock_saved_state_t state;
+        cache.lock.AcquireIrqSave(state);
+        while (cache.count > 0) {
+            list_add_tail(&pages, list_remove_head(&cache.pages));
+            cache.count--;
+        }
+        cache.lock.ReleaseIrqRestore(state);
+    }
+
+    if (!list_is_empty(&pages)) {
+        stat_inc(&local_cache().drains);
+        ArenaAutoLock al;
+        pmm_free_locked(&pages);
+    }
+}
+
+// An approximate count of the cached pages. This does not take the cache
+// locks, so that it can be used from the pmm free timer.
+static size_t pcpu_cache_count() TA_NO_THREAD_SAFETY_ANALYSIS {
+    size_t count = 0;
+    for (auto& cache : pcpu_caches)
+        count += __atomic_load_n(&cache.count, __ATOMIC_RELAXED);
+    return count;
+}
+
+// Moves up to |count| pages from the zero pool to the tail of |list|.
+static size_t zero_pool_take(pmm_zero_pool* pool, size_t count, list_node* list) {
+    spin_lock_saved_state_t state;
+    pool->lock.AcquireIrqSave(state);
+    size_t taken = 0;
+    while (taken < count && pool->count > 0) {
+        vm_page_t* page = list_remove_head_type(&pool->pages, vm_page_t, free.node);
+        list_add_tail(list, &page->free.node);
+        pool->count--;
+        taken++;
+    }
+    size_t remaining = pool->count;
+    pool->lock.ReleaseIrqRestore(state);
+
+    // kick the zeroing thread when crossing the low mark, or whenever the
+    // pool comes up short in case it gave up for lack of free memory
+    if ((remaining < kZeroPoolLow && remaining + taken >= kZeroPoolLow) || taken < count)
+        event_signal(&zero_pool_event, false);
+
+    return taken;
+}
+
+// Returns every pooled page to the arenas.
+static void zero_pool_drain() {
+    list_node pages = LIST_INITIAL_VALUE(pages);
+
+    for (auto& pool : zero_pools) {
+        spin_lock_saved_state_t state;
+        pool.lock.AcquireIrqSave(state);
+        while (pool.count > 0) {
+            list_add_tail(&pages, list_remove_head(&pool.pages));
+            pool.count--;
+        }
+        pool.lock.ReleaseIrqRestore(state);
+    }
+
+    if (!list_is_empty(&pages)) {
+        ArenaAutoLock al;
+        pmm_free_locked(&pages);
+    }
+}
+
+// An approximate count of the pooled pages, see pcpu_cache_count().
+static size_t zero_pool_count(const pmm_zero_pool& pool) TA_NO_THREAD_SAFETY_ANALYSIS {
+    return __atomic_load_n(&pool.count, __ATOMIC_RELAXED);
+}
+
+static size_t zero_pool_count() {
+    size_t count = 0;
+    for (const auto& pool : zero_pools)
+        count += zero_pool_count(pool);
+    return count;
+}
+
+// Free pages held outside of the arenas.
+static size_t pmm_count_cached_pages() {
+    return pcpu_cache_count() + zero_pool_count();
+}
+
+// Puts every page held outside of the arenas back into them.
+static void pmm_drain_caches() {
+    pcpu_cache_drain_all();
+    zero_pool_drain();
+}
+
+static void clear_page(vm_page_t* page) {
+    arch_zero_page(paddr_to_physmap(vm_page_to_paddr(page)));
+}
+
+// Tops up the pool of |node| with pages of that node.
+static void zero_pool_fill(uint node) {
+    pmm_zero_pool& pool = zero_pools[node];
+
+    for (;;) {
+        size_t want = kZeroPoolMax - zero_pool_count(pool);
+        if (want == 0 || want > kZeroPoolMax)
+            break;
+        want = MIN(want, kPcpuCacheBatch);
+
+        list_node batch = LIST_INITIAL_VALUE(batch);
+        {
+            ArenaAutoLock al;
+            if (pmm_count_free_pages_locked() <= kZeroPoolReserve + want)
+                break;
+            pmm_alloc_pages_locked(want, PMM_ALLOC_FLAG_NODE_STRICT, node, &batch);
+        }
+
+        size_t count = 0;
+        vm_page_t* page;
+        list_for_every_entry(&batch, page, vm_page_t, free.node) {
+            clear_page(page);
+            count++;
+        }
+        if (count == 0)
+            break;
+
+        spin_lock_saved_state_t state;
+        pool.lock.AcquireIrqSave(state);
+        list_node* n;
+        while ((n = list_remove_head(&batch)) != nullptr)
+            list_add_tail(&pool.pages, n);
+        pool.count += count;
+        pool.lock.ReleaseIrqRestore(state);
+
+        __atomic_fetch_add(&pool.zeroed, count, __ATOMIC_RELAXED);
+    }
+}
+
+static int zero_pool_thread(void*) {
+    for (;;) {
+        __UNUSED zx_status_t err = event_wait(&zero_pool_event);
+        DEBUG_ASSERT(err == ZX_OK);
+
+        for (uint node = 0; node < node_count; node++)
+            zero_pool_fill(node);
+    }
+
+    return 0;
+}
+
+static void zero_pool_init(uint level) {
+    if (!kZeroPoolEnabled)
+        return;
+
+    // just above the idle threads, so zeroing only uses otherwise idle cpu time
+    thread_t* t = thread_create("pmm-zero", &zero_pool_thread, nullptr, LOWEST_PRIORITY + 1,
+                                DEFAULT_STACK_SIZE);
+    thread_detach_and_resume(t);
+
+    // fill the pools for the first time
+    event_signal(&zero_pool_event, false);
+}
+
+LK_INIT_HOOK(pmm_zero_pool, &zero_pool_init, LK_INIT_LEVEL_THREADING);
+
+// Allocates |count| zeroed pages of |node|, preferring its pool and clearing
+// any shortfall inline. Returns the number of pages added to the tail of |list|.
+static size_t pmm_alloc_zeroed(size_t count, uint alloc_flags, uint node, list_node* list) {
+    size_t allocated = 0;
+    if (kZeroPoolEnabled && !(alloc_flags & PMM_ALLOC_FLAG_KMAP)) {
+        pmm_zero_pool& pool = zero_pools[node];
+        allocated = zero_pool_take(&pool, count, list);
+        stat_inc(allocated == count ? &pool.hits : &pool.misses);
+        if (allocated == count)
+            return allocated;
+    }
+
+    list_node pages = LIST_INITIAL_VALUE(pages);
+    pmm_alloc_pages_node(count - allocated, alloc_flags, node, &pages);
+
+    list_node* n;
+    while ((n = list_remove_head(&pages)) != nullptr) {
+        clear_page(containerof(n, vm_page_t, free.node));
+        list_add_tail(list, n);
+        allocated++;
+    }
+
+    return allocated;
+}
+
 #if PMM_ENABLE_FREE_FILL
 static void pmm_enforce_fill(uint level) {
     for (auto& a : arena_list) {
@@ -113,29 +499,170 @@ done_add:
     return ZX_OK;
 }
 
-vm_page_t* pmm_alloc_page(uint alloc_flags, paddr_t* pa) {
-    AutoLock al(&arena_lock);
+// This changes the arena list, which the lockless lookups such as
+// vm_page_to_paddr() rely on staying put, so it may only be called while the
+// boot cpu is the only one running.
+zx_status_t pmm_set_node_range(paddr_t base, size_t size, uint node) {
+    LTRACEF("base %#" PRIxPTR " size %#zx node %u\n", base, size, node);
+
+    if (node >= PMM_MAX_NODES)
+        return ZX_ERR_OUT_OF_RANGE;
+
+    const paddr_t end = ROUNDUP(base + size, PAGE_SIZE);
+    base = ROUNDDOWN(base, PAGE_SIZE);
+
+    ArenaAutoLock al;
+
+    for (auto iter = arena_list.begin(); iter != arena_list.end(); ++iter) {
+        const paddr_t arena_end = iter->base() + iter->size();
+        if (arena_end <= base || iter->base() >= end)
+            continue;
+
+        /* split off whatever lies past either edge of the range, the piece
+         * before it is looked at again on the next iteration */
+        const paddr_t split = iter->base() < base ? base : end;
+        if (split > iter->base() && split < arena_end) {
+            pmm_arena_info_t info = iter->info();
+            info.base = split;
+            info.size = arena_end - split;
+
+            fbl::AllocChecker ac;
+            PmmArena* tail = new (&ac) PmmArena(&info);
+            if (!ac.check())
+                return ZX_ERR_NO_MEMORY;
+            iter->SplitInto(tail);
+            arena_list.insert_after(iter, tail);
+
+            if (split == base)
+                continue;
+        }
 
-    /* walk the arenas in order until we find one with a free page */
-    for (auto& a : arena_list) {
-        /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
-        if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
-            if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
+        iter->set_node(node);
+    }
+
+    node_count = MAX(node_count, node + 1);
+    return ZX_OK;
+}
+
+void pmm_set_cpu_node(uint cpu, uint node) {
+    DEBUG_ASSERT(cpu < SMP_MAX_CPUS);
+    DEBUG_ASSERT(node < PMM_MAX_NODES);
+
+    cpu_nodes[cpu] = static_cast<uint8_t>(node);
+    node_count = MAX(node_count, node + 1);
+}
+
+uint pmm_cpu_node(uint cpu) {
+    return cpu_nodes[cpu];
+}
+
+// We don't need to hold the arena lock, see vm_page_to_paddr().
+uint pmm_page_node(const vm_page_t* page) TA_NO_THREAD_SAFETY_ANALYSIS {
+    for (const auto& a : arena_list) {
+        if (a.page_belongs_to_arena(page))
+            return a.node();
+    }
+    return 0;
+}
+
+uint pmm_node_count() {
+    return node_count;
+}
+
+static uint pmm_resolve_node(uint node) {
+    if (node == PMM_NODE_LOCAL)
+        return pmm_cpu_node(arch_curr_cpu_num());
+    DEBUG_ASSERT(node < PMM_MAX_NODES);
+    return node;
+}
+
+// Whether an allocation can be served from the local cpu cache.
+static bool pmm_use_cache(uint alloc_flags, uint node) {
+    return kPcpuCacheEnabled &&
+           !(alloc_flags & (PMM_ALLOC_FLAG_KMAP | PMM_ALLOC_FLAG_NODE_STRICT)) &&
+           node == pmm_cpu_node(arch_curr_cpu_num());
+}
+
+// Calls |func| on every arena an allocation with |alloc_flags| may use until
+// it returns true. When there is more than one node the arenas of |node| go
+// first, and with PMM_ALLOC_FLAG_NODE_STRICT they are the only ones.
+template <typename Func>
+static void pmm_for_each_alloc_arena_locked(uint alloc_flags, uint node, Func func)
+    TA_REQ(arena_lock) {
+    const bool numa = node_count > 1;
+    node = pmm_resolve_node(node);
+
+    for (int pass = 0; pass < 2; pass++) {
+        for (auto& a : arena_list) {
+            /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
+            if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
+                if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
+                    continue;
+            }
+
+            /* the first pass is over the wanted node, the second over the rest */
+            if (numa && (a.node() == node) != (pass == 0))
                 continue;
+
+            if (func(a))
+                return;
         }
 
-        // try to allocate the page out of the arena
-        vm_page_t* page = a.AllocPage(pa);
-        if (page)
+        if (!numa || (alloc_flags & PMM_ALLOC_FLAG_NODE_STRICT))
+            return;
+    }
+}
+
+vm_page_t* pmm_alloc_page(uint alloc_flags, paddr_t* pa) {
+    return pmm_alloc_page_node(alloc_flags, PMM_NODE_LOCAL, pa);
+}
+
+vm_page_t* pmm_alloc_page_node(uint alloc_flags, uint node, paddr_t* pa) {
+    node = pmm_resolve_node(node);
+
+    if (alloc_flags & PMM_ALLOC_FLAG_ZEROED) {
+        list_node list = LIST_INITIAL_VALUE(list);
+        if (pmm_alloc_zeroed(1, alloc_flags & ~PMM_ALLOC_FLAG_ZEROED, node, &list) != 1)
+            return nullptr;
+        vm_page_t* page = list_remove_head_type(&list, vm_page_t, free.node);
+        if (pa)
+            *pa = vm_page_to_paddr(page);
+        return page;
+    }
+
+    if (pmm_use_cache(alloc_flags, node)) {
+        list_node list = LIST_INITIAL_VALUE(list);
+        if (pcpu_cache_alloc(1, &list) == 1) {
+            vm_page_t* page = list_remove_head_type(&list, vm_page_t, free.node);
+            if (pa)
+                *pa = vm_page_to_paddr(page);
             return page;
+        }
+        // the other cpus or the zero pool may be sitting on the last free pages
+        pmm_drain_caches();
     }
 
-    LTRACEF("failed to allocate page\n");
-    return nullptr;
+    ArenaAutoLock al;
+
+    /* walk the arenas in order until we find one with a free page */
+    vm_page_t* page = nullptr;
+    pmm_for_each_alloc_arena_locked(alloc_flags, node, [&page, pa](PmmArena& a) {
+        // try to allocate the page out of the arena
+        page = a.AllocPage(pa);
+        return page != nullptr;
+    });
+
+    if (!page)
+        LTRACEF("failed to allocate page\n");
+    return page;
 }
 
 size_t pmm_alloc_pages(size_t count, uint alloc_flags, struct list_node* list) {
-    LTRACEF("count %zu\n", count);
+    return pmm_alloc_pages_node(count, alloc_flags, PMM_NODE_LOCAL, list);
+}
+
+size_t pmm_alloc_pages_node(size_t count, uint alloc_flags, uint node, struct list_node* list) {
+    LTRACEF("count %zu node %#x\n", count, node);
 
     /* list must be initialized prior to calling this */
     DEBUG_ASSERT(list);
@@ -143,25 +670,39 @@ size_t pmm_alloc_pages(size_t count, uint alloc_flags, struct list_node* list) {
     if (count == 0)
         return 0;
 
-    AutoLock al(&arena_lock);
+    node = pmm_resolve_node(node);
+
+    if (alloc_flags & PMM_ALLOC_FLAG_ZEROED)
+        return pmm_alloc_zeroed(count, alloc_flags & ~PMM_ALLOC_FLAG_ZEROED, node, list);
+
+    /* small requests are served from the local cache, large ones go straight to the arenas */
+    size_t allocated = 0;
+    if (pmm_use_cache(alloc_flags, node) && count < kPcpuCacheBatch) {
+        allocated = pcpu_cache_alloc(count, list);
+        if (allocated == count)
+            return allocated;
+        pmm_drain_caches();
+    }
+
+    ArenaAutoLock al;
+    return allocated + pmm_alloc_pages_locked(count - allocated, alloc_flags, node, list);
+}
+
+static size_t pmm_alloc_pages_locked(size_t count, uint alloc_flags, uint node,
+                                     struct list_node* list) {
+    if (count == 0)
+        return 0;
 
     /* walk the arenas in order, allocating as many pages as we can from each */
     size_t allocated = 0;
-    for (auto& a : arena_list) {
+    pmm_for_each_alloc_arena_locked(alloc_flags, node, [&](PmmArena& a) {
         DEBUG_ASSERT(count > allocated);
 
-        /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
-        if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
-            if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
-                continue;
-        }
-
         // ask the arena to allocate some pages
         allocated += a.AllocPages(count - allocated, list);
         DEBUG_ASSERT(allocated <= count);
-        if (allocated == count)
-            break;
-    }
+        return allocated == count;
+    });
 
     return allocated;
 }
@@ -175,7 +716,11 @@ size_t pmm_alloc_range(paddr_t address, size_t count, struct list_node* list) {
 
     address = ROUNDDOWN(address, PAGE_SIZE);
 
-    AutoLock al(&arena_lock);
+    /* the pages asked for may be sitting in a cache */
+    if (kPcpuCacheEnabled)
+        pmm_drain_caches();
+
+    ArenaAutoLock al;
 
     /* walk through the arenas, looking to see if the physical page belongs to it */
     for (auto& a : arena_list) {
@@ -198,6 +743,99 @@ size_t pmm_alloc_range(paddr_t address, size_t count, struct list_node* list) {
     return allocated;
 }
 
+// Finds the best run to compact in the arenas, starting the search at page
+// |*start| of |*arena|, or at the first arena if that is null.
+static bool pmm_find_compactable_run_locked(size_t count, uint alloc_flags, uint8_t alignment_log2,
+                                            PmmArena** arena, size_t* start, size_t* movable)
+    TA_REQ(arena_lock) {
+    auto iter = *arena ? arena_list.make_iterator(**arena) : arena_list.begin();
+    if (!*arena)
+        *start = 0;
+
+    for (; iter != arena_list.end(); ++iter, *start = 0) {
+        /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
+        if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
+            if ((iter->flags() & PMM_ARENA_FLAG_KMAP) == 0)
+                continue;
+        }
+
+        if (iter->FindCompactableRun(count, alignment_log2, start, movable)) {
+            *arena = &*iter;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Allocates the pages of the run that are free, adding them to |reserved|.
+static void pmm_reserve_run_locked(PmmArena* arena, size_t start, size_t count,
+                                   list_node* reserved) TA_REQ(arena_lock) {
+    for (size_t i = start; i < start + count; i++) {
+        vm_page_t* page = arena->AllocSpecific(arena->base() + i * PAGE_SIZE);
+        if (page)
+            list_add_tail(reserved, &page->free.node);
+    }
+}
+
+static size_t pmm_compact_contiguous(size_t count, uint alloc_flags, uint8_t alignment_log2,
+                                     paddr_t* pa, struct list_node* list) {
+    AutoLock compaction_lock(&compaction.lock);
+    stat_inc(&compaction.requests);
+
+    PmmArena* arena = nullptr;
+    size_t start = 0;
+    for (int runs = 0; runs < kCompactMaxRuns; runs++) {
+        list_node reserved = LIST_INITIAL_VALUE(reserved);
+        size_t movable;
+        {
+            ArenaAutoLock al;
+            if (!pmm_find_compactable_run_locked(count, alloc_flags, alignment_log2, &arena,
+                                                 &start, &movable)) {
+                break;
+            }
+            pmm_reserve_run_locked(arena, start, count, &reserved);
+        }
+
+        const paddr_t run_pa = arena->base() + start * PAGE_SIZE;
+        LTRACEF("compacting %zu pages at %#" PRIxPTR ", %zu to move\n", count, run_pa, movable);
+
+        size_t moved = VmObjectPaged::EvacuateRange(run_pa, count, &reserved);
+        __atomic_fetch_add(&compaction.pages_moved, moved, __ATOMIC_RELAXED);
+
+        /* pages of the run freed while the rest were moved may be sitting in a cache */
+        pmm_drain_caches();
+        {
+            ArenaAutoLock al;
+            pmm_reserve_run_locked(arena, start, count, &reserved);
+
+            if (list_length(&reserved) == count) {
+                /* hand the run out in address order, like AllocContiguous */
+                if (list) {
+                    for (size_t i = start; i < start + count; i++) {
+                        vm_page_t* page = arena->get_page(i);
+                        DEBUG_ASSERT(page->state == VM_PAGE_STATE_ALLOC);
+                        list_delete(&page->free.node);
+                        list_add_tail(list, &page->free.node);
+                    }
+                }
+                if (pa)
+                    *pa = run_pa;
+                stat_inc(&compaction.successes);
+                return count;
+            }
+        }
+
+        /* something in the run couldn't be moved, give it back and look further on */
+        LTRACEF("abandoning run at %#" PRIxPTR ", %zu of %zu pages cleared\n", run_pa,
+                list_length(&reserved), count);
+        stat_inc(&compaction.runs_abandoned);
+        pmm_free(&reserved);
+        start++;
+    }
+
+    return 0;
+}
+
 size_t pmm_alloc_contiguous(size_t count, uint alloc_flags, uint8_t alignment_log2, paddr_t* pa,
                             struct list_node* list) {
     LTRACEF("count %zu, align %u\n", count, alignment_log2);
@@ -217,20 +855,35 @@ size_t pmm_alloc_contiguous(size_t count, uint alloc_flags, uint8_t alignment_lo
         return 1;
     }
 
-    AutoLock al(&arena_lock);
+    /* if no run is free, try again with the pages the caches hold back in the arenas */
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (attempt > 0) {
+            if (pmm_count_cached_pages() == 0)
+                break;
+            pmm_drain_caches();
+        }
 
-    for (auto& a : arena_list) {
-        /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
-        if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
-            if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
-                continue;
+        ArenaAutoLock al;
+
+        for (auto& a : arena_list) {
+            /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
+            if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
+                if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
+                    continue;
+            }
+
+            size_t allocated = a.AllocContiguous(count, alignment_log2, pa, list);
+            if (allocated > 0) {
+                DEBUG_ASSERT(allocated == count);
+                return allocated;
+            }
         }
+    }
 
-        size_t allocated = a.AllocContiguous(count, alignment_log2, pa, list);
-        if (allocated > 0) {
-            DEBUG_ASSERT(allocated == count);
+    if (alloc_flags & PMM_ALLOC_FLAG_COMPACT) {
+        size_t allocated = pmm_compact_contiguous(count, alloc_flags, alignment_log2, pa, list);
+        if (allocated > 0)
             return allocated;
-        }
     }
 
     LTRACEF("couldn't find run\n");
@@ -311,8 +964,39 @@ size_t pmm_free(struct list_node* list) {
 
     DEBUG_ASSERT(list);
 
-    AutoLock al(&arena_lock);
+    /* small frees go to the local cache, large ones straight back to the arenas */
+    size_t count = list_length(list);
+    if (kPcpuCacheEnabled && count <= kPcpuCacheBatch) {
+        /* pages of other nodes skip the cache so that it only hands out local ones */
+        list_node remote = LIST_INITIAL_VALUE(remote);
+        const uint local = pmm_cpu_node(arch_curr_cpu_num());
+
+        vm_page_t* page;
+        vm_page_t* temp;
+        list_for_every_entry_safe (list, page, temp, vm_page_t, free.node) {
+            DEBUG_ASSERT_MSG(!page_is_free(page), "page %p state %u\n", page, page->state);
+            DEBUG_ASSERT(page->state != VM_PAGE_STATE_OBJECT || page->object.pin_count == 0);
+            page->state = VM_PAGE_STATE_ALLOC;
+            page->flags = 0;
+            if (node_count > 1 && pmm_page_node(page) != local) {
+                list_delete(&page->free.node);
+                list_add_tail(&remote, &page->free.node);
+            }
+        }
+        pcpu_cache_put(list);
 
+        if (!list_is_empty(&remote)) {
+            ArenaAutoLock al;
+            pmm_free_locked(&remote);
+        }
+        return count;
+    }
+
+    ArenaAutoLock al;
+    return pmm_free_locked(list);
+}
+
+static size_t pmm_free_locked(struct list_node* list) {
     uint count = 0;
     while (!list_is_empty(list)) {
         vm_page_t* page = list_remove_head_type(list, vm_page_t, free.node);
@@ -351,12 +1035,13 @@ static size_t pmm_count_free_pages_locked() TA_REQ(arena_lock) {
 }
 
 size_t pmm_count_free_pages() {
+    size_t cached = pmm_count_cached_pages();
     AutoLock al(&arena_lock);
-    return pmm_count_free_pages_locked();
+    return pmm_count_free_pages_locked() + cached;
 }
 
 static void pmm_dump_free() TA_REQ(arena_lock) {
-    auto megabytes_free = pmm_count_free_pages_locked() / 256u;
+    auto megabytes_free = (pmm_count_free_pages_locked() + pmm_count_cached_pages()) / 256u;
     printf(" %zu free MBs\n", megabytes_free);
 }
 
@@ -397,6 +1082,53 @@ static void arena_dump(bool is_panic) TA_NO_THREAD_SAFETY_ANALYSIS {
     }
 }
 
+// No locking, the numbers are only a snapshot and this also runs from the panic shell.
+static void cache_dump() TA_NO_THREAD_SAFETY_ANALYSIS {
+    printf("per cpu page caches, batch %zu, max %zu:\n", kPcpuCacheBatch, kPcpuCacheMax);
+    for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+        const auto& c = pcpu_caches[i];
+        if (c.hits + c.misses + c.lock_acquires == 0)
+            continue;
+        uint64_t lookups = c.hits + c.misses;
+        printf("\tcpu %2u: %4zu pages, %" PRIu64 " hits %" PRIu64 " misses (%" PRIu64
+               "%% hit), %" PRIu64 " drains, arena lock %" PRIu64 " taken %" PRIu64 " contended\n",
+               i, c.count, c.hits, c.misses, lookups ? c.hits * 100 / lookups : 0, c.drains,
+               c.lock_acquires, c.lock_contended);
+    }
+    for (uint node = 0; node < node_count; node++) {
+        const auto& pool = zero_pools[node];
+        uint64_t lookups = pool.hits + pool.misses;
+        printf("zero pool of node %u: %zu pages, max %zu, %" PRIu64 " hits %" PRIu64
+               " misses (%" PRIu64 "%% hit), %" PRIu64 " pages zeroed\n",
+               node, pool.count, kZeroPoolMax, pool.hits, pool.misses,
+               lookups ? pool.hits * 100 / lookups : 0, pool.zeroed);
+    }
+}
+
+// No locking, for the same reasons as cache_dump().
+static void frag_dump() TA_NO_THREAD_SAFETY_ANALYSIS {
+    for (const auto& a : arena_list) {
+        size_t runs[PmmArena::kFreeRunOrders] = {};
+        size_t largest = 0;
+        size_t movable = 0;
+        a.CountFreeRuns(runs, &largest, &movable);
+
+        printf("arena '%s': %zu free pages, longest free run %zu pages, %zu movable pages\n",
+               a.name(), a.free_count(), largest, movable);
+        printf("\tfree runs by length:");
+        for (size_t order = 0; order < PmmArena::kFreeRunOrders; order++) {
+            if (runs[order] > 0)
+                printf(" %zu%s:%zu", size_t(1) << order,
+                       order == PmmArena::kFreeRunOrders - 1 ? "+" : "", runs[order]);
+        }
+        printf("\n");
+    }
+    printf("compaction: %" PRIu64 " requests, %" PRIu64 " runs made, %" PRIu64
+           " runs abandoned, %" PRIu64 " pages moved\n",
+           compaction.requests, compaction.successes, compaction.runs_abandoned,
+           compaction.pages_moved);
+}
+
 static int cmd_pmm(int argc, const cmd_args* argv, uint32_t flags) {
     bool is_panic = flags & CMD_FLAG_PANIC;
 
@@ -406,6 +1138,8 @@ static int cmd_pmm(int argc, const cmd_args* argv, uint32_t flags) {
     usage:
         printf("usage:\n");
         printf("%s arenas\n", argv[0].str);
+        printf("%s cache\n", argv[0].str);
+        printf("%s frag\n", argv[0].str);
         if (!is_panic) {
             printf("%s alloc <count>\n", argv[0].str);
             printf("%s alloc_range <address> <count>\n", argv[0].str);
@@ -422,6 +1156,10 @@ static int cmd_pmm(int argc, const cmd_args* argv, uint32_t flags) {
 
     if (!strcmp(argv[1].str, "arenas")) {
         arena_dump(is_panic);
+    } else if (!strcmp(argv[1].str, "cache")) {
+        cache_dump();
+    } else if (!strcmp(argv[1].str, "frag")) {
+        frag_dump();
     } else if (is_panic) {
         // No other operations will work during a panic.
         printf("Only the \"arenas\" command is available during a panic.\n");
@@ -9,6 +9,7 @@
 
 #include <err.h>
 #include <inttypes.h>
+#include <pow2.h>
 #include <pretty/sizes.h>
 #include <string.h>
 #include <trace.h>
@@ -72,6 +73,32 @@ void PmmArena::BootAllocArray() {
     free_count_ += page_count;
 }
 
+void PmmArena::SplitInto(PmmArena* tail) {
+    DEBUG_ASSERT(page_array_ && !tail->page_array_);
+    DEBUG_ASSERT(tail->base() > base() && tail->base() < base() + size());
+    DEBUG_ASSERT(tail->base() + tail->size() == base() + size());
+
+    const size_t index = (tail->base() - base()) / PAGE_SIZE;
+    tail->page_array_ = page_array_ + index;
+    info_.size = index * PAGE_SIZE;
+
+    /* move the free pages over, keeping their order */
+    vm_page_t* page;
+    vm_page_t* temp;
+    list_for_every_entry_safe (&free_list_, page, temp, vm_page_t, free.node) {
+        if (tail->page_belongs_to_arena(page)) {
+            list_delete(&page->free.node);
+            list_add_tail(&tail->free_list_, &page->free.node);
+            free_count_--;
+            tail->free_count_++;
+        }
+    }
+
+#if PMM_ENABLE_FREE_FILL
+    tail->enforce_fill_ = enforce_fill_;
+#endif
+}
+
 vm_page_t* PmmArena::AllocPage(paddr_t* pa) {
     vm_page_t* page = list_remove_head_type(&free_list_, vm_page_t, free.node);
     if (!page)
@@ -217,6 +244,87 @@ retry:
     return 0;
 }
 
+bool PmmArena::FindCompactableRun(size_t count, uint8_t alignment_log2, size_t* start,
+                                  size_t* movable) const {
+    DEBUG_ASSERT(alignment_log2 >= PAGE_SIZE_SHIFT);
+
+    paddr_t rounded_base = ROUNDUP(base(), 1UL << alignment_log2);
+    if (rounded_base < base() || rounded_base > base() + size() - 1)
+        return false;
+
+    const size_t page_count = size() / PAGE_SIZE;
+    const size_t step = 1UL << (alignment_log2 - PAGE_SIZE_SHIFT);
+    const size_t aligned_offset = (rounded_base - base()) / PAGE_SIZE;
+
+    size_t first = aligned_offset;
+    if (*start > aligned_offset)
+        first += ROUNDUP(*start - aligned_offset, step);
+
+    /* slide a window over the candidate runs, keeping counts of the pages in
+     * [lo, hi) so that overlapping runs only look at each page once */
+    bool found = false;
+    size_t best_movable = 0;
+    size_t lo = first;
+    size_t hi = first;
+    size_t pinned = 0;
+    size_t moves = 0;
+    for (size_t run = first; run + count <= page_count; run += step) {
+        if (hi <= run) {
+            lo = hi = run;
+            pinned = moves = 0;
+        }
+        for (; lo < run; lo++) {
+            const vm_page_t* p = &page_array_[lo];
+            if (page_is_movable(p)) {
+                moves--;
+            } else if (!page_is_free(p)) {
+                pinned--;
+            }
+        }
+        for (; hi < run + count; hi++) {
+            const vm_page_t* p = &page_array_[hi];
+            if (page_is_movable(p)) {
+                moves++;
+            } else if (!page_is_free(p)) {
+                pinned++;
+            }
+        }
+
+        if (pinned == 0 && (!found || moves < best_movable)) {
+            found = true;
+            best_movable = moves;
+            *start = run;
+            if (moves == 0)
+                break;
+        }
+    }
+
+    if (found) {
+        LTRACEF("run at pn %zu needs %zu pages moved\n", *start, best_movable);
+        *movable = best_movable;
+    }
+    return found;
+}
+
+void PmmArena::CountFreeRuns(size_t runs[kFreeRunOrders], size_t* largest,
+                             size_t* movable) const {
+    size_t run = 0;
+    for (size_t i = 0; i <= size() / PAGE_SIZE; i++) {
+        const vm_page_t* p = i < size() / PAGE_SIZE ? &page_array_[i] : nullptr;
+        if (p && page_is_free(p)) {
+            run++;
+            continue;
+        }
+        if (p && page_is_movable(p))
+            (*movable)++;
+        if (run > 0) {
+            runs[MIN(log2_ulong_floor(run), kFreeRunOrders - 1)]++;
+            *largest = MAX(*largest, run);
+            run = 0;
+        }
+    }
+}
+
 zx_status_t PmmArena::FreePage(vm_page_t* page) {
     LTRACEF("page %p\n", page);
     if (!page_belongs_to_arena(page))
@@ -229,6 +337,7 @@ zx_status_t PmmArena::FreePage(vm_page_t* page) {
 #endif
 
     page->state = VM_PAGE_STATE_FREE;
+    page->flags = 0;
 
     list_add_head(&free_list_, &page->free.node);
     free_count_++;
@@ -243,8 +352,8 @@ void PmmArena::CountStates(size_t state_count[_VM_PAGE_STATE_COUNT]) const {
 
 void PmmArena::Dump(bool dump_pages, bool dump_free_ranges) {
     char pbuf[16];
-    printf("arena %p: name '%s' base %#" PRIxPTR " size %s (0x%zx) priority %u flags 0x%x\n", this, name(), base(),
-           format_size(pbuf, sizeof(pbuf), size()), size(), priority(), flags());
+    printf("arena %p: name '%s' base %#" PRIxPTR " size %s (0x%zx) priority %u flags 0x%x node %u\n", this,
+           name(), base(), format_size(pbuf, sizeof(pbuf), size()), size(), priority(), flags(), node());
     printf("\tpage_array %p, free_count %zu\n", page_array_, free_count_);
 
     /* dump all of the pages */
@@ -38,6 +38,8 @@ public:
     size_t size() const { return info_.size; }
     unsigned int flags() const { return info_.flags; }
     unsigned int priority() const { return info_.priority; }
+    unsigned int node() const { return info_.node; }
+    void set_node(unsigned int node) { info_.node = node; }
     size_t free_count() const { return free_count_; };
 
     // Counts the number of pages in every state. For each page in the arena,
@@ -47,6 +49,25 @@ public:
 
     vm_page_t* get_page(size_t index) { return &page_array_[index]; }
 
+    // Looks for the aligned run of |count| pages starting at or after page
+    // index |*start| in which every page is either free or movable, and picks
+    // the one with the fewest pages to move. Returns false if there is none.
+    bool FindCompactableRun(size_t count, uint8_t alignment_log2, size_t* start,
+                            size_t* movable) const;
+
+    // Describes how fragmented the free pages are. Counts the maximal runs of
+    // free pages whose length, in pages, has each power of two as its floor
+    // into |runs|, with every run of 2^(kFreeRunOrders - 1) pages or more in
+    // the last entry, and returns the longest run in |largest|. Also counts
+    // the movable pages into |movable|. Does not zero out the values first.
+    static constexpr size_t kFreeRunOrders = 16;
+    void CountFreeRuns(size_t runs[kFreeRunOrders], size_t* largest, size_t* movable) const;
+
+    // Hands the pages from |tail|'s base on over to |tail|, a new arena for
+    // the rest of this one that has no page array yet, and shrinks this one
+    // to end there.
+    void SplitInto(PmmArena* tail);
+
     // main allocation routines
     vm_page_t* AllocPage(paddr_t* pa);
     vm_page_t* AllocSpecific(paddr_t pa);
@@ -80,7 +101,7 @@ private:
     void CheckFreeFill(vm_page_t* page);
 #endif
 
-    const pmm_arena_info_t info_;
+    pmm_arena_info_t info_;
     vm_page_t* page_array_ = nullptr;
 
     size_t free_count_ = 0;
@@ -100,6 +100,14 @@ zx_status_t VmAddressRegion::CreateSubVmarInternal(size_t offset, size_t size, u
         return ZX_ERR_ACCESS_DENIED;
     }
 
+    // The access hints are exclusive, and without one the child takes its parent's.
+    if ((vmar_flags & VMAR_ACCESS_HINT_FLAGS) == VMAR_ACCESS_HINT_FLAGS) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    if (!(vmar_flags & VMAR_ACCESS_HINT_FLAGS)) {
+        vmar_flags |= flags_ & VMAR_ACCESS_HINT_FLAGS;
+    }
+
     bool is_specific_overwrite = static_cast<bool>(vmar_flags & VMAR_FLAG_SPECIFIC_OVERWRITE);
     bool is_specific = static_cast<bool>(vmar_flags & VMAR_FLAG_SPECIFIC) || is_specific_overwrite;
     if (!is_specific && offset != 0) {
@@ -213,7 +221,8 @@ zx_status_t VmAddressRegion::CreateSubVmar(size_t offset, size_t size, uint8_t a
     }
 
     // Check that only allowed flags have been set
-    if (vmar_flags & ~(VMAR_FLAG_SPECIFIC | VMAR_FLAG_CAN_MAP_SPECIFIC | VMAR_FLAG_COMPACT | VMAR_CAN_RWX_FLAGS)) {
+    if (vmar_flags & ~(VMAR_FLAG_SPECIFIC | VMAR_FLAG_CAN_MAP_SPECIFIC | VMAR_FLAG_COMPACT |
+                       VMAR_CAN_RWX_FLAGS | VMAR_ACCESS_HINT_FLAGS)) {
         return ZX_ERR_INVALID_ARGS;
     }
 
@@ -236,7 +245,8 @@ zx_status_t VmAddressRegion::CreateVmMapping(size_t mapping_offset, size_t size,
     LTRACEF("%p %#zx %#zx %x\n", this, mapping_offset, size, vmar_flags);
 
     // Check that only allowed flags have been set
-    if (vmar_flags & ~(VMAR_FLAG_SPECIFIC | VMAR_FLAG_SPECIFIC_OVERWRITE | VMAR_CAN_RWX_FLAGS)) {
+    if (vmar_flags & ~(VMAR_FLAG_SPECIFIC | VMAR_FLAG_SPECIFIC_OVERWRITE | VMAR_CAN_RWX_FLAGS |
+                       VMAR_ACCESS_HINT_FLAGS)) {
         return ZX_ERR_INVALID_ARGS;
     }
 
@@ -344,6 +354,10 @@ void VmAddressRegion::RemoveSubregion(VmAddressRegionOrMapping* region) {
     subregions_.erase(*region);
 }
 
+void VmAddressRegion::SubregionResized(VmAddressRegionOrMapping* region) {
+    WAVLTreeObserver::RecordSubtreeChange(subregions_.make_iterator(*region));
+}
+
 fbl::RefPtr<VmAddressRegionOrMapping> VmAddressRegion::FindRegion(vaddr_t addr) {
     AutoLock guard(aspace_->lock());
     if (state_ != LifeCycleState::ALIVE) {
@@ -380,7 +394,7 @@ size_t VmAddressRegion::AllocatedPagesLocked() const {
     return sum;
 }
 
-zx_status_t VmAddressRegion::PageFault(vaddr_t va, uint pf_flags) {
+zx_status_t VmAddressRegion::PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) {
     canary_.Assert();
     DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
 
@@ -388,7 +402,7 @@ zx_status_t VmAddressRegion::PageFault(vaddr_t va, uint pf_flags) {
          auto next = vmar->FindRegionLocked(va);
          vmar = next->as_vm_address_region()) {
         if (next->is_mapping())
-            return next->PageFault(va, pf_flags);
+            return next->PageFault(va, pf_flags, page_request);
     }
 
     return ZX_ERR_NOT_FOUND;
@@ -759,49 +773,81 @@ zx_status_t VmAddressRegion::LinearRegionAllocatorLocked(size_t size, uint8_t al
                                                          uint arch_mmu_flags, vaddr_t* spot) {
     DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
 
-    const vaddr_t base = 0;
-
     if (align_pow2 < PAGE_SIZE_SHIFT)
         align_pow2 = PAGE_SIZE_SHIFT;
     const vaddr_t align = 1UL << align_pow2;
 
     // Find the first gap in the address space which can contain a region of the
     // requested size.
-    auto before_iter = subregions_.end();
-    auto after_iter = subregions_.begin();
+    zx_status_t status = ZX_ERR_NO_MEMORY;
+    ForEachGap([this, align, size, arch_mmu_flags, spot, &status](vaddr_t gap_base,
+                                                                  size_t gap_len) -> bool {
+        if (gap_len < size) {
+            return true;
+        }
+
+        auto after_iter = subregions_.upper_bound(gap_base);
+        auto before_iter = after_iter;
+        if (after_iter == subregions_.begin() || subregions_.size() == 0) {
+            before_iter = subregions_.end();
+        } else {
+            --before_iter;
+        }
 
-    do {
-        if (CheckGapLocked(before_iter, after_iter, spot, base, align, size, 0, arch_mmu_flags)) {
+        if (CheckGapLocked(before_iter, after_iter, spot, gap_base, align, size, 0,
+                           arch_mmu_flags)) {
             if (*spot != static_cast<vaddr_t>(-1)) {
-                return ZX_OK;
-            } else {
-                return ZX_ERR_NO_MEMORY;
+                status = ZX_OK;
             }
+            return false;
         }
+        return true;
+    },
+               align_pow2, size);
 
-        before_iter = after_iter++;
-    } while (before_iter.IsValid());
+    return status;
+}
 
-    // couldn't find anything
-    return ZX_ERR_NO_MEMORY;
+template <typename F>
+bool VmAddressRegion::ForEachGapInSubtree(const ChildList::iterator& node, F& func, vaddr_t align,
+                                          size_t min_gap, vaddr_t* prev_end) {
+    if (!node.IsValid()) {
+        return true;
+    }
+
+    // If neither the gap leading up to this subtree nor any gap inside it is
+    // big enough, step over the whole subtree.
+    const SubtreeState& state = node->subtree_state_;
+    const size_t lead_gap = state.first_base > *prev_end ? state.first_base - *prev_end : 0;
+    if (lead_gap < min_gap && state.max_gap < min_gap) {
+        *prev_end = ROUNDUP(state.last_byte + 1, align);
+        return true;
+    }
+
+    if (!ForEachGapInSubtree(node.left(), func, align, min_gap, prev_end)) {
+        return false;
+    }
+    if (node->base() > *prev_end) {
+        const size_t gap = node->base() - *prev_end;
+        if (!func(*prev_end, gap)) {
+            return false;
+        }
+    }
+    *prev_end = ROUNDUP(node->base() + node->size(), align);
+    return ForEachGapInSubtree(node.right(), func, align, min_gap, prev_end);
 }
 
 template <typename F>
-void VmAddressRegion::ForEachGap(F func, uint8_t align_pow2) {
+void VmAddressRegion::ForEachGap(F func, uint8_t align_pow2, size_t min_gap) {
     const vaddr_t align = 1UL << align_pow2;
 
-    // Scan the regions list to find the gap to the left of each region.  We
-    // round up the end of the previous region to the requested alignment, so
-    // all gaps reported will be for aligned ranges.
+    // Walk the regions tree in order to find the gap to the left of each
+    // region, skipping subtrees that can't hold a gap of min_gap.  We round up
+    // the end of the previous region to the requested alignment, so all gaps
+    // reported will be for aligned ranges.
     vaddr_t prev_region_end = ROUNDUP(base_, align);
-    for (const auto& region : subregions_) {
-        if (region.base() > prev_region_end) {
-            const size_t gap = region.base() - prev_region_end;
-            if (!func(prev_region_end, gap)) {
-                return;
-            }
-        }
-        prev_region_end = ROUNDUP(region.base() + region.size(), align);
+    if (!ForEachGapInSubtree(subregions_.root(), func, align, min_gap, &prev_region_end)) {
+        return;
     }
 
     // Grab the gap to the right of the last region (note that if there are no
@@ -844,7 +890,7 @@ zx_status_t VmAddressRegion::NonCompactRandomizedRegionAllocatorLocked(size_t si
         }
         return true;
     },
-               align_pow2);
+               align_pow2, size);
 
     if (candidate_spaces == 0) {
         return ZX_ERR_NO_MEMORY;
@@ -870,7 +916,7 @@ zx_status_t VmAddressRegion::NonCompactRandomizedRegionAllocatorLocked(size_t si
         selected_index -= spots;
         return true;
     },
-               align_pow2);
+               align_pow2, size);
     ASSERT(alloc_spot != static_cast<vaddr_t>(-1));
     ASSERT(IS_ALIGNED(alloc_spot, align));
 
@@ -544,12 +544,27 @@ zx_status_t VmAspace::PageFault(vaddr_t va, uint flags) {
         flags |= VMM_PF_FLAG_GUEST;
     }
 
-    // for now, hold the aspace lock across the page fault operation,
-    // which stops any other operations on the address space from moving
-    // the region out from underneath it
-    AutoLock a(&lock_);
+    for (;;) {
+        PageRequest page_request;
+        zx_status_t status;
+        {
+            // for now, hold the aspace lock across the page fault operation,
+            // which stops any other operations on the address space from moving
+            // the region out from underneath it
+            AutoLock a(&lock_);
+
+            status = root_vmar_->PageFault(va, flags, &page_request);
+        }
+        if (status != ZX_ERR_SHOULD_WAIT)
+            return status;
 
-    return root_vmar_->PageFault(va, flags);
+        // the page is coming from a page source, wait for it without holding
+        // the lock and then look the address up again, as the mapping may
+        // have changed in the meantime
+        status = page_request.Wait();
+        if (status != ZX_OK)
+            return status;
+    }
 }
 
 void VmAspace::Dump(bool verbose) const {
@@ -606,7 +621,7 @@ size_t VmAspace::AllocatedPages() const {
 void VmAspace::InitializeAslr() {
     aslr_enabled_ = is_user() && !cmdline_get_bool("aslr.disable", false);
 
-    crypto::GlobalPRNG::GetInstance()->Draw(aslr_seed_, sizeof(aslr_seed_));
+    crypto::GlobalPRNG::Draw(aslr_seed_, sizeof(aslr_seed_));
     aslr_prng_.AddEntropy(aslr_seed_, sizeof(aslr_seed_));
 }
 
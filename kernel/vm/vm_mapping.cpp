@@ -13,6 +13,8 @@
 #include <fbl/auto_call.h>
 #include <fbl/auto_lock.h>
 #include <inttypes.h>
+#include <kernel/cmdline.h>
+#include <lk/init.h>
 #include <safeint/safe_math.h>
 #include <trace.h>
 #include <vm/fault.h>
@@ -162,6 +164,7 @@ zx_status_t VmMapping::ProtectLocked(vaddr_t base, size_t size, uint new_arch_mm
         arch_mmu_flags_ = new_arch_mmu_flags;
 
         size_ = size;
+        parent_->SubregionResized(this);
         mapping->ActivateLocked();
         return ZX_OK;
     }
@@ -183,6 +186,7 @@ zx_status_t VmMapping::ProtectLocked(vaddr_t base, size_t size, uint new_arch_mm
         LTRACEF("arch_mmu_protect returns %d\n", status);
 
         size_ -= size;
+        parent_->SubregionResized(this);
         mapping->ActivateLocked();
         return ZX_OK;
     }
@@ -212,6 +216,7 @@ zx_status_t VmMapping::ProtectLocked(vaddr_t base, size_t size, uint new_arch_mm
 
     // Turn us into the left half
     size_ = left_size;
+    parent_->SubregionResized(this);
 
     center_mapping->ActivateLocked();
     right_mapping->ActivateLocked();
@@ -287,6 +292,7 @@ zx_status_t VmMapping::UnmapLocked(vaddr_t base, size_t size) {
             parent_->subregions_.insert(fbl::move(ref));
         }
         size_ -= size;
+        parent_->SubregionResized(this);
 
         return ZX_OK;
     }
@@ -315,6 +321,7 @@ zx_status_t VmMapping::UnmapLocked(vaddr_t base, size_t size) {
 
     // Turn us into the left half
     size_ = base - base_;
+    parent_->SubregionResized(this);
     mapping->ActivateLocked();
     return ZX_OK;
 }
@@ -391,22 +398,33 @@ namespace {
 class VmMappingCoalescer {
 public:
     VmMappingCoalescer(VmMapping* mapping, vaddr_t base);
+    VmMappingCoalescer(VmMapping* mapping, vaddr_t base, uint mmu_flags);
     ~VmMappingCoalescer();
 
     // Add a page to the mapping run.  If this fails, the VmMappingCoalescer is
     // no longer valid.
     zx_status_t Append(vaddr_t vaddr, paddr_t paddr) {
         DEBUG_ASSERT(!aborted_);
-        // If this isn't the expected vaddr, flush the run we have first.
-        if (count_ >= fbl::count_of(phys_) || vaddr != base_ + count_ * PAGE_SIZE) {
+        // Physically contiguous pages extend the current run, so that the MMU
+        // code gets to use large pages where the run allows it.
+        if (count_ > 0 && vaddr == base_ + size_ &&
+            paddr == runs_[count_ - 1].paddr + runs_[count_ - 1].size) {
+            runs_[count_ - 1].size += PAGE_SIZE;
+            size_ += PAGE_SIZE;
+            return ZX_OK;
+        }
+        // If this isn't the expected vaddr, flush the runs we have first.
+        if (count_ >= fbl::count_of(runs_) || vaddr != base_ + size_) {
             zx_status_t status = Flush();
             if (status != ZX_OK) {
                 return status;
             }
             base_ = vaddr;
         }
-        phys_[count_] = paddr;
+        runs_[count_].paddr = paddr;
+        runs_[count_].size = PAGE_SIZE;
         ++count_;
+        size_ += PAGE_SIZE;
         return ZX_OK;
     }
 
@@ -422,15 +440,26 @@ public:
 private:
     DISALLOW_COPY_ASSIGN_AND_MOVE(VmMappingCoalescer);
 
+    struct Run {
+        paddr_t paddr;
+        size_t size;
+    };
+
     VmMapping* mapping_;
+    uint mmu_flags_;
     vaddr_t base_;
-    paddr_t phys_[16];
+    size_t size_;
+    Run runs_[16];
     size_t count_;
     bool aborted_;
 };
 
 VmMappingCoalescer::VmMappingCoalescer(VmMapping* mapping, vaddr_t base)
-    : mapping_(mapping), base_(base), count_(0), aborted_(false) { }
+    : VmMappingCoalescer(mapping, base, mapping->arch_mmu_flags()) { }
+
+VmMappingCoalescer::VmMappingCoalescer(VmMapping* mapping, vaddr_t base, uint mmu_flags)
+    : mapping_(mapping), mmu_flags_(mmu_flags), base_(base), size_(0), count_(0),
+      aborted_(false) { }
 
 VmMappingCoalescer::~VmMappingCoalescer() {
     // Make sure we've flushed or aborted
@@ -442,10 +471,17 @@ zx_status_t VmMappingCoalescer::Flush() {
         return ZX_OK;
     }
 
-    uint flags = mapping_->arch_mmu_flags();
-    if (flags & ARCH_MMU_FLAG_PERM_RWX_MASK) {
+    uint flags = mmu_flags_;
+    if ((flags & ARCH_MMU_FLAG_PERM_RWX_MASK) && count_ > 1 && size_ == count_ * PAGE_SIZE) {
+        // Scattered single pages, as freshly allocated ones usually are, go
+        // to the MMU in one call, so the page table lock is taken and the TLB
+        // flushed once for all of them.  The MMU undoes a partial map itself.
+        paddr_t pages[fbl::count_of(runs_)];
+        for (size_t i = 0; i < count_; i++) {
+            pages[i] = runs_[i].paddr;
+        }
         size_t mapped;
-        zx_status_t ret = mapping_->aspace()->arch_aspace().Map(base_, phys_, count_, flags,
+        zx_status_t ret = mapping_->aspace()->arch_aspace().Map(base_, pages, count_, flags,
                                                                 &mapped);
         if (ret != ZX_OK) {
             TRACEF("error %d mapping %zu pages starting at va %#" PRIxPTR "\n", ret, count_, base_);
@@ -453,8 +489,26 @@ zx_status_t VmMappingCoalescer::Flush() {
             return ret;
         }
         DEBUG_ASSERT(mapped == count_);
+    } else if (flags & ARCH_MMU_FLAG_PERM_RWX_MASK) {
+        vaddr_t va = base_;
+        for (size_t i = 0; i < count_; i++) {
+            size_t pages = runs_[i].size / PAGE_SIZE;
+            size_t mapped;
+            zx_status_t ret = mapping_->aspace()->arch_aspace().MapContiguous(
+                va, runs_[i].paddr, pages, flags, &mapped);
+            if (ret != ZX_OK) {
+                TRACEF("error %d mapping %zu pages starting at va %#" PRIxPTR "\n", ret, pages, va);
+                if (va != base_)
+                    mapping_->aspace()->arch_aspace().Unmap(base_, (va - base_) / PAGE_SIZE, nullptr);
+                aborted_ = true;
+                return ret;
+            }
+            DEBUG_ASSERT(mapped == pages);
+            va += runs_[i].size;
+        }
     }
-    base_ += count_ * PAGE_SIZE;
+    base_ += size_;
+    size_ = 0;
     count_ = 0;
     return ZX_OK;
 }
@@ -504,7 +558,10 @@ zx_status_t VmMapping::MapRange(size_t offset, size_t len, bool commit) {
 
         zx_status_t status;
         paddr_t pa;
-        status = object_->GetPageLocked(vmo_offset, pf_flags, nullptr, nullptr, &pa);
+        status = object_->GetPageLocked(vmo_offset, pf_flags, nullptr, nullptr, nullptr, &pa);
+        // pages still coming in from a page source get mapped when first touched
+        if (status == ZX_ERR_SHOULD_WAIT)
+            continue;
         if (status < 0) {
             // no page to map
             if (commit) {
@@ -545,6 +602,33 @@ zx_status_t VmMapping::DecommitRange(size_t offset, size_t len,
     return object_->DecommitRange(object_offset_ + offset, len, decommitted);
 }
 
+zx_status_t VmMapping::ReplacePages(vaddr_t va, list_node* pages, size_t count) {
+    canary_.Assert();
+    LTRACEF("%p [%#zx+%#zx], va %#" PRIxPTR ", count %zu\n",
+            this, base_, size_, va, count);
+
+    AutoLock guard(aspace_->lock());
+    if (state_ != LifeCycleState::ALIVE) {
+        return ZX_ERR_BAD_STATE;
+    }
+    if (!is_in_range(va, count * PAGE_SIZE)) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    // the pages were filled in through the physmap, so only a cached mapping
+    // sees their contents as written
+    const uint required = ARCH_MMU_FLAG_PERM_USER | ARCH_MMU_FLAG_PERM_WRITE;
+    if ((arch_mmu_flags_ & required) != required ||
+        (arch_mmu_flags_ & ARCH_MMU_FLAG_CACHE_MASK) != ARCH_MMU_FLAG_CACHED) {
+        return ZX_ERR_ACCESS_DENIED;
+    }
+
+    // VmObject::ReplacePages will call back into our instance's
+    // VmMapping::UnmapVmoRangeLocked, keep the object alive until it's done.
+    fbl::RefPtr<VmObject> vmo = object_;
+    return vmo->ReplacePages(object_offset_ + (va - base_), pages, count);
+}
+
 zx_status_t VmMapping::DestroyLocked() {
     canary_.Assert();
     DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
@@ -595,7 +679,129 @@ zx_status_t VmMapping::DestroyLocked() {
     return ZX_OK;
 }
 
-zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
+// Number of pages, including the faulting one, that a fault maps when they are
+// already resident. Mappings hinted as sequential map kFaultAroundSequentialScale
+// times as many pages ahead of the fault, ones hinted as random only the
+// faulting page.
+static uint32_t fault_around_pages = 16;
+static constexpr uint32_t kFaultAroundSequentialScale = 4;
+static constexpr uint32_t kFaultAroundMaxPages = 256;
+
+static void fault_around_init(uint level) {
+    fault_around_pages = MIN(cmdline_get_uint32("kernel.vm.fault-around", fault_around_pages),
+                             kFaultAroundMaxPages);
+}
+
+LK_INIT_HOOK(vm_fault_around, &fault_around_init, LK_INIT_LEVEL_VM);
+
+void VmMapping::FaultAroundLocked(vaddr_t va, uint pf_flags) {
+    DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
+    DEBUG_ASSERT(object_->lock()->IsHeld());
+
+    if (fault_around_pages <= 1 || (flags_ & VMAR_FLAG_ACCESS_RANDOM) ||
+        (pf_flags & VMM_PF_FLAG_GUEST)) {
+        return;
+    }
+
+    // a window aligned around the fault, or one running ahead of it for sequential access
+    vaddr_t start, end;
+    if (flags_ & VMAR_FLAG_ACCESS_SEQUENTIAL) {
+        start = va;
+        end = va + fault_around_pages * kFaultAroundSequentialScale * PAGE_SIZE;
+    } else {
+        const size_t window = fault_around_pages * PAGE_SIZE;
+        start = base_ + ROUNDDOWN(va - base_, window);
+        end = start + window;
+    }
+    if (end < start || end > base_ + size_)
+        end = base_ + size_;
+
+    // Pages of a clone may belong to one of its ancestors, and have to copy
+    // on write, so only ever map those read only.
+    uint mmu_flags = arch_mmu_flags_;
+    if (object_->is_cow_clone_locked())
+        mmu_flags &= ~ARCH_MMU_FLAG_PERM_WRITE;
+
+    VmMappingCoalescer coalescer(this, start, mmu_flags);
+    for (vaddr_t cur = start; cur < end; cur += PAGE_SIZE) {
+        if (cur == va)
+            continue;
+
+        // leave whatever is already mapped alone
+        paddr_t pa;
+        if (aspace_->arch_aspace().Query(cur, &pa, nullptr) == ZX_OK)
+            continue;
+
+        // only take resident pages, without fault flags nothing gets committed
+        if (object_->GetPageLocked(cur - base_ + object_offset_, 0, nullptr, nullptr, nullptr, &pa) != ZX_OK)
+            continue;
+
+        if (coalescer.Append(cur, pa) != ZX_OK)
+            return;
+
+#if ARCH_ARM64
+        if (mmu_flags & ARCH_MMU_FLAG_PERM_EXECUTE) {
+            if (coalescer.Flush() != ZX_OK)
+                return;
+            arch_sync_cache_range(cur, PAGE_SIZE);
+        }
+#endif
+    }
+    coalescer.Flush();
+}
+
+zx_status_t VmMapping::PageFaultLargeLocked(vaddr_t va, uint pf_flags) {
+    DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
+    DEBUG_ASSERT(object_->lock()->IsHeld());
+
+    // the large page has to fit in the mapping, with the object offset equally aligned
+    vaddr_t large_va = ROUNDDOWN(va, LARGE_PAGE_SIZE);
+    if (large_va < base_ || large_va - base_ > size_ - LARGE_PAGE_SIZE || size_ < LARGE_PAGE_SIZE)
+        return ZX_ERR_NOT_SUPPORTED;
+    uint64_t vmo_offset = large_va - base_ + object_offset_;
+    if (!IS_ALIGNED(vmo_offset, LARGE_PAGE_SIZE))
+        return ZX_ERR_NOT_SUPPORTED;
+
+    paddr_t large_pa;
+    zx_status_t status = object_->GetLargePageLocked(vmo_offset, LARGE_PAGE_SIZE_SHIFT, pf_flags,
+                                                     &large_pa);
+    if (status != ZX_OK)
+        return status;
+
+    // another thread may have beaten us to it
+    paddr_t pa;
+    uint page_flags;
+    if (aspace_->arch_aspace().Query(va, &pa, &page_flags) == ZX_OK &&
+        pa == large_pa + (va - large_va) && page_flags == arch_mmu_flags_) {
+        return ZX_OK;
+    }
+
+    // The run backs the whole range with real pages, so it gets the full
+    // permissions of the mapping. Whatever small pages were mapped here before
+    // are replaced, they were either the same pages or the zero page.
+    status = aspace_->arch_aspace().Unmap(large_va, LARGE_PAGE_SIZE / PAGE_SIZE, nullptr);
+    if (status != ZX_OK)
+        return status;
+
+    size_t mapped;
+    status = aspace_->arch_aspace().MapContiguous(large_va, large_pa, LARGE_PAGE_SIZE / PAGE_SIZE,
+                                                  arch_mmu_flags_, &mapped);
+    if (status != ZX_OK) {
+        TRACEF("failed to map large page at va %#" PRIxPTR "\n", large_va);
+        return status;
+    }
+    DEBUG_ASSERT(mapped == LARGE_PAGE_SIZE / PAGE_SIZE);
+
+    LTRACEF("mapped large page pa %#" PRIxPTR " at va %#" PRIxPTR "\n", large_pa, large_va);
+
+#if ARCH_ARM64
+    if (!(pf_flags & VMM_PF_FLAG_GUEST) && (arch_mmu_flags_ & ARCH_MMU_FLAG_PERM_EXECUTE))
+        arch_sync_cache_range(large_va, LARGE_PAGE_SIZE);
+#endif
+    return ZX_OK;
+}
+
+zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags, PageRequest* page_request) {
     canary_.Assert();
     DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
 
@@ -642,10 +848,17 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
     currently_faulting_ = true;
     auto ac = fbl::MakeAutoCall([&]() { currently_faulting_ = false; });
 
+    // objects that can back the surrounding large page with one run get it mapped in one go
+    if (object_->prefers_large_pages() && PageFaultLargeLocked(va, pf_flags) == ZX_OK)
+        return ZX_OK;
+
     // fault in or grab an existing page
     paddr_t new_pa;
     vm_page_t* page;
-    zx_status_t status = object_->GetPageLocked(vmo_offset, pf_flags, nullptr, &page, &new_pa);
+    zx_status_t status = object_->GetPageLocked(vmo_offset, pf_flags, nullptr, page_request,
+                                                &page, &new_pa);
+    if (status == ZX_ERR_SHOULD_WAIT)
+        return status;
     if (status < 0) {
         TRACEF("ERROR: failed to fault in or grab existing page\n");
         TRACEF("%p vmo_offset %#" PRIx64 ", pf_flags %#x\n", this, vmo_offset, pf_flags);
@@ -726,6 +939,9 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
             return ZX_ERR_NO_MEMORY;
         }
         DEBUG_ASSERT(mapped == 1);
+
+        // save the faults on the neighbouring pages that are already resident
+        FaultAroundLocked(va, pf_flags);
     }
 
 // TODO: figure out what to do with this
@@ -82,6 +82,19 @@ zx_status_t VmObject::set_name(const char* name, size_t len) {
     return name_.set(name, len);
 }
 
+fbl::RefPtr<VmObject> VmObject::NextInGlobalList(VmObject* prev) {
+    AutoLock a(&all_vmos_lock_);
+
+    // |prev| is referenced, so it can't have left the list
+    auto iter = prev ? ++all_vmos_.make_iterator(*prev) : all_vmos_.begin();
+    for (; iter != all_vmos_.end(); ++iter) {
+        auto vmo = fbl::internal::MakeRefPtrUpgradeFromRaw(&*iter, all_vmos_lock_);
+        if (vmo)
+            return vmo;
+    }
+    return nullptr;
+}
+
 void VmObject::set_user_id(uint64_t user_id) {
     canary_.Assert();
     AutoLock a(&lock_);
@@ -116,6 +129,23 @@ bool VmObject::is_cow_clone() const {
     return parent_ != nullptr;
 }
 
+uint32_t VmObject::chain_depth() const {
+    canary_.Assert();
+    AutoLock a(&lock_);
+    return chain_depth_locked();
+}
+
+// Every object in a clone tree shares the root's lock, so holding ours covers
+// the whole chain.
+uint32_t VmObject::chain_depth_locked() const TA_NO_THREAD_SAFETY_ANALYSIS {
+    DEBUG_ASSERT(lock_.IsHeld());
+    uint32_t depth = 0;
+    for (const VmObject* o = parent_.get(); o; o = o->parent_.get()) {
+        depth++;
+    }
+    return depth;
+}
+
 void VmObject::AddMappingLocked(VmMapping* r) {
     canary_.Assert();
     DEBUG_ASSERT(lock_.IsHeld());
@@ -215,6 +245,19 @@ uint32_t VmObject::num_children() const {
     return children_list_len_;
 }
 
+void VmObject::AddHolder() {
+    canary_.Assert();
+    AutoLock a(&lock_);
+    holder_count_++;
+}
+
+void VmObject::RemoveHolder() {
+    canary_.Assert();
+    AutoLock a(&lock_);
+    DEBUG_ASSERT(holder_count_ > 0);
+    holder_count_--;
+}
+
 void VmObject::RangeChangeUpdateLocked(uint64_t offset, uint64_t len) {
     canary_.Assert();
     DEBUG_ASSERT(lock_.IsHeld());
@@ -242,6 +285,7 @@ static int cmd_vm_object(int argc, const cmd_args* argv, uint32_t flags) {
         printf("usage:\n");
         printf("%s dump <address>\n", argv[0].str);
         printf("%s dump_pages <address>\n", argv[0].str);
+        printf("%s chains [min depth]\n", argv[0].str);
         return ZX_ERR_INTERNAL;
     }
 
@@ -259,6 +303,18 @@ static int cmd_vm_object(int argc, const cmd_args* argv, uint32_t flags) {
         VmObject* o = reinterpret_cast<VmObject*>(argv[2].u);
 
         o->Dump(0, true);
+    } else if (!strcmp(argv[1].str, "chains")) {
+        uint32_t min_depth = (argc > 2) ? static_cast<uint32_t>(argv[2].u) : 2;
+
+        printf("clones at least %u parents deep:\n", min_depth);
+        VmObject::ForEach([min_depth](const VmObject& vmo) {
+            uint32_t depth = vmo.chain_depth();
+            if (depth >= min_depth) {
+                printf("vmo %p/k%" PRIu64 " depth %u parent k%" PRIu64 "\n",
+                       &vmo, vmo.user_id(), depth, vmo.parent_user_id());
+            }
+            return ZX_OK;
+        });
     } else {
         printf("unknown command\n");
         goto usage;
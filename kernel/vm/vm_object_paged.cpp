@@ -11,10 +11,17 @@
 #include <arch/ops.h>
 #include <assert.h>
 #include <err.h>
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
+#include <fbl/auto_call.h>
 #include <fbl/auto_lock.h>
 #include <inttypes.h>
+#include <kernel/cmdline.h>
+#include <kernel/event.h>
+#include <kernel/thread.h>
 #include <lib/console.h>
+#include <lib/counters.h>
+#include <lk/init.h>
 #include <safeint/safe_math.h>
 #include <stdlib.h>
 #include <string.h>
@@ -29,8 +36,23 @@ using fbl::AutoLock;
 
 #define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
 
+KCOUNTER(vm_cow_parents_collapsed, "kernel.vm.cow.parents_collapsed");
+KCOUNTER(vm_cow_pages_merged, "kernel.vm.cow.pages_merged");
+KCOUNTER(vm_cow_pages_freed, "kernel.vm.cow.pages_freed");
+KCOUNTER(vm_zero_scan_passes, "kernel.vm.zero_scan.passes");
+KCOUNTER(vm_zero_scan_pages_freed, "kernel.vm.zero_scan.pages_freed");
+KCOUNTER(vm_compaction_pages_moved, "kernel.vm.compaction.pages_moved");
+KCOUNTER(vm_page_source_pages_supplied, "kernel.vm.page_source.pages_supplied");
+
+fbl::Mutex VmObjectPaged::collapse_lock_ = {};
+VmObjectPaged::CollapseList VmObjectPaged::collapse_list_ = {};
+
 namespace {
 
+// signaled when an object is put on the collapse queue
+event_t collapse_event = EVENT_INITIAL_VALUE(collapse_event, false, EVENT_FLAG_AUTOUNSIGNAL);
+bool collapse_thread_running = false;
+
 void ZeroPage(paddr_t pa) {
     void* ptr = paddr_to_physmap(pa);
     DEBUG_ASSERT(ptr);
@@ -43,9 +65,21 @@ void ZeroPage(vm_page_t* p) {
     ZeroPage(pa);
 }
 
+bool IsZeroPage(vm_page_t* p) {
+    auto words = static_cast<const uint64_t*>(paddr_to_physmap(vm_page_to_paddr(p)));
+    DEBUG_ASSERT(words);
+
+    for (size_t i = 0; i < PAGE_SIZE / sizeof(uint64_t); i++) {
+        if (words[i] != 0)
+            return false;
+    }
+    return true;
+}
+
 void InitializeVmPage(vm_page_t* p) {
     DEBUG_ASSERT(p->state == VM_PAGE_STATE_ALLOC);
     p->state = VM_PAGE_STATE_OBJECT;
+    p->flags = 0;
     p->object.pin_count = 0;
     p->object.contiguous_pin = 0;
 }
@@ -62,6 +96,10 @@ VmObjectPaged::~VmObjectPaged() {
 
     LTRACEF("%p\n", this);
 
+    // nothing is going to ask for our pages anymore
+    if (page_source_)
+        page_source_->Close();
+
     page_list_.ForEveryPage(
         [](const auto p, uint64_t off) {
             if (p->object.contiguous_pin) {
@@ -76,15 +114,22 @@ VmObjectPaged::~VmObjectPaged() {
 }
 
 zx_status_t VmObjectPaged::Create(uint32_t pmm_alloc_flags, uint64_t size, fbl::RefPtr<VmObject>* obj) {
+    return Create(pmm_alloc_flags, 0, size, obj);
+}
+
+zx_status_t VmObjectPaged::Create(uint32_t pmm_alloc_flags, uint32_t options, uint64_t size,
+                                  fbl::RefPtr<VmObject>* obj) {
     // there's a max size to keep indexes within range
     if (size > MAX_SIZE)
         return ZX_ERR_INVALID_ARGS;
 
     fbl::AllocChecker ac;
-    auto vmo = fbl::AdoptRef<VmObject>(new (&ac) VmObjectPaged(pmm_alloc_flags, nullptr));
+    auto vmo = fbl::AdoptRef<VmObjectPaged>(new (&ac) VmObjectPaged(pmm_alloc_flags, nullptr));
     if (!ac.check())
         return ZX_ERR_NO_MEMORY;
 
+    vmo->large_pages_ = (options & kLargePages) != 0;
+
     auto err = vmo->Resize(size);
     if (err != ZX_OK)
         return err;
@@ -94,16 +139,46 @@ zx_status_t VmObjectPaged::Create(uint32_t pmm_alloc_flags, uint64_t size, fbl::
     return ZX_OK;
 }
 
+zx_status_t VmObjectPaged::CreateExternal(fbl::RefPtr<PageSource> src, uint64_t size,
+                                          fbl::RefPtr<VmObject>* obj) {
+    // there's a max size to keep indexes within range
+    if (size > MAX_SIZE)
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::AllocChecker ac;
+    auto vmo = fbl::AdoptRef<VmObjectPaged>(new (&ac) VmObjectPaged(PMM_ALLOC_FLAG_ANY, nullptr));
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    auto err = vmo->Resize(size);
+    if (err != ZX_OK)
+        return err;
+
+    // set last, past this point Resize() refuses
+    vmo->page_source_ = fbl::move(src);
+    vmo->source_backed_ = true;
+
+    *obj = fbl::move(vmo);
+
+    return ZX_OK;
+}
+
 zx_status_t VmObjectPaged::CloneCOW(uint64_t offset, uint64_t size, bool copy_name, fbl::RefPtr<VmObject>* clone_vmo) {
     LTRACEF("vmo %p offset %#" PRIx64 " size %#" PRIx64 "\n", this, offset, size);
 
     canary_.Assert();
 
+    // don't stack another level on top of parents nobody else can see
+    CollapseChain();
+
     fbl::AllocChecker ac;
     auto vmo = fbl::AdoptRef<VmObjectPaged>(new (&ac) VmObjectPaged(pmm_alloc_flags_, fbl::WrapRefPtr(this)));
     if (!ac.check())
         return ZX_ERR_NO_MEMORY;
 
+    // pages we don't have may still have to come from a page source above us
+    vmo->source_backed_ = source_backed_;
+
     AutoLock a(&lock_);
 
     // add it as a child to us
@@ -122,6 +197,9 @@ zx_status_t VmObjectPaged::CloneCOW(uint64_t offset, uint64_t size, bool copy_na
     if (copy_name)
         vmo->name_ = name_;
 
+    vmo->node_policy_ = node_policy_;
+    vmo->policy_node_ = policy_node_;
+
     *clone_vmo = fbl::move(vmo);
 
     return ZX_OK;
@@ -135,18 +213,14 @@ void VmObjectPaged::Dump(uint depth, bool verbose) {
 
     AutoLock a(&lock_);
 
-    size_t count = 0;
-    page_list_.ForEveryPage([&count](const auto p, uint64_t) {
-        count++;
-        return ZX_ERR_NEXT;
-    });
+    size_t count = page_list_.count();
 
     for (uint i = 0; i < depth; ++i) {
         printf("  ");
     }
     printf("vmo %p/k%" PRIu64 " size %#" PRIx64
-           " pages %zu ref %d parent k%" PRIu64 "\n",
-           this, user_id_, size_, count, ref_count_debug(), parent_id);
+           " pages %zu ref %d parent k%" PRIu64 " depth %u\n",
+           this, user_id_, size_, count, ref_count_debug(), parent_id, chain_depth_locked());
 
     if (verbose) {
         auto f = [depth](const auto p, uint64_t offset) {
@@ -167,6 +241,10 @@ size_t VmObjectPaged::AllocatedPagesInRange(uint64_t offset, uint64_t len) const
     if (!TrimRange(offset, len, size_, &new_len)) {
         return 0;
     }
+    if (offset == 0 && new_len == size_) {
+        // The whole object; the list keeps count.
+        return page_list_.count();
+    }
     size_t count = 0;
     // TODO: Figure out what to do with our parent's pages. If we're a clone,
     // page_list_ only contains pages that we've made copies of.
@@ -180,6 +258,13 @@ size_t VmObjectPaged::AllocatedPagesInRange(uint64_t offset, uint64_t len) const
     return count;
 }
 
+void VmObjectPaged::SetAttribution(fbl::RefPtr<VmAttribution> attribution) {
+    canary_.Assert();
+    AutoLock a(&lock_);
+
+    page_list_.SetAttribution(fbl::move(attribution));
+}
+
 zx_status_t VmObjectPaged::AddPage(vm_page_t* p, uint64_t offset) {
     AutoLock a(&lock_);
 
@@ -200,6 +285,7 @@ zx_status_t VmObjectPaged::AddPageLocked(vm_page_t* p, uint64_t offset) {
     zx_status_t err = page_list_.AddPage(p, offset);
     if (err != ZX_OK)
         return err;
+    SetPageOwnerLocked(p, offset);
 
     // other mappings may have covered this offset into the vmo, so unmap those ranges
     RangeChangeUpdateLocked(offset, PAGE_SIZE);
@@ -207,6 +293,21 @@ zx_status_t VmObjectPaged::AddPageLocked(vm_page_t* p, uint64_t offset) {
     return ZX_OK;
 }
 
+void VmObjectPaged::SetPageOwnerLocked(vm_page_t* p, uint64_t offset) {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    // wired pages, such as the kernel's own in CreateFromROData, never move
+    if (p->state != VM_PAGE_STATE_OBJECT)
+        return;
+
+    p->object.obj = this;
+    p->object.offset = offset;
+    // large page runs have to stay where they are to keep being mapped whole,
+    // and so does a page whose address has been handed out
+    if (!large_pages_ && !(p->flags & VM_PAGE_FLAG_LOOKED_UP))
+        p->flags |= VM_PAGE_FLAG_MOVABLE;
+}
+
 zx_status_t VmObjectPaged::CreateFromROData(const void* data, size_t size, fbl::RefPtr<VmObject>* obj) {
     LTRACEF("data %p, size %zu\n", data, size);
 
@@ -262,8 +363,13 @@ zx_status_t VmObjectPaged::CreateFromROData(const void* data, size_t size, fbl::
 // |free_list|, if not NULL, is a list of allocated but unused vm_page_t that
 // this function may allocate from.  This function will need at most one entry,
 // and will not fail if |free_list| is a non-empty list, faulting in was requested,
-// and offset is in range.
+// offset is in range and the object isn't backed by a page source.
+//
+// Pages of a source backed object that aren't in yet are asked for from the
+// source, failing with ZX_ERR_SHOULD_WAIT and setting up |page_request|, if not
+// NULL, to wait for them.
 zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_node* free_list,
+                                         PageRequest* page_request,
                                          vm_page_t** const page_out, paddr_t* const pa_out) {
     canary_.Assert();
     DEBUG_ASSERT(lock_.IsHeld());
@@ -289,16 +395,23 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
             vmm_pf_flags_to_string(pf_flags, pf_string));
 
     // if we have a parent see if they have a page for us
-    if (parent_) {
+    if (parent_ && offset < parent_limit_) {
+        // a parent only we can reach is dead weight on every miss, have it merged into us
+        if (unlikely(!collapse_queued_) && ParentCollapsibleLocked())
+            QueueCollapseLocked();
+
         safeint::CheckedNumeric<uint64_t> parent_offset = parent_offset_;
         parent_offset += offset;
         DEBUG_ASSERT(parent_offset.IsValid());
 
-        // make sure we don't cause the parent to fault in new pages, just ask for any that already exist
-        uint parent_pf_flags = pf_flags & ~(VMM_PF_FLAG_FAULT_MASK);
+        // make sure we don't cause the parent to fault in new pages, just ask for any that already exist.
+        // the contents of a chain backed by a page source only ever come from there, so have the
+        // parent bring the page in from it, but never to write to.
+        uint parent_pf_flags = source_backed_ ? (pf_flags & ~VMM_PF_FLAG_WRITE)
+                                              : (pf_flags & ~(VMM_PF_FLAG_FAULT_MASK));
 
         zx_status_t status = parent_->GetPageLocked(parent_offset.ValueOrDie(), parent_pf_flags,
-                                                    nullptr, &p, &pa);
+                                                    nullptr, page_request, &p, &pa);
         if (status == ZX_OK) {
             // we have a page from them. if we're read-only faulting, return that page so they can map
             // or read from it directly
@@ -323,7 +436,7 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
                 }
             }
             if (!p_clone) {
-                p_clone = pmm_alloc_page(pmm_alloc_flags_, &pa_clone);
+                p_clone = AllocPageLocked(pmm_alloc_flags_, &pa_clone);
             }
             if (!p_clone) {
                 return ZX_ERR_NO_MEMORY;
@@ -353,12 +466,20 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
 
             return ZX_OK;
         }
+
+        // the page is on its way from the source, or isn't coming at all
+        if (source_backed_ && status != ZX_ERR_NOT_FOUND && status != ZX_ERR_OUT_OF_RANGE)
+            return status;
     }
 
     // if we're not being asked to sw or hw fault in the page, return not found
     if ((pf_flags & VMM_PF_FLAG_FAULT_MASK) == 0)
         return ZX_ERR_NOT_FOUND;
 
+    // our contents come from the page source, rather than being zero filled
+    if (page_source_)
+        return page_source_->GetPage(ROUNDDOWN(offset, PAGE_SIZE), size_, page_request);
+
     // if we're read faulting, we don't already have a page, and the parent doesn't have it,
     // return the single global zero page
     if ((pf_flags & VMM_PF_FLAG_WRITE) == 0) {
@@ -370,7 +491,7 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
         return ZX_OK;
     }
 
-    // allocate a page
+    // allocate a zeroed page, free_list pages are allocated zeroed by the caller
     if (free_list) {
         p = list_remove_head_type(free_list, vm_page_t, free.node);
         if (p) {
@@ -378,7 +499,7 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
         }
     }
     if (!p) {
-        p = pmm_alloc_page(pmm_alloc_flags_, &pa);
+        p = AllocPageLocked(pmm_alloc_flags_ | PMM_ALLOC_FLAG_ZEROED, &pa);
     }
     if (!p) {
         return ZX_ERR_NO_MEMORY;
@@ -386,9 +507,6 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
 
     InitializeVmPage(p);
 
-    // TODO: remove once pmm returns zeroed pages
-    ZeroPage(pa);
-
     zx_status_t status = AddPageLocked(p, offset);
     DEBUG_ASSERT(status == ZX_OK);
 
@@ -405,15 +523,86 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
     return ZX_OK;
 }
 
+zx_status_t VmObjectPaged::GetLargePageLocked(uint64_t offset, uint8_t size_shift, uint pf_flags,
+                                              paddr_t* pa_out) {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    const uint64_t len = 1ULL << size_shift;
+    DEBUG_ASSERT(IS_ALIGNED(offset, len));
+
+    // clones need per page copy on write, so they always use small pages
+    if (!large_pages_ || parent_)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    if (!InRange(offset, len, size_))
+        return ZX_ERR_OUT_OF_RANGE;
+
+    // see if the range is already backed by a single run
+    size_t present = 0;
+    bool contiguous = true;
+    paddr_t base = 0;
+    page_list_.ForEveryPageInRange(
+        [&present, &contiguous, &base, offset](const auto p, uint64_t off) {
+            paddr_t pa = vm_page_to_paddr(p);
+            if (present++ == 0) {
+                base = pa - (off - offset);
+            } else if (pa != base + (off - offset)) {
+                contiguous = false;
+                return ZX_ERR_STOP;
+            }
+            return ZX_ERR_NEXT;
+        },
+        offset, offset + len);
+
+    if (present == len / PAGE_SIZE && contiguous && IS_ALIGNED(base, len)) {
+        *pa_out = base;
+        return ZX_OK;
+    }
+
+    // only commit a run into an empty range, partially populated ranges stay on small pages
+    if (present != 0 || !(pf_flags & VMM_PF_FLAG_FAULT_MASK))
+        return ZX_ERR_NOT_FOUND;
+
+    list_node page_list = LIST_INITIAL_VALUE(page_list);
+    const size_t count = len / PAGE_SIZE;
+    paddr_t pa;
+    if (pmm_alloc_contiguous(count, pmm_alloc_flags_, size_shift, &pa, &page_list) != count) {
+        LTRACEF("no contiguous run for offset %#" PRIx64 "\n", offset);
+        pmm_free(&page_list);
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    vm_page_t* p;
+    while ((p = list_remove_head_type(&page_list, vm_page_t, free.node)) != nullptr) {
+        InitializeVmPage(p);
+        ZeroPage(p);
+        zx_status_t status = AddPageLocked(p, offset + (vm_page_to_paddr(p) - pa));
+        DEBUG_ASSERT(status == ZX_OK);
+    }
+
+    // other mappings may have the zero page mapped over this range, so unmap those ranges
+    RangeChangeUpdateLocked(offset, len);
+
+    LTRACEF("faulted in large page at offset %#" PRIx64 ", pa %#" PRIxPTR "\n", offset, pa);
+
+    *pa_out = pa;
+    return ZX_OK;
+}
+
 zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t* committed) {
     canary_.Assert();
+
+    AutoLock a(&lock_);
+    return CommitRangeLocked(offset, len, committed);
+}
+
+zx_status_t VmObjectPaged::CommitRangeLocked(uint64_t offset, uint64_t len, uint64_t* committed) {
     LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 "\n", offset, len);
 
     if (committed)
         *committed = 0;
 
-    AutoLock a(&lock_);
-
     // trim the size
     uint64_t new_len;
     if (!TrimRange(offset, len, size_, &new_len))
@@ -428,6 +617,57 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t*
     DEBUG_ASSERT(end > offset);
     offset = ROUNDDOWN(offset, PAGE_SIZE);
 
+    // pages that have to come from a page source are brought in one at a time,
+    // waiting for the ones that aren't there yet
+    if (source_backed_) {
+        for (uint64_t o = offset; o < end; o += PAGE_SIZE) {
+            if (page_list_.GetPage(o))
+                continue;
+
+            PageRequest page_request;
+            zx_status_t status = GetPageLocked(o, VMM_PF_FLAG_SW_FAULT | VMM_PF_FLAG_WRITE,
+                                               nullptr, &page_request, nullptr, nullptr);
+            if (status == ZX_ERR_SHOULD_WAIT) {
+                status = WaitForPageLocked(&page_request);
+                if (status != ZX_OK)
+                    return status;
+                // look at the same offset again
+                o -= PAGE_SIZE;
+                continue;
+            }
+            if (status != ZX_OK)
+                return status;
+
+            if (committed)
+                *committed += PAGE_SIZE;
+        }
+        return ZX_OK;
+    }
+
+    // commit whole empty aligned runs as large pages first, anything left is filled in below
+    uint64_t large_committed = 0;
+    if (large_pages_ && !parent_) {
+        for (uint64_t o = ROUNDUP(offset, LARGE_PAGE_SIZE);
+             o < end && end - o >= LARGE_PAGE_SIZE; o += LARGE_PAGE_SIZE) {
+            bool empty = true;
+            page_list_.ForEveryPageInRange(
+                [&empty](const auto p, uint64_t off) {
+                    empty = false;
+                    return ZX_ERR_STOP;
+                },
+                o, o + LARGE_PAGE_SIZE);
+            if (!empty)
+                continue;
+
+            paddr_t pa;
+            const uint flags = VMM_PF_FLAG_SW_FAULT | VMM_PF_FLAG_WRITE;
+            if (GetLargePageLocked(o, LARGE_PAGE_SIZE_SHIFT, flags, &pa) == ZX_OK)
+                large_committed += LARGE_PAGE_SIZE;
+        }
+        if (committed)
+            *committed = large_committed;
+    }
+
     // make a pass through the list, counting the number of pages we need to allocate
     size_t count = 0;
     uint64_t expected_next_off = offset;
@@ -451,7 +691,7 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t*
     list_node page_list;
     list_initialize(&page_list);
 
-    size_t allocated = pmm_alloc_pages(count, pmm_alloc_flags_, &page_list);
+    size_t allocated = AllocPagesLocked(count, pmm_alloc_flags_ | PMM_ALLOC_FLAG_ZEROED, &page_list);
     if (allocated < count) {
         LTRACEF("failed to allocate enough pages (asked for %zu, got %zu)\n", count, allocated);
         pmm_free(&page_list);
@@ -474,7 +714,7 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t*
         const uint flags = VMM_PF_FLAG_SW_FAULT | VMM_PF_FLAG_WRITE;
         // Should not be able to fail, since we're providing it memory and the
         // range should be valid.
-        zx_status_t status = GetPageLocked(o, flags, &page_list, &p, &pa);
+        zx_status_t status = GetPageLocked(o, flags, &page_list, nullptr, &p, &pa);
         ASSERT(status == ZX_OK);
 
         if (committed)
@@ -484,7 +724,7 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t*
     DEBUG_ASSERT(list_is_empty(&page_list));
 
     // for now we only support committing as much as we were asked for
-    DEBUG_ASSERT(!committed || *committed == count * PAGE_SIZE);
+    DEBUG_ASSERT(!committed || *committed == count * PAGE_SIZE + large_committed);
 
     return ZX_OK;
 }
@@ -529,17 +769,36 @@ zx_status_t VmObjectPaged::CommitRangeContiguous(uint64_t offset, uint64_t len,
         return ZX_ERR_BAD_STATE;
     }
 
+    // finding a run may mean moving other objects' pages out of the way, which
+    // takes their locks, so the allocation is done without holding ours
+    const uint32_t pmm_alloc_flags = pmm_alloc_flags_;
+    a.release();
+
     // allocate count number of pages
     list_node page_list;
     list_initialize(&page_list);
 
-    size_t allocated = pmm_alloc_contiguous(count, pmm_alloc_flags_, alignment_log2, nullptr, &page_list);
+    size_t allocated = pmm_alloc_contiguous(count, pmm_alloc_flags | PMM_ALLOC_FLAG_COMPACT,
+                                            alignment_log2, nullptr, &page_list);
     if (allocated < count) {
         LTRACEF("failed to allocate enough pages (asked for %zu, got %zu)\n", count, allocated);
         pmm_free(&page_list);
         return ZX_ERR_NO_MEMORY;
     }
 
+    AutoLock relock(&lock_);
+
+    // the range may have been resized away or committed in the meantime
+    bool still_empty = end <= size_;
+    for (uint64_t o = offset; still_empty && o < end; o += PAGE_SIZE) {
+        if (page_list_.GetPage(o))
+            still_empty = false;
+    }
+    if (!still_empty) {
+        pmm_free(&page_list);
+        return ZX_ERR_BAD_STATE;
+    }
+
     DEBUG_ASSERT(list_length(&page_list) == allocated);
 
     // unmap all of the pages in this range on all the mapping regions
@@ -623,6 +882,227 @@ zx_status_t VmObjectPaged::DecommitRange(uint64_t offset, uint64_t len, uint64_t
     return ZX_OK;
 }
 
+zx_status_t VmObjectPaged::TakePages(uint64_t offset, uint64_t len, list_node* pages) {
+    canary_.Assert();
+    LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 "\n", offset, len);
+
+    if (!IS_PAGE_ALIGNED(offset) || !IS_PAGE_ALIGNED(len))
+        return ZX_ERR_INVALID_ARGS;
+
+    // pages of a clone may really be its parent's, and the pages of a source
+    // backed object aren't ours to give away
+    if (is_cow_clone() || page_source_)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    // every offset needs a page to hand over, the holes get zeroed ones
+    zx_status_t status = CommitRange(offset, len, nullptr);
+    if (status != ZX_OK)
+        return status;
+
+    AutoLock a(&lock_);
+
+    if (!InRange(offset, len, size_))
+        return ZX_ERR_OUT_OF_RANGE;
+
+    // someone may be doing dma to the pages
+    if (AnyPagesPinnedLocked(offset, len))
+        return ZX_ERR_BAD_STATE;
+
+    // the range may have been decommitted while we weren't holding the lock
+    for (uint64_t o = offset; o < offset + len; o += PAGE_SIZE) {
+        if (!page_list_.GetPage(o))
+            return ZX_ERR_BAD_STATE;
+    }
+
+    // unmap the pages everywhere, including children that see through to us
+    RangeChangeUpdateLocked(offset, len);
+
+    for (uint64_t o = offset; o < offset + len; o += PAGE_SIZE) {
+        vm_page_t* p = page_list_.RemovePage(o);
+        DEBUG_ASSERT(p);
+
+        p->state = VM_PAGE_STATE_ALLOC;
+        p->flags = 0;
+        list_add_tail(pages, &p->free.node);
+    }
+
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::SupplyPages(uint64_t offset, uint64_t len, list_node* pages) {
+    canary_.Assert();
+    LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 "\n", offset, len);
+
+    list_node unused;
+    list_initialize(&unused);
+    auto ac = fbl::MakeAutoCall([pages, &unused]() {
+        pmm_free(pages);
+        pmm_free(&unused);
+    });
+
+    if (!page_source_)
+        return ZX_ERR_NOT_SUPPORTED;
+    if (!IS_PAGE_ALIGNED(offset) || !IS_PAGE_ALIGNED(len))
+        return ZX_ERR_INVALID_ARGS;
+    if (list_length(pages) != len / PAGE_SIZE)
+        return ZX_ERR_INVALID_ARGS;
+
+    AutoLock a(&lock_);
+
+    if (!InRange(offset, len, size_))
+        return ZX_ERR_OUT_OF_RANGE;
+
+    size_t supplied = 0;
+    for (uint64_t o = offset; o < offset + len; o += PAGE_SIZE) {
+        vm_page_t* p = list_remove_head_type(pages, vm_page_t, free.node);
+        DEBUG_ASSERT(p);
+
+        // a page that is already in may have been written to since, keep it
+        if (page_list_.GetPage(o)) {
+            list_add_tail(&unused, &p->free.node);
+            continue;
+        }
+
+        InitializeVmPage(p);
+        zx_status_t status = AddPageLocked(p, o);
+        if (status != ZX_OK) {
+            // waiters that still miss their page ask for it again
+            p->state = VM_PAGE_STATE_ALLOC;
+            list_add_tail(&unused, &p->free.node);
+            continue;
+        }
+        supplied++;
+    }
+    kcounter_add(vm_page_source_pages_supplied, supplied);
+
+    page_source_->OnPagesSupplied(offset, len);
+
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::WaitForPageLocked(PageRequest* page_request) {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    // whoever supplies the page needs our lock to put it in
+    lock_.Release();
+    zx_status_t status = page_request->Wait();
+    lock_.Acquire();
+
+    return status;
+}
+
+zx_status_t VmObjectPaged::GetNodePolicy(uint32_t* policy, uint32_t* node) {
+    canary_.Assert();
+
+    AutoLock a(&lock_);
+    *policy = node_policy_;
+    *node = policy_node_;
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::SetNodePolicy(uint32_t policy, uint32_t node) {
+    canary_.Assert();
+    LTRACEF("policy %u node %u\n", policy, node);
+
+    switch (policy) {
+    case PMM_NODE_POLICY_LOCAL:
+    case PMM_NODE_POLICY_INTERLEAVE:
+        node = 0;
+        break;
+    case PMM_NODE_POLICY_BIND:
+        if (node >= pmm_node_count())
+            return ZX_ERR_INVALID_ARGS;
+        break;
+    default:
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    // pages already committed stay where they are
+    AutoLock a(&lock_);
+    node_policy_ = policy;
+    policy_node_ = node;
+    return ZX_OK;
+}
+
+vm_page_t* VmObjectPaged::AllocPageLocked(uint alloc_flags, paddr_t* pa) {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    switch (node_policy_) {
+    case PMM_NODE_POLICY_INTERLEAVE:
+        return pmm_alloc_page_node(alloc_flags, interleave_next_++ % pmm_node_count(), pa);
+    case PMM_NODE_POLICY_BIND:
+        return pmm_alloc_page_node(alloc_flags | PMM_ALLOC_FLAG_NODE_STRICT, policy_node_, pa);
+    default:
+        return pmm_alloc_page(alloc_flags, pa);
+    }
+}
+
+size_t VmObjectPaged::AllocPagesLocked(size_t count, uint alloc_flags, list_node* pages) {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    switch (node_policy_) {
+    case PMM_NODE_POLICY_INTERLEAVE: {
+        // the pages are added to the object in list order, so taking them
+        // one node at a time spreads the range evenly
+        size_t allocated = 0;
+        for (; allocated < count; allocated++) {
+            vm_page_t* p = AllocPageLocked(alloc_flags, nullptr);
+            if (!p)
+                break;
+            list_add_tail(pages, &p->free.node);
+        }
+        return allocated;
+    }
+    case PMM_NODE_POLICY_BIND:
+        return pmm_alloc_pages_node(count, alloc_flags | PMM_ALLOC_FLAG_NODE_STRICT, policy_node_,
+                                    pages);
+    default:
+        return pmm_alloc_pages(count, alloc_flags, pages);
+    }
+}
+
+zx_status_t VmObjectPaged::ReplacePages(uint64_t offset, list_node* pages, size_t count) {
+    canary_.Assert();
+    LTRACEF("offset %#" PRIx64 ", count %zu\n", offset, count);
+
+    if (!IS_PAGE_ALIGNED(offset))
+        return ZX_ERR_INVALID_ARGS;
+
+    AutoLock a(&lock_);
+
+    const uint64_t len = count * PAGE_SIZE;
+    if (!InRange(offset, len, size_))
+        return ZX_ERR_OUT_OF_RANGE;
+
+    // someone may be doing dma to the old pages
+    if (AnyPagesPinnedLocked(offset, len))
+        return ZX_ERR_BAD_STATE;
+
+    // unmap the old pages everywhere, including children that see through to us
+    RangeChangeUpdateLocked(offset, len);
+
+    for (uint64_t end = offset + len; offset < end; offset += PAGE_SIZE) {
+        vm_page_t* p = list_peek_head_type(pages, vm_page_t, free.node);
+        DEBUG_ASSERT(p);
+
+        page_list_.FreePage(offset);
+
+        // the only way this can fail is running out of memory for a new list
+        // node, anything not done yet stays with the caller
+        list_delete(&p->free.node);
+        InitializeVmPage(p);
+        zx_status_t status = page_list_.AddPage(p, offset);
+        if (status != ZX_OK) {
+            p->state = VM_PAGE_STATE_ALLOC;
+            list_add_head(pages, &p->free.node);
+            return status;
+        }
+        SetPageOwnerLocked(p, offset);
+    }
+
+    return ZX_OK;
+}
+
 zx_status_t VmObjectPaged::Pin(uint64_t offset, uint64_t len) {
     canary_.Assert();
 
@@ -722,7 +1202,7 @@ bool VmObjectPaged::AnyPagesPinnedLocked(uint64_t offset, size_t len) {
     page_list_.ForEveryPageInRange(
         [&found_pinned, start_page_offset, end_page_offset](const auto p, uint64_t off) {
             DEBUG_ASSERT(off >= start_page_offset && off < end_page_offset);
-            if (p->object.pin_count > 0) {
+            if (p->object.pin_count > 0 || (p->flags & VM_PAGE_FLAG_LOOKED_UP)) {
                 found_pinned = true;
                 return ZX_ERR_STOP;
             }
@@ -786,6 +1266,10 @@ zx_status_t VmObjectPaged::ResizeLocked(uint64_t s) {
 }
 
 zx_status_t VmObjectPaged::Resize(uint64_t s) {
+    // the source decides what is in the object, including how much of it there is
+    if (page_source_)
+        return ZX_ERR_NOT_SUPPORTED;
+
     AutoLock a(&lock_);
 
     return ResizeLocked(s);
@@ -831,6 +1315,14 @@ zx_status_t VmObjectPaged::ReadWriteInternal(uint64_t offset, size_t len, size_t
     if (new_len == 0)
         return 0;
 
+    // bring in every page being written to in one go, rather than a fault
+    // at a time in the loop below
+    if (write) {
+        zx_status_t status = CommitRangeLocked(offset, new_len, nullptr);
+        if (status != ZX_OK)
+            return status;
+    }
+
     // walk the list of pages and do the write
     uint64_t src_offset = offset;
     size_t dest_offset = 0;
@@ -840,9 +1332,16 @@ zx_status_t VmObjectPaged::ReadWriteInternal(uint64_t offset, size_t len, size_t
 
         // fault in the page
         paddr_t pa;
+        PageRequest page_request;
         auto status = GetPageLocked(src_offset,
                                     VMM_PF_FLAG_SW_FAULT | (write ? VMM_PF_FLAG_WRITE : 0),
-                                    nullptr, nullptr, &pa);
+                                    nullptr, &page_request, nullptr, &pa);
+        if (status == ZX_ERR_SHOULD_WAIT) {
+            status = WaitForPageLocked(&page_request);
+            if (status != ZX_OK)
+                return status;
+            continue;
+        }
         if (status < 0)
             return status;
 
@@ -927,7 +1426,7 @@ zx_status_t VmObjectPaged::Lookup(uint64_t offset, uint64_t len, uint pf_flags,
 
                 paddr_t pa;
                 zx_status_t status = this->GetPageLocked(missing_off, pf_flags, nullptr,
-                                                         nullptr, &pa);
+                                                         nullptr, nullptr, &pa);
                 if (status != ZX_OK) {
                     return ZX_ERR_NO_MEMORY;
                 }
@@ -962,7 +1461,7 @@ zx_status_t VmObjectPaged::Lookup(uint64_t offset, uint64_t len, uint pf_flags,
     // If expected_next_off isn't at the end, there's a gap to process
     for (uint64_t off = expected_next_off; off < end_page_offset; off += PAGE_SIZE) {
         paddr_t pa;
-        zx_status_t status = GetPageLocked(off, pf_flags, nullptr, nullptr, &pa);
+        zx_status_t status = GetPageLocked(off, pf_flags, nullptr, nullptr, nullptr, &pa);
         if (status != ZX_OK) {
             return ZX_ERR_NO_MEMORY;
         }
@@ -999,6 +1498,83 @@ zx_status_t VmObjectPaged::WriteUser(user_in_ptr<const void> ptr, uint64_t offse
     return ReadWriteInternal(offset, len, bytes_written, true, write_routine);
 }
 
+namespace {
+
+// Walks a list of user buffers in order, handing out the next |len| bytes of
+// them as a run of contiguous pieces.
+class IovecCursor {
+public:
+    IovecCursor(const iovec_t* vec, size_t count) : vec_(vec), count_(count) {}
+
+    template <typename F>
+    zx_status_t Next(size_t len, F func) {
+        size_t offset = 0;
+        while (len > 0) {
+            while (pos_ == vec_[index_].iov_len) {
+                index_++;
+                pos_ = 0;
+                DEBUG_ASSERT(index_ < count_);
+            }
+            size_t n = MIN(len, vec_[index_].iov_len - pos_);
+            zx_status_t status = func(static_cast<uint8_t*>(vec_[index_].iov_base) + pos_, offset, n);
+            if (status != ZX_OK)
+                return status;
+            pos_ += n;
+            offset += n;
+            len -= n;
+        }
+        return ZX_OK;
+    }
+
+private:
+    const iovec_t* const vec_;
+    const size_t count_;
+    size_t index_ = 0;
+    size_t pos_ = 0;
+};
+
+} // namespace
+
+zx_status_t VmObjectPaged::ReadUserVector(const iovec_t* vec, size_t count, uint64_t offset,
+                                          size_t* bytes_read) {
+    canary_.Assert();
+
+    ssize_t len = iovec_size(vec, static_cast<uint>(count));
+    if (len < 0)
+        return static_cast<zx_status_t>(len);
+
+    // read routine that scatters with copy_to_user
+    IovecCursor cursor(vec, count);
+    auto read_routine = [&cursor](const void* src, size_t, size_t len) -> zx_status_t {
+        return cursor.Next(len, [src](uint8_t* user, size_t offset, size_t n) {
+            return make_user_out_ptr(user).copy_array_to_user(
+                static_cast<const uint8_t*>(src) + offset, n);
+        });
+    };
+
+    return ReadWriteInternal(offset, len, bytes_read, false, read_routine);
+}
+
+zx_status_t VmObjectPaged::WriteUserVector(const iovec_t* vec, size_t count, uint64_t offset,
+                                           size_t* bytes_written) {
+    canary_.Assert();
+
+    ssize_t len = iovec_size(vec, static_cast<uint>(count));
+    if (len < 0)
+        return static_cast<zx_status_t>(len);
+
+    // write routine that gathers with copy_from_user
+    IovecCursor cursor(vec, count);
+    auto write_routine = [&cursor](void* dst, size_t, size_t len) -> zx_status_t {
+        return cursor.Next(len, [dst](uint8_t* user, size_t offset, size_t n) {
+            return make_user_in_ptr(static_cast<const uint8_t*>(user)).copy_array_from_user(
+                static_cast<uint8_t*>(dst) + offset, n);
+        });
+    };
+
+    return ReadWriteInternal(offset, len, bytes_written, true, write_routine);
+}
+
 zx_status_t VmObjectPaged::LookupUser(uint64_t offset, uint64_t len, user_inout_ptr<paddr_t> buffer,
                                       size_t buffer_size) {
     canary_.Assert();
@@ -1010,12 +1586,33 @@ zx_status_t VmObjectPaged::LookupUser(uint64_t offset, uint64_t len, user_inout_
     if (unlikely(table_size > buffer_size))
         return ZX_ERR_BUFFER_TOO_SMALL;
 
+    // no longer safe to merge into a child, even if the lookup fails part way
+    {
+        AutoLock a(&lock_);
+        pages_looked_up_ = true;
+    }
+
+    struct Context {
+        VmObject* vmo;
+        user_inout_ptr<paddr_t> buffer;
+    } context = {this, buffer};
     auto copy_to_user = [](void* context, size_t offset, size_t index, paddr_t pa) -> zx_status_t {
-        user_inout_ptr<paddr_t>* buffer = static_cast<user_inout_ptr<paddr_t>*>(context);
-        return buffer->element_offset(index).copy_to_user(pa);
+        Context* c = static_cast<Context*>(context);
+
+        // the caller is free to program a device with the address, so from now
+        // on the page is held as if pinned, and neither the zero page scanner
+        // nor compaction may touch it. Lookup() holds our lock, and a page
+        // seen through from a parent isn't ours to mark.
+        vm_page_t* p = paddr_to_vm_page(pa);
+        if (p && p->state == VM_PAGE_STATE_OBJECT && p->object.obj == c->vmo) {
+            p->flags |= VM_PAGE_FLAG_LOOKED_UP;
+            p->flags &= ~VM_PAGE_FLAG_MOVABLE;
+        }
+
+        return c->buffer.element_offset(index).copy_to_user(pa);
     };
     // only lookup pages that are already present
-    return Lookup(offset, len, 0, copy_to_user, &buffer);
+    return Lookup(offset, len, 0, copy_to_user, &context);
 }
 
 zx_status_t VmObjectPaged::InvalidateCache(const uint64_t offset, const uint64_t len) {
@@ -1063,7 +1660,7 @@ zx_status_t VmObjectPaged::CacheOp(const uint64_t start_offset, const uint64_t l
 
         // lookup the physical address of the page, careful not to fault in a new one
         paddr_t pa;
-        auto status = GetPageLocked(op_start_offset, 0, nullptr, nullptr, &pa);
+        auto status = GetPageLocked(op_start_offset, 0, nullptr, nullptr, nullptr, &pa);
 
         if (likely(status == ZX_OK)) {
             // Convert the page address to a Kernel virtual address.
@@ -1125,3 +1722,377 @@ void VmObjectPaged::RangeChangeUpdateFromParentLocked(const uint64_t offset, con
     // TODO: optimize by not passing on ranges that are completely covered by pages local to this vmo
     RangeChangeUpdateLocked(offset_new, len_new);
 }
+
+bool VmObjectPaged::ParentCollapsibleLocked() const {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    if (!parent_)
+        return false;
+
+    // clones are only ever made of paged objects
+    DEBUG_ASSERT(parent_->is_paged());
+    auto parent = static_cast<const VmObjectPaged*>(parent_.get());
+
+    // the root owns the lock the whole tree uses, so only an intermediate
+    // parent can go away, and only once nothing but us uses it: no handles or
+    // other holders, no mappings, and no pages a device may be using. pins
+    // are checked for when collapsing, since finding them takes a walk.
+    return parent->parent_ && parent->children_list_len_ == 1 &&
+           parent->holder_count_ == 0 && parent->mapping_list_len_ == 0 &&
+           !parent->pages_looked_up_;
+}
+
+bool VmObjectPaged::CollapseParentLocked(fbl::RefPtr<VmObject>* dead) {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    if (!ParentCollapsibleLocked())
+        return false;
+
+    auto parent = static_cast<VmObjectPaged*>(parent_.get());
+    DEBUG_ASSERT(&parent->children_list_.front() == this);
+    if (parent->AnyPagesPinnedLocked(0, ROUNDUP(parent->size_, PAGE_SIZE)))
+        return false;
+
+    safeint::CheckedNumeric<uint64_t> new_offset = parent->parent_offset_;
+    new_offset += parent_offset_;
+    safeint::CheckedNumeric<uint64_t> new_end = new_offset;
+    new_end += size_;
+    if (!new_end.IsValid())
+        return false;
+
+    // we see the parent's pages in [parent_offset_, parent_offset_ + visible)
+    const uint64_t visible = MIN(size_, parent_limit_);
+
+    // the grandparent is only visible through the part of the parent's range
+    // it could look through itself
+    const uint64_t parent_view = MIN(parent->size_, parent->parent_limit_);
+    const uint64_t new_limit =
+        MIN(parent_limit_, parent_view > parent_offset_ ? parent_view - parent_offset_ : 0);
+
+    // move the parent's pages that we can see and haven't replaced into us,
+    // the rest were only reachable through us and can be freed
+    list_node free_list = LIST_INITIAL_VALUE(free_list);
+    size_t merged = 0;
+    size_t freed = 0;
+    VmPageList& pages = page_list_;
+    VmObject* const self = this;
+    const uint64_t base = parent_offset_;
+    parent->page_list_.ForEveryPage(
+        [&pages, &free_list, &merged, &freed, self, base, visible](vm_page_t*& p, uint64_t off) {
+            DEBUG_ASSERT(p->object.pin_count == 0);
+            if (off >= base && off - base < visible && pages.GetPage(off - base) == nullptr) {
+                __UNUSED zx_status_t status = pages.AddPage(p, off - base);
+                DEBUG_ASSERT(status == ZX_OK);
+                p->object.obj = self;
+                p->object.offset = off - base;
+                merged++;
+            } else {
+                list_add_tail(&free_list, &p->free.node);
+                freed++;
+            }
+            p = nullptr;
+            return ZX_ERR_NEXT;
+        });
+    parent->page_list_.FreeAllPages();
+    pmm_free(&free_list);
+
+    // take the parent's place under the grandparent. the physical pages behind
+    // every offset we can see are unchanged, so no mappings need updating.
+    fbl::RefPtr<VmObject> grandparent = fbl::move(parent->parent_);
+    parent->RemoveChildLocked(this);
+    grandparent->RemoveChildLocked(parent);
+    grandparent->AddChildLocked(this);
+
+    LTRACEF("vmo %p collapsed parent %p, %zu pages merged, %zu freed\n",
+            this, parent, merged, freed);
+
+    parent_offset_ = new_offset.ValueOrDie();
+    parent_limit_ = new_limit;
+    *dead = fbl::move(parent_);
+    parent_ = fbl::move(grandparent);
+
+    kcounter_add(vm_cow_parents_collapsed, 1);
+    kcounter_add(vm_cow_pages_merged, merged);
+    kcounter_add(vm_cow_pages_freed, freed);
+
+    return true;
+}
+
+uint32_t VmObjectPaged::CollapseChain() {
+    canary_.Assert();
+
+    uint32_t collapsed = 0;
+    for (;;) {
+        // destroyed after the lock is dropped
+        fbl::RefPtr<VmObject> dead;
+
+        AutoLock a(&lock_);
+        if (!CollapseParentLocked(&dead))
+            break;
+        collapsed++;
+    }
+    return collapsed;
+}
+
+void VmObjectPaged::QueueCollapseLocked() {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    if (!collapse_thread_running)
+        return;
+
+    // we're referenced by whoever is looking up pages through us, so it's
+    // safe to take another reference here
+    collapse_queued_ = true;
+    {
+        AutoLock a(&collapse_lock_);
+        collapse_list_.push_back(fbl::WrapRefPtr(this));
+    }
+    event_signal(&collapse_event, false);
+}
+
+void VmObjectPaged::CollapseQueued() {
+    for (;;) {
+        fbl::RefPtr<VmObjectPaged> vmo;
+        {
+            AutoLock a(&collapse_lock_);
+            vmo = collapse_list_.pop_front();
+        }
+        if (!vmo)
+            return;
+
+        {
+            AutoLock a(&vmo->lock_);
+            vmo->collapse_queued_ = false;
+        }
+        vmo->CollapseChain();
+    }
+}
+
+static int vm_cow_collapse_thread(void* arg) {
+    for (;;) {
+        __UNUSED zx_status_t err = event_wait(&collapse_event);
+        DEBUG_ASSERT(err == ZX_OK);
+
+        VmObjectPaged::CollapseQueued();
+    }
+
+    return 0;
+}
+
+static void vm_cow_collapse_init(uint level) {
+    thread_t* t = thread_create("vm-cow-collapse", &vm_cow_collapse_thread, nullptr,
+                                LOW_PRIORITY, DEFAULT_STACK_SIZE);
+    collapse_thread_running = true;
+    thread_detach_and_resume(t);
+}
+
+LK_INIT_HOOK(vm_cow_collapse, &vm_cow_collapse_init, LK_INIT_LEVEL_THREADING);
+
+bool VmObjectPaged::MappedIntoKernelLocked() const {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    for (const auto& m : mapping_list_) {
+        if (!m.aspace()->is_user())
+            return true;
+    }
+    return false;
+}
+
+size_t VmObjectPaged::FreeZeroPages() {
+    canary_.Assert();
+
+    // pages are looked at in batches, dropping the lock in between so a large
+    // object doesn't hold off its faults for the whole scan
+    static constexpr size_t kBatch = 64;
+
+    size_t freed = 0;
+    uint64_t start = 0;
+    for (;;) {
+        AutoLock a(&lock_);
+
+        // a large page run has to stay whole to keep being mapped as one, and
+        // a page source would only be asked for the page again
+        if (large_pages_ || page_source_ || MappedIntoKernelLocked())
+            break;
+
+        // a page of a clone that covers the parent can't go, since the parent's
+        // page would show through in its place
+        if (parent_)
+            start = MAX(start, MIN(parent_limit_, size_));
+        if (start >= size_)
+            break;
+
+        uint64_t offsets[kBatch];
+        size_t count = 0;
+        page_list_.ForEveryPageInRange(
+            [&offsets, &count](const auto p, uint64_t off) {
+                // a device may still be using a page whose address was looked up
+                if (p->state != VM_PAGE_STATE_OBJECT || p->object.pin_count > 0 ||
+                    (p->flags & VM_PAGE_FLAG_LOOKED_UP) || !IsZeroPage(p)) {
+                    return ZX_ERR_NEXT;
+                }
+                offsets[count++] = off;
+                return count == kBatch ? ZX_ERR_STOP : ZX_ERR_NEXT;
+            },
+            start, size_);
+
+        for (size_t i = 0; i < count; i++) {
+            vm_page_t* p = page_list_.GetPage(offsets[i]);
+            DEBUG_ASSERT(p);
+
+            // take the page out of every mapping first, then look again in case
+            // it was written through one of them after the first look
+            RangeChangeUpdateLocked(offsets[i], PAGE_SIZE);
+            if (!IsZeroPage(p))
+                continue;
+
+            __UNUSED zx_status_t status = page_list_.FreePage(offsets[i]);
+            DEBUG_ASSERT(status == ZX_OK);
+            freed++;
+        }
+
+        if (count < kBatch)
+            break;
+        start = offsets[count - 1] + PAGE_SIZE;
+    }
+
+    if (freed > 0) {
+        LTRACEF("vmo %p freed %zu zero pages\n", this, freed);
+        kcounter_add(vm_zero_scan_pages_freed, freed);
+    }
+    return freed;
+}
+
+size_t VmObjectPaged::ScanForZeroPages() {
+    size_t freed = 0;
+
+    fbl::RefPtr<VmObject> vmo;
+    while ((vmo = VmObject::NextInGlobalList(vmo.get())) != nullptr) {
+        if (vmo->is_paged())
+            freed += static_cast<VmObjectPaged*>(vmo.get())->FreeZeroPages();
+    }
+
+    kcounter_add(vm_zero_scan_passes, 1);
+    return freed;
+}
+
+// seconds between passes of the zero page scanner, 0 turns it off
+static uint32_t zero_scan_interval = 30;
+
+static int vm_zero_scan_thread(void* arg) {
+    for (;;) {
+        thread_sleep_relative(ZX_SEC(zero_scan_interval));
+
+        __UNUSED size_t freed = VmObjectPaged::ScanForZeroPages();
+        LTRACEF("zero page scan freed %zu pages\n", freed);
+    }
+
+    return 0;
+}
+
+static void vm_zero_scan_init(uint level) {
+    zero_scan_interval = cmdline_get_uint32("kernel.vm.zero-scan-interval", zero_scan_interval);
+    if (zero_scan_interval == 0)
+        return;
+
+    thread_t* t = thread_create("vm-zero-scan", &vm_zero_scan_thread, nullptr,
+                                LOW_PRIORITY, DEFAULT_STACK_SIZE);
+    thread_detach_and_resume(t);
+}
+
+LK_INIT_HOOK(vm_zero_scan, &vm_zero_scan_init, LK_INIT_LEVEL_THREADING);
+
+static int compare_vmo_ptr(const void* a, const void* b) {
+    auto x = reinterpret_cast<uintptr_t>(*static_cast<VmObject* const*>(a));
+    auto y = reinterpret_cast<uintptr_t>(*static_cast<VmObject* const*>(b));
+    return x < y ? -1 : x > y;
+}
+
+size_t VmObjectPaged::EvacuateRange(paddr_t pa, size_t count, list_node* vacated) {
+    // the owners recorded in the pages are only hints until the object is found
+    // on the global list and the page is looked at again under its lock
+    fbl::AllocChecker ac;
+    fbl::Array<VmObject*> owners(new (&ac) VmObject*[count], count);
+    if (!ac.check())
+        return 0;
+
+    size_t movable = 0;
+    for (size_t i = 0; i < count; i++) {
+        const vm_page_t* p = paddr_to_vm_page(pa + i * PAGE_SIZE);
+        if (p && page_is_movable(p))
+            owners[movable++] = p->object.obj;
+    }
+    if (movable == 0)
+        return 0;
+
+    VmObject** const first = owners.get();
+    VmObject** const last = first + movable;
+    qsort(first, movable, sizeof(VmObject*), compare_vmo_ptr);
+
+    size_t moved = 0;
+    fbl::RefPtr<VmObject> vmo;
+    while (moved < movable && (vmo = VmObject::NextInGlobalList(vmo.get())) != nullptr) {
+        if (!vmo->is_paged())
+            continue;
+        VmObject* const* it = fbl::lower_bound(first, last, vmo.get());
+        if (it == last || *it != vmo.get())
+            continue;
+
+        moved += static_cast<VmObjectPaged*>(vmo.get())->EvacuatePages(pa, count, vacated);
+    }
+
+    kcounter_add(vm_compaction_pages_moved, moved);
+    return moved;
+}
+
+size_t VmObjectPaged::EvacuatePages(paddr_t pa, size_t count, list_node* vacated) {
+    canary_.Assert();
+
+    AutoLock a(&lock_);
+
+    // the kernel may touch its mappings where it can't take a fault
+    if (MappedIntoKernelLocked())
+        return 0;
+
+    const paddr_t end = pa + count * PAGE_SIZE;
+    size_t moved = 0;
+    for (paddr_t old_pa = pa; old_pa < end; old_pa += PAGE_SIZE) {
+        vm_page_t* p = paddr_to_vm_page(old_pa);
+        if (!p || !page_is_movable(p) || p->object.obj != this)
+            continue;
+        const uint64_t offset = p->object.offset;
+        if (page_list_.GetPage(offset) != p)
+            continue;
+
+        // the copy has to go outside the range, but pages inside it that were
+        // freed since the caller reserved it can turn up here too, and are
+        // just as good to hand back
+        paddr_t new_pa;
+        vm_page_t* new_p;
+        while ((new_p = AllocPageLocked(pmm_alloc_flags_, &new_pa)) != nullptr &&
+               new_pa >= pa && new_pa < end) {
+            list_add_tail(vacated, &new_p->free.node);
+        }
+        if (!new_p)
+            break;
+        InitializeVmPage(new_p);
+
+        // nothing can write the old page once it's unmapped everywhere,
+        // including from children that see through to us
+        RangeChangeUpdateLocked(offset, PAGE_SIZE);
+        memcpy(paddr_to_physmap(new_pa), paddr_to_physmap(old_pa), PAGE_SIZE);
+
+        __UNUSED vm_page_t* old = page_list_.ReplacePage(new_p, offset);
+        DEBUG_ASSERT(old == p);
+        SetPageOwnerLocked(new_p, offset);
+
+        p->state = VM_PAGE_STATE_ALLOC;
+        p->flags = 0;
+        list_add_tail(vacated, &p->free.node);
+        moved++;
+    }
+
+    LTRACEF("vmo %p moved %zu pages out of [%#" PRIxPTR ", %#" PRIxPTR ")\n", this, moved, pa, end);
+    return moved;
+}
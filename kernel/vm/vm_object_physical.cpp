@@ -70,7 +70,8 @@ void VmObjectPhysical::Dump(uint depth, bool verbose) {
 
 // get the physical address of a page at offset
 zx_status_t VmObjectPhysical::GetPageLocked(uint64_t offset, uint pf_flags, list_node* free_list,
-                                            vm_page_t** _page, paddr_t* _pa) {
+                                            PageRequest* page_request, vm_page_t** _page,
+                                            paddr_t* _pa) {
     canary_.Assert();
 
     if (_page)
@@ -88,6 +89,25 @@ zx_status_t VmObjectPhysical::GetPageLocked(uint64_t offset, uint pf_flags, list
     return ZX_OK;
 }
 
+zx_status_t VmObjectPhysical::GetLargePageLocked(uint64_t offset, uint8_t size_shift,
+                                                 uint pf_flags, paddr_t* _pa) {
+    canary_.Assert();
+
+    const uint64_t len = 1ULL << size_shift;
+    DEBUG_ASSERT(IS_ALIGNED(offset, len));
+
+    if (!InRange(offset, len, size_))
+        return ZX_ERR_OUT_OF_RANGE;
+
+    uint64_t pa = base_ + offset;
+    if (!IS_ALIGNED(pa, len) || pa + len - 1 > UINTPTR_MAX)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    *_pa = (paddr_t)pa;
+
+    return ZX_OK;
+}
+
 zx_status_t VmObjectPhysical::LookupUser(uint64_t offset, uint64_t len, user_inout_ptr<paddr_t> buffer,
                                          size_t buffer_size) {
     canary_.Assert();
@@ -67,6 +67,7 @@ VmPageList::VmPageList() {
 VmPageList::~VmPageList() {
     LTRACEF("%p\n", this);
     DEBUG_ASSERT(list_.is_empty());
+    DEBUG_ASSERT(count_ == 0);
 }
 
 zx_status_t VmPageList::AddPage(vm_page* p, uint64_t offset) {
@@ -91,9 +92,13 @@ zx_status_t VmPageList::AddPage(vm_page* p, uint64_t offset) {
 
         list_.insert(fbl::move(pl));
     } else {
-        pln->AddPage(p, index);
+        zx_status_t status = pln->AddPage(p, index);
+        if (status != ZX_OK) {
+            return status;
+        }
     }
 
+    AdjustCount(1);
     return ZX_OK;
 }
 
@@ -113,7 +118,28 @@ vm_page* VmPageList::GetPage(uint64_t offset) {
     return pln->GetPage(index);
 }
 
-zx_status_t VmPageList::FreePage(uint64_t offset) {
+vm_page* VmPageList::ReplacePage(vm_page* p, uint64_t offset) {
+    uint64_t node_offset = ROUNDDOWN(offset, PAGE_SIZE * VmPageListNode::kPageFanOut);
+    size_t index = (offset >> PAGE_SIZE_SHIFT) % VmPageListNode::kPageFanOut;
+
+    LTRACEF_LEVEL(2, "%p page %p, offset %#" PRIx64 " node_offset %#" PRIx64 " index %zu\n", this, p,
+                  offset, node_offset, index);
+
+    // lookup the tree node that holds this page
+    auto pln = list_.find(node_offset);
+    if (!pln.IsValid()) {
+        return nullptr;
+    }
+
+    auto old = pln->RemovePage(index);
+    if (old) {
+        __UNUSED auto status = pln->AddPage(p, index);
+        DEBUG_ASSERT(status == ZX_OK);
+    }
+    return old;
+}
+
+vm_page* VmPageList::RemovePage(uint64_t offset) {
     uint64_t node_offset = ROUNDDOWN(offset, PAGE_SIZE * VmPageListNode::kPageFanOut);
     size_t index = (offset >> PAGE_SIZE_SHIFT) % VmPageListNode::kPageFanOut;
 
@@ -123,21 +149,32 @@ zx_status_t VmPageList::FreePage(uint64_t offset) {
     // lookup the tree node that holds this page
     auto pln = list_.find(node_offset);
     if (!pln.IsValid()) {
-        return ZX_ERR_NOT_FOUND;
+        return nullptr;
     }
 
-    // free this page
     auto page = pln->RemovePage(index);
     if (page) {
+        AdjustCount(-1);
+
         // if it was the last page in the node, remove the node from the tree
         if (pln->IsEmpty()) {
             LTRACEF_LEVEL(2, "%p freeing the list node\n", this);
             list_.erase(*pln);
         }
+    }
+
+    return page;
+}
 
-        pmm_free_page(page);
+zx_status_t VmPageList::FreePage(uint64_t offset) {
+    // free this page
+    auto page = RemovePage(offset);
+    if (!page) {
+        return ZX_ERR_NOT_FOUND;
     }
 
+    pmm_free_page(page);
+
     return ZX_OK;
 }
 
@@ -168,5 +205,18 @@ size_t VmPageList::FreeAllPages() {
     // empty the tree
     list_.clear();
 
+    // pages may have been taken out of the nodes directly, see ForEveryPage()
+    AdjustCount(-static_cast<int64_t>(count_));
+
     return count;
 }
+
+void VmPageList::SetAttribution(fbl::RefPtr<VmAttribution> attribution) {
+    if (attribution_) {
+        attribution_->AddPages(-static_cast<int64_t>(count_));
+    }
+    attribution_ = fbl::move(attribution);
+    if (attribution_) {
+        attribution_->AddPages(count_);
+    }
+}
@@ -9,6 +9,7 @@
 #include <fbl/alloc_checker.h>
 #include <fbl/array.h>
 #include <unittest.h>
+#include <vm/physmap.h>
 #include <vm/vm.h>
 #include <vm/vm_address_region.h>
 #include <vm/vm_aspace.h>
@@ -53,6 +54,74 @@ static bool pmm_large_alloc_test(void* context) {
     END_TEST;
 }
 
+// Allocates and frees small batches, which go through the per cpu page
+// caches, and makes sure the pages come back usable and accounted for.
+static bool pmm_small_alloc_test(void* context) {
+    BEGIN_TEST;
+    list_node list = LIST_INITIAL_VALUE(list);
+
+    static const size_t alloc_count = 8;
+
+    for (int pass = 0; pass < 4; pass++) {
+        auto count = pmm_alloc_pages(alloc_count, 0, &list);
+        EXPECT_EQ(alloc_count, count, "pmm_alloc_pages a few pages count");
+        EXPECT_EQ(alloc_count, list_length(&list), "pmm_alloc_pages a few pages list count");
+
+        vm_page_t* page;
+        list_for_every_entry(&list, page, vm_page_t, free.node) {
+            EXPECT_EQ(VM_PAGE_STATE_ALLOC, page->state, "allocated page state");
+            EXPECT_EQ(page, paddr_to_vm_page(vm_page_to_paddr(page)), "page translates");
+        }
+
+        auto ret = pmm_free(&list);
+        EXPECT_EQ(alloc_count, ret, "pmm_free on a few pages");
+        EXPECT_TRUE(list_is_empty(&list), "pmm_free empties the list");
+    }
+    END_TEST;
+}
+
+// Dirties some pages, frees them and makes sure zeroed allocations, whether
+// they come from the zero pool or are cleared inline, never see the old data.
+static bool pmm_zeroed_alloc_test(void* context) {
+    BEGIN_TEST;
+    list_node list = LIST_INITIAL_VALUE(list);
+
+    static const size_t alloc_count = 64;
+
+    auto count = pmm_alloc_pages(alloc_count, 0, &list);
+    EXPECT_EQ(alloc_count, count, "pmm_alloc_pages count");
+    vm_page_t* page;
+    list_for_every_entry(&list, page, vm_page_t, free.node) {
+        memset(paddr_to_physmap(vm_page_to_paddr(page)), 0xa5, PAGE_SIZE);
+    }
+    pmm_free(&list);
+
+    count = pmm_alloc_pages(alloc_count, PMM_ALLOC_FLAG_ZEROED, &list);
+    EXPECT_EQ(alloc_count, count, "pmm_alloc_pages zeroed count");
+
+    paddr_t pa;
+    page = pmm_alloc_page(PMM_ALLOC_FLAG_ZEROED, &pa);
+    EXPECT_NONNULL(page, "pmm_alloc_page zeroed");
+    if (page)
+        list_add_tail(&list, &page->free.node);
+
+    list_for_every_entry(&list, page, vm_page_t, free.node) {
+        EXPECT_EQ(VM_PAGE_STATE_ALLOC, page->state, "allocated page state");
+        auto data = static_cast<const uint8_t*>(paddr_to_physmap(vm_page_to_paddr(page)));
+        bool zero = true;
+        for (size_t i = 0; i < PAGE_SIZE; i++) {
+            if (data[i] != 0) {
+                zero = false;
+                break;
+            }
+        }
+        EXPECT_TRUE(zero, "page is zeroed");
+    }
+
+    pmm_free(&list);
+    END_TEST;
+}
+
 // Allocates too many pages and makes sure it fails nicely.
 static bool pmm_oversized_alloc_test(void* context) {
     BEGIN_TEST;
@@ -72,6 +141,42 @@ static bool pmm_oversized_alloc_test(void* context) {
     END_TEST;
 }
 
+// Allocates from each node and makes sure the pages come from where they
+// were asked for.
+static bool pmm_node_alloc_test(void* context) {
+    BEGIN_TEST;
+
+    EXPECT_GE(pmm_node_count(), 1u, "at least one node");
+    for (uint node = 0; node < pmm_node_count(); node++) {
+        list_node list = LIST_INITIAL_VALUE(list);
+        size_t count = pmm_alloc_pages_node(16, PMM_ALLOC_FLAG_NODE_STRICT, node, &list);
+        paddr_t pa;
+        vm_page_t* page = pmm_alloc_page_node(PMM_ALLOC_FLAG_NODE_STRICT | PMM_ALLOC_FLAG_ZEROED,
+                                              node, &pa);
+        if (page) {
+            EXPECT_EQ(pa, vm_page_to_paddr(page), "returned address");
+            list_add_tail(&list, &page->free.node);
+            count++;
+        }
+        EXPECT_EQ(count, list_length(&list), "list count");
+
+        list_for_every_entry(&list, page, vm_page_t, free.node) {
+            EXPECT_EQ(node, pmm_page_node(page), "page from the node asked for");
+        }
+        pmm_free(&list);
+    }
+
+    // the local node is the one the current cpu is on
+    paddr_t pa;
+    vm_page_t* page = pmm_alloc_page_node(PMM_ALLOC_FLAG_NODE_STRICT, PMM_NODE_LOCAL, &pa);
+    if (page) {
+        EXPECT_EQ(pmm_cpu_node(arch_curr_cpu_num()), pmm_page_node(page), "local page");
+        pmm_free_page(page);
+    }
+
+    END_TEST;
+}
+
 static uint32_t test_rand(uint32_t seed) {
     return (seed = seed * 1664525 + 1013904223);
 }
@@ -305,6 +410,69 @@ static bool vmaspace_alloc_smoke_test(void* context) {
     END_TEST;
 }
 
+// Fills a randomized region with single page mappings and checks that every
+// last gap can be found, and that freed space is found again.
+static bool vmaspace_fill_region_test(void* context) {
+    BEGIN_TEST;
+    static const size_t kPages = 64;
+    static const uint kVmarFlags = VMAR_FLAG_CAN_MAP_READ | VMAR_FLAG_CAN_MAP_WRITE;
+
+    auto aspace = VmAspace::Create(0, "test aspace3");
+    REQUIRE_NONNULL(aspace, "creating aspace\n");
+
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 2 * PAGE_SIZE, &vmo);
+    REQUIRE_EQ(ZX_OK, status, "vmobject creation\n");
+
+    fbl::RefPtr<VmAddressRegion> vmar;
+    status = aspace->RootVmar()->CreateSubVmar(0, kPages * PAGE_SIZE, 0, kVmarFlags, "test",
+                                               &vmar);
+    REQUIRE_EQ(ZX_OK, status, "creating vmar\n");
+
+    fbl::RefPtr<VmMapping> mappings[kPages];
+    for (size_t i = 0; i < kPages; i++) {
+        status = vmar->CreateVmMapping(0, PAGE_SIZE, 0, 0, vmo, 0, kArchRwFlags, "test",
+                                       &mappings[i]);
+        REQUIRE_EQ(ZX_OK, status, "mapping page\n");
+    }
+
+    fbl::RefPtr<VmMapping> extra;
+    status = vmar->CreateVmMapping(0, PAGE_SIZE, 0, 0, vmo, 0, kArchRwFlags, "test", &extra);
+    EXPECT_EQ(ZX_ERR_NO_MEMORY, status, "mapping into a full vmar\n");
+
+    // Sort the mappings by address, so neighbours can be freed.
+    for (size_t i = 0; i < kPages; i++) {
+        for (size_t j = i + 1; j < kPages; j++) {
+            if (mappings[j]->base() < mappings[i]->base()) {
+                mappings[i].swap(mappings[j]);
+            }
+        }
+    }
+
+    // Two separate free pages can't hold two pages...
+    const vaddr_t freed_base = mappings[10]->base();
+    EXPECT_EQ(ZX_OK, mappings[10]->Destroy(), "destroying mapping\n");
+    EXPECT_EQ(ZX_OK, mappings[20]->Destroy(), "destroying mapping\n");
+    status = vmar->CreateVmMapping(0, 2 * PAGE_SIZE, 0, 0, vmo, 0, kArchRwFlags, "test", &extra);
+    EXPECT_EQ(ZX_ERR_NO_MEMORY, status, "mapping into fragmented vmar\n");
+
+    // ...but two neighbouring ones can.
+    EXPECT_EQ(ZX_OK, mappings[11]->Destroy(), "destroying mapping\n");
+    status = vmar->CreateVmMapping(0, 2 * PAGE_SIZE, 0, 0, vmo, 0, kArchRwFlags, "test", &extra);
+    REQUIRE_EQ(ZX_OK, status, "mapping into freed space\n");
+    EXPECT_EQ(freed_base, extra->base(), "mapping placed in freed space\n");
+
+    // Shrinking a mapping in place frees its tail for others.
+    EXPECT_EQ(ZX_OK, extra->Unmap(extra->base() + PAGE_SIZE, PAGE_SIZE), "shrinking mapping\n");
+    status = vmar->CreateVmMapping(0, 2 * PAGE_SIZE, 0, 0, vmo, 0, kArchRwFlags, "test", &extra);
+    EXPECT_EQ(ZX_ERR_NO_MEMORY, status, "mapping into fragmented vmar\n");
+    status = vmar->CreateVmMapping(0, PAGE_SIZE, 0, 0, vmo, 0, kArchRwFlags, "test", &extra);
+    REQUIRE_EQ(ZX_OK, status, "mapping into freed space\n");
+
+    aspace->Destroy();
+    END_TEST;
+}
+
 // Doesn't do anything, just prints all aspaces.
 // Should be run after all other tests so that people can manually comb
 // through the output for leaked test aspaces.
@@ -489,6 +657,220 @@ static bool vmo_contiguous_commit_test(void* context) {
     END_TEST;
 }
 
+// Commits a large page vm object and checks that, memory permitting, whole
+// aligned runs are backed by contiguous aligned pages.
+static bool vmo_large_page_commit_test(void* context) {
+    BEGIN_TEST;
+    static const size_t alloc_size = LARGE_PAGE_SIZE * 2 + PAGE_SIZE;
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, VmObjectPaged::kLargePages,
+                                               alloc_size, &vmo);
+    REQUIRE_EQ(status, ZX_OK, "vmobject creation\n");
+    REQUIRE_TRUE(vmo, "vmobject creation\n");
+    EXPECT_TRUE(vmo->prefers_large_pages(), "large page vmo\n");
+
+    uint64_t committed;
+    auto ret = vmo->CommitRange(PAGE_SIZE, alloc_size - PAGE_SIZE, &committed);
+    EXPECT_EQ(ZX_OK, ret, "committing vm object\n");
+    EXPECT_EQ(alloc_size - PAGE_SIZE, committed, "committing vm object\n");
+
+    paddr_t pa;
+    {
+        fbl::AutoLock a(vmo->lock());
+        // the first run was only partially committed, so stays on small pages
+        EXPECT_EQ(ZX_ERR_NOT_FOUND,
+                  vmo->GetLargePageLocked(0, LARGE_PAGE_SIZE_SHIFT, 0, &pa),
+                  "partial run\n");
+        status = vmo->GetLargePageLocked(LARGE_PAGE_SIZE, LARGE_PAGE_SIZE_SHIFT, 0, &pa);
+    }
+    if (status == ZX_OK) {
+        EXPECT_TRUE(IS_ALIGNED(pa, LARGE_PAGE_SIZE), "large page alignment\n");
+
+        struct lookup_context {
+            paddr_t base;
+            bool contiguous;
+        } ctx = {pa, true};
+        auto lookup_fn = [](void* context, size_t offset, size_t index, paddr_t pa) {
+            auto ctx = static_cast<lookup_context*>(context);
+            if (pa != ctx->base + index * PAGE_SIZE)
+                ctx->contiguous = false;
+            return ZX_OK;
+        };
+        EXPECT_EQ(ZX_OK, vmo->Lookup(LARGE_PAGE_SIZE, LARGE_PAGE_SIZE, 0, lookup_fn, &ctx),
+                  "lookup\n");
+        EXPECT_TRUE(ctx.contiguous, "large page is contiguous\n");
+    } else {
+        // no free aligned run, the range is committed with small pages instead
+        EXPECT_EQ(ZX_ERR_NOT_FOUND, status, "small page fallback\n");
+    }
+    END_TEST;
+}
+
+// Writes |value| over page |index| of |vmo|.
+static bool fill_vmo_page(const fbl::RefPtr<VmObject>& vmo, uint64_t index, uint8_t value,
+                          uint8_t* buf) {
+    memset(buf, value, PAGE_SIZE);
+    size_t bytes_written;
+    return vmo->Write(buf, index * PAGE_SIZE, PAGE_SIZE, &bytes_written) == ZX_OK &&
+           bytes_written == PAGE_SIZE;
+}
+
+// Returns true if every byte of page |index| of |vmo| is |value|.
+static bool vmo_page_is(const fbl::RefPtr<VmObject>& vmo, uint64_t index, uint8_t value,
+                        uint8_t* buf) {
+    size_t bytes_read;
+    if (vmo->Read(buf, index * PAGE_SIZE, PAGE_SIZE, &bytes_read) != ZX_OK ||
+        bytes_read != PAGE_SIZE)
+        return false;
+    for (size_t i = 0; i < PAGE_SIZE; i++) {
+        if (buf[i] != value)
+            return false;
+    }
+    return true;
+}
+
+// Builds a root <- parent <- clone chain, drops the parent and checks that
+// collapsing it into the clone keeps what the clone sees.
+static bool vmo_cow_collapse_test(void* context) {
+    BEGIN_TEST;
+    static const size_t alloc_size = PAGE_SIZE * 4;
+
+    fbl::AllocChecker ac;
+    fbl::Array<uint8_t> buf(new (&ac) uint8_t[PAGE_SIZE], PAGE_SIZE);
+    REQUIRE_TRUE(ac.check(), "buffer allocation\n");
+
+    fbl::RefPtr<VmObject> root;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, alloc_size, &root);
+    REQUIRE_EQ(ZX_OK, status, "vmobject creation\n");
+    for (uint64_t i = 0; i < 4; i++) {
+        EXPECT_TRUE(fill_vmo_page(root, i, static_cast<uint8_t>('a' + i), buf.get()), "fill root\n");
+    }
+
+    // the parent starts out with a holder, as if it had a handle
+    fbl::RefPtr<VmObject> parent;
+    status = root->CloneCOW(0, alloc_size, false, &parent);
+    REQUIRE_EQ(ZX_OK, status, "clone root\n");
+    parent->AddHolder();
+    EXPECT_TRUE(fill_vmo_page(parent, 1, 'P', buf.get()), "fill parent\n");
+
+    // the clone looks one page into the parent and past its end
+    fbl::RefPtr<VmObject> clone;
+    status = parent->CloneCOW(PAGE_SIZE, alloc_size, false, &clone);
+    REQUIRE_EQ(ZX_OK, status, "clone parent\n");
+    EXPECT_TRUE(fill_vmo_page(clone, 1, 'C', buf.get()), "fill clone\n");
+    EXPECT_EQ(2u, clone->chain_depth(), "clone depth\n");
+
+    auto paged = static_cast<VmObjectPaged*>(clone.get());
+
+    // the parent is still held, so it has to stay
+    EXPECT_EQ(0u, paged->CollapseChain(), "held parent\n");
+    EXPECT_EQ(2u, clone->chain_depth(), "clone depth\n");
+
+    parent->RemoveHolder();
+    parent.reset();
+    EXPECT_EQ(1u, paged->CollapseChain(), "collapse parent\n");
+    EXPECT_EQ(1u, clone->chain_depth(), "collapsed depth\n");
+    EXPECT_EQ(root->user_id(), clone->parent_user_id(), "new parent\n");
+    EXPECT_EQ(1u, root->num_children(), "root children\n");
+
+    // the root has no parent to merge into
+    EXPECT_EQ(0u, paged->CollapseChain(), "root stays\n");
+
+    EXPECT_TRUE(vmo_page_is(clone, 0, 'P', buf.get()), "merged parent page\n");
+    EXPECT_TRUE(vmo_page_is(clone, 1, 'C', buf.get()), "own page\n");
+    EXPECT_TRUE(vmo_page_is(clone, 2, 'd', buf.get()), "root page\n");
+    // past the end of the old parent nothing shows through from the root
+    EXPECT_TRUE(vmo_page_is(clone, 3, 0, buf.get()), "beyond old parent\n");
+
+    // the clone is still copy on write against the root
+    EXPECT_TRUE(fill_vmo_page(clone, 2, 'W', buf.get()), "write clone\n");
+    EXPECT_TRUE(vmo_page_is(root, 3, 'd', buf.get()), "root unchanged\n");
+    END_TEST;
+}
+
+// Frees the committed pages of a vmo that stay zero.
+static bool vmo_free_zero_pages_test(void* context) {
+    BEGIN_TEST;
+    static const size_t alloc_size = PAGE_SIZE * 4;
+
+    fbl::AllocChecker ac;
+    fbl::Array<uint8_t> buf(new (&ac) uint8_t[PAGE_SIZE], PAGE_SIZE);
+    REQUIRE_TRUE(ac.check(), "buffer allocation\n");
+
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, alloc_size, &vmo);
+    REQUIRE_EQ(ZX_OK, status, "vmobject creation\n");
+    uint64_t committed;
+    status = vmo->CommitRange(0, alloc_size, &committed);
+    REQUIRE_EQ(ZX_OK, status, "committing vm object\n");
+    EXPECT_EQ(alloc_size, committed, "committing vm object\n");
+
+    EXPECT_TRUE(fill_vmo_page(vmo, 1, 'x', buf.get()), "fill page\n");
+    status = vmo->Pin(3 * PAGE_SIZE, PAGE_SIZE);
+    REQUIRE_EQ(ZX_OK, status, "pinning page\n");
+
+    // only the unpinned zero pages go
+    auto paged = static_cast<VmObjectPaged*>(vmo.get());
+    EXPECT_EQ(2u, paged->FreeZeroPages(), "zero pages freed\n");
+    EXPECT_EQ(2u, vmo->AllocatedPages(), "pages left\n");
+    EXPECT_TRUE(vmo_page_is(vmo, 0, 0, buf.get()), "freed page reads zero\n");
+    EXPECT_TRUE(vmo_page_is(vmo, 1, 'x', buf.get()), "written page kept\n");
+    EXPECT_EQ(0u, paged->FreeZeroPages(), "nothing left to free\n");
+
+    vmo->Unpin(3 * PAGE_SIZE, PAGE_SIZE);
+    EXPECT_EQ(1u, paged->FreeZeroPages(), "unpinned page freed\n");
+    END_TEST;
+}
+
+static paddr_t vmo_page_paddr(const fbl::RefPtr<VmObject>& vmo, uint64_t index) {
+    paddr_t pa = 0;
+    auto lookup_fn = [](void* context, size_t offset, size_t index, paddr_t pa) {
+        *static_cast<paddr_t*>(context) = pa;
+        return ZX_OK;
+    };
+    vmo->Lookup(index * PAGE_SIZE, PAGE_SIZE, 0, lookup_fn, &pa);
+    return pa;
+}
+
+// Moves the pages of a vmo out of a physical range for compaction.
+static bool vmo_evacuate_test(void* context) {
+    BEGIN_TEST;
+    static const size_t alloc_size = PAGE_SIZE * 2;
+
+    fbl::AllocChecker ac;
+    fbl::Array<uint8_t> buf(new (&ac) uint8_t[PAGE_SIZE], PAGE_SIZE);
+    REQUIRE_TRUE(ac.check(), "buffer allocation\n");
+
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, alloc_size, &vmo);
+    REQUIRE_EQ(ZX_OK, status, "vmobject creation\n");
+    EXPECT_TRUE(fill_vmo_page(vmo, 0, 'a', buf.get()), "fill page\n");
+    EXPECT_TRUE(fill_vmo_page(vmo, 1, 'b', buf.get()), "fill page\n");
+
+    const paddr_t old_pa = vmo_page_paddr(vmo, 0);
+    REQUIRE_NE(0u, old_pa, "page lookup\n");
+    EXPECT_TRUE(page_is_movable(paddr_to_vm_page(old_pa)), "page movable\n");
+
+    list_node vacated = LIST_INITIAL_VALUE(vacated);
+    EXPECT_EQ(1u, VmObjectPaged::EvacuateRange(old_pa, 1, &vacated), "page moved\n");
+    EXPECT_EQ(1u, list_length(&vacated), "page vacated\n");
+    EXPECT_EQ(paddr_to_vm_page(old_pa), list_peek_head_type(&vacated, vm_page_t, free.node),
+              "old page handed back\n");
+    pmm_free(&vacated);
+
+    EXPECT_NE(old_pa, vmo_page_paddr(vmo, 0), "page has a new address\n");
+    EXPECT_TRUE(vmo_page_is(vmo, 0, 'a', buf.get()), "contents moved\n");
+
+    // pinned pages stay put
+    const paddr_t pinned_pa = vmo_page_paddr(vmo, 1);
+    status = vmo->Pin(PAGE_SIZE, PAGE_SIZE);
+    REQUIRE_EQ(ZX_OK, status, "pinning page\n");
+    EXPECT_EQ(0u, VmObjectPaged::EvacuateRange(pinned_pa, 1, &vacated), "pinned page moved\n");
+    EXPECT_EQ(pinned_pa, vmo_page_paddr(vmo, 1), "pinned page address\n");
+    vmo->Unpin(PAGE_SIZE, PAGE_SIZE);
+    END_TEST;
+}
+
 // Creats a vm object, maps it, precommitted.
 static bool vmo_precommitted_map_test(void* context) {
     BEGIN_TEST;
@@ -755,6 +1137,60 @@ static bool vmo_read_write_smoke_test(void* context) {
     END_TEST;
 }
 
+// Checks the node policy of a paged object and where its pages end up.
+static bool vmo_node_policy_test(void* context) {
+    BEGIN_TEST;
+
+    static const size_t alloc_size = 16 * PAGE_SIZE;
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, alloc_size, &vmo);
+    REQUIRE_EQ(status, ZX_OK, "vmobject creation\n");
+
+    uint32_t policy, node;
+    EXPECT_EQ(ZX_OK, vmo->GetNodePolicy(&policy, &node), "get default policy");
+    EXPECT_EQ(PMM_NODE_POLICY_LOCAL, policy, "default policy");
+
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, vmo->SetNodePolicy(PMM_NODE_POLICY_BIND, pmm_node_count()),
+              "bind to a node that doesn't exist");
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, vmo->SetNodePolicy(PMM_NODE_POLICY_BIND + 1, 0),
+              "invalid policy");
+
+    const uint last = pmm_node_count() - 1;
+    EXPECT_EQ(ZX_OK, vmo->SetNodePolicy(PMM_NODE_POLICY_BIND, last), "bind");
+    EXPECT_EQ(ZX_OK, vmo->GetNodePolicy(&policy, &node), "get policy");
+    EXPECT_EQ(PMM_NODE_POLICY_BIND, policy, "policy");
+    EXPECT_EQ(last, node, "node");
+
+    uint64_t committed;
+    status = vmo->CommitRange(0, alloc_size, &committed);
+    EXPECT_EQ(ZX_OK, status, "committing vm object\n");
+    EXPECT_EQ(alloc_size, committed, "committed size");
+    auto check = [](void* context, size_t offset, size_t index, paddr_t pa) -> zx_status_t {
+        return pmm_page_node(paddr_to_vm_page(pa)) == *static_cast<uint*>(context)
+                   ? ZX_OK : ZX_ERR_BAD_STATE;
+    };
+    uint want = last;
+    EXPECT_EQ(ZX_OK, vmo->Lookup(0, alloc_size, 0, check, &want), "pages on the bound node");
+
+    // clones start out with the policy of their parent
+    fbl::RefPtr<VmObject> clone;
+    EXPECT_EQ(ZX_OK, vmo->CloneCOW(0, alloc_size, false, &clone), "clone");
+    if (clone) {
+        EXPECT_EQ(ZX_OK, clone->GetNodePolicy(&policy, &node), "get clone policy");
+        EXPECT_EQ(PMM_NODE_POLICY_BIND, policy, "clone policy");
+    }
+
+    // interleaved objects take their pages from every node
+    fbl::RefPtr<VmObject> interleaved;
+    status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, alloc_size, &interleaved);
+    REQUIRE_EQ(status, ZX_OK, "vmobject creation\n");
+    EXPECT_EQ(ZX_OK, interleaved->SetNodePolicy(PMM_NODE_POLICY_INTERLEAVE, 0), "interleave");
+    EXPECT_EQ(ZX_OK, interleaved->CommitRange(0, alloc_size, &committed), "commit");
+    EXPECT_EQ(alloc_size, committed, "committed size");
+
+    END_TEST;
+}
+
 static bool vmo_cache_test(void* context) {
     BEGIN_TEST;
 
@@ -970,7 +1406,10 @@ static bool arch_noncontiguous_map(void* context) {
 UNITTEST_START_TESTCASE(vm_tests)
 VM_UNITTEST(pmm_smoke_test)
 VM_UNITTEST(pmm_large_alloc_test)
+VM_UNITTEST(pmm_small_alloc_test)
+VM_UNITTEST(pmm_zeroed_alloc_test)
 VM_UNITTEST(pmm_oversized_alloc_test)
+VM_UNITTEST(pmm_node_alloc_test)
 VM_UNITTEST(vmm_alloc_smoke_test)
 VM_UNITTEST(vmm_alloc_contiguous_smoke_test)
 VM_UNITTEST(multiple_regions_test)
@@ -980,12 +1419,14 @@ VM_UNITTEST(vmm_alloc_contiguous_missing_flag_commit_fails)
 VM_UNITTEST(vmm_alloc_contiguous_zero_size_fails)
 VM_UNITTEST(vmaspace_create_smoke_test)
 VM_UNITTEST(vmaspace_alloc_smoke_test)
+VM_UNITTEST(vmaspace_fill_region_test)
 VM_UNITTEST(vmo_create_test)
 VM_UNITTEST(vmo_pin_test)
 VM_UNITTEST(vmo_multiple_pin_test)
 VM_UNITTEST(vmo_commit_test)
 VM_UNITTEST(vmo_odd_size_commit_test)
 VM_UNITTEST(vmo_contiguous_commit_test)
+VM_UNITTEST(vmo_large_page_commit_test)
 VM_UNITTEST(vmo_precommitted_map_test)
 VM_UNITTEST(vmo_demand_paged_map_test)
 VM_UNITTEST(vmo_dropped_ref_test)
@@ -993,7 +1434,11 @@ VM_UNITTEST(vmo_remap_test)
 VM_UNITTEST(vmo_double_remap_test)
 VM_UNITTEST(vmo_read_write_smoke_test)
 VM_UNITTEST(vmo_cache_test)
+VM_UNITTEST(vmo_node_policy_test)
 VM_UNITTEST(vmo_lookup_test)
+VM_UNITTEST(vmo_cow_collapse_test)
+VM_UNITTEST(vmo_free_zero_pages_test)
+VM_UNITTEST(vmo_evacuate_test)
 VM_UNITTEST(arch_noncontiguous_map)
 // Uncomment for debugging
 // VM_UNITTEST(dump_all_aspaces)  // Run last
@@ -41,6 +41,7 @@ LKNAME ?= zircon
 CLANG_TARGET_FUCHSIA ?= false
 USE_LINKER_GC ?= true
 HOST_USE_ASAN ?= false
+ENABLE_LOCK_PROFILING ?= false
 
 ifeq ($(call TOBOOL,$(ENABLE_ULIB_ONLY)),true)
 ENABLE_BUILD_SYSROOT := false
@@ -379,6 +380,12 @@ MDI_INCLUDES := system/public/zircon/mdi/zircon.mdi
 KERNEL_DEFINES += WITH_PANIC_BACKTRACE=1 WITH_FRAME_POINTERS=1
 KERNEL_COMPILEFLAGS += $(KEEP_FRAME_POINTER_COMPILEFLAGS)
 
+# record contention, wait and hold times of kernel mutexes and spin locks,
+# see "k lockprof" and ZX_INFO_LOCK_PROFILE
+ifeq ($(call TOBOOL,$(ENABLE_LOCK_PROFILING)),true)
+KERNEL_DEFINES += WITH_LOCK_PROFILING=1
+endif
+
 # userspace boot file system generated by the build system
 USER_BOOTDATA := $(BUILDDIR)/bootdata.bin
 USER_FS := $(BUILDDIR)/user.fs
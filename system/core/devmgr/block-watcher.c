@@ -11,7 +11,10 @@
 #include <gpt/gpt.h>
 #include <zircon/device/block.h>
 #include <zircon/device/device.h>
+#include <zircon/processargs.h>
 #include <zircon/syscalls.h>
+#include <zircon/syscalls/system.h>
+#include <fdio/limits.h>
 #include <fdio/watcher.h>
 
 #include "devmgr.h"
@@ -61,16 +64,37 @@ void launch_blobstore_init() {
     zx_handle_close(proc);
 }
 
+// Launches a filesystem which caches vnodes, adding the memory pressure
+// events to its handles so that it can shrink its caches.
+static zx_status_t launch_caching_fs(const char* name, int argc, const char** argv,
+                                     zx_handle_t* hnd, uint32_t* ids, size_t len) {
+    zx_handle_t handles[FDIO_MAX_HANDLES * 2 + 2];
+    uint32_t types[FDIO_MAX_HANDLES * 2 + 2];
+    if (len > FDIO_MAX_HANDLES * 2) {
+        return devmgr_launch(job, name, argc, argv, NULL, -1, hnd, ids, len, NULL);
+    }
+    memcpy(handles, hnd, len * sizeof(zx_handle_t));
+    memcpy(types, ids, len * sizeof(uint32_t));
+    size_t n = len;
+    if ((handles[n] = memory_pressure_event_clone(ZX_SYSTEM_EVENT_MEMORY_PRESSURE_WARNING)) !=
+        ZX_HANDLE_INVALID) {
+        types[n++] = PA_HND(PA_USER1, 0);
+    }
+    if ((handles[n] = memory_pressure_event_clone(ZX_SYSTEM_EVENT_MEMORY_PRESSURE_CRITICAL)) !=
+        ZX_HANDLE_INVALID) {
+        types[n++] = PA_HND(PA_USER1, 1);
+    }
+    return devmgr_launch(job, name, argc, argv, NULL, -1, handles, types, n, NULL);
+}
+
 static zx_status_t launch_blobstore(int argc, const char** argv, zx_handle_t* hnd,
                                     uint32_t* ids, size_t len) {
-    return devmgr_launch(job, "blobstore:/blobstore", argc, argv, NULL, -1,
-                         hnd, ids, len, NULL);
+    return launch_caching_fs("blobstore:/blobstore", argc, argv, hnd, ids, len);
 }
 
 static zx_status_t launch_minfs(int argc, const char** argv, zx_handle_t* hnd,
                                 uint32_t* ids, size_t len) {
-    return devmgr_launch(job, "minfs:/data", argc, argv, NULL, -1,
-                         hnd, ids, len, NULL);
+    return launch_caching_fs("minfs:/data", argc, argv, hnd, ids, len);
 }
 
 static zx_status_t launch_fat(int argc, const char** argv, zx_handle_t* hnd,
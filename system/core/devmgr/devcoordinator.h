@@ -63,6 +63,10 @@ struct dc_devhost {
 
 #define DEV_HOST_DYING 1
 #define DEV_HOST_SUSPEND 2
+// the process is still being started on a launcher thread
+#define DEV_HOST_LAUNCHING 4
+// released while launching; freed once the launch completes
+#define DEV_HOST_RELEASED 8
 
 struct dc_device {
     zx_handle_t hrpc;
@@ -101,6 +105,10 @@ struct dc_device {
     // listnode for this device in the all devices list
     list_node_t anode;
 
+    // time spent, and bind programs run, looking for drivers for this device
+    zx_duration_t bind_time;
+    uint32_t bind_evals;
+
     zx_device_prop_t props[];
 };
 
@@ -137,6 +145,9 @@ struct dc_device {
 // return to this state once made visible.
 #define DEV_CTX_INVISIBLE     0x80
 
+// At most this many property requirements are kept per bind program.
+#define DC_BIND_MAX_REQS 4
+
 struct dc_driver {
     const char* name;
     const zx_bind_inst_t* binding;
@@ -144,8 +155,29 @@ struct dc_driver {
     uint32_t flags;
     struct list_node node;
     const char* libname;
+
+    // Worked out from the bind program by dc_driver_index_add().
+    // A device can only match if its BIND_PROTOCOL is |protocol_id|
+    // (if |has_protocol|) and it has each of |reqs| exactly.  All zero,
+    // as for a driver not yet indexed, means there are no requirements.
+    bool has_protocol;
+    uint32_t protocol_id;
+    uint32_t req_count;
+    zx_device_prop_t reqs[DC_BIND_MAX_REQS];
+
+    // position in the driver list, and node in the bind index
+    int64_t rank;
+    struct list_node inode;
 };
 
+// Walks the indexed drivers that might bind to one device.
+typedef struct dc_driver_iter {
+    uint32_t protocol_id;
+    list_node_t* bucket;
+    driver_t* next_bucket;
+    driver_t* next_any;
+} dc_driver_iter_t;
+
 #define DRIVER_NAME_LEN_MAX 64
 
 zx_status_t devfs_publish(device_t* parent, device_t* dev);
@@ -160,10 +192,36 @@ void dc_driver_added(driver_t* drv, const char* version);
 void load_driver(const char* path);
 void find_loadable_drivers(const char* path);
 
+// Boot-time tracing of the coordinator's steps, as ktrace probes named
+// "devmgr:<step>".  Each step writes a DC_TRACE_BEGIN record and then a
+// DC_TRACE_END record whose argument is the step's result.
+// May be called from any thread.
+#define DC_TRACE_SCAN 0
+#define DC_TRACE_LAUNCH 1
+#define DC_TRACE_BIND 2
+#define DC_TRACE_COUNT 3
+
+#define DC_TRACE_BEGIN 1
+#define DC_TRACE_END 2
+
+void dc_trace(uint32_t probe, uint32_t phase, uint32_t arg);
+
 bool dc_is_bindable(driver_t* drv, uint32_t protocol_id,
                     zx_device_prop_t* props, size_t prop_count,
                     bool autobind);
 
+// Index |drv| for binding, as the first (|at_head|) or last driver in
+// priority order.  Every driver on the coordinator's driver list is
+// indexed exactly once.
+void dc_driver_index_add(driver_t* drv, bool at_head);
+
+// Return the first driver, in priority order, whose bind program might
+// match a device with these properties; continue with dc_driver_iter_next.
+// Drivers that cannot match are skipped without running their programs.
+driver_t* dc_driver_iter_first(dc_driver_iter_t* it, uint32_t protocol_id,
+                               const zx_device_prop_t* props, size_t prop_count);
+driver_t* dc_driver_iter_next(dc_driver_iter_t* it);
+
 #define DC_MAX_DATA 4096
 
 // The first two fields of devcoordinator messages align
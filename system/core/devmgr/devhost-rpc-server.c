@@ -66,6 +66,7 @@ devhost_iostate_t* create_devhost_iostate(zx_device_t* dev) {
         return NULL;
     }
     ios->dev = dev;
+    mtx_init(&ios->lock, mtx_plain);
     return ios;
 }
 
@@ -494,14 +494,111 @@ static zx_status_t dh_handle_dc_rpc(port_handler_t* ph, zx_signals_t signals, ui
     return ZX_OK;
 }
 
+// Connections served by this devhost, keyed by the koid of their
+// client end.  A driver in this devhost that talks to one of them
+// through fdio is served by dh_local_txn() on its own thread, rather
+// than by a channel round trip through dh_port.
+#define LOCAL_BUCKETS 64
+
+static mtx_t local_lock = MTX_INIT;
+static list_node_t local_ios[LOCAL_BUCKETS];
+
+static list_node_t* local_bucket(zx_koid_t koid) {
+    return &local_ios[koid % LOCAL_BUCKETS];
+}
+
+static void local_ios_add(iostate_t* ios) {
+    zx_info_handle_basic_t info;
+    if (zx_object_get_info(ios->ph.handle, ZX_INFO_HANDLE_BASIC,
+                           &info, sizeof(info), NULL, NULL) != ZX_OK) {
+        return;
+    }
+    ios->peer_koid = info.related_koid;
+    mtx_lock(&local_lock);
+    list_add_tail(local_bucket(ios->peer_koid), &ios->lnode);
+    mtx_unlock(&local_lock);
+}
+
+// Once this returns no direct call can be using |ios|.
+static void local_ios_remove(iostate_t* ios) {
+    mtx_lock(&local_lock);
+    if (list_in_list(&ios->lnode)) {
+        list_delete(&ios->lnode);
+    }
+    mtx_unlock(&local_lock);
+    mtx_lock(&ios->lock);
+    ios->dead = true;
+    mtx_unlock(&ios->lock);
+}
+
+static bool is_reply_valid(zxrio_msg_t* msg) {
+    return (msg->datalen <= FDIO_CHUNK_SIZE) && (msg->hcount <= FDIO_MAX_HANDLES);
+}
+
+// Handles a transaction on client channel |h| in-process, when this
+// devhost serves the other end.  This has the same effect as
+// zxrio_handle_rpc() on the server end followed by reading the reply.
+static zx_status_t dh_local_txn(zx_handle_t h, zxrio_msg_t* msg) {
+    zx_info_handle_basic_t info;
+    if (zx_object_get_info(h, ZX_INFO_HANDLE_BASIC,
+                           &info, sizeof(info), NULL, NULL) != ZX_OK) {
+        return ZX_ERR_NEXT;
+    }
+
+    iostate_t* ios = NULL;
+    iostate_t* entry;
+    mtx_lock(&local_lock);
+    list_for_every_entry(local_bucket(info.koid), entry, iostate_t, lnode) {
+        if (entry->peer_koid == info.koid) {
+            ios = entry;
+            mtx_lock(&ios->lock);
+            break;
+        }
+    }
+    mtx_unlock(&local_lock);
+    if (ios == NULL) {
+        return ZX_ERR_NEXT;
+    }
+
+    // Requests already queued on the channel go first, and a connection
+    // that is shutting down answers through the channel as it would have.
+    zx_signals_t pending;
+    if (ios->dead ||
+        (zx_object_wait_one(ios->ph.handle, ZX_CHANNEL_READABLE,
+                            0, &pending) != ZX_ERR_TIMED_OUT)) {
+        mtx_unlock(&ios->lock);
+        return ZX_ERR_NEXT;
+    }
+
+    msg->arg = devhost_rio_handler(msg, ios);
+    mtx_unlock(&ios->lock);
+
+    if (msg->arg == ERR_DISPATCHER_INDIRECT) {
+        // only OPEN and CLONE reply indirectly, and those are never local
+        msg->arg = ZX_ERR_INTERNAL;
+    }
+    if ((msg->arg < 0) || !is_reply_valid(msg)) {
+        for (uint32_t n = 0; n < msg->hcount; n++) {
+            zx_handle_close(msg->handle[n]);
+        }
+        msg->datalen = 0;
+        msg->hcount = 0;
+        msg->arg = (msg->arg < 0) ? msg->arg : ZX_ERR_INTERNAL;
+    }
+    msg->op = ZXRIO_STATUS;
+    return ZX_OK;
+}
+
 // handles remoteio rpc
 static zx_status_t dh_handle_rio_rpc(port_handler_t* ph, zx_signals_t signals, uint32_t evt) {
     iostate_t* ios = ios_from_ph(ph);
 
     zx_status_t r;
     zxrio_msg_t msg;
+    mtx_lock(&ios->lock);
     if (signals & ZX_CHANNEL_READABLE) {
         if ((r = zxrio_handle_rpc(ph->handle, &msg, devhost_rio_handler, ios)) == ZX_OK) {
+            mtx_unlock(&ios->lock);
             return ZX_OK;
         }
     } else if (signals & ZX_CHANNEL_PEER_CLOSED) {
@@ -511,6 +608,8 @@ static zx_status_t dh_handle_rio_rpc(port_handler_t* ph, zx_signals_t signals, u
         printf("dh_handle_rio_rpc: invalid signals %x\n", signals);
         exit(0);
     }
+    mtx_unlock(&ios->lock);
+    local_ios_remove(ios);
 
     // We arrive here if handle_rpc was a clean close (ERR_DISPATCHER_DONE),
     // or close-due-to-error (non-ZX_OK), or if the channel was closed
@@ -854,7 +953,13 @@ zx_status_t devhost_start_iostate(devhost_iostate_t* ios, zx_handle_t h) {
     ios->ph.handle = h;
     ios->ph.waitfor = ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED;
     ios->ph.func = dh_handle_rio_rpc;
-    return port_wait(&dh_port, &ios->ph);
+    local_ios_add(ios);
+
+    zx_status_t r;
+    if ((r = port_wait(&dh_port, &ios->ph)) < 0) {
+        local_ios_remove(ios);
+    }
+    return r;
 }
 
 __EXPORT int device_host_main(int argc, char** argv) {
@@ -873,6 +978,11 @@ __EXPORT int device_host_main(int argc, char** argv) {
         log(ERROR, "devhost: no root resource handle!\n");
     }
 
+    for (size_t n = 0; n < LOCAL_BUCKETS; n++) {
+        list_initialize(&local_ios[n]);
+    }
+    zxrio_set_local_txn(dh_local_txn);
+
     zx_status_t r;
     if ((r = port_init(&dh_port)) < 0) {
         log(ERROR, "devhost: could not create port: %d\n", r);
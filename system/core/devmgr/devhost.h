@@ -68,6 +68,12 @@ typedef struct devhost_iostate {
     uint32_t flags;
     bool dead;
     port_handler_t ph;
+
+    // Serializes requests from the channel with direct calls from
+    // drivers in this devhost (see devhost_start_iostate()).
+    mtx_t lock;
+    zx_koid_t peer_koid;
+    list_node_t lnode;
 } devhost_iostate_t;
 
 devhost_iostate_t* create_devhost_iostate(zx_device_t* dev);
@@ -8,6 +8,8 @@
 
 #include <stdio.h>
 
+#include <zircon/listnode.h>
+
 #include "devcoordinator.h"
 
 typedef struct {
@@ -138,6 +140,133 @@ next_instruction:
     return false;
 }
 
+// Drivers whose bind programs require a protocol are indexed in one of
+// these buckets, by protocol; the rest are in list_index_any.  Each list
+// is kept in priority (rank) order.
+#define INDEX_BUCKETS 64
+
+static bool index_ready;
+static list_node_t index_buckets[INDEX_BUCKETS];
+static list_node_t list_index_any = LIST_INITIAL_VALUE(list_index_any);
+static int64_t rank_first;
+static int64_t rank_last;
+
+static list_node_t* index_bucket(uint32_t protocol_id) {
+    return &index_buckets[(protocol_id * 2654435761u) >> 26];
+}
+
+// Work out what a device must look like for |drv|'s bind program to match.
+//
+// The leading run of conditional aborts is executed for every device,
+// and a GOTO can only jump forward, so a device that fails any of those
+// tests can never match.  Each "abort unless prop == value" therefore
+// becomes a requirement.  Anything after the run is left to is_bindable().
+static void analyze_binding(driver_t* drv) {
+    drv->has_protocol = false;
+    drv->protocol_id = 0;
+    drv->req_count = 0;
+
+    const zx_bind_inst_t* ip = drv->binding;
+    const zx_bind_inst_t* end = ip + (drv->binding_size / sizeof(zx_bind_inst_t));
+    for (; ip < end; ip++) {
+        uint32_t inst = ip->op;
+        if ((BINDINST_OP(inst) != OP_ABORT) || (BINDINST_CC(inst) == COND_AL)) {
+            break;
+        }
+        uint32_t pid = BINDINST_PB(inst);
+        if ((BINDINST_CC(inst) != COND_NE) || (pid == BIND_FLAGS)) {
+            continue;
+        }
+        if ((pid == BIND_PROTOCOL) && !drv->has_protocol) {
+            drv->has_protocol = true;
+            drv->protocol_id = ip->arg;
+        } else if (drv->req_count < DC_BIND_MAX_REQS) {
+            drv->reqs[drv->req_count].id = pid;
+            drv->reqs[drv->req_count].reserved = 0;
+            drv->reqs[drv->req_count].value = ip->arg;
+            drv->req_count++;
+        }
+    }
+}
+
+// Cheap check of the requirements found by analyze_binding().
+static bool may_bind(driver_t* drv, bpctx_t* ctx) {
+    if (drv->has_protocol &&
+        (dev_get_prop(ctx, BIND_PROTOCOL) != drv->protocol_id)) {
+        return false;
+    }
+    for (uint32_t n = 0; n < drv->req_count; n++) {
+        if (dev_get_prop(ctx, drv->reqs[n].id) != drv->reqs[n].value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void dc_driver_index_add(driver_t* drv, bool at_head) {
+    if (!index_ready) {
+        for (size_t n = 0; n < INDEX_BUCKETS; n++) {
+            list_initialize(&index_buckets[n]);
+        }
+        index_ready = true;
+    }
+    analyze_binding(drv);
+
+    list_node_t* list = drv->has_protocol ? index_bucket(drv->protocol_id) : &list_index_any;
+    if (at_head) {
+        drv->rank = --rank_first;
+        list_add_head(list, &drv->inode);
+    } else {
+        drv->rank = rank_last++;
+        list_add_tail(list, &drv->inode);
+    }
+}
+
+static driver_t* bucket_next(dc_driver_iter_t* it, list_node_t* node) {
+    driver_t* drv;
+    while ((drv = list_next_type(it->bucket, node, driver_t, inode)) != NULL) {
+        if (drv->protocol_id == it->protocol_id) {
+            return drv;
+        }
+        node = &drv->inode;
+    }
+    return NULL;
+}
+
+driver_t* dc_driver_iter_first(dc_driver_iter_t* it, uint32_t protocol_id,
+                               const zx_device_prop_t* props, size_t prop_count) {
+    // a BIND_PROTOCOL property overrides the device's protocol
+    bpctx_t ctx = {
+        .props = props,
+        .end = props + prop_count,
+        .protocol_id = protocol_id,
+    };
+    it->protocol_id = dev_get_prop(&ctx, BIND_PROTOCOL);
+    if (!index_ready) {
+        it->bucket = NULL;
+        it->next_bucket = NULL;
+        it->next_any = list_peek_head_type(&list_index_any, driver_t, inode);
+    } else {
+        it->bucket = index_bucket(it->protocol_id);
+        it->next_bucket = bucket_next(it, it->bucket);
+        it->next_any = list_peek_head_type(&list_index_any, driver_t, inode);
+    }
+    return dc_driver_iter_next(it);
+}
+
+driver_t* dc_driver_iter_next(dc_driver_iter_t* it) {
+    // merge the two rank-ordered lists
+    driver_t* drv;
+    if ((it->next_bucket != NULL) &&
+        ((it->next_any == NULL) || (it->next_bucket->rank < it->next_any->rank))) {
+        drv = it->next_bucket;
+        it->next_bucket = bucket_next(it, &drv->inode);
+    } else if ((drv = it->next_any) != NULL) {
+        it->next_any = list_next_type(&list_index_any, &drv->inode, driver_t, inode);
+    }
+    return drv;
+}
+
 bool dc_is_bindable(driver_t* drv, uint32_t protocol_id,
                     zx_device_prop_t* props, size_t prop_count,
                     bool autobind) {
@@ -152,5 +281,5 @@ bool dc_is_bindable(driver_t* drv, uint32_t protocol_id,
     ctx.binding_size = drv->binding_size;
     ctx.name = drv->name;
     ctx.autobind = autobind ? 1 : 0;
-    return is_bindable(&ctx);
+    return may_bind(drv, &ctx) && is_bindable(&ctx);
 }
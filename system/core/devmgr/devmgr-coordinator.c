@@ -4,13 +4,17 @@
 
 #include <ctype.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <threads.h>
 
 #include <ddk/driver.h>
 #include <driver-info/driver-info.h>
 #include <launchpad/launchpad.h>
+#include <launchpad/vmo.h>
 #include <zircon/assert.h>
 #include <zircon/ktrace.h>
 #include <zircon/processargs.h>
@@ -235,14 +239,12 @@ static zx_status_t libname_to_vmo(const char* libname, zx_handle_t* out) {
         log(ERROR, "devcoord: cannot find driver '%s'\n", libname);
         return ZX_ERR_NOT_FOUND;
     }
-    int fd = open(libname, O_RDONLY);
-    if (fd < 0) {
+    // Drivers bound to many devices are read only once; later binds get
+    // a copy-on-write clone from launchpad's image cache.
+    zx_status_t r = launchpad_vmo_from_file(libname, out);
+    if (r == ZX_ERR_IO) {
         log(ERROR, "devcoord: cannot open driver '%s'\n", libname);
-        return ZX_ERR_IO;
-    }
-    zx_status_t r = fdio_get_vmo(fd, out);
-    close(fd);
-    if (r < 0) {
+    } else if (r < 0) {
         log(ERROR, "devcoord: cannot get driver vmo '%s'\n", libname);
     }
     return r;
@@ -269,7 +271,8 @@ static void dc_dump_device(device_t* dev, size_t indent) {
     zx_koid_t pid = dev->host ? dev->host->koid : 0;
     char extra[256];
     if (log_flags & LOG_DEVLC) {
-        snprintf(extra, sizeof(extra), " dev=%p ref=%d", dev, dev->refcount);
+        snprintf(extra, sizeof(extra), " dev=%p ref=%d bind=%" PRIu64 "us/%u",
+                 dev, dev->refcount, dev->bind_time / ZX_USEC(1), dev->bind_evals);
     } else {
         extra[0] = 0;
     }
@@ -534,10 +537,11 @@ static void dc_watch(zx_handle_t h) {
     }
 }
 
-static zx_status_t dc_launch_devhost(devhost_t* host,
-                                     const char* name, zx_handle_t hrpc) {
-    const char* devhost_bin = get_devhost_bin();
-
+// Runs on a launcher thread, so it must only use state that the
+// coordinator never changes after startup.
+static zx_status_t dc_launch_devhost(const char* devhost_bin, const char* name,
+                                     zx_handle_t hrpc, zx_handle_t* proc,
+                                     const char** errmsg) {
     launchpad_t* lp;
     launchpad_create_with_jobs(devhost_job, 0, name, &lp);
     launchpad_load_from_file(lp, devhost_bin);
@@ -571,21 +575,100 @@ static zx_status_t dc_launch_devhost(devhost_t* host,
     launchpad_add_handle(lp, get_sysinfo_job_root(),
                          PA_HND(PA_USER0, ID_HJOBROOT));
 
+    return launchpad_go(lp, proc, errmsg);
+}
+
+// Devhosts are started by a small pool of launcher threads.  Loading
+// and starting a devhost takes a while, and nothing the coordinator
+// does next depends on the process existing: messages for the new
+// devhost simply wait in its channel until it starts reading.
+#define DC_LAUNCH_THREADS 4
+
+typedef struct dc_launch {
+    // completion, queued on dc_port by the launcher thread
+    port_handler_t ph;
+    list_node_t node;
+    devhost_t* host;
+    const char* devhost_bin;
+    zx_handle_t hrpc;
+    zx_handle_t proc;
+    zx_status_t status;
     const char* errmsg;
-    zx_status_t status = launchpad_go(lp, &host->proc, &errmsg);
-    if (status < 0) {
+    char name[32];
+} dc_launch_t;
+
+static mtx_t dc_launch_lock = MTX_INIT;
+static cnd_t dc_launch_cond;
+static list_node_t dc_launch_queue = LIST_INITIAL_VALUE(dc_launch_queue);
+
+static int dc_launch_thread(void* arg) {
+    for (;;) {
+        mtx_lock(&dc_launch_lock);
+        dc_launch_t* launch;
+        while ((launch = list_remove_head_type(&dc_launch_queue,
+                                               dc_launch_t, node)) == NULL) {
+            cnd_wait(&dc_launch_cond, &dc_launch_lock);
+        }
+        mtx_unlock(&dc_launch_lock);
+
+        dc_trace(DC_TRACE_LAUNCH, DC_TRACE_BEGIN, 0);
+        launch->status = dc_launch_devhost(launch->devhost_bin, launch->name,
+                                           launch->hrpc, &launch->proc,
+                                           &launch->errmsg);
+        dc_trace(DC_TRACE_LAUNCH, DC_TRACE_END, launch->status);
+        port_queue(&dc_port, &launch->ph, 0);
+    }
+    return 0;
+}
+
+static void dc_free_devhost(devhost_t* dh) {
+    zx_task_kill(dh->proc);
+    zx_handle_close(dh->proc);
+    free(dh);
+}
+
+// Runs on the coordinator thread once a launcher thread is done.
+static zx_status_t dc_launch_done(port_handler_t* ph, zx_signals_t signals, uint32_t evt) {
+    dc_launch_t* launch = containerof(ph, dc_launch_t, ph);
+    devhost_t* dh = launch->host;
+    dh->flags &= ~DEV_HOST_LAUNCHING;
+
+    if (launch->status < 0) {
+        // The devhost's end of the rpc channel is gone, so its devices
+        // will see their peer close and be removed.
         log(ERROR, "devcoord: launch devhost '%s': failed: %d: %s\n",
-            name, status, errmsg);
-        return status;
+            launch->name, launch->status, launch->errmsg);
+    } else {
+        dh->proc = launch->proc;
+        zx_info_handle_basic_t info;
+        if (zx_object_get_info(dh->proc, ZX_INFO_HANDLE_BASIC, &info,
+                               sizeof(info), NULL, NULL) == ZX_OK) {
+            dh->koid = info.koid;
+        }
+        log(INFO, "devcoord: launch devhost '%s': pid=%zu\n",
+            launch->name, dh->koid);
     }
-    zx_info_handle_basic_t info;
-    if (zx_object_get_info(host->proc, ZX_INFO_HANDLE_BASIC, &info,
-                           sizeof(info), NULL, NULL) == ZX_OK) {
-        host->koid = info.koid;
+    if (dh->flags & DEV_HOST_RELEASED) {
+        dc_free_devhost(dh);
     }
-    log(INFO, "devcoord: launch devhost '%s': pid=%zu\n",
-        name, host->koid);
+    free(launch);
+    return ZX_OK;
+}
 
+static zx_status_t dc_start_launchers(void) {
+    cnd_init(&dc_launch_cond);
+    for (int i = 0; i < DC_LAUNCH_THREADS; i++) {
+        thrd_t t;
+        if (thrd_create_with_name(&t, dc_launch_thread, NULL,
+                                  "devmgr-launcher") != thrd_success) {
+            // one is enough to make progress
+            if (i == 0) {
+                return ZX_ERR_NO_RESOURCES;
+            }
+            break;
+        }
+        thrd_detach(t);
+    }
     return ZX_OK;
 }
 
@@ -595,20 +678,31 @@ static zx_status_t dc_new_devhost(const char* name, devhost_t* parent,
     if (dh == NULL) {
         return ZX_ERR_NO_MEMORY;
     }
-
-    zx_handle_t hrpc;
-    zx_status_t r;
-    if ((r = zx_channel_create(0, &hrpc, &dh->hrpc)) < 0) {
+    dc_launch_t* launch = calloc(1, sizeof(dc_launch_t));
+    if (launch == NULL) {
         free(dh);
-        return r;
+        return ZX_ERR_NO_MEMORY;
     }
 
-    if ((r = dc_launch_devhost(dh, name, hrpc)) < 0) {
-        zx_handle_close(dh->hrpc);
+    zx_status_t r;
+    if ((r = zx_channel_create(0, &launch->hrpc, &dh->hrpc)) < 0) {
+        free(launch);
         free(dh);
         return r;
     }
 
+    launch->ph.func = dc_launch_done;
+    launch->host = dh;
+    // chosen here, since dc_asan_drivers belongs to the coordinator thread
+    launch->devhost_bin = get_devhost_bin();
+    snprintf(launch->name, sizeof(launch->name), "%s", name);
+    dh->flags |= DEV_HOST_LAUNCHING;
+
+    mtx_lock(&dc_launch_lock);
+    list_add_tail(&dc_launch_queue, &launch->node);
+    cnd_signal(&dc_launch_cond);
+    mtx_unlock(&dc_launch_lock);
+
     list_initialize(&dh->devices);
     list_initialize(&dh->children);
 
@@ -639,9 +733,12 @@ static void dc_release_devhost(devhost_t* dh) {
     }
     list_delete(&dh->anode);
     zx_handle_close(dh->hrpc);
-    zx_task_kill(dh->proc);
-    zx_handle_close(dh->proc);
-    free(dh);
+    if (dh->flags & DEV_HOST_LAUNCHING) {
+        // dc_launch_done() still needs it, and frees it
+        dh->flags |= DEV_HOST_RELEASED;
+        return;
+    }
+    dc_free_devhost(dh);
 }
 
 // called when device children or proxys are removed
@@ -1425,7 +1522,16 @@ static zx_status_t dc_prepare_proxy(device_t* dev) {
     return ZX_OK;
 }
 
+static zx_status_t dc_try_bind(driver_t* drv, device_t* dev);
+
 static zx_status_t dc_attempt_bind(driver_t* drv, device_t* dev) {
+    dc_trace(DC_TRACE_BIND, DC_TRACE_BEGIN, 0);
+    zx_status_t r = dc_try_bind(drv, dev);
+    dc_trace(DC_TRACE_BIND, DC_TRACE_END, r);
+    return r;
+}
+
+static zx_status_t dc_try_bind(driver_t* drv, device_t* dev) {
     // cannot bind driver to already bound device
     if ((dev->flags & DEV_CTX_BOUND) && (!(dev->flags & DEV_CTX_MULTI_BIND))) {
         return ZX_ERR_BAD_STATE;
@@ -1453,9 +1559,14 @@ static zx_status_t dc_attempt_bind(driver_t* drv, device_t* dev) {
 }
 
 static void dc_handle_new_device(device_t* dev) {
-    driver_t* drv;
+    zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
 
-    list_for_every_entry(&list_drivers, drv, driver_t, node) {
+    // Only drivers the bind index can't rule out run their bind programs.
+    dc_driver_iter_t it;
+    driver_t* drv;
+    for (drv = dc_driver_iter_first(&it, dev->protocol_id, dev->props, dev->prop_count);
+         drv != NULL; drv = dc_driver_iter_next(&it)) {
+        dev->bind_evals++;
         if (dc_is_bindable(drv, dev->protocol_id,
                            dev->props, dev->prop_count, true)) {
             log(SPEW, "devcoord: drv='%s' bindable to dev='%s'\n",
@@ -1467,6 +1578,18 @@ static void dc_handle_new_device(device_t* dev) {
             }
         }
     }
+
+    dev->bind_time += zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+}
+
+// Add |drv| to the driver list and the bind index.
+static void dc_add_driver(driver_t* drv, bool at_head) {
+    if (at_head) {
+        list_add_head(&list_drivers, &drv->node);
+    } else {
+        list_add_tail(&list_drivers, &drv->node);
+    }
+    dc_driver_index_add(drv, at_head);
 }
 
 static void dc_suspend_fallback(uint32_t flags) {
@@ -1685,6 +1808,30 @@ static bool is_root_driver(driver_t* drv) {
 
 static work_t new_driver_work;
 
+// ktrace probe ids for the DC_TRACE_* steps, or 0 if not registered
+static uint32_t dc_trace_probes[DC_TRACE_COUNT];
+
+static void dc_trace_init(void) {
+    static const char* const names[DC_TRACE_COUNT] = {
+        [DC_TRACE_SCAN] = "devmgr:scan",
+        [DC_TRACE_LAUNCH] = "devmgr:launch",
+        [DC_TRACE_BIND] = "devmgr:bind",
+    };
+    for (uint32_t i = 0; i < DC_TRACE_COUNT; i++) {
+        char name[ZX_MAX_NAME_LEN] = {};
+        strncpy(name, names[i], sizeof(name) - 1);
+        zx_status_t r = zx_ktrace_control(get_root_resource(),
+                                          KTRACE_ACTION_NEW_PROBE, 0, name);
+        dc_trace_probes[i] = (r > 0) ? (uint32_t)r : 0;
+    }
+}
+
+void dc_trace(uint32_t probe, uint32_t phase, uint32_t arg) {
+    if (dc_trace_probes[probe] != 0) {
+        zx_ktrace_write(get_root_resource(), dc_trace_probes[probe], phase, arg);
+    }
+}
+
 // dc_driver_added is called from driver enumeration either before
 // or after the devcoordinator starts running.  If after, it's added
 // to the list of new drivers and work is queued to process it.  If
@@ -1710,9 +1857,9 @@ void dc_driver_added(driver_t* drv, const char* version) {
     } else if (version[0] == '!') {
         // debugging / development hack
         // prioritize drivers with version "!..." over others
-        list_add_head(&list_drivers, &drv->node);
+        dc_add_driver(drv, true);
     } else {
-        list_add_tail(&list_drivers, &drv->node);
+        dc_add_driver(drv, false);
     }
 }
 
@@ -1734,6 +1881,10 @@ device_t* coordinator_init(zx_handle_t root_job) {
     zx_object_set_property(devhost_job, ZX_PROP_NAME, "zircon-drivers", 15);
 
     port_init(&dc_port);
+    dc_trace_init();
+    if (dc_start_launchers() < 0) {
+        log(ERROR, "devcoord: cannot start devhost launchers\n");
+    }
 
     return &root_device;
 }
@@ -1756,8 +1907,12 @@ void dc_bind_driver(driver_t* drv) {
                 // if device is already bound or being destroyed, skip it
                 continue;
             }
-            if (dc_is_bindable(drv, dev->protocol_id,
-                               dev->props, dev->prop_count, true)) {
+            zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+            dev->bind_evals++;
+            bool bindable = dc_is_bindable(drv, dev->protocol_id,
+                                           dev->props, dev->prop_count, true);
+            dev->bind_time += zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+            if (bindable) {
                 log(INFO, "devcoord: drv='%s' bindable to dev='%s'\n",
                     drv->name, dev->name);
 
@@ -1770,7 +1925,7 @@ void dc_bind_driver(driver_t* drv) {
 void dc_handle_new_driver(void) {
     driver_t* drv;
     while ((drv = list_remove_head_type(&list_drivers_new, driver_t, node)) != NULL) {
-        list_add_tail(&list_drivers, &drv->node);
+        dc_add_driver(drv, false);
         dc_bind_driver(drv);
     }
 }
@@ -1852,7 +2007,7 @@ void coordinator(void) {
     } else {
         driver_t* drv;
         while ((drv = list_remove_tail_type(&list_drivers_fallback, driver_t, node)) != NULL) {
-            list_add_tail(&list_drivers, &drv->node);
+            dc_add_driver(drv, false);
         }
     }
 
@@ -4,9 +4,11 @@
 
 #include <dirent.h>
 #include <fcntl.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <threads.h>
 #include <unistd.h>
 
 #include "devmgr.h"
@@ -15,6 +17,19 @@
 #include <driver-info/driver-info.h>
 
 #include <zircon/driver/binding.h>
+#include <zircon/listnode.h>
+#include <zircon/threads.h>
+
+// Driver files in a directory are scanned by up to this many threads.
+#define SCAN_THREADS 4
+
+// One file to be scanned for driver notes.
+typedef struct scan_item {
+    char libname[256 + 32];
+    const char* filename;   // last component of libname
+    zx_status_t status;
+    list_node_t found;      // found_driver_t
+} scan_item_t;
 
 static bool is_driver_disabled(const char* name) {
     // driver.<driver_name>.disable
@@ -23,6 +38,14 @@ static bool is_driver_disabled(const char* name) {
     return getenv_bool(opt, false);
 }
 
+// A driver found by a scan, waiting to be handed to the coordinator.
+typedef struct found_driver {
+    list_node_t node;
+    driver_t* drv;
+    char version[sizeof(((zircon_driver_note_payload_t*)0)->version)];
+    bool asan;
+} found_driver_t;
+
 static void found_driver(zircon_driver_note_payload_t* note,
                          const zx_bind_inst_t* bi, void* cookie) {
     // ensure strings are terminated
@@ -34,14 +57,20 @@ static void found_driver(zircon_driver_note_payload_t* note,
         return;
     }
 
-    const char* libname = cookie;
+    scan_item_t* item = cookie;
+    const char* libname = item->libname;
     size_t pathlen = strlen(libname) + 1;
     size_t namelen = strlen(note->name) + 1;
     size_t bindlen = note->bindcount * sizeof(zx_bind_inst_t);
     size_t len = sizeof(driver_t) + bindlen + pathlen + namelen;
 
+    found_driver_t* found;
+    if ((found = malloc(sizeof(found_driver_t))) == NULL) {
+        return;
+    }
     driver_t* drv;
     if ((drv = malloc(len)) == NULL) {
+        free(found);
         return;
     }
 
@@ -56,7 +85,7 @@ static void found_driver(zircon_driver_note_payload_t* note,
     memcpy((void*) drv->name, note->name, namelen);
 
 #if VERBOSE_DRIVER_LOAD
-    printf("found driver: %s\n", (char*) cookie);
+    printf("found driver: %s\n", libname);
     printf("        name: %s\n", note->name);
     printf("      vendor: %s\n", note->vendor);
     printf("     version: %s\n", note->version);
@@ -67,11 +96,59 @@ static void found_driver(zircon_driver_note_payload_t* note,
     }
 #endif
 
-    if (note->flags & ZIRCON_DRIVER_NOTE_FLAG_ASAN) {
-        dc_asan_drivers = true;
+    found->drv = drv;
+    memcpy(found->version, note->version, sizeof(found->version));
+    found->asan = (note->flags & ZIRCON_DRIVER_NOTE_FLAG_ASAN) != 0;
+    list_add_tail(&item->found, &found->node);
+}
+
+// Read the driver notes of one file.  Safe to run on any thread, since
+// the results are only collected in |item|.
+static void scan_one(int dirfd, scan_item_t* item) {
+    int fd;
+    if ((fd = openat(dirfd, item->filename, O_RDONLY)) < 0) {
+        item->status = ZX_ERR_IO;
+        return;
+    }
+    item->status = di_read_driver_info(fd, item, found_driver);
+    close(fd);
+}
+
+// Hand the drivers found in |item| to the coordinator.
+// Must be called on the coordinator thread.
+static void commit_item(scan_item_t* item) {
+    if (item->status == ZX_ERR_IO) {
+        printf("devcoord: cannot open '%s'\n", item->libname);
+    } else if (item->status == ZX_ERR_NOT_FOUND) {
+        printf("devcoord: no driver info in '%s'\n", item->libname);
+    } else if (item->status != ZX_OK) {
+        printf("devcoord: error reading info from '%s'\n", item->libname);
+    }
+
+    found_driver_t* found;
+    while ((found = list_remove_head_type(&item->found, found_driver_t, node)) != NULL) {
+        if (found->asan) {
+            dc_asan_drivers = true;
+        }
+        dc_driver_added(found->drv, found->version);
+        free(found);
     }
+}
 
-    dc_driver_added(drv, note->version);
+typedef struct scan_ctx {
+    int dirfd;
+    scan_item_t* items;
+    size_t count;
+    atomic_size_t next;
+} scan_ctx_t;
+
+static int scan_thread(void* arg) {
+    scan_ctx_t* ctx = arg;
+    size_t n;
+    while ((n = atomic_fetch_add(&ctx->next, 1)) < ctx->count) {
+        scan_one(ctx->dirfd, &ctx->items[n]);
+    }
+    return 0;
 }
 
 void find_loadable_drivers(const char* path) {
@@ -79,6 +156,12 @@ void find_loadable_drivers(const char* path) {
     if (dir == NULL) {
         return;
     }
+    dc_trace(DC_TRACE_SCAN, DC_TRACE_BEGIN, 0);
+
+    // Gather the candidate files first, in directory order.
+    scan_item_t* items = NULL;
+    size_t count = 0;
+    size_t max = 0;
     struct dirent* de;
     while ((de = readdir(dir)) != NULL) {
         if (de->d_name[0] == '.') {
@@ -87,45 +170,73 @@ void find_loadable_drivers(const char* path) {
         if (de->d_type != DT_REG) {
             continue;
         }
-        char libname[256 + 32];
-        int r = snprintf(libname, sizeof(libname), "%s/%s", path, de->d_name);
-        if ((r < 0) || (r >= (int)sizeof(libname))) {
-            continue;
+        if (count == max) {
+            size_t newmax = max ? max * 2 : 32;
+            scan_item_t* p = realloc(items, newmax * sizeof(scan_item_t));
+            if (p == NULL) {
+                break;
+            }
+            items = p;
+            max = newmax;
         }
-
-        int fd;
-        if ((fd = openat(dirfd(dir), de->d_name, O_RDONLY)) < 0) {
+        scan_item_t* item = &items[count];
+        int r = snprintf(item->libname, sizeof(item->libname), "%s/%s", path, de->d_name);
+        if ((r < 0) || (r >= (int)sizeof(item->libname))) {
             continue;
         }
-        zx_status_t status = di_read_driver_info(fd, libname, found_driver);
-        close(fd);
-
-        if (status) {
-            if (status == ZX_ERR_NOT_FOUND) {
-                printf("devcoord: no driver info in '%s'\n", libname);
-            } else {
-                printf("devcoord: error reading info from '%s'\n", libname);
+        item->filename = item->libname + strlen(path) + 1;
+        item->status = ZX_OK;
+        count++;
+    }
+    // list nodes must not move, so only set them up once |items| is final
+    for (size_t n = 0; n < count; n++) {
+        list_initialize(&items[n].found);
+    }
+
+    // Reading the notes is mostly waiting on the filesystem, so do it on
+    // several threads at once.  This thread takes a share of the work too.
+    scan_ctx_t ctx = {
+        .dirfd = dirfd(dir),
+        .items = items,
+        .count = count,
+    };
+    atomic_init(&ctx.next, 0);
+    thrd_t threads[SCAN_THREADS - 1];
+    size_t nthreads = 0;
+    if (count > 1) {
+        for (; nthreads < countof(threads) && nthreads + 1 < count; nthreads++) {
+            if (thrd_create_with_name(&threads[nthreads], scan_thread, &ctx,
+                                      "devmgr-scan") != thrd_success) {
+                break;
             }
         }
     }
+    scan_thread(&ctx);
+    for (size_t n = 0; n < nthreads; n++) {
+        thrd_join(threads[n], NULL);
+    }
+
+    // Add the drivers in directory order, so that priority among
+    // drivers with the same version markers is unchanged.
+    for (size_t n = 0; n < count; n++) {
+        commit_item(&items[n]);
+    }
+    free(items);
     closedir(dir);
+    dc_trace(DC_TRACE_SCAN, DC_TRACE_END, (uint32_t)count);
 }
 
 void load_driver(const char* path) {
     //TODO: check for duplicate driver add
-    int fd;
-    if ((fd = open(path, O_RDONLY)) < 0) {
+    scan_item_t item;
+    int r = snprintf(item.libname, sizeof(item.libname), "%s", path);
+    if ((r < 0) || (r >= (int)sizeof(item.libname))) {
         printf("devcoord: cannot open '%s'\n", path);
         return;
     }
-    zx_status_t status = di_read_driver_info(fd, (void*)path, found_driver);
-    close(fd);
-
-    if (status) {
-        if (status == ZX_ERR_NOT_FOUND) {
-            printf("devcoord: no driver info in '%s'\n", path);
-        } else {
-            printf("devcoord: error reading info from '%s'\n", path);
-        }
-    }
+    item.filename = item.libname;
+    item.status = ZX_OK;
+    list_initialize(&item.found);
+    scan_one(AT_FDCWD, &item);
+    commit_item(&item);
 }
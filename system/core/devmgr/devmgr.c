@@ -19,6 +19,7 @@
 #include <zircon/processargs.h>
 #include <zircon/syscalls.h>
 #include <zircon/syscalls/object.h>
+#include <zircon/syscalls/system.h>
 
 #include <fdio/namespace.h>
 #include <fdio/util.h>
@@ -577,6 +578,17 @@ void fshost_start(void) {
         types[n++] = PA_HND(PA_USER1, 0);
     }
 
+    // pass memory pressure events to fshost, for the filesystems to shrink
+    // their caches on
+    if (zx_system_get_event(root_job_handle, ZX_SYSTEM_EVENT_MEMORY_PRESSURE_WARNING,
+                            &handles[n]) == ZX_OK) {
+        types[n++] = PA_HND(PA_USER1, 1);
+    }
+    if (zx_system_get_event(root_job_handle, ZX_SYSTEM_EVENT_MEMORY_PRESSURE_CRITICAL,
+                            &handles[n]) == ZX_OK) {
+        types[n++] = PA_HND(PA_USER1, 2);
+    }
+
     // pass bootdata VMOs to fshost
     for (size_t m = 0; n < MAXHND; m++) {
         uint32_t type = PA_HND(PA_VMO_BOOTDATA, m);
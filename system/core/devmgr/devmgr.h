@@ -46,6 +46,11 @@ zx_handle_t fs_root_clone(void);
 zx_handle_t devfs_root_clone(void);
 zx_handle_t svc_root_clone(void);
 
+// Duplicates the event the kernel signals at the memory pressure level
+// |kind| (ZX_SYSTEM_EVENT_MEMORY_PRESSURE_WARNING or _CRITICAL), or returns
+// ZX_HANDLE_INVALID if fshost wasn't given it.
+zx_handle_t memory_pressure_event_clone(uint32_t kind);
+
 void block_device_watcher(zx_handle_t job, bool netboot);
 
 // getenv_bool looks in the environment for name. If not found, it returns
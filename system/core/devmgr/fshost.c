@@ -20,6 +20,7 @@
 #include <zircon/processargs.h>
 #include <zircon/status.h>
 #include <zircon/syscalls.h>
+#include <zircon/syscalls/system.h>
 
 #include <errno.h>
 #include <fcntl.h>
@@ -200,9 +201,10 @@ static void setup_bootfs(void) {
             case BOOTDATA_BOOTFS_SYSTEM: {
                 const char* errmsg;
                 zx_handle_t bootfs_vmo;
-                status = decompress_bootdata(zx_vmar_root_self(), vmo,
-                                             off, bootdata.length + sizeof(bootdata_t),
-                                             &bootfs_vmo, &errmsg);
+                status = decompress_bootdata_parallel(zx_vmar_root_self(), vmo,
+                                                      off, bootdata.length + sizeof(bootdata_t),
+                                                      zx_system_get_num_cpus(),
+                                                      &bootfs_vmo, &errmsg);
                 if (status < 0) {
                     printf("devmgr: failed to decompress bootdata: %s\n", errmsg);
                 } else {
@@ -213,10 +215,10 @@ static void setup_bootfs(void) {
             case BOOTDATA_RAMDISK: {
                 const char* errmsg;
                 zx_handle_t ramdisk_vmo;
-                status = decompress_bootdata(
+                status = decompress_bootdata_parallel(
                     zx_vmar_root_self(), vmo,
                     off, bootdata.length + sizeof(bootdata_t),
-                    &ramdisk_vmo, &errmsg);
+                    zx_system_get_num_cpus(), &ramdisk_vmo, &errmsg);
                 if (status != ZX_OK) {
                     printf("fshost: failed to decompress bootdata: %s\n",
                            errmsg);
@@ -328,6 +330,8 @@ zx_handle_t devmgr_load_file(const char* path) {
 static zx_handle_t devfs_root;
 static zx_handle_t svc_root;
 static zx_handle_t fuchsia_event;
+static zx_handle_t memory_warning_event;
+static zx_handle_t memory_critical_event;
 
 zx_handle_t devfs_root_clone(void) {
     return fdio_service_clone(devfs_root);
@@ -337,6 +341,17 @@ zx_handle_t svc_root_clone(void) {
     return fdio_service_clone(svc_root);
 }
 
+zx_handle_t memory_pressure_event_clone(uint32_t kind) {
+    zx_handle_t event = (kind == ZX_SYSTEM_EVENT_MEMORY_PRESSURE_CRITICAL) ?
+                        memory_critical_event : memory_warning_event;
+    zx_handle_t h;
+    if (event == ZX_HANDLE_INVALID ||
+        zx_handle_duplicate(event, ZX_RIGHT_SAME_RIGHTS, &h) != ZX_OK) {
+        return ZX_HANDLE_INVALID;
+    }
+    return h;
+}
+
 void fuchsia_start(void) {
     zx_object_signal(fuchsia_event, 0, ZX_USER_SIGNAL_0);
 }
@@ -362,6 +377,8 @@ int main(int argc, char** argv) {
     svc_root = zx_get_startup_handle(PA_HND(PA_USER0, 2));
     zx_handle_t devmgr_loader = zx_get_startup_handle(PA_HND(PA_USER0, 3));
     fuchsia_event = zx_get_startup_handle(PA_HND(PA_USER1, 0));
+    memory_warning_event = zx_get_startup_handle(PA_HND(PA_USER1, 1));
+    memory_critical_event = zx_get_startup_handle(PA_HND(PA_USER1, 2));
 
     fshost_start();
 
@@ -68,6 +68,7 @@ MODULE_STATIC_LIBS := \
     system/ulib/bootdata \
     system/ulib/fbl \
     system/ulib/gpt \
+    system/ulib/trace-provider \
     system/ulib/trace \
     system/ulib/zx \
     system/ulib/zxcpp \
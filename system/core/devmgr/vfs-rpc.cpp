@@ -22,6 +22,7 @@
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_lock.h>
 #include <fbl/unique_ptr.h>
+#include <trace-provider/provider.h>
 
 #include "devmgr.h"
 #include "memfs-private.h"
@@ -34,6 +35,12 @@ namespace {
 Vfs root_vfs;
 Vfs system_vfs;
 fbl::unique_ptr<async::Loop> global_loop;
+// Publishes fshost's trace events, including the system loader service's.
+fbl::unique_ptr<trace::TraceProvider> trace_provider;
+
+// Reads of memfs files are dispatched from this many threads at once; see
+// fs::Vfs::SetConcurrent().
+constexpr uint32_t kDispatchThreads = 4;
 
 }  // namespace
 
@@ -167,10 +174,15 @@ VnodeDir* vfs_create_global_root() {
         ZX_ASSERT(memfs::root_vfs.Open(memfs::global_root, &vn, fbl::StringPiece("/volume"), &pathout,
                                        ZX_FS_RIGHT_READABLE | ZX_FS_FLAG_CREATE, S_IFDIR) == ZX_OK);
 
+        memfs::root_vfs.SetConcurrent(true);
+        memfs::system_vfs.SetConcurrent(true);
         memfs::global_loop.reset(new async::Loop());
-        memfs::global_loop->StartThread("root-dispatcher");
+        for (uint32_t i = 0; i < memfs::kDispatchThreads; i++) {
+            memfs::global_loop->StartThread("root-dispatcher");
+        }
         memfs::root_vfs.set_async(memfs::global_loop->async());
         memfs::system_vfs.set_async(memfs::global_loop->async());
+        memfs::trace_provider.reset(new trace::TraceProvider(memfs::global_loop->async()));
     }
     return memfs::global_root.get();
 }
@@ -10,7 +10,7 @@
 
 #include "netsvc.h"
 
-#define MAX_LOG_LINE (ZX_LOG_RECORD_MAX + 32)
+#define MAX_LOG_LINE (ZX_LOG_RECORD_MAX + 64)
 
 static zx_handle_t loghandle;
 static logpacket_t pkt;
@@ -21,28 +21,50 @@ static volatile uint32_t pending = 0;
 
 zx_time_t debuglog_next_timeout = ZX_TIME_INFINITE;
 
+// records are read from the kernel a batch at a time
+static uint64_t batch[ZX_LOG_RECORD_MAX * 8 / sizeof(uint64_t)];
+static size_t batch_len;
+static size_t batch_off;
+
+static zx_log_record_t* next_log_record(void) {
+    if (batch_off >= batch_len) {
+        zx_status_t n = zx_log_read(loghandle, sizeof(batch), batch, ZX_LOG_READ_BATCH);
+        if (n <= 0) {
+            return NULL;
+        }
+        batch_len = n;
+        batch_off = 0;
+    }
+    zx_log_record_t* rec = (zx_log_record_t*)((char*)batch + batch_off);
+    batch_off = (batch_off + sizeof(zx_log_record_t) + rec->datalen + 7) & ~7;
+    return rec;
+}
+
 static int get_log_line(char* out) {
     char buf[ZX_LOG_RECORD_MAX + 1];
-    zx_log_record_t* rec = (zx_log_record_t*)buf;
-    for (;;) {
-        if (zx_log_read(loghandle, ZX_LOG_RECORD_MAX, rec, 0) > 0) {
-            if (rec->datalen && (rec->data[rec->datalen - 1] == '\n')) {
-                rec->datalen--;
-            }
-            // records flagged for local display are ignored
-            if (rec->flags & ZX_LOG_LOCAL) {
-                continue;
-            }
-            rec->data[rec->datalen] = 0;
-            snprintf(out, MAX_LOG_LINE, "[%05d.%03d] %05" PRIu64 ".%05" PRIu64 "> %s\n",
-                     (int)(rec->timestamp / 1000000000ULL),
-                     (int)((rec->timestamp / 1000000ULL) % 1000ULL),
-                     rec->pid, rec->tid, rec->data);
-            return strlen(out);
-        } else {
-            return 0;
+    zx_log_record_t* rec;
+    while ((rec = next_log_record()) != NULL) {
+        // records flagged for local display are ignored
+        if (rec->flags & ZX_LOG_LOCAL) {
+            continue;
+        }
+        size_t len = rec->datalen;
+        if (len && (rec->data[len - 1] == '\n')) {
+            len--;
         }
+        memcpy(buf, rec->data, len);
+        buf[len] = 0;
+        int n = 0;
+        if (rec->dropped) {
+            n = snprintf(out, MAX_LOG_LINE, "[netsvc] %u log records dropped\n", rec->dropped);
+        }
+        snprintf(out + n, MAX_LOG_LINE - n, "[%05d.%03d] %05" PRIu64 ".%05" PRIu64 "> %s\n",
+                 (int)(rec->timestamp / 1000000000ULL),
+                 (int)((rec->timestamp / 1000000ULL) % 1000ULL),
+                 rec->pid, rec->tid, buf);
+        return strlen(out);
     }
+    return 0;
 }
 
 int debuglog_init(void) {
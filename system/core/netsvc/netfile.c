@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <threads.h>
 #include <unistd.h>
 #include <sys/stat.h>
 
@@ -23,11 +24,124 @@
 
 #define TMP_SUFFIX ".netsvc.tmp"
 
+// Size of the buffer that file writes are staged in
+#define WRITE_BUFSZ (1024 * 1024)
+
 netfile_state netfile = {
     .fd = -1,
     .needs_rename = false,
 };
 
+// Writes are copied into a ring buffer and written out to the file by a
+// separate thread, so that the network loop can keep acknowledging incoming
+// blocks while the filesystem catches up.
+static struct {
+    bool active;
+    mtx_t lock;
+    cnd_t cond;     // signalled whenever head, tail, error or stop change
+    thrd_t thread;
+    int fd;
+    char* buf;
+    size_t head;    // total bytes queued
+    size_t tail;    // total bytes written out
+    int error;      // first error, as a negative errno
+    bool stop;
+} writer;
+
+static int netfile_writer_thread(void* arg) {
+    mtx_lock(&writer.lock);
+    for (;;) {
+        while (writer.head == writer.tail && !writer.stop) {
+            cnd_wait(&writer.cond, &writer.lock);
+        }
+        if (writer.head == writer.tail) {
+            break;
+        }
+        size_t off = writer.tail % WRITE_BUFSZ;
+        size_t len = writer.head - writer.tail;
+        if (len > WRITE_BUFSZ - off) {
+            len = WRITE_BUFSZ - off;
+        }
+        mtx_unlock(&writer.lock);
+        ssize_t n = write(writer.fd, writer.buf + off, len);
+        mtx_lock(&writer.lock);
+        if (n <= 0 && writer.error == 0) {
+            printf("netsvc: error writing %s: %d\n", netfile.filename, errno);
+            writer.error = (errno == 0) ? -EIO : -errno;
+        }
+        if (writer.error) {
+            // drop whatever is left
+            writer.tail = writer.head;
+        } else {
+            writer.tail += n;
+        }
+        cnd_broadcast(&writer.cond);
+    }
+    mtx_unlock(&writer.lock);
+    return 0;
+}
+
+static void netfile_writer_start(int fd) {
+    if ((writer.buf = malloc(WRITE_BUFSZ)) == NULL) {
+        return;
+    }
+    writer.fd = fd;
+    writer.head = 0;
+    writer.tail = 0;
+    writer.error = 0;
+    writer.stop = false;
+    mtx_init(&writer.lock, mtx_plain);
+    cnd_init(&writer.cond);
+    if (thrd_create_with_name(&writer.thread, netfile_writer_thread, NULL,
+                              "netfile-writer") != thrd_success) {
+        // fall back to writing synchronously
+        cnd_destroy(&writer.cond);
+        mtx_destroy(&writer.lock);
+        free(writer.buf);
+        return;
+    }
+    writer.active = true;
+}
+
+// Waits for everything queued so far to be written out.
+static int netfile_writer_drain(void) {
+    if (!writer.active) {
+        return 0;
+    }
+    mtx_lock(&writer.lock);
+    while (writer.tail != writer.head) {
+        cnd_wait(&writer.cond, &writer.lock);
+    }
+    int result = writer.error;
+    mtx_unlock(&writer.lock);
+    return result;
+}
+
+// Stops the writer thread, after writing out everything queued unless
+// |discard| is set. Returns the first write error, if any.
+static int netfile_writer_stop(bool discard) {
+    if (!writer.active) {
+        return 0;
+    }
+    mtx_lock(&writer.lock);
+    if (discard && writer.error == 0) {
+        writer.error = -ECANCELED;
+        writer.tail = writer.head;
+    }
+    writer.stop = true;
+    cnd_broadcast(&writer.cond);
+    mtx_unlock(&writer.lock);
+    thrd_join(writer.thread, NULL);
+
+    int result = discard ? 0 : writer.error;
+    cnd_destroy(&writer.cond);
+    mtx_destroy(&writer.lock);
+    free(writer.buf);
+    writer.buf = NULL;
+    writer.active = false;
+    return result;
+}
+
 static int netfile_mkdir(const char* filename) {
     const char* ptr = filename[0] == '/' ? filename + 1 : filename;
     struct stat st;
@@ -55,6 +169,7 @@ static int netfile_mkdir(const char* filename) {
 int netfile_open(const char *filename, uint32_t arg, size_t* file_size) {
     if (netfile.fd >= 0) {
         printf("netsvc: closing still-open '%s', replacing with '%s'\n", netfile.filename, filename);
+        netfile_writer_stop(false);
         close(netfile.fd);
         netfile.fd = -1;
     }
@@ -104,6 +219,9 @@ again: // label here to catch filename=/path/to/new/directory/
     } else {
         strlcpy(netfile.filename, filename, sizeof(netfile.filename));
         netfile.offset = 0;
+        if (arg == O_WRONLY) {
+            netfile_writer_start(netfile.fd);
+        }
     }
 
     return 0;
@@ -112,6 +230,14 @@ err:
     return -errno;
 }
 
+// A queued write failed: report it the way a failed synchronous write would.
+static int netfile_write_failed(int result) {
+    netfile_writer_stop(true);
+    close(netfile.fd);
+    netfile.fd = -1;
+    return result;
+}
+
 int netfile_offset_read(void* data_out, off_t offset, size_t max_len) {
     if (netfile.fd < 0) {
         printf("netsvc: read, but no open file\n");
@@ -149,6 +275,11 @@ int netfile_offset_write(const char* data, off_t offset, size_t length) {
         return -EBADF;
     }
     if (offset != netfile.offset) {
+        // Only seek once everything queued before this point is written out
+        int result = netfile_writer_drain();
+        if (result < 0) {
+            return netfile_write_failed(result);
+        }
         if (lseek(netfile.fd, offset, SEEK_SET) != offset) {
             return -errno;
         }
@@ -162,6 +293,36 @@ int netfile_write(const char* data, size_t len) {
         printf("netsvc: write, but no open file\n");
         return -EBADF;
     }
+    if (writer.active) {
+        mtx_lock(&writer.lock);
+        size_t done = 0;
+        while (done < len && writer.error == 0) {
+            size_t space = WRITE_BUFSZ - (writer.head - writer.tail);
+            if (space == 0) {
+                cnd_wait(&writer.cond, &writer.lock);
+                continue;
+            }
+            size_t off = writer.head % WRITE_BUFSZ;
+            size_t n = len - done;
+            if (n > space) {
+                n = space;
+            }
+            if (n > WRITE_BUFSZ - off) {
+                n = WRITE_BUFSZ - off;
+            }
+            memcpy(writer.buf + off, data + done, n);
+            writer.head += n;
+            done += n;
+            cnd_broadcast(&writer.cond);
+        }
+        int result = writer.error;
+        mtx_unlock(&writer.lock);
+        if (result < 0) {
+            return netfile_write_failed(result);
+        }
+        netfile.offset += len;
+        return len;
+    }
     ssize_t n = write(netfile.fd, data, len);
     if (n != (ssize_t)len) {
         printf("netsvc: error writing %s: %d\n", netfile.filename, errno);
@@ -179,6 +340,11 @@ int netfile_close(void) {
     if (netfile.fd < 0) {
         printf("netsvc: close, but no open file\n");
     } else {
+        if ((result = netfile_writer_stop(false)) < 0) {
+            // don't let an incomplete file replace the destination
+            netfile_abort_write();
+            return result;
+        }
         if (netfile.needs_rename) {
             char src[PATH_MAX];
             strlcpy(src, netfile.filename, sizeof(src));
@@ -201,6 +367,7 @@ void netfile_abort_write(void) {
     if (netfile.fd < 0) {
         return;
     }
+    netfile_writer_stop(true);
     close(netfile.fd);
     netfile.fd = -1;
     char tmp[PATH_MAX];
@@ -62,24 +62,24 @@ static void run_server(const char* progname, const char* bin, zx_handle_t h) {
 
 const char* nodename = "zircon";
 
-void udp6_recv(void* data, size_t len,
-               const ip6_addr_t* daddr, uint16_t dport,
-               const ip6_addr_t* saddr, uint16_t sport) {
+static void netboot_udp6_recv(void* cookie, void* data, size_t len,
+                              const ip6_addr_t* daddr, uint16_t dport,
+                              const ip6_addr_t* saddr, uint16_t sport) {
+    bool mcast = (memcmp(daddr, &ip6_ll_all_nodes, sizeof(ip6_addr_t)) == 0);
+    netboot_recv(data, len, mcast, daddr, dport, saddr, sport);
+}
 
+static void debuglog_udp6_recv(void* cookie, void* data, size_t len,
+                               const ip6_addr_t* daddr, uint16_t dport,
+                               const ip6_addr_t* saddr, uint16_t sport) {
     bool mcast = (memcmp(daddr, &ip6_ll_all_nodes, sizeof(ip6_addr_t)) == 0);
+    debuglog_recv(data, len, mcast);
+}
 
-    switch (dport) {
-    case NB_SERVER_PORT:
-        netboot_recv(data, len, mcast, daddr, dport, saddr, sport);
-        break;
-    case DEBUGLOG_ACK_PORT:
-        debuglog_recv(data, len, mcast);
-        break;
-    case NB_TFTP_INCOMING_PORT:
-    case NB_TFTP_OUTGOING_PORT:
-        tftp_recv(data, len, daddr, dport, saddr, sport);
-        break;
-    }
+static void tftp_udp6_recv(void* cookie, void* data, size_t len,
+                           const ip6_addr_t* daddr, uint16_t dport,
+                           const ip6_addr_t* saddr, uint16_t sport) {
+    tftp_recv(data, len, daddr, dport, saddr, sport);
 }
 
 void netifc_recv(void* data, size_t len) {
@@ -123,6 +123,14 @@ int main(int argc, char** argv) {
         return -1;
     }
 
+    if ((udp6_register(NB_SERVER_PORT, netboot_udp6_recv, NULL) != ZX_OK) ||
+        (udp6_register(DEBUGLOG_ACK_PORT, debuglog_udp6_recv, NULL) != ZX_OK) ||
+        (udp6_register(NB_TFTP_INCOMING_PORT, tftp_udp6_recv, NULL) != ZX_OK) ||
+        (udp6_register(NB_TFTP_OUTGOING_PORT, tftp_udp6_recv, NULL) != ZX_OK)) {
+        printf("netsvc: failed to register udp ports\n");
+        return -1;
+    }
+
     bool nodename_provided = false;
     while (argc > 1) {
         if (!strncmp(argv[1], "--netboot", 9)) {
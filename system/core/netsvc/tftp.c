@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <stddef.h>
@@ -24,6 +25,15 @@
 
 #define SCRATCHSZ 2048
 
+// Largest DATA payload that fits a single ethernet frame, and so
+// tftp_out_scratch, after the UDP/IPv6 and 4 byte TFTP headers.
+#define TFTP_MAX_BLOCKSZ (ETH_MTU - ETH_HDR_LEN - IP6_HDR_LEN - UDP_HDR_LEN - 4)
+// Most blocks a client may have in flight (RFC 7440). Lost blocks within a
+// window are recovered by the library, so this only bounds the burst.
+#define TFTP_MAX_WINDOWSZ 1024
+
+static_assert(TFTP_MAX_BLOCKSZ + 4 <= SCRATCHSZ, "tftp scratch buffer too small");
+
 #define NB_IMAGE_PREFIX_LEN (strlen(NB_IMAGE_PREFIX))
 #define NB_FILENAME_PREFIX_LEN (strlen(NB_FILENAME_PREFIX))
 
@@ -414,6 +424,12 @@ static void initialize_connection(const ip6_addr_t* saddr, uint16_t sport) {
                                     file_read, file_write, file_close};
     tftp_session_set_file_interface(session, &file_ifc);
 
+    // Honor the block and window sizes the client asks for, up to what fits
+    // our buffers and a single frame.
+    uint16_t max_block_size = TFTP_MAX_BLOCKSZ;
+    uint16_t max_window_size = TFTP_MAX_WINDOWSZ;
+    tftp_set_max_options(session, &max_block_size, &max_window_size);
+
     // Initialize transport interface
     memcpy(&transport_info.dest_addr, saddr, sizeof(ip6_addr_t));
     transport_info.dest_port = sport;
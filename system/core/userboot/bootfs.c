@@ -54,6 +54,39 @@ static const bootfs_entry_t* bootfs_search(zx_handle_t log,
     p += sizeof(bootfs_header_t);
     size_t avail = hdr->dirsize;
 
+    // Use the hash index after the directory, if the image has one.
+    if ((hdr->hashsize >= sizeof(bootfs_hash_t)) &&
+        (hdr->dirsize <= fs->len - sizeof(bootfs_header_t)) &&
+        (hdr->hashsize <= fs->len - sizeof(bootfs_header_t) - hdr->dirsize)) {
+        const bootfs_hash_t* hash = p + hdr->dirsize;
+        uint32_t count = hash->slot_count;
+        if ((count == 0) || (count & (count - 1)) ||
+            (count > (hdr->hashsize - sizeof(bootfs_hash_t)) / sizeof(uint32_t)))
+            fail(log, "bootfs has bogus hash index");
+
+        uint32_t mask = count - 1;
+        uint32_t slot = bootfs_hash_name(filename, filename_len - 1) & mask;
+        for (uint32_t n = 0; n <= mask; n++) {
+            uint32_t off = hash->slot[slot];
+            if (off-- == 0)
+                return NULL;
+            if ((off >= hdr->dirsize) || (off % 4) ||
+                (hdr->dirsize - off <= sizeof(bootfs_entry_t)))
+                fail(log, "bootfs has bogus hash entry");
+
+            const bootfs_entry_t* e = p + off;
+            if ((e->name_len < 1) || (BOOTFS_RECSIZE(e) > hdr->dirsize - off))
+                fail(log, "bootfs has bogus namelen in header");
+
+            if (e->name_len == filename_len) {
+                if (!memcmp(e->name, filename, filename_len))
+                    return e;
+            }
+            slot = (slot + 1) & mask;
+        }
+        return NULL;
+    }
+
     while (avail > sizeof(bootfs_entry_t)) {
         const bootfs_entry_t* e = p;
 
@@ -4,6 +4,7 @@
 
 #include <assert.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/param.h>
@@ -74,6 +75,15 @@ static zx_status_t vc_setup(vc_t* vc, bool special) {
         return ZX_ERR_NO_MEMORY;
     }
 
+    // allocate the damage spans
+    vc->dirty = reinterpret_cast<vc_dirty_span_t*>(
+        calloc(vc->rows, sizeof(vc_dirty_span_t)));
+    if (!vc->dirty) {
+        free(vc->scrollback_buf);
+        free(vc->text_buf);
+        return ZX_ERR_NO_MEMORY;
+    }
+
     // set up the default palette
     memcpy(&vc->palette, default_palette, sizeof(default_palette));
     if (special) {
@@ -87,70 +97,147 @@ static zx_status_t vc_setup(vc_t* vc, bool special) {
     return ZX_OK;
 }
 
-static void vc_invalidate(void* cookie, int x0, int y0, int w, int h) {
-    vc_t* vc = reinterpret_cast<vc_t*>(cookie);
+// Marks cells dirty, in screen coordinates.
+static void vc_damage(vc_t* vc, int x0, int y0, int w, int h) {
+    int x1 = MIN(x0 + w, static_cast<int>(vc->columns));
+    int y1 = MIN(y0 + h, vc_rows(vc));
+    x0 = MAX(x0, 0);
+    y0 = MAX(y0, 0);
+    if (x0 >= x1) {
+        return;
+    }
+    for (int y = y0; y < y1; y++) {
+        vc_dirty_span_t* span = &vc->dirty[y];
+        if (span->x0 >= span->x1) {
+            span->x0 = static_cast<uint16_t>(x0);
+            span->x1 = static_cast<uint16_t>(x1);
+        } else {
+            span->x0 = static_cast<uint16_t>(MIN(span->x0, x0));
+            span->x1 = static_cast<uint16_t>(MAX(span->x1, x1));
+        }
+    }
+}
+
+static void vc_damage_clear(vc_t* vc) {
+    memset(vc->dirty, 0, vc->rows * sizeof(vc_dirty_span_t));
+    vc->pending_scroll = 0;
+    vc->flush_x0 = vc->flush_y0 = UINT_MAX;
+    vc->flush_x1 = vc->flush_y1 = 0;
+    vc->cursor_drawn_y = -1;
+}
 
+// Adds drawn cells, in screen coordinates, to the region vc_flush() sends
+// to the display.
+static void vc_flush_add(vc_t* vc, unsigned x0, unsigned y0, unsigned x1, unsigned y1) {
+    vc->flush_x0 = MIN(vc->flush_x0, x0);
+    vc->flush_y0 = MIN(vc->flush_y0, y0);
+    vc->flush_x1 = MAX(vc->flush_x1, x1);
+    vc->flush_y1 = MAX(vc->flush_y1, y1);
+}
+
+static void vc_draw_cell(vc_t* vc, int x, int screen_y) {
+    int y = screen_y + vc->viewport_y;
+    if (y < 0) {
+        // Scrollback row.
+        vc_char_t* row = vc_get_scrollback_line_ptr(
+            vc, y + vc->scrollback_rows_count);
+        vc_gfx_draw_char(vc, row[x], x, screen_y, /* invert= */ false);
+        return;
+    }
+    // Row in the main console region (non-scrollback).  Check whether we
+    // should display the cursor at this position.  Note that it's possible
+    // that the cursor is outside the display area (vc->cursor_x ==
+    // vc->columns).  In that case, we won't display the cursor, even if
+    // there's a margin.  This matches gnome-terminal.
+    bool invert = (!vc->hide_cursor &&
+                   static_cast<unsigned>(x) == vc->cursor_x &&
+                   static_cast<unsigned>(y) == vc->cursor_y);
+    if (invert) {
+        vc->cursor_drawn_x = x;
+        vc->cursor_drawn_y = screen_y;
+    }
+    vc_gfx_draw_char(vc, vc->text_buf[y * vc->columns + x], x, screen_y, invert);
+}
+
+// Brings the drawn screen up to date with the text: applies any deferred
+// scroll, then draws the dirty cells.
+static void vc_render_damage(vc_t* vc) {
     if (!vc->active) {
         return;
     }
+    int rows = vc_rows(vc);
+    if (vc->pending_scroll > 0) {
+        int n = vc->pending_scroll;
+        vc->pending_scroll = 0;
+        // When n >= rows every row is already dirty.
+        if (n < rows) {
+            gfx_copyrect(vc_gfx, 0, n * vc->charh,
+                         vc_gfx->width, (rows - n) * vc->charh, 0, 0);
+            vc->cursor_drawn_y -= n;
+        } else {
+            vc->cursor_drawn_y = -1;
+        }
+        vc_flush_add(vc, 0, 0, vc->columns, rows);
 
-    assert(h >= 0);
-    int y1 = y0 + h;
-    assert(y0 <= static_cast<int>(vc->rows));
-    assert(y1 <= static_cast<int>(vc->rows));
+        // The scrollback indicators may have changed.
+        vc_status_update();
+        vc_gfx_invalidate_status();
+    }
 
-    // Clip the y range so that we don't unnecessarily draw characters
-    // outside the visible range, and so that we don't draw characters into
-    // the bottom margin.
-    int visible_y0 = vc->viewport_y;
-    int visible_y1 = vc->viewport_y + vc_rows(vc);
-    y0 = MAX(y0, visible_y0);
-    y1 = MIN(y1, visible_y1);
+    // Erase the cursor from wherever it was drawn; it gets drawn again below
+    // if it's still within the damage.
+    if (vc->cursor_drawn_y >= 0) {
+        vc_damage(vc, vc->cursor_drawn_x, vc->cursor_drawn_y, 1, 1);
+        vc->cursor_drawn_y = -1;
+    }
 
-    for (int y = y0; y < y1; y++) {
-        if (y < 0) {
-            // Scrollback row.
-            vc_char_t* row = vc_get_scrollback_line_ptr(
-                vc, y + vc->scrollback_rows_count);
-            for (int x = x0; x < x0 + w; x++) {
-                vc_gfx_draw_char(vc, row[x], x, y - vc->viewport_y,
-                                 /* invert= */ false);
-            }
-        } else {
-            // Row in the main console region (non-scrollback).
-            vc_char_t* row = &vc->text_buf[y * vc->columns];
-            for (int x = x0; x < x0 + w; x++) {
-                // Check whether we should display the cursor at this
-                // position.  Note that it's possible that the cursor is
-                // outside the display area (vc->cursor_x ==
-                // vc->columns).  In that case, we won't display the
-                // cursor, even if there's a margin.  This matches
-                // gnome-terminal.
-                bool invert = (!vc->hide_cursor &&
-                               static_cast<unsigned>(x) == vc->cursor_x &&
-                               static_cast<unsigned>(y) == vc->cursor_y);
-                vc_gfx_draw_char(vc, row[x], x, y - vc->viewport_y, invert);
-            }
+    for (int y = 0; y < rows; y++) {
+        vc_dirty_span_t* span = &vc->dirty[y];
+        if (span->x0 >= span->x1) {
+            continue;
         }
+        for (int x = span->x0; x < span->x1; x++) {
+            vc_draw_cell(vc, x, y);
+        }
+        vc_flush_add(vc, span->x0, y, span->x1, y + 1);
+        span->x0 = span->x1 = 0;
     }
 }
 
-// implement tc callbacks:
-
-static inline void vc_invalidate_lines(vc_t* vc, int y, int h) {
-    if (y < vc->invy0) {
-        vc->invy0 = y;
+void vc_flush(vc_t* vc) {
+    if (!vc->active) {
+        return;
     }
-    y += h;
-    if (y > vc->invy1) {
-        vc->invy1 = y;
+    vc_render_damage(vc);
+    if (vc->flush_x0 < vc->flush_x1 && vc->flush_y0 < vc->flush_y1) {
+        vc_gfx_invalidate(vc, vc->flush_x0, vc->flush_y0,
+                          vc->flush_x1 - vc->flush_x0, vc->flush_y1 - vc->flush_y0);
     }
+    vc->flush_x0 = vc->flush_y0 = UINT_MAX;
+    vc->flush_x1 = vc->flush_y1 = 0;
 }
 
-static void vc_tc_invalidate(void* cookie, int x0, int y0, int w, int h){
+// Marks cells dirty, in console coordinates (negative rows are scrollback).
+static void vc_invalidate(void* cookie, int x0, int y0, int w, int h) {
     vc_t* vc = reinterpret_cast<vc_t*>(cookie);
+
+    if (!vc->active) {
+        return;
+    }
+
+    assert(h >= 0);
+    assert(y0 <= static_cast<int>(vc->rows));
+    assert(y0 + h <= static_cast<int>(vc->rows));
+
+    // vc_damage() clips to the visible range, so that we don't draw
+    // characters into the bottom margin.
+    vc_damage(vc, x0, y0 - vc->viewport_y, w, h);
+}
+
+// implement tc callbacks:
+
+static void vc_tc_invalidate(void* cookie, int x0, int y0, int w, int h){
     vc_invalidate(cookie, x0, y0, w, h);
-    vc_invalidate_lines(vc, y0, h);
 }
 
 static void vc_tc_movecursor(void* cookie, int x, int y) {
@@ -162,11 +249,9 @@ static void vc_tc_movecursor(void* cookie, int x, int y) {
     if (vc->active && !vc->hide_cursor) {
         // Clear the cursor from its old position.
         vc_invalidate(cookie, old_x, old_y, 1, 1);
-        vc_invalidate_lines(vc, old_y, 1);
 
         // Display the cursor in its new position.
         vc_invalidate(cookie, vc->cursor_x, vc->cursor_y, 1, 1);
-        vc_invalidate_lines(vc, vc->cursor_y, 1);
     }
 }
 
@@ -223,48 +308,61 @@ static void vc_set_cursor_hidden(vc_t* vc, bool hide) {
     vc->hide_cursor = hide;
     if (vc->active) {
         vc_invalidate(vc, vc->cursor_x, vc->cursor_y, 1, 1);
-        vc_invalidate_lines(vc, vc->cursor_y, 1);
     }
 }
 
 static void vc_tc_copy_lines(void* cookie, int y_dest, int y_src, int line_count) {
     vc_t* vc = reinterpret_cast<vc_t*>(cookie);
 
+    if (!vc->active) {
+        tc_copy_lines(&vc->textcon, y_dest, y_src, line_count);
+        return;
+    }
+
     if (vc->viewport_y < 0) {
         tc_copy_lines(&vc->textcon, y_dest, y_src, line_count);
 
         // The viewport is scrolled.  For simplicity, fall back to
         // redrawing all of the non-scrollback lines in this case.
-        int rows = vc_rows(vc);
-        vc_invalidate(vc, 0, 0, vc->columns, rows);
-        vc_invalidate_lines(vc, 0, rows);
+        vc_invalidate(vc, 0, 0, vc->columns, vc_rows(vc));
         return;
     }
 
-    // Remove the cursor from the display before copying the lines on
-    // screen, otherwise we might be copying a rendering of the cursor to a
-    // position where the cursor isn't.  This must be done before the
-    // tc_copy_lines() call, otherwise we might render the wrong character.
-    bool old_hide_cursor = vc->hide_cursor;
-    if (vc->active) {
-        vc_set_cursor_hidden(vc, true);
+    int rows = vc_rows(vc);
+    if (y_dest == 0 && y_src > 0 && y_src + line_count == rows) {
+        // Fast path for the whole screen scrolling up, which is what a
+        // stream of output does.  The pixels are moved once, by
+        // vc_render_damage(), however many lines scroll before the next
+        // flush; until then the damage moves with the text.
+        tc_copy_lines(&vc->textcon, y_dest, y_src, line_count);
+        memmove(&vc->dirty[0], &vc->dirty[y_src], line_count * sizeof(vc_dirty_span_t));
+        for (int y = line_count; y < rows; y++) {
+            vc->dirty[y].x0 = 0;
+            vc->dirty[y].x1 = static_cast<uint16_t>(vc->columns);
+        }
+        vc->pending_scroll += y_src;
+        return;
     }
 
-    // The next two calls can be done in any order.
-    tc_copy_lines(&vc->textcon, y_dest, y_src, line_count);
+    // Draw what's pending before moving pixels around, with the cursor
+    // removed from the display, otherwise we might be copying a rendering
+    // of the cursor to a position where the cursor isn't.
+    bool old_hide_cursor = vc->hide_cursor;
+    vc->hide_cursor = true;
+    vc_render_damage(vc);
+    vc->hide_cursor = old_hide_cursor;
 
-    if (vc->active) {
-        gfx_copyrect(vc_gfx, 0, y_src * vc->charh,
-                     vc_gfx->width, line_count * vc->charh,
-                     0, y_dest * vc->charh);
+    tc_copy_lines(&vc->textcon, y_dest, y_src, line_count);
+    gfx_copyrect(vc_gfx, 0, y_src * vc->charh,
+                 vc_gfx->width, line_count * vc->charh,
+                 0, y_dest * vc->charh);
+    vc_flush_add(vc, 0, y_dest, vc->columns, y_dest + line_count);
 
-        // Restore the cursor.
-        vc_set_cursor_hidden(vc, old_hide_cursor);
+    // Restore the cursor.
+    vc_invalidate(vc, vc->cursor_x, vc->cursor_y, 1, 1);
 
-        vc_status_update();
-        vc_gfx_invalidate_status();
-        vc_invalidate_lines(vc, 0, vc_rows(vc));
-    }
+    vc_status_update();
+    vc_gfx_invalidate_status();
 }
 
 static void vc_tc_setparam(void* cookie, int param, uint8_t* arg, size_t arglen) {
@@ -317,6 +415,7 @@ static void vc_reset(vc_t* vc) {
     }
 
     vc_clear_gfx(vc);
+    vc_damage_clear(vc);
     vc_gfx_invalidate_all(vc);
 }
 
@@ -341,6 +440,9 @@ void vc_status_write(int x, unsigned color, const char* text) {
 
 void vc_render(vc_t* vc) {
     if (vc->active) {
+        vc_render_damage(vc);
+        vc->flush_x0 = vc->flush_y0 = UINT_MAX;
+        vc->flush_x1 = vc->flush_y1 = 0;
         vc_status_update();
         vc_gfx_invalidate_all(vc);
     }
@@ -348,9 +450,11 @@ void vc_render(vc_t* vc) {
 
 void vc_full_repaint(vc_t* vc) {
     vc_clear_gfx(vc);
+    vc_damage_clear(vc);
     int scrollback_lines = vc_get_scrollback_lines(vc);
     vc_invalidate(vc, 0, -scrollback_lines,
                          vc->columns, scrollback_lines + vc->rows);
+    vc_render_damage(vc);
 }
 
 int vc_get_scrollback_lines(vc_t* vc) {
@@ -372,11 +476,18 @@ static void vc_scroll_viewport_abs(vc_t* vc, int vpy) {
     if (diff == 0)
         return;
     int diff_abs = ABS(diff);
+    // Pending damage is relative to the old viewport.
+    vc_render_damage(vc);
     vc->viewport_y = vpy;
     int rows = vc_rows(vc);
     if (!vc->active) {
         return;
     }
+    // The drawn cursor moves with the pixels.
+    vc->cursor_drawn_y -= diff;
+    if (vc->cursor_drawn_y >= rows) {
+        vc->cursor_drawn_y = -1;
+    }
     if (diff_abs >= rows) {
         // We are scrolling the viewport by a large delta.  Invalidate all
         // of the visible area of the console.
@@ -474,6 +585,7 @@ void vc_free(vc_t* vc) {
     }
     free(vc->text_buf);
     free(vc->scrollback_buf);
+    free(vc->dirty);
     free(vc);
 }
 
@@ -210,21 +210,11 @@ void handle_key_press(uint8_t keycode, int modifiers) {
 }
 
 ssize_t vc_write(vc_t* vc, const void* buf, size_t count, zx_off_t off) {
-    vc->invy0 = vc_rows(vc) + 1;
-    vc->invy1 = -1;
     const uint8_t* str = (const uint8_t*)buf;
     for (size_t i = 0; i < count; i++) {
         vc->textcon.putc(&vc->textcon, str[i]);
     }
-    if (vc->invy1 >= 0) {
-        int rows = vc_rows(vc);
-        // Adjust for the current viewport position.  Convert
-        // console-relative row numbers to screen-relative row numbers.
-        int invalidate_y0 = MIN(vc->invy0 - vc->viewport_y, rows);
-        int invalidate_y1 = MIN(vc->invy1 - vc->viewport_y, rows);
-        vc_gfx_invalidate(vc, 0, invalidate_y0,
-                          vc->columns, invalidate_y1 - invalidate_y0);
-    }
+    vc_flush(vc);
     if (!(vc->flags & VC_FLAG_HASOUTPUT) && !vc->active) {
         vc->flags |= VC_FLAG_HASOUTPUT;
         vc_status_update();
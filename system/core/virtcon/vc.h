@@ -39,6 +39,12 @@ zx_status_t new_input_device(int fd, keypress_handler_t handler);
 #define STATUS_COLOR_ACTIVE 11
 #define STATUS_COLOR_UPDATED 10
 
+// Half-open range of columns in a screen row that need to be redrawn.
+typedef struct vc_dirty_span {
+    uint16_t x0;
+    uint16_t x1;
+} vc_dirty_span_t;
+
 typedef struct vc {
     char title[MAX_TAB_WIDTH];
     // vc title, shown in status bar
@@ -69,8 +75,14 @@ typedef struct vc {
     unsigned charw, charh;
     // size of character cell
 
-    int invy0, invy1;
-    // offscreen invalid lines, tracked during textcon drawing
+    vc_dirty_span_t* dirty;
+    // per screen row damage, drawn and flushed by vc_flush()
+    int pending_scroll;
+    // lines the drawn screen must scroll up by before damage is drawn
+    unsigned flush_x0, flush_y0, flush_x1, flush_y1;
+    // drawn cells that have not been flushed to the display yet
+    int cursor_drawn_x, cursor_drawn_y;
+    // where the cursor was last drawn, cursor_drawn_y < 0 if nowhere
 
     unsigned cursor_x, cursor_y;
     // cursor
@@ -117,6 +129,8 @@ void vc_status_clear();
 void vc_status_write(int x, unsigned color, const char* text);
 
 void vc_render(vc_t* vc);
+// draws the damaged cells and flushes them to the display
+void vc_flush(vc_t* vc);
 void vc_full_repaint(vc_t* vc);
 int vc_get_scrollback_lines(vc_t* vc);
 vc_char_t* vc_get_scrollback_line_ptr(vc_t* vc, unsigned row);
@@ -55,9 +55,10 @@ zx_status_t IntelHDAController::ResetControllerHW() {
             IntelHDAStream::Reset(sregs + i);
         }
 
-        // Explicitly shut down any CORB/RIRB DMA
+        // Explicitly shut down any CORB/RIRB DMA and DMA position reporting.
         REG_WR(&regs_->corbctl, 0u);
         REG_WR(&regs_->rirbctl, 0u);
+        REG_WR(&regs_->dpiblbase, 0u);
     }
 
     // Assert the reset signal and wait for the controller to ack.
@@ -284,6 +285,29 @@ zx_status_t IntelHDAController::SetupStreamDescriptors() {
         return res;
     }
 
+    // Allocate the DMA position buffer.  When enabled, the controller writes
+    // the current link position of each stream descriptor into an 8 byte slot
+    // of this buffer (in stream descriptor order) as DMA progresses, so
+    // clients which map it can track the ring buffer position without waiting
+    // for an IRQ.  See section 3.6.1
+    constexpr uint32_t DMA_POS_ENTRY_SIZE = 8;
+    res = dma_pos_mem_.Allocate(DMA_POS_ENTRY_SIZE * countof(regs_->stream_desc));
+    if (res != ZX_OK) {
+        LOG("Failed to allocate contiguous physical memory for the DMA position "
+            "buffer!  (res %d)\n", res);
+        return res;
+    }
+
+    uint64_t dma_pos_paddr64 = static_cast<uint64_t>(dma_pos_mem_.phys());
+    if (!HDA_REG_GCAP_64OK(gcap) && (dma_pos_paddr64 >> 32)) {
+        LOG("Intel HDA controller does not support 64-bit physical addressing!\n");
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    REG_WR(&regs_->dpibubase, static_cast<uint32_t>(dma_pos_paddr64 >> 32));
+    REG_WR(&regs_->dpiblbase, static_cast<uint32_t>(dma_pos_paddr64 & 0xFFFFFFFF) |
+                              HDA_REG_DPLBASE_ENABLE);
+
     // Allocate our stream descriptors and populate our free lists.
     for (uint32_t i = 0, bdl_off = 0; i < total_stream_cnt; ++i, bdl_off += bdl_size) {
         uint16_t stream_id = static_cast<uint16_t>(i + 1);
@@ -293,11 +317,26 @@ zx_status_t IntelHDAController::SetupStreamDescriptors() {
                   ? IntelHDAStream::Type::OUTPUT
                   : IntelHDAStream::Type::BIDIR);
 
+        // Each stream gets its own read-only handle to the position buffer
+        // which it may hand out to its clients.
+        zx::vmo dma_pos_vmo;
+        res = dma_pos_mem_.vmo().duplicate(ZX_RIGHT_TRANSFER |
+                                           ZX_RIGHT_DUPLICATE |
+                                           ZX_RIGHT_MAP |
+                                           ZX_RIGHT_READ,
+                                           &dma_pos_vmo);
+        if (res != ZX_OK) {
+            LOG("Failed to duplicate DMA position buffer VMO!  (res %d)\n", res);
+            return res;
+        }
+
         auto stream = fbl::AdoptRef(new IntelHDAStream(type,
                                                         stream_id,
                                                         &regs_->stream_desc[i],
                                                         bdl_mem_.phys() + bdl_off,
-                                                        bdl_mem_.virt() + bdl_off));
+                                                        bdl_mem_.virt() + bdl_off,
+                                                        fbl::move(dma_pos_vmo),
+                                                        i * DMA_POS_ENTRY_SIZE));
 
         ZX_DEBUG_ASSERT(i < countof(all_streams_));
         ZX_DEBUG_ASSERT(all_streams_[i] == nullptr);
@@ -95,6 +95,7 @@ IntelHDAController::~IntelHDAController() {
     // Release all of our physical memory used to talk directly to the hardware.
     cmd_buf_mem_.Release();
     bdl_mem_.Release();
+    dma_pos_mem_.Release();
 
     if (pci_.ops != nullptr) {
         // TODO(johngro) : unclaim the PCI device.  Right now, there is no way
@@ -73,6 +73,7 @@ public:
     // If mapped, unmap.  Then, if allocated, deallocate.
     void Release();
 
+    const zx::vmo& vmo()      const { return vmo_; }
     zx_paddr_t  phys()        const { return phys_; }
     uintptr_t   virt()        const { return virt_; }
     size_t      size()        const { return size_; }
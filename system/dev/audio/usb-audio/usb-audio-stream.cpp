@@ -12,6 +12,7 @@
 #include <zx/vmar.h>
 #include <fbl/algorithm.h>
 #include <fbl/limits.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <dispatcher-pool/dispatcher-thread-pool.h>
@@ -23,7 +24,22 @@
 namespace audio {
 namespace usb {
 
-static constexpr uint32_t MAX_OUTSTANDING_REQ = 8;
+// The number of usb requests kept in flight while the ring buffer runs.  Each
+// one carries a single 1mSec isochronous packet, so this is also how far (in
+// mSec) we run ahead of the bus, and how long the devhost may be descheduled
+// before the stream underruns.  It may be overridden with the
+// driver.usb_audio.queue_depth boot option.
+static constexpr uint32_t DEFAULT_REQ_QUEUE_DEPTH = 8;
+static constexpr uint32_t MIN_REQ_QUEUE_DEPTH = 2;
+static constexpr uint32_t MAX_REQ_QUEUE_DEPTH = 64;
+
+static uint32_t GetReqQueueDepth() {
+    const char* opt = getenv("driver.usb_audio.queue_depth");
+    if (opt == nullptr)
+        return DEFAULT_REQ_QUEUE_DEPTH;
+    return fbl::clamp(static_cast<uint32_t>(strtoul(opt, nullptr, 0)),
+                      MIN_REQ_QUEUE_DEPTH, MAX_REQ_QUEUE_DEPTH);
+}
 
 static constexpr uint32_t ExtractSampleRate(const usb_audio_ac_samp_freq& sr) {
     return static_cast<uint32_t>(sr.freq[0])
@@ -38,6 +54,10 @@ UsbAudioStream::~UsbAudioStream() {
     while (!list_is_empty(&free_req_)) {
         usb_request_release(list_remove_head_type(&free_req_, usb_request_t, node));
     }
+
+    if (position_virt_ != nullptr) {
+        zx::vmar::root_self().unmap(reinterpret_cast<uintptr_t>(position_virt_), PAGE_SIZE);
+    }
 }
 
 // static
@@ -94,6 +114,9 @@ zx_status_t UsbAudioStream::Bind(const char* devname,
     // TODO(johngro): Do this differently when we have the ability to queue io
     // transactions to a USB isochronous endpoint and can have the bus driver
     // DMA directly from the ring buffer we have set up with our user.
+    //
+    // All of the requests are allocated up front so that nothing needs to be
+    // allocated while the ring buffer is running.
     {
         fbl::AutoLock req_lock(&req_lock_);
 
@@ -102,13 +125,14 @@ zx_status_t UsbAudioStream::Bind(const char* devname,
         allocated_req_cnt_ = 0;
         max_req_size_ = usb_ep_max_packet(usb_endpoint);
 
-        for (uint32_t i = 0; i < MAX_OUTSTANDING_REQ; ++i) {
+        uint32_t queue_depth = GetReqQueueDepth();
+        for (uint32_t i = 0; i < queue_depth; ++i) {
             usb_request_t* req;
             zx_status_t status = usb_request_alloc(&req, max_req_size_,
                                                    usb_endpoint->bEndpointAddress);
             if (status != ZX_OK) {
                 LOG("Failed to allocate usb request %u/%u (size %u): %d\n",
-                    i + 1, MAX_OUTSTANDING_REQ, max_req_size_, status);
+                    i + 1, queue_depth, max_req_size_, status);
                 return status;
             }
 
@@ -124,6 +148,25 @@ zx_status_t UsbAudioStream::Bind(const char* devname,
         }
     }
 
+    // Create the page which we publish the ring buffer position through.  It is
+    // mapped for the lifetime of the stream, and only ever written to while
+    // holding the req_lock_.
+    res = zx::vmo::create(PAGE_SIZE, 0, &position_vmo_);
+    if (res != ZX_OK) {
+        LOG("Failed to create position buffer (res %d)\n", res);
+        return res;
+    }
+
+    uintptr_t position_virt;
+    res = zx::vmar::root_self().map(0, position_vmo_, 0, PAGE_SIZE,
+                                    ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE,
+                                    &position_virt);
+    if (res != ZX_OK) {
+        LOG("Failed to map position buffer (res %d)\n", res);
+        return res;
+    }
+    position_virt_ = reinterpret_cast<uint32_t*>(position_virt);
+
     iface_num_   = usb_interface->bInterfaceNumber;
     alt_setting_ = usb_interface->bAlternateSetting;
     usb_ep_addr_ = usb_endpoint->bEndpointAddress;
@@ -400,6 +443,7 @@ zx_status_t UsbAudioStream::ProcessRingBufferChannel(dispatcher::Channel* channe
         audio_proto::RingBufGetBufferReq    get_buffer;
         audio_proto::RingBufStartReq        rb_start;
         audio_proto::RingBufStopReq         rb_stop;
+        audio_proto::RingBufGetPositionBufferReq get_position_buffer;
         // TODO(johngro) : add more commands here
     } req;
 
@@ -422,6 +466,7 @@ zx_status_t UsbAudioStream::ProcessRingBufferChannel(dispatcher::Channel* channe
     HREQ(AUDIO_RB_CMD_GET_BUFFER,     get_buffer,     OnGetBufferLocked,    false);
     HREQ(AUDIO_RB_CMD_START,          rb_start,       OnStartLocked,        false);
     HREQ(AUDIO_RB_CMD_STOP,           rb_stop,        OnStopLocked,         false);
+    HREQ(AUDIO_RB_CMD_GET_POSITION_BUFFER, get_position_buffer, OnGetPositionBufferLocked, false);
     default:
         DEBUG_LOG("Unrecognized ring buffer command 0x%04x\n", req.hdr.cmd);
         return ZX_ERR_NOT_SUPPORTED;
@@ -551,10 +596,11 @@ zx_status_t UsbAudioStream::OnSetStreamFormatLocked(dispatcher::Channel* channel
         rb_channel_.reset();
     }
 
-    // We always try to keep two isochronous packets in flight at any point in
-    // time.  Based on our cadence generation parameters, determine if it is
-    // possible to have 0, 1 or 2 long packets back to back at any point in time
-    // during the sequence.
+    // We keep every one of our usb requests in flight at all times, and the
+    // payload of an output request is copied out of the ring buffer when it is
+    // queued, so our read ahead is one packet per request.  Based on our
+    // cadence generation parameters, determine the most long packets which can
+    // show up in that many back to back packets.
     //
     // TODO(johngro): This is not the proper way to report the FIFO depth.  How
     // far ahead the USB controller will read ahead into its FIFO is going to be
@@ -562,20 +608,15 @@ zx_status_t UsbAudioStream::OnSetStreamFormatLocked(dispatcher::Channel* channel
     // possible that this is negotiable to some extent as well.  I need to work
     // with voydanof@ to determine what we can expose from the USB bus driver in
     // order to report this accurately.
-    //
-    // Right now, we assume that the controller will never get farther ahead
-    // than two isochronous usb requests, so we report this the worst case fifo_depth.
-    fifo_bytes_ = bytes_per_packet_ << 1;
-
-    // If we have no fractional portion to accumulate, we always send
-    // short packets.  If our fractional portion is <= 1/2 of our
-    // isochronous rate, then we will never send two long packets back
-    // to back.
+    fifo_bytes_ = bytes_per_packet_ * allocated_req_cnt_;
+
+    // If we have no fractional portion to accumulate, we always send short
+    // packets.  Otherwise, N back to back packets contain at most
+    // (N * inc / rate) + 1 long packets.
     if (fractional_bpp_inc_) {
-        fifo_bytes_ += frame_size_;
-        if (fractional_bpp_inc_ > (iso_packet_rate_ >> 1)) {
-            fifo_bytes_ += frame_size_;
-        }
+        uint32_t max_long_packets = ((allocated_req_cnt_ * fractional_bpp_inc_)
+                                  / iso_packet_rate_) + 1;
+        fifo_bytes_ += frame_size_ * fbl::min(max_long_packets, allocated_req_cnt_);
     }
 
     // Send the commands required to set up the new format.  Do not attempt to
@@ -813,6 +854,7 @@ zx_status_t UsbAudioStream::OnStartLocked(dispatcher::Channel* channel,
     notification_acc_   = 0;
     ring_buffer_offset_ = 0;
     ring_buffer_pos_    = 0;
+    __atomic_store_n(position_virt_, 0u, __ATOMIC_RELEASE);
 
     // Schedule the frame number which the first transaction will go out on.
     //
@@ -853,6 +895,24 @@ zx_status_t UsbAudioStream::OnStartLocked(dispatcher::Channel* channel,
     return ZX_OK;
 }
 
+zx_status_t UsbAudioStream::OnGetPositionBufferLocked(
+        dispatcher::Channel* channel,
+        const audio_proto::RingBufGetPositionBufferReq& req) {
+    audio_proto::RingBufGetPositionBufferResp resp = { };
+    resp.hdr = req.hdr;
+
+    zx::vmo client_handle;
+    resp.result = position_vmo_.duplicate(ZX_RIGHT_TRANSFER | ZX_RIGHT_MAP | ZX_RIGHT_READ,
+                                          &client_handle);
+    if (resp.result != ZX_OK) {
+        LOG("Failed to duplicate position buffer handle (res %d)\n", resp.result);
+        return channel->Write(&resp, sizeof(resp));
+    }
+
+    resp.offset = 0;
+    return channel->Write(&resp, sizeof(resp), fbl::move(client_handle));
+}
+
 zx_status_t UsbAudioStream::OnStopLocked(dispatcher::Channel* channel,
                                          const audio_proto::RingBufStopReq& req) {
     fbl::AutoLock req_lock(&req_lock_);
@@ -1121,6 +1181,7 @@ void UsbAudioStream::CompleteRequestLocked(usb_request_t* req) {
         ring_buffer_pos_ -= ring_buffer_size_;
         ZX_DEBUG_ASSERT(ring_buffer_pos_ < ring_buffer_size_);
     }
+    __atomic_store_n(position_virt_, ring_buffer_pos_, __ATOMIC_RELEASE);
 
     // If this is an input stream, the ring buffer offset should always be equal
     // to the stream position.
@@ -120,6 +120,8 @@ private:
         __TA_REQUIRES(lock_);
     zx_status_t OnStopLocked(dispatcher::Channel* channel, const audio_proto::RingBufStopReq& req)
         __TA_REQUIRES(lock_);
+    zx_status_t OnGetPositionBufferLocked(dispatcher::Channel* channel,
+            const audio_proto::RingBufGetPositionBufferReq& req) __TA_REQUIRES(lock_);
 
     void RequestComplete(usb_request_t* req);
     void QueueRequestLocked() __TA_REQUIRES(req_lock_);
@@ -159,6 +161,11 @@ private:
     volatile RingBufferState ring_buffer_state_
         __TA_GUARDED(req_lock_) = RingBufferState::STOPPED;
 
+    // A page shared (read only) with clients which holds a copy of
+    // ring_buffer_pos_, updated as each usb request completes.
+    zx::vmo   position_vmo_;
+    uint32_t* position_virt_ = nullptr;
+
     union {
         audio_proto::RingBufStopResp  stop;
         audio_proto::RingBufStartResp start;
@@ -38,6 +38,19 @@
 #define AHCI_PORT_FLAG_SYNC_PAUSED (1 << 2) // port is paused until pending xfers are done
 //clang-format on
 
+// How deep the queue gets, in buckets of powers of two: 1, 2-3, ... 16-31, 32.
+#define AHCI_DEPTH_BUCKETS 6
+
+typedef struct ahci_port_stats {
+    uint64_t issued;     // commands issued
+    uint64_t issues;     // batches of commands issued
+    uint64_t completed;  // commands completed
+    uint64_t cpl_irqs;   // interrupts which completed any commands
+    uint64_t depth[AHCI_DEPTH_BUCKETS]; // outstanding commands after each issue
+    uint32_t max_depth;
+    uint64_t dumped;     // issued, when the stats were last logged
+} ahci_port_stats_t;
+
 typedef struct ahci_port {
     int nr; // 0-based
     int flags;
@@ -50,11 +63,14 @@ typedef struct ahci_port {
     mtx_t lock;
 
     uint32_t running;   // bitmask of running commands
+    uint32_t queued;    // bitmask of running commands which are NCQ
     uint32_t completed; // bitmask of completed commands
     iotxn_t* commands[AHCI_MAX_COMMANDS]; // commands in flight
 
     list_node_t txn_list;
     io_buffer_t buffer;
+
+    ahci_port_stats_t stats;
 } ahci_port_t;
 
 typedef struct ahci_device {
@@ -162,8 +178,10 @@ static void ahci_port_reset(ahci_port_t* port) {
     ahci_write(&port->regs->serr, ahci_read(&port->regs->serr));
 }
 
-static bool ahci_port_cmd_busy(ahci_port_t* port, int slot) {
-    return ((ahci_read(&port->regs->sact) | ahci_read(&port->regs->ci)) & (1 << slot)) || (port->commands[slot] != NULL) || (port->running & (1 << slot));
+// slots which are in use, whether by a command we know of or one the
+// watchdog gave up on which the hba still has
+static uint32_t ahci_port_busy_slots(ahci_port_t* port) {
+    return ahci_read(&port->regs->sact) | ahci_read(&port->regs->ci) | port->running;
 }
 
 static bool cmd_is_read(uint8_t cmd) {
@@ -179,7 +197,8 @@ static bool cmd_is_read(uint8_t cmd) {
 static bool cmd_is_write(uint8_t cmd) {
     if (cmd == SATA_CMD_WRITE_DMA ||
         cmd == SATA_CMD_WRITE_DMA_EXT ||
-        cmd == SATA_CMD_WRITE_FPDMA_QUEUED) {
+        cmd == SATA_CMD_WRITE_FPDMA_QUEUED ||
+        cmd == SATA_CMD_DATA_SET_MANAGEMENT) {
         return true;
     } else {
         return false;
@@ -190,22 +209,52 @@ static bool cmd_is_queued(uint8_t cmd) {
     return (cmd == SATA_CMD_READ_FPDMA_QUEUED) || (cmd == SATA_CMD_WRITE_FPDMA_QUEUED);
 }
 
+// use queued commands only if both the hba and the device support them
+static bool ahci_txn_queued(ahci_device_t* dev, sata_pdata_t* pdata) {
+    if (cmd_is_queued(pdata->cmd) && !(dev->cap & AHCI_CAP_NCQ)) {
+        pdata->cmd = (pdata->cmd == SATA_CMD_READ_FPDMA_QUEUED) ? SATA_CMD_READ_DMA_EXT :
+                                                                  SATA_CMD_WRITE_DMA_EXT;
+    }
+    return cmd_is_queued(pdata->cmd);
+}
+
 static void ahci_port_complete_txn(ahci_device_t* dev, ahci_port_t* port, zx_status_t status) {
     mtx_lock(&port->lock);
-    uint32_t sact = ahci_read(&port->regs->sact);
-    uint32_t running = port->running;
-    uint32_t done = sact ^ running;
-    // assert if a channel without an outstanding transaction is active
-    ZX_DEBUG_ASSERT(!(done & sact));
+    // queued commands are done once the device clears them from SActive, and
+    // the rest once the hba clears them from CI. a single interrupt may
+    // cover any number of them.
+    uint32_t active = ahci_read(&port->regs->sact) | ahci_read(&port->regs->ci);
+    uint32_t done = port->running & ~active & ~port->completed;
     port->completed |= done;
+    if (done) {
+        port->stats.completed += __builtin_popcount(done);
+        port->stats.cpl_irqs++;
+    }
     mtx_unlock(&port->lock);
     // hit the worker thread to complete commands
-    completion_signal(&dev->worker_completion);
+    if (done) {
+        completion_signal(&dev->worker_completion);
+    }
+}
+
+static void ahci_port_dump_stats(ahci_port_t* port) {
+    ahci_port_stats_t* s = &port->stats;
+    zxlogf(TRACE, "ahci.%d: %" PRIu64 " commands in %" PRIu64 " issues, %" PRIu64
+                  " completions in %" PRIu64 " irqs, max depth %u\n",
+           port->nr, s->issued, s->issues, s->completed, s->cpl_irqs, s->max_depth);
+    for (int i = 0; i < AHCI_DEPTH_BUCKETS; i++) {
+        if (s->depth[i]) {
+            zxlogf(TRACE, "ahci.%d:   depth >= %2d: %" PRIu64 "\n", port->nr, 1 << i, s->depth[i]);
+        }
+    }
+    s->dumped = s->issued;
 }
 
+// builds the command for |txn| in |slot|. the caller starts it, along with
+// any others built at the same time.
 static zx_status_t ahci_do_txn(ahci_device_t* dev, ahci_port_t* port, int slot, iotxn_t* txn) {
     assert(slot < AHCI_MAX_COMMANDS);
-    assert(!ahci_port_cmd_busy(port, slot));
+    assert(!(port->running & (1 << slot)));
 
     sata_pdata_t* pdata = sata_iotxn_pdata(txn);
     zx_status_t status = iotxn_physmap(txn);
@@ -217,14 +266,6 @@ static zx_status_t ahci_do_txn(ahci_device_t* dev, ahci_port_t* port, int slot,
     iotxn_phys_iter_t iter;
     iotxn_phys_iter_init(&iter, txn, AHCI_PRD_MAX_SIZE);
 
-    if (dev->cap & AHCI_CAP_NCQ) {
-        if (pdata->cmd == SATA_CMD_READ_DMA_EXT) {
-            pdata->cmd = SATA_CMD_READ_FPDMA_QUEUED;
-        } else if (pdata->cmd == SATA_CMD_WRITE_DMA_EXT) {
-            pdata->cmd = SATA_CMD_WRITE_FPDMA_QUEUED;
-        }
-    }
-
     // build the command
     ahci_cl_t* cl = port->cl + slot;
     // don't clear the cl since we set up ctba/ctbau at init
@@ -262,6 +303,11 @@ static zx_status_t ahci_do_txn(ahci_device_t* dev, ahci_port_t* port, int slot,
         cfis[11] = (pdata->count >> 8) & 0xff;
         cfis[12] = (slot << 3) & 0xff; // tag
         cfis[13] = 0; // normal priority
+    } else if (pdata->cmd == SATA_CMD_DATA_SET_MANAGEMENT) {
+        // the ranges are in the data, the count is of 512 byte blocks of them
+        cfis[3] = SATA_DSM_FEATURE_TRIM;
+        cfis[12] = pdata->count & 0xff;
+        cfis[13] = (pdata->count >> 8) & 0xff;
     }
 
     cl->prdtl = 0;
@@ -295,6 +341,9 @@ static zx_status_t ahci_do_txn(ahci_device_t* dev, ahci_port_t* port, int slot,
     }
 
     port->running |= (1 << slot);
+    if (cmd_is_queued(pdata->cmd)) {
+        port->queued |= (1 << slot);
+    }
     port->commands[slot] = txn;
 
     zxlogf(SPEW, "ahci.%d: do_txn txn %p (%c) offset 0x%" PRIx64 " length 0x%" PRIx64
@@ -309,16 +358,8 @@ static zx_status_t ahci_do_txn(ahci_device_t* dev, ahci_port_t* port, int slot,
         }
     }
 
-    // start command
-    if (cmd_is_queued(pdata->cmd)) {
-        ahci_write(&port->regs->sact, (1 << slot));
-    }
-    ahci_write(&port->regs->ci, (1 << slot));
-
-    // set the watchdog
     // TODO: general timeout mechanism
     pdata->timeout = zx_time_get(ZX_CLOCK_MONOTONIC) + ZX_SEC(1);
-    completion_signal(&dev->watchdog_completion);
     return ZX_OK;
 }
 
@@ -451,75 +492,122 @@ static void ahci_release(void* ctx) {
 
 // worker thread (for iotxn queue):
 
+static void ahci_port_complete_cmds(ahci_port_t* port) {
+    iotxn_t* done[AHCI_MAX_COMMANDS];
+    uint32_t completed = port->completed;
+    if (!completed) {
+        return;
+    }
+    for (uint32_t pending = completed; pending; pending &= pending - 1) {
+        unsigned slot = __builtin_ctz(pending);
+        done[slot] = port->commands[slot];
+        port->commands[slot] = NULL;
+    }
+    port->completed = 0;
+    port->running &= ~completed;
+    port->queued &= ~completed;
+    // resume the port if paused for sync and no outstanding transactions
+    if ((port->flags & AHCI_PORT_FLAG_SYNC_PAUSED) && !port->running) {
+        port->flags &= ~AHCI_PORT_FLAG_SYNC_PAUSED;
+    }
+
+    mtx_unlock(&port->lock);
+    for (uint32_t pending = completed; pending; pending &= pending - 1) {
+        unsigned slot = __builtin_ctz(pending);
+        iotxn_t* txn = done[slot];
+        if (txn == NULL) {
+            zxlogf(ERROR, "ahci.%d: illegal state, completing slot %d but txn == NULL\n",
+                    port->nr, slot);
+        } else {
+            zxlogf(SPEW, "ahci.%d: complete txn %p\n", port->nr, txn);
+            iotxn_complete(txn, ZX_OK, txn->length);
+        }
+    }
+    mtx_lock(&port->lock);
+}
+
+// starts as many of the queued txns as there are free slots for
+static void ahci_port_issue_cmds(ahci_device_t* dev, ahci_port_t* port) {
+    uint32_t busy = ahci_port_busy_slots(port);
+    uint32_t was_running = port->running;
+    uint32_t issue = 0;
+    uint32_t issue_queued = 0;
+    iotxn_t* txn;
+    while (!(port->flags & AHCI_PORT_FLAG_SYNC_PAUSED) &&
+           (txn = list_peek_head_type(&port->txn_list, iotxn_t, node)) != NULL) {
+        // if IOTXN_SYNC_BEFORE, pause the port if there are transactions in flight
+        if ((txn->flags & IOTXN_SYNC_BEFORE) && port->running) {
+            port->flags |= AHCI_PORT_FLAG_SYNC_PAUSED;
+            break;
+        }
+
+        // queued commands can only run alongside other queued commands, and
+        // the others only run one at a time
+        sata_pdata_t* pdata = sata_iotxn_pdata(txn);
+        bool queued = ahci_txn_queued(dev, pdata);
+        if (port->running && (!queued || (port->running & ~port->queued))) {
+            break;
+        }
+
+        // find a free command tag
+        int max = MIN(pdata->max_cmd, (int)((dev->cap >> 8) & 0x1f));
+        uint32_t free_slots = ~busy & (max == 31 ? ~0u : (1u << (max + 1)) - 1);
+        if (!free_slots) {
+            break;
+        }
+        int slot = __builtin_ctz(free_slots);
+
+        list_delete(&txn->node);
+        // if IOTXN_SYNC_AFTER, pause the port until this command is complete
+        if (txn->flags & IOTXN_SYNC_AFTER) {
+            port->flags |= AHCI_PORT_FLAG_SYNC_PAUSED;
+        }
+        // build the command, they all start together below
+        if (ahci_do_txn(dev, port, slot, txn) != ZX_OK) {
+            continue;
+        }
+        busy |= (1 << slot);
+        issue |= (1 << slot);
+        if (queued) {
+            issue_queued |= (1 << slot);
+        }
+    }
+    if (!issue) {
+        return;
+    }
+
+    // start the commands
+    if (issue_queued) {
+        ahci_write(&port->regs->sact, issue_queued);
+    }
+    ahci_write(&port->regs->ci, issue);
+
+    uint32_t depth = __builtin_popcount(port->running);
+    port->stats.issued += __builtin_popcount(issue);
+    port->stats.issues++;
+    port->stats.depth[MIN(31 - __builtin_clz(depth), AHCI_DEPTH_BUCKETS - 1)]++;
+    port->stats.max_depth = MAX(port->stats.max_depth, depth);
+
+    // set the watchdog, which is already running if the port was busy
+    if (!was_running) {
+        completion_signal(&dev->watchdog_completion);
+    }
+}
+
 static int ahci_worker_thread(void* arg) {
     ahci_device_t* dev = (ahci_device_t*)arg;
     ahci_port_t* port;
-    iotxn_t* txn;
     for (;;) {
         // iterate all the ports and run or complete commands
         for (int i = 0; i < AHCI_MAX_PORTS; i++) {
             port = &dev->ports[i];
-            mtx_lock(&port->lock);
             if (!(port->flags & (AHCI_PORT_FLAG_IMPLEMENTED | AHCI_PORT_FLAG_PRESENT))) {
-                goto next;
-            }
-
-            // complete commands first
-            while (port->completed) {
-                unsigned slot = 32 - __builtin_clz(port->completed) - 1;
-                txn = port->commands[slot];
-                if (txn == NULL) {
-                    zxlogf(ERROR, "ahci.%d: illegal state, completing slot %d but txn == NULL\n",
-                            port->nr, slot);
-                } else {
-                    mtx_unlock(&port->lock);
-                    zxlogf(SPEW, "ahci.%d: complete txn %p\n", port->nr, txn);
-                    iotxn_complete(txn, ZX_OK, txn->length);
-                    mtx_lock(&port->lock);
-                }
-                port->completed &= ~(1 << slot);
-                port->running &= ~(1 << slot);
-                port->commands[slot] = NULL;
-                // resume the port if paused for sync and no outstanding transactions
-                if ((port->flags & AHCI_PORT_FLAG_SYNC_PAUSED) && !port->running) {
-                    port->flags &= ~AHCI_PORT_FLAG_SYNC_PAUSED;
-                }
-            }
-
-            if (port->flags & AHCI_PORT_FLAG_SYNC_PAUSED) {
-                goto next;
-            }
-
-            txn = list_peek_head_type(&port->txn_list, iotxn_t, node);
-            if (!txn) {
-                goto next;
-            }
-
-            // if IOTXN_SYNC_BEFORE, pause the port if there are transactions in flight
-            if ((txn->flags & IOTXN_SYNC_BEFORE) && port->running) {
-                port->flags |= AHCI_PORT_FLAG_SYNC_PAUSED;
-                goto next;
-            }
-
-            // find a free command tag
-            sata_pdata_t* pdata = sata_iotxn_pdata(txn);
-            int max = MIN(pdata->max_cmd, (int)((dev->cap >> 8) & 0x1f));
-            int i = 0;
-            for (i = 0; i <= max; i++) {
-                if (!ahci_port_cmd_busy(port, i)) break;
-            }
-            if (i > max) {
-                goto next;
-            }
-
-            list_delete(&txn->node);
-            // if IOTXN_SYNC_AFTER, pause the port until this command is complete
-            if (txn->flags & IOTXN_SYNC_AFTER) {
-                port->flags |= AHCI_PORT_FLAG_SYNC_PAUSED;
+                continue;
             }
-            // run the command
-            ahci_do_txn(dev, port, i, txn);
-next:
+            mtx_lock(&port->lock);
+            // complete commands first, to free up their slots
+            ahci_port_complete_cmds(port);
+            ahci_port_issue_cmds(dev, port);
             mtx_unlock(&port->lock);
         }
         // wait here until more commands are queued, or a port becomes idle
@@ -542,6 +630,9 @@ static int ahci_watchdog_thread(void* arg) {
 
             mtx_lock(&port->lock);
             uint32_t pending = port->running & ~port->completed;
+            if (!pending && port->stats.issued != port->stats.dumped) {
+                ahci_port_dump_stats(port);
+            }
             while (pending) {
                 idle = false;
                 unsigned slot = 32 - __builtin_clz(pending) - 1;
@@ -554,6 +645,7 @@ static int ahci_watchdog_thread(void* arg) {
                         // time out
                         zxlogf(ERROR, "ahci: txn time out on port %d txn %p\n", port->nr, txn);
                         port->running &= ~(1 << slot);
+                        port->queued &= ~(1 << slot);
                         port->commands[slot] = NULL;
                         mtx_unlock(&port->lock);
                         iotxn_complete(txn, ZX_ERR_TIMED_OUT, 0);
@@ -27,6 +27,7 @@
 
 #define SATA_FLAG_DMA   (1 << 0)
 #define SATA_FLAG_LBA48 (1 << 1)
+#define SATA_FLAG_NCQ   (1 << 2)
 
 typedef struct sata_device {
     zx_device_t* zxdev;
@@ -40,8 +41,18 @@ typedef struct sata_device {
 
     size_t sector_sz;
     zx_off_t capacity; // bytes
+    uint32_t dsm_max_blocks; // of ranges, in one DATA SET MANAGEMENT command
 } sata_device_t;
 
+// a trim in progress, sent as as many DATA SET MANAGEMENT commands as it takes
+typedef struct sata_trim {
+    sata_device_t* device;
+    iotxn_t* txn; // the trim being done
+    uint64_t lba;
+    uint64_t count; // blocks left to trim
+    uint64_t* ranges; // the mapped data of the DATA SET MANAGEMENT commands
+} sata_trim_t;
+
 static void sata_device_identify_complete(iotxn_t* txn, void* cookie) {
     completion_signal((completion_t*)cookie);
 }
@@ -128,7 +139,15 @@ static zx_status_t sata_device_identify(sata_device_t* dev, zx_device_t* control
     } else {
         zxlogf(INFO, " PIO");
     }
-    dev->max_cmd = *(devinfo + SATA_DEVINFO_QUEUE_DEPTH);
+    // the queue depth only means anything for queued commands, without them
+    // there is one command at a time
+    if (*(devinfo + SATA_DEVINFO_SATA_CAP) & (1 << 8)) {
+        flags |= SATA_FLAG_NCQ;
+        dev->max_cmd = *(devinfo + SATA_DEVINFO_QUEUE_DEPTH) & 0x1f;
+        zxlogf(INFO, " NCQ");
+    } else {
+        dev->max_cmd = 0;
+    }
     zxlogf(INFO, " %d commands\n", dev->max_cmd + 1);
     if (cap & (1 << 9)) {
         dev->sector_sz = 512; // default
@@ -152,6 +171,18 @@ static zx_status_t sata_device_identify(sata_device_t* dev, zx_device_t* control
     memset(&dev->info, 0, sizeof(dev->info));
     dev->info.block_size = dev->sector_sz;
     dev->info.block_count = dev->capacity / dev->sector_sz;
+    // 1 means solid state; anything else is a spinning (or unreported) disk
+    if (*(devinfo + SATA_DEVINFO_ROTATION_RATE) != 1) {
+        dev->info.flags |= BLOCK_FLAG_ROTATIONAL;
+    }
+    if ((flags & SATA_FLAG_LBA48) && (*(devinfo + SATA_DEVINFO_DSM) & (1 << 0))) {
+        dev->info.flags |= BLOCK_FLAG_TRIM_SUPPORT;
+        // zero means the device didn't say, and one block is always allowed.
+        // a page of ranges covers plenty in one command.
+        dev->dsm_max_blocks = MIN(MAX(*(devinfo + SATA_DEVINFO_DSM_MAX_BLOCKS), 1),
+                                  PAGE_SIZE / SATA_DSM_BLOCK_SIZE);
+        zxlogf(INFO, "  TRIM, %u blocks of ranges\n", dev->dsm_max_blocks);
+    }
 
     uint32_t max_sg_size = SATA_MAX_BLOCK_COUNT * dev->sector_sz; // SATA cmd limit
     if (is_qemu) {
@@ -167,6 +198,79 @@ static zx_status_t sata_device_identify(sata_device_t* dev, zx_device_t* control
 
 static zx_protocol_device_t sata_device_proto;
 
+// fills |dsm| with as many of the ranges left in |trim| as fit, and sends it
+static void sata_trim_next(sata_trim_t* trim, iotxn_t* dsm) {
+    sata_device_t* device = trim->device;
+    size_t max_ranges = device->dsm_max_blocks * (SATA_DSM_BLOCK_SIZE / sizeof(uint64_t));
+    size_t n = 0;
+    while (trim->count > 0 && n < max_ranges) {
+        uint64_t count = MIN(trim->count, SATA_DSM_RANGE_MAX_COUNT);
+        trim->ranges[n++] = SATA_DSM_RANGE(trim->lba, count);
+        trim->lba += count;
+        trim->count -= count;
+    }
+    // the rest of the last block is ranges of no blocks, which are ignored
+    size_t blocks = (n * sizeof(uint64_t) + SATA_DSM_BLOCK_SIZE - 1) / SATA_DSM_BLOCK_SIZE;
+    memset(trim->ranges + n, 0, blocks * SATA_DSM_BLOCK_SIZE - n * sizeof(uint64_t));
+
+    dsm->opcode = IOTXN_OP_WRITE;
+    dsm->flags = trim->txn->flags;
+    dsm->length = blocks * SATA_DSM_BLOCK_SIZE;
+    dsm->actual = 0;
+
+    sata_pdata_t* pdata = sata_iotxn_pdata(dsm);
+    pdata->cmd = SATA_CMD_DATA_SET_MANAGEMENT;
+    pdata->device = 0x40;
+    pdata->lba = 0;
+    pdata->count = blocks;
+    pdata->max_cmd = device->max_cmd;
+    pdata->port = device->port;
+
+    iotxn_queue(device->parent, dsm);
+}
+
+static void sata_trim_complete(iotxn_t* dsm, void* cookie) {
+    sata_trim_t* trim = cookie;
+    if (dsm->status == ZX_OK && trim->count > 0) {
+        sata_trim_next(trim, dsm);
+        return;
+    }
+    iotxn_t* txn = trim->txn;
+    zx_status_t status = dsm->status;
+    iotxn_release(dsm);
+    free(trim);
+    iotxn_complete(txn, status, status == ZX_OK ? txn->length : 0);
+}
+
+static void sata_trim(sata_device_t* device, iotxn_t* txn) {
+    sata_trim_t* trim = malloc(sizeof(*trim));
+    if (trim == NULL) {
+        iotxn_complete(txn, ZX_ERR_NO_MEMORY, 0);
+        return;
+    }
+    iotxn_t* dsm;
+    zx_status_t status = iotxn_alloc(&dsm, IOTXN_ALLOC_CONTIGUOUS,
+                                     device->dsm_max_blocks * SATA_DSM_BLOCK_SIZE);
+    if (status != ZX_OK) {
+        free(trim);
+        iotxn_complete(txn, status, 0);
+        return;
+    }
+    if ((status = iotxn_mmap(dsm, (void**)&trim->ranges)) != ZX_OK) {
+        iotxn_release(dsm);
+        free(trim);
+        iotxn_complete(txn, status, 0);
+        return;
+    }
+    trim->device = device;
+    trim->txn = txn;
+    trim->lba = txn->offset / device->sector_sz;
+    trim->count = txn->length / device->sector_sz;
+    dsm->complete_cb = sata_trim_complete;
+    dsm->cookie = trim;
+    sata_trim_next(trim, dsm);
+}
+
 static void sata_iotxn_queue(void* ctx, iotxn_t* txn) {
     sata_device_t* device = ctx;
 
@@ -188,6 +292,16 @@ static void sata_iotxn_queue(void* ctx, iotxn_t* txn) {
         return;
     }
 
+    if (txn->opcode == IOTXN_OP_TRIM) {
+        if (!(device->info.flags & BLOCK_FLAG_TRIM_SUPPORT)) {
+            iotxn_complete(txn, ZX_ERR_NOT_SUPPORTED, 0);
+            return;
+        }
+        // moves no data, so it may be as long as it likes
+        sata_trim(device, txn);
+        return;
+    }
+
     // transfer must be smaller than max size
     if (txn->length > device->info.max_transfer_size) {
         iotxn_complete(txn, ZX_ERR_OUT_OF_RANGE, 0);
@@ -195,7 +309,12 @@ static void sata_iotxn_queue(void* ctx, iotxn_t* txn) {
     }
 
     sata_pdata_t* pdata = sata_iotxn_pdata(txn);
-    pdata->cmd = txn->opcode == IOTXN_OP_READ ? SATA_CMD_READ_DMA_EXT : SATA_CMD_WRITE_DMA_EXT;
+    if (device->flags & SATA_FLAG_NCQ) {
+        pdata->cmd = txn->opcode == IOTXN_OP_READ ? SATA_CMD_READ_FPDMA_QUEUED :
+                                                    SATA_CMD_WRITE_FPDMA_QUEUED;
+    } else {
+        pdata->cmd = txn->opcode == IOTXN_OP_READ ? SATA_CMD_READ_DMA_EXT : SATA_CMD_WRITE_DMA_EXT;
+    }
     pdata->device = 0x40;
     pdata->lba = txn->offset / device->sector_sz;
     pdata->count = txn->length / device->sector_sz;
@@ -6,6 +6,7 @@
 
 #include "ahci.h"
 
+#define SATA_CMD_DATA_SET_MANAGEMENT  0x06
 #define SATA_CMD_IDENTIFY_DEVICE      0xec
 #define SATA_CMD_READ_DMA             0xc8
 #define SATA_CMD_READ_DMA_EXT         0x25
@@ -25,8 +26,11 @@
 #define SATA_DEVINFO_MAJOR_VERS          80
 #define SATA_DEVINFO_CMD_SET_2           83
 #define SATA_DEVINFO_LBA_CAPACITY_2      100
+#define SATA_DEVINFO_DSM_MAX_BLOCKS      105
 #define SATA_DEVINFO_SECTOR_SIZE         106
 #define SATA_DEVINFO_LOGICAL_SECTOR_SIZE 117
+#define SATA_DEVINFO_DSM                 169
+#define SATA_DEVINFO_ROTATION_RATE       217
 
 #define SATA_DEVINFO_SERIAL_LEN   20
 #define SATA_DEVINFO_FW_REV_LEN   8
@@ -34,6 +38,13 @@
 
 #define SATA_MAX_BLOCK_COUNT  0x10000 // 16-bit count
 
+// DATA SET MANAGEMENT takes 512 byte blocks of ranges, each a 48-bit lba
+// and a 16-bit count
+#define SATA_DSM_FEATURE_TRIM     0x01
+#define SATA_DSM_BLOCK_SIZE       512
+#define SATA_DSM_RANGE_MAX_COUNT  0xffff
+#define SATA_DSM_RANGE(lba, count) (((uint64_t)(count) << 48) | ((lba) & ((1ull << 48) - 1)))
+
 typedef struct sata_pdata {
     zx_time_t timeout; // for ahci driver watchdog
     uint64_t lba;   // in blocks
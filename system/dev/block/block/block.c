@@ -174,6 +174,45 @@ done:
     return status;
 }
 
+static zx_status_t blkdev_fifo_set_policy(blkdev_t* bdev, const void* in_buf, size_t in_len) {
+    if (in_len != sizeof(block_fifo_policy_t)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    zx_status_t status;
+    mtx_lock(&bdev->lock);
+    if (bdev->bs == NULL) {
+        status = ZX_ERR_BAD_STATE;
+        goto done;
+    }
+
+    status = blockserver_set_policy(bdev->bs, in_buf);
+done:
+    mtx_unlock(&bdev->lock);
+    return status;
+}
+
+static zx_status_t blkdev_fifo_get_stats(blkdev_t* bdev, void* out_buf, size_t out_len,
+                                         size_t* out_actual) {
+    if (out_len < sizeof(block_fifo_stats_t)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    zx_status_t status;
+    mtx_lock(&bdev->lock);
+    if (bdev->bs == NULL) {
+        status = ZX_ERR_BAD_STATE;
+        goto done;
+    }
+
+    blockserver_get_stats(bdev->bs, out_buf);
+    *out_actual = sizeof(block_fifo_stats_t);
+    status = ZX_OK;
+done:
+    mtx_unlock(&bdev->lock);
+    return status;
+}
+
 static zx_status_t blkdev_fifo_close_locked(blkdev_t* bdev) {
     if (bdev->bs != NULL) {
         blockserver_shutdown(bdev->bs);
@@ -198,6 +237,10 @@ static zx_status_t blkdev_ioctl(void* ctx, uint32_t op, const void* cmd,
         return blkdev_alloc_txn(blkdev, cmd, cmdlen, reply, max, out_actual);
     case IOCTL_BLOCK_FREE_TXN:
         return blkdev_free_txn(blkdev, cmd, cmdlen);
+    case IOCTL_BLOCK_FIFO_SET_POLICY:
+        return blkdev_fifo_set_policy(blkdev, cmd, cmdlen);
+    case IOCTL_BLOCK_FIFO_GET_STATS:
+        return blkdev_fifo_get_stats(blkdev, reply, max, out_actual);
     case IOCTL_BLOCK_FIFO_CLOSE: {
         mtx_lock(&blkdev->lock);
         zx_status_t status = blkdev_fifo_close_locked(blkdev);
@@ -229,14 +272,21 @@ static void blkdev_iotxn_queue(void* ctx, iotxn_t* txn) {
         size_t bmask = bsz - 1;
         size_t blocks = txn->length / bsz;
 
+        bool trim = (txn->opcode == IOTXN_OP_TRIM);
+
         if ((txn->offset & bmask) ||
             (txn->length & bmask) ||
-            (txn->vmo_offset & bmask) ||
             (blocks < 1) ||
-            (txn->vmo_handle == ZX_HANDLE_INVALID)) {
+            (blocks > UINT32_MAX) ||
+            (!trim && (txn->vmo_offset & bmask)) ||
+            (!trim && (txn->vmo_handle == ZX_HANDLE_INVALID))) {
             iotxn_complete(txn, ZX_ERR_INVALID_ARGS, 0);
             return;
         }
+        if (trim && !(blkdev->info.flags & BLOCK_FLAG_TRIM_SUPPORT)) {
+            iotxn_complete(txn, ZX_ERR_NOT_SUPPORTED, 0);
+            return;
+        }
 
         block_op_t* bop = malloc(blkdev->block_op_size);
         if (bop == NULL) {
@@ -244,12 +294,18 @@ static void blkdev_iotxn_queue(void* ctx, iotxn_t* txn) {
             return;
         }
 
-        bop->command = (txn->opcode == IOTXN_OP_READ) ? BLOCK_OP_READ : BLOCK_OP_WRITE;
-        bop->rw.length = blocks;
-        bop->rw.vmo = txn->vmo_handle;
-        bop->rw.offset_dev = txn->offset / bsz;
-        bop->rw.offset_vmo = txn->vmo_offset / bsz;
-        bop->rw.pages = NULL;
+        if (trim) {
+            bop->command = BLOCK_OP_TRIM;
+            bop->trim.length = blocks;
+            bop->trim.offset_dev = txn->offset / bsz;
+        } else {
+            bop->command = (txn->opcode == IOTXN_OP_READ) ? BLOCK_OP_READ : BLOCK_OP_WRITE;
+            bop->rw.length = blocks;
+            bop->rw.vmo = txn->vmo_handle;
+            bop->rw.offset_dev = txn->offset / bsz;
+            bop->rw.offset_vmo = txn->vmo_offset / bsz;
+            bop->rw.pages = NULL;
+        }
         bop->completion_cb = block_completion_cb;
         bop->cookie = txn;
 
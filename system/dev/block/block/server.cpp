@@ -2,21 +2,26 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <inttypes.h>
+#include <limits.h>
 #include <unistd.h>
 
 #include <stdbool.h>
 #include <string.h>
 
+#include <ddk/debug.h>
 #include <ddk/device.h>
 #include <ddk/iotxn.h>
 #include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_lock.h>
 #include <fbl/limits.h>
+#include <fbl/new.h>
 #include <fbl/ref_ptr.h>
 #include <zircon/compiler.h>
 #include <zircon/device/block.h>
 #include <zircon/syscalls.h>
+#include <zircon/syscalls/fifo.h>
 #include <zx/fifo.h>
 
 #include "server.h"
@@ -30,6 +35,24 @@
 // block clients will also be able to manipulate them.
 constexpr zx_signals_t kSignalFifoTerminate = ZX_USER_SIGNAL_0;
 
+// The largest VMO given a page list when it is attached; 4096 pages, which
+// keeps the list itself to 32K.
+constexpr uint64_t kMaxPageListSize = 16 * 1024 * 1024;
+
+// Whether ops pass through the BlockScheduler, or go straight to the device.
+constexpr bool kScheduleOps = true;
+
+// How far ahead of its budget a throttled client may get, so that it can
+// send requests in bursts.
+constexpr zx_duration_t kThrottleBurst = ZX_MSEC(100);
+
+// How many ops a client of each priority may have at the device at once.
+constexpr uint32_t kPriorityInflight[] = {
+    fbl::numeric_limits<uint32_t>::max(), // BLOCK_PRIORITY_FOREGROUND
+    8,                                    // BLOCK_PRIORITY_BACKGROUND
+    1,                                    // BLOCK_PRIORITY_IDLE
+};
+
 namespace {
 
 void OutOfBandErrorRespond(const zx::fifo& fifo, zx_status_t status, txnid_t txnid) {
@@ -48,8 +71,9 @@ void OutOfBandErrorRespond(const zx::fifo& fifo, zx_status_t status, txnid_t txn
 void BlockComplete(void* cookie, zx_status_t status) {
     block_msg_t* msg = static_cast<block_msg_t*>(cookie);
     // Since iobuf is a RefPtr, it lives at least as long as the txn,
-    // and is not discarded underneath the block device driver.
-    ZX_DEBUG_ASSERT(msg->iobuf != nullptr);
+    // and is not discarded underneath the block device driver. Trims
+    // have no iobuf.
+    ZX_DEBUG_ASSERT((msg->iobuf != nullptr) || (msg->opcode == BLOCKIO_TRIM));
     ZX_DEBUG_ASSERT(msg->txn != nullptr);
     // Hold an extra copy of the 'blktxn' refptr; if we don't, and 'msg->txn' is
     // the last copy, then when we nullify 'msg->txn' in Complete we end up
@@ -61,49 +85,247 @@ void BlockComplete(void* cookie, zx_status_t status) {
 }
 
 void BlockCompleteIotxn(iotxn_t* txn, void* cookie) {
-    BlockComplete(cookie, txn->status);
+    BlockServer* bs = static_cast<block_msg_t*>(cookie)->server;
+    zx_status_t status = txn->status;
+    BlockComplete(cookie, status);
     iotxn_release(txn);
+    bs->OpComplete(status);
 }
 
 void BlockCompleteCb(block_op_t* bop, zx_status_t status) {
-    BlockComplete(bop->cookie, status);
-    free(bop);
+    while (bop != nullptr) {
+        block_op_t* next = BlockOpPool::NextMerged(bop);
+        BlockServer* bs = static_cast<block_msg_t*>(bop->cookie)->server;
+        BlockComplete(bop->cookie, status);
+        BlockOpPool::Free(bop);
+        bs->OpComplete(status);
+        bop = next;
+    }
+}
+
+// The time it takes to send |amount| at |rate| per second.
+zx_duration_t BudgetTime(uint64_t amount, uint64_t rate) {
+    return (amount / rate) * ZX_SEC(1) + ((amount % rate) * ZX_SEC(1)) / rate;
 }
 
 }  // namespace
 
-void BlockServer::Queue(uint32_t flags, zx_handle_t vmo, uint64_t length,
+BlockOpPool::BlockOpPool(size_t op_size, size_t count) :
+    slot_size_(fbl::round_up(kOpOffset + op_size, static_cast<size_t>(16))), count_(count),
+    slots_(nullptr), free_(nullptr), returned_(0) {}
+
+zx_status_t BlockOpPool::Create(size_t op_size, size_t count, fbl::RefPtr<BlockOpPool>* out) {
+    fbl::AllocChecker ac;
+    fbl::RefPtr<BlockOpPool> pool = fbl::AdoptRef(new (&ac) BlockOpPool(op_size, count));
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    pool->slots_ = static_cast<uint8_t*>(aligned_alloc(16, pool->slot_size_ * count));
+    if (pool->slots_ == nullptr) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    for (size_t i = 0; i < count; i++) {
+        Slot* slot = new (pool->slots_ + i * pool->slot_size_) Slot();
+        slot->pooled = true;
+        slot->next = pool->free_;
+        pool->free_ = slot;
+    }
+    *out = fbl::move(pool);
+    return ZX_OK;
+}
+
+BlockOpPool::~BlockOpPool() {
+    if (slots_ == nullptr) {
+        return;
+    }
+    for (size_t i = 0; i < count_; i++) {
+        reinterpret_cast<Slot*>(slots_ + i * slot_size_)->~Slot();
+    }
+    free(slots_);
+}
+
+block_op_t* BlockOpPool::Alloc() {
+    if (free_ == nullptr) {
+        free_ = reinterpret_cast<Slot*>(returned_.exchange(0, fbl::memory_order_acquire));
+    }
+    Slot* slot = free_;
+    if (slot != nullptr) {
+        free_ = slot->next;
+    } else {
+        void* mem = aligned_alloc(16, slot_size_);
+        if (mem == nullptr) {
+            return nullptr;
+        }
+        slot = new (mem) Slot();
+        slot->pooled = false;
+    }
+    slot->pool = fbl::WrapRefPtr(this);
+    slot->merged = nullptr;
+    return OpOf(slot);
+}
+
+void BlockOpPool::Free(block_op_t* bop) {
+    Slot* slot = SlotOf(bop);
+    // Keep the pool alive until the slot is back in it.
+    fbl::RefPtr<BlockOpPool> pool = fbl::move(slot->pool);
+    if (!slot->pooled) {
+        slot->~Slot();
+        free(slot);
+        return;
+    }
+    uintptr_t head = pool->returned_.load(fbl::memory_order_relaxed);
+    do {
+        slot->next = reinterpret_cast<Slot*>(head);
+    } while (!pool->returned_.compare_exchange_weak(&head, reinterpret_cast<uintptr_t>(slot),
+                                                    fbl::memory_order_release,
+                                                    fbl::memory_order_relaxed));
+}
+
+BlockScheduler::BlockScheduler() :
+    bp_(nullptr), block_size_(0), max_transfer_size_(0), sort_(false), count_(0),
+    ops_in_(0), ops_out_(0), merges_(0), sorts_(0), sorts_skipped_(0) {}
+
+void BlockScheduler::Init(const block_protocol_t* bp, const block_info_t* info) {
+    bp_ = bp;
+    block_size_ = info->block_size;
+    max_transfer_size_ = info->max_transfer_size;
+    sort_ = info->flags & BLOCK_FLAG_ROTATIONAL;
+}
+
+void BlockScheduler::Add(block_op_t* bop) {
+    if (count_ == kMaxOps) {
+        Flush();
+    }
+    ops_[count_++] = bop;
+    ops_in_++;
+}
+
+bool BlockScheduler::CanMerge(const block_op_t* a, const block_op_t* b) const {
+    uint32_t op = a->command & BLOCK_OP_MASK;
+    if ((op != BLOCK_OP_READ && op != BLOCK_OP_WRITE) || (b->command != a->command) ||
+        (b->rw.vmo != a->rw.vmo) || ((a->rw.pages == nullptr) != (b->rw.pages == nullptr))) {
+        // Ops with page lists for the same vmo point into the same list,
+        // which covers the merged op too.
+        return false;
+    }
+    if ((a->rw.offset_dev + a->rw.length != b->rw.offset_dev) ||
+        (a->rw.offset_vmo + a->rw.length != b->rw.offset_vmo)) {
+        return false;
+    }
+    uint64_t length = static_cast<uint64_t>(a->rw.length) + b->rw.length;
+    if (length > fbl::numeric_limits<uint32_t>::max()) {
+        return false;
+    }
+    return (max_transfer_size_ == 0) || (length * block_size_ <= max_transfer_size_);
+}
+
+bool BlockScheduler::Sort() {
+    // Batches are small, and usually close to sorted already.
+    for (size_t i = 0; i < count_; i++) {
+        block_op_t* bop = ops_[i];
+        size_t j = i;
+        for (; j > 0 && sorted_[j - 1]->rw.offset_dev > bop->rw.offset_dev; j--) {
+            sorted_[j] = sorted_[j - 1];
+        }
+        sorted_[j] = bop;
+    }
+    // If any two ops overlap, then some neighbouring pair does.
+    for (size_t i = 1; i < count_; i++) {
+        if (sorted_[i - 1]->rw.offset_dev + sorted_[i - 1]->rw.length > sorted_[i]->rw.offset_dev) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BlockScheduler::Flush() {
+    if (count_ == 0) {
+        return;
+    }
+    block_op_t** ops = ops_;
+    if (sort_ && count_ > 1) {
+        if (Sort()) {
+            ops = sorted_;
+            sorts_++;
+        } else {
+            sorts_skipped_++;
+        }
+    }
+
+    size_t i = 0;
+    while (i < count_) {
+        block_op_t* head = ops[i++];
+        block_op_t* tail = head;
+        while (i < count_ && CanMerge(head, ops[i])) {
+            head->rw.length += ops[i]->rw.length;
+            BlockOpPool::SetNextMerged(tail, ops[i]);
+            tail = ops[i++];
+            merges_++;
+        }
+        ops_out_++;
+        bp_->ops->queue(bp_->ctx, head);
+    }
+    count_ = 0;
+}
+
+void BlockScheduler::DumpStats() const {
+    zxlogf(TRACE, "block server: %" PRIu64 " ops queued as %" PRIu64 " (%" PRIu64 " merged), %"
+           PRIu64 " batches sorted, %" PRIu64 " left unsorted\n",
+           ops_in_, ops_out_, merges_, sorts_, sorts_skipped_);
+}
+
+void BlockServer::Queue(uint32_t flags, const IoBuffer* iobuf, uint64_t length,
                         uint64_t vmo_offset, uint64_t dev_offset, block_msg_t* msg) {
+    const bool trim = (msg->opcode == BLOCKIO_TRIM);
+    zx_handle_t vmo = trim ? ZX_HANDLE_INVALID : iobuf->vmo();
     if (bp_.ops == NULL) {
         iotxn_t* txn;
         zx_status_t status;
-        if ((status = iotxn_alloc_vmo(&txn, IOTXN_ALLOC_POOL, vmo,
-                                      vmo_offset, length)) != ZX_OK) {
+        if (trim) {
+            if ((status = iotxn_alloc(&txn, IOTXN_ALLOC_POOL, 0)) == ZX_OK) {
+                txn->length = length;
+            }
+        } else {
+            status = iotxn_alloc_vmo(&txn, IOTXN_ALLOC_POOL, vmo, vmo_offset, length);
+        }
+        if (status != ZX_OK) {
             BlockComplete(msg, status);
             return;
         }
         txn->flags = flags;
-        txn->opcode = msg->opcode;
+        txn->opcode = trim ? IOTXN_OP_TRIM : msg->opcode;
         txn->offset = dev_offset;
         txn->cookie = msg;
         txn->complete_cb = BlockCompleteIotxn;
+        OpIssued();
         iotxn_queue(dev_, txn);
     } else {
         size_t bsz = info_.block_size;
-        block_op_t* bop = (block_op_t*) malloc(block_op_size_);
+        block_op_t* bop = op_pool_->Alloc();
         if (bop == nullptr) {
             BlockComplete(msg, ZX_ERR_NO_MEMORY);
             return;
         }
-        bop->command = (msg->opcode == BLOCKIO_READ) ? BLOCK_OP_READ : BLOCK_OP_WRITE;
-        bop->rw.length = (uint32_t) (length / bsz);
-        bop->rw.vmo = vmo;
-        bop->rw.offset_dev = dev_offset / bsz;
-        bop->rw.offset_vmo = vmo_offset / bsz;
-        bop->rw.pages = NULL;
+        if (trim) {
+            bop->command = BLOCK_OP_TRIM;
+            bop->trim.length = (uint32_t) (length / bsz);
+            bop->trim.offset_dev = dev_offset / bsz;
+        } else {
+            bop->command = (msg->opcode == BLOCKIO_READ) ? BLOCK_OP_READ : BLOCK_OP_WRITE;
+            bop->rw.length = (uint32_t) (length / bsz);
+            bop->rw.vmo = vmo;
+            bop->rw.offset_dev = dev_offset / bsz;
+            bop->rw.offset_vmo = vmo_offset / bsz;
+            bop->rw.pages = iobuf->PageList(vmo_offset, length);
+        }
         bop->completion_cb = BlockCompleteCb;
         bop->cookie = msg;
-        bp_.ops->queue(bp_.ctx, bop);
+        OpIssued();
+        if (kScheduleOps) {
+            sched_.Add(bop);
+        } else {
+            bp_.ops->queue(bp_.ctx, bop);
+        }
     }
 }
 
@@ -187,6 +409,43 @@ IoBuffer::IoBuffer(zx::vmo vmo, vmoid_t id) : io_vmo_(fbl::move(vmo)), vmoid_(id
 
 IoBuffer::~IoBuffer() {}
 
+zx_status_t IoBuffer::InitPageList() {
+    uint64_t vmo_size;
+    zx_status_t status;
+    if ((status = io_vmo_.get_size(&vmo_size)) != ZX_OK) {
+        return status;
+    }
+    vmo_size = fbl::round_up(vmo_size, static_cast<uint64_t>(PAGE_SIZE));
+    if (vmo_size == 0 || vmo_size > kMaxPageListSize) {
+        return ZX_OK;
+    }
+
+    size_t count = vmo_size / PAGE_SIZE;
+    fbl::AllocChecker ac;
+    fbl::Array<uint64_t> pages(new (&ac) uint64_t[count], count);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    if ((status = io_vmo_.op_range(ZX_VMO_OP_COMMIT, 0, vmo_size, nullptr, 0)) != ZX_OK) {
+        return status;
+    }
+    static_assert(sizeof(zx_paddr_t) == sizeof(uint64_t), "");
+    if ((status = io_vmo_.op_range(ZX_VMO_OP_LOOKUP, 0, vmo_size, pages.get(),
+                                   count * sizeof(uint64_t))) != ZX_OK) {
+        return status;
+    }
+    pages_ = fbl::move(pages);
+    return ZX_OK;
+}
+
+uint64_t* IoBuffer::PageList(uint64_t vmo_offset, uint64_t length) const {
+    uint64_t covered = pages_.size() * PAGE_SIZE;
+    if ((vmo_offset > covered) || (covered - vmo_offset < length)) {
+        return nullptr;
+    }
+    return &pages_[vmo_offset / PAGE_SIZE];
+}
+
 zx_status_t IoBuffer::ValidateVmoHack(uint64_t length, uint64_t vmo_offset) {
     uint64_t vmo_size;
     zx_status_t status;
@@ -198,12 +457,19 @@ zx_status_t IoBuffer::ValidateVmoHack(uint64_t length, uint64_t vmo_offset) {
     return ZX_OK;
 }
 
-zx_status_t BlockServer::Read(block_fifo_request_t* requests, uint32_t* count) {
+zx_status_t BlockServer::Read(block_fifo_request_t* requests, size_t max, uint32_t* count) {
     // Keep trying to read messages from the fifo until we have a reason to
     // terminate
     while (true) {
-        zx_status_t status = fifo_.read(requests, sizeof(block_fifo_request_t), count);
-        if (status == ZX_ERR_SHOULD_WAIT) {
+        zx_status_t status = fifo_.read(requests, sizeof(block_fifo_request_t) * max, count);
+        if (status == ZX_OK) {
+            size_t bucket = 0;
+            while ((bucket < kBatchBuckets - 1) && (*count >> (bucket + 1)) != 0) {
+                bucket++;
+            }
+            read_batches_[bucket]++;
+            return ZX_OK;
+        } else if (status == ZX_ERR_SHOULD_WAIT) {
             zx_signals_t waitfor = ZX_FIFO_READABLE | ZX_FIFO_PEER_CLOSED | kSignalFifoTerminate;
             zx_signals_t observed;
             if ((status = fifo_.wait_one(waitfor, ZX_TIME_INFINITE, &observed)) != ZX_OK) {
@@ -219,6 +485,110 @@ zx_status_t BlockServer::Read(block_fifo_request_t* requests, uint32_t* count) {
     }
 }
 
+void BlockServer::OpIssued() {
+    fbl::AutoLock lock(&inflight_lock_);
+    inflight_++;
+    max_inflight_ = fbl::max(max_inflight_, static_cast<uint64_t>(inflight_));
+}
+
+void BlockServer::OpComplete(zx_status_t status) {
+    fbl::AutoLock lock(&inflight_lock_);
+    ZX_DEBUG_ASSERT(inflight_ > 0);
+    inflight_--;
+    if (status != ZX_OK) {
+        errors_++;
+    }
+    completion_signal(&inflight_done_);
+}
+
+void BlockServer::WaitForInflightBelow(uint32_t limit) {
+    while (true) {
+        {
+            fbl::AutoLock lock(&inflight_lock_);
+            if (inflight_ < limit) {
+                return;
+            }
+            completion_reset(&inflight_done_);
+        }
+        completion_wait(&inflight_done_, ZX_TIME_INFINITE);
+    }
+}
+
+bool BlockServer::Throttle(uint64_t length) {
+    block_fifo_policy_t policy;
+    {
+        fbl::AutoLock server_lock(&server_lock_);
+        policy = policy_;
+    }
+    if ((policy.priority == BLOCK_PRIORITY_FOREGROUND) && (policy.max_iops == 0) &&
+        (policy.max_bytes_per_sec == 0)) {
+        return true;
+    }
+
+    zx_time_t now = zx_time_get(ZX_CLOCK_MONOTONIC);
+    zx_time_t deadline = now;
+    if (policy.max_iops != 0) {
+        iops_next_ = fbl::max(iops_next_, now) + BudgetTime(1, policy.max_iops);
+    } else {
+        iops_next_ = 0;
+    }
+    if (policy.max_bytes_per_sec != 0) {
+        bytes_next_ = fbl::max(bytes_next_, now) + BudgetTime(length, policy.max_bytes_per_sec);
+    } else {
+        bytes_next_ = 0;
+    }
+    zx_time_t next = fbl::max(iops_next_, bytes_next_);
+    if (next > now + kThrottleBurst) {
+        deadline = next - kThrottleBurst;
+    }
+    uint32_t limit = kPriorityInflight[policy.priority];
+    bool over_limit;
+    {
+        fbl::AutoLock lock(&inflight_lock_);
+        over_limit = inflight_ >= limit;
+    }
+    if ((deadline <= now) && !over_limit) {
+        return true;
+    }
+
+    // Whatever the scheduler holds counts against the client, so it must be
+    // sent on before waiting for any of it to complete.
+    sched_.Flush();
+    if (deadline > now) {
+        zx_signals_t observed;
+        fifo_.wait_one(ZX_FIFO_PEER_CLOSED | kSignalFifoTerminate, deadline, &observed);
+        if (observed & (ZX_FIFO_PEER_CLOSED | kSignalFifoTerminate)) {
+            return false;
+        }
+    }
+    WaitForInflightBelow(limit);
+
+    fbl::AutoLock server_lock(&server_lock_);
+    stats_.throttled++;
+    stats_.throttled_ns += zx_time_get(ZX_CLOCK_MONOTONIC) - now;
+    return true;
+}
+
+zx_status_t BlockServer::SetPolicy(const block_fifo_policy_t* policy) {
+    if (policy->priority >= fbl::count_of(kPriorityInflight) || policy->reserved != 0) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    fbl::AutoLock server_lock(&server_lock_);
+    policy_ = *policy;
+    return ZX_OK;
+}
+
+void BlockServer::GetStats(block_fifo_stats_t* out) {
+    {
+        fbl::AutoLock server_lock(&server_lock_);
+        *out = stats_;
+        out->policy = policy_;
+    }
+    fbl::AutoLock lock(&inflight_lock_);
+    out->errors = errors_;
+    out->max_inflight = max_inflight_;
+}
+
 zx_status_t BlockServer::FindVmoIDLocked(vmoid_t* out) {
     for (vmoid_t i = last_id_; i < fbl::numeric_limits<vmoid_t>::max(); i++) {
         if (!tree_.find(i).IsValid()) {
@@ -250,6 +620,11 @@ zx_status_t BlockServer::AttachVmo(zx::vmo vmo, vmoid_t* out) {
     if (!ac.check()) {
         return ZX_ERR_NO_MEMORY;
     }
+    // Only the block protocol path can use the page list; a vmo that can't
+    // have one is still fine to do I/O with.
+    if ((bp_.ops != NULL) && (status = ibuf->InitPageList()) != ZX_OK) {
+        zxlogf(TRACE, "block server: no page list for vmoid %u: %d\n", id, status);
+    }
     tree_.insert(fbl::move(ibuf));
     *out = id;
     return ZX_OK;
@@ -290,7 +665,8 @@ zx_status_t BlockServer::Create(zx_device_t* dev, block_protocol_t* bp,
     }
 
     zx_status_t status;
-    if ((status = zx::fifo::create(BLOCK_FIFO_MAX_DEPTH, BLOCK_FIFO_ESIZE, 0,
+    // Clients may map the fifo to queue requests without a syscall each.
+    if ((status = zx::fifo::create(BLOCK_FIFO_MAX_DEPTH, BLOCK_FIFO_ESIZE, ZX_FIFO_MAPPABLE,
                                    fifo_out, &bs->fifo_)) != ZX_OK) {
         delete bs;
         return status;
@@ -298,6 +674,14 @@ zx_status_t BlockServer::Create(zx_device_t* dev, block_protocol_t* bp,
 
     if (bp->ops != NULL) {
         bp->ops->query(bp->ctx, &bs->info_, &bs->block_op_size_);
+        // At most a fifo's worth of requests are read at once, and most
+        // complete before the next batch is read.
+        if ((status = BlockOpPool::Create(bs->block_op_size_, BLOCK_FIFO_MAX_DEPTH,
+                                          &bs->op_pool_)) != ZX_OK) {
+            delete bs;
+            return status;
+        }
+        bs->sched_.Init(&bs->bp_, &bs->info_);
     }
 
     *out = bs;
@@ -309,7 +693,7 @@ zx_status_t BlockServer::Serve() {
     block_fifo_request_t requests[BLOCK_FIFO_MAX_DEPTH];
     uint32_t count;
     while (true) {
-        if ((status = Read(requests, &count) != ZX_OK)) {
+        if ((status = Read(requests, fbl::count_of(requests), &count)) != ZX_OK) {
             return status;
         }
 
@@ -317,10 +701,16 @@ zx_status_t BlockServer::Serve() {
             bool wants_reply = requests[i].opcode & BLOCKIO_TXN_END;
             txnid_t txnid = requests[i].txnid;
             vmoid_t vmoid = requests[i].vmoid;
+            uint32_t op = requests[i].opcode & BLOCKIO_OP_MASK;
+
+            if ((op == BLOCKIO_READ || op == BLOCKIO_WRITE) && !Throttle(requests[i].length)) {
+                sched_.Flush();
+                return ZX_ERR_PEER_CLOSED;
+            }
 
             fbl::AutoLock server_lock(&server_lock_);
             auto iobuf = tree_.find(vmoid);
-            if (!iobuf.IsValid()) {
+            if (!iobuf.IsValid() && (op != BLOCKIO_TRIM)) {
                 // Operation which is not accessing a valid vmo
                 if (wants_reply) {
                     OutOfBandErrorRespond(fifo_, ZX_ERR_IO, txnid);
@@ -365,6 +755,7 @@ zx_status_t BlockServer::Serve() {
                     break;
                 }
                 ZX_DEBUG_ASSERT(msg->txn == nullptr);
+                msg->server = this;
                 msg->txn = txns_[txnid];
                 ZX_DEBUG_ASSERT(msg->iobuf == nullptr);
                 msg->iobuf = iobuf.CopyPointer();
@@ -379,6 +770,13 @@ zx_status_t BlockServer::Serve() {
                 }
 
                 msg->opcode = requests[i].opcode & BLOCKIO_OP_MASK;
+                if (msg->opcode == BLOCKIO_READ) {
+                    stats_.reads++;
+                    stats_.bytes_read += requests[i].length;
+                } else {
+                    stats_.writes++;
+                    stats_.bytes_written += requests[i].length;
+                }
 
                 const uint64_t max_xfer = info_.max_transfer_size;
                 if (max_xfer != 0 && max_xfer < requests[i].length) {
@@ -397,19 +795,53 @@ zx_status_t BlockServer::Serve() {
                         flags &= ~(i == sub_txns - 1 ? 0 : IOTXN_SYNC_AFTER);
                         // Only allow IOTXN_SYNC_BEFORE to be set on the first sub-txn.
                         flags &= ~(i == 0 ? 0 : IOTXN_SYNC_BEFORE);
-                        Queue(flags, iobuf->vmo(), length,
+                        Queue(flags, msg->iobuf.get(), length,
                               vmo_offset, dev_offset, msg);
                         vmo_offset += length;
                         dev_offset += length;
                     }
                     ZX_DEBUG_ASSERT(len_remaining == 0);
                 } else {
-                    Queue(msg->flags, iobuf->vmo(), requests[i].length,
+                    Queue(msg->flags, msg->iobuf.get(), requests[i].length,
                           requests[i].vmo_offset, requests[i].dev_offset, msg);
                 }
 
                 break;
             }
+            case BLOCKIO_TRIM: {
+                // Trims move no data, so they are neither throttled nor split
+                // to fit the device's transfer limit.
+                size_t bsmask = info_.block_size - 1;
+                zx_status_t error = ZX_OK;
+                if (!(info_.flags & BLOCK_FLAG_TRIM_SUPPORT)) {
+                    error = ZX_ERR_NOT_SUPPORTED;
+                } else if ((requests[i].length > fbl::numeric_limits<uint32_t>::max()) ||
+                           (requests[i].length & bsmask) ||
+                           (requests[i].dev_offset & bsmask) ||
+                           (requests[i].length < info_.block_size)) {
+                    error = ZX_ERR_INVALID_ARGS;
+                }
+                if (error != ZX_OK) {
+                    if (wants_reply) {
+                        OutOfBandErrorRespond(fifo_, error, txnid);
+                    }
+                    continue;
+                }
+
+                block_msg_t* msg;
+                status = txns_[txnid]->Enqueue(wants_reply, &msg);
+                if (status != ZX_OK) {
+                    break;
+                }
+                ZX_DEBUG_ASSERT(msg->txn == nullptr);
+                msg->server = this;
+                msg->txn = txns_[txnid];
+                msg->opcode = BLOCKIO_TRIM;
+                stats_.trims++;
+                stats_.bytes_trimmed += requests[i].length;
+                Queue(msg->flags, nullptr, requests[i].length, 0, requests[i].dev_offset, msg);
+                break;
+            }
             case BLOCKIO_SYNC: {
                 // TODO(smklein): It might be more useful to have this on a per-vmo basis
                 fprintf(stderr, "Warning: BLOCKIO_SYNC is currently unimplemented\n");
@@ -428,17 +860,32 @@ zx_status_t BlockServer::Serve() {
             }
             }
         }
+        // Nothing more will be added to the ops until the next batch.
+        sched_.Flush();
     }
 }
 
 BlockServer::BlockServer(zx_device_t* dev, block_protocol_t* bp) :
-    dev_(dev), bp_(*bp), block_op_size_(0), last_id_(VMOID_INVALID + 1) {
+    dev_(dev), bp_(*bp), block_op_size_(0), iops_next_(0), bytes_next_(0), inflight_(0),
+    errors_(0), max_inflight_(0), last_id_(VMOID_INVALID + 1) {
+    memset(read_batches_, 0, sizeof(read_batches_));
+    memset(&policy_, 0, sizeof(policy_));
+    memset(&stats_, 0, sizeof(stats_));
     size_t actual;
     device_ioctl(dev_, IOCTL_BLOCK_GET_INFO, nullptr, 0, &info_, sizeof(info_), &actual);
 }
 
 BlockServer::~BlockServer() {
     ShutDown();
+    // Completions still to come refer back to the server.
+    WaitForInflightBelow(1);
+    sched_.DumpStats();
+    for (size_t i = 0; i < kBatchBuckets; i++) {
+        if (read_batches_[i] != 0) {
+            zxlogf(TRACE, "block server: %" PRIu64 " reads of %s%zu requests\n",
+                   read_batches_[i], (i == kBatchBuckets - 1) ? ">= " : "", 1ul << i);
+        }
+    }
 }
 
 void BlockServer::ShutDown() {
@@ -474,3 +921,9 @@ zx_status_t blockserver_allocate_txn(BlockServer* bs, txnid_t* out) {
 void blockserver_free_txn(BlockServer* bs, txnid_t txnid) {
     return bs->FreeTxn(txnid);
 }
+zx_status_t blockserver_set_policy(BlockServer* bs, const block_fifo_policy_t* policy) {
+    return bs->SetPolicy(policy);
+}
+void blockserver_get_stats(BlockServer* bs, block_fifo_stats_t* out) {
+    bs->GetStats(out);
+}
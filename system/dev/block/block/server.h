@@ -10,6 +10,7 @@
 
 #include <zircon/device/block.h>
 #include <ddk/protocol/block.h>
+#include <sync/completion.h>
 #include <zircon/thread_annotations.h>
 #include <zircon/types.h>
 
@@ -17,6 +18,8 @@
 
 #include <zx/fifo.h>
 #include <zx/vmo.h>
+#include <fbl/array.h>
+#include <fbl/atomic.h>
 #include <fbl/intrusive_wavl_tree.h>
 #include <fbl/mutex.h>
 #include <fbl/ref_counted.h>
@@ -34,6 +37,20 @@ public:
     // checking it and using it.  This will require a mechanism to "pin" VMO pages.
     zx_status_t ValidateVmoHack(uint64_t length, uint64_t vmo_offset);
 
+    // Commits the VMO and records the physical address of each of its pages,
+    // once, so that ops against it can carry a page list (block_op_t's
+    // rw.pages) instead of every driver looking the pages up per request.
+    // Must be called before the buffer is shared. VMOs larger than
+    // kMaxPageListSize are left without a list.
+    //
+    // Looking the pages up holds them in place for the life of the VMO, so
+    // the client can't decommit them or shrink the VMO while a device may
+    // still be using the list.
+    zx_status_t InitPageList();
+
+    // Returns the page list entry for the page holding |vmo_offset|, or
+    // null if the list doesn't cover |length| bytes from there.
+    uint64_t* PageList(uint64_t vmo_offset, uint64_t length) const;
 
     zx_handle_t vmo() const { return io_vmo_.get(); }
 
@@ -46,13 +63,16 @@ private:
 
     const zx::vmo io_vmo_;
     const vmoid_t vmoid_;
+    fbl::Array<uint64_t> pages_;
 };
 
 constexpr uint32_t kTxnFlagRespond = 0x00000001; // Should a reponse be sent when we hit ctr?
 
 class BlockTransaction;
+class BlockServer;
 
 typedef struct {
+    BlockServer* server;
     fbl::RefPtr<BlockTransaction> txn;
     fbl::RefPtr<IoBuffer> iobuf;
     uint32_t opcode;
@@ -85,6 +105,101 @@ private:
     uint32_t ctr_ TA_GUARDED(lock_); // How many ops does the block device need to complete?
 };
 
+// A fixed set of block ops, reused across requests so that queueing a
+// request to the device doesn't touch the heap. Ops are only allocated by
+// the server thread, but come back from the device on any thread, so
+// freed ops go on a lock-free stack which the server thread takes whole
+// when its own list runs dry. If the pool is exhausted, ops fall back to
+// the heap.
+//
+// Each op holds a reference to the pool, so the pool outlives a server
+// which exits with ops still in flight.
+class BlockOpPool : public fbl::RefCounted<BlockOpPool> {
+public:
+    static zx_status_t Create(size_t op_size, size_t count, fbl::RefPtr<BlockOpPool>* out);
+
+    // Must only be called from the server thread.
+    block_op_t* Alloc();
+    // May be called from any thread.
+    static void Free(block_op_t* bop);
+
+    // Ops merged into |bop| by the scheduler, which complete along with it.
+    static block_op_t* NextMerged(block_op_t* bop) { return SlotOf(bop)->merged; }
+    static void SetNextMerged(block_op_t* bop, block_op_t* next) {
+        SlotOf(bop)->merged = next;
+    }
+
+    ~BlockOpPool();
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(BlockOpPool);
+    BlockOpPool(size_t op_size, size_t count);
+
+    struct Slot {
+        fbl::RefPtr<BlockOpPool> pool;
+        Slot* next;
+        block_op_t* merged;
+        bool pooled;
+    };
+    static constexpr size_t kOpOffset = (sizeof(Slot) + 15) & ~static_cast<size_t>(15);
+
+    static block_op_t* OpOf(Slot* slot) {
+        return reinterpret_cast<block_op_t*>(reinterpret_cast<uint8_t*>(slot) + kOpOffset);
+    }
+    static Slot* SlotOf(block_op_t* bop) {
+        return reinterpret_cast<Slot*>(reinterpret_cast<uint8_t*>(bop) - kOpOffset);
+    }
+
+    const size_t slot_size_;
+    const size_t count_;
+    uint8_t* slots_;
+
+    Slot* free_; // Only touched by the server thread.
+    fbl::atomic<uintptr_t> returned_; // Slot* stack of ops freed since.
+};
+
+// Holds the ops queued while handling one batch of fifo requests, and sends
+// them to the device when the batch is done. Ops covering contiguous ranges
+// of both the device and the same vmo are merged into one, up to the
+// device's max transfer size. For rotational devices the batch is first
+// sorted by device offset, unless any two ops in it overlap, in which case
+// their order matters and the batch goes as it came.
+class BlockScheduler {
+public:
+    BlockScheduler();
+
+    void Init(const block_protocol_t* bp, const block_info_t* info);
+
+    // Must only be called from the server thread.
+    void Add(block_op_t* bop);
+    void Flush();
+
+    void DumpStats() const;
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(BlockScheduler);
+
+    bool CanMerge(const block_op_t* a, const block_op_t* b) const;
+    bool Sort();
+
+    static constexpr size_t kMaxOps = BLOCK_FIFO_MAX_DEPTH;
+
+    const block_protocol_t* bp_;
+    uint32_t block_size_;
+    uint32_t max_transfer_size_;
+    bool sort_;
+
+    block_op_t* ops_[kMaxOps];
+    block_op_t* sorted_[kMaxOps];
+    size_t count_;
+
+    uint64_t ops_in_;       // Ops added
+    uint64_t ops_out_;      // Ops sent to the device, after merging
+    uint64_t merges_;       // Ops merged into an earlier one
+    uint64_t sorts_;        // Batches sent in sorted order
+    uint64_t sorts_skipped_; // Batches left unsorted because ops overlapped
+};
+
 class BlockServer {
 public:
     // Creates a new BlockServer
@@ -98,15 +213,31 @@ public:
 
     void ShutDown();
 
+    // The client's policy, which is enforced when its requests are read
+    // from the fifo.
+    zx_status_t SetPolicy(const block_fifo_policy_t* policy);
+    void GetStats(block_fifo_stats_t* out);
+
+    // Called as each op sent to the device by Queue() completes.
+    void OpComplete(zx_status_t status);
+
     ~BlockServer();
 private:
     DISALLOW_COPY_ASSIGN_AND_MOVE(BlockServer);
     BlockServer(zx_device_t* dev, block_protocol_t* bp);
 
-    zx_status_t Read(block_fifo_request_t* requests, uint32_t* count);
+    // Waits until the client's policy lets a request of |length| bytes go
+    // to the device. Returns false if the server is shutting down.
+    bool Throttle(uint64_t length);
+    void WaitForInflightBelow(uint32_t limit);
+    void OpIssued();
+
+    // Reads up to |max| requests, waiting until there is at least one.
+    zx_status_t Read(block_fifo_request_t* requests, size_t max, uint32_t* count);
     zx_status_t FindVmoIDLocked(vmoid_t* out) TA_REQ(server_lock_);
 
-    void Queue(uint32_t flags, zx_handle_t vmo, uint64_t length,
+    // Sends one op of |msg| to the device. |iobuf| is null for trims.
+    void Queue(uint32_t flags, const IoBuffer* iobuf, uint64_t length,
                uint64_t vmo_offset, uint64_t dev_offset, block_msg_t* msg);
 
     zx::fifo fifo_;
@@ -114,8 +245,28 @@ private:
     block_info_t info_;
     block_protocol_t bp_;
     size_t block_op_size_;
+    fbl::RefPtr<BlockOpPool> op_pool_;
+    BlockScheduler sched_;
+
+    // How many requests each Read() returned, in buckets of powers of two.
+    static constexpr size_t kBatchBuckets = 8;
+    uint64_t read_batches_[kBatchBuckets];
+
+    // When the next request may go, for each of the policy's budgets. These
+    // may run up to kThrottleBurst ahead of the current time.
+    zx_time_t iops_next_;
+    zx_time_t bytes_next_;
+
+    // Ops sent to the device which have not yet completed.
+    fbl::Mutex inflight_lock_;
+    uint32_t inflight_ TA_GUARDED(inflight_lock_);
+    completion_t inflight_done_;
+    uint64_t errors_ TA_GUARDED(inflight_lock_);
+    uint64_t max_inflight_ TA_GUARDED(inflight_lock_);
 
     fbl::Mutex server_lock_;
+    block_fifo_policy_t policy_ TA_GUARDED(server_lock_);
+    block_fifo_stats_t stats_ TA_GUARDED(server_lock_);
     fbl::WAVLTree<vmoid_t, fbl::RefPtr<IoBuffer>> tree_ TA_GUARDED(server_lock_);
     fbl::RefPtr<BlockTransaction> txns_[MAX_TXN_COUNT] TA_GUARDED(server_lock_);
     vmoid_t last_id_ TA_GUARDED(server_lock_);
@@ -149,4 +300,8 @@ zx_status_t blockserver_attach_vmo(BlockServer* bs, zx_handle_t vmo, vmoid_t* ou
 zx_status_t blockserver_allocate_txn(BlockServer* bs, txnid_t* out);
 void blockserver_free_txn(BlockServer* bs, txnid_t txnid);
 
+// Set the client's priority and budgets, and read back its statistics
+zx_status_t blockserver_set_policy(BlockServer* bs, const block_fifo_policy_t* policy);
+void blockserver_get_stats(BlockServer* bs, block_fifo_stats_t* out);
+
 __END_CDECLS
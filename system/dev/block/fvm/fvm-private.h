@@ -79,7 +79,10 @@ private:
     friend class TypeWAVLTraits;
     DISALLOW_COPY_ASSIGN_AND_MOVE(SliceExtent);
 
-    fbl::Vector<uint32_t> pslices_;
+    // Most extents are short, so keep the first few pslices within the
+    // extent itself rather than allocating for each split or new extent.
+    static constexpr size_t kInlineSlices = 8;
+    fbl::InlineVector<uint32_t, kInlineSlices> pslices_;
     const size_t vslice_start_;
 };
 
@@ -137,6 +140,9 @@ public:
     zx_status_t FreeSlices(VPartition* vp, size_t vslice_start, size_t count) TA_EXCL(lock_);
     zx_status_t FreeSlicesLocked(VPartition* vp, size_t vslice_start,
                                  size_t count) TA_REQ(lock_);
+    // Tells the parent device that the contents of freed slices are no
+    // longer needed.
+    void TrimSlicesLocked(const fbl::Vector<uint32_t>& pslices) TA_REQ(lock_);
 
     size_t DiskSize() const { return info_.block_count * info_.block_size; }
     size_t SliceSize() const { return slice_size_; }
@@ -230,6 +236,9 @@ public:
     // Destroy the extent containing the vslice.
     void ExtentDestroyLocked(size_t vslice) TA_REQ(lock_);
 
+    // Returns the extent holding |vslice|, or nullptr if it isn't allocated.
+    const SliceExtent* ExtentGetLocked(size_t vslice) TA_REQ(lock_);
+
     size_t BlockSize() const TA_NO_THREAD_SAFETY_ANALYSIS {
         return info_.block_size;
     }
@@ -259,7 +268,17 @@ private:
     // indicates that the vpartition is completely unmapped, and uses no
     // physical slices.
     fbl::WAVLTree<size_t, fbl::unique_ptr<SliceExtent>> slice_map_ TA_GUARDED(lock_);
+    // The extent last looked up for I/O, which sequential I/O will usually
+    // find again. Cleared whenever the slice map changes.
+    const SliceExtent* last_extent_ TA_GUARDED(lock_);
     block_info_t info_ TA_GUARDED(lock_);
+
+    // Iotxns split into more than one txn to the parent, how many they became,
+    // and how many slice boundaries were crossed without splitting because
+    // the slices on either side were physically contiguous.
+    uint64_t split_txns_ TA_GUARDED(lock_);
+    uint64_t split_parts_ TA_GUARDED(lock_);
+    uint64_t merged_slices_ TA_GUARDED(lock_);
 };
 
 } // namespace fvm
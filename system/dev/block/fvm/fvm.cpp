@@ -2,10 +2,12 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <inttypes.h>
 #include <stdbool.h>
 #include <string.h>
 #include <unistd.h>
 
+#include <ddk/debug.h>
 #include <fs/mapped-vmo.h>
 #include <zircon/compiler.h>
 #include <zircon/device/block.h>
@@ -431,6 +433,12 @@ zx_status_t VPartitionManager::FreeSlicesLocked(VPartition* vp, size_t vslice_st
         return ZX_ERR_INVALID_ARGS;
     }
 
+    // The slices freed, which are trimmed once the metadata no longer refers
+    // to them. If there is no memory to remember them, they go untrimmed.
+    fbl::Vector<uint32_t> freed;
+    fbl::AllocChecker ac;
+    bool trim = (info_.flags & BLOCK_FLAG_TRIM_SUPPORT) != 0;
+
     bool freed_something = false;
     {
         fbl::AutoLock lock(&vp->lock_);
@@ -449,7 +457,12 @@ zx_status_t VPartitionManager::FreeSlicesLocked(VPartition* vp, size_t vslice_st
             // Special case: Freeing entire VPartition
             for (auto extent = vp->ExtentBegin(); extent.IsValid(); extent = vp->ExtentBegin()) {
                 for (size_t i = extent->start(); i < extent->end(); i++) {
-                    GetSliceEntryLocked(vp->SliceGetLocked(i))->vpart = PSLICE_UNALLOCATED;
+                    uint32_t pslice = vp->SliceGetLocked(i);
+                    GetSliceEntryLocked(pslice)->vpart = PSLICE_UNALLOCATED;
+                    if (trim) {
+                        freed.push_back(pslice, &ac);
+                        trim = ac.check();
+                    }
                 }
                 vp->ExtentDestroyLocked(extent->start());
             }
@@ -477,6 +490,10 @@ zx_status_t VPartitionManager::FreeSlicesLocked(VPartition* vp, size_t vslice_st
                     }
                     GetSliceEntryLocked(pslice)->vpart = 0;
                     freed_something = true;
+                    if (trim) {
+                        freed.push_back(static_cast<uint32_t>(pslice), &ac);
+                        trim = ac.check();
+                    }
                 }
             }
         }
@@ -485,7 +502,47 @@ zx_status_t VPartitionManager::FreeSlicesLocked(VPartition* vp, size_t vslice_st
     if (!freed_something) {
         return ZX_ERR_INVALID_ARGS;
     }
-    return WriteFvmLocked();
+    zx_status_t status = WriteFvmLocked();
+    if ((status == ZX_OK) && trim) {
+        // Nothing can allocate the slices again until the lock is dropped.
+        TrimSlicesLocked(freed);
+    }
+    return status;
+}
+
+void VPartitionManager::TrimSlicesLocked(const fbl::Vector<uint32_t>& pslices) {
+    // Slices are freed from either end of an extent, so runs of physically
+    // contiguous slices may be listed in either order. Each run is limited to
+    // what a single txn can describe.
+    const size_t max_run = fbl::max(fbl::numeric_limits<uint32_t>::max() / SliceSize(),
+                                    static_cast<size_t>(1));
+    size_t i = 0;
+    while (i < pslices.size()) {
+        size_t first = pslices[i];
+        size_t last = first;
+        for (i++; i < pslices.size() && last - first + 1 < max_run; i++) {
+            if (pslices[i] == last + 1) {
+                last++;
+            } else if (pslices[i] == first - 1) {
+                first--;
+            } else {
+                break;
+            }
+        }
+
+        iotxn_t* txn;
+        if (iotxn_alloc(&txn, IOTXN_ALLOC_POOL, 0) != ZX_OK) {
+            return;
+        }
+        txn->opcode = IOTXN_OP_TRIM;
+        txn->offset = SliceStart(DiskSize(), SliceSize(), first);
+        txn->length = (last - first + 1) * SliceSize();
+        iotxn_synchronous_op(parent_, txn);
+        if (txn->status != ZX_OK) {
+            zxlogf(TRACE, "fvm: trim of slices %zu-%zu failed: %d\n", first, last, txn->status);
+        }
+        iotxn_release(txn);
+    }
 }
 
 // Device protocol (FVM)
@@ -567,13 +624,17 @@ void VPartitionManager::DdkRelease() {
 }
 
 VPartition::VPartition(VPartitionManager* vpm, size_t entry_index)
-    : PartitionDeviceType(vpm->zxdev()), mgr_(vpm), entry_index_(entry_index) {
+    : PartitionDeviceType(vpm->zxdev()), mgr_(vpm), entry_index_(entry_index),
+      last_extent_(nullptr), split_txns_(0), split_parts_(0), merged_slices_(0) {
 
     memcpy(&info_, &mgr_->info_, sizeof(block_info_t));
     info_.block_count = 0;
 }
 
-VPartition::~VPartition() = default;
+VPartition::~VPartition() TA_NO_THREAD_SAFETY_ANALYSIS {
+    zxlogf(TRACE, "fvm: partition %zu split %" PRIu64 " txns into %" PRIu64 ", merged %"
+           PRIu64 " slices\n", entry_index_, split_txns_, split_parts_, merged_slices_);
+}
 
 zx_status_t VPartition::Create(VPartitionManager* vpm, size_t entry_index,
                                fbl::unique_ptr<VPartition>* out) {
@@ -599,6 +660,19 @@ uint32_t VPartition::SliceGetLocked(size_t vslice) const {
     return extent->get(vslice);
 }
 
+const SliceExtent* VPartition::ExtentGetLocked(size_t vslice) {
+    if (last_extent_ != nullptr && last_extent_->start() <= vslice &&
+        vslice < last_extent_->end()) {
+        return last_extent_;
+    }
+    auto extent = --slice_map_.upper_bound(vslice);
+    if (!extent.IsValid() || vslice >= extent->end()) {
+        return nullptr;
+    }
+    last_extent_ = &*extent;
+    return last_extent_;
+}
+
 zx_status_t VPartition::CheckSlices(size_t vslice_start, size_t* count, bool* allocated) {
     fbl::AutoLock lock(&lock_);
 
@@ -639,6 +713,7 @@ zx_status_t VPartition::SliceSetLocked(size_t vslice, uint32_t pslice) {
     ZX_DEBUG_ASSERT(vslice < mgr_->VSliceMax());
     auto extent = --slice_map_.upper_bound(vslice);
     ZX_DEBUG_ASSERT(!extent.IsValid() || extent->get(vslice) == PSLICE_UNALLOCATED);
+    last_extent_ = nullptr;
     if (extent.IsValid() && (vslice == extent->end())) {
         // Easy case: append to existing slice
         if (!extent->push_back(pslice)) {
@@ -677,6 +752,7 @@ zx_status_t VPartition::SliceSetLocked(size_t vslice, uint32_t pslice) {
 bool VPartition::SliceFreeLocked(size_t vslice) {
     ZX_DEBUG_ASSERT(vslice < mgr_->VSliceMax());
     ZX_DEBUG_ASSERT(SliceCanFree(vslice));
+    last_extent_ = nullptr;
     auto extent = --slice_map_.upper_bound(vslice);
     if (vslice != extent->end() - 1) {
         // Removing from the middle of an extent; this splits the extent in
@@ -700,6 +776,7 @@ bool VPartition::SliceFreeLocked(size_t vslice) {
 void VPartition::ExtentDestroyLocked(size_t vslice) TA_REQ(lock_) {
     ZX_DEBUG_ASSERT(vslice < mgr_->VSliceMax());
     ZX_DEBUG_ASSERT(SliceCanFree(vslice));
+    last_extent_ = nullptr;
     auto extent = --slice_map_.upper_bound(vslice);
     size_t length = extent->size();
     slice_map_.erase(*extent);
@@ -895,99 +972,95 @@ void VPartition::DdkIotxnQueue(iotxn_t* txn) {
     size_t vslice_start = txn->offset / slice_size;
     size_t vslice_end = (txn->offset + txn->length - 1) / slice_size;
 
-    fbl::AutoLock lock(&lock_);
-    if (vslice_start == vslice_end) {
-        // Common case: iotxn occurs within one slice
-        uint32_t pslice = SliceGetLocked(vslice_start);
-        if (pslice == FVM_SLICE_FREE) {
-            iotxn_complete(txn, ZX_ERR_OUT_OF_RANGE, 0);
-            return;
-        }
-        txn->offset = SliceStart(disk_size, slice_size, pslice) +
-                      (txn->offset % slice_size);
-        iotxn_queue(GetParent(), txn);
-        return;
-    }
-
-    // Less common case: iotxn spans multiple slices
+    // Find the runs of physically contiguous slices backing the txn, each of
+    // which can go to the parent as a single txn.
+    struct SliceRun {
+        uint32_t pslice;
+        size_t count;
+    };
+    constexpr size_t kMaxRuns = 32;
+    SliceRun runs[kMaxRuns];
+    size_t run_count = 0;
 
-    // First, check that all slices are allocated.
-    // If any are missing, then this txn will fail.
-    bool contiguous = true;
-    for (size_t vslice = vslice_start; vslice <= vslice_end; vslice++) {
-        if (SliceGetLocked(vslice) == FVM_SLICE_FREE) {
+    fbl::AutoLock lock(&lock_);
+    for (size_t vslice = vslice_start; vslice <= vslice_end;) {
+        const SliceExtent* extent = ExtentGetLocked(vslice);
+        if (extent == nullptr) {
             iotxn_complete(txn, ZX_ERR_OUT_OF_RANGE, 0);
             return;
         }
-        if (vslice != vslice_start && SliceGetLocked(vslice - 1) + 1 != SliceGetLocked(vslice)) {
-            contiguous = false;
+        for (; vslice <= vslice_end && vslice < extent->end(); vslice++) {
+            uint32_t pslice = extent->get(vslice);
+            if (run_count > 0 && runs[run_count - 1].pslice + runs[run_count - 1].count == pslice) {
+                runs[run_count - 1].count++;
+                continue;
+            }
+            if (run_count == kMaxRuns) {
+                iotxn_complete(txn, ZX_ERR_OUT_OF_RANGE, 0);
+                return;
+            }
+            runs[run_count++] = {pslice, 1};
         }
     }
+    merged_slices_ += (vslice_end - vslice_start + 1) - run_count;
 
-    // Ideal case: slices are contiguous
-    if (contiguous) {
-        uint32_t pslice = SliceGetLocked(vslice_start);
-        txn->offset = SliceStart(disk_size, slice_size, pslice) +
+    // Common case: the txn is backed by contiguous slices
+    if (run_count == 1) {
+        txn->offset = SliceStart(disk_size, slice_size, runs[0].pslice) +
                       (txn->offset % slice_size);
         iotxn_queue(GetParent(), txn);
         return;
     }
 
-    // Harder case: Noncontiguous slices
-    constexpr size_t kMaxSlices = 32;
-    iotxn_t* txns[kMaxSlices];
-    const size_t txn_count = vslice_end - vslice_start + 1;
-    if (kMaxSlices < (txn_count)) {
-        iotxn_complete(txn, ZX_ERR_OUT_OF_RANGE, 0);
-        return;
-    }
-
+    // Harder case: noncontiguous slices
+    iotxn_t* txns[kMaxRuns];
     fbl::AllocChecker ac;
-    fbl::unique_ptr<multi_iotxn_state_t> state(new (&ac) multi_iotxn_state_t(txn_count, txn));
+    fbl::unique_ptr<multi_iotxn_state_t> state(new (&ac) multi_iotxn_state_t(run_count, txn));
     if (!ac.check()) {
         iotxn_complete(txn, ZX_ERR_NO_MEMORY, 0);
         return;
     }
 
     size_t length_remaining = txn->length;
-    for (size_t i = 0; i < txn_count; i++) {
-        size_t vslice = vslice_start + i;
-        uint32_t pslice = SliceGetLocked(vslice);
-
-        uint64_t vmo_offset;
-        zx_off_t length;
-        if (vslice == vslice_start) {
-            length = fbl::round_up(txn->offset + 1, slice_size) - txn->offset;
-            vmo_offset = 0;
-        } else if (vslice == vslice_end) {
-            length = length_remaining;
-            vmo_offset = txn->length - length_remaining;
-        } else {
-            length = slice_size;
-            vmo_offset = txns[0]->length + slice_size * (i - 1);
+    for (size_t i = 0; i < run_count; i++) {
+        uint64_t vmo_offset = txn->length - length_remaining;
+        zx_off_t offset = SliceStart(disk_size, slice_size, runs[i].pslice);
+        zx_off_t length = runs[i].count * slice_size;
+        if (i == 0) {
+            offset += txn->offset % slice_size;
+            length -= txn->offset % slice_size;
         }
-        ZX_DEBUG_ASSERT(length <= slice_size);
+        length = fbl::min(length, static_cast<zx_off_t>(length_remaining));
 
         zx_status_t status;
         txns[i] = nullptr;
-        if ((status = iotxn_clone_partial(txn, vmo_offset, length, &txns[i])) != ZX_OK) {
+        if (txn->opcode == IOTXN_OP_TRIM) {
+            // Trims have no data to clone.
+            if ((status = iotxn_alloc(&txns[i], IOTXN_ALLOC_POOL, 0)) == ZX_OK) {
+                txns[i]->opcode = IOTXN_OP_TRIM;
+                txns[i]->flags = txn->flags;
+                txns[i]->length = length;
+            }
+        } else {
+            status = iotxn_clone_partial(txn, vmo_offset, length, &txns[i]);
+        }
+        if (status != ZX_OK) {
             while (i-- > 0) {
                 iotxn_release(txns[i]);
             }
             iotxn_complete(txn, status, 0);
             return;
         }
-        txns[i]->offset = SliceStart(disk_size, slice_size, pslice);
-        if (vslice == vslice_start) {
-            txns[i]->offset += (txn->offset % slice_size);
-        }
+        txns[i]->offset = offset;
         length_remaining -= txns[i]->length;
         txns[i]->complete_cb = multi_iotxn_completion;
         txns[i]->cookie = state.get();
     }
     ZX_DEBUG_ASSERT(length_remaining == 0);
+    split_txns_++;
+    split_parts_ += run_count;
 
-    for (size_t i = 0; i < txn_count; i++) {
+    for (size_t i = 0; i < run_count; i++) {
         iotxn_queue(GetParent(), txns[i]);
     }
     state.release();
@@ -157,7 +157,9 @@ static void mbr_queue(void* ctx, block_op_t* bop) {
 
     switch (bop->command & BLOCK_OP_MASK) {
     case BLOCK_OP_READ:
-    case BLOCK_OP_WRITE: {
+    case BLOCK_OP_WRITE:
+    case BLOCK_OP_TRIM: {
+        // Trims lay out their extent like reads and writes.
         size_t blocks = bop->rw.length;
         size_t max = mbr->partition.sector_partition_length;
 
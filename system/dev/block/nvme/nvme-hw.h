@@ -98,6 +98,10 @@ typedef struct {
             uint32_t eilbrt;
             uint32_t elbat;
         } rw;
+        struct {
+            uint32_t range_count; // minus 1
+            uint32_t attributes;
+        } dsm;
     } u;
 } nvme_cmd_t;
 
@@ -138,6 +142,12 @@ static_assert(sizeof(nvme_cmd_t) == (1 << NVME_CMD_SHIFT), "");
 #define NVME_FEATURE_SEL_SUPPORTED (3 << 8)
 
 #define NVME_FEATURE_NUMBER_OF_QUEUES 0x07
+#define NVME_FEATURE_INTERRUPT_COALESCING 0x08
+#define NVME_FEATURE_INTERRUPT_VECTOR_CONFIG 0x09
+
+#define NVME_COALESCE_THR(n)      (((n) & 0xFF) << 0) // Aggregation Threshold (0's based)
+#define NVME_COALESCE_TIME(n)     (((n) & 0xFF) << 8) // Aggregation Time (100us units)
+#define NVME_IV_CONFIG_CD         (1 << 16)           // Coalescing Disable
 
 
 #define NVME_LBAFMT_RP(n)      (((n) >> 24) & 3)
@@ -148,10 +158,22 @@ static_assert(sizeof(nvme_cmd_t) == (1 << NVME_CMD_SHIFT), "");
 #define NVME_OP_FLUSH       0x00
 #define NVME_OP_WRITE       0x01
 #define NVME_OP_READ        0x02
+#define NVME_OP_DSM         0x09
 
 #define NVME_RW_FLAG_LR     (1 << 15)
 #define NVME_RW_FLAG_FUA    (1 << 14)
 
+#define NVME_DSM_ATTR_AD    (1 << 2) // Deallocate the ranges
+
+// Dataset Management range, of which a command has a list
+typedef struct {
+    uint32_t attributes;    // context attributes
+    uint32_t length;        // in blocks
+    uint64_t start_lba;
+} nvme_dsm_range_t;
+
+static_assert(sizeof(nvme_dsm_range_t) == 16, "");
+
 
 // Identify Page for Controllers
 typedef struct {
@@ -4,6 +4,7 @@
 
 #include <assert.h>
 #include <limits.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -36,12 +37,29 @@
 
 #define TXN_FLAG_FAILED 1
 
+// Interrupt coalescing.  The controller holds back an io queue's
+// interrupt until COALESCE_THRESHOLD completions are waiting or
+// COALESCE_TIME (in 100us units) has passed.  Either set to 0
+// leaves coalescing off.
+#define COALESCE_THRESHOLD 0
+#define COALESCE_TIME 0
+
+// Hybrid polling.  Once an io thread is awake and its queue has at
+// least POLL_MIN_DEPTH commands outstanding, it polls for completions
+// for up to POLL_TIME before going back to waiting for an interrupt.
+// A POLL_TIME of 0 turns polling off.
+#define POLL_MIN_DEPTH 2
+#define POLL_TIME ZX_USEC(20)
+
 typedef struct {
     block_op_t op;
     list_node_t node;
     uint16_t pending_utxns;
     uint8_t opcode;
     uint8_t flags;
+#if WITH_STATS
+    zx_time_t start;
+#endif
 } nvme_txn_t;
 
 typedef struct {
@@ -53,7 +71,9 @@ typedef struct {
     uint32_t reserved1;
 } nvme_utxn_t;
 
-#define UTXN_COUNT 63
+// Upper bound on the utxns of an io queue.  Each one holds a command
+// slot in the submission queue, so this also bounds the queue size.
+#define UTXN_MAX 127
 
 // There's no system constant for this.  Ensure it matches reality.
 #define PAGE_SHIFT 12
@@ -66,36 +86,64 @@ static_assert(PAGE_SIZE == (1 << PAGE_SHIFT), "");
 #define MAX_XFER (1024*1024)
 
 // Maximum submission and completion queue item counts, for
-// queues that are a single page in size.
+// queues that are a single page in size.  The admin queue is
+// always this size.
 #define SQMAX (PAGE_SIZE / sizeof(nvme_cmd_t))
 #define CQMAX (PAGE_SIZE / sizeof(nvme_cpl_t))
 
+// Maximum io queue item count.  A submission queue this size spans
+// several pages.  The controller may support fewer (CAP.MQES).
+#define IOQ_ENTRIES_MAX (UTXN_MAX + 1)
+
+// Upper bound on io queue pairs and interrupts.  Up to one of each
+// is used per cpu.
+#define IOQ_MAX 32
+#define IRQ_MAX IOQ_MAX
+
+// How a completion was noticed, for the latency histograms
+#define CPL_MODE_IRQ   0
+#define CPL_MODE_POLL  1
+#define CPL_MODE_COUNT 2
+
+// Latency histogram buckets, each twice as wide as the last,
+// starting at 1us.  The last bucket holds anything slower.
+#define LAT_BUCKETS 24
+
 // global driver state bits
-#define FLAG_IRQ_THREAD_STARTED  0x0001
-#define FLAG_IO_THREAD_STARTED   0x0002
 #define FLAG_SHUTDOWN            0x0004
 
 #define FLAG_HAS_VWC             0x0100
 
+typedef struct nvme_device nvme_device_t;
+
+// An io submission and completion queue pair, with its own pool of
+// utxns and io thread.
 typedef struct {
-    void* io;
-    zx_handle_t irqh;
-    uint32_t flags;
+    nvme_device_t* nvme;
+    uint16_t id;          // queue id, used for both the sq and cq
+    uint16_t vector;      // index of the interrupt for the cq
+    uint16_t entries;     // item count of the sq and cq
+    uint16_t utxn_count;
+    uint16_t utxn_active;  // utxns with commands in flight
+    bool thread_started;
+
+    // set by nvme_queue() to cut short a poll for completions
+    atomic_bool poll_kick;
+
     mtx_t lock;
 
     // io queue doorbell registers
-    void* io_sq_tail_db;
-    void* io_cq_head_db;
+    void* sq_tail_db;
+    void* cq_head_db;
 
-    nvme_cpl_t* io_cq;
-    nvme_cmd_t* io_sq;
-    uint32_t io_nsid;
-    uint16_t io_cq_head;
-    uint16_t io_cq_toggle;
-    uint16_t io_sq_tail;
-    uint16_t io_sq_head;
+    nvme_cpl_t* cq;
+    nvme_cmd_t* sq;
+    uint16_t cq_head;
+    uint16_t cq_toggle;
+    uint16_t sq_tail;
+    uint16_t sq_head;
 
-    uint64_t utxn_avail;   // bitmask of available utxns
+    uint64_t utxn_avail[(UTXN_MAX + 63) / 64];   // bitmask of available utxns
 
     // The pending list is txns that have been received
     // via nvme_queue() and are waiting for io to start.
@@ -113,6 +161,49 @@ typedef struct {
     // it has work to do.
     completion_t io_signal;
 
+    // pages for the queues, which must each be contiguous,
+    // and for the utxn scatter lists
+    io_buffer_t sq_iob;
+    io_buffer_t cq_iob;
+    io_buffer_t utxn_iob;
+
+    thrd_t iothread;
+
+#if WITH_STATS
+    size_t stat_concur;
+    size_t stat_pending;
+    size_t stat_max_concur;
+    size_t stat_max_pending;
+    size_t stat_total_ops;
+    size_t stat_total_blocks;
+    size_t stat_latency[CPL_MODE_COUNT][LAT_BUCKETS];
+#endif
+
+    // pool of utxns
+    nvme_utxn_t utxn[UTXN_MAX];
+} nvme_ioq_t;
+
+typedef struct {
+    nvme_device_t* nvme;
+    zx_handle_t handle;
+    uint16_t vector;
+    bool thread_started;
+    thrd_t thread;
+} nvme_irq_t;
+
+struct nvme_device {
+    void* io;
+    uint32_t flags;
+    uint64_t cap;
+
+    // io queue pairs, spread over the interrupts
+    nvme_ioq_t* ioq[IOQ_MAX];
+    uint32_t ioq_count;
+    atomic_uint next_ioq;
+
+    nvme_irq_t irq[IRQ_MAX];
+    uint32_t irq_count;
+
     uint32_t max_xfer;
     block_info_t info;
 
@@ -140,33 +231,18 @@ typedef struct {
     size_t iosz;
     zx_handle_t ioh;
 
-    // source of physical pages for queues and admin commands
+    // source of physical pages for admin queues and commands
     io_buffer_t iob;
-
-    thrd_t irqthread;
-    thrd_t iothread;
-
-#if WITH_STATS
-    size_t stat_concur;
-    size_t stat_pending;
-    size_t stat_max_concur;
-    size_t stat_max_pending;
-    size_t stat_total_ops;
-    size_t stat_total_blocks;
-#endif
-
-    // pool of utxns
-    nvme_utxn_t utxn[UTXN_COUNT];
-} nvme_device_t;
+};
 
 #if WITH_STATS
-#define STAT_INC(name) do { nvme->stat_##name++; } while (0)
-#define STAT_DEC(name) do { nvme->stat_##name--; } while (0)
-#define STAT_DEC_IF(name, c) do { if (c) nvme->stat_##name--; } while (0)
-#define STAT_ADD(name, num) do { nvme->stat_##name += num; } while (0)
+#define STAT_INC(name) do { q->stat_##name++; } while (0)
+#define STAT_DEC(name) do { q->stat_##name--; } while (0)
+#define STAT_DEC_IF(name, c) do { if (c) q->stat_##name--; } while (0)
+#define STAT_ADD(name, num) do { q->stat_##name += num; } while (0)
 #define STAT_INC_MAX(name) do { \
-    if (++nvme->stat_##name > nvme->stat_max_##name) { \
-        nvme->stat_max_##name = nvme->stat_##name; \
+    if (++q->stat_##name > q->stat_max_##name) { \
+        q->stat_max_##name = q->stat_##name; \
     }} while (0)
 #else
 #define STAT_INC(name) do { } while (0)
@@ -181,30 +257,35 @@ typedef struct {
 // based on the transfer limits of the controller, etc.  Each utxn has an
 // id associated with it, which is used as the command id for the command
 // queued to the NVME device.  This id is the same as its index into the
-// pool of utxns and the bitmask of free txns, to simplify management.
+// queue's pool of utxns and the bitmask of free txns, to simplify management.
 //
-// We maintain a pool of 63 of these, which is the number of commands
-// that can be submitted to NVME via a single page submit queue.
+// Each io queue has one utxn per command its submission queue can hold,
+// up to UTXN_MAX.
 //
 // The utxns are not protected by locks.  Instead, after initialization,
-// they may only be touched by the io thread, which is responsible for
-// queueing commands and dequeuing completion messages.
-
-static nvme_utxn_t* utxn_get(nvme_device_t* nvme) {
-    uint64_t n = __builtin_ffsll(nvme->utxn_avail);
-    if (n == 0) {
-        return NULL;
-    }
-    n--;
-    nvme->utxn_avail &= ~(1ULL << n);
-    STAT_INC_MAX(concur);
-    return nvme->utxn + n;
+// they may only be touched by their queue's io thread, which is responsible
+// for queueing commands and dequeuing completion messages.
+
+static nvme_utxn_t* utxn_get(nvme_ioq_t* q) {
+    for (unsigned i = 0; i < countof(q->utxn_avail); i++) {
+        uint64_t n = __builtin_ffsll(q->utxn_avail[i]);
+        if (n == 0) {
+            continue;
+        }
+        n--;
+        q->utxn_avail[i] &= ~(1ULL << n);
+        q->utxn_active++;
+        STAT_INC_MAX(concur);
+        return q->utxn + i * 64 + n;
+    }
+    return NULL;
 }
 
-static void utxn_put(nvme_device_t* nvme, nvme_utxn_t* utxn) {
+static void utxn_put(nvme_ioq_t* q, nvme_utxn_t* utxn) {
     uint64_t n = utxn->id;
+    q->utxn_active--;
     STAT_DEC(concur);
-    nvme->utxn_avail |= (1ULL << n);
+    q->utxn_avail[n / 64] |= (1ULL << (n % 64));
 }
 
 static zx_status_t nvme_admin_cq_get(nvme_device_t* nvme, nvme_cpl_t* cpl) {
@@ -243,61 +324,78 @@ static zx_status_t nvme_admin_sq_put(nvme_device_t* nvme, nvme_cmd_t* cmd) {
     return ZX_OK;
 }
 
-static zx_status_t nvme_io_cq_get(nvme_device_t* nvme, nvme_cpl_t* cpl) {
-    if ((readw(&nvme->io_cq[nvme->io_cq_head].status) & 1) != nvme->io_cq_toggle) {
+static inline bool nvme_io_cq_ready(nvme_ioq_t* q) {
+    return (readw(&q->cq[q->cq_head].status) & 1) == q->cq_toggle;
+}
+
+static zx_status_t nvme_io_cq_get(nvme_ioq_t* q, nvme_cpl_t* cpl) {
+    if (!nvme_io_cq_ready(q)) {
         return ZX_ERR_SHOULD_WAIT;
     }
-    *cpl = nvme->io_cq[nvme->io_cq_head];
+    *cpl = q->cq[q->cq_head];
 
-    // advance the head pointer, wrapping and inverting toggle at max
-    uint16_t next = (nvme->io_cq_head + 1) & (CQMAX - 1);
-    if ((nvme->io_cq_head = next) == 0) {
-        nvme->io_cq_toggle ^= 1;
+    // advance the head pointer, wrapping and inverting toggle at max.
+    // io queues need not be a power of two in size.
+    uint16_t next = q->cq_head + 1;
+    if (next == q->entries) {
+        next = 0;
+    }
+    if ((q->cq_head = next) == 0) {
+        q->cq_toggle ^= 1;
     }
 
     // note the new sq head reported by hw
-    nvme->io_sq_head = cpl->sq_head;
+    q->sq_head = cpl->sq_head;
     return ZX_OK;
 }
 
-static void nvme_io_cq_ack(nvme_device_t* nvme) {
+static void nvme_io_cq_ack(nvme_ioq_t* q) {
     // ring the doorbell
-    writel(nvme->io_cq_head, nvme->io_cq_head_db);
+    writel(q->cq_head, q->cq_head_db);
 }
 
-static zx_status_t nvme_io_sq_put(nvme_device_t* nvme, nvme_cmd_t* cmd) {
-    uint16_t next = (nvme->io_sq_tail + 1) & (SQMAX - 1);
+static zx_status_t nvme_io_sq_put(nvme_ioq_t* q, nvme_cmd_t* cmd) {
+    uint16_t next = q->sq_tail + 1;
+    if (next == q->entries) {
+        next = 0;
+    }
 
     // if head+1 == tail: queue is full
-    if (next == nvme->io_sq_head) {
+    if (next == q->sq_head) {
         return ZX_ERR_SHOULD_WAIT;
     }
 
-    nvme->io_sq[nvme->io_sq_tail] = *cmd;
-    nvme->io_sq_tail = next;
+    q->sq[q->sq_tail] = *cmd;
+    q->sq_tail = next;
 
     // ring the doorbell
-    writel(next, nvme->io_sq_tail_db);
+    writel(next, q->sq_tail_db);
     return ZX_OK;
 }
 
 static int irq_thread(void* arg) {
-    nvme_device_t* nvme = arg;
+    nvme_irq_t* irq = arg;
+    nvme_device_t* nvme = irq->nvme;
     for (;;) {
         zx_status_t r;
         uint64_t slots;
-        if ((r = zx_interrupt_wait(nvme->irqh, &slots)) != ZX_OK) {
+        if ((r = zx_interrupt_wait(irq->handle, &slots)) != ZX_OK) {
             zxlogf(ERROR, "nvme: irq wait failed: %d\n", r);
             break;
         }
 
+        // the admin queue shares the first interrupt
         nvme_cpl_t cpl;
-        if (nvme_admin_cq_get(nvme, &cpl) == ZX_OK) {
+        if ((irq->vector == 0) && (nvme_admin_cq_get(nvme, &cpl) == ZX_OK)) {
             nvme->admin_result = cpl;
             completion_signal(&nvme->admin_signal);
         }
 
-        completion_signal(&nvme->io_signal);
+        for (unsigned n = 0; n < nvme->ioq_count; n++) {
+            if (nvme->ioq[n]->vector == irq->vector) {
+                completion_signal(&nvme->ioq[n]->io_signal);
+            }
+        }
     }
     return 0;
 }
@@ -331,10 +429,55 @@ static inline void txn_complete(nvme_txn_t* txn, zx_status_t status) {
     txn->op.completion_cb(&txn->op, status);
 }
 
+// Queue the single deallocate command of a trim txn.  It moves no
+// data, so the utxn's scatter page holds the range list instead.
+// Returns true if there was no utxn for it.
+static bool io_process_trim(nvme_ioq_t* q, nvme_txn_t* txn) {
+    nvme_utxn_t* utxn = utxn_get(q);
+    if (utxn == NULL) {
+        return true;
+    }
+
+    nvme_dsm_range_t* range = utxn->virt;
+    memset(range, 0, sizeof(*range));
+    range->length = txn->op.trim.length;
+    range->start_lba = txn->op.trim.offset_dev;
+
+    nvme_cmd_t cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.cmd = NVME_CMD_CID(utxn->id) | NVME_CMD_PRP | NVME_CMD_NORMAL | NVME_CMD_OPC(NVME_OP_DSM);
+    cmd.nsid = 1;
+    cmd.dptr.prp[0] = utxn->phys;
+    cmd.u.dsm.range_count = 0;
+    cmd.u.dsm.attributes = NVME_DSM_ATTR_AD;
+
+    zxlogf(TRACE, "nvme: txn=%p utxn id=%u op=DSM\n", txn, utxn->id);
+
+    if (nvme_io_sq_put(q, &cmd) != ZX_OK) {
+        zxlogf(ERROR, "nvme: could not submit cmd (txn=%p id=%u)\n", txn, utxn->id);
+        utxn_put(q, utxn);
+        txn_complete(txn, ZX_ERR_INTERNAL);
+        return false;
+    }
+
+    utxn->txn = txn;
+    txn->op.trim.length = 0;
+    txn->pending_utxns++;
+    mtx_lock(&q->lock);
+    list_add_tail(&q->active_txns, &txn->node);
+    mtx_unlock(&q->lock);
+    return false;
+}
+
 // Attempt to generate utxns and queue nvme commands for a txn
 // Returns true if this could not be completed due to temporary
 // lack of resources or false if either it succeeded or errored out.
-static bool io_process_txn(nvme_device_t* nvme, nvme_txn_t* txn) {
+static bool io_process_txn(nvme_ioq_t* q, nvme_txn_t* txn) {
+    if (txn->opcode == NVME_OP_DSM) {
+        return io_process_trim(q, txn);
+    }
+
+    nvme_device_t* nvme = q->nvme;
     zx_handle_t vmo = txn->op.rw.vmo;
     nvme_utxn_t* utxn;
     zx_status_t r;
@@ -342,7 +485,7 @@ static bool io_process_txn(nvme_device_t* nvme, nvme_txn_t* txn) {
     for (;;) {
         // If there are no available utxns, we can't proceed
         // and we tell the caller to retain the txn (true)
-        if ((utxn = utxn_get(nvme)) == NULL) {
+        if ((utxn = utxn_get(q)) == NULL) {
             return true;
         }
 
@@ -353,23 +496,27 @@ static bool io_process_txn(nvme_device_t* nvme, nvme_txn_t* txn) {
 
         size_t bytes = ((size_t) blocks) * ((size_t) nvme->info.block_size);
 
-        if ((r = zx_vmo_op_range(vmo, ZX_VMO_OP_COMMIT,
-                                 txn->op.rw.offset_vmo, bytes, NULL, 0)) != ZX_OK) {
-            zxlogf(ERROR, "nvme: could not commit pages\n");
-            break;
-        }
-
-        zx_paddr_t* pages = utxn->virt;
-        if ((r = zx_vmo_op_range(vmo, ZX_VMO_OP_LOOKUP,
-                                 txn->op.rw.offset_vmo, bytes, pages, PAGE_SIZE)) != ZX_OK) {
-            zxlogf(ERROR, "nvme: could not lookup pages\n");
-            break;
-        }
-
         // Take the starting byte into the initial page plus total bytes
         // transferred, convert to page count (rounded up)
         size_t pagecount = ((txn->op.rw.offset_vmo & PAGE_MASK) + bytes + PAGE_MASK) / PAGE_SIZE;
 
+        zx_paddr_t* pages = utxn->virt;
+        if (txn->op.rw.pages != NULL) {
+            // The vmo is already committed and the caller looked its pages up
+            memcpy(pages, txn->op.rw.pages, pagecount * sizeof(zx_paddr_t));
+        } else {
+            if ((r = zx_vmo_op_range(vmo, ZX_VMO_OP_COMMIT,
+                                     txn->op.rw.offset_vmo, bytes, NULL, 0)) != ZX_OK) {
+                zxlogf(ERROR, "nvme: could not commit pages\n");
+                break;
+            }
+            if ((r = zx_vmo_op_range(vmo, ZX_VMO_OP_LOOKUP,
+                                     txn->op.rw.offset_vmo, bytes, pages, PAGE_SIZE)) != ZX_OK) {
+                zxlogf(ERROR, "nvme: could not lookup pages\n");
+                break;
+            }
+        }
+
         nvme_cmd_t cmd;
         memset(&cmd, 0, sizeof(cmd));
         cmd.cmd = NVME_CMD_CID(utxn->id) | NVME_CMD_PRP | NVME_CMD_NORMAL | NVME_CMD_OPC(txn->opcode);
@@ -393,7 +540,7 @@ static bool io_process_txn(nvme_device_t* nvme, nvme_txn_t* txn) {
         zxlogf(SPEW, "nvme: pages[] = { %016zx, %016zx, %016zx, %016zx, ... }\n",
                pages[0], pages[1], pages[2], pages[3]);
 
-        if ((r = nvme_io_sq_put(nvme, &cmd)) != ZX_OK) {
+        if ((r = nvme_io_sq_put(q, &cmd)) != ZX_OK) {
             zxlogf(ERROR, "nvme: could not submit cmd (txn=%p id=%u)\n", txn, utxn->id);
             break;
         }
@@ -401,6 +548,10 @@ static bool io_process_txn(nvme_device_t* nvme, nvme_txn_t* txn) {
         utxn->txn = txn;
 
         // keep track of where we are
+        if (txn->op.rw.pages != NULL) {
+            txn->op.rw.pages += ((txn->op.rw.offset_vmo + bytes) / PAGE_SIZE) -
+                                (txn->op.rw.offset_vmo / PAGE_SIZE);
+        }
         txn->op.rw.offset_dev += blocks;
         txn->op.rw.offset_vmo += bytes;
         txn->op.rw.length -= blocks;
@@ -410,25 +561,25 @@ static bool io_process_txn(nvme_device_t* nvme, nvme_txn_t* txn) {
         // move this txn to the active list and tell the
         // caller not to retain the txn (false)
         if (txn->op.rw.length == 0) {
-            mtx_lock(&nvme->lock);
-            list_add_tail(&nvme->active_txns, &txn->node);
-            mtx_unlock(&nvme->lock);
+            mtx_lock(&q->lock);
+            list_add_tail(&q->active_txns, &txn->node);
+            mtx_unlock(&q->lock);
             return false;
         }
     }
 
     // failure
-    utxn_put(nvme, utxn);
+    utxn_put(q, utxn);
 
-    mtx_lock(&nvme->lock);
+    mtx_lock(&q->lock);
     txn->flags |= TXN_FLAG_FAILED;
     if (txn->pending_utxns) {
         // if there are earlier uncompleted IOs we become active now
         // and will finish erroring out when they complete
-        list_add_tail(&nvme->active_txns, &txn->node);
+        list_add_tail(&q->active_txns, &txn->node);
         txn = NULL;
     }
-    mtx_unlock(&nvme->lock);
+    mtx_unlock(&q->lock);
 
     if (txn != NULL) {
         txn_complete(txn, ZX_ERR_INTERNAL);
@@ -438,42 +589,53 @@ static bool io_process_txn(nvme_device_t* nvme, nvme_txn_t* txn) {
     return false;
 }
 
-static void io_process_txns(nvme_device_t* nvme) {
+static void io_process_txns(nvme_ioq_t* q) {
     nvme_txn_t* txn;
 
     for (;;) {
-        mtx_lock(&nvme->lock);
-        txn = list_remove_head_type(&nvme->pending_txns, nvme_txn_t, node);
+        mtx_lock(&q->lock);
+        txn = list_remove_head_type(&q->pending_txns, nvme_txn_t, node);
         STAT_DEC_IF(pending, txn != NULL);
-        mtx_unlock(&nvme->lock);
+        mtx_unlock(&q->lock);
 
         if (txn == NULL) {
             return;
         }
 
-        if (io_process_txn(nvme, txn)) {
+        if (io_process_txn(q, txn)) {
             // put txn back at front of queue for further processing later
-            mtx_lock(&nvme->lock);
-            list_add_head(&nvme->pending_txns, &txn->node);
+            mtx_lock(&q->lock);
+            list_add_head(&q->pending_txns, &txn->node);
             STAT_INC_MAX(pending);
-            mtx_unlock(&nvme->lock);
+            mtx_unlock(&q->lock);
             return;
         }
     }
 }
 
-static void io_process_cpls(nvme_device_t* nvme) {
+#if WITH_STATS
+static void stat_latency(nvme_ioq_t* q, nvme_txn_t* txn, int mode) {
+    zx_duration_t usec = (zx_time_get(ZX_CLOCK_MONOTONIC) - txn->start) / ZX_USEC(1);
+    unsigned bucket = (usec == 0) ? 0 : 64 - __builtin_clzll(usec);
+    if (bucket >= LAT_BUCKETS) {
+        bucket = LAT_BUCKETS - 1;
+    }
+    q->stat_latency[mode][bucket]++;
+}
+#endif
+
+static void io_process_cpls(nvme_ioq_t* q, int mode) {
     bool ring_doorbell = false;
     nvme_cpl_t cpl;
 
-    while (nvme_io_cq_get(nvme, &cpl) == ZX_OK) {
+    while (nvme_io_cq_get(q, &cpl) == ZX_OK) {
         ring_doorbell = true;
 
-        if (cpl.cmd_id >= UTXN_COUNT) {
-            zxlogf(ERROR, "nvme: unexpected cmd id %u\n", cpl.cmd_id);
+        if (cpl.cmd_id >= q->utxn_count) {
+            zxlogf(ERROR, "nvme: queue %u: unexpected cmd id %u\n", q->id, cpl.cmd_id);
             continue;
         }
-        nvme_utxn_t* utxn = nvme->utxn + cpl.cmd_id;
+        nvme_utxn_t* utxn = q->utxn + cpl.cmd_id;
         nvme_txn_t* txn = utxn->txn;
 
         if (txn == NULL) {
@@ -495,43 +657,69 @@ static void io_process_cpls(nvme_device_t* nvme) {
 
         // release the microtransaction
         utxn->txn = NULL;
-        utxn_put(nvme, utxn);
+        utxn_put(q, utxn);
 
         txn->pending_utxns--;
         if ((txn->pending_utxns == 0) && (txn->op.rw.length == 0)) {
             // remove from either pending or active list
-            mtx_lock(&nvme->lock);
+            mtx_lock(&q->lock);
             list_delete(&txn->node);
-            mtx_unlock(&nvme->lock);
+            mtx_unlock(&q->lock);
             zxlogf(TRACE, "nvme: txn %p %s\n", txn, txn->flags & TXN_FLAG_FAILED ? "error" : "okay");
+#if WITH_STATS
+            stat_latency(q, txn, mode);
+#endif
             txn_complete(txn, txn->flags & TXN_FLAG_FAILED ? ZX_ERR_IO : ZX_OK);
         }
     }
 
     if (ring_doorbell) {
-        nvme_io_cq_ack(nvme);
+        nvme_io_cq_ack(q);
+    }
+}
+
+// While enough commands are in flight that another completion is
+// likely soon, spin on the completion queue's phase bit instead of
+// paying for an interrupt and wakeup.  Returns true if there are
+// completions or new txns to process.
+static bool io_poll(nvme_ioq_t* q) {
+    if ((POLL_TIME == 0) || (q->utxn_active < POLL_MIN_DEPTH)) {
+        return false;
     }
+    zx_time_t deadline = zx_time_get(ZX_CLOCK_MONOTONIC) + POLL_TIME;
+    do {
+        if (nvme_io_cq_ready(q) ||
+            atomic_exchange_explicit(&q->poll_kick, false, memory_order_relaxed)) {
+            return true;
+        }
+    } while (zx_time_get(ZX_CLOCK_MONOTONIC) < deadline);
+    return false;
 }
 
 static int io_thread(void* arg) {
-    nvme_device_t* nvme = arg;
+    nvme_ioq_t* q = arg;
     for (;;) {
-        if (completion_wait(&nvme->io_signal, ZX_TIME_INFINITE)) {
+        if (completion_wait(&q->io_signal, ZX_TIME_INFINITE)) {
             break;
         }
-        if (nvme->flags & FLAG_SHUTDOWN) {
+        if (q->nvme->flags & FLAG_SHUTDOWN) {
             //TODO: cancel out pending IO
-            zxlogf(INFO, "nvme: io thread exiting\n");
+            zxlogf(INFO, "nvme: io thread %u exiting\n", q->id);
             break;
         }
 
-        completion_reset(&nvme->io_signal);
+        completion_reset(&q->io_signal);
+
+        int mode = CPL_MODE_IRQ;
+        do {
+            // process completion messages
+            io_process_cpls(q, mode);
 
-        // process completion messages
-        io_process_cpls(nvme);
+            // process work queue
+            io_process_txns(q);
 
-        // process work queue
-        io_process_txns(nvme);
+            mode = CPL_MODE_POLL;
+        } while (io_poll(q));
 
     }
     return 0;
@@ -548,6 +736,13 @@ static void nvme_queue(void* ctx, block_op_t* op) {
     case BLOCK_OP_WRITE:
         txn->opcode = NVME_OP_WRITE;
         break;
+    case BLOCK_OP_TRIM:
+        if (!(nvme->info.flags & BLOCK_FLAG_TRIM_SUPPORT)) {
+            txn_complete(txn, ZX_ERR_NOT_SUPPORTED);
+            return;
+        }
+        txn->opcode = NVME_OP_DSM;
+        break;
     case BLOCK_OP_FLUSH:
         // TODO
         txn_complete(txn, ZX_OK);
@@ -557,30 +752,43 @@ static void nvme_queue(void* ctx, block_op_t* op) {
         return;
     }
 
+    // trims share the length field with reads and writes
     if (txn->op.rw.length == 0) {
         txn_complete(txn, ZX_ERR_INVALID_ARGS);
         return;
     }
 
-    // convert vmo offset to a byte offset
-    txn->op.rw.offset_vmo *= nvme->info.block_size;
+    if (txn->opcode != NVME_OP_DSM) {
+        // convert vmo offset to a byte offset
+        txn->op.rw.offset_vmo *= nvme->info.block_size;
+    }
 
     txn->pending_utxns = 0;
     txn->flags = 0;
+#if WITH_STATS
+    txn->start = zx_time_get(ZX_CLOCK_MONOTONIC);
+#endif
 
     zxlogf(SPEW, "nvme: io: %s: %ublks @ blk#%zu\n",
-           txn->opcode == NVME_OP_WRITE ? "wr" : "rd",
+           txn->opcode == NVME_OP_WRITE ? "wr" : txn->opcode == NVME_OP_DSM ? "trim" : "rd",
            txn->op.rw.length + 1U, txn->op.rw.offset_dev);
 
-    STAT_INC(total_ops);
-    STAT_ADD(total_blocks, txn->op.rw.length);
+    // Spread txns over the io queues, so that concurrent clients are
+    // submitted and completed by different threads and interrupts.
+    unsigned n = atomic_fetch_add_explicit(&nvme->next_ioq, 1, memory_order_relaxed);
+    nvme_ioq_t* q = nvme->ioq[n % nvme->ioq_count];
 
-    mtx_lock(&nvme->lock);
-    list_add_tail(&nvme->pending_txns, &txn->node);
+    mtx_lock(&q->lock);
+    STAT_INC(total_ops);
+    if (txn->opcode != NVME_OP_DSM) {
+        STAT_ADD(total_blocks, txn->op.rw.length);
+    }
+    list_add_tail(&q->pending_txns, &txn->node);
     STAT_INC_MAX(pending);
-    mtx_unlock(&nvme->lock);
+    mtx_unlock(&q->lock);
 
-    completion_signal(&nvme->io_signal);
+    atomic_store_explicit(&q->poll_kick, true, memory_order_relaxed);
+    completion_signal(&q->io_signal);
 }
 
 static void nvme_query(void* ctx, block_info_t* info_out, size_t* block_op_size_out) {
@@ -588,10 +796,23 @@ static void nvme_query(void* ctx, block_info_t* info_out, size_t* block_op_size_
     *info_out = nvme->info;
     *block_op_size_out = sizeof(nvme_txn_t);
 #if WITH_STATS
-    zxlogf(INFO, "nvme: stats: max concurrent utxns:   %zu\n", nvme->stat_max_concur);
-    zxlogf(INFO, "nvme: stats: max pending txns:       %zu\n", nvme->stat_max_pending);
-    zxlogf(INFO, "nvme: stats: total submitted txns:   %zu\n", nvme->stat_total_ops);
-    zxlogf(INFO, "nvme: stats: total submitted blocks:  %zu\n", nvme->stat_total_blocks);
+    for (unsigned n = 0; n < nvme->ioq_count; n++) {
+        nvme_ioq_t* q = nvme->ioq[n];
+        zxlogf(INFO, "nvme: stats: queue %u:\n", q->id);
+        zxlogf(INFO, "nvme: stats: max concurrent utxns:   %zu\n", q->stat_max_concur);
+        zxlogf(INFO, "nvme: stats: max pending txns:       %zu\n", q->stat_max_pending);
+        zxlogf(INFO, "nvme: stats: total submitted txns:   %zu\n", q->stat_total_ops);
+        zxlogf(INFO, "nvme: stats: total submitted blocks:  %zu\n", q->stat_total_blocks);
+        static const char* mode_name[CPL_MODE_COUNT] = { "irq", "poll" };
+        for (unsigned m = 0; m < CPL_MODE_COUNT; m++) {
+            for (unsigned b = 0; b < LAT_BUCKETS; b++) {
+                if (q->stat_latency[m][b] != 0) {
+                    zxlogf(INFO, "nvme: stats: %s latency < %8lluus: %zu\n", mode_name[m],
+                           1ULL << b, q->stat_latency[m][b]);
+                }
+            }
+        }
+    }
 #endif
 }
 
@@ -644,26 +865,39 @@ static void nvme_release(void* ctx) {
         zx_handle_close(nvme->ioh);
         // TODO: risks a handle use-after-close, will be resolved by IRQ api
         // changes coming soon
-        zx_handle_close(nvme->irqh);
-    }
-    if (nvme->flags & FLAG_IRQ_THREAD_STARTED) {
-        thrd_join(nvme->irqthread, &r);
+        for (unsigned n = 0; n < nvme->irq_count; n++) {
+            zx_handle_close(nvme->irq[n].handle);
+        }
     }
-    if (nvme->flags & FLAG_IO_THREAD_STARTED) {
-        completion_signal(&nvme->io_signal);
-        thrd_join(nvme->iothread, &r);
+    for (unsigned n = 0; n < nvme->irq_count; n++) {
+        if (nvme->irq[n].thread_started) {
+            thrd_join(nvme->irq[n].thread, &r);
+        }
     }
 
-    // error out any pending txns
-    mtx_lock(&nvme->lock);
-    nvme_txn_t* txn;
-    while ((txn = list_remove_head_type(&nvme->active_txns, nvme_txn_t, node)) != NULL) {
-        txn_complete(txn, ZX_ERR_PEER_CLOSED);
-    }
-    while ((txn = list_remove_head_type(&nvme->pending_txns, nvme_txn_t, node)) != NULL) {
-        txn_complete(txn, ZX_ERR_PEER_CLOSED);
+    for (unsigned n = 0; n < nvme->ioq_count; n++) {
+        nvme_ioq_t* q = nvme->ioq[n];
+        if (q->thread_started) {
+            completion_signal(&q->io_signal);
+            thrd_join(q->iothread, &r);
+        }
+
+        // error out any pending txns
+        mtx_lock(&q->lock);
+        nvme_txn_t* txn;
+        while ((txn = list_remove_head_type(&q->active_txns, nvme_txn_t, node)) != NULL) {
+            txn_complete(txn, ZX_ERR_PEER_CLOSED);
+        }
+        while ((txn = list_remove_head_type(&q->pending_txns, nvme_txn_t, node)) != NULL) {
+            txn_complete(txn, ZX_ERR_PEER_CLOSED);
+        }
+        mtx_unlock(&q->lock);
+
+        io_buffer_release(&q->sq_iob);
+        io_buffer_release(&q->cq_iob);
+        io_buffer_release(&q->utxn_iob);
+        free(q);
     }
-    mtx_unlock(&nvme->lock);
 
     io_buffer_release(&nvme->iob);
     free(nvme);
@@ -714,12 +948,9 @@ static void infostring(const char* prefix, uint8_t* str, size_t len) {
 // dedicated pages from the page pool
 #define IDX_ADMIN_SQ   0
 #define IDX_ADMIN_CQ   1
-#define IDX_IO_SQ      2
-#define IDX_IO_CQ      3
-#define IDX_SCRATCH    4
-#define IDX_UTXN_POOL  5 // this must always be last
+#define IDX_SCRATCH    2
 
-#define IO_PAGE_COUNT  (IDX_UTXN_POOL + UTXN_COUNT)
+#define IO_PAGE_COUNT  (IDX_SCRATCH + 1)
 
 static inline uint64_t U64(uint8_t* x) {
     return *((uint64_t*) (void*) x);
@@ -733,9 +964,95 @@ static inline uint32_t U16(uint8_t* x) {
 
 #define WAIT_MS 5000
 
+// Allocates io queue pair |id|, has the controller create it, and
+// starts its io thread.
+static zx_status_t nvme_ioq_create(nvme_device_t* nvme, uint16_t id, uint16_t vector,
+                                   uint16_t entries) {
+    nvme_ioq_t* q;
+    if ((q = calloc(1, sizeof(nvme_ioq_t))) == NULL) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    q->nvme = nvme;
+    q->id = id;
+    q->vector = vector;
+    q->entries = entries;
+    q->utxn_count = entries - 1;
+    list_initialize(&q->pending_txns);
+    list_initialize(&q->active_txns);
+    mtx_init(&q->lock, mtx_plain);
+
+    // from here on the queue is torn down by nvme_release()
+    nvme->ioq[nvme->ioq_count++] = q;
+
+    if (io_buffer_init(&q->sq_iob, entries * sizeof(nvme_cmd_t),
+                       IO_BUFFER_RW | IO_BUFFER_CONTIG) ||
+        io_buffer_init(&q->cq_iob, entries * sizeof(nvme_cpl_t),
+                       IO_BUFFER_RW | IO_BUFFER_CONTIG) ||
+        io_buffer_init(&q->utxn_iob, PAGE_SIZE * q->utxn_count, IO_BUFFER_RW) ||
+        io_buffer_physmap(&q->utxn_iob)) {
+        zxlogf(ERROR, "nvme: could not allocate io buffers for queue %u\n", id);
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    // initialize the microtransaction pool
+    for (unsigned n = 0; n < q->utxn_count; n++) {
+        q->utxn[n].id = n;
+        q->utxn[n].phys = q->utxn_iob.phys_list[n];
+        q->utxn[n].virt = q->utxn_iob.virt + n * PAGE_SIZE;
+        q->utxn_avail[n / 64] |= 1ULL << (n % 64);
+    }
+
+    // registers and buffers for the queues
+    q->sq_tail_db = nvme->io + NVME_REG_SQnTDBL(id, nvme->cap);
+    q->cq_head_db = nvme->io + NVME_REG_CQnHDBL(id, nvme->cap);
+
+    q->sq = io_buffer_virt(&q->sq_iob);
+    q->sq_head = 0;
+    q->sq_tail = 0;
+
+    q->cq = io_buffer_virt(&q->cq_iob);
+    q->cq_head = 0;
+    q->cq_toggle = 1;
+
+    // create the IO completion queue
+    nvme_cmd_t cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.cmd = NVME_CMD_CID(0) | NVME_CMD_PRP | NVME_CMD_NORMAL | NVME_CMD_OPC(NVME_ADMIN_OP_CREATE_IOCQ);
+    cmd.dptr.prp[0] = io_buffer_phys(&q->cq_iob);
+    cmd.u.raw[0] = ((entries - 1) << 16) | id; // queue size, queue id
+    cmd.u.raw[1] = (vector << 16) | 2 | 1; // irq vector, irq enable, phys contig
+
+    if (nvme_admin_txn(nvme, &cmd, NULL) != ZX_OK) {
+        zxlogf(ERROR, "nvme: completion queue %u creation op failed\n", id);
+        return ZX_ERR_INTERNAL;
+    }
+
+    // create the IO submit queue
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.cmd = NVME_CMD_CID(0) | NVME_CMD_PRP | NVME_CMD_NORMAL | NVME_CMD_OPC(NVME_ADMIN_OP_CREATE_IOSQ);
+    cmd.dptr.prp[0] = io_buffer_phys(&q->sq_iob);
+    cmd.u.raw[0] = ((entries - 1) << 16) | id; // queue size, queue id
+    cmd.u.raw[1] = (id << 16) | 0 | 1; // cqid, qprio, phys contig
+
+    if (nvme_admin_txn(nvme, &cmd, NULL) != ZX_OK) {
+        zxlogf(ERROR, "nvme: submit queue %u creation op failed\n", id);
+        return ZX_ERR_INTERNAL;
+    }
+
+    char name[ZX_MAX_NAME_LEN];
+    snprintf(name, sizeof(name), "nvme-io-thread-%u", id);
+    if (thrd_create_with_name(&q->iothread, io_thread, q, name)) {
+        zxlogf(ERROR, "nvme; cannot create io thread\n");
+        return ZX_ERR_INTERNAL;
+    }
+    q->thread_started = true;
+    return ZX_OK;
+}
+
 static zx_status_t nvme_init(nvme_device_t* nvme) {
     uint32_t n = rd32(VS);
     uint64_t cap = rd64(CAP);
+    nvme->cap = cap;
 
     zxlogf(INFO, "nvme: version %d.%d.%d\n", n >> 16, (n >> 8) & 0xFF, n & 0xFF);
     zxlogf(INFO, "nvme: page size: (MPSMIN): %u (MPSMAX): %u\n",
@@ -755,21 +1072,13 @@ static zx_status_t nvme_init(nvme_device_t* nvme) {
         zxlogf(ERROR, "nvme: minimum page size larger than platform page size\n");
         return ZX_ERR_NOT_SUPPORTED;
     }
-    // allocate pages for various queues and the utxn scatter lists
+    // allocate pages for the admin queues and commands
     if (io_buffer_init(&nvme->iob, PAGE_SIZE * IO_PAGE_COUNT, IO_BUFFER_RW) ||
         io_buffer_physmap(&nvme->iob)) {
         zxlogf(ERROR, "nvme: could not allocate io buffers\n");
         return ZX_ERR_NO_MEMORY;
     }
 
-    // initialize the microtransaction pool
-    nvme->utxn_avail = 0x7FFFFFFFFFFFFFFFULL;
-    for (unsigned n = 0; n < UTXN_COUNT; n++) {
-        nvme->utxn[n].id = n;
-        nvme->utxn[n].phys = nvme->iob.phys_list[IDX_UTXN_POOL + n];
-        nvme->utxn[n].virt = nvme->iob.virt + (IDX_UTXN_POOL + n) * PAGE_SIZE;
-    }
-
     if (rd32(CSTS) & NVME_CSTS_RDY) {
         zxlogf(INFO, "nvme: controller is active. resetting...\n");
         wr32(rd32(CC) & ~NVME_CC_EN, CC); // disable
@@ -819,32 +1128,18 @@ static zx_status_t nvme_init(nvme_device_t* nvme) {
     nvme->admin_cq_head = 0;
     nvme->admin_cq_toggle = 1;
 
-    // registers and buffers for IO queues
-    nvme->io_sq_tail_db = nvme->io + NVME_REG_SQnTDBL(1, cap);
-    nvme->io_cq_head_db = nvme->io + NVME_REG_CQnHDBL(1, cap);
-
-    nvme->io_sq = nvme->iob.virt + PAGE_SIZE * IDX_IO_SQ;
-    nvme->io_sq_head = 0;
-    nvme->io_sq_tail = 0;
-
-    nvme->io_cq = nvme->iob.virt + PAGE_SIZE * IDX_IO_CQ;
-    nvme->io_cq_head = 0;
-    nvme->io_cq_toggle = 1;
-
     // scratch page for admin ops
     void* scratch = nvme->iob.virt + PAGE_SIZE * IDX_SCRATCH;
 
-    if (thrd_create_with_name(&nvme->irqthread, irq_thread, nvme, "nvme-irq-thread")) {
-        zxlogf(ERROR, "nvme; cannot create irq thread\n");
-        return ZX_ERR_INTERNAL;
-    }
-    nvme->flags |= FLAG_IRQ_THREAD_STARTED;
-
-    if (thrd_create_with_name(&nvme->iothread, io_thread, nvme, "nvme-io-thread")) {
-        zxlogf(ERROR, "nvme; cannot create io thread\n");
-        return ZX_ERR_INTERNAL;
+    for (unsigned n = 0; n < nvme->irq_count; n++) {
+        char name[ZX_MAX_NAME_LEN];
+        snprintf(name, sizeof(name), "nvme-irq-thread-%u", n);
+        if (thrd_create_with_name(&nvme->irq[n].thread, irq_thread, &nvme->irq[n], name)) {
+            zxlogf(ERROR, "nvme; cannot create irq thread\n");
+            return ZX_ERR_INTERNAL;
+        }
+        nvme->irq[n].thread_started = true;
     }
-    nvme->flags |= FLAG_IO_THREAD_STARTED;
 
     nvme_cmd_t cmd;
 
@@ -919,44 +1214,73 @@ static zx_status_t nvme_init(nvme_device_t* nvme) {
     FEATURE(ONCS, TIMESTAMP);
     FEATURE(ONCS, RESERVATIONS);
     FEATURE(ONCS, SAVE_SELECT_NONZERO);
+    FEATURE(ONCS, DATASET_MANAGEMENT);
     FEATURE(ONCS, WRITE_UNCORRECTABLE);
     FEATURE(ONCS, COMPARE);
 
-    // set feature (number of queues) to 1 iosq and 1 iocq
+    // trims are sent as dataset management deallocates
+    if (ci->ONCS & ONCS_DATASET_MANAGEMENT) {
+        nvme->info.flags |= BLOCK_FLAG_TRIM_SUPPORT;
+    }
+
+    // ask for one io queue pair per cpu, as far as we have interrupts for
+    uint32_t want = zx_system_get_num_cpus();
+    if (want > nvme->irq_count) {
+        want = nvme->irq_count;
+    }
+
+    // set feature (number of queues), in 0's based counts of iosqs and iocqs
     memset(&cmd, 0, sizeof(cmd));
     cmd.cmd = NVME_CMD_CID(0) | NVME_CMD_PRP | NVME_CMD_NORMAL | NVME_CMD_OPC(NVME_ADMIN_OP_SET_FEATURE);
     cmd.u.raw[0] = NVME_FEATURE_NUMBER_OF_QUEUES;
-    cmd.u.raw[1] = 0;
+    cmd.u.raw[1] = ((want - 1) << 16) | (want - 1);
 
     nvme_cpl_t cpl;
     if (nvme_admin_txn(nvme, &cmd, &cpl) != ZX_OK) {
         zxlogf(ERROR, "nvme: set feature (number queues) op failed\n");
         return ZX_ERR_INTERNAL;
     }
-    zxlogf(INFO,"cpl.cmd %08x\n", cpl.cmd);
 
-    // create the IO completion queue
-    memset(&cmd, 0, sizeof(cmd));
-    cmd.cmd = NVME_CMD_CID(0) | NVME_CMD_PRP | NVME_CMD_NORMAL | NVME_CMD_OPC(NVME_ADMIN_OP_CREATE_IOCQ);
-    cmd.dptr.prp[0] = nvme->iob.phys_list[IDX_IO_CQ];
-    cmd.u.raw[0] = ((CQMAX - 1) << 16) | 1; // queue size, queue id
-    cmd.u.raw[1] = (0 << 16) | 2 | 1; // irq vector, irq enable, phys contig
+    // the controller may allocate more or fewer than asked for
+    uint32_t nsqa = (cpl.cmd & 0xFFFF) + 1;
+    uint32_t ncqa = (cpl.cmd >> 16) + 1;
+    zxlogf(INFO, "nvme: io queues allocated: %u sq / %u cq\n", nsqa, ncqa);
+    uint32_t ioq_count = want;
+    if (ioq_count > nsqa) {
+        ioq_count = nsqa;
+    }
+    if (ioq_count > ncqa) {
+        ioq_count = ncqa;
+    }
 
-    if (nvme_admin_txn(nvme, &cmd, NULL) != ZX_OK) {
-        zxlogf(ERROR, "nvme: completion queue creation op failed\n");
-        return ZX_ERR_INTERNAL;
+    // queues may span several pages, as far as the controller allows
+    uint32_t entries = NVME_CAP_MQES(cap) + 1;
+    if (entries > IOQ_ENTRIES_MAX) {
+        entries = IOQ_ENTRIES_MAX;
     }
+    zxlogf(INFO, "nvme: using %u io queues of %u entries\n", ioq_count, entries);
 
-    // create the IO submit queue
-    memset(&cmd, 0, sizeof(cmd));
-    cmd.cmd = NVME_CMD_CID(0) | NVME_CMD_PRP | NVME_CMD_NORMAL | NVME_CMD_OPC(NVME_ADMIN_OP_CREATE_IOSQ);
-    cmd.dptr.prp[0] = nvme->iob.phys_list[IDX_IO_SQ];
-    cmd.u.raw[0] = ((SQMAX - 1) << 16) | 1; // queue size, queue id
-    cmd.u.raw[1] = (1 << 16) | 0 | 1; // cqid, qprio, phys contig
+    // the first queue shares the first interrupt with the admin queue
+    for (unsigned n = 0; n < ioq_count; n++) {
+        zx_status_t r = nvme_ioq_create(nvme, n + 1, n % nvme->irq_count, entries);
+        if (r != ZX_OK) {
+            return r;
+        }
+    }
 
-    if (nvme_admin_txn(nvme, &cmd, NULL) != ZX_OK) {
-        zxlogf(ERROR, "nvme: submit queue creation op failed\n");
-        return ZX_ERR_INTERNAL;
+    if ((COALESCE_THRESHOLD != 0) && (COALESCE_TIME != 0)) {
+        // set feature (interrupt coalescing), which applies to every io
+        // queue interrupt unless disabled for the vector
+        memset(&cmd, 0, sizeof(cmd));
+        cmd.cmd = NVME_CMD_CID(0) | NVME_CMD_PRP | NVME_CMD_NORMAL | NVME_CMD_OPC(NVME_ADMIN_OP_SET_FEATURE);
+        cmd.u.raw[0] = NVME_FEATURE_INTERRUPT_COALESCING;
+        cmd.u.raw[1] = NVME_COALESCE_THR(COALESCE_THRESHOLD - 1) | NVME_COALESCE_TIME(COALESCE_TIME);
+        if (nvme_admin_txn(nvme, &cmd, NULL) != ZX_OK) {
+            zxlogf(ERROR, "nvme: set feature (interrupt coalescing) op failed\n");
+        } else {
+            zxlogf(INFO, "nvme: interrupt coalescing: %u cpls / %u us\n",
+                   COALESCE_THRESHOLD, COALESCE_TIME * 100);
+        }
     }
 
     // identify namespace 1
@@ -1040,9 +1364,6 @@ static zx_status_t nvme_bind(void* ctx, zx_device_t* dev) {
     if ((nvme = calloc(1, sizeof(nvme_device_t))) == NULL) {
         return ZX_ERR_NO_MEMORY;
     }
-    list_initialize(&nvme->pending_txns);
-    list_initialize(&nvme->active_txns);
-    mtx_init(&nvme->lock, mtx_plain);
     mtx_init(&nvme->admin_lock, mtx_plain);
 
     if (device_get_protocol(dev, ZX_PROTOCOL_PCI, &nvme->pci)) {
@@ -1060,9 +1381,24 @@ static zx_status_t nvme_bind(void* ctx, zx_device_t* dev) {
     };
     uint32_t nirq = 0;
     for (unsigned n = 0; n < countof(modes); n++) {
-        if ((pci_query_irq_mode_caps(&nvme->pci, modes[n], &nirq) == ZX_OK) &&
-            (pci_set_irq_mode(&nvme->pci, modes[n], 1) == ZX_OK)) {
-            zxlogf(INFO, "nvme: irq mode %u, irq count %u (#%u)\n", modes[n], nirq, n);
+        if (pci_query_irq_mode_caps(&nvme->pci, modes[n], &nirq) != ZX_OK) {
+            continue;
+        }
+        // with MSI-X, each io queue can have an interrupt of its own
+        uint32_t count = 1;
+        if (modes[n] == ZX_PCIE_IRQ_MODE_MSI_X) {
+            count = zx_system_get_num_cpus();
+            if (count > nirq) {
+                count = nirq;
+            }
+            if (count > IRQ_MAX) {
+                count = IRQ_MAX;
+            }
+        }
+        if (pci_set_irq_mode(&nvme->pci, modes[n], count) == ZX_OK) {
+            zxlogf(INFO, "nvme: irq mode %u, irq count %u of %u (#%u)\n",
+                   modes[n], count, nirq, n);
+            nvme->irq_count = count;
             goto irq_configured;
         }
     }
@@ -1070,9 +1406,13 @@ static zx_status_t nvme_bind(void* ctx, zx_device_t* dev) {
     goto fail;
 
 irq_configured:
-    if (pci_map_interrupt(&nvme->pci, 0, &nvme->irqh) != ZX_OK) {
-        zxlogf(ERROR, "nvme: could not map irq\n");
-        goto fail;
+    for (unsigned n = 0; n < nvme->irq_count; n++) {
+        nvme->irq[n].nvme = nvme;
+        nvme->irq[n].vector = n;
+        if (pci_map_interrupt(&nvme->pci, n, &nvme->irq[n].handle) != ZX_OK) {
+            zxlogf(ERROR, "nvme: could not map irq %u\n", n);
+            goto fail;
+        }
     }
     if (pci_enable_bus_master(&nvme->pci, true)) {
         zxlogf(ERROR, "nvme: cannot enable bus mastering\n");
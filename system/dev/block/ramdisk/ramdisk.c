@@ -8,7 +8,6 @@
 #include <ddk/protocol/block.h>
 
 #include <zircon/device/ramdisk.h>
-#include <sync/completion.h>
 
 #include <assert.h>
 #include <inttypes.h>
@@ -28,83 +27,191 @@ typedef struct {
     zx_device_t* zxdev;
 } ramctl_device_t;
 
-typedef struct ramdisk_device {
+typedef struct ramdisk_device ramdisk_device_t;
+
+typedef struct {
+    ramdisk_device_t* dev;
+    uint32_t idx;
+    thrd_t thrd;
+} ramdisk_worker_t;
+
+struct ramdisk_device {
     zx_device_t* zxdev;
     uintptr_t mapped_addr;
     uint64_t blk_size;
     uint64_t blk_count;
 
+    // Protects everything below, up to |flags|.
     mtx_t lock;
-    completion_t signal;
+    // Signalled when there is new work, or when a barrier clears.
+    cnd_t work;
+    // Workers beyond |width| wait here until the pool grows again.
+    cnd_t park;
     list_node_t txn_list;
     bool dead;
+    // Number of workers allowed to take requests, and number started.
+    uint32_t width;
+    uint32_t nworkers;
+    // Requests currently being worked on.
+    uint32_t inflight;
+    // Set while a request that must finish before later ones start is running.
+    bool barrier;
 
     uint32_t flags;
     zx_handle_t vmo;
-    thrd_t worker;
+    ramdisk_worker_t workers[RAMDISK_MAX_WORKERS];
     char name[NAME_MAX];
-} ramdisk_device_t;
+};
 
 typedef struct {
     block_op_t op;
     list_node_t node;
 } ramdisk_txn_t;
 
-// The worker thread processes messages from iotxns in the background
-static int worker_thread(void* arg) {
-    ramdisk_device_t* dev = (ramdisk_device_t*)arg;
-    ramdisk_txn_t* txn;
-    bool dead;
+static bool txn_barrier_before(const ramdisk_txn_t* txn) {
+    return (txn->op.command & BLOCK_FL_BARRIER_BEFORE) ||
+           ((txn->op.command & BLOCK_OP_MASK) == BLOCK_OP_FLUSH);
+}
 
+static bool txn_barrier_after(const ramdisk_txn_t* txn) {
+    return (txn->op.command & BLOCK_FL_BARRIER_AFTER) ||
+           ((txn->op.command & BLOCK_OP_MASK) == BLOCK_OP_FLUSH);
+}
+
+// Takes the next request this worker may start, waiting until there is one.
+// Returns NULL once the device is dead. Called with the lock held.
+static ramdisk_txn_t* worker_next_locked(ramdisk_worker_t* worker) {
+    ramdisk_device_t* dev = worker->dev;
     for (;;) {
-        for (;;) {
-            mtx_lock(&dev->lock);
-            dead = dev->dead;
-            txn = list_remove_head_type(&dev->txn_list, ramdisk_txn_t, node);
-            mtx_unlock(&dev->lock);
-            if (dead) {
-                goto goodbye;
-            }
-            if (txn == NULL) {
-                completion_wait(&dev->signal, ZX_TIME_INFINITE);
-            } else {
-                completion_reset(&dev->signal);
-                break;
-            }
+        if (dev->dead) {
+            return NULL;
+        }
+        if (worker->idx >= dev->width) {
+            cnd_wait(&dev->park, &dev->lock);
+            continue;
         }
+        ramdisk_txn_t* txn = list_peek_head_type(&dev->txn_list, ramdisk_txn_t, node);
+        // Nothing starts while a barrier is running, and a barrier does not
+        // start until everything before it is done.
+        if ((txn != NULL) && !dev->barrier &&
+            !(txn_barrier_before(txn) && (dev->inflight > 0))) {
+            list_delete(&txn->node);
+            dev->inflight++;
+            dev->barrier = txn_barrier_after(txn);
+            return txn;
+        }
+        cnd_wait(&dev->work, &dev->lock);
+    }
+}
+
+static zx_status_t ramdisk_rw(ramdisk_device_t* dev, ramdisk_txn_t* txn) {
+    // Copy straight between the client's vmo and our mapping of the ramdisk
+    // vmo, so the data only moves once.
+    void* addr = (void*) dev->mapped_addr + txn->op.rw.offset_dev;
+    size_t len = txn->op.rw.length * dev->blk_size;
+    size_t actual;
+    zx_status_t status;
+
+    if ((txn->op.command & BLOCK_OP_MASK) == BLOCK_OP_READ) {
+        status = zx_vmo_write(txn->op.rw.vmo, addr, txn->op.rw.offset_vmo, len, &actual);
+    } else {
+        status = zx_vmo_read(txn->op.rw.vmo, addr, txn->op.rw.offset_vmo, len, &actual);
+    }
+    if ((status != ZX_OK) || (actual != len)) {
+        return ZX_ERR_IO;
+    }
+    return ZX_OK;
+}
+
+static zx_status_t ramdisk_trim(ramdisk_device_t* dev, ramdisk_txn_t* txn) {
+    // Whole pages go back to the system, and the rest of the range is zeroed,
+    // so trimmed blocks read back as zeroes either way.
+    uint64_t start = txn->op.trim.offset_dev;
+    uint64_t end = start + txn->op.trim.length * dev->blk_size;
+    uint64_t page_start = (start + PAGE_SIZE - 1) & ~((uint64_t)PAGE_SIZE - 1);
+    uint64_t page_end = end & ~((uint64_t)PAGE_SIZE - 1);
+    if (page_start >= page_end) {
+        memset((void*)(dev->mapped_addr + start), 0, end - start);
+        return ZX_OK;
+    }
+    memset((void*)(dev->mapped_addr + start), 0, page_start - start);
+    memset((void*)(dev->mapped_addr + page_end), 0, end - page_end);
+    return zx_vmo_op_range(dev->vmo, ZX_VMO_OP_DECOMMIT, page_start, page_end - page_start,
+                           NULL, 0);
+}
+
+// The worker threads process requests in the background. Requests without
+// barriers between them may be worked on by several workers at once.
+static int worker_thread(void* arg) {
+    ramdisk_worker_t* worker = arg;
+    ramdisk_device_t* dev = worker->dev;
+    ramdisk_txn_t* txn;
+
+    mtx_lock(&dev->lock);
+    while ((txn = worker_next_locked(worker)) != NULL) {
+        mtx_unlock(&dev->lock);
 
         zx_status_t status = ZX_OK;
-        void* addr = (void*) dev->mapped_addr + txn->op.rw.offset_dev;
-        size_t len = txn->op.rw.length * dev->blk_size;
-        size_t actual;
-
-        if (txn->op.command == BLOCK_OP_READ) {
-            if ((zx_vmo_write(txn->op.rw.vmo, addr, txn->op.rw.offset_vmo,
-                              len, &actual) != ZX_OK) ||
-                (actual != len)) {
-                status = ZX_ERR_IO;
-            }
-        } else {
-            if ((zx_vmo_read(txn->op.rw.vmo, addr, txn->op.rw.offset_vmo,
-                             len, &actual) != ZX_OK) ||
-                (actual != len)) {
-                status = ZX_ERR_IO;
-            }
+        bool barrier = txn_barrier_after(txn);
+        switch (txn->op.command & BLOCK_OP_MASK) {
+        case BLOCK_OP_FLUSH:
+            break;
+        case BLOCK_OP_TRIM:
+            status = ramdisk_trim(dev, txn);
+            break;
+        default:
+            status = ramdisk_rw(dev, txn);
+            break;
         }
-
         txn->op.completion_cb(&txn->op, status);
+
+        mtx_lock(&dev->lock);
+        dev->inflight--;
+        if (barrier) {
+            dev->barrier = false;
+        }
+        if (barrier || (dev->inflight == 0)) {
+            cnd_broadcast(&dev->work);
+        }
     }
 
-goodbye:
-    while (txn != NULL) {
+    // Whichever workers see the device die fail whatever is still queued.
+    while ((txn = list_remove_head_type(&dev->txn_list, ramdisk_txn_t, node)) != NULL) {
+        mtx_unlock(&dev->lock);
         txn->op.completion_cb(&txn->op, ZX_ERR_BAD_STATE);
         mtx_lock(&dev->lock);
-        txn = list_remove_head_type(&dev->txn_list, ramdisk_txn_t, node);
-        mtx_unlock(&dev->lock);
     }
+    mtx_unlock(&dev->lock);
     return 0;
 }
 
+// Allows |width| workers to take requests, starting any that are missing.
+// Called with the lock held.
+static zx_status_t ramdisk_set_width_locked(ramdisk_device_t* dev, uint32_t width) {
+    if ((width == 0) || (width > RAMDISK_MAX_WORKERS)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    while (dev->nworkers < width) {
+        ramdisk_worker_t* worker = &dev->workers[dev->nworkers];
+        worker->dev = dev;
+        worker->idx = dev->nworkers;
+        if (thrd_create_with_name(&worker->thrd, worker_thread, worker,
+                                  "ramdisk-worker") != thrd_success) {
+            if (dev->nworkers == 0) {
+                return ZX_ERR_NO_RESOURCES;
+            }
+            // Make do with the workers we have.
+            width = dev->nworkers;
+            break;
+        }
+        dev->nworkers++;
+    }
+    dev->width = width;
+    cnd_broadcast(&dev->park);
+    cnd_broadcast(&dev->work);
+    return ZX_OK;
+}
+
 static uint64_t sizebytes(ramdisk_device_t* rdev) {
     return rdev->blk_size * rdev->blk_count;
 }
@@ -116,7 +223,7 @@ static void ramdisk_get_info(void* ctx, block_info_t* info) {
     info->block_count = ramdev->blk_count;
     // Arbitrarily set, but matches the SATA driver for testing
     info->max_transfer_size = (1 << 25);
-    info->flags = ramdev->flags;
+    info->flags = ramdev->flags | BLOCK_FLAG_TRIM_SUPPORT;
 }
 
 // implement device protocol:
@@ -125,8 +232,9 @@ static void ramdisk_unbind(void* ctx) {
     ramdisk_device_t* ramdev = ctx;
     mtx_lock(&ramdev->lock);
     ramdev->dead = true;
+    cnd_broadcast(&ramdev->work);
+    cnd_broadcast(&ramdev->park);
     mtx_unlock(&ramdev->lock);
-    completion_signal(&ramdev->signal);
     device_remove(ramdev->zxdev);
 }
 
@@ -150,6 +258,15 @@ static zx_status_t ramdisk_ioctl(void* ctx, uint32_t op, const void* cmd, size_t
         ramdev->flags = *flags;
         return ZX_OK;
     }
+    case IOCTL_RAMDISK_SET_WORKERS: {
+        if (cmd_len < sizeof(uint32_t)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        mtx_lock(&ramdev->lock);
+        zx_status_t status = ramdisk_set_width_locked(ramdev, *(const uint32_t*)cmd);
+        mtx_unlock(&ramdev->lock);
+        return status;
+    }
     // Block Protocol
     case IOCTL_BLOCK_GET_NAME: {
         char* name = reply;
@@ -183,31 +300,35 @@ static void ramdisk_queue(void* ctx, block_op_t* bop) {
     ramdisk_txn_t* txn = containerof(bop, ramdisk_txn_t, op);
     bool dead;
 
-    switch ((txn->op.command &= BLOCK_OP_MASK)) {
+    // The command keeps its barrier flags; the workers order requests by them.
+    switch (txn->op.command & BLOCK_OP_MASK) {
     case BLOCK_OP_READ:
     case BLOCK_OP_WRITE:
+    case BLOCK_OP_TRIM:
+        // Trims lay out their extent like reads and writes.
         if ((txn->op.rw.offset_dev >= ramdev->blk_count) ||
             ((ramdev->blk_count - txn->op.rw.offset_dev) < txn->op.rw.length)) {
             bop->completion_cb(bop, ZX_ERR_OUT_OF_RANGE);
             return;
         }
         txn->op.rw.offset_dev *= ramdev->blk_size;
-        txn->op.rw.offset_vmo *= ramdev->blk_size;
-
+        if ((txn->op.command & BLOCK_OP_MASK) != BLOCK_OP_TRIM) {
+            txn->op.rw.offset_vmo *= ramdev->blk_size;
+        }
+        // fallthrough
+    case BLOCK_OP_FLUSH:
+        // Flushes have nothing to write back, but still have to wait for the
+        // requests ahead of them now that those may be running in parallel.
         mtx_lock(&ramdev->lock);
         if (!(dead = ramdev->dead)) {
             list_add_tail(&ramdev->txn_list, &txn->node);
+            cnd_signal(&ramdev->work);
         }
         mtx_unlock(&ramdev->lock);
         if (dead) {
             bop->completion_cb(bop, ZX_ERR_BAD_STATE);
-        } else {
-            completion_signal(&ramdev->signal);
         }
         break;
-    case BLOCK_OP_FLUSH:
-        bop->completion_cb(bop, ZX_OK);
-        break;
     default:
         bop->completion_cb(bop, ZX_ERR_NOT_SUPPORTED);
         break;
@@ -226,14 +347,18 @@ static zx_off_t ramdisk_getsize(void* ctx) {
 static void ramdisk_release(void* ctx) {
     ramdisk_device_t* ramdev = ctx;
 
-    // Wake up the worker thread, in case it is sleeping
+    // Wake up the worker threads, in case they are sleeping
     mtx_lock(&ramdev->lock);
     ramdev->dead = true;
+    cnd_broadcast(&ramdev->work);
+    cnd_broadcast(&ramdev->park);
+    uint32_t nworkers = ramdev->nworkers;
     mtx_unlock(&ramdev->lock);
-    completion_signal(&ramdev->signal);
 
-    int r;
-    thrd_join(ramdev->worker, &r);
+    for (uint32_t i = 0; i < nworkers; i++) {
+        int r;
+        thrd_join(ramdev->workers[i].thrd, &r);
+    }
     if (ramdev->vmo != ZX_HANDLE_INVALID) {
         zx_vmar_unmap(zx_vmar_root_self(), ramdev->mapped_addr, sizebytes(ramdev));
         zx_handle_close(ramdev->vmo);
@@ -275,6 +400,12 @@ static zx_status_t ramctl_config(ramctl_device_t* ramctl, zx_handle_t vmo,
     if (mtx_init(&ramdev->lock, mtx_plain) != thrd_success) {
         goto fail_free;
     }
+    if (cnd_init(&ramdev->work) != thrd_success) {
+        goto fail_mtx;
+    }
+    if (cnd_init(&ramdev->park) != thrd_success) {
+        goto fail_work;
+    }
     ramdev->vmo = vmo;
     ramdev->blk_size = blk_size;
     ramdev->blk_count = blk_count;
@@ -285,10 +416,15 @@ static zx_status_t ramctl_config(ramctl_device_t* ramctl, zx_handle_t vmo,
                          ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE,
                          &ramdev->mapped_addr);
     if (status != ZX_OK) {
-        goto fail_mtx;
+        goto fail_park;
     }
     list_initialize(&ramdev->txn_list);
-    if (thrd_create(&ramdev->worker, worker_thread, ramdev) != thrd_success) {
+    // Start with a worker per cpu, up to the limit.
+    uint32_t width = MIN(zx_system_get_num_cpus(), RAMDISK_MAX_WORKERS);
+    mtx_lock(&ramdev->lock);
+    status = ramdisk_set_width_locked(ramdev, MAX(width, 1u));
+    mtx_unlock(&ramdev->lock);
+    if (status != ZX_OK) {
         goto fail_unmap;
     }
 
@@ -311,6 +447,10 @@ static zx_status_t ramctl_config(ramctl_device_t* ramctl, zx_handle_t vmo,
 
 fail_unmap:
     zx_vmar_unmap(zx_vmar_root_self(), ramdev->mapped_addr, sizebytes(ramdev));
+fail_park:
+    cnd_destroy(&ramdev->park);
+fail_work:
+    cnd_destroy(&ramdev->work);
 fail_mtx:
     mtx_destroy(&ramdev->lock);
 fail_free:
@@ -3,7 +3,10 @@
 // found in the LICENSE file.
 
 // Notes and limitations:
-// 1. This driver only uses PIO mode.
+// 1. This driver uses ADMA2 when the controller supports it, with 64-bit
+//    descriptors if it can and 32-bit descriptors otherwise. Transfers fall
+//    back to PIO when there is no ADMA2, or when a 32-bit controller can't
+//    reach all of the pages.
 //
 // 2. This driver only supports SDHCv3 and above. Lower versions of SD are not
 //    currently supported. The driver should fail gracefully if a lower version
@@ -62,9 +65,47 @@ typedef struct sdhci_adma64_desc {
 
 static_assert(sizeof(sdhci_adma64_desc_t) == 12, "unexpected ADMA2 descriptor size");
 
+typedef struct sdhci_adma32_desc {
+    uint16_t attr;
+    uint16_t length;
+    uint32_t address;
+} __PACKED sdhci_adma32_desc_t;
+
+static_assert(sizeof(sdhci_adma32_desc_t) == 8, "unexpected ADMA2 descriptor size");
+
+// ADMA2 descriptor attributes, for descriptors set up through |attr|.
+#define ADMA2_ATTR_VALID        (1 << 0)
+#define ADMA2_ATTR_END          (1 << 1)
+#define ADMA2_ATTR_ACT_TRAN     (1 << 5)
+
 #define ADMA2_DESC_MAX_LENGTH   0x10000 // 64k
 #define DMA_DESC_COUNT          8192    // for 32M max transfer size for fully discontiguous
 
+typedef enum {
+    SDHCI_DMA_NONE,
+    SDHCI_DMA_ADMA2_32,
+    SDHCI_DMA_ADMA2_64,
+} sdhci_dma_mode_t;
+
+// Command latencies are kept per command index, and data commands are
+// bucketed by log2 microseconds.
+#define SDHCI_NUM_CMDS          64
+#define SDHCI_LATENCY_BUCKETS   16
+
+typedef struct {
+    uint64_t count;
+    zx_duration_t total;
+    zx_duration_t max;
+} sdhci_cmd_stats_t;
+
+typedef struct {
+    sdhci_cmd_stats_t cmds[SDHCI_NUM_CMDS];
+    uint64_t data_latency[SDHCI_LATENCY_BUCKETS];
+    uint64_t dma_txns;
+    uint64_t pio_txns;
+    uint64_t dma_descs;
+} sdhci_stats_t;
+
 typedef struct sdhci_device {
     // Interrupts mapped here.
     zx_handle_t irq_handle;
@@ -83,13 +124,18 @@ typedef struct sdhci_device {
 
     // DMA descriptors
     io_buffer_t iobuf;
+    sdhci_dma_mode_t dma_mode;
     sdhci_adma64_desc_t* descs;
+    sdhci_adma32_desc_t* descs32;
 
     // Held when a command or action is in progress.
     mtx_t mtx;
 
     // Current iotxn in flight
     iotxn_t* pending;
+    // Whether the pending iotxn's data moves by DMA, and when it was issued.
+    bool pending_dma;
+    zx_time_t pending_issued;
     // Completed iotxn
     iotxn_t* completed;
     // Used to signal that the pending iotxn is completed
@@ -100,6 +146,8 @@ typedef struct sdhci_device {
 
     // Cached base clock rate that the pi is running at.
     uint32_t base_clock;
+
+    sdhci_stats_t stats;
 } sdhci_device_t;
 
 // If any of these interrupts is asserted in the SDHCI irq register, it means
@@ -127,10 +175,53 @@ static const uint32_t normal_interrupts = (
     SDHCI_IRQ_BUFF_WRITE_READY
 );
 
-static bool sdhci_supports_adma2_64bit(sdhci_device_t* dev) {
-    return (dev->regs->caps0 & SDHCI_CORECFG_ADMA2_SUPPORT) &&
-           (dev->regs->caps0 & SDHCI_CORECFG_64BIT_SUPPORT) &&
-           !(dev->quirks & SDHCI_QUIRK_NO_DMA);
+static sdhci_dma_mode_t sdhci_get_dma_mode(sdhci_device_t* dev) {
+    if (!(dev->regs->caps0 & SDHCI_CORECFG_ADMA2_SUPPORT) ||
+        (dev->quirks & SDHCI_QUIRK_NO_DMA)) {
+        return SDHCI_DMA_NONE;
+    }
+    if (dev->regs->caps0 & SDHCI_CORECFG_64BIT_SUPPORT) {
+        return SDHCI_DMA_ADMA2_64;
+    }
+    return SDHCI_DMA_ADMA2_32;
+}
+
+static void sdhci_record_latency_locked(sdhci_device_t* dev, uint32_t cmd, bool has_data) {
+    zx_duration_t latency = zx_time_get(ZX_CLOCK_MONOTONIC) - dev->pending_issued;
+    sdhci_cmd_stats_t* stats = &dev->stats.cmds[(cmd >> 24) & (SDHCI_NUM_CMDS - 1)];
+    stats->count++;
+    stats->total += latency;
+    if (latency > stats->max) {
+        stats->max = latency;
+    }
+    if (has_data) {
+        uint64_t us = latency / ZX_USEC(1);
+        uint32_t bucket = 0;
+        while ((us >>= 1) && (bucket < SDHCI_LATENCY_BUCKETS - 1)) {
+            bucket++;
+        }
+        dev->stats.data_latency[bucket]++;
+    }
+}
+
+static void sdhci_dump_stats(sdhci_device_t* dev) {
+    const sdhci_stats_t* stats = &dev->stats;
+    zxlogf(TRACE, "sdhci: %" PRIu64 " dma txns (%" PRIu64 " descriptors), %" PRIu64
+           " pio txns\n", stats->dma_txns, stats->dma_descs, stats->pio_txns);
+    for (uint32_t i = 0; i < SDHCI_NUM_CMDS; i++) {
+        const sdhci_cmd_stats_t* c = &stats->cmds[i];
+        if (c->count == 0) {
+            continue;
+        }
+        zxlogf(TRACE, "sdhci: cmd%u: %" PRIu64 " issued, avg %" PRIu64 "us, max %" PRIu64
+               "us\n", i, c->count, c->total / c->count / ZX_USEC(1), c->max / ZX_USEC(1));
+    }
+    for (uint32_t i = 0; i < SDHCI_LATENCY_BUCKETS; i++) {
+        if (stats->data_latency[i] != 0) {
+            zxlogf(TRACE, "sdhci: data cmds under %uus: %" PRIu64 "\n",
+                   2u << i, stats->data_latency[i]);
+        }
+    }
 }
 
 static zx_status_t sdhci_wait_for_reset(sdhci_device_t* dev, const uint32_t mask, zx_time_t timeout) {
@@ -151,6 +242,9 @@ static void sdhci_complete_pending_locked(sdhci_device_t* dev, zx_status_t statu
     // Disable irqs when no pending iotxn
     dev->regs->irqen = 0;
 
+    sdmmc_protocol_data_t* pdata = iotxn_pdata(dev->pending, sdmmc_protocol_data_t);
+    sdhci_record_latency_locked(dev, pdata->cmd, pdata->cmd & SDMMC_RESP_DATA_PRESENT);
+
     dev->completed = dev->pending;
     dev->completed->status = status;
     dev->completed->actual = actual;
@@ -190,9 +284,8 @@ static void sdhci_cmd_stage_complete_locked(sdhci_device_t* dev) {
 
     // If this command has a data phase and we're not using DMA, transfer the data
     bool has_data = cmd & SDMMC_RESP_DATA_PRESENT;
-    bool use_dma = sdhci_supports_adma2_64bit(dev);
     if (has_data) {
-        if (use_dma) {
+        if (dev->pending_dma) {
             // Wait for transfer complete interrupt
             regs->irqen = error_interrupts | SDHCI_IRQ_XFER_CPLT;
         } else {
@@ -346,6 +439,70 @@ static int sdhci_irq_thread(void *arg) {
     return 0;
 }
 
+// Fills in the descriptor table for |txn|, one descriptor per physically
+// contiguous run of up to 64k, so that a single command covers all of it.
+// Returns ZX_ERR_OUT_OF_RANGE if the controller can't reach some of the
+// pages, in which case the data can still be moved with PIO.
+static zx_status_t sdhci_build_dma_descs_locked(sdhci_device_t* dev, iotxn_t* txn) {
+    iotxn_phys_iter_t iter;
+    iotxn_phys_iter_init(&iter, txn, ADMA2_DESC_MAX_LENGTH);
+
+    const bool is64 = dev->dma_mode == SDHCI_DMA_ADMA2_64;
+    size_t count = 0;
+    size_t length;
+    zx_paddr_t paddr;
+    while ((length = iotxn_phys_iter_next(&iter, &paddr)) != 0) {
+        if (length > ADMA2_DESC_MAX_LENGTH) {
+            zxlogf(TRACE, "sdhci: chunk size > %zu is unsupported\n", length);
+            return ZX_ERR_NOT_SUPPORTED;
+        } else if (count == DMA_DESC_COUNT) {
+            zxlogf(TRACE, "sdhci: txn with more than %d chunks is unsupported\n",
+                    DMA_DESC_COUNT);
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+        if (is64) {
+            sdhci_adma64_desc_t* desc = &dev->descs[count];
+            desc->length = length & 0xffff; // 0 = 0x10000 bytes
+            desc->address = paddr;
+            desc->attr = ADMA2_ATTR_VALID | ADMA2_ATTR_ACT_TRAN;
+        } else {
+            if ((paddr + length - 1) > UINT32_MAX) {
+                return ZX_ERR_OUT_OF_RANGE;
+            }
+            sdhci_adma32_desc_t* desc = &dev->descs32[count];
+            desc->length = length & 0xffff; // 0 = 0x10000 bytes
+            desc->address = (uint32_t)paddr;
+            desc->attr = ADMA2_ATTR_VALID | ADMA2_ATTR_ACT_TRAN;
+        }
+        count++;
+    }
+    if (count == 0) {
+        zxlogf(TRACE, "sdhci: empty descriptor list!\n");
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    // set end bit on the last descriptor
+    if (is64) {
+        dev->descs[count - 1].attr |= ADMA2_ATTR_END;
+    } else {
+        dev->descs32[count - 1].attr |= ADMA2_ATTR_END;
+    }
+    dev->stats.dma_descs += count;
+
+    if (driver_get_log_flags() & DDK_LOG_SPEW) {
+        for (size_t i = 0; i < count; i++) {
+            if (is64) {
+                zxlogf(SPEW, "desc: addr=0x%" PRIx64 " length=0x%04x attr=0x%04x\n",
+                        dev->descs[i].address, dev->descs[i].length, dev->descs[i].attr);
+            } else {
+                zxlogf(SPEW, "desc: addr=0x%08x length=0x%04x attr=0x%04x\n",
+                        dev->descs32[i].address, dev->descs32[i].length,
+                        dev->descs32[i].attr);
+            }
+        }
+    }
+    return ZX_OK;
+}
+
 static zx_status_t sdhci_start_txn_locked(sdhci_device_t* dev, iotxn_t* txn) {
     sdmmc_protocol_data_t* pdata = iotxn_pdata(txn, sdmmc_protocol_data_t);
 
@@ -391,7 +548,7 @@ static zx_status_t sdhci_start_txn_locked(sdhci_device_t* dev, iotxn_t* txn) {
     while (regs->state & inhibit_mask)
         zx_nanosleep(zx_deadline_after(ZX_MSEC(1)));
 
-    bool use_dma = sdhci_supports_adma2_64bit(dev);
+    dev->pending_dma = false;
     if (has_data) {
         st = iotxn_physmap(txn);
         if (st != ZX_OK) {
@@ -404,52 +561,15 @@ static zx_status_t sdhci_start_txn_locked(sdhci_device_t* dev, iotxn_t* txn) {
             iotxn_cache_flush(txn, 0, blkcnt * blksiz);
         }
 
-        if (use_dma) {
-            iotxn_phys_iter_t iter;
-            iotxn_phys_iter_init(&iter, txn, ADMA2_DESC_MAX_LENGTH);
-
-            int count = 0;
-            size_t length;
-            zx_paddr_t paddr;
-            sdhci_adma64_desc_t* desc = dev->descs;
-            for (;;) {
-                length = iotxn_phys_iter_next(&iter, &paddr);
-                if (length == 0) {
-                    if (desc != dev->descs) {
-                        desc -= 1;
-                        desc->end = 1; // set end bit on the last descriptor
-                        break;
-                    } else {
-                        zxlogf(TRACE, "sdhci: empty descriptor list!\n");
-                        st = ZX_ERR_NOT_SUPPORTED;
-                        goto err;
-                    }
-                } else if (length > ADMA2_DESC_MAX_LENGTH) {
-                    zxlogf(TRACE, "sdhci: chunk size > %zu is unsupported\n", length);
-                    st = ZX_ERR_NOT_SUPPORTED;
-                    goto err;
-                } else if ((++count) > DMA_DESC_COUNT) {
-                    zxlogf(TRACE, "sdhci: txn with more than %zd chunks is unsupported\n",
-                            length);
-                    st = ZX_ERR_NOT_SUPPORTED;
-                    goto err;
-                }
-                desc->length = length & 0xffff; // 0 = 0x10000 bytes
-                desc->address = paddr;
-                desc->attr = 0;
-                desc->valid = 1;
-                desc->act2 = 1; // transfer data
-                desc += 1;
-            }
-
-            if (driver_get_log_flags() & DDK_LOG_SPEW) {
-                desc = dev->descs;
-                do {
-                    zxlogf(SPEW, "desc: addr=0x%" PRIx64 " length=0x%04x attr=0x%04x\n",
-                            desc->address, desc->length, desc->attr);
-                } while (!(desc++)->end);
+        if (dev->dma_mode != SDHCI_DMA_NONE) {
+            st = sdhci_build_dma_descs_locked(dev, txn);
+            if (st == ZX_OK) {
+                dev->pending_dma = true;
+            } else if (st != ZX_ERR_OUT_OF_RANGE) {
+                goto err;
             }
-
+        }
+        if (dev->pending_dma) {
             zx_paddr_t desc_phys = io_buffer_phys(&dev->iobuf);
             dev->regs->admaaddr0 = LO32(desc_phys);
             dev->regs->admaaddr1 = HI32(desc_phys);
@@ -458,10 +578,10 @@ static zx_status_t sdhci_start_txn_locked(sdhci_device_t* dev, iotxn_t* txn) {
                     dev->regs->admaaddr0, dev->regs->admaaddr1);
 
             cmd |= SDHCI_XFERMODE_DMA_ENABLE;
-
+            dev->stats.dma_txns++;
         } else {
-            ZX_DEBUG_ASSERT(txn->phys_count == 1);
-            regs->arg2 = iotxn_phys(txn);
+            // The data moves through the buffer data port instead.
+            dev->stats.pio_txns++;
         }
 
         if (cmd & SDMMC_CMD_MULTI_BLK) {
@@ -484,6 +604,7 @@ static zx_status_t sdhci_start_txn_locked(sdhci_device_t* dev, iotxn_t* txn) {
     regs->irq = regs->irqen;
 
     // And we're off to the races!
+    dev->pending_issued = zx_time_get(ZX_CLOCK_MONOTONIC);
     regs->cmd = cmd;
     return ZX_OK;
 err:
@@ -794,6 +915,7 @@ static void sdhci_unbind(void* ctx) {
 
 static void sdhci_release(void* ctx) {
     sdhci_device_t* dev = ctx;
+    sdhci_dump_stats(dev);
     free(dev);
 }
 
@@ -829,7 +951,8 @@ static zx_status_t sdhci_controller_init(sdhci_device_t* dev) {
     }
 
     // allocate and setup DMA descriptor
-    if (sdhci_supports_adma2_64bit(dev)) {
+    dev->dma_mode = sdhci_get_dma_mode(dev);
+    if (dev->dma_mode == SDHCI_DMA_ADMA2_64) {
         status = io_buffer_init(&dev->iobuf, DMA_DESC_COUNT * sizeof(sdhci_adma64_desc_t),
                                 IO_BUFFER_RW | IO_BUFFER_CONTIG);
         if (status != ZX_OK) {
@@ -840,7 +963,25 @@ static zx_status_t sdhci_controller_init(sdhci_device_t* dev) {
 
         // Select ADMA2
         dev->regs->ctrl0 |= SDHCI_HOSTCTRL_DMA_SELECT_ADMA2;
+    } else if (dev->dma_mode == SDHCI_DMA_ADMA2_32) {
+        // The descriptor table itself must be reachable with 32-bit addresses.
+        status = io_buffer_init(&dev->iobuf, DMA_DESC_COUNT * sizeof(sdhci_adma32_desc_t),
+                                IO_BUFFER_RW | IO_BUFFER_CONTIG);
+        if ((status == ZX_OK) && (HI32(io_buffer_phys(&dev->iobuf)) != 0)) {
+            io_buffer_release(&dev->iobuf);
+            status = ZX_ERR_NO_MEMORY;
+        }
+        if (status != ZX_OK) {
+            zxlogf(INFO, "sdhci: no DMA descriptors below 4GB, using PIO\n");
+            dev->dma_mode = SDHCI_DMA_NONE;
+            status = ZX_OK;
+        } else {
+            dev->descs32 = io_buffer_virt(&dev->iobuf);
+            uint32_t ctrl0 = dev->regs->ctrl0 & ~SDHCI_HOSTCTRL_DMA_SELECT_MASK;
+            dev->regs->ctrl0 = ctrl0 | SDHCI_HOSTCTRL_DMA_SELECT_ADMA2_32;
+        }
     }
+    zxlogf(TRACE, "sdhci: dma mode %d\n", dev->dma_mode);
 
     // Configure the clock.
     ctrl1 = dev->regs->ctrl1;
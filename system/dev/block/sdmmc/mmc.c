@@ -240,6 +240,9 @@ static zx_status_t mmc_decode_ext_csd(sdmmc_t* sdmmc, const uint8_t* raw_ext_csd
 
     zxlogf(TRACE, "mmc: found card with capacity = %" PRIu64 "B\n", sdmmc->capacity);
 
+    sdmmc->trim_supported =
+        (raw_ext_csd[MMC_EXT_CSD_SEC_FEATURE_SUPPORT] & MMC_EXT_CSD_SEC_GB_CL_EN) != 0;
+
     return ZX_OK;
 }
 
@@ -125,6 +125,8 @@ zx_status_t sdmmc_probe_sd(sdmmc_t* sdmmc, iotxn_t* setup_txn) {
     }
 
     sdmmc->type = SDMMC_TYPE_SD;
+    // Erase is a mandatory command class for SDHC cards.
+    sdmmc->trim_supported = true;
     sdmmc->rca = (pdata->response[0] >> 16) & 0xffff;
     if (pdata->response[0] & 0xe000) {
         zxlogf(ERROR, "sd: SEND_RELATIVE_ADDR failed with resp = %d\n",
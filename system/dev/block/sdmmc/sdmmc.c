@@ -73,6 +73,9 @@ static void sdmmc_get_info(block_info_t* info, void* ctx) {
     info->block_size = SDHC_BLOCK_SIZE;
     info->block_count = sdmmc_get_size(ctx) / SDHC_BLOCK_SIZE;
     info->max_transfer_size = sdmmc->max_transfer_size;
+    if (sdmmc->trim_supported) {
+        info->flags |= BLOCK_FLAG_TRIM_SUPPORT;
+    }
 }
 
 static zx_status_t sdmmc_ioctl(void* ctx, uint32_t op, const void* cmd,
@@ -179,6 +182,11 @@ static void sdmmc_iotxn_queue(void* ctx, iotxn_t* txn) {
 
     sdmmc_t* sdmmc = ctx;
 
+    if (txn->opcode == IOTXN_OP_TRIM && (!sdmmc->trim_supported || txn->length == 0)) {
+        iotxn_complete(txn, sdmmc->trim_supported ? ZX_ERR_INVALID_ARGS : ZX_ERR_NOT_SUPPORTED, 0);
+        return;
+    }
+
     mtx_lock(&sdmmc->lock);
     list_add_tail(&sdmmc->txn_list, &txn->node);
     mtx_unlock(&sdmmc->lock);
@@ -220,6 +228,9 @@ static void sdmmc_do_txn(sdmmc_t* sdmmc, iotxn_t* txn) {
                 cmd = SDMMC_WRITE_BLOCK;
             }
             break;
+        case IOTXN_OP_TRIM:
+            cmd = SDMMC_ERASE;
+            break;
         default:
             // Invalid opcode?
             zxlogf(SPEW, "sdmmc: iotxn_complete txn %p status %d\n", txn, ZX_ERR_INVALID_ARGS);
@@ -241,43 +252,75 @@ static void sdmmc_do_txn(sdmmc_t* sdmmc, iotxn_t* txn) {
     // Following commands do not use the data buffer and
     // it is safe to use the cloned iotxn
 
-    uint8_t current_state;
-    const size_t max_attempts = 10;
-    size_t attempt = 0;
-    for (; attempt <= max_attempts; attempt++) {
-        st = sdmmc_do_command(sdmmc_zxdev, SDMMC_SEND_STATUS, sdmmc->rca << 16, clone);
-        if (st != ZX_OK) {
-            zxlogf(SPEW, "sdmmc: iotxn_complete txn %p status %d (SDMMC_SEND_STATUS)\n",
-                    txn, st);
-            iotxn_complete(txn, st, 0);
-            goto out;
-        }
+    // A read, or a multi-block write whose stop command waited out the busy
+    // signal, leaves the card back in the transfer state. Only ask the card
+    // where it is when we don't already know.
+    if (sdmmc->card_in_tran) {
+        sdmmc->status_polls_skipped++;
+    } else {
+        uint8_t current_state;
+        const size_t max_attempts = 10;
+        size_t attempt = 0;
+        for (; attempt <= max_attempts; attempt++) {
+            st = sdmmc_do_command(sdmmc_zxdev, SDMMC_SEND_STATUS, sdmmc->rca << 16, clone);
+            if (st != ZX_OK) {
+                zxlogf(SPEW, "sdmmc: iotxn_complete txn %p status %d (SDMMC_SEND_STATUS)\n",
+                        txn, st);
+                iotxn_complete(txn, st, 0);
+                goto out;
+            }
 
-        current_state = (pdata->response[0] >> 9) & 0xf;
+            current_state = (pdata->response[0] >> 9) & 0xf;
 
-        if (current_state == SDMMC_STATE_RECV) {
-            st = sdmmc_do_command(sdmmc_zxdev, SDMMC_STOP_TRANSMISSION, 0, clone);
-            continue;
-        } else if (current_state == SDMMC_STATE_TRAN) {
-            break;
+            if (current_state == SDMMC_STATE_RECV) {
+                st = sdmmc_do_command(sdmmc_zxdev, SDMMC_STOP_TRANSMISSION, 0, clone);
+                continue;
+            } else if (current_state == SDMMC_STATE_TRAN) {
+                break;
+            }
+
+            zx_nanosleep(zx_deadline_after(ZX_MSEC(10)));
         }
 
-        zx_nanosleep(zx_deadline_after(ZX_MSEC(10)));
+        if (attempt == max_attempts) {
+            // Too many retries, fail.
+            zxlogf(SPEW, "sdmmc: iotxn_complete txn %p status %d\n", txn, ZX_ERR_BAD_STATE);
+            iotxn_complete(txn, ZX_ERR_BAD_STATE, 0);
+            goto out;
+        }
     }
 
-    if (attempt == max_attempts) {
-        // Too many retries, fail.
-        zxlogf(SPEW, "sdmmc: iotxn_complete txn %p status %d\n", txn, ZX_ERR_BAD_STATE);
-        iotxn_complete(txn, ZX_ERR_BAD_STATE, 0);
+    const uint32_t blkid = clone->offset / SDHC_BLOCK_SIZE;
+
+    if (cmd == SDMMC_ERASE) {
+        // Mark the range, then erase it. On MMC this is a trim of write
+        // blocks, not an erase of whole erase groups.
+        const uint32_t last = blkid + clone->length / SDHC_BLOCK_SIZE - 1;
+        const bool mmc = sdmmc->type == SDMMC_TYPE_MMC;
+        pdata->blockcount = 0;
+        sdmmc->card_in_tran = false;
+        if ((st = sdmmc_do_command(sdmmc_zxdev, mmc ? MMC_ERASE_GROUP_START :
+                                   SDMMC_ERASE_WR_BLK_START, blkid, clone)) != ZX_OK ||
+            (st = sdmmc_do_command(sdmmc_zxdev, mmc ? MMC_ERASE_GROUP_END :
+                                   SDMMC_ERASE_WR_BLK_END, last, clone)) != ZX_OK ||
+            (st = sdmmc_do_command(sdmmc_zxdev, SDMMC_ERASE,
+                                   mmc ? MMC_ERASE_TRIM_ARG : 0, clone)) != ZX_OK) {
+            zxlogf(SPEW, "sdmmc: iotxn_complete txn %p status %d (erase)\n", txn, st);
+            iotxn_complete(txn, st, 0);
+            goto out;
+        }
+        // The card may still be busy erasing, so poll before the next command.
+        zxlogf(SPEW, "sdmmc: iotxn_complete txn %p status %d\n", txn, ZX_OK);
+        iotxn_complete(txn, ZX_OK, txn->length);
         goto out;
     }
 
     // Issue the data transfer
 
-    const uint32_t blkid = clone->offset / SDHC_BLOCK_SIZE;
     pdata->blockcount = clone->length / SDHC_BLOCK_SIZE;
     pdata->blocksize = SDHC_BLOCK_SIZE;
 
+    sdmmc->card_in_tran = false;
     st = sdmmc_do_command(sdmmc_zxdev, cmd, blkid, clone);
     if (st != ZX_OK) {
         zxlogf(SPEW, "sdmmc: iotxn_complete txn %p status %d (cmd 0x%x)\n", txn, st, cmd);
@@ -285,6 +328,8 @@ static void sdmmc_do_txn(sdmmc_t* sdmmc, iotxn_t* txn) {
         goto out;
     }
 
+    // A single block write may still be programming.
+    sdmmc->card_in_tran = (cmd != SDMMC_WRITE_BLOCK);
     zxlogf(SPEW, "sdmmc: iotxn_complete txn %p status %d\n", txn, ZX_OK);
     iotxn_complete(txn, ZX_OK, txn->length);
 
@@ -367,7 +412,8 @@ static int sdmmc_worker_thread(void* arg) {
         }
     }
 
-    zxlogf(TRACE, "sdmmc: worker thread terminated\n");
+    zxlogf(TRACE, "sdmmc: worker thread terminated, skipped %" PRIu64 " status polls\n",
+           sdmmc->status_polls_skipped);
 
     return 0;
 }
@@ -49,6 +49,15 @@ typedef struct sdmmc {
     bool worker_thread_running;
 
     uint32_t max_transfer_size;
+
+    // Whether IOTXN_OP_TRIM can be done with an erase, which for MMC needs
+    // the card to trim by write block rather than by erase group.
+    bool trim_supported;
+
+    // Set while the card is known to be back in the transfer state after the
+    // last data command, so the next one can skip polling its status.
+    bool card_in_tran;
+    uint64_t status_polls_skipped;
 } sdmmc_t;
 
 // Issue a command to the host controller
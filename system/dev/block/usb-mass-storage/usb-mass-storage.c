@@ -50,15 +50,15 @@ static void ums_req_complete(usb_request_t* req, void* cookie) {
     }
 }
 
-static void ums_send_cbw(ums_t* ums, uint8_t lun, uint32_t transfer_length, uint8_t flags,
-                         uint8_t command_len, void* command) {
+static zx_status_t ums_fill_cbw(ums_t* ums, uint8_t lun, uint32_t transfer_length, uint8_t flags,
+                                uint8_t command_len, void* command) {
     usb_request_t* req = ums->cbw_req;
 
     ums_cbw_t* cbw;
     zx_status_t status = usb_request_mmap(req, (void **)&cbw);
     if (status != ZX_OK) {
         DEBUG_PRINT(("UMS: usb request mmap failed: %d\n", status));
-        return;
+        return status;
     }
 
     memset(cbw, 0, sizeof(*cbw));
@@ -71,21 +71,27 @@ static void ums_send_cbw(ums_t* ums, uint8_t lun, uint32_t transfer_length, uint
 
     // copy command_len bytes from the command passed in into the command_len
     memcpy(cbw->CBWCB, command, command_len);
+    return ZX_OK;
+}
+
+static void ums_send_cbw(ums_t* ums, uint8_t lun, uint32_t transfer_length, uint8_t flags,
+                         uint8_t command_len, void* command) {
+    if (ums_fill_cbw(ums, lun, transfer_length, flags, command_len, command) != ZX_OK) {
+        return;
+    }
 
+    usb_request_t* req = ums->cbw_req;
     completion_t completion = COMPLETION_INIT;
     req->cookie = &completion;
     usb_request_queue(&ums->usb, req);
     completion_wait(&completion, ZX_TIME_INFINITE);
 }
 
-static zx_status_t ums_read_csw(ums_t* ums, uint32_t* out_residue) {
-    completion_t completion = COMPLETION_INIT;
+// Checks the CSW that has just been received into ums->csw_req.
+static zx_status_t ums_process_csw(ums_t* ums, uint32_t* out_residue) {
     usb_request_t* csw_request = ums->csw_req;
-    csw_request->cookie = &completion;
-    usb_request_queue(&ums->usb, csw_request);
-    completion_wait(&completion, ZX_TIME_INFINITE);
-
-    csw_status_t csw_error = ums_verify_csw(ums, csw_request, out_residue);
+    csw_status_t csw_error = csw_request->response.status == ZX_OK ?
+                             ums_verify_csw(ums, csw_request, out_residue) : CSW_INVALID;
 
     if (csw_error == CSW_SUCCESS) {
         return ZX_OK;
@@ -100,6 +106,16 @@ static zx_status_t ums_read_csw(ums_t* ums, uint32_t* out_residue) {
     }
 }
 
+static zx_status_t ums_read_csw(ums_t* ums, uint32_t* out_residue) {
+    completion_t completion = COMPLETION_INIT;
+    usb_request_t* csw_request = ums->csw_req;
+    csw_request->cookie = &completion;
+    usb_request_queue(&ums->usb, csw_request);
+    completion_wait(&completion, ZX_TIME_INFINITE);
+
+    return ums_process_csw(ums, out_residue);
+}
+
 static csw_status_t ums_verify_csw(ums_t* ums, usb_request_t* csw_request, uint32_t* out_residue) {
     ums_csw_t csw;
     usb_request_copyfrom(csw_request, &csw, sizeof(csw), 0);
@@ -242,105 +258,57 @@ static zx_status_t ums_mode_sense6(ums_t* ums, uint8_t lun, scsi_mode_sense_6_da
     return status;
 }
 
-static zx_status_t ums_data_transfer(ums_t* ums, iotxn_t* txn, zx_off_t offset, size_t length,
-                                     uint8_t ep_address) {
-    usb_request_t* req = &ums->data_transfer_req;
-
-    zx_status_t status = usb_request_init(req, txn->vmo_handle,
+// Runs one bulk-only command with a data phase against |length| bytes of |txn|
+// at |offset|. The CBW, the data and the CSW requests are all queued up front,
+// so the host controller moves from one phase to the next without waiting on
+// this thread in between.
+static zx_status_t ums_pipelined_command(ums_t* ums, uint8_t lun, iotxn_t* txn,
+                                         zx_off_t offset, size_t length, uint8_t flags,
+                                         uint8_t command_len, void* command,
+                                         uint32_t* out_residue) {
+    usb_request_t* data_req = &ums->data_transfer_req;
+    uint8_t ep_address = (flags & USB_DIR_IN) ? ums->bulk_in_addr : ums->bulk_out_addr;
+
+    zx_status_t status = usb_request_init(data_req, txn->vmo_handle,
                                           txn->vmo_offset + offset,
                                           length, ep_address);
     if (status != ZX_OK) {
         return status;
     }
-    req->complete_cb = ums_req_complete;
+    data_req->complete_cb = ums_req_complete;
 
-    completion_t completion = COMPLETION_INIT;
-    req->cookie = &completion;
-    usb_request_queue(&ums->usb, req);
-    completion_wait(&completion, ZX_TIME_INFINITE);
-
-    status = req->response.status;
-    if (status == ZX_OK && req->response.actual != length) {
-        status = ZX_ERR_IO;
-    }
-
-    usb_request_release(req);
-    return status;
-}
-
-static ssize_t ums_read(ums_block_t* dev, iotxn_t* txn) {
-    ums_t* ums = block_to_ums(dev);
-
-    uint64_t lba = txn->offset / dev->block_size;
-    if (lba > dev->total_blocks) {
-        return ZX_ERR_OUT_OF_RANGE;
-    }
-    uint32_t num_blocks = txn->length / dev->block_size;
-    if (lba + num_blocks >= dev->total_blocks) {
-        num_blocks = dev->total_blocks - lba;
-        if (num_blocks == 0) {
-            return 0;
-        }
+    status = ums_fill_cbw(ums, lun, length, flags, command_len, command);
+    if (status != ZX_OK) {
+        usb_request_release(data_req);
+        return status;
     }
 
-    size_t blocks_transferred = 0;
-    size_t max_blocks = ums->max_transfer / dev->block_size;
-    zx_status_t status = ZX_OK;
-
-    while (status == ZX_OK && blocks_transferred < num_blocks) {
-        size_t blocks = num_blocks - blocks_transferred;
-        if (blocks > max_blocks) {
-            blocks = max_blocks;
-        }
-        size_t length = blocks * dev->block_size;
+    completion_t cbw_completion = COMPLETION_INIT;
+    completion_t data_completion = COMPLETION_INIT;
+    completion_t csw_completion = COMPLETION_INIT;
+    ums->cbw_req->cookie = &cbw_completion;
+    data_req->cookie = &data_completion;
+    ums->csw_req->cookie = &csw_completion;
 
-        // CBW Configuration
-        // Need to use UMS_READ16 if block addresses are greater than 32 bit
-        if (dev->total_blocks > UINT32_MAX) {
-            scsi_command16_t command;
-            memset(&command, 0, sizeof(command));
-            command.opcode = UMS_READ16;
-            command.lba = htobe64(lba + blocks_transferred);
-            command.length = htobe32(blocks);
-            ums_send_cbw(ums, dev->lun, length, USB_DIR_IN, sizeof(command), &command);
-        } else if (blocks <= UINT16_MAX) {
-            scsi_command10_t command;
-            memset(&command, 0, sizeof(command));
-            command.opcode = UMS_READ10;
-            command.lba = htobe32(lba + blocks_transferred);
-            command.length_hi = blocks >> 8;
-            command.length_lo = blocks & 0xFF;
-            ums_send_cbw(ums, dev->lun, length, USB_DIR_IN, sizeof(command), &command);
-        } else {
-            scsi_command12_t command;
-            memset(&command, 0, sizeof(command));
-            command.opcode = UMS_READ12;
-            command.lba = htobe32(lba + blocks_transferred);
-            command.length = htobe32(blocks);
-            ums_send_cbw(ums, dev->lun, length, USB_DIR_IN, sizeof(command), &command);
-        }
+    usb_request_queue(&ums->usb, ums->cbw_req);
+    usb_request_queue(&ums->usb, data_req);
+    usb_request_queue(&ums->usb, ums->csw_req);
 
-        status = ums_data_transfer(ums, txn, blocks_transferred * dev->block_size, length,
-                                   ums->bulk_in_addr);
-        blocks_transferred += blocks;
+    completion_wait(&cbw_completion, ZX_TIME_INFINITE);
+    completion_wait(&data_completion, ZX_TIME_INFINITE);
+    completion_wait(&csw_completion, ZX_TIME_INFINITE);
 
-        // receive CSW
-        uint32_t residue;
-        status = ums_read_csw(ums, &residue);
-        if (status == ZX_OK && residue) {
-            zxlogf(ERROR, "unexpected residue in ums_read\n");
-            status = ZX_ERR_IO;
-        }
+    zx_status_t data_status = data_req->response.status;
+    if (data_status == ZX_OK && data_req->response.actual != length) {
+        data_status = ZX_ERR_IO;
     }
+    usb_request_release(data_req);
 
-    if (status == ZX_OK) {
-        return num_blocks * dev->block_size;
-    } else {
-        return status;
-    }
+    status = ums_process_csw(ums, out_residue);
+    return status != ZX_OK ? status : data_status;
 }
 
-static ssize_t ums_write(ums_block_t* dev, iotxn_t* txn) {
+static ssize_t ums_rw(ums_block_t* dev, iotxn_t* txn, bool read) {
     ums_t* ums = block_to_ums(dev);
 
     uint64_t lba = txn->offset / dev->block_size;
@@ -366,40 +334,41 @@ static ssize_t ums_write(ums_block_t* dev, iotxn_t* txn) {
         }
         size_t length = blocks * dev->block_size;
 
-        // Need to use UMS_WRITE16 if block addresses are greater than 32 bit
+        union {
+            scsi_command10_t cmd10;
+            scsi_command12_t cmd12;
+            scsi_command16_t cmd16;
+        } command;
+        uint8_t command_len;
+        memset(&command, 0, sizeof(command));
+
+        // Need to use UMS_READ16/UMS_WRITE16 if block addresses are greater than 32 bit
         if (dev->total_blocks > UINT32_MAX) {
-            scsi_command16_t command;
-            memset(&command, 0, sizeof(command));
-            command.opcode = UMS_WRITE16;
-            command.lba = htobe64(lba + blocks_transferred);
-            command.length = htobe32(blocks);
-            ums_send_cbw(ums, dev->lun, length, USB_DIR_OUT, sizeof(command), &command);
+            command.cmd16.opcode = read ? UMS_READ16 : UMS_WRITE16;
+            command.cmd16.lba = htobe64(lba + blocks_transferred);
+            command.cmd16.length = htobe32(blocks);
+            command_len = sizeof(command.cmd16);
         } else if (blocks <= UINT16_MAX) {
-            scsi_command10_t command;
-            memset(&command, 0, sizeof(command));
-            command.opcode = UMS_WRITE10;
-            command.lba = htobe32(lba + blocks_transferred);
-            command.length_hi = blocks >> 8;
-            command.length_lo = blocks & 0xFF;
-            ums_send_cbw(ums, dev->lun, length, USB_DIR_OUT, sizeof(command), &command);
+            command.cmd10.opcode = read ? UMS_READ10 : UMS_WRITE10;
+            command.cmd10.lba = htobe32(lba + blocks_transferred);
+            command.cmd10.length_hi = blocks >> 8;
+            command.cmd10.length_lo = blocks & 0xFF;
+            command_len = sizeof(command.cmd10);
         } else {
-            scsi_command12_t command;
-            memset(&command, 0, sizeof(command));
-            command.opcode = UMS_WRITE12;
-            command.lba = htobe32(lba + blocks_transferred);
-            command.length = htobe32(blocks);
-            ums_send_cbw(ums, dev->lun, length, USB_DIR_OUT, sizeof(command), &command);
+            command.cmd12.opcode = read ? UMS_READ12 : UMS_WRITE12;
+            command.cmd12.lba = htobe32(lba + blocks_transferred);
+            command.cmd12.length = htobe32(blocks);
+            command_len = sizeof(command.cmd12);
         }
 
-        status = ums_data_transfer(ums, txn, blocks_transferred * dev->block_size, length,
-                                   ums->bulk_out_addr);
+        uint32_t residue = 0;
+        status = ums_pipelined_command(ums, dev->lun, txn, blocks_transferred * dev->block_size,
+                                       length, read ? USB_DIR_IN : USB_DIR_OUT,
+                                       command_len, &command, &residue);
         blocks_transferred += blocks;
 
-        // receive CSW
-        uint32_t residue;
-        status = ums_read_csw(ums, &residue);
         if (status == ZX_OK && residue) {
-            zxlogf(ERROR, "unexpected residue in ums_write\n");
+            zxlogf(ERROR, "unexpected residue in ums_%s\n", read ? "read" : "write");
             status = ZX_ERR_IO;
         }
     }
@@ -411,6 +380,14 @@ static ssize_t ums_write(ums_block_t* dev, iotxn_t* txn) {
     }
 }
 
+static ssize_t ums_read(ums_block_t* dev, iotxn_t* txn) {
+    return ums_rw(dev, txn, true);
+}
+
+static ssize_t ums_write(ums_block_t* dev, iotxn_t* txn) {
+    return ums_rw(dev, txn, false);
+}
+
 static void ums_unbind(void* ctx) {
     ums_t* ums = ctx;
 
@@ -0,0 +1,463 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <threads.h>
+
+#include <crypto/bytes.h>
+#include <ddk/debug.h>
+#include <ddk/device.h>
+#include <ddk/iotxn.h>
+#include <fbl/algorithm.h>
+#include <fbl/auto_call.h>
+#include <fbl/auto_lock.h>
+#include <fbl/new.h>
+#include <fbl/unique_ptr.h>
+#include <fs/mapped-vmo.h>
+#include <zircon/device/block.h>
+#include <zircon/listnode.h>
+#include <zircon/status.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
+#include <zircon/types.h>
+#include <zxcrypt/superblock.h>
+
+#include "device.h"
+#include "worker.h"
+
+namespace zxcrypt {
+namespace {
+
+// Largest transfer the device accepts, which bounds how much of the write buffer one write uses.
+const uint32_t kMaxTransferSize = 1U << 18;
+
+// Size of the write buffer.  Writes beyond what fits wait for earlier writes to complete.
+const size_t kBufferSize = 16 * kMaxTransferSize;
+
+} // namespace
+
+Device::Device(zx_device_t* parent)
+    : DeviceType(parent), has_fvm_(false), data_offset_(0), num_workers_(0) {
+    memset(&info_, 0, sizeof(info_));
+    memset(&fvm_, 0, sizeof(fvm_));
+    list_initialize(&pending_);
+}
+
+Device::~Device() {}
+
+zx_status_t Device::Init() {
+    zx_status_t rc;
+
+    auto cleanup = fbl::MakeAutoCall([&] {
+        zxlogf(ERROR, "zxcrypt: aborting driver load\n");
+        DdkRemove();
+        // Init runs on the thread created by bind and is joined in |DdkRelease|; if the device
+        // never becomes visible, detach the thread and clean up here instead.
+        thrd_detach(init_);
+        for (size_t i = 0; i < num_workers_; ++i) {
+            zx_port_packet_t packet;
+            packet.key = Worker::kStop;
+            packet.type = ZX_PKT_TYPE_USER;
+            port_.queue(&packet, 0);
+        }
+        for (size_t i = 0; i < num_workers_; ++i) {
+            workers_[i].Join();
+        }
+        delete this;
+    });
+
+    // TODO(aarongreen): ZX-1130 workaround; use the null key until keys can be passed on binding.
+    crypto::Bytes key;
+    fbl::unique_ptr<Superblock> superblock;
+    if ((rc = key.InitZero(kZx1130KeyLen)) != ZX_OK ||
+        (rc = Superblock::Open(parent(), key, 0, &superblock)) != ZX_OK ||
+        (rc = superblock->GetInfo(&info_, &fvm_)) != ZX_OK) {
+        zxlogf(ERROR, "zxcrypt: failed to open volume: %s\n", zx_status_get_string(rc));
+        return rc;
+    }
+    has_fvm_ = superblock->HasFVM();
+    data_offset_ = fvm_.slice_size;
+    // Only reads and writes are passed through to the parent.
+    info_.flags &= ~BLOCK_FLAG_TRIM_SUPPORT;
+
+    // Every transfer must fit in the write buffer, as well as the parent's limit.
+    uint32_t max_transfer = kMaxTransferSize;
+    if (info_.max_transfer_size != 0) {
+        max_transfer = fbl::min(max_transfer, info_.max_transfer_size);
+    }
+    info_.max_transfer_size = fbl::round_down(max_transfer, info_.block_size);
+    if (info_.max_transfer_size == 0) {
+        zxlogf(ERROR, "zxcrypt: block size %" PRIu32 " exceeds max transfer size %" PRIu32 "\n",
+               info_.block_size, max_transfer);
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    if ((rc = MappedVmo::Create(kBufferSize, "zxcrypt-buffer", &buf_)) != ZX_OK) {
+        zxlogf(ERROR, "zxcrypt: failed to create write buffer: %s\n", zx_status_get_string(rc));
+        return rc;
+    }
+    {
+        fbl::AutoLock lock(&mtx_);
+        if ((rc = map_.Reset(kBufferSize / info_.block_size)) != ZX_OK) {
+            return rc;
+        }
+    }
+
+    if ((rc = zx::port::create(0, &port_)) != ZX_OK) {
+        zxlogf(ERROR, "zxcrypt: failed to create port: %s\n", zx_status_get_string(rc));
+        return rc;
+    }
+    size_t num_workers = fbl::min(static_cast<size_t>(zx_system_get_num_cpus()), kMaxWorkers);
+    for (; num_workers_ < num_workers; ++num_workers_) {
+        if ((rc = workers_[num_workers_].Start(this, superblock.get())) != ZX_OK) {
+            return rc;
+        }
+    }
+
+    DdkMakeVisible();
+    cleanup.cancel();
+    return ZX_OK;
+}
+
+zx_status_t Device::DdkIoctl(uint32_t op, const void* in, size_t in_len, void* out,
+                             size_t out_len, size_t* actual) {
+    switch (op) {
+    case IOCTL_BLOCK_GET_INFO: {
+        if (out_len < sizeof(info_)) {
+            return ZX_ERR_BUFFER_TOO_SMALL;
+        }
+        fbl::AutoLock lock(&mtx_);
+        memcpy(out, &info_, sizeof(info_));
+        *actual = sizeof(info_);
+        return ZX_OK;
+    }
+    case IOCTL_BLOCK_FVM_QUERY: {
+        if (!has_fvm_) {
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+        if (out_len < sizeof(fvm_)) {
+            return ZX_ERR_BUFFER_TOO_SMALL;
+        }
+        memcpy(out, &fvm_, sizeof(fvm_));
+        *actual = sizeof(fvm_);
+        return ZX_OK;
+    }
+    case IOCTL_BLOCK_FVM_EXTEND:
+    case IOCTL_BLOCK_FVM_SHRINK:
+    case IOCTL_BLOCK_FVM_VSLICE_QUERY:
+        if (!has_fvm_) {
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+        return FvmIoctl(op, in, in_len, out, out_len, actual);
+    default:
+        return device_ioctl(parent(), op, in, in_len, out, out_len, actual);
+    }
+}
+
+zx_status_t Device::FvmIoctl(uint32_t op, const void* in, size_t in_len, void* out,
+                             size_t out_len, size_t* actual) {
+    zx_status_t rc;
+
+    // The first data slice is the parent's second slice.
+    switch (op) {
+    case IOCTL_BLOCK_FVM_EXTEND:
+    case IOCTL_BLOCK_FVM_SHRINK: {
+        if (in_len < sizeof(extend_request_t)) {
+            return ZX_ERR_BUFFER_TOO_SMALL;
+        }
+        extend_request_t request;
+        memcpy(&request, in, sizeof(request));
+        if (request.offset >= fvm_.vslice_count ||
+            request.length > fvm_.vslice_count - request.offset) {
+            return ZX_ERR_OUT_OF_RANGE;
+        }
+        request.offset += 1;
+        if ((rc = device_ioctl(parent(), op, &request, sizeof(request), nullptr, 0, nullptr)) !=
+            ZX_OK) {
+            return rc;
+        }
+        fbl::AutoLock lock(&mtx_);
+        size_t blocks = request.length * (fvm_.slice_size / info_.block_size);
+        if (op == IOCTL_BLOCK_FVM_EXTEND) {
+            info_.block_count += blocks;
+        } else {
+            info_.block_count -= blocks;
+        }
+        return ZX_OK;
+    }
+    case IOCTL_BLOCK_FVM_VSLICE_QUERY: {
+        if (in_len < sizeof(query_request_t)) {
+            return ZX_ERR_BUFFER_TOO_SMALL;
+        }
+        query_request_t request;
+        memcpy(&request, in, sizeof(request));
+        if (request.count > MAX_FVM_VSLICE_REQUESTS) {
+            return ZX_ERR_BUFFER_TOO_SMALL;
+        }
+        for (size_t i = 0; i < request.count; ++i) {
+            if (request.vslice_start[i] >= fvm_.vslice_count) {
+                return ZX_ERR_OUT_OF_RANGE;
+            }
+            request.vslice_start[i] += 1;
+        }
+        return device_ioctl(parent(), op, &request, sizeof(request), out, out_len, actual);
+    }
+    default:
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+}
+
+void Device::DdkIotxnQueue(iotxn_t* txn) {
+    const uint32_t block_size = info_.block_size;
+    if ((txn->offset % block_size) || (txn->length % block_size)) {
+        iotxn_complete(txn, ZX_ERR_INVALID_ARGS, 0);
+        return;
+    }
+    const uint64_t device_capacity = DdkGetSize();
+    if ((txn->offset >= device_capacity) || (device_capacity - txn->offset < txn->length) ||
+        txn->length > info_.max_transfer_size) {
+        iotxn_complete(txn, ZX_ERR_OUT_OF_RANGE, 0);
+        return;
+    }
+    if (txn->length == 0) {
+        iotxn_complete(txn, ZX_OK, 0);
+        return;
+    }
+    if (txn->opcode != IOTXN_OP_READ && txn->opcode != IOTXN_OP_WRITE) {
+        iotxn_complete(txn, ZX_ERR_NOT_SUPPORTED, 0);
+        return;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<Request> request(new (&ac) Request());
+    if (!ac.check()) {
+        iotxn_complete(txn, ZX_ERR_NO_MEMORY, 0);
+        return;
+    }
+    request->device = this;
+    request->txn = txn;
+    request->block = txn->offset / block_size;
+    request->status.store(ZX_OK);
+    txn->context = request.get();
+
+    zx_status_t rc;
+    void* data;
+    if (txn->opcode == IOTXN_OP_READ) {
+        // Read the ciphertext straight into the client's buffer.
+        iotxn_t* clone = nullptr;
+        if ((rc = iotxn_mmap(txn, &data)) != ZX_OK ||
+            (rc = iotxn_clone(txn, &clone)) != ZX_OK) {
+            iotxn_complete(txn, rc, 0);
+            return;
+        }
+        request->src = static_cast<const uint8_t*>(data);
+        request->dst = static_cast<uint8_t*>(data);
+        clone->offset += data_offset_;
+        clone->complete_cb = ReadComplete;
+        clone->cookie = request.release();
+        iotxn_queue(parent(), clone);
+        return;
+    }
+
+    if ((rc = iotxn_mmap(txn, &data)) != ZX_OK) {
+        iotxn_complete(txn, rc, 0);
+        return;
+    }
+    request->src = static_cast<const uint8_t*>(data);
+    {
+        // Keep writes in order behind any which are already waiting for space.
+        fbl::AutoLock lock(&mtx_);
+        if (!list_is_empty(&pending_) || !ReserveLocked(request.get())) {
+            list_add_tail(&pending_, &txn->node);
+            request.release();
+            return;
+        }
+    }
+    Dispatch(Worker::kEncrypt, request.release());
+}
+
+zx_off_t Device::DdkGetSize() {
+    fbl::AutoLock lock(&mtx_);
+    return info_.block_count * info_.block_size;
+}
+
+void Device::DdkUnbind() {
+    DdkRemove();
+}
+
+void Device::DdkRelease() {
+    thrd_join(init_, nullptr);
+    for (size_t i = 0; i < num_workers_; ++i) {
+        zx_port_packet_t packet;
+        packet.key = Worker::kStop;
+        packet.type = ZX_PKT_TYPE_USER;
+        port_.queue(&packet, 0);
+    }
+    for (size_t i = 0; i < num_workers_; ++i) {
+        workers_[i].Join();
+    }
+    delete this;
+}
+
+void Device::TaskDone(Request* request, zx_status_t rc) {
+    if (rc != ZX_OK) {
+        zx_status_t expected = ZX_OK;
+        request->status.compare_exchange_strong(&expected, rc, fbl::memory_order_seq_cst,
+                                                fbl::memory_order_seq_cst);
+    }
+    if (request->tasks.fetch_sub(1) != 1) {
+        return;
+    }
+    rc = request->status.load();
+    if (request->txn->opcode == IOTXN_OP_READ || rc != ZX_OK) {
+        if (request->txn->opcode == IOTXN_OP_WRITE) {
+            Release(request);
+        }
+        Complete(request, rc);
+        return;
+    }
+    SendWrite(request);
+}
+
+// Private methods
+
+void Device::SendWrite(Request* request) {
+    zx_status_t rc;
+
+    iotxn_t* txn = request->txn;
+    iotxn_t* write;
+    if ((rc = iotxn_alloc_vmo(&write, IOTXN_ALLOC_POOL, buf_->GetVmo(),
+                              request->buf_block * info_.block_size, txn->length)) != ZX_OK) {
+        Release(request);
+        Complete(request, rc);
+        return;
+    }
+    write->opcode = IOTXN_OP_WRITE;
+    write->flags = txn->flags;
+    write->offset = txn->offset + data_offset_;
+    write->complete_cb = WriteComplete;
+    write->cookie = request;
+    iotxn_queue(parent(), write);
+}
+
+void Device::ReadComplete(iotxn_t* txn, void* cookie) {
+    Request* request = static_cast<Request*>(cookie);
+    Device* device = request->device;
+    zx_status_t rc = txn->status;
+    iotxn_release(txn);
+    if (rc != ZX_OK) {
+        device->Complete(request, rc);
+        return;
+    }
+    device->Dispatch(Worker::kDecrypt, request);
+}
+
+void Device::WriteComplete(iotxn_t* txn, void* cookie) {
+    Request* request = static_cast<Request*>(cookie);
+    Device* device = request->device;
+    zx_status_t rc = txn->status;
+    iotxn_release(txn);
+    device->Release(request);
+    device->Complete(request, rc);
+}
+
+void Device::Dispatch(Worker::Op op, Request* request) {
+    zx_status_t rc;
+
+    // Split the request evenly between the workers.
+    uint64_t length = request->txn->length / info_.block_size;
+    uint64_t per_task = fbl::round_up(length, num_workers_) / num_workers_;
+    uint64_t num_tasks = fbl::round_up(length, per_task) / per_task;
+    request->tasks.store(num_tasks);
+
+    zx_port_packet_t packet;
+    packet.key = op;
+    packet.type = ZX_PKT_TYPE_USER;
+    packet.user.u64[0] = reinterpret_cast<uint64_t>(request);
+    for (uint64_t first = 0; first < length; first += per_task) {
+        packet.user.u64[1] = first;
+        packet.user.u64[2] = fbl::min(per_task, length - first);
+        if ((rc = port_.queue(&packet, 0)) != ZX_OK) {
+            zxlogf(ERROR, "zxcrypt: failed to queue task: %s\n", zx_status_get_string(rc));
+            // Fail this task and the rest which were never queued.
+            for (; first < length; first += per_task) {
+                TaskDone(request, rc);
+            }
+            return;
+        }
+    }
+}
+
+void Device::Complete(Request* request, zx_status_t rc) {
+    iotxn_t* txn = request->txn;
+    delete request;
+    iotxn_complete(txn, rc, rc == ZX_OK ? txn->length : 0);
+}
+
+bool Device::ReserveLocked(Request* request) {
+    size_t length = request->txn->length / info_.block_size;
+    if (map_.Find(false, 0, map_.size(), length, &request->buf_block) != ZX_OK ||
+        map_.Set(request->buf_block, request->buf_block + length) != ZX_OK) {
+        return false;
+    }
+    request->dst = static_cast<uint8_t*>(buf_->GetData()) + request->buf_block * info_.block_size;
+    return true;
+}
+
+void Device::Release(Request* request) {
+    {
+        fbl::AutoLock lock(&mtx_);
+        size_t length = request->txn->length / info_.block_size;
+        map_.Clear(request->buf_block, request->buf_block + length);
+    }
+    for (;;) {
+        Request* next;
+        {
+            fbl::AutoLock lock(&mtx_);
+            iotxn_t* txn = list_peek_head_type(&pending_, iotxn_t, node);
+            if (!txn) {
+                return;
+            }
+            next = static_cast<Request*>(txn->context);
+            if (!ReserveLocked(next)) {
+                return;
+            }
+            list_delete(&txn->node);
+        }
+        Dispatch(Worker::kEncrypt, next);
+    }
+}
+
+} // namespace zxcrypt
+
+// C-compatibility definitions
+
+static int zxcrypt_init_thread(void* arg) {
+    return reinterpret_cast<zxcrypt::Device*>(arg)->Init();
+}
+
+zx_status_t zxcrypt_bind(zx_device_t* parent) {
+    zx_status_t rc;
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<zxcrypt::Device> device(new (&ac) zxcrypt::Device(parent));
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    if ((rc = device->DdkAdd("zxcrypt", DEVICE_ADD_INVISIBLE)) != ZX_OK) {
+        return rc;
+    }
+
+    // Open the volume asynchronously
+    if (thrd_create_with_name(&device->init_, zxcrypt_init_thread, device.get(),
+                              "zxcrypt-init") != thrd_success) {
+        device->DdkRemove();
+        return ZX_ERR_NO_RESOURCES;
+    }
+    device.release();
+    return ZX_OK;
+}
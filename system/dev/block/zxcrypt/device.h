@@ -0,0 +1,134 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <ddk/device.h>
+#include <zircon/types.h>
+
+#ifdef __cplusplus
+
+#include <stddef.h>
+#include <stdint.h>
+#include <threads.h>
+
+#include <bitmap/raw-bitmap.h>
+#include <bitmap/storage.h>
+#include <ddk/iotxn.h>
+#include <ddktl/device.h>
+#include <ddktl/protocol/block.h>
+#include <fbl/macros.h>
+#include <fbl/mutex.h>
+#include <fbl/unique_ptr.h>
+#include <fs/mapped-vmo.h>
+#include <zircon/device/block.h>
+#include <zircon/listnode.h>
+#include <zircon/thread_annotations.h>
+#include <zx/port.h>
+
+#include "worker.h"
+
+namespace zxcrypt {
+
+class Device;
+using DeviceType = ddk::Device<Device, ddk::Ioctlable, ddk::IotxnQueueable, ddk::GetSizable,
+                               ddk::Unbindable>;
+
+// |zxcrypt::Device| is the encrypted block device presented on top of a raw block device or FVM
+// partition.  The first and last slices of the parent hold the superblocks; the rest is data,
+// encrypted per block with AES-XTS and tweaked by block number.
+//
+// Reads are sent to the parent as-is and decrypted in place in the client's buffer.  Writes are
+// encrypted into a shared write buffer, which is what gets sent to the parent, so the client's
+// plaintext is never modified.  In both cases the cipher work for a request is split across a pool
+// of |Worker|s.
+class Device final : public DeviceType, public ddk::BlockProtocol<Device> {
+public:
+    explicit Device(zx_device_t* parent);
+    ~Device();
+
+    // Opens the superblock, starts the workers and makes the device visible.  Run on a separate
+    // thread from bind, since opening the superblock does synchronous I/O to the parent.
+    zx_status_t Init();
+
+    // ddk::Device methods
+    zx_status_t DdkIoctl(uint32_t op, const void* in, size_t in_len, void* out, size_t out_len,
+                         size_t* actual);
+    void DdkIotxnQueue(iotxn_t* txn);
+    zx_off_t DdkGetSize();
+    void DdkUnbind();
+    void DdkRelease();
+
+    // Called by a worker when it has finished one of |request|'s tasks.
+    void TaskDone(Request* request, zx_status_t rc);
+
+    // Accessors for the workers.
+    const zx::port& port() const { return port_; }
+    uint32_t block_size() const { return info_.block_size; }
+
+    // The thread running |Init|.
+    thrd_t init_;
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(Device);
+
+    // Maximum number of worker threads.
+    static const size_t kMaxWorkers = 8;
+
+    // Sends the ciphertext for |request| from the write buffer to the parent.
+    void SendWrite(Request* request);
+
+    // Completion callbacks for txns sent to the parent; |cookie| is the |Request|.
+    static void ReadComplete(iotxn_t* txn, void* cookie);
+    static void WriteComplete(iotxn_t* txn, void* cookie);
+
+    // Splits |request| into tasks and queues them to the workers.
+    void Dispatch(Worker::Op op, Request* request);
+
+    // Completes |request|'s txn and frees it.
+    void Complete(Request* request, zx_status_t rc);
+
+    // Reserves space in the write buffer for |request|.  Returns false if there is no room.
+    bool ReserveLocked(Request* request) TA_REQ(mtx_);
+
+    // Releases |request|'s space in the write buffer and starts any writes that were waiting on it.
+    void Release(Request* request);
+
+    // Forwards an FVM ioctl to the parent, shifted past the first reserved slice.
+    zx_status_t FvmIoctl(uint32_t op, const void* in, size_t in_len, void* out, size_t out_len,
+                         size_t* actual);
+
+    // Block and FVM geometry of the zxcrypt device, as adjusted by the superblock.
+    block_info_t info_;
+    fvm_info_t fvm_;
+    bool has_fvm_;
+    // Byte offset on the parent of the first data block.
+    zx_off_t data_offset_;
+
+    // Task queue shared by the workers.
+    zx::port port_;
+    Worker workers_[kMaxWorkers];
+    size_t num_workers_;
+
+    // Write buffer holding ciphertext on its way to the parent.
+    fbl::unique_ptr<MappedVmo> buf_;
+
+    fbl::Mutex mtx_;
+    // Blocks of the write buffer in use.
+    bitmap::RawBitmapGeneric<bitmap::DefaultStorage> map_ TA_GUARDED(mtx_);
+    // Writes waiting on space in the write buffer, linked through |Request::txn->node|.
+    list_node_t pending_ TA_GUARDED(mtx_);
+};
+
+} // namespace zxcrypt
+
+#endif // ifdef __cplusplus
+
+__BEGIN_CDECLS
+
+// Binds the zxcrypt driver to a block device; the volume is opened asynchronously in a background
+// thread.
+zx_status_t zxcrypt_bind(zx_device_t* dev);
+
+__END_CDECLS
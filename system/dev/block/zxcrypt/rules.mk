@@ -0,0 +1,36 @@
+# Copyright 2017 The Fuchsia Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+MODULE := $(LOCAL_DIR)
+
+MODULE_TYPE := driver
+
+MODULE_SRCS := \
+    $(LOCAL_DIR)/device.cpp \
+    $(LOCAL_DIR)/worker.cpp \
+    $(LOCAL_DIR)/zxcrypt.c \
+
+MODULE_STATIC_LIBS := \
+    system/ulib/bitmap \
+    system/ulib/ddk \
+    system/ulib/ddktl \
+    system/ulib/fs \
+    system/ulib/zx \
+    system/ulib/zxcpp \
+    system/ulib/fbl \
+    system/ulib/sync \
+    third_party/ulib/safeint \
+    third_party/ulib/uboringssl \
+
+MODULE_LIBS := \
+    system/ulib/c \
+    system/ulib/crypto \
+    system/ulib/driver \
+    system/ulib/zircon \
+    system/ulib/fdio \
+    system/ulib/zxcrypt \
+
+include make/module.mk
@@ -0,0 +1,103 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <threads.h>
+
+#include <crypto/cipher.h>
+#include <ddk/debug.h>
+#include <zircon/status.h>
+#include <zircon/syscalls/port.h>
+#include <zircon/types.h>
+#include <zxcrypt/superblock.h>
+
+#include "device.h"
+#include "worker.h"
+
+namespace zxcrypt {
+
+Worker::Worker() : device_(nullptr), started_(false) {}
+
+Worker::~Worker() {
+    ZX_DEBUG_ASSERT(!started_);
+}
+
+zx_status_t Worker::Start(Device* device, Superblock* superblock) {
+    zx_status_t rc;
+
+    if ((rc = superblock->BindCiphers(&encrypt_, &decrypt_)) != ZX_OK) {
+        zxlogf(ERROR, "zxcrypt: failed to bind ciphers: %s\n", zx_status_get_string(rc));
+        return rc;
+    }
+    device_ = device;
+    if (thrd_create_with_name(&thrd_, WorkerThread, this, "zxcrypt-worker") != thrd_success) {
+        zxlogf(ERROR, "zxcrypt: failed to start worker thread\n");
+        return ZX_ERR_NO_RESOURCES;
+    }
+    started_ = true;
+    return ZX_OK;
+}
+
+zx_status_t Worker::Join() {
+    if (!started_) {
+        return ZX_OK;
+    }
+    int rc;
+    thrd_join(thrd_, &rc);
+    started_ = false;
+    return static_cast<zx_status_t>(rc);
+}
+
+int Worker::WorkerThread(void* arg) {
+    return static_cast<Worker*>(arg)->Loop();
+}
+
+zx_status_t Worker::Loop() {
+    zx_status_t rc;
+    zx_port_packet_t packet;
+    for (;;) {
+        if ((rc = device_->port().wait(ZX_TIME_INFINITE, &packet, 0)) != ZX_OK) {
+            zxlogf(ERROR, "zxcrypt: failed to read task: %s\n", zx_status_get_string(rc));
+            return rc;
+        }
+        Op op = static_cast<Op>(packet.key);
+        if (op == kStop) {
+            return ZX_OK;
+        }
+        Request* request = reinterpret_cast<Request*>(packet.user.u64[0]);
+        rc = Transform(op, request, packet.user.u64[1], packet.user.u64[2]);
+        device_->TaskDone(request, rc);
+    }
+}
+
+zx_status_t Worker::Transform(Op op, Request* request, uint64_t first, uint64_t count) {
+    zx_status_t rc;
+    const size_t block_size = device_->block_size();
+    const uint8_t* src = request->src + first * block_size;
+    uint8_t* dst = request->dst + first * block_size;
+    for (uint64_t block = request->block + first; count != 0; --count, ++block) {
+        switch (op) {
+        case kEncrypt:
+            if ((rc = encrypt_.Tweak(block)) != ZX_OK ||
+                (rc = encrypt_.Encrypt(src, block_size, dst)) != ZX_OK) {
+                return rc;
+            }
+            break;
+        case kDecrypt:
+            if ((rc = decrypt_.Tweak(block)) != ZX_OK ||
+                (rc = decrypt_.Decrypt(src, block_size, dst)) != ZX_OK) {
+                return rc;
+            }
+            break;
+        default:
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+        src += block_size;
+        dst += block_size;
+    }
+    return ZX_OK;
+}
+
+} // namespace zxcrypt
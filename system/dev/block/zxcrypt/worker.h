@@ -0,0 +1,87 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <threads.h>
+
+#include <crypto/cipher.h>
+#include <ddk/iotxn.h>
+#include <fbl/atomic.h>
+#include <fbl/macros.h>
+#include <zircon/types.h>
+#include <zxcrypt/superblock.h>
+
+namespace zxcrypt {
+
+class Device;
+
+// |zxcrypt::Request| tracks a single iotxn while its blocks are transformed by the workers.  The
+// blocks are split into contiguous ranges, each of which is a task for one worker; the last task to
+// finish hands the request back to the device.
+struct Request {
+    // The device the request was queued to.
+    Device* device;
+    // The iotxn queued to the zxcrypt device.
+    iotxn_t* txn;
+    // Mapped data to read from and write to.  For reads these are both the client's buffer, which
+    // is decrypted in place.  For writes, the client's buffer is encrypted into the write buffer.
+    const uint8_t* src;
+    uint8_t* dst;
+    // The first block of the request, in zxcrypt device blocks.  Used as the tweak for the cipher.
+    uint64_t block;
+    // The first block of the write buffer holding this request's ciphertext.  Writes only.
+    size_t buf_block;
+    // Number of tasks not yet finished, and the first error any of them encountered.
+    fbl::atomic<size_t> tasks;
+    fbl::atomic<zx_status_t> status;
+};
+
+// |zxcrypt::Worker| is a thread which pulls tasks from the device's port and encrypts or decrypts
+// the blocks they describe.  Each worker has its own ciphers, since a cipher's tweak is per-object
+// state.
+class Worker final {
+public:
+    // Port packet keys.  Task packets carry the |Request| and the range of its blocks to transform
+    // in |user.u64[0..2]|.
+    enum Op : uint64_t {
+        kStop = 0,
+        kEncrypt,
+        kDecrypt,
+    };
+
+    Worker();
+    ~Worker();
+
+    // Binds this worker's ciphers to the data key from |superblock| and starts its thread.
+    zx_status_t Start(Device* device, Superblock* superblock);
+
+    // Waits for the thread to exit.  The device must have queued a |kStop| packet for it.
+    zx_status_t Join();
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(Worker);
+
+    // Thread entry point; |arg| is the worker.
+    static int WorkerThread(void* arg);
+
+    // Handles packets until told to stop.
+    zx_status_t Loop();
+
+    // Transforms |count| blocks of |request|, starting |first| blocks into it.
+    zx_status_t Transform(Op op, Request* request, uint64_t first, uint64_t count);
+
+    // The device this worker belongs to.
+    Device* device_;
+    // Ciphers bound to the volume's data key.
+    crypto::Cipher encrypt_;
+    crypto::Cipher decrypt_;
+    // The worker thread, and whether it is running.
+    thrd_t thrd_;
+    bool started_;
+};
+
+} // namespace zxcrypt
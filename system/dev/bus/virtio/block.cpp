@@ -6,6 +6,7 @@
 
 #include <ddk/debug.h>
 #include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
 #include <fbl/auto_lock.h>
 #include <inttypes.h>
 #include <pretty/hexdump.h>
@@ -14,6 +15,8 @@
 #include <string.h>
 #include <sys/param.h>
 #include <zircon/compiler.h>
+#include <zircon/syscalls.h>
+#include <zircon/threads.h>
 
 #include "trace.h"
 #include "utils.h"
@@ -60,7 +63,7 @@ void BlockDevice::GetInfo(block_info_t* info) {
     memset(info, 0, sizeof(*info));
     info->block_size = GetBlockSize();
     info->block_count = GetSize() / GetBlockSize();
-    info->max_transfer_size = (uint32_t)(PAGE_SIZE * (ring_size - 2));
+    info->max_transfer_size = (uint32_t)(PAGE_SIZE * kMaxSegments);
 }
 
 zx_status_t BlockDevice::virtio_block_ioctl(void* ctx, uint32_t op, const void* in_buf, size_t in_len,
@@ -95,6 +98,84 @@ BlockDevice::~BlockDevice() {
     // TODO: clean up allocated physical memory
 }
 
+// Negotiates features with the device; see section 5.2.3 of the spec.  Each
+// of these only changes how requests are laid out in (or signalled through)
+// the rings, so the device works the same way without any of them.
+zx_status_t BlockDevice::NegotiateFeatures() {
+    if (DeviceFeatureSupported(VIRTIO_F_RING_INDIRECT_DESC)) {
+        DriverFeatureAck(VIRTIO_F_RING_INDIRECT_DESC);
+        indirect_ = true;
+    }
+    if (DeviceFeatureSupported(VIRTIO_F_RING_EVENT_IDX)) {
+        DriverFeatureAck(VIRTIO_F_RING_EVENT_IDX);
+        event_idx_ = true;
+    }
+    if (DeviceFeatureSupported(VIRTIO_BLK_F_MQ)) {
+        DriverFeatureAck(VIRTIO_BLK_F_MQ);
+        // One queue per CPU, as far as both ends allow
+        uint32_t queues = fbl::min(zx_system_get_num_cpus(), static_cast<uint32_t>(kMaxQueues));
+        queues = fbl::min(queues, static_cast<uint32_t>(config_.num_queues));
+        num_queues_ = static_cast<uint16_t>(fbl::max(queues, 1u));
+    }
+
+    zx_status_t status = DeviceStatusFeaturesOk();
+    if (status != ZX_OK) {
+        zxlogf(ERROR, "%s: feature negotiation failed %d\n", tag(), status);
+        return status;
+    }
+    return ZX_OK;
+}
+
+zx_status_t BlockDevice::InitQueue(uint16_t n) {
+    Queue* q = &queues_[n];
+
+    fbl::AllocChecker ac;
+    q->ring.reset(new (&ac) Ring(this));
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    auto err = q->ring->Init(n, ring_size);
+    if (err < 0) {
+        zxlogf(ERROR, "failed to allocate vring %u\n", n);
+        return err;
+    }
+    if (event_idx_) {
+        q->ring->EnableEventIdx();
+    }
+
+    // allocate a queue of block requests
+    size_t size = sizeof(virtio_blk_req_t) * blk_req_count + sizeof(uint8_t) * blk_req_count;
+
+    zx_status_t r = map_contiguous_memory(size, (uintptr_t*)&q->blk_req, &q->blk_req_pa);
+    if (r < 0) {
+        zxlogf(ERROR, "cannot alloc blk_req buffers %d\n", r);
+        return r;
+    }
+
+    LTRACEF("allocated blk request at %p, physical address %#" PRIxPTR "\n",
+            q->blk_req, q->blk_req_pa);
+
+    // responses are 32 words at the end of the allocated block
+    q->blk_res_pa = q->blk_req_pa + sizeof(virtio_blk_req_t) * blk_req_count;
+    q->blk_res = (uint8_t*)((uintptr_t)q->blk_req + sizeof(virtio_blk_req_t) * blk_req_count);
+
+    LTRACEF("allocated blk responses at %p, physical address %#" PRIxPTR "\n",
+            q->blk_res, q->blk_res_pa);
+
+    // and a descriptor table for each request, if they are to be indirect
+    if (indirect_) {
+        size = sizeof(vring_desc) * kIndirectDescs * blk_req_count;
+        r = map_contiguous_memory(size, (uintptr_t*)&q->indirect, &q->indirect_pa);
+        if (r < 0) {
+            zxlogf(ERROR, "cannot alloc indirect descriptor tables %d\n", r);
+            return r;
+        }
+    }
+
+    return ZX_OK;
+}
+
 zx_status_t BlockDevice::Init() {
     LTRACE_ENTRY;
 
@@ -119,31 +200,19 @@ zx_status_t BlockDevice::Init() {
     // ack and set the driver status bit
     DriverStatusAck();
 
-    // XXX check features bits and ack/nak them
-
-    // allocate the main vring
-    auto err = vring_.Init(0, ring_size);
-    if (err < 0) {
-        zxlogf(ERROR, "failed to allocate vring\n");
-        return err;
-    }
-
-    // allocate a queue of block requests
-    size_t size = sizeof(virtio_blk_req_t) * blk_req_count + sizeof(uint8_t) * blk_req_count;
-
-    zx_status_t r = map_contiguous_memory(size, (uintptr_t*)&blk_req_, &blk_req_pa_);
-    if (r < 0) {
-        zxlogf(ERROR, "cannot alloc blk_req buffers %d\n", r);
+    zx_status_t r = NegotiateFeatures();
+    if (r != ZX_OK) {
         return r;
     }
+    LTRACEF("queues %u, indirect %d, event idx %d\n", num_queues_, indirect_, event_idx_);
 
-    LTRACEF("allocated blk request at %p, physical address %#" PRIxPTR "\n", blk_req_, blk_req_pa_);
-
-    // responses are 32 words at the end of the allocated block
-    blk_res_pa_ = blk_req_pa_ + sizeof(virtio_blk_req_t) * blk_req_count;
-    blk_res_ = (uint8_t*)((uintptr_t)blk_req_ + sizeof(virtio_blk_req_t) * blk_req_count);
-
-    LTRACEF("allocated blk responses at %p, physical address %#" PRIxPTR "\n", blk_res_, blk_res_pa_);
+    // allocate the vrings
+    for (uint16_t n = 0; n < num_queues_; n++) {
+        r = InitQueue(n);
+        if (r != ZX_OK) {
+            return r;
+        }
+    }
 
     // start the interrupt thread
     StartIrqThread();
@@ -176,10 +245,18 @@ zx_status_t BlockDevice::Init() {
 void BlockDevice::IrqRingUpdate() {
     LTRACE_ENTRY;
 
+    for (uint16_t n = 0; n < num_queues_; n++) {
+        QueueRingUpdate(&queues_[n]);
+    }
+}
+
+void BlockDevice::QueueRingUpdate(Queue* q) {
+    list_node completed = LIST_INITIAL_VALUE(completed);
+
     // parse our descriptor chain, add back to the free queue
-    auto free_chain = [this](vring_used_elem* used_elem) {
+    auto free_chain = [this, q, &completed](vring_used_elem* used_elem) {
         uint32_t i = (uint16_t)used_elem->id;
-        struct vring_desc* desc = vring_.DescFromIndex((uint16_t)i);
+        struct vring_desc* desc = q->ring->DescFromIndex((uint16_t)i);
         auto head_desc = desc; // save the first element
         for (;;) {
             int next;
@@ -191,29 +268,40 @@ void BlockDevice::IrqRingUpdate() {
                 next = -1;
             }
 
-            vring_.FreeDesc((uint16_t)i);
+            q->ring->FreeDesc((uint16_t)i);
 
             if (next < 0)
                 break;
             i = next;
-            desc = vring_.DescFromIndex((uint16_t)i);
+            desc = q->ring->DescFromIndex((uint16_t)i);
         }
 
         // search our pending txn list to see if this completes it
         iotxn_t* txn;
-        list_for_every_entry (&iotxn_list, txn, iotxn_t, node) {
+        list_for_every_entry (&q->iotxn_list, txn, iotxn_t, node) {
             if (txn->context == head_desc) {
                 LTRACEF("completes txn %p\n", txn);
-                free_blk_req((unsigned int)txn->extra[1]);
+                size_t index = (size_t)txn->extra[1];
+                txn->status = (q->blk_res[index] == VIRTIO_BLK_S_OK) ? ZX_OK : ZX_ERR_IO;
+                q->free_blk_req(index);
                 list_delete(&txn->node);
-                iotxn_complete(txn, ZX_OK, txn->length);
+                list_add_tail(&completed, &txn->node);
                 break;
             }
         }
     };
 
     // tell the ring to find free chains and hand it back to our lambda
-    vring_.IrqRingUpdate(free_chain);
+    {
+        fbl::AutoLock lock(&q->lock);
+        q->ring->IrqRingUpdate(free_chain);
+    }
+
+    // complete outside the lock, since completion callbacks may queue more work
+    iotxn_t* txn;
+    while ((txn = list_remove_head_type(&completed, iotxn_t, node)) != nullptr) {
+        iotxn_complete(txn, txn->status, txn->status == ZX_OK ? txn->length : 0);
+    }
 }
 
 void BlockDevice::IrqConfigChange() {
@@ -256,11 +344,19 @@ static void ScatterGatherHelper(const iotxn_t* txn, callback callback_new_run) {
         callback_new_run(run_start, run_len);
 }
 
+BlockDevice::Queue* BlockDevice::SelectQueue() {
+    if (num_queues_ == 1) {
+        return &queues_[0];
+    }
+    // There is no cheap way to ask which CPU we are on, so spread threads
+    // over the queues instead; a thread's requests stay on one queue.
+    uint32_t h = static_cast<uint32_t>(thrd_get_zx_handle(thrd_current())) * 0x9e3779b1u;
+    return &queues_[(h >> 16) % num_queues_];
+}
+
 void BlockDevice::QueueReadWriteTxn(iotxn_t* txn) {
     LTRACEF("txn %p, pflags %#x\n", txn, txn->pflags);
 
-    fbl::AutoLock lock(&lock_);
-
     bool write = (txn->opcode == IOTXN_OP_WRITE);
 
     // offset must be aligned to block size
@@ -288,24 +384,6 @@ void BlockDevice::QueueReadWriteTxn(iotxn_t* txn) {
         return;
     }
 
-    // allocate and start filling out a block request
-    auto index = alloc_blk_req();
-    if (index >= blk_req_count) {
-        TRACEF("too many block requests queued (%zu)!\n", index);
-        iotxn_complete(txn, ZX_ERR_NO_RESOURCES, 0);
-        return;
-    }
-
-    auto req = &blk_req_[index];
-    req->type = write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
-    req->ioprio = 0;
-    req->sector = txn->offset / 512;
-    LTRACEF("blk_req type %u ioprio %u sector %" PRIu64 "\n",
-            req->type, req->ioprio, req->sector);
-
-    // save the req index into the txn->extra[1] slot so we can free it when we complete the transfer
-    txn->extra[1] = index;
-
     // get the physical map for the transfer
     auto status = iotxn_physmap(txn);
     LTRACEF("status %d, pflags %#x\n", status, txn->pflags);
@@ -331,30 +409,84 @@ void BlockDevice::QueueReadWriteTxn(iotxn_t* txn) {
     LTRACEF("run count %lu\n", run_count);
     assert(run_count > 0);
 
+    if (run_count > kMaxSegments) {
+        TRACEF("transfer of %zu runs is too fragmented\n", run_count);
+        iotxn_complete(txn, ZX_ERR_NO_RESOURCES, 0);
+        return;
+    }
+
+    Queue* q = SelectQueue();
+    fbl::AutoLock lock(&q->lock);
+
+    // allocate and start filling out a block request
+    auto index = q->alloc_blk_req();
+    if (index >= blk_req_count) {
+        TRACEF("too many block requests queued (%zu)!\n", index);
+        lock.release();
+        iotxn_complete(txn, ZX_ERR_NO_RESOURCES, 0);
+        return;
+    }
+
+    auto req = &q->blk_req[index];
+    req->type = write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+    req->ioprio = 0;
+    req->sector = txn->offset / 512;
+    LTRACEF("blk_req type %u ioprio %u sector %" PRIu64 "\n",
+            req->type, req->ioprio, req->sector);
+    q->blk_res[index] = 0xff;
+
+    // save the req index into the txn->extra[1] slot so we can free it when we complete the transfer
+    txn->extra[1] = index;
+
     /* put together a transfer */
     uint16_t i;
-    auto desc = vring_.AllocDescChain((uint16_t)(2u + run_count), &i);
-    if (!desc) {
-        TRACEF("failed to allocate descriptor chain of length %zu\n", 2u + run_count);
+    auto head = q->ring->AllocDescChain(indirect_ ? 1u : (uint16_t)(2u + run_count), &i);
+    if (!head) {
+        TRACEF("failed to allocate descriptor chain of length %zu\n",
+               indirect_ ? 1u : 2u + run_count);
         // TODO: handle this scenario by requeing the transfer in smaller runs
+        q->free_blk_req(index);
+        lock.release();
         iotxn_complete(txn, ZX_ERR_NO_RESOURCES, 0);
         return;
     }
 
-    LTRACEF("after alloc chain desc %p, i %u\n", desc, i);
+    LTRACEF("after alloc chain desc %p, i %u\n", head, i);
 
     /* point the iotxn at this head descriptor */
-    txn->context = desc;
+    txn->context = head;
+
+    // With indirect descriptors the chain is built in this request's own
+    // table, and the single ring descriptor points at it.
+    vring_desc* table = nullptr;
+    uint16_t table_index = 0;
+    auto next_desc = [&](vring_desc* desc) -> vring_desc* {
+        if (table) {
+            desc->next = ++table_index;
+            return &table[table_index];
+        }
+        return q->ring->DescFromIndex(desc->next);
+    };
+
+    vring_desc* desc = head;
+    if (indirect_) {
+        table = q->indirect + index * kIndirectDescs;
+        head->addr = q->indirect_pa + index * kIndirectDescs * sizeof(vring_desc);
+        head->len = (uint32_t)((2u + run_count) * sizeof(vring_desc));
+        head->flags = VRING_DESC_F_INDIRECT;
+        LTRACE_DO(virtio_dump_desc(head));
+        desc = &table[0];
+    }
 
     /* set up the descriptor pointing to the head */
-    desc->addr = blk_req_pa_ + index * sizeof(virtio_blk_req_t);
+    desc->addr = q->blk_req_pa + index * sizeof(virtio_blk_req_t);
     desc->len = sizeof(virtio_blk_req_t);
     desc->flags = VRING_DESC_F_NEXT;
     LTRACE_DO(virtio_dump_desc(desc));
     {
-        auto new_run_callback = [this, write, &desc](uint64_t start, uint64_t len) {
+        auto new_run_callback = [write, &desc, &next_desc](uint64_t start, uint64_t len) {
             /* set up the descriptor pointing to the buffer */
-            desc = vring_.DescFromIndex(desc->next);
+            desc = next_desc(desc);
 
             desc->addr = start;
             desc->len = (uint32_t)len;
@@ -370,20 +502,20 @@ void BlockDevice::QueueReadWriteTxn(iotxn_t* txn) {
     LTRACE_DO(virtio_dump_desc(desc));
 
     /* set up the descriptor pointing to the response */
-    desc = vring_.DescFromIndex(desc->next);
-    desc->addr = blk_res_pa_ + index;
+    desc = next_desc(desc);
+    desc->addr = q->blk_res_pa + index;
     desc->len = 1;
     desc->flags = VRING_DESC_F_WRITE;
     LTRACE_DO(virtio_dump_desc(desc));
 
     // save the iotxn in a list
-    list_add_tail(&iotxn_list, &txn->node);
+    list_add_tail(&q->iotxn_list, &txn->node);
 
     /* submit the transfer */
-    vring_.SubmitChain(i);
+    q->ring->SubmitChain(i);
 
     /* kick it off */
-    vring_.Kick();
+    q->ring->Kick();
 }
 
 } // namespace virtio
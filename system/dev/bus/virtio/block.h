@@ -6,6 +6,8 @@
 #include "device.h"
 #include "ring.h"
 
+#include <fbl/mutex.h>
+#include <fbl/unique_ptr.h>
 #include <stdlib.h>
 #include <zircon/compiler.h>
 
@@ -41,42 +43,72 @@ private:
 
     void GetInfo(block_info_t* info);
 
-    void QueueReadWriteTxn(iotxn_t* txn);
+    zx_status_t NegotiateFeatures();
+    zx_status_t InitQueue(uint16_t n);
 
-    // the main virtio ring
-    Ring vring_ = {this};
+    void QueueReadWriteTxn(iotxn_t* txn);
 
     static const uint16_t ring_size = 128; // 128 matches legacy pci
 
-    // saved block device configuration out of the pci config BAR
-    virtio_blk_config_t config_ = {};
+    // Upper bound on the number of request queues, however many CPUs or
+    // device queues there are.
+    static const uint16_t kMaxQueues = 8;
 
     // a queue of block request/responses
     static const size_t blk_req_count = 32;
 
-    zx_paddr_t blk_req_pa_ = 0;
-    virtio_blk_req_t* blk_req_ = nullptr;
+    // Data segments in the largest transfer; one descriptor each, plus one for
+    // the request header and one for the status byte.  With indirect
+    // descriptors each request has a table this long, so the whole transfer
+    // takes a single ring entry.
+    static const size_t kMaxSegments = ring_size - 2;
+    static const size_t kIndirectDescs = kMaxSegments + 2;
+
+    // Requests issued from a thread all go down the same queue, so a
+    // submitter does not contend with submitters on other queues.
+    struct Queue {
+        fbl::Mutex lock;
+        fbl::unique_ptr<Ring> ring;
+
+        zx_paddr_t blk_req_pa = 0;
+        virtio_blk_req_t* blk_req = nullptr;
 
-    zx_paddr_t blk_res_pa_ = 0;
-    uint8_t* blk_res_ = nullptr;
+        zx_paddr_t blk_res_pa = 0;
+        uint8_t* blk_res = nullptr;
 
-    uint32_t blk_req_bitmap_ = 0;
-    static_assert(blk_req_count <= sizeof(blk_req_bitmap_) * CHAR_BIT, "");
+        // Only allocated when indirect descriptors are in use.
+        zx_paddr_t indirect_pa = 0;
+        vring_desc* indirect = nullptr;
 
-    size_t alloc_blk_req() {
-        size_t i = 0;
-        if (blk_req_bitmap_ != 0)
-            i = sizeof(blk_req_bitmap_) * CHAR_BIT - __builtin_clz(blk_req_bitmap_);
-        blk_req_bitmap_ |= (1 << i);
-        return i;
-    }
+        uint32_t blk_req_bitmap = 0;
 
-    void free_blk_req(size_t i) {
-        blk_req_bitmap_ &= ~(1 << i);
-    }
+        // pending iotxns
+        list_node iotxn_list = LIST_INITIAL_VALUE(iotxn_list);
 
-    // pending iotxns
-    list_node iotxn_list = LIST_INITIAL_VALUE(iotxn_list);
+        size_t alloc_blk_req() {
+            size_t i = 0;
+            if (blk_req_bitmap != 0)
+                i = sizeof(blk_req_bitmap) * CHAR_BIT - __builtin_clz(blk_req_bitmap);
+            blk_req_bitmap |= (1 << i);
+            return i;
+        }
+
+        void free_blk_req(size_t i) {
+            blk_req_bitmap &= ~(1 << i);
+        }
+    };
+    static_assert(blk_req_count <= sizeof(Queue::blk_req_bitmap) * CHAR_BIT, "");
+
+    Queue* SelectQueue();
+    void QueueRingUpdate(Queue* q);
+
+    Queue queues_[kMaxQueues];
+    uint16_t num_queues_ = 1;
+    bool indirect_ = false;
+    bool event_idx_ = false;
+
+    // saved block device configuration out of the pci config BAR
+    virtio_blk_config_t config_ = {};
 };
 
 } // namespace virtio
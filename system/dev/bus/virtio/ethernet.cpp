@@ -21,6 +21,7 @@
 #include <virtio/virtio.h>
 #include <zircon/assert.h>
 #include <zircon/status.h>
+#include <zircon/syscalls.h>
 #include <zircon/types.h>
 
 #include "ring.h"
@@ -34,7 +35,7 @@ namespace virtio {
 namespace {
 
 // Specifies how many packets can fit in each of the receive and transmit
-// backlogs.
+// backlogs of each queue pair.
 const size_t kBacklog = 32;
 
 // Specifies the maximum transfer unit we support and the maximum layer 1
@@ -43,13 +44,32 @@ const size_t kVirtioMtu = 1500;
 const size_t kL1EthHdrLen = 26;
 
 // Other constants determined by the values above and the memory architecture.
-// The goal here is to allocate single-page I/O buffers.
-const size_t kFrameSize = sizeof(virtio_net_hdr_t) + kL1EthHdrLen + kVirtioMtu;
+// The goal here is to allocate single-page I/O buffers.  Frames leave room
+// for the larger header used with mergeable rx buffers.
+const size_t kFrameSize = sizeof(virtio_net_hdr_mrg_rxbuf_t) + kL1EthHdrLen + kVirtioMtu;
 const size_t kFramesInBuf = PAGE_SIZE / kFrameSize;
-const size_t kNumIoBufs = fbl::round_up(kBacklog * 2, kFramesInBuf) / kFramesInBuf;
 
-const uint16_t kRxId = 0u;
-const uint16_t kTxId = 1u;
+// Segmentation offload needs one buffer per tx descriptor big enough for a
+// whole TSO frame.
+const size_t kTsoFrameSize = sizeof(virtio_net_hdr_mrg_rxbuf_t) + UINT16_MAX;
+
+// Large receive offload merges segments into packets of up to 64k, which
+// arrive spread over several rx buffers.
+const size_t kMergeBufSize = UINT16_MAX + kL1EthHdrLen;
+
+// Control virtqueue size, and where a command is laid out in its buffer.
+const uint16_t kCtrlBacklog = 16;
+const size_t kCtrlDataOffset = sizeof(virtio_net_ctrl_hdr_t);
+const size_t kCtrlAckOffset = 64;
+
+// Virtqueue indices; see section 5.1.2 of the spec.
+uint16_t RxId(uint16_t pair) {
+    return static_cast<uint16_t>(2 * pair);
+}
+
+uint16_t TxId(uint16_t pair) {
+    return static_cast<uint16_t>(2 * pair + 1);
+}
 
 // Strictly for convenience...
 typedef struct vring_desc desc_t;
@@ -105,7 +125,8 @@ zx_status_t virtio_net_queue_tx(void* ctx, uint32_t options, ethmac_netbuf_t* ne
 }
 
 static zx_status_t virtio_set_param(void* ctx, uint32_t param, int32_t value, void* data) {
-    return ZX_ERR_NOT_SUPPORTED;
+    virtio::EthernetDevice* eth = static_cast<virtio::EthernetDevice*>(ctx);
+    return eth->SetParam(param, value, data);
 }
 
 ethmac_protocol_ops_t kProtoOps = {
@@ -114,21 +135,21 @@ ethmac_protocol_ops_t kProtoOps = {
     virtio_net_start,
     virtio_net_queue_tx,
     virtio_set_param,
+    nullptr, // queue_rx
 };
 
 // I/O buffer helpers
-zx_status_t InitBuffers(fbl::unique_ptr<io_buffer_t[]>* out) {
+zx_status_t InitBuffers(fbl::unique_ptr<io_buffer_t[]>* out, size_t count, size_t size) {
     zx_status_t rc;
     fbl::AllocChecker ac;
-    fbl::unique_ptr<io_buffer_t[]> bufs(new (&ac) io_buffer_t[kNumIoBufs]);
+    fbl::unique_ptr<io_buffer_t[]> bufs(new (&ac) io_buffer_t[count]);
     if (!ac.check()) {
         zxlogf(ERROR, "out of memory!\n");
         return ZX_ERR_NO_MEMORY;
     }
-    memset(bufs.get(), 0, sizeof(io_buffer_t) * kNumIoBufs);
-    size_t buf_size = kFrameSize * kFramesInBuf;
-    for (uint16_t id = 0; id < kNumIoBufs; ++id) {
-        if ((rc = io_buffer_init(&bufs[id], buf_size, IO_BUFFER_RW | IO_BUFFER_CONTIG)) != ZX_OK) {
+    memset(bufs.get(), 0, sizeof(io_buffer_t) * count);
+    for (size_t id = 0; id < count; ++id) {
+        if ((rc = io_buffer_init(&bufs[id], size, IO_BUFFER_RW | IO_BUFFER_CONTIG)) != ZX_OK) {
             zxlogf(ERROR, "failed to allocate I/O buffers: %s\n", zx_status_get_string(rc));
             return rc;
         }
@@ -137,11 +158,11 @@ zx_status_t InitBuffers(fbl::unique_ptr<io_buffer_t[]>* out) {
     return ZX_OK;
 }
 
-void ReleaseBuffers(fbl::unique_ptr<io_buffer_t[]> bufs) {
+void ReleaseBuffers(fbl::unique_ptr<io_buffer_t[]> bufs, size_t count) {
     if (!bufs) {
         return;
     }
-    for (size_t i = 0; i < kNumIoBufs; ++i) {
+    for (size_t i = 0; i < count; ++i) {
         if (io_buffer_is_valid(&bufs[i])) {
             io_buffer_release(&bufs[i]);
         }
@@ -150,15 +171,15 @@ void ReleaseBuffers(fbl::unique_ptr<io_buffer_t[]> bufs) {
 
 // Frame access helpers
 zx_off_t GetFrame(io_buffer_t** bufs, uint16_t ring_id, uint16_t desc_id) {
-    uint16_t i = static_cast<uint16_t>(desc_id + ring_id * kBacklog);
+    size_t i = desc_id + ring_id * kBacklog;
     *bufs = &((*bufs)[i / kFramesInBuf]);
     return (i % kFramesInBuf) * kFrameSize;
 }
 
-void* GetFrameVirt(io_buffer_t* bufs, uint16_t ring_id, uint16_t desc_id) {
+uint8_t* GetFrameVirt(io_buffer_t* bufs, uint16_t ring_id, uint16_t desc_id) {
     zx_off_t offset = GetFrame(&bufs, ring_id, desc_id);
     uintptr_t vaddr = reinterpret_cast<uintptr_t>(io_buffer_virt(bufs));
-    return reinterpret_cast<void*>(vaddr + offset);
+    return reinterpret_cast<uint8_t*>(vaddr + offset);
 }
 
 zx_paddr_t GetFramePhys(io_buffer_t* bufs, uint16_t ring_id, uint16_t desc_id) {
@@ -166,58 +187,166 @@ zx_paddr_t GetFramePhys(io_buffer_t* bufs, uint16_t ring_id, uint16_t desc_id) {
     return io_buffer_phys(bufs) + offset;
 }
 
-virtio_net_hdr_t* GetFrameHdr(io_buffer_t* bufs, uint16_t ring_id, uint16_t desc_id) {
-    return reinterpret_cast<virtio_net_hdr_t*>(GetFrameVirt(bufs, ring_id, desc_id));
-}
-
-uint8_t* GetFrameData(io_buffer_t* bufs, uint16_t ring_id, uint16_t desc_id) {
-    uintptr_t vaddr = reinterpret_cast<uintptr_t>(GetFrameHdr(bufs, ring_id, desc_id));
-    return reinterpret_cast<uint8_t*>(vaddr + sizeof(virtio_net_hdr_t));
+// Finishes a checksum the host left partial (VIRTIO_NET_HDR_F_NEEDS_CSUM):
+// the field at |start| + |offset| holds the pseudo-header sum, and the sum of
+// everything from |start| on, inverted, goes there.
+bool FinishChecksum(uint8_t* data, size_t len, size_t start, size_t offset) {
+    if (start + offset + 2 > len) {
+        return false;
+    }
+    uint32_t sum = 0;
+    size_t i;
+    for (i = start; i + 1 < len; i += 2) {
+        sum += static_cast<uint32_t>((data[i] << 8) | data[i + 1]);
+    }
+    if (i < len) {
+        sum += static_cast<uint32_t>(data[i] << 8);
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    uint16_t csum = static_cast<uint16_t>(~sum);
+    data[start + offset] = static_cast<uint8_t>(csum >> 8);
+    data[start + offset + 1] = static_cast<uint8_t>(csum & 0xff);
+    return true;
 }
 
 } // namespace
 
 EthernetDevice::EthernetDevice(zx_device_t* bus_device, fbl::unique_ptr<Backend> backend)
-    : Device(bus_device, fbl::move(backend)), rx_(this), tx_(this), bufs_(nullptr), unkicked_(0),
+    : Device(bus_device, fbl::move(backend)), pairs_(1), bufs_(nullptr), num_bufs_(0),
+      tso_bufs_(nullptr), num_tso_bufs_(0), features_(0), hdr_len_(sizeof(virtio_net_hdr_t)), mrg_rxbuf_(false),
       ifc_(nullptr), cookie_(nullptr) {
+    memset(&ctrl_buf_, 0, sizeof(ctrl_buf_));
 }
 
 EthernetDevice::~EthernetDevice() {
     LTRACE_ENTRY;
 }
 
-zx_status_t EthernetDevice::Init() {
-    LTRACE_ENTRY;
-    zx_status_t rc;
-    if (mtx_init(&state_lock_, mtx_plain) != thrd_success ||
-        mtx_init(&tx_lock_, mtx_plain) != thrd_success) {
-        return ZX_ERR_NO_RESOURCES;
+// Negotiates features with the device; see section 5.1.3 of the spec.
+// Segmentation offload is only offered to the ethmac layer when both IPv4
+// and IPv6 are supported, and large receive offload needs mergeable rx
+// buffers (so 64k packets don't need 64k buffers) and a way to turn it off.
+zx_status_t EthernetDevice::NegotiateFeatures() {
+    bool version_1 = DeviceFeatureSupported(VIRTIO_F_VERSION_1);
+    if (version_1) {
+        DriverFeatureAck(VIRTIO_F_VERSION_1);
+    }
+    if (DeviceFeatureSupported(VIRTIO_F_RING_EVENT_IDX)) {
+        DriverFeatureAck(VIRTIO_F_RING_EVENT_IDX);
+    }
+    if (DeviceFeatureSupported(VIRTIO_NET_F_MRG_RXBUF)) {
+        DriverFeatureAck(VIRTIO_NET_F_MRG_RXBUF);
+        mrg_rxbuf_ = true;
+    }
+    hdr_len_ = (version_1 || mrg_rxbuf_) ? sizeof(virtio_net_hdr_mrg_rxbuf_t)
+                                         : sizeof(virtio_net_hdr_t);
+
+    bool ctrl_vq = DeviceFeatureSupported(VIRTIO_NET_F_CTRL_VQ);
+    if (ctrl_vq) {
+        DriverFeatureAck(VIRTIO_NET_F_CTRL_VQ);
+        if (DeviceFeatureSupported(VIRTIO_NET_F_MQ)) {
+            DriverFeatureAck(VIRTIO_NET_F_MQ);
+            // One pair per CPU, as far as both ends allow
+            uint32_t pairs = fbl::min(zx_system_get_num_cpus(), static_cast<uint32_t>(ETH_MAX_QUEUES));
+            pairs = fbl::min(pairs, static_cast<uint32_t>(config_.max_virtqueue_pairs));
+            pairs_ = static_cast<uint16_t>(fbl::max(pairs, 1u));
+        }
     }
-    fbl::AutoLock lock(&state_lock_);
 
-    // Reset the device and read our configuration
-    DeviceReset();
-    CopyDeviceConfig(&config_, sizeof(config_));
-    LTRACEF("mac %02x:%02x:%02x:%02x:%02x:%02x\n", config_.mac[0], config_.mac[1], config_.mac[2],
-            config_.mac[3], config_.mac[4], config_.mac[5]);
-    LTRACEF("status %u\n", config_.status);
-    LTRACEF("max_virtqueue_pairs  %u\n", config_.max_virtqueue_pairs);
+    if (DeviceFeatureSupported(VIRTIO_NET_F_CSUM)) {
+        DriverFeatureAck(VIRTIO_NET_F_CSUM);
+        features_ |= ETHMAC_FEATURE_TX_CSUM;
+        if (DeviceFeatureSupported(VIRTIO_NET_F_HOST_TSO4) &&
+            DeviceFeatureSupported(VIRTIO_NET_F_HOST_TSO6)) {
+            DriverFeatureAck(VIRTIO_NET_F_HOST_TSO4);
+            DriverFeatureAck(VIRTIO_NET_F_HOST_TSO6);
+            features_ |= ETHMAC_FEATURE_TSO;
+        }
+    }
+    if (DeviceFeatureSupported(VIRTIO_NET_F_GUEST_CSUM)) {
+        DriverFeatureAck(VIRTIO_NET_F_GUEST_CSUM);
+        features_ |= ETHMAC_FEATURE_RX_CSUM;
+        if (mrg_rxbuf_ && ctrl_vq && DeviceFeatureSupported(VIRTIO_NET_F_CNTRL_GUEST_OFFLOADS) &&
+            DeviceFeatureSupported(VIRTIO_NET_F_GUEST_TSO4) &&
+            DeviceFeatureSupported(VIRTIO_NET_F_GUEST_TSO6)) {
+            DriverFeatureAck(VIRTIO_NET_F_CNTRL_GUEST_OFFLOADS);
+            DriverFeatureAck(VIRTIO_NET_F_GUEST_TSO4);
+            DriverFeatureAck(VIRTIO_NET_F_GUEST_TSO6);
+            features_ |= ETHMAC_FEATURE_LRO;
+        }
+    }
 
-    // Ack and set the driver status bit
-    DriverStatusAck();
+    zx_status_t rc;
+    if ((rc = DeviceStatusFeaturesOk()) != ZX_OK) {
+        zxlogf(ERROR, "feature negotiation failed: %s\n", zx_status_get_string(rc));
+        return rc;
+    }
 
-    // TODO(aarongreen): Check features bits and ack/nak them
+    // The control queue comes after every queue pair the device has.
+    if (ctrl_vq) {
+        fbl::AllocChecker ac;
+        ctrl_.reset(new (&ac) Ring(this));
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        uint16_t ctrl_id = DeviceFeatureSupported(VIRTIO_NET_F_MQ)
+                               ? RxId(config_.max_virtqueue_pairs)
+                               : RxId(1);
+        if ((rc = io_buffer_init(&ctrl_buf_, PAGE_SIZE, IO_BUFFER_RW | IO_BUFFER_CONTIG)) !=
+                ZX_OK ||
+            (rc = ctrl_->Init(ctrl_id, kCtrlBacklog)) != ZX_OK) {
+            zxlogf(ERROR, "failed to set up control virtqueue: %s\n", zx_status_get_string(rc));
+            return rc;
+        }
+        if (DeviceFeatureSupported(VIRTIO_F_RING_EVENT_IDX)) {
+            ctrl_->EnableEventIdx();
+        }
+        ctrl_->DisableInterrupts();
+    }
+    return ZX_OK;
+}
 
-    // Plan to clean up unless everything goes right.
-    auto cleanup = fbl::MakeAutoCall([this]() { Release(); });
+zx_status_t EthernetDevice::InitQueue(uint16_t n) {
+    zx_status_t rc;
+    Queue* q = &q_[n];
+    if (mtx_init(&q->tx_lock, mtx_plain) != thrd_success) {
+        return ZX_ERR_NO_RESOURCES;
+    }
+    q->unkicked = 0;
+    q->merge_len = 0;
+    q->merge_left = 0;
+
+    fbl::AllocChecker ac;
+    q->rx.reset(new (&ac) Ring(this));
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    q->tx.reset(new (&ac) Ring(this));
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    if (features_ & ETHMAC_FEATURE_LRO) {
+        q->merge_buf.reset(new (&ac) uint8_t[kMergeBufSize]);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+    }
 
-    // Allocate I/O buffers and virtqueues.
     uint16_t num_descs = static_cast<uint16_t>(kBacklog & 0xffff);
-    if ((rc = InitBuffers(&bufs_)) != ZX_OK || (rc = rx_.Init(kRxId, num_descs)) != ZX_OK ||
-        (rc = tx_.Init(kTxId, num_descs)) != ZX_OK) {
+    if ((rc = q->rx->Init(RxId(n), num_descs)) != ZX_OK ||
+        (rc = q->tx->Init(TxId(n), num_descs)) != ZX_OK) {
         zxlogf(ERROR, "failed to allocate virtqueue: %s\n", zx_status_get_string(rc));
         return rc;
     }
+    if (DeviceFeatureSupported(VIRTIO_F_RING_EVENT_IDX)) {
+        q->rx->EnableEventIdx();
+        q->tx->EnableEventIdx();
+    }
+    // Sent buffers are reclaimed when the tx ring runs short, not on an
+    // interrupt.
+    q->tx->DisableInterrupts();
 
     // Associate the I/O buffers with the virtqueue descriptors
     desc_t* desc = nullptr;
@@ -226,22 +355,70 @@ zx_status_t EthernetDevice::Init() {
     // For rx buffers, we queue a bunch of "reads" from the network that
     // complete when packets arrive.
     for (uint16_t i = 0; i < num_descs; ++i) {
-        desc = rx_.AllocDescChain(1, &id);
-        desc->addr = GetFramePhys(bufs_.get(), kRxId, id);
+        desc = q->rx->AllocDescChain(1, &id);
+        desc->addr = GetFramePhys(bufs_.get(), RxId(n), id);
         desc->len = kFrameSize;
         desc->flags |= VRING_DESC_F_WRITE;
         LTRACE_DO(virtio_dump_desc(desc));
-        rx_.SubmitChain(id);
+        q->rx->SubmitChain(id);
     }
 
     // For tx buffers, we hold onto them until we need to send a packet.
     for (uint16_t id = 0; id < num_descs; ++id) {
-        desc = tx_.DescFromIndex(id);
-        desc->addr = GetFramePhys(bufs_.get(), kTxId, id);
+        desc = q->tx->DescFromIndex(id);
+        desc->addr = GetFramePhys(bufs_.get(), TxId(n), id);
         desc->len = 0;
         desc->flags &= static_cast<uint16_t>(~VRING_DESC_F_WRITE);
         LTRACE_DO(virtio_dump_desc(desc));
     }
+    return ZX_OK;
+}
+
+zx_status_t EthernetDevice::Init() {
+    LTRACE_ENTRY;
+    zx_status_t rc;
+    if (mtx_init(&state_lock_, mtx_plain) != thrd_success ||
+        mtx_init(&ctrl_lock_, mtx_plain) != thrd_success) {
+        return ZX_ERR_NO_RESOURCES;
+    }
+    fbl::AutoLock lock(&state_lock_);
+
+    // Reset the device and read our configuration
+    DeviceReset();
+    CopyDeviceConfig(&config_, sizeof(config_));
+    LTRACEF("mac %02x:%02x:%02x:%02x:%02x:%02x\n", config_.mac[0], config_.mac[1], config_.mac[2],
+            config_.mac[3], config_.mac[4], config_.mac[5]);
+    LTRACEF("status %u\n", config_.status);
+    LTRACEF("max_virtqueue_pairs  %u\n", config_.max_virtqueue_pairs);
+
+    // Ack and set the driver status bit
+    DriverStatusAck();
+
+    // Plan to clean up unless everything goes right.
+    auto cleanup = fbl::MakeAutoCall([this]() { Release(); });
+
+    if ((rc = NegotiateFeatures()) != ZX_OK) {
+        return rc;
+    }
+
+    // Allocate I/O buffers and virtqueues.
+    num_bufs_ = fbl::round_up(kBacklog * 2 * pairs_, kFramesInBuf) / kFramesInBuf;
+    if ((rc = InitBuffers(&bufs_, num_bufs_, kFrameSize * kFramesInBuf)) != ZX_OK) {
+        return rc;
+    }
+    if (features_ & ETHMAC_FEATURE_TSO) {
+        num_tso_bufs_ = kBacklog * pairs_;
+        if (InitBuffers(&tso_bufs_, num_tso_bufs_, kTsoFrameSize) != ZX_OK) {
+            // carry on without; the host just never sees segmentation requests
+            ReleaseBuffers(fbl::move(tso_bufs_), num_tso_bufs_);
+            features_ &= ~ETHMAC_FEATURE_TSO;
+        }
+    }
+    for (uint16_t n = 0; n < pairs_; ++n) {
+        if ((rc = InitQueue(n)) != ZX_OK) {
+            return rc;
+        }
+    }
 
     // Start the interrupt thread and set the driver OK status
     StartIrqThread();
@@ -260,11 +437,29 @@ zx_status_t EthernetDevice::Init() {
         return rc;
     }
     // Give the rx buffers to the host
-    rx_.Kick();
+    for (uint16_t n = 0; n < pairs_; ++n) {
+        q_[n].rx->Kick();
+    }
 
     // Woohoo! Driver should be ready.
     cleanup.cancel();
     DriverStatusOk();
+
+    // The control queue only works once the driver is ready.  The host only
+    // uses the first pair until told how many we have, and starts with every
+    // negotiated receive offload on, but LRO waits until the ethernet layer
+    // asks for it.
+    if (pairs_ > 1) {
+        uint16_t pairs = pairs_;
+        if (SendCtrl(VIRTIO_NET_CTRL_MQ, VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET, &pairs,
+                     sizeof(pairs)) != ZX_OK) {
+            zxlogf(ERROR, "failed to enable %u queue pairs, using one\n", pairs_);
+            pairs_ = 1;
+        }
+    }
+    if ((features_ & ETHMAC_FEATURE_LRO) && SetParam(ETHMAC_SETPARAM_LRO, false, nullptr) != ZX_OK) {
+        features_ &= ~ETHMAC_FEATURE_LRO;
+    }
     return ZX_OK;
 }
 
@@ -276,55 +471,183 @@ void EthernetDevice::Release() {
 
 void EthernetDevice::ReleaseLocked() {
     ifc_ = nullptr;
-    ReleaseBuffers(fbl::move(bufs_));
+    ReleaseBuffers(fbl::move(bufs_), num_bufs_);
+    ReleaseBuffers(fbl::move(tso_bufs_), num_tso_bufs_);
+    if (io_buffer_is_valid(&ctrl_buf_)) {
+        io_buffer_release(&ctrl_buf_);
+    }
     Device::Release();
 }
 
+zx_status_t EthernetDevice::SendCtrl(uint8_t class_id, uint8_t command, const void* data,
+                                     size_t len) {
+    if (!ctrl_ || kCtrlDataOffset + len > kCtrlAckOffset) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    fbl::AutoLock lock(&ctrl_lock_);
+
+    // The command is three descriptors: header and data for the device to
+    // read, and a byte for it to write its answer to.
+    uint16_t id;
+    desc_t* desc = ctrl_->AllocDescChain(3, &id);
+    if (!desc) {
+        return ZX_ERR_NO_RESOURCES;
+    }
+    uint8_t* buf = static_cast<uint8_t*>(io_buffer_virt(&ctrl_buf_));
+    zx_paddr_t pa = io_buffer_phys(&ctrl_buf_);
+    auto hdr = reinterpret_cast<virtio_net_ctrl_hdr_t*>(buf);
+    hdr->class_id = class_id;
+    hdr->command = command;
+    memcpy(buf + kCtrlDataOffset, data, len);
+    buf[kCtrlAckOffset] = VIRTIO_NET_ERR;
+
+    desc->addr = pa;
+    desc->len = sizeof(virtio_net_ctrl_hdr_t);
+    desc->flags = VRING_DESC_F_NEXT;
+    desc = ctrl_->DescFromIndex(desc->next);
+    desc->addr = pa + kCtrlDataOffset;
+    desc->len = static_cast<uint32_t>(len);
+    desc->flags = VRING_DESC_F_NEXT;
+    desc = ctrl_->DescFromIndex(desc->next);
+    desc->addr = pa + kCtrlAckOffset;
+    desc->len = 1;
+    desc->flags = VRING_DESC_F_WRITE;
+
+    ctrl_->SubmitChain(id);
+    ctrl_->Kick();
+
+    // Commands are rare; poll for the answer.
+    bool done = false;
+    for (int tries = 0; !done && tries < 1000; ++tries) {
+        ctrl_->IrqRingUpdate([this, &done](vring_used_elem* used_elem) {
+            uint16_t i = static_cast<uint16_t>(used_elem->id & 0xffff);
+            for (;;) {
+                desc_t* d = ctrl_->DescFromIndex(i);
+                bool next = (d->flags & VRING_DESC_F_NEXT) != 0;
+                uint16_t next_id = d->next;
+                ctrl_->FreeDesc(i);
+                if (!next) {
+                    break;
+                }
+                i = next_id;
+            }
+            done = true;
+        });
+        if (!done) {
+            zx_nanosleep(zx_deadline_after(ZX_USEC(100)));
+        }
+    }
+    if (!done) {
+        zxlogf(ERROR, "control command %u/%u timed out\n", class_id, command);
+        return ZX_ERR_TIMED_OUT;
+    }
+    return buf[kCtrlAckOffset] == VIRTIO_NET_OK ? ZX_OK : ZX_ERR_INTERNAL;
+}
+
+void EthernetDevice::Deliver(uint16_t n, uint8_t* data, size_t len, const virtio_net_hdr_t* hdr) {
+    LTRACEF("Receiving %zu bytes on queue %u:\n", len, n);
+    LTRACE_DO(hexdump8_ex(data, len, 0));
+
+    // With GUEST_CSUM, the host vouches for checksums it has checked
+    // and may leave those of packets from its own stack unfinished.
+    uint32_t flags = 0;
+    if (hdr->flags & VIRTIO_NET_HDR_F_NEEDS_CSUM) {
+        if (FinishChecksum(data, len, hdr->csum_start, hdr->csum_offset)) {
+            flags |= ETHMAC_RECV_CSUM_OK;
+        }
+    } else if (hdr->flags & VIRTIO_NET_HDR_F_DATA_VALID) {
+        flags |= ETHMAC_RECV_CSUM_OK;
+    }
+
+    // Pass the data up the stack to the generic Ethernet driver.  The host
+    // keeps each flow on one queue, so the queue stands in for a flow hash.
+    if (pairs_ > 1) {
+        ifc_->recv_hashed(cookie_, data, len, flags, n);
+    } else {
+        ifc_->recv(cookie_, data, len, flags);
+    }
+}
+
+void EthernetDevice::RxBuffer(uint16_t n, vring_used_elem* used_elem) {
+    Queue* q = &q_[n];
+    uint16_t id = static_cast<uint16_t>(used_elem->id & 0xffff);
+    desc_t* desc = q->rx->DescFromIndex(id);
+    assert(used_elem->len <= desc->len);
+    assert((desc->flags & VRING_DESC_F_NEXT) == 0);
+    LTRACE_DO(virtio_dump_desc(desc));
+    uint8_t* frame = GetFrameVirt(bufs_.get(), RxId(n), id);
+    size_t len = used_elem->len;
+
+    if (q->merge_left > 0) {
+        // A later piece of a merged packet; drop the packet if it has grown
+        // too big, but keep counting its buffers.
+        if (q->merge_len + len <= kMergeBufSize) {
+            memcpy(q->merge_buf.get() + q->merge_len, frame, len);
+            q->merge_len += len;
+        } else {
+            q->merge_len = kMergeBufSize + 1;
+        }
+        if (--q->merge_left == 0 && q->merge_len <= kMergeBufSize) {
+            Deliver(n, q->merge_buf.get(), q->merge_len, &q->merge_hdr);
+        }
+    } else if (len >= hdr_len_) {
+        auto hdr = reinterpret_cast<virtio_net_hdr_t*>(frame);
+        uint16_t num_buffers = 1;
+        if (mrg_rxbuf_) {
+            num_buffers = reinterpret_cast<virtio_net_hdr_mrg_rxbuf_t*>(frame)->num_buffers;
+        }
+        uint8_t* data = frame + hdr_len_;
+        len -= hdr_len_;
+        if (num_buffers <= 1) {
+            Deliver(n, data, len, hdr);
+        } else if (q->merge_buf) {
+            memcpy(q->merge_buf.get(), data, len);
+            q->merge_len = len;
+            q->merge_left = static_cast<uint16_t>(num_buffers - 1);
+            q->merge_hdr = *hdr;
+        } else {
+            // not expected without LRO; skip the rest of the packet
+            q->merge_len = kMergeBufSize + 1;
+            q->merge_left = static_cast<uint16_t>(num_buffers - 1);
+        }
+    }
+    q->rx->FreeDesc(id);
+}
+
 void EthernetDevice::IrqRingUpdate() {
     LTRACE_ENTRY;
     // Lock to prevent changes to ifc_.
-    {
-        fbl::AutoLock lock(&state_lock_);
-        if (!ifc_) {
-            return;
-        }
-        // Ring::IrqRingUpdate will call this lambda on each rx buffer filled by
-        // the underlying device since the last IRQ.
+    fbl::AutoLock lock(&state_lock_);
+    if (!ifc_) {
+        return;
+    }
+    for (uint16_t n = 0; n < pairs_; ++n) {
+        Queue* q = &q_[n];
+        // Ring::IrqRingUpdate will call this lambda on each rx buffer filled
+        // by the underlying device since the last IRQ.
         // Thread safety analysis is explicitly disabled as clang isn't able to determine that the
         // state_lock_ is  held when the lambda invoked.
-        rx_.IrqRingUpdate([this](vring_used_elem* used_elem) TA_NO_THREAD_SAFETY_ANALYSIS {
-            uint16_t id = static_cast<uint16_t>(used_elem->id & 0xffff);
-            desc_t* desc = rx_.DescFromIndex(id);
-
-            // Transitional driver does not merge rx buffers.
-            assert(used_elem->len < desc->len);
-            uint8_t* data = GetFrameData(bufs_.get(), kRxId, id);
-            size_t len = used_elem->len - sizeof(virtio_net_hdr_t);
-            LTRACEF("Receiving %zu bytes:\n", len);
-            LTRACE_DO(hexdump8_ex(data, len, 0));
-
-            // Pass the data up the stack to the generic Ethernet driver
-            ifc_->recv(cookie_, data, len, 0);
-            assert((desc->flags & VRING_DESC_F_NEXT) == 0);
-            LTRACE_DO(virtio_dump_desc(desc));
-            rx_.FreeDesc(id);
+        q->rx->IrqRingUpdate([this, n](vring_used_elem* used_elem) TA_NO_THREAD_SAFETY_ANALYSIS {
+            RxBuffer(n, used_elem);
         });
-    }
 
-    // Now recycle the rx buffers.  As in Init(), this means queuing a bunch of
-    // "reads" from the network that will complete when packets arrive.
-    desc_t* desc = nullptr;
-    uint16_t id;
-    bool need_kick = false;
-    while ((desc = rx_.AllocDescChain(1, &id))) {
-        desc->len = kFrameSize;
-        rx_.SubmitChain(id);
-        need_kick = true;
-    }
+        // Now recycle the rx buffers.  As in Init(), this means queuing a
+        // bunch of "reads" from the network that will complete when packets
+        // arrive.
+        desc_t* desc = nullptr;
+        uint16_t id;
+        bool need_kick = false;
+        while ((desc = q->rx->AllocDescChain(1, &id))) {
+            desc->len = kFrameSize;
+            q->rx->SubmitChain(id);
+            need_kick = true;
+        }
 
-    // If we have re-queued any rx buffers, poke the virtqueue to pick them up.
-    if (need_kick) {
-        rx_.Kick();
+        // If we have re-queued any rx buffers, poke the virtqueue to pick
+        // them up.
+        if (need_kick) {
+            q->rx->Kick();
+        }
     }
 }
 
@@ -347,9 +670,10 @@ zx_status_t EthernetDevice::Query(uint32_t options, ethmac_info_t* info) {
     }
     fbl::AutoLock lock(&state_lock_);
     if (info) {
-        // TODO(aarongreen): Add info->features = GetFeatures();
+        info->features = features_;
         info->mtu = kVirtioMtu;
         memcpy(info->mac, config_.mac, sizeof(info->mac));
+        info->queue_count = pairs_;
     }
     return ZX_OK;
 }
@@ -379,54 +703,93 @@ zx_status_t EthernetDevice::QueueTx(uint32_t options, ethmac_netbuf_t* netbuf) {
     LTRACE_ENTRY;
     void* data = netbuf->data;
     size_t length = netbuf->len;
+    bool tso = (netbuf->flags & (ETHMAC_NETBUF_TSO_V4 | ETHMAC_NETBUF_TSO_V6)) != 0;
     // First, validate the packet
-    if (!data || length > sizeof(virtio_net_hdr_t) + kVirtioMtu) {
+    if (!data || (tso && !(features_ & ETHMAC_FEATURE_TSO)) ||
+        (!tso && length > kFrameSize - hdr_len_)) {
         LTRACEF("dropping packet; invalid packet\n");
         return ZX_ERR_INVALID_ARGS;
     }
 
-    fbl::AutoLock lock(&tx_lock_);
+    uint16_t n = static_cast<uint16_t>(ETHMAC_TX_OPT_QUEUE_INDEX(options) % pairs_);
+    Queue* q = &q_[n];
+    fbl::AutoLock lock(&q->tx_lock);
 
     // Flush outstanding descriptors.  Ring::IrqRingUpdate will call this lambda
     // on each sent tx_buffer, allowing us to reclaim them.
-    auto flush = [this](vring_used_elem* used_elem) {
+    auto flush = [q](vring_used_elem* used_elem) {
         uint16_t id = static_cast<uint16_t>(used_elem->id & 0xffff);
-        desc_t* desc = tx_.DescFromIndex(id);
+        desc_t* desc = q->tx->DescFromIndex(id);
         assert((desc->flags & VRING_DESC_F_NEXT) == 0);
         LTRACE_DO(virtio_dump_desc(desc));
-        tx_.FreeDesc(id);
+        q->tx->FreeDesc(id);
     };
 
     // Grab a free descriptor
     uint16_t id;
-    desc_t* desc = tx_.AllocDescChain(1, &id);
+    desc_t* desc = q->tx->AllocDescChain(1, &id);
     if (!desc) {
-        tx_.IrqRingUpdate(flush);
-        desc = tx_.AllocDescChain(1, &id);
+        q->tx->IrqRingUpdate(flush);
+        desc = q->tx->AllocDescChain(1, &id);
     }
     if (!desc) {
         LTRACEF("dropping packet; out of descriptors\n");
         return ZX_ERR_NO_RESOURCES;
     }
 
-    // Add the data to be sent
-    void* tx_hdr = GetFrameHdr(bufs_.get(), kTxId, id);
-    memset(tx_hdr, 0, sizeof(virtio_net_hdr_t));
-    void* tx_buf = GetFrameData(bufs_.get(), kTxId, id);
+    // Add the data to be sent, in the descriptor's TSO buffer if it is to be
+    // segmented.
+    uint8_t* frame;
+    if (tso) {
+        io_buffer_t* buf = &tso_bufs_[n * kBacklog + id];
+        frame = static_cast<uint8_t*>(io_buffer_virt(buf));
+        desc->addr = io_buffer_phys(buf);
+    } else {
+        frame = GetFrameVirt(bufs_.get(), TxId(n), id);
+        desc->addr = GetFramePhys(bufs_.get(), TxId(n), id);
+    }
+    auto tx_hdr = reinterpret_cast<virtio_net_hdr_t*>(frame);
+    memset(tx_hdr, 0, hdr_len_);
+    if (netbuf->flags & ETHMAC_NETBUF_CSUM) {
+        tx_hdr->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+        tx_hdr->csum_start = netbuf->csum_start;
+        tx_hdr->csum_offset = netbuf->csum_offset;
+    }
+    if (tso) {
+        tx_hdr->gso_type = (netbuf->flags & ETHMAC_NETBUF_TSO_V4) ? VIRTIO_NET_HDR_GSO_TCPV4
+                                                                  : VIRTIO_NET_HDR_GSO_TCPV6;
+        tx_hdr->hdr_len = netbuf->hdr_len;
+        tx_hdr->gso_size = netbuf->mss;
+    }
+    uint8_t* tx_buf = frame + hdr_len_;
     memcpy(tx_buf, data, length);
-    desc->len = static_cast<uint32_t>(sizeof(virtio_net_hdr_t) + length);
+    desc->len = static_cast<uint32_t>(hdr_len_ + length);
 
     // Submit the descriptor and notify the back-end.
     LTRACE_DO(virtio_dump_desc(desc));
-    LTRACEF("Sending %zu bytes:\n", length);
+    LTRACEF("Sending %zu bytes on queue %u:\n", length, n);
     LTRACE_DO(hexdump8_ex(tx_buf, length, 0));
-    tx_.SubmitChain(id);
-    ++unkicked_;
-    if ((options & ETHMAC_TX_OPT_MORE) == 0 || unkicked_ > kBacklog / 2) {
-        tx_.Kick();
-        unkicked_ = 0;
+    q->tx->SubmitChain(id);
+    ++q->unkicked;
+    if ((options & ETHMAC_TX_OPT_MORE) == 0 || q->unkicked > kBacklog / 2) {
+        q->tx->Kick();
+        q->unkicked = 0;
     }
     return ZX_OK;
 }
 
+// LRO is switched by turning the host's segmentation receive offloads on
+// and off; checksum offload stays on throughout.
+zx_status_t EthernetDevice::SetParam(uint32_t param, int32_t value, void* data) {
+    if (param != ETHMAC_SETPARAM_LRO || !(features_ & ETHMAC_FEATURE_LRO)) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    uint64_t offloads = 1ull << VIRTIO_NET_F_GUEST_CSUM;
+    if (value) {
+        offloads |= (1ull << VIRTIO_NET_F_GUEST_TSO4) | (1ull << VIRTIO_NET_F_GUEST_TSO6);
+    }
+    return SendCtrl(VIRTIO_NET_CTRL_GUEST_OFFLOADS, VIRTIO_NET_CTRL_GUEST_OFFLOADS_SET, &offloads,
+                    sizeof(offloads));
+}
+
 } // namespace virtio
@@ -40,27 +40,67 @@ public:
     void Stop() TA_EXCL(state_lock_);
     zx_status_t Start(ethmac_ifc_t* ifc, void* cookie) TA_EXCL(state_lock_);
     zx_status_t QueueTx(uint32_t options, ethmac_netbuf_t* netbuf) TA_EXCL(state_lock_);
+    zx_status_t SetParam(uint32_t param, int32_t value, void* data);
 
     const char* tag() const override { return "virtio-net"; }
 
 private:
     DISALLOW_COPY_ASSIGN_AND_MOVE(EthernetDevice);
 
+    // One receive and transmit virtqueue pair; see section 5.1.2 of the spec.
+    struct Queue {
+        fbl::unique_ptr<Ring> rx;
+        fbl::unique_ptr<Ring> tx;
+        mtx_t tx_lock;
+        size_t unkicked; // guarded by tx_lock
+
+        // A packet being gathered from several mergeable rx buffers; only
+        // allocated when large receive offload was negotiated.
+        fbl::unique_ptr<uint8_t[]> merge_buf;
+        size_t merge_len;
+        uint16_t merge_left;
+        virtio_net_hdr_t merge_hdr;
+    };
+
     // DDK device hooks; see ddk/device.h
     void ReleaseLocked() TA_REQ(state_lock_);
 
+    // Feature negotiation and virtqueue setup, from Init()
+    zx_status_t NegotiateFeatures() TA_REQ(state_lock_);
+    zx_status_t InitQueue(uint16_t n) TA_REQ(state_lock_);
+
+    // Receive path helpers
+    void RxBuffer(uint16_t n, vring_used_elem* used_elem) TA_REQ(state_lock_);
+    void Deliver(uint16_t n, uint8_t* data, size_t len, const virtio_net_hdr_t* hdr)
+        TA_REQ(state_lock_);
+
+    // Sends a command on the control virtqueue and waits for the reply.
+    zx_status_t SendCtrl(uint8_t class_id, uint8_t command, const void* data, size_t len);
+
     // Mutexes to control concurrent access
     mtx_t state_lock_;
-    mtx_t tx_lock_;
-
-    // Virtqueues; see section 5.1.2 of the spec
-    // This driver doesn't currently support multi-queueing, automatic
-    // steering, or the control virtqueue, so only a single queue is needed in
-    // each direction.
-    Ring rx_;
-    Ring tx_;
+    mtx_t ctrl_lock_;
+
+    // Virtqueues; receive queues are spread across pairs by the host, which
+    // keeps each flow on one queue.
+    Queue q_[ETH_MAX_QUEUES];
+    uint16_t pairs_;
     fbl::unique_ptr<io_buffer_t[]> bufs_;
-    size_t unkicked_ TA_GUARDED(tx_lock_);
+    size_t num_bufs_;
+    // One per tx descriptor, if segmentation offload was negotiated
+    fbl::unique_ptr<io_buffer_t[]> tso_bufs_;
+    size_t num_tso_bufs_;
+
+    // Control virtqueue and the buffer its commands are built in, if
+    // VIRTIO_NET_F_CTRL_VQ was negotiated
+    fbl::unique_ptr<Ring> ctrl_;
+    io_buffer_t ctrl_buf_;
+
+    // ETHMAC_FEATURE_* offloads negotiated with the device
+    uint32_t features_;
+    // Size of the virtio_net_hdr at the start of each frame
+    size_t hdr_len_;
+    bool mrg_rxbuf_;
 
     // Saved net device configuration out of the pci config BAR
     virtio_net_config_t config_ TA_GUARDED(state_lock_);
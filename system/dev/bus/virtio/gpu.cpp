@@ -76,6 +76,30 @@ void GpuDevice::virtio_gpu_flush(void* ctx) {
     gd->Flush();
 }
 
+void GpuDevice::virtio_gpu_flush_region(void* ctx, uint32_t x, uint32_t y,
+                                        uint32_t width, uint32_t height) {
+    GpuDevice* gd = static_cast<GpuDevice*>(ctx);
+
+    LTRACEF("dev %p, x %u y %u w %u h %u\n", gd, x, y, width, height);
+
+    gd->FlushRegion(x, y, width, height);
+}
+
+zx_status_t GpuDevice::virtio_gpu_set_cursor(void* ctx, const void* pixels,
+                                             uint32_t hot_x, uint32_t hot_y) {
+    GpuDevice* gd = static_cast<GpuDevice*>(ctx);
+
+    LTRACEF("dev %p, pixels %p\n", gd, pixels);
+
+    return gd->SetCursor(pixels, hot_x, hot_y);
+}
+
+void GpuDevice::virtio_gpu_move_cursor(void* ctx, int32_t x, int32_t y) {
+    GpuDevice* gd = static_cast<GpuDevice*>(ctx);
+
+    gd->MoveCursor(x, y);
+}
+
 GpuDevice::GpuDevice(zx_device_t* bus_device, fbl::unique_ptr<Backend> backend)
     : Device(bus_device, fbl::move(backend)) {
     cnd_init(&request_cond_);
@@ -88,16 +112,37 @@ GpuDevice::~GpuDevice() {
     cnd_destroy(&flush_cond_);
 }
 
-zx_status_t GpuDevice::send_command_response(const void* cmd, size_t cmd_len, void** _res, size_t res_len) {
-    LTRACEF("dev %p, cmd %p, cmd_len %zu, res %p, res_len %zu\n", this, cmd, cmd_len, _res, res_len);
+// Queues a command in a free slot, waiting for one if they are all in
+// flight.  The caller kicks the ring, so several commands can go to the
+// host at once.  Returns the slot.
+int GpuDevice::queue_command_locked(const void* cmd, size_t cmd_len, size_t res_len, bool wait) {
+    LTRACEF("dev %p, cmd %p, cmd_len %zu, res_len %zu\n", this, cmd, cmd_len, res_len);
+
+    assert(cmd_len + res_len <= kCmdSlotSize);
+
+    int slot = -1;
+    for (;;) {
+        for (size_t n = 0; n < kCmdSlots; n++) {
+            if (slots_[n].state == SlotState::kFree) {
+                slot = static_cast<int>(n);
+                break;
+            }
+        }
+        if (slot >= 0) {
+            break;
+        }
+        cnd_wait(&request_cond_, request_lock_.GetInternal());
+    }
 
     uint16_t i;
     struct vring_desc* desc = vring_.AllocDescChain(2, &i);
     assert(desc);
 
-    memcpy(gpu_req_, cmd, cmd_len);
+    uint8_t* req = static_cast<uint8_t*>(gpu_req_) + slot * kCmdSlotSize;
+    zx_paddr_t req_pa = gpu_req_pa_ + slot * kCmdSlotSize;
+    memcpy(req, cmd, cmd_len);
 
-    desc->addr = gpu_req_pa_;
+    desc->addr = req_pa;
     desc->len = (uint32_t)cmd_len;
     desc->flags |= VRING_DESC_F_NEXT;
 
@@ -105,23 +150,43 @@ zx_status_t GpuDevice::send_command_response(const void* cmd, size_t cmd_len, vo
     desc = vring_.DescFromIndex(desc->next);
     assert(desc);
 
-    void* res = (void*)((uint8_t*)gpu_req_ + cmd_len);
-    *_res = res;
-    zx_paddr_t res_phys = gpu_req_pa_ + cmd_len;
-    memset(res, 0, res_len);
+    memset(req + cmd_len, 0, res_len);
 
-    desc->addr = res_phys;
+    desc->addr = req_pa + cmd_len;
     desc->len = (uint32_t)res_len;
     desc->flags = VRING_DESC_F_WRITE;
 
+    slots_[slot].state = wait ? SlotState::kWaiting : SlotState::kAsync;
+    slots_[slot].desc = i;
+    slots_[slot].cmd_len = cmd_len;
+
     /* submit the transfer */
     vring_.SubmitChain(i);
 
+    return slot;
+}
+
+void GpuDevice::init_fence(virtio_gpu_ctrl_hdr* hdr) {
+    hdr->flags |= VIRTIO_GPU_FLAG_FENCE;
+    hdr->fence_id = ++last_fence_id_;
+}
+
+zx_status_t GpuDevice::send_command_response(const void* cmd, size_t cmd_len, void* res, size_t res_len) {
+    fbl::AutoLock lock(&request_lock_);
+
+    int slot = queue_command_locked(cmd, cmd_len, res_len, true);
+
     /* kick it off */
     vring_.Kick();
 
     /* wait for result */
-    cnd_wait(&request_cond_, request_lock_.GetInternal());
+    while (slots_[slot].state != SlotState::kDone) {
+        cnd_wait(&request_cond_, request_lock_.GetInternal());
+    }
+
+    memcpy(res, static_cast<uint8_t*>(gpu_req_) + slot * kCmdSlotSize + cmd_len, res_len);
+    slots_[slot].state = SlotState::kFree;
+    cnd_broadcast(&request_cond_);
 
     return ZX_OK;
 }
@@ -129,17 +194,15 @@ zx_status_t GpuDevice::send_command_response(const void* cmd, size_t cmd_len, vo
 zx_status_t GpuDevice::get_display_info() {
     LTRACEF("dev %p\n", this);
 
-    /* grab a lock to keep this single message at a time */
-    fbl::AutoLock lock(&request_lock_);
-
     /* construct the get display info message */
     virtio_gpu_ctrl_hdr req;
     memset(&req, 0, sizeof(req));
     req.type = VIRTIO_GPU_CMD_GET_DISPLAY_INFO;
 
     /* send the message and get a response */
-    virtio_gpu_resp_display_info* info;
-    auto err = send_command_response(&req, sizeof(req), (void**)&info, sizeof(*info));
+    virtio_gpu_resp_display_info info_buf;
+    virtio_gpu_resp_display_info* info = &info_buf;
+    auto err = send_command_response(&req, sizeof(req), info, sizeof(*info));
     if (err < ZX_OK) {
         return ZX_ERR_NOT_FOUND;
     }
@@ -166,14 +229,12 @@ zx_status_t GpuDevice::get_display_info() {
     return ZX_OK;
 }
 
-zx_status_t GpuDevice::allocate_2d_resource(uint32_t* resource_id, uint32_t width, uint32_t height) {
+zx_status_t GpuDevice::allocate_2d_resource(uint32_t* resource_id, uint32_t format,
+                                            uint32_t width, uint32_t height) {
     LTRACEF("dev %p\n", this);
 
     assert(resource_id);
 
-    /* grab a lock to keep this single message at a time */
-    fbl::AutoLock lock(&request_lock_);
-
     /* construct the request */
     virtio_gpu_resource_create_2d req;
     memset(&req, 0, sizeof(req));
@@ -181,18 +242,18 @@ zx_status_t GpuDevice::allocate_2d_resource(uint32_t* resource_id, uint32_t widt
     req.hdr.type = VIRTIO_GPU_CMD_RESOURCE_CREATE_2D;
     req.resource_id = next_resource_id_++;
     *resource_id = req.resource_id;
-    req.format = VIRTIO_GPU_FORMAT_B8G8R8X8_UNORM;
+    req.format = format;
     req.width = width;
     req.height = height;
 
     /* send the command and get a response */
-    struct virtio_gpu_ctrl_hdr* res;
-    auto err = send_command_response(&req, sizeof(req), (void**)&res, sizeof(*res));
+    struct virtio_gpu_ctrl_hdr res;
+    auto err = send_command_response(&req, sizeof(req), &res, sizeof(res));
     assert(err == ZX_OK);
 
     /* see if we got a valid response */
-    LTRACEF("response type 0x%x\n", res->type);
-    err = (res->type == VIRTIO_GPU_RESP_OK_NODATA) ? ZX_OK : ZX_ERR_NO_MEMORY;
+    LTRACEF("response type 0x%x\n", res.type);
+    err = (res.type == VIRTIO_GPU_RESP_OK_NODATA) ? ZX_OK : ZX_ERR_NO_MEMORY;
 
     return err;
 }
@@ -202,9 +263,6 @@ zx_status_t GpuDevice::attach_backing(uint32_t resource_id, zx_paddr_t ptr, size
 
     assert(ptr);
 
-    /* grab a lock to keep this single message at a time */
-    fbl::AutoLock lock(&request_lock_);
-
     /* construct the request */
     struct {
         struct virtio_gpu_resource_attach_backing req;
@@ -220,13 +278,13 @@ zx_status_t GpuDevice::attach_backing(uint32_t resource_id, zx_paddr_t ptr, size
     req.mem.length = (uint32_t)buf_len;
 
     /* send the command and get a response */
-    struct virtio_gpu_ctrl_hdr* res;
-    auto err = send_command_response(&req, sizeof(req), (void**)&res, sizeof(*res));
+    struct virtio_gpu_ctrl_hdr res;
+    auto err = send_command_response(&req, sizeof(req), &res, sizeof(res));
     assert(err == ZX_OK);
 
     /* see if we got a valid response */
-    LTRACEF("response type 0x%x\n", res->type);
-    err = (res->type == VIRTIO_GPU_RESP_OK_NODATA) ? ZX_OK : ZX_ERR_NO_MEMORY;
+    LTRACEF("response type 0x%x\n", res.type);
+    err = (res.type == VIRTIO_GPU_RESP_OK_NODATA) ? ZX_OK : ZX_ERR_NO_MEMORY;
 
     return err;
 }
@@ -234,9 +292,6 @@ zx_status_t GpuDevice::attach_backing(uint32_t resource_id, zx_paddr_t ptr, size
 zx_status_t GpuDevice::set_scanout(uint32_t scanout_id, uint32_t resource_id, uint32_t width, uint32_t height) {
     LTRACEF("dev %p, scanout_id %u, resource_id %u, width %u, height %u\n", this, scanout_id, resource_id, width, height);
 
-    /* grab a lock to keep this single message at a time */
-    fbl::AutoLock lock(&request_lock_);
-
     /* construct the request */
     virtio_gpu_set_scanout req;
     memset(&req, 0, sizeof(req));
@@ -249,41 +304,58 @@ zx_status_t GpuDevice::set_scanout(uint32_t scanout_id, uint32_t resource_id, ui
     req.resource_id = resource_id;
 
     /* send the command and get a response */
-    virtio_gpu_ctrl_hdr* res;
-    auto err = send_command_response(&req, sizeof(req), (void**)&res, sizeof(*res));
+    virtio_gpu_ctrl_hdr res;
+    auto err = send_command_response(&req, sizeof(req), &res, sizeof(res));
     assert(err == ZX_OK);
 
     /* see if we got a valid response */
-    LTRACEF("response type 0x%x\n", res->type);
-    err = (res->type == VIRTIO_GPU_RESP_OK_NODATA) ? ZX_OK : ZX_ERR_NO_MEMORY;
+    LTRACEF("response type 0x%x\n", res.type);
+    err = (res.type == VIRTIO_GPU_RESP_OK_NODATA) ? ZX_OK : ZX_ERR_NO_MEMORY;
 
     return err;
 }
 
+void GpuDevice::build_flush_resource(virtio_gpu_resource_flush* req, uint32_t resource_id,
+                                     const Rect& r) {
+    memset(req, 0, sizeof(*req));
+
+    req->hdr.type = VIRTIO_GPU_CMD_RESOURCE_FLUSH;
+    req->r.x = r.x;
+    req->r.y = r.y;
+    req->r.width = r.width;
+    req->r.height = r.height;
+    req->resource_id = resource_id;
+}
+
+void GpuDevice::build_transfer_to_host_2d(virtio_gpu_transfer_to_host_2d* req,
+                                          uint32_t resource_id, const Rect& r, uint32_t stride) {
+    memset(req, 0, sizeof(*req));
+
+    req->hdr.type = VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D;
+    req->r.x = r.x;
+    req->r.y = r.y;
+    req->r.width = r.width;
+    req->r.height = r.height;
+    // offset of the first pixel of the rect in the backing store
+    req->offset = (static_cast<uint64_t>(r.y) * stride + r.x) * 4;
+    req->resource_id = resource_id;
+}
+
 zx_status_t GpuDevice::flush_resource(uint32_t resource_id, uint32_t width, uint32_t height) {
     LTRACEF("dev %p, resource_id %u, width %u, height %u\n", this, resource_id, width, height);
 
-    /* grab a lock to keep this single message at a time */
-    fbl::AutoLock lock(&request_lock_);
-
     /* construct the request */
     virtio_gpu_resource_flush req;
-    memset(&req, 0, sizeof(req));
-
-    req.hdr.type = VIRTIO_GPU_CMD_RESOURCE_FLUSH;
-    req.r.x = req.r.y = 0;
-    req.r.width = width;
-    req.r.height = height;
-    req.resource_id = resource_id;
+    build_flush_resource(&req, resource_id, {0, 0, width, height});
 
     /* send the command and get a response */
-    virtio_gpu_ctrl_hdr* res;
-    auto err = send_command_response(&req, sizeof(req), (void**)&res, sizeof(*res));
+    virtio_gpu_ctrl_hdr res;
+    auto err = send_command_response(&req, sizeof(req), &res, sizeof(res));
     assert(err == ZX_OK);
 
     /* see if we got a valid response */
-    LTRACEF("response type 0x%x\n", res->type);
-    err = (res->type == VIRTIO_GPU_RESP_OK_NODATA) ? ZX_OK : ZX_ERR_NO_MEMORY;
+    LTRACEF("response type 0x%x\n", res.type);
+    err = (res.type == VIRTIO_GPU_RESP_OK_NODATA) ? ZX_OK : ZX_ERR_NO_MEMORY;
 
     return err;
 }
@@ -291,34 +363,47 @@ zx_status_t GpuDevice::flush_resource(uint32_t resource_id, uint32_t width, uint
 zx_status_t GpuDevice::transfer_to_host_2d(uint32_t resource_id, uint32_t width, uint32_t height) {
     LTRACEF("dev %p, resource_id %u, width %u, height %u\n", this, resource_id, width, height);
 
-    /* grab a lock to keep this single message at a time */
-    fbl::AutoLock lock(&request_lock_);
-
     /* construct the request */
     virtio_gpu_transfer_to_host_2d req;
-    memset(&req, 0, sizeof(req));
-
-    req.hdr.type = VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D;
-    req.r.x = req.r.y = 0;
-    req.r.width = width;
-    req.r.height = height;
-    req.offset = 0;
-    req.resource_id = resource_id;
+    build_transfer_to_host_2d(&req, resource_id, {0, 0, width, height}, width);
 
     /* send the command and get a response */
-    virtio_gpu_ctrl_hdr* res;
-    auto err = send_command_response(&req, sizeof(req), (void**)&res, sizeof(*res));
+    virtio_gpu_ctrl_hdr res;
+    auto err = send_command_response(&req, sizeof(req), &res, sizeof(res));
     assert(err == ZX_OK);
 
     /* see if we got a valid response */
-    LTRACEF("response type 0x%x\n", res->type);
-    err = (res->type == VIRTIO_GPU_RESP_OK_NODATA) ? ZX_OK : ZX_ERR_NO_MEMORY;
+    LTRACEF("response type 0x%x\n", res.type);
+    err = (res.type == VIRTIO_GPU_RESP_OK_NODATA) ? ZX_OK : ZX_ERR_NO_MEMORY;
 
     return err;
 }
 
 void GpuDevice::Flush() {
+    FlushRegion(0, 0, pmode_.r.width, pmode_.r.height);
+}
+
+void GpuDevice::FlushRegion(uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+    // clip to the display
+    if (x >= pmode_.r.width || y >= pmode_.r.height) {
+        return;
+    }
+    uint32_t x1 = x + MIN(width, pmode_.r.width - x);
+    uint32_t y1 = y + MIN(height, pmode_.r.height - y);
+    if (x == x1 || y == y1) {
+        return;
+    }
+
     fbl::AutoLock al(&flush_lock_);
+    if (flush_pending_) {
+        uint32_t dx1 = dirty_.x + dirty_.width;
+        uint32_t dy1 = dirty_.y + dirty_.height;
+        x = MIN(x, dirty_.x);
+        y = MIN(y, dirty_.y);
+        x1 = MAX(x1, dx1);
+        y1 = MAX(y1, dy1);
+    }
+    dirty_ = {x, y, x1 - x, y1 - y};
     flush_pending_ = true;
     cnd_signal(&flush_cond_);
 }
@@ -328,27 +413,126 @@ void GpuDevice::virtio_gpu_flusher() {
     for (;;) {
         {
             fbl::AutoLock al(&flush_lock_);
-            if (!flush_pending_)
+            while (!flush_pending_)
                 cnd_wait(&flush_cond_, flush_lock_.GetInternal());
-            flush_pending_ = false;
         }
 
-        LTRACEF("flushing\n");
+        fbl::AutoLock lock(&request_lock_);
+
+        // Let the host fall no more than a couple of frames behind; flushes
+        // that come in meanwhile merge into the next one.
+        while (last_fence_id_ - completed_fence_id_ >= kMaxFramesInFlight) {
+            cnd_wait(&request_cond_, request_lock_.GetInternal());
+        }
 
-        /* transfer to host 2d */
-        auto err = transfer_to_host_2d(display_resource_id_, pmode_.r.width, pmode_.r.height);
-        if (err < 0) {
-            LTRACEF("failed to flush resource\n");
-            continue;
+        Rect r;
+        {
+            fbl::AutoLock al(&flush_lock_);
+            r = dirty_;
+            flush_pending_ = false;
         }
 
-        /* resource flush */
-        err = flush_resource(display_resource_id_, pmode_.r.width, pmode_.r.height);
-        if (err < 0) {
-            LTRACEF("failed to flush resource\n");
-            continue;
+        LTRACEF("flushing x %u y %u w %u h %u\n", r.x, r.y, r.width, r.height);
+
+        // Queue the transfer and the flush back to back and kick once. The
+        // host handles the control queue in order, so only the flush needs
+        // to be fenced.
+        virtio_gpu_transfer_to_host_2d transfer;
+        build_transfer_to_host_2d(&transfer, display_resource_id_, r, pmode_.r.width);
+        queue_command_locked(&transfer, sizeof(transfer), sizeof(virtio_gpu_ctrl_hdr), false);
+
+        virtio_gpu_resource_flush flush;
+        build_flush_resource(&flush, display_resource_id_, r);
+        init_fence(&flush.hdr);
+        queue_command_locked(&flush, sizeof(flush), sizeof(virtio_gpu_ctrl_hdr), false);
+
+        vring_.Kick();
+    }
+}
+
+zx_status_t GpuDevice::queue_cursor_command(const virtio_gpu_update_cursor& cmd) {
+    fbl::AutoLock lock(&request_lock_);
+
+    // Cursor updates are superseded by the next one, so rather than wait
+    // for a slot, drop the update if the host is that far behind.
+    size_t slot;
+    for (slot = 0; slot < kCursorSlots; slot++) {
+        if (!cursor_slot_busy_[slot]) {
+            break;
         }
     }
+    if (slot == kCursorSlots) {
+        return ZX_ERR_SHOULD_WAIT;
+    }
+
+    uint16_t i;
+    struct vring_desc* desc = cursor_ring_.AllocDescChain(1, &i);
+    if (!desc) {
+        return ZX_ERR_SHOULD_WAIT;
+    }
+
+    memcpy(static_cast<uint8_t*>(cursor_req_) + slot * sizeof(cmd), &cmd, sizeof(cmd));
+    desc->addr = cursor_req_pa_ + slot * sizeof(cmd);
+    desc->len = sizeof(cmd);
+    desc->flags = 0;
+    cursor_slot_busy_[slot] = true;
+
+    cursor_ring_.SubmitChain(i);
+    cursor_ring_.Kick();
+    return ZX_OK;
+}
+
+zx_status_t GpuDevice::SetCursor(const void* pixels, uint32_t hot_x, uint32_t hot_y) {
+    if (cursor_fb_ == nullptr) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    if (hot_x >= DISPLAY_CURSOR_SIZE || hot_y >= DISPLAY_CURSOR_SIZE) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    fbl::AutoLock al(&cursor_lock_);
+
+    virtio_gpu_update_cursor cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.hdr.type = VIRTIO_GPU_CMD_UPDATE_CURSOR;
+    cmd.pos.scanout_id = pmode_id_;
+
+    if (pixels == nullptr) {
+        // resource 0 hides the cursor
+        cursor_visible_ = false;
+        return queue_cursor_command(cmd);
+    }
+
+    memcpy(cursor_fb_, pixels, DISPLAY_CURSOR_SIZE * DISPLAY_CURSOR_SIZE * 4);
+    zx_status_t err = transfer_to_host_2d(cursor_resource_id_,
+                                          DISPLAY_CURSOR_SIZE, DISPLAY_CURSOR_SIZE);
+    if (err < 0) {
+        return err;
+    }
+
+    cmd.resource_id = cursor_resource_id_;
+    cmd.hot_x = hot_x;
+    cmd.hot_y = hot_y;
+    cursor_visible_ = true;
+    cursor_hot_x_ = hot_x;
+    cursor_hot_y_ = hot_y;
+    return queue_cursor_command(cmd);
+}
+
+void GpuDevice::MoveCursor(int32_t x, int32_t y) {
+    fbl::AutoLock al(&cursor_lock_);
+    if (!cursor_visible_) {
+        return;
+    }
+
+    virtio_gpu_update_cursor cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.hdr.type = VIRTIO_GPU_CMD_MOVE_CURSOR;
+    cmd.pos.scanout_id = pmode_id_;
+    // the host positions the cursor by its top left corner
+    cmd.pos.x = static_cast<uint32_t>(MAX(x - static_cast<int32_t>(cursor_hot_x_), 0));
+    cmd.pos.y = static_cast<uint32_t>(MAX(y - static_cast<int32_t>(cursor_hot_y_), 0));
+    queue_cursor_command(cmd);
 }
 
 int GpuDevice::virtio_gpu_flusher_entry(void* arg) {
@@ -381,7 +565,8 @@ zx_status_t GpuDevice::virtio_gpu_start() {
            pmode_.flags);
 
     /* allocate a resource */
-    err = allocate_2d_resource(&display_resource_id_, pmode_.r.width, pmode_.r.height);
+    err = allocate_2d_resource(&display_resource_id_, VIRTIO_GPU_FORMAT_B8G8R8X8_UNORM,
+                               pmode_.r.width, pmode_.r.height);
     if (err < 0) {
         zxlogf(ERROR, "%s: failed to allocate 2d resource\n", tag());
         return err;
@@ -411,6 +596,21 @@ zx_status_t GpuDevice::virtio_gpu_start() {
         return err;
     }
 
+    /* set up a resource for the cursor image; the display works without one */
+    size_t cursor_len = DISPLAY_CURSOR_SIZE * DISPLAY_CURSOR_SIZE * 4;
+    err = allocate_2d_resource(&cursor_resource_id_, VIRTIO_GPU_FORMAT_B8G8R8A8_UNORM,
+                               DISPLAY_CURSOR_SIZE, DISPLAY_CURSOR_SIZE);
+    if (err == ZX_OK) {
+        err = map_contiguous_memory(cursor_len, (uintptr_t*)&cursor_fb_, &cursor_fb_pa_);
+    }
+    if (err == ZX_OK) {
+        err = attach_backing(cursor_resource_id_, cursor_fb_pa_, cursor_len);
+    }
+    if (err < 0) {
+        zxlogf(ERROR, "%s: failed to set up cursor resource, no hw cursor\n", tag());
+        cursor_fb_ = nullptr;
+    }
+
     // run a worker thread to shove in flush events
     thrd_create_with_name(&flush_thread_, virtio_gpu_flusher_entry, this, "virtio-gpu-flusher");
     thrd_detach(flush_thread_);
@@ -421,6 +621,9 @@ zx_status_t GpuDevice::virtio_gpu_start() {
     display_proto_ops_.get_mode = virtio_gpu_get_mode;
     display_proto_ops_.get_framebuffer = virtio_gpu_get_framebuffer;
     display_proto_ops_.flush = virtio_gpu_flush;
+    display_proto_ops_.flush_region = virtio_gpu_flush_region;
+    display_proto_ops_.set_cursor = virtio_gpu_set_cursor;
+    display_proto_ops_.move_cursor = virtio_gpu_move_cursor;
 
     // initialize the zx_device and publish us
     // point the ctx of our DDK device at ourself
@@ -472,12 +675,19 @@ zx_status_t GpuDevice::Init() {
     // XXX check features bits and ack/nak them
 
     // allocate the main vring
-    auto err = vring_.Init(0, 16);
+    auto err = vring_.Init(0, kRingSize);
     if (err < 0) {
         zxlogf(ERROR, "%s: failed to allocate vring\n", tag());
         return err;
     }
 
+    // and the cursor vring
+    err = cursor_ring_.Init(1, kCursorSlots);
+    if (err < 0) {
+        zxlogf(ERROR, "%s: failed to allocate cursor vring\n", tag());
+        return err;
+    }
+
     // allocate a gpu request
     auto r = map_contiguous_memory(PAGE_SIZE, (uintptr_t*)&gpu_req_, &gpu_req_pa_);
     if (r < 0) {
@@ -487,6 +697,12 @@ zx_status_t GpuDevice::Init() {
 
     LTRACEF("allocated gpu request at %p, physical address %#" PRIxPTR "\n", gpu_req_, gpu_req_pa_);
 
+    r = map_contiguous_memory(PAGE_SIZE, (uintptr_t*)&cursor_req_, &cursor_req_pa_);
+    if (r < 0) {
+        zxlogf(ERROR, "%s: cannot alloc cursor request buffers %d\n", tag(), r);
+        return r;
+    }
+
     // start the interrupt thread
     StartIrqThread();
 
@@ -503,11 +719,13 @@ zx_status_t GpuDevice::Init() {
 void GpuDevice::IrqRingUpdate() {
     LTRACE_ENTRY;
 
+    fbl::AutoLock lock(&request_lock_);
+
     // parse our descriptor chain, add back to the free queue
-    auto free_chain = [this](vring_used_elem* used_elem) {
-        uint32_t i = (uint16_t)used_elem->id;
-        struct vring_desc* desc = vring_.DescFromIndex((uint16_t)i);
-        __UNUSED auto head_desc = desc; // save the first element
+    auto free_chain = [this](vring_used_elem* used_elem) __TA_NO_THREAD_SAFETY_ANALYSIS {
+        uint16_t head = (uint16_t)used_elem->id;
+        uint16_t i = head;
+        struct vring_desc* desc = vring_.DescFromIndex(i);
         for (;;) {
             int next;
 
@@ -518,22 +736,52 @@ void GpuDevice::IrqRingUpdate() {
                 next = -1;
             }
 
-            vring_.FreeDesc((uint16_t)i);
+            vring_.FreeDesc(i);
 
             if (next < 0)
                 break;
-            i = next;
-            desc = vring_.DescFromIndex((uint16_t)i);
+            i = (uint16_t)next;
+            desc = vring_.DescFromIndex(i);
         }
 
-        // wack the request condition
-        request_lock_.Acquire();
-        cnd_signal(&request_cond_);
-        request_lock_.Release();
+        for (size_t n = 0; n < kCmdSlots; n++) {
+            CmdSlot* slot = &slots_[n];
+            if (slot->state == SlotState::kFree || slot->desc != head) {
+                continue;
+            }
+            auto cmd = reinterpret_cast<virtio_gpu_ctrl_hdr*>(
+                static_cast<uint8_t*>(gpu_req_) + n * kCmdSlotSize);
+            auto res = reinterpret_cast<virtio_gpu_ctrl_hdr*>(
+                reinterpret_cast<uint8_t*>(cmd) + slot->cmd_len);
+            if (cmd->flags & VIRTIO_GPU_FLAG_FENCE) {
+                completed_fence_id_ = MAX(completed_fence_id_, cmd->fence_id);
+            }
+            if (slot->state == SlotState::kAsync) {
+                if (res->type != VIRTIO_GPU_RESP_OK_NODATA) {
+                    zxlogf(ERROR, "%s: command 0x%x failed 0x%x\n", tag(), cmd->type, res->type);
+                }
+                slot->state = SlotState::kFree;
+            } else {
+                slot->state = SlotState::kDone;
+            }
+            break;
+        }
+    };
+
+    // cursor commands are fire and forget
+    auto free_cursor_chain = [this](vring_used_elem* used_elem) __TA_NO_THREAD_SAFETY_ANALYSIS {
+        uint16_t i = (uint16_t)used_elem->id;
+        zx_paddr_t addr = cursor_ring_.DescFromIndex(i)->addr;
+        cursor_ring_.FreeDesc(i);
+        cursor_slot_busy_[(addr - cursor_req_pa_) / sizeof(virtio_gpu_update_cursor)] = false;
     };
 
     // tell the ring to find free chains and hand it back to our lambda
     vring_.IrqRingUpdate(free_chain);
+    cursor_ring_.IrqRingUpdate(free_cursor_chain);
+
+    // wack the request condition
+    cnd_broadcast(&request_cond_);
 }
 
 void GpuDevice::IrqConfigChange() {
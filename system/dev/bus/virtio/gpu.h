@@ -7,7 +7,9 @@
 #include "ring.h"
 #include "virtio_gpu.h"
 
+#include <fbl/mutex.h>
 #include <fbl/unique_ptr.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <zircon/compiler.h>
 
@@ -31,6 +33,9 @@ public:
     const virtio_gpu_resp_display_info::virtio_gpu_display_one* pmode() const { return &pmode_; }
 
     void Flush();
+    void FlushRegion(uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+    zx_status_t SetCursor(const void* pixels, uint32_t hot_x, uint32_t hot_y);
+    void MoveCursor(int32_t x, int32_t y);
 
     const char* tag() const override { return "virtio-gpu"; };
 
@@ -40,15 +45,35 @@ private:
     static zx_status_t virtio_gpu_get_mode(void* ctx, zx_display_info_t* info);
     static zx_status_t virtio_gpu_get_framebuffer(void* ctx, void** framebuffer);
     static void virtio_gpu_flush(void* ctx);
+    static void virtio_gpu_flush_region(void* ctx, uint32_t x, uint32_t y,
+                                        uint32_t width, uint32_t height);
+    static zx_status_t virtio_gpu_set_cursor(void* ctx, const void* pixels,
+                                             uint32_t hot_x, uint32_t hot_y);
+    static void virtio_gpu_move_cursor(void* ctx, int32_t x, int32_t y);
+
+    struct Rect {
+        uint32_t x;
+        uint32_t y;
+        uint32_t width;
+        uint32_t height;
+    };
 
     // internal routines
-    zx_status_t send_command_response(const void* cmd, size_t cmd_len, void** _res, size_t res_len);
+    zx_status_t send_command_response(const void* cmd, size_t cmd_len, void* res, size_t res_len);
+    int queue_command_locked(const void* cmd, size_t cmd_len, size_t res_len, bool wait)
+        __TA_REQUIRES(request_lock_);
+    void init_fence(virtio_gpu_ctrl_hdr* hdr) __TA_REQUIRES(request_lock_);
     zx_status_t get_display_info();
-    zx_status_t allocate_2d_resource(uint32_t* resource_id, uint32_t width, uint32_t height);
+    zx_status_t allocate_2d_resource(uint32_t* resource_id, uint32_t format,
+                                     uint32_t width, uint32_t height);
     zx_status_t attach_backing(uint32_t resource_id, zx_paddr_t ptr, size_t buf_len);
     zx_status_t set_scanout(uint32_t scanout_id, uint32_t resource_id, uint32_t width, uint32_t height);
     zx_status_t flush_resource(uint32_t resource_id, uint32_t width, uint32_t height);
     zx_status_t transfer_to_host_2d(uint32_t resource_id, uint32_t width, uint32_t height);
+    void build_transfer_to_host_2d(virtio_gpu_transfer_to_host_2d* req, uint32_t resource_id,
+                                   const Rect& r, uint32_t stride);
+    void build_flush_resource(virtio_gpu_resource_flush* req, uint32_t resource_id, const Rect& r);
+    zx_status_t queue_cursor_command(const virtio_gpu_update_cursor& cmd);
 
     zx_status_t virtio_gpu_start();
     static int virtio_gpu_start_entry(void* arg);
@@ -57,12 +82,55 @@ private:
     // the main virtio ring
     Ring vring_ = {this};
 
+    // the cursor ring, for cursor updates that bypass the control queue
+    Ring cursor_ring_ = {this};
+
     // display protocol ops
     display_protocol_ops_t display_proto_ops_ = {};
 
-    // gpu op
+    // Control queue commands are pipelined. Each one in flight owns a slot
+    // of the request page that holds the command followed by its response.
+    static constexpr size_t kCmdSlotSize = 512;
+    static constexpr size_t kCmdSlots = PAGE_SIZE / kCmdSlotSize;
+    // Every command is a two-descriptor chain.
+    static constexpr uint16_t kRingSize = kCmdSlots * 2;
+    enum class SlotState {
+        kFree,
+        // the submitter waits for the response
+        kWaiting,
+        kDone,
+        // nobody waits; the irq handler checks and frees the slot
+        kAsync,
+    };
+    struct CmdSlot {
+        SlotState state;
+        uint16_t desc;
+        size_t cmd_len;
+    };
     void* gpu_req_ = nullptr;
     zx_paddr_t gpu_req_pa_ = 0;
+    CmdSlot slots_[kCmdSlots] __TA_GUARDED(request_lock_) = {};
+
+    // Flushes are fenced so the flusher can tell how many frames the host
+    // has yet to consume.
+    static constexpr uint64_t kMaxFramesInFlight = 2;
+    uint64_t last_fence_id_ __TA_GUARDED(request_lock_) = 0;
+    uint64_t completed_fence_id_ __TA_GUARDED(request_lock_) = 0;
+
+    // cursor queue requests, one descriptor each
+    static constexpr size_t kCursorSlots = 16;
+    void* cursor_req_ = nullptr;
+    zx_paddr_t cursor_req_pa_ = 0;
+    bool cursor_slot_busy_[kCursorSlots] __TA_GUARDED(request_lock_) = {};
+
+    // cursor image resource
+    uint32_t cursor_resource_id_ = 0;
+    void* cursor_fb_ = nullptr;
+    zx_paddr_t cursor_fb_pa_ = 0;
+    fbl::Mutex cursor_lock_;
+    bool cursor_visible_ __TA_GUARDED(cursor_lock_) = false;
+    uint32_t cursor_hot_x_ __TA_GUARDED(cursor_lock_) = 0;
+    uint32_t cursor_hot_y_ __TA_GUARDED(cursor_lock_) = 0;
 
     // a saved copy of the display
     virtio_gpu_resp_display_info::virtio_gpu_display_one pmode_ = {};
@@ -88,7 +156,9 @@ private:
     thrd_t flush_thread_ = {};
     fbl::Mutex flush_lock_;
     cnd_t flush_cond_ = {};
-    bool flush_pending_ = false;
+    bool flush_pending_ __TA_GUARDED(flush_lock_) = false;
+    // union of the regions flushed since the flusher last ran
+    Rect dirty_ __TA_GUARDED(flush_lock_) = {};
 };
 
 } // namespace virtio
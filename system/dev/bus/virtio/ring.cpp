@@ -129,14 +129,38 @@ void Ring::SubmitChain(uint16_t desc_index) {
     struct vring_avail* avail = ring_.avail;
 
     avail->ring[avail->idx & ring_.num_mask] = desc_index;
-    //mb();
+    // the entry must be visible before the index that publishes it
+    __atomic_thread_fence(__ATOMIC_RELEASE);
     avail->idx++;
 }
 
 void Ring::Kick() {
     LTRACE_ENTRY;
 
+    // Make the new avail index visible before looking at what the device
+    // asked for, then skip the notification (a VM exit, for a hypervisor)
+    // if the device is still working through entries from an earlier kick.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    uint16_t new_idx = ring_.avail->idx;
+    uint16_t old_idx = kicked_idx_;
+    kicked_idx_ = new_idx;
+    if (event_idx_) {
+        if (!vring_need_event(vring_avail_event(&ring_), new_idx, old_idx)) {
+            return;
+        }
+    } else if (ring_.used->flags & VRING_USED_F_NO_NOTIFY) {
+        return;
+    }
+
     device_->RingKick(index_);
 }
 
+void Ring::DisableInterrupts() {
+    no_interrupts_ = true;
+    ring_.avail->flags |= VRING_AVAIL_F_NO_INTERRUPT;
+    if (event_idx_) {
+        vring_used_event(&ring_) = static_cast<uint16_t>(ring_.last_used + 0x8000);
+    }
+}
+
 } // namespace virtio
@@ -24,6 +24,13 @@ public:
     void SubmitChain(uint16_t desc_index);
     void Kick();
 
+    // Use the event index fields to suppress kicks and interrupts; only
+    // once VIRTIO_F_RING_EVENT_IDX has been negotiated.
+    void EnableEventIdx() { event_idx_ = true; }
+    // Ask the device not to interrupt for this ring, for one whose used
+    // entries are only collected by polling IrqRingUpdate.
+    void DisableInterrupts();
+
     struct vring_desc* DescFromIndex(uint16_t index) {
         return &ring_.desc[index];
     }
@@ -41,6 +48,11 @@ private:
     uint16_t index_ = 0;
 
     vring ring_ = {};
+
+    bool event_idx_ = false;
+    bool no_interrupts_ = false;
+    // avail->idx when Kick() last ran
+    uint16_t kicked_idx_ = 0;
 };
 
 // perform the main loop of finding free descriptor chains and passing it to a passed in function
@@ -50,18 +62,35 @@ inline void Ring::IrqRingUpdate(T free_chain) {
     //         ring_.used->flags, ring_.used->idx, ring_.last_used);
 
     // find a new free chain of descriptors
-    uint16_t cur_idx = ring_.used->idx;
     uint16_t i = ring_.last_used;
-    for (; i != cur_idx; ++i) {
-        // TRACEF("looking at idx %u\n", i);
-
-        struct vring_used_elem* used_elem = &ring_.used->ring[i & ring_.num_mask];
-        // TRACEF("used chain id %u, len %u\n", used_elem->id, used_elem->len);
-
-        // free the chain
-        free_chain(used_elem);
+    for (;;) {
+        uint16_t cur_idx = ring_.used->idx;
+        for (; i != cur_idx; ++i) {
+            // TRACEF("looking at idx %u\n", i);
+
+            struct vring_used_elem* used_elem = &ring_.used->ring[i & ring_.num_mask];
+            // TRACEF("used chain id %u, len %u\n", used_elem->id, used_elem->len);
+
+            // free the chain
+            free_chain(used_elem);
+        }
+        ring_.last_used = i;
+        if (!event_idx_) {
+            break;
+        }
+        if (no_interrupts_) {
+            // keep the event index out of reach of the used index
+            vring_used_event(&ring_) = static_cast<uint16_t>(i + 0x8000);
+            break;
+        }
+        // Ask for an interrupt on the next used entry, then pick up any that
+        // arrived before the device could see the request.
+        vring_used_event(&ring_) = i;
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (ring_.used->idx == i) {
+            break;
+        }
     }
-    ring_.last_used = i;
 }
 
 void virtio_dump_desc(const struct vring_desc* desc);
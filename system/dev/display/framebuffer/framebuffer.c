@@ -41,22 +41,44 @@ struct fb {
     // only one fullscreen client may exist at a time
     // and we keep track of it here
     fbi_t* fullscreen;
+
+    // the client whose image was last presented, which
+    // gets told when its images reach the screen
+    fbi_t* presenter;
+
+    // the client that last set an overlay or the cursor
+    fbi_t* plane_owner;
 };
 
 #define FB_HAS_GPU(fb) (fb->dpy.ops->acquire_or_release_display != NULL)
 #define FB_ACQUIRE(fb) (fb->dpy.ops->acquire_or_release_display(fb->dpy.ctx, true))
 #define FB_RELEASE(fb) (fb->dpy.ops->acquire_or_release_display(fb->dpy.ctx, false))
+#define FB_HAS_SWAPCHAIN(fb) (fb->dpy.ops->present_image != NULL)
 static inline void FB_FLUSH(fb_t* fb) {
     if (fb->dpy.ops->flush) {
         fb->dpy.ops->flush(fb->dpy.ctx);
     }
 }
+static inline void FB_FLUSH_REGION(fb_t* fb, uint32_t x, uint32_t y,
+                                   uint32_t width, uint32_t height) {
+    if (fb->dpy.ops->flush_region) {
+        fb->dpy.ops->flush_region(fb->dpy.ctx, x, y, width, height);
+    } else {
+        FB_FLUSH(fb);
+    }
+}
+
+#define FB_MAX_IMAGES 8
 
 struct fbi {
     fb_t* fb;
     void* buffer;
     zx_handle_t vmo;
     uint32_t group;
+
+    // images imported for page flipping, 0 for unused slots
+    uint64_t images[FB_MAX_IMAGES];
+    zx_handle_t present_ch;
 };
 
 void fb_callback(bool acquired, void* cookie) {
@@ -72,6 +94,54 @@ void fb_callback(bool acquired, void* cookie) {
     mtx_unlock(&fb->lock);
 }
 
+// called from the display driver's interrupt thread
+static void fb_present_callback(uint64_t image_id, zx_time_t timestamp, void* cookie) {
+    fb_t* fb = cookie;
+    mtx_lock(&fb->lock);
+    if ((fb->presenter != NULL) && (fb->presenter->present_ch != ZX_HANDLE_INVALID)) {
+        display_present_info_t info = {
+            .image_id = image_id,
+            .timestamp = timestamp,
+        };
+        zx_channel_write(fb->presenter->present_ch, 0, &info, sizeof(info), NULL, 0);
+    }
+    mtx_unlock(&fb->lock);
+}
+
+// put the display's own framebuffer back on screen
+// called with fb->lock held
+static void fb_unpresent_locked(fb_t* fb) {
+    if (fb->presenter != NULL) {
+        fb->dpy.ops->present_image(fb->dpy.ctx, 0);
+        fb->presenter = NULL;
+    }
+}
+
+// hide the overlays and the cursor
+// called with fb->lock held
+static void fb_hide_planes_locked(fb_t* fb) {
+    if (fb->plane_owner == NULL) {
+        return;
+    }
+    if (fb->dpy.ops->set_overlay) {
+        for (uint32_t i = 0; fb->dpy.ops->set_overlay(fb->dpy.ctx, i, 0, 0, 0, 0, 0) == ZX_OK; i++) {
+        }
+    }
+    if (fb->dpy.ops->set_cursor) {
+        fb->dpy.ops->set_cursor(fb->dpy.ctx, NULL, 0, 0);
+    }
+    fb->plane_owner = NULL;
+}
+
+static int fbi_find_image(fbi_t* fbi, uint64_t id) {
+    for (int i = 0; i < FB_MAX_IMAGES; i++) {
+        if ((id != 0) && (fbi->images[i] == id)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
 static zx_status_t fbi_get_vmo(fbi_t* fbi, zx_handle_t* vmo) {
     mtx_lock(&fbi->fb->lock);
     zx_status_t r;
@@ -135,7 +205,7 @@ static zx_status_t fbi_ioctl(void* ctx, uint32_t op,
         }
         if ((fb->active == fbi->group) && (fbi->buffer != NULL)) {
             memcpy(fb->buffer + y * linesize, fbi->buffer + y * linesize, h * linesize);
-            FB_FLUSH(fb);
+            FB_FLUSH_REGION(fb, 0, y, fb->info.width, h);
         }
         mtx_unlock(&fb->lock);
         return ZX_OK;
@@ -177,6 +247,171 @@ static zx_status_t fbi_ioctl(void* ctx, uint32_t op,
             return ZX_OK;
         }
     }
+    case IOCTL_DISPLAY_IMPORT_IMAGE: {
+        if (in_len != sizeof(zx_handle_t)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        zx_handle_t vmo = *((const zx_handle_t*) in_buf);
+        if (!FB_HAS_SWAPCHAIN(fb)) {
+            zx_handle_close(vmo);
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+        if (out_len < sizeof(uint64_t)) {
+            zx_handle_close(vmo);
+            return ZX_ERR_BUFFER_TOO_SMALL;
+        }
+        mtx_lock(&fb->lock);
+        int slot = -1;
+        for (int i = 0; i < FB_MAX_IMAGES; i++) {
+            if (fbi->images[i] == 0) {
+                slot = i;
+                break;
+            }
+        }
+        if (slot < 0) {
+            mtx_unlock(&fb->lock);
+            zx_handle_close(vmo);
+            return ZX_ERR_NO_RESOURCES;
+        }
+        uint64_t id;
+        if ((r = fb->dpy.ops->import_vmo(fb->dpy.ctx, vmo, &id)) == ZX_OK) {
+            fbi->images[slot] = id;
+            *((uint64_t*) out_buf) = id;
+            *out_actual = sizeof(uint64_t);
+        }
+        mtx_unlock(&fb->lock);
+        return r;
+    }
+    case IOCTL_DISPLAY_RELEASE_IMAGE: {
+        if (in_len != sizeof(uint64_t)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        mtx_lock(&fb->lock);
+        int slot = fbi_find_image(fbi, *((const uint64_t*) in_buf));
+        if (slot < 0) {
+            mtx_unlock(&fb->lock);
+            return ZX_ERR_NOT_FOUND;
+        }
+        fb->dpy.ops->release_image(fb->dpy.ctx, fbi->images[slot]);
+        fbi->images[slot] = 0;
+        mtx_unlock(&fb->lock);
+        return ZX_OK;
+    }
+    case IOCTL_DISPLAY_PRESENT_IMAGE: {
+        if (in_len != sizeof(uint64_t)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        mtx_lock(&fb->lock);
+        int slot = fbi_find_image(fbi, *((const uint64_t*) in_buf));
+        if (slot < 0) {
+            r = ZX_ERR_NOT_FOUND;
+        } else if (fb->active != fbi->group) {
+            r = ZX_ERR_ACCESS_DENIED;
+        } else if ((r = fb->dpy.ops->present_image(fb->dpy.ctx, fbi->images[slot])) == ZX_OK) {
+            fb->presenter = fbi;
+        }
+        mtx_unlock(&fb->lock);
+        return r;
+    }
+    case IOCTL_DISPLAY_SET_OVERLAY: {
+        if (in_len != sizeof(ioctl_display_overlay_t)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        if (fb->dpy.ops->set_overlay == NULL) {
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+        const ioctl_display_overlay_t* o = in_buf;
+        mtx_lock(&fb->lock);
+        if ((o->image_id != 0) && (fbi_find_image(fbi, o->image_id) < 0)) {
+            r = ZX_ERR_NOT_FOUND;
+        } else if (fb->active != fbi->group) {
+            r = ZX_ERR_ACCESS_DENIED;
+        } else if ((r = fb->dpy.ops->set_overlay(fb->dpy.ctx, o->overlay, o->image_id,
+                                                 o->x, o->y, o->width, o->height)) == ZX_OK) {
+            fb->plane_owner = fbi;
+        }
+        mtx_unlock(&fb->lock);
+        return r;
+    }
+    case IOCTL_DISPLAY_SET_CURSOR: {
+        if (in_len != sizeof(ioctl_display_cursor_t)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        const ioctl_display_cursor_t* c = in_buf;
+        if (fb->dpy.ops->set_cursor == NULL) {
+            zx_handle_close(c->vmo);
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+        size_t size = DISPLAY_CURSOR_SIZE * DISPLAY_CURSOR_SIZE * 4;
+        uintptr_t pixels;
+        r = zx_vmar_map(zx_vmar_root_self(), 0, c->vmo, 0, size, ZX_VM_FLAG_PERM_READ, &pixels);
+        zx_handle_close(c->vmo);
+        if (r < 0) {
+            return r;
+        }
+        mtx_lock(&fb->lock);
+        if (fb->active != fbi->group) {
+            r = ZX_ERR_ACCESS_DENIED;
+        } else if ((r = fb->dpy.ops->set_cursor(fb->dpy.ctx, (const void*) pixels,
+                                                c->hot_x, c->hot_y)) == ZX_OK) {
+            fb->plane_owner = fbi;
+        }
+        mtx_unlock(&fb->lock);
+        zx_vmar_unmap(zx_vmar_root_self(), pixels, size);
+        return r;
+    }
+    case IOCTL_DISPLAY_MOVE_CURSOR: {
+        if (in_len != sizeof(ioctl_display_cursor_position_t)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        if (fb->dpy.ops->move_cursor == NULL) {
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+        const ioctl_display_cursor_position_t* pos = in_buf;
+        mtx_lock(&fb->lock);
+        if (fb->active != fbi->group) {
+            r = ZX_ERR_ACCESS_DENIED;
+        } else {
+            fb->dpy.ops->move_cursor(fb->dpy.ctx, pos->x, pos->y);
+            r = ZX_OK;
+        }
+        mtx_unlock(&fb->lock);
+        return r;
+    }
+    case IOCTL_DISPLAY_HIDE_CURSOR: {
+        if (fb->dpy.ops->set_cursor == NULL) {
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+        mtx_lock(&fb->lock);
+        if (fb->active != fbi->group) {
+            r = ZX_ERR_ACCESS_DENIED;
+        } else {
+            r = fb->dpy.ops->set_cursor(fb->dpy.ctx, NULL, 0, 0);
+        }
+        mtx_unlock(&fb->lock);
+        return r;
+    }
+    case IOCTL_DISPLAY_GET_PRESENT_CHANNEL: {
+        if (!FB_HAS_SWAPCHAIN(fb)) {
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+        if (out_len != sizeof(zx_handle_t)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        zx_handle_t ch0, ch1;
+        if ((r = zx_channel_create(0, &ch0, &ch1)) < 0) {
+            return r;
+        }
+        mtx_lock(&fb->lock);
+        if (fbi->present_ch != ZX_HANDLE_INVALID) {
+            zx_handle_close(fbi->present_ch);
+        }
+        fbi->present_ch = ch0;
+        mtx_unlock(&fb->lock);
+        *((zx_handle_t*) out_buf) = ch1;
+        *out_actual = sizeof(zx_handle_t);
+        return ZX_OK;
+    }
     case IOCTL_DISPLAY_SET_OWNER: {
         if (in_len != sizeof(uint32_t)) {
             return ZX_ERR_INVALID_ARGS;
@@ -201,6 +436,8 @@ static zx_status_t fbi_ioctl(void* ctx, uint32_t op,
             return ZX_ERR_PEER_CLOSED;
         }
         if ((*n == GROUP_VIRTCON) || (fb->fullscreen == NULL)) {
+            fb_unpresent_locked(fb);
+            fb_hide_planes_locked(fb);
             fb->active = GROUP_VIRTCON;
             zx_object_signal(fb->event, ZX_USER_SIGNAL_1, ZX_USER_SIGNAL_0);
         } else {
@@ -242,6 +479,20 @@ static void fbi_release(void* ctx) {
     // and if group 1 was active, make group 0 active
     fb_t* fb = fbi->fb;
     mtx_lock(&fb->lock);
+    if (fb->presenter == fbi) {
+        fb_unpresent_locked(fb);
+    }
+    if (fb->plane_owner == fbi) {
+        fb_hide_planes_locked(fb);
+    }
+    for (int i = 0; i < FB_MAX_IMAGES; i++) {
+        if (fbi->images[i] != 0) {
+            fb->dpy.ops->release_image(fb->dpy.ctx, fbi->images[i]);
+        }
+    }
+    if (fbi->present_ch != ZX_HANDLE_INVALID) {
+        zx_handle_close(fbi->present_ch);
+    }
     if (fb->fullscreen == fbi) {
         fb->fullscreen = NULL;
         if (fb->active == GROUP_FULLSCREEN) {
@@ -333,6 +584,9 @@ static zx_status_t fb_open(void* ctx, zx_device_t** out, uint32_t flags) {
 static void fb_unbind(void* ctx) {
     fb_t* fb = ctx;
     zx_device_t* dev = fb->zxdev;
+    if (FB_HAS_SWAPCHAIN(fb)) {
+        fb->dpy.ops->set_present_callback(fb->dpy.ctx, NULL, NULL);
+    }
     mtx_lock(&fb->lock);
     fb->zxdev = NULL;
     mtx_unlock(&fb->lock);
@@ -410,6 +664,9 @@ static zx_status_t fb_bind(void* ctx, zx_device_t* dev) {
         fb->dpy.ops->set_ownership_change_callback(fb->dpy.ctx, fb_callback, fb);
         FB_ACQUIRE(fb);
     }
+    if (FB_HAS_SWAPCHAIN(fb)) {
+        fb->dpy.ops->set_present_callback(fb->dpy.ctx, fb_present_callback, fb);
+    }
     return ZX_OK;
 
 fail:
@@ -7,6 +7,8 @@
 #include <cpuid.h>
 #include <string.h>
 
+#include <fbl/algorithm.h>
+#include <fbl/auto_lock.h>
 #include <zx/vmar.h>
 #include <zx/vmo.h>
 
@@ -33,6 +35,9 @@ DisplayDevice::~DisplayDevice() {
     if (framebuffer_) {
         zx::vmar::root_self().unmap(framebuffer_, framebuffer_size_);
     }
+    if (cursor_buffer_) {
+        zx::vmar::root_self().unmap(cursor_buffer_, 2 * kCursorBytes);
+    }
 }
 
 hwreg::RegisterIo* DisplayDevice::mmio_space() const {
@@ -80,6 +85,361 @@ void DisplayDevice::Flush() {
     }
 }
 
+zx_status_t DisplayDevice::ImportVmo(zx_handle_t handle, uint64_t* image_id_out) {
+    zx::vmo vmo(handle);
+    if (!controller_->has_interrupts()) {
+        // Without flip done interrupts there's no way to tell clients when
+        // they can reuse an image.
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    uint64_t size;
+    zx_status_t status = vmo.get_size(&size);
+    if (status != ZX_OK) {
+        return status;
+    }
+    if (size < framebuffer_size_) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+    // The gtt maps physical pages, so they all need to be present.
+    status = vmo.op_range(ZX_VMO_OP_COMMIT, 0, framebuffer_size_, nullptr, 0);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    fbl::AllocChecker ac;
+    auto image = fbl::make_unique_checked<Image>(&ac);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    fbl::AutoLock lock(&lock_);
+    images_.reserve(images_.size() + 1, &ac);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    image->gfx_addr = controller_->gtt()
+            ->Insert(mmio_space(), &vmo, framebuffer_size_,
+                     registers::PlaneSurface::kLinearAlignment,
+                     registers::PlaneSurface::kTrailingPtePadding);
+    if (!image->gfx_addr) {
+        zxlogf(ERROR, "i915: Failed to allocate gfx address for image\n");
+        return ZX_ERR_NO_RESOURCES;
+    }
+    image->vmo = fbl::move(vmo);
+    image->id = next_image_id_++;
+    *image_id_out = image->id;
+    images_.push_back(fbl::move(image));
+    return ZX_OK;
+}
+
+void DisplayDevice::ReleaseImage(uint64_t image_id) {
+    fbl::AutoLock lock(&lock_);
+    for (size_t i = 0; i < images_.size(); i++) {
+        if (images_[i]->id != image_id) {
+            continue;
+        }
+        fbl::unique_ptr<Image> image = images_.erase(i);
+        bool on_overlay = false;
+        for (uint32_t j = 0; j < kOverlayCount; j++) {
+            if (overlay_images_[j] == image_id) {
+                DisableOverlayLocked(j);
+                on_overlay = true;
+            }
+        }
+        if (image_id != current_image_ && !(flip_pending_ && image_id == pending_image_)) {
+            if (on_overlay) {
+                RetireOverlayImageLocked(fbl::move(image));
+            }
+            return;
+        }
+
+        // The plane is, or is about to be, scanning out of this image. Put
+        // the framebuffer back unless another image is already on its way,
+        // and hold on to the memory until the plane has moved off it.
+        if (!flip_pending_ || image_id == pending_image_) {
+            FlipLocked(0, fb_gfx_addr_->base);
+        }
+        fbl::AllocChecker ac;
+        retired_images_.push_back(fbl::move(image), &ac);
+        if (!ac.check()) {
+            zxlogf(ERROR, "i915: Leaking released image\n");
+            image.release();
+        }
+        return;
+    }
+}
+
+zx_status_t DisplayDevice::PresentImage(uint64_t image_id) {
+    fbl::AutoLock lock(&lock_);
+    if (image_id == 0) {
+        FlipLocked(0, fb_gfx_addr_->base);
+        return ZX_OK;
+    }
+    for (size_t i = 0; i < images_.size(); i++) {
+        Image* image = images_[i].get();
+        if (image->id == image_id) {
+            // The display engine doesn't snoop the cpu caches.
+            image->vmo.op_range(ZX_VMO_OP_CACHE_CLEAN, 0, framebuffer_size_, nullptr, 0);
+            FlipLocked(image_id, image->gfx_addr->base);
+            return ZX_OK;
+        }
+    }
+    return ZX_ERR_NOT_FOUND;
+}
+
+void DisplayDevice::SetPresentCallback(zx_display_present_cb_t callback, void* cookie) {
+    fbl::AutoLock lock(&lock_);
+    present_cb_ = callback;
+    present_cookie_ = cookie;
+}
+
+zx_status_t DisplayDevice::SetOverlay(uint32_t overlay, uint64_t image_id,
+                                      uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+    if (overlay >= kOverlayCount) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+    fbl::AutoLock lock(&lock_);
+    if (image_id == 0) {
+        if (overlay_images_[overlay] != 0) {
+            DisableOverlayLocked(overlay);
+        }
+        return ZX_OK;
+    }
+    if (width == 0 || height == 0 || x >= info_.width || y >= info_.height ||
+        width > info_.width - x || height > info_.height - y) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    Image* image = nullptr;
+    for (size_t i = 0; i < images_.size(); i++) {
+        if (images_[i]->id == image_id) {
+            image = images_[i].get();
+            break;
+        }
+    }
+    if (image == nullptr) {
+        return ZX_ERR_NOT_FOUND;
+    }
+    // The display engine doesn't snoop the cpu caches.
+    image->vmo.op_range(ZX_VMO_OP_CACHE_CLEAN, 0, framebuffer_size_, nullptr, 0);
+
+    // Images have the same layout as the framebuffer, and the overlay shows
+    // the top left of one. Everything is latched by the PLANE_SURF write,
+    // so the whole update reaches the screen at the same vblank.
+    registers::PipeRegs pipe_regs(pipe());
+    int plane = kFirstOverlayPlane + overlay;
+
+    auto plane_control = pipe_regs.PlaneControl(plane).FromValue(0);
+    plane_control.set_plane_enable(1);
+    plane_control.set_source_pixel_format(plane_control.kFormatRgb8888);
+    plane_control.set_tiled_surface(plane_control.kLinear);
+    plane_control.WriteTo(mmio_space());
+
+    auto plane_stride = pipe_regs.PlaneSurfaceStride(plane).FromValue(0);
+    plane_stride.set_stride(info_.stride / registers::PlaneSurfaceStride::kLinearStrideChunkSize);
+    plane_stride.WriteTo(mmio_space());
+
+    auto plane_pos = pipe_regs.PlanePosition(plane).FromValue(0);
+    plane_pos.set_x_pos(x);
+    plane_pos.set_y_pos(y);
+    plane_pos.WriteTo(mmio_space());
+
+    auto plane_size = pipe_regs.PlaneSurfaceSize(plane).FromValue(0);
+    plane_size.set_width_minus_1(width - 1);
+    plane_size.set_height_minus_1(height - 1);
+    plane_size.WriteTo(mmio_space());
+
+    auto plane_surface = pipe_regs.PlaneSurface(plane).FromValue(0);
+    plane_surface.set_surface_base_addr(
+            static_cast<uint32_t>(image->gfx_addr->base >> plane_surface.kRShiftCount));
+    plane_surface.WriteTo(mmio_space());
+
+    overlay_images_[overlay] = image_id;
+    return ZX_OK;
+}
+
+zx_status_t DisplayDevice::SetCursor(const void* pixels, uint32_t hot_x, uint32_t hot_y) {
+    fbl::AutoLock lock(&lock_);
+    if (pixels == nullptr) {
+        if (cursor_visible_) {
+            cursor_visible_ = false;
+            WriteCursorLocked();
+        }
+        return ZX_OK;
+    }
+    if (hot_x >= DISPLAY_CURSOR_SIZE || hot_y >= DISPLAY_CURSOR_SIZE) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    if (!cursor_gfx_addr_) {
+        zx_status_t status = AllocCursorLocked();
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+
+    // Write the buffer that isn't on screen, so the cursor never shows a
+    // half-written image.
+    cursor_index_ ^= 1;
+    uint32_t offset = cursor_index_ * kCursorBytes;
+    memcpy(reinterpret_cast<void*>(cursor_buffer_ + offset), pixels, kCursorBytes);
+    cursor_vmo_.op_range(ZX_VMO_OP_CACHE_CLEAN, offset, kCursorBytes, nullptr, 0);
+
+    cursor_hot_x_ = hot_x;
+    cursor_hot_y_ = hot_y;
+    cursor_visible_ = true;
+    WriteCursorLocked();
+    return ZX_OK;
+}
+
+void DisplayDevice::MoveCursor(int32_t x, int32_t y) {
+    fbl::AutoLock lock(&lock_);
+    cursor_x_ = x;
+    cursor_y_ = y;
+    if (cursor_visible_) {
+        WriteCursorLocked();
+    }
+}
+
+zx_status_t DisplayDevice::AllocCursorLocked() {
+    zx_status_t status = zx::vmo::create(2 * kCursorBytes, 0, &cursor_vmo_);
+    if (status != ZX_OK) {
+        return status;
+    }
+    status = cursor_vmo_.op_range(ZX_VMO_OP_COMMIT, 0, 2 * kCursorBytes, nullptr, 0);
+    if (status != ZX_OK) {
+        cursor_vmo_.reset();
+        return status;
+    }
+    status = zx::vmar::root_self().map(0, cursor_vmo_, 0, 2 * kCursorBytes,
+                                       ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE,
+                                       &cursor_buffer_);
+    if (status != ZX_OK) {
+        cursor_vmo_.reset();
+        return status;
+    }
+    cursor_gfx_addr_ = controller_->gtt()
+            ->Insert(mmio_space(), &cursor_vmo_, 2 * kCursorBytes,
+                     registers::CursorBase::kAlignment, 0);
+    if (!cursor_gfx_addr_) {
+        zxlogf(ERROR, "i915: Failed to allocate gfx address for cursor\n");
+        zx::vmar::root_self().unmap(cursor_buffer_, 2 * kCursorBytes);
+        cursor_buffer_ = 0;
+        cursor_vmo_.reset();
+        return ZX_ERR_NO_RESOURCES;
+    }
+    return ZX_OK;
+}
+
+void DisplayDevice::WriteCursorLocked() {
+    // CUR_CTL and CUR_POS are latched by the CUR_BASE write, so moving the
+    // cursor costs three register writes and no copying.
+    registers::PipeRegs pipe_regs(pipe());
+
+    // Keep at least one pixel of the cursor on screen.
+    int32_t x = fbl::clamp(cursor_x_ - static_cast<int32_t>(cursor_hot_x_),
+                           1 - DISPLAY_CURSOR_SIZE, static_cast<int32_t>(info_.width) - 1);
+    int32_t y = fbl::clamp(cursor_y_ - static_cast<int32_t>(cursor_hot_y_),
+                           1 - DISPLAY_CURSOR_SIZE, static_cast<int32_t>(info_.height) - 1);
+    auto cursor_pos = pipe_regs.CursorPos().FromValue(0);
+    cursor_pos.set_x_sign(x < 0);
+    cursor_pos.set_x_pos(x < 0 ? -x : x);
+    cursor_pos.set_y_sign(y < 0);
+    cursor_pos.set_y_pos(y < 0 ? -y : y);
+    cursor_pos.WriteTo(mmio_space());
+
+    auto cursor_ctl = pipe_regs.CursorControl().FromValue(0);
+    cursor_ctl.set_mode_select(cursor_visible_ ? cursor_ctl.kArgb64x64 : cursor_ctl.kDisabled);
+    cursor_ctl.WriteTo(mmio_space());
+
+    auto cursor_base = pipe_regs.CursorBase().FromValue(0);
+    if (cursor_gfx_addr_) {
+        uint64_t addr = cursor_gfx_addr_->base + cursor_index_ * kCursorBytes;
+        cursor_base.set_cursor_base(static_cast<uint32_t>(addr >> cursor_base.kRShiftCount));
+    }
+    cursor_base.WriteTo(mmio_space());
+}
+
+void DisplayDevice::DisableOverlayLocked(uint32_t overlay) {
+    registers::PipeRegs pipe_regs(pipe());
+    int plane = kFirstOverlayPlane + overlay;
+    pipe_regs.PlaneControl(plane).FromValue(0).WriteTo(mmio_space());
+    pipe_regs.PlaneSurface(plane).FromValue(0).WriteTo(mmio_space());
+    overlay_images_[overlay] = 0;
+}
+
+void DisplayDevice::RetireOverlayImageLocked(fbl::unique_ptr<Image> image) {
+    fbl::AllocChecker ac;
+    overlay_retired_images_.push_back(fbl::move(image), &ac);
+    if (!ac.check()) {
+        zxlogf(ERROR, "i915: Leaking released image\n");
+        image.release();
+        return;
+    }
+    // The overlay was written before the next vblank, so it has latched
+    // its new state by the end of the one after that at the latest.
+    overlay_retire_vblanks_ = 2;
+    SetVblankInterruptLocked(true);
+}
+
+void DisplayDevice::SetVblankInterruptLocked(bool enable) {
+    registers::PipeRegs pipe_regs(pipe());
+    auto mask = pipe_regs.PipeInterrupt(registers::PipeInterrupt::kMask).ReadFrom(mmio_space());
+    mask.set_vblank(!enable);
+    mask.WriteTo(mmio_space());
+}
+
+void DisplayDevice::HandleVblank() {
+    fbl::AutoLock lock(&lock_);
+    if (overlay_retire_vblanks_ > 0 && --overlay_retire_vblanks_ == 0) {
+        overlay_retired_images_.reset();
+        SetVblankInterruptLocked(false);
+    }
+}
+
+void DisplayDevice::FlipLocked(uint64_t image_id, uint64_t gfx_addr) {
+    // PLANE_SURF is double buffered; the write is latched at the next vblank.
+    registers::PipeRegs pipe_regs(pipe());
+    auto plane_surface = pipe_regs.PlaneSurface().ReadFrom(mmio_space());
+    plane_surface.set_surface_base_addr(
+            static_cast<uint32_t>(gfx_addr >> plane_surface.kRShiftCount));
+    plane_surface.WriteTo(mmio_space());
+
+    pending_image_ = image_id;
+    pending_gfx_addr_ = gfx_addr;
+    flip_pending_ = true;
+}
+
+void DisplayDevice::HandleFlipDone(zx_time_t timestamp) {
+    zx_display_present_cb_t callback;
+    void* cookie;
+    uint64_t image_id;
+    {
+        fbl::AutoLock lock(&lock_);
+        if (!flip_pending_) {
+            return;
+        }
+        // If another flip was queued before this interrupt was serviced, this
+        // completion is for an earlier one; wait for the next.
+        registers::PipeRegs pipe_regs(pipe());
+        auto live = pipe_regs.PlaneSurfaceLive().ReadFrom(mmio_space());
+        if (live.surface_base_addr() !=
+                static_cast<uint32_t>(pending_gfx_addr_ >> registers::PlaneSurface::kRShiftCount)) {
+            return;
+        }
+        flip_pending_ = false;
+        current_image_ = pending_image_;
+        retired_images_.reset();
+
+        callback = present_cb_;
+        cookie = present_cookie_;
+        image_id = current_image_;
+    }
+    if (callback) {
+        callback(image_id, timestamp, cookie);
+    }
+}
+
 bool DisplayDevice::EnablePowerWell2() {
     // Enable Power Wells
     auto power_well = registers::PowerWellControl2::Get().ReadFrom(mmio_space());
@@ -172,6 +532,19 @@ bool DisplayDevice::Init() {
             static_cast<uint32_t>(fb_gfx_addr_->base >> plane_surface.kRShiftCount));
     plane_surface.WriteTo(controller_->mmio_space());
 
+    // Report flips of the plane so that clients can pace presents.
+    // The vblank interrupt is enabled too, but stays masked until released
+    // overlay images are waiting on it.
+    auto flip_enable = pipe_regs.PipeInterrupt(registers::PipeInterrupt::kEnable)
+            .ReadFrom(controller_->mmio_space());
+    flip_enable.set_plane1_flip_done(1);
+    flip_enable.set_vblank(1);
+    flip_enable.WriteTo(controller_->mmio_space());
+    auto flip_mask = pipe_regs.PipeInterrupt(registers::PipeInterrupt::kMask)
+            .ReadFrom(controller_->mmio_space());
+    flip_mask.set_plane1_flip_done(0);
+    flip_mask.WriteTo(controller_->mmio_space());
+
     return true;
 }
 
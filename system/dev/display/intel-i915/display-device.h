@@ -6,6 +6,9 @@
 
 #include <ddktl/device.h>
 #include <ddktl/protocol/display.h>
+#include <fbl/mutex.h>
+#include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
 #include <hwreg/mmio.h>
 #include <region-alloc/region-alloc.h>
 #include <zx/vmo.h>
@@ -33,9 +36,24 @@ public:
     zx_status_t GetMode(zx_display_info_t* info);
     zx_status_t GetFramebuffer(void** framebuffer);
     void Flush();
+    zx_status_t ImportVmo(zx_handle_t vmo, uint64_t* image_id_out);
+    void ReleaseImage(uint64_t image_id);
+    zx_status_t PresentImage(uint64_t image_id);
+    void SetPresentCallback(zx_display_present_cb_t callback, void* cookie);
+    zx_status_t SetCursor(const void* pixels, uint32_t hot_x, uint32_t hot_y);
+    void MoveCursor(int32_t x, int32_t y);
+    zx_status_t SetOverlay(uint32_t overlay, uint64_t image_id,
+                           uint32_t x, uint32_t y, uint32_t width, uint32_t height);
 
     bool Init();
 
+    // Called from the controller's interrupt thread when a flip of this
+    // display's plane has taken effect.
+    void HandleFlipDone(zx_time_t timestamp);
+    // Called from the controller's interrupt thread at each vblank, while
+    // the vblank interrupt is unmasked.
+    void HandleVblank();
+
     const zx::vmo& framebuffer_vmo() const { return framebuffer_vmo_; }
     uint32_t framebuffer_size() const { return framebuffer_size_; }
     const zx_display_info_t& info() const { return info_; }
@@ -57,6 +75,28 @@ protected:
     bool ResetDdi();
 
 private:
+    // A client vmo that the plane can scan out of.
+    struct Image {
+        uint64_t id;
+        zx::vmo vmo;
+        fbl::unique_ptr<const GttRegion> gfx_addr;
+    };
+
+    // Overlays 0 and 1 are planes 2 and 3, which the hardware stacks in
+    // that order above plane 1.
+    static constexpr uint32_t kOverlayCount = 2;
+    static constexpr int kFirstOverlayPlane = 2;
+    // The cursor has two buffers, so that a new image can be written while
+    // the old one is still on screen.
+    static constexpr uint32_t kCursorBytes = DISPLAY_CURSOR_SIZE * DISPLAY_CURSOR_SIZE * 4;
+
+    void FlipLocked(uint64_t image_id, uint64_t gfx_addr) __TA_REQUIRES(lock_);
+    void DisableOverlayLocked(uint32_t overlay) __TA_REQUIRES(lock_);
+    void RetireOverlayImageLocked(fbl::unique_ptr<Image> image) __TA_REQUIRES(lock_);
+    void SetVblankInterruptLocked(bool enable) __TA_REQUIRES(lock_);
+    zx_status_t AllocCursorLocked() __TA_REQUIRES(lock_);
+    void WriteCursorLocked() __TA_REQUIRES(lock_);
+
     // Borrowed reference to Controller instance
     Controller* controller_;
 
@@ -70,6 +110,40 @@ private:
 
     bool inited_;
     zx_display_info_t info_;
+
+    fbl::Mutex lock_;
+    fbl::Vector<fbl::unique_ptr<Image>> images_ __TA_GUARDED(lock_);
+    // Images released while the plane might still be reading from them.
+    // They're freed once a later flip has taken effect.
+    fbl::Vector<fbl::unique_ptr<Image>> retired_images_ __TA_GUARDED(lock_);
+    uint64_t next_image_id_ __TA_GUARDED(lock_) = 1;
+    // The image on screen; 0 is the framebuffer.
+    uint64_t current_image_ __TA_GUARDED(lock_) = 0;
+    // The image written to PLANE_SURF, which takes effect at the next vblank.
+    uint64_t pending_image_ __TA_GUARDED(lock_) = 0;
+    uint64_t pending_gfx_addr_ __TA_GUARDED(lock_) = 0;
+    bool flip_pending_ __TA_GUARDED(lock_) = false;
+    zx_display_present_cb_t present_cb_ __TA_GUARDED(lock_) = nullptr;
+    void* present_cookie_ __TA_GUARDED(lock_) = nullptr;
+
+    // The image on each overlay, or 0 if it's hidden.
+    uint64_t overlay_images_[kOverlayCount] __TA_GUARDED(lock_) = {};
+    // Images released while an overlay might still be reading from them.
+    // Overlays don't report flips, so these are freed once enough vblanks
+    // have gone by for the overlay to have moved off them.
+    fbl::Vector<fbl::unique_ptr<Image>> overlay_retired_images_ __TA_GUARDED(lock_);
+    int overlay_retire_vblanks_ __TA_GUARDED(lock_) = 0;
+
+    zx::vmo cursor_vmo_ __TA_GUARDED(lock_);
+    uintptr_t cursor_buffer_ __TA_GUARDED(lock_) = 0;
+    fbl::unique_ptr<const GttRegion> cursor_gfx_addr_ __TA_GUARDED(lock_);
+    // The buffer most recently written to CUR_BASE.
+    uint32_t cursor_index_ __TA_GUARDED(lock_) = 0;
+    bool cursor_visible_ __TA_GUARDED(lock_) = false;
+    uint32_t cursor_hot_x_ __TA_GUARDED(lock_) = 0;
+    uint32_t cursor_hot_y_ __TA_GUARDED(lock_) = 0;
+    int32_t cursor_x_ __TA_GUARDED(lock_) = 0;
+    int32_t cursor_y_ __TA_GUARDED(lock_) = 0;
 };
 
 } // namespace i915
@@ -99,6 +99,32 @@ int Controller::IrqLoop() {
             sde_int_identity.WriteTo(mmio_space_.get());
         }
 
+        for (uint32_t i = 0; i < registers::kPipeCount; i++) {
+            registers::Pipe pipe = registers::kPipes[i];
+            if (!interrupt_ctrl.pipe_int_pending(pipe).get()) {
+                continue;
+            }
+            registers::PipeRegs pipe_regs(pipe);
+            auto identity = pipe_regs.PipeInterrupt(registers::PipeInterrupt::kIdentity)
+                    .ReadFrom(mmio_space_.get());
+            // Write back the register to clear the bits
+            identity.WriteTo(mmio_space_.get());
+            if (identity.plane1_flip_done() || identity.vblank()) {
+                zx_time_t now = zx_time_get(ZX_CLOCK_MONOTONIC);
+                for (size_t j = 0; j < display_devices_.size(); j++) {
+                    if (display_devices_[j]->pipe() != pipe) {
+                        continue;
+                    }
+                    if (identity.plane1_flip_done()) {
+                        display_devices_[j]->HandleFlipDone(now);
+                    }
+                    if (identity.vblank()) {
+                        display_devices_[j]->HandleVblank();
+                    }
+                }
+            }
+        }
+
         interrupt_ctrl.set_enable_mask(1);
         interrupt_ctrl.WriteTo(mmio_space_.get());
     }
@@ -119,7 +145,7 @@ void Controller::EnableBacklight(bool enable) {
     }
 }
 
-zx_status_t Controller::InitHotplug(pci_protocol_t* pci) {
+zx_status_t Controller::InitInterrupts(pci_protocol_t* pci) {
     // Disable interrupts here, we'll re-enable them at the very end of ::Bind
     auto interrupt_ctrl = registers::MasterInterruptControl::Get().ReadFrom(mmio_space_.get());
     interrupt_ctrl.set_enable_mask(0);
@@ -145,9 +171,15 @@ zx_status_t Controller::InitHotplug(pci_protocol_t* pci) {
     status = thrd_create_with_name(&irq_thread_, irq_handler, this, "i915-irq-thread");
     if (status != ZX_OK) {
         zxlogf(ERROR, "i915: Failed to create irq thread\n");
+        zx_handle_close(irq_);
+        irq_ = ZX_HANDLE_INVALID;
         return status;
     }
 
+    return ZX_OK;
+}
+
+zx_status_t Controller::InitHotplug() {
     auto sfuse_strap = registers::SouthFuseStrap::Get().ReadFrom(mmio_space_.get());
     for (uint32_t i = 0; i < registers::kDdiCount; i++) {
         registers::Ddi ddi = registers::kDdis[i];
@@ -341,8 +373,12 @@ bool Controller::ResetPipe(registers::Pipe pipe) {
     registers::TranscoderRegs trans_regs(pipe);
 
     // Disable planes
-    pipe_regs.PlaneControl().FromValue(0).WriteTo(mmio_space());
-    pipe_regs.PlaneSurface().FromValue(0).WriteTo(mmio_space());
+    for (int plane = 1; plane <= 3; plane++) {
+        pipe_regs.PlaneControl(plane).FromValue(0).WriteTo(mmio_space());
+        pipe_regs.PlaneSurface(plane).FromValue(0).WriteTo(mmio_space());
+    }
+    pipe_regs.CursorControl().FromValue(0).WriteTo(mmio_space());
+    pipe_regs.CursorBase().FromValue(0).WriteTo(mmio_space());
 
     // Disable the scalers (double buffered on PipeScalerWinSize)
     pipe_regs.PipeScalerCtrl(0).ReadFrom(mmio_space()).set_enable(0).WriteTo(mmio_space());
@@ -419,32 +455,42 @@ void Controller::AllocDisplayBuffers() {
         registers::Pipe pipe = registers::kPipes[i];
         registers::PipeRegs pipe_regs(pipe);
 
-        // Plane 1 gets everything
+        // The cursor and the overlay planes (2 and 3) get fixed slices of
+        // the pipe's share, and plane 1 gets the rest.
         constexpr uint32_t kPerDdi = 891 / 3;
-        auto buf_cfg = pipe_regs.PlaneBufCfg(1).FromValue(0);
-        buf_cfg.set_buffer_start(kPerDdi * pipe);
-        buf_cfg.set_buffer_end(kPerDdi * (pipe + 1) - 1);
-        buf_cfg.WriteTo(mmio_space());
-
-        // Cursor and planes 2 and 3 get nothing
-        pipe_regs.PlaneBufCfg(0).FromValue(0).WriteTo(mmio_space());
-        pipe_regs.PlaneBufCfg(2).FromValue(0).WriteTo(mmio_space());
-        pipe_regs.PlaneBufCfg(3).FromValue(0).WriteTo(mmio_space());
-
-        auto wm0 = pipe_regs.PlaneWatermark(0).FromValue(0);
-        wm0.set_enable(1);
-        wm0.set_lines(2);
-        wm0.set_blocks(kPerDdi);
-        wm0.WriteTo(mmio_space());
-
-        for (int i = 1; i < 8; i++) {
-            auto wm = pipe_regs.PlaneWatermark(i).FromValue(0);
-            wm.WriteTo(mmio_space());
+        constexpr uint32_t kCursorBlocks = 8;
+        constexpr uint32_t kOverlayBlocks = 48;
+        const uint32_t blocks[4] = {
+            kCursorBlocks, kPerDdi - kCursorBlocks - 2 * kOverlayBlocks,
+            kOverlayBlocks, kOverlayBlocks,
+        };
+        uint32_t start = kPerDdi * pipe;
+        for (int plane = 0; plane < 4; plane++) {
+            auto buf_cfg = pipe_regs.PlaneBufCfg(plane).FromValue(0);
+            buf_cfg.set_buffer_start(start);
+            buf_cfg.set_buffer_end(start + blocks[plane] - 1);
+            buf_cfg.WriteTo(mmio_space());
+            start += blocks[plane];
+
+            auto wm0 = pipe_regs.PlaneWatermark(plane, 0).FromValue(0);
+            wm0.set_enable(1);
+            wm0.set_lines(2);
+            wm0.set_blocks(blocks[plane]);
+            wm0.WriteTo(mmio_space());
+
+            for (int i = 1; i < 8; i++) {
+                auto wm = pipe_regs.PlaneWatermark(plane, i).FromValue(0);
+                wm.WriteTo(mmio_space());
+            }
         }
 
         // Write so double-buffered regs are updated
-        auto base = pipe_regs.PlaneSurface().ReadFrom(mmio_space());
-        base.WriteTo(mmio_space());
+        for (int plane = 1; plane <= 3; plane++) {
+            auto base = pipe_regs.PlaneSurface(plane).ReadFrom(mmio_space());
+            base.WriteTo(mmio_space());
+        }
+        auto cursor_base = pipe_regs.CursorBase().ReadFrom(mmio_space());
+        cursor_base.WriteTo(mmio_space());
     }
     // TODO(ZX-1413): Wait for vblank instead of sleeping
     zx_nanosleep(zx_deadline_after(ZX_MSEC(33)));
@@ -596,9 +642,22 @@ zx_status_t Controller::Bind(fbl::unique_ptr<i915::Controller>* controller_ptr)
     }
     mmio_space_ = fbl::move(mmio_space);
 
+    if (is_gen9(device_id_)) {
+        zxlogf(TRACE, "i915: initializing interrupts\n");
+        status = InitInterrupts(&pci);
+        if (status != ZX_OK) {
+            // The bootloader display works without interrupts, it just can't
+            // page flip.
+            zxlogf(ERROR, "i915: failed to init interrupts\n");
+            if (ENABLE_MODESETTING) {
+                return status;
+            }
+        }
+    }
+
     if (ENABLE_MODESETTING && is_gen9(device_id_)) {
         zxlogf(TRACE, "i915: initialzing hotplug\n");
-        status = InitHotplug(&pci);
+        status = InitHotplug();
         if (status != ZX_OK) {
             zxlogf(ERROR, "i915: failed to init hotplugging\n");
             return status;
@@ -34,6 +34,7 @@ public:
     hwreg::RegisterIo* mmio_space() { return mmio_space_.get(); }
     Gtt* gtt() { return &gtt_; }
     uint16_t device_id() const { return device_id_; }
+    bool has_interrupts() const { return irq_ != ZX_HANDLE_INVALID; }
 
     int IrqLoop();
 
@@ -42,7 +43,8 @@ public:
 
 private:
     void EnableBacklight(bool enable);
-    zx_status_t InitHotplug(pci_protocol_t* pci);
+    zx_status_t InitInterrupts(pci_protocol_t* pci);
+    zx_status_t InitHotplug();
     zx_status_t InitDisplays();
     fbl::unique_ptr<DisplayDevice> InitDisplay(registers::Ddi ddi);
     zx_status_t AddDisplay(fbl::unique_ptr<DisplayDevice>&& display);
@@ -46,6 +46,16 @@ public:
     DEF_BIT(3, ring_flip_source);
 };
 
+// PLANE_SURFLIVE
+class PlaneSurfaceLive : public hwreg::RegisterBase<PlaneSurfaceLive, uint32_t> {
+public:
+    static constexpr uint32_t kBaseAddr = 0x701ac;
+
+    // The surface address currently being scanned out, in the same form
+    // as PlaneSurface::surface_base_addr.
+    DEF_FIELD(31, 12, surface_base_addr);
+};
+
 // PLANE_STRIDE
 class PlaneSurfaceStride : public hwreg::RegisterBase<PlaneSurfaceStride, uint32_t> {
 public:
@@ -65,6 +75,15 @@ public:
     DEF_FIELD(12, 0, width_minus_1);
 };
 
+// PLANE_POS
+class PlanePosition : public hwreg::RegisterBase<PlanePosition, uint32_t> {
+public:
+    static constexpr uint32_t kBaseAddr = 0x7018c;
+
+    DEF_FIELD(28, 16, y_pos);
+    DEF_FIELD(12, 0, x_pos);
+};
+
 // PLANE_CTL
 class PlaneControl : public hwreg::RegisterBase<PlaneControl, uint32_t> {
 public:
@@ -120,6 +139,42 @@ public:
     DEF_FIELD(9, 0, blocks);
 };
 
+// CUR_CTL
+class CursorControl : public hwreg::RegisterBase<CursorControl, uint32_t> {
+public:
+    static constexpr uint32_t kBaseAddr = 0x70080;
+
+    DEF_BIT(26, pipe_gamma_enable);
+    DEF_BIT(24, pipe_csc_enable);
+    DEF_FIELD(5, 0, mode_select);
+    static constexpr uint32_t kDisabled = 0;
+    static constexpr uint32_t kArgb64x64 = 0x27;
+};
+
+// CUR_BASE
+class CursorBase : public hwreg::RegisterBase<CursorBase, uint32_t> {
+public:
+    static constexpr uint32_t kBaseAddr = 0x70084;
+
+    // Writing this register arms the other cursor registers, which all
+    // take effect together at the next vblank.
+    DEF_FIELD(31, 12, cursor_base);
+    static constexpr uint32_t kRShiftCount = 12;
+    static constexpr uint32_t kAlignment = 4096;
+};
+
+// CUR_POS
+class CursorPos : public hwreg::RegisterBase<CursorPos, uint32_t> {
+public:
+    static constexpr uint32_t kBaseAddr = 0x70088;
+
+    // Sign and magnitude, so the cursor can hang off the top or left edge.
+    DEF_BIT(31, y_sign);
+    DEF_FIELD(27, 16, y_pos);
+    DEF_BIT(15, x_sign);
+    DEF_FIELD(12, 0, x_pos);
+};
+
 // PS_CTRL
 class PipeScalerCtrl : public hwreg::RegisterBase<PipeScalerCtrl, uint32_t> {
 public:
@@ -137,6 +192,17 @@ public:
     DEF_FIELD(11, 0, y_size);
 };
 
+// DE_PIPE_INTERRUPT
+class PipeInterrupt : public hwreg::RegisterBase<PipeInterrupt, uint32_t> {
+public:
+    static constexpr uint32_t kMask = 0x44404;
+    static constexpr uint32_t kIdentity = 0x44408;
+    static constexpr uint32_t kEnable = 0x4440c;
+
+    DEF_BIT(3, plane1_flip_done);
+    DEF_BIT(0, vblank);
+};
+
 // An instance of PipeRegs represents the registers for a particular pipe.
 class PipeRegs {
 public:
@@ -146,18 +212,25 @@ public:
         return GetReg<registers::PipeSourceSize>();
     }
 
-    // The following methods get the instance of the plane register for plane 1.
-    hwreg::RegisterAddr<registers::PlaneSurface> PlaneSurface() {
-        return GetReg<registers::PlaneSurface>();
+    // The following methods get the instance of the plane register for
+    // |plane|, 1-3. Plane 1 is the primary plane.
+    hwreg::RegisterAddr<registers::PlaneSurface> PlaneSurface(int plane = 1) {
+        return GetPlaneReg<registers::PlaneSurface>(plane);
+    }
+    hwreg::RegisterAddr<registers::PlaneSurfaceLive> PlaneSurfaceLive(int plane = 1) {
+        return GetPlaneReg<registers::PlaneSurfaceLive>(plane);
+    }
+    hwreg::RegisterAddr<registers::PlaneSurfaceStride> PlaneSurfaceStride(int plane = 1) {
+        return GetPlaneReg<registers::PlaneSurfaceStride>(plane);
     }
-    hwreg::RegisterAddr<registers::PlaneSurfaceStride> PlaneSurfaceStride() {
-        return GetReg<registers::PlaneSurfaceStride>();
+    hwreg::RegisterAddr<registers::PlaneSurfaceSize> PlaneSurfaceSize(int plane = 1) {
+        return GetPlaneReg<registers::PlaneSurfaceSize>(plane);
     }
-    hwreg::RegisterAddr<registers::PlaneSurfaceSize> PlaneSurfaceSize() {
-        return GetReg<registers::PlaneSurfaceSize>();
+    hwreg::RegisterAddr<registers::PlanePosition> PlanePosition(int plane = 1) {
+        return GetPlaneReg<registers::PlanePosition>(plane);
     }
-    hwreg::RegisterAddr<registers::PlaneControl> PlaneControl() {
-        return GetReg<registers::PlaneControl>();
+    hwreg::RegisterAddr<registers::PlaneControl> PlaneControl(int plane = 1) {
+        return GetPlaneReg<registers::PlaneControl>(plane);
     }
     // 0 == cursor, 1-3 are regular planes
     hwreg::RegisterAddr<registers::PlaneBufCfg> PlaneBufCfg(int plane) {
@@ -165,8 +238,20 @@ public:
                 PlaneBufCfg::kBaseAddr + 0x1000 * pipe_ + 0x100 * plane);
     }
 
-    hwreg::RegisterAddr<registers::PlaneWm>PlaneWatermark(int wm_num) {
-        return hwreg::RegisterAddr<PlaneWm>(PlaneWm::kBaseAddr + 0x1000 * pipe_ + 4 * wm_num);
+    // 0 == cursor, 1-3 are regular planes
+    hwreg::RegisterAddr<registers::PlaneWm>PlaneWatermark(int plane, int wm_num) {
+        return hwreg::RegisterAddr<PlaneWm>(
+                PlaneWm::kBaseAddr + 0x1000 * pipe_ + 0x100 * (plane - 1) + 4 * wm_num);
+    }
+
+    hwreg::RegisterAddr<registers::CursorControl> CursorControl() {
+        return GetReg<registers::CursorControl>();
+    }
+    hwreg::RegisterAddr<registers::CursorBase> CursorBase() {
+        return GetReg<registers::CursorBase>();
+    }
+    hwreg::RegisterAddr<registers::CursorPos> CursorPos() {
+        return GetReg<registers::CursorPos>();
     }
 
     hwreg::RegisterAddr<registers::PipeScalerCtrl> PipeScalerCtrl(int num) {
@@ -179,11 +264,21 @@ public:
                 PipeScalerWinSize::kBaseAddr + 0x800 * pipe_ + num * 0x100);
     }
 
+    // |type| is one of the PipeInterrupt register offsets.
+    hwreg::RegisterAddr<registers::PipeInterrupt> PipeInterrupt(uint32_t type) {
+        return hwreg::RegisterAddr<registers::PipeInterrupt>(type + 0x10 * pipe_);
+    }
+
 private:
     template <class RegType> hwreg::RegisterAddr<RegType> GetReg() {
         return hwreg::RegisterAddr<RegType>(RegType::kBaseAddr + 0x1000 * pipe_);
     }
 
+    template <class RegType> hwreg::RegisterAddr<RegType> GetPlaneReg(int plane) {
+        return hwreg::RegisterAddr<RegType>(
+                RegType::kBaseAddr + 0x1000 * pipe_ + 0x100 * (plane - 1));
+    }
+
     Pipe pipe_;
 };
 
@@ -24,10 +24,10 @@
 
 #include "asix-88179.h"
 
-#define READ_REQ_COUNT 8
-#define WRITE_REQ_COUNT 8
+#define READ_REQ_COUNT 16
+#define WRITE_REQ_COUNT 16
 #define USB_BUF_SIZE 24576
-#define MAX_TX_IN_FLIGHT 4
+#define MAX_TX_IN_FLIGHT 8
 #define INTR_REQ_SIZE 8
 #define RX_HEADER_SIZE 4
 #define AX88179_MTU 1500
@@ -22,11 +22,11 @@
 #include <threads.h>
 #include <unistd.h>
 
-#define READ_REQ_COUNT 8
-#define WRITE_REQ_COUNT 4
+#define READ_REQ_COUNT 16
+#define WRITE_REQ_COUNT 8
 #define INTR_REQ_COUNT 4
 #define USB_BUF_IN_SIZE 16384
-#define USB_BUF_OUT_SIZE 2048
+#define USB_BUF_OUT_SIZE 16384
 #define INTR_REQ_SIZE 8
 #define ETH_HEADER_SIZE 4
 #define ETH_MTU 1500
@@ -51,6 +51,10 @@ typedef struct {
     // entries if free_write_reqs is empty.
     list_node_t pending_netbufs;
 
+    // Write request currently being filled with frames. It is held back from the USB stack
+    // while the ethernet layer indicates that more frames are coming.
+    usb_request_t* tx_req;
+
     // callback interface to attached ethernet layer
     ethmac_ifc_t* ifc;
     void* cookie;
@@ -179,8 +183,9 @@ static void ax88772b_recv(ax88772b_t* eth, usb_request_t* request) {
     }
 }
 
-// Send a netbuf to the USB interface using the provided request
-static zx_status_t ax88772b_send(ax88772b_t* eth, usb_request_t* request, ethmac_netbuf_t* netbuf) {
+// Append a netbuf to the frames already packed in a write request. Each frame is preceded by
+// its own length header and starts on a uint16 boundary, mirroring the receive path.
+static zx_status_t ax88772b_append_to_tx_req(usb_request_t* request, ethmac_netbuf_t* netbuf) {
     size_t length = netbuf->len;
 
     if (length + ETH_HEADER_SIZE > USB_BUF_OUT_SIZE) {
@@ -188,6 +193,16 @@ static zx_status_t ax88772b_send(ax88772b_t* eth, usb_request_t* request, ethmac
         return ZX_ERR_INVALID_ARGS;
     }
 
+    zx_off_t offset = request->header.length;
+    if (offset & 1) {
+        uint8_t pad = 0;
+        usb_request_copyto(request, &pad, 1, offset);
+        offset++;
+    }
+    if (offset + ETH_HEADER_SIZE + length > USB_BUF_OUT_SIZE) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+
     // write 4 byte packet header
     uint8_t header[ETH_HEADER_SIZE];
     uint8_t lo = length & 0xFF;
@@ -197,10 +212,9 @@ static zx_status_t ax88772b_send(ax88772b_t* eth, usb_request_t* request, ethmac
     header[2] = lo ^ 0xFF;
     header[3] = hi ^ 0xFF;
 
-    usb_request_copyto(request, header, ETH_HEADER_SIZE, 0);
-    usb_request_copyto(request, netbuf->data, length, ETH_HEADER_SIZE);
-    request->header.length = length + ETH_HEADER_SIZE;
-    usb_request_queue(&eth->usb, request);
+    usb_request_copyto(request, header, ETH_HEADER_SIZE, offset);
+    usb_request_copyto(request, netbuf->data, length, offset + ETH_HEADER_SIZE);
+    request->header.length = offset + ETH_HEADER_SIZE + length;
     return ZX_OK;
 }
 
@@ -234,14 +248,22 @@ static void ax88772b_write_complete(usb_request_t* request, void* cookie) {
     }
 
     mtx_lock(&eth->mutex);
-    if (!list_is_empty(&eth->pending_netbufs)) {
-        // If we have any netbufs that are waiting to be sent, reuse the request we just got back
-        ethmac_netbuf_t* netbuf = list_remove_head_type(&eth->pending_netbufs, ethmac_netbuf_t,
-                                                        node);
-        zx_status_t send_result = ax88772b_send(eth, request, netbuf);
+    // If we have any netbufs that are waiting to be sent, pack as many of them as will fit into
+    // the request we just got back
+    request->header.length = 0;
+    ethmac_netbuf_t* netbuf;
+    while ((netbuf = list_peek_head_type(&eth->pending_netbufs, ethmac_netbuf_t, node)) != NULL) {
+        zx_status_t send_result = ax88772b_append_to_tx_req(request, netbuf);
+        if (send_result == ZX_ERR_BUFFER_TOO_SMALL) {
+            break;
+        }
+        list_delete(&netbuf->node);
         if (eth->ifc) {
             eth->ifc->complete_tx(eth->cookie, netbuf, send_result);
         }
+    }
+    if (request->header.length > 0) {
+        usb_request_queue(&eth->usb, request);
     } else {
         list_add_tail(&eth->free_write_reqs, &request->node);
     }
@@ -307,15 +329,41 @@ static zx_status_t ax88772b_queue_tx(void* ctx, uint32_t options, ethmac_netbuf_
 
     mtx_lock(&eth->mutex);
 
-    list_node_t* node = list_remove_head(&eth->free_write_reqs);
-    if (!node) {
-        list_add_tail(&eth->pending_netbufs, &netbuf->node);
-        status = ZX_ERR_SHOULD_WAIT;
-        goto out;
+    if (!list_is_empty(&eth->pending_netbufs)) {
+        // Keep frames in order behind the ones already waiting for a request
+        goto pending;
+    }
+
+    if (eth->tx_req == NULL) {
+        eth->tx_req = list_remove_head_type(&eth->free_write_reqs, usb_request_t, node);
+        if (eth->tx_req == NULL) {
+            goto pending;
+        }
+        eth->tx_req->header.length = 0;
     }
-    usb_request_t* request = containerof(node, usb_request_t, node);
 
-    status = ax88772b_send(eth, request, netbuf);
+    status = ax88772b_append_to_tx_req(eth->tx_req, netbuf);
+    if (status == ZX_ERR_BUFFER_TOO_SMALL) {
+        // The current request is full, send it and start packing another one
+        usb_request_queue(&eth->usb, eth->tx_req);
+        eth->tx_req = list_remove_head_type(&eth->free_write_reqs, usb_request_t, node);
+        if (eth->tx_req == NULL) {
+            goto pending;
+        }
+        eth->tx_req->header.length = 0;
+        status = ax88772b_append_to_tx_req(eth->tx_req, netbuf);
+    }
+
+    // Hold on to a partially filled request while more frames are on their way
+    if (!(options & ETHMAC_TX_OPT_MORE) && eth->tx_req->header.length > 0) {
+        usb_request_queue(&eth->usb, eth->tx_req);
+        eth->tx_req = NULL;
+    }
+    goto out;
+
+pending:
+    list_add_tail(&eth->pending_netbufs, &netbuf->node);
+    status = ZX_ERR_SHOULD_WAIT;
 
 out:
     mtx_unlock(&eth->mutex);
@@ -344,6 +392,9 @@ static void ax88772b_free(ax88772b_t* eth) {
     while ((req = list_remove_head_type(&eth->free_intr_reqs, usb_request_t, node)) != NULL) {
         usb_request_release(req);
     }
+    if (eth->tx_req) {
+        usb_request_release(eth->tx_req);
+    }
     free(eth);
 }
 
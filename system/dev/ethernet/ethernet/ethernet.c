@@ -13,6 +13,7 @@
 #include <zircon/listnode.h>
 #include <zircon/process.h>
 #include <zircon/syscalls.h>
+#include <zircon/syscalls/fifo.h>
 #include <zircon/thread_annotations.h>
 #include <zircon/types.h>
 
@@ -48,17 +49,54 @@ typedef struct ethdev0 {
 
     int promisc_requesters;
 
+    // ETHMAC_SETPARAM_LRO is on
+    bool lro;
+
+    // client whose rx buffers the ethmac receives into, if any
+    struct ethdev* rx_owner;
+
+    // instances with a capture ring (ethdev_t, by capture_node)
+    list_node_t list_capture;
+
     ethmac_info_t info;
     uint32_t status;
     zx_device_t* zxdev;
+
+    mtx_t stats_lock;
+    eth_tx_stats_t tx_stats;
 } ethdev0_t;
 
 typedef struct tx_info {
     struct ethdev* edev;
+    struct eth_queue* q;
     void* fifo_cookie;
     ethmac_netbuf_t netbuf;
 } tx_info_t;
 
+typedef struct rx_info {
+    struct ethdev* edev;
+    void* fifo_cookie;
+    ethmac_netbuf_t netbuf;
+} rx_info_t;
+
+// One of a client's queue pairs, and the thread servicing its tx fifo.
+typedef struct eth_queue {
+    struct ethdev* edev;
+    uint32_t index;
+
+    // fifos are named from the perspective
+    // of the packet from from the client
+    // to the network interface
+    zx_handle_t tx_fifo;
+    zx_handle_t rx_fifo;
+
+    thrd_t tx_thr;
+    bool tx_thread;
+
+    uint32_t fail_rx_read;
+    uint32_t fail_rx_write;
+} eth_queue_t;
+
 // transmit thread has been created
 #define ETHDEV_TX_THREAD (1u)
 
@@ -77,6 +115,9 @@ typedef struct tx_info {
 // This client has requested promisc mode
 #define ETHDEV_PROMISC (0x20u)
 
+// rx thread has been created
+#define ETHDEV_RX_THREAD (0x40u)
+
 // indicates the device is busy although its lock is released
 #define ETHDEV0_BUSY (1u)
 
@@ -89,12 +130,10 @@ typedef struct ethdev {
     uint32_t state;
     char name[DEVICE_NAME_LEN];
 
-    // fifos are named from the perspective
-    // of the packet from from the client
-    // to the network interface
-    zx_handle_t tx_fifo;
+    // queue pairs; queue 0 always exists once the fifos have been obtained
+    eth_queue_t q[ETH_MAX_QUEUES];
+    uint32_t queue_count;
     uint32_t tx_depth;
-    zx_handle_t rx_fifo;
     uint32_t rx_depth;
 
     // io buffer
@@ -103,22 +142,38 @@ typedef struct ethdev {
     size_t io_size;
     zx_paddr_t* paddr_map;
 
+    // ETH_FEATURE_OFFLOADS bits enabled with SET_OFFLOADS
+    uint32_t offloads;
+
+    // capture ring, mapped from the vmo given with SET_CAPTURE
+    list_node_t capture_node;
+    zx_handle_t capture_vmo;
+    eth_capture_ring_t* capture;
+    uint8_t* capture_data;
+    uint64_t capture_size;
+    uint32_t capture_snaplen;
+
     tx_info_t all_tx_bufs[FIFO_DEPTH];
-    mtx_t lock;  // Protects free_tx_bufs
+    mtx_t lock;  // Protects free_tx_bufs, free_rx_bufs and rx_outstanding
     list_node_t free_tx_bufs;  // tx_info_t elements
 
-    // fifo thread
-    thrd_t tx_thr;
+    // When this client is the rx owner, its rx fifo entries are handed to
+    // the ethmac as netbufs by the rx thread.
+    rx_info_t all_rx_bufs[FIFO_DEPTH];
+    list_node_t free_rx_bufs;  // rx_info_t elements
+    uint32_t rx_outstanding;
+    cnd_t rx_done;
+    thrd_t rx_thr;
 
     zx_device_t* zxdev;
 
-    uint32_t fail_rx_read;
-    uint32_t fail_rx_write;
     uint32_t fail_tx_write;
 } ethdev_t;
 
 #define FAIL_REPORT_RATE 50
 
+static void eth_rx_release_locked(ethdev_t* edev, bool flush);
+
 static inline ssize_t eth_set_promisc_locked(ethdev_t* edev, bool req_on) {
     if (!req_on == !(edev->state & ETHDEV_PROMISC)) {
         return ZX_OK; // Duplicate request
@@ -149,17 +204,31 @@ static inline ssize_t eth_set_promisc_locked(ethdev_t* edev, bool req_on) {
     return status;
 }
 
-static void eth_handle_rx(ethdev_t* edev, const void* data, size_t len, uint32_t extra) {
+// The fifo flags a client gets for a packet the ethmac received with |flags|.
+static uint32_t eth_rx_flags(ethdev_t* edev, uint32_t flags) {
+    if ((flags & ETHMAC_RECV_CSUM_OK) && (edev->offloads & ETH_FEATURE_RX_CSUM)) {
+        return ETH_FIFO_RX_CSUM_OK;
+    }
+    return 0;
+}
+
+static void eth_handle_rx(eth_queue_t* q, const void* data, size_t len, uint32_t extra) {
+    ethdev_t* edev = q->edev;
     eth_fifo_entry_t e;
     zx_status_t status;
     uint32_t count;
 
+    if (edev->edev0->rx_owner == edev) {
+        // its rx buffers all belong to the ethmac
+        return;
+    }
+
     // TODO: read multiple and cache locally to reduce syscalls
-    if ((status = zx_fifo_read(edev->rx_fifo, &e, sizeof(e), &count)) < 0) {
+    if ((status = zx_fifo_read(q->rx_fifo, &e, sizeof(e), &count)) < 0) {
         if (status == ZX_ERR_SHOULD_WAIT) {
-            if ((edev->fail_rx_read++ % FAIL_REPORT_RATE) == 0) {
-                zxlogf(ERROR, "eth [%s]: no rx buffers available (%u times)\n",
-                       edev->name, edev->fail_rx_read);
+            if ((q->fail_rx_read++ % FAIL_REPORT_RATE) == 0) {
+                zxlogf(ERROR, "eth [%s]: no rx buffers available on queue %u (%u times)\n",
+                       edev->name, q->index, q->fail_rx_read);
             }
         } else {
             // Fatal, should force teardown
@@ -182,11 +251,11 @@ static void eth_handle_rx(ethdev_t* edev, const void* data, size_t len, uint32_t
         e.flags = ETH_FIFO_RX_OK | extra;
     }
 
-    if ((status = zx_fifo_write(edev->rx_fifo, &e, sizeof(e), &count)) < 0) {
+    if ((status = zx_fifo_write(q->rx_fifo, &e, sizeof(e), &count)) < 0) {
         if (status == ZX_ERR_SHOULD_WAIT) {
-            if ((edev->fail_rx_write++ % FAIL_REPORT_RATE) == 0) {
-                zxlogf(ERROR, "eth [%s]: no rx_fifo space available (%u times)\n",
-                       edev->name, edev->fail_rx_write);
+            if ((q->fail_rx_write++ % FAIL_REPORT_RATE) == 0) {
+                zxlogf(ERROR, "eth [%s]: no rx_fifo space available on queue %u (%u times)\n",
+                       edev->name, q->index, q->fail_rx_write);
             }
         } else {
             // Fatal, should force teardown
@@ -196,6 +265,68 @@ static void eth_handle_rx(ethdev_t* edev, const void* data, size_t len, uint32_t
     }
 }
 
+// Append a frame to a client's capture ring as a pcapng Enhanced Packet Block.
+static void eth_capture_frame(ethdev_t* edev, uint32_t interface_id, const void* data,
+                              size_t len, zx_time_t now) {
+    eth_capture_ring_t* ring = edev->capture;
+    size_t cap_len = len;
+    if (edev->capture_snaplen && (cap_len > edev->capture_snaplen)) {
+        cap_len = edev->capture_snaplen;
+    }
+    uint64_t block_len = sizeof(eth_capture_epb_t) + ROUNDUP(cap_len, 4) + sizeof(uint32_t);
+
+    // Only we write head; the client advances tail as it consumes blocks.
+    uint64_t head = ring->head;
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    uint64_t offset = head % edev->capture_size;
+    uint64_t skip = (edev->capture_size - offset < block_len) ? edev->capture_size - offset : 0;
+    if ((head - tail) + skip + block_len > edev->capture_size) {
+        ring->drops++;
+        return;
+    }
+
+    if (skip >= 2 * sizeof(uint32_t)) {
+        uint32_t* pad = (uint32_t*)(edev->capture_data + offset);
+        pad[0] = ETH_CAPTURE_BLOCK_PAD;
+        pad[1] = (uint32_t)skip;
+    }
+    head += skip;
+    offset = head % edev->capture_size;
+
+    uint8_t* block = edev->capture_data + offset;
+    eth_capture_epb_t* epb = (eth_capture_epb_t*)block;
+    epb->block_type = ETH_CAPTURE_BLOCK_EPB;
+    epb->block_len = (uint32_t)block_len;
+    epb->interface_id = interface_id;
+    epb->ts_high = (uint32_t)(now >> 32);
+    epb->ts_low = (uint32_t)now;
+    epb->cap_len = (uint32_t)cap_len;
+    epb->orig_len = (uint32_t)len;
+    memcpy(block + sizeof(*epb), data, cap_len);
+    memset(block + sizeof(*epb) + cap_len, 0, ROUNDUP(cap_len, 4) - cap_len);
+    memcpy(block + block_len - sizeof(uint32_t), &epb->block_len, sizeof(uint32_t));
+
+    ring->packets++;
+    if (cap_len < len) {
+        ring->truncated++;
+    }
+    __atomic_store_n(&ring->head, head + block_len, __ATOMIC_RELEASE);
+}
+
+// Offer a frame to every capture ring.  |interface_id| is 0 for received
+// frames and 1 for transmitted ones.
+static void eth_capture_locked(ethdev0_t* edev0, uint32_t interface_id, const void* data,
+                               size_t len) {
+    if (list_is_empty(&edev0->list_capture)) {
+        return;
+    }
+    zx_time_t now = zx_time_get(ZX_CLOCK_MONOTONIC);
+    ethdev_t* edev;
+    list_for_every_entry(&edev0->list_capture, edev, ethdev_t, capture_node) {
+        eth_capture_frame(edev, interface_id, data, len, now);
+    }
+}
+
 static void eth0_status(void* cookie, uint32_t status) {
     zxlogf(TRACE, "eth: status() %08x\n", status);
 
@@ -205,16 +336,17 @@ static void eth0_status(void* cookie, uint32_t status) {
 
     ethdev_t* edev;
     list_for_every_entry(&edev0->list_active, edev, ethdev_t, node) {
-        zx_object_signal_peer(edev->rx_fifo, 0, ETH_SIGNAL_STATUS);
+        zx_object_signal_peer(edev->q[0].rx_fifo, 0, ETH_SIGNAL_STATUS);
     }
     mtx_unlock(&edev0->lock);
 }
 
-static int tx_fifo_write(ethdev_t* edev, eth_fifo_entry_t* entries, uint32_t count) {
+static int tx_fifo_write(eth_queue_t* q, eth_fifo_entry_t* entries, uint32_t count) {
+    ethdev_t* edev = q->edev;
     zx_status_t status;
     uint32_t actual;
     // Writing should never fail, or fail to write all entries
-    status = zx_fifo_write(edev->tx_fifo, entries, sizeof(eth_fifo_entry_t) * count, &actual);
+    status = zx_fifo_write(q->tx_fifo, entries, sizeof(eth_fifo_entry_t) * count, &actual);
     if (status < 0) {
         zxlogf(ERROR, "eth [%s]: tx_fifo write failed %d\n", edev->name, status);
         return -1;
@@ -233,8 +365,25 @@ static void eth0_recv(void* cookie, void* data, size_t len, uint32_t flags) {
 
     ethdev_t* edev;
     mtx_lock(&edev0->lock);
+    eth_capture_locked(edev0, 0, data, len);
     list_for_every_entry(&edev0->list_active, edev, ethdev_t, node) {
-        eth_handle_rx(edev, data, len, 0);
+        eth_handle_rx(&edev->q[0], data, len, eth_rx_flags(edev, flags));
+    }
+    mtx_unlock(&edev0->lock);
+}
+
+// Each client gets the packet on the queue its flow hashes to, so one
+// client worker per queue sees every packet of the flows it owns.
+static void eth0_recv_hashed(void* cookie, void* data, size_t len, uint32_t flags,
+                             uint32_t hash) {
+    ethdev0_t* edev0 = cookie;
+
+    ethdev_t* edev;
+    mtx_lock(&edev0->lock);
+    eth_capture_locked(edev0, 0, data, len);
+    list_for_every_entry(&edev0->list_active, edev, ethdev_t, node) {
+        eth_handle_rx(&edev->q[hash % edev->queue_count], data, len,
+                      eth_rx_flags(edev, flags));
     }
     mtx_unlock(&edev0->lock);
 }
@@ -254,13 +403,64 @@ static void eth0_complete_tx(void* cookie, ethmac_netbuf_t* netbuf, zx_status_t
     mtx_unlock(&edev->lock);
 
     // Send the eth_fifo_entry back to the client
-    tx_fifo_write(edev, &entry, 1);
+    tx_fifo_write(tx_info->q, &entry, 1);
+}
+
+// A packet the ethmac received straight into the rx owner's io buffer.
+// Other clients get a copy, as they would from eth0_recv().
+static void eth0_complete_rx(void* cookie, ethmac_netbuf_t* netbuf, size_t len,
+                             zx_status_t status) {
+    ethdev0_t* edev0 = cookie;
+    rx_info_t* rx_info = containerof(netbuf, rx_info_t, netbuf);
+    ethdev_t* edev = rx_info->edev;
+    eth_fifo_entry_t entry = {.offset = netbuf->data - edev->io_buf,
+                              .length = 0,
+                              .flags = 0,
+                              .cookie = rx_info->fifo_cookie};
+
+    if (status == ZX_OK) {
+        if (len > netbuf->len) {
+            entry.flags = ETH_FIFO_INVALID;
+        } else {
+            entry.length = len;
+            entry.flags = ETH_FIFO_RX_OK | eth_rx_flags(edev, netbuf->flags);
+
+            ethdev_t* other;
+            mtx_lock(&edev0->lock);
+            eth_capture_locked(edev0, 0, netbuf->data, len);
+            list_for_every_entry(&edev0->list_active, other, ethdev_t, node) {
+                if (other != edev) {
+                    eth_handle_rx(&other->q[0], netbuf->data, len,
+                                  eth_rx_flags(other, netbuf->flags));
+                }
+            }
+            mtx_unlock(&edev0->lock);
+        }
+    }
+
+    // A flushed buffer goes back to the client empty, to be offered again.
+    uint32_t actual;
+    if ((status = zx_fifo_write(edev->q[0].rx_fifo, &entry, sizeof(entry), &actual)) < 0) {
+        if ((edev->q[0].fail_rx_write++ % FAIL_REPORT_RATE) == 0) {
+            zxlogf(ERROR, "eth [%s]: rx_fifo write failed %d (%u times)\n",
+                   edev->name, status, edev->q[0].fail_rx_write);
+        }
+    }
+
+    mtx_lock(&edev->lock);
+    list_add_head(&edev->free_rx_bufs, &rx_info->netbuf.node);
+    if (--edev->rx_outstanding == 0) {
+        cnd_broadcast(&edev->rx_done);
+    }
+    mtx_unlock(&edev->lock);
 }
 
 static ethmac_ifc_t ethmac_ifc = {
     .status = eth0_status,
     .recv = eth0_recv,
     .complete_tx = eth0_complete_tx,
+    .recv_hashed = eth0_recv_hashed,
+    .complete_rx = eth0_complete_rx,
 };
 
 static void eth_tx_echo(ethdev0_t* edev0, const void* data, size_t len) {
@@ -268,17 +468,25 @@ static void eth_tx_echo(ethdev0_t* edev0, const void* data, size_t len) {
     mtx_lock(&edev0->lock);
     list_for_every_entry(&edev0->list_active, edev, ethdev_t, node) {
         if (edev->state & ETHDEV_TX_LISTEN) {
-            eth_handle_rx(edev, data, len, ETH_FIFO_RX_TX);
+            eth_handle_rx(&edev->q[0], data, len, ETH_FIFO_RX_TX);
         }
     }
     mtx_unlock(&edev0->lock);
 }
 
+static void eth_tx_capture(ethdev0_t* edev0, const void* data, size_t len) {
+    mtx_lock(&edev0->lock);
+    eth_capture_locked(edev0, 1, data, len);
+    mtx_unlock(&edev0->lock);
+}
+
 static zx_status_t eth_tx_listen_locked(ethdev_t* edev, bool yes) {
     ethdev0_t* edev0 = edev->edev0;
 
     // update our state
     if (yes) {
+        // echoed packets take the copy path
+        eth_rx_release_locked(edev, true);
         edev->state |= ETHDEV_TX_LISTEN;
     } else {
         edev->state &= (~ETHDEV_TX_LISTEN);
@@ -304,12 +512,140 @@ static zx_status_t eth_tx_listen_locked(ethdev_t* edev, bool yes) {
     return ZX_OK;
 }
 
-static int eth_send(ethdev_t* edev, eth_fifo_entry_t* entries, uint32_t count) {
+// Describe the offloads a frame asks for in |netbuf|, from its headers.
+static bool eth_tx_offload(ethdev0_t* edev0, const uint8_t* frame, size_t len, uint16_t flags,
+                           ethmac_netbuf_t* netbuf) {
+    netbuf->flags = 0;
+    if (!(flags & (ETH_FIFO_TX_CSUM | ETH_FIFO_TX_TSO))) {
+        return true;
+    }
+
+    // ethertype, skipping one 802.1Q tag
+    size_t l3 = 14;
+    if (len < l3) {
+        return false;
+    }
+    uint16_t type = (uint16_t)((frame[12] << 8) | frame[13]);
+    if (type == 0x8100) {
+        l3 += 4;
+        if (len < l3) {
+            return false;
+        }
+        type = (uint16_t)((frame[16] << 8) | frame[17]);
+    }
+
+    size_t l4;
+    uint8_t proto;
+    bool v6;
+    if (type == 0x0800) {
+        if (len < l3 + 20) {
+            return false;
+        }
+        size_t ihl = (frame[l3] & 0xf) * 4u;
+        if ((ihl < 20) || (len < l3 + ihl)) {
+            return false;
+        }
+        if ((frame[l3 + 6] & 0x3f) || frame[l3 + 7]) {
+            // fragment
+            return false;
+        }
+        proto = frame[l3 + 9];
+        l4 = l3 + ihl;
+        v6 = false;
+    } else if (type == 0x86dd) {
+        if (len < l3 + 40) {
+            return false;
+        }
+        proto = frame[l3 + 6];
+        l4 = l3 + 40;
+        v6 = true;
+    } else {
+        return false;
+    }
+
+    size_t l4_hdr_len;
+    if (proto == 6) {
+        if (len < l4 + 20) {
+            return false;
+        }
+        l4_hdr_len = (frame[l4 + 12] >> 4) * 4u;
+        if ((l4_hdr_len < 20) || (len < l4 + l4_hdr_len)) {
+            return false;
+        }
+        netbuf->csum_offset = 16;
+    } else if ((proto == 17) && !(flags & ETH_FIFO_TX_TSO)) {
+        l4_hdr_len = 8;
+        if (len < l4 + l4_hdr_len) {
+            return false;
+        }
+        netbuf->csum_offset = 6;
+    } else {
+        return false;
+    }
+    netbuf->csum_start = (uint16_t)l4;
+    netbuf->flags = ETHMAC_NETBUF_CSUM;
+
+    if (flags & ETH_FIFO_TX_TSO) {
+        // each segment is one MTU of IP packet
+        size_t hdr_len = l4 + l4_hdr_len;
+        if (edev0->info.mtu <= hdr_len - l3) {
+            return false;
+        }
+        netbuf->hdr_len = (uint16_t)hdr_len;
+        netbuf->mss = (uint16_t)(edev0->info.mtu - (hdr_len - l3));
+        netbuf->flags |= v6 ? ETHMAC_NETBUF_TSO_V6 : ETHMAC_NETBUF_TSO_V4;
+    }
+    return true;
+}
+
+static bool eth_tx_valid(ethdev_t* edev, eth_fifo_entry_t* e, ethmac_netbuf_t* netbuf) {
+    if ((e->offset > edev->io_size) || (e->length > (edev->io_size - e->offset))) {
+        return false;
+    }
+    if (((e->flags & ETH_FIFO_TX_CSUM) && !(edev->offloads & ETH_FEATURE_TX_CSUM)) ||
+        ((e->flags & ETH_FIFO_TX_TSO) && !(edev->offloads & ETH_FEATURE_TSO))) {
+        return false;
+    }
+    return eth_tx_offload(edev->edev0, edev->io_buf + e->offset, e->length, e->flags, netbuf);
+}
+
+static void eth_tx_stats_add(ethdev0_t* edev0, uint32_t batch) {
+    if (batch == 0) {
+        return;
+    }
+    uint32_t bucket = 31 - __builtin_clz(batch);
+    if (bucket >= ETH_TX_STATS_BUCKETS) {
+        bucket = ETH_TX_STATS_BUCKETS - 1;
+    }
+    mtx_lock(&edev0->stats_lock);
+    edev0->tx_stats.frames += batch;
+    edev0->tx_stats.batches++;
+    if (batch > edev0->tx_stats.max_batch) {
+        edev0->tx_stats.max_batch = batch;
+    }
+    edev0->tx_stats.batch_sizes[bucket]++;
+    mtx_unlock(&edev0->stats_lock);
+}
+
+// Hand a batch of frames to the ethmac.  All but the last valid frame go
+// with ETHMAC_TX_OPT_MORE, so the driver can tell the hardware once.
+static int eth_send(eth_queue_t* q, eth_fifo_entry_t* entries, uint32_t count) {
+    ethdev_t* edev = q->edev;
     ethdev0_t* edev0 = edev->edev0;
+
+    uint32_t batch = 0;
+    ethmac_netbuf_t scratch;
+    for (uint32_t n = 0; n < count; n++) {
+        if (eth_tx_valid(edev, &entries[n], &scratch)) {
+            batch++;
+        }
+    }
+    eth_tx_stats_add(edev0, batch);
+
     for (eth_fifo_entry_t* e = entries; count > 0; e++) {
-        if ((e->offset > edev->io_size) || ((e->length > (edev->io_size - e->offset)))) {
+        if (!eth_tx_valid(edev, e, &scratch)) {
             e->flags = ETH_FIFO_INVALID;
-            tx_fifo_write(edev, e, 1);
+            tx_fifo_write(q, e, 1);
         } else {
             zx_status_t status;
             mtx_lock(&edev->lock);
@@ -319,9 +655,14 @@ static int eth_send(ethdev_t* edev, eth_fifo_entry_t* entries, uint32_t count) {
                  zxlogf(ERROR, "eth [%s]: invalid tx_info pool\n", edev->name);
                  return -1;
             }
-            uint32_t opts = count > 1 ? ETHMAC_TX_OPT_MORE : 0u;
-            if (opts) {
-                zxlogf(SPEW, "setting OPT_MORE (%u packets to go)\n", count);
+            tx_info->netbuf.flags = scratch.flags;
+            tx_info->netbuf.csum_start = scratch.csum_start;
+            tx_info->netbuf.csum_offset = scratch.csum_offset;
+            tx_info->netbuf.hdr_len = scratch.hdr_len;
+            tx_info->netbuf.mss = scratch.mss;
+            uint32_t opts = (--batch > 0 ? ETHMAC_TX_OPT_MORE : 0u) | ETHMAC_TX_OPT_QUEUE(q->index);
+            if (opts & ETHMAC_TX_OPT_MORE) {
+                zxlogf(SPEW, "setting OPT_MORE (%u packets to go)\n", batch);
             }
             tx_info->netbuf.data = edev->io_buf + e->offset;
             if (edev0->info.features & ETHMAC_FEATURE_DMA) {
@@ -329,11 +670,16 @@ static int eth_send(ethdev_t* edev, eth_fifo_entry_t* entries, uint32_t count) {
                                        (e->offset & PAGE_MASK);
             }
             tx_info->netbuf.len = e->length;
+            tx_info->q = q;
             tx_info->fifo_cookie = e->cookie;
             status = edev0->mac.ops->queue_tx(edev0->mac.ctx, opts, &tx_info->netbuf);
             if (edev->state & ETHDEV_TX_LOOPBACK) {
                 eth_tx_echo(edev0, edev->io_buf + e->offset, e->length);
             }
+            // unlocked peek; a capture that just started may miss a frame
+            if (!list_is_empty(&edev0->list_capture)) {
+                eth_tx_capture(edev0, edev->io_buf + e->offset, e->length);
+            }
             if (status != ZX_ERR_SHOULD_WAIT) {
                 // transaction completed, add buffer to free list and return fifo entry
                 // TODO: batch these so we can do a single fifo write
@@ -341,7 +687,7 @@ static int eth_send(ethdev_t* edev, eth_fifo_entry_t* entries, uint32_t count) {
                 mtx_lock(&edev->lock);
                 list_add_head(&edev->free_tx_bufs, &tx_info->netbuf.node);
                 mtx_unlock(&edev->lock);
-                tx_fifo_write(edev, e, 1);
+                tx_fifo_write(q, e, 1);
             }
         }
         count--;
@@ -350,16 +696,19 @@ static int eth_send(ethdev_t* edev, eth_fifo_entry_t* entries, uint32_t count) {
 }
 
 static int eth_tx_thread(void* arg) {
-    ethdev_t* edev = (ethdev_t*)arg;
-    eth_fifo_entry_t entries[FIFO_DEPTH / 2];
+    eth_queue_t* q = arg;
+    ethdev_t* edev = q->edev;
+    // room for everything the client can have queued, so each wakeup
+    // drains the fifo into a single batch
+    eth_fifo_entry_t entries[FIFO_DEPTH];
     zx_status_t status;
     uint32_t count;
 
     for (;;) {
-        if ((status = zx_fifo_read(edev->tx_fifo, entries, sizeof(entries), &count)) < 0) {
+        if ((status = zx_fifo_read(q->tx_fifo, entries, sizeof(entries), &count)) < 0) {
             if (status == ZX_ERR_SHOULD_WAIT) {
                 zx_signals_t observed;
-                if ((status = zx_object_wait_one(edev->tx_fifo,
+                if ((status = zx_object_wait_one(q->tx_fifo,
                                                  ZX_FIFO_READABLE |
                                                  ZX_FIFO_PEER_CLOSED |
                                                  kSignalFifoTerminate,
@@ -377,39 +726,208 @@ static int eth_tx_thread(void* arg) {
             }
         }
 
-        if (eth_send(edev, entries, count)) {
+        if (eth_send(q, entries, count)) {
             break;
         }
     }
 
-    zxlogf(INFO, "eth [%s]: tx_thread: exit: %d\n", edev->name, status);
+    zxlogf(INFO, "eth [%s]: tx_thread %u: exit: %d\n", edev->name, q->index, status);
     return 0;
 }
 
-static zx_status_t eth_get_fifos_locked(ethdev_t* edev, void* out_buf, size_t out_len,
-                                        size_t* out_actual) {
+// Whether the ethmac can DMA |len| bytes at |offset| of the io buffer.
+static bool eth_dma_contiguous(ethdev_t* edev, uint32_t offset, uint32_t len) {
+    size_t last = (offset + len - 1) / PAGE_SIZE;
+    for (size_t n = offset / PAGE_SIZE; n < last; n++) {
+        if (edev->paddr_map[n + 1] != edev->paddr_map[n] + PAGE_SIZE) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Hand one of the rx owner's buffers to the ethmac.
+static void eth_rx_post(ethdev_t* edev, eth_fifo_entry_t* e) {
+    ethdev0_t* edev0 = edev->edev0;
+    uint32_t actual;
+
+    if ((e->length == 0) || (e->offset >= edev->io_size) ||
+        (e->length > (edev->io_size - e->offset)) ||
+        !eth_dma_contiguous(edev, e->offset, e->length)) {
+        e->length = 0;
+        e->flags = ETH_FIFO_INVALID;
+        zx_fifo_write(edev->q[0].rx_fifo, e, sizeof(*e), &actual);
+        return;
+    }
+
+    mtx_lock(&edev->lock);
+    rx_info_t* rx_info = list_remove_head_type(&edev->free_rx_bufs, rx_info_t, netbuf.node);
+    if (rx_info != NULL) {
+        edev->rx_outstanding++;
+    }
+    mtx_unlock(&edev->lock);
+
+    zx_status_t status = ZX_ERR_NO_RESOURCES;
+    if (rx_info != NULL) {
+        rx_info->fifo_cookie = e->cookie;
+        rx_info->netbuf.data = edev->io_buf + e->offset;
+        rx_info->netbuf.phys = edev->paddr_map[e->offset / PAGE_SIZE] + (e->offset & PAGE_MASK);
+        rx_info->netbuf.len = e->length;
+        rx_info->netbuf.flags = 0;
+        status = edev0->mac.ops->queue_rx(edev0->mac.ctx, &rx_info->netbuf);
+    }
+    if (status != ZX_OK) {
+        // give the buffer back, empty
+        if (rx_info != NULL) {
+            mtx_lock(&edev->lock);
+            list_add_head(&edev->free_rx_bufs, &rx_info->netbuf.node);
+            if (--edev->rx_outstanding == 0) {
+                cnd_broadcast(&edev->rx_done);
+            }
+            mtx_unlock(&edev->lock);
+        }
+        e->length = 0;
+        e->flags = 0;
+        zx_fifo_write(edev->q[0].rx_fifo, e, sizeof(*e), &actual);
+    }
+}
+
+static int eth_rx_thread(void* arg) {
+    ethdev_t* edev = arg;
+    zx_handle_t rx_fifo = edev->q[0].rx_fifo;
+    eth_fifo_entry_t entries[FIFO_DEPTH / 2];
+    zx_status_t status;
+    uint32_t count;
+
+    for (;;) {
+        if ((status = zx_fifo_read(rx_fifo, entries, sizeof(entries), &count)) < 0) {
+            if (status == ZX_ERR_SHOULD_WAIT) {
+                zx_signals_t observed;
+                if ((status = zx_object_wait_one(rx_fifo,
+                                                 ZX_FIFO_READABLE |
+                                                 ZX_FIFO_PEER_CLOSED |
+                                                 kSignalFifoTerminate,
+                                                 ZX_TIME_INFINITE,
+                                                 &observed)) < 0) {
+                    zxlogf(ERROR, "eth [%s]: rx_fifo: error waiting: %d\n", edev->name, status);
+                    break;
+                }
+                if (observed & kSignalFifoTerminate)
+                    break;
+                continue;
+            } else {
+                zxlogf(ERROR, "eth [%s]: rx_fifo: cannot read: %d\n", edev->name, status);
+                break;
+            }
+        }
+        for (uint32_t n = 0; n < count; n++) {
+            eth_rx_post(edev, &entries[n]);
+        }
+    }
+
+    zxlogf(INFO, "eth [%s]: rx_thread: exit: %d\n", edev->name, status);
+    return 0;
+}
+
+// Make |edev| the rx owner if the ethmac can receive into its io buffer.
+// Only one client can own the ethmac's receive buffers; a promiscuous or
+// tx-listening client, or one with several queues, keeps the copy path.
+static void eth_rx_claim_locked(ethdev_t* edev) {
+    ethdev0_t* edev0 = edev->edev0;
+    if ((edev0->rx_owner != NULL) || (edev0->mac.ops->queue_rx == NULL) ||
+        !(edev0->info.features & ETHMAC_FEATURE_DMA) || (edev->paddr_map == NULL) ||
+        (edev->queue_count != 1) || (edev->state & (ETHDEV_PROMISC | ETHDEV_TX_LISTEN))) {
+        return;
+    }
+    int r = thrd_create_with_name(&edev->rx_thr, eth_rx_thread, edev, "eth-rx-thread");
+    if (r != thrd_success) {
+        zxlogf(ERROR, "eth [%s]: failed to start rx thread: %d\n", edev->name, r);
+        return;
+    }
+    edev->state |= ETHDEV_RX_THREAD;
+    edev0->rx_owner = edev;
+}
+
+// Stop handing |edev|'s buffers to the ethmac, and wait for it to return
+// the ones it has.  |flush| asks the ethmac to return them; otherwise it
+// is being stopped, which returns them.
+static void eth_rx_release_locked(ethdev_t* edev, bool flush) TA_NO_THREAD_SAFETY_ANALYSIS {
+    ethdev0_t* edev0 = edev->edev0;
+    if (edev0->rx_owner != edev) {
+        return;
+    }
+    if (edev->state & ETHDEV_RX_THREAD) {
+        edev->state &= ~ETHDEV_RX_THREAD;
+        zx_object_signal(edev->q[0].rx_fifo, 0, kSignalFifoTerminate);
+        int ret;
+        thrd_join(edev->rx_thr, &ret);
+    }
+
+    // complete_rx() takes edev0->lock
+    edev0->state |= ETHDEV0_BUSY;
+    mtx_unlock(&edev0->lock);
+    if (flush) {
+        edev0->mac.ops->set_param(edev0->mac.ctx, ETHMAC_SETPARAM_RX_FLUSH, 0, NULL);
+    }
+    mtx_lock(&edev->lock);
+    while (edev->rx_outstanding > 0) {
+        cnd_wait(&edev->rx_done, &edev->lock);
+    }
+    mtx_unlock(&edev->lock);
+    mtx_lock(&edev0->lock);
+    edev0->state &= ~ETHDEV0_BUSY;
+
+    edev0->rx_owner = NULL;
+}
+
+static uint32_t eth_queue_limit(ethdev0_t* edev0) {
+    uint32_t count = edev0->info.queue_count;
+    if (count < 1) {
+        return 1;
+    }
+    return (count > ETH_MAX_QUEUES) ? ETH_MAX_QUEUES : count;
+}
+
+// Create the fifos for the client's next queue, |index|.
+static zx_status_t eth_create_queue_locked(ethdev_t* edev, uint32_t index,
+                                           void* out_buf, size_t out_len,
+                                           size_t* out_actual) {
     if (out_len < sizeof(eth_fifos_t)) {
         return ZX_ERR_INVALID_ARGS;
     }
-    if (edev->tx_fifo != ZX_HANDLE_INVALID) {
+    if (index < edev->queue_count) {
         return ZX_ERR_ALREADY_BOUND;
     }
+    if ((index != edev->queue_count) || (index >= eth_queue_limit(edev->edev0))) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+    if (edev->state & ETHDEV_RUNNING) {
+        return ZX_ERR_BAD_STATE;
+    }
 
     eth_fifos_t* fifos = out_buf;
+    eth_queue_t* q = &edev->q[index];
 
+    // clients may map the fifos to queue buffers without a syscall each
     zx_status_t status;
-    if ((status = zx_fifo_create(FIFO_DEPTH, FIFO_ESIZE, 0, &fifos->tx_fifo, &edev->tx_fifo)) < 0) {
+    if ((status = zx_fifo_create(FIFO_DEPTH, FIFO_ESIZE, ZX_FIFO_MAPPABLE,
+                                 &fifos->tx_fifo, &q->tx_fifo)) < 0) {
         zxlogf(ERROR, "eth_create  [%s]: failed to create tx fifo: %d\n", edev->name, status);
         return status;
     }
-    if ((status = zx_fifo_create(FIFO_DEPTH, FIFO_ESIZE, 0, &fifos->rx_fifo, &edev->rx_fifo)) < 0) {
+    if ((status = zx_fifo_create(FIFO_DEPTH, FIFO_ESIZE, ZX_FIFO_MAPPABLE,
+                                 &fifos->rx_fifo, &q->rx_fifo)) < 0) {
         zxlogf(ERROR, "eth_create  [%s]: failed to create rx fifo: %d\n", edev->name, status);
         zx_handle_close(fifos->tx_fifo);
-        zx_handle_close(edev->tx_fifo);
-        edev->tx_fifo = ZX_HANDLE_INVALID;
+        zx_handle_close(q->tx_fifo);
+        q->tx_fifo = ZX_HANDLE_INVALID;
         return status;
     }
 
+    q->edev = edev;
+    q->index = index;
+    edev->queue_count++;
+
     edev->tx_depth = FIFO_DEPTH;
     edev->rx_depth = FIFO_DEPTH;
     fifos->tx_depth = FIFO_DEPTH;
@@ -419,6 +937,24 @@ static zx_status_t eth_get_fifos_locked(ethdev_t* edev, void* out_buf, size_t ou
     return ZX_OK;
 }
 
+static zx_status_t eth_get_fifos_locked(ethdev_t* edev, void* out_buf, size_t out_len,
+                                        size_t* out_actual) {
+    return eth_create_queue_locked(edev, 0, out_buf, out_len, out_actual);
+}
+
+static zx_status_t eth_get_queue_fifos_locked(ethdev_t* edev, const void* in_buf, size_t in_len,
+                                              void* out_buf, size_t out_len,
+                                              size_t* out_actual) {
+    if ((in_len != sizeof(uint32_t)) || (in_buf == NULL)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    uint32_t index = *(const uint32_t*)in_buf;
+    if (index == 0) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    return eth_create_queue_locked(edev, index, out_buf, out_len, out_actual);
+}
+
 static ssize_t eth_set_iobuf_locked(ethdev_t* edev, const void* in_buf, size_t in_len) {
     if (in_len < sizeof(zx_handle_t)) {
         return ZX_ERR_INVALID_ARGS;
@@ -451,8 +987,14 @@ static ssize_t eth_set_iobuf_locked(ethdev_t* edev, const void* in_buf, size_t i
             status = ZX_ERR_NO_MEMORY;
             goto fail;
         }
+        // Commit the pages so that the physical addresses we hand the ethmac
+        // stay valid for as long as we hold the vmo.
         // TODO: pin memory
-        if ((status = zx_vmo_op_range(edev->io_vmo, ZX_VMO_OP_LOOKUP, 0, size, &edev->paddr_map,
+        if ((status = zx_vmo_op_range(vmo, ZX_VMO_OP_COMMIT, 0, size, NULL, 0)) != ZX_OK) {
+            zxlogf(ERROR, "eth [%s]: vmo_op_range failed, can't commit io_buf\n", edev->name);
+            goto fail;
+        }
+        if ((status = zx_vmo_op_range(vmo, ZX_VMO_OP_LOOKUP, 0, size, edev->paddr_map,
                                       paddr_map_size)) != ZX_OK) {
             zxlogf(ERROR, "eth [%s]: vmo_op_range failed, can't determine phys addr\n", edev->name);
             goto fail;
@@ -475,15 +1017,141 @@ fail:
     return status;
 }
 
+static zx_status_t eth_capture_stop_locked(ethdev_t* edev) {
+    if (edev->capture == NULL) {
+        return ZX_OK;
+    }
+    list_delete(&edev->capture_node);
+    zx_vmar_unmap(zx_vmar_root_self(), (uintptr_t)edev->capture, 0);
+    zx_handle_close(edev->capture_vmo);
+    edev->capture = NULL;
+    edev->capture_data = NULL;
+    edev->capture_vmo = ZX_HANDLE_INVALID;
+    return ZX_OK;
+}
+
+static zx_status_t eth_set_capture_locked(ethdev_t* edev, const void* in_buf, size_t in_len) {
+    if (in_len < sizeof(zx_handle_t)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    zx_handle_t vmo = *((zx_handle_t*)in_buf);
+    if (edev->capture != NULL) {
+        zx_handle_close(vmo);
+        return ZX_ERR_ALREADY_BOUND;
+    }
+
+    size_t size;
+    zx_status_t status;
+    if ((status = zx_vmo_get_size(vmo, &size)) < 0) {
+        goto fail;
+    }
+    // room for the header and at least one full-sized frame
+    if (size < sizeof(eth_capture_ring_t) + PAGE_SIZE) {
+        status = ZX_ERR_INVALID_ARGS;
+        goto fail;
+    }
+
+    uintptr_t addr;
+    if ((status = zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, size,
+                              ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE, &addr)) < 0) {
+        zxlogf(ERROR, "eth [%s]: could not map capture ring: %d\n", edev->name, status);
+        goto fail;
+    }
+    eth_capture_ring_t* ring = (eth_capture_ring_t*)addr;
+    if (ring->magic != ETH_CAPTURE_MAGIC) {
+        zx_vmar_unmap(zx_vmar_root_self(), addr, 0);
+        status = ZX_ERR_INVALID_ARGS;
+        goto fail;
+    }
+
+    // blocks are multiples of four bytes, so keep the ring one too
+    ring->size = (size - sizeof(eth_capture_ring_t)) & ~3ull;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->packets = 0;
+    ring->drops = 0;
+    ring->truncated = 0;
+
+    edev->capture_vmo = vmo;
+    edev->capture = ring;
+    edev->capture_data = (uint8_t*)(ring + 1);
+    edev->capture_size = ring->size;
+    edev->capture_snaplen = ring->snaplen;
+    list_add_tail(&edev->edev0->list_capture, &edev->capture_node);
+    return ZX_OK;
+
+fail:
+    zx_handle_close(vmo);
+    return status;
+}
+
 // The thread safety analysis cannot reason through the aliasing of
 // edev0 and edev->edev0, so disable it.
+static uint32_t eth_features(ethdev0_t* edev0) {
+    uint32_t features = 0;
+    if (edev0->info.features & ETHMAC_FEATURE_WLAN) {
+        features |= ETH_FEATURE_WLAN;
+    }
+    if (edev0->info.features & ETHMAC_FEATURE_SYNTH) {
+        features |= ETH_FEATURE_SYNTH;
+    }
+    if (edev0->info.features & ETHMAC_FEATURE_TX_CSUM) {
+        features |= ETH_FEATURE_TX_CSUM;
+    }
+    if (edev0->info.features & ETHMAC_FEATURE_RX_CSUM) {
+        features |= ETH_FEATURE_RX_CSUM;
+    }
+    if (edev0->info.features & ETHMAC_FEATURE_TSO) {
+        features |= ETH_FEATURE_TSO;
+    }
+    if (edev0->info.features & ETHMAC_FEATURE_LRO) {
+        features |= ETH_FEATURE_LRO;
+    }
+    return features;
+}
+
+// LRO is on while every running client can take merged frames.  While no
+// client is running the ethmac is stopped and is left as it is.
+static void eth_update_lro_locked(ethdev0_t* edev0) {
+    if (!(edev0->info.features & ETHMAC_FEATURE_LRO) || list_is_empty(&edev0->list_active)) {
+        return;
+    }
+    bool lro = true;
+    ethdev_t* edev;
+    list_for_every_entry(&edev0->list_active, edev, ethdev_t, node) {
+        if (!(edev->offloads & ETH_FEATURE_LRO)) {
+            lro = false;
+        }
+    }
+    if (lro != edev0->lro) {
+        zx_status_t status = edev0->mac.ops->set_param(edev0->mac.ctx, ETHMAC_SETPARAM_LRO,
+                                                       lro, NULL);
+        if (status == ZX_OK) {
+            edev0->lro = lro;
+        } else {
+            zxlogf(ERROR, "eth: failed to turn LRO %s: %d\n", lro ? "on" : "off", status);
+        }
+    }
+}
+
+static zx_status_t eth_set_offloads_locked(ethdev_t* edev, const void* in_buf, size_t in_len) {
+    if (in_len != sizeof(uint32_t) || in_buf == NULL) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    uint32_t offloads = *(const uint32_t*)in_buf;
+    if (offloads & ~(eth_features(edev->edev0) & ETH_FEATURE_OFFLOADS)) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    edev->offloads = offloads;
+    eth_update_lro_locked(edev->edev0);
+    return ZX_OK;
+}
+
 static zx_status_t eth_start_locked(ethdev_t* edev) TA_NO_THREAD_SAFETY_ANALYSIS {
     ethdev0_t* edev0 = edev->edev0;
 
     // Cannot start unless tx/rx rings are configured
-    if ((edev->io_vmo == ZX_HANDLE_INVALID) ||
-        (edev->tx_fifo == ZX_HANDLE_INVALID) ||
-        (edev->rx_fifo == ZX_HANDLE_INVALID)) {
+    if ((edev->io_vmo == ZX_HANDLE_INVALID) || (edev->queue_count == 0)) {
         return ZX_ERR_BAD_STATE;
     }
 
@@ -491,13 +1159,18 @@ static zx_status_t eth_start_locked(ethdev_t* edev) TA_NO_THREAD_SAFETY_ANALYSIS
         return ZX_OK;
     }
 
-    if (!(edev->state & ETHDEV_TX_THREAD)) {
-        int r = thrd_create_with_name(&edev->tx_thr, eth_tx_thread,
-                                      edev, "eth-tx-thread");
+    for (uint32_t n = 0; n < edev->queue_count; n++) {
+        eth_queue_t* q = &edev->q[n];
+        if (q->tx_thread) {
+            continue;
+        }
+        int r = thrd_create_with_name(&q->tx_thr, eth_tx_thread,
+                                      q, "eth-tx-thread");
         if (r != thrd_success) {
             zxlogf(ERROR, "eth [%s]: failed to start tx thread: %d\n", edev->name, r);
             return ZX_ERR_INTERNAL;
         }
+        q->tx_thread = true;
         edev->state |= ETHDEV_TX_THREAD;
     }
 
@@ -518,6 +1191,8 @@ static zx_status_t eth_start_locked(ethdev_t* edev) TA_NO_THREAD_SAFETY_ANALYSIS
         edev->state |= ETHDEV_RUNNING;
         list_delete(&edev->node);
         list_add_tail(&edev0->list_active, &edev->node);
+        eth_rx_claim_locked(edev);
+        eth_update_lro_locked(edev0);
     } else {
         zxlogf(ERROR, "eth [%s]: failed to start mac: %d\n", edev->name, status);
     }
@@ -534,7 +1209,8 @@ static zx_status_t eth_stop_locked(ethdev_t* edev) TA_NO_THREAD_SAFETY_ANALYSIS
         edev->state &= (~ETHDEV_RUNNING);
         list_delete(&edev->node);
         list_add_tail(&edev0->list_idle, &edev->node);
-        if (list_is_empty(&edev0->list_active)) {
+        bool last = list_is_empty(&edev0->list_active);
+        if (last) {
             if (!(edev->state & ETHDEV_DEAD)) {
                 // Release the lock to allow other device operations in callback routine.
                 // Re-acquire lock afterwards. Set busy to prevent problems with other ioctls.
@@ -545,6 +1221,8 @@ static zx_status_t eth_stop_locked(ethdev_t* edev) TA_NO_THREAD_SAFETY_ANALYSIS
                 edev0->state &= ~ETHDEV0_BUSY;
             }
         }
+        eth_rx_release_locked(edev, !last || (edev->state & ETHDEV_DEAD));
+        eth_update_lro_locked(edev0);
     }
 
     return ZX_OK;
@@ -564,10 +1242,10 @@ static zx_status_t eth_get_status_locked(ethdev_t* edev, void* out_buf, size_t o
     if (out_len < sizeof(uint32_t)) {
         return ZX_ERR_INVALID_ARGS;
     }
-    if (edev->rx_fifo == ZX_HANDLE_INVALID) {
+    if (edev->queue_count == 0) {
         return ZX_ERR_BAD_STATE;
     }
-    if (zx_object_signal_peer(edev->rx_fifo, ETH_SIGNAL_STATUS, 0) != ZX_OK) {
+    if (zx_object_signal_peer(edev->q[0].rx_fifo, ETH_SIGNAL_STATUS, 0) != ZX_OK) {
         return ZX_ERR_INTERNAL;
     }
 
@@ -604,13 +1282,9 @@ static zx_status_t eth_ioctl(void* ctx, uint32_t op,
             eth_info_t* info = out_buf;
             memset(info, 0, sizeof(*info));
             memcpy(info->mac, edev->edev0->info.mac, ETH_MAC_SIZE);
-            if (edev->edev0->info.features & ETHMAC_FEATURE_WLAN) {
-                info->features |= ETH_FEATURE_WLAN;
-            }
-            if (edev->edev0->info.features & ETHMAC_FEATURE_SYNTH) {
-                info->features |= ETH_FEATURE_SYNTH;
-            }
+            info->features = eth_features(edev->edev0);
             info->mtu = edev->edev0->info.mtu;
+            info->queue_count = eth_queue_limit(edev->edev0);
             *out_actual = sizeof(*info);
             status = ZX_OK;
         }
@@ -619,6 +1293,20 @@ static zx_status_t eth_ioctl(void* ctx, uint32_t op,
     case IOCTL_ETHERNET_GET_FIFOS:
         status = eth_get_fifos_locked(edev, out_buf, out_len, out_actual);
         break;
+    case IOCTL_ETHERNET_GET_TX_STATS:
+        if (out_len < sizeof(eth_tx_stats_t)) {
+            status = ZX_ERR_BUFFER_TOO_SMALL;
+        } else {
+            mtx_lock(&edev->edev0->stats_lock);
+            memcpy(out_buf, &edev->edev0->tx_stats, sizeof(eth_tx_stats_t));
+            mtx_unlock(&edev->edev0->stats_lock);
+            *out_actual = sizeof(eth_tx_stats_t);
+            status = ZX_OK;
+        }
+        break;
+    case IOCTL_ETHERNET_GET_QUEUE_FIFOS:
+        status = eth_get_queue_fifos_locked(edev, in_buf, in_len, out_buf, out_len, out_actual);
+        break;
     case IOCTL_ETHERNET_SET_IOBUF:
         status = eth_set_iobuf_locked(edev, in_buf, in_len);
         break;
@@ -647,6 +1335,15 @@ static zx_status_t eth_ioctl(void* ctx, uint32_t op,
         }
         status = eth_set_promisc_locked(edev, *(bool*)in_buf);
         break;
+    case IOCTL_ETHERNET_SET_OFFLOADS:
+        status = eth_set_offloads_locked(edev, in_buf, in_len);
+        break;
+    case IOCTL_ETHERNET_SET_CAPTURE:
+        status = eth_set_capture_locked(edev, in_buf, in_len);
+        break;
+    case IOCTL_ETHERNET_CAPTURE_STOP:
+        status = eth_capture_stop_locked(edev);
+        break;
     default:
         // TODO: consider if we want this under the edev0->lock or not
         status = device_ioctl(edev->edev0->macdev, op, in_buf, in_len, out_buf, out_len, out_actual);
@@ -669,35 +1366,43 @@ static void eth_kill_locked(ethdev_t* edev) {
     zxlogf(TRACE, "eth [%s]: kill: tearing down%s\n",
             edev->name, (edev->state & ETHDEV_TX_THREAD) ? " tx thread" : "");
     eth_set_promisc_locked(edev, false);
+    eth_rx_release_locked(edev, true);
+    eth_capture_stop_locked(edev);
 
     // make sure any future ioctls or other ops will fail
     edev->state |= ETHDEV_DEAD;
 
     // try to convince clients to close us
-    if (edev->rx_fifo) {
-        zx_handle_close(edev->rx_fifo);
-        edev->rx_fifo = ZX_HANDLE_INVALID;
-    }
-    if (edev->tx_fifo) {
-        // Ask the TX thread to exit.
-        zx_object_signal(edev->tx_fifo, 0, kSignalFifoTerminate);
+    for (uint32_t n = 0; n < edev->queue_count; n++) {
+        eth_queue_t* q = &edev->q[n];
+        if (q->rx_fifo) {
+            zx_handle_close(q->rx_fifo);
+            q->rx_fifo = ZX_HANDLE_INVALID;
+        }
+        if (q->tx_fifo) {
+            // Ask the TX thread to exit.
+            zx_object_signal(q->tx_fifo, 0, kSignalFifoTerminate);
+        }
     }
     if (edev->io_vmo) {
         zx_handle_close(edev->io_vmo);
         edev->io_vmo = ZX_HANDLE_INVALID;
     }
 
-    if (edev->state & ETHDEV_TX_THREAD) {
-        edev->state &= (~ETHDEV_TX_THREAD);
-        int ret;
-        thrd_join(edev->tx_thr, &ret);
-        zxlogf(TRACE, "eth [%s]: kill: tx thread exited\n", edev->name);
-    }
-
-    if (edev->tx_fifo) {
-        zx_handle_close(edev->tx_fifo);
-        edev->tx_fifo = ZX_HANDLE_INVALID;
+    for (uint32_t n = 0; n < edev->queue_count; n++) {
+        eth_queue_t* q = &edev->q[n];
+        if (q->tx_thread) {
+            q->tx_thread = false;
+            int ret;
+            thrd_join(q->tx_thr, &ret);
+            zxlogf(TRACE, "eth [%s]: kill: tx thread %u exited\n", edev->name, n);
+        }
+        if (q->tx_fifo) {
+            zx_handle_close(q->tx_fifo);
+            q->tx_fifo = ZX_HANDLE_INVALID;
+        }
     }
+    edev->state &= (~ETHDEV_TX_THREAD);
 
     if (edev->io_buf) {
         zx_vmar_unmap(zx_vmar_root_self(), (uintptr_t)edev->io_buf, 0);
@@ -749,7 +1454,13 @@ static zx_status_t eth0_open(void* ctx, zx_device_t** out, uint32_t flags) {
         edev->all_tx_bufs[ndx].edev = edev;
         list_add_tail(&edev->free_tx_bufs, &edev->all_tx_bufs[ndx].netbuf.node);
     }
+    list_initialize(&edev->free_rx_bufs);
+    for (size_t ndx = 0; ndx < FIFO_DEPTH; ndx++) {
+        edev->all_rx_bufs[ndx].edev = edev;
+        list_add_tail(&edev->free_rx_bufs, &edev->all_rx_bufs[ndx].netbuf.node);
+    }
     mtx_init(&edev->lock, mtx_plain);
+    cnd_init(&edev->rx_done);
 
     device_add_args_t args = {
         .version = DEVICE_ADD_ARGS_VERSION,
@@ -834,8 +1545,10 @@ static zx_status_t eth_bind(void* ctx, zx_device_t* dev) {
     }
 
     mtx_init(&edev0->lock, mtx_plain);
+    mtx_init(&edev0->stats_lock, mtx_plain);
     list_initialize(&edev0->list_active);
     list_initialize(&edev0->list_idle);
+    list_initialize(&edev0->list_capture);
 
     edev0->macdev = dev;
 
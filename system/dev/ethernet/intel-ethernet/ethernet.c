@@ -40,11 +40,72 @@ typedef struct ethernet_device {
     io_buffer_t buffer;
     bool online;
 
+    // interrupt moderation, see eth_adapt_irq_rate()
+    uint32_t irq_rate;
+    uint64_t irq_count;
+    uint64_t poll_count;
+    uint64_t rx_count;
+
     // callback interface to attached ethernet layer
     ethmac_ifc_t* ifc;
     void* cookie;
 } ethernet_device_t;
 
+// Interrupt rate limits, in interrupts per second, by how much rx work
+// each interrupt finds: small batches mean latency sensitive traffic, so
+// interrupt often; full batches mean bulk traffic, so let the hardware
+// coalesce more and have the poll loop pick up the rest.
+#define ETH_IRQ_RATE_LOWEST_LATENCY 70000
+#define ETH_IRQ_RATE_LOW_LATENCY 20000
+#define ETH_IRQ_RATE_BULK 4000
+
+// Most packets handled per poll round before the lock is dropped, so tx
+// and control calls are not starved by a busy rx ring.
+#define ETH_RX_POLL_BUDGET (ETH_RXBUF_COUNT / 2)
+
+// Call with edev->lock held.
+static size_t eth_rx_poll(ethernet_device_t* edev, size_t budget) {
+    void* data;
+    size_t len;
+    bool csum_ok;
+    size_t count = 0;
+
+    while (count < budget && eth_rx(&edev->eth, &data, &len, &csum_ok) == ZX_OK) {
+        if (edev->ifc && (edev->state == ETH_RUNNING)) {
+            edev->ifc->recv(edev->cookie, data, len, csum_ok ? ETHMAC_RECV_CSUM_OK : 0);
+        }
+        eth_rx_ack(&edev->eth);
+        count++;
+    }
+    return count;
+}
+
+// Call with edev->lock held.
+static void eth_adapt_irq_rate(ethernet_device_t* edev, size_t packets) {
+    uint32_t target;
+    if (packets <= 4) {
+        target = ETH_IRQ_RATE_LOWEST_LATENCY;
+    } else if (packets <= ETH_RX_POLL_BUDGET) {
+        target = ETH_IRQ_RATE_LOW_LATENCY;
+    } else {
+        target = ETH_IRQ_RATE_BULK;
+    }
+
+    // Move a quarter of the way towards the target each time so that one
+    // odd interrupt does not swing the rate, but snap up to a higher rate
+    // immediately so a burst ending does not leave latency behind.
+    uint32_t rate = edev->irq_rate;
+    if (target > rate) {
+        rate = target;
+    } else {
+        rate -= (rate - target) / 4;
+    }
+    if (rate != edev->irq_rate) {
+        edev->irq_rate = rate;
+        eth_set_irq_rate(&edev->eth, rate);
+    }
+}
+
 static int irq_thread(void* arg) {
     ethernet_device_t* edev = arg;
     for (;;) {
@@ -56,17 +117,31 @@ static int irq_thread(void* arg) {
         }
 
         mtx_lock(&edev->lock);
+        edev->irq_count++;
         unsigned irq = eth_handle_irq(&edev->eth);
         if (irq & ETH_IRQ_RX) {
-            void* data;
-            size_t len;
-
-            while (eth_rx(&edev->eth, &data, &len) == ZX_OK) {
-                if (edev->ifc && (edev->state == ETH_RUNNING)) {
-                    edev->ifc->recv(edev->cookie, data, len, 0);
+            // Keep the rx interrupt masked while packets keep arriving and
+            // drain the ring in budgeted rounds, only going back to waiting
+            // on the interrupt once a round comes up short.
+            eth_rx_irq_disable(&edev->eth);
+            size_t total = 0;
+            for (;;) {
+                size_t count = eth_rx_poll(edev, ETH_RX_POLL_BUDGET);
+                edev->poll_count++;
+                total += count;
+                if (count < ETH_RX_POLL_BUDGET) {
+                    break;
                 }
-                eth_rx_ack(&edev->eth);
+                mtx_unlock(&edev->lock);
+                thrd_yield();
+                mtx_lock(&edev->lock);
             }
+            eth_rx_irq_enable(&edev->eth);
+            // Catch anything that landed between the last round and
+            // unmasking; the interrupt for it may already have been dropped.
+            total += eth_rx_poll(edev, ETH_RXBUF_COUNT);
+            edev->rx_count += total;
+            eth_adapt_irq_rate(edev, total);
         }
         if (irq & ETH_IRQ_LSC) {
             bool was_online = edev->online;
@@ -92,6 +167,7 @@ static zx_status_t eth_query(void* ctx, uint32_t options, ethmac_info_t* info) {
 
     memset(info, 0, sizeof(*info));
     ZX_DEBUG_ASSERT(ETH_TXBUF_SIZE >= ETH_MTU);
+    info->features = ETHMAC_FEATURE_TX_CSUM | ETHMAC_FEATURE_RX_CSUM;
     info->mtu = ETH_MTU;
     memcpy(info->mac, edev->eth.mac, sizeof(edev->eth.mac));
 
@@ -128,7 +204,14 @@ static zx_status_t eth_queue_tx(void* ctx, uint32_t options, ethmac_netbuf_t* ne
         return ZX_ERR_BAD_STATE;
     }
     // TODO: Add support for DMA directly from netbuf
-    return eth_tx(&edev->eth, netbuf->data, netbuf->len);
+    size_t css = 0;
+    size_t cso = 0;
+    if (netbuf->flags & ETHMAC_NETBUF_CSUM) {
+        css = netbuf->csum_start;
+        cso = css + netbuf->csum_offset;
+    }
+    return eth_tx(&edev->eth, netbuf->data, netbuf->len, css, cso,
+                  options & ETHMAC_TX_OPT_MORE);
 }
 
 static zx_status_t eth_set_param(void *ctx, uint32_t param, int32_t value, void* data) {
@@ -211,8 +294,34 @@ static void eth_release(void* ctx) {
     free(edev);
 }
 
+static zx_status_t eth_ioctl(void* ctx, uint32_t op, const void* in_buf, size_t in_len,
+                             void* out_buf, size_t out_len, size_t* out_actual) {
+    ethernet_device_t* edev = ctx;
+
+    switch (op) {
+    case IOCTL_ETHERNET_GET_IRQ_STATS: {
+        if (out_len < sizeof(eth_irq_stats_t)) {
+            return ZX_ERR_BUFFER_TOO_SMALL;
+        }
+        eth_irq_stats_t* stats = out_buf;
+        memset(stats, 0, sizeof(*stats));
+        mtx_lock(&edev->lock);
+        stats->interrupts = edev->irq_count;
+        stats->polls = edev->poll_count;
+        stats->rx_packets = edev->rx_count;
+        stats->irq_rate = edev->irq_rate;
+        mtx_unlock(&edev->lock);
+        *out_actual = sizeof(*stats);
+        return ZX_OK;
+    }
+    default:
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+}
+
 static zx_protocol_device_t device_ops = {
     .version = DEVICE_OPS_VERSION,
+    .ioctl = eth_ioctl,
     .suspend = eth_suspend,
     .resume = eth_resume,
     .release = eth_release,
@@ -283,6 +392,8 @@ static zx_status_t eth_bind(void* ctx, zx_device_t* dev) {
 
     eth_setup_buffers(&edev->eth, io_buffer_virt(&edev->buffer), io_buffer_phys(&edev->buffer));
     eth_init_hw(&edev->eth);
+    edev->irq_rate = ETH_IRQ_RATE_LOW_LATENCY;
+    eth_set_irq_rate(&edev->eth, edev->irq_rate);
 
     device_add_args_t args = {
         .version = DEVICE_ADD_ARGS_VERSION,
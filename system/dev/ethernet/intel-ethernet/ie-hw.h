@@ -16,6 +16,7 @@
 #define IE_TXCW      0x0178 // TX Config Word
 #define IE_RXCW      0x0180 // RX Config Word
 #define IE_ICR       0x00C0 // Interrupt Cause Read
+#define IE_ITR       0x00C4 // Interrupt Throttling Rate
 #define IE_ICS       0x00C8 // Interrupt Cause Set
 #define IE_IMS       0x00D0 // Interrupt Mask Set / Read
 #define IE_IMC       0x00D8 // Interrupt Mask Clear
@@ -116,6 +117,9 @@
 #define IE_RCTL_BSEX      (1 << 25) // Buffer Size Extension (x16)
 #define IE_RCTL_SECRC     (1 << 26) // Strip CRC Field
 
+#define IE_RXCSUM_IPOFL   (1 << 8) // IP Checksum Offload Enable
+#define IE_RXCSUM_TUOFL   (1 << 9) // TCP/UDP Checksum Offload Enable
+
 #define IE_TCTL_RESERVED  ((1 << 2) | (1 << 23) | (0xf << 25) | (1 << 31))
 #define IE_TCTL_RST       (1 << 0) // TX Reset?
 #define IE_TCTL_EN        (1 << 1) // TX Enable
@@ -142,6 +146,7 @@ typedef struct ie_rxd {
 #define IE_RXD_PIF     (1ULL << 39) // Passed Inexact Filter
 #define IE_RXD_IPCS    (1ULL << 38) // IP Checksum Calculated
 #define IE_RXD_TCPCS   (1ULL << 37) // TCP Checksum Calculated
+#define IE_RXD_UDPCS   (1ULL << 36) // UDP Checksum Calculated
 #define IE_RXD_VP      (1ULL << 35) // 802.1Q / Matched VET
 #define IE_RXD_IXSM    (1ULL << 34) // Ignore IPCS and TCPCS bits
 #define IE_RXD_EOP     (1ULL << 33) // End of Packet (last desc)
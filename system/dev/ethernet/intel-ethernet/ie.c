@@ -45,11 +45,24 @@ unsigned eth_handle_irq(ethdev_t* eth) {
     return readl(IE_ICR);
 }
 
+void eth_rx_irq_disable(ethdev_t* eth) {
+    writel(IE_INT_RXT0, IE_IMC);
+}
+
+void eth_rx_irq_enable(ethdev_t* eth) {
+    writel(IE_INT_RXT0, IE_IMS);
+}
+
+void eth_set_irq_rate(ethdev_t* eth, uint32_t rate) {
+    // the interval is in units of 256ns
+    writel(rate ? 1000000000u / (rate * 256u) : 0, IE_ITR);
+}
+
 bool eth_status_online(ethdev_t* eth) {
     return readl(IE_STATUS) & IE_STATUS_LU;
 }
 
-status_t eth_rx(ethdev_t* eth, void** data, size_t* len) {
+status_t eth_rx(ethdev_t* eth, void** data, size_t* len, bool* csum_ok) {
     uint32_t n = eth->rx_rd_ptr;
     uint64_t info = eth->rxd[n].info;
 
@@ -62,6 +75,7 @@ status_t eth_rx(ethdev_t* eth, void** data, size_t* len) {
 
     *data = eth->rxb + ETH_RXBUF_SIZE * n;
     *len = r;
+    *csum_ok = !(info & (IE_RXD_IXSM | IE_RXD_TCPE)) && (info & (IE_RXD_TCPCS | IE_RXD_UDPCS));
 
     return ZX_OK;
 }
@@ -105,16 +119,21 @@ static void reap_tx_buffers(ethdev_t* eth) {
     eth->tx_rd_ptr = n;
 }
 
-status_t eth_tx(ethdev_t* eth, const void* data, size_t len) {
-    if ((len < 60) || (len > ETH_TXBUF_DSIZE)) {
-        printf("intel-eth: unsupported packet length %zu\n", len);
-        return ZX_ERR_INVALID_ARGS;
-    }
-
+status_t eth_tx(ethdev_t* eth, const void* data, size_t len, size_t css, size_t cso, bool more) {
     zx_status_t status = ZX_OK;
 
     mtx_lock(&eth->send_lock);
 
+    if ((len < 60) || (len > ETH_TXBUF_DSIZE)) {
+        printf("intel-eth: unsupported packet length %zu\n", len);
+        status = ZX_ERR_INVALID_ARGS;
+        goto out;
+    }
+    if ((css > 0xff) || (cso > 0xff)) {
+        status = ZX_ERR_NOT_SUPPORTED;
+        goto out;
+    }
+
     reap_tx_buffers(eth);
 
     // obtain buffer, copy into it, setup descriptor
@@ -128,14 +147,20 @@ status_t eth_tx(ethdev_t* eth, const void* data, size_t len) {
     memcpy(frame->data, data, len);
     eth->txd[n].addr = frame->phys;
     eth->txd[n].info = IE_TXD_LEN(len) | IE_TXD_EOP | IE_TXD_IFCS | IE_TXD_RS;
+    if (cso != 0) {
+        eth->txd[n].info |= IE_TXD_IC | IE_TXD_CSS(css) | IE_TXD_CSO(cso);
+    }
     list_add_tail(&eth->busy_frames, &frame->node);
 
-    // inform hw of buffer availability
     n = (n + 1) & (ETH_TXBUF_COUNT - 1);
     eth->tx_wr_ptr = n;
-    writel(n, IE_TDT);
 
 out:
+    // inform hw of buffer availability, at the end of a batch or when
+    // this frame failed and the batch may never be finished
+    if (!more || (status != ZX_OK)) {
+        writel(eth->tx_wr_ptr, IE_TDT);
+    }
     mtx_unlock(&eth->send_lock);
     return status;
 }
@@ -290,7 +315,7 @@ void eth_init_hw(ethdev_t* eth) {
 
     // setup rx ring
     eth->rx_rd_ptr = 0;
-    writel(0, IE_RXCSUM);
+    writel(IE_RXCSUM_TUOFL, IE_RXCSUM);
     writel((4 << 0) | (1 << 8) | (1 << 16) | (1 << 24), IE_RXDCTL);
     writel(eth->rxd_phys, IE_RDBAL);
     writel(eth->rxd_phys >> 32, IE_RDBAH);
@@ -68,12 +68,17 @@ void eth_init_hw(ethdev_t* eth);
 
 void eth_dump_regs(ethdev_t* eth);
 
-status_t eth_rx(ethdev_t* eth, void** data, size_t* len);
+// |csum_ok| is set if the hardware verified the frame's TCP/UDP checksum.
+status_t eth_rx(ethdev_t* eth, void** data, size_t* len, bool* csum_ok);
 void eth_rx_ack(ethdev_t* eth);
 void eth_enable_rx(ethdev_t* eth);
 void eth_disable_rx(ethdev_t* eth);
 
-status_t eth_tx(ethdev_t* eth, const void* data, size_t len);
+// With |more|, the hardware is not told about the frame until a later
+// call without it, so a batch of frames costs one tail register write.
+// A nonzero |cso| has the hardware store the checksum of the bytes from
+// |css| to the end of the frame at offset |cso|; both must be below 256.
+status_t eth_tx(ethdev_t* eth, const void* data, size_t len, size_t css, size_t cso, bool more);
 size_t eth_tx_queued(ethdev_t* eth);
 void eth_enable_tx(ethdev_t* eth);
 void eth_disable_tx(ethdev_t* eth);
@@ -89,3 +94,10 @@ bool eth_status_online(ethdev_t* eth);
 #define ETH_IRQ_RX IE_INT_RXT0
 #define ETH_IRQ_LSC IE_INT_LSC
 unsigned eth_handle_irq(ethdev_t* eth);
+
+// Mask and unmask the rx interrupt, for polling the rx ring.
+void eth_rx_irq_disable(ethdev_t* eth);
+void eth_rx_irq_enable(ethdev_t* eth);
+
+// Limit interrupts to |rate| per second; 0 removes the limit.
+void eth_set_irq_rate(ethdev_t* eth, uint32_t rate);
@@ -52,6 +52,7 @@ typedef struct ethernet_device {
     eth_desc_t* txd_ring;
     uint64_t txd_phys_addr;
     int txd_idx;
+    bool tx_pending;  // descriptors queued since the last doorbell
     void* txb;
 
     eth_desc_t* rxd_ring;
@@ -244,15 +245,27 @@ static zx_status_t rtl8111_start(void* ctx, ethmac_ifc_t* ifc, void* cookie) {
 
 static zx_status_t rtl8111_queue_tx(void* ctx, uint32_t options, ethmac_netbuf_t* netbuf) {
     size_t length = netbuf->len;
+    ethernet_device_t* edev = ctx;
+
+    mtx_lock(&edev->tx_lock);
+
     if (length > ETH_BUF_SIZE) {
         zxlogf(ERROR, "rtl8111: Unsupported packet length %zu\n", length);
+        // don't strand the rest of the batch
+        if (edev->tx_pending) {
+            writeb(RTL_TPPOLL, readb(RTL_TPPOLL) | RTL_TPPOLL_NPQ);
+            edev->tx_pending = false;
+        }
+        mtx_unlock(&edev->tx_lock);
         return ZX_ERR_INVALID_ARGS;
     }
-    ethernet_device_t* edev = ctx;
-
-    mtx_lock(&edev->tx_lock);
 
     if (edev->txd_ring[edev->txd_idx].status1 & TX_DESC_OWN) {
+        // the ring is full; make sure the hardware knows about all of it
+        if (edev->tx_pending) {
+            writeb(RTL_TPPOLL, readb(RTL_TPPOLL) | RTL_TPPOLL_NPQ);
+            edev->tx_pending = false;
+        }
         mtx_lock(&edev->lock);
         writew(RTL_IMR, readw(RTL_IMR) | RTL_INT_TOK);
         writew(RTL_ISR, RTL_INT_TOK);
@@ -272,7 +285,13 @@ static zx_status_t rtl8111_queue_tx(void* ctx, uint32_t options, ethmac_netbuf_t
     edev->txd_ring[edev->txd_idx].status1 =
         (is_end ? TX_DESC_EOR : 0) | length | TX_DESC_OWN | TX_DESC_FS | TX_DESC_LS;
 
-    writeb(RTL_TPPOLL, readb(RTL_TPPOLL) | RTL_TPPOLL_NPQ);
+    // ring the doorbell once per batch
+    if (options & ETHMAC_TX_OPT_MORE) {
+        edev->tx_pending = true;
+    } else {
+        writeb(RTL_TPPOLL, readb(RTL_TPPOLL) | RTL_TPPOLL_NPQ);
+        edev->tx_pending = false;
+    }
 
     edev->txd_idx = (edev->txd_idx + 1) % ETH_BUF_COUNT;
 
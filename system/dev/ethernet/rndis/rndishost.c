@@ -20,9 +20,10 @@
 #include <string.h>
 #include <threads.h>
 
-#define READ_REQ_COUNT 8
-#define WRITE_REQ_COUNT 4
+#define READ_REQ_COUNT 16
+#define WRITE_REQ_COUNT 8
 #define ETH_HEADER_SIZE 4
+#define ETH_MTU 1500
 
 typedef struct {
     zx_device_t* zxdev;
@@ -42,6 +43,20 @@ typedef struct {
     list_node_t free_write_reqs;
     list_node_t free_intr_reqs;
 
+    // Limits on packing several packet messages into one bulk transfer, as reported by the
+    // device in its initialization reply.
+    uint32_t tx_max_packets;
+    uint32_t tx_max_xfer_size;
+    uint32_t tx_alignment;
+
+    // Write request currently being filled, held back while more frames are on their way, and
+    // the number of packet messages it holds.
+    usb_request_t* tx_req;
+    uint32_t tx_req_packets;
+
+    // Netbufs waiting for a free write request.
+    list_node_t pending_netbufs;
+
     // Interface to the ethernet layer.
     ethmac_ifc_t* ifc;
     void* cookie;
@@ -105,6 +120,68 @@ static zx_status_t rndis_command(rndishost_t* eth, void* buf) {
     return status;
 }
 
+// Deliver every packet message in a received bulk transfer to the ethernet layer.
+static void rndis_recv(rndishost_t* eth, uint8_t* data, size_t len) {
+    while (len >= sizeof(rndis_packet_header)) {
+        rndis_packet_header* header = (rndis_packet_header*)data;
+        if (header->msg_type != RNDIS_PACKET_MSG || header->msg_length < sizeof(*header) ||
+            header->msg_length > len) {
+            zxlogf(TRACE, "rndishost: dropping malformed transfer (type %x, length %u)\n",
+                   header->msg_type, header->msg_length);
+            return;
+        }
+        // The offset is given from the beginning of the data_offset field.
+        size_t offset = 8 + (size_t)header->data_offset;
+        if (offset > header->msg_length || header->data_length > header->msg_length - offset) {
+            zxlogf(TRACE, "rndishost: dropping packet with bad data offset %u\n",
+                   header->data_offset);
+            return;
+        }
+        eth->ifc->recv(eth->cookie, data + offset, header->data_length, 0);
+        data += header->msg_length;
+        len -= header->msg_length;
+    }
+}
+
+// Append a netbuf to the packet messages already in a write request. Every message is padded
+// to the alignment the device asked for so the next one starts on a boundary.
+static zx_status_t rndis_append_to_tx_req(rndishost_t* eth, usb_request_t* req, uint32_t* packets,
+                                          ethmac_netbuf_t* netbuf) {
+    static const uint8_t padding[1 << RNDIS_MAX_PACKET_ALIGNMENT];
+    size_t length = netbuf->len;
+    size_t msg_length = sizeof(rndis_packet_header) + length;
+    size_t pad = (eth->tx_alignment - (msg_length % eth->tx_alignment)) % eth->tx_alignment;
+
+    if (msg_length > eth->tx_max_xfer_size) {
+        zxlogf(ERROR, "rndishost: unsupported packet length %zu\n", length);
+        return ZX_ERR_INVALID_ARGS;
+    }
+    zx_off_t offset = req->header.length;
+    if (*packets >= eth->tx_max_packets || offset + msg_length > eth->tx_max_xfer_size) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+    if (offset + msg_length + pad > eth->tx_max_xfer_size) {
+        // The last message in a transfer does not need trailing padding.
+        pad = 0;
+    }
+
+    rndis_packet_header header;
+    memset(&header, 0, sizeof(header));
+    header.msg_type = RNDIS_PACKET_MSG;
+    header.msg_length = msg_length + pad;
+    // The offset should be given from the beginning of the data_offset field.
+    // So subtract 8 bytes for msg_type and msg_length.
+    header.data_offset = sizeof(rndis_packet_header) - 8;
+    header.data_length = length;
+
+    usb_request_copyto(req, &header, sizeof(header), offset);
+    usb_request_copyto(req, netbuf->data, length, offset + sizeof(header));
+    usb_request_copyto(req, padding, pad, offset + msg_length);
+    req->header.length = offset + msg_length + pad;
+    (*packets)++;
+    return ZX_OK;
+}
+
 static void rndis_read_complete(usb_request_t* request, void* cookie) {
     zxlogf(TRACE, "rndis_read_complete\n");
     rndishost_t* eth = (rndishost_t*)cookie;
@@ -126,7 +203,7 @@ static void rndis_read_complete(usb_request_t* request, void* cookie) {
             return;
         }
 
-        eth->ifc->recv(eth->cookie, read_data, len, 0);
+        rndis_recv(eth, read_data, len);
     }
 
     // TODO: Only usb_request_queue if the device is online.
@@ -149,7 +226,26 @@ static void rndis_write_complete(usb_request_t* request, void* cookie) {
         zxlogf(TRACE, "rndishost usb_reset_endpoint\n");
         usb_reset_endpoint(&eth->usb, eth->bulk_in_addr);
     }
-    list_add_tail(&eth->free_write_reqs, &request->node);
+
+    // Pack as many waiting netbufs as will fit into the request we just got back
+    request->header.length = 0;
+    uint32_t packets = 0;
+    ethmac_netbuf_t* netbuf;
+    while ((netbuf = list_peek_head_type(&eth->pending_netbufs, ethmac_netbuf_t, node)) != NULL) {
+        zx_status_t status = rndis_append_to_tx_req(eth, request, &packets, netbuf);
+        if (status == ZX_ERR_BUFFER_TOO_SMALL) {
+            break;
+        }
+        list_delete(&netbuf->node);
+        if (eth->ifc) {
+            eth->ifc->complete_tx(eth->cookie, netbuf, status);
+        }
+    }
+    if (request->header.length > 0) {
+        usb_request_queue(&eth->usb, request);
+    } else {
+        list_add_tail(&eth->free_write_reqs, &request->node);
+    }
     mtx_unlock(&eth->mutex);
 }
 
@@ -164,6 +260,9 @@ static void rndishost_free(rndishost_t* eth) {
     while ((txn = list_remove_head_type(&eth->free_intr_reqs, usb_request_t, node)) != NULL) {
         usb_request_release(txn);
     }
+    if (eth->tx_req) {
+        usb_request_release(eth->tx_req);
+    }
     free(eth);
 }
 
@@ -209,41 +308,47 @@ static zx_status_t rndishost_start(void* ctx, ethmac_ifc_t* ifc, void* cookie) {
 }
 
 static zx_status_t rndishost_queue_tx(void* ctx, uint32_t options, ethmac_netbuf_t* netbuf) {
-    size_t length = netbuf->len;
     rndishost_t* eth = (rndishost_t*)ctx;
-    uint8_t* byte_data = netbuf->data;
     zx_status_t status = ZX_OK;
 
     mtx_lock(&eth->mutex);
 
-    usb_request_t* req = list_remove_head_type(&eth->free_write_reqs, usb_request_t, node);
-    if (req == NULL) {
-        zxlogf(DEBUG1, "dropped a packet.\n");
-        status = ZX_ERR_NO_RESOURCES;
-        goto done;
+    if (!list_is_empty(&eth->pending_netbufs)) {
+        // Keep frames in order behind the ones already waiting for a request
+        goto pending;
     }
 
-    // TODO: Check that length + header <= MTU
+    if (eth->tx_req == NULL) {
+        eth->tx_req = list_remove_head_type(&eth->free_write_reqs, usb_request_t, node);
+        if (eth->tx_req == NULL) {
+            goto pending;
+        }
+        eth->tx_req->header.length = 0;
+        eth->tx_req_packets = 0;
+    }
 
-    rndis_packet_header header;
-    uint8_t* header_data = (uint8_t*)&header;
-    memset(header_data, 0, sizeof(rndis_packet_header));
-    header.msg_type = RNDIS_PACKET_MSG;
-    header.msg_length = sizeof(rndis_packet_header) + length;
-    // The offset should be given from the beginning of the data_offset field.
-    // So subtract 8 bytes for msg_type and msg_length.
-    header.data_offset = sizeof(rndis_packet_header) - 8;
-    header.data_length = length;
+    status = rndis_append_to_tx_req(eth, eth->tx_req, &eth->tx_req_packets, netbuf);
+    if (status == ZX_ERR_BUFFER_TOO_SMALL) {
+        // The current request is full, send it and start packing another one
+        usb_request_queue(&eth->usb, eth->tx_req);
+        eth->tx_req = list_remove_head_type(&eth->free_write_reqs, usb_request_t, node);
+        if (eth->tx_req == NULL) {
+            goto pending;
+        }
+        eth->tx_req->header.length = 0;
+        eth->tx_req_packets = 0;
+        status = rndis_append_to_tx_req(eth, eth->tx_req, &eth->tx_req_packets, netbuf);
+    }
 
-    usb_request_copyto(req, header_data, sizeof(rndis_packet_header), 0);
-    ssize_t bytes_copied = usb_request_copyto(req, byte_data, length, sizeof(rndis_packet_header));
-    req->header.length = sizeof(rndis_packet_header) + length;
-    if (bytes_copied < 0) {
-        printf("rndishost: failed to copy data into send txn (error %zd)\n", bytes_copied);
-        list_add_tail(&eth->free_write_reqs, &req->node);
-        goto done;
+    if (!(options & ETHMAC_TX_OPT_MORE) && eth->tx_req->header.length > 0) {
+        usb_request_queue(&eth->usb, eth->tx_req);
+        eth->tx_req = NULL;
     }
-    usb_request_queue(&eth->usb, req);
+    goto done;
+
+pending:
+    list_add_tail(&eth->pending_netbufs, &netbuf->node);
+    status = ZX_ERR_SHOULD_WAIT;
 
 done:
     mtx_unlock(&eth->mutex);
@@ -297,14 +402,28 @@ static int rndis_start_thread(void* arg) {
         goto fail;
     }
 
-    // TODO: Save important fields of init_cmplt.
     rndis_init_complete* init_cmplt = buf;
     if (!command_succeeded(buf, RNDIS_INITIALIZE_CMPLT, sizeof(*init_cmplt))) {
         zxlogf(DEBUG1, "rndishost initialization failed.\n");
         status = ZX_ERR_IO;
         goto fail;
     }
-    eth->mtu = init_cmplt->max_xfer_size;
+    eth->mtu = ETH_MTU;
+
+    // Pack as many packet messages per transfer as the device accepts. max_xfer_size is the
+    // largest transfer the device will take from us, not a frame size.
+    mtx_lock(&eth->mutex);
+    if (init_cmplt->max_packers_per_xfer > 0 &&
+        init_cmplt->packet_alignment <= RNDIS_MAX_PACKET_ALIGNMENT) {
+        eth->tx_max_packets = init_cmplt->max_packers_per_xfer;
+        eth->tx_alignment = 1u << init_cmplt->packet_alignment;
+    }
+    if (init_cmplt->max_xfer_size > 0 && init_cmplt->max_xfer_size < eth->tx_max_xfer_size) {
+        eth->tx_max_xfer_size = init_cmplt->max_xfer_size;
+    }
+    mtx_unlock(&eth->mutex);
+    zxlogf(TRACE, "rndishost: up to %u packets per %u byte transfer, %u byte alignment\n",
+           eth->tx_max_packets, eth->tx_max_xfer_size, eth->tx_alignment);
 
     // Check the PHY, this is optional and may not be supported by the device.
     uint32_t* phy;
@@ -380,6 +499,15 @@ static int rndis_start_thread(void* arg) {
     }
 
     free(buf);
+
+    // Data transfers are enabled, start receiving.
+    mtx_lock(&eth->mutex);
+    usb_request_t* req;
+    while ((req = list_remove_head_type(&eth->free_read_reqs, usb_request_t, node)) != NULL) {
+        usb_request_queue(&eth->usb, req);
+    }
+    mtx_unlock(&eth->mutex);
+
     device_make_visible(eth->zxdev);
     return ZX_OK;
 
@@ -469,6 +597,12 @@ static zx_status_t rndishost_bind(void* ctx, zx_device_t* device) {
     list_initialize(&eth->free_read_reqs);
     list_initialize(&eth->free_write_reqs);
     list_initialize(&eth->free_intr_reqs);
+    list_initialize(&eth->pending_netbufs);
+
+    // Until the device tells us otherwise, send one packet message per transfer.
+    eth->tx_max_packets = 1;
+    eth->tx_max_xfer_size = RNDIS_MAX_XFER_SIZE;
+    eth->tx_alignment = 1;
 
     mtx_init(&eth->mutex, mtx_plain);
 
@@ -482,7 +616,7 @@ static zx_status_t rndishost_bind(void* ctx, zx_device_t* device) {
 
     for (int i = 0; i < READ_REQ_COUNT; i++) {
         usb_request_t* req;
-        zx_status_t alloc_result = usb_request_alloc(&req, RNDIS_BUFFER_SIZE, bulk_in_addr);
+        zx_status_t alloc_result = usb_request_alloc(&req, RNDIS_MAX_XFER_SIZE, bulk_in_addr);
         if (alloc_result != ZX_OK) {
             status = alloc_result;
             goto fail;
@@ -493,8 +627,7 @@ static zx_status_t rndishost_bind(void* ctx, zx_device_t* device) {
     }
     for (int i = 0; i < WRITE_REQ_COUNT; i++) {
         usb_request_t* req;
-        // TODO: Allocate based on mtu.
-        zx_status_t alloc_result = usb_request_alloc(&req, RNDIS_BUFFER_SIZE, bulk_out_addr);
+        zx_status_t alloc_result = usb_request_alloc(&req, RNDIS_MAX_XFER_SIZE, bulk_out_addr);
         if (alloc_result != ZX_OK) {
             status = alloc_result;
             goto fail;
@@ -16,6 +16,7 @@
 #define RNDIS_MAJOR_VERSION             0x00000001
 #define RNDIS_MINOR_VERSION             0x00000000
 #define RNDIS_MAX_XFER_SIZE             0x00004000
+#define RNDIS_MAX_PACKET_ALIGNMENT      6 // log2 of the largest packet alignment honored
 
 // Messages
 #define RNDIS_PACKET_MSG                0x00000001
@@ -20,9 +20,11 @@
 
 #define CDC_SUPPORTED_VERSION 0x0110 /* 1.10 */
 
-// The maximum amount of memory we are willing to allocate to transaction buffers
-#define MAX_TX_BUF_SZ 32768
-#define MAX_RX_BUF_SZ 32768
+// The maximum amount of memory we are willing to allocate to transaction buffers. CDC-ECM
+// carries exactly one ethernet frame per bulk transfer, so throughput depends on keeping
+// enough transfers in flight rather than on packing frames together.
+#define MAX_TX_BUF_SZ 65536
+#define MAX_RX_BUF_SZ 65536
 
 const char* module_name = "usb-cdc-ecm";
 
@@ -226,7 +228,7 @@ static zx_status_t send_locked(ecm_ctx_t* ctx, ethmac_netbuf_t* netbuf) {
         return status;
     }
 
-    if (send_terminal_packet && (status = queue_request(ctx, byte_data, 0, tx_req)) != ZX_OK) {
+    if (send_terminal_packet && (status = queue_request(ctx, byte_data, 0, terminal_req)) != ZX_OK) {
         // This leaves us in a very awkward situation, since failing to send the zero-length
         // packet means the ethernet packet will be improperly terminated.
         list_add_tail(&ctx->tx_txn_bufs, &terminal_req->node);
@@ -11,8 +11,10 @@
 #include <ddk/protocol/hidbus.h>
 #include <zircon/device/input.h>
 
+#include <sync/completion.h>
 #include <zircon/assert.h>
 #include <zircon/listnode.h>
+#include <zircon/syscalls.h>
 
 #include <assert.h>
 #include <stdlib.h>
@@ -70,6 +72,14 @@ typedef struct hid_device {
     struct list_node instance_list;
     mtx_t instance_lock;
 
+    // Started the first time an instance asks for a maximum delivery rate.
+    // Asserts DEV_STATE_READABLE on instances whose signalling was deferred
+    // by their rate limit.
+    thrd_t notify_thread;
+    bool notify_thread_started;
+    bool notify_shutdown;
+    completion_t notify_completion;
+
     char name[ZX_DEVICE_NAME_MAX + 1];
 } hid_device_t;
 
@@ -79,8 +89,17 @@ typedef struct hid_instance {
 
     uint32_t flags;
 
+    // Each report in the fifo is followed by the zx_time_t at which it arrived.
     zx_hid_fifo_t fifo;
 
+    // Delivery state, guarded by fifo.lock.
+    bool batch;
+    bool readable;
+    bool signal_pending;
+    zx_duration_t min_interval;
+    zx_time_t last_signal;
+    input_stats_t stats;
+
     struct list_node node;
 } hid_instance_t;
 
@@ -266,6 +285,28 @@ static zx_status_t hid_set_report(hid_device_t* hid, const void* in_buf, size_t
 }
 
 
+// Asserts DEV_STATE_READABLE on |inst| unless its maximum delivery rate says
+// it was signalled too recently, in which case the notify thread will do so
+// once the interval has passed.  Must be called with inst->fifo.lock held.
+static void hid_instance_signal_locked(hid_instance_t* inst, zx_time_t now) {
+    if (inst->readable) {
+        return;
+    }
+
+    if (inst->min_interval && (now < inst->last_signal + inst->min_interval)) {
+        if (!inst->signal_pending) {
+            inst->signal_pending = true;
+            completion_signal(&inst->base->notify_completion);
+        }
+        return;
+    }
+
+    inst->readable = true;
+    inst->signal_pending = false;
+    inst->last_signal = now;
+    device_state_set(inst->zxdev, DEV_STATE_READABLE);
+}
+
 static zx_status_t hid_read_instance(void* ctx, void* buf, size_t count, zx_off_t off,
                                      size_t* actual) {
     hid_instance_t* hid = ctx;
@@ -274,43 +315,138 @@ static zx_status_t hid_read_instance(void* ctx, void* buf, size_t count, zx_off_
         return ZX_ERR_PEER_CLOSED;
     }
 
-    size_t left;
+    // In batch mode, hand back as many complete reports as fit, each with a
+    // header carrying its size and arrival time.  Otherwise return exactly
+    // one report.
+    uint8_t* out = buf;
+    size_t hdr_size = hid->batch ? sizeof(input_report_hdr_t) : 0;
+    size_t total = 0;
+    zx_status_t status = ZX_OK;
+
     mtx_lock(&hid->fifo.lock);
-    size_t xfer;
     uint8_t rpt_id;
-    ssize_t r = zx_hid_fifo_peek(&hid->fifo, &rpt_id);
-    if (r < 1) {
-        // fifo is empty
-        mtx_unlock(&hid->fifo.lock);
-        return ZX_ERR_SHOULD_WAIT;
-    }
+    while (zx_hid_fifo_peek(&hid->fifo, &rpt_id) > 0) {
+        size_t xfer = hid_get_report_size_by_id(hid->base, rpt_id, INPUT_REPORT_INPUT);
+        if (xfer == 0) {
+            zxlogf(ERROR, "error reading hid device: unknown report id (%u)!\n", rpt_id);
+            status = ZX_ERR_BAD_STATE;
+            break;
+        }
 
-    xfer = hid_get_report_size_by_id(hid->base, rpt_id, INPUT_REPORT_INPUT);
-    if (xfer == 0) {
-        zxlogf(ERROR, "error reading hid device: unknown report id (%u)!\n", rpt_id);
-        mtx_unlock(&hid->fifo.lock);
-        return ZX_ERR_BAD_STATE;
-    }
+        if (hdr_size + xfer > count - total) {
+            if (total == 0) {
+                zxlogf(SPEW, "next report: %zd, read count: %zd\n", xfer, count);
+                status = ZX_ERR_BUFFER_TOO_SMALL;
+            }
+            break;
+        }
+
+        zx_time_t timestamp;
+        zx_hid_fifo_read(&hid->fifo, out + total + hdr_size, xfer);
+        zx_hid_fifo_read(&hid->fifo, &timestamp, sizeof(timestamp));
+        if (hid->batch) {
+            input_report_hdr_t hdr = {
+                .timestamp = timestamp,
+                .size = (uint32_t)xfer,
+            };
+            memcpy(out + total, &hdr, sizeof(hdr));
+        }
+        total += hdr_size + xfer;
 
-    if (xfer > count) {
-        zxlogf(SPEW, "next report: %zd, read count: %zd\n", xfer, count);
-        mtx_unlock(&hid->fifo.lock);
-        return ZX_ERR_BUFFER_TOO_SMALL;
+        if (!hid->batch) {
+            break;
+        }
     }
 
-    r = zx_hid_fifo_read(&hid->fifo, buf, xfer);
-    left = zx_hid_fifo_size(&hid->fifo);
-    if (left == 0) {
+    if (zx_hid_fifo_size(&hid->fifo) == 0) {
+        hid->readable = false;
+        hid->signal_pending = false;
         device_state_clr(hid->zxdev, DEV_STATE_READABLE);
     }
+    if (total > 0) {
+        hid->stats.reads++;
+    }
     mtx_unlock(&hid->fifo.lock);
-    if (r > 0) {
-        *actual = r;
-        r = ZX_OK;
-    } else if (r == 0) {
-        r = ZX_ERR_SHOULD_WAIT;
+
+    if (total > 0) {
+        *actual = total;
+        return ZX_OK;
+    }
+    return (status != ZX_OK) ? status : ZX_ERR_SHOULD_WAIT;
+}
+
+static int hid_notify_thread(void* arg) {
+    hid_device_t* hid = arg;
+
+    mtx_lock(&hid->instance_lock);
+    while (!hid->notify_shutdown) {
+        zx_time_t now = zx_time_get(ZX_CLOCK_MONOTONIC);
+        zx_time_t next = ZX_TIME_INFINITE;
+
+        hid_instance_t* instance;
+        foreach_instance(hid, instance) {
+            mtx_lock(&instance->fifo.lock);
+            if (instance->signal_pending) {
+                hid_instance_signal_locked(instance, now);
+                if (instance->signal_pending) {
+                    next = MIN(next, instance->last_signal + instance->min_interval);
+                }
+            }
+            mtx_unlock(&instance->fifo.lock);
+        }
+
+        // Wakeups are only ever requested with the instance lock held, so
+        // resetting here cannot lose one.
+        completion_reset(&hid->notify_completion);
+        mtx_unlock(&hid->instance_lock);
+        completion_wait(&hid->notify_completion,
+                        (next == ZX_TIME_INFINITE) ? ZX_TIME_INFINITE : next - now);
+        mtx_lock(&hid->instance_lock);
     }
-    return r;
+    mtx_unlock(&hid->instance_lock);
+
+    return 0;
+}
+
+static zx_status_t hid_set_delivery(hid_instance_t* hid, const void* in_buf, size_t in_len) {
+    if (in_len < sizeof(input_delivery_t)) return ZX_ERR_INVALID_ARGS;
+    const input_delivery_t* cfg = in_buf;
+    if (cfg->flags & ~INPUT_DELIVERY_BATCH) return ZX_ERR_INVALID_ARGS;
+
+    hid_device_t* base = hid->base;
+    mtx_lock(&base->instance_lock);
+    if (cfg->max_rate_hz && !base->notify_thread_started) {
+        int ret = thrd_create_with_name(&base->notify_thread, hid_notify_thread, base,
+                                        "hid-notify");
+        if (ret != thrd_success) {
+            mtx_unlock(&base->instance_lock);
+            return ZX_ERR_NO_RESOURCES;
+        }
+        base->notify_thread_started = true;
+    }
+
+    mtx_lock(&hid->fifo.lock);
+    hid->batch = (cfg->flags & INPUT_DELIVERY_BATCH) != 0;
+    hid->min_interval = cfg->max_rate_hz ? ZX_SEC(1) / cfg->max_rate_hz : 0;
+    if (hid->signal_pending) {
+        // The deadline moved; let the notify thread recompute it.
+        completion_signal(&base->notify_completion);
+    }
+    mtx_unlock(&hid->fifo.lock);
+    mtx_unlock(&base->instance_lock);
+
+    return ZX_OK;
+}
+
+static zx_status_t hid_get_stats(hid_instance_t* hid, void* out_buf, size_t out_len,
+                                 size_t* out_actual) {
+    if (out_len < sizeof(input_stats_t)) return ZX_ERR_INVALID_ARGS;
+
+    mtx_lock(&hid->fifo.lock);
+    memcpy(out_buf, &hid->stats, sizeof(input_stats_t));
+    mtx_unlock(&hid->fifo.lock);
+    *out_actual = sizeof(input_stats_t);
+    return ZX_OK;
 }
 
 static zx_status_t hid_ioctl_instance(void* ctx, uint32_t op,
@@ -337,6 +473,10 @@ static zx_status_t hid_ioctl_instance(void* ctx, uint32_t op,
         return hid_get_report(hid->base, in_buf, in_len, out_buf, out_len, out_actual);
     case IOCTL_INPUT_SET_REPORT:
         return hid_set_report(hid->base, in_buf, in_len);
+    case IOCTL_INPUT_SET_DELIVERY:
+        return hid_set_delivery(hid, in_buf, in_len);
+    case IOCTL_INPUT_GET_STATS:
+        return hid_get_stats(hid, out_buf, out_len, out_actual);
     }
     return ZX_ERR_NOT_SUPPORTED;
 }
@@ -667,6 +807,14 @@ static zx_status_t hid_init_reassembly_buffer(hid_device_t* dev) {
 static void hid_release_device(void* ctx) {
     hid_device_t* hid = ctx;
 
+    if (hid->notify_thread_started) {
+        mtx_lock(&hid->instance_lock);
+        hid->notify_shutdown = true;
+        completion_signal(&hid->notify_completion);
+        mtx_unlock(&hid->instance_lock);
+        thrd_join(hid->notify_thread, NULL);
+    }
+
     if (hid->hid_report_desc) {
         free(hid->hid_report_desc);
         hid->hid_report_desc = NULL;
@@ -732,6 +880,8 @@ zx_protocol_device_t hid_device_proto = {
 void hid_io_queue(void* cookie, const uint8_t* buf, size_t len) {
     hid_device_t* hid = cookie;
 
+    zx_time_t now = zx_time_get(ZX_CLOCK_MONOTONIC);
+
     mtx_lock(&hid->instance_lock);
 
     while (len) {
@@ -803,20 +953,20 @@ void hid_io_queue(void* cookie, const uint8_t* buf, size_t len) {
         hid_instance_t* instance;
         foreach_instance(hid, instance) {
             mtx_lock(&instance->fifo.lock);
-            bool was_empty = zx_hid_fifo_size(&instance->fifo) == 0;
-            ssize_t wrote = zx_hid_fifo_write(&instance->fifo, rbuf, rlen);
+            size_t avail = HID_FIFO_SIZE - zx_hid_fifo_size(&instance->fifo);
 
-            if (wrote <= 0) {
+            if (avail < rlen + sizeof(now)) {
+                instance->stats.reports_dropped++;
                 if (!(instance->flags & HID_FLAGS_WRITE_FAILED)) {
-                    zxlogf(ERROR, "%s: could not write to hid fifo (ret=%zd)\n",
-                            hid->name, wrote);
+                    zxlogf(ERROR, "%s: hid fifo full, dropping reports\n", hid->name);
                     instance->flags |= HID_FLAGS_WRITE_FAILED;
                 }
             } else {
+                zx_hid_fifo_write(&instance->fifo, rbuf, rlen);
+                zx_hid_fifo_write(&instance->fifo, &now, sizeof(now));
+                instance->stats.reports_queued++;
                 instance->flags &= ~HID_FLAGS_WRITE_FAILED;
-                if (was_empty) {
-                    device_state_set(instance->zxdev, DEV_STATE_READABLE);
-                }
+                hid_instance_signal_locked(instance, now);
             }
             mtx_unlock(&instance->fifo.lock);
         }
@@ -12,7 +12,7 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/hid-fifo.c \
     $(LOCAL_DIR)/hid.c
 
-MODULE_STATIC_LIBS := system/ulib/ddk
+MODULE_STATIC_LIBS := system/ulib/ddk system/ulib/sync
 
 MODULE_LIBS := \
     system/ulib/driver \
@@ -7,6 +7,7 @@
 #include <ddk/driver.h>
 #include <ddk/binding.h>
 #include <ddk/protocol/hidbus.h>
+#include <ddk/protocol/i2c.h>
 
 #include <zircon/assert.h>
 #include <zircon/types.h>
@@ -57,6 +58,15 @@ typedef struct i2c_hid_device {
     bool i2c_pending_reset; // True if reset-in-progress
     thrd_t irq_thread;
     zx_handle_t irq;
+
+    // Set if the slave device can queue transactions. Reports are then read
+    // through |i2c| and handled in the completion callback, rather than by a
+    // blocking device_read() under |i2c_lock|.
+    bool has_i2c;
+    i2c_channel_t i2c;
+    completion_t read_done;
+
+    zx_time_t last_timeout_warning;
 } i2c_hid_device_t;
 
 static uint8_t* i2c_hid_prepare_write_read_buffer(uint8_t* buf, int wlen, int rlen) {
@@ -329,6 +339,67 @@ static int i2c_hid_noirq_thread(void* arg) {
     return 0;
 }
 
+// Handles the result of reading the input register, from the irq thread or
+// from an i2c completion callback.
+static void i2c_hid_handle_report(i2c_hid_device_t* dev, zx_status_t status,
+                                  const uint8_t* buf, size_t actual) {
+    const zx_duration_t kMinTimeBetweenWarnings = ZX_SEC(10);
+
+    if (status != ZX_OK) {
+        if (status == ZX_ERR_TIMED_OUT) {
+            zx_time_t now = zx_time_get(ZX_CLOCK_MONOTONIC);
+            if (now - dev->last_timeout_warning > kMinTimeBetweenWarnings) {
+                zxlogf(TRACE, "i2c-hid: report read timed out\n");
+                dev->last_timeout_warning = now;
+            }
+            return;
+        }
+        zxlogf(ERROR, "i2c-hid: report read failure %d\n", status);
+        return;
+    }
+    if (actual < 2) {
+        zxlogf(ERROR, "i2c-hid: short read (%zd < 2)!!!\n", actual);
+        return;
+    }
+
+    uint16_t report_len = letoh16(*(uint16_t*)buf);
+
+    mtx_lock(&dev->i2c_lock);
+    if (report_len == 0x0) {
+        zxlogf(INFO, "i2c-hid reset detected\n");
+        // Either host or device reset.
+        dev->i2c_pending_reset = false;
+        cnd_broadcast(&dev->i2c_reset_cnd);
+        mtx_unlock(&dev->i2c_lock);
+        return;
+    }
+    if (dev->i2c_pending_reset) {
+        zxlogf(INFO, "i2c-hid: received event while waiting for reset? %u\n", report_len);
+        mtx_unlock(&dev->i2c_lock);
+        return;
+    }
+    mtx_unlock(&dev->i2c_lock);
+
+    if ((report_len > actual) || (report_len < 2)) {
+        zxlogf(ERROR, "i2c-hid: bad report len (rlen %hu, bytes read %zd)!!!\n",
+                report_len, actual);
+        return;
+    }
+
+    mtx_lock(&dev->ifc_lock);
+    if (dev->ifc) {
+        dev->ifc->io_queue(dev->cookie, buf + 2, report_len - 2);
+    }
+    mtx_unlock(&dev->ifc_lock);
+}
+
+static void i2c_hid_read_complete(zx_status_t status, const uint8_t* data, size_t actual,
+                                  void* cookie) {
+    i2c_hid_device_t* dev = cookie;
+    i2c_hid_handle_report(dev, status, data, actual);
+    completion_signal(&dev->read_done);
+}
+
 static int i2c_hid_irq_thread(void* arg) {
     zxlogf(TRACE, "i2c-hid: using irq\n");
 
@@ -341,10 +412,7 @@ static int i2c_hid_irq_thread(void* arg) {
     }
 
     uint16_t len = letoh16(dev->hiddesc->wMaxInputLength);
-    uint8_t* buf = malloc(len);
-
-    zx_time_t last_timeout_warning = 0;
-    const zx_duration_t kMinTimeBetweenWarnings = ZX_SEC(10);
+    uint8_t* buf = dev->has_i2c ? NULL : malloc(len);
 
     while (true) {
         uint64_t slots;
@@ -354,60 +422,24 @@ static int i2c_hid_irq_thread(void* arg) {
             break;
         }
 
-        mtx_lock(&dev->i2c_lock);
-
-        size_t actual = 0;
-        status = device_read(dev->i2cdev, buf, len, 0, &actual);
-        if (status != ZX_OK) {
-            if (status == ZX_ERR_TIMED_OUT) {
-                zx_time_t now = zx_time_get(ZX_CLOCK_MONOTONIC);
-                if (now - last_timeout_warning > kMinTimeBetweenWarnings) {
-                    zxlogf(TRACE, "i2c-hid: device_read timed out\n");
-                    last_timeout_warning = now;
-                }
-                mtx_unlock(&dev->i2c_lock);
+        if (dev->has_i2c) {
+            // The interrupt is level triggered, so it is not waited on again
+            // until the read has taken the report that raised it.
+            completion_reset(&dev->read_done);
+            status = i2c_transact(&dev->i2c, NULL, 0, len, i2c_hid_read_complete, dev);
+            if (status != ZX_OK) {
+                zxlogf(ERROR, "i2c-hid: could not queue report read %d\n", status);
                 continue;
             }
-            zxlogf(ERROR, "i2c-hid: device_read failure %d\n", status);
-            mtx_unlock(&dev->i2c_lock);
-            continue;
-        }
-        if (actual < 2) {
-            zxlogf(ERROR, "i2c-hid: short read (%zd < 2)!!!\n", actual);
-            mtx_unlock(&dev->i2c_lock);
-            continue;
-        }
-
-        uint16_t report_len = letoh16(*(uint16_t*)buf);
-        if (report_len == 0x0) {
-            zxlogf(INFO, "i2c-hid reset detected\n");
-            // Either host or device reset.
-            dev->i2c_pending_reset = false;
-            cnd_broadcast(&dev->i2c_reset_cnd);
-            mtx_unlock(&dev->i2c_lock);
-            continue;
-        }
-
-        if (dev->i2c_pending_reset) {
-            zxlogf(INFO, "i2c-hid: received event while waiting for reset? %u\n", report_len);
-            mtx_unlock(&dev->i2c_lock);
-            continue;
-        }
-
-        if ((report_len > actual) || (report_len < 2)) {
-            zxlogf(ERROR, "i2c-hid: bad report len (rlen %hu, bytes read %zd)!!!\n",
-                    report_len, actual);
-            mtx_unlock(&dev->i2c_lock);
+            completion_wait(&dev->read_done, ZX_TIME_INFINITE);
             continue;
         }
 
+        size_t actual = 0;
+        mtx_lock(&dev->i2c_lock);
+        status = device_read(dev->i2cdev, buf, len, 0, &actual);
         mtx_unlock(&dev->i2c_lock);
-
-        mtx_lock(&dev->ifc_lock);
-        if (dev->ifc) {
-            dev->ifc->io_queue(dev->cookie, buf + 2, report_len - 2);
-        }
-        mtx_unlock(&dev->ifc_lock);
+        i2c_hid_handle_report(dev, status, buf, actual);
     }
 
     // TODO: figure out how to clean up
@@ -466,6 +498,20 @@ static zx_status_t i2c_hid_bind(void* ctx, zx_device_t* dev) {
         return ZX_ERR_NOT_SUPPORTED;
     }
 
+    // Prefer queued transactions for reading reports, if the slave device
+    // supports them and can read a whole report at once.
+    i2c_protocol_t i2c;
+    if (device_get_protocol(dev, ZX_PROTOCOL_I2C, &i2c) == ZX_OK &&
+        i2c_get_channel(&i2c, 0, &i2chid->i2c) == ZX_OK) {
+        size_t max_transfer = 0;
+        if (i2c_get_max_transfer_size(&i2chid->i2c, &max_transfer) == ZX_OK &&
+            max_transfer >= letoh16(i2chid->hiddesc->wMaxInputLength)) {
+            i2chid->has_i2c = true;
+        } else {
+            i2c_channel_release(&i2chid->i2c);
+        }
+    }
+
     zxlogf(TRACE, "i2c-hid: desc:\n");
     zxlogf(TRACE, "  report desc len: %u\n", letoh16(i2chid->hiddesc->wReportDescLength));
     zxlogf(TRACE, "  report desc reg: %u\n", letoh16(i2chid->hiddesc->wReportDescRegister));
@@ -10,7 +10,7 @@ MODULE_TYPE := driver
 
 MODULE_SRCS := $(LOCAL_DIR)/i2c-hid.c
 
-MODULE_STATIC_LIBS := system/ulib/ddk system/ulib/hid
+MODULE_STATIC_LIBS := system/ulib/ddk system/ulib/hid system/ulib/sync
 
 MODULE_LIBS := system/ulib/driver system/ulib/zircon system/ulib/c
 
@@ -49,14 +49,19 @@ static void fifo_write(uint8_t x) {
 
 static int debug_reader(void* arg) {
     zx_device_t* dev = arg;
-    uint8_t ch;
+    // zx_debug_read() blocks for the first byte and returns whatever else
+    // was already buffered, so a burst of input costs one call.
+    uint8_t buf[64];
     for (;;) {
-        if (zx_debug_read(get_root_resource(), (void*)&ch, 1) == 1) {
+        zx_status_t n = zx_debug_read(get_root_resource(), (void*)buf, sizeof(buf));
+        if (n > 0) {
             mtx_lock(&fifo.lock);
             if (fifo.head == fifo.tail) {
                 device_state_set(dev, DEV_STATE_READABLE);
             }
-            fifo_write(ch);
+            for (zx_status_t i = 0; i < n; i++) {
+                fifo_write(buf[i]);
+            }
             mtx_unlock(&fifo.lock);
         }
     }
@@ -507,6 +507,8 @@ static zx_status_t ipm_stage_fixed_config(const cpuperf_config_t* icfg,
         ocfg->fixed_flags[ss->num_fixed] |= IPM_CONFIG_FLAG_TIMEBASE;
     if (icfg->flags[ii] & CPUPERF_CONFIG_FLAG_PC)
         ocfg->fixed_flags[ss->num_fixed] |= IPM_CONFIG_FLAG_PC;
+    if (icfg->flags[ii] & CPUPERF_CONFIG_FLAG_CALLSTACK)
+        ocfg->fixed_flags[ss->num_fixed] |= IPM_CONFIG_FLAG_CALLSTACK;
 
     ++ss->num_fixed;
     return ZX_OK;
@@ -589,6 +591,8 @@ static zx_status_t ipm_stage_programmable_config(const cpuperf_config_t* icfg,
         ocfg->programmable_flags[ss->num_programmable] |= IPM_CONFIG_FLAG_TIMEBASE;
     if (icfg->flags[ii] & CPUPERF_CONFIG_FLAG_PC)
         ocfg->programmable_flags[ss->num_programmable] |= IPM_CONFIG_FLAG_PC;
+    if (icfg->flags[ii] & CPUPERF_CONFIG_FLAG_CALLSTACK)
+        ocfg->programmable_flags[ss->num_programmable] |= IPM_CONFIG_FLAG_CALLSTACK;
 
     ++ss->num_programmable;
     return ZX_OK;
@@ -47,6 +47,11 @@ typedef struct ipt_per_trace_state {
     bool is_circular;
     // true if allocated
     bool allocated;
+    // true if assigned to a thread, |owner.thread| is then our handle of it
+    bool assigned;
+    // true if tracing into this buffer was stopped with
+    // IOCTL_IPT_SNAPSHOT_BUFFER while tracing is active
+    bool paused;
     // number of ToPA tables needed
     uint32_t num_tables;
 
@@ -72,7 +77,8 @@ typedef struct ipt_device {
 
     // # of entries in |per_trace_state|.
     // When tracing by cpu, this is the max number of cpus.
-    // When tracing by thread, this is the max number of threads.
+    // When tracing by thread, this is the max number of threads,
+    // IPT_MAX_NUM_THREAD_TRACES.
     // TODO(dje): Add support for dynamically growing the vector.
     uint32_t num_traces;
 
@@ -530,15 +536,74 @@ static zx_status_t x86_pt_alloc_buffer(ipt_device_t* ipt_dev,
 }
 
 static zx_status_t x86_pt_assign_buffer_thread(ipt_device_t* ipt_dev, uint32_t index, zx_handle_t thread) {
+    zx_status_t status;
+    if (ipt_dev->mode != IPT_TRACE_THREADS) {
+        status = ZX_ERR_BAD_STATE;
+        goto fail;
+    }
+    if (ipt_dev->active) {
+        status = ZX_ERR_BAD_STATE;
+        goto fail;
+    }
+    if (index >= ipt_dev->num_traces) {
+        status = ZX_ERR_INVALID_ARGS;
+        goto fail;
+    }
+    ipt_per_trace_state_t* per_trace = &ipt_dev->per_trace_state[index];
+    if (!per_trace->allocated) {
+        status = ZX_ERR_INVALID_ARGS;
+        goto fail;
+    }
+    if (per_trace->assigned) {
+        status = ZX_ERR_ALREADY_BOUND;
+        goto fail;
+    }
+
+    zx_handle_t resource = get_root_resource();
+    status = zx_mtrace_control(resource, MTRACE_KIND_IPT, MTRACE_IPT_ASSIGN_THREAD,
+                               index, &thread, sizeof(thread));
+    if (status != ZX_OK)
+        goto fail;
+
+    per_trace->owner.thread = thread;
+    per_trace->assigned = true;
+    return ZX_OK;
+
+fail:
     zx_handle_close(thread);
-    // TODO(dje): Thread support is still work-in-progress.
-    return ZX_ERR_NOT_SUPPORTED;
+    return status;
 }
 
 static zx_status_t x86_pt_release_buffer_thread(ipt_device_t* ipt_dev, uint32_t index, zx_handle_t thread) {
+    zx_status_t status;
+    if (ipt_dev->active) {
+        status = ZX_ERR_BAD_STATE;
+        goto done;
+    }
+    if (index >= ipt_dev->num_traces) {
+        status = ZX_ERR_INVALID_ARGS;
+        goto done;
+    }
+    ipt_per_trace_state_t* per_trace = &ipt_dev->per_trace_state[index];
+    if (!per_trace->assigned) {
+        status = ZX_ERR_INVALID_ARGS;
+        goto done;
+    }
+
+    // The kernel checks |thread| is the one assigned to the buffer.
+    zx_handle_t resource = get_root_resource();
+    status = zx_mtrace_control(resource, MTRACE_KIND_IPT, MTRACE_IPT_RELEASE_THREAD,
+                               index, &thread, sizeof(thread));
+    if (status != ZX_OK)
+        goto done;
+
+    zx_handle_close(per_trace->owner.thread);
+    per_trace->owner.thread = ZX_HANDLE_INVALID;
+    per_trace->assigned = false;
+
+done:
     zx_handle_close(thread);
-    // TODO(dje): Thread support is still work-in-progress.
-    return ZX_ERR_NOT_SUPPORTED;
+    return status;
 }
 
 static zx_status_t x86_pt_free_buffer(ipt_device_t* ipt_dev, uint32_t index) {
@@ -550,6 +615,9 @@ static zx_status_t x86_pt_free_buffer(ipt_device_t* ipt_dev, uint32_t index) {
     ipt_per_trace_state_t* per_trace = &ipt_dev->per_trace_state[index];
     if (!per_trace->allocated)
         return ZX_ERR_INVALID_ARGS;
+    // The thread has to be released first.
+    if (per_trace->assigned)
+        return ZX_ERR_BAD_STATE;
     x86_pt_free_buffer1(ipt_dev, per_trace);
     return ZX_OK;
 }
@@ -570,10 +638,6 @@ static zx_status_t ipt_alloc_trace(cpu_trace_device_t* dev,
         return ZX_ERR_INVALID_ARGS;
     memcpy(&config, cmd, sizeof(config));
 
-    // TODO(dje): Until thread tracing is supported.
-    if (config.mode == IPT_MODE_THREADS)
-        return ZX_ERR_NOT_SUPPORTED;
-
     uint32_t internal_mode;
     switch (config.mode) {
     case IPT_MODE_CPUS:
@@ -593,7 +657,10 @@ static zx_status_t ipt_alloc_trace(cpu_trace_device_t* dev,
     if (!ipt_dev)
         return ZX_ERR_NO_MEMORY;
 
-    ipt_dev->num_traces = zx_system_get_num_cpus();
+    if (internal_mode == IPT_TRACE_CPUS)
+        ipt_dev->num_traces = zx_system_get_num_cpus();
+    else
+        ipt_dev->num_traces = IPT_MAX_NUM_THREAD_TRACES;
 
     ipt_dev->per_trace_state = calloc(ipt_dev->num_traces, sizeof(ipt_dev->per_trace_state[0]));
     if (!ipt_dev->per_trace_state) {
@@ -621,12 +688,6 @@ static zx_status_t ipt_free_trace(cpu_trace_device_t* dev) {
     if (ipt_dev->active)
         return ZX_ERR_BAD_STATE;
 
-    for (uint32_t i = 0; i < ipt_dev->num_traces; ++i) {
-        ipt_per_trace_state_t* per_trace = &ipt_dev->per_trace_state[i];
-        if (per_trace->allocated)
-            x86_pt_free_buffer1(ipt_dev, per_trace);
-    }
-
     zx_handle_t resource = get_root_resource();
     zx_status_t status =
         zx_mtrace_control(resource, MTRACE_KIND_IPT, MTRACE_IPT_FREE_TRACE, 0, NULL, 0);
@@ -635,6 +696,15 @@ static zx_status_t ipt_free_trace(cpu_trace_device_t* dev) {
     if (status != ZX_OK)
         return ZX_OK;
 
+    // Freeing the trace released any threads still assigned to buffers.
+    for (uint32_t i = 0; i < ipt_dev->num_traces; ++i) {
+        ipt_per_trace_state_t* per_trace = &ipt_dev->per_trace_state[i];
+        if (per_trace->assigned)
+            zx_handle_close(per_trace->owner.thread);
+        if (per_trace->allocated)
+            x86_pt_free_buffer1(ipt_dev, per_trace);
+    }
+
     free(ipt_dev->per_trace_state);
     free(ipt_dev);
     dev->ipt = NULL;
@@ -747,9 +817,6 @@ static zx_status_t ipt_get_buffer_info(ipt_device_t* ipt_dev,
     if (replymax < sizeof(data))
         return ZX_ERR_BUFFER_TOO_SMALL;
 
-    if (ipt_dev->active)
-        return ZX_ERR_BAD_STATE;
-
     memcpy(&index, cmd, sizeof(index));
     if (index >= ipt_dev->num_traces)
         return ZX_ERR_INVALID_ARGS;
@@ -757,6 +824,9 @@ static zx_status_t ipt_get_buffer_info(ipt_device_t* ipt_dev,
     if (!per_trace->allocated)
         return ZX_ERR_INVALID_ARGS;
 
+    if (ipt_dev->active && !per_trace->paused)
+        return ZX_ERR_BAD_STATE;
+
     // Note: If this is a circular buffer this is just where tracing stopped.
     data.capture_end = compute_capture_size(ipt_dev, per_trace);
     memcpy(reply, &data, sizeof(data));
@@ -804,17 +874,66 @@ static zx_status_t ipt_free_buffer(ipt_device_t* ipt_dev,
     return 0;
 }
 
+static void x86_pt_regs_from_trace(const ipt_per_trace_state_t* per_trace,
+                                   zx_x86_pt_regs_t* regs) {
+    regs->ctl = per_trace->ctl;
+    regs->ctl |= IPT_CTL_TOPA_MASK | IPT_CTL_TRACE_EN_MASK;
+    regs->status = per_trace->status;
+    regs->output_base = per_trace->output_base;
+    regs->output_mask_ptrs = per_trace->output_mask_ptrs;
+    regs->cr3_match = per_trace->cr3_match;
+    static_assert(sizeof(regs->addr_ranges) == sizeof(per_trace->addr_ranges),
+                  "addr range size mismatch");
+    memcpy(regs->addr_ranges, per_trace->addr_ranges, sizeof(per_trace->addr_ranges));
+}
+
+static void x86_pt_trace_from_regs(ipt_per_trace_state_t* per_trace,
+                                   const zx_x86_pt_regs_t* regs) {
+    per_trace->ctl = regs->ctl;
+    per_trace->status = regs->status;
+    per_trace->output_base = regs->output_base;
+    per_trace->output_mask_ptrs = regs->output_mask_ptrs;
+    per_trace->cr3_match = regs->cr3_match;
+    static_assert(sizeof(per_trace->addr_ranges) == sizeof(regs->addr_ranges),
+                  "addr range size mismatch");
+    memcpy(per_trace->addr_ranges, regs->addr_ranges, sizeof(regs->addr_ranges));
+}
+
 // Begin tracing.
 static zx_status_t ipt_start(ipt_device_t* ipt_dev) {
     if (ipt_dev->active)
         return ZX_ERR_BAD_STATE;
-    if (ipt_dev->mode != IPT_TRACE_CPUS)
-        return ZX_ERR_BAD_STATE;
     assert(ipt_dev->per_trace_state);
 
     zx_handle_t resource = get_root_resource();
     zx_status_t status;
 
+    if (ipt_dev->mode == IPT_TRACE_THREADS) {
+        uint32_t num_assigned = 0;
+        for (uint32_t i = 0; i < ipt_dev->num_traces; ++i) {
+            const ipt_per_trace_state_t* per_trace = &ipt_dev->per_trace_state[i];
+            if (!per_trace->assigned)
+                continue;
+
+            zx_x86_pt_regs_t regs;
+            x86_pt_regs_from_trace(per_trace, &regs);
+            status = zx_mtrace_control(resource, MTRACE_KIND_IPT, MTRACE_IPT_STAGE_THREAD_DATA,
+                                       i, &regs, sizeof(regs));
+            if (status != ZX_OK)
+                return status;
+            ++num_assigned;
+        }
+        if (num_assigned == 0)
+            return ZX_ERR_BAD_STATE;
+
+        status = zx_mtrace_control(resource, MTRACE_KIND_IPT, MTRACE_IPT_THREAD_MODE_START,
+                                   0, NULL, 0);
+        if (status != ZX_OK)
+            return status;
+        ipt_dev->active = true;
+        return ZX_OK;
+    }
+
     // First verify a buffer has been allocated for each cpu.
     for (uint32_t cpu = 0; cpu < ipt_dev->num_traces; ++cpu) {
         const ipt_per_trace_state_t* per_trace = &ipt_dev->per_trace_state[cpu];
@@ -826,16 +945,7 @@ static zx_status_t ipt_start(ipt_device_t* ipt_dev) {
         const ipt_per_trace_state_t* per_trace = &ipt_dev->per_trace_state[cpu];
 
         zx_x86_pt_regs_t regs;
-        regs.ctl = per_trace->ctl;
-        regs.ctl |= IPT_CTL_TOPA_MASK | IPT_CTL_TRACE_EN_MASK;
-        regs.status = per_trace->status;
-        regs.output_base = per_trace->output_base;
-        regs.output_mask_ptrs = per_trace->output_mask_ptrs;
-        regs.cr3_match = per_trace->cr3_match;
-        static_assert(sizeof(regs.addr_ranges) == sizeof(per_trace->addr_ranges),
-                      "addr range size mismatch");
-        memcpy(regs.addr_ranges, per_trace->addr_ranges, sizeof(per_trace->addr_ranges));
-
+        x86_pt_regs_from_trace(per_trace, &regs);
         status = zx_mtrace_control(resource, MTRACE_KIND_IPT, MTRACE_IPT_STAGE_CPU_DATA,
                                    cpu, &regs, sizeof(regs));
         if (status != ZX_OK)
@@ -857,40 +967,99 @@ static zx_status_t ipt_stop(ipt_device_t* ipt_dev) {
     assert(ipt_dev->per_trace_state);
 
     zx_handle_t resource = get_root_resource();
+    bool threads = ipt_dev->mode == IPT_TRACE_THREADS;
 
-    zx_status_t status = zx_mtrace_control(resource, MTRACE_KIND_IPT, MTRACE_IPT_CPU_MODE_STOP,
+    zx_status_t status = zx_mtrace_control(resource, MTRACE_KIND_IPT,
+                                           threads ? MTRACE_IPT_THREAD_MODE_STOP : MTRACE_IPT_CPU_MODE_STOP,
                                            0, NULL, 0);
     if (status != ZX_OK)
         return status;
     ipt_dev->active = false;
 
-    for (uint32_t cpu = 0; cpu < ipt_dev->num_traces; ++cpu) {
-        ipt_per_trace_state_t* per_trace = &ipt_dev->per_trace_state[cpu];
+    for (uint32_t i = 0; i < ipt_dev->num_traces; ++i) {
+        ipt_per_trace_state_t* per_trace = &ipt_dev->per_trace_state[i];
+        if (threads && !per_trace->assigned)
+            continue;
+        per_trace->paused = false;
 
         zx_x86_pt_regs_t regs;
-        status = zx_mtrace_control(resource, MTRACE_KIND_IPT, MTRACE_IPT_GET_CPU_DATA,
-                                   cpu, &regs, sizeof(regs));
+        status = zx_mtrace_control(resource, MTRACE_KIND_IPT,
+                                   threads ? MTRACE_IPT_GET_THREAD_DATA : MTRACE_IPT_GET_CPU_DATA,
+                                   i, &regs, sizeof(regs));
         if (status != ZX_OK)
             return status;
-        per_trace->ctl = regs.ctl;
-        per_trace->status = regs.status;
-        per_trace->output_base = regs.output_base;
-        per_trace->output_mask_ptrs = regs.output_mask_ptrs;
-        per_trace->cr3_match = regs.cr3_match;
-        static_assert(sizeof(per_trace->addr_ranges) == sizeof(regs.addr_ranges),
-                      "addr range size mismatch");
-        memcpy(per_trace->addr_ranges, regs.addr_ranges, sizeof(regs.addr_ranges));
+        x86_pt_trace_from_regs(per_trace, &regs);
 
         // If there was an operational error, report it.
         if (per_trace->status & IPT_STATUS_ERROR_MASK) {
-            printf("%s: WARNING: operational error detected on cpu %u\n",
-                   __func__, cpu);
+            printf("%s: WARNING: operational error detected on %s %u\n",
+                   __func__, threads ? "trace" : "cpu", i);
         }
     }
 
     return ZX_OK;
 }
 
+// Stop tracing into one thread's buffer and fetch where it got to, leaving
+// the other threads being traced.
+static zx_status_t ipt_snapshot_buffer(ipt_device_t* ipt_dev,
+                                       const void* cmd, size_t cmdlen) {
+    uint32_t index;
+    if (cmdlen != sizeof(index))
+        return ZX_ERR_INVALID_ARGS;
+    memcpy(&index, cmd, sizeof(index));
+
+    if (!ipt_dev->active || ipt_dev->mode != IPT_TRACE_THREADS)
+        return ZX_ERR_BAD_STATE;
+    if (index >= ipt_dev->num_traces)
+        return ZX_ERR_INVALID_ARGS;
+    ipt_per_trace_state_t* per_trace = &ipt_dev->per_trace_state[index];
+    if (!per_trace->assigned || per_trace->paused)
+        return ZX_ERR_BAD_STATE;
+
+    zx_handle_t resource = get_root_resource();
+    zx_status_t status = zx_mtrace_control(resource, MTRACE_KIND_IPT, MTRACE_IPT_PAUSE_THREAD,
+                                           index, NULL, 0);
+    if (status != ZX_OK)
+        return status;
+    per_trace->paused = true;
+
+    zx_x86_pt_regs_t regs;
+    status = zx_mtrace_control(resource, MTRACE_KIND_IPT, MTRACE_IPT_GET_THREAD_DATA,
+                               index, &regs, sizeof(regs));
+    if (status != ZX_OK)
+        return status;
+    // Keep |ctl| as configured, the kernel still has the trace enabled.
+    uint64_t ctl = per_trace->ctl;
+    x86_pt_trace_from_regs(per_trace, &regs);
+    per_trace->ctl = ctl;
+    return ZX_OK;
+}
+
+static zx_status_t ipt_resume_buffer(ipt_device_t* ipt_dev,
+                                     const void* cmd, size_t cmdlen) {
+    uint32_t index;
+    if (cmdlen != sizeof(index))
+        return ZX_ERR_INVALID_ARGS;
+    memcpy(&index, cmd, sizeof(index));
+
+    if (!ipt_dev->active)
+        return ZX_ERR_BAD_STATE;
+    if (index >= ipt_dev->num_traces)
+        return ZX_ERR_INVALID_ARGS;
+    ipt_per_trace_state_t* per_trace = &ipt_dev->per_trace_state[index];
+    if (!per_trace->paused)
+        return ZX_ERR_BAD_STATE;
+
+    zx_handle_t resource = get_root_resource();
+    zx_status_t status = zx_mtrace_control(resource, MTRACE_KIND_IPT, MTRACE_IPT_RESUME_THREAD,
+                                           index, NULL, 0);
+    if (status != ZX_OK)
+        return status;
+    per_trace->paused = false;
+    return ZX_OK;
+}
+
 zx_status_t ipt_ioctl(cpu_trace_device_t* dev, uint32_t op,
                       const void* cmd, size_t cmdlen,
                       void* reply, size_t replymax,
@@ -956,6 +1125,16 @@ zx_status_t ipt_ioctl(cpu_trace_device_t* dev, uint32_t op,
             return ZX_ERR_INVALID_ARGS;
         return ipt_stop(ipt_dev);
 
+    case IOCTL_IPT_SNAPSHOT_BUFFER:
+        if (replymax != 0)
+            return ZX_ERR_INVALID_ARGS;
+        return ipt_snapshot_buffer(ipt_dev, cmd, cmdlen);
+
+    case IOCTL_IPT_RESUME_BUFFER:
+        if (replymax != 0)
+            return ZX_ERR_INVALID_ARGS;
+        return ipt_resume_buffer(ipt_dev, cmd, cmdlen);
+
     default:
         return ZX_ERR_INVALID_ARGS;
     }
@@ -12,11 +12,121 @@
 
 #include <zircon/device/ktrace.h>
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <threads.h>
 
+#define STREAM_CHUNK_SIZE (64 * 1024)
+#define STREAM_POLL_INTERVAL ZX_MSEC(10)
+
+// While streaming, a thread moves records out of the kernel and into a socket
+// whose other end the client has, until the client closes it.
+static mtx_t stream_lock = MTX_INIT;
+static bool streaming;
+
+static void ktrace_stream_done(void) {
+    mtx_lock(&stream_lock);
+    zx_ktrace_control(get_root_resource(), KTRACE_ACTION_STOP, 0, NULL);
+    zx_ktrace_control(get_root_resource(), KTRACE_ACTION_REWIND, 0, NULL);
+    streaming = false;
+    mtx_unlock(&stream_lock);
+}
+
+static int ktrace_stream_thread(void* arg) {
+    zx_handle_t socket = (zx_handle_t)(uintptr_t)arg;
+    char* buf = malloc(STREAM_CHUNK_SIZE);
+    size_t pending = 0;
+    size_t sent = 0;
+
+    while (buf != NULL) {
+        zx_signals_t observed;
+        if (sent == pending) {
+            uint32_t actual;
+            if (zx_ktrace_read(get_root_resource(), buf, 0, STREAM_CHUNK_SIZE, &actual) != ZX_OK) {
+                break;
+            }
+            if (actual == 0) {
+                // Nothing is ready yet. Look again shortly, unless the client
+                // has gone away.
+                if (zx_object_wait_one(socket, ZX_SOCKET_PEER_CLOSED,
+                                       zx_deadline_after(STREAM_POLL_INTERVAL),
+                                       &observed) == ZX_OK) {
+                    break;
+                }
+                continue;
+            }
+            pending = actual;
+            sent = 0;
+        }
+
+        size_t actual;
+        zx_status_t status = zx_socket_write(socket, 0, buf + sent, pending - sent, &actual);
+        if (status == ZX_ERR_SHOULD_WAIT) {
+            zx_object_wait_one(socket, ZX_SOCKET_WRITABLE | ZX_SOCKET_PEER_CLOSED,
+                               ZX_TIME_INFINITE, &observed);
+            if (observed & ZX_SOCKET_PEER_CLOSED) {
+                break;
+            }
+            continue;
+        }
+        if (status != ZX_OK) {
+            break;
+        }
+        sent += actual;
+    }
+
+    free(buf);
+    zx_handle_close(socket);
+    ktrace_stream_done();
+    return 0;
+}
+
+static zx_status_t ktrace_start_streaming(uint32_t group_mask, zx_handle_t* out) {
+    mtx_lock(&stream_lock);
+    if (streaming) {
+        mtx_unlock(&stream_lock);
+        return ZX_ERR_ALREADY_BOUND;
+    }
+
+    zx_handle_t local, remote;
+    zx_status_t status = zx_socket_create(0, &local, &remote);
+    if (status != ZX_OK) {
+        mtx_unlock(&stream_lock);
+        return status;
+    }
+
+    // Start from a clean buffer so the stream begins with the metadata.
+    zx_handle_t root = get_root_resource();
+    zx_ktrace_control(root, KTRACE_ACTION_STOP, 0, NULL);
+    zx_ktrace_control(root, KTRACE_ACTION_REWIND, 0, NULL);
+    status = zx_ktrace_control(root, KTRACE_ACTION_START_STREAMING, group_mask, NULL);
+    if (status != ZX_OK) {
+        zx_handle_close(local);
+        zx_handle_close(remote);
+        mtx_unlock(&stream_lock);
+        return status;
+    }
+
+    thrd_t thread;
+    if (thrd_create_with_name(&thread, ktrace_stream_thread, (void*)(uintptr_t)local,
+                              "ktrace-stream") != thrd_success) {
+        zx_ktrace_control(root, KTRACE_ACTION_STOP, 0, NULL);
+        zx_ktrace_control(root, KTRACE_ACTION_REWIND, 0, NULL);
+        zx_handle_close(local);
+        zx_handle_close(remote);
+        mtx_unlock(&stream_lock);
+        return ZX_ERR_NO_RESOURCES;
+    }
+    thrd_detach(thread);
+
+    streaming = true;
+    mtx_unlock(&stream_lock);
+    *out = remote;
+    return ZX_OK;
+}
+
 static zx_status_t ktrace_read(void* ctx, void* buf, size_t count, zx_off_t off, size_t* actual) {
     uint32_t length;
     zx_status_t status = zx_ktrace_read(get_root_resource(), buf, off, count, &length);
@@ -73,8 +183,27 @@ static zx_status_t ktrace_ioctl(void* ctx, uint32_t op,
         return zx_ktrace_control(get_root_resource(), KTRACE_ACTION_START, group_mask, NULL);
     }
     case IOCTL_KTRACE_STOP: {
+        mtx_lock(&stream_lock);
         zx_ktrace_control(get_root_resource(), KTRACE_ACTION_STOP, 0, NULL);
-        zx_ktrace_control(get_root_resource(), KTRACE_ACTION_REWIND, 0, NULL);
+        // A stream carries on with what's left until the client closes it.
+        if (!streaming) {
+            zx_ktrace_control(get_root_resource(), KTRACE_ACTION_REWIND, 0, NULL);
+        }
+        mtx_unlock(&stream_lock);
+        return ZX_OK;
+    }
+    case IOCTL_KTRACE_START_STREAMING: {
+        if (cmdlen != sizeof(uint32_t)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        if (max < sizeof(zx_handle_t)) {
+            return ZX_ERR_BUFFER_TOO_SMALL;
+        }
+        zx_status_t status = ktrace_start_streaming(*(uint32_t *)cmd, (zx_handle_t*)reply);
+        if (status != ZX_OK) {
+            return status;
+        }
+        *out_actual = sizeof(zx_handle_t);
         return ZX_OK;
     }
     default:
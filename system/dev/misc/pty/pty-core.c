@@ -53,12 +53,11 @@ static zx_status_t pty_client_read(void* ctx, void* buf, size_t count, zx_off_t
     pty_server_t* ps = pc->srv;
 
     mtx_lock(&ps->lock);
-    bool was_full = pty_fifo_is_full(&pc->fifo);
     size_t length = pty_fifo_read(&pc->fifo, buf, count);
     if (pty_fifo_is_empty(&pc->fifo)) {
         device_state_clr(pc->zxdev, DEV_STATE_READABLE);
     }
-    if (was_full && length) {
+    if (pty_fifo_unblock(&pc->fifo)) {
         device_state_set(ps->zxdev, DEV_STATE_WRITABLE);
     }
     mtx_unlock(&ps->lock);
@@ -261,6 +260,7 @@ static void pty_client_release(void* ctx) {
     }
 
     xprintf("pty cli %p (id=%u) release\n", pc, pc->id);
+    pty_fifo_destroy(&pc->fifo);
     free(pc);
 }
 
@@ -299,9 +299,11 @@ static zx_status_t pty_openat(pty_server_t* ps, zx_device_t** out, uint32_t id,
 
     pc->id = id;
     pc->flags = 0;
-    pc->fifo.head = 0;
-    pc->fifo.tail = 0;
     zx_status_t status;
+    if ((status = pty_fifo_init(&pc->fifo)) != ZX_OK) {
+        free(pc);
+        return status;
+    }
 
     unsigned num_clients = 0;
     mtx_lock(&ps->lock);
@@ -310,6 +312,7 @@ static zx_status_t pty_openat(pty_server_t* ps, zx_device_t** out, uint32_t id,
     list_for_every_entry(&ps->clients, c, pty_client_t, node) {
         if (c->id == id) {
             mtx_unlock(&ps->lock);
+            pty_fifo_destroy(&pc->fifo);
             free(pc);
             return ZX_ERR_INVALID_ARGS;
         }
@@ -378,19 +381,12 @@ zx_status_t pty_server_send(pty_server_t* ps, const void* data, size_t len, bool
         if (atomic || (pc->flags & PTY_CLI_RAW_MODE)) {
             *actual = pty_fifo_write(&pc->fifo, data, len, atomic);
         } else {
-            if (len > PTY_FIFO_SIZE) {
-                len = PTY_FIFO_SIZE;
-            }
-            const uint8_t *ch = data;
-            unsigned n = 0;
-            unsigned evt = 0;
-            while (n < len) {
-                if (*ch++ == CTRL_C) {
-                    evt = PTY_EVENT_INTERRUPT;
-                    break;
-                }
-                n++;
+            if (len > PTY_FIFO_MAX_SIZE) {
+                len = PTY_FIFO_MAX_SIZE;
             }
+            const uint8_t* ctrl_c = memchr(data, CTRL_C, len);
+            size_t n = ctrl_c ? (size_t)(ctrl_c - (const uint8_t*)data) : len;
+            unsigned evt = ctrl_c ? PTY_EVENT_INTERRUPT : 0;
             size_t r = pty_fifo_write(&pc->fifo, data, n, false);
             if ((r == n) && evt) {
                 // consume the event
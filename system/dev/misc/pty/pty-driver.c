@@ -53,7 +53,6 @@ static zx_status_t psd_read(void* ctx, void* buf, size_t count, zx_off_t off, si
     bool eof = false;
 
     mtx_lock(&psd->srv.lock);
-    bool was_full = pty_fifo_is_full(&psd->fifo);
     size_t length = pty_fifo_read(&psd->fifo, buf, count);
     if (pty_fifo_is_empty(&psd->fifo)) {
         if (list_is_empty(&psd->srv.clients)) {
@@ -62,7 +61,7 @@ static zx_status_t psd_read(void* ctx, void* buf, size_t count, zx_off_t off, si
             device_state_clr(psd->srv.zxdev, DEV_STATE_READABLE);
         }
     }
-    if (was_full && length) {
+    if (pty_fifo_unblock(&psd->fifo)) {
         pty_server_resume_locked(&psd->srv);
     }
     mtx_unlock(&psd->srv.lock);
@@ -111,6 +110,12 @@ static zx_status_t psd_ioctl(void* ctx, uint32_t op,
     }
 }
 
+static void psd_release(pty_server_t* ps) {
+    pty_server_dev_t* psd = psd_from_ps(ps);
+    pty_fifo_destroy(&psd->fifo);
+    free(psd);
+}
+
 // Since we have no special functionality,
 // we just use the implementations from pty-core
 // directly.
@@ -133,11 +138,15 @@ static zx_status_t ptmx_open(void* ctx, zx_device_t** out, uint32_t flags) {
         return ZX_ERR_NO_MEMORY;
     }
 
+    zx_status_t status;
+    if ((status = pty_fifo_init(&psd->fifo)) != ZX_OK) {
+        free(psd);
+        return status;
+    }
     pty_server_init(&psd->srv);
     psd->srv.recv = psd_recv;
+    psd->srv.release = psd_release;
     mtx_init(&psd->lock, mtx_plain);
-    psd->fifo.head = 0;
-    psd->fifo.tail = 0;
 
     device_add_args_t args = {
         .version = DEVICE_ADD_ARGS_VERSION,
@@ -148,8 +157,8 @@ static zx_status_t ptmx_open(void* ctx, zx_device_t** out, uint32_t flags) {
         .flags = DEVICE_ADD_INSTANCE,
     };
 
-    zx_status_t status;
     if ((status = device_add(pty_root, &args, &psd->srv.zxdev)) < 0) {
+        pty_fifo_destroy(&psd->fifo);
         free(psd);
         return status;
     }
@@ -7,30 +7,94 @@
 
 #include "pty-fifo.h"
 
-static_assert((PTY_FIFO_SIZE & (PTY_FIFO_SIZE - 1)) == 0, "fifo size not power of two");
+static_assert((PTY_FIFO_MIN_SIZE & (PTY_FIFO_MIN_SIZE - 1)) == 0, "fifo size not power of two");
+static_assert((PTY_FIFO_MAX_SIZE & (PTY_FIFO_MAX_SIZE - 1)) == 0, "fifo size not power of two");
 
-#define PTY_FIFO_MASK (PTY_FIFO_SIZE - 1)
+zx_status_t pty_fifo_init(pty_fifo_t* fifo) {
+    if ((fifo->data = malloc(PTY_FIFO_MIN_SIZE)) == NULL) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    fifo->size = PTY_FIFO_MIN_SIZE;
+    fifo->head = 0;
+    fifo->tail = 0;
+    fifo->peak = 0;
+    fifo->full = false;
+    return ZX_OK;
+}
+
+void pty_fifo_destroy(pty_fifo_t* fifo) {
+    free(fifo->data);
+    fifo->data = NULL;
+}
+
+// Copies |len| bytes from the tail of the fifo, without consuming them.
+static void pty_fifo_peek(pty_fifo_t* fifo, uint8_t* data, size_t len) {
+    size_t offset = fifo->tail & (fifo->size - 1);
+    size_t avail = fifo->size - offset;
+    if (len <= avail) {
+        memcpy(data, fifo->data + offset, len);
+    } else {
+        memcpy(data, fifo->data + offset, avail);
+        memcpy(data + avail, fifo->data, len - avail);
+    }
+}
+
+// Moves the contents to a buffer of |size|. If that can't be allocated the
+// fifo is left as it was.
+static void pty_fifo_resize(pty_fifo_t* fifo, uint32_t size) {
+    uint8_t* data = malloc(size);
+    if (data == NULL) {
+        return;
+    }
+    uint32_t used = fifo->head - fifo->tail;
+    pty_fifo_peek(fifo, data, used);
+    free(fifo->data);
+    fifo->data = data;
+    fifo->size = size;
+    fifo->tail = 0;
+    fifo->head = used;
+}
 
 size_t pty_fifo_write(pty_fifo_t* fifo, const void* data, size_t len, bool atomic) {
-    size_t avail = PTY_FIFO_SIZE - (fifo->head - fifo->tail);
+    uint32_t used = fifo->head - fifo->tail;
+    if (fifo->size - used < len && fifo->size < PTY_FIFO_MAX_SIZE) {
+        uint32_t size = fifo->size;
+        while (size - used < len && size < PTY_FIFO_MAX_SIZE) {
+            size *= 2;
+        }
+        pty_fifo_resize(fifo, size);
+    }
+
+    size_t avail = fifo->size - used;
     if (avail < len) {
+        // An empty fifo has nothing to drain that would unblock it.
+        if (used > 0) {
+            fifo->full = true;
+        }
         if (atomic) {
             return 0;
         }
         len = avail;
     }
 
-    size_t offset = fifo->head & PTY_FIFO_MASK;
+    size_t offset = fifo->head & (fifo->size - 1);
 
-    avail = PTY_FIFO_SIZE - offset;
+    avail = fifo->size - offset;
     if (len <= avail) {
         memcpy(fifo->data + offset, data, len);
     } else {
         memcpy(fifo->data + offset, data, avail);
-        memcpy(fifo->data, data + avail, len - avail);
+        memcpy(fifo->data, (const uint8_t*)data + avail, len - avail);
     }
 
     fifo->head += len;
+    used += len;
+    if (used == PTY_FIFO_MAX_SIZE) {
+        fifo->full = true;
+    }
+    if (used > fifo->peak) {
+        fifo->peak = used;
+    }
     return len;
 }
 
@@ -40,17 +104,22 @@ size_t pty_fifo_read(pty_fifo_t* fifo, void* data, size_t len) {
         len = avail;
     }
 
-    size_t offset = fifo->tail & PTY_FIFO_MASK;
+    pty_fifo_peek(fifo, data, len);
+    fifo->tail += len;
 
-    avail = PTY_FIFO_SIZE - offset;
-    if (len <= avail) {
-        memcpy(data, fifo->data + offset, len);
-    } else {
-        memcpy(data, fifo->data + offset, avail);
-        memcpy(data + avail, fifo->data, len - avail);
+    if (pty_fifo_is_empty(fifo)) {
+        if (fifo->size > PTY_FIFO_MIN_SIZE && fifo->peak <= fifo->size / 4) {
+            pty_fifo_resize(fifo, fifo->size / 2);
+        }
+        fifo->peak = 0;
     }
-
-    fifo->tail += len;
     return len;
 }
 
+bool pty_fifo_unblock(pty_fifo_t* fifo) {
+    if (fifo->full && (fifo->head - fifo->tail) <= fifo->size / 2) {
+        fifo->full = false;
+        return true;
+    }
+    return false;
+}
@@ -9,26 +9,46 @@
 #include <stdlib.h>
 
 #include <zircon/compiler.h>
+#include <zircon/types.h>
 
 __BEGIN_CDECLS;
 
-#define PTY_FIFO_SIZE (4096)
+// A fifo starts at the minimum size and doubles when a write does not fit,
+// up to the maximum, so that a burst of output is taken in by one write
+// rather than one small write at a time. It halves again, down to the
+// minimum, when it empties having used no more than a quarter of itself.
+#define PTY_FIFO_MIN_SIZE (4096)
+#define PTY_FIFO_MAX_SIZE (65536)
 
 typedef struct pty_fifo {
+    uint8_t* data;
+    // Of |data|, a power of two.
+    uint32_t size;
     uint32_t head;
     uint32_t tail;
-    uint8_t data[PTY_FIFO_SIZE];
+    // The most the fifo has held since it was last empty.
+    uint32_t peak;
+    // Set when a write has found the fifo full, until pty_fifo_unblock().
+    bool full;
 } pty_fifo_t;
 
+zx_status_t pty_fifo_init(pty_fifo_t* fifo);
+void pty_fifo_destroy(pty_fifo_t* fifo);
+
 size_t pty_fifo_read(pty_fifo_t* fifo, void* data, size_t len);
 size_t pty_fifo_write(pty_fifo_t* fifo, const void* data, size_t len, bool atomic);
 
+// Returns true, and clears the full flag, if the fifo was full but has
+// drained to half its size. The writer should be woken then, rather than as
+// soon as there is any room, so that it resumes with one large write.
+bool pty_fifo_unblock(pty_fifo_t* fifo);
+
 static inline bool pty_fifo_is_empty(pty_fifo_t* fifo) {
     return fifo->head == fifo->tail;
 }
 
 static inline bool pty_fifo_is_full(pty_fifo_t* fifo) {
-    return (fifo->head - fifo->tail) == PTY_FIFO_SIZE;
+    return fifo->full;
 }
 
 __END_CDECLS;
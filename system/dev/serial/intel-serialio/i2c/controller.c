@@ -754,8 +754,11 @@ zx_status_t intel_serialio_bind_i2c(zx_device_t* dev) {
         return ZX_ERR_NO_MEMORY;
 
     list_initialize(&device->slave_list);
+    list_initialize(&device->txn_list);
+    list_initialize(&device->free_txn_list);
     mtx_init(&device->mutex, mtx_plain);
     mtx_init(&device->irq_mask_mutex, mtx_plain);
+    mtx_init(&device->txn_mutex, mtx_plain);
     device->pcidev = dev;
 
     uint16_t vendor_id;
@@ -797,6 +800,15 @@ zx_status_t intel_serialio_bind_i2c(zx_device_t* dev) {
         goto fail;
     }
 
+    // start the thread that runs queued transactions
+    ret = thrd_create_with_name(&device->txn_thread, intel_serialio_i2c_txn_thread, device,
+                                "i2c-txn");
+    if (ret != thrd_success) {
+        xprintf("i2c: failed to create txn thread: %d\n", ret);
+        status = ZX_ERR_NO_RESOURCES;
+        goto fail;
+    }
+
     // Run the bus at standard speed by default.
     device->bus_freq = I2C_MAX_STANDARD_SPEED_HZ;
 
@@ -6,6 +6,7 @@
 
 #include <zircon/types.h>
 #include <stdint.h>
+#include <sync/completion.h>
 #include <zircon/listnode.h>
 #include <threads.h>
 
@@ -157,6 +158,13 @@ typedef struct intel_serialio_i2c_device {
 
     mtx_t mutex;
     mtx_t irq_mask_mutex;
+
+    // Transactions queued by i2c_transact(), and spares to reuse.
+    thrd_t txn_thread;
+    struct list_node txn_list;
+    struct list_node free_txn_list;
+    completion_t txn_active;
+    mtx_t txn_mutex;
 } intel_serialio_i2c_device_t;
 
 zx_status_t intel_serialio_i2c_reset_controller(
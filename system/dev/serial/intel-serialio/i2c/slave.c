@@ -4,11 +4,13 @@
 
 #include <ddk/device.h>
 #include <ddk/driver.h>
+#include <ddk/protocol/i2c.h>
 #include <intel-serialio/reg.h>
 #include <zircon/types.h>
 #include <zircon/device/i2c.h>
 #include <zircon/listnode.h>
 #include <zircon/thread_annotations.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -256,6 +258,160 @@ transfer_finish_2:
     return status;
 }
 
+// Implement queued transactions for the i2c channel protocol. A caller can
+// queue the next transaction while the controller is still busy with the last
+// one, and gets the result in its completion callback rather than blocking.
+
+static intel_serialio_i2c_txn_t* intel_serialio_i2c_get_txn(
+    intel_serialio_i2c_device_t* controller) {
+    mtx_lock(&controller->txn_mutex);
+    intel_serialio_i2c_txn_t* txn =
+        list_remove_head_type(&controller->free_txn_list, intel_serialio_i2c_txn_t, node);
+    mtx_unlock(&controller->txn_mutex);
+    if (!txn) {
+        txn = calloc(1, sizeof(*txn));
+    }
+    return txn;
+}
+
+int intel_serialio_i2c_txn_thread(void* arg) {
+    intel_serialio_i2c_device_t* controller = arg;
+    intel_serialio_i2c_txn_t* txn;
+
+    while (true) {
+        mtx_lock(&controller->txn_mutex);
+        while ((txn = list_remove_head_type(&controller->txn_list, intel_serialio_i2c_txn_t,
+                                            node)) != NULL) {
+            mtx_unlock(&controller->txn_mutex);
+
+            i2c_slave_segment_t segments[2];
+            int segment_count = 0;
+            if (txn->tx_len > 0) {
+                segments[segment_count++] = (i2c_slave_segment_t){
+                    .type = I2C_SEGMENT_TYPE_WRITE,
+                    .buf = txn->tx_buf,
+                    .len = txn->tx_len,
+                };
+            }
+            if (txn->rx_len > 0) {
+                segments[segment_count++] = (i2c_slave_segment_t){
+                    .type = I2C_SEGMENT_TYPE_READ,
+                    .buf = txn->rx_buf,
+                    .len = txn->rx_len,
+                };
+            }
+
+            zx_status_t status = intel_serialio_i2c_slave_transfer(txn->slave, segments,
+                                                                   segment_count);
+            if (txn->cb) {
+                if (status == ZX_OK) {
+                    txn->cb(ZX_OK, txn->rx_len ? txn->rx_buf : NULL, txn->rx_len, txn->cookie);
+                } else {
+                    txn->cb(status, NULL, 0, txn->cookie);
+                }
+            }
+
+            mtx_lock(&controller->txn_mutex);
+            list_add_head(&controller->free_txn_list, &txn->node);
+            // keep holding mutex for while loop test
+        }
+        mtx_unlock(&controller->txn_mutex);
+
+        completion_wait(&controller->txn_active, ZX_TIME_INFINITE);
+        completion_reset(&controller->txn_active);
+    }
+    return 0;
+}
+
+static zx_status_t intel_serialio_i2c_slave_transact(
+    void* ctx, const void* write_buf, size_t write_length, size_t read_length,
+    i2c_complete_cb complete_cb, void* cookie) {
+    intel_serialio_i2c_slave_device_t* slave = ctx;
+    intel_serialio_i2c_device_t* controller = slave->controller;
+
+    if (write_length > INTEL_SERIALIO_I2C_MAX_TRANSFER ||
+        read_length > INTEL_SERIALIO_I2C_MAX_TRANSFER) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+    if (write_length == 0 && read_length == 0) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    intel_serialio_i2c_txn_t* txn = intel_serialio_i2c_get_txn(controller);
+    if (!txn) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    if (write_length > 0) {
+        memcpy(txn->tx_buf, write_buf, write_length);
+    }
+    txn->slave = slave;
+    txn->tx_len = write_length;
+    txn->rx_len = read_length;
+    txn->cb = complete_cb;
+    txn->cookie = cookie;
+
+    mtx_lock(&controller->txn_mutex);
+    list_add_tail(&controller->txn_list, &txn->node);
+    mtx_unlock(&controller->txn_mutex);
+    completion_signal(&controller->txn_active);
+
+    return ZX_OK;
+}
+
+static zx_status_t intel_serialio_i2c_slave_set_bitrate(void* ctx, uint32_t bitrate) {
+    // The bus frequency is shared by all the slaves on a controller, and is
+    // set through IOCTL_I2C_BUS_SET_FREQUENCY on the bus device.
+    return ZX_ERR_NOT_SUPPORTED;
+}
+
+static zx_status_t intel_serialio_i2c_slave_get_max_transfer_size(void* ctx, size_t* out_size) {
+    *out_size = INTEL_SERIALIO_I2C_MAX_TRANSFER;
+    return ZX_OK;
+}
+
+static void intel_serialio_i2c_slave_channel_release(void* ctx) {
+    // The channel is the slave device itself, which outlives it.
+}
+
+static i2c_channel_ops_t intel_serialio_i2c_channel_ops = {
+    .transact = intel_serialio_i2c_slave_transact,
+    .set_bitrate = intel_serialio_i2c_slave_set_bitrate,
+    .get_max_transfer_size = intel_serialio_i2c_slave_get_max_transfer_size,
+    .channel_release = intel_serialio_i2c_slave_channel_release,
+};
+
+// A slave device has a single channel, to itself.
+static zx_status_t intel_serialio_i2c_slave_get_channel(void* ctx, uint32_t channel_id,
+                                                         i2c_channel_t* channel) {
+    if (channel_id != 0) {
+        return ZX_ERR_NOT_FOUND;
+    }
+    channel->ops = &intel_serialio_i2c_channel_ops;
+    channel->ctx = ctx;
+    return ZX_OK;
+}
+
+static zx_status_t intel_serialio_i2c_slave_get_channel_by_address(
+    void* ctx, uint32_t bus_id, uint16_t address, i2c_channel_t* channel) {
+    return ZX_ERR_NOT_SUPPORTED;
+}
+
+static i2c_protocol_ops_t intel_serialio_i2c_protocol_ops = {
+    .get_channel = intel_serialio_i2c_slave_get_channel,
+    .get_channel_by_address = intel_serialio_i2c_slave_get_channel_by_address,
+};
+
+static zx_status_t intel_serialio_i2c_slave_get_protocol(void* ctx, uint32_t proto_id,
+                                                          void* protocol) {
+    if (proto_id != ZX_PROTOCOL_I2C) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    i2c_protocol_t* proto = protocol;
+    proto->ops = &intel_serialio_i2c_protocol_ops;
+    proto->ctx = ctx;
+    return ZX_OK;
+}
+
 // Implement the char protocol for the slave devices.
 
 static zx_status_t intel_serialio_i2c_slave_read(
@@ -484,6 +640,7 @@ static void intel_serialio_i2c_slave_release(void* ctx) {
 
 zx_protocol_device_t intel_serialio_i2c_slave_device_proto = {
     .version = DEVICE_OPS_VERSION,
+    .get_protocol = intel_serialio_i2c_slave_get_protocol,
     .read = intel_serialio_i2c_slave_read,
     .write = intel_serialio_i2c_slave_write,
     .ioctl = intel_serialio_i2c_slave_ioctl,
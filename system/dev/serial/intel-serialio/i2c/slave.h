@@ -6,10 +6,14 @@
 
 #include <ddk/binding.h>
 #include <ddk/device.h>
+#include <ddk/protocol/i2c.h>
 #include <zircon/types.h>
 #include <zircon/listnode.h>
 #include <stdint.h>
 
+// Largest write or read that can be queued with i2c_transact().
+#define INTEL_SERIALIO_I2C_MAX_TRANSFER 1024
+
 typedef struct intel_serialio_i2c_slave_device {
     zx_device_t* zxdev;
     struct intel_serialio_i2c_device* controller;
@@ -22,5 +26,22 @@ typedef struct intel_serialio_i2c_slave_device {
     struct list_node slave_list_node;
 } intel_serialio_i2c_slave_device_t;
 
+// A write-read transaction queued on the controller by i2c_transact(). The
+// write, if any, is followed by the read with a repeated start in between.
+typedef struct intel_serialio_i2c_txn {
+    struct list_node node;
+    intel_serialio_i2c_slave_device_t* slave;
+    uint8_t tx_buf[INTEL_SERIALIO_I2C_MAX_TRANSFER];
+    uint8_t rx_buf[INTEL_SERIALIO_I2C_MAX_TRANSFER];
+    size_t tx_len;
+    size_t rx_len;
+    i2c_complete_cb cb;
+    void* cookie;
+} intel_serialio_i2c_txn_t;
+
+// Runs the transactions queued on |arg|, an intel_serialio_i2c_device_t, in
+// order, and completes each from this thread.
+int intel_serialio_i2c_txn_thread(void* arg);
+
 // device protocol for a slave device
 extern zx_protocol_device_t intel_serialio_i2c_slave_device_proto;
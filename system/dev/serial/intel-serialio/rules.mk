@@ -21,7 +21,7 @@ MODULE_SRCS := \
 
 MODULE_COMPILEFLAGS += -I $(LOCAL_DIR)/intel-serialio-include/
 
-MODULE_STATIC_LIBS := system/ulib/ddk
+MODULE_STATIC_LIBS := system/ulib/ddk system/ulib/sync
 
 MODULE_LIBS := system/ulib/driver system/ulib/zircon system/ulib/c
 
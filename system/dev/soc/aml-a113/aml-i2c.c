@@ -19,7 +19,7 @@
 #include "aml-i2c-internal.h"
 
 static zx_status_t aml_i2c_read(aml_i2c_dev_t *dev, uint8_t *buff, uint32_t len);
-static zx_status_t aml_i2c_write(aml_i2c_dev_t *dev, uint8_t *buff, uint32_t len);
+static zx_status_t aml_i2c_write(aml_i2c_dev_t *dev, uint8_t *buff, uint32_t len, bool stop);
 
 static zx_status_t aml_i2c_set_slave_addr(aml_i2c_dev_t *dev, uint16_t addr) {
 
@@ -66,16 +66,20 @@ static int aml_i2c_thread(void *arg) {
         while ((txn = list_remove_tail_type(&dev->txn_list, aml_i2c_txn_t, node)) != NULL) {
             mtx_unlock(&dev->txn_mutex);
             aml_i2c_set_slave_addr(dev, txn->conn->slave_addr);
+            // A write followed by a read is sent as one combined transaction,
+            // with a repeated start in between rather than a stop.
+            zx_status_t status = ZX_OK;
             if (txn->tx_len > 0) {
-                aml_i2c_write(dev,txn->tx_buff, txn->tx_len);
-                if ((txn->cb) && (txn->rx_len == 0)) {
-                    txn->cb(ZX_OK, NULL, txn->rx_len, txn->cookie);
-                }
+                status = aml_i2c_write(dev, txn->tx_buff, txn->tx_len, txn->rx_len == 0);
+            }
+            if (status == ZX_OK && txn->rx_len > 0) {
+                status = aml_i2c_read(dev, txn->rx_buff, txn->rx_len);
             }
-            if (txn->rx_len > 0) {
-                aml_i2c_read(dev, txn->rx_buff, txn->rx_len);
-                if (txn->cb) {
-                    txn->cb(ZX_OK, txn->rx_buff, txn->rx_len, txn->cookie);
+            if (txn->cb) {
+                if (status == ZX_OK) {
+                    txn->cb(ZX_OK, txn->rx_len ? txn->rx_buff : NULL, txn->rx_len, txn->cookie);
+                } else {
+                    txn->cb(status, NULL, 0, txn->cookie);
                 }
             }
             memset(txn, 0, sizeof(aml_i2c_txn_t));
@@ -191,7 +195,7 @@ static zx_status_t aml_i2c_wait_event(aml_i2c_dev_t* dev, uint32_t sig_mask) {
 }
 
 
-static zx_status_t aml_i2c_write(aml_i2c_dev_t *dev, uint8_t *buff, uint32_t len) {
+static zx_status_t aml_i2c_write(aml_i2c_dev_t *dev, uint8_t *buff, uint32_t len, bool stop) {
     ZX_DEBUG_ASSERT(len <= AML_I2C_MAX_TRANSFER);
     uint32_t token_num = 0;
     uint64_t token_reg = 0;
@@ -206,7 +210,7 @@ static zx_status_t aml_i2c_write(aml_i2c_dev_t *dev, uint8_t *buff, uint32_t len
             token_reg |= (uint64_t)TOKEN_DATA << (4*(token_num++));
         }
 
-        if (is_last_iter) {
+        if (is_last_iter && stop) {
             token_reg |= (uint64_t)TOKEN_STOP << (4*(token_num++));
         }
 
@@ -282,7 +286,7 @@ static zx_status_t aml_i2c_read(aml_i2c_dev_t *dev, uint8_t *buff, uint32_t len)
         rdata = dev->virt_regs->token_rdata_0;
         rdata |= (uint64_t)(dev->virt_regs->token_rdata_1) << 32;
 
-        for (uint32_t i=0; i < sizeof(rdata); i++) {
+        for (uint32_t i=0; i < rx_size; i++) {
             buff[i] = (uint8_t)((rdata >> (8*i) & 0xff));
         }
 
@@ -211,17 +211,21 @@ static int i2c_dw_worker_thread (void* arg) {
             i2c_dw_disable_interrupts(dev);
             i2c_dw_clear_intrrupts(dev);
 
+            zx_status_t status = ZX_OK;
             if (txn->tx_len > 0) {
-                i2c_dw_write(dev, txn->tx_buff, txn->tx_len, (txn->rx_len) ? false : true);
-                if ((txn->cb) && (txn->rx_len == 0)) {
-                    txn->cb(ZX_OK, NULL, txn->rx_len, txn->cookie);
-                }
+                status = i2c_dw_write(dev, txn->tx_buff, txn->tx_len,
+                                      (txn->rx_len) ? false : true);
+            }
+
+            if (status == ZX_OK && txn->rx_len > 0) {
+                status = i2c_dw_read(dev, txn->rx_buff, txn->rx_len);
             }
 
-            if (txn->rx_len > 0) {
-                i2c_dw_read(dev, txn->rx_buff, txn->rx_len);
-                if (txn->cb) {
-                    txn->cb(ZX_OK, txn->rx_buff, txn->rx_len, txn->cookie);
+            if (txn->cb) {
+                if (status == ZX_OK) {
+                    txn->cb(ZX_OK, txn->rx_len ? txn->rx_buff : NULL, txn->rx_len, txn->cookie);
+                } else {
+                    txn->cb(status, NULL, 0, txn->cookie);
                 }
             }
 
@@ -200,8 +200,26 @@ static void xhci_release(void* ctx) {
     xhci_free(xhci);
 }
 
+static zx_status_t xhci_ioctl(void* ctx, uint32_t op, const void* in_buf, size_t in_len,
+                              void* out_buf, size_t out_len, size_t* out_actual) {
+    xhci_t* xhci = ctx;
+
+    switch (op) {
+    case IOCTL_USB_HCI_GET_EVENT_STATS:
+        if (out_len < sizeof(usb_hci_event_stats_t)) {
+            return ZX_ERR_BUFFER_TOO_SMALL;
+        }
+        xhci_get_event_stats(xhci, out_buf);
+        *out_actual = sizeof(usb_hci_event_stats_t);
+        return ZX_OK;
+    default:
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+}
+
 static zx_protocol_device_t xhci_device_proto = {
     .version = DEVICE_OPS_VERSION,
+    .ioctl = xhci_ioctl,
     .suspend = xhci_suspend,
     .unbind = xhci_unbind,
     .release = xhci_release,
@@ -263,7 +281,7 @@ static int xhci_start_thread(void* arg) {
         completers[i] = completer;
         completer->interrupter = i;
         completer->xhci = xhci;
-        // We need a high priority thread for isochronous transfers.
+        // We need a high priority thread for isochronous and interrupt transfers.
         // If there is only one interrupt available, that thread will need
         // to be high priority.
         completer->priority = (i == ISOCH_INTERRUPTER || xhci->num_interrupts == 1) ?
@@ -280,8 +298,9 @@ static int xhci_start_thread(void* arg) {
     device_make_visible(xhci->zxdev);
     atomic_store(&xhci->suspended, false);
     for (uint32_t i = 0; i < xhci->num_interrupts; i++) {
-        thrd_create_with_name(&xhci->completer_threads[i], completer_thread, completers[i],
-                              "completer_thread");
+        char name[ZX_MAX_NAME_LEN];
+        snprintf(name, sizeof(name), "xhci-completer-%u", i);
+        thrd_create_with_name(&xhci->completer_threads[i], completer_thread, completers[i], name);
     }
 
     zxlogf(TRACE, "xhci_start_thread done\n");
@@ -350,9 +369,14 @@ static zx_status_t usb_xhci_bind_pci(zx_device_t* parent, pci_protocol_t* pci) {
         goto error_return;
     }
 
+    // one interrupter per vector, up to as many as we have a policy for
+    if (irq_cnt > INTERRUPTER_COUNT) {
+        irq_cnt = INTERRUPTER_COUNT;
+    }
+
     // select our IRQ mode
     xhci_mode_t mode = XHCI_PCI_MSI;
-    status = pci_set_irq_mode(pci, ZX_PCIE_IRQ_MODE_MSI, xhci->num_interrupts);
+    status = pci_set_irq_mode(pci, ZX_PCIE_IRQ_MODE_MSI, irq_cnt);
     if (status < 0) {
         zx_status_t status_legacy = pci_set_irq_mode(pci, ZX_PCIE_IRQ_MODE_LEGACY, 1);
 
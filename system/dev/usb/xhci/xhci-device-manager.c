@@ -417,6 +417,10 @@ static zx_status_t xhci_handle_disconnect_device(xhci_t* xhci, uint32_t hub_addr
     uint32_t drop_flags = 0;
     for (int i = 0; i < XHCI_NUM_EPS; i++) {
         if (slot->eps[i].state != EP_STATE_DEAD) {
+            // endpoint 0 never had an interrupter assigned
+            if (i > 0 && slot->eps[i].state != EP_STATE_DISABLED) {
+                xhci_release_interrupter(xhci, slot->eps[i].interrupter);
+            }
             zx_status_t status = xhci_stop_endpoint(xhci, slot_id, i, EP_STATE_DEAD,
                                                     ZX_ERR_IO_NOT_PRESENT);
             if (status != ZX_OK) {
@@ -666,6 +670,7 @@ zx_status_t xhci_enable_endpoint(xhci_t* xhci, uint32_t slot_id, usb_endpoint_de
             if (!ep->transfer_state) {
                 status = ZX_ERR_NO_MEMORY;
             } else {
+                ep->interrupter = xhci_assign_interrupter(xhci, ep->ep_type);
                 ep->state = EP_STATE_RUNNING;
             }
         }
@@ -676,8 +681,12 @@ zx_status_t xhci_enable_endpoint(xhci_t* xhci, uint32_t slot_id, usb_endpoint_de
         // xhci_stop_endpoint will try to acquire the endpoint lock.
         // It also needs to wait for the TRB_CMD_STOP_ENDPOINT completion, which may never
         // complete if another xhci event is waiting for the same endpoint lock.
+        bool was_running = (ep->state != EP_STATE_DEAD && ep->state != EP_STATE_DISABLED);
         mtx_unlock(&ep->lock);
         xhci_stop_endpoint(xhci, slot_id, index, EP_STATE_DISABLED, ZX_ERR_BAD_STATE);
+        if (was_running) {
+            xhci_release_interrupter(xhci, ep->interrupter);
+        }
         XHCI_WRITE32(&icc->drop_context_flags, XHCI_ICC_EP_FLAG(index));
         zx_status_t status = xhci_update_input_context(xhci, slot_id, index);
         mtx_unlock(&xhci->input_context_lock);
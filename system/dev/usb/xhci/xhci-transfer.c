@@ -201,7 +201,7 @@ static zx_status_t xhci_start_transfer_locked(xhci_t* xhci, xhci_slot_t* slot, u
     state->needs_transfer_trb = ep->ep_type == USB_ENDPOINT_BULK;
 
     size_t length = req->header.length;
-    uint32_t interrupter_target = 0;
+    uint32_t interrupter_target = ep->interrupter;
 
     if (setup) {
         // Setup Stage
@@ -246,13 +246,10 @@ static zx_status_t xhci_continue_transfer_locked(xhci_t* xhci, xhci_slot_t* slot
     bool isochronous = (ep->ep_type == USB_ENDPOINT_ISOCHRONOUS);
     uint64_t frame = header->frame;
 
-    uint32_t interrupter_target = 0;
+    uint32_t interrupter_target = ep->interrupter;
 
-    if (isochronous) {
-        if (length == 0) return ZX_ERR_INVALID_ARGS;
-        if (xhci->num_interrupts > 1) {
-            interrupter_target = ISOCH_INTERRUPTER;
-        }
+    if (isochronous && length == 0) {
+        return ZX_ERR_INVALID_ARGS;
     }
 
     if (frame != 0) {
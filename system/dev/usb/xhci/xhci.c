@@ -584,6 +584,8 @@ uint64_t xhci_get_current_frame(xhci_t* xhci) {
 
 static void xhci_handle_events(xhci_t* xhci, int interrupter) {
     xhci_event_ring_t* er = &xhci->event_rings[interrupter];
+    usb_hci_ring_stats_t* stats = &xhci->ring_stats[interrupter];
+    uint32_t events = 0;
 
     // invalidate event ring before processing new events
     xhci_cache_flush_invalidate(er->start, er->buffer.size);
@@ -600,6 +602,7 @@ static void xhci_handle_events(xhci_t* xhci, int interrupter) {
             break;
         case TRB_EVENT_TRANSFER:
             xhci_handle_transfer_event(xhci, er->current);
+            stats->transfer_events++;
             break;
         case TRB_EVENT_MFINDEX_WRAP:
             xhci_handle_mfindex_wrap(xhci);
@@ -609,6 +612,7 @@ static void xhci_handle_events(xhci_t* xhci, int interrupter) {
             break;
         }
 
+        events++;
         er->current++;
         if (er->current == er->end) {
             er->current = er->start;
@@ -616,6 +620,11 @@ static void xhci_handle_events(xhci_t* xhci, int interrupter) {
         }
     }
 
+    stats->events += events;
+    if (events > stats->max_events) {
+        stats->max_events = events;
+    }
+
     // update event ring dequeue pointer and clear event handler busy flag
     xhci_update_erdp(xhci, interrupter);
 }
@@ -625,5 +634,34 @@ void xhci_handle_interrupt(xhci_t* xhci, uint32_t interrupter) {
     xhci_intr_regs_t* intr_regs = &xhci->runtime_regs->intr_regs[interrupter];
     XHCI_WRITE32(&intr_regs->iman, IMAN_IE | IMAN_IP);
 
+    xhci->ring_stats[interrupter].interrupts++;
     xhci_handle_events(xhci, interrupter);
 }
+
+// Chooses the interrupter an endpoint of the given type completes on.
+uint32_t xhci_assign_interrupter(xhci_t* xhci, uint8_t ep_type) {
+    uint32_t interrupter = 0;
+    if (ep_type == USB_ENDPOINT_ISOCHRONOUS || ep_type == USB_ENDPOINT_INTERRUPT) {
+        if (xhci->num_interrupts > ISOCH_INTERRUPTER) {
+            interrupter = ISOCH_INTERRUPTER;
+        }
+    } else if (ep_type == USB_ENDPOINT_BULK) {
+        if (xhci->num_interrupts > FIRST_BULK_INTERRUPTER) {
+            uint32_t bulk_count = xhci->num_interrupts - FIRST_BULK_INTERRUPTER;
+            interrupter = FIRST_BULK_INTERRUPTER +
+                          atomic_fetch_add(&xhci->next_bulk_interrupter, 1) % bulk_count;
+        }
+    }
+    __atomic_fetch_add(&xhci->ring_stats[interrupter].endpoints, 1, __ATOMIC_RELAXED);
+    return interrupter;
+}
+
+void xhci_release_interrupter(xhci_t* xhci, uint32_t interrupter) {
+    __atomic_fetch_sub(&xhci->ring_stats[interrupter].endpoints, 1, __ATOMIC_RELAXED);
+}
+
+void xhci_get_event_stats(xhci_t* xhci, usb_hci_event_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->interrupter_count = xhci->num_interrupts;
+    memcpy(stats->rings, xhci->ring_stats, xhci->num_interrupts * sizeof(stats->rings[0]));
+}
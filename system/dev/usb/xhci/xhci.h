@@ -5,6 +5,7 @@
 #pragma once
 
 #include <sync/completion.h>
+#include <zircon/device/usb.h>
 #include <zircon/hw/usb.h>
 #include <zircon/hw/usb-hub.h>
 #include <zircon/types.h>
@@ -33,7 +34,14 @@
 #define XHCI_RH_USB_3 1 // index of USB 2.0 virtual root hub device
 #define XHCI_RH_COUNT 2 // number of virtual root hub devices
 
+// Interrupter policy: interrupter 0 receives command completions and port
+// status changes, which the controller always reports there, along with
+// control transfers.  Isochronous and interrupt endpoints complete on
+// ISOCH_INTERRUPTER, which is serviced by a high priority thread, and bulk
+// endpoints are spread round robin over the interrupters after it, so that
+// bulk storage traffic does not add latency to periodic transfers.
 #define ISOCH_INTERRUPTER 1
+#define FIRST_BULK_INTERRUPTER 2
 
 // state for endpoint's current transfer
 typedef struct {
@@ -63,6 +71,7 @@ typedef struct {
     mtx_t lock;
     xhci_ep_state_t state;
     uint8_t ep_type;
+    uint32_t interrupter;        // interrupter this endpoint's transfers complete on
 } xhci_endpoint_t;
 
 typedef struct xhci_slot {
@@ -107,7 +116,7 @@ struct xhci {
     // Desired number of interrupters. This may be greater than what is
     // supported by hardware. The actual number of interrupts configured
     // will not exceed this, and is stored in num_interrupts.
-#define INTERRUPTER_COUNT 2
+#define INTERRUPTER_COUNT USB_HCI_MAX_INTERRUPTERS
     thrd_t completer_threads[INTERRUPTER_COUNT];
     zx_handle_t irq_handles[INTERRUPTER_COUNT];
     // actual number of interrupts we are using
@@ -143,6 +152,11 @@ struct xhci {
     xhci_event_ring_t event_rings[INTERRUPTER_COUNT];
     erst_entry_t* erst_arrays[INTERRUPTER_COUNT];
     zx_paddr_t erst_arrays_phys[INTERRUPTER_COUNT];
+    // Each ring's statistics are only updated by its completer thread,
+    // apart from the endpoint counts.
+    usb_hci_ring_stats_t ring_stats[INTERRUPTER_COUNT];
+    // next bulk interrupter to hand out
+    atomic_uint next_bulk_interrupter;
 
     size_t page_size;
     size_t max_slots;
@@ -220,6 +234,9 @@ int xhci_get_ep_ctx_state(xhci_slot_t* slot, xhci_endpoint_t* ep);
 void xhci_set_dbcaa(xhci_t* xhci, uint32_t slot_id, zx_paddr_t paddr);
 zx_status_t xhci_start(xhci_t* xhci);
 void xhci_handle_interrupt(xhci_t* xhci, uint32_t interrupter);
+uint32_t xhci_assign_interrupter(xhci_t* xhci, uint8_t ep_type);
+void xhci_release_interrupter(xhci_t* xhci, uint32_t interrupter);
+void xhci_get_event_stats(xhci_t* xhci, usb_hci_event_stats_t* stats);
 void xhci_post_command(xhci_t* xhci, uint32_t command, uint64_t ptr, uint32_t control_bits,
                        xhci_command_context_t* context);
 void xhci_wait_bits(volatile uint32_t* ptr, uint32_t bits, uint32_t expected);
@@ -22,17 +22,19 @@ namespace usb {
 static constexpr uint32_t RING_BUFFER_NUM_FRAMES = 30;
 static constexpr uint32_t MAX_OUTSTANDING_REQS = 8;
 
+static_assert(CAMERA_FRAME_RING_MAX_SLOTS <= 64, "slot ownership is tracked in a uint64_t");
+
 UsbVideoStream::~UsbVideoStream() {
     // List may not have been initialized.
     if (free_reqs_.next) {
         while (!list_is_empty(&free_reqs_)) {
-            usb_request_release(list_remove_head_type(&free_reqs_, usb_request_t, node));
+            usb_request_pool_add(&req_pool_,
+                                 list_remove_head_type(&free_reqs_, usb_request_t, node));
         }
+        usb_request_pool_release(&req_pool_);
     }
-    if (data_ring_buffer_.virt != nullptr) {
-        zx::vmar::root_self().unmap(reinterpret_cast<uintptr_t>(data_ring_buffer_.virt),
-                                    data_ring_buffer_.size);
-    }
+    data_ring_buffer_.Release();
+    frame_ring_.Release();
 }
 
 // static
@@ -88,16 +90,20 @@ zx_status_t UsbVideoStream::Bind(const char* devname,
         fbl::AutoLock lock(&lock_);
 
         list_initialize(&free_reqs_);
+        usb_request_pool_init(&req_pool_);
+
+        // All payloads are carved out of one VMO so that streaming never
+        // creates or maps VMOs per request.
+        zx_status_t status = usb_request_pool_alloc(&req_pool_, MAX_OUTSTANDING_REQS,
+                                                    max_bandwidth, usb_ep_addr_);
+        if (status != ZX_OK) {
+            zxlogf(ERROR, "usb_request_pool_alloc failed: %d\n", status);
+            return status;
+        }
 
         for (uint32_t i = 0; i < MAX_OUTSTANDING_REQS; i++) {
-            usb_request_t* req;
-            zx_status_t status = usb_request_alloc(&req,
-                                                   max_bandwidth,
-                                                   usb_ep_addr_);
-            if (status != ZX_OK) {
-                zxlogf(ERROR, "usb_request_alloc failed: %d\n", status);
-                return status;
-            }
+            usb_request_t* req = usb_request_pool_get(&req_pool_, max_bandwidth);
+            ZX_DEBUG_ASSERT(req != nullptr);
 
             req->cookie = this;
             req->complete_cb = [](usb_request_t* req, void* cookie) -> void {
@@ -318,13 +324,17 @@ zx_status_t UsbVideoStream::ProcessChannel(dispatcher::Channel* channel) {
         camera::camera_proto::CmdHdr        hdr;
         camera::camera_proto::GetFormatsReq get_formats;
         camera::camera_proto::SetFormatReq  set_format;
+        camera::camera_proto::SetFrameRingReq set_frame_ring;
+        camera::camera_proto::RingBufStartReq start;
+        camera::camera_proto::RingBufStopReq  stop;
     } req;
 
     static_assert(sizeof(req) <= 256,
                   "Request buffer is getting to be too large to hold on the stack!");
 
     uint32_t req_size;
-    zx_status_t res = channel->Read(&req, sizeof(req), &req_size);
+    zx::handle rxed_handle;
+    zx_status_t res = channel->Read(&req, sizeof(req), &req_size, &rxed_handle);
     if (res != ZX_OK)
         return res;
 
@@ -335,6 +345,10 @@ zx_status_t UsbVideoStream::ProcessChannel(dispatcher::Channel* channel) {
     switch (req.hdr.cmd) {
     HREQ(CAMERA_STREAM_CMD_GET_FORMATS, get_formats, GetFormatsLocked);
     HREQ(CAMERA_STREAM_CMD_SET_FORMAT,  set_format,  SetFormatLocked);
+    HREQ(CAMERA_STREAM_CMD_SET_FRAME_RING, set_frame_ring, SetFrameRingLocked,
+         fbl::move(rxed_handle));
+    HREQ(CAMERA_RB_CMD_START, start, StartLocked);
+    HREQ(CAMERA_RB_CMD_STOP,  stop,  StopLocked);
     default:
         zxlogf(ERROR, "Unrecognized command 0x%04x\n", req.hdr.cmd);
         return ZX_ERR_NOT_SUPPORTED;
@@ -354,14 +368,95 @@ zx_status_t UsbVideoStream::SetFormatLocked(dispatcher::Channel* channel,
     return ZX_ERR_NOT_SUPPORTED;
 }
 
+zx_status_t UsbVideoStream::SetFrameRingLocked(dispatcher::Channel* channel,
+                                               const camera::camera_proto::SetFrameRingReq& req,
+                                               zx::handle rxed_handle) {
+    camera::camera_proto::SetFrameRingResp resp = {};
+    resp.hdr = req.hdr;
+    resp.max_frame_size = max_frame_size_;
+
+    zx::fifo client_fifo;
+    resp.result = InitFrameRingLocked(req, zx::vmo(fbl::move(rxed_handle)), &client_fifo);
+    return channel->Write(&resp, sizeof(resp), fbl::move(client_fifo));
+}
+
+zx_status_t UsbVideoStream::InitFrameRingLocked(const camera::camera_proto::SetFrameRingReq& req,
+                                                zx::vmo vmo, zx::fifo* out_fifo) {
+    if (streaming_state_ != StreamingState::STOPPED) {
+        return ZX_ERR_BAD_STATE;
+    }
+    if (!vmo.is_valid() || req.slot_count == 0 ||
+        req.slot_count > CAMERA_FRAME_RING_MAX_SLOTS) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    if (req.slot_size < max_frame_size_) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+    uint64_t ring_size = static_cast<uint64_t>(req.slot_size) * req.slot_count;
+    uint64_t vmo_size;
+    zx_status_t status = vmo.get_size(&vmo_size);
+    if (status != ZX_OK) {
+        return status;
+    }
+    if (ring_size > vmo_size || ring_size > UINT32_MAX) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    frame_ring_.Release();
+    frame_fifo_.reset();
+    status = frame_ring_.Map(fbl::move(vmo), static_cast<uint32_t>(ring_size));
+    if (status != ZX_OK) {
+        return status;
+    }
+    // The fifo can hold every slot, so handing a frame to the client never
+    // has to wait.
+    status = zx::fifo::create(CAMERA_FRAME_RING_MAX_SLOTS,
+                              sizeof(camera::camera_proto::FrameNotify), 0,
+                              &frame_fifo_, out_fifo);
+    if (status != ZX_OK) {
+        frame_ring_.Release();
+        return status;
+    }
+
+    frame_slot_size_ = req.slot_size;
+    frame_slot_count_ = req.slot_count;
+    free_slot_mask_ = (req.slot_count == 64) ? UINT64_MAX : ((1ull << req.slot_count) - 1);
+    cur_slot_ = kNoSlot;
+    last_frame_time_ = 0;
+    dropped_frames_ = 0;
+    late_frames_ = 0;
+    return ZX_OK;
+}
+
+zx_status_t UsbVideoStream::StartLocked(dispatcher::Channel* channel,
+                                        const camera::camera_proto::RingBufStartReq& req) {
+    camera::camera_proto::RingBufStartResp resp = {};
+    resp.hdr = req.hdr;
+    resp.result = frame_fifo_.is_valid() ? StartStreamingLocked() : ZX_ERR_BAD_STATE;
+    return channel->Write(&resp, sizeof(resp));
+}
+
+zx_status_t UsbVideoStream::StopLocked(dispatcher::Channel* channel,
+                                       const camera::camera_proto::RingBufStopReq& req) {
+    camera::camera_proto::RingBufStopResp resp = {};
+    resp.hdr = req.hdr;
+    resp.result = StopStreamingLocked();
+    return channel->Write(&resp, sizeof(resp));
+}
+
 zx_status_t UsbVideoStream::RingBuffer::Init(uint32_t size) {
-    zx_status_t status = zx::vmo::create(size, 0, &this->vmo);
+    zx::vmo vmo;
+    zx_status_t status = zx::vmo::create(size, 0, &vmo);
     if (status != ZX_OK) {
         zxlogf(ERROR, "failed to create ring buffer: %d\n", status);
         return status;
     }
+    return Map(fbl::move(vmo), size);
+}
 
-    status = zx::vmar::root_self().map(0, this->vmo,
+zx_status_t UsbVideoStream::RingBuffer::Map(zx::vmo vmo, uint32_t size) {
+    this->vmo = fbl::move(vmo);
+    zx_status_t status = zx::vmar::root_self().map(0, this->vmo,
                                        0, size,
                                        ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE,
                                        reinterpret_cast<uintptr_t*>(&this->virt));
@@ -370,9 +465,20 @@ zx_status_t UsbVideoStream::RingBuffer::Init(uint32_t size) {
         return status;
     }
     this->size = size;
+    this->offset = 0;
     return ZX_OK;
 }
 
+void UsbVideoStream::RingBuffer::Release() {
+    if (this->virt != nullptr) {
+        zx::vmar::root_self().unmap(reinterpret_cast<uintptr_t>(this->virt), this->size);
+        this->virt = nullptr;
+    }
+    this->vmo.reset();
+    this->size = 0;
+    this->offset = 0;
+}
+
 zx_status_t UsbVideoStream::CreateDataRingBuffer() {
     fbl::AutoLock lock(&lock_);
 
@@ -386,8 +492,12 @@ zx_status_t UsbVideoStream::CreateDataRingBuffer() {
 
 zx_status_t UsbVideoStream::StartStreaming() {
     fbl::AutoLock lock(&lock_);
+    return StartStreamingLocked();
+}
 
-    if (!data_ring_buffer_.virt || streaming_state_ != StreamingState::STOPPED) {
+zx_status_t UsbVideoStream::StartStreamingLocked() {
+    if ((!data_ring_buffer_.virt && !frame_ring_.virt) ||
+        streaming_state_ != StreamingState::STOPPED) {
         return ZX_ERR_BAD_STATE;
     }
     zx_status_t status = usb_set_interface(&usb_, iface_num_,
@@ -405,7 +515,10 @@ zx_status_t UsbVideoStream::StartStreaming() {
 
 zx_status_t UsbVideoStream::StopStreaming() {
     fbl::AutoLock lock(&lock_);
+    return StopStreamingLocked();
+}
 
+zx_status_t UsbVideoStream::StopStreamingLocked() {
     if (streaming_state_ != StreamingState::STARTED) {
         return ZX_ERR_BAD_STATE;
     }
@@ -440,6 +553,11 @@ void UsbVideoStream::RequestComplete(usb_request_t* req) {
             zxlogf(TRACE, "setting ring buffer as stopped, got %u frames\n",
                    num_frames_);
             streaming_state_ = StreamingState::STOPPED;
+            // Reclaim the slot of the frame that was cut short.
+            if (cur_slot_ != kNoSlot) {
+                free_slot_mask_ |= 1ull << cur_slot_;
+                cur_slot_ = kNoSlot;
+            }
         }
         return;
     }
@@ -504,15 +622,7 @@ void UsbVideoStream::ProcessPayloadLocked(usb_request_t* req) {
     uint8_t fid = header.bmHeaderInfo & USB_VIDEO_VS_PAYLOAD_HEADER_FID;
     // FID is toggled when a new frame begins.
     if (cur_fid_ != fid) {
-        // Only advance the ring buffer position if the frame had no errors.
-        // TODO(jocelyndang): figure out if we should do something else.
-        if (!cur_frame_error_) {
-            data_ring_buffer_.offset += cur_frame_bytes_;
-            if (data_ring_buffer_.offset >= data_ring_buffer_.size) {
-                data_ring_buffer_.offset -= data_ring_buffer_.size;
-                ZX_DEBUG_ASSERT(data_ring_buffer_.offset < data_ring_buffer_.size);
-            }
-        }
+        CompleteFrameLocked();
 
         if (clock_frequency_hz_ != 0) {
             zxlogf(TRACE, "#%u: PTS = %lfs, STC = %lfs\n",
@@ -527,6 +637,14 @@ void UsbVideoStream::ProcessPayloadLocked(usb_request_t* req) {
         cur_fid_ = fid;
         cur_frame_pts_ = 0;
         cur_frame_stc_ = 0;
+
+        if (frame_fifo_.is_valid() && !AcquireFrameSlotLocked()) {
+            dropped_frames_++;
+        }
+    }
+    if (frame_fifo_.is_valid() && cur_slot_ == kNoSlot) {
+        // No slot for this frame, it is being dropped.
+        return;
     }
     if (cur_frame_error_) {
         zxlogf(ERROR, "skipping payload of invalid frame #%u\n", num_frames_);
@@ -550,6 +668,19 @@ void UsbVideoStream::ProcessPayloadLocked(usb_request_t* req) {
         return;
     }
 
+    if (frame_fifo_.is_valid()) {
+        uint8_t* slot = reinterpret_cast<uint8_t*>(frame_ring_.virt) +
+                        cur_slot_ * frame_slot_size_;
+        usb_request_copyfrom(req, slot + cur_frame_bytes_, data_size, offset);
+        cur_frame_bytes_ += data_size;
+        // Hand the frame over now rather than waiting for the FID to toggle
+        // on the first payload of the next frame.
+        if (header.bmHeaderInfo & USB_VIDEO_VS_PAYLOAD_HEADER_EOF) {
+            CompleteFrameLocked();
+        }
+        return;
+    }
+
     // Append the data to the end of the current frame.
     uint32_t frame_end_offset = data_ring_buffer_.offset + cur_frame_bytes_;
     if (frame_end_offset >= data_ring_buffer_.size) {
@@ -569,6 +700,80 @@ void UsbVideoStream::ProcessPayloadLocked(usb_request_t* req) {
     cur_frame_bytes_ += data_size;
 }
 
+void UsbVideoStream::CompleteFrameLocked() {
+    if (!frame_fifo_.is_valid()) {
+        // Only advance the ring buffer position if the frame had no errors.
+        // TODO(jocelyndang): figure out if we should do something else.
+        if (!cur_frame_error_) {
+            data_ring_buffer_.offset += cur_frame_bytes_;
+            if (data_ring_buffer_.offset >= data_ring_buffer_.size) {
+                data_ring_buffer_.offset -= data_ring_buffer_.size;
+                ZX_DEBUG_ASSERT(data_ring_buffer_.offset < data_ring_buffer_.size);
+            }
+        }
+        return;
+    }
+    if (cur_slot_ == kNoSlot) {
+        return;
+    }
+    uint32_t slot = cur_slot_;
+    cur_slot_ = kNoSlot;
+
+    if (cur_frame_error_ || cur_frame_bytes_ == 0) {
+        if (cur_frame_error_) {
+            dropped_frames_++;
+        }
+        free_slot_mask_ |= 1ull << slot;
+        return;
+    }
+
+    zx_time_t now = zx_time_get(ZX_CLOCK_MONOTONIC);
+    // dwFrameInterval is in 100ns units.
+    zx_duration_t interval = negotiation_result_.dwFrameInterval * 100ull;
+    if (last_frame_time_ != 0 && interval != 0 &&
+        now - last_frame_time_ > interval + interval / 2) {
+        late_frames_++;
+    }
+    last_frame_time_ = now;
+
+    camera::camera_proto::FrameNotify notify = {};
+    notify.frame_number = num_frames_;
+    notify.slot = slot;
+    notify.frame_size = cur_frame_bytes_;
+    notify.timestamp = now;
+    notify.presentation_timestamp = cur_frame_pts_;
+    notify.source_time_clock = cur_frame_stc_;
+    notify.dropped_frames = dropped_frames_;
+    notify.late_frames = late_frames_;
+
+    uint32_t actual;
+    zx_status_t status = frame_fifo_.write(&notify, sizeof(notify), &actual);
+    if (status != ZX_OK) {
+        // The client has gone away, keep the slot.
+        zxlogf(ERROR, "failed to notify frame #%u: %d\n", num_frames_, status);
+        free_slot_mask_ |= 1ull << slot;
+    }
+    cur_frame_bytes_ = 0;
+}
+
+bool UsbVideoStream::AcquireFrameSlotLocked() {
+    camera::camera_proto::FrameNotify returned[CAMERA_FRAME_RING_MAX_SLOTS];
+    uint32_t count;
+    if (frame_fifo_.read(returned, sizeof(returned), &count) == ZX_OK) {
+        for (uint32_t i = 0; i < count; i++) {
+            if (returned[i].slot < frame_slot_count_) {
+                free_slot_mask_ |= 1ull << returned[i].slot;
+            }
+        }
+    }
+    if (free_slot_mask_ == 0) {
+        return false;
+    }
+    cur_slot_ = __builtin_ctzll(free_slot_mask_);
+    free_slot_mask_ &= ~(1ull << cur_slot_);
+    return true;
+}
+
 void UsbVideoStream::DeactivateStreamChannel(const dispatcher::Channel* channel) {
     fbl::AutoLock lock(&lock_);
 
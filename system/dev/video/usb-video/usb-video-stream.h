@@ -13,6 +13,7 @@
 #include <fbl/mutex.h>
 #include <fbl/ref_counted.h>
 #include <fbl/vector.h>
+#include <zx/fifo.h>
 #include <zx/vmo.h>
 
 #include "usb-video.h"
@@ -61,6 +62,9 @@ private:
 
     struct RingBuffer {
         zx_status_t Init(uint32_t size);
+        // Maps an existing VMO, taking ownership of it.
+        zx_status_t Map(zx::vmo vmo, uint32_t size);
+        void Release();
 
         zx::vmo vmo;
         void* virt = nullptr;
@@ -116,12 +120,33 @@ private:
     zx_status_t SetFormatLocked(dispatcher::Channel* channel,
                                 const camera::camera_proto::SetFormatReq& req)
         __TA_REQUIRES(lock_);
+    zx_status_t SetFrameRingLocked(dispatcher::Channel* channel,
+                                   const camera::camera_proto::SetFrameRingReq& req,
+                                   zx::handle rxed_handle)
+        __TA_REQUIRES(lock_);
+    zx_status_t StartLocked(dispatcher::Channel* channel,
+                            const camera::camera_proto::RingBufStartReq& req)
+        __TA_REQUIRES(lock_);
+    zx_status_t StopLocked(dispatcher::Channel* channel,
+                           const camera::camera_proto::RingBufStopReq& req)
+        __TA_REQUIRES(lock_);
+
+    // Maps the client provided frame ring and creates the fifo used to pass
+    // slots back and forth. The client end of the fifo is returned in out_fifo.
+    zx_status_t InitFrameRingLocked(const camera::camera_proto::SetFrameRingReq& req,
+                                    zx::vmo vmo, zx::fifo* out_fifo)
+        __TA_REQUIRES(lock_);
+    // Collects slots handed back by the client and claims one for the next
+    // frame. Returns false if every slot is owned by the client.
+    bool AcquireFrameSlotLocked() __TA_REQUIRES(lock_);
 
     // Creates a new ring buffer and maps it into our address space.
     // The current streaming state must be StreamingState::STOPPED.
     zx_status_t CreateDataRingBuffer();
     zx_status_t StartStreaming();
     zx_status_t StopStreaming();
+    zx_status_t StartStreamingLocked() __TA_REQUIRES(lock_);
+    zx_status_t StopStreamingLocked() __TA_REQUIRES(lock_);
 
     // Queues a usb request against the underlying device.
     void QueueRequestLocked() __TA_REQUIRES(lock_);
@@ -131,6 +156,9 @@ private:
     // Extracts the payload data from the usb request response,
     // and stores it in the ring buffer.
     void ProcessPayloadLocked(usb_request_t* req) __TA_REQUIRES(lock_);
+    // Called once the last payload of the current frame has been processed.
+    // Commits the frame to the data ring buffer or hands its slot to the client.
+    void CompleteFrameLocked() __TA_REQUIRES(lock_);
 
     void DeactivateStreamChannel(const dispatcher::Channel* channel);
 
@@ -171,9 +199,26 @@ private:
 
     RingBuffer data_ring_buffer_ __TA_GUARDED(lock_);
 
+    // Client provided ring of frame slots. When set, payload data is written
+    // straight into the slots instead of data_ring_buffer_.
+    static constexpr uint32_t kNoSlot = UINT32_MAX;
+    RingBuffer frame_ring_ __TA_GUARDED(lock_);
+    zx::fifo frame_fifo_ __TA_GUARDED(lock_);
+    uint32_t frame_slot_size_ = 0;
+    uint32_t frame_slot_count_ = 0;
+    // Bit i is set while slot i is owned by the driver.
+    uint64_t free_slot_mask_ __TA_GUARDED(lock_) = 0;
+    // Slot the current frame is being written into.
+    uint32_t cur_slot_ __TA_GUARDED(lock_) = kNoSlot;
+    zx_time_t last_frame_time_ = 0;
+    uint32_t dropped_frames_ = 0;
+    uint32_t late_frames_ = 0;
+
     volatile StreamingState streaming_state_
         __TA_GUARDED(lock_) = StreamingState::STOPPED;
 
+    // Backing storage for the requests on free_reqs_.
+    usb_request_pool_t req_pool_;
     list_node_t free_reqs_ __TA_GUARDED(lock_);
     uint32_t num_free_reqs_ __TA_GUARDED(lock_);
     uint32_t num_allocated_reqs_ = 0;
@@ -32,6 +32,7 @@ namespace {
 
 typedef struct {
     bool readonly = false;
+    bool compress = false;
     uint64_t data_blocks = blobstore::kStartBlockMinimum; // Account for reserved blocks
     fbl::Vector<fbl::String> blob_list;
 } blob_options_t;
@@ -62,6 +63,7 @@ int do_blobstore_add_blobs(fbl::unique_fd fd, const blob_options_t& options) {
     if (blobstore_create(&bs, fbl::move(fd)) < 0) {
         return -1;
     }
+    bs->SetCompression(options.compress);
 
     struct rlimit rlp;
     if (getrlimit(RLIMIT_NOFILE, &rlp) != 0) {
@@ -235,6 +237,10 @@ int usage() {
                 CMDS[n].name, CMDS[n].help);
     }
     fprintf(stderr, "\n");
+    fprintf(stderr, "options:\n"
+                    "\t--readonly\n"
+                    "\t--compress   LZ4 compress blobs which are added\n"
+                    "\n");
     fprintf(stderr, "arguments (valid for create, one or more required for add):\n"
                     "\t--blob <path-to-file>\n"
                     "\t--manifest <path-to-manifest>\n");
@@ -255,6 +261,8 @@ int process_args(int argc, char** argv, CommandFunction* func, blob_options_t* o
     while (argc > 1) {
         if (!strcmp(argv[0], "--readonly")) {
             options->readonly = true;
+        } else if (!strcmp(argv[0], "--compress")) {
+            options->compress = true;
         } else {
             break;
         }
@@ -0,0 +1,702 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Decodes the per-thread Intel Processor Trace snapshots written by
+// ipt-capture into timelines of the functions each thread was running.
+//
+// Rather than reconstructing the full instruction flow, which takes the
+// code of every binary, only the packets that carry an address are used:
+// ipt-capture traces returns as branches, so each indirect branch, return,
+// and trace resumption tells where the thread was at the time. That is
+// plenty to see which functions a slow request spent its time in.
+// Functions are named from the unstripped binaries with the build IDs of
+// the process's dsos.
+
+#include <cxxabi.h>
+#include <dirent.h>
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+// ELF, just what it takes to find build IDs and function symbols.
+
+struct Elf64Ehdr {
+    uint8_t ident[16];
+    uint16_t type;
+    uint16_t machine;
+    uint32_t version;
+    uint64_t entry;
+    uint64_t phoff;
+    uint64_t shoff;
+    uint32_t flags;
+    uint16_t ehsize;
+    uint16_t phentsize;
+    uint16_t phnum;
+    uint16_t shentsize;
+    uint16_t shnum;
+    uint16_t shstrndx;
+};
+
+struct Elf64Phdr {
+    uint32_t type;
+    uint32_t flags;
+    uint64_t offset;
+    uint64_t vaddr;
+    uint64_t paddr;
+    uint64_t filesz;
+    uint64_t memsz;
+    uint64_t align;
+};
+
+struct Elf64Shdr {
+    uint32_t name;
+    uint32_t type;
+    uint64_t flags;
+    uint64_t addr;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t link;
+    uint32_t info;
+    uint64_t addralign;
+    uint64_t entsize;
+};
+
+struct Elf64Sym {
+    uint32_t name;
+    uint8_t info;
+    uint8_t other;
+    uint16_t shndx;
+    uint64_t value;
+    uint64_t size;
+};
+
+constexpr uint32_t kPtLoad = 1;
+constexpr uint32_t kPtNote = 4;
+constexpr uint32_t kShtSymtab = 2;
+constexpr uint32_t kShtDynsym = 11;
+constexpr uint8_t kSttFunc = 2;
+constexpr uint32_t kNtGnuBuildId = 3;
+
+struct Symbol {
+    uint64_t addr;
+    uint64_t size;
+    std::string name;
+};
+
+struct Binary {
+    std::string path;
+    uint64_t load_vaddr = 0;
+    std::vector<Symbol> symbols;
+};
+
+bool read_at(FILE* f, uint64_t offset, void* buf, size_t size) {
+    return fseek(f, static_cast<long>(offset), SEEK_SET) == 0 && fread(buf, 1, size, f) == size;
+}
+
+bool read_ehdr(FILE* f, Elf64Ehdr* ehdr) {
+    return read_at(f, 0, ehdr, sizeof(*ehdr)) &&
+           memcmp(ehdr->ident, "\x7f" "ELF", 4) == 0 &&
+           ehdr->ident[4] == 2 && // 64 bit
+           ehdr->ident[5] == 1 && // little endian
+           ehdr->phentsize == sizeof(Elf64Phdr) &&
+           (ehdr->shnum == 0 || ehdr->shentsize == sizeof(Elf64Shdr));
+}
+
+// The build ID of |f|, as the lowercase hex ipt-capture writes, or "".
+std::string read_build_id(FILE* f, const Elf64Ehdr& ehdr) {
+    for (uint16_t i = 0; i < ehdr.phnum; ++i) {
+        Elf64Phdr phdr;
+        if (!read_at(f, ehdr.phoff + i * sizeof(phdr), &phdr, sizeof(phdr)))
+            return "";
+        if (phdr.type != kPtNote || phdr.filesz > (1 << 20))
+            continue;
+
+        std::vector<uint8_t> notes(phdr.filesz);
+        if (!read_at(f, phdr.offset, notes.data(), notes.size()))
+            return "";
+        size_t pos = 0;
+        while (pos + 12 <= notes.size()) {
+            uint32_t namesz, descsz, type;
+            memcpy(&namesz, &notes[pos], 4);
+            memcpy(&descsz, &notes[pos + 4], 4);
+            memcpy(&type, &notes[pos + 8], 4);
+            size_t name = pos + 12;
+            size_t desc = name + ((namesz + 3) & ~3u);
+            pos = desc + ((descsz + 3) & ~3u);
+            if (pos > notes.size())
+                break;
+            if (type == kNtGnuBuildId && namesz == 4 && memcmp(&notes[name], "GNU", 4) == 0) {
+                std::string id;
+                for (uint32_t j = 0; j < descsz; ++j) {
+                    char hex[3];
+                    snprintf(hex, sizeof(hex), "%02x", notes[desc + j]);
+                    id += hex;
+                }
+                return id;
+            }
+        }
+    }
+    return "";
+}
+
+std::string demangle(const char* name) {
+    int status;
+    char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    if (status != 0)
+        return name;
+    std::string result(demangled);
+    free(demangled);
+    return result;
+}
+
+// Load the function symbols of |binary|, from its symbol table if it wasn't
+// stripped, from its dynamic symbols otherwise.
+bool load_symbols(Binary* binary) {
+    FILE* f = fopen(binary->path.c_str(), "rb");
+    if (!f)
+        return false;
+    Elf64Ehdr ehdr;
+    bool ok = read_ehdr(f, &ehdr);
+
+    binary->load_vaddr = UINT64_MAX;
+    for (uint16_t i = 0; ok && i < ehdr.phnum; ++i) {
+        Elf64Phdr phdr;
+        ok = read_at(f, ehdr.phoff + i * sizeof(phdr), &phdr, sizeof(phdr));
+        if (ok && phdr.type == kPtLoad)
+            binary->load_vaddr = std::min(binary->load_vaddr, phdr.vaddr & ~UINT64_C(0xfff));
+    }
+    if (binary->load_vaddr == UINT64_MAX)
+        binary->load_vaddr = 0;
+
+    std::vector<Elf64Shdr> shdrs(ok ? ehdr.shnum : 0);
+    if (!shdrs.empty())
+        ok = read_at(f, ehdr.shoff, shdrs.data(), shdrs.size() * sizeof(Elf64Shdr));
+
+    for (uint32_t want : {kShtSymtab, kShtDynsym}) {
+        for (const auto& shdr : shdrs) {
+            if (!ok || shdr.type != want || shdr.link >= shdrs.size())
+                continue;
+            const Elf64Shdr& strtab = shdrs[shdr.link];
+            std::vector<char> strings(strtab.size + 1);
+            std::vector<Elf64Sym> syms(shdr.size / sizeof(Elf64Sym));
+            if (!read_at(f, strtab.offset, strings.data(), strtab.size) ||
+                !read_at(f, shdr.offset, syms.data(), syms.size() * sizeof(Elf64Sym)))
+                continue;
+            strings[strtab.size] = '\0';
+            for (const auto& sym : syms) {
+                if ((sym.info & 0xf) != kSttFunc || sym.value == 0 || sym.name >= strtab.size)
+                    continue;
+                binary->symbols.push_back({sym.value, sym.size, demangle(&strings[sym.name])});
+            }
+        }
+        if (!binary->symbols.empty())
+            break;
+    }
+    fclose(f);
+
+    std::sort(binary->symbols.begin(), binary->symbols.end(),
+              [](const Symbol& a, const Symbol& b) { return a.addr < b.addr; });
+    return ok;
+}
+
+// Walk |dir| for ELF files with the build IDs in |binaries|.
+void find_binaries(const std::string& dir, std::map<std::string, Binary>* binaries,
+                   size_t* remaining) {
+    DIR* d = opendir(dir.c_str());
+    if (!d)
+        return;
+    struct dirent* de;
+    while (*remaining > 0 && (de = readdir(d)) != nullptr) {
+        if (de->d_name[0] == '.' && (de->d_name[1] == '\0' ||
+                                     (de->d_name[1] == '.' && de->d_name[2] == '\0')))
+            continue;
+        std::string path = dir + "/" + de->d_name;
+        struct stat st;
+        if (lstat(path.c_str(), &st) != 0)
+            continue;
+        if (S_ISDIR(st.st_mode)) {
+            find_binaries(path, binaries, remaining);
+            continue;
+        }
+        if (!S_ISREG(st.st_mode))
+            continue;
+
+        FILE* f = fopen(path.c_str(), "rb");
+        if (!f)
+            continue;
+        Elf64Ehdr ehdr;
+        std::string id = read_ehdr(f, &ehdr) ? read_build_id(f, ehdr) : "";
+        fclose(f);
+
+        auto it = binaries->find(id);
+        if (it != binaries->end() && it->second.path.empty()) {
+            it->second.path = path;
+            --*remaining;
+        }
+    }
+    closedir(d);
+}
+
+// The snapshot ipt-capture wrote.
+
+struct Dso {
+    std::string build_id;
+    uint64_t base;
+    std::string name;
+    Binary* binary = nullptr;
+};
+
+struct ThreadTrace {
+    uint64_t tid;
+    std::string file;
+    std::string name;
+};
+
+struct Snapshot {
+    uint64_t ticks_per_second = 0;
+    std::vector<Dso> dsos;
+    std::vector<ThreadTrace> threads;
+};
+
+bool read_snapshot(const char* path, Snapshot* snapshot) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "ipt-decode: unable to open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    char line[1024];
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\n")] = '\0';
+        char id[256], file[512];
+        uint64_t value;
+        int n;
+        if (sscanf(line, "ticks_per_second: %" SCNu64, &value) == 1) {
+            snapshot->ticks_per_second = value;
+        } else if (sscanf(line, "dso: id=%255s base=%" SCNx64 " name=%n", id, &value, &n) == 2) {
+            Dso dso;
+            dso.build_id = id;
+            dso.base = value;
+            dso.name = line + n;
+            snapshot->dsos.push_back(dso);
+        } else if (sscanf(line, "thread: tid=%" SCNu64 " file=%511s name=%n",
+                          &value, file, &n) == 2) {
+            snapshot->threads.push_back({value, file, line + n});
+        }
+    }
+    fclose(f);
+
+    std::sort(snapshot->dsos.begin(), snapshot->dsos.end(),
+              [](const Dso& a, const Dso& b) { return a.base < b.base; });
+    if (snapshot->ticks_per_second == 0 || snapshot->threads.empty()) {
+        fprintf(stderr, "ipt-decode: %s is not an ipt-capture snapshot\n", path);
+        return false;
+    }
+    return true;
+}
+
+// Processor trace packets, see chapter 35.4 of volume 3 of the Intel
+// Software Developer's Manual.
+
+// Where a thread was at some point in time.
+struct Event {
+    uint64_t tsc;
+    uint64_t ip;
+};
+
+class Decoder {
+public:
+    Decoder(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    // Decode everything after the first packet stream boundary into
+    // |events|, in order. Returns the number of times tracing stopped and
+    // restarted, which is when the thread was switched out, or was in the
+    // kernel when that isn't traced.
+    size_t Decode(std::vector<Event>* events);
+
+    // The number of bytes that made no sense, after which the decoder
+    // skipped to the next packet stream boundary.
+    size_t errors() const { return errors_; }
+
+private:
+    bool Sync();
+    bool DecodeIp(uint8_t header, uint64_t* ip, size_t* len);
+    void Emit(uint64_t ip, std::vector<Event>* events);
+    void Stamp(uint64_t tsc, std::vector<Event>* events);
+
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_ = 0;
+    size_t errors_ = 0;
+
+    uint64_t last_ip_ = 0;
+    uint64_t tsc_ = 0;
+    // Events since the last TSC packet get times spread out evenly until the
+    // next one.
+    size_t unstamped_ = 0;
+};
+
+const uint8_t kPsb[16] = {0x02, 0x82, 0x02, 0x82, 0x02, 0x82, 0x02, 0x82,
+                          0x02, 0x82, 0x02, 0x82, 0x02, 0x82, 0x02, 0x82};
+
+bool Decoder::Sync() {
+    for (; pos_ + sizeof(kPsb) <= size_; ++pos_) {
+        if (memcmp(&data_[pos_], kPsb, sizeof(kPsb)) == 0)
+            return true;
+    }
+    pos_ = size_;
+    return false;
+}
+
+bool Decoder::DecodeIp(uint8_t header, uint64_t* ip, size_t* len) {
+    static const size_t kPayloadSize[8] = {0, 2, 4, 6, 6, 0, 8, 0};
+    uint8_t ip_bytes = header >> 5;
+    size_t size = kPayloadSize[ip_bytes];
+    *len = 1 + size;
+    if ((ip_bytes == 5 || ip_bytes == 7) || pos_ + *len > size_)
+        return false;
+
+    uint64_t payload = 0;
+    for (size_t i = 0; i < size; ++i)
+        payload |= static_cast<uint64_t>(data_[pos_ + 1 + i]) << (8 * i);
+
+    switch (ip_bytes) {
+    case 0: // Suppressed, out of context.
+        *ip = 0;
+        return true;
+    case 1:
+        *ip = (last_ip_ & ~UINT64_C(0xffff)) | payload;
+        break;
+    case 2:
+        *ip = (last_ip_ & ~UINT64_C(0xffffffff)) | payload;
+        break;
+    case 3: // Sign extended.
+        *ip = (payload & (UINT64_C(1) << 47)) ? payload | ~((UINT64_C(1) << 48) - 1) : payload;
+        break;
+    case 4:
+        *ip = (last_ip_ & ~((UINT64_C(1) << 48) - 1)) | payload;
+        break;
+    case 6:
+        *ip = payload;
+        break;
+    }
+    last_ip_ = *ip;
+    return true;
+}
+
+void Decoder::Emit(uint64_t ip, std::vector<Event>* events) {
+    if (ip == 0)
+        return;
+    events->push_back({tsc_, ip});
+    ++unstamped_;
+}
+
+void Decoder::Stamp(uint64_t tsc, std::vector<Event>* events) {
+    if (tsc_ != 0 && tsc > tsc_ && unstamped_ > 0) {
+        uint64_t step = (tsc - tsc_) / (unstamped_ + 1);
+        size_t first = events->size() - unstamped_;
+        for (size_t i = 0; i < unstamped_; ++i)
+            (*events)[first + i].tsc = tsc_ + step * (i + 1);
+    }
+    unstamped_ = 0;
+    tsc_ = tsc;
+}
+
+size_t Decoder::Decode(std::vector<Event>* events) {
+    size_t gaps = 0;
+    if (!Sync())
+        return 0;
+
+    while (pos_ < size_) {
+        uint8_t b = data_[pos_];
+        size_t len = 0;
+        uint64_t ip;
+
+        if (b == 0x00) { // PAD
+            len = 1;
+        } else if (b == 0x02) { // Extended opcodes.
+            if (pos_ + 2 > size_)
+                break;
+            uint8_t e = data_[pos_ + 1];
+            if (e == 0x82) { // PSB, the IP compression state is reset.
+                len = sizeof(kPsb);
+                last_ip_ = 0;
+            } else if (e == 0x23 || e == 0xf3 || e == 0x83 || e == 0x62 || e == 0xe2) {
+                len = 2; // PSBEND, OVF, TraceStop, EXSTOP
+            } else if (e == 0x03 || e == 0x22) {
+                len = 4; // CBR, PWRE
+            } else if (e == 0x43 || e == 0xa3) {
+                len = 8; // PIP, long TNT
+            } else if (e == 0x73 || e == 0xc8 || e == 0xa2) {
+                len = 7; // TMA, VMCS, PWRX
+            } else if (e == 0xc2) {
+                len = 10; // MWAIT
+            } else if (e == 0xc3) {
+                len = 11; // MNT
+            } else if ((e & 0x1f) == 0x12) {
+                len = 2 + (((e >> 5) & 3) == 0 ? 4 : 8); // PTW
+            }
+        } else if (b == 0x19) { // TSC
+            len = 8;
+            if (pos_ + len <= size_) {
+                uint64_t tsc = 0;
+                for (size_t i = 0; i < 7; ++i)
+                    tsc |= static_cast<uint64_t>(data_[pos_ + 1 + i]) << (8 * i);
+                Stamp(tsc, events);
+            }
+        } else if (b == 0x59 || b == 0x99) { // MTC, MODE
+            len = 2;
+        } else if ((b & 0x1f) == 0x0d || (b & 0x1f) == 0x11 || (b & 0x1f) == 0x1d) {
+            // TIP, TIP.PGE, FUP
+            if (DecodeIp(b, &ip, &len))
+                Emit(ip, events);
+            else
+                len = 0;
+        } else if ((b & 0x1f) == 0x01) { // TIP.PGD
+            if (DecodeIp(b, &ip, &len)) {
+                Emit(ip, events);
+                // Nothing happened in between, don't spread times over it.
+                unstamped_ = 0;
+                ++gaps;
+            } else {
+                len = 0;
+            }
+        } else if ((b & 3) == 3) { // CYC
+            len = 1;
+            if (b & 4) {
+                while (pos_ + len < size_ && (data_[pos_ + len] & 1))
+                    ++len;
+                ++len;
+            }
+        } else if ((b & 1) == 0) { // short TNT
+            len = 1;
+        }
+
+        if (len == 0 || pos_ + len > size_) {
+            ++errors_;
+            ++pos_;
+            if (!Sync())
+                break;
+            continue;
+        }
+        pos_ += len;
+    }
+    return gaps;
+}
+
+// Functions and the timeline.
+
+struct Options {
+    std::vector<std::string> dirs;
+    double slice_us = 100;
+    size_t top = 20;
+    size_t slice_top = 3;
+};
+
+// What a function is called, as precisely as the binaries allow.
+std::string function_name(const Snapshot& snapshot, uint64_t ip) {
+    char buf[64];
+    if (ip >> 63)
+        return "<kernel>";
+
+    auto it = std::upper_bound(snapshot.dsos.begin(), snapshot.dsos.end(), ip,
+                               [](uint64_t ip, const Dso& dso) { return ip < dso.base; });
+    if (it == snapshot.dsos.begin()) {
+        snprintf(buf, sizeof(buf), "%#" PRIx64, ip);
+        return buf;
+    }
+    const Dso& dso = *--it;
+    uint64_t offset = ip - dso.base;
+    if (dso.binary) {
+        uint64_t vaddr = offset + dso.binary->load_vaddr;
+        const auto& symbols = dso.binary->symbols;
+        auto sym = std::upper_bound(symbols.begin(), symbols.end(), vaddr,
+                                    [](uint64_t v, const Symbol& s) { return v < s.addr; });
+        if (sym != symbols.begin()) {
+            --sym;
+            if (sym->size == 0 || vaddr < sym->addr + sym->size)
+                return sym->name;
+        }
+    }
+    // The symbolize script can make something of these.
+    snprintf(buf, sizeof(buf), "+%#" PRIx64, offset);
+    return dso.name + buf;
+}
+
+typedef std::vector<std::pair<std::string, size_t>> Counts;
+
+Counts hottest(const std::map<std::string, size_t>& counts) {
+    Counts sorted(counts.begin(), counts.end());
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const Counts::value_type& a, const Counts::value_type& b) {
+                         return a.second > b.second;
+                     });
+    return sorted;
+}
+
+void report_thread(const Snapshot& snapshot, const ThreadTrace& thread,
+                   const std::string& dir, const Options& options) {
+    std::string path = dir + "/" + thread.file;
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+        fprintf(stderr, "ipt-decode: unable to open %s: %s\n", path.c_str(), strerror(errno));
+        return;
+    }
+    std::vector<uint8_t> data;
+    uint8_t buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        data.insert(data.end(), buf, buf + n);
+    fclose(f);
+
+    Decoder decoder(data.data(), data.size());
+    std::vector<Event> events;
+    size_t gaps = decoder.Decode(&events);
+
+    printf("\nthread %" PRIu64 " %s: ", thread.tid, thread.name.c_str());
+    // Events before the first timestamp can't be placed in time.
+    auto first = std::find_if(events.begin(), events.end(),
+                              [](const Event& e) { return e.tsc != 0; });
+    if (first == events.end()) {
+        printf("no trace\n");
+        return;
+    }
+    double ticks_per_us = static_cast<double>(snapshot.ticks_per_second) / 1e6;
+    uint64_t start = first->tsc;
+    uint64_t end = events.back().tsc;
+    printf("%zu branches over %.3f ms, tracing stopped %zu times",
+           static_cast<size_t>(events.end() - first),
+           static_cast<double>(end - start) / ticks_per_us / 1000, gaps);
+    if (decoder.errors())
+        printf(", %zu decode errors", decoder.errors());
+    printf("\n");
+
+    // The names of the ips, looked up once each.
+    std::map<uint64_t, std::string> names;
+    std::map<std::string, size_t> totals;
+    for (auto e = first; e != events.end(); ++e) {
+        auto it = names.find(e->ip);
+        if (it == names.end())
+            it = names.emplace(e->ip, function_name(snapshot, e->ip)).first;
+        totals[it->second]++;
+    }
+
+    size_t count = events.end() - first;
+    Counts hot = hottest(totals);
+    printf("hottest functions:\n");
+    for (size_t i = 0; i < hot.size() && i < options.top; ++i) {
+        printf("  %5.1f%%  %s\n", 100.0 * static_cast<double>(hot[i].second) / count,
+               hot[i].first.c_str());
+    }
+
+    printf("timeline, %.0f us slices:\n", options.slice_us);
+    uint64_t slice_ticks = std::max<uint64_t>(1, static_cast<uint64_t>(options.slice_us *
+                                                                        ticks_per_us));
+    for (auto e = first; e != events.end();) {
+        uint64_t slice = (e->tsc - start) / slice_ticks;
+        std::map<std::string, size_t> counts;
+        size_t in_slice = 0;
+        for (; e != events.end() && (e->tsc - start) / slice_ticks == slice; ++e) {
+            counts[names[e->ip]]++;
+            ++in_slice;
+        }
+        printf("  %+10.3f ms %6zu ", static_cast<double>(slice * slice_ticks) / ticks_per_us / 1000,
+               in_slice);
+        Counts top = hottest(counts);
+        for (size_t i = 0; i < top.size() && i < options.slice_top; ++i) {
+            printf(" %s %.0f%%", top[i].first.c_str(),
+                   100.0 * static_cast<double>(top[i].second) / in_slice);
+        }
+        printf("\n");
+    }
+}
+
+void usage() {
+    fprintf(stderr,
+            "Usage: ipt-decode [options] <snapshot.txt>\n"
+            "Decodes the per-thread Intel PT snapshot written by ipt-capture, and prints\n"
+            "the hottest functions of each thread and a timeline of what it was doing.\n"
+            "The trace files are looked for next to <snapshot.txt>.\n"
+            "Options:\n"
+            "  -s <dir>     look for unstripped binaries by build ID under <dir>,\n"
+            "               e.g. the build directory; may be repeated\n"
+            "  -b <us>      timeline slice width in microseconds (default 100)\n"
+            "  -n <count>   how many of the hottest functions to print (default 20)\n"
+            "  -m <count>   how many functions to print per slice (default 3)\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:b:n:m:h")) != -1) {
+        switch (opt) {
+        case 's':
+            options.dirs.push_back(optarg);
+            break;
+        case 'b':
+            options.slice_us = strtod(optarg, nullptr);
+            break;
+        case 'n':
+            options.top = strtoul(optarg, nullptr, 0);
+            break;
+        case 'm':
+            options.slice_top = strtoul(optarg, nullptr, 0);
+            break;
+        default:
+            usage();
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind != argc - 1 || options.slice_us <= 0) {
+        usage();
+        return 1;
+    }
+
+    const char* path = argv[optind];
+    Snapshot snapshot;
+    if (!read_snapshot(path, &snapshot))
+        return 1;
+    std::string dir(path);
+    size_t slash = dir.rfind('/');
+    dir = slash == std::string::npos ? "." : dir.substr(0, slash);
+
+    std::map<std::string, Binary> binaries;
+    for (const auto& dso : snapshot.dsos)
+        binaries[dso.build_id];
+    size_t remaining = binaries.size();
+    for (const auto& d : options.dirs)
+        find_binaries(d, &binaries, &remaining);
+
+    for (auto& dso : snapshot.dsos) {
+        Binary* binary = &binaries[dso.build_id];
+        if (binary->path.empty()) {
+            printf("dso %s: no binary with build ID %s\n", dso.name.c_str(),
+                   dso.build_id.c_str());
+            continue;
+        }
+        if (binary->symbols.empty() && !load_symbols(binary)) {
+            printf("dso %s: unable to read %s\n", dso.name.c_str(), binary->path.c_str());
+            continue;
+        }
+        dso.binary = binary;
+    }
+
+    for (const auto& thread : snapshot.threads)
+        report_thread(snapshot, thread, dir, options);
+    return 0;
+}
@@ -59,9 +59,10 @@ struct item {
     fsentry_t* first;
     fsentry_t* last;
 
-    // size of header and total output size
+    // size of header, hash index and total output size
     // used by bootfs items
     size_t hdrsize;
+    size_t hashsize;
     size_t outsize;
 
     // Used only by ITEM_PLATFORM_ID items.
@@ -697,11 +698,31 @@ fail:
         bootfs_header_t hdr = {
             .magic = BOOTFS_MAGIC,
             .dirsize = item->hdrsize - sizeof(bootfs_header_t),
+            .hashsize = item->hashsize,
         };
         CHECK(op->write(fd, &hdr, sizeof(hdr), cookie, &crc));
     }
+    bootfs_hash_t* hash = NULL;
+    if (item->hashsize) {
+        if ((hash = calloc(1, item->hashsize)) == NULL) {
+            fprintf(stderr, "error: out of memory\n");
+            return -1;
+        }
+        hash->slot_count = (item->hashsize - sizeof(bootfs_hash_t)) / sizeof(uint32_t);
+    }
+    uint32_t diroff = 0;
     fsentry_t* last_entry = NULL;
     for (e = item->first; e != NULL; e = e->next) {
+        if (hash) {
+            uint32_t mask = hash->slot_count - 1;
+            uint32_t slot = bootfs_hash_name(e->name, e->namelen - 1) & mask;
+            while (hash->slot[slot] != 0) {
+                slot = (slot + 1) & mask;
+            }
+            hash->slot[slot] = diroff + 1;
+        }
+        diroff += sizeof(bootfs_entry_t) + BOOTFS_ALIGN(e->namelen);
+
         bootfs_entry_t entry = {
             .name_len = e->namelen,
             .data_len = e->length,
@@ -717,7 +738,12 @@ fail:
     // Record length of last file
     uint32_t last_length = last_entry ? last_entry->length : 0;
 
-    if ((n = PAGEFILL(item->hdrsize))) {
+    if (hash) {
+        int r = op->write(fd, hash, item->hashsize, cookie, &crc);
+        free(hash);
+        CHECK(r);
+    }
+    if ((n = PAGEFILL(item->hdrsize + item->hashsize))) {
         CHECK(op->write(fd, fill, n, cookie, &crc));
     }
 
@@ -1324,7 +1350,19 @@ int main(int argc, char **argv) {
         case ITEM_BOOTFS_SYSTEM:
             // account for the bootfs header record
             item->hdrsize += sizeof(bootfs_header_t);
-            size_t off = PAGEALIGN(item->hdrsize);
+            // and the hash index, kept at most half full
+            size_t count = 0;
+            for (fsentry_t* e = item->first; e != NULL; e = e->next) {
+                count++;
+            }
+            if (count > 0) {
+                size_t slots = 1;
+                while (slots < count * 2) {
+                    slots *= 2;
+                }
+                item->hashsize = sizeof(bootfs_hash_t) + slots * sizeof(uint32_t);
+            }
+            size_t off = PAGEALIGN(item->hdrsize + item->hashsize);
             fsentry_t* last_entry = NULL;
             for (fsentry_t* e = item->first; e != NULL; e = e->next) {
                 e->offset = off;
@@ -9,6 +9,7 @@ HOSTAPPS := \
 	$(LOCAL_DIR)/bootserver/rules.mk \
 	$(LOCAL_DIR)/fidl/rules.mk \
 	$(LOCAL_DIR)/fvm/rules.mk \
+	$(LOCAL_DIR)/ipt-decode/rules.mk \
 	$(LOCAL_DIR)/kernel-buildsig/rules.mk \
 	$(LOCAL_DIR)/loglistener/rules.mk \
 	$(LOCAL_DIR)/mdi/rules.mk \
@@ -209,6 +209,8 @@ __END_CDECLS;
 //   data offset (32bit le)
 //   namedata   (namelength bytes, includes \0)
 //
+// Optionally followed by a bootfs_hash_t (see below)
+//
 // - data offsets must be page aligned (multiple of 4096)
 // - entries start on uint32 boundaries
 
@@ -225,8 +227,10 @@ typedef struct bootfs_header {
     // does not include the size of the bootfs_header_t
     uint32_t dirsize;
 
-    // 0, 0
-    uint32_t reserved0;
+    // size of the bootfs_hash_t following the entries, or 0 if none
+    uint32_t hashsize;
+
+    // 0
     uint32_t reserved1;
 } bootfs_header_t;
 
@@ -241,4 +245,26 @@ typedef struct bootfs_entry {
 #define BOOTFS_RECSIZE(entry) \
     (sizeof(bootfs_entry_t) + BOOTFS_ALIGN(entry->name_len))
 
+// The hash index lets readers find an entry by name without walking
+// the directory.  It is an open-addressed table of |slot_count| slots
+// (a power of two); a slot holds 0 for empty, or one more than the
+// offset of an entry from the start of the directory.  An entry named
+// N is in the first slot, probing linearly from
+// bootfs_hash_name(N) & (slot_count - 1), that is either empty or
+// holds an entry named N.  Entries with the same name are in directory
+// order, so lookups find the same entry as a walk of the directory.
+typedef struct bootfs_hash {
+    uint32_t slot_count;
+    uint32_t slot[];
+} bootfs_hash_t;
+
+// FNV-1a over the |len| bytes of |name| (not including the \0)
+static inline uint32_t bootfs_hash_name(const char* name, uint32_t len) {
+    uint32_t h = 2166136261u;
+    while (len-- > 0) {
+        h = (h ^ (uint8_t)*name++) * 16777619u;
+    }
+    return h;
+}
+
 #endif
@@ -36,6 +36,7 @@ typedef enum audio_cmd {
     AUDIO_RB_CMD_GET_BUFFER         = 0x3001,
     AUDIO_RB_CMD_START              = 0x3002,
     AUDIO_RB_CMD_STOP               = 0x3003,
+    AUDIO_RB_CMD_GET_POSITION_BUFFER = 0x3004,
 
     // Async notifications sent on the ring buffer channel.
     AUDIO_RB_POSITION_NOTIFY        = 0x4000,
@@ -339,6 +340,35 @@ typedef struct audio_rb_cmd_stop_resp {
     zx_status_t     result;
 } audio_rb_cmd_stop_resp_t;
 
+// AUDIO_RB_CMD_GET_POSITION_BUFFER
+//
+// Optional.  Drivers whose hardware writes its DMA position to memory may
+// share that memory with the client, allowing the client to poll the ring
+// buffer position without sending a request or waiting for a position
+// notification.  Drivers which cannot do this fail the request; clients
+// should fall back to position notifications.
+//
+// May be not used with the NO_ACK flag.
+typedef struct audio_rb_cmd_get_position_buffer_req {
+    audio_cmd_hdr_t hdr;
+} audio_rb_cmd_get_position_buffer_req_t;
+
+typedef struct audio_rb_cmd_get_position_buffer_resp {
+    audio_cmd_hdr_t hdr;
+    zx_status_t     result;
+
+    // The byte offset into the VMO of the little-endian uint32_t which holds
+    // the current position (in bytes) of the hardware's read (output) or write
+    // (input) pointer in the ring buffer.
+    uint32_t offset;
+
+    // NOTE: If result == ZX_OK, a read-only VMO handle will be returned as
+    // well.  The VMO may be shared by several streams of the same device and
+    // contains nothing but DMA positions.  The position is updated by the
+    // hardware as it moves data and is only meaningful while the ring buffer
+    // is started.
+} audio_rb_cmd_get_position_buffer_resp_t;
+
 // AUDIO_RB_POSITION_NOTIFY
 typedef struct audio_rb_position_notify {
     audio_cmd_hdr_t hdr;
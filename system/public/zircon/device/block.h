@@ -78,11 +78,19 @@
 // since it will allow "activating" updated partitions.
 #define IOCTL_BLOCK_FVM_UPGRADE \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_BLOCK, 17)
+// Set the priority and budget of the currently running FIFO server
+#define IOCTL_BLOCK_FIFO_SET_POLICY \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_BLOCK, 18)
+// Get the policy and statistics of the currently running FIFO server
+#define IOCTL_BLOCK_FIFO_GET_STATS \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_BLOCK, 19)
 
 // Block Core ioctls (specific to each block device):
 
 #define BLOCK_FLAG_READONLY 0x00000001
 #define BLOCK_FLAG_REMOVABLE 0x00000002
+#define BLOCK_FLAG_ROTATIONAL 0x00000004 // Seeks are expensive
+#define BLOCK_FLAG_TRIM_SUPPORT 0x00000008 // Accepts BLOCKIO_TRIM
 
 typedef struct {
     uint64_t block_count;       // The number of blocks in this block device
@@ -142,6 +150,39 @@ IOCTL_WRAPPER_IN(ioctl_block_free_txn, IOCTL_BLOCK_FREE_TXN, txnid_t);
 // ssize_t ioctl_block_fifo_close(int fd);
 IOCTL_WRAPPER(ioctl_block_fifo_close, IOCTL_BLOCK_FIFO_CLOSE);
 
+// The priority of a FIFO client limits how many of its requests may be at the
+// device at once, leaving room for the requests of other clients sharing it.
+#define BLOCK_PRIORITY_FOREGROUND 0 // No limit
+#define BLOCK_PRIORITY_BACKGROUND 1 // A few requests at a time
+#define BLOCK_PRIORITY_IDLE       2 // One request at a time
+
+typedef struct {
+    uint32_t priority;
+    uint32_t reserved;
+    uint64_t max_iops;          // Requests per second, or 0 for no limit
+    uint64_t max_bytes_per_sec; // Or 0 for no limit
+} block_fifo_policy_t;
+
+typedef struct {
+    block_fifo_policy_t policy;
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+    uint64_t errors;
+    uint64_t throttled;    // Requests which waited on the policy before going to the device
+    uint64_t throttled_ns; // Total time spent waiting
+    uint64_t max_inflight; // Most requests at the device at once
+    uint64_t trims;
+    uint64_t bytes_trimmed;
+} block_fifo_stats_t;
+
+// ssize_t ioctl_block_fifo_set_policy(int fd, const block_fifo_policy_t* in);
+IOCTL_WRAPPER_IN(ioctl_block_fifo_set_policy, IOCTL_BLOCK_FIFO_SET_POLICY, block_fifo_policy_t);
+
+// ssize_t ioctl_block_fifo_get_stats(int fd, block_fifo_stats_t* out);
+IOCTL_WRAPPER_OUT(ioctl_block_fifo_get_stats, IOCTL_BLOCK_FIFO_GET_STATS, block_fifo_stats_t);
+
 #define GUID_LEN 16
 #define NAME_LEN 24
 #define MAX_FVM_VSLICE_REQUESTS 16
@@ -226,7 +267,7 @@ IOCTL_WRAPPER_IN(ioctl_block_fvm_upgrade, IOCTL_BLOCK_FVM_UPGRADE, upgrade_req_t
 //    This response is sent once all operations either complete or a single operation fails.
 //    At this point, step (1) may begin again without reallocating the txn.
 //
-// For BLOCKIO_READ and BLOCKIO_WRITE, N may be greater than 1.
+// For BLOCKIO_READ, BLOCKIO_WRITE and BLOCKIO_TRIM, N may be greater than 1.
 // Otherwise, N == 1 (skipping step (1) in the protocol above).
 //
 // Notes:
@@ -253,11 +294,19 @@ IOCTL_WRAPPER_IN(ioctl_block_fvm_upgrade, IOCTL_BLOCK_FVM_UPGRADE, upgrade_req_t
 // 'dev_offset', into the VMO associated with 'vmoid', starting at 'vmo_offset'.
 // If the transaction is out of range, for example if 'length' is too large or if
 // 'dev_offset' is beyond the end of the device, ZX_ERR_OUT_OF_RANGE is returned.
+//
+// BLOCKIO_TRIM tells the device that the 'length' bytes at 'dev_offset' no longer hold
+// data anyone needs, so that it may reclaim the space. It uses no VMO, and 'vmoid' and
+// 'vmo_offset' are ignored. Reads of trimmed blocks return unspecified data until the
+// blocks are written again. Devices without BLOCK_FLAG_TRIM_SUPPORT fail it with
+// ZX_ERR_NOT_SUPPORTED. Trims within a txn may be reordered against the txn's other
+// requests, so a client must not trim and write the same blocks in one txn.
 
 #define BLOCKIO_READ 0x0001      // Reads from the Block device into the VMO
 #define BLOCKIO_WRITE 0x0002     // Writes to the Block device from the VMO
 #define BLOCKIO_SYNC 0x0003      // Unimplemented
 #define BLOCKIO_CLOSE_VMO 0x0004 // Detaches the VMO from the block device; closes the handle to it.
+#define BLOCKIO_TRIM 0x0005      // Discards blocks which no longer hold data
 #define BLOCKIO_OP_MASK 0x00FF
 
 #define BLOCKIO_TXN_END 0x0100 // Expects response after request (and all previous) have completed
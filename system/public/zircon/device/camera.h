@@ -16,6 +16,7 @@ typedef enum camera_cmd {
     // Commands sent on the stream channel.
     CAMERA_STREAM_CMD_GET_FORMATS      = 0x1000,
     CAMERA_STREAM_CMD_SET_FORMAT       = 0x1001,
+    CAMERA_STREAM_CMD_SET_FRAME_RING   = 0x1002,
 
     // Commands sent on the ring buffer channel
     CAMERA_RB_CMD_GET_DATA_BUFFER      = 0x2000,
@@ -134,6 +135,54 @@ typedef struct camera_stream_cmd_set_format_resp {
     // be returned.
 } camera_stream_cmd_set_format_resp_t;
 
+// CAMERA_STREAM_CMD_SET_FRAME_RING
+//
+// Sent by the client along with a VMO handle to have frames written straight
+// into client memory. The VMO is divided into slot_count slots of slot_size
+// bytes, and every slot starts out owned by the driver. slot_size must be at
+// least the maximum frame size, which is reported in the response; slot_count
+// may not exceed CAMERA_FRAME_RING_MAX_SLOTS.
+//
+// Once a frame ring is set, CAMERA_RB_CMD_START and CAMERA_RB_CMD_STOP are
+// accepted on the stream channel to start and stop capture.
+#define CAMERA_FRAME_RING_MAX_SLOTS (64u)
+
+typedef struct camera_stream_cmd_set_frame_ring_req {
+    camera_cmd_hdr_t hdr;
+    uint32_t slot_size;
+    uint32_t slot_count;
+} camera_stream_cmd_set_frame_ring_req_t;
+
+typedef struct camera_stream_cmd_set_frame_ring_resp {
+    camera_cmd_hdr_t hdr;
+    zx_status_t result;
+    uint32_t max_frame_size;
+
+    // NOTE: If result == ZX_OK, a fifo handle with camera_frame_notify_t
+    // elements will be returned as well. The driver writes an element for
+    // every completed frame, handing the slot over to the client. The client
+    // hands a slot back by writing an element with |slot| set; the other
+    // fields are ignored. When no slot is free, frames are dropped.
+} camera_stream_cmd_set_frame_ring_resp_t;
+
+typedef struct camera_frame_notify {
+    uint32_t frame_number;
+    uint32_t slot;
+    // Number of bytes of frame data at the start of the slot.
+    uint32_t frame_size;
+    uint32_t reserved;
+    // ZX_CLOCK_MONOTONIC time at which the last payload of the frame arrived.
+    zx_time_t timestamp;
+    // From the payload headers, in units of the device clock frequency.
+    uint32_t presentation_timestamp;
+    uint32_t source_time_clock;
+    // Running totals of frames dropped because they had errors or no slot
+    // was free, and of frames that completed more than half a frame interval
+    // late.
+    uint32_t dropped_frames;
+    uint32_t late_frames;
+} camera_frame_notify_t;
+
 // CAMERA_RB_CMD_GET_DATA_BUFFER
 typedef struct camera_rb_cmd_get_data_buffer_req {
     camera_cmd_hdr_t hdr;
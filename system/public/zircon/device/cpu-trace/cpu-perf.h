@@ -67,8 +67,10 @@ typedef enum {
   CPUPERF_RECORD_VALUE = 4,
   // The record is a |cpuperf_pc_record_t|.
   CPUPERF_RECORD_PC = 5,
+  // The record is a |cpuperf_callstack_record_t|.
+  CPUPERF_RECORD_CALLSTACK = 6,
   // non-ABI
-  CPUPERF_NUM_RECORD_TYPES = 6,
+  CPUPERF_NUM_RECORD_TYPES = 7,
 } cpuperf_record_type_t;
 
 // Trace buffer space is expensive, we want to keep records small.
@@ -174,6 +176,34 @@ typedef struct {
     uint64_t pc;
 } __PACKED cpuperf_pc_record_t;
 
+// The most return addresses a |cpuperf_callstack_record_t| holds.
+#define CPUPERF_MAX_CALLSTACK_FRAMES 16
+
+// Record the thread that was running, its pc, and the return addresses of
+// the innermost frames of its user stack.
+// Like |cpuperf_pc_record_t| this also indicates that the event reached
+// its tick point, and it is expected to follow a TIME record.
+// This is used when doing continuous profiling: the koids identify the
+// process to symbolize |pc| and |frames| against.
+// Unlike the other records this one varies in size: it is followed by
+// |num_frames| uint64_t return addresses, innermost first, for a total of
+// CPUPERF_CALLSTACK_RECORD_SIZE(|num_frames|) bytes.
+// The frames are found by following the frame pointer chain, so code built
+// without frame pointers ends it early. They are only collected when |pc|
+// is in userspace; if the kernel was running |num_frames| is zero.
+typedef struct {
+    cpuperf_record_header_t header;
+    uint32_t num_frames;
+    // The process and thread koids, ZX_KOID_INVALID if the cpu was running
+    // a kernel thread.
+    uint64_t pid;
+    uint64_t tid;
+    uint64_t pc;
+} __PACKED cpuperf_callstack_record_t;
+
+#define CPUPERF_CALLSTACK_RECORD_SIZE(num_frames) \
+    (sizeof(cpuperf_callstack_record_t) + (num_frames) * sizeof(uint64_t))
+
 // The properties of this system.
 typedef struct {
     // S/W API version = CPUPERF_API_VERSION.
@@ -229,6 +259,8 @@ typedef struct {
 // record (depending on what the event is).
 // It is an error to have this bit set for an event and have rate[0] be zero.
 #define CPUPERF_CONFIG_FLAG_TIMEBASE0 (1u << 3)
+// Collect the thread, pc and user callstack, in place of aspace+pc values.
+#define CPUPERF_CONFIG_FLAG_CALLSTACK (1u << 4)
 } cpuperf_config_t;
 
 ///////////////////////////////////////////////////////////////////////////////
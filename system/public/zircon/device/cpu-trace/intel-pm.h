@@ -330,13 +330,15 @@ typedef struct {
     uint32_t fixed_flags[IPM_MAX_FIXED_COUNTERS];
     uint32_t programmable_flags[IPM_MAX_PROGRAMMABLE_COUNTERS];
     uint32_t misc_flags[IPM_MAX_MISC_EVENTS];
-// Both of IPM_CONFIG_FLAG_{PC,TIMEBASE} cannot be set.
-#define IPM_CONFIG_FLAG_MASK     0x3
+// Both of IPM_CONFIG_FLAG_{PC,TIMEBASE} cannot be set, nor PC and CALLSTACK.
+#define IPM_CONFIG_FLAG_MASK      0x7
 // Collect aspace+pc values.
-#define IPM_CONFIG_FLAG_PC       (1u << 0)
+#define IPM_CONFIG_FLAG_PC        (1u << 0)
 // Collect this event's value when |timebase_id| counter's data is collected.
 // While redundant, it is ok to set this for the |timebase_id| counter.
-#define IPM_CONFIG_FLAG_TIMEBASE (1u << 1)
+#define IPM_CONFIG_FLAG_TIMEBASE  (1u << 1)
+// Collect the thread, pc and user callstack.
+#define IPM_CONFIG_FLAG_CALLSTACK (1u << 2)
 
     // IA32_PERFEVTSEL_*
     uint64_t programmable_events[IPM_MAX_PROGRAMMABLE_COUNTERS];
@@ -185,6 +185,10 @@ typedef struct {
 // trace specific threads
 #define IPT_MODE_THREADS 1
 
+// The most threads that can be traced at once in IPT_MODE_THREADS. Each one
+// is traced into a buffer of its own.
+#define IPT_MAX_NUM_THREAD_TRACES 32
+
 ///////////////////////////////////////////////////////////////////////////////
 
 #ifdef __Fuchsia__
@@ -234,6 +238,8 @@ typedef struct {
 // Output: trace buffer descriptor (think file descriptor for trace buffers)
 // When tracing cpus, buffers are auto-assigned to cpus: the resulting trace
 // buffer descriptor is the number of the cpu using the buffer.
+// When tracing threads, a buffer is assigned to a thread with
+// IOCTL_IPT_ASSIGN_BUFFER_THREAD.
 #define IOCTL_IPT_ALLOC_BUFFER \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_IPT, 3)
 IOCTL_WRAPPER_INOUT(ioctl_ipt_alloc_buffer, IOCTL_IPT_ALLOC_BUFFER, ioctl_ipt_buffer_config_t, uint32_t);
@@ -315,6 +321,21 @@ IOCTL_WRAPPER(ioctl_ipt_start, IOCTL_IPT_START);
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_IPT, 11)
 IOCTL_WRAPPER(ioctl_ipt_stop, IOCTL_IPT_STOP);
 
+// stop tracing into one buffer while the others carry on, when tracing threads
+// The buffer's info and contents can then be read. With a circular buffer
+// this snapshots the latest activity of its thread, e.g. right after the
+// thread was seen to take too long.
+// Input: trace buffer descriptor
+#define IOCTL_IPT_SNAPSHOT_BUFFER \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_IPT, 12)
+IOCTL_WRAPPER_IN(ioctl_ipt_snapshot_buffer, IOCTL_IPT_SNAPSHOT_BUFFER, uint32_t);
+
+// resume tracing into a buffer after IOCTL_IPT_SNAPSHOT_BUFFER
+// Input: trace buffer descriptor
+#define IOCTL_IPT_RESUME_BUFFER \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_IPT, 13)
+IOCTL_WRAPPER_IN(ioctl_ipt_resume_buffer, IOCTL_IPT_RESUME_BUFFER, uint32_t);
+
 #endif // __Fuchsia__
 
 __END_CDECLS
@@ -59,11 +59,82 @@ typedef struct zx_display_info {
 #define IOCTL_DISPLAY_SET_OWNER \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_DISPLAY, 6)
 
+// Import a vmo as an image that can be presented with page flips,
+// instead of being copied into the framebuffer.  The vmo must hold one
+// full frame in the display's mode (stride * height * pixelsize bytes).
+// Not all displays support this.
+//   in: zx_handle_t (vmo)
+//   out: uint64_t (image id)
+#define IOCTL_DISPLAY_IMPORT_IMAGE \
+    IOCTL(IOCTL_KIND_SET_HANDLE, IOCTL_FAMILY_DISPLAY, 7)
+
+// Release an imported image.  If the image is on screen, the display
+// goes back to scanning out the framebuffer.
+//   in: uint64_t (image id)
+//   out: none
+#define IOCTL_DISPLAY_RELEASE_IMAGE \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_DISPLAY, 8)
+
+// Scan out an imported image, starting at the next vblank.  Presenting
+// again before then replaces the pending image, which is never shown.
+// The client must not draw into an image between presenting it and the
+// present completing for a different image.
+//   in: uint64_t (image id)
+//   out: none
+#define IOCTL_DISPLAY_PRESENT_IMAGE \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_DISPLAY, 9)
+
+// Get a channel on which a display_present_info_t is written each time
+// a presented image reaches the screen.
+//   in: none
+//   out: zx_handle_t
+#define IOCTL_DISPLAY_GET_PRESENT_CHANNEL \
+    IOCTL(IOCTL_KIND_GET_HANDLE, IOCTL_FAMILY_DISPLAY, 10)
+
+// Show an imported image on an overlay plane, or hide the overlay.  Like
+// IOCTL_DISPLAY_PRESENT_IMAGE, this takes effect at the next vblank, along
+// with any image presented before it.  Fails with ZX_ERR_OUT_OF_RANGE for
+// an overlay the display doesn't have.  Not all displays support this.
+//   in: ioctl_display_overlay_t
+//   out: none
+#define IOCTL_DISPLAY_SET_OVERLAY \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_DISPLAY, 11)
+
+// Set the hardware cursor image from a vmo holding DISPLAY_CURSOR_SIZE
+// square ZX_PIXEL_FORMAT_ARGB_8888 pixels, and show the cursor.  Not all
+// displays support this.
+//   in: ioctl_display_cursor_t
+//   out: none
+#define IOCTL_DISPLAY_SET_CURSOR \
+    IOCTL(IOCTL_KIND_SET_HANDLE, IOCTL_FAMILY_DISPLAY, 12)
+
+// Move the hotspot of the hardware cursor.
+//   in: ioctl_display_cursor_position_t
+//   out: none
+#define IOCTL_DISPLAY_MOVE_CURSOR \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_DISPLAY, 13)
+
+// Hide the hardware cursor.
+//   in: none
+//   out: none
+#define IOCTL_DISPLAY_HIDE_CURSOR \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_DISPLAY, 14)
+
+// Cursor images are DISPLAY_CURSOR_SIZE pixels square.
+#define DISPLAY_CURSOR_SIZE 64
+
 typedef struct {
     zx_handle_t vmo;
     zx_display_info_t info;
 } ioctl_display_get_fb_t;
 
+typedef struct {
+    uint64_t image_id;
+    // ZX_CLOCK_MONOTONIC time of the vblank at which the image went on
+    // screen.
+    zx_time_t timestamp;
+} display_present_info_t;
+
 typedef struct {
     uint32_t x;
     uint32_t y;
@@ -71,6 +142,33 @@ typedef struct {
     uint32_t height;
 } ioctl_display_region_t;
 
+typedef struct {
+    // Overlays are stacked above the primary image in order, overlay 0
+    // lowest, and the cursor is above them all.
+    uint32_t overlay;
+    uint32_t reserved;
+    // The image to show, or 0 to hide the overlay.
+    uint64_t image_id;
+    // The top left |width| by |height| pixels of the image are shown with
+    // their top left corner at (|x|, |y|), which must be on screen.
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+} ioctl_display_overlay_t;
+
+typedef struct {
+    zx_handle_t vmo;
+    // The pixel in the image that marks the cursor position.
+    uint32_t hot_x;
+    uint32_t hot_y;
+} ioctl_display_cursor_t;
+
+typedef struct {
+    int32_t x;
+    int32_t y;
+} ioctl_display_cursor_position_t;
+
 // ssize_t ioctl_display_get_fb(int fd, ioctl_display_get_fb_t* out);
 IOCTL_WRAPPER_OUT(ioctl_display_get_fb, IOCTL_DISPLAY_GET_FB, ioctl_display_get_fb_t);
 
@@ -87,4 +185,28 @@ IOCTL_WRAPPER_IN(ioctl_display_set_fullscreen, IOCTL_DISPLAY_SET_FULLSCREEN, uin
 IOCTL_WRAPPER_OUT(ioctl_display_get_ownership_change_event, IOCTL_DISPLAY_GET_OWNERSHIP_CHANGE_EVENT, zx_handle_t);
 
 // ssize_t ioctl_display_set_owner(int fd, uint32_t owner);
-IOCTL_WRAPPER_IN(ioctl_display_set_owner, IOCTL_DISPLAY_SET_OWNER, uint32_t)
\ No newline at end of file
+IOCTL_WRAPPER_IN(ioctl_display_set_owner, IOCTL_DISPLAY_SET_OWNER, uint32_t);
+
+// ssize_t ioctl_display_import_image(int fd, const zx_handle_t* in, uint64_t* out);
+IOCTL_WRAPPER_INOUT(ioctl_display_import_image, IOCTL_DISPLAY_IMPORT_IMAGE, zx_handle_t, uint64_t);
+
+// ssize_t ioctl_display_release_image(int fd, const uint64_t* in);
+IOCTL_WRAPPER_IN(ioctl_display_release_image, IOCTL_DISPLAY_RELEASE_IMAGE, uint64_t);
+
+// ssize_t ioctl_display_present_image(int fd, const uint64_t* in);
+IOCTL_WRAPPER_IN(ioctl_display_present_image, IOCTL_DISPLAY_PRESENT_IMAGE, uint64_t);
+
+// ssize_t ioctl_display_get_present_channel(int fd, zx_handle_t* out);
+IOCTL_WRAPPER_OUT(ioctl_display_get_present_channel, IOCTL_DISPLAY_GET_PRESENT_CHANNEL, zx_handle_t);
+
+// ssize_t ioctl_display_set_overlay(int fd, const ioctl_display_overlay_t* in);
+IOCTL_WRAPPER_IN(ioctl_display_set_overlay, IOCTL_DISPLAY_SET_OVERLAY, ioctl_display_overlay_t);
+
+// ssize_t ioctl_display_set_cursor(int fd, const ioctl_display_cursor_t* in);
+IOCTL_WRAPPER_IN(ioctl_display_set_cursor, IOCTL_DISPLAY_SET_CURSOR, ioctl_display_cursor_t);
+
+// ssize_t ioctl_display_move_cursor(int fd, const ioctl_display_cursor_position_t* in);
+IOCTL_WRAPPER_IN(ioctl_display_move_cursor, IOCTL_DISPLAY_MOVE_CURSOR, ioctl_display_cursor_position_t);
+
+// ssize_t ioctl_display_hide_cursor(int fd);
+IOCTL_WRAPPER(ioctl_display_hide_cursor, IOCTL_DISPLAY_HIDE_CURSOR);
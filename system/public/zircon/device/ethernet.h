@@ -22,7 +22,9 @@ typedef struct eth_info_t {
     uint32_t mtu;
     uint8_t mac[6];
     uint8_t pad[2];
-    uint32_t reserved[12];
+    // number of queue pairs a client may open (see GET_QUEUE_FIFOS)
+    uint32_t queue_count;
+    uint32_t reserved[11];
 } eth_info_t;
 
 #define ETH_SIGNAL_STATUS ZX_USER_SIGNAL_0
@@ -33,6 +35,17 @@ typedef struct eth_info_t {
 #define ETH_FEATURE_WLAN  1
 // Device is a synthetic network device
 #define ETH_FEATURE_SYNTH 2
+// Device fills in TCP/UDP checksums of frames sent with ETH_FIFO_TX_CSUM
+#define ETH_FEATURE_TX_CSUM 4
+// Device verifies TCP/UDP checksums, reporting good ones with ETH_FIFO_RX_CSUM_OK
+#define ETH_FEATURE_RX_CSUM 8
+// Device splits TCP frames sent with ETH_FIFO_TX_TSO into MTU-sized segments
+#define ETH_FEATURE_TSO 0x10
+// Device may merge received TCP segments into frames larger than the MTU
+#define ETH_FEATURE_LRO 0x20
+
+#define ETH_FEATURE_OFFLOADS \
+    (ETH_FEATURE_TX_CSUM | ETH_FEATURE_RX_CSUM | ETH_FEATURE_TSO | ETH_FEATURE_LRO)
 
 // Get the fifos to submit tx and rx operations
 //   in: none
@@ -84,6 +97,117 @@ typedef struct eth_fifos_t {
 #define IOCTL_ETHERNET_SET_PROMISC \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_ETH, 9)
 
+// Get the fifos for an additional queue pair
+//   in: uint32_t (queue index, 1 .. eth_info_t.queue_count - 1)
+//  out: eth_fifos_t*
+// Queue 0 is the pair returned by GET_FIFOS, which must be obtained first,
+// and queues must be obtained in order, before START.  Received packets
+// are spread across the client's queues by the device's flow hash, so
+// all packets of one flow arrive on the same queue.  Each queue's tx fifo
+// is serviced independently.
+#define IOCTL_ETHERNET_GET_QUEUE_FIFOS \
+    IOCTL(IOCTL_KIND_GET_TWO_HANDLES, IOCTL_FAMILY_ETH, 10)
+
+// Upper bound on eth_info_t.queue_count
+#define ETH_MAX_QUEUES 8
+
+// Get transmit batching statistics for the device, across all clients
+//   in: none
+//  out: eth_tx_stats_t*
+#define IOCTL_ETHERNET_GET_TX_STATS \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_ETH, 11)
+
+#define ETH_TX_STATS_BUCKETS 9
+
+typedef struct eth_tx_stats {
+    // frames handed to the device, and the batches they were handed over in
+    uint64_t frames;
+    uint64_t batches;
+    uint32_t max_batch;
+    uint32_t reserved;
+    // batch_sizes[n] counts batches of 2^n to 2^(n+1)-1 frames;
+    // the last bucket also counts any larger batches
+    uint64_t batch_sizes[ETH_TX_STATS_BUCKETS];
+} eth_tx_stats_t;
+
+// Enable offloads for this client
+//   in: uint32_t (ETH_FEATURE_OFFLOADS bits, a subset of eth_info_t.features)
+//  out: none
+// Only offloads that are enabled may be requested with fifo entry flags.
+// LRO is turned on in the device while every started client has enabled it,
+// and such clients must be ready to receive frames of up to 64k.
+#define IOCTL_ETHERNET_SET_OFFLOADS \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_ETH, 12)
+
+// Get interrupt moderation statistics from the ethmac driver, for drivers
+// that moderate their interrupts
+//   in: none
+//  out: eth_irq_stats_t*
+#define IOCTL_ETHERNET_GET_IRQ_STATS \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_ETH, 13)
+
+typedef struct eth_irq_stats {
+    // interrupts taken, and rounds of the rx poll loop run for them
+    uint64_t interrupts;
+    uint64_t polls;
+    uint64_t rx_packets;
+    // current interrupt rate limit, in interrupts per second (0 is none)
+    uint32_t irq_rate;
+    uint32_t reserved;
+} eth_irq_stats_t;
+
+// Start capturing every frame this device receives or transmits into a
+// ring in the given vmo
+//   in: zx_handle_t (vmo)
+//  out: none
+// The vmo begins with an eth_capture_ring_t, whose magic and snaplen the
+// client fills in; the rest of the vmo holds the ring.  Frames are copied
+// in by the driver whenever the device is running, independent of this
+// client's fifos and TX_LISTEN.  See "Capture" below.
+#define IOCTL_ETHERNET_SET_CAPTURE \
+    IOCTL(IOCTL_KIND_SET_HANDLE, IOCTL_FAMILY_ETH, 14)
+
+// Stop capturing and release the capture vmo
+//   in: none
+//  out: none
+#define IOCTL_ETHERNET_CAPTURE_STOP \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_ETH, 15)
+
+#define ETH_CAPTURE_MAGIC 0x45544843 // "CHTE"
+
+typedef struct eth_capture_ring {
+    uint32_t magic;
+    // bytes of each frame to keep (0 keeps whole frames)
+    uint32_t snaplen;
+    // bytes of ring space following this header, set by the driver
+    uint64_t size;
+    // bytes ever written by the driver and consumed by the client; both only
+    // grow, and (head - tail) bytes starting at (tail % size) are readable
+    uint64_t head;
+    uint64_t tail;
+    // frames captured, frames dropped because the ring was full, and frames
+    // cut short to snaplen
+    uint64_t packets;
+    uint64_t drops;
+    uint64_t truncated;
+    uint64_t reserved[2];
+} eth_capture_ring_t;
+
+// pcapng block types found in a capture ring
+#define ETH_CAPTURE_BLOCK_EPB (6u) // Enhanced Packet Block
+#define ETH_CAPTURE_BLOCK_PAD (0u) // skip block_len bytes
+
+// The pcapng Enhanced Packet Block header preceding each captured frame
+typedef struct eth_capture_epb {
+    uint32_t block_type;
+    uint32_t block_len;
+    uint32_t interface_id;
+    uint32_t ts_high;
+    uint32_t ts_low;
+    uint32_t cap_len;
+    uint32_t orig_len;
+} eth_capture_epb_t;
+
 // Link status bits:
 #define ETH_STATUS_ONLINE (1u)
 
@@ -108,14 +232,45 @@ typedef struct eth_fifos_t {
 // of each fifo for each outstanding tx or rx request.  The fifo sizes
 // are returned along with the fifo handles in the eth_fifos_t.
 
+// Checksum and segmentation offload
+//
+// A frame sent with ETH_FIFO_TX_CSUM must be an IPv4 or IPv6 (without
+// extension headers) TCP or UDP packet, optionally 802.1Q tagged.  The
+// client leaves the one's complement sum of the pseudo-header, not
+// inverted, in the TCP/UDP checksum field, and the device completes it.
+// ETH_FIFO_TX_TSO implies ETH_FIFO_TX_CSUM and is for TCP only: the frame
+// is one set of headers followed by any amount of payload, which is sent
+// in segments filling the device MTU.  The pseudo-header sum is then taken
+// with a zero length, and the device fixes up the lengths, ids, sequence
+// numbers and flags of each segment.
+
+// Capture
+//
+// Each captured frame is one pcapng Enhanced Packet Block: an
+// eth_capture_epb_t, cap_len bytes of frame padded to a multiple of four,
+// no options, and a trailing copy of block_len.  Blocks can be appended to
+// a pcapng file as they are.  Timestamps are in nanoseconds of the
+// monotonic clock, taken when the driver saw the frame, so the file's
+// interface block should carry if_tsresol 9.  interface_id is 0 for
+// received frames and 1 for transmitted ones.
+//
+// Blocks never wrap around the end of the ring.  When the next block does
+// not fit before the end, the driver writes an ETH_CAPTURE_BLOCK_PAD block
+// covering the remaining space (or nothing, when fewer than eight bytes
+// remain) and starts again at the beginning.  The client consumes blocks
+// from tail and then advances tail; the driver never overwrites unconsumed
+// data, and counts a drop instead.
+
 // flags values for request messages
-// - none -
+#define ETH_FIFO_TX_CSUM (0x100u) // device fills in the TCP/UDP checksum
+#define ETH_FIFO_TX_TSO  (0x200u) // device segments the TCP payload
 
 // flags values for response messages
 #define ETH_FIFO_RX_OK   (1u)   // packet received okay
 #define ETH_FIFO_TX_OK   (1u)   // packet transmitted okay
 #define ETH_FIFO_INVALID (2u)   // offset+length not within io_vmo bounds
 #define ETH_FIFO_RX_TX   (4u)   // received our own tx packet (when TX_LISTEN)
+#define ETH_FIFO_RX_CSUM_OK (8u) // TCP/UDP checksum verified (with RX_CSUM enabled)
 
 typedef struct eth_fifo_entry {
     // offset from start of io_vmo to packet data
@@ -156,3 +311,22 @@ IOCTL_WRAPPER_OUT(ioctl_ethernet_get_status, IOCTL_ETHERNET_GET_STATUS, uint32_t
 
 // ssize_t ioctl_ethernet_set_promisc(int fd, bool*);
 IOCTL_WRAPPER_IN(ioctl_ethernet_set_promisc, IOCTL_ETHERNET_SET_PROMISC, bool);
+
+// ssize_t ioctl_ethernet_get_tx_stats(int fd, eth_tx_stats_t* out);
+IOCTL_WRAPPER_OUT(ioctl_ethernet_get_tx_stats, IOCTL_ETHERNET_GET_TX_STATS, eth_tx_stats_t);
+
+// ssize_t ioctl_ethernet_get_irq_stats(int fd, eth_irq_stats_t* out);
+IOCTL_WRAPPER_OUT(ioctl_ethernet_get_irq_stats, IOCTL_ETHERNET_GET_IRQ_STATS, eth_irq_stats_t);
+
+// ssize_t ioctl_ethernet_set_capture(int fd, const zx_handle_t* vmo);
+IOCTL_WRAPPER_IN(ioctl_ethernet_set_capture, IOCTL_ETHERNET_SET_CAPTURE, zx_handle_t);
+
+// ssize_t ioctl_ethernet_capture_stop(int fd);
+IOCTL_WRAPPER(ioctl_ethernet_capture_stop, IOCTL_ETHERNET_CAPTURE_STOP);
+
+// ssize_t ioctl_ethernet_set_offloads(int fd, const uint32_t* features);
+IOCTL_WRAPPER_IN(ioctl_ethernet_set_offloads, IOCTL_ETHERNET_SET_OFFLOADS, uint32_t);
+
+// ssize_t ioctl_ethernet_get_queue_fifos(int fd, const uint32_t* queue, eth_fifos_t* out);
+IOCTL_WRAPPER_INOUT(ioctl_ethernet_get_queue_fifos, IOCTL_ETHERNET_GET_QUEUE_FIFOS,
+                    uint32_t, eth_fifos_t);
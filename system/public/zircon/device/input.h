@@ -5,6 +5,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <zircon/types.h>
 #include <zircon/device/ioctl.h>
 #include <zircon/device/ioctl-wrapper.h>
 
@@ -26,6 +27,10 @@
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_INPUT, 7)
 #define IOCTL_INPUT_SET_REPORT \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_INPUT, 8)
+#define IOCTL_INPUT_SET_DELIVERY \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_INPUT, 9)
+#define IOCTL_INPUT_GET_STATS \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_INPUT, 10)
 
 enum {
     INPUT_PROTO_NONE = 0,
@@ -59,6 +64,35 @@ typedef struct input_set_report {
     uint8_t data[];
 } input_set_report_t;
 
+// When set, a read returns every complete report pending on the instance
+// which fits in the read buffer, each preceded by an input_report_hdr_t.
+#define INPUT_DELIVERY_BATCH (1u << 0)
+
+typedef struct input_delivery {
+    uint32_t flags;
+    // The maximum rate, in Hz, at which the instance becomes readable.  Reports
+    // which arrive faster than this are queued and delivered together.  Zero
+    // means no limit.
+    uint32_t max_rate_hz;
+} input_delivery_t;
+
+typedef struct input_report_hdr {
+    // The ZX_CLOCK_MONOTONIC time at which the report arrived from the device.
+    zx_time_t timestamp;
+    // The size of the report which immediately follows this header.
+    uint32_t size;
+    uint32_t reserved;
+} input_report_hdr_t;
+
+typedef struct input_stats {
+    // Reports queued to this instance.
+    uint64_t reports_queued;
+    // Reports which could not be queued because the instance's fifo was full.
+    uint64_t reports_dropped;
+    // Reads which returned at least one report.
+    uint64_t reads;
+} input_stats_t;
+
 typedef struct boot_kbd_report {
     uint8_t modifier;
     uint8_t reserved;
@@ -101,3 +135,9 @@ IOCTL_WRAPPER_IN_VAROUT(ioctl_input_get_report, IOCTL_INPUT_GET_REPORT,
 
 // ssize_t ioctl_input_set_report(int fd, const input_set_report_t* in, size_t in_len);
 IOCTL_WRAPPER_VARIN(ioctl_input_set_report, IOCTL_INPUT_SET_REPORT, input_set_report_t);
+
+// ssize_t ioctl_input_set_delivery(int fd, const input_delivery_t* in);
+IOCTL_WRAPPER_IN(ioctl_input_set_delivery, IOCTL_INPUT_SET_DELIVERY, input_delivery_t);
+
+// ssize_t ioctl_input_get_stats(int fd, input_stats_t* out);
+IOCTL_WRAPPER_OUT(ioctl_input_get_stats, IOCTL_INPUT_GET_STATS, input_stats_t);
@@ -37,5 +37,14 @@ static inline zx_status_t ioctl_ktrace_add_probe(int fd, const char* name, uint3
                       name, strlen(name), probe_id, sizeof(uint32_t));
 }
 
+// Start tracing, with records streamed out as they're written.
+// input: The group_mask
+// reply: a socket carrying the records, KTRACE_ACTION_START_STREAMING style.
+//        Closing it ends the stream; IOCTL_KTRACE_STOP stops new records.
+#define IOCTL_KTRACE_START_STREAMING \
+    IOCTL(IOCTL_KIND_GET_HANDLE, IOCTL_FAMILY_KTRACE, 5)
+
 IOCTL_WRAPPER_IN(ioctl_ktrace_start, IOCTL_KTRACE_START, uint32_t);
 IOCTL_WRAPPER(ioctl_ktrace_stop, IOCTL_KTRACE_STOP);
+IOCTL_WRAPPER_INOUT(ioctl_ktrace_start_streaming, IOCTL_KTRACE_START_STREAMING, uint32_t,
+                    zx_handle_t);
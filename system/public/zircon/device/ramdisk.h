@@ -16,6 +16,11 @@
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_RAMDISK, 2)
 #define IOCTL_RAMDISK_SET_FLAGS \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_RAMDISK, 3)
+#define IOCTL_RAMDISK_SET_WORKERS \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_RAMDISK, 5)
+
+// The most worker threads a single ramdisk will serve requests with.
+#define RAMDISK_MAX_WORKERS 8
 
 typedef struct ramdisk_ioctl_config {
     uint64_t blk_size;
@@ -43,3 +48,8 @@ IOCTL_WRAPPER(ioctl_ramdisk_unlink, IOCTL_RAMDISK_UNLINK);
 // The flags to set match block_info_t.flags. This is intended to simulate the behavior
 // of other block devices, so it should be used only for tests.
 IOCTL_WRAPPER_IN(ioctl_ramdisk_set_flags, IOCTL_RAMDISK_SET_FLAGS, uint32_t);
+
+// ssize_t ioctl_ramdisk_set_workers(int fd, uint32_t* in);
+// Sets how many requests the ramdisk may work on at once, between 1 and
+// RAMDISK_MAX_WORKERS. Requests are still ordered around barriers and flushes.
+IOCTL_WRAPPER_IN(ioctl_ramdisk_set_workers, IOCTL_RAMDISK_SET_WORKERS, uint32_t);
@@ -87,6 +87,26 @@ __BEGIN_CDECLS
 // call with in_len = sizeof(int)
 #define IOCTL_USB_SET_CONFIGURATION     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_USB, 13)
 
+// returns completion event statistics for each interrupter of a host controller
+// sent to the host controller device, call with out_len = sizeof(usb_hci_event_stats_t)
+#define IOCTL_USB_HCI_GET_EVENT_STATS   IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_USB, 14)
+
+#define USB_HCI_MAX_INTERRUPTERS        8
+
+typedef struct {
+    uint64_t interrupts;        // interrupts serviced
+    uint64_t events;            // events consumed from the ring
+    uint64_t transfer_events;   // of which transfer completions
+    uint32_t max_events;        // most events consumed for a single interrupt
+    uint32_t endpoints;         // endpoints currently completing on this ring
+} usb_hci_ring_stats_t;
+
+typedef struct {
+    uint32_t interrupter_count;
+    uint32_t reserved;
+    usb_hci_ring_stats_t rings[USB_HCI_MAX_INTERRUPTERS];
+} usb_hci_event_stats_t;
+
 IOCTL_WRAPPER_OUT(ioctl_usb_get_device_type, IOCTL_USB_GET_DEVICE_TYPE, int);
 IOCTL_WRAPPER_OUT(ioctl_usb_get_device_speed, IOCTL_USB_GET_DEVICE_SPEED, int);
 IOCTL_WRAPPER_OUT(ioctl_usb_get_device_desc, IOCTL_USB_GET_DEVICE_DESC, usb_device_descriptor_t);
@@ -106,5 +126,7 @@ IOCTL_WRAPPER_OUT(ioctl_usb_get_device_id, IOCTL_USB_GET_DEVICE_ID, uint64_t);
 IOCTL_WRAPPER_OUT(ioctl_usb_get_device_hub_id, IOCTL_USB_GET_DEVICE_HUB_ID, uint64_t);
 IOCTL_WRAPPER_OUT(ioctl_usb_get_configuration, IOCTL_USB_GET_CONFIGURATION, int);
 IOCTL_WRAPPER_IN(ioctl_usb_set_configuration, IOCTL_USB_SET_CONFIGURATION, int);
+IOCTL_WRAPPER_OUT(ioctl_usb_hci_get_event_stats, IOCTL_USB_HCI_GET_EVENT_STATS,
+                  usb_hci_event_stats_t);
 
 __END_CDECLS
@@ -88,6 +88,10 @@
 #define IOCTL_VFS_GET_DEVICE_PATH \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_VFS, 9)
 
+// Return statistics about the filesystem's block cache.
+#define IOCTL_VFS_QUERY_CACHE \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_VFS, 10)
+
 typedef struct {
     zx_handle_t channel; // Channel to which watch events will be sent
     uint32_t mask;       // Bitmask of desired events (1 << WATCH_EVT_*)
@@ -164,6 +168,27 @@ typedef struct vfs_query_info {
 // ssize_t ioctl_vfs_query_fs(int fd, vfs_query_info_t* out, size_t out_len);
 IOCTL_WRAPPER_VAROUT(ioctl_vfs_query_fs, IOCTL_VFS_QUERY_FS, vfs_query_info_t);
 
+typedef struct vfs_cache_info {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t readahead;     // Blocks brought in ahead of being asked for.
+    uint64_t evictions;
+    uint64_t invalidations; // Cached blocks dropped because they were overwritten.
+    uint32_t capacity;      // In blocks.
+    uint32_t block_size;
+    // The buffer of writes waiting to go out to disk, in blocks, and how
+    // often and for how long writers have had to wait for room in it.
+    uint32_t writeback_capacity;
+    uint32_t writeback_used;
+    uint32_t writeback_peak;
+    uint32_t reserved;
+    uint64_t writeback_stalls;
+    uint64_t writeback_stall_ns;
+} vfs_cache_info_t;
+
+// ssize_t ioctl_vfs_query_cache(int fd, vfs_cache_info_t* out);
+IOCTL_WRAPPER_OUT(ioctl_vfs_query_cache, IOCTL_VFS_QUERY_CACHE, vfs_cache_info_t);
+
 // ssize_t ioctl_vfs_get_token(int fd, zx_handle_t* out);
 IOCTL_WRAPPER_OUT(ioctl_vfs_get_token, IOCTL_VFS_GET_TOKEN, zx_handle_t);
 
@@ -10,6 +10,7 @@
 
 KTRACE_DEF(0x000,32B,VERSION,META) // version
 KTRACE_DEF(0x001,32B,TICKS_PER_MS,META) // lo32, hi32
+KTRACE_DEF(0x002,32B,DROPPED,META) // cpu, total dropped lo32, hi32
 
 KTRACE_DEF(0x020,NAME,KTHREAD_NAME,META) // ktid, 0, name[]
 KTRACE_DEF(0x021,NAME,THREAD_NAME,META) // tid, pid, name[]
@@ -17,6 +18,7 @@ KTRACE_DEF(0x022,NAME,PROC_NAME,META) // pid, 0, name[]
 KTRACE_DEF(0x023,NAME,SYSCALL_NAME,META) // num, 0, name[]
 KTRACE_DEF(0x024,NAME,IRQ_NAME,META) // num, 0, name[]
 KTRACE_DEF(0x025,NAME,PROBE_NAME,META) // num, 0, name[]
+KTRACE_DEF(0x026,NAME,INIT_HOOK_NAME,META) // num, level, name[]
 
 KTRACE_DEF(0x030,16B,IRQ_ENTER,IRQ) // (irqn << 8) | cpu
 KTRACE_DEF(0x031,16B,IRQ_EXIT,IRQ) // (irqn << 8) | cpu
@@ -56,6 +58,12 @@ KTRACE_DEF(0x160,32B,KWAIT_BLOCK,SCHEDULER) // queue_hi, queue_hi
 KTRACE_DEF(0x161,32B,KWAIT_WAKE,SCHEDULER) // queue_hi, queue_hi, is_mutex
 KTRACE_DEF(0x162,32B,KWAIT_UNBLOCK,SCHEDULER) // queue_hi, queue_hi, blocked_status
 
+KTRACE_DEF(0x170,32B,DEADLINE_MISS,SCHEDULER) // tid, lateness_lo, lateness_hi, cpu
+
+// The boot timeline, replayed with the rest of the metadata.
+KTRACE_DEF(0x180,32B,INIT_HOOK_START,META) // num, level, cpu
+KTRACE_DEF(0x181,32B,INIT_HOOK_END,META) // num, level, cpu
+
 // events from 0x200-0x2ff are for arch-specific needs
 
 #ifdef __x86_64__
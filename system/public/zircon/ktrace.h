@@ -88,5 +88,11 @@ enum {
 #define KTRACE_ACTION_STOP      2 // options ignored
 #define KTRACE_ACTION_REWIND    3 // options ignored
 #define KTRACE_ACTION_NEW_PROBE 4 // options ignored, ptr = name
+#define KTRACE_ACTION_START_STREAMING 5 // options = grpmask, 0 = all
+
+// In streaming mode, each zx_ktrace_read() ignores its offset and takes the
+// whole records that are ready, freeing their space for more. A TAG_DROPPED
+// record is read whenever a cpu had to drop records since the last one.
+// Streaming lasts until the next KTRACE_ACTION_REWIND.
 
 __END_CDECLS
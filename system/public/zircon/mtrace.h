@@ -39,6 +39,22 @@ __BEGIN_CDECLS
 #define MTRACE_IPT_CPU_MODE_START 4
 #define MTRACE_IPT_CPU_MODE_STOP 5
 
+// Stage/fetch all trace buffer data for a thread trace.
+#define MTRACE_IPT_STAGE_THREAD_DATA 6
+#define MTRACE_IPT_GET_THREAD_DATA 7
+
+// Assign a thread to a thread trace, or release it. The argument is the
+// thread's handle.
+#define MTRACE_IPT_ASSIGN_THREAD 8
+#define MTRACE_IPT_RELEASE_THREAD 9
+
+#define MTRACE_IPT_THREAD_MODE_START 10
+#define MTRACE_IPT_THREAD_MODE_STOP 11
+
+// Stop tracing one thread while the others carry on, and resume it.
+#define MTRACE_IPT_PAUSE_THREAD 12
+#define MTRACE_IPT_RESUME_THREAD 13
+
 // Encode/decode options values for mtrace_control().
 // At present we just encode the cpu number here.
 // We only support 32 cpus at the moment, the extra bit is for magic values.
@@ -49,6 +65,9 @@ __BEGIN_CDECLS
 
 #define MTRACE_IPT_OPTIONS_CPU(options) ((options) & MTRACE_IPT_OPTIONS_CPU_MASK)
 
+// Thread traces are identified by their descriptor in place of the cpu.
+#define MTRACE_IPT_OPTIONS_TRACE(options) MTRACE_IPT_OPTIONS_CPU(options)
+
 // Actions for Intel Performance Monitoring control
 
 // Get performonce monitoring system properties
@@ -77,3 +77,9 @@
 
 #define ZX_DEFAULT_IOMMU_RIGHTS \
     (ZX_RIGHT_DUPLICATE | ZX_RIGHT_TRANSFER)
+
+#define ZX_DEFAULT_PAGER_RIGHTS \
+    (ZX_RIGHT_DUPLICATE | ZX_RIGHT_TRANSFER | ZX_RIGHTS_IO)
+
+#define ZX_DEFAULT_RING_RIGHTS \
+    (ZX_RIGHTS_BASIC | ZX_RIGHTS_IO)
@@ -0,0 +1,51 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <zircon/types.h>
+
+__BEGIN_CDECLS
+
+// zx_fifo_create() options
+#define ZX_FIFO_MAPPABLE                (1u << 0)
+
+// Layout of the vmo returned by zx_fifo_get_ring() for fifos created with
+// ZX_FIFO_MAPPABLE.
+//
+// The vmo holds one ring of elements per direction. Ring N carries the
+// elements written on the endpoint zx_fifo_get_ring() reported as index N,
+// so an endpoint produces into ring |index| and consumes from ring
+// |index ^ 1|. Both ring headers live in the first page and each ring's
+// elements fill the start of their own page.
+//
+// |head| and |tail| are free running element counts that wrap at 2^32; the
+// element for count c is slot (c % elem_count). Only the writer advances
+// |head| and only the reader advances |tail|, each with release semantics
+// after touching the slots.
+typedef struct zx_fifo_ring {
+    uint32_t head;
+    uint32_t tail;
+    // ZX_FIFO_RING_*_WAITING bits, see below.
+    uint32_t waiters;
+    uint32_t reserved;
+} zx_fifo_ring_t;
+
+#define ZX_FIFO_RING_HEADER_OFFSET(n)   ((n) * sizeof(zx_fifo_ring_t))
+#define ZX_FIFO_RING_DATA_OFFSET(n)     (4096u * ((n) + 1u))
+#define ZX_FIFO_RING_VMO_SIZE           ZX_FIFO_RING_DATA_OFFSET(2)
+
+// A reader that finds its ring empty sets ZX_FIFO_RING_READER_WAITING,
+// checks the ring again and calls zx_fifo_ring_update() before waiting for
+// ZX_FIFO_READABLE. A writer that advances |head| and sees the bit set
+// clears it and calls zx_fifo_ring_update(). Writers waiting for free slots
+// use ZX_FIFO_RING_WRITER_WAITING and ZX_FIFO_WRITABLE the same way.
+//
+// zx_fifo_read() and zx_fifo_write() set these bits themselves before
+// returning ZX_ERR_SHOULD_WAIT, so a peer using the mapping works with one
+// that only makes system calls.
+#define ZX_FIFO_RING_READER_WAITING     (1u << 0)
+#define ZX_FIFO_RING_WRITER_WAITING     (1u << 1)
+
+__END_CDECLS
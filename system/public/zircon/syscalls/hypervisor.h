@@ -12,6 +12,9 @@
 __BEGIN_CDECLS
 
 // clang-format off
+// Options for zx_guest_create().
+#define ZX_GUEST_OPT_POPULATE   (1u << 0)
+
 enum {
     ZX_GUEST_TRAP_BELL  = 0,
     ZX_GUEST_TRAP_MEM   = 1,
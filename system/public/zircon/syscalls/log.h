@@ -13,7 +13,8 @@ __BEGIN_CDECLS
 
 // Defines and structures for zx_log_*()
 typedef struct zx_log_record {
-    uint32_t reserved;
+    // number of records this reader missed immediately before this one
+    uint32_t dropped;
     uint16_t datalen;
     uint16_t flags;
     zx_time_t timestamp;
@@ -49,4 +50,8 @@ typedef struct zx_log_record {
 
 #define ZX_LOG_FLAG_READABLE  0x40000000
 
+// Read as many records as fit, each starting at an 8 byte
+// aligned offset, rather than just one
+#define ZX_LOG_READ_BATCH     0x00000001
+
 __END_CDECLS
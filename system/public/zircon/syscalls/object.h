@@ -31,6 +31,10 @@ typedef enum {
     ZX_INFO_KMEM_STATS                 = 17, // zx_info_kmem_stats_t[1]
     ZX_INFO_RESOURCE                   = 18, // zx_info_resource_t[1]
     ZX_INFO_HANDLE_COUNT               = 19, // zx_info_handle_count_t[1]
+    ZX_INFO_CPU_SCHED_HISTOGRAMS       = 20, // zx_info_cpu_sched_histograms_t[n]
+    ZX_INFO_PORT                       = 21, // zx_info_port_t[1]
+    ZX_INFO_LOCK_PROFILE               = 22, // zx_info_lock_profile_t[n]
+    ZX_INFO_JOB_PROCESS_SNAPSHOT       = 23, // zx_info_process_snapshot_t[n]
     ZX_INFO_LAST
 } zx_object_info_topic_t;
 
@@ -55,6 +59,8 @@ typedef enum {
     ZX_OBJ_TYPE_VCPU                = 21,
     ZX_OBJ_TYPE_TIMER               = 22,
     ZX_OBJ_TYPE_IOMMU               = 23,
+    ZX_OBJ_TYPE_PAGER               = 24,
+    ZX_OBJ_TYPE_RING                = 25,
     ZX_OBJ_TYPE_LAST
 } zx_obj_type_t;
 
@@ -121,8 +127,17 @@ typedef struct zx_info_thread {
 typedef struct zx_info_thread_stats {
     // Total accumulated running time of the thread.
     zx_time_t total_runtime;
+
+    // The cpu the thread last ran on, or ZX_INFO_INVALID_CPU if it never has.
+    uint32_t last_scheduled_cpu;
+
+    // How many times the thread has started running on a different cpu from
+    // the one it last ran on.
+    uint32_t migrations;
 } zx_info_thread_stats_t;
 
+#define ZX_INFO_INVALID_CPU 0xFFFFFFFFu
+
 // Statistics about resources (e.g., memory) used by a task. Can be relatively
 // expensive to gather.
 typedef struct zx_info_task_stats {
@@ -151,6 +166,38 @@ typedef struct zx_info_task_stats {
     size_t mem_scaled_shared_bytes;
 } zx_info_task_stats_t;
 
+// Values for zx_info_process_snapshot_t.state.
+#define ZX_INFO_PROCESS_STATE_INITIAL       0u
+#define ZX_INFO_PROCESS_STATE_RUNNING       1u
+#define ZX_INFO_PROCESS_STATE_DYING         2u
+#define ZX_INFO_PROCESS_STATE_DEAD          3u
+
+// A summary of a process, cheap enough to gather for every process in the
+// system at once.
+typedef struct zx_info_process_snapshot {
+    zx_koid_t koid;
+
+    // The job the process is directly in.
+    zx_koid_t job_koid;
+
+    char name[ZX_MAX_NAME_LEN];
+
+    // One of ZX_INFO_PROCESS_STATE_*.
+    uint32_t state;
+
+    // The number of threads the process has.
+    uint32_t threads;
+
+    // Time spent running by all the threads the process has had.
+    zx_duration_t cpu_time;
+
+    // Memory committed to the VMOs the process created or cloned, wherever
+    // they are mapped. Unlike the ZX_INFO_TASK_STATS numbers, it
+    // is kept up to date as pages come and go, rather than counted by walking
+    // the address space.
+    uint64_t mem_committed_bytes;
+} zx_info_process_snapshot_t;
+
 typedef struct zx_info_vmar {
     // Base address of the region.
     uintptr_t base;
@@ -159,6 +206,22 @@ typedef struct zx_info_vmar {
     size_t len;
 } zx_info_vmar_t;
 
+typedef struct zx_info_port {
+    // Number of packets queued now, and the most that have been queued at
+    // any one time.
+    uint64_t queue_depth;
+    uint64_t max_queue_depth;
+
+    // Number of packets that have been dequeued.
+    uint64_t packets_dequeued;
+
+    // Number of times a waiter blocked until a packet arrived, and the total
+    // and longest time spent blocked doing so.
+    uint64_t waits;
+    zx_duration_t total_wait_time;
+    zx_duration_t max_wait_time;
+} zx_info_port_t;
+
 
 // Types and values used by ZX_INFO_PROCESS_MAPS.
 
@@ -281,6 +344,8 @@ typedef struct zx_info_vmo {
 
 // kernel statistics per cpu
 // TODO(cpu), expose the deprecated stats via a new syscall.
+#define ZX_INFO_CPU_IDLE_STATES 8
+
 typedef struct zx_info_cpu_stats {
     uint32_t cpu_number;
     uint32_t flags;
@@ -305,8 +370,45 @@ typedef struct zx_info_cpu_stats {
     // inter-processor interrupts
     uint64_t reschedule_ipis;
     uint64_t generic_ipis;
+
+    // channel message allocations served by the per-cpu caches, and those
+    // that had to go to the kernel heap
+    uint64_t channel_msg_cache_hits;
+    uint64_t channel_msg_cache_misses;
+
+    // directed wakeups, such as channel calls handing their cpu to the
+    // server, and those where the waker did not block in time
+    uint64_t handoffs;
+    uint64_t handoff_timeouts;
+
+    // entries into and time spent in each idle state the kernel picks
+    // between, shallowest first; the states a cpu doesn't have read as zero
+    uint64_t idle_state_entries[ZX_INFO_CPU_IDLE_STATES];
+    zx_duration_t idle_state_time[ZX_INFO_CPU_IDLE_STATES];
 } zx_info_cpu_stats_t;
 
+// scheduler histograms per cpu
+#define ZX_INFO_SCHED_LATENCY_BUCKETS 32
+#define ZX_INFO_SCHED_DEPTH_BUCKETS   32
+#define ZX_INFO_SCHED_SLICE_BUCKETS   10
+
+typedef struct zx_info_cpu_sched_histograms {
+    uint32_t cpu_number;
+    uint32_t flags;
+
+    // Wakeups whose delay from being made runnable to starting to run was
+    // in [2^i, 2^(i+1)) nanoseconds. The last bucket also counts anything longer.
+    uint64_t wakeup_latency[ZX_INFO_SCHED_LATENCY_BUCKETS];
+
+    // Reschedules that found i threads waiting in the run queue. The last
+    // bucket also counts anything deeper.
+    uint64_t run_queue_depth[ZX_INFO_SCHED_DEPTH_BUCKETS];
+
+    // Times a thread stopped running after using [i/10, (i+1)/10) of the
+    // time slice it was granted. The last bucket also counts whole slices.
+    uint64_t slice_usage[ZX_INFO_SCHED_SLICE_BUCKETS];
+} zx_info_cpu_sched_histograms_t;
+
 // Information about kernel memory usage.
 // Can be expensive to gather.
 typedef struct zx_info_kmem_stats {
@@ -356,6 +458,35 @@ typedef struct zx_info_resource {
 
 #define ZX_INFO_CPU_STATS_FLAG_ONLINE       (1u<<0)
 
+// kernel lock statistics per acquisition site, only in kernels built with
+// ENABLE_LOCK_PROFILING=true
+#define ZX_INFO_LOCK_KIND_MUTEX             0u
+#define ZX_INFO_LOCK_KIND_SPIN              1u
+
+typedef struct zx_info_lock_profile {
+    // The kernel address the lock was acquired from, that is the return
+    // address of the call into the lock, and the address of the lock most
+    // recently acquired there.
+    uint64_t caller;
+    uint64_t lock;
+
+    // One of ZX_INFO_LOCK_KIND_*.
+    uint32_t kind;
+    uint32_t reserved;
+
+    // Acquisitions, and those that had to spin or block for the lock.
+    uint64_t acquires;
+    uint64_t contended;
+
+    // Time waited for the lock by the contended acquisitions, and time the
+    // lock was held after being acquired here, in ticks (see
+    // zx_ticks_per_second()).
+    uint64_t wait_total;
+    uint64_t wait_max;
+    uint64_t hold_total;
+    uint64_t hold_max;
+} zx_info_lock_profile_t;
+
 // Object properties.
 
 // Argument is a uint32_t.
@@ -394,6 +525,30 @@ typedef int32_t zx_job_importance_t;
 // The highest importance.
 #define ZX_JOB_IMPORTANCE_MAX       ((zx_job_importance_t)255)
 
+// Argument is a zx_vmo_numa_policy_t.
+#define ZX_PROP_VMO_NUMA_POLICY            8u
+
+// Chooses the NUMA nodes a VMO's pages are allocated from.
+typedef struct zx_vmo_numa_policy {
+    // One of ZX_VMO_NUMA_POLICY_*.
+    uint32_t policy;
+    // The node, for ZX_VMO_NUMA_POLICY_BIND.
+    uint32_t node;
+} zx_vmo_numa_policy_t;
+
+// Values for zx_vmo_numa_policy_t.policy.
+// From the node of the cpu that first touches the page, the default.
+#define ZX_VMO_NUMA_POLICY_LOCAL            0u
+// From each node in turn.
+#define ZX_VMO_NUMA_POLICY_INTERLEAVE       1u
+// Only from the given node.
+#define ZX_VMO_NUMA_POLICY_BIND             2u
+
+// Argument is a zx_duration_t: the longest a thread can take to be woken up
+// by an idle cpu. Keeps the cpus it blocks on out of deeper idle states,
+// ZX_TIME_INFINITE (the default) leaves the choice to the kernel.
+#define ZX_PROP_THREAD_IDLE_LATENCY        9u
+
 // Values for zx_info_thread_t.state.
 #define ZX_THREAD_STATE_NEW                 0u
 #define ZX_THREAD_STATE_RUNNING             1u
@@ -19,6 +19,8 @@ __BEGIN_CDECLS
 
 // Basic policy topic.
 #define ZX_JOB_POL_BASIC                    0u
+// Timer slack policy topic.
+#define ZX_JOB_POL_TIMER_SLACK              1u
 
 // Input structure to use with ZX_JOB_POL_BASIC.
 typedef struct zx_policy_basic {
@@ -26,6 +28,16 @@ typedef struct zx_policy_basic {
     uint32_t policy;
 } zx_policy_basic_t;
 
+// Input structure to use with ZX_JOB_POL_TIMER_SLACK.
+typedef struct zx_policy_timer_slack {
+    // Least slack applied to timers and to the deadlines of waits made
+    // by threads in the job, rounded down to a power of two.
+    zx_duration_t min_slack;
+    // ZX_TIMER_SLACK_CENTER, ZX_TIMER_SLACK_EARLY or ZX_TIMER_SLACK_LATE;
+    // how the slack is applied to wait deadlines.
+    uint32_t default_mode;
+} zx_policy_timer_slack_t;
+
 // Conditions handled by job policy.
 #define ZX_POL_BAD_HANDLE                    0u
 #define ZX_POL_WRONG_OBJECT                  1u
@@ -8,6 +8,9 @@
 
 __BEGIN_CDECLS
 
+// zx_port_create() options
+#define ZX_PORT_LIFO                (1u << 0)
+
 // zx_object_wait_async() options
 #define ZX_WAIT_ASYNC_ONCE          0u
 #define ZX_WAIT_ASYNC_REPEATING     1u
@@ -21,6 +24,8 @@ __BEGIN_CDECLS
 #define ZX_PKT_TYPE_GUEST_IO        0x05u
 #define ZX_PKT_TYPE_GUEST_VCPU      0x06u
 #define ZX_PKT_TYPE_EXCEPTION(n)    (0x07u | (((n) & 0xFFu) << 8))
+#define ZX_PKT_TYPE_PAGE_REQUEST    0x08u
+#define ZX_PKT_TYPE_INTERRUPT       0x09u
 
 #define ZX_PKT_TYPE_MASK            0xFFu
 
@@ -32,6 +37,8 @@ __BEGIN_CDECLS
 #define ZX_PKT_IS_GUEST_IO(type)    ((type) == ZX_PKT_TYPE_GUEST_IO)
 #define ZX_PKT_IS_GUEST_VCPU(type)  ((type) == ZX_PKT_TYPE_GUEST_VCPU)
 #define ZX_PKT_IS_EXCEPTION(type)   (((type) & ZX_PKT_TYPE_MASK) == ZX_PKT_TYPE_EXCEPTION(0))
+#define ZX_PKT_IS_PAGE_REQUEST(type) ((type) == ZX_PKT_TYPE_PAGE_REQUEST)
+#define ZX_PKT_IS_INTERRUPT(type)   ((type) == ZX_PKT_TYPE_INTERRUPT)
 
 // port_packet_t::type ZX_PKT_TYPE_USER.
 typedef union zx_packet_user {
@@ -103,6 +110,30 @@ typedef struct zx_packet_guest_vcpu {
     uint64_t reserved1;
 } zx_packet_guest_vcpu_t;
 
+// zx_packet_page_request_t::command values.
+#define ZX_PAGER_VMO_READ           0x0000u
+#define ZX_PAGER_VMO_COMPLETE       0x0001u
+
+// port_packet_t::type ZX_PKT_TYPE_PAGE_REQUEST.
+typedef struct zx_packet_page_request {
+    uint16_t command;
+    uint16_t flags;
+    uint32_t reserved0;
+    uint64_t offset;
+    uint64_t length;
+    uint64_t reserved1;
+} zx_packet_page_request_t;
+
+// port_packet_t::type ZX_PKT_TYPE_INTERRUPT.
+typedef struct zx_packet_interrupt {
+    // When the first of |slots| fired since the last packet was dequeued.
+    zx_time_t timestamp;
+    // The slots which fired, as zx_interrupt_wait() would report them.
+    uint64_t slots;
+    uint64_t reserved0;
+    uint64_t reserved1;
+} zx_packet_interrupt_t;
+
 typedef struct zx_port_packet {
     uint64_t key;
     uint32_t type;
@@ -115,7 +146,12 @@ typedef struct zx_port_packet {
         zx_packet_guest_mem_t guest_mem;
         zx_packet_guest_io_t guest_io;
         zx_packet_guest_vcpu_t guest_vcpu;
+        zx_packet_page_request_t page_request;
+        zx_packet_interrupt_t interrupt;
     };
 } zx_port_packet_t;
 
+// Maximum number of packets for zx_port_wait_many().
+#define ZX_PORT_MAX_BATCH_PACKETS 16u
+
 __END_CDECLS
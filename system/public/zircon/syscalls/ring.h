@@ -0,0 +1,77 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <zircon/types.h>
+
+__BEGIN_CDECLS
+
+// Operations a ring can carry. Each stands for the system call of the same
+// name, made by the thread that calls zx_ring_enter().
+#define ZX_RING_OP_NOP                  0u
+#define ZX_RING_OP_CHANNEL_WRITE        1u
+#define ZX_RING_OP_CHANNEL_READ         2u
+#define ZX_RING_OP_VMO_READ             3u
+#define ZX_RING_OP_VMO_WRITE            4u
+#define ZX_RING_OP_PORT_QUEUE           5u
+#define ZX_RING_OP_OBJECT_SIGNAL        6u
+#define ZX_RING_OP_OBJECT_SIGNAL_PEER   7u
+
+// A submission. |handle| is the handle the system call acts on and |args|
+// are its remaining arguments, in order, leaving out |options|, which is
+// always zero:
+//
+//   CHANNEL_WRITE        bytes, num_bytes, handles, num_handles
+//   CHANNEL_READ         bytes, handles, num_bytes, num_handles,
+//                        actual_bytes, actual_handles
+//   VMO_READ             data, offset, len, actual
+//   VMO_WRITE            data, offset, len, actual
+//   PORT_QUEUE           packet
+//   OBJECT_SIGNAL        clear_mask, set_mask
+//   OBJECT_SIGNAL_PEER   clear_mask, set_mask
+//
+// Pointers are addresses in the calling process, and outputs are written
+// there just as the system call would write them. |user_data| is copied to
+// the completion untouched.
+typedef struct zx_ring_sqe {
+    uint32_t op;
+    zx_handle_t handle;
+    uint64_t user_data;
+    uint64_t args[6];
+} zx_ring_sqe_t;
+
+// A completion, posted for each submission in the order they were taken.
+typedef struct zx_ring_cqe {
+    uint64_t user_data;
+    zx_status_t status;
+    uint32_t reserved;
+} zx_ring_cqe_t;
+
+// Layout of the vmo returned by zx_ring_create().
+//
+// The first page holds a header for each queue: the submission queue, which
+// userspace produces into and the kernel consumes, and the completion queue,
+// which goes the other way. Each queue's entries fill their own page.
+//
+// As for mappable fifos, |head| and |tail| are free running entry counts
+// that wrap at 2^32; the entry for count c is slot (c % entries). Only the
+// producer advances |head| and only the consumer advances |tail|, each with
+// release semantics after touching the slots.
+typedef struct zx_ring_queue {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t reserved[2];
+} zx_ring_queue_t;
+
+#define ZX_RING_SQ_HEADER_OFFSET        0u
+#define ZX_RING_CQ_HEADER_OFFSET        sizeof(zx_ring_queue_t)
+#define ZX_RING_SQ_OFFSET               4096u
+#define ZX_RING_CQ_OFFSET               8192u
+#define ZX_RING_VMO_SIZE                12288u
+
+#define ZX_RING_SQ_ENTRIES              (4096u / sizeof(zx_ring_sqe_t))
+#define ZX_RING_CQ_ENTRIES              (4096u / sizeof(zx_ring_cqe_t))
+
+__END_CDECLS
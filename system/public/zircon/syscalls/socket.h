@@ -0,0 +1,46 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <zircon/types.h>
+
+__BEGIN_CDECLS
+
+// Layout of the vmo returned by zx_socket_get_ring() for sockets created
+// with ZX_SOCKET_RING.
+//
+// The vmo holds one byte ring per direction. Ring N carries the data written
+// on the endpoint zx_socket_get_ring() reported as index N, so an endpoint
+// produces into ring |index| and consumes from ring |index ^ 1|. Both ring
+// headers live in the first page, followed by the two data areas.
+//
+// |head| and |tail| are free running byte counts that wrap at 2^32; the data
+// for count c lives at data offset (c % ZX_SOCKET_RING_SIZE). Only the writer
+// advances |head| and only the reader advances |tail|, each with release
+// semantics after touching the data.
+typedef struct zx_socket_ring {
+    uint32_t head;
+    uint32_t tail;
+    // ZX_SOCKET_RING_*_WAITING bits, see below.
+    uint32_t waiters;
+    uint32_t reserved;
+} zx_socket_ring_t;
+
+#define ZX_SOCKET_RING_SIZE             (64u * 1024u)
+#define ZX_SOCKET_RING_HEADER_OFFSET(n) ((n) * sizeof(zx_socket_ring_t))
+#define ZX_SOCKET_RING_DATA_OFFSET(n)   (4096u + (n) * ZX_SOCKET_RING_SIZE)
+#define ZX_SOCKET_RING_VMO_SIZE         ZX_SOCKET_RING_DATA_OFFSET(2)
+
+// A reader that finds its ring empty sets ZX_SOCKET_RING_READER_WAITING,
+// checks the ring again and then calls zx_socket_ring_update() before
+// waiting for ZX_SOCKET_READABLE. A writer that advances |head| and sees the
+// bit set clears it and calls zx_socket_ring_update() so the kernel raises
+// the signal. Writers waiting for space use ZX_SOCKET_RING_WRITER_WAITING and
+// ZX_SOCKET_WRITABLE the same way. When neither side is waiting no system
+// calls are needed.
+#define ZX_SOCKET_RING_READER_WAITING   (1u << 0)
+#define ZX_SOCKET_RING_WRITER_WAITING   (1u << 1)
+
+__END_CDECLS
@@ -30,4 +30,10 @@ typedef struct zx_system_powerctl_arg {
     };
 } zx_system_powerctl_arg_t;
 
+// Events returned by zx_system_get_event(). The kernel keeps the one for
+// the current memory pressure level signaled, and the others not.
+#define ZX_SYSTEM_EVENT_MEMORY_PRESSURE_NORMAL   1u
+#define ZX_SYSTEM_EVENT_MEMORY_PRESSURE_WARNING  2u
+#define ZX_SYSTEM_EVENT_MEMORY_PRESSURE_CRITICAL 3u
+
 __END_CDECLS
@@ -129,6 +129,9 @@ typedef uint32_t zx_signals_t;
 #define ZX_FIFO_WRITABLE            __ZX_OBJECT_WRITABLE
 #define ZX_FIFO_PEER_CLOSED         __ZX_OBJECT_PEER_CLOSED
 
+// Ring
+#define ZX_RING_READABLE            __ZX_OBJECT_READABLE
+
 // Task signals (process, thread, job)
 #define ZX_TASK_TERMINATED          __ZX_OBJECT_SIGNALED
 
@@ -170,6 +173,28 @@ typedef struct {
     uint32_t rd_num_handles;
 } zx_channel_call_args_t;
 
+// Maximum number of messages for zx_channel_read_many() and
+// zx_channel_write_many().
+#define ZX_CHANNEL_MAX_BATCH_MSGS 64u
+
+// Structure for zx_channel_write_many():
+typedef struct {
+    const void* bytes;
+    const zx_handle_t* handles;
+    uint32_t num_bytes;
+    uint32_t num_handles;
+} zx_channel_write_msg_t;
+
+// Structure for zx_channel_read_many():
+typedef struct {
+    void* bytes;
+    zx_handle_t* handles;
+    uint32_t num_bytes;
+    uint32_t num_handles;
+    uint32_t actual_bytes;
+    uint32_t actual_handles;
+} zx_channel_read_msg_t;
+
 // Maximum number of wait items allowed for zx_object_wait_many()
 // TODO(ZX-1349) Re-lower this.
 #define ZX_WAIT_MANY_MAX_ITEMS 16
@@ -181,6 +206,16 @@ typedef struct {
     zx_signals_t pending;
 } zx_wait_item_t;
 
+// Maximum number of buffers allowed for zx_vmo_read_vector() and
+// zx_vmo_write_vector()
+#define ZX_VMO_VECTOR_MAX_ITEMS 16
+
+// Structure for zx_vmo_read_vector() and zx_vmo_write_vector():
+typedef struct {
+    void* buffer;
+    size_t length;
+} zx_iovec_t;
+
 typedef uint32_t zx_rights_t;
 #define ZX_RIGHT_NONE             ((zx_rights_t)0u)
 #define ZX_RIGHT_DUPLICATE        ((zx_rights_t)1u << 0)
@@ -226,6 +261,9 @@ typedef uint32_t zx_rights_t;
 #define ZX_VMO_OP_CACHE_CLEAN            8u
 #define ZX_VMO_OP_CACHE_CLEAN_INVALIDATE 9u
 
+// VM Object creation options
+#define ZX_VMO_LARGE_PAGES               (1u << 0)
+
 // VM Object clone flags
 #define ZX_VMO_CLONE_COPY_ON_WRITE       1u
 
@@ -241,6 +279,9 @@ typedef uint32_t zx_rights_t;
 #define ZX_VM_FLAG_CAN_MAP_WRITE      (1u << 8)
 #define ZX_VM_FLAG_CAN_MAP_EXECUTE    (1u << 9)
 #define ZX_VM_FLAG_MAP_RANGE          (1u << 10)
+#define ZX_VM_FLAG_ACCESS_SEQUENTIAL  (1u << 11)
+#define ZX_VM_FLAG_ACCESS_RANDOM      (1u << 12)
+#define ZX_VM_FLAG_MAP_POPULATE       (1u << 13)
 
 // clock ids
 #define ZX_CLOCK_MONOTONIC        (0u)
@@ -298,7 +339,9 @@ typedef uint64_t zx_off_t;
 #define ZX_SOCKET_DATAGRAM                  (1u << 0)
 #define ZX_SOCKET_HAS_CONTROL               (1u << 1)
 #define ZX_SOCKET_HAS_ACCEPT                (1u << 2)
-#define ZX_SOCKET_CREATE_MASK               (ZX_SOCKET_DATAGRAM | ZX_SOCKET_HAS_CONTROL | ZX_SOCKET_HAS_ACCEPT)
+#define ZX_SOCKET_RING                      (1u << 3)
+#define ZX_SOCKET_CREATE_MASK               (ZX_SOCKET_DATAGRAM | ZX_SOCKET_HAS_CONTROL | ZX_SOCKET_HAS_ACCEPT | \
+                                             ZX_SOCKET_RING)
 
 // These can be passed to zx_socket_read() and zx_socket_write().
 #define ZX_SOCKET_CONTROL                   (1u << 2)
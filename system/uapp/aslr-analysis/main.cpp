@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include <fcntl.h>
+#include <inttypes.h>
 #include <launchpad/launchpad.h>
 #include <launchpad/vmo.h>
 #include <limits.h>
@@ -42,6 +43,7 @@ unsigned int AnalyzeField(const fbl::Array<ReportInfo>& reports,
                           uintptr_t ReportInfo::*field);
 double ApproxBinomialCdf(double p, double N, double n);
 int TestRunMain(int argc, char** argv);
+int MeasurePlacement();
 zx_status_t LaunchTestRun(const char* bin, zx_handle_t h, zx_handle_t* out);
 int JoinProcess(zx_handle_t proc);
 } // namespace
@@ -85,7 +87,7 @@ int main(int argc, char** argv) {
     bits = AnalyzeField(reports, &ReportInfo::vdso);
     printf("vdso: %d bits\n", bits);
 
-    return 0;
+    return MeasurePlacement();
 }
 
 namespace {
@@ -152,6 +154,63 @@ unsigned int AnalyzeField(const fbl::Array<ReportInfo>& reports,
     return good_bits;
 }
 
+// Time how long it takes to place a new mapping in a VMAR that already holds
+// many others, to check that randomized placement doesn't slow down as the
+// address space fills up.
+int MeasurePlacement() {
+    static const size_t kMappingCounts[] = {100, 1000, 10000, 50000};
+    static const size_t kSamples = 1000;
+
+    zx_handle_t vmo;
+    zx_status_t status = zx_vmo_create(PAGE_SIZE, 0, &vmo);
+    if (status != ZX_OK) {
+        printf("Failed to create vmo: %d\n", status);
+        return 1;
+    }
+    auto close_vmo = fbl::MakeAutoCall([vmo]() { zx_handle_close(vmo); });
+
+    for (size_t count : kMappingCounts) {
+        // Leave the vmar three quarters empty so that there are gaps all over
+        // it to choose from.
+        const size_t vmar_size = 4 * (count + kSamples) * PAGE_SIZE;
+        zx_handle_t vmar;
+        uintptr_t vmar_addr;
+        status = zx_vmar_allocate(zx_vmar_root_self(), 0, vmar_size,
+                                  ZX_VM_FLAG_CAN_MAP_READ, &vmar, &vmar_addr);
+        if (status != ZX_OK) {
+            printf("Failed to allocate vmar: %d\n", status);
+            return 1;
+        }
+        auto destroy_vmar = fbl::MakeAutoCall([vmar]() {
+            zx_vmar_destroy(vmar);
+            zx_handle_close(vmar);
+        });
+
+        uintptr_t addr;
+        for (size_t i = 0; i < count; ++i) {
+            status = zx_vmar_map(vmar, 0, vmo, 0, PAGE_SIZE, ZX_VM_FLAG_PERM_READ, &addr);
+            if (status != ZX_OK) {
+                printf("Failed to map: %d\n", status);
+                return 1;
+            }
+        }
+
+        const zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+        for (size_t i = 0; i < kSamples; ++i) {
+            status = zx_vmar_map(vmar, 0, vmo, 0, PAGE_SIZE, ZX_VM_FLAG_PERM_READ, &addr);
+            if (status != ZX_OK) {
+                printf("Failed to map: %d\n", status);
+                return 1;
+            }
+        }
+        const zx_time_t elapsed = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+
+        printf("placement with %zu mappings: %" PRIu64 " ns per map\n", count,
+               static_cast<uint64_t>(elapsed / kSamples));
+    }
+    return 0;
+}
+
 int GatherReports(const char* test_bin, fbl::Array<ReportInfo>* reports) {
     const size_t count = reports->size();
     for (unsigned int run = 0; run < count; ++run) {
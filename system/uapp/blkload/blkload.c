@@ -0,0 +1,535 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <zircon/compiler.h>
+#include <zircon/device/block.h>
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+
+// Keeps a fixed number of requests in flight on a block device's FIFO and
+// measures how long each takes. Every request is a transaction of its own,
+// so the device sees them all at once and completes them in any order.
+//
+// Requests belong to "clients", each with its own VMO and its own share of
+// the device for sequential runs. One thread drives them all: the FIFO is
+// shared, so a thread per client would only have to pass responses back and
+// forth between them.
+
+typedef struct {
+    size_t xfer;            // bytes per request
+    uint32_t depth;         // requests in flight per client
+    uint32_t clients;
+    uint32_t read_percent;  // the rest are writes
+    bool random;
+    bool verify;
+    uint64_t ops;           // per run
+    uint32_t runs;
+    uint64_t range;         // bytes at the start of the device to use, 0 for all
+} options_t;
+
+typedef struct {
+    zx_handle_t vmo;
+    uintptr_t buffer;
+    vmoid_t vmoid;
+    uint64_t first;         // this client's blocks, for sequential runs
+    uint64_t count;
+    uint64_t next;
+    uint64_t remaining;     // requests left to issue in this run
+} client_t;
+
+typedef struct {
+    txnid_t txnid;
+    client_t* client;
+    uint64_t vmo_offset;
+    uint64_t block;         // in units of the transfer size
+    uint16_t opcode;
+    uint64_t start;         // ticks
+} slot_t;
+
+static options_t opts;
+static int fd;
+static zx_handle_t fifo;
+static uint64_t nblocks;
+static uint64_t seed;
+static uint64_t rng_state;
+
+static client_t* clients;
+static slot_t* slots;
+static size_t nslots;
+static slot_t* txn_slots[MAX_TXN_COUNT];
+
+static uint64_t number(const char* str, bool* ok) {
+    char* end;
+    errno = 0;
+    uint64_t n = strtoull(str, &end, 10);
+    if (errno != 0 || end == str) {
+        *ok = false;
+        return 0;
+    }
+
+    uint64_t m = 1;
+    switch (*end) {
+    case 'G':
+    case 'g':
+        m = 1024*1024*1024;
+        end++;
+        break;
+    case 'M':
+    case 'm':
+        m = 1024*1024;
+        end++;
+        break;
+    case 'K':
+    case 'k':
+        m = 1024;
+        end++;
+        break;
+    }
+    if (*end != '\0') {
+        *ok = false;
+    }
+    return m * n;
+}
+
+static uint64_t rand64(void) {
+    // xorshift64*
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+// The contents of |block| in verify mode depend only on the seed and the
+// block, so writes racing each other or a read of the same block all agree.
+static uint64_t pattern_word(uint64_t block, size_t i) {
+    uint64_t z = seed + block * 0x9E3779B97F4A7C15ULL + i;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static void fill_pattern(uint64_t* buf, uint64_t block) {
+    for (size_t i = 0; i < opts.xfer / sizeof(uint64_t); i++) {
+        buf[i] = pattern_word(block, i);
+    }
+}
+
+static bool check_pattern(const uint64_t* buf, uint64_t block) {
+    for (size_t i = 0; i < opts.xfer / sizeof(uint64_t); i++) {
+        uint64_t expected = pattern_word(block, i);
+        if (buf[i] != expected) {
+            fprintf(stderr, "error: verify failed at byte %" PRIu64 ": read %#" PRIx64
+                    ", expected %#" PRIx64 "\n",
+                    block * opts.xfer + i * sizeof(uint64_t), buf[i], expected);
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint64_t ticks_to_ns(uint64_t ticks) {
+    return (uint64_t)((__uint128_t)ticks * ZX_SEC(1) / zx_ticks_per_second());
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t va = *(const uint64_t*)a;
+    uint64_t vb = *(const uint64_t*)b;
+    return va < vb ? -1 : va > vb;
+}
+
+// Writes all of |count| requests, waiting for room if the FIFO is full.
+static zx_status_t fifo_write_all(block_fifo_request_t* requests, size_t count) {
+    while (count > 0) {
+        uint32_t actual;
+        zx_status_t status = zx_fifo_write(fifo, requests, sizeof(*requests) * count, &actual);
+        if (status == ZX_ERR_SHOULD_WAIT) {
+            zx_signals_t signals;
+            status = zx_object_wait_one(fifo, ZX_FIFO_WRITABLE | ZX_FIFO_PEER_CLOSED,
+                                        ZX_TIME_INFINITE, &signals);
+            if (status != ZX_OK) {
+                return status;
+            }
+            if (signals & ZX_FIFO_PEER_CLOSED) {
+                return ZX_ERR_PEER_CLOSED;
+            }
+        } else if (status == ZX_OK) {
+            requests += actual;
+            count -= actual;
+        } else {
+            return status;
+        }
+    }
+    return ZX_OK;
+}
+
+// Reads at least one response, waiting for it if need be.
+static zx_status_t fifo_read_some(block_fifo_response_t* responses, size_t max,
+                                  uint32_t* count) {
+    while (true) {
+        zx_status_t status = zx_fifo_read(fifo, responses, sizeof(*responses) * max, count);
+        if (status != ZX_ERR_SHOULD_WAIT) {
+            return status;
+        }
+        zx_signals_t signals;
+        status = zx_object_wait_one(fifo, ZX_FIFO_READABLE | ZX_FIFO_PEER_CLOSED,
+                                    ZX_TIME_INFINITE, &signals);
+        if (status != ZX_OK) {
+            return status;
+        }
+        if (signals & ZX_FIFO_PEER_CLOSED) {
+            return ZX_ERR_PEER_CLOSED;
+        }
+    }
+}
+
+// Picks the next request for |slot| and describes it in |request|.
+static void prepare(slot_t* slot, block_fifo_request_t* request, uint32_t read_percent,
+                    bool random) {
+    client_t* client = slot->client;
+    client->remaining--;
+
+    slot->opcode = (rand64() % 100 < read_percent) ? BLOCKIO_READ : BLOCKIO_WRITE;
+    if (random) {
+        slot->block = rand64() % nblocks;
+    } else {
+        slot->block = client->first + client->next;
+        client->next = (client->next + 1) % client->count;
+    }
+    if (opts.verify && slot->opcode == BLOCKIO_WRITE) {
+        fill_pattern((uint64_t*)(client->buffer + slot->vmo_offset), slot->block);
+    }
+
+    *request = (block_fifo_request_t){
+        .txnid = slot->txnid,
+        .vmoid = client->vmoid,
+        .opcode = slot->opcode | BLOCKIO_TXN_END,
+        .length = opts.xfer,
+        .vmo_offset = slot->vmo_offset,
+        .dev_offset = slot->block * opts.xfer,
+    };
+}
+
+// Does |ops| requests, recording how long each took in |latencies|, and
+// returns how long they took altogether, or 0 on failure.
+static uint64_t run(uint64_t ops, uint32_t read_percent, bool random, uint64_t* latencies) {
+    for (uint32_t i = 0; i < opts.clients; i++) {
+        clients[i].next = 0;
+        clients[i].remaining = ops / opts.clients + (i < ops % opts.clients ? 1 : 0);
+    }
+
+    block_fifo_request_t requests[BLOCK_FIFO_MAX_DEPTH];
+    block_fifo_response_t responses[BLOCK_FIFO_MAX_DEPTH];
+    size_t batch = 0;
+    uint64_t issued = 0;
+    uint64_t done = 0;
+    bool failed = false;
+
+    uint64_t t0 = zx_ticks_get();
+    for (size_t i = 0; i < nslots; i++) {
+        if (slots[i].client->remaining > 0) {
+            prepare(&slots[i], &requests[batch++], read_percent, random);
+            slots[i].start = t0;
+        }
+    }
+
+    while (batch > 0 || done < issued) {
+        if (batch > 0) {
+            zx_status_t status = fifo_write_all(requests, batch);
+            if (status != ZX_OK) {
+                fprintf(stderr, "error: cannot queue requests: %d\n", status);
+                return 0;
+            }
+            issued += batch;
+            batch = 0;
+        }
+
+        uint32_t count;
+        zx_status_t status = fifo_read_some(responses, countof(responses), &count);
+        if (status != ZX_OK) {
+            fprintf(stderr, "error: cannot read responses: %d\n", status);
+            return 0;
+        }
+        uint64_t now = zx_ticks_get();
+
+        for (uint32_t i = 0; i < count; i++) {
+            slot_t* slot = responses[i].txnid < MAX_TXN_COUNT ? txn_slots[responses[i].txnid]
+                                                              : NULL;
+            if (slot == NULL) {
+                fprintf(stderr, "error: response for unknown txn %u\n", responses[i].txnid);
+                return 0;
+            }
+            latencies[done++] = now - slot->start;
+
+            if (responses[i].status != ZX_OK) {
+                fprintf(stderr, "error: %s at byte %" PRIu64 " failed: %d\n",
+                        slot->opcode == BLOCKIO_READ ? "read" : "write",
+                        slot->block * opts.xfer, responses[i].status);
+                failed = true;
+            } else if (opts.verify && slot->opcode == BLOCKIO_READ &&
+                       !check_pattern((const uint64_t*)(slot->client->buffer + slot->vmo_offset),
+                                      slot->block)) {
+                failed = true;
+            }
+
+            // Stop issuing after a failure, but let what is in flight finish.
+            if (!failed && slot->client->remaining > 0) {
+                prepare(slot, &requests[batch++], read_percent, random);
+                slot->start = now;
+            }
+        }
+    }
+    uint64_t t1 = zx_ticks_get();
+
+    return failed ? 0 : t1 - t0;
+}
+
+static void report(uint32_t n, uint64_t ops, uint64_t ticks, uint64_t* latencies) {
+    qsort(latencies, ops, sizeof(latencies[0]), compare_u64);
+
+    double s = (double)ticks_to_ns(ticks) / 1e9;
+    double iops = (double)ops / s;
+    double mbps = iops * (double)opts.xfer / (1024 * 1024);
+#define LAT_US(p) ((double)ticks_to_ns(latencies[(uint64_t)((double)(ops - 1) * (p))]) / 1000)
+    printf("run %u: %" PRIu64 " ops in %.3f s: %.0f IOPS, %.2f MB/s, "
+           "latency (us) p50 %.1f p99 %.1f p99.9 %.1f max %.1f\n",
+           n, ops, s, iops, mbps, LAT_US(0.5), LAT_US(0.99), LAT_US(0.999), LAT_US(1.0));
+#undef LAT_US
+}
+
+static zx_status_t setup(const char* dev) {
+    if (ioctl_block_get_fifos(fd, &fifo) != sizeof(fifo)) {
+        fprintf(stderr, "error: cannot get fifo for '%s'; is it in use?\n", dev);
+        return ZX_ERR_BAD_STATE;
+    }
+
+    size_t buffer_size = opts.depth * opts.xfer;
+    for (uint32_t i = 0; i < opts.clients; i++) {
+        client_t* client = &clients[i];
+        zx_status_t status;
+        if ((status = zx_vmo_create(buffer_size, 0, &client->vmo)) != ZX_OK) {
+            fprintf(stderr, "error: cannot create vmo: %d\n", status);
+            return status;
+        }
+        if ((status = zx_vmar_map(zx_vmar_root_self(), 0, client->vmo, 0, buffer_size,
+                                  ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE,
+                                  &client->buffer)) != ZX_OK) {
+            fprintf(stderr, "error: cannot map vmo: %d\n", status);
+            return status;
+        }
+        // Something other than zeros to write when not verifying.
+        for (size_t j = 0; j < buffer_size / sizeof(uint64_t); j++) {
+            ((uint64_t*)client->buffer)[j] = rand64();
+        }
+
+        zx_handle_t dup;
+        if ((status = zx_handle_duplicate(client->vmo, ZX_RIGHT_SAME_RIGHTS, &dup)) != ZX_OK) {
+            fprintf(stderr, "error: cannot duplicate handle: %d\n", status);
+            return status;
+        }
+        if (ioctl_block_attach_vmo(fd, &dup, &client->vmoid) != sizeof(client->vmoid)) {
+            fprintf(stderr, "error: cannot attach vmo for '%s'\n", dev);
+            return ZX_ERR_IO;
+        }
+
+        client->count = nblocks / opts.clients;
+        client->first = i * client->count;
+
+        for (uint32_t j = 0; j < opts.depth; j++) {
+            slot_t* slot = &slots[i * opts.depth + j];
+            if (ioctl_block_alloc_txn(fd, &slot->txnid) != sizeof(slot->txnid)) {
+                fprintf(stderr, "error: cannot allocate txn for '%s'\n", dev);
+                return ZX_ERR_NO_RESOURCES;
+            }
+            slot->client = client;
+            slot->vmo_offset = j * opts.xfer;
+            txn_slots[slot->txnid] = slot;
+            nslots++;
+        }
+    }
+    return ZX_OK;
+}
+
+static void teardown(void) {
+    for (size_t i = 0; i < nslots; i++) {
+        ioctl_block_free_txn(fd, &slots[i].txnid);
+    }
+    if (fifo != ZX_HANDLE_INVALID) {
+        ioctl_block_fifo_close(fd);
+        zx_handle_close(fifo);
+    }
+    for (uint32_t i = 0; i < opts.clients; i++) {
+        if (clients[i].buffer) {
+            zx_vmar_unmap(zx_vmar_root_self(), clients[i].buffer, opts.depth * opts.xfer);
+        }
+        zx_handle_close(clients[i].vmo);
+    }
+}
+
+static int usage(void) {
+    fprintf(stderr,
+            "usage: blkload [options] <device>\n"
+            "\n"
+            "Keeps requests in flight on a block device and reports IOPS, bandwidth\n"
+            "and latency percentiles. Writes destroy the contents of the device.\n"
+            "Sizes take a K, M or G suffix.\n"
+            "\n"
+            "options:\n"
+            "  -b SIZE   bytes per request (default: 4K)\n"
+            "  -q N      requests in flight per client (default: 32)\n"
+            "  -c N      clients, each with its own VMO (default: 1)\n"
+            "  -r N      percent of requests that are reads (default: 100)\n"
+            "  -R        random offsets, rather than sequential\n"
+            "  -n N      requests per run (default: 100000)\n"
+            "  -i N      runs (default: 1)\n"
+            "  -s SIZE   only use this much of the start of the device\n"
+            "  -v        verify: fill the device with a known pattern first, write only\n"
+            "            that pattern, and check every read against it\n"
+            "\n"
+            "At most %zu requests can be in flight altogether.\n",
+            (size_t)BLOCK_FIFO_MAX_DEPTH);
+    return -1;
+}
+
+int main(int argc, char** argv) {
+    opts = (options_t){
+        .xfer = 4096,
+        .depth = 32,
+        .clients = 1,
+        .read_percent = 100,
+        .ops = 100000,
+        .runs = 1,
+    };
+
+    int opt;
+    bool ok = true;
+    while (ok && (opt = getopt(argc, argv, "b:q:c:r:Rn:i:s:v")) != -1) {
+        switch (opt) {
+        case 'b':
+            opts.xfer = number(optarg, &ok);
+            break;
+        case 'q':
+            opts.depth = (uint32_t)number(optarg, &ok);
+            break;
+        case 'c':
+            opts.clients = (uint32_t)number(optarg, &ok);
+            break;
+        case 'r':
+            opts.read_percent = (uint32_t)number(optarg, &ok);
+            break;
+        case 'R':
+            opts.random = true;
+            break;
+        case 'n':
+            opts.ops = number(optarg, &ok);
+            break;
+        case 'i':
+            opts.runs = (uint32_t)number(optarg, &ok);
+            break;
+        case 's':
+            opts.range = number(optarg, &ok);
+            break;
+        case 'v':
+            opts.verify = true;
+            break;
+        default:
+            ok = false;
+            break;
+        }
+    }
+    if (!ok || optind != argc - 1 || opts.depth == 0 || opts.clients == 0 ||
+        opts.read_percent > 100 || opts.ops == 0 || opts.xfer == 0 ||
+        (uint64_t)opts.depth * opts.clients > BLOCK_FIFO_MAX_DEPTH) {
+        return usage();
+    }
+    const char* dev = argv[optind];
+
+    bool writes = opts.read_percent < 100 || opts.verify;
+    if ((fd = open(dev, writes ? O_RDWR : O_RDONLY)) < 0) {
+        fprintf(stderr, "error: cannot open '%s'\n", dev);
+        return -1;
+    }
+
+    block_info_t info;
+    if (ioctl_block_get_info(fd, &info) != sizeof(info)) {
+        fprintf(stderr, "error: cannot get info for '%s'\n", dev);
+        return -1;
+    }
+    if (writes && (info.flags & BLOCK_FLAG_READONLY)) {
+        fprintf(stderr, "error: '%s' is read-only\n", dev);
+        return -1;
+    }
+    if (opts.xfer % info.block_size || opts.xfer % sizeof(uint64_t) ||
+        (info.max_transfer_size && opts.xfer > info.max_transfer_size)) {
+        fprintf(stderr, "error: request size must be a multiple of %u bytes", info.block_size);
+        if (info.max_transfer_size) {
+            fprintf(stderr, ", at most %u", info.max_transfer_size);
+        }
+        fprintf(stderr, "\n");
+        return -1;
+    }
+
+    uint64_t range = info.block_count * info.block_size;
+    if (opts.range && opts.range < range) {
+        range = opts.range;
+    }
+    // Round down so that every client has the same share.
+    nblocks = range / opts.xfer / opts.clients * opts.clients;
+    if (nblocks == 0) {
+        fprintf(stderr, "error: '%s' is too small\n", dev);
+        return -1;
+    }
+
+    seed = zx_ticks_get();
+    rng_state = seed | 1;
+
+    clients = calloc(opts.clients, sizeof(client_t));
+    slots = calloc(opts.clients * opts.depth, sizeof(slot_t));
+    uint64_t* latencies = malloc(sizeof(uint64_t) * (opts.ops > nblocks ? opts.ops : nblocks));
+    if (clients == NULL || slots == NULL || latencies == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        return -1;
+    }
+
+    int ret = -1;
+    if (setup(dev) != ZX_OK) {
+        goto done;
+    }
+
+    printf("%s: %" PRIu64 " blocks of %zu bytes, %s, %u%% reads, %u client%s x %u in flight%s\n",
+           dev, nblocks, opts.xfer, opts.random ? "random" : "sequential",
+           opts.read_percent, opts.clients, opts.clients == 1 ? "" : "s", opts.depth,
+           opts.verify ? ", verifying" : "");
+
+    if (opts.verify) {
+        // Each client writes its share of the device once, in order.
+        if (run(nblocks, 0, false, latencies) == 0) {
+            goto done;
+        }
+    }
+    for (uint32_t i = 0; i < opts.runs; i++) {
+        uint64_t ticks = run(opts.ops, opts.read_percent, opts.random, latencies);
+        if (ticks == 0) {
+            goto done;
+        }
+        report(i, opts.ops, ticks, latencies);
+    }
+    ret = 0;
+
+done:
+    teardown();
+    free(latencies);
+    free(slots);
+    free(clients);
+    close(fd);
+    return ret;
+}
@@ -29,8 +29,13 @@ namespace {
 
 #define MIN_ARGS 2
 
+// Reads of readable blobs are dispatched from this many threads at once; see
+// fs::Vfs::SetConcurrent().
+constexpr uint32_t kDispatchThreads = 4;
+
 typedef struct {
     bool readonly = false;
+    bool compress = false;
     uint64_t data_blocks = blobstore::kStartBlockMinimum; // Account for reserved blocks
     fbl::Vector<fbl::String> blob_list;
 } blob_options_t;
@@ -48,8 +53,16 @@ int do_blobstore_mount(fbl::unique_fd fd, const blob_options_t& options) {
         readonly = block_info.flags & BLOCK_FLAG_READONLY;
     }
 
+    async::Loop loop;
+    blobstore::blobstore_options_t mount_options;
+    mount_options.compress = options.compress;
+    // fshost passes on the events for the memory pressure levels, if it has them.
+    zx::event memory_warning(zx_get_startup_handle(PA_HND(PA_USER1, 0)));
+    zx::event memory_critical(zx_get_startup_handle(PA_HND(PA_USER1, 1)));
     fbl::RefPtr<blobstore::VnodeBlob> vn;
-    if (blobstore::blobstore_mount(&vn, fbl::move(fd)) < 0) {
+    if (blobstore::blobstore_mount(&vn, fbl::move(fd), mount_options, loop.async(),
+                                   fbl::move(memory_warning),
+                                   fbl::move(memory_critical)) < 0) {
         return -1;
     }
     zx_handle_t h = zx_get_startup_handle(PA_HND(PA_USER0, 0));
@@ -58,14 +71,17 @@ int do_blobstore_mount(fbl::unique_fd fd, const blob_options_t& options) {
         return -1;
     }
 
-    async::Loop loop;
     fs::Vfs vfs(loop.async());
     vfs.SetReadonly(readonly);
+    vfs.SetConcurrent(true);
     zx_status_t status;
     if ((status = vfs.ServeDirectory(fbl::move(vn), zx::channel(h))) != ZX_OK) {
         return status;
     }
     trace::TraceProvider provider(loop.async());
+    for (uint32_t i = 1; i < kDispatchThreads; i++) {
+        loop.StartThread("blobstore-dispatcher");
+    }
     loop.Run();
     return ZX_OK;
 }
@@ -110,6 +126,7 @@ int usage() {
             "usage: blobstore [ <options>* ] <command> [ <arg>* ]\n"
             "\n"
             "options: --readonly  Mount filesystem read-only\n"
+            "         --compress  Compress the data of blobs written\n"
             "\n"
             "On Fuchsia, blobstore takes the block device argument by handle.\n"
             "This can make 'blobstore' commands hard to invoke from command line.\n"
@@ -137,6 +154,8 @@ int process_args(int argc, char** argv, CommandFunction* func, blob_options_t* o
     while (argc > 1) {
         if (!strcmp(argv[0], "--readonly")) {
             options->readonly = true;
+        } else if (!strcmp(argv[0], "--compress")) {
+            options->compress = true;
         } else {
             break;
         }
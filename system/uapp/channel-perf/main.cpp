@@ -4,15 +4,23 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <unistd.h>
 
 #include <zircon/compiler.h>
+#include <zircon/device/sysinfo.h>
 #include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
+#include <zircon/syscalls/port.h>
 #include <fbl/algorithm.h>
+#include <fbl/atomic.h>
 #include <fbl/unique_ptr.h>
 
 namespace {
@@ -28,6 +36,140 @@ void duplicate_handles(uint32_t n, zx_handle_t src, zx_handle_t* dest) {
     }
 }
 
+void close_handle(zx_handle_t* handle) {
+    if (*handle != ZX_HANDLE_INVALID) {
+        __UNUSED zx_status_t status = zx_handle_close(*handle);
+        assert(status == ZX_OK);
+        *handle = ZX_HANDLE_INVALID;
+    }
+}
+
+// The root resource, for reading the kernel's message allocation and
+// scheduler handoff counters.
+// Stays invalid if we are not allowed to have it.
+zx_handle_t root_resource = ZX_HANDLE_INVALID;
+
+void get_root_resource() {
+    int fd = open("/dev/misc/sysinfo", O_RDWR);
+    if (fd < 0)
+        return;
+    if (ioctl_sysinfo_get_root_resource(fd, &root_resource) != sizeof(root_resource))
+        root_resource = ZX_HANDLE_INVALID;
+    close(fd);
+}
+
+struct KernelStats {
+    uint64_t cache_hits;
+    uint64_t cache_misses;
+    uint64_t handoffs;
+    uint64_t handoff_timeouts;
+};
+
+bool read_kernel_stats(KernelStats* out) {
+    if (root_resource == ZX_HANDLE_INVALID)
+        return false;
+
+    static constexpr size_t kMaxCpus = 32;
+    zx_info_cpu_stats_t stats[kMaxCpus];
+    size_t actual;
+    if (zx_object_get_info(root_resource, ZX_INFO_CPU_STATS, stats, sizeof(stats),
+                           &actual, nullptr) != ZX_OK)
+        return false;
+
+    *out = {};
+    for (size_t i = 0; i < actual; i++) {
+        out->cache_hits += stats[i].channel_msg_cache_hits;
+        out->cache_misses += stats[i].channel_msg_cache_misses;
+        out->handoffs += stats[i].handoffs;
+        out->handoff_timeouts += stats[i].handoff_timeouts;
+    }
+    return true;
+}
+
+KernelStats kernel_stats_delta(const KernelStats& before, const KernelStats& after) {
+    return {
+        after.cache_hits - before.cache_hits,
+        after.cache_misses - before.cache_misses,
+        after.handoffs - before.handoffs,
+        after.handoff_timeouts - before.handoff_timeouts,
+    };
+}
+
+struct Latency {
+    zx_duration_t p50;
+    zx_duration_t p99;
+    zx_duration_t p999;
+    zx_duration_t max;
+};
+
+struct Result {
+    const char* test;
+    uint32_t size;
+    uint32_t handles;
+    uint32_t queue;
+    uint32_t pairs;     // client/server thread pairs, 0 for the single thread tests
+    uint64_t operations;
+    double per_second;
+    bool have_latency;
+    Latency latency;
+    bool have_stats;
+    KernelStats stats;  // what changed while the test ran
+};
+
+// Set with -j: print a JSON array with an object for each test, which can be
+// compared between runs, rather than text.
+bool json_output = false;
+bool first_result = true;
+uint32_t iteration = 0;
+
+void report(const Result& r) {
+    if (json_output) {
+        printf("%s  {\"test\": \"%s\", \"iteration\": %" PRIu32 ", \"size\": %" PRIu32
+               ", \"handles\": %" PRIu32 ", \"queue\": %" PRIu32 ", \"pairs\": %" PRIu32
+               ", \"operations\": %" PRIu64 ", \"per_second\": %.0f",
+               first_result ? "\n" : ",\n", r.test, iteration, r.size, r.handles, r.queue,
+               r.pairs, r.operations, r.per_second);
+        if (r.have_latency) {
+            printf(", \"latency_ns\": {\"p50\": %" PRId64 ", \"p99\": %" PRId64
+                   ", \"p999\": %" PRId64 ", \"max\": %" PRId64 "}",
+                   r.latency.p50, r.latency.p99, r.latency.p999, r.latency.max);
+        }
+        // These are system wide, so they include traffic from everything
+        // else that ran during the test.
+        if (r.have_stats) {
+            printf(", \"kernel\": {\"msg_cache_hits\": %" PRIu64 ", \"msg_cache_misses\": %" PRIu64
+                   ", \"handoffs\": %" PRIu64 ", \"handoff_timeouts\": %" PRIu64 "}",
+                   r.stats.cache_hits, r.stats.cache_misses, r.stats.handoffs,
+                   r.stats.handoff_timeouts);
+        }
+        printf("}");
+        first_result = false;
+        return;
+    }
+
+    if (r.pairs == 0) {
+        printf("write/read %" PRIu32 " bytes, %" PRIu32 " handles (%" PRIu32 " pre-queued): "
+                   "%.0f iterations/second\n",
+               r.size, r.handles, r.queue, r.per_second);
+    } else {
+        printf("%s %" PRIu32 " bytes, %" PRIu32 " handles, %" PRIu32 " thread pairs: "
+                   "%.0f round trips/second\n",
+               r.test, r.size, r.handles, r.pairs, r.per_second);
+        printf("  latency: p50 %" PRId64 " ns, p99 %" PRId64 " ns, p99.9 %" PRId64
+               " ns, max %" PRId64 " ns\n",
+               r.latency.p50, r.latency.p99, r.latency.p999, r.latency.max);
+    }
+    if (r.have_stats) {
+        printf("  message allocations: %" PRIu64 " from cache, %" PRIu64 " from heap\n",
+               r.stats.cache_hits, r.stats.cache_misses);
+        if (r.pairs != 0) {
+            printf("  cpu handoffs: %" PRIu64 ", handed to another cpu after timing out: %" PRIu64
+                   "\n",
+                   r.stats.handoffs, r.stats.handoff_timeouts);
+        }
+    }
+}
+
 struct TestArgs {
     uint32_t size;
     uint32_t handles;
@@ -69,6 +211,9 @@ void do_test(uint32_t duration, const TestArgs& test_args) {
 
     duplicate_handles(test_args.handles, event, handles.get());
 
+    KernelStats alloc_before;
+    bool have_alloc_stats = read_kernel_stats(&alloc_before);
+
     static constexpr uint32_t big_it_size = 10000;
     uint64_t big_its = 0;
     uint64_t start_ns = zx_time_get(ZX_CLOCK_MONOTONIC);
@@ -105,11 +250,533 @@ void do_test(uint32_t duration, const TestArgs& test_args) {
     status = zx_handle_close(mp[1]);
     assert(status == ZX_OK);
 
+    KernelStats alloc_after;
+    have_alloc_stats = have_alloc_stats && read_kernel_stats(&alloc_after);
+
     double real_duration = static_cast<double>(end_ns - start_ns) / 1000000000.0;
-    double its_per_second = static_cast<double>(big_its) * big_it_size / real_duration;
-    printf("write/read %" PRIu32 " bytes, %" PRIu32 " handles (%" PRIu32 " pre-queued): "
-               "%.0f iterations/second\n",
-           test_args.size, test_args.handles, test_args.queue, its_per_second);
+    Result result = {};
+    result.test = "channel-write-read";
+    result.size = test_args.size;
+    result.handles = test_args.handles;
+    result.queue = test_args.queue;
+    result.operations = big_its * big_it_size;
+    result.per_second = static_cast<double>(result.operations) / real_duration;
+    result.have_stats = have_alloc_stats;
+    if (have_alloc_stats)
+        result.stats = kernel_stats_delta(alloc_before, alloc_after);
+    report(result);
+}
+
+// One of the IPC primitives, set up between a client (side 0) and a server
+// (side 1). The client times round trips: it sends a message and waits for
+// the server to send one straight back.
+class Transport {
+public:
+    Transport(uint32_t size, uint32_t handles) : size_(size), handles_(handles) {}
+    virtual ~Transport() {}
+
+    // What each message actually carries; not every primitive can carry
+    // every size, or handles.
+    uint32_t size() const { return size_; }
+    uint32_t handles() const { return handles_; }
+
+    virtual void Send(int side) = 0;
+    // Waits for a message on |side|. Returns false once the other side has
+    // gone away.
+    virtual bool Receive(int side) = 0;
+
+    virtual void RoundTrip() {
+        Send(0);
+        Receive(0);
+    }
+
+    // Called on the client once it is done, to get the server out of
+    // Receive() for the last time.
+    virtual void Stop() { Send(0); }
+
+protected:
+    uint32_t size_;
+    uint32_t handles_;
+};
+
+class ChannelTransport : public Transport {
+public:
+    ChannelTransport(uint32_t size, uint32_t handles) : Transport(size, handles) {
+        __UNUSED zx_status_t status = zx_channel_create(0u, &channel_[0], &channel_[1]);
+        assert(status == ZX_OK);
+        for (int side = 0; side < 2; side++) {
+            data_[side].reset(new uint8_t[fbl::max(size_, 1u)]());
+            handle_[side].reset(new zx_handle_t[fbl::max(handles_, 1u)]);
+        }
+
+        // The same handles go back and forth, and start out on the client.
+        zx_handle_t event;
+        status = zx_event_create(0u, &event);
+        assert(status == ZX_OK);
+        duplicate_handles(handles_, event, handle_[0].get());
+        close_handle(&event);
+    }
+
+    ~ChannelTransport() override {
+        // By now the handles are back on the client.
+        for (uint32_t i = 0; i < handles_; i++)
+            close_handle(&handle_[0][i]);
+        close_handle(&channel_[0]);
+        close_handle(&channel_[1]);
+    }
+
+    void Send(int side) override {
+        __UNUSED zx_status_t status = zx_channel_write(channel_[side], 0u, data_[side].get(),
+                                                       size_, handle_[side].get(), handles_);
+        assert(status == ZX_OK);
+    }
+
+    bool Receive(int side) override {
+        zx_signals_t pending;
+        __UNUSED zx_status_t status =
+            zx_object_wait_one(channel_[side], ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED,
+                               ZX_TIME_INFINITE, &pending);
+        assert(status == ZX_OK);
+        if (!(pending & ZX_CHANNEL_READABLE))
+            return false;
+        uint32_t r_size, r_handles;
+        status = zx_channel_read(channel_[side], 0u, data_[side].get(), handle_[side].get(),
+                                 size_, handles_, &r_size, &r_handles);
+        assert(status == ZX_OK);
+        assert(r_size == size_);
+        assert(r_handles == handles_);
+        return true;
+    }
+
+    void Stop() override { close_handle(&channel_[0]); }
+
+protected:
+    zx_handle_t channel_[2] = {ZX_HANDLE_INVALID, ZX_HANDLE_INVALID};
+    fbl::unique_ptr<uint8_t[]> data_[2];
+    fbl::unique_ptr<zx_handle_t[]> handle_[2];
+};
+
+// The server side is the same as ChannelTransport's, and sends back the
+// transaction id it was sent.
+class ChannelCallTransport : public ChannelTransport {
+public:
+    ChannelCallTransport(uint32_t size, uint32_t handles)
+        : ChannelTransport(fbl::max(size, static_cast<uint32_t>(sizeof(zx_txid_t))), handles) {}
+
+    void RoundTrip() override {
+        zx_channel_call_args_t args = {
+            data_[0].get(), handle_[0].get(), data_[0].get(), handle_[0].get(),
+            size_, handles_, size_, handles_,
+        };
+        uint32_t r_size, r_handles;
+        __UNUSED zx_status_t status = zx_channel_call(channel_[0], 0u, ZX_TIME_INFINITE, &args,
+                                                      &r_size, &r_handles, nullptr);
+        assert(status == ZX_OK);
+        assert(r_size == size_);
+        assert(r_handles == handles_);
+    }
+};
+
+class SocketTransport : public Transport {
+public:
+    SocketTransport(uint32_t size, uint32_t options)
+        : Transport(fbl::max(size, 1u), 0u), options_(options) {
+        __UNUSED zx_status_t status = zx_socket_create(options_, &socket_[0], &socket_[1]);
+        assert(status == ZX_OK);
+        for (int side = 0; side < 2; side++)
+            data_[side].reset(new uint8_t[size_]());
+    }
+
+    ~SocketTransport() override {
+        close_handle(&socket_[0]);
+        close_handle(&socket_[1]);
+    }
+
+    void Send(int side) override {
+        // A stream socket may take the message in pieces.
+        size_t sent = 0;
+        while (sent < size_) {
+            size_t actual;
+            zx_status_t status = zx_socket_write(socket_[side], 0u, data_[side].get() + sent,
+                                                 size_ - sent, &actual);
+            if (status == ZX_ERR_SHOULD_WAIT) {
+                status = zx_object_wait_one(socket_[side], ZX_SOCKET_WRITABLE, ZX_TIME_INFINITE,
+                                            nullptr);
+                assert(status == ZX_OK);
+                continue;
+            }
+            assert(status == ZX_OK);
+            sent += actual;
+        }
+    }
+
+    bool Receive(int side) override {
+        size_t received = 0;
+        while (received < size_) {
+            zx_signals_t pending;
+            __UNUSED zx_status_t status =
+                zx_object_wait_one(socket_[side], ZX_SOCKET_READABLE | ZX_SOCKET_PEER_CLOSED,
+                                   ZX_TIME_INFINITE, &pending);
+            assert(status == ZX_OK);
+            if (!(pending & ZX_SOCKET_READABLE))
+                return false;
+            size_t actual;
+            status = zx_socket_read(socket_[side], 0u, data_[side].get() + received,
+                                    size_ - received, &actual);
+            assert(status == ZX_OK);
+            received += actual;
+            if (options_ & ZX_SOCKET_DATAGRAM) {
+                assert(actual == size_);
+                break;
+            }
+        }
+        return true;
+    }
+
+    void Stop() override { close_handle(&socket_[0]); }
+
+private:
+    const uint32_t options_;
+    zx_handle_t socket_[2] = {ZX_HANDLE_INVALID, ZX_HANDLE_INVALID};
+    fbl::unique_ptr<uint8_t[]> data_[2];
+};
+
+// Each message is a single fifo element.
+class FifoTransport : public Transport {
+public:
+    static constexpr uint32_t kMaxElemSize = 2048;
+
+    FifoTransport(uint32_t size, uint32_t handles)
+        : Transport(fbl::clamp(size, 1u, kMaxElemSize), 0u) {
+        __UNUSED zx_status_t status = zx_fifo_create(2u, size_, 0u, &fifo_[0], &fifo_[1]);
+        assert(status == ZX_OK);
+        for (int side = 0; side < 2; side++)
+            data_[side].reset(new uint8_t[size_]());
+    }
+
+    ~FifoTransport() override {
+        close_handle(&fifo_[0]);
+        close_handle(&fifo_[1]);
+    }
+
+    void Send(int side) override {
+        uint32_t actual;
+        __UNUSED zx_status_t status = zx_fifo_write(fifo_[side], data_[side].get(), size_,
+                                                    &actual);
+        assert(status == ZX_OK);
+        assert(actual == 1u);
+    }
+
+    bool Receive(int side) override {
+        zx_signals_t pending;
+        __UNUSED zx_status_t status =
+            zx_object_wait_one(fifo_[side], ZX_FIFO_READABLE | ZX_FIFO_PEER_CLOSED,
+                               ZX_TIME_INFINITE, &pending);
+        assert(status == ZX_OK);
+        if (!(pending & ZX_FIFO_READABLE))
+            return false;
+        uint32_t actual;
+        status = zx_fifo_read(fifo_[side], data_[side].get(), size_, &actual);
+        assert(status == ZX_OK);
+        assert(actual == 1u);
+        return true;
+    }
+
+    void Stop() override { close_handle(&fifo_[0]); }
+
+private:
+    zx_handle_t fifo_[2] = {ZX_HANDLE_INVALID, ZX_HANDLE_INVALID};
+    fbl::unique_ptr<uint8_t[]> data_[2];
+};
+
+// Each side waits on its own port, and the other side queues user packets
+// to it.
+class PortTransport : public Transport {
+public:
+    PortTransport(uint32_t size, uint32_t handles)
+        : Transport(static_cast<uint32_t>(sizeof(zx_packet_user_t)), 0u) {
+        for (int side = 0; side < 2; side++) {
+            __UNUSED zx_status_t status = zx_port_create(0u, &port_[side]);
+            assert(status == ZX_OK);
+        }
+    }
+
+    ~PortTransport() override {
+        close_handle(&port_[0]);
+        close_handle(&port_[1]);
+    }
+
+    void Send(int side) override {
+        zx_port_packet_t packet = {};
+        packet.type = ZX_PKT_TYPE_USER;
+        __UNUSED zx_status_t status = zx_port_queue(port_[1 - side], &packet, 0u);
+        assert(status == ZX_OK);
+    }
+
+    bool Receive(int side) override {
+        zx_port_packet_t packet;
+        __UNUSED zx_status_t status = zx_port_wait(port_[side], ZX_TIME_INFINITE, &packet, 0u);
+        assert(status == ZX_OK);
+        return true;
+    }
+
+private:
+    zx_handle_t port_[2] = {ZX_HANDLE_INVALID, ZX_HANDLE_INVALID};
+};
+
+// Messages are ZX_USER_SIGNAL_0 raised on the peer.
+class EventPairTransport : public Transport {
+public:
+    EventPairTransport(uint32_t size, uint32_t handles) : Transport(0u, 0u) {
+        __UNUSED zx_status_t status = zx_eventpair_create(0u, &event_[0], &event_[1]);
+        assert(status == ZX_OK);
+    }
+
+    ~EventPairTransport() override {
+        close_handle(&event_[0]);
+        close_handle(&event_[1]);
+    }
+
+    void Send(int side) override {
+        __UNUSED zx_status_t status = zx_object_signal_peer(event_[side], 0u, ZX_USER_SIGNAL_0);
+        assert(status == ZX_OK);
+    }
+
+    bool Receive(int side) override {
+        zx_signals_t pending;
+        __UNUSED zx_status_t status =
+            zx_object_wait_one(event_[side], ZX_USER_SIGNAL_0 | ZX_EPAIR_PEER_CLOSED,
+                               ZX_TIME_INFINITE, &pending);
+        assert(status == ZX_OK);
+        if (!(pending & ZX_USER_SIGNAL_0))
+            return false;
+        status = zx_object_signal(event_[side], ZX_USER_SIGNAL_0, 0u);
+        assert(status == ZX_OK);
+        return true;
+    }
+
+    void Stop() override { close_handle(&event_[0]); }
+
+private:
+    zx_handle_t event_[2] = {ZX_HANDLE_INVALID, ZX_HANDLE_INVALID};
+};
+
+// Each side sleeps on its own futex until the other side sets it to 1.
+class FutexTransport : public Transport {
+public:
+    FutexTransport(uint32_t size, uint32_t handles) : Transport(0u, 0u) {}
+
+    void Send(int side) override {
+        __atomic_store_n(&futex_[1 - side], 1, __ATOMIC_RELEASE);
+        __UNUSED zx_status_t status = zx_futex_wake(&futex_[1 - side], 1u);
+        assert(status == ZX_OK);
+    }
+
+    bool Receive(int side) override {
+        while (__atomic_load_n(&futex_[side], __ATOMIC_ACQUIRE) == 0) {
+            __UNUSED zx_status_t status = zx_futex_wait(&futex_[side], 0, ZX_TIME_INFINITE);
+            assert(status == ZX_OK || status == ZX_ERR_BAD_STATE);
+        }
+        __atomic_store_n(&futex_[side], 0, __ATOMIC_RELAXED);
+        return true;
+    }
+
+private:
+    zx_futex_t futex_[2] = {0, 0};
+};
+
+struct Benchmark {
+    const char* name;
+    Transport* (*create)(uint32_t size, uint32_t handles);
+};
+
+template <typename T>
+Transport* create_transport(uint32_t size, uint32_t handles) {
+    return new T(size, handles);
+}
+
+const Benchmark benchmarks[] = {
+    {"channel", create_transport<ChannelTransport>},
+    {"channel-call", create_transport<ChannelCallTransport>},
+    {"socket-stream",
+     [](uint32_t size, uint32_t handles) -> Transport* {
+         return new SocketTransport(size, ZX_SOCKET_STREAM);
+     }},
+    {"socket-datagram",
+     [](uint32_t size, uint32_t handles) -> Transport* {
+         return new SocketTransport(size, ZX_SOCKET_DATAGRAM);
+     }},
+    {"fifo", create_transport<FifoTransport>},
+    {"port", create_transport<PortTransport>},
+    {"eventpair", create_transport<EventPairTransport>},
+    {"futex", create_transport<FutexTransport>},
+};
+
+const Benchmark* find_benchmark(const char* name) {
+    for (const Benchmark& benchmark : benchmarks) {
+        if (!strcmp(benchmark.name, name))
+            return &benchmark;
+    }
+    return nullptr;
+}
+
+// Keeps a uniform sample of up to kMaxSamples round trip times, in ticks, so
+// that long runs don't need unbounded memory.
+class LatencySamples {
+public:
+    static constexpr uint64_t kMaxSamples = 1u << 18;
+
+    LatencySamples() : samples_(new uint64_t[kMaxSamples]) {}
+
+    void Add(uint64_t ticks) {
+        if (count_ < kMaxSamples) {
+            samples_[count_] = ticks;
+        } else {
+            uint64_t i = Random() % (count_ + 1);
+            if (i < kMaxSamples)
+                samples_[i] = ticks;
+        }
+        count_++;
+    }
+
+    uint64_t size() const { return fbl::min(count_, kMaxSamples); }
+    const uint64_t* data() const { return samples_.get(); }
+
+private:
+    uint64_t Random() {
+        rng_ = rng_ * 6364136223846793005ull + 1442695040888963407ull;
+        return rng_ >> 11;
+    }
+
+    fbl::unique_ptr<uint64_t[]> samples_;
+    uint64_t count_ = 0;
+    uint64_t rng_ = 1;
+};
+
+struct PingPong {
+    fbl::unique_ptr<Transport> transport;
+    fbl::atomic<bool> stop;
+    uint64_t duration;
+    uint64_t round_trips;
+    uint64_t elapsed;
+    LatencySamples samples;
+    thrd_t client;
+    thrd_t server;
+};
+
+int ping_pong_server(void* arg) {
+    PingPong* pp = static_cast<PingPong*>(arg);
+    while (pp->transport->Receive(1) && !pp->stop.load())
+        pp->transport->Send(1);
+    return 0;
+}
+
+int ping_pong_client(void* arg) {
+    PingPong* pp = static_cast<PingPong*>(arg);
+    uint64_t start = zx_ticks_get();
+    uint64_t now;
+    do {
+        uint64_t before = zx_ticks_get();
+        pp->transport->RoundTrip();
+        now = zx_ticks_get();
+        pp->samples.Add(now - before);
+        pp->round_trips++;
+    } while (now - start < pp->duration);
+    pp->elapsed = now - start;
+
+    pp->stop.store(true);
+    pp->transport->Stop();
+    return 0;
+}
+
+int compare_ticks(const void* a, const void* b) {
+    uint64_t ta = *static_cast<const uint64_t*>(a);
+    uint64_t tb = *static_cast<const uint64_t*>(b);
+    return ta < tb ? -1 : ta > tb;
+}
+
+struct PingPongArgs {
+    const char* benchmark;
+    uint32_t size;
+    uint32_t handles;
+    uint32_t pairs;
+};
+
+// Runs |args.pairs| clients and servers at once, each pair with its own
+// instance of the transport. Where the threads run is up to the scheduler.
+void do_ping_pong_test(uint32_t duration, const PingPongArgs& args) {
+    const Benchmark* benchmark = find_benchmark(args.benchmark);
+    assert(benchmark);
+
+    const uint64_t ticks_per_second = zx_ticks_per_second();
+    fbl::unique_ptr<PingPong[]> pps(new PingPong[args.pairs]);
+    for (uint32_t i = 0; i < args.pairs; i++) {
+        pps[i].transport.reset(benchmark->create(args.size, args.handles));
+        pps[i].stop.store(false);
+        pps[i].duration = duration * ticks_per_second;
+        pps[i].round_trips = 0;
+    }
+
+    KernelStats stats_before;
+    bool have_stats = read_kernel_stats(&stats_before);
+
+    __UNUSED int rc;
+    for (uint32_t i = 0; i < args.pairs; i++) {
+        rc = thrd_create(&pps[i].server, ping_pong_server, &pps[i]);
+        assert(rc == thrd_success);
+    }
+    for (uint32_t i = 0; i < args.pairs; i++) {
+        rc = thrd_create(&pps[i].client, ping_pong_client, &pps[i]);
+        assert(rc == thrd_success);
+    }
+    for (uint32_t i = 0; i < args.pairs; i++) {
+        rc = thrd_join(pps[i].client, nullptr);
+        assert(rc == thrd_success);
+        rc = thrd_join(pps[i].server, nullptr);
+        assert(rc == thrd_success);
+    }
+
+    KernelStats stats_after;
+    have_stats = have_stats && read_kernel_stats(&stats_after);
+
+    Result result = {};
+    result.test = benchmark->name;
+    result.size = pps[0].transport->size();
+    result.handles = pps[0].transport->handles();
+    result.pairs = args.pairs;
+    result.have_stats = have_stats;
+    if (have_stats)
+        result.stats = kernel_stats_delta(stats_before, stats_after);
+
+    uint64_t num_samples = 0;
+    for (uint32_t i = 0; i < args.pairs; i++) {
+        result.operations += pps[i].round_trips;
+        result.per_second += static_cast<double>(pps[i].round_trips) * ticks_per_second /
+                             static_cast<double>(pps[i].elapsed);
+        num_samples += pps[i].samples.size();
+    }
+
+    // The percentiles are over all the pairs' round trips together.
+    fbl::unique_ptr<uint64_t[]> samples(new uint64_t[num_samples]);
+    uint64_t n = 0;
+    for (uint32_t i = 0; i < args.pairs; i++) {
+        memcpy(&samples[n], pps[i].samples.data(), pps[i].samples.size() * sizeof(uint64_t));
+        n += pps[i].samples.size();
+    }
+    qsort(samples.get(), num_samples, sizeof(uint64_t), compare_ticks);
+
+    auto percentile = [&](double p) -> zx_duration_t {
+        uint64_t i = fbl::min(static_cast<uint64_t>(p * static_cast<double>(num_samples)),
+                              num_samples - 1);
+        return static_cast<zx_duration_t>(static_cast<double>(samples[i]) * 1e9 /
+                                          static_cast<double>(ticks_per_second));
+    };
+    result.have_latency = true;
+    result.latency.p50 = percentile(0.5);
+    result.latency.p99 = percentile(0.99);
+    result.latency.p999 = percentile(0.999);
+    result.latency.max = percentile(1.0);
+    report(result);
 }
 
 }  // namespace
@@ -119,18 +786,25 @@ int main(int argc, char** argv) {
         "Usage: %s [options ...]\n"
         "\n"
         "Options:\n"
-        "  -h    show help (this)\n"
-        "  -o    run single test (default)\n"
-        "  -s    run suite (ignores -S/-H/-Q)\n"
-        "  -n N  set test repetition count to N (default: 1)\n"
-        "  -d N  set test duration to N seconds (default: 5)\n"
-        "  -S N  set message size to N bytes (default: 10)\n"
-        "  -H N  set message handle count to N handles (default: 0)\n"
-        "  -Q N  set message pre-queue count to N messages (default: 0)\n";
-
-    bool run_suite = false;  // -o/-s
-    uint32_t duration = 5;   // -d
-    uint32_t repeats = 1;    // -n
+        "  -h       show help (this)\n"
+        "  -o       run single write/read test (default)\n"
+        "  -s       run suite (ignores -S/-H/-Q/-t)\n"
+        "  -b NAME  run round trip test NAME between threads (uses -S/-H/-t)\n"
+        "  -c       same as -b channel-call\n"
+        "  -l       list the round trip tests\n"
+        "  -j       print the results as JSON\n"
+        "  -n N     set test repetition count to N (default: 1)\n"
+        "  -d N     set test duration to N seconds (default: 5)\n"
+        "  -S N     set message size to N bytes (default: 10)\n"
+        "  -H N     set message handle count to N handles (default: 0)\n"
+        "  -Q N     set message pre-queue count to N messages (default: 0)\n"
+        "  -t N     run N client/server thread pairs at once (default: 1)\n";
+
+    bool run_suite = false;           // -o/-s
+    const char* benchmark = nullptr;  // -b/-c
+    uint32_t duration = 5;            // -d
+    uint32_t repeats = 1;             // -n
+    uint32_t pairs = 1;               // -t
     // Ignored when running a suite:
     TestArgs test_args = {
         10,                  // -S (size)
@@ -139,10 +813,10 @@ int main(int argc, char** argv) {
     };
 
     int opt;
-    while ((opt = getopt(argc, argv, "+hosn:d:S:H:Q:")) != -1) {
-        // Our option values are always unsigned numbers.
+    while ((opt = getopt(argc, argv, "+hosb:cljn:d:S:H:Q:t:")) != -1) {
+        // Our option values are always unsigned numbers, except for -b's.
         uint32_t value = 0;
-        if (optarg) {
+        if (optarg && opt != 'b') {
             errno = 0;
             char* endptr = nullptr;
             unsigned long long v = strtoull(optarg, &endptr, 10);
@@ -157,10 +831,27 @@ int main(int argc, char** argv) {
                 return EXIT_SUCCESS;
             case 'o':
                 run_suite = false;
+                benchmark = nullptr;
                 break;
             case 's':
                 run_suite = true;
                 break;
+            case 'b':
+                assert(optarg);
+                if (!find_benchmark(optarg))
+                    argument_error(argv[0], "unknown test, -l lists them");
+                benchmark = optarg;
+                break;
+            case 'c':
+                benchmark = "channel-call";
+                break;
+            case 'l':
+                for (const Benchmark& b : benchmarks)
+                    printf("%s\n", b.name);
+                return EXIT_SUCCESS;
+            case 'j':
+                json_output = true;
+                break;
             case 'n':
                 assert(optarg);
                 repeats = value;
@@ -181,6 +872,12 @@ int main(int argc, char** argv) {
                 assert(optarg);
                 test_args.queue = value;
                 break;
+            case 't':
+                assert(optarg);
+                if (value == 0 || value > 64)
+                    argument_error(argv[0], "thread pairs must be from 1 to 64");
+                pairs = value;
+                break;
             default:  // '?'
                 argument_error(argv[0], "invalid option");
                 break;
@@ -189,8 +886,14 @@ int main(int argc, char** argv) {
     if (optind < argc)
         argument_error(argv[0], "unexpected positional argument");
 
+    get_root_resource();
+
+    if (json_output)
+        printf("[");
+
     for (uint32_t i = 0; i < repeats; i++) {
-        if (repeats > 1u) {
+        iteration = i;
+        if (repeats > 1u && !json_output) {
             if (i > 0u)
                 printf("\n");
             printf("Test iteration #%" PRIu32 " (of %" PRIu32 "):\n", i + 1,
@@ -217,10 +920,44 @@ int main(int argc, char** argv) {
             };
             for (size_t i = 0; i < fbl::count_of(suite); i++)
                 do_test(duration, suite[i]);
+
+            static constexpr PingPongArgs ping_pong_suite[] = {
+                {"channel", 16, 0, 1},
+                {"channel", 1024, 0, 1},
+                {"channel", 16384, 0, 1},
+                {"channel", 16, 1, 1},
+                {"channel", 16, 5, 1},
+                {"channel", 16, 0, 4},
+                {"channel-call", 16, 0, 1},
+                {"channel-call", 1024, 0, 1},
+                {"channel-call", 16, 1, 1},
+                {"channel-call", 16, 0, 4},
+                {"socket-stream", 16, 0, 1},
+                {"socket-stream", 16384, 0, 1},
+                {"socket-stream", 16, 0, 4},
+                {"socket-datagram", 16, 0, 1},
+                {"socket-datagram", 16384, 0, 1},
+                {"fifo", 16, 0, 1},
+                {"fifo", 2048, 0, 1},
+                {"fifo", 16, 0, 4},
+                {"port", 0, 0, 1},
+                {"port", 0, 0, 4},
+                {"eventpair", 0, 0, 1},
+                {"eventpair", 0, 0, 4},
+                {"futex", 0, 0, 1},
+                {"futex", 0, 0, 4},
+            };
+            for (size_t i = 0; i < fbl::count_of(ping_pong_suite); i++)
+                do_ping_pong_test(duration, ping_pong_suite[i]);
+        } else if (benchmark) {
+            do_ping_pong_test(duration, {benchmark, test_args.size, test_args.handles, pairs});
         } else {
             do_test(duration, test_args);
         }
     }
 
+    if (json_output)
+        printf("\n]\n");
+
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,436 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A sampling cpu profiler. Every cpu records the running thread and its user
+// callstack every so many reference cycles, by way of the cpu-trace device,
+// and the samples are symbolized against the dsos of their process. The
+// output can be fed to zircon/scripts/symbolize to get function names.
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
+#include <inspector/inspector.h>
+#include <task-utils/get.h>
+#include <zircon/device/cpu-trace/cpu-perf.h>
+#include <zircon/device/cpu-trace/intel-pm.h>
+#include <zircon/status.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
+
+namespace {
+
+constexpr char kDevicePath[] = "/dev/misc/cpu-trace";
+
+typedef enum {
+#define DEF_FIXED_EVENT(symbol, id, regnum, flags, name, description) \
+    symbol##_ID = CPUPERF_MAKE_EVENT_ID(CPUPERF_UNIT_FIXED, id),
+#include <zircon/device/cpu-trace/intel-pm-events.inc>
+} fixed_event_id_t;
+
+struct Options {
+    uint32_t frequency = 1000;
+    uint32_t duration_sec = 10;
+    size_t top = 20;
+    bool kernel = false;
+    bool callstacks = false;
+};
+
+struct Sample {
+    zx_koid_t pid;
+    uint64_t pc;
+    uint32_t num_frames;
+    uint64_t frames[CPUPERF_MAX_CALLSTACK_FRAMES];
+};
+
+// A run of samples that compare equal, after sorting.
+struct Bucket {
+    const Sample* sample;
+    size_t count;
+};
+
+// A process samples were taken in, and what it takes to symbolize them.
+struct Process {
+    zx_koid_t pid;
+    size_t count;
+    char name[ZX_MAX_NAME_LEN];
+    inspector_dsoinfo_t* dso_list;
+};
+
+void usage() {
+    fprintf(stderr,
+            "Usage: cpuprof [options]\n"
+            "Samples what every cpu is running, and prints where the time went.\n"
+            "Options:\n"
+            "  -f <hz>      samples per second per busy cpu (default 1000)\n"
+            "  -d <sec>     how long to profile for (default 10)\n"
+            "  -n <count>   how many of the hottest pcs to print per process (default 20)\n"
+            "  -g           also print the hottest callstacks\n"
+            "  -k           also sample the kernel\n");
+}
+
+size_t record_size(const cpuperf_record_header_t* hdr) {
+    switch (hdr->type) {
+    case CPUPERF_RECORD_TIME:
+        return sizeof(cpuperf_time_record_t);
+    case CPUPERF_RECORD_TICK:
+        return sizeof(cpuperf_tick_record_t);
+    case CPUPERF_RECORD_COUNT:
+        return sizeof(cpuperf_count_record_t);
+    case CPUPERF_RECORD_VALUE:
+        return sizeof(cpuperf_value_record_t);
+    case CPUPERF_RECORD_PC:
+        return sizeof(cpuperf_pc_record_t);
+    case CPUPERF_RECORD_CALLSTACK: {
+        uint32_t num_frames;
+        memcpy(&num_frames,
+               reinterpret_cast<const char*>(hdr) +
+                   offsetof(cpuperf_callstack_record_t, num_frames),
+               sizeof(num_frames));
+        if (num_frames > CPUPERF_MAX_CALLSTACK_FRAMES)
+            return 0;
+        return CPUPERF_CALLSTACK_RECORD_SIZE(num_frames);
+    }
+    default:
+        return 0;
+    }
+}
+
+// Appends the samples in the buffer of one cpu to |samples|.
+zx_status_t read_buffer(zx_handle_t vmo, fbl::Vector<Sample>* samples, bool* full) {
+    cpuperf_buffer_header_t header;
+    size_t actual;
+    zx_status_t status = zx_vmo_read(vmo, &header, 0, sizeof(header), &actual);
+    if (status != ZX_OK)
+        return status;
+    if (header.version != CPUPERF_BUFFER_VERSION || header.capture_end < sizeof(header))
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    *full = *full || (header.flags & CPUPERF_BUFFER_FLAG_FULL);
+
+    size_t size = header.capture_end - sizeof(header);
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<char[]> data(new (&ac) char[size]);
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+    status = zx_vmo_read(vmo, data.get(), sizeof(header), size, &actual);
+    if (status != ZX_OK)
+        return status;
+
+    for (size_t offset = 0; offset < size;) {
+        auto hdr = reinterpret_cast<const cpuperf_record_header_t*>(data.get() + offset);
+        size_t rec_size = record_size(hdr);
+        if (rec_size == 0 || offset + rec_size > size)
+            return ZX_ERR_IO_DATA_INTEGRITY;
+
+        if (hdr->type == CPUPERF_RECORD_CALLSTACK) {
+            // Records are only 4 byte aligned.
+            cpuperf_callstack_record_t rec;
+            memcpy(&rec, hdr, sizeof(rec));
+            Sample sample = {};
+            sample.pid = rec.pid;
+            sample.pc = rec.pc;
+            sample.num_frames = rec.num_frames;
+            memcpy(sample.frames, data.get() + offset + sizeof(rec),
+                   rec.num_frames * sizeof(uint64_t));
+            samples->push_back(sample, &ac);
+            if (!ac.check())
+                return ZX_ERR_NO_MEMORY;
+        }
+        offset += rec_size;
+    }
+    return ZX_OK;
+}
+
+zx_status_t collect(int fd, const Options& options, fbl::Vector<Sample>* samples,
+                    bool* full) {
+    uint32_t num_cpus = zx_system_get_num_cpus();
+
+    // Room for every sample, and then some: samples of busy cpus come in
+    // at the requested frequency, plus a time record each.
+    size_t sample_size = sizeof(cpuperf_time_record_t) +
+                         CPUPERF_CALLSTACK_RECORD_SIZE(CPUPERF_MAX_CALLSTACK_FRAMES);
+    size_t buffer_size = sizeof(cpuperf_buffer_header_t) +
+                         2 * sample_size * options.frequency * options.duration_sec;
+    buffer_size = fbl::round_up(buffer_size, static_cast<size_t>(PAGE_SIZE));
+    if (buffer_size > UINT32_MAX) {
+        fprintf(stderr, "cpuprof: profiling for too long at that frequency\n");
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    ioctl_cpuperf_alloc_t alloc = {};
+    alloc.num_buffers = num_cpus;
+    alloc.buffer_size = static_cast<uint32_t>(buffer_size);
+    ssize_t result = ioctl_cpuperf_alloc_trace(fd, &alloc);
+    if (result < 0) {
+        fprintf(stderr, "cpuprof: unable to allocate trace buffers: %zd\n", result);
+        return static_cast<zx_status_t>(result);
+    }
+
+    // Reference cycles tick at a constant rate, that of the tsc, and don't
+    // while the cpu is halted, so idle cpus cost nothing.
+    cpuperf_config_t config = {};
+    config.events[0] = FIXED_UNHALTED_REFERENCE_CYCLES_ID;
+    config.rate[0] = static_cast<uint32_t>(zx_ticks_per_second() / options.frequency);
+    config.flags[0] = CPUPERF_CONFIG_FLAG_USER | CPUPERF_CONFIG_FLAG_CALLSTACK;
+    if (options.kernel)
+        config.flags[0] |= CPUPERF_CONFIG_FLAG_OS;
+
+    zx_status_t status = ZX_OK;
+    if ((result = ioctl_cpuperf_stage_config(fd, &config)) < 0) {
+        fprintf(stderr, "cpuprof: unable to configure sampling: %zd\n", result);
+        status = static_cast<zx_status_t>(result);
+    } else if ((result = ioctl_cpuperf_start(fd)) < 0) {
+        fprintf(stderr, "cpuprof: unable to start sampling: %zd\n", result);
+        status = static_cast<zx_status_t>(result);
+    } else {
+        zx_nanosleep(zx_deadline_after(ZX_SEC(options.duration_sec)));
+        ioctl_cpuperf_stop(fd);
+
+        for (uint32_t cpu = 0; cpu < num_cpus && status == ZX_OK; ++cpu) {
+            ioctl_cpuperf_buffer_handle_req_t req = {cpu};
+            zx_handle_t vmo;
+            if ((result = ioctl_cpuperf_get_buffer_handle(fd, &req, &vmo)) < 0) {
+                fprintf(stderr, "cpuprof: unable to get the buffer of cpu %u: %zd\n",
+                        cpu, result);
+                status = static_cast<zx_status_t>(result);
+                break;
+            }
+            status = read_buffer(vmo, samples, full);
+            if (status != ZX_OK) {
+                fprintf(stderr, "cpuprof: unable to read the buffer of cpu %u: %d(%s)\n",
+                        cpu, status, zx_status_get_string(status));
+            }
+            zx_handle_close(vmo);
+        }
+    }
+
+    ioctl_cpuperf_free_trace(fd);
+    return status;
+}
+
+int compare_pc(const Sample* a, const Sample* b) {
+    if (a->pid != b->pid)
+        return a->pid < b->pid ? -1 : 1;
+    if (a->pc != b->pc)
+        return a->pc < b->pc ? -1 : 1;
+    return 0;
+}
+
+int compare_callstack(const Sample* a, const Sample* b) {
+    int result = compare_pc(a, b);
+    if (result != 0)
+        return result;
+    if (a->num_frames != b->num_frames)
+        return a->num_frames < b->num_frames ? -1 : 1;
+    return memcmp(a->frames, b->frames, a->num_frames * sizeof(a->frames[0]));
+}
+
+// Sorts |samples| by |compare| and collects the runs of equal ones, most
+// frequent first.
+zx_status_t bucket(fbl::Vector<Sample>* samples, int (*compare)(const Sample*, const Sample*),
+                   fbl::Vector<Bucket>* buckets) {
+    qsort(samples->get(), samples->size(), sizeof(Sample),
+          reinterpret_cast<int (*)(const void*, const void*)>(compare));
+
+    buckets->reset();
+    fbl::AllocChecker ac;
+    for (size_t i = 0; i < samples->size();) {
+        size_t j = i + 1;
+        while (j < samples->size() && compare(&(*samples)[i], &(*samples)[j]) == 0)
+            ++j;
+        buckets->push_back(Bucket{&(*samples)[i], j - i}, &ac);
+        if (!ac.check())
+            return ZX_ERR_NO_MEMORY;
+        i = j;
+    }
+
+    // Ties are left in pid order, so a process's buckets stay together.
+    auto by_count = [](const void* a, const void* b) {
+        size_t ca = static_cast<const Bucket*>(a)->count;
+        size_t cb = static_cast<const Bucket*>(b)->count;
+        return ca > cb ? -1 : ca < cb ? 1 : 0;
+    };
+    qsort(buckets->get(), buckets->size(), sizeof(Bucket), by_count);
+    return ZX_OK;
+}
+
+void print_pc(int n, uint64_t pc, inspector_dsoinfo_t* dso_list) {
+    // Kernel addresses are in the upper half, above every dso.
+    inspector_dsoinfo_t* dso = nullptr;
+    if (!(pc & (1ul << 63)))
+        dso = inspector_dso_lookup(dso_list, pc);
+    if (dso == nullptr) {
+        printf("bt#%02d: pc %#" PRIx64 " sp 0\n", n, pc);
+    } else {
+        printf("bt#%02d: pc %#" PRIx64 " sp 0 (%s,%#" PRIx64 ")\n",
+               n, pc, inspector_dso_name(dso), pc - inspector_dso_base(dso));
+    }
+}
+
+void print_process(const Process& process, const fbl::Vector<Bucket>& pcs,
+                   const fbl::Vector<Bucket>& callstacks, size_t total,
+                   const Options& options) {
+    if (process.pid == ZX_KOID_INVALID) {
+        printf("\nkernel: %zu samples (%.1f%%)\n",
+               process.count, 100.0 * process.count / total);
+    } else {
+        printf("\nprocess %" PRIu64 " '%s': %zu samples (%.1f%%)\n",
+               process.pid, process.name, process.count, 100.0 * process.count / total);
+        inspector_dso_print_list(stdout, process.dso_list);
+    }
+
+    size_t printed = 0;
+    for (const auto& b : pcs) {
+        if (b.sample->pid != process.pid)
+            continue;
+        if (printed++ == options.top)
+            break;
+        printf("%6zu %5.1f%% ", b.count, 100.0 * b.count / total);
+        print_pc(0, b.sample->pc, process.dso_list);
+    }
+
+    printed = 0;
+    for (const auto& b : callstacks) {
+        if (b.sample->pid != process.pid)
+            continue;
+        if (printed++ == options.top)
+            break;
+        printf("callstack: %zu samples (%.1f%%)\n", b.count, 100.0 * b.count / total);
+        print_pc(0, b.sample->pc, process.dso_list);
+        for (uint32_t i = 0; i < b.sample->num_frames; ++i)
+            print_pc(i + 1, b.sample->frames[i], process.dso_list);
+        printf("bt#%02u: end\n", b.sample->num_frames + 1);
+    }
+}
+
+zx_status_t report(fbl::Vector<Sample>* samples, const Options& options) {
+    fbl::AllocChecker ac;
+
+    // Buckets point into the samples, so the callstacks are sorted in a
+    // copy of their own.
+    fbl::Vector<Sample> by_callstack;
+    fbl::Vector<Bucket> callstacks;
+    if (options.callstacks) {
+        by_callstack.reserve(samples->size(), &ac);
+        if (!ac.check())
+            return ZX_ERR_NO_MEMORY;
+        for (const auto& s : *samples)
+            by_callstack.push_back(s);
+        zx_status_t status = bucket(&by_callstack, compare_callstack, &callstacks);
+        if (status != ZX_OK)
+            return status;
+    }
+    fbl::Vector<Bucket> pcs;
+    zx_status_t status = bucket(samples, compare_pc, &pcs);
+    if (status != ZX_OK)
+        return status;
+
+    // Samples are sorted by pid now, which makes counting processes easy.
+    fbl::Vector<Process> processes;
+    for (const auto& s : *samples) {
+        if (processes.is_empty() || processes[processes.size() - 1].pid != s.pid) {
+            processes.push_back(Process{s.pid, 0, {}, nullptr}, &ac);
+            if (!ac.check())
+                return ZX_ERR_NO_MEMORY;
+        }
+        processes[processes.size() - 1].count++;
+    }
+    qsort(processes.get(), processes.size(), sizeof(Process),
+          [](const void* a, const void* b) {
+              size_t ca = static_cast<const Process*>(a)->count;
+              size_t cb = static_cast<const Process*>(b)->count;
+              return ca > cb ? -1 : ca < cb ? 1 : 0;
+          });
+
+    for (auto& process : processes) {
+        if (process.pid != ZX_KOID_INVALID) {
+            zx_obj_type_t type;
+            zx_handle_t handle;
+            if (get_task_by_koid(process.pid, &type, &handle) == ZX_OK) {
+                if (type == ZX_OBJ_TYPE_PROCESS) {
+                    zx_object_get_property(handle, ZX_PROP_NAME,
+                                           process.name, sizeof(process.name));
+                    process.dso_list = inspector_dso_fetch_list(handle);
+                }
+                zx_handle_close(handle);
+            } else {
+                strcpy(process.name, "<exited>");
+            }
+        }
+        print_process(process, pcs, callstacks, samples->size(), options);
+        inspector_dso_free_list(process.dso_list);
+        process.dso_list = nullptr;
+    }
+    return ZX_OK;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    int opt;
+    while ((opt = getopt(argc, argv, "f:d:n:gkh")) != -1) {
+        switch (opt) {
+        case 'f':
+            options.frequency = static_cast<uint32_t>(strtoul(optarg, nullptr, 0));
+            break;
+        case 'd':
+            options.duration_sec = static_cast<uint32_t>(strtoul(optarg, nullptr, 0));
+            break;
+        case 'n':
+            options.top = strtoul(optarg, nullptr, 0);
+            break;
+        case 'g':
+            options.callstacks = true;
+            break;
+        case 'k':
+            options.kernel = true;
+            break;
+        default:
+            usage();
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind != argc || options.frequency == 0 || options.duration_sec == 0 ||
+        options.frequency > zx_ticks_per_second()) {
+        usage();
+        return 1;
+    }
+
+    int fd = open(kDevicePath, O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "cpuprof: unable to open %s\n", kDevicePath);
+        return 1;
+    }
+
+    fbl::Vector<Sample> samples;
+    bool full = false;
+    zx_status_t status = collect(fd, options, &samples, &full);
+    close(fd);
+    if (status != ZX_OK)
+        return 1;
+
+    printf("cpuprof: %zu samples over %u s at %u Hz\n",
+           samples.size(), options.duration_sec, options.frequency);
+    if (full)
+        printf("cpuprof: a trace buffer filled up, some samples were dropped\n");
+    if (samples.is_empty())
+        return 0;
+
+    status = report(&samples, options);
+    if (status != ZX_OK) {
+        fprintf(stderr, "cpuprof: %d(%s)\n", status, zx_status_get_string(status));
+        return 1;
+    }
+    return 0;
+}
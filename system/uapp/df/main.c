@@ -5,6 +5,7 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdalign.h>
 #include <stdarg.h>
 #include <stdbool.h>
@@ -21,6 +22,7 @@ int usage(void) {
     fprintf(stderr, "df displays the mounted filesystems for a list of paths\n");
     fprintf(stderr, " -i : List inode information instead of block usage\n");
     fprintf(stderr, " -h : Show sizes in human readable format (e.g., 1K 2M 3G)\n");
+    fprintf(stderr, " -c : Also show block cache statistics, where supported\n");
     fprintf(stderr, " --help : Show this help message\n");
     return -1;
 }
@@ -28,6 +30,7 @@ int usage(void) {
 typedef struct {
     bool node_usage;
     bool human_readable;
+    bool cache_stats;
 } df_options_t;
 
 const char* root = "/";
@@ -38,6 +41,8 @@ int parse_args(int argc, const char** argv, df_options_t* options, const char***
             options->node_usage = true;
         } else if (!strcmp(argv[1], "-h")) {
             options->human_readable = true;
+        } else if (!strcmp(argv[1], "-c")) {
+            options->cache_stats = true;
         } else if (!strcmp(argv[1], "--help")) {
             return usage();
         } else {
@@ -144,6 +149,18 @@ void print_fs_type(const char* name, const df_options_t* options,
     }
 
 }
+void print_cache_info(const vfs_cache_info_t* cache) {
+    uint64_t lookups = cache->hits + cache->misses;
+    printf("  cache: %u x %u bytes, %" PRIu64 " hits, %" PRIu64 " misses (%" PRIu64 "%% hit), "
+           "%" PRIu64 " readahead, %" PRIu64 " evicted, %" PRIu64 " invalidated\n",
+           cache->capacity, cache->block_size, cache->hits, cache->misses,
+           lookups ? cache->hits * 100 / lookups : 0, cache->readahead, cache->evictions,
+           cache->invalidations);
+    printf("  writeback: %u of %u blocks in use (peak %u), %" PRIu64 " stalls for %" PRIu64
+           " ms\n", cache->writeback_used, cache->writeback_capacity, cache->writeback_peak,
+           cache->writeback_stalls, cache->writeback_stall_ns / 1000000);
+}
+
 typedef union {
     vfs_query_info_t info;
     struct {
@@ -200,6 +217,11 @@ int main(int argc, const char** argv) {
         ssize_t s = ioctl_vfs_get_device_path(fd, device_path, sizeof(device_path));
         const char* path = (s > 0 ? device_path : (admin ? NULL : "unknown; missing O_ADMIN"));
         print_fs_type(dirs[i], &options, name_len > 0 ? &wrapper.info : NULL, name_len, path);
+
+        vfs_cache_info_t cache;
+        if (options.cache_stats && ioctl_vfs_query_cache(fd, &cache) == sizeof(cache)) {
+            print_cache_info(&cache);
+        }
         close(fd);
     }
 
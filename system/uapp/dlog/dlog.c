@@ -64,30 +64,41 @@ int main(int argc, char** argv) {
         return -1;
     }
 
-    char buf[ZX_LOG_RECORD_MAX];
-    zx_log_record_t* rec = (zx_log_record_t*)buf;
+    uint64_t batch[ZX_LOG_RECORD_MAX * 8 / sizeof(uint64_t)];
     for (;;) {
         zx_status_t status;
-        if ((status = zx_log_read(h, ZX_LOG_RECORD_MAX, rec, 0)) < 0) {
+        if ((status = zx_log_read(h, sizeof(batch), batch, ZX_LOG_READ_BATCH)) < 0) {
             if ((status == ZX_ERR_SHOULD_WAIT) && tail) {
                 zx_object_wait_one(h, ZX_LOG_READABLE, ZX_TIME_INFINITE, NULL);
                 continue;
             }
             break;
         }
-        if (filter_pid && (pid != rec->pid)) {
-            continue;
-        }
-        if (!plain) {
-            char tmp[32];
-            size_t len = snprintf(tmp, sizeof(tmp), "[%05d.%03d] ",
-                                  (int)(rec->timestamp / 1000000000ULL),
-                                  (int)((rec->timestamp / 1000000ULL) % 1000ULL));
-            write(1, tmp, (len > sizeof(tmp) ? sizeof(tmp) : len));
-        }
-        write(1, rec->data, rec->datalen);
-        if ((rec->datalen == 0) || (rec->data[rec->datalen - 1] != '\n')) {
-            write(1, "\n", 1);
+        size_t actual = status;
+        for (size_t off = 0; off < actual;) {
+            zx_log_record_t* rec = (zx_log_record_t*)((char*)batch + off);
+            off = (off + sizeof(zx_log_record_t) + rec->datalen + 7) & ~7;
+
+            if (rec->dropped) {
+                char tmp[64];
+                size_t len = snprintf(tmp, sizeof(tmp), "dlog: %u records dropped\n",
+                                      rec->dropped);
+                write(1, tmp, (len > sizeof(tmp) ? sizeof(tmp) : len));
+            }
+            if (filter_pid && (pid != rec->pid)) {
+                continue;
+            }
+            if (!plain) {
+                char tmp[32];
+                size_t len = snprintf(tmp, sizeof(tmp), "[%05d.%03d] ",
+                                      (int)(rec->timestamp / 1000000000ULL),
+                                      (int)((rec->timestamp / 1000000ULL) % 1000ULL));
+                write(1, tmp, (len > sizeof(tmp) ? sizeof(tmp) : len));
+            }
+            write(1, rec->data, rec->datalen);
+            if ((rec->datalen == 0) || (rec->data[rec->datalen - 1] != '\n')) {
+                write(1, "\n", 1);
+            }
         }
     }
     return 0;
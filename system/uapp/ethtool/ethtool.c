@@ -11,6 +11,7 @@
 
 #include <arpa/inet.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <netinet/if_ether.h>
 #include <netinet/tcp.h>
@@ -25,6 +26,8 @@ typedef struct {
     const char* device;
     bool setting_promisc;
     bool promisc_on;
+    bool tx_stats;
+    bool irq_stats;
 } ethtool_options_t;
 
 int usage(void) {
@@ -33,6 +36,8 @@ int usage(void) {
     fprintf(stderr, "Actions:\n");
     fprintf(stderr, "  promisc on     : Promiscuous mode on\n");
     fprintf(stderr, "  promisc off    : Promiscuous mode off\n");
+    fprintf(stderr, "  txstats        : Show transmit batching statistics\n");
+    fprintf(stderr, "  irqstats       : Show interrupt moderation statistics\n");
     fprintf(stderr, "  --help  : Show this help message\n");
     return -1;
 }
@@ -65,6 +70,10 @@ int parse_args(int argc, const char** argv, ethtool_options_t* options) {
             } else {
                 return usage();
             }
+        } else if (!strcmp(argv[0], "txstats")) {
+            options->tx_stats = true;
+        } else if (!strcmp(argv[0], "irqstats")) {
+            options->irq_stats = true;
         } else { // Includes --help, -h, --HELF, --42, etc.
             return usage();
         }
@@ -83,6 +92,41 @@ int parse_args(int argc, const char** argv, ethtool_options_t* options) {
     return 0;
 }
 
+void print_tx_stats(const eth_tx_stats_t* stats) {
+    printf("tx frames: %" PRIu64 "\n", stats->frames);
+    printf("tx batches: %" PRIu64 "\n", stats->batches);
+    if (stats->batches > 0) {
+        printf("tx frames/batch: %" PRIu64 " avg, %u max\n",
+               stats->frames / stats->batches, stats->max_batch);
+    }
+    for (uint32_t n = 0; n < ETH_TX_STATS_BUCKETS; n++) {
+        if (stats->batch_sizes[n] == 0) {
+            continue;
+        }
+        if (n == ETH_TX_STATS_BUCKETS - 1) {
+            printf("  %4u+      : %" PRIu64 "\n", 1u << n, stats->batch_sizes[n]);
+        } else {
+            printf("  %4u-%-4u  : %" PRIu64 "\n", 1u << n, (2u << n) - 1,
+                   stats->batch_sizes[n]);
+        }
+    }
+}
+
+void print_irq_stats(const eth_irq_stats_t* stats) {
+    printf("interrupts: %" PRIu64 "\n", stats->interrupts);
+    printf("rx polls: %" PRIu64 "\n", stats->polls);
+    printf("rx packets: %" PRIu64 "\n", stats->rx_packets);
+    if (stats->interrupts > 0) {
+        printf("rx packets/interrupt: %" PRIu64 " avg\n",
+               stats->rx_packets / stats->interrupts);
+    }
+    if (stats->irq_rate) {
+        printf("interrupt rate limit: %u/s\n", stats->irq_rate);
+    } else {
+        printf("interrupt rate limit: none\n");
+    }
+}
+
 int main(int argc, const char** argv) {
     ethtool_options_t options;
     memset(&options, 0, sizeof(options));
@@ -111,5 +155,23 @@ int main(int argc, const char** argv) {
         }
     }
 
+    if (options.tx_stats) {
+        eth_tx_stats_t stats;
+        if ((r = ioctl_ethernet_get_tx_stats(fd, &stats)) < 0) {
+            fprintf(stderr, "ethtool: failed to get tx stats: %zd\n", r);
+        } else {
+            print_tx_stats(&stats);
+        }
+    }
+
+    if (options.irq_stats) {
+        eth_irq_stats_t stats;
+        if ((r = ioctl_ethernet_get_irq_stats(fd, &stats)) < 0) {
+            fprintf(stderr, "ethtool: failed to get irq stats: %zd\n", r);
+        } else {
+            print_irq_stats(&stats);
+        }
+    }
+
     return 0;
 }
@@ -6,6 +6,7 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -290,6 +291,12 @@ static int hid_input_thread(void* arg) {
         mtx_unlock(&print_lock);
     }
 
+    input_stats_t stats;
+    if (ioctl_input_get_stats(args->fd, &stats) >= 0) {
+        lprintf("hid: %s reports queued %" PRIu64 " dropped %" PRIu64 " reads %" PRIu64 "\n",
+                args->name, stats.reports_queued, stats.reports_dropped, stats.reads);
+    }
+
     lprintf("hid: closing %s\n", args->name);
     close(args->fd);
     delete args;
@@ -6,10 +6,12 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/param.h>
 #include <unistd.h>
 
 #include <hid/acer12.h>
@@ -26,6 +28,9 @@
 #define DEV_INPUT       "/dev/class/input"
 #define FRAMEBUFFER     "/dev/class/framebuffer/000"
 #define CLEAR_BTN_SIZE 50
+// Touch panels report far faster than we can usefully draw; have the driver
+// coalesce reports and wake us at most this often.
+#define MAX_DELIVERY_RATE_HZ 120
 #define I2C_HID_DEBUG 0
 
 enum touch_panel_type {
@@ -352,11 +357,23 @@ next_node:
         printf("failed to get max report size: %zd\n", ret);
         return -1;
     }
-    void* buf = malloc(max_rpt_sz);
+    input_delivery_t delivery = {
+        .flags = INPUT_DELIVERY_BATCH,
+        .max_rate_hz = MAX_DELIVERY_RATE_HZ,
+    };
+    bool batched = ioctl_input_set_delivery(touchfd, &delivery) >= 0;
+    if (!batched) {
+        printf("report batching not supported, reading one report at a time\n");
+    }
+
+    // Leave room for a full fifo's worth of reports when batching.
+    size_t buf_sz = batched ? 4096 : max_rpt_sz;
+    uint8_t* buf = malloc(buf_sz);
     if (buf == NULL) {
         printf("no memory!\n");
         return -1;
     }
+    uint64_t reported_drops = 0;
 
     ret = ioctl_console_set_active_vc(vcfd);
     if (ret < 0) {
@@ -367,22 +384,46 @@ next_node:
 
     clear_screen((void*)fbo, &fb);
     while (1) {
-        ssize_t r = read(touchfd, buf, max_rpt_sz);
+        ssize_t r = read(touchfd, buf, buf_sz);
         if (r < 0) {
             printf("touchscreen read error: %zd (errno=%d)\n", r, errno);
             break;
         }
-        if (panel == TOUCH_PANEL_ACER12) {
-            if (*(uint8_t*)buf == ACER12_RPT_ID_TOUCH) {
-                process_acer12_touchscreen_input(buf, r, vcfd, pixels32, &fb);
-            } else if (*(uint8_t*)buf == ACER12_RPT_ID_STYLUS) {
-                process_acer12_stylus_input(buf, r, vcfd, pixels32, &fb);
+
+        size_t off = 0;
+        while (off < (size_t)r) {
+            uint8_t* rpt = buf + off;
+            size_t rpt_len = r - off;
+            if (batched) {
+                input_report_hdr_t hdr;
+                if (rpt_len < sizeof(hdr)) break;
+                memcpy(&hdr, rpt, sizeof(hdr));
+                rpt += sizeof(hdr);
+                rpt_len = MIN(hdr.size, rpt_len - sizeof(hdr));
+                off += sizeof(hdr);
             }
-        } else if (panel == TOUCH_PANEL_PARADISE) {
-            if (*(uint8_t*)buf == PARADISE_RPT_ID_TOUCH) {
-                process_paradise_touchscreen_input(buf, r, vcfd, pixels32, &fb);
+            off += rpt_len;
+
+            if (panel == TOUCH_PANEL_ACER12) {
+                if (*rpt == ACER12_RPT_ID_TOUCH) {
+                    process_acer12_touchscreen_input(rpt, rpt_len, vcfd, pixels32, &fb);
+                } else if (*rpt == ACER12_RPT_ID_STYLUS) {
+                    process_acer12_stylus_input(rpt, rpt_len, vcfd, pixels32, &fb);
+                }
+            } else if (panel == TOUCH_PANEL_PARADISE) {
+                if (*rpt == PARADISE_RPT_ID_TOUCH) {
+                    process_paradise_touchscreen_input(rpt, rpt_len, vcfd, pixels32, &fb);
+                }
             }
         }
+
+        input_stats_t stats;
+        if (ioctl_input_get_stats(touchfd, &stats) >= 0 &&
+            stats.reports_dropped != reported_drops) {
+            printf("touchscreen: %" PRIu64 " of %" PRIu64 " reports dropped\n",
+                   stats.reports_dropped, stats.reports_dropped + stats.reports_queued);
+            reported_drops = stats.reports_dropped;
+        }
     }
 
     free(buf);
@@ -296,6 +296,9 @@ static int usage(void) {
             "    -c block_count - number of blocks to read (default=the whole device)\n"
             "    -o offset - block-size offset to start reading from (default=0)\n"
             "    -s seed - the seed to use for pseudorandom testing\n"
+            "    -p priority - fg, bg or idle (default=fg)\n"
+            "    -iops iops - the most requests per second to send (default=no limit)\n"
+            "    -bps bytes - the most bytes per second to send (default=no limit)\n"
             "    --live-dangerously - skip confirmation prompt\n");
     return -1;
 }
@@ -313,6 +316,7 @@ int iochk(int argc, char** argv) {
             device, info.block_size, info.block_count);
 
     int seed_set = 0;
+    block_fifo_policy_t policy = {};
     num_threads = 1;
     int i = 1;
     bool confirmed = false;
@@ -333,6 +337,24 @@ int iochk(int argc, char** argv) {
             base_seed = atoll(argv[i + 1]);
             seed_set = 1;
             i += 2;
+        } else if (strcmp(argv[i], "-p") == 0) {
+            if (strcmp(argv[i + 1], "fg") == 0) {
+                policy.priority = BLOCK_PRIORITY_FOREGROUND;
+            } else if (strcmp(argv[i + 1], "bg") == 0) {
+                policy.priority = BLOCK_PRIORITY_BACKGROUND;
+            } else if (strcmp(argv[i + 1], "idle") == 0) {
+                policy.priority = BLOCK_PRIORITY_IDLE;
+            } else {
+                fprintf(stderr, "Invalid priority %s\n", argv[i + 1]);
+                return -1;
+            }
+            i += 2;
+        } else if (strcmp(argv[i], "-iops") == 0) {
+            policy.max_iops = number(argv[i + 1]);
+            i += 2;
+        } else if (strcmp(argv[i], "-bps") == 0) {
+            policy.max_bytes_per_sec = number(argv[i + 1]);
+            i += 2;
         } else if (strcmp(argv[i], "--live-dangerously") == 0) {
             confirmed = true;
             i++;
@@ -406,6 +428,11 @@ int iochk(int argc, char** argv) {
         return -1;
     }
 
+    if (ioctl_block_fifo_set_policy(fd, &policy) < 0) {
+        fprintf(stderr, "error: cannot set fifo policy for device\n");
+        return -1;
+    }
+
     if (init_device()) {
         fprintf(stderr, "error: device initialization failed\n");
         return -1;
@@ -442,6 +469,13 @@ int iochk(int argc, char** argv) {
         free_txn_resources(&vmo, &vmoid, &txnid, &buf);
     }
 
+    block_fifo_stats_t stats;
+    if (ioctl_block_fifo_get_stats(fd, &stats) == sizeof(stats)) {
+        printf("%lu reads, %lu writes, %lu errors, throttled %lu times for %lu ms\n",
+               stats.reads, stats.writes, stats.errors, stats.throttled,
+               stats.throttled_ns / 1000000);
+    }
+
     if (!iochk_failure) {
         printf("iochk completed successfully\n");
         return 0;
@@ -0,0 +1,349 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Traces the threads of one process with Intel Processor Trace, each into a
+// ring buffer of its own, and writes out what they were last doing whenever
+// the process asks for it. The snapshots are decoded on the host by
+// ipt-decode, see system/host/ipt-decode.
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
+#include <inspector/inspector.h>
+#include <task-utils/get.h>
+#include <zircon/device/cpu-trace/intel-pt.h>
+#include <zircon/status.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
+
+namespace {
+
+constexpr char kDevicePath[] = "/dev/misc/cpu-trace";
+
+// Each ring buffer is made up of chunks of 64KB.
+constexpr uint32_t kChunkOrder = 4;
+constexpr size_t kChunkSize = (1u << kChunkOrder) * PAGE_SIZE;
+
+struct Options {
+    size_t buffer_kb = 1024;
+    uint32_t count = 1;
+    zx_duration_t timeout = ZX_TIME_INFINITE;
+    const char* dir = "/tmp";
+    bool kernel = false;
+};
+
+struct Thread {
+    zx_koid_t tid;
+    zx_handle_t handle;
+    uint32_t descriptor;
+    char name[ZX_MAX_NAME_LEN];
+};
+
+void usage() {
+    fprintf(stderr,
+            "Usage: ipt-capture [options] <pid>\n"
+            "Traces every thread of process <pid> into a ring buffer of its own, and\n"
+            "writes out what the threads were last doing each time the process\n"
+            "signals ZX_USER_SIGNAL_0 on itself, e.g. on seeing a request take too\n"
+            "long. Feed the snapshots to ipt-decode on the host.\n"
+            "Options:\n"
+            "  -s <kb>      ring buffer size per thread (default 1024)\n"
+            "  -n <count>   how many snapshots to take (default 1)\n"
+            "  -t <sec>     snapshot anyway after waiting this long for a signal\n"
+            "  -o <dir>     where to write the snapshots (default /tmp)\n"
+            "  -k           also trace the kernel\n");
+}
+
+zx_status_t ioctl_status(ssize_t result) {
+    return result < 0 ? static_cast<zx_status_t>(result) : ZX_OK;
+}
+
+// Fetch the threads of |process|, as many as can be traced.
+zx_status_t get_threads(zx_handle_t process, fbl::unique_ptr<Thread[]>* out_threads,
+                        size_t* out_count) {
+    zx_koid_t koids[IPT_MAX_NUM_THREAD_TRACES];
+    size_t actual, avail;
+    zx_status_t status = zx_object_get_info(process, ZX_INFO_PROCESS_THREADS, koids,
+                                            sizeof(koids), &actual, &avail);
+    if (status != ZX_OK)
+        return status;
+    if (avail > actual) {
+        fprintf(stderr, "ipt-capture: only tracing %zu of %zu threads\n", actual, avail);
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<Thread[]> threads(new (&ac) Thread[actual]);
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    size_t count = 0;
+    for (size_t i = 0; i < actual; ++i) {
+        Thread* t = &threads[count];
+        t->tid = koids[i];
+        // Threads may exit while we look.
+        if (zx_object_get_child(process, koids[i], ZX_RIGHT_SAME_RIGHTS, &t->handle) != ZX_OK)
+            continue;
+        if (zx_object_get_property(t->handle, ZX_PROP_NAME, t->name, sizeof(t->name)) != ZX_OK)
+            t->name[0] = '\0';
+        ++count;
+    }
+
+    *out_threads = fbl::move(threads);
+    *out_count = count;
+    return ZX_OK;
+}
+
+zx_status_t setup(int fd, const Options& options, Thread* threads, size_t count) {
+    ioctl_ipt_trace_config_t trace_config = {};
+    trace_config.mode = IPT_MODE_THREADS;
+    zx_status_t status = ioctl_status(ioctl_ipt_alloc_trace(fd, &trace_config));
+    if (status != ZX_OK) {
+        fprintf(stderr, "ipt-capture: unable to set up thread tracing: %d(%s)\n",
+                status, zx_status_get_string(status));
+        return status;
+    }
+
+    // Returns are traced as branches rather than compressed away, so that
+    // the decoder sees every function the threads get back to.
+    ioctl_ipt_buffer_config_t config = {};
+    config.num_chunks = static_cast<uint32_t>((options.buffer_kb * 1024 + kChunkSize - 1) /
+                                              kChunkSize);
+    config.chunk_order = kChunkOrder;
+    config.is_circular = true;
+    config.ctl = (IPT_CTL_USER_ALLOWED_MASK | IPT_CTL_BRANCH_EN_MASK |
+                  IPT_CTL_TSC_EN_MASK | IPT_CTL_DIS_RETC_MASK);
+    if (options.kernel)
+        config.ctl |= IPT_CTL_OS_ALLOWED_MASK;
+
+    for (size_t i = 0; i < count; ++i) {
+        Thread* t = &threads[i];
+        status = ioctl_status(ioctl_ipt_alloc_buffer(fd, &config, &t->descriptor));
+        if (status != ZX_OK) {
+            fprintf(stderr, "ipt-capture: unable to allocate a buffer: %d(%s)\n",
+                    status, zx_status_get_string(status));
+            return status;
+        }
+
+        // The device takes over the handle passed to it.
+        ioctl_ipt_assign_buffer_thread_t assign = {};
+        assign.descriptor = t->descriptor;
+        status = zx_handle_duplicate(t->handle, ZX_RIGHT_SAME_RIGHTS, &assign.thread);
+        if (status == ZX_OK)
+            status = ioctl_status(ioctl_ipt_assign_buffer_thread(fd, &assign));
+        if (status != ZX_OK) {
+            fprintf(stderr, "ipt-capture: unable to trace thread %" PRIu64 ": %d(%s)\n",
+                    t->tid, status, zx_status_get_string(status));
+            return status;
+        }
+    }
+    return ZX_OK;
+}
+
+void teardown(int fd, Thread* threads, size_t count) {
+    ioctl_ipt_stop(fd);
+    // This releases the threads and frees the buffers too.
+    ioctl_ipt_free_trace(fd);
+    for (size_t i = 0; i < count; ++i)
+        zx_handle_close(threads[i].handle);
+}
+
+// Write out the ring buffer of |t| oldest data first. The decoder syncs up
+// on the first packet stream boundary it finds.
+zx_status_t write_trace(int fd, const Thread& t, const char* path) {
+    ioctl_ipt_buffer_config_t config;
+    zx_status_t status = ioctl_status(ioctl_ipt_get_buffer_config(fd, &t.descriptor, &config));
+    if (status != ZX_OK)
+        return status;
+    ioctl_ipt_buffer_info_t info;
+    status = ioctl_status(ioctl_ipt_get_buffer_info(fd, &t.descriptor, &info));
+    if (status != ZX_OK)
+        return status;
+
+    size_t chunk_size = (1u << config.chunk_order) * PAGE_SIZE;
+    size_t size = config.num_chunks * chunk_size;
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> data(new (&ac) uint8_t[size]);
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    for (uint32_t i = 0; i < config.num_chunks; ++i) {
+        ioctl_ipt_chunk_handle_req_t req = {t.descriptor, i};
+        zx_handle_t vmo;
+        status = ioctl_status(ioctl_ipt_get_chunk_handle(fd, &req, &vmo));
+        if (status != ZX_OK)
+            return status;
+        size_t actual;
+        status = zx_vmo_read(vmo, &data[i * chunk_size], 0, chunk_size, &actual);
+        zx_handle_close(vmo);
+        if (status != ZX_OK)
+            return status;
+        if (actual != chunk_size)
+            return ZX_ERR_IO;
+    }
+
+    FILE* f = fopen(path, "w");
+    if (!f)
+        return ZX_ERR_IO;
+    size_t end = info.capture_end < size ? info.capture_end : 0;
+    bool ok = (fwrite(&data[end], 1, size - end, f) == size - end &&
+               fwrite(&data[0], 1, end, f) == end);
+    if (fclose(f) != 0)
+        ok = false;
+    return ok ? ZX_OK : ZX_ERR_IO;
+}
+
+// Snapshot every thread at once, so that their traces end at about the same
+// time, and write them out along with what the decoder needs to make sense
+// of them.
+zx_status_t snapshot(int fd, const Options& options, zx_handle_t process, zx_koid_t pid,
+                     Thread* threads, size_t count, uint32_t n) {
+    zx_status_t status = ZX_OK;
+    size_t paused;
+    for (paused = 0; paused < count && status == ZX_OK; ++paused)
+        status = ioctl_status(ioctl_ipt_snapshot_buffer(fd, &threads[paused].descriptor));
+    if (status != ZX_OK)
+        --paused;
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/ipt-%" PRIu64 "-%u.txt", options.dir, pid, n);
+    FILE* f = status == ZX_OK ? fopen(path, "w") : nullptr;
+    if (status == ZX_OK && !f)
+        status = ZX_ERR_IO;
+    if (f) {
+        fprintf(f, "ticks_per_second: %" PRIu64 "\n", zx_ticks_per_second());
+        inspector_dsoinfo_t* dso_list = inspector_dso_fetch_list(process);
+        inspector_dso_print_list(f, dso_list);
+        inspector_dso_free_list(dso_list);
+
+        for (size_t i = 0; i < count && status == ZX_OK; ++i) {
+            char trace_name[64];
+            snprintf(trace_name, sizeof(trace_name), "ipt-%" PRIu64 "-%u-%" PRIu64 ".pt",
+                     pid, n, threads[i].tid);
+            snprintf(path, sizeof(path), "%s/%s", options.dir, trace_name);
+            status = write_trace(fd, threads[i], path);
+            fprintf(f, "thread: tid=%" PRIu64 " file=%s name=%s\n",
+                    threads[i].tid, trace_name, threads[i].name);
+        }
+        if (fclose(f) != 0 && status == ZX_OK)
+            status = ZX_ERR_IO;
+    }
+
+    for (size_t i = 0; i < paused; ++i)
+        ioctl_ipt_resume_buffer(fd, &threads[i].descriptor);
+
+    if (status == ZX_OK)
+        printf("ipt-capture: wrote %s/ipt-%" PRIu64 "-%u.txt\n", options.dir, pid, n);
+    return status;
+}
+
+zx_status_t capture(int fd, const Options& options, zx_handle_t process, zx_koid_t pid,
+                    Thread* threads, size_t count) {
+    zx_status_t status = ioctl_status(ioctl_ipt_start(fd));
+    if (status != ZX_OK) {
+        fprintf(stderr, "ipt-capture: unable to start tracing: %d(%s)\n",
+                status, zx_status_get_string(status));
+        return status;
+    }
+
+    for (uint32_t n = 0; n < options.count; ++n) {
+        zx_signals_t pending = 0;
+        status = zx_object_wait_one(process, ZX_USER_SIGNAL_0 | ZX_PROCESS_TERMINATED,
+                                    zx_deadline_after(options.timeout), &pending);
+        if (status != ZX_OK && status != ZX_ERR_TIMED_OUT)
+            return status;
+        if (pending & ZX_PROCESS_TERMINATED) {
+            fprintf(stderr, "ipt-capture: process %" PRIu64 " exited\n", pid);
+            return ZX_ERR_PEER_CLOSED;
+        }
+
+        status = snapshot(fd, options, process, pid, threads, count, n);
+        if (status != ZX_OK) {
+            fprintf(stderr, "ipt-capture: unable to write snapshot: %d(%s)\n",
+                    status, zx_status_get_string(status));
+            return status;
+        }
+        zx_object_signal(process, ZX_USER_SIGNAL_0, 0);
+    }
+    return ZX_OK;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:n:t:o:kh")) != -1) {
+        switch (opt) {
+        case 's':
+            options.buffer_kb = strtoul(optarg, nullptr, 0);
+            break;
+        case 'n':
+            options.count = static_cast<uint32_t>(strtoul(optarg, nullptr, 0));
+            break;
+        case 't':
+            options.timeout = ZX_SEC(strtoul(optarg, nullptr, 0));
+            break;
+        case 'o':
+            options.dir = optarg;
+            break;
+        case 'k':
+            options.kernel = true;
+            break;
+        default:
+            usage();
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind != argc - 1 || options.buffer_kb == 0 || options.count == 0) {
+        usage();
+        return 1;
+    }
+    zx_koid_t pid = strtoull(argv[optind], nullptr, 0);
+
+    zx_obj_type_t type;
+    zx_handle_t process;
+    if (get_task_by_koid(pid, &type, &process) != ZX_OK) {
+        fprintf(stderr, "ipt-capture: no such process %" PRIu64 "\n", pid);
+        return 1;
+    }
+    if (type != ZX_OBJ_TYPE_PROCESS) {
+        fprintf(stderr, "ipt-capture: %" PRIu64 " is not a process\n", pid);
+        zx_handle_close(process);
+        return 1;
+    }
+
+    fbl::unique_ptr<Thread[]> threads;
+    size_t count = 0;
+    zx_status_t status = get_threads(process, &threads, &count);
+    if (status != ZX_OK || count == 0) {
+        fprintf(stderr, "ipt-capture: unable to get the threads of %" PRIu64 "\n", pid);
+        zx_handle_close(process);
+        return 1;
+    }
+
+    int fd = open(kDevicePath, O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "ipt-capture: unable to open %s\n", kDevicePath);
+        zx_handle_close(process);
+        return 1;
+    }
+
+    status = setup(fd, options, threads.get(), count);
+    if (status == ZX_OK) {
+        printf("ipt-capture: tracing %zu threads of %" PRIu64 "\n", count, pid);
+        status = capture(fd, options, process, pid, threads.get(), count);
+    }
+    teardown(fd, threads.get(), count);
+    close(fd);
+    zx_handle_close(process);
+    return status == ZX_OK ? 0 : 1;
+}
@@ -2,13 +2,19 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <getopt.h>
+#include <inttypes.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <threads.h>
 #include <unistd.h>
 
 #include <zircon/errors.h>
+#include <zircon/process.h>
 #include <zircon/types.h>
 #include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
 #include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_call.h>
@@ -21,22 +27,103 @@ static constexpr float kDefaultMinWorkMsec = 5.0f;
 static constexpr float kDefaultMaxWorkMsec = 15.0f;
 static constexpr float kDefaultMinSleepMsec = 1.0f;
 static constexpr float kDefaultMaxSleepMsec = 2.5f;
+static constexpr int32_t kCyclicPriority = 24;
+static constexpr size_t kMaxPriorities = 8;
+static constexpr int32_t kNoPriority = -1;
+
+// Counts durations in power of two buckets of microseconds: bucket 0 is
+// under 1us, bucket n is [2^(n-1), 2^n) us.
+class Histogram {
+public:
+    static constexpr size_t kBuckets = 32;
+
+    void Add(zx_duration_t ns) {
+        uint64_t us = ns / 1000;
+        size_t bucket = us ? 64 - __builtin_clzll(us) : 0;
+        buckets_[fbl::min(bucket, kBuckets - 1)]++;
+        count_++;
+        total_ += ns;
+        max_ = fbl::max(max_, ns);
+    }
+
+    void Merge(const Histogram& other) {
+        for (size_t i = 0; i < kBuckets; i++)
+            buckets_[i] += other.buckets_[i];
+        count_ += other.count_;
+        total_ += other.total_;
+        max_ = fbl::max(max_, other.max_);
+    }
+
+    void Print(const char* title) const {
+        if (count_ == 0) {
+            printf("%s: no samples\n", title);
+            return;
+        }
+        printf("%s: %" PRIu64 " samples, mean %.1f us, max %.1f us, "
+               "p50 < %" PRIu64 " us, p99 < %" PRIu64 " us, p99.9 < %" PRIu64 " us\n",
+               title, count_, static_cast<double>(total_) / static_cast<double>(count_) / 1000,
+               static_cast<double>(max_) / 1000, Percentile(0.5), Percentile(0.99),
+               Percentile(0.999));
+        for (size_t i = 0; i < kBuckets; i++) {
+            if (buckets_[i] == 0)
+                continue;
+            printf("  %8" PRIu64 " - %8" PRIu64 " us: %10" PRIu64 " %6.2f%%\n",
+                   i ? UINT64_C(1) << (i - 1) : 0, UINT64_C(1) << i, buckets_[i],
+                   100.0 * static_cast<double>(buckets_[i]) / static_cast<double>(count_));
+        }
+    }
+
+private:
+    // The upper bound, in us, of the bucket holding the |p|th fraction.
+    uint64_t Percentile(double p) const {
+        uint64_t target = static_cast<uint64_t>(p * static_cast<double>(count_));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBuckets; i++) {
+            seen += buckets_[i];
+            if (seen > target)
+                return 1ull << i;
+        }
+        return 1ull << (kBuckets - 1);
+    }
+
+    uint64_t buckets_[kBuckets] = {};
+    uint64_t count_ = 0;
+    zx_duration_t total_ = 0;
+    zx_duration_t max_ = 0;
+};
 
 class LoadGeneratorThread :
     public fbl::SinglyLinkedListable<fbl::unique_ptr<LoadGeneratorThread>> {
 public:
-    LoadGeneratorThread(unsigned int seed) : seed_(seed) { }
+    // A cyclic thread does no work; it wakes up every cyclic_period() at
+    // kCyclicPriority and measures how late it was, like cyclictest.
+    LoadGeneratorThread(unsigned int seed, int32_t priority, bool cyclic)
+        : seed_(seed), priority_(priority), cyclic_(cyclic) { }
     ~LoadGeneratorThread();
 
     zx_status_t Start();
 
+    // Tells every thread to quit, and waits for this one to.
+    void Stop();
+
     static float& min_work_msec() { return min_work_msec_; }
     static float& max_work_msec() { return max_work_msec_; }
     static float& min_sleep_msec() { return min_sleep_msec_; }
     static float& max_sleep_msec() { return max_sleep_msec_; }
+    static zx_duration_t& cyclic_period() { return cyclic_period_; }
+
+    // What the thread measured, valid once it has stopped.
+    bool cyclic() const { return cyclic_; }
+    int32_t priority() const { return priority_; }
+    bool priority_set() const { return priority_set_; }
+    const Histogram& lateness() const { return lateness_; }
+    zx_duration_t runtime() const { return stats_.total_runtime; }
+    uint32_t migrations() const { return stats_.migrations; }
 
 private:
     int Run();
+    void RunLoad();
+    void RunCyclic();
 
     double MakeRandomDouble(double min, double max);
 
@@ -44,26 +131,30 @@ private:
     static float max_work_msec_;
     static float min_sleep_msec_;
     static float max_sleep_msec_;
+    static zx_duration_t cyclic_period_;
     static volatile bool quit_;
 
     unsigned int seed_;
-    bool thread_started_;
+    const int32_t priority_;
+    const bool cyclic_;
+    bool priority_set_ = false;
+    bool thread_started_ = false;
     thrd_t thread_;
     volatile double accumulator_;
+
+    Histogram lateness_;
+    zx_info_thread_stats_t stats_ = {};
 };
 
 float LoadGeneratorThread::min_work_msec_ = kDefaultMinWorkMsec;
 float LoadGeneratorThread::max_work_msec_ = kDefaultMaxWorkMsec;
 float LoadGeneratorThread::min_sleep_msec_ = kDefaultMinSleepMsec;
 float LoadGeneratorThread::max_sleep_msec_ = kDefaultMaxSleepMsec;
+zx_duration_t LoadGeneratorThread::cyclic_period_ = 0;
 volatile bool LoadGeneratorThread::quit_ = false;
 
 LoadGeneratorThread::~LoadGeneratorThread() {
-    if (thread_started_) {
-        int musl_ret;
-        quit_ = true;
-        thrd_join(thread_, &musl_ret);
-    }
+    Stop();
 }
 
 zx_status_t LoadGeneratorThread::Start() {
@@ -80,10 +171,35 @@ zx_status_t LoadGeneratorThread::Start() {
         return ZX_ERR_INTERNAL;
     }
 
+    thread_started_ = true;
     return ZX_OK;
 }
 
+void LoadGeneratorThread::Stop() {
+    if (thread_started_) {
+        int musl_ret;
+        quit_ = true;
+        thrd_join(thread_, &musl_ret);
+        thread_started_ = false;
+    }
+}
+
 int LoadGeneratorThread::Run() {
+    if (priority_ != kNoPriority)
+        priority_set_ = (zx_thread_set_priority(priority_) == ZX_OK);
+
+    if (cyclic_) {
+        RunCyclic();
+    } else {
+        RunLoad();
+    }
+
+    zx_object_get_info(zx_thread_self(), ZX_INFO_THREAD_STATS, &stats_, sizeof(stats_),
+                       nullptr, nullptr);
+    return 0;
+}
+
+void LoadGeneratorThread::RunLoad() {
     constexpr double kMinNum = 1.0;
     constexpr double kMaxNum = 100000000.0;
     uint32_t ticks_per_msec = static_cast<uint32_t>(zx_ticks_per_second() / 1000);
@@ -124,12 +240,27 @@ int LoadGeneratorThread::Run() {
                 zx_nanosleep(now + max_sleep);
             } else {
                 zx_nanosleep(sleep_deadline);
+                lateness_.Add(zx_time_get(ZX_CLOCK_MONOTONIC) - sleep_deadline);
                 break;
             }
         } while (!quit_);
     }
+}
 
-    return 0;
+void LoadGeneratorThread::RunCyclic() {
+    // Deadlines are absolute, so lateness does not accumulate.
+    zx_time_t deadline = zx_time_get(ZX_CLOCK_MONOTONIC);
+    while (!quit_) {
+        deadline += cyclic_period();
+        zx_nanosleep(deadline);
+        zx_time_t now = zx_time_get(ZX_CLOCK_MONOTONIC);
+        lateness_.Add(now - deadline);
+
+        // Skip the periods that went by entirely rather than firing for them
+        // all at once.
+        if (now - deadline > cyclic_period())
+            deadline = now;
+    }
 }
 
 double LoadGeneratorThread::MakeRandomDouble(double min, double max) {
@@ -138,24 +269,147 @@ double LoadGeneratorThread::MakeRandomDouble(double min, double max) {
     return min + (norm * (max - min));
 }
 
+using ThreadList = fbl::SinglyLinkedList<fbl::unique_ptr<LoadGeneratorThread>>;
+
+// Prints wakeup lateness, CPU share by priority, and migrations.
+void report(const ThreadList& threads, zx_duration_t elapsed) {
+    printf("\nRan for %.3f s\n\n", static_cast<double>(elapsed) / ZX_SEC(1));
+
+    Histogram load_lateness;
+    Histogram cyclic_lateness;
+    bool any_cyclic = false;
+    for (const auto& t : threads) {
+        if (t.cyclic()) {
+            cyclic_lateness.Merge(t.lateness());
+            any_cyclic = true;
+        } else {
+            load_lateness.Merge(t.lateness());
+        }
+    }
+    load_lateness.Print("Load thread wakeup lateness");
+    if (any_cyclic) {
+        char title[64];
+        snprintf(title, sizeof(title), "Cyclic wakeup lateness (period %" PRIu64 " us)",
+                 LoadGeneratorThread::cyclic_period() / 1000);
+        cyclic_lateness.Print(title);
+    }
+
+    // Fairness: the share of one CPU each priority got, altogether and per
+    // thread. Threads whose priority could not be set are counted as such.
+    struct Group {
+        int32_t priority;
+        bool set;
+        uint32_t threads;
+        zx_duration_t runtime;
+        uint64_t migrations;
+    };
+    Group groups[kMaxPriorities * 2 + 2] = {};
+    size_t num_groups = 0;
+    uint64_t total_migrations = 0;
+    for (const auto& t : threads) {
+        if (t.cyclic())
+            continue;
+        size_t i;
+        for (i = 0; i < num_groups; i++) {
+            if (groups[i].priority == t.priority() && groups[i].set == t.priority_set())
+                break;
+        }
+        if (i == num_groups) {
+            if (num_groups == fbl::count_of(groups))
+                continue;
+            groups[num_groups++] = {t.priority(), t.priority_set(), 0, 0, 0};
+        }
+        groups[i].threads++;
+        groups[i].runtime += t.runtime();
+        groups[i].migrations += t.migrations();
+        total_migrations += t.migrations();
+    }
+
+    printf("\n%-12s %8s %12s %12s %14s\n",
+           "priority", "threads", "cpu %", "cpu %/thread", "migrations/s");
+    double seconds = static_cast<double>(elapsed) / ZX_SEC(1);
+    for (size_t i = 0; i < num_groups; i++) {
+        const Group& g = groups[i];
+        char name[16];
+        if (g.priority == kNoPriority) {
+            snprintf(name, sizeof(name), "default");
+        } else {
+            snprintf(name, sizeof(name), "%d%s", g.priority, g.set ? "" : " (unset)");
+        }
+        double share = 100.0 * static_cast<double>(g.runtime) / static_cast<double>(elapsed);
+        printf("%-12s %8u %12.1f %12.1f %14.1f\n", name, g.threads, share, share / g.threads,
+               static_cast<double>(g.migrations) / seconds);
+    }
+    printf("\nMigrations: %" PRIu64 " (%.1f/s)\n", total_migrations,
+           static_cast<double>(total_migrations) / seconds);
+}
+
 void usage(const char* program_name) {
-    printf("usage: %s [N] [min_work max_work] [min_sleep max_sleep] [seed]\n"
+    printf("usage: %s [options] [N] [min_work max_work] [min_sleep max_sleep] [seed]\n"
            "  All arguments are positional and optional.\n"
            "  N             : Number of threads to create.  Default %u\n"
            "  min/max_work  : Min/max msec for threads to work for.  Default %.1f,%.1f mSec\n"
            "  min/max_sleep : Min/max msec for threads to sleep for.  Default %.1f,%.1f mSec\n"
-           "  seed          : RNG seed to use.  Defaults to seeding from zx_time_get\n",
+           "  seed          : RNG seed to use.  Defaults to seeding from zx_time_get\n"
+           "\n"
+           "Options:\n"
+           "  -t SECONDS    : Run for this long rather than until a key is pressed\n"
+           "  -p P1,P2,...  : Give the threads these priorities, in turn (at most %zu)\n"
+           "  -c USEC       : Also run a thread per CPU at priority %d that wakes up\n"
+           "                  every USEC microseconds and measures how late it was\n"
+           "\n"
+           "On exit it prints how late threads woke up from their sleeps, the share\n"
+           "of a CPU each priority got, and how often threads migrated between CPUs.\n"
+           "Setting priorities needs thread.set.priority.allowed=true on the kernel\n"
+           "command line.\n",
            program_name,
            kDefaultNumThreads,
            kDefaultMinWorkMsec,
            kDefaultMaxWorkMsec,
            kDefaultMinSleepMsec,
-           kDefaultMaxSleepMsec);
+           kDefaultMaxSleepMsec,
+           kMaxPriorities,
+           kCyclicPriority);
 }
 
 int main(int argc, char** argv) {
     auto show_usage = fbl::MakeAutoCall([argv]() { usage(argv[0]); });
 
+    uint32_t run_seconds = 0;
+    int32_t priorities[kMaxPriorities];
+    size_t num_priorities = 0;
+    uint32_t cyclic_usec = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:p:c:")) != -1) {
+        switch (opt) {
+        case 't':
+            if (sscanf(optarg, "%u", &run_seconds) != 1 || run_seconds == 0) return -1;
+            break;
+        case 'p':
+            for (char* p = optarg; *p;) {
+                char* end;
+                long prio = strtol(p, &end, 10);
+                if (end == p || prio < 0 || prio > 31 || num_priorities == kMaxPriorities)
+                    return -1;
+                priorities[num_priorities++] = static_cast<int32_t>(prio);
+                p = (*end == ',') ? end + 1 : end;
+                if (*end != ',' && *end != '\0') return -1;
+            }
+            break;
+        case 'c':
+            if (sscanf(optarg, "%u", &cyclic_usec) != 1 || cyclic_usec == 0) return -1;
+            LoadGeneratorThread::cyclic_period() = ZX_USEC(cyclic_usec);
+            break;
+        default:
+            return -1;
+        }
+    }
+
+    // Shift the positional arguments down so that they are counted as before.
+    argc -= optind - 1;
+    argv += optind - 1;
+
     // 0, 1, 3, 5 and 6 arguments are the only legal number of args.
     switch (argc) {
     case 1:
@@ -213,19 +467,31 @@ int main(int argc, char** argv) {
            LoadGeneratorThread::max_sleep_msec(),
            seed);
 
-    fbl::SinglyLinkedList<fbl::unique_ptr<LoadGeneratorThread>> threads;
-    for (uint32_t i = 0; i < num_threads; ++i) {
+    uint32_t num_cyclic = cyclic_usec ? zx_system_get_num_cpus() : 0;
+    if (num_cyclic) {
+        printf("Cyclic      : %u thread%s, every %u uSec at priority %d\n",
+               num_cyclic, num_cyclic == 1 ? "" : "s", cyclic_usec, kCyclicPriority);
+    }
+
+    ThreadList threads;
+    for (uint32_t i = 0; i < num_threads + num_cyclic; ++i) {
+        bool cyclic = i >= num_threads;
+        int32_t priority = cyclic ? kCyclicPriority
+                                  : num_priorities ? priorities[i % num_priorities]
+                                                   : kNoPriority;
         fbl::AllocChecker ac;
-        fbl::unique_ptr<LoadGeneratorThread> t(new (&ac) LoadGeneratorThread(rand_r(&seed)));
+        fbl::unique_ptr<LoadGeneratorThread> t(
+            new (&ac) LoadGeneratorThread(rand_r(&seed), priority, cyclic));
 
         if (!ac.check()) {
-            printf("Failed to create thread %u/%u\n", i + 1, num_threads);
+            printf("Failed to create thread %u/%u\n", i + 1, num_threads + num_cyclic);
             return -1;
         }
 
         threads.push_front(fbl::move(t));
     }
 
+    zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
     for (auto& t : threads) {
         zx_status_t res = t.Start();
         if (res != ZX_OK) {
@@ -234,11 +500,20 @@ int main(int argc, char** argv) {
         }
     }
 
-    printf("Running.  Press any key to exit\n");
-    char junk;
-    ::read(STDIN_FILENO, &junk, sizeof(junk));
+    if (run_seconds) {
+        printf("Running for %u second%s\n", run_seconds, run_seconds == 1 ? "" : "s");
+        zx_nanosleep(zx_deadline_after(ZX_SEC(run_seconds)));
+    } else {
+        printf("Running.  Press any key to exit\n");
+        char junk;
+        ::read(STDIN_FILENO, &junk, sizeof(junk));
+    }
 
     printf("Shutting down...\n");
+    for (auto& t : threads)
+        t.Stop();
+    report(threads, zx_time_get(ZX_CLOCK_MONOTONIC) - start);
+
     threads.clear();
     printf("Finished\n");
 
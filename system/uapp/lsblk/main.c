@@ -129,6 +129,12 @@ static int cmd_list_blk(void) {
         if (block_info.flags & BLOCK_FLAG_REMOVABLE) {
             strlcat(flags, "RE ", sizeof(flags));
         }
+        if (block_info.flags & BLOCK_FLAG_ROTATIONAL) {
+            strlcat(flags, "ROT ", sizeof(flags));
+        }
+        if (block_info.flags & BLOCK_FLAG_TRIM_SUPPORT) {
+            strlcat(flags, "TRIM ", sizeof(flags));
+        }
 devdone:
         close(fd);
         printf("%-3s %4s %-14s %-20s %-6s %s\n",
@@ -192,6 +198,49 @@ out:
     return rc;
 }
 
+static const char* priority_to_cstring(uint32_t priority) {
+    switch (priority) {
+    case BLOCK_PRIORITY_FOREGROUND:
+        return "foreground";
+    case BLOCK_PRIORITY_BACKGROUND:
+        return "background";
+    case BLOCK_PRIORITY_IDLE:
+        return "idle";
+    default:
+        return "unknown";
+    }
+}
+
+static int cmd_stats_blk(const char* dev) {
+    int fd = open(dev, O_RDONLY);
+    if (fd < 0) {
+        printf("Error opening %s\n", dev);
+        return fd;
+    }
+
+    block_fifo_stats_t stats;
+    ssize_t rc = ioctl_block_fifo_get_stats(fd, &stats);
+    close(fd);
+    if (rc == ZX_ERR_BAD_STATE) {
+        printf("%s has no fifo client\n", dev);
+        return 0;
+    } else if (rc < 0) {
+        printf("Error %zd getting fifo stats for %s\n", rc, dev);
+        return rc;
+    }
+
+    printf("priority %s, max iops %" PRIu64 ", max bytes/sec %" PRIu64 "\n",
+           priority_to_cstring(stats.policy.priority), stats.policy.max_iops,
+           stats.policy.max_bytes_per_sec);
+    printf("reads %" PRIu64 " (%" PRIu64 " bytes), writes %" PRIu64 " (%" PRIu64 " bytes)\n",
+           stats.reads, stats.bytes_read, stats.writes, stats.bytes_written);
+    printf("trims %" PRIu64 " (%" PRIu64 " bytes)\n", stats.trims, stats.bytes_trimmed);
+    printf("errors %" PRIu64 ", throttled %" PRIu64 " (%" PRIu64 " ms), max in flight %" PRIu64
+           "\n", stats.errors, stats.throttled, stats.throttled_ns / 1000000,
+           stats.max_inflight);
+    return 0;
+}
+
 int main(int argc, const char** argv) {
     int rc = 0;
     const char *cmd = argc > 1 ? argv[1] : NULL;
@@ -201,6 +250,9 @@ int main(int argc, const char** argv) {
         } else if (!strcmp(cmd, "read")) {
             if (argc < 5) goto usage;
             rc = cmd_read_blk(argv[2], strtoul(argv[3], NULL, 10), strtoull(argv[4], NULL, 10));
+        } else if (!strcmp(cmd, "stats")) {
+            if (argc < 3) goto usage;
+            rc = cmd_stats_blk(argv[2]);
         } else {
             printf("Unrecognized command %s!\n", cmd);
             goto usage;
@@ -213,5 +265,6 @@ usage:
     printf("Usage:\n");
     printf("%s\n", argv[0]);
     printf("%s read <blkdev> <offset> <count>\n", argv[0]);
+    printf("%s stats <blkdev>\n", argv[0]);
     return 0;
 }
@@ -14,6 +14,9 @@
 #include <unistd.h>
 
 #include <lz4/lz4frame.h>
+#include <zircon/syscalls.h>
+
+#include "parallel.h"
 
 #define BLOCK_SIZE 65536
 
@@ -21,13 +24,14 @@
 #define PERM_644 S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH
 
 static void usage(const char* arg0) {
-    printf("usage: %s [-1|-9] [-d] <input file> <output file>\n", arg0);
+    printf("usage: %s [-1|-9] [-d] [-t <threads>] <input file> <output file>\n", arg0);
     printf("   -1  fast compression (default)\n");
     printf("   -9  high compression (slower)\n");
     printf("   -d  decompress\n");
+    printf("   -t  number of blocks to (de)compress at once (default: number of CPUs)\n");
 }
 
-static int do_decompress(const char* infile, const char* outfile) {
+static int do_decompress(const char* infile, const char* outfile, size_t num_threads) {
     int infd, outfd;
 
     infd = open(infile, O_RDONLY);
@@ -43,6 +47,21 @@ static int do_decompress(const char* infile, const char* outfile) {
         return -1;
     }
 
+    // Frames of independent blocks are decompressed in parallel; anything
+    // else goes through the streaming decompressor from the start.
+    int rc = lz4_decompress_parallel(infd, outfd, num_threads);
+    if (rc != LZ4_PARALLEL_UNSUPPORTED) {
+        close(outfd);
+        close(infd);
+        return rc;
+    }
+    if (lseek(infd, 0, SEEK_SET) != 0) {
+        fprintf(stderr, "could not seek in %s: %s\n", infile, strerror(errno));
+        close(outfd);
+        close(infd);
+        return -1;
+    }
+
     LZ4F_decompressionContext_t dctx;
     LZ4F_errorCode_t errc = LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION);
     if (LZ4F_isError(errc)) {
@@ -123,7 +142,8 @@ done:
     return 0;
 }
 
-static int do_compress(const char* infile, const char* outfile, int clevel) {
+static int do_compress(const char* infile, const char* outfile, int clevel,
+                       size_t num_threads) {
     int infd, outfd;
 
     infd = open(infile, O_RDONLY);
@@ -139,56 +159,16 @@ static int do_compress(const char* infile, const char* outfile, int clevel) {
         return -1;
     }
 
-    LZ4F_preferences_t prefs;
-    memset(&prefs, 0, sizeof(prefs));
-    prefs.compressionLevel = clevel;
-
-    uint8_t inbuf[BLOCK_SIZE];
-    size_t outsize = LZ4F_compressFrameBound(BLOCK_SIZE, &prefs);
-    uint8_t* outbuf = malloc(outsize);
-    if (!outbuf) {
-        fprintf(stderr, "out of memory\n");
-        close(outfd);
-        close(infd);
-        return ENOMEM;
-    }
-
-    // TODO: do the whole file in one frame, using the LZ4F begin/update/end
-    // functions.
-    ssize_t nr = 0;
-    while ((nr = read(infd, inbuf, BLOCK_SIZE)) > 0) {
-        ssize_t csz = LZ4F_compressFrame(outbuf, outsize, inbuf, nr, &prefs);
-        if (LZ4F_isError(csz)) {
-            fprintf(stderr, "error compressing %s: %s\n", infile, LZ4F_getErrorName(csz));
-            goto done;
-        }
-
-        ssize_t nw = write(outfd, outbuf, csz);
-        if (nw != csz) {
-            fprintf(stderr, "could not write to %s", outfile);
-            if (nw < 0) {
-                fprintf(stderr, ": %s", strerror(errno));
-            }
-            fprintf(stderr, "\n");
-            goto done;
-        }
-    }
-
-    if (nr < 0) {
-        fprintf(stderr, "error reading %s: %s\n", infile, strerror(errno));
-        goto done;
-    }
-
-done:
-    free(outbuf);
+    int rc = lz4_compress_parallel(infd, outfd, clevel, num_threads);
     close(outfd);
     close(infd);
-    return 0;
+    return rc;
 }
 
 int main(int argc, char* argv[]) {
     int clevel = 1;
     bool decompress = false;
+    size_t num_threads = zx_system_get_num_cpus();
     const char* infile = NULL;
     const char* outfile = NULL;
 
@@ -201,6 +181,13 @@ int main(int argc, char* argv[]) {
             clevel = 9;
             continue;
         }
+        if (!strcmp("-t", argv[i]) && i + 1 < argc) {
+            num_threads = strtoul(argv[++i], NULL, 0);
+            if (num_threads == 0) {
+                num_threads = 1;
+            }
+            continue;
+        }
         if (!strcmp("-h", argv[i])) {
             usage(argv[0]);
             return 0;
@@ -235,8 +222,8 @@ int main(int argc, char* argv[]) {
     printf("\n");
 
     if (decompress) {
-        return do_decompress(infile, outfile);
+        return do_decompress(infile, outfile, num_threads);
     } else {
-        return do_compress(infile, outfile, clevel);
+        return do_compress(infile, outfile, clevel, num_threads);
     }
 }
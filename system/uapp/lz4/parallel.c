@@ -0,0 +1,446 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "parallel.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <threads.h>
+#include <unistd.h>
+
+#include <lz4/lz4.h>
+#include <lz4/lz4hc.h>
+#define XXH_NAMESPACE LZ4_
+#include <lz4/xxhash.h>
+
+// LZ4 frame format; see
+// https://github.com/lz4/lz4/blob/dev/lz4_Frame_format.md
+#define LZ4_MAGIC 0x184D2204
+
+#define FLG_VERSION_MASK   0xc0
+#define FLG_VERSION        0x40
+#define FLG_BLOCK_INDEP    0x20
+#define FLG_BLOCK_CKSUM    0x10
+#define FLG_CONTENT_SIZE   0x08
+#define FLG_CONTENT_CKSUM  0x04
+#define FLG_RESERVED       0x03
+
+#define BD_BLOCK_MAX_SHIFT 4
+#define BD_BLOCK_MAX_MASK  (7 << BD_BLOCK_MAX_SHIFT)
+#define BD_BLOCK_64KB      4
+#define BD_RESERVED        0x8f
+
+#define BLOCK_UNCOMPRESSED 0x80000000u
+
+// Compressed blocks hold 64kB, the same as the serial path and mkbootfs use.
+#define BLOCK_SIZE 65536
+
+// Roughly how much data to read in before handing it out to the threads.
+#define BATCH_BYTES (16 * 1024 * 1024)
+
+// Compression levels from here up use the high compression compressor.
+#define LZ4HC_MIN_LEVEL 3
+
+typedef struct {
+    // Data to compress or decompress.
+    const uint8_t* in;
+    size_t in_size;
+    // Room for the result.
+    uint8_t* out;
+    size_t out_size;
+    // Size of the result. If |raw| is set, the result is |in| itself.
+    size_t actual;
+    bool raw;
+} block_t;
+
+typedef struct {
+    block_t* blocks;
+    size_t count;
+    bool decompress;
+    int clevel;
+
+    atomic_size_t next;
+    atomic_bool ok;
+} batch_t;
+
+static void put_le32(uint8_t* p, uint32_t v) {
+    for (size_t i = 0; i < 4; i++) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static uint32_t get_le32(const uint8_t* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Reads until |len| bytes or end of file. Returns the number of bytes read,
+// or -1 on error.
+static ssize_t read_full(int fd, void* buf, size_t len) {
+    size_t pos = 0;
+    while (pos < len) {
+        ssize_t nr = read(fd, (uint8_t*)buf + pos, len - pos);
+        if (nr < 0) {
+            return -1;
+        }
+        if (nr == 0) {
+            break;
+        }
+        pos += nr;
+    }
+    return pos;
+}
+
+static bool write_full(int fd, const void* buf, size_t len) {
+    size_t pos = 0;
+    while (pos < len) {
+        ssize_t nw = write(fd, (const uint8_t*)buf + pos, len - pos);
+        if (nw <= 0) {
+            return false;
+        }
+        pos += nw;
+    }
+    return true;
+}
+
+static bool process_block(const batch_t* batch, block_t* block) {
+    if (batch->decompress) {
+        if (block->raw) {
+            block->actual = block->in_size;
+            return block->in_size <= block->out_size;
+        }
+        int dcmp = LZ4_decompress_safe((const char*)block->in, (char*)block->out,
+                                       block->in_size, block->out_size);
+        if (dcmp < 0) {
+            return false;
+        }
+        block->actual = dcmp;
+        return true;
+    }
+
+    int csz;
+    if (batch->clevel < LZ4HC_MIN_LEVEL) {
+        csz = LZ4_compress_default((const char*)block->in, (char*)block->out,
+                                   block->in_size, block->out_size);
+    } else {
+        csz = LZ4_compress_HC((const char*)block->in, (char*)block->out,
+                              block->in_size, block->out_size, batch->clevel);
+    }
+    // Store blocks which don't shrink as they are.
+    block->raw = csz <= 0 || (size_t)csz >= block->in_size;
+    block->actual = block->raw ? block->in_size : (size_t)csz;
+    return true;
+}
+
+static int batch_thread(void* arg) {
+    batch_t* batch = arg;
+    for (;;) {
+        size_t i = atomic_fetch_add(&batch->next, 1);
+        if (i >= batch->count || !atomic_load(&batch->ok)) {
+            break;
+        }
+        if (!process_block(batch, &batch->blocks[i])) {
+            atomic_store(&batch->ok, false);
+            break;
+        }
+    }
+    return 0;
+}
+
+// Compresses or decompresses every block of |batch| on up to |num_threads|
+// threads. Returns false if any block failed.
+static bool run_batch(batch_t* batch, size_t num_threads) {
+    atomic_init(&batch->next, 0);
+    atomic_init(&batch->ok, true);
+    if (num_threads > batch->count) {
+        num_threads = batch->count;
+    }
+
+    thrd_t threads[num_threads > 0 ? num_threads : 1];
+    size_t started = 0;
+    for (; started + 1 < num_threads; started++) {
+        if (thrd_create(&threads[started], batch_thread, batch) != thrd_success) {
+            // The threads we have will pick up the slack.
+            break;
+        }
+    }
+    batch_thread(batch);
+    for (size_t i = 0; i < started; i++) {
+        thrd_join(threads[i], NULL);
+    }
+    return atomic_load(&batch->ok);
+}
+
+// Writes the blocks of |batch|, each preceded by its size word.
+static bool write_blocks(int outfd, const batch_t* batch) {
+    for (size_t i = 0; i < batch->count; i++) {
+        const block_t* block = &batch->blocks[i];
+        uint8_t word[4];
+        put_le32(word, block->actual | (block->raw ? BLOCK_UNCOMPRESSED : 0));
+        if (!write_full(outfd, word, sizeof(word)) ||
+            !write_full(outfd, block->raw ? block->in : block->out, block->actual)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static size_t batch_blocks(size_t block_size, size_t num_threads) {
+    size_t count = BATCH_BYTES / block_size;
+    return count < num_threads ? num_threads : count;
+}
+
+int lz4_compress_parallel(int infd, int outfd, int clevel, size_t num_threads) {
+    int ret = -1;
+    if (num_threads == 0) {
+        num_threads = 1;
+    }
+
+    struct stat st;
+    bool has_size = fstat(infd, &st) == 0 && S_ISREG(st.st_mode);
+
+    uint8_t hdr[15];
+    size_t hlen = 0;
+    put_le32(hdr, LZ4_MAGIC);
+    hlen += 4;
+    hdr[hlen++] = FLG_VERSION | FLG_BLOCK_INDEP | (has_size ? FLG_CONTENT_SIZE : 0);
+    hdr[hlen++] = BD_BLOCK_64KB << BD_BLOCK_MAX_SHIFT;
+    if (has_size) {
+        uint64_t size = st.st_size;
+        for (size_t i = 0; i < 8; i++) {
+            hdr[hlen++] = (uint8_t)(size >> (8 * i));
+        }
+    }
+    hdr[hlen] = (uint8_t)(XXH32(hdr + 4, hlen - 4, 0) >> 8);
+    hlen++;
+
+    size_t max_blocks = batch_blocks(BLOCK_SIZE, num_threads);
+    size_t bound = LZ4_compressBound(BLOCK_SIZE);
+    uint8_t* inbuf = malloc(max_blocks * BLOCK_SIZE);
+    uint8_t* outbuf = malloc(max_blocks * bound);
+    block_t* blocks = calloc(max_blocks, sizeof(block_t));
+    if (!inbuf || !outbuf || !blocks) {
+        fprintf(stderr, "out of memory\n");
+        goto done;
+    }
+
+    if (!write_full(outfd, hdr, hlen)) {
+        fprintf(stderr, "could not write: %s\n", strerror(errno));
+        goto done;
+    }
+
+    uint64_t total = 0;
+    for (;;) {
+        ssize_t nr = read_full(infd, inbuf, max_blocks * BLOCK_SIZE);
+        if (nr < 0) {
+            fprintf(stderr, "error reading: %s\n", strerror(errno));
+            goto done;
+        }
+        if (nr == 0) {
+            break;
+        }
+
+        batch_t batch = {
+            .blocks = blocks,
+            .count = (nr + BLOCK_SIZE - 1) / BLOCK_SIZE,
+            .decompress = false,
+            .clevel = clevel,
+        };
+        for (size_t i = 0; i < batch.count; i++) {
+            blocks[i].in = inbuf + i * BLOCK_SIZE;
+            blocks[i].in_size = (i + 1) * BLOCK_SIZE <= (size_t)nr ? BLOCK_SIZE
+                                                                  : nr - i * BLOCK_SIZE;
+            blocks[i].out = outbuf + i * bound;
+            blocks[i].out_size = bound;
+        }
+        run_batch(&batch, num_threads);
+        if (!write_blocks(outfd, &batch)) {
+            fprintf(stderr, "could not write: %s\n", strerror(errno));
+            goto done;
+        }
+
+        total += nr;
+        if ((size_t)nr < max_blocks * BLOCK_SIZE) {
+            break;
+        }
+    }
+    if (has_size && total != (uint64_t)st.st_size) {
+        fprintf(stderr, "input changed size while compressing\n");
+        goto done;
+    }
+
+    uint8_t end_mark[4] = {0};
+    if (!write_full(outfd, end_mark, sizeof(end_mark))) {
+        fprintf(stderr, "could not write: %s\n", strerror(errno));
+        goto done;
+    }
+    ret = 0;
+
+done:
+    free(blocks);
+    free(outbuf);
+    free(inbuf);
+    return ret;
+}
+
+// Decompresses the blocks of one frame, whose header has been read.
+static int decompress_frame(int infd, int outfd, uint8_t flg, size_t block_max,
+                            uint64_t content_size, size_t num_threads) {
+    int ret = -1;
+    size_t max_blocks = batch_blocks(block_max, num_threads);
+    uint8_t* inbuf = malloc(max_blocks * block_max);
+    uint8_t* outbuf = malloc(max_blocks * block_max);
+    block_t* blocks = calloc(max_blocks, sizeof(block_t));
+    XXH32_state_t* xxh = XXH32_createState();
+    if (!inbuf || !outbuf || !blocks || !xxh) {
+        fprintf(stderr, "out of memory\n");
+        goto done;
+    }
+    XXH32_reset(xxh, 0);
+
+    uint64_t total = 0;
+    bool end = false;
+    while (!end) {
+        batch_t batch = {
+            .blocks = blocks,
+            .count = 0,
+            .decompress = true,
+        };
+        while (batch.count < max_blocks) {
+            uint8_t word[4];
+            if (read_full(infd, word, sizeof(word)) != sizeof(word)) {
+                fprintf(stderr, "lz4 frame truncated\n");
+                goto done;
+            }
+            uint32_t size = get_le32(word);
+            if (size == 0) {
+                end = true;
+                break;
+            }
+            block_t* block = &blocks[batch.count++];
+            block->raw = (size & BLOCK_UNCOMPRESSED) != 0;
+            block->in_size = size & ~BLOCK_UNCOMPRESSED;
+            if (block->in_size > block_max) {
+                fprintf(stderr, "lz4 block larger than the frame allows\n");
+                goto done;
+            }
+            block->in = inbuf + (batch.count - 1) * block_max;
+            block->out = outbuf + (batch.count - 1) * block_max;
+            block->out_size = block_max;
+            if (read_full(infd, (uint8_t*)block->in, block->in_size) != (ssize_t)block->in_size) {
+                fprintf(stderr, "lz4 frame truncated\n");
+                goto done;
+            }
+        }
+
+        if (!run_batch(&batch, num_threads)) {
+            fprintf(stderr, "lz4 decompression failed\n");
+            goto done;
+        }
+        for (size_t i = 0; i < batch.count; i++) {
+            const block_t* block = &blocks[i];
+            const uint8_t* data = block->raw ? block->in : block->out;
+            if (!write_full(outfd, data, block->actual)) {
+                fprintf(stderr, "could not write: %s\n", strerror(errno));
+                goto done;
+            }
+            if (flg & FLG_CONTENT_CKSUM) {
+                XXH32_update(xxh, data, block->actual);
+            }
+            total += block->actual;
+        }
+    }
+
+    if (flg & FLG_CONTENT_CKSUM) {
+        uint8_t cksum[4];
+        if (read_full(infd, cksum, sizeof(cksum)) != sizeof(cksum)) {
+            fprintf(stderr, "lz4 frame truncated\n");
+            goto done;
+        }
+        if (get_le32(cksum) != XXH32_digest(xxh)) {
+            fprintf(stderr, "lz4 content checksum mismatch\n");
+            goto done;
+        }
+    }
+    if ((flg & FLG_CONTENT_SIZE) && total != content_size) {
+        fprintf(stderr, "lz4 content size mismatch\n");
+        goto done;
+    }
+    ret = 0;
+
+done:
+    XXH32_freeState(xxh);
+    free(blocks);
+    free(outbuf);
+    free(inbuf);
+    return ret;
+}
+
+int lz4_decompress_parallel(int infd, int outfd, size_t num_threads) {
+    if (num_threads == 0) {
+        num_threads = 1;
+    }
+
+    for (bool first = true;; first = false) {
+        uint8_t hdr[15];
+        ssize_t nr = read_full(infd, hdr, 6);
+        if (nr < 0) {
+            fprintf(stderr, "error reading: %s\n", strerror(errno));
+            return -1;
+        }
+        if (nr == 0 && !first) {
+            return 0;
+        }
+        if (nr != 6 || get_le32(hdr) != LZ4_MAGIC) {
+            if (first) {
+                // Let the serial path deal with anything unusual.
+                return LZ4_PARALLEL_UNSUPPORTED;
+            }
+            fprintf(stderr, "bad lz4 frame header\n");
+            return -1;
+        }
+
+        uint8_t flg = hdr[4];
+        uint8_t bd = hdr[5];
+        if ((flg & FLG_VERSION_MASK) != FLG_VERSION || (flg & FLG_RESERVED) ||
+            (bd & BD_RESERVED) || ((bd & BD_BLOCK_MAX_MASK) >> BD_BLOCK_MAX_SHIFT) < 4) {
+            fprintf(stderr, "bad lz4 frame header\n");
+            return -1;
+        }
+        if (!(flg & FLG_BLOCK_INDEP) || (flg & FLG_BLOCK_CKSUM)) {
+            if (first) {
+                return LZ4_PARALLEL_UNSUPPORTED;
+            }
+            fprintf(stderr, "lz4 frame with linked blocks follows independent ones\n");
+            return -1;
+        }
+
+        size_t hlen = 6 + ((flg & FLG_CONTENT_SIZE) ? 8 : 0) + 1;
+        if (read_full(infd, hdr + 6, hlen - 6) != (ssize_t)(hlen - 6)) {
+            fprintf(stderr, "lz4 frame truncated\n");
+            return -1;
+        }
+        if (hdr[hlen - 1] != (uint8_t)(XXH32(hdr + 4, hlen - 5, 0) >> 8)) {
+            fprintf(stderr, "lz4 frame header checksum mismatch\n");
+            return -1;
+        }
+        uint64_t content_size = 0;
+        if (flg & FLG_CONTENT_SIZE) {
+            for (size_t i = 0; i < 8; i++) {
+                content_size |= (uint64_t)hdr[6 + i] << (8 * i);
+            }
+        }
+
+        size_t block_max = (size_t)1 << (8 + 2 * ((bd & BD_BLOCK_MAX_MASK) >> BD_BLOCK_MAX_SHIFT));
+        if (decompress_frame(infd, outfd, flg, block_max, content_size, num_threads) != 0) {
+            return -1;
+        }
+    }
+}
@@ -0,0 +1,24 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+
+// Returned by lz4_decompress_parallel() when the input is a valid LZ4 frame
+// which can only be decoded in order, such as one with linked blocks.
+#define LZ4_PARALLEL_UNSUPPORTED 1
+
+// Compresses |infd| into |outfd| as a single LZ4 frame of independent 64kB
+// blocks, compressing up to |num_threads| blocks at once. The content size is
+// recorded in the frame if |infd| is a regular file.
+// Returns 0 on success and -1 on error, which has been printed.
+int lz4_compress_parallel(int infd, int outfd, int clevel, size_t num_threads);
+
+// Decompresses the LZ4 frames of independent blocks read from |infd| into
+// |outfd|, decompressing up to |num_threads| blocks at once.
+// Returns 0 on success and -1 on error, which has been printed. Returns
+// LZ4_PARALLEL_UNSUPPORTED without writing anything if the first frame's
+// blocks are not independent.
+int lz4_decompress_parallel(int infd, int outfd, size_t num_threads);
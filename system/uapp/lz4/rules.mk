@@ -10,7 +10,8 @@ MODULE_TYPE := userapp
 MODULE_GROUP := misc
 
 MODULE_SRCS += \
-    $(LOCAL_DIR)/main.c
+    $(LOCAL_DIR)/main.c \
+    $(LOCAL_DIR)/parallel.c
 
 MODULE_STATIC_LIBS := third_party/ulib/lz4
 
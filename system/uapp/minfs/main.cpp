@@ -26,6 +26,10 @@
 
 namespace {
 
+// Reads of cached files, and syncs, are dispatched from this many threads at
+// once; see fs::Vfs::SetConcurrent().
+constexpr uint32_t kDispatchThreads = 4;
+
 int do_minfs_check(fbl::unique_ptr<minfs::Bcache> bc, int argc, char** argv) {
     return minfs_check(fbl::move(bc));
 }
@@ -41,11 +45,19 @@ int do_minfs_mount(fbl::unique_ptr<minfs::Bcache> bc, bool readonly) {
     fs::Vfs vfs(loop.async());
     trace::TraceProvider trace_provider(loop.async());
     vfs.SetReadonly(readonly);
+    vfs.SetConcurrent(true);
 
-    if (MountAndServe(&vfs, fbl::move(bc), zx::channel(h)) != ZX_OK) {
+    // fshost passes on the events for the memory pressure levels, if it has them.
+    zx::event memory_warning(zx_get_startup_handle(PA_HND(PA_USER1, 0)));
+    zx::event memory_critical(zx_get_startup_handle(PA_HND(PA_USER1, 1)));
+    if (MountAndServe(&vfs, fbl::move(bc), zx::channel(h), fbl::move(memory_warning),
+                      fbl::move(memory_critical)) != ZX_OK) {
         return -1;
     }
 
+    for (uint32_t i = 1; i < kDispatchThreads; i++) {
+        loop.StartThread("minfs-dispatcher");
+    }
     loop.Run();
     return 0;
 }
@@ -12,6 +12,7 @@
 
 #include <arpa/inet.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <netinet/if_ether.h>
 #include <netinet/tcp.h>
@@ -33,6 +34,8 @@ typedef struct {
     size_t packet_count;
     size_t verbose_level;
     int dumpfile;
+    // size of the capture ring, or 0 to read frames through the rx fifo
+    size_t ring_size;
 } netdump_options_t;
 
 typedef struct {
@@ -63,6 +66,25 @@ typedef struct {
 
 #define SIMPLE_PKT_MIN_SIZE (sizeof(simple_pkt_t) + sizeof(uint32_t))
 
+// An Interface Description Block with an if_tsresol option, for capture
+// ring timestamps
+typedef struct {
+    uint32_t type;
+    uint32_t blk_tot_len;
+    uint16_t linktype;
+    uint16_t reserved;
+    uint32_t snaplen;
+    uint16_t tsresol_code;
+    uint16_t tsresol_len;
+    uint8_t tsresol;
+    uint8_t tsresol_pad[3];
+    uint32_t end_of_opts;
+    uint32_t blk_tot_len2;
+} __attribute__((packed)) pcap_idb_tsresol_t;
+
+// How long to sleep when the capture ring is empty
+#define RING_POLL_INTERVAL ZX_MSEC(10)
+
 inline void print_mac(const uint8_t mac[ETH_ALEN]) {
     printf("%02x:%02x:%02x:%02x:%02x:%02x",
            mac[0], mac[1], mac[2],
@@ -316,11 +338,127 @@ void handle_rx(zx_handle_t rx_fifo, char* iobuf, unsigned count, netdump_options
 
             e->length = BUFSIZE;
             e->flags = 0;
+        }
+
+        // Hand the whole batch back to the driver at once
+        uint32_t done = 0;
+        while (done < n) {
             uint32_t actual;
-            if ((status = zx_fifo_write(rx_fifo, e, sizeof(*e), &actual)) < 0) {
-                fprintf(stderr, "netdump: failed to queue rx packet: %d\n", status);
+            if ((status = zx_fifo_write(rx_fifo, entries + done, (n - done) * sizeof(entries[0]),
+                                        &actual)) < 0) {
+                fprintf(stderr, "netdump: failed to queue rx packets: %d\n", status);
                 break;
             }
+            done += actual;
+        }
+    }
+}
+
+int write_capture_idb(int fd) {
+    if (fd == -1) {
+        return 0;
+    }
+    pcap_idb_tsresol_t idb = {
+        .type = 0x00000001,
+        .blk_tot_len = sizeof(pcap_idb_tsresol_t),
+        .linktype = 1,
+        .reserved = 0,
+        .snaplen = 0xFFFF,
+        .tsresol_code = 9,
+        .tsresol_len = 1,
+        .tsresol = 9, // nanoseconds
+        .end_of_opts = 0,
+        .blk_tot_len2 = sizeof(pcap_idb_tsresol_t),
+    };
+
+    // One interface for received frames and one for transmitted frames
+    for (int i = 0; i < 2; i++) {
+        if (write(fd, &idb, sizeof(idb)) != sizeof(idb)) {
+            fprintf(stderr, "Couldn't write PCAP Interface Description Block\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Consume blocks from a capture ring, handing rx fifo buffers straight back
+// to the driver.  The rx fifo is only drained so that the driver does not run
+// out of buffers for us; it also tells us when frames are arriving.
+void handle_capture(eth_capture_ring_t* ring, zx_handle_t rx_fifo, unsigned count,
+                    netdump_options_t* options) {
+    eth_fifo_entry_t entries[count];
+    uint8_t* data = (uint8_t*)(ring + 1);
+    uint64_t drops = 0;
+
+    if (write_shb(options->dumpfile)) {
+        return;
+    }
+    if (write_capture_idb(options->dumpfile)) {
+        return;
+    }
+
+    for (;;) {
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t tail = ring->tail;
+        while (tail != head) {
+            uint64_t offset = tail % ring->size;
+            if (ring->size - offset < 2 * sizeof(uint32_t)) {
+                tail += ring->size - offset;
+                continue;
+            }
+            eth_capture_epb_t* epb = (eth_capture_epb_t*)(data + offset);
+            if (epb->block_type == ETH_CAPTURE_BLOCK_PAD) {
+                tail += epb->block_len;
+                continue;
+            }
+
+            uint8_t* frame = (uint8_t*)(epb + 1);
+            if (options->raw) {
+                printf("--- %s\n", epb->interface_id ? "tx" : "rx");
+                hexdump8_ex(frame, epb->cap_len, 0);
+            } else {
+                parse_packet(frame, epb->cap_len, options);
+            }
+            if (options->dumpfile != -1 &&
+                write(options->dumpfile, epb, epb->block_len) != (ssize_t)epb->block_len) {
+                fprintf(stderr, "Couldn't write packet\n");
+                return;
+            }
+            tail += epb->block_len;
+
+            options->packet_count--;
+            if (options->packet_count == 0) {
+                __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+                return;
+            }
+        }
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+
+        if (ring->drops != drops) {
+            fprintf(stderr, "netdump: %" PRIu64 " frames dropped (ring full)\n",
+                    ring->drops - drops);
+            drops = ring->drops;
+        }
+
+        uint32_t n;
+        zx_status_t status = zx_fifo_read(rx_fifo, entries, sizeof(entries), &n);
+        if (status == ZX_OK) {
+            for (uint32_t i = 0; i < n; i++) {
+                entries[i].length = BUFSIZE;
+                entries[i].flags = 0;
+            }
+            uint32_t actual;
+            zx_fifo_write(rx_fifo, entries, n * sizeof(entries[0]), &actual);
+        } else if (status == ZX_ERR_SHOULD_WAIT) {
+            zx_signals_t observed = 0;
+            zx_object_wait_one(rx_fifo, ZX_FIFO_READABLE | ZX_FIFO_PEER_CLOSED,
+                               zx_deadline_after(RING_POLL_INTERVAL), &observed);
+            if (observed & ZX_FIFO_PEER_CLOSED) {
+                return;
+            }
+        } else {
+            fprintf(stderr, "netdump: failed to read rx packets: %d\n", status);
+            return;
         }
     }
 }
@@ -331,6 +469,7 @@ int usage(void) {
     fprintf(stderr, " -c count: Exit after receiving count packets\n");
     fprintf(stderr, " -e      : Print link-level header information\n");
     fprintf(stderr, " -p      : Use promiscuous mode\n");
+    fprintf(stderr, " -r size : Capture through a shared ring of size MiB, with timestamps\n");
     fprintf(stderr, " -v      : Print verbose output\n");
     fprintf(stderr, " -vv     : Print extra verbose output\n");
     fprintf(stderr, " --raw   : Print raw bytes of all incoming packets\n");
@@ -357,6 +496,19 @@ int parse_args(int argc, const char** argv, netdump_options_t* options) {
             argv++;
             argc--;
             options->link_level = true;
+        } else if (!strcmp(argv[0], "-r")) {
+            argv++;
+            argc--;
+            if (argc < 1) {
+                return usage();
+            }
+            char* endptr;
+            options->ring_size = strtoul(argv[0], &endptr, 10) * 1024 * 1024;
+            if (*endptr != '\0' || options->ring_size == 0) {
+                return usage();
+            }
+            argv++;
+            argc--;
         } else if (!strcmp(argv[0], "-p")) {
             argv++;
             argc--;
@@ -475,12 +627,34 @@ int main(int argc, const char** argv) {
         return -1;
     }
 
-    if (ioctl_ethernet_tx_listen_start(fd) < 0) {
-        fprintf(stderr, "netdump: failed to start listening\n");
-        return -1;
-    }
+    if (options.ring_size) {
+        zx_handle_t ring_vmo;
+        eth_capture_ring_t* ring;
+        if ((status = zx_vmo_create(options.ring_size, 0, &ring_vmo)) < 0 ||
+            (status = zx_vmar_map(zx_vmar_root_self(), 0, ring_vmo, 0, options.ring_size,
+                                  ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE,
+                                  (uintptr_t*)&ring)) < 0) {
+            fprintf(stderr, "netdump: failed to create capture ring: %d\n", status);
+            return -1;
+        }
+        ring->magic = ETH_CAPTURE_MAGIC;
+        ring->snaplen = 0;
+        if ((r = ioctl_ethernet_set_capture(fd, &ring_vmo)) < 0) {
+            fprintf(stderr, "netdump: failed to start capture: %zd\n", r);
+            return -1;
+        }
+        handle_capture(ring, fifos.rx_fifo, count, &options);
+        fprintf(stderr, "netdump: %" PRIu64 " frames captured, %" PRIu64 " dropped, %" PRIu64
+                " truncated\n", ring->packets, ring->drops, ring->truncated);
+        ioctl_ethernet_capture_stop(fd);
+    } else {
+        if (ioctl_ethernet_tx_listen_start(fd) < 0) {
+            fprintf(stderr, "netdump: failed to start listening\n");
+            return -1;
+        }
 
-    handle_rx(fifos.rx_fifo, iobuf, count, &options);
+        handle_rx(fifos.rx_fifo, iobuf, count, &options);
+    }
 
     zx_handle_close(fifos.rx_fifo);
     if (options.dumpfile != -1) {
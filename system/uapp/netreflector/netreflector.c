@@ -9,6 +9,7 @@
 #include <zircon/syscalls/port.h>
 
 #include <fcntl.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -28,7 +29,7 @@ typedef struct eth_buf eth_buf_t;
 
 struct eth_buf {
     eth_buf_t* next;
-    eth_fifo_entry_t* e;
+    eth_fifo_entry_t e;
 };
 
 typedef struct {
@@ -38,9 +39,18 @@ typedef struct {
 } __PACKED eth_hdr_t;
 
 eth_buf_t* avail_tx_buffers = NULL;
-eth_buf_t* pending_tx = NULL;
 zx_handle_t port = ZX_HANDLE_INVALID;
 
+// Entries to write back to each fifo, collected while handling a batch of
+// completions so that each fifo takes a single write per batch.
+eth_fifo_entry_t rx_batch[BUFS];
+uint32_t rx_batch_count = 0;
+eth_fifo_entry_t tx_batch[BUFS];
+uint32_t tx_batch_count = 0;
+
+// Packets reflected since the last report
+uint64_t reflected = 0;
+
 void flip_src_dst(void* packet) {
     eth_hdr_t* eth = packet;
     mac_addr_t src_mac = eth->src;
@@ -61,18 +71,19 @@ void flip_src_dst(void* packet) {
     udp->checksum = ip6_checksum(ip, HDR_UDP, ntohs(ip->length));
 }
 
-void send_pending_tx(zx_handle_t tx_fifo) {
-    uint32_t n;
-    zx_status_t status;
-    while (pending_tx != NULL) {
-        eth_fifo_entry_t* e = pending_tx->e;
-        e->cookie = pending_tx;
-        if ((status = zx_fifo_write(tx_fifo, e, sizeof(eth_fifo_entry_t), &n)) != ZX_OK) {
-            fprintf(stderr, "netreflector: error reflecting packet %d\n", status);
-            return;
+void flush_batch(zx_handle_t fifo, eth_fifo_entry_t* batch, uint32_t* count) {
+    uint32_t done = 0;
+    while (done < *count) {
+        uint32_t n;
+        zx_status_t status = zx_fifo_write(fifo, batch + done, (*count - done) * sizeof(*batch),
+                                           &n);
+        if (status != ZX_OK) {
+            fprintf(stderr, "netreflector: error writing fifo %d\n", status);
+            break;
         }
-        pending_tx = pending_tx->next;
+        done += n;
     }
+    *count = 0;
 }
 
 void tx_complete(eth_fifo_entry_t* e) {
@@ -93,29 +104,27 @@ zx_status_t acquire_tx_buffer(eth_buf_t** out) {
     return ZX_OK;
 }
 
-void queue_tx_buffer(eth_buf_t* tx) {
-    tx->next = pending_tx;
-    pending_tx = tx;
-}
-
 zx_status_t reflect_packet(char* iobuf, eth_fifo_entry_t* e) {
     eth_buf_t* tx;
     zx_status_t status;
     if ((status = acquire_tx_buffer(&tx)) != ZX_OK) {
         return status;
     }
-    tx->e->length = e->length;
+    tx->e.length = e->length;
+    tx->e.flags = 0;
+    tx->e.cookie = tx;
 
     void* in_pkt = iobuf + e->offset;
-    void* out_pkt = iobuf + tx->e->offset;
-    memcpy(out_pkt, in_pkt, tx->e->length);
+    void* out_pkt = iobuf + tx->e.offset;
+    memcpy(out_pkt, in_pkt, tx->e.length);
     flip_src_dst(out_pkt);
 
-    queue_tx_buffer(tx);
+    tx_batch[tx_batch_count++] = tx->e;
+    reflected++;
     return ZX_OK;
 }
 
-void rx_complete(char* iobuf, zx_handle_t rx_fifo, eth_fifo_entry_t* e) {
+void rx_complete(char* iobuf, eth_fifo_entry_t* e) {
     if (!(e->flags & ETH_FIFO_RX_OK)) {
         return;
     }
@@ -134,11 +143,7 @@ void rx_complete(char* iobuf, zx_handle_t rx_fifo, eth_fifo_entry_t* e) {
 queue:
     e->length = BUFSIZE;
     e->flags = 0;
-    uint32_t actual;
-    zx_status_t status;
-    if ((status = zx_fifo_write(rx_fifo, e, sizeof(*e), &actual)) != ZX_OK) {
-        fprintf(stderr, "netreflector: failed to queue rx packet: %d\n", status);
-    }
+    rx_batch[rx_batch_count++] = *e;
 }
 
 void handle(char* iobuf, eth_fifos_t* fifos) {
@@ -146,8 +151,21 @@ void handle(char* iobuf, eth_fifos_t* fifos) {
     zx_status_t status;
     uint32_t n;
     eth_fifo_entry_t entries[BUFS];
+    zx_time_t last_report = zx_time_get(ZX_CLOCK_MONOTONIC);
     for (;;) {
-        status = zx_port_wait(port, ZX_TIME_INFINITE, &packet, 0);
+        status = zx_port_wait(port, last_report + ZX_SEC(1), &packet, 0);
+        zx_time_t now = zx_time_get(ZX_CLOCK_MONOTONIC);
+        if (now >= last_report + ZX_SEC(1)) {
+            if (reflected > 0) {
+                printf("netreflector: %" PRIu64 " packets/sec\n",
+                       reflected * ZX_SEC(1) / (now - last_report));
+                reflected = 0;
+            }
+            last_report = now;
+        }
+        if (status == ZX_ERR_TIMED_OUT) {
+            continue;
+        }
         if (status != ZX_OK) {
             fprintf(stderr, "netreflector: error while waiting on port %d\n", status);
             return;
@@ -162,7 +180,9 @@ void handle(char* iobuf, eth_fifos_t* fifos) {
             uint8_t fifo_id = (uint8_t)packet.key;
             zx_handle_t fifo = (fifo_id == RX_FIFO ? fifos->rx_fifo : fifos->tx_fifo);
             if ((status = zx_fifo_read(fifo, entries, sizeof(entries), &n)) != ZX_OK) {
-                fprintf(stderr, "netreflector: error reading fifo %d\n", status);
+                if (status != ZX_ERR_SHOULD_WAIT) {
+                    fprintf(stderr, "netreflector: error reading fifo %d\n", status);
+                }
                 continue;
             }
 
@@ -175,7 +195,7 @@ void handle(char* iobuf, eth_fifos_t* fifos) {
                 break;
             case RX_FIFO:
                 for (uint32_t i = 0; i < n; i++, e++) {
-                    rx_complete(iobuf, fifos->rx_fifo, e);
+                    rx_complete(iobuf, e);
                 }
                 break;
             default:
@@ -183,7 +203,8 @@ void handle(char* iobuf, eth_fifos_t* fifos) {
                 break;
             }
         }
-        send_pending_tx(fifos->tx_fifo);
+        flush_batch(fifos->tx_fifo, tx_batch, &tx_batch_count);
+        flush_batch(fifos->rx_fifo, rx_batch, &rx_batch_count);
     }
 }
 
@@ -233,20 +254,20 @@ int main(int argc, char** argv) {
         eth_fifo_entry_t entry = {
             .offset = n * BUFSIZE, .length = BUFSIZE, .flags = 0, .cookie = NULL,
         };
-        uint32_t actual;
-        if ((status = zx_fifo_write(fifos.rx_fifo, &entry, sizeof(entry), &actual)) < 0) {
-            fprintf(stderr, "netreflector: failed to queue rx packet: %d\n", status);
-            return -1;
-        }
+        rx_batch[rx_batch_count++] = entry;
     }
+    flush_batch(fifos.rx_fifo, rx_batch, &rx_batch_count);
 
-    // ... continue writing next BUFS entries to tx fifo.
+    // ... and keep the next BUFS entries for tx.
     eth_buf_t* buf = malloc(sizeof(eth_buf_t) * BUFS);
+    if (buf == NULL) {
+        return -1;
+    }
     for (; n < count; n++, buf++) {
         eth_fifo_entry_t entry = {
             .offset = n * BUFSIZE, .length = BUFSIZE, .flags = 0, .cookie = buf,
         };
-        buf->e = &entry;
+        buf->e = entry;
         buf->next = avail_tx_buffers;
         avail_tx_buffers = buf;
     }
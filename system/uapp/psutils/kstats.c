@@ -89,6 +89,155 @@ static zx_status_t cpustats(zx_handle_t root_resource, zx_time_t delay) {
     return ZX_OK;
 }
 
+static void print_histogram(const char* title, const char* const* labels,
+                            const uint64_t* counts, size_t num_buckets) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < num_buckets; i++) {
+        total += counts[i];
+    }
+    printf("%s (%" PRIu64 " samples)\n", title, total);
+    if (total == 0)
+        return;
+
+    for (size_t i = 0; i < num_buckets; i++) {
+        if (counts[i] == 0)
+            continue;
+        unsigned int percent = (unsigned int)((counts[i] * 1000) / total);
+        printf("  %12s %10" PRIu64 " %3u.%u%%\n",
+               labels[i], counts[i], percent / 10, percent % 10);
+    }
+}
+
+static zx_status_t schedstats(zx_handle_t root_resource) {
+    static zx_info_cpu_sched_histograms_t old_hist[MAX_CPUS];
+    zx_info_cpu_sched_histograms_t hist[MAX_CPUS];
+
+    size_t actual, avail;
+    zx_status_t err = zx_object_get_info(root_resource, ZX_INFO_CPU_SCHED_HISTOGRAMS,
+                                         &hist, sizeof(hist), &actual, &avail);
+    if (err != ZX_OK) {
+        fprintf(stderr, "ZX_INFO_CPU_SCHED_HISTOGRAMS returns %d (%s)\n",
+                err, zx_status_get_string(err));
+        return err;
+    }
+
+    // sum the change since the last report over every cpu
+    uint64_t latency[ZX_INFO_SCHED_LATENCY_BUCKETS] = {};
+    uint64_t depth[ZX_INFO_SCHED_DEPTH_BUCKETS] = {};
+    uint64_t slice[ZX_INFO_SCHED_SLICE_BUCKETS] = {};
+    for (size_t i = 0; i < actual; i++) {
+        for (size_t b = 0; b < ZX_INFO_SCHED_LATENCY_BUCKETS; b++)
+            latency[b] += hist[i].wakeup_latency[b] - old_hist[i].wakeup_latency[b];
+        for (size_t b = 0; b < ZX_INFO_SCHED_DEPTH_BUCKETS; b++)
+            depth[b] += hist[i].run_queue_depth[b] - old_hist[i].run_queue_depth[b];
+        for (size_t b = 0; b < ZX_INFO_SCHED_SLICE_BUCKETS; b++)
+            slice[b] += hist[i].slice_usage[b] - old_hist[i].slice_usage[b];
+        old_hist[i] = hist[i];
+    }
+
+    static const char* const size_suffix[] = {"ns", "us", "ms", "s"};
+    char latency_buf[ZX_INFO_SCHED_LATENCY_BUCKETS][16];
+    const char* latency_labels[ZX_INFO_SCHED_LATENCY_BUCKETS];
+    for (size_t b = 0; b < ZX_INFO_SCHED_LATENCY_BUCKETS; b++) {
+        // label each bucket by its lower bound, scaled to a readable unit
+        uint64_t lower = (b == 0) ? 0 : (1ull << b);
+        size_t unit = 0;
+        while (lower >= 1000 && unit < countof(size_suffix) - 1) {
+            lower /= 1000;
+            unit++;
+        }
+        snprintf(latency_buf[b], sizeof(latency_buf[b]), ">= %" PRIu64 "%s",
+                 lower, size_suffix[unit]);
+        latency_labels[b] = latency_buf[b];
+    }
+
+    char depth_buf[ZX_INFO_SCHED_DEPTH_BUCKETS][16];
+    const char* depth_labels[ZX_INFO_SCHED_DEPTH_BUCKETS];
+    for (size_t b = 0; b < ZX_INFO_SCHED_DEPTH_BUCKETS; b++) {
+        snprintf(depth_buf[b], sizeof(depth_buf[b]), "%s%zu",
+                 (b == ZX_INFO_SCHED_DEPTH_BUCKETS - 1) ? ">= " : "", b);
+        depth_labels[b] = depth_buf[b];
+    }
+
+    char slice_buf[ZX_INFO_SCHED_SLICE_BUCKETS][16];
+    const char* slice_labels[ZX_INFO_SCHED_SLICE_BUCKETS];
+    for (size_t b = 0; b < ZX_INFO_SCHED_SLICE_BUCKETS; b++) {
+        snprintf(slice_buf[b], sizeof(slice_buf[b]), ">= %zu%%", b * 100 / ZX_INFO_SCHED_SLICE_BUCKETS);
+        slice_labels[b] = slice_buf[b];
+    }
+
+    print_histogram("wakeup to run latency", latency_labels, latency, countof(latency));
+    print_histogram("run queue depth at reschedule", depth_labels, depth, countof(depth));
+    print_histogram("time slice used", slice_labels, slice, countof(slice));
+
+    return ZX_OK;
+}
+
+// the kernel's limit, see LOCKPROF_SITES
+#define MAX_LOCK_SITES 1024
+#define LOCK_SITES_SHOWN 20
+
+static int compare_lock_wait(const void* a, const void* b) {
+    const zx_info_lock_profile_t* pa = a;
+    const zx_info_lock_profile_t* pb = b;
+    if (pa->wait_total != pb->wait_total)
+        return pa->wait_total > pb->wait_total ? -1 : 1;
+    return pa->hold_total > pb->hold_total ? -1 : pa->hold_total < pb->hold_total;
+}
+
+static zx_status_t lockstats(zx_handle_t root_resource) {
+    static zx_info_lock_profile_t old_prof[MAX_LOCK_SITES];
+    static size_t old_count;
+    static zx_info_lock_profile_t prof[MAX_LOCK_SITES];
+    static zx_info_lock_profile_t delta[MAX_LOCK_SITES];
+
+    size_t actual, avail;
+    zx_status_t err = zx_object_get_info(root_resource, ZX_INFO_LOCK_PROFILE,
+                                         prof, sizeof(prof), &actual, &avail);
+    if (err != ZX_OK) {
+        fprintf(stderr, "ZX_INFO_LOCK_PROFILE returns %d (%s)\n",
+                err, zx_status_get_string(err));
+        if (err == ZX_ERR_NOT_SUPPORTED)
+            fprintf(stderr, "the kernel needs to be built with ENABLE_LOCK_PROFILING=true\n");
+        return err;
+    }
+
+    // the change at each site since the last report, the maximums are since boot
+    for (size_t i = 0; i < actual; i++) {
+        delta[i] = prof[i];
+        for (size_t j = 0; j < old_count; j++) {
+            if (old_prof[j].caller == prof[i].caller) {
+                delta[i].acquires -= old_prof[j].acquires;
+                delta[i].contended -= old_prof[j].contended;
+                delta[i].wait_total -= old_prof[j].wait_total;
+                delta[i].hold_total -= old_prof[j].hold_total;
+                break;
+            }
+        }
+    }
+    memcpy(old_prof, prof, actual * sizeof(prof[0]));
+    old_count = actual;
+
+    qsort(delta, actual, sizeof(delta[0]), compare_lock_wait);
+
+    double ticks_per_usec = (double)zx_ticks_per_second() / 1000000.0;
+    printf("%18s %18s %5s %10s %10s %12s %10s %12s %10s\n", "caller", "lock", "kind",
+           "acquires", "contended", "wait us", "max", "hold us", "max");
+    for (size_t i = 0; i < actual && i < LOCK_SITES_SHOWN; i++) {
+        const zx_info_lock_profile_t* p = &delta[i];
+        printf("%#18" PRIx64 " %#18" PRIx64 " %5s %10" PRIu64 " %10" PRIu64
+               " %12.0f %10.0f %12.0f %10.0f\n",
+               p->caller, p->lock, p->kind == ZX_INFO_LOCK_KIND_SPIN ? "spin" : "mutex",
+               p->acquires, p->contended,
+               (double)p->wait_total / ticks_per_usec, (double)p->wait_max / ticks_per_usec,
+               (double)p->hold_total / ticks_per_usec, (double)p->hold_max / ticks_per_usec);
+    }
+    if (actual < avail)
+        printf("%zu more sites not shown\n", avail - actual);
+
+    return ZX_OK;
+}
+
 static void print_mem_stat(const char* label, size_t bytes) {
     char buf[MAX_FORMAT_SIZE_LEN];
     const char unit = 'M';
@@ -152,6 +301,9 @@ static void print_help(FILE* f) {
     fprintf(f, "Options:\n");
     fprintf(f, " -c              Print system CPU stats\n");
     fprintf(f, " -m              Print system memory stats\n");
+    fprintf(f, " -s              Print scheduler latency, run queue and time slice histograms\n");
+    fprintf(f, " -l              Print the most contended kernel locks (needs a kernel built\n");
+    fprintf(f, "                 with ENABLE_LOCK_PROFILING=true)\n");
     fprintf(f, " -d <delay>      Delay in seconds (default 1 second)\n");
     fprintf(f, " -n <times>      Run this many times and then exit\n");
     fprintf(f, " -t              Print timestamp for each report\n");
@@ -179,12 +331,14 @@ static void print_help(FILE* f) {
 int main(int argc, char** argv) {
     bool cpu_stats = false;
     bool mem_stats = false;
+    bool sched_stats = false;
+    bool lock_stats = false;
     zx_time_t delay = ZX_SEC(1);
     int num_loops = -1;
     bool timestamp = false;
 
     int c;
-    while ((c = getopt(argc, argv, "cd:n:hmt")) > 0) {
+    while ((c = getopt(argc, argv, "cd:n:hlmst")) > 0) {
         switch (c) {
             case 'c':
                 cpu_stats = true;
@@ -208,9 +362,15 @@ int main(int argc, char** argv) {
             case 'h':
                 print_help(stdout);
                 return 0;
+            case 'l':
+                lock_stats = true;
+                break;
             case 'm':
                 mem_stats = true;
                 break;
+            case 's':
+                sched_stats = true;
+                break;
             case 't':
                 timestamp = true;
                 break;
@@ -221,7 +381,7 @@ int main(int argc, char** argv) {
         }
     }
 
-    if (!cpu_stats && !mem_stats) {
+    if (!cpu_stats && !mem_stats && !sched_stats && !lock_stats) {
         fprintf(stderr, "No statistics selected\n");
         print_help(stderr);
         return 1;
@@ -258,6 +418,12 @@ int main(int argc, char** argv) {
         if (mem_stats) {
             ret |= memstats(root_resource);
         }
+        if (sched_stats) {
+            ret |= schedstats(root_resource);
+        }
+        if (lock_stats) {
+            ret |= lockstats(root_resource);
+        }
 
         if (ret != ZX_OK)
             break;
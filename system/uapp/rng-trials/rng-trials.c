@@ -3,13 +3,64 @@
 // found in the LICENSE file.
 
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <zircon/syscalls.h>
 
 #define TRIALS 10000
 #define BINS 32
 
+// Throughput trials: each thread makes DRAWS_PER_THREAD draws of DRAW_SIZE.
+#define DRAWS_PER_THREAD 20000
+#define DRAW_SIZE 32
+#define MAX_THREADS 64
+
+static void* draw_thread(void* arg) {
+    uint8_t buf[DRAW_SIZE];
+    for (unsigned int i = 0; i < DRAWS_PER_THREAD; ++i) {
+        size_t sz = 0;
+        zx_cprng_draw(buf, sizeof(buf), &sz);
+        if (sz != sizeof(buf)) {
+            return (void*)1;
+        }
+    }
+    return NULL;
+}
+
+// Runs |num_threads| threads drawing at once, and reports the total rate.
+static int throughput_trial(unsigned int num_threads) {
+    pthread_t threads[MAX_THREADS];
+    zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+    for (unsigned int i = 0; i < num_threads; ++i) {
+        if (pthread_create(&threads[i], NULL, draw_thread, NULL) != 0) {
+            printf("failed to create thread %u\n", i);
+            return 1;
+        }
+    }
+    int result = 0;
+    for (unsigned int i = 0; i < num_threads; ++i) {
+        void* ret;
+        pthread_join(threads[i], &ret);
+        if (ret != NULL) {
+            result = 1;
+        }
+    }
+    zx_time_t elapsed = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+    if (result != 0) {
+        printf("zx_cprng_draw returned short data\n");
+        return result;
+    }
+
+    uint64_t draws = (uint64_t)num_threads * DRAWS_PER_THREAD;
+    printf("%2u threads: %" PRIu64 " draws of %d bytes in %" PRIu64 " us: "
+           "%" PRIu64 " draws/s\n",
+           num_threads, draws, DRAW_SIZE, elapsed / ZX_USEC(1),
+           elapsed ? draws * ZX_SEC(1) / elapsed : 0);
+    return 0;
+}
+
 int main(int argc, char** argv) {
     static uint8_t buf[32];
     uint64_t values[BINS] = { 0 };
@@ -41,5 +92,24 @@ int main(int argc, char** argv) {
         printf("bin %u: %" PRIu64 "\n", i, values[i]);
     }
 
+    // Measure draw throughput with increasing numbers of concurrent threads,
+    // up to the number given on the command line (default: one per CPU).
+    unsigned int max_threads = zx_system_get_num_cpus();
+    if (argc > 1) {
+        max_threads = (unsigned int)strtoul(argv[1], NULL, 0);
+    }
+    if (max_threads < 1 || max_threads > MAX_THREADS) {
+        printf("thread count must be between 1 and %d\n", MAX_THREADS);
+        return 1;
+    }
+    for (unsigned int n = 1;; n = (n * 2 < max_threads) ? n * 2 : max_threads) {
+        if (throughput_trial(n) != 0) {
+            return 1;
+        }
+        if (n == max_threads) {
+            break;
+        }
+    }
+
     return 0;
 }
@@ -0,0 +1,134 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <perftest/perftest.h>
+
+// Times a batch of UDP datagrams going over the loopback address, sent and
+// received one at a time and with sendmmsg() and recvmmsg(). It needs the
+// netstack, so unlike the microbenchmarks it is not a test.
+
+namespace {
+
+constexpr unsigned kBatch = 16;
+constexpr size_t kMaxSize = 1500;
+
+// A UDP socket connected to another one on the loopback address.
+class UdpPair {
+public:
+    ~UdpPair() {
+        if (tx_ >= 0)
+            close(tx_);
+        if (rx_ >= 0)
+            close(rx_);
+    }
+
+    bool Open() {
+        if ((rx_ = socket(AF_INET, SOCK_DGRAM, 0)) < 0 ||
+            (tx_ = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+            return false;
+        }
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        return bind(rx_, reinterpret_cast<struct sockaddr*>(&addr), len) == 0 &&
+               getsockname(rx_, reinterpret_cast<struct sockaddr*>(&addr), &len) == 0 &&
+               connect(tx_, reinterpret_cast<struct sockaddr*>(&addr), len) == 0;
+    }
+
+    int tx() const { return tx_; }
+    int rx() const { return rx_; }
+
+private:
+    int tx_ = -1;
+    int rx_ = -1;
+};
+
+bool OneAtATime(perftest::RepeatState* state, size_t size) {
+    UdpPair pair;
+    if (!pair.Open())
+        return false;
+    char buf[kMaxSize] = {};
+    bool ok = true;
+    while (state->KeepRunning()) {
+        for (unsigned i = 0; i < kBatch; i++) {
+            if (send(pair.tx(), buf, size, 0) != static_cast<ssize_t>(size))
+                ok = false;
+        }
+        for (unsigned i = 0; i < kBatch; i++) {
+            if (recv(pair.rx(), buf, sizeof(buf), 0) != static_cast<ssize_t>(size))
+                ok = false;
+        }
+    }
+    return ok;
+}
+
+bool Batched(perftest::RepeatState* state, size_t size) {
+    UdpPair pair;
+    if (!pair.Open())
+        return false;
+    static char bufs[kBatch][kMaxSize];
+    struct iovec tx_iov[kBatch];
+    struct iovec rx_iov[kBatch];
+    struct mmsghdr tx_msgs[kBatch] = {};
+    struct mmsghdr rx_msgs[kBatch] = {};
+    for (unsigned i = 0; i < kBatch; i++) {
+        tx_iov[i].iov_base = bufs[i];
+        tx_iov[i].iov_len = size;
+        tx_msgs[i].msg_hdr.msg_iov = &tx_iov[i];
+        tx_msgs[i].msg_hdr.msg_iovlen = 1;
+        rx_iov[i].iov_base = bufs[i];
+        rx_msgs[i].msg_hdr.msg_iov = &rx_iov[i];
+        rx_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    bool ok = true;
+    while (state->KeepRunning()) {
+        if (sendmmsg(pair.tx(), tx_msgs, kBatch, 0) != static_cast<int>(kBatch))
+            ok = false;
+        // Receiving trims each iovec to its datagram.
+        for (unsigned i = 0; i < kBatch; i++)
+            rx_iov[i].iov_len = kMaxSize;
+        unsigned received = 0;
+        while (ok && received < kBatch) {
+            int n = recvmmsg(pair.rx(), rx_msgs + received, kBatch - received,
+                             MSG_WAITFORONE, nullptr);
+            if (n <= 0) {
+                ok = false;
+                break;
+            }
+            received += n;
+        }
+    }
+    return ok;
+}
+
+template <size_t Size>
+void RegisterSize(const char* one_at_a_time_name, const char* batched_name) {
+    perftest::RegisterTest(one_at_a_time_name, [](perftest::RepeatState* state) {
+        return OneAtATime(state, Size);
+    });
+    perftest::RegisterTest(batched_name, [](perftest::RepeatState* state) {
+        return Batched(state, Size);
+    });
+}
+
+void RegisterTests() {
+    static_assert(kBatch == 16, "the names say how many datagrams a batch has");
+    RegisterSize<64>("Udp/OneAtATime/16x64", "Udp/Mmsg/16x64");
+    RegisterSize<1200>("Udp/OneAtATime/16x1200", "Udp/Mmsg/16x1200");
+}
+PERFTEST_CTOR(RegisterTests);
+
+} // namespace
+
+int main(int argc, char** argv) {
+    return perftest::PerfTestMain(argc, argv);
+}
@@ -0,0 +1,127 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <async/channel_reader.h>
+
+#include <fbl/alloc_checker.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
+namespace async {
+
+ChannelReader::ChannelReader(async_t* async, zx_handle_t channel,
+                             uint32_t max_batch, uint32_t msg_bytes)
+    : async_wait_t{{ASYNC_STATE_INIT}, &ChannelReader::CallHandler, channel,
+                   ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED, 0u, {}},
+      async_(async), max_batch_(max_batch), msg_bytes_(msg_bytes) {
+    ZX_DEBUG_ASSERT(async_);
+    ZX_DEBUG_ASSERT(max_batch_ > 0u && max_batch_ <= ZX_CHANNEL_MAX_BATCH_MSGS);
+    ZX_DEBUG_ASSERT(msg_bytes_ <= ZX_CHANNEL_MAX_MSG_BYTES);
+}
+
+ChannelReader::~ChannelReader() {
+    Cancel();
+}
+
+zx_status_t ChannelReader::AllocBuffers() {
+    if (msgs_)
+        return ZX_OK;
+
+    const size_t total_bytes = ZX_CHANNEL_MAX_MSG_BYTES + (max_batch_ - 1u) * size_t{msg_bytes_};
+    const size_t total_handles = size_t{max_batch_} * ZX_CHANNEL_MAX_MSG_HANDLES;
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<zx_channel_read_msg_t[]> msgs(new (&ac) zx_channel_read_msg_t[max_batch_]);
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+    fbl::unique_ptr<uint8_t[]> bytes(new (&ac) uint8_t[total_bytes]);
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+    fbl::unique_ptr<zx_handle_t[]> handles(new (&ac) zx_handle_t[total_handles]);
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    msgs_ = fbl::move(msgs);
+    bytes_ = fbl::move(bytes);
+    handles_ = fbl::move(handles);
+    return ZX_OK;
+}
+
+zx_status_t ChannelReader::Begin() {
+    ZX_DEBUG_ASSERT(!pending_);
+
+    zx_status_t status = AllocBuffers();
+    if (status != ZX_OK)
+        return status;
+
+    status = async_begin_wait(async_, this);
+    if (status == ZX_OK)
+        pending_ = true;
+
+    return status;
+}
+
+void ChannelReader::Cancel() {
+    if (!pending_)
+        return;
+
+    zx_status_t status = async_cancel_wait(async_, this);
+    ZX_DEBUG_ASSERT_MSG(status == ZX_OK, "status=%d", status);
+
+    pending_ = false;
+}
+
+async_wait_result_t ChannelReader::Drain(async_t* async) {
+    for (;;) {
+        uint8_t* bytes = bytes_.get();
+        for (uint32_t i = 0; i < max_batch_; ++i) {
+            const uint32_t num_bytes = i == 0u ? ZX_CHANNEL_MAX_MSG_BYTES : msg_bytes_;
+            msgs_[i] = zx_channel_read_msg_t{
+                bytes, &handles_[i * ZX_CHANNEL_MAX_MSG_HANDLES],
+                num_bytes, ZX_CHANNEL_MAX_MSG_HANDLES, 0u, 0u};
+            bytes += num_bytes;
+        }
+
+        uint32_t count = 0u;
+        zx_status_t status = zx_channel_read_many(async_wait_t::object, 0u,
+                                                  msgs_.get(), max_batch_, &count);
+        if (status == ZX_ERR_SHOULD_WAIT)
+            return ASYNC_WAIT_AGAIN;
+        if (status != ZX_OK) {
+            handler_(async, status, nullptr, 0u);
+            return ASYNC_WAIT_FINISHED;
+        }
+
+        if (handler_(async, ZX_OK, msgs_.get(), count) != ASYNC_WAIT_AGAIN)
+            return ASYNC_WAIT_FINISHED;
+
+        // A short batch means the channel is empty, or the next message only
+        // fits in the first buffer; either way another read is cheaper than
+        // going back through the dispatcher.
+    }
+}
+
+async_wait_result_t ChannelReader::CallHandler(async_t* async, async_wait_t* wait,
+                                               zx_status_t status,
+                                               const zx_packet_signal_t* signal) {
+    auto self = static_cast<ChannelReader*>(wait);
+    ZX_DEBUG_ASSERT(self->pending_);
+    self->pending_ = false;
+
+    if (status != ZX_OK) {
+        self->handler_(async, status, nullptr, 0u);
+        return ASYNC_WAIT_FINISHED;
+    }
+
+    // The handler may destroy the reader when it finishes; don't touch
+    // |self| after that.
+    async_wait_result_t result = self->Drain(async);
+    if (result == ASYNC_WAIT_AGAIN) {
+        ZX_DEBUG_ASSERT(!self->pending_);
+        self->pending_ = true;
+    }
+    return result;
+}
+
+} // namespace async
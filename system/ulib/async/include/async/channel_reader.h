@@ -0,0 +1,106 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <async/wait.h>
+
+#ifdef __cplusplus
+
+#include <fbl/function.h>
+#include <fbl/macros.h>
+#include <fbl/unique_ptr.h>
+
+namespace async {
+
+// Waits for a channel to become readable and drains it in batches of up to
+// |max_batch| messages with |zx_channel_read_many()|, which takes one
+// syscall per batch instead of one per message.
+//
+// The first buffer of each batch can hold the largest possible message; the
+// others hold up to |msg_bytes| bytes, so a large message simply ends a
+// batch and starts the next one.
+//
+// This class is NOT thread-safe; it can only be used with single-threaded
+// asynchronous dispatchers.
+class ChannelReader final : private async_wait_t {
+public:
+    // Handles a batch of messages read from the channel.
+    //
+    // If |status| is |ZX_OK| then |msgs| holds |count| messages, otherwise
+    // |msgs| is null and |count| is zero.  The handler owns the handles in
+    // the messages; the message buffers are only valid until it returns.
+    //
+    // The result indicates whether to keep reading.  The result must be
+    // |ASYNC_WAIT_FINISHED| if |status| was not |ZX_OK|.
+    //
+    // It is safe for the handler to destroy itself when returning |ASYNC_WAIT_FINISHED|.
+    using Handler = fbl::Function<async_wait_result_t(async_t* async,
+                                                      zx_status_t status,
+                                                      const zx_channel_read_msg_t* msgs,
+                                                      uint32_t count)>;
+
+    static constexpr uint32_t kDefaultMaxBatch = 16u;
+    static constexpr uint32_t kDefaultMsgBytes = 4096u;
+
+    // Binds the reader to an asynchronous dispatcher and a channel.
+    explicit ChannelReader(async_t* async,
+                           zx_handle_t channel = ZX_HANDLE_INVALID,
+                           uint32_t max_batch = kDefaultMaxBatch,
+                           uint32_t msg_bytes = kDefaultMsgBytes);
+
+    // Destroys the reader, canceling its wait if it is still pending.
+    ~ChannelReader();
+
+    // Gets the asynchronous dispatcher to which this reader has been bound.
+    async_t* async() const { return async_; }
+
+    // Returns true if |Begin()| was called successfully but the reader has
+    // not finished or been canceled.
+    bool is_pending() const { return pending_; }
+
+    // Gets or sets the handler to invoke for each batch.
+    // Must be set before beginning the wait.
+    const Handler& handler() const { return handler_; }
+    void set_handler(Handler handler) { handler_ = fbl::move(handler); }
+
+    // The channel to read from.
+    zx_handle_t channel() const { return async_wait_t::object; }
+    void set_channel(zx_handle_t channel) { async_wait_t::object = channel; }
+
+    // Begins waiting for the channel to become readable.  Allocates the
+    // message buffers on first use.
+    //
+    // This method must not be called when the wait is already pending.
+    zx_status_t Begin();
+
+    // Cancels the wait.
+    //
+    // This method does nothing if the wait is not pending.
+    void Cancel();
+
+private:
+    static async_wait_result_t CallHandler(async_t* async, async_wait_t* wait,
+                                           zx_status_t status,
+                                           const zx_packet_signal_t* signal);
+
+    zx_status_t AllocBuffers();
+    async_wait_result_t Drain(async_t* async);
+
+    async_t* const async_;
+    const uint32_t max_batch_;
+    const uint32_t msg_bytes_;
+    Handler handler_;
+    bool pending_ = false;
+
+    fbl::unique_ptr<zx_channel_read_msg_t[]> msgs_;
+    fbl::unique_ptr<uint8_t[]> bytes_;
+    fbl::unique_ptr<zx_handle_t[]> handles_;
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(ChannelReader);
+};
+
+} // namespace async
+
+#endif // __cplusplus
@@ -48,6 +48,15 @@ typedef struct async_loop_config {
 
     // Data to pass to the callback functions.
     void* data;
+
+    // If true, tasks posted with a deadline which has already passed are run
+    // as independent work items instead of in deadline order with the other
+    // tasks: any thread running the loop may run them, concurrently with each
+    // other and with other handlers.  Each thread running the loop queues the
+    // tasks it posts itself and runs them without a system call; threads which
+    // run out of work steal from the others, and only idle threads are woken.
+    // Tasks with later deadlines are dispatched as usual.
+    bool executor;
 } async_loop_config_t;
 
 // Creates a message loop and returns its asynchronous dispatcher.
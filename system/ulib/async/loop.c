@@ -19,6 +19,20 @@
 // The port wait key associated with the dispatcher's control messages.
 #define KEY_CONTROL (0u)
 
+// The key of a batched packet whose wait was canceled before the packet
+// could be dispatched.  Waits are pointers, so this is never a real key.
+#define KEY_CANCELED (1u)
+
+// The maximum number of packets a loop thread dequeues per wakeup.
+#define MAX_BATCH_PACKETS (16u)
+
+// The initial number of task heap slots.
+#define MIN_TASK_CAPACITY (16u)
+
+// The maximum number of ready tasks a loop thread runs in executor mode
+// before it checks the port, so that waits and timers are not starved.
+#define MAX_READY_STREAK (32u)
+
 static zx_status_t async_loop_begin_wait(async_t* async, async_wait_t* wait);
 static zx_status_t async_loop_cancel_wait(async_t* async, async_wait_t* wait);
 static zx_status_t async_loop_post_task(async_t* async, async_task_t* task);
@@ -38,6 +52,41 @@ typedef struct thread_record {
     thrd_t thread;
 } thread_record_t;
 
+// Packets dequeued together which a loop thread is dispatching.
+typedef struct packet_batch {
+    list_node_t node;
+    size_t next; // index of the next packet to dispatch
+    size_t count;
+    zx_port_packet_t packets[MAX_BATCH_PACKETS];
+} packet_batch_t;
+
+// A queue of tasks which are ready to run in executor mode.  Each thread
+// running the loop owns one and other threads may steal from it; tasks posted
+// by threads which are not running the loop go on the loop's shared queue.
+// Queues stay allocated until the loop is destroyed because concurrent
+// cancelations may still refer to them; a thread which stops running the
+// loop moves its tasks to the shared queue and leaves its queue for reuse.
+typedef struct run_queue {
+    list_node_t node; // in the loop's |queue_list|
+    struct async_loop* loop; // immutable
+    bool in_use; // guarded by the loop's |lock|
+    uint32_t streak; // ready tasks run since checking the port, owner only
+
+    mtx_t lock; // guards the queue and the states of the tasks on it
+    async_task_t* head;
+    async_task_t* tail;
+    atomic_size_t count;
+} run_queue_t;
+
+// A pending task's slot in the loop's task heap.  The deadline is cached here
+// so the heap can be reordered without touching the tasks themselves, and the
+// sequence number keeps tasks with equal deadlines in the order they were posted.
+typedef struct task_entry {
+    zx_time_t deadline;
+    uint64_t seq;
+    async_task_t* task;
+} task_entry_t;
+
 typedef struct async_loop {
     async_t async; // must be first
     async_loop_config_t config; // immutable
@@ -50,20 +99,45 @@ typedef struct async_loop {
     mtx_t lock; // guards the lists and the dispatching tasks flag
     bool dispatching_tasks; // true while the loop is busy dispatching tasks
     list_node_t wait_list; // most recently added first
-    list_node_t task_list; // pending tasks, earliest deadline first
+    list_node_t batch_list; // packet batches being dispatched
+    task_entry_t* task_heap; // pending tasks, a binary min-heap by deadline
+    size_t task_count; // number of tasks in |task_heap|
+    size_t task_capacity; // number of slots allocated in |task_heap|
+    size_t task_reserved; // posted tasks not yet finished, at most |task_capacity|
+    uint64_t task_seq; // sequence number of the next task inserted
     list_node_t due_list; // due tasks, earliest deadline first
     list_node_t thread_list; // earliest created thread first
+    list_node_t queue_list; // run queues of threads which ran the loop in executor mode
+
+    // Executor mode state.
+    run_queue_t shared_queue; // ready tasks posted by other threads
+    atomic_size_t ready_tasks; // total number of tasks on run queues
+    atomic_uint idle_threads; // number of threads about to wait on the port
+    atomic_bool wake_pending; // a wake-up packet for an idle thread is queued
 } async_loop_t;
 
-static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline);
+static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline, bool once);
+static zx_status_t async_loop_dispatch_port_packet(async_loop_t* loop,
+                                                   const zx_port_packet_t* packet);
 static zx_status_t async_loop_dispatch_wait(async_loop_t* loop, async_wait_t* wait,
                                             zx_status_t status, const zx_packet_signal_t* signal);
 static zx_status_t async_loop_dispatch_tasks(async_loop_t* loop);
+static zx_status_t async_loop_dispatch_ready_task(async_loop_t* loop, async_task_t* task);
 static zx_status_t async_loop_dispatch_packet(async_loop_t* loop, async_receiver_t* receiver,
                                               zx_status_t status, const zx_packet_user_t* data);
 static void async_loop_wake_threads(async_loop_t* loop);
 static zx_status_t async_loop_wait_async(async_loop_t* loop, async_wait_t* wait);
+static zx_status_t async_loop_reserve_task_locked(async_loop_t* loop);
 static void async_loop_insert_task_locked(async_loop_t* loop, async_task_t* task);
+static async_task_t* async_loop_pop_task_locked(async_loop_t* loop);
+static void async_loop_remove_task_locked(async_loop_t* loop, size_t index);
+static run_queue_t* async_loop_acquire_queue(async_loop_t* loop);
+static void async_loop_release_queue(async_loop_t* loop, run_queue_t* queue);
+static void async_loop_push_ready_task(async_loop_t* loop, async_task_t* task);
+static bool async_loop_cancel_ready_task(async_loop_t* loop, async_task_t* task,
+                                         uintptr_t slot);
+static async_task_t* async_loop_take_ready_task(async_loop_t* loop, run_queue_t* queue);
+static void async_loop_wake_idle_thread(async_loop_t* loop);
 static void async_loop_restart_timer_locked(async_loop_t* loop);
 static void async_loop_invoke_prologue(async_loop_t* loop);
 static void async_loop_invoke_epilogue(async_loop_t* loop);
@@ -96,6 +170,49 @@ static inline async_task_t* node_to_task(list_node_t* node) {
     return FROM_NODE(async_task_t, node);
 }
 
+// A task's state records where it is queued:
+// - While it is pending in the task heap, |link| is TASK_IN_HEAP and |slot|
+//   holds its heap index shifted left by one.
+// - While it is due, the same storage links it into |due_list|.
+// - While it is ready in executor mode, |link| points to the next task on its
+//   run queue and |slot| is the run queue's address tagged with
+//   TASK_IN_RUN_QUEUE.  |slot| is accessed atomically in this case because
+//   cancelation reads it before it knows which lock to take.
+// - Otherwise both words are zero.
+// None of these encodings can be mistaken for a pair of list pointers.
+#define TASK_IN_HEAP ((uintptr_t)1u)
+#define TASK_IN_RUN_QUEUE ((uintptr_t)1u)
+
+typedef struct task_state {
+    uintptr_t link;
+    uintptr_t slot;
+} task_state_t;
+
+static_assert(sizeof(task_state_t) <= sizeof(async_state_t),
+              "async_state_t too small");
+
+static inline task_state_t* task_to_state(async_task_t* task) {
+    return (task_state_t*)&task->state;
+}
+
+static inline uintptr_t task_load_slot(async_task_t* task) {
+    return atomic_load_explicit((_Atomic uintptr_t*)&task_to_state(task)->slot,
+                                memory_order_acquire);
+}
+
+static inline void task_store_slot(async_task_t* task, uintptr_t slot) {
+    atomic_store_explicit((_Atomic uintptr_t*)&task_to_state(task)->slot, slot,
+                          memory_order_release);
+}
+
+// The run queue of the current thread while it is running a loop in executor
+// mode, or NULL if none.
+static _Thread_local run_queue_t* current_queue;
+
+static inline run_queue_t* async_loop_current_queue(async_loop_t* loop) {
+    return current_queue && current_queue->loop == loop ? current_queue : NULL;
+}
+
 zx_status_t async_loop_create(const async_loop_config_t* config, async_t** out_async) {
     ZX_DEBUG_ASSERT(out_async);
 
@@ -110,9 +227,16 @@ zx_status_t async_loop_create(const async_loop_config_t* config, async_t** out_a
         loop->config = *config;
     mtx_init(&loop->lock, mtx_plain);
     list_initialize(&loop->wait_list);
-    list_initialize(&loop->task_list);
+    list_initialize(&loop->batch_list);
     list_initialize(&loop->due_list);
     list_initialize(&loop->thread_list);
+    list_initialize(&loop->queue_list);
+    loop->shared_queue.loop = loop;
+    mtx_init(&loop->shared_queue.lock, mtx_plain);
+    atomic_init(&loop->shared_queue.count, 0u);
+    atomic_init(&loop->ready_tasks, 0u);
+    atomic_init(&loop->idle_threads, 0u);
+    atomic_init(&loop->wake_pending, false);
 
     zx_status_t status = zx_port_create(0u, &loop->port);
     if (status == ZX_OK)
@@ -143,7 +267,15 @@ void async_loop_destroy(async_t* async) {
 
     zx_handle_close(loop->port);
     zx_handle_close(loop->timer);
+    list_node_t* node;
+    while ((node = list_remove_head(&loop->queue_list))) {
+        run_queue_t* queue = containerof(node, run_queue_t, node);
+        mtx_destroy(&queue->lock);
+        free(queue);
+    }
+    mtx_destroy(&loop->shared_queue.lock);
     mtx_destroy(&loop->lock);
+    free(loop->task_heap);
     free(loop);
 }
 
@@ -176,8 +308,18 @@ void async_loop_shutdown(async_t* async) {
             async_loop_invoke_epilogue(loop);
         }
     }
-    while ((node = list_remove_head(&loop->task_list))) {
-        async_task_t* task = node_to_task(node);
+    while (loop->task_count) {
+        async_task_t* task = async_loop_pop_task_locked(loop);
+        if (task->flags & ASYNC_FLAG_HANDLE_SHUTDOWN) {
+            async_loop_invoke_prologue(loop);
+            async_loop_invoke_task_handler(loop, task, ZX_ERR_CANCELED);
+            async_loop_invoke_epilogue(loop);
+        }
+    }
+    // No thread is running the loop anymore, so every ready task has been
+    // moved to the shared queue.
+    async_task_t* task;
+    while ((task = async_loop_take_ready_task(loop, NULL))) {
         if (task->flags & ASYNC_FLAG_HANDLE_SHUTDOWN) {
             async_loop_invoke_prologue(loop);
             async_loop_invoke_task_handler(loop, task, ZX_ERR_CANCELED);
@@ -195,12 +337,27 @@ zx_status_t async_loop_run(async_t* async, zx_time_t deadline, bool once) {
     async_loop_t* loop = (async_loop_t*)async;
     ZX_DEBUG_ASSERT(loop);
 
+    // In executor mode, give this thread a run queue for the tasks it posts.
+    // If none can be allocated it still runs tasks from the other queues.
+    run_queue_t* prior_queue = current_queue;
+    run_queue_t* queue = NULL;
+    if (loop->config.executor) {
+        queue = async_loop_acquire_queue(loop);
+        if (queue)
+            current_queue = queue;
+    }
+
     zx_status_t status;
     atomic_fetch_add_explicit(&loop->active_threads, 1u, memory_order_acq_rel);
     do {
-        status = async_loop_run_once(loop, deadline);
+        status = async_loop_run_once(loop, deadline, once);
     } while (status == ZX_OK && !once);
     atomic_fetch_sub_explicit(&loop->active_threads, 1u, memory_order_acq_rel);
+
+    if (queue) {
+        current_queue = prior_queue;
+        async_loop_release_queue(loop, queue);
+    }
     return status;
 }
 
@@ -212,39 +369,125 @@ zx_status_t async_loop_run_until_idle(async_t* async) {
     return status;
 }
 
-static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline) {
+static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline, bool once) {
     async_loop_state_t state = atomic_load_explicit(&loop->state, memory_order_acquire);
     if (state == ASYNC_LOOP_SHUTDOWN)
         return ZX_ERR_BAD_STATE;
     if (state != ASYNC_LOOP_RUNNABLE)
         return ZX_ERR_CANCELED;
 
-    zx_port_packet_t packet;
-    zx_status_t status = zx_port_wait(loop->port, deadline, &packet, 0);
+    // In executor mode, run ready tasks ahead of port packets, but check the
+    // port after a streak of them.  A thread with nothing to run counts itself
+    // as idle before looking one last time, so that a thread posting a task
+    // either sees it is idle and wakes it, or posted early enough to be seen.
+    zx_time_t wait_deadline = deadline;
+    bool idle = false;
+    if (loop->config.executor) {
+        run_queue_t* queue = async_loop_current_queue(loop);
+        if (!queue || queue->streak < MAX_READY_STREAK) {
+            async_task_t* task = async_loop_take_ready_task(loop, queue);
+            if (task) {
+                if (queue)
+                    queue->streak++;
+                return async_loop_dispatch_ready_task(loop, task);
+            }
+        }
+        if (queue)
+            queue->streak = 0u;
+
+        if (atomic_load(&loop->ready_tasks)) {
+            wait_deadline = 0;
+        } else {
+            atomic_fetch_add(&loop->idle_threads, 1u);
+            if (atomic_load(&loop->ready_tasks)) {
+                atomic_fetch_sub(&loop->idle_threads, 1u);
+                return ZX_OK;
+            }
+            idle = true;
+        }
+    }
+
+    // A thread running the loop by itself takes everything that is pending
+    // in one go.  When there are several, each takes one packet at a time so
+    // that they share the work.
+    size_t max_packets = 1u;
+    if (!once && atomic_load_explicit(&loop->active_threads, memory_order_acquire) == 1u)
+        max_packets = MAX_BATCH_PACKETS;
+
+    packet_batch_t batch;
+    zx_status_t status = zx_port_wait_many(loop->port, wait_deadline, batch.packets,
+                                           max_packets, &batch.count);
+    if (loop->config.executor) {
+        if (idle)
+            atomic_fetch_sub(&loop->idle_threads, 1u);
+        atomic_store(&loop->wake_pending, false);
+    }
+    if (status == ZX_ERR_TIMED_OUT && wait_deadline != deadline)
+        return ZX_OK; // only polled the port between ready tasks
     if (status != ZX_OK)
         return status;
 
-    if (packet.key == KEY_CONTROL) {
+    if (batch.count == 1u)
+        return async_loop_dispatch_port_packet(loop, &batch.packets[0]);
+
+    // A handler may cancel a wait whose packet is later in the batch, so the
+    // batch stays on |batch_list| where |async_loop_cancel_wait()| can find
+    // it until every packet has been dispatched.
+    uint32_t wakeups = 0u;
+    batch.next = 0u;
+    mtx_lock(&loop->lock);
+    list_add_tail(&loop->batch_list, &batch.node);
+    while (batch.next < batch.count) {
+        zx_port_packet_t packet = batch.packets[batch.next++];
+        mtx_unlock(&loop->lock);
+
+        if (packet.key == KEY_CONTROL && packet.type == ZX_PKT_TYPE_USER) {
+            wakeups++;
+        } else if (packet.key != KEY_CANCELED) {
+            async_loop_dispatch_port_packet(loop, &packet);
+        }
+
+        mtx_lock(&loop->lock);
+    }
+    list_delete(&batch.node);
+    mtx_unlock(&loop->lock);
+
+    // Each wake-up packet is meant for a different thread, so pass on the
+    // ones this thread does not need.
+    for (; wakeups > 1u; wakeups--) {
+        zx_port_packet_t packet = {
+            .key = KEY_CONTROL,
+            .type = ZX_PKT_TYPE_USER,
+            .status = ZX_OK};
+        status = zx_port_queue(loop->port, &packet, 0u);
+        ZX_DEBUG_ASSERT_MSG(status == ZX_OK, "status=%d", status);
+    }
+    return ZX_OK;
+}
+
+static zx_status_t async_loop_dispatch_port_packet(async_loop_t* loop,
+                                                   const zx_port_packet_t* packet) {
+    if (packet->key == KEY_CONTROL) {
         // Handle wake-up packets.
-        if (packet.type == ZX_PKT_TYPE_USER)
+        if (packet->type == ZX_PKT_TYPE_USER)
             return ZX_OK;
 
         // Handle task timer expirations.
-        if (packet.type == ZX_PKT_TYPE_SIGNAL_REP &&
-            packet.signal.observed & ZX_TIMER_SIGNALED) {
+        if (packet->type == ZX_PKT_TYPE_SIGNAL_REP &&
+            packet->signal.observed & ZX_TIMER_SIGNALED) {
             return async_loop_dispatch_tasks(loop);
         }
     } else {
         // Handle wait completion packets.
-        if (packet.type == ZX_PKT_TYPE_SIGNAL_ONE) {
-            async_wait_t* wait = (void*)(uintptr_t)packet.key;
-            return async_loop_dispatch_wait(loop, wait, packet.status, &packet.signal);
+        if (packet->type == ZX_PKT_TYPE_SIGNAL_ONE) {
+            async_wait_t* wait = (void*)(uintptr_t)packet->key;
+            return async_loop_dispatch_wait(loop, wait, packet->status, &packet->signal);
         }
 
         // Handle queued user packets.
-        if (packet.type == ZX_PKT_TYPE_USER) {
-            async_receiver_t* receiver = (void*)(uintptr_t)packet.key;
-            return async_loop_dispatch_packet(loop, receiver, packet.status, &packet.user);
+        if (packet->type == ZX_PKT_TYPE_USER) {
+            async_receiver_t* receiver = (void*)(uintptr_t)packet->key;
+            return async_loop_dispatch_packet(loop, receiver, packet->status, &packet->user);
         }
     }
 
@@ -299,20 +542,9 @@ static zx_status_t async_loop_dispatch_tasks(async_loop_t* loop) {
         list_node_t* node;
         if (list_is_empty(&loop->due_list)) {
             zx_time_t due_time = zx_time_get(ZX_CLOCK_MONOTONIC);
-            list_node_t* tail = NULL;
-            list_for_every(&loop->task_list, node) {
-                if (node_to_task(node)->deadline > due_time)
-                    break;
-                tail = node;
-            }
-            if (tail) {
-                list_node_t* head = loop->task_list.next;
-                loop->task_list.next = tail->next;
-                tail->next->prev = &loop->task_list;
-                loop->due_list.next = head;
-                head->prev = &loop->due_list;
-                loop->due_list.prev = tail;
-                tail->next = &loop->due_list;
+            while (loop->task_count && loop->task_heap[0].deadline <= due_time) {
+                async_task_t* task = async_loop_pop_task_locked(loop);
+                list_add_tail(&loop->due_list, task_to_node(task));
             }
         }
 
@@ -328,8 +560,12 @@ static zx_status_t async_loop_dispatch_tasks(async_loop_t* loop) {
             async_task_result_t result = async_loop_invoke_task_handler(loop, task, ZX_OK);
 
             mtx_lock(&loop->lock);
-            if (result == ASYNC_TASK_REPEAT)
+            if (result == ASYNC_TASK_REPEAT) {
+                // The task still holds its reservation so this cannot fail.
                 async_loop_insert_task_locked(loop, task);
+            } else {
+                loop->task_reserved--;
+            }
             mtx_unlock(&loop->lock);
 
             async_loop_invoke_epilogue(loop);
@@ -347,6 +583,19 @@ static zx_status_t async_loop_dispatch_tasks(async_loop_t* loop) {
     return ZX_OK;
 }
 
+static zx_status_t async_loop_dispatch_ready_task(async_loop_t* loop, async_task_t* task) {
+    // Invoke the handler.  Note that it might destroy itself.
+    async_loop_invoke_prologue(loop);
+    async_task_result_t result = async_loop_invoke_task_handler(loop, task, ZX_OK);
+    if (result == ASYNC_TASK_REPEAT) {
+        zx_status_t status = async_loop_post_task(&loop->async, task);
+        if (status != ZX_OK)
+            async_loop_invoke_task_handler(loop, task, status);
+    }
+    async_loop_invoke_epilogue(loop);
+    return ZX_OK;
+}
+
 static zx_status_t async_loop_dispatch_packet(async_loop_t* loop, async_receiver_t* receiver,
                                               zx_status_t status, const zx_packet_user_t* data) {
     // Invoke the handler.  Note that it might destroy itself.
@@ -448,6 +697,22 @@ static zx_status_t async_loop_begin_wait(async_t* async, async_wait_t* wait) {
     return status;
 }
 
+static bool async_loop_cancel_batched_wait_locked(async_loop_t* loop, async_wait_t* wait) {
+    // The packet of a wait which has already been dequeued may still be
+    // waiting its turn in some thread's batch.
+    packet_batch_t* batch;
+    list_for_every_entry(&loop->batch_list, batch, packet_batch_t, node) {
+        for (size_t i = batch->next; i < batch->count; i++) {
+            zx_port_packet_t* packet = &batch->packets[i];
+            if (packet->key == (uintptr_t)wait && packet->type == ZX_PKT_TYPE_SIGNAL_ONE) {
+                packet->key = KEY_CANCELED;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
 static zx_status_t async_loop_cancel_wait(async_t* async, async_wait_t* wait) {
     async_loop_t* loop = (async_loop_t*)async;
     ZX_DEBUG_ASSERT(loop);
@@ -458,11 +723,13 @@ static zx_status_t async_loop_cancel_wait(async_t* async, async_wait_t* wait) {
     // invoked again past this point.
     zx_status_t status = zx_port_cancel(loop->port, wait->object,
                                         (uintptr_t)wait);
-    if (status == ZX_OK && (wait->flags & ASYNC_FLAG_HANDLE_SHUTDOWN)) {
-        mtx_lock(&loop->lock);
+
+    mtx_lock(&loop->lock);
+    if (status == ZX_ERR_NOT_FOUND && async_loop_cancel_batched_wait_locked(loop, wait))
+        status = ZX_OK;
+    if (status == ZX_OK && (wait->flags & ASYNC_FLAG_HANDLE_SHUTDOWN))
         list_delete(wait_to_node(wait));
-        mtx_unlock(&loop->lock);
-    }
+    mtx_unlock(&loop->lock);
     return status;
 }
 
@@ -474,11 +741,20 @@ static zx_status_t async_loop_post_task(async_t* async, async_task_t* task) {
     if (atomic_load_explicit(&loop->state, memory_order_acquire) == ASYNC_LOOP_SHUTDOWN)
         return ZX_ERR_BAD_STATE;
 
+    if (loop->config.executor && task->deadline <= zx_time_get(ZX_CLOCK_MONOTONIC)) {
+        async_loop_push_ready_task(loop, task);
+        return ZX_OK;
+    }
+
     mtx_lock(&loop->lock);
 
+    zx_status_t status = async_loop_reserve_task_locked(loop);
+    if (status != ZX_OK) {
+        mtx_unlock(&loop->lock);
+        return status;
+    }
     async_loop_insert_task_locked(loop, task);
-    if (!loop->dispatching_tasks &&
-        task_to_node(task)->prev == &loop->task_list) {
+    if (!loop->dispatching_tasks && task_to_state(task)->slot == 0u) {
         // Task inserted at head.  Earliest deadline changed.
         async_loop_restart_timer_locked(loop);
     }
@@ -496,26 +772,72 @@ static zx_status_t async_loop_cancel_task(async_t* async, async_task_t* task) {
     // destroyed in case the client is counting on the handler not being
     // invoked again past this point.  Also, the task we're removing here
     // might be present in the dispatcher's |due_list| if it is pending
-    // dispatch instead of in the loop's |task_list| as usual.  The same
-    // logic works in both cases.
+    // dispatch instead of in the loop's task heap as usual, or on a run
+    // queue in executor mode.
 
-    mtx_lock(&loop->lock);
-    list_node_t* node = task_to_node(task);
-    if (!list_in_list(node)) {
+    for (;;) {
+        uintptr_t slot = task_load_slot(task);
+        if (slot & TASK_IN_RUN_QUEUE) {
+            if (async_loop_cancel_ready_task(loop, task, slot))
+                return ZX_OK;
+            continue;
+        }
+
+        mtx_lock(&loop->lock);
+        if (task_load_slot(task) & TASK_IN_RUN_QUEUE) {
+            // It was reposted as a ready task in the meantime.
+            mtx_unlock(&loop->lock);
+            continue;
+        }
+        task_state_t* state = task_to_state(task);
+        if (state->link == TASK_IN_HEAP) {
+            size_t index = state->slot >> 1;
+            async_loop_remove_task_locked(loop, index);
+            if (!loop->dispatching_tasks && index == 0u && loop->task_count &&
+                loop->task_heap[0].deadline > task->deadline) {
+                // The head task was canceled and following task has a later deadline.
+                async_loop_restart_timer_locked(loop);
+            }
+        } else {
+            list_node_t* node = task_to_node(task);
+            if (!list_in_list(node)) {
+                mtx_unlock(&loop->lock);
+                return ZX_ERR_NOT_FOUND;
+            }
+            list_delete(node);
+        }
+        loop->task_reserved--;
         mtx_unlock(&loop->lock);
-        return ZX_ERR_NOT_FOUND;
+        return ZX_OK;
     }
+}
 
-    if (!loop->dispatching_tasks &&
-        node->prev == &loop->task_list &&
-        node->next != &loop->task_list &&
-        node_to_task(node->next)->deadline > task->deadline) {
-        // The head task was canceled and following task has a later deadline.
-        async_loop_restart_timer_locked(loop);
+// Removes a ready task from the run queue named by |slot|.  Returns false if
+// it was taken off that queue before we could get hold of the queue's lock.
+static bool async_loop_cancel_ready_task(async_loop_t* loop, async_task_t* task,
+                                         uintptr_t slot) {
+    run_queue_t* queue = (run_queue_t*)(slot & ~TASK_IN_RUN_QUEUE);
+    mtx_lock(&queue->lock);
+    if (task_load_slot(task) != slot) {
+        mtx_unlock(&queue->lock);
+        return false;
     }
-    list_delete(node);
-    mtx_unlock(&loop->lock);
-    return ZX_OK;
+
+    async_task_t** prev = &queue->head;
+    async_task_t* prior = NULL;
+    while (*prev != task) {
+        prior = *prev;
+        prev = (async_task_t**)&task_to_state(prior)->link;
+    }
+    *prev = (async_task_t*)task_to_state(task)->link;
+    if (queue->tail == task)
+        queue->tail = prior;
+    task_to_state(task)->link = 0u;
+    task_store_slot(task, 0u);
+    atomic_fetch_sub(&queue->count, 1u);
+    atomic_fetch_sub(&loop->ready_tasks, 1u);
+    mtx_unlock(&queue->lock);
+    return true;
 }
 
 static zx_status_t async_loop_queue_packet(async_t* async, async_receiver_t* receiver,
@@ -542,27 +864,234 @@ static zx_status_t async_loop_wait_async(async_loop_t* loop, async_wait_t* wait)
                                 ZX_WAIT_ASYNC_ONCE);
 }
 
-static void async_loop_insert_task_locked(async_loop_t* loop, async_task_t* task) {
-    // TODO(ZX-976): We assume that tasks are inserted in quasi-monotonic order and
-    // that insertion into the task queue will typically take no more than a few steps.
-    // If this assumption proves false and the cost of insertion becomes a problem, we
-    // should consider using a more efficient representation for maintaining order.
-    list_node_t* node;
-    for (node = loop->task_list.prev; node != &loop->task_list; node = node->prev) {
-        if (task->deadline >= node_to_task(node)->deadline)
+static inline bool task_entry_before(const task_entry_t* a, const task_entry_t* b) {
+    return a->deadline < b->deadline || (a->deadline == b->deadline && a->seq < b->seq);
+}
+
+static inline void async_loop_set_task_locked(async_loop_t* loop, size_t index,
+                                              const task_entry_t* entry) {
+    loop->task_heap[index] = *entry;
+    task_state_t* state = task_to_state(entry->task);
+    state->link = TASK_IN_HEAP;
+    state->slot = index << 1;
+}
+
+static void async_loop_sift_up_locked(async_loop_t* loop, size_t index) {
+    task_entry_t entry = loop->task_heap[index];
+    while (index > 0u) {
+        size_t parent = (index - 1u) / 2u;
+        if (!task_entry_before(&entry, &loop->task_heap[parent]))
+            break;
+        async_loop_set_task_locked(loop, index, &loop->task_heap[parent]);
+        index = parent;
+    }
+    async_loop_set_task_locked(loop, index, &entry);
+}
+
+static void async_loop_sift_down_locked(async_loop_t* loop, size_t index) {
+    task_entry_t entry = loop->task_heap[index];
+    for (;;) {
+        size_t child = index * 2u + 1u;
+        if (child >= loop->task_count)
+            break;
+        if (child + 1u < loop->task_count &&
+            task_entry_before(&loop->task_heap[child + 1u], &loop->task_heap[child]))
+            child++;
+        if (!task_entry_before(&loop->task_heap[child], &entry))
             break;
+        async_loop_set_task_locked(loop, index, &loop->task_heap[child]);
+        index = child;
+    }
+    async_loop_set_task_locked(loop, index, &entry);
+}
+
+// Makes sure a heap slot will be available for a newly posted task for as
+// long as it is pending, due, or being dispatched, so that re-inserting a
+// repeating task never needs to allocate.
+static zx_status_t async_loop_reserve_task_locked(async_loop_t* loop) {
+    if (loop->task_reserved == loop->task_capacity) {
+        size_t capacity = loop->task_capacity ? loop->task_capacity * 2u : MIN_TASK_CAPACITY;
+        task_entry_t* heap = realloc(loop->task_heap, capacity * sizeof(task_entry_t));
+        if (!heap)
+            return ZX_ERR_NO_MEMORY;
+        loop->task_heap = heap;
+        loop->task_capacity = capacity;
+    }
+    loop->task_reserved++;
+    return ZX_OK;
+}
+
+static void async_loop_insert_task_locked(async_loop_t* loop, async_task_t* task) {
+    ZX_DEBUG_ASSERT(loop->task_count < loop->task_capacity);
+
+    task_entry_t entry = {
+        .deadline = task->deadline,
+        .seq = loop->task_seq++,
+        .task = task};
+    size_t index = loop->task_count++;
+    loop->task_heap[index] = entry;
+    async_loop_sift_up_locked(loop, index);
+}
+
+static void async_loop_remove_task_locked(async_loop_t* loop, size_t index) {
+    ZX_DEBUG_ASSERT(index < loop->task_count);
+
+    async_task_t* task = loop->task_heap[index].task;
+    *task_to_state(task) = (task_state_t){0u, 0u};
+
+    size_t last = --loop->task_count;
+    if (index == last)
+        return;
+    loop->task_heap[index] = loop->task_heap[last];
+    if (index > 0u &&
+        task_entry_before(&loop->task_heap[index], &loop->task_heap[(index - 1u) / 2u])) {
+        async_loop_sift_up_locked(loop, index);
+    } else {
+        async_loop_sift_down_locked(loop, index);
     }
-    list_add_after(node, task_to_node(task));
+}
+
+static async_task_t* async_loop_pop_task_locked(async_loop_t* loop) {
+    async_task_t* task = loop->task_heap[0].task;
+    async_loop_remove_task_locked(loop, 0u);
+    return task;
+}
+
+static run_queue_t* async_loop_acquire_queue(async_loop_t* loop) {
+    run_queue_t* queue;
+    mtx_lock(&loop->lock);
+    list_for_every_entry (&loop->queue_list, queue, run_queue_t, node) {
+        if (!queue->in_use) {
+            queue->in_use = true;
+            mtx_unlock(&loop->lock);
+            return queue;
+        }
+    }
+    queue = calloc(1u, sizeof(run_queue_t));
+    if (queue) {
+        queue->loop = loop;
+        queue->in_use = true;
+        mtx_init(&queue->lock, mtx_plain);
+        atomic_init(&queue->count, 0u);
+        list_add_tail(&loop->queue_list, &queue->node);
+    }
+    mtx_unlock(&loop->lock);
+    return queue;
+}
+
+static void async_loop_release_queue(async_loop_t* loop, run_queue_t* queue) {
+    // Hand any tasks left behind to the shared queue for whoever runs next.
+    run_queue_t* shared = &loop->shared_queue;
+    mtx_lock(&queue->lock);
+    if (queue->head) {
+        mtx_lock(&shared->lock);
+        for (async_task_t* task = queue->head; task;
+             task = (async_task_t*)task_to_state(task)->link) {
+            task_store_slot(task, (uintptr_t)shared | TASK_IN_RUN_QUEUE);
+        }
+        if (shared->tail)
+            task_to_state(shared->tail)->link = (uintptr_t)queue->head;
+        else
+            shared->head = queue->head;
+        shared->tail = queue->tail;
+        atomic_fetch_add(&shared->count, atomic_load(&queue->count));
+        mtx_unlock(&shared->lock);
+        queue->head = queue->tail = NULL;
+        atomic_store(&queue->count, 0u);
+    }
+    mtx_unlock(&queue->lock);
+
+    mtx_lock(&loop->lock);
+    queue->in_use = false;
+    queue->streak = 0u;
+    mtx_unlock(&loop->lock);
+}
+
+static void async_loop_push_ready_task(async_loop_t* loop, async_task_t* task) {
+    // Tasks posted from a loop thread stay on that thread unless another
+    // steals them.
+    run_queue_t* queue = async_loop_current_queue(loop);
+    if (!queue)
+        queue = &loop->shared_queue;
+
+    mtx_lock(&queue->lock);
+    task_to_state(task)->link = 0u;
+    task_store_slot(task, (uintptr_t)queue | TASK_IN_RUN_QUEUE);
+    if (queue->tail)
+        task_to_state(queue->tail)->link = (uintptr_t)task;
+    else
+        queue->head = task;
+    queue->tail = task;
+    atomic_fetch_add(&queue->count, 1u);
+    mtx_unlock(&queue->lock);
+
+    atomic_fetch_add(&loop->ready_tasks, 1u);
+    async_loop_wake_idle_thread(loop);
+}
+
+static async_task_t* async_loop_pop_ready_task(async_loop_t* loop, run_queue_t* queue) {
+    if (!atomic_load_explicit(&queue->count, memory_order_relaxed))
+        return NULL;
+
+    mtx_lock(&queue->lock);
+    async_task_t* task = queue->head;
+    if (task) {
+        queue->head = (async_task_t*)task_to_state(task)->link;
+        if (!queue->head)
+            queue->tail = NULL;
+        task_to_state(task)->link = 0u;
+        task_store_slot(task, 0u);
+        atomic_fetch_sub(&queue->count, 1u);
+        atomic_fetch_sub(&loop->ready_tasks, 1u);
+    }
+    mtx_unlock(&queue->lock);
+    return task;
+}
+
+static async_task_t* async_loop_take_ready_task(async_loop_t* loop, run_queue_t* queue) {
+    // Prefer the thread's own tasks, then those posted from elsewhere, then
+    // steal from another loop thread.
+    async_task_t* task = NULL;
+    if (queue)
+        task = async_loop_pop_ready_task(loop, queue);
+    if (!task)
+        task = async_loop_pop_ready_task(loop, &loop->shared_queue);
+    if (!task && atomic_load(&loop->ready_tasks)) {
+        run_queue_t* victim;
+        mtx_lock(&loop->lock);
+        list_for_every_entry (&loop->queue_list, victim, run_queue_t, node) {
+            if (victim != queue && (task = async_loop_pop_ready_task(loop, victim)))
+                break;
+        }
+        mtx_unlock(&loop->lock);
+    }
+
+    // Pass the remaining work on to another idle thread, if any.
+    if (task && atomic_load(&loop->ready_tasks))
+        async_loop_wake_idle_thread(loop);
+    return task;
+}
+
+static void async_loop_wake_idle_thread(async_loop_t* loop) {
+    // Threads which are busy will find ready tasks before they next wait on
+    // the port, so only wake one which is idle, and only one at a time.
+    if (!atomic_load(&loop->idle_threads) || atomic_exchange(&loop->wake_pending, true))
+        return;
+
+    zx_port_packet_t packet = {
+        .key = KEY_CONTROL,
+        .type = ZX_PKT_TYPE_USER,
+        .status = ZX_OK};
+    zx_status_t status = zx_port_queue(loop->port, &packet, 0u);
+    ZX_DEBUG_ASSERT_MSG(status == ZX_OK, "status=%d", status);
 }
 
 static void async_loop_restart_timer_locked(async_loop_t* loop) {
     zx_time_t deadline;
     if (list_is_empty(&loop->due_list)) {
-        list_node_t* head = list_peek_head(&loop->task_list);
-        if (!head)
+        if (!loop->task_count)
             return;
-        async_task_t* task = node_to_task(head);
-        deadline = task->deadline;
+        deadline = loop->task_heap[0].deadline;
         if (deadline == ZX_TIME_INFINITE)
             return;
     } else {
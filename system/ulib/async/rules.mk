@@ -16,6 +16,7 @@ MODULE_TYPE := userlib
 MODULE_SRCS = \
     $(LOCAL_DIR)/auto_task.cpp \
     $(LOCAL_DIR)/auto_wait.cpp \
+    $(LOCAL_DIR)/channel_reader.cpp \
     $(LOCAL_DIR)/receiver.cpp \
     $(LOCAL_DIR)/task.cpp \
     $(LOCAL_DIR)/wait.cpp \
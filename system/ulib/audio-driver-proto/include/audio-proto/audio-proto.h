@@ -56,6 +56,10 @@ using RingBufStartResp = audio_rb_cmd_start_resp_t;
 using RingBufStopReq  = audio_rb_cmd_stop_req_t;
 using RingBufStopResp = audio_rb_cmd_stop_resp_t;
 
+// AUDIO_RB_CMD_GET_POSITION_BUFFER
+using RingBufGetPositionBufferReq  = audio_rb_cmd_get_position_buffer_req_t;
+using RingBufGetPositionBufferResp = audio_rb_cmd_get_position_buffer_resp_t;
+
 // AUDIO_RB_POSITION_NOTIFY
 using RingBufPositionNotify = audio_rb_position_notify_t;
 
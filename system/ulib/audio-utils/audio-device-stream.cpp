@@ -554,6 +554,52 @@ zx_status_t AudioDeviceStream::GetBuffer(uint32_t frames, uint32_t irqs_per_ring
     return ZX_OK;
 }
 
+zx_status_t AudioDeviceStream::MapPositionBuffer() {
+    if (!rb_ch_.is_valid() || pos_vmo_.is_valid())
+        return ZX_ERR_BAD_STATE;
+
+    audio_rb_cmd_get_position_buffer_req_t  req;
+    audio_rb_cmd_get_position_buffer_resp_t resp;
+
+    req.hdr.cmd = AUDIO_RB_CMD_GET_POSITION_BUFFER;
+    req.hdr.transaction_id = 1;
+
+    zx::handle tmp;
+    zx_status_t res = DoCall(rb_ch_, req, &resp, &tmp);
+    if ((res == ZX_OK) && (resp.result != ZX_OK))
+        res = resp.result;
+
+    if (res != ZX_OK)
+        return res;
+
+    pos_vmo_.reset(tmp.release());
+
+    uint64_t pos_vmo_sz;
+    res = pos_vmo_.get_size(&pos_vmo_sz);
+    if (res != ZX_OK) {
+        printf("Failed to fetch position buffer VMO size (res %d)\n", res);
+        return res;
+    }
+
+    if ((resp.offset % sizeof(uint32_t)) ||
+        (static_cast<uint64_t>(resp.offset) + sizeof(uint32_t) > pos_vmo_sz)) {
+        printf("Bad position buffer offset returned by audio driver! "
+               "(offset = %u size = %lu)\n", resp.offset, pos_vmo_sz);
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    res = zx::vmar::root_self().map(0u, pos_vmo_,
+                                    0u, pos_vmo_sz,
+                                    ZX_VM_FLAG_PERM_READ, &pos_map_);
+    if (res != ZX_OK) {
+        printf("Failed to map position buffer VMO (res %d)\n", res);
+        return res;
+    }
+
+    pos_virt_ = reinterpret_cast<const volatile uint32_t*>(pos_map_ + resp.offset);
+    return ZX_OK;
+}
+
 zx_status_t AudioDeviceStream::StartRingBuffer() {
     if (rb_ch_ == ZX_HANDLE_INVALID)
         return ZX_ERR_BAD_STATE;
@@ -568,6 +614,8 @@ zx_status_t AudioDeviceStream::StartRingBuffer() {
 
     if (res == ZX_OK) {
         start_time_ = resp.start_time;
+        xrun_count_ = 0;
+        xrun_check_time_ = 0;
     }
 
     return res;
@@ -588,15 +636,36 @@ zx_status_t AudioDeviceStream::StopRingBuffer() {
     return DoCall(rb_ch_, req, &resp);
 }
 
+void AudioDeviceStream::UpdateXrunCount(uint32_t headroom) {
+    zx_time_t now = zx_time_get(ZX_CLOCK_MONOTONIC);
+
+    if (xrun_check_time_ != 0) {
+        uint64_t moved = (((now - xrun_check_time_) * frame_rate_) / ZX_SEC(1)) * frame_sz_;
+        if (moved > xrun_headroom_)
+            ++xrun_count_;
+    }
+
+    xrun_check_time_ = now;
+    xrun_headroom_   = headroom;
+}
+
 void AudioDeviceStream::ResetRingBuffer() {
     if (rb_virt_ != nullptr) {
         ZX_DEBUG_ASSERT(rb_sz_ != 0);
         zx::vmar::root_self().unmap(reinterpret_cast<uintptr_t>(rb_virt_), rb_sz_);
     }
+    if (pos_map_ != 0) {
+        uint64_t pos_vmo_sz;
+        if (pos_vmo_.get_size(&pos_vmo_sz) == ZX_OK)
+            zx::vmar::root_self().unmap(pos_map_, pos_vmo_sz);
+    }
     rb_ch_.reset();
     rb_vmo_.reset();
+    pos_vmo_.reset();
     rb_sz_ = 0;
     rb_virt_ = nullptr;
+    pos_map_ = 0;
+    pos_virt_ = nullptr;
 }
 
 void AudioDeviceStream::Close() {
@@ -74,8 +74,12 @@ zx_status_t AudioInput::Record(AudioSink& sink, float duration_seconds) {
         return res;
     }
 
+    // Once serviced, the ring is empty, and the driver may fill all but its
+    // fifo before we overrun.
+    uint32_t  headroom = (rb_sz_ > fifo_depth_) ? rb_sz_ - fifo_depth_ : 0;
     uint32_t  rd_ptr = 0;
     bool      peer_connected = true;
+    UpdateXrunCount(headroom);
     while (true) {
         zx_signals_t sigs;
 
@@ -168,12 +172,18 @@ zx_status_t AudioInput::Record(AudioSink& sink, float duration_seconds) {
                 rd_ptr = 0;
             }
         }
+
+        UpdateXrunCount(headroom);
     }
 
     if (peer_connected) {
         StopRingBuffer();
     }
 
+    if (xrun_count_)
+        printf("%u overrun%s detected during capture\n",
+               xrun_count_, xrun_count_ == 1 ? "" : "s");
+
     zx_status_t finalize_res = sink.Finalize();
     return (res == ZX_OK) ? finalize_res : res;
 }
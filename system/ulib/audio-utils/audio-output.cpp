@@ -129,6 +129,11 @@ zx_status_t AudioOutput::Play(AudioSource& source) {
             started = true;
         }
 
+        // Everything we have written which the driver has not yet pulled into
+        // its fifo can play out before we underrun.
+        uint32_t queued = (rb_sz_ + wr - rd) % rb_sz_;
+        UpdateXrunCount(queued > fifo_depth_ ? queued - fifo_depth_ : 0);
+
         res = rb_ch_.wait_one(ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED,
                               ZX_TIME_INFINITE, &sigs);
 
@@ -193,6 +198,10 @@ zx_status_t AudioOutput::Play(AudioSource& source) {
     if (res == ZX_OK)
         res = stop_res;
 
+    if (xrun_count_)
+        printf("%u underrun%s detected during playback\n",
+               xrun_count_, xrun_count_ == 1 ? "" : "s");
+
     return res;
 }
 
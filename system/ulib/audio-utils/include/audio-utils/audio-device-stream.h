@@ -26,6 +26,7 @@ public:
                           uint16_t channels,
                           audio_sample_format_t sample_format);
     zx_status_t GetBuffer(uint32_t frames, uint32_t irqs_per_ring);
+    zx_status_t MapPositionBuffer();
     zx_status_t StartRingBuffer();
     zx_status_t StopRingBuffer();
     void        ResetRingBuffer();
@@ -49,6 +50,15 @@ public:
     void*       ring_buffer()          const { return rb_virt_; }
     uint64_t    start_time()           const { return start_time_; }
     uint64_t    external_delay_nsec()  const { return external_delay_nsec_; }
+    bool        has_position_buffer()  const { return pos_virt_ != nullptr; }
+
+    // Reads the current ring buffer position from the driver's shared DMA
+    // position buffer.  Only valid after a successful MapPositionBuffer.
+    uint32_t    ring_buffer_position() const { return *pos_virt_; }
+
+    // The number of times the ring buffer was not serviced in time since it
+    // was last started; underruns for outputs, and overruns for inputs.
+    uint32_t    xrun_count()           const { return xrun_count_; }
 
 protected:
     friend class fbl::unique_ptr<AudioDeviceStream>;
@@ -58,6 +68,12 @@ protected:
                              bool enable_notify) const;
     void        DisablePlugNotifications();
 
+    // Called each time the ring buffer is serviced while running, with the
+    // number of bytes the driver can now move before it needs servicing
+    // again.  Counts an xrun if, going by the clock, the driver has moved more
+    // than the previous call allowed for.
+    void        UpdateXrunCount(uint32_t headroom);
+
     AudioDeviceStream(bool input, uint32_t dev_id);
     AudioDeviceStream(bool input, const char* dev_path);
     virtual ~AudioDeviceStream();
@@ -65,6 +81,7 @@ protected:
     zx::channel stream_ch_;
     zx::channel rb_ch_;
     zx::vmo     rb_vmo_;
+    zx::vmo     pos_vmo_;
 
     const bool  input_;
     char        name_[64] = { 0 };
@@ -79,6 +96,11 @@ protected:
     uint32_t fifo_depth_           = 0;
     uint32_t rb_sz_                = 0;
     void*    rb_virt_              = nullptr;
+    uintptr_t pos_map_             = 0;
+    const volatile uint32_t* pos_virt_ = nullptr;
+    uint32_t  xrun_count_          = 0;
+    uint32_t  xrun_headroom_       = 0;
+    zx_time_t xrun_check_time_     = 0;
 };
 
 }  // namespace utils
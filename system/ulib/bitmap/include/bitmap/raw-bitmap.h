@@ -14,6 +14,7 @@
 #include <zircon/assert.h>
 #include <zircon/types.h>
 #include <fbl/algorithm.h>
+#include <fbl/array.h>
 #include <fbl/macros.h>
 #include <fbl/type_support.h>
 
@@ -72,11 +73,44 @@ public:
     // Clear all bits in the bitmap.
     void ClearAll() override;
 
+    // Enables a summary of which words of the bitmap have all of their bits
+    // set, kept as a hierarchy of bitmaps with one bit per word of the level
+    // below.  Scans for unset bits, and so Find for runs of unset bits, then
+    // skip over full regions in time logarithmic in their size instead of
+    // reading every word.  Set, Clear, Grow and Reset keep the summary up to
+    // date.
+    //
+    // The summary is built from the current contents of the bitmap.  Callers
+    // which modify the bitmap through its storage directly must call
+    // RebuildSummary afterwards.
+    zx_status_t EnableSummary();
+
+    // Recomputes the summary, if enabled, from the contents of the bitmap.
+    void RebuildSummary();
+
 protected:
+    // Resizes the summary, if enabled, to cover the current size of the
+    // bitmap and rebuilds it.  If this fails the summary is disabled.
+    zx_status_t ResizeSummary();
+
     // The size of this bitmap, in bits.
     size_t size_ = 0;
     // Owned by bits_, cached
     size_t* data_ = nullptr;
+
+private:
+    // Returns the index of the first word at or after |idx| which may have
+    // unset bits, or a value past the last word if there is none.
+    size_t NextNonFullWord(size_t idx) const;
+
+    // Updates the summary after data_[idx] has changed.
+    void UpdateSummary(size_t idx);
+
+    bool summary_enabled_ = false;
+    // The number of words of data_ covered by the summary.
+    size_t summary_words_ = 0;
+    // The levels of the summary, lowest first.
+    fbl::Array<size_t> summary_;
 };
 
 // A simple bitmap backed by generic storage.
@@ -125,7 +159,7 @@ public:
 
         // Clear the partial bits not included in the new "size_t"s.
         Clear(old_size, fbl::min(old_len * kBits, size_));
-        return ZX_OK;
+        return ResizeSummary();
     }
 
     template <typename U = Storage>
@@ -140,7 +174,7 @@ public:
         size_ = size;
         if (size_ == 0) {
             data_ = nullptr;
-            return ZX_OK;
+            return ResizeSummary();
         }
         size_t last_idx = LastIdx(size);
         zx_status_t status = bits_.Allocate(sizeof(size_t) * (last_idx + 1));
@@ -149,7 +183,7 @@ public:
         }
         data_ = static_cast<size_t*>(bits_.GetData());
         ClearAll();
-        return ZX_OK;
+        return ResizeSummary();
     }
 
     // This function allows access to underlying data, but is dangerous: It
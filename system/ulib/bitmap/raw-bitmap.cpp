@@ -10,6 +10,7 @@
 
 #include <zircon/types.h>
 #include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
 #include <fbl/macros.h>
 
 namespace {
@@ -57,6 +58,44 @@ size_t CountZeros(size_t idx, size_t value) {
 }
 #undef CTZ
 
+// Returns the index of the lowest set bit of a nonzero value.
+size_t LowestSetBit(size_t value) {
+    return CountZeros(0, value);
+}
+
+// Summary levels shrink by a factor of kBits, so this covers any bitmap which
+// fits in memory.
+constexpr size_t kMaxSummaryLevels = 11;
+
+// Where a summary level lives in the summary array, and how many of its bits
+// are in use.  Bits past |entries| are always zero.
+struct SummaryLevel {
+    size_t offset;
+    size_t entries;
+};
+
+// Lays out the summary for a bitmap of |words| words: level 0 has a bit per
+// word of the bitmap, each level above has a bit per word of the level below,
+// and the topmost level fits in a single word.  Returns the number of levels
+// and the total number of words they need.
+size_t GetSummaryLevels(size_t words, SummaryLevel* levels, size_t* total_words) {
+    size_t count = 0;
+    size_t offset = 0;
+    size_t entries = words;
+    while (entries > 0) {
+        ZX_ASSERT(count < kMaxSummaryLevels);
+        size_t level_words = (entries + bitmap::kBits - 1) / bitmap::kBits;
+        levels[count++] = SummaryLevel{offset, entries};
+        offset += level_words;
+        if (level_words == 1) {
+            break;
+        }
+        entries = level_words;
+    }
+    *total_words = offset;
+    return count;
+}
+
 } // namespace
 
 namespace bitmap {
@@ -92,8 +131,12 @@ size_t RawBitmapBase::Scan(size_t bitoff, size_t bitmax, bool is_set) const {
         if (value != 0) {
             break;
         }
+        if (is_set && summary_enabled_) {
+            // Skip over the following words which are entirely set.
+            i = NextNonFullWord(i + 1) - 1;
+        }
     }
-    return fbl::min(bitmax, CountZeros(i, value));
+    return fbl::min(bitmax, CountZeros(fbl::min(i, last_idx + 1), value));
 }
 
 zx_status_t RawBitmapBase::Find(bool is_set, size_t bitoff, size_t bitmax,
@@ -135,6 +178,9 @@ zx_status_t RawBitmapBase::Set(size_t bitoff, size_t bitmax) {
     for (size_t i = first_idx; i <= last_idx; ++i) {
         data_[i] |=
                 GetMask(i == first_idx, i == last_idx, bitoff, bitmax);
+        if (summary_enabled_) {
+            UpdateSummary(i);
+        }
     }
     return ZX_OK;
 }
@@ -151,11 +197,17 @@ zx_status_t RawBitmapBase::Clear(size_t bitoff, size_t bitmax) {
     for (size_t i = first_idx; i <= last_idx; ++i) {
         data_[i] &=
                 ~(GetMask(i == first_idx, i == last_idx, bitoff, bitmax));
+        if (summary_enabled_) {
+            UpdateSummary(i);
+        }
     }
     return ZX_OK;
 }
 
 void RawBitmapBase::ClearAll() {
+    for (size_t i = 0; i < summary_.size(); ++i) {
+        summary_[i] = 0;
+    }
     if (size_ == 0) {
         return;
     }
@@ -165,4 +217,114 @@ void RawBitmapBase::ClearAll() {
     }
 }
 
+zx_status_t RawBitmapBase::EnableSummary() {
+    summary_enabled_ = true;
+    return ResizeSummary();
+}
+
+zx_status_t RawBitmapBase::ResizeSummary() {
+    if (!summary_enabled_) {
+        return ZX_OK;
+    }
+    size_t words = size_ == 0 ? 0 : LastIdx(size_) + 1;
+    SummaryLevel levels[kMaxSummaryLevels];
+    size_t total_words;
+    GetSummaryLevels(words, levels, &total_words);
+    if (total_words != summary_.size()) {
+        fbl::AllocChecker ac;
+        size_t* summary = new (&ac) size_t[total_words];
+        if (!ac.check()) {
+            summary_enabled_ = false;
+            summary_words_ = 0;
+            summary_.reset();
+            return ZX_ERR_NO_MEMORY;
+        }
+        summary_.reset(summary, total_words);
+    }
+    summary_words_ = words;
+    RebuildSummary();
+    return ZX_OK;
+}
+
+void RawBitmapBase::RebuildSummary() {
+    if (!summary_enabled_) {
+        return;
+    }
+    for (size_t i = 0; i < summary_.size(); ++i) {
+        summary_[i] = 0;
+    }
+    SummaryLevel levels[kMaxSummaryLevels];
+    size_t total_words;
+    size_t count = GetSummaryLevels(summary_words_, levels, &total_words);
+    const size_t* below = data_;
+    for (size_t level = 0; level < count; ++level) {
+        size_t* summary = &summary_[levels[level].offset];
+        for (size_t i = 0; i < levels[level].entries; ++i) {
+            if (below[i] == ~size_t(0)) {
+                summary[i / kBits] |= size_t(1) << (i % kBits);
+            }
+        }
+        below = summary;
+    }
+}
+
+void RawBitmapBase::UpdateSummary(size_t idx) {
+    SummaryLevel levels[kMaxSummaryLevels];
+    size_t total_words;
+    size_t count = GetSummaryLevels(summary_words_, levels, &total_words);
+    bool full = data_[idx] == ~size_t(0);
+    for (size_t level = 0; level < count; ++level) {
+        size_t* word = &summary_[levels[level].offset + idx / kBits];
+        size_t bit = size_t(1) << (idx % kBits);
+        size_t old_value = *word;
+        *word = full ? (old_value | bit) : (old_value & ~bit);
+        // The level above only changes if this word became, or stopped
+        // being, entirely set.
+        bool was_full = old_value == ~size_t(0);
+        full = *word == ~size_t(0);
+        if (was_full == full) {
+            return;
+        }
+        idx /= kBits;
+    }
+}
+
+size_t RawBitmapBase::NextNonFullWord(size_t idx) const {
+    SummaryLevel levels[kMaxSummaryLevels];
+    size_t total_words;
+    size_t count = GetSummaryLevels(summary_words_, levels, &total_words);
+    const size_t end = summary_words_;
+
+    // Climb until a level has an entry which is not full at or after the
+    // position corresponding to |idx|.
+    size_t level = 0;
+    for (;;) {
+        if (level == count || idx >= levels[level].entries) {
+            return end;
+        }
+        size_t value = ~summary_[levels[level].offset + idx / kBits] &
+                       GetMask(true, false, idx, 0);
+        if (value != 0) {
+            idx = (idx / kBits) * kBits + LowestSetBit(value);
+            break;
+        }
+        idx = idx / kBits + 1;
+        ++level;
+    }
+
+    // Descend to the first word which is not full beneath that entry.  Only
+    // the last word of a level has unused bits, so running into them means
+    // there is nothing further.
+    for (;;) {
+        if (idx >= levels[level].entries) {
+            return end;
+        }
+        if (level == 0) {
+            return idx;
+        }
+        --level;
+        idx = idx * kBits + LowestSetBit(~summary_[levels[level].offset + idx]);
+    }
+}
+
 } // namespace bitmap
@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -24,6 +25,7 @@
 #define MXDEBUG 0
 
 #include <blobstore/blobstore.h>
+#include <blobstore/compression.h>
 
 using digest::Digest;
 using digest::MerkleTree;
@@ -118,10 +120,6 @@ zx_status_t VnodeBlob::Verify() const {
     ZX_DEBUG_ASSERT(blob_ != nullptr);
 
     const blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
-    // TODO(smklein): We could lazily verify more of the VMO if
-    // we could fault in pages on-demand.
-    //
-    // For now, we aggressively verify the entire VMO up front.
     Digest d;
     d = reinterpret_cast<const uint8_t*>(&digest_[0]);
     return MerkleTree::Verify(GetData(), inode->blob_size, GetMerkle(),
@@ -151,14 +149,179 @@ zx_status_t VnodeBlob::InitVmos() {
         return status;
     }
 
+    if ((status = verified_.Reset(BlobDataBlocks(*inode))) != ZX_OK) {
+        BlobCloseHandles();
+        return status;
+    }
+
+    // Only the Merkle tree is read up front; it is checked against the root
+    // digest piece by piece, along with the data it covers.
+    if (MerkleTreeBlocks(*inode) > 0) {
+        ReadTxn txn(blobstore_.get());
+        txn.Enqueue(vmoid_, 0, inode->start_block + DataStartBlock(blobstore_->info_),
+                    MerkleTreeBlocks(*inode));
+        if ((status = txn.Flush()) != ZX_OK) {
+            BlobCloseHandles();
+            return status;
+        }
+    }
+
+    if (IsCompressed() && (status = ReadSeekTable()) != ZX_OK) {
+        FS_TRACE_ERROR("blobstore: Failed to read seek table: %d\n", status);
+        BlobCloseHandles();
+        return status;
+    }
+    return ZX_OK;
+}
+
+bool VnodeBlob::IsCompressed() const {
+    return blobstore_->GetNode(map_index_)->flags & kBlobstoreInodeFlagLZ4;
+}
+
+zx_status_t VnodeBlob::ReadSeekTable() {
+    TRACE_DURATION("blobstore", "Blobstore::ReadSeekTable");
+    const blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
+    const uint64_t merkle_blocks = MerkleTreeBlocks(*inode);
+    const uint64_t table_size = BlobSeekTableSize(*inode);
+    if (inode->num_blocks <= merkle_blocks ||
+        table_size >= (inode->num_blocks - merkle_blocks) * kBlobstoreBlockSize) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    const size_t stored_size = (inode->num_blocks - merkle_blocks) * kBlobstoreBlockSize;
+
+    zx_status_t status;
+    fbl::unique_ptr<MappedVmo> compressed;
+    vmoid_t vmoid;
+    if ((status = MappedVmo::Create(stored_size, "blob-compressed", &compressed)) != ZX_OK) {
+        return status;
+    } else if ((status = blobstore_->AttachVmo(compressed->GetVmo(), &vmoid)) != ZX_OK) {
+        return status;
+    }
+    compressed_ = fbl::move(compressed);
+    compressed_vmoid_ = vmoid;
+
     ReadTxn txn(blobstore_.get());
-    txn.Enqueue(vmoid_, 0, inode->start_block + DataStartBlock(blobstore_->info_),
-                BlobDataBlocks(*inode) + MerkleTreeBlocks(*inode));
+    txn.Enqueue(compressed_vmoid_, 0,
+                inode->start_block + DataStartBlock(blobstore_->info_) + merkle_blocks,
+                fbl::round_up(table_size, kBlobstoreBlockSize) / kBlobstoreBlockSize);
     if ((status = txn.Flush()) != ZX_OK) {
         return status;
     }
 
-    return Verify();
+    const size_t chunks = BlobChunkCount(*inode);
+    fbl::AllocChecker ac;
+    fbl::Array<uint32_t> seek_table(new (&ac) uint32_t[chunks], chunks);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    memcpy(seek_table.get(), compressed_->GetData(), table_size);
+    if ((status = CheckSeekTable(*inode, seek_table.get(), stored_size)) != ZX_OK) {
+        return status;
+    }
+    seek_table_ = fbl::move(seek_table);
+    return ZX_OK;
+}
+
+zx_status_t VnodeBlob::ReadCompressed(uint64_t block, uint64_t end_block) {
+    TRACE_DURATION("blobstore", "Blobstore::ReadCompressed", "block", block,
+                   "end_block", end_block);
+    ZX_DEBUG_ASSERT(block % kVerifyChunkBlocks == 0);
+    const blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
+    const uint64_t merkle_blocks = MerkleTreeBlocks(*inode);
+    const size_t stored_size = (inode->num_blocks - merkle_blocks) * kBlobstoreBlockSize;
+    const uint64_t chunk = block / kVerifyChunkBlocks;
+    const uint64_t end_chunk = fbl::round_up(end_block, kVerifyChunkBlocks) / kVerifyChunkBlocks;
+
+    // Read in the blocks which hold the compressed chunks, at the same offset
+    // in compressed_ as they have on disk.
+    const uint64_t start = (chunk == 0) ? BlobSeekTableSize(*inode) : seek_table_[chunk - 1];
+    const uint64_t end = seek_table_[end_chunk - 1];
+    const uint64_t read_block = start / kBlobstoreBlockSize;
+    const uint64_t read_end = fbl::round_up(end, kBlobstoreBlockSize) / kBlobstoreBlockSize;
+    zx_status_t status;
+    ReadTxn txn(blobstore_.get());
+    txn.Enqueue(compressed_vmoid_, read_block,
+                inode->start_block + DataStartBlock(blobstore_->info_) + merkle_blocks +
+                read_block, read_end - read_block);
+    if ((status = txn.Flush()) != ZX_OK) {
+        return status;
+    }
+
+    for (uint64_t i = chunk; i < end_chunk; i++) {
+        void* out = fs::GetBlock<kBlobstoreBlockSize>(GetData(), i * kVerifyChunkBlocks);
+        if ((status = DecompressBlobChunk(*inode, seek_table_.get(), compressed_->GetData(),
+                                          stored_size, i, out)) != ZX_OK) {
+            FS_TRACE_ERROR("blobstore: Failed to decompress chunk %" PRIu64 "\n", i);
+            break;
+        }
+    }
+
+    // Only the decompressed copy is kept.
+    zx_vmo_op_range(compressed_->GetVmo(), ZX_VMO_OP_DECOMMIT, read_block * kBlobstoreBlockSize,
+                    (read_end - read_block) * kBlobstoreBlockSize, nullptr, 0);
+    return status;
+}
+
+zx_status_t VnodeBlob::VerifyRange(uint64_t off, uint64_t len) {
+    TRACE_DURATION("blobstore", "Blobstore::VerifyRange", "off", off, "len", len);
+    ZX_DEBUG_ASSERT(blob_ != nullptr);
+    static_assert(MerkleTree::kNodeSize == kBlobstoreBlockSize,
+                  "Verified ranges are tracked in blocks");
+
+    const blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
+    const uint64_t data_blocks = BlobDataBlocks(*inode);
+    uint64_t block = fbl::round_down(off / kBlobstoreBlockSize, kVerifyChunkBlocks);
+    const uint64_t end = fbl::min(fbl::round_up((off + len + kBlobstoreBlockSize - 1) /
+                                                kBlobstoreBlockSize, kVerifyChunkBlocks),
+                                  data_blocks);
+    Digest d;
+    d = reinterpret_cast<const uint8_t*>(&digest_[0]);
+    while (block < end) {
+        // Skip past what has already been verified, and read in the run after
+        // it which hasn't been.
+        block = verified_.Scan(block, end, true);
+        if (block == end) {
+            break;
+        }
+        const uint64_t run_end = verified_.Scan(block, end, false);
+
+        zx_status_t status;
+        if (IsCompressed()) {
+            if ((status = ReadCompressed(block, run_end)) != ZX_OK) {
+                return status;
+            }
+        } else {
+            ReadTxn txn(blobstore_.get());
+            txn.Enqueue(vmoid_, MerkleTreeBlocks(*inode) + block,
+                        inode->start_block + DataStartBlock(blobstore_->info_) +
+                        MerkleTreeBlocks(*inode) + block, run_end - block);
+            if ((status = txn.Flush()) != ZX_OK) {
+                return status;
+            }
+        }
+
+        const uint64_t run_off = block * kBlobstoreBlockSize;
+        const uint64_t run_len = fbl::min(run_end * kBlobstoreBlockSize,
+                                          inode->blob_size) - run_off;
+        if ((status = MerkleTree::Verify(GetData(), inode->blob_size, GetMerkle(),
+                                         MerkleTree::GetTreeLength(inode->blob_size),
+                                         run_off, run_len, d)) != ZX_OK) {
+            FS_TRACE_ERROR("blobstore: Blob data at %" PRIu64 " failed verification\n", run_off);
+            return status;
+        }
+        verified_.Set(block, run_end);
+        block = run_end;
+    }
+    return ZX_OK;
+}
+
+zx_status_t VnodeBlob::SetVerified() {
+    const blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
+    zx_status_t status = verified_.Reset(BlobDataBlocks(*inode));
+    if (status != ZX_OK) {
+        return status;
+    }
+    return verified_.Set(0, BlobDataBlocks(*inode));
 }
 
 uint64_t VnodeBlob::SizeData() const {
@@ -180,7 +343,13 @@ VnodeBlob::VnodeBlob(fbl::RefPtr<Blobstore> bs)
       flags_(kBlobStateEmpty | kBlobFlagDirectory) {}
 
 void VnodeBlob::BlobCloseHandles() {
+    merkle_builder_.reset();
     blob_ = nullptr;
+    if (compressed_ != nullptr) {
+        blobstore_->DetachVmo(compressed_vmoid_);
+        compressed_.reset();
+    }
+    seek_table_.reset();
     readable_event_.reset();
 }
 
@@ -204,7 +373,11 @@ zx_status_t VnodeBlob::SpaceAllocate(uint64_t size_data) {
     blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
     memset(inode->merkle_root_hash, 0, Digest::kLength);
     inode->blob_size = size_data;
+    inode->flags = 0;
+    // Room is reserved for the data uncompressed; if it compresses, what
+    // isn't needed is given back once it has all been written.
     inode->num_blocks = MerkleTreeBlocks(*inode) + BlobDataBlocks(*inode);
+    compress_ = blobstore_->compress_ && BlobDataBlocks(*inode) > 1;
 
     // Open VMOs, so we can begin writing after allocate succeeds.
     if ((status = MappedVmo::Create(inode->num_blocks * kBlobstoreBlockSize, "blob", &blob_)) != ZX_OK) {
@@ -214,6 +387,22 @@ zx_status_t VnodeBlob::SpaceAllocate(uint64_t size_data) {
         goto fail;
     }
 
+    // Small blobs have no Merkle tree to build; they are checked directly
+    // once they have been written.
+    if (MerkleTree::GetTreeLength(inode->blob_size) > 0) {
+        fbl::AllocChecker ac;
+        merkle_builder_.reset(new (&ac) MerkleBuilder(blobstore_->hash_pool_.get()));
+        if (!ac.check()) {
+            status = ZX_ERR_NO_MEMORY;
+            goto fail;
+        }
+        if ((status = merkle_builder_->Start(GetData(), inode->blob_size, GetMerkle(),
+                                             MerkleTree::GetTreeLength(inode->blob_size))) !=
+            ZX_OK) {
+            goto fail;
+        }
+    }
+
     // Allocate space for the blob
     if ((status = blobstore_->AllocateBlocks(inode->num_blocks, &inode->start_block)) != ZX_OK) {
         goto fail;
@@ -241,6 +430,50 @@ zx_status_t VnodeBlob::WriteShared(WriteTxn* txn, size_t start, size_t len, uint
     return txn->Flush();
 }
 
+zx_status_t VnodeBlob::WriteCompressed(WriteTxn* txn) {
+    TRACE_DURATION("blobstore", "Blobstore::WriteCompressed");
+    blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
+    const uint64_t merkle_blocks = MerkleTreeBlocks(*inode);
+    const uint64_t data_blocks = BlobDataBlocks(*inode);
+
+    // Compression has to save at least a block to be worth it.
+    zx_status_t status;
+    fbl::unique_ptr<MappedVmo> compressed;
+    if ((status = MappedVmo::Create((data_blocks - 1) * kBlobstoreBlockSize, "blob-compressed",
+                                    &compressed)) != ZX_OK) {
+        return status;
+    }
+    size_t compressed_size;
+    status = CompressBlob(GetData(), inode->blob_size, compressed->GetData(),
+                          compressed->GetSize(), &compressed_size);
+    if (status == ZX_ERR_BUFFER_TOO_SMALL) {
+        return WriteShared(txn, merkle_blocks * kBlobstoreBlockSize, inode->blob_size,
+                           inode->start_block);
+    } else if (status != ZX_OK) {
+        return status;
+    }
+
+    vmoid_t vmoid;
+    if ((status = blobstore_->AttachVmo(compressed->GetVmo(), &vmoid)) != ZX_OK) {
+        return status;
+    }
+    const uint64_t stored_blocks = fbl::round_up(compressed_size, kBlobstoreBlockSize) /
+                                   kBlobstoreBlockSize;
+    txn->Enqueue(vmoid, 0, inode->start_block + DataStartBlock(blobstore_->info_) + merkle_blocks,
+                 stored_blocks);
+    status = txn->Flush();
+    blobstore_->DetachVmo(vmoid);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    blobstore_->FreeBlocks(data_blocks - stored_blocks,
+                           inode->start_block + merkle_blocks + stored_blocks);
+    inode->num_blocks = merkle_blocks + stored_blocks;
+    inode->flags |= kBlobstoreInodeFlagLZ4;
+    return ZX_OK;
+}
+
 void* VnodeBlob::GetData() const {
     auto inode = blobstore_->GetNode(map_index_);
     return fs::GetBlock<kBlobstoreBlockSize>(blob_->GetData(),
@@ -285,8 +518,11 @@ zx_status_t VnodeBlob::WriteMetadata() {
     // Flush the block allocation bitmap to disk
     fsync(blobstore_->Fd());
 
-    // Update the on-disk hash
+    // Update the on-disk hash. The node may already be in the digest index
+    // under its empty hash, if the index was rebuilt while it was written.
+    blobstore_->UnindexNode(map_index_);
     memcpy(inode->merkle_root_hash, &digest_[0], Digest::kLength);
+    blobstore_->IndexNode(map_index_);
 
     // Write back the blob node
     if (blobstore_->WriteNode(&txn, map_index_)) {
@@ -317,36 +553,41 @@ zx_status_t VnodeBlob::WriteInternal(const void* data, size_t len, size_t* actua
             return status;
         }
 
-        status = WriteShared(&txn, offset, len, inode->start_block);
-        if (status != ZX_OK) {
-            SetState(kBlobStateError);
-            return status;
+        // Data which is to be compressed is only written out once all of it
+        // has arrived.
+        if (!compress_) {
+            status = WriteShared(&txn, offset, len, inode->start_block);
+            if (status != ZX_OK) {
+                SetState(kBlobStateError);
+                return status;
+            }
         }
 
         *actual = to_write;
         bytes_written_ += to_write;
+        if (merkle_builder_ != nullptr) {
+            // Hash what has arrived so far on the pool, while the client
+            // sends the rest.
+            merkle_builder_->Append(bytes_written_);
+        }
 
         // More data to write.
         if (bytes_written_ < inode->blob_size) {
             return ZX_OK;
         }
 
-        // TODO(smklein): As an optimization, use the CreateInit/Update/Final
-        // methods to create the merkle tree as we write data, rather than
-        // waiting until the data is fully downloaded to create the tree.
         size_t merkle_size = MerkleTree::GetTreeLength(inode->blob_size);
         if (merkle_size > 0) {
             Digest digest;
-            void* merkle_data = GetMerkle();
-            const void* blob_data = GetData();
-            if (MerkleTree::Create(blob_data, inode->blob_size, merkle_data,
-                                   merkle_size, &digest) != ZX_OK) {
+            status = merkle_builder_->Finish(&digest);
+            merkle_builder_.reset();
+            if (status != ZX_OK) {
                 SetState(kBlobStateError);
                 return status;
             } else if (digest != digest_) {
                 // Downloaded blob did not match provided digest
                 SetState(kBlobStateError);
-                return status;
+                return ZX_ERR_IO_DATA_INTEGRITY;
             }
 
             status = WriteShared(&txn, 0, merkle_size, inode->start_block);
@@ -362,6 +603,17 @@ zx_status_t VnodeBlob::WriteInternal(const void* data, size_t len, size_t* actua
             return status;
         }
 
+        if (compress_ && (status = WriteCompressed(&txn)) != ZX_OK) {
+            SetState(kBlobStateError);
+            return status;
+        }
+
+        // Everything in memory has now been checked against the digest.
+        if ((status = SetVerified()) != ZX_OK) {
+            SetState(kBlobStateError);
+            return status;
+        }
+
         // No more data to write. Flush to disk.
         if ((status = WriteMetadata()) != ZX_OK) {
             SetState(kBlobStateError);
@@ -397,14 +649,19 @@ zx_status_t VnodeBlob::CopyVmo(zx_rights_t rights, zx_handle_t* out) {
     if (GetState() != kBlobStateReadable) {
         return ZX_ERR_BAD_STATE;
     }
-    zx_status_t status = InitVmos();
-    if (status != ZX_OK) {
-        return status;
-    }
-
     auto inode = blobstore_->GetNode(map_index_);
-    // TODO(smklein): Only clone / verify the part of the vmo that
-    // was requested.
+    zx_status_t status;
+    {
+        fbl::AutoLock lock(&read_lock_);
+        if ((status = InitVmos()) != ZX_OK) {
+            return status;
+        }
+        // TODO(smklein): Only clone / verify the part of the vmo that
+        // was requested.
+        if ((status = VerifyRange(0, inode->blob_size)) != ZX_OK) {
+            return status;
+        }
+    }
     const size_t data_start = MerkleTreeBlocks(*inode) * kBlobstoreBlockSize;
     zx_handle_t clone;
     if ((status = zx_vmo_clone(blob_->GetVmo(), ZX_VMO_CLONE_COPY_ON_WRITE,
@@ -426,13 +683,6 @@ zx_status_t VnodeBlob::ReadInternal(void* data, size_t len, size_t off, size_t*
         return ZX_ERR_BAD_STATE;
     }
 
-    zx_status_t status = InitVmos();
-    if (status != ZX_OK) {
-        return status;
-    }
-
-    Digest d;
-    d = reinterpret_cast<const uint8_t*>(&digest_[0]);
     auto inode = blobstore_->GetNode(map_index_);
     if (off >= inode->blob_size) {
         *actual = 0;
@@ -442,12 +692,25 @@ zx_status_t VnodeBlob::ReadInternal(void* data, size_t len, size_t off, size_t*
         len = inode->blob_size - off;
     }
 
+    {
+        fbl::AutoLock lock(&read_lock_);
+        zx_status_t status = InitVmos();
+        if (status != ZX_OK) {
+            return status;
+        }
+        if ((status = VerifyRange(off, len)) != ZX_OK) {
+            return status;
+        }
+    }
+
     const size_t data_start = MerkleTreeBlocks(*inode) * kBlobstoreBlockSize;
     return zx_vmo_read(blob_->GetVmo(), data, data_start + off, len, actual);
 }
 
 void VnodeBlob::QueueUnlink() {
     flags_ |= kBlobFlagDeletable;
+    // The blob is purged once the last reference to it goes away.
+    blobstore_->vnode_cache_.Evict(this);
 }
 
 // Allocates Blocks IN MEMORY
@@ -514,12 +777,17 @@ zx_status_t Blobstore::AllocateNode(size_t* node_index_out) {
 // Frees a node IN MEMORY
 void Blobstore::FreeNode(size_t node_index) {
     TRACE_DURATION("blobstore", "Blobstore::FreeNode", "node_index", node_index);
+    if (GetNode(node_index)->start_block >= kStartBlockMinimum) {
+        UnindexNode(node_index);
+    }
     memset(GetNode(node_index), 0, sizeof(blobstore_inode_t));
     info_.alloc_inode_count--;
 }
 
 zx_status_t Blobstore::Unmount() {
     TRACE_DURATION("blobstore", "Blobstore::Unmount");
+    // Cached blobs refer back to the blobstore.
+    vnode_cache_.Clear();
     // Explicitly delete this (rather than just letting the memory release when
     // the process exits) to ensure that the block device's fifo has been
     // closed.
@@ -531,6 +799,77 @@ zx_status_t Blobstore::Unmount() {
     return ZX_OK;
 }
 
+namespace {
+
+// Merkle roots are already uniformly distributed, so their leading bytes
+// serve as the hash.
+size_t DigestBucket(const uint8_t* digest, size_t bucket_count) {
+    uint32_t key;
+    memcpy(&key, digest, sizeof(key));
+    return key & (bucket_count - 1);
+}
+
+} // namespace
+
+zx_status_t Blobstore::ResetNodeIndex(size_t node_count) {
+    TRACE_DURATION("blobstore", "Blobstore::ResetNodeIndex", "node_count", node_count);
+    ZX_DEBUG_ASSERT(node_count < fbl::numeric_limits<uint32_t>::max());
+    size_t bucket_count = 1;
+    while (bucket_count < node_count) {
+        bucket_count <<= 1;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::Array<uint32_t> buckets(new (&ac) uint32_t[bucket_count](), bucket_count);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    fbl::Array<uint32_t> chain(new (&ac) uint32_t[node_count](), node_count);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    node_buckets_ = fbl::move(buckets);
+    node_chain_ = fbl::move(chain);
+
+    for (size_t i = 0; i < node_count; ++i) {
+        if (GetNode(i)->start_block >= kStartBlockMinimum) {
+            IndexNode(i);
+        }
+    }
+    return ZX_OK;
+}
+
+void Blobstore::IndexNode(size_t node_index) {
+    ZX_DEBUG_ASSERT(node_index < node_chain_.size());
+    size_t b = DigestBucket(GetNode(node_index)->merkle_root_hash, node_buckets_.size());
+    node_chain_[node_index] = node_buckets_[b];
+    node_buckets_[b] = static_cast<uint32_t>(node_index + 1);
+}
+
+void Blobstore::UnindexNode(size_t node_index) {
+    size_t b = DigestBucket(GetNode(node_index)->merkle_root_hash, node_buckets_.size());
+    for (uint32_t* link = &node_buckets_[b]; *link != 0; link = &node_chain_[*link - 1]) {
+        if (*link == node_index + 1) {
+            *link = node_chain_[node_index];
+            node_chain_[node_index] = 0;
+            return;
+        }
+    }
+}
+
+bool Blobstore::FindNode(const Digest& digest, size_t* node_index_out) const {
+    size_t b = DigestBucket(digest.AcquireBytes(), node_buckets_.size());
+    digest.ReleaseBytes();
+    for (uint32_t link = node_buckets_[b]; link != 0; link = node_chain_[link - 1]) {
+        const blobstore_inode_t* inode = GetNode(link - 1);
+        if (inode->start_block >= kStartBlockMinimum && digest == inode->merkle_root_hash) {
+            *node_index_out = link - 1;
+            return true;
+        }
+    }
+    return false;
+}
+
 zx_status_t Blobstore::WriteBitmap(WriteTxn* txn, uint64_t nblocks, uint64_t start_block) {
     TRACE_DURATION("blobstore", "Blobstore::WriteBitmap", "nblocks", nblocks, "start_block",
                    start_block);
@@ -604,6 +943,9 @@ zx_status_t Blobstore::ReleaseBlob(VnodeBlob* vn) {
         WriteNode(&txn, node_index);
         WriteBitmap(&txn, nblocks, start_block);
         CountUpdate(&txn);
+        if (trim_supported_) {
+            txn.EnqueueTrim(start_block + DataStartBlock(info_), nblocks);
+        }
         hash_.erase(*vn);
         return ZX_OK;
     }
@@ -685,29 +1027,26 @@ zx_status_t Blobstore::LookupBlob(const Digest& digest, fbl::RefPtr<VnodeBlob>*
         return ZX_OK;
     }
 
-    // Look up blob in the slow map
-    for (size_t i = 0; i < info_.inode_count; ++i) {
-        if (GetNode(i)->start_block >= kStartBlockMinimum) {
-            if (digest == GetNode(i)->merkle_root_hash) {
-                if (out != nullptr) {
-                    // Found it. Attempt to wrap the blob in a vnode.
-                    fbl::AllocChecker ac;
-                    fbl::RefPtr<VnodeBlob> vn =
-                        fbl::AdoptRef(new (&ac) VnodeBlob(fbl::RefPtr<Blobstore>(this), digest));
-                    if (!ac.check()) {
-                        return ZX_ERR_NO_MEMORY;
-                    }
-                    vn->SetState(kBlobStateReadable);
-                    vn->SetMapIndex(i);
-                    // Delay reading any data from disk until read.
-                    hash_.insert(vn.get());
-                    *out = fbl::move(vn);
-                }
-                return ZX_OK;
-            }
+    // Look up blob in the digest index of the node map
+    size_t i;
+    if (!FindNode(digest, &i)) {
+        return ZX_ERR_NOT_FOUND;
+    }
+    if (out != nullptr) {
+        // Found it. Attempt to wrap the blob in a vnode.
+        fbl::AllocChecker ac;
+        fbl::RefPtr<VnodeBlob> vn =
+            fbl::AdoptRef(new (&ac) VnodeBlob(fbl::RefPtr<Blobstore>(this), digest));
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
         }
+        vn->SetState(kBlobStateReadable);
+        vn->SetMapIndex(i);
+        // Delay reading any data from disk until read.
+        hash_.insert(vn.get());
+        *out = fbl::move(vn);
     }
-    return ZX_ERR_NOT_FOUND;
+    return ZX_OK;
 }
 
 zx_status_t Blobstore::AttachVmo(zx_handle_t vmo, vmoid_t* out) {
@@ -724,6 +1063,14 @@ zx_status_t Blobstore::AttachVmo(zx_handle_t vmo, vmoid_t* out) {
     return ZX_OK;
 }
 
+void Blobstore::DetachVmo(vmoid_t vmoid) {
+    block_fifo_request_t request;
+    request.txnid = TxnId();
+    request.vmoid = vmoid;
+    request.opcode = BLOCKIO_CLOSE_VMO;
+    Txn(&request, 1);
+}
+
 zx_status_t Blobstore::AddInodes() {
     TRACE_DURATION("blobstore", "Blobstore::AddInodes");
 
@@ -755,15 +1102,20 @@ zx_status_t Blobstore::AddInodes() {
         return ZX_ERR_NO_SPACE;
     }
 
-    info_.vslice_count += request.length;
-    info_.ino_slices += static_cast<uint32_t>(request.length);
-    info_.inode_count = inodes;
-
     // Reset new inodes to 0
     uintptr_t addr = reinterpret_cast<uintptr_t>(node_map_->GetData());
     memset(reinterpret_cast<void*>(addr + kBlobstoreBlockSize * inoblks_old), 0,
                                    (kBlobstoreBlockSize * (inoblks - inoblks_old)));
 
+    // Rehash over the larger node map before anything is allocated from it.
+    if (ResetNodeIndex(inodes) != ZX_OK) {
+        return ZX_ERR_NO_SPACE;
+    }
+
+    info_.vslice_count += request.length;
+    info_.ino_slices += static_cast<uint32_t>(request.length);
+    info_.inode_count = inodes;
+
     WriteTxn txn(this);
     txn.Enqueue(info_vmoid_, 0, 0, 1);
     txn.Enqueue(node_map_vmoid_, inoblks_old, NodeMapStartBlock(info_) + inoblks_old,
@@ -867,6 +1219,17 @@ zx_status_t Blobstore::Create(fbl::unique_fd fd, const blobstore_info_t* info,
         return status;
     }
 
+    block_info_t block_info;
+    if (ioctl_block_get_info(fs->Fd(), &block_info) >= 0) {
+        fs->trim_supported_ = (block_info.flags & BLOCK_FLAG_TRIM_SUPPORT) != 0;
+    }
+
+    if ((status = HashPool::Create(fbl::min(zx_system_get_num_cpus(), kHashThreads),
+                                   &fs->hash_pool_)) != ZX_OK) {
+        fprintf(stderr, "blobstore: Could not start hashing threads\n");
+        return status;
+    }
+
     // Keep the block_map_ aligned to a block multiple
     if ((status = fs->block_map_.Reset(BlockMapBlocks(fs->info_) * kBlobstoreBlockBits)) < 0) {
         fprintf(stderr, "blobstore: Could not reset block bitmap\n");
@@ -890,6 +1253,9 @@ zx_status_t Blobstore::Create(fbl::unique_fd fd, const blobstore_info_t* info,
     } else if ((status = fs->LoadBitmaps()) < 0) {
         fprintf(stderr, "blobstore: Failed to load bitmaps: %d\n", status);
         return status;
+    } else if ((status = fs->ResetNodeIndex(fs->info_.inode_count)) != ZX_OK) {
+        fprintf(stderr, "blobstore: Failed to index nodes: %d\n", status);
+        return status;
     } else if ((status = MappedVmo::Create(kBlobstoreBlockSize, "blobstore-superblock",
                                            &fs->info_vmo_)) != ZX_OK) {
         fprintf(stderr, "blobstore: Failed to create info vmo: %d\n", status);
@@ -926,7 +1292,11 @@ zx_status_t Blobstore::LoadBitmaps() {
     ReadTxn txn(this);
     txn.Enqueue(block_map_vmoid_, 0, BlockMapStartBlock(info_), BlockMapBlocks(info_));
     txn.Enqueue(node_map_vmoid_, 0, NodeMapStartBlock(info_), NodeMapBlocks(info_));
-    return txn.Flush();
+    zx_status_t status = txn.Flush();
+    if (status != ZX_OK) {
+        return status;
+    }
+    return block_map_.EnableSummary();
 }
 
 zx_status_t blobstore_create(fbl::RefPtr<Blobstore>* out, fbl::unique_fd blockfd) {
@@ -965,13 +1335,19 @@ zx_status_t blobstore_create(fbl::RefPtr<Blobstore>* out, fbl::unique_fd blockfd
     return ZX_OK;
 }
 
-zx_status_t blobstore_mount(fbl::RefPtr<VnodeBlob>* out, fbl::unique_fd blockfd) {
+zx_status_t blobstore_mount(fbl::RefPtr<VnodeBlob>* out, fbl::unique_fd blockfd,
+                            const blobstore_options_t& options, async_t* async,
+                            zx::event memory_warning, zx::event memory_critical) {
     zx_status_t status;
     fbl::RefPtr<Blobstore> fs;
 
     if ((status = blobstore_create(&fs, fbl::move(blockfd))) != ZX_OK) {
         return status;
     }
+    fs->SetCompression(options.compress);
+    if (memory_warning.is_valid() && memory_critical.is_valid()) {
+        fs->WatchMemoryPressure(async, fbl::move(memory_warning), fbl::move(memory_critical));
+    }
 
     if ((status = fs->GetRootBlob(out)) != ZX_OK) {
         fprintf(stderr, "blobstore: mount failed; could not get root blob\n");
@@ -0,0 +1,87 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/limits.h>
+#include <lz4/lz4.h>
+
+#include <blobstore/compression.h>
+
+namespace blobstore {
+namespace {
+
+uint64_t ChunkLength(uint64_t blob_size, uint64_t chunk) {
+    return fbl::min(kBlobstoreChunkSize, blob_size - chunk * kBlobstoreChunkSize);
+}
+
+} // namespace
+
+zx_status_t CompressBlob(const void* data, uint64_t blob_size, void* out, size_t out_capacity,
+                         size_t* out_size) {
+    const uint64_t chunks = fbl::round_up(blob_size, kBlobstoreChunkSize) / kBlobstoreChunkSize;
+    const uint64_t table_size = chunks * sizeof(uint32_t);
+    if (table_size > out_capacity) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+
+    const char* src = static_cast<const char*>(data);
+    char* dst = static_cast<char*>(out);
+    // Seek table offsets are 32 bits wide, which bounds how much compressed
+    // data a blob may have.
+    const size_t capacity = fbl::min(out_capacity,
+                                     static_cast<size_t>(fbl::numeric_limits<uint32_t>::max()));
+    size_t offset = table_size;
+    for (uint64_t i = 0; i < chunks; i++) {
+        const int len = static_cast<int>(ChunkLength(blob_size, i));
+        const int room = static_cast<int>(fbl::min(capacity - offset,
+                                                   static_cast<size_t>(LZ4_compressBound(len))));
+        int r = LZ4_compress_default(src + i * kBlobstoreChunkSize, dst + offset, len, room);
+        if (r <= 0) {
+            return ZX_ERR_BUFFER_TOO_SMALL;
+        }
+        offset += r;
+        uint32_t end = static_cast<uint32_t>(offset);
+        memcpy(dst + i * sizeof(uint32_t), &end, sizeof(end));
+    }
+    *out_size = offset;
+    return ZX_OK;
+}
+
+zx_status_t CheckSeekTable(const blobstore_inode_t& inode, const uint32_t* seek_table,
+                           size_t stored_size) {
+    uint64_t start = BlobSeekTableSize(inode);
+    for (uint64_t i = 0; i < BlobChunkCount(inode); i++) {
+        if (seek_table[i] <= start || seek_table[i] > stored_size) {
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        start = seek_table[i];
+    }
+    return ZX_OK;
+}
+
+zx_status_t DecompressBlobChunk(const blobstore_inode_t& inode, const uint32_t* seek_table,
+                                const void* stored, size_t stored_size, uint64_t chunk,
+                                void* out) {
+    if (chunk >= BlobChunkCount(inode)) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+    const uint64_t start = (chunk == 0) ? BlobSeekTableSize(inode) : seek_table[chunk - 1];
+    const uint64_t end = seek_table[chunk];
+    if (start >= end || end > stored_size) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+
+    const int len = static_cast<int>(ChunkLength(inode.blob_size, chunk));
+    int r = LZ4_decompress_safe(static_cast<const char*>(stored) + start, static_cast<char*>(out),
+                                static_cast<int>(end - start), len);
+    if (r != len) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    return ZX_OK;
+}
+
+} // namespace blobstore
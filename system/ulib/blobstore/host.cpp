@@ -23,6 +23,7 @@
 
 #define MXDEBUG 0
 
+#include <blobstore/compression.h>
 #include <blobstore/format.h>
 #include <blobstore/fsck.h>
 #include <blobstore/host.h>
@@ -176,6 +177,27 @@ zx_status_t blobstore_add_blob(Blobstore* bs, int data_fd) {
         return status;
     }
 
+    // Compression runs concurrently with other blobs, like the Merkle tree.
+    // Blobs which don't save at least a block are stored as they are.
+    blobstore_inode_t shape = {};
+    shape.blob_size = s.st_size;
+    const uint64_t data_blocks = BlobDataBlocks(shape);
+    fbl::unique_ptr<uint8_t[]> compressed;
+    size_t compressed_size = 0;
+    if (bs->compress() && data_blocks > 1) {
+        const size_t capacity = (data_blocks - 1) * kBlobstoreBlockSize;
+        compressed.reset(new (&ac) uint8_t[capacity]);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        status = CompressBlob(blob_data, s.st_size, compressed.get(), capacity, &compressed_size);
+        if (status == ZX_ERR_BUFFER_TOO_SMALL) {
+            compressed.reset();
+        } else if (status != ZX_OK) {
+            return status;
+        }
+    }
+
     std::lock_guard<std::mutex> lock(add_blob_mutex_);
     fbl::unique_ptr<InodeBlock> inode_block;
     if ((status = bs->NewBlob(digest, &inode_block)) < 0) {
@@ -188,12 +210,23 @@ zx_status_t blobstore_add_blob(Blobstore* bs, int data_fd) {
 
     inode_block->SetSize(s.st_size);
     blobstore_inode_t* inode = inode_block->GetInode();
+    const void* stored_data = blob_data;
+    size_t stored_size = s.st_size;
+    if (compressed != nullptr) {
+        stored_data = compressed.get();
+        stored_size = compressed_size;
+        inode->flags |= kBlobstoreInodeFlagLZ4;
+        inode->num_blocks = MerkleTreeBlocks(*inode) +
+                            fbl::round_up(compressed_size, kBlobstoreBlockSize) /
+                            kBlobstoreBlockSize;
+    }
 
     if ((status = bs->AllocateBlocks(inode->num_blocks,
                                      reinterpret_cast<size_t*>(&inode->start_block))) != ZX_OK) {
         fprintf(stderr, "error: No blocks available\n");
         return status;
-    } else if ((status = bs->WriteData(inode, merkle_tree.get(), blob_data)) != ZX_OK) {
+    } else if ((status = bs->WriteData(inode, merkle_tree.get(), stored_data,
+                                       stored_size)) != ZX_OK) {
         return status;
     } else if ((status = bs->WriteBitmap(inode->num_blocks, inode->start_block)) != ZX_OK) {
         return status;
@@ -221,6 +254,7 @@ zx_status_t blobstore_fsck(fbl::unique_fd fd, off_t start, off_t end,
 
 void InodeBlock::SetSize(size_t size) {
     inode_->blob_size = size;
+    inode_->flags = 0;
     inode_->num_blocks = MerkleTreeBlocks(*inode_) + BlobDataBlocks(*inode_);
 }
 
@@ -292,7 +326,7 @@ zx_status_t Blobstore::LoadBitmap() {
             memcpy(bmdata, cache_.blk, kBlobstoreBlockSize);
         }
     }
-    return ZX_OK;
+    return block_map_.EnableSummary();
 }
 
 zx_status_t Blobstore::NewBlob(const Digest& digest, fbl::unique_ptr<InodeBlock>* out) {
@@ -384,7 +418,8 @@ zx_status_t Blobstore::WriteNode(fbl::unique_ptr<InodeBlock> ino_block) {
     return WriteBlock(cache_.bno, cache_.blk);
 }
 
-zx_status_t Blobstore::WriteData(blobstore_inode_t* inode, void* merkle_data, void* blob_data) {
+zx_status_t Blobstore::WriteData(blobstore_inode_t* inode, const void* merkle_data,
+                                 const void* blob_data, size_t data_size) {
     for (size_t n = 0; n < MerkleTreeBlocks(*inode); n++) {
         const void* data = fs::GetBlock<kBlobstoreBlockSize>(merkle_data, n);
         uint64_t bno = data_start_block_ + inode->start_block + n;
@@ -394,17 +429,18 @@ zx_status_t Blobstore::WriteData(blobstore_inode_t* inode, void* merkle_data, vo
         }
     }
 
-    for (size_t n = 0; n < BlobDataBlocks(*inode); n++) {
+    const size_t data_blocks = fbl::round_up(data_size, kBlobstoreBlockSize) / kBlobstoreBlockSize;
+    for (size_t n = 0; n < data_blocks; n++) {
         const void* data = fs::GetBlock<kBlobstoreBlockSize>(blob_data, n);
 
         // If we try to write a block, will it be reaching beyond the end of the
         // mapped file?
         size_t off = n * kBlobstoreBlockSize;
         uint8_t last_data[kBlobstoreBlockSize];
-        if (inode->blob_size < off + kBlobstoreBlockSize) {
+        if (data_size < off + kBlobstoreBlockSize) {
             // Read the partial block from a block-sized buffer which zero-pads the data.
             memset(last_data, 0, kBlobstoreBlockSize);
-            memcpy(last_data, data, inode->blob_size - off);
+            memcpy(last_data, data, data_size - off);
             data = last_data;
         }
 
@@ -14,9 +14,12 @@
 #include <bitmap/raw-bitmap.h>
 #include <digest/digest.h>
 #include <fbl/algorithm.h>
+#include <fbl/array.h>
+#include <fbl/auto_lock.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/intrusive_wavl_tree.h>
 #include <fbl/macros.h>
+#include <fbl/mutex.h>
 #include <fbl/ref_counted.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_fd.h>
@@ -24,6 +27,7 @@
 #include <fs/block-txn.h>
 #include <fs/trace.h>
 #include <fs/vfs.h>
+#include <fs/vnode-cache.h>
 #include <fs/vnode.h>
 
 #include <string.h>
@@ -36,6 +40,7 @@
 
 #include <blobstore/common.h>
 #include <blobstore/format.h>
+#include <blobstore/merkle-builder.h>
 
 namespace blobstore {
 
@@ -69,6 +74,22 @@ constexpr BlobFlags kBlobOtherMask        = 0x0000FF00;
 
 // clang-format on
 
+// How much of a blob's data is read in and verified at once, in blocks, when
+// it is read back from disk. This is also the size of the chunks which
+// compressed blobs are decompressed in.
+constexpr size_t kVerifyChunkBlocks = 16;
+static_assert(kVerifyChunkBlocks * kBlobstoreBlockSize == kBlobstoreChunkSize,
+              "Compressed chunks are verified as they are decompressed");
+
+// The most threads used to hash blobs as they are written.
+constexpr uint32_t kHashThreads = 4;
+
+// Closed blobs are kept around up to these limits, so that executables and
+// libraries which are launched again don't need to be read and verified
+// again.
+constexpr size_t kBlobstoreVnodeCacheSize = 256;
+constexpr size_t kBlobstoreVnodeCacheBytes = 32 * (1LU << 20);
+
 class VnodeBlob final : public fs::Vnode {
 public:
     // Intrusive methods and structures
@@ -160,21 +181,49 @@ private:
                        uint32_t mode) final;
     zx_status_t Truncate(size_t len) final;
     zx_status_t Unlink(fbl::StringPiece name, bool must_be_dir) final;
+    zx_status_t Close() final;
     zx_status_t Mmap(int flags, size_t len, size_t* off, zx_handle_t* out) final;
     zx_status_t Sync() final;
+    bool CanDispatchConcurrently(uint32_t op) final;
 
-    // Read both VMOs into memory, if we haven't already.
-    //
-    // TODO(ZX-1481): When we have can register the Blob Store as a pager
-    // service, and it can properly handle pages faults on a vnode's contents,
-    // then we can avoid reading the entire blob up-front. Until then, read
-    // the contents of a VMO into memory when it is opened.
+    // Creates the VMO holding the blob and reads its Merkle tree into it, if
+    // we haven't already. The data is only read in as it is needed, by
+    // VerifyRange().
     zx_status_t InitVmos();
 
     // Verify the integrity of the in-memory Blob.
-    // InitVmos() must have already been called for this blob.
+    // InitVmos() must have already been called for this blob, and all of its
+    // data must be in memory.
     zx_status_t Verify() const;
 
+    // Makes sure [off, off + len) of the blob's data has been read in from
+    // disk and checked against the Merkle tree. Data is read in aligned
+    // chunks of kVerifyChunkBlocks around what was asked for, and each chunk
+    // is only read and verified once.
+    // InitVmos() must have already been called for this blob.
+    zx_status_t VerifyRange(uint64_t off, uint64_t len);
+
+    // Marks all of the blob's data as verified, once it has been written out
+    // and checked as a whole.
+    zx_status_t SetVerified();
+
+    // Returns true if the blob's data is stored in compressed chunks.
+    bool IsCompressed() const;
+
+    // Reads the seek table of a compressed blob into |seek_table_|.
+    // InitVmos() must have already been called for this blob.
+    zx_status_t ReadSeekTable();
+
+    // Reads in the compressed chunks holding blocks [block, end_block) of the
+    // blob's data and decompresses them into blob_. |block| must be the
+    // start of a chunk, and |end_block| the end of one or of the data.
+    zx_status_t ReadCompressed(uint64_t block, uint64_t end_block);
+
+    // Writes out the blob's data once all of it has arrived, compressed if
+    // that saves space. Blocks which the compressed data doesn't need are
+    // given back.
+    zx_status_t WriteCompressed(WriteTxn* txn);
+
     zx_status_t WriteShared(WriteTxn* txn, size_t start, size_t len, uint64_t start_block);
     // Called by Blob once the last write has completed, updating the
     // on-disk metadata.
@@ -194,6 +243,24 @@ private:
     // 2) The Blob itself, aligned to the nearest kBlobstoreBlockSize
     fbl::unique_ptr<MappedVmo> blob_{};
     vmoid_t vmoid_{};
+    // Serializes concurrent reads of a readable blob while they set up blob_
+    // and read in and verify its data.
+    fbl::Mutex read_lock_;
+    // One bit per block of the blob's data, set once that block is in blob_
+    // and has been verified.
+    bitmap::RawBitmapGeneric<bitmap::DefaultStorage> verified_{};
+    // Builds the Merkle tree while the blob is being written. Declared after
+    // blob_, so that it stops reading from it before it goes away.
+    fbl::unique_ptr<MerkleBuilder> merkle_builder_{};
+
+    // Set while a blob is written if its data is held back until all of it
+    // has arrived, to be compressed.
+    bool compress_{};
+    // For compressed blobs: holds compressed data as it is read in, before it
+    // is decompressed into blob_, and a copy of the seek table.
+    fbl::unique_ptr<MappedVmo> compressed_{};
+    vmoid_t compressed_vmoid_{};
+    fbl::Array<uint32_t> seek_table_{};
 
     zx::event readable_event_{};
     uint64_t bytes_written_{};
@@ -253,8 +320,12 @@ public:
     zx_status_t Readdir(fs::vdircookie_t* cookie, void* dirents, size_t len, size_t* out_actual);
 
     zx_status_t AttachVmo(zx_handle_t vmo, vmoid_t* out);
+    void DetachVmo(vmoid_t vmoid);
     zx_status_t Txn(block_fifo_request_t* requests, size_t count) {
         TRACE_DURATION("blobstore", "Blobstore::Txn", "count", count);
+        // Reads of different blobs may be dispatched at once, and they all
+        // share one txnid.
+        fbl::AutoLock lock(&txn_lock_);
         return block_fifo_txn(fifo_client_, requests, count);
     }
     txnid_t TxnId() const { return txnid_; }
@@ -272,6 +343,14 @@ public:
     // Returns an unique identifier for this instance.
     uint64_t GetFsId() const { return fs_id_; }
 
+    // Sets whether the data of blobs written from now on is compressed.
+    void SetCompression(bool compress) { compress_ = compress; }
+
+    // Shrinks |vnode_cache_| while the system is short of memory.
+    zx_status_t WatchMemoryPressure(async_t* async, zx::event warning, zx::event critical) {
+        return vnode_cache_.WatchMemoryPressure(async, fbl::move(warning), fbl::move(critical));
+    }
+
     blobstore_info_t info_;
 
 private:
@@ -291,6 +370,16 @@ private:
     // Access the nth inode of the node map
     blobstore_inode_t* GetNode(size_t index) const;
 
+    // Rebuilds the digest index over the first |node_count| nodes of the
+    // node map. On failure the existing index is left in place.
+    zx_status_t ResetNodeIndex(size_t node_count);
+    // Adds or removes an allocated node, by its merkle root, in the digest
+    // index. Removing a node which is not present is a no-op.
+    void IndexNode(size_t node_index);
+    void UnindexNode(size_t node_index);
+    // Finds the allocated node holding |digest|, without scanning the node map.
+    bool FindNode(const Digest& digest, size_t* node_index_out) const;
+
     // Given a contiguous number of blocks after a starting block,
     // write out the bitmap to disk for the corresponding blocks.
     zx_status_t WriteBitmap(WriteTxn* txn, uint64_t nblocks, uint64_t start_block);
@@ -313,7 +402,15 @@ private:
                                             VnodeBlob::TypeWavlTraits>;
     WAVLTreeByMerkle hash_{}; // Map of all 'in use' blobs
 
+    // Digest index over every allocated node, so that blobs which aren't in
+    // |hash_| can be found without scanning the node map. |node_buckets_|
+    // holds one more than the first node in each bucket (zero when empty),
+    // and |node_chain_| links nodes which share a bucket in the same way.
+    fbl::Array<uint32_t> node_buckets_;
+    fbl::Array<uint32_t> node_chain_;
+
     fbl::unique_fd blockfd_;
+    fbl::Mutex txn_lock_;
     fifo_client_t* fifo_client_{};
     txnid_t txnid_{};
     RawBitmap block_map_{};
@@ -323,11 +420,31 @@ private:
     fbl::unique_ptr<MappedVmo> info_vmo_{};
     vmoid_t info_vmoid_{};
     uint64_t fs_id_{};
+    bool compress_{};
+    // Whether the device accepts BLOCKIO_TRIM for the blocks of purged blobs.
+    bool trim_supported_{};
+
+    // Hashes the data of blobs being written.
+    fbl::unique_ptr<HashPool> hash_pool_{};
+
+    // Keeps recently closed blobs in |hash_|, along with the data which has
+    // been read in and verified.
+    fs::VnodeCache vnode_cache_{kBlobstoreVnodeCacheSize, kBlobstoreVnodeCacheBytes};
 };
 
+typedef struct {
+    // Compress the data of blobs as they are written, where that saves space.
+    bool compress = false;
+} blobstore_options_t;
+
 zx_status_t blobstore_create(fbl::RefPtr<Blobstore>* out, fbl::unique_fd blockfd);
 
 //TODO(planders): Update blobstore to use unique_fd.
-zx_status_t blobstore_mount(fbl::RefPtr<VnodeBlob>* out, fbl::unique_fd blockfd);
+//
+// If they are valid, the blobstore's caches are shrunk on |async| while
+// |memory_warning| or |memory_critical| is signaled; see zx_system_get_event().
+zx_status_t blobstore_mount(fbl::RefPtr<VnodeBlob>* out, fbl::unique_fd blockfd,
+                            const blobstore_options_t& options, async_t* async,
+                            zx::event memory_warning, zx::event memory_critical);
 
 } // namespace blobstore
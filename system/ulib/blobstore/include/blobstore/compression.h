@@ -0,0 +1,44 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This file contains the chunked LZ4 compression of blob data, shared
+// between host and target implementations of Blobstore.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zircon/types.h>
+
+#include <blobstore/format.h>
+
+namespace blobstore {
+
+// Compresses the |blob_size| bytes at |data| into |out| in the layout
+// described in format.h: a seek table followed by each chunk of the blob
+// compressed on its own. On success, |*out_size| is the number of bytes of
+// |out| which were used.
+//
+// Returns ZX_ERR_BUFFER_TOO_SMALL if the compressed blob doesn't fit in
+// |out_capacity| bytes, in which case the blob should be stored as it is.
+zx_status_t CompressBlob(const void* data, uint64_t blob_size, void* out, size_t out_capacity,
+                         size_t* out_size);
+
+// Decompresses chunk |chunk| of a compressed blob to |out|, which has room
+// for kBlobstoreChunkSize bytes. |seek_table| is the blob's seek table, and
+// |stored| holds the first |stored_size| bytes of the blob's data as it is
+// stored: the seek table and the compressed chunks.
+//
+// Returns ZX_ERR_IO_DATA_INTEGRITY if the seek table or the chunk is corrupt.
+zx_status_t DecompressBlobChunk(const blobstore_inode_t& inode, const uint32_t* seek_table,
+                                const void* stored, size_t stored_size, uint64_t chunk,
+                                void* out);
+
+// Checks that the seek table of a compressed blob is in order and that it
+// fits within the |stored_size| bytes which the blob has on disk.
+zx_status_t CheckSeekTable(const blobstore_inode_t& inode, const uint32_t* seek_table,
+                           size_t stored_size);
+
+} // namespace blobstore
@@ -23,7 +23,7 @@ namespace blobstore {
 
 constexpr uint64_t kBlobstoreMagic0  = (0xac2153479e694d21ULL);
 constexpr uint64_t kBlobstoreMagic1  = (0x985000d4d4d3d314ULL);
-constexpr uint32_t kBlobstoreVersion = 0x00000004;
+constexpr uint32_t kBlobstoreVersion = 0x00000005;
 
 constexpr uint32_t kBlobstoreFlagClean      = 1;
 constexpr uint32_t kBlobstoreFlagDirty      = 2;
@@ -108,13 +108,17 @@ constexpr uint64_t kStartBlockFree     = 0;
 constexpr uint64_t kStartBlockReserved = 1;
 constexpr uint64_t kStartBlockMinimum  = 2; // Smallest 'data' block possible
 
+// Flags of a blobstore_inode_t.
+constexpr uint32_t kBlobstoreInodeFlagLZ4 = 1; // Data is stored as compressed chunks
+
 using digest::Digest;
 typedef struct {
     uint8_t  merkle_root_hash[Digest::kLength];
     uint64_t start_block;
     uint64_t num_blocks;
     uint64_t blob_size;
-    uint64_t reserved;
+    uint32_t flags;
+    uint32_t reserved;
 } blobstore_inode_t;
 
 static_assert(sizeof(blobstore_inode_t) == kBlobstoreInodeSize,
@@ -122,9 +126,26 @@ static_assert(sizeof(blobstore_inode_t) == kBlobstoreInodeSize,
 static_assert(kBlobstoreBlockSize % kBlobstoreInodeSize == 0,
               "Blobstore Inodes should fit cleanly within a blobstore block");
 
-// Number of blocks reserved for the blob itself
+// Number of blocks the blob's data takes up once it is uncompressed
 constexpr uint64_t BlobDataBlocks(const blobstore_inode_t& blobNode) {
     return fbl::round_up(blobNode.blob_size, kBlobstoreBlockSize) / kBlobstoreBlockSize;
 }
 
+// Compressed blobs (kBlobstoreInodeFlagLZ4) split their data into chunks of
+// kBlobstoreChunkSize bytes, the last of which may be shorter, and compress
+// each one on its own with LZ4 so that any chunk can be read back without the
+// ones before it. After the Merkle tree, which still covers the uncompressed
+// data, come a seek table of one uint32_t per chunk and then the compressed
+// chunks. Entry i of the seek table is the offset at which chunk i ends, in
+// bytes from the start of the seek table; chunk 0 starts right after it.
+constexpr uint64_t kBlobstoreChunkSize = 16 * kBlobstoreBlockSize;
+
+constexpr uint64_t BlobChunkCount(const blobstore_inode_t& blobNode) {
+    return fbl::round_up(blobNode.blob_size, kBlobstoreChunkSize) / kBlobstoreChunkSize;
+}
+
+constexpr uint64_t BlobSeekTableSize(const blobstore_inode_t& blobNode) {
+    return BlobChunkCount(blobNode) * sizeof(uint32_t);
+}
+
 } // namespace blobstore
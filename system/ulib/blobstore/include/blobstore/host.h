@@ -80,11 +80,18 @@ public:
     // Allocate |nblocks| starting at |*blkno_out| in memory
     zx_status_t AllocateBlocks(size_t nblocks, size_t* blkno_out);
 
-    zx_status_t WriteData(blobstore_inode_t* inode, void* merkle_data, void* blob_data);
+    // Writes the Merkle tree and the |data_size| bytes of |blob_data| which are
+    // stored for |inode|: the blob itself, or its compressed form.
+    zx_status_t WriteData(blobstore_inode_t* inode, const void* merkle_data,
+                          const void* blob_data, size_t data_size);
     zx_status_t WriteBitmap(size_t nblocks, size_t start_block);
     zx_status_t WriteNode(fbl::unique_ptr<InodeBlock> ino_block);
     zx_status_t WriteInfo();
 
+    // Chooses whether blobs added from now on are compressed.
+    void SetCompression(bool compress) { compress_ = compress; }
+    bool compress() const { return compress_; }
+
 private:
     typedef struct {
         size_t bno;
@@ -111,6 +118,7 @@ private:
     zx_status_t ResetCache();
 
     RawBitmap block_map_{};
+    bool compress_{};
 
     fbl::unique_fd blockfd_;
     bool dirty_;
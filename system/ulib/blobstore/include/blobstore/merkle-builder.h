@@ -0,0 +1,105 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#ifndef __Fuchsia__
+#error Fuchsia-only Header
+#endif
+
+#include <threads.h>
+
+#include <digest/digest.h>
+#include <digest/merkle-tree.h>
+#include <fbl/array.h>
+#include <fbl/intrusive_double_list.h>
+#include <fbl/macros.h>
+#include <fbl/mutex.h>
+#include <fbl/unique_ptr.h>
+#include <zircon/thread_annotations.h>
+#include <zircon/types.h>
+
+namespace blobstore {
+
+class HashPool;
+
+// Builds the Merkle tree of a blob on a HashPool as its data is written, so
+// that the tree is ready soon after the last write, and blobs written at the
+// same time are hashed in parallel rather than one after another on the
+// dispatch thread.
+//
+// The data handed to Append() must stay where it is, unmodified, until
+// Finish() or Abandon() returns.
+class MerkleBuilder : public fbl::DoublyLinkedListable<MerkleBuilder*> {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(MerkleBuilder);
+    explicit MerkleBuilder(HashPool* pool) : pool_(pool) {}
+    ~MerkleBuilder();
+
+    // Prepares to build |tree| (at least GetTreeLength(|data_len|) bytes) for
+    // the |data_len| bytes at |data|.
+    zx_status_t Start(const void* data, size_t data_len, void* tree, size_t tree_len);
+
+    // Marks the first |len| bytes of the data as written, letting the pool
+    // hash them.
+    void Append(size_t len);
+
+    // Waits for all the data to be hashed, and completes the tree.
+    zx_status_t Finish(digest::Digest* out);
+
+    // Stops hashing, waiting for any hashing in progress to stop touching the
+    // data. The builder may be started again afterwards.
+    void Abandon();
+
+private:
+    friend class HashPool;
+
+    HashPool* const pool_;
+    digest::MerkleTree tree_;
+    const uint8_t* data_ = nullptr;
+    void* tree_data_ = nullptr;
+
+    // Guarded by the pool's lock.
+    size_t written_ = 0;
+    size_t hashed_ = 0;
+    bool queued_ = false;
+    bool abandoned_ = false;
+    zx_status_t status_ = ZX_OK;
+};
+
+// A set of worker threads which hash data for MerkleBuilders. Each builder is
+// worked on by one thread at a time, in order; different builders are worked
+// on at the same time.
+class HashPool {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(HashPool);
+    HashPool() = default;
+    ~HashPool();
+
+    // Starts up to |threads| worker threads.
+    static zx_status_t Create(uint32_t threads, fbl::unique_ptr<HashPool>* out);
+
+private:
+    friend class MerkleBuilder;
+
+    static int WorkerThread(void* arg);
+
+    // Queues |builder| to be worked on, if it isn't already.
+    void QueueLocked(MerkleBuilder* builder) __TA_REQUIRES(lock_);
+
+    // Waits until |builder| is no longer queued or being worked on.
+    void WaitIdleLocked(MerkleBuilder* builder) __TA_REQUIRES(lock_);
+
+    fbl::Mutex lock_;
+    // Signalled when there is work queued, or the pool is shutting down.
+    cnd_t work_cvar_;
+    // Signalled when a builder goes idle.
+    cnd_t idle_cvar_;
+    fbl::DoublyLinkedList<MerkleBuilder*> queue_ __TA_GUARDED(lock_);
+    bool stopping_ __TA_GUARDED(lock_) = false;
+    fbl::Array<thrd_t> threads_;
+    size_t thread_count_ = 0;
+};
+
+} // namespace blobstore
@@ -0,0 +1,174 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <threads.h>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/auto_lock.h>
+#include <trace/event.h>
+#include <zircon/assert.h>
+
+#include <blobstore/merkle-builder.h>
+
+using digest::Digest;
+
+namespace blobstore {
+
+MerkleBuilder::~MerkleBuilder() {
+    Abandon();
+}
+
+zx_status_t MerkleBuilder::Start(const void* data, size_t data_len, void* tree,
+                                 size_t tree_len) {
+    fbl::AutoLock lock(&pool_->lock_);
+    ZX_DEBUG_ASSERT(!queued_);
+    zx_status_t status = tree_.CreateInit(data_len, tree_len);
+    if (status != ZX_OK) {
+        return status;
+    }
+    data_ = static_cast<const uint8_t*>(data);
+    tree_data_ = tree;
+    written_ = 0;
+    hashed_ = 0;
+    abandoned_ = false;
+    status_ = ZX_OK;
+    return ZX_OK;
+}
+
+void MerkleBuilder::Append(size_t len) {
+    fbl::AutoLock lock(&pool_->lock_);
+    ZX_DEBUG_ASSERT(len >= written_);
+    written_ = len;
+    if (!abandoned_) {
+        pool_->QueueLocked(this);
+    }
+}
+
+zx_status_t MerkleBuilder::Finish(Digest* out) {
+    TRACE_DURATION("blobstore", "MerkleBuilder::Finish");
+    {
+        fbl::AutoLock lock(&pool_->lock_);
+        pool_->WaitIdleLocked(this);
+        if (status_ != ZX_OK) {
+            return status_;
+        }
+        ZX_DEBUG_ASSERT(hashed_ == written_);
+    }
+    return tree_.CreateFinal(tree_data_, out);
+}
+
+void MerkleBuilder::Abandon() {
+    fbl::AutoLock lock(&pool_->lock_);
+    abandoned_ = true;
+    pool_->WaitIdleLocked(this);
+    data_ = nullptr;
+    tree_data_ = nullptr;
+}
+
+zx_status_t HashPool::Create(uint32_t threads, fbl::unique_ptr<HashPool>* out) {
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<HashPool> pool(new (&ac) HashPool());
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    pool->threads_.reset(new (&ac) thrd_t[threads], threads);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    if (cnd_init(&pool->work_cvar_) != thrd_success) {
+        return ZX_ERR_NO_RESOURCES;
+    } else if (cnd_init(&pool->idle_cvar_) != thrd_success) {
+        return ZX_ERR_NO_RESOURCES;
+    }
+
+    // Make do with however many threads could be started, as long as there
+    // is at least one.
+    for (uint32_t i = 0; i < threads; i++) {
+        if (thrd_create_with_name(&pool->threads_[i], HashPool::WorkerThread, pool.get(),
+                                  "blobstore-hash") != thrd_success) {
+            break;
+        }
+        pool->thread_count_++;
+    }
+    if (pool->thread_count_ == 0) {
+        return ZX_ERR_NO_RESOURCES;
+    }
+
+    *out = fbl::move(pool);
+    return ZX_OK;
+}
+
+HashPool::~HashPool() {
+    if (thread_count_ > 0) {
+        {
+            fbl::AutoLock lock(&lock_);
+            stopping_ = true;
+            cnd_broadcast(&work_cvar_);
+        }
+        for (size_t i = 0; i < thread_count_; i++) {
+            thrd_join(threads_[i], nullptr);
+        }
+    }
+    ZX_DEBUG_ASSERT(queue_.is_empty());
+}
+
+void HashPool::QueueLocked(MerkleBuilder* builder) {
+    if (!builder->queued_) {
+        builder->queued_ = true;
+        queue_.push_back(builder);
+        cnd_signal(&work_cvar_);
+    }
+}
+
+void HashPool::WaitIdleLocked(MerkleBuilder* builder) {
+    while (builder->queued_) {
+        cnd_wait(&idle_cvar_, lock_.GetInternal());
+    }
+}
+
+int HashPool::WorkerThread(void* arg) {
+    HashPool* pool = reinterpret_cast<HashPool*>(arg);
+
+    pool->lock_.Acquire();
+    while (true) {
+        while (pool->queue_.is_empty() && !pool->stopping_) {
+            cnd_wait(&pool->work_cvar_, pool->lock_.GetInternal());
+        }
+        if (pool->queue_.is_empty()) {
+            pool->lock_.Release();
+            return 0;
+        }
+
+        // The builder stays marked as queued while it is worked on, so that
+        // no other thread picks it up and nobody waiting on it goes ahead.
+        MerkleBuilder* builder = pool->queue_.pop_front();
+        if (!builder->abandoned_ && builder->status_ == ZX_OK) {
+            const size_t start = builder->hashed_;
+            const size_t end = builder->written_;
+            pool->lock_.Release();
+            zx_status_t status;
+            {
+                TRACE_DURATION("blobstore", "HashPool::Hash", "len", end - start);
+                status = builder->tree_.CreateUpdate(builder->data_ + start, end - start,
+                                                     builder->tree_data_);
+            }
+            pool->lock_.Acquire();
+            builder->hashed_ = end;
+            if (status != ZX_OK) {
+                builder->status_ = status;
+            }
+        }
+
+        if (!builder->abandoned_ && builder->status_ == ZX_OK &&
+            builder->written_ > builder->hashed_) {
+            // More was written while this thread was hashing.
+            pool->queue_.push_back(builder);
+        } else {
+            builder->queued_ = false;
+            cnd_broadcast(&pool->idle_cvar_);
+        }
+    }
+}
+
+} // namespace blobstore
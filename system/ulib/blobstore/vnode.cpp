@@ -31,11 +31,10 @@ namespace blobstore {
 VnodeBlob::~VnodeBlob() {
     blobstore_->ReleaseBlob(this);
     if (blob_ != nullptr) {
-        block_fifo_request_t request;
-        request.txnid = blobstore_->TxnId();
-        request.vmoid = vmoid_;
-        request.opcode = BLOCKIO_CLOSE_VMO;
-        blobstore_->Txn(&request, 1);
+        blobstore_->DetachVmo(vmoid_);
+    }
+    if (compressed_ != nullptr) {
+        blobstore_->DetachVmo(compressed_vmoid_);
     }
 }
 
@@ -130,6 +129,23 @@ zx_status_t VnodeBlob::Getattr(vnattr_t* a) {
     return ZX_OK;
 }
 
+bool VnodeBlob::CanDispatchConcurrently(uint32_t op) {
+    switch (op) {
+    case ZXRIO_READ:
+    case ZXRIO_READ_AT:
+    case ZXRIO_READ_VMO:
+    case ZXRIO_READ_AT_VMO:
+        // Readable blobs never change; reads of one blob serialize among
+        // themselves while they bring its data in.
+        return !IsDirectory() && GetState() == kBlobStateReadable;
+    case ZXRIO_STAT:
+    case ZXRIO_SEEK:
+        return true;
+    default:
+        return false;
+    }
+}
+
 zx_status_t VnodeBlob::Create(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece name, uint32_t mode) {
     TRACE_DURATION("blobstore", "VnodeBlob::Create", "name", name, "mode", mode);
     assert(memchr(name.data(), '/', name.length()) == nullptr);
@@ -232,6 +248,22 @@ zx_status_t VnodeBlob::Unlink(fbl::StringPiece name, bool must_be_dir) {
     return ZX_OK;
 }
 
+zx_status_t VnodeBlob::Close() {
+    if (!IsDirectory() && GetState() == kBlobStateReadable && !DeletionQueued()) {
+        // Most of what a closed blob holds on to is the data which has been
+        // read in and verified.
+        size_t bytes = sizeof(*this);
+        if (blob_ != nullptr) {
+            bytes += blob_->GetSize();
+        }
+        if (compressed_ != nullptr) {
+            bytes += compressed_->GetSize();
+        }
+        blobstore_->vnode_cache_.Retain(fbl::RefPtr<VnodeBlob>(this), bytes);
+    }
+    return ZX_OK;
+}
+
 zx_status_t VnodeBlob::Mmap(int flags, size_t len, size_t* off, zx_handle_t* out) {
     TRACE_DURATION("blobstore", "VnodeBlob::Mmap", "flags", flags, "len", len, "off", off);
 
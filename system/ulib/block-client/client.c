@@ -3,11 +3,14 @@
 // found in the LICENSE file.
 
 #include <assert.h>
+#include <threads.h>
 #include <unistd.h>
 
 #include <zircon/compiler.h>
 #include <zircon/device/block.h>
+#include <zircon/process.h>
 #include <zircon/syscalls.h>
+#include <zircon/syscalls/fifo.h>
 #include <sync/completion.h>
 
 #include "block-client/client.h"
@@ -69,14 +72,78 @@ typedef struct block_completion {
 typedef struct fifo_client {
     zx_handle_t fifo;
     block_completion_t txns[MAX_TXN_COUNT];
+
+    // Set when the server's fifo can be mapped, see <zircon/syscalls/fifo.h>.
+    // Requests are then queued straight into the ring, and the kernel is only
+    // entered to wake the server when it is waiting for them.
+    uintptr_t ring_mapping;
+    zx_fifo_ring_t* tx_ring;
+    block_fifo_request_t* tx_slots;
+    mtx_t tx_lock;
 } fifo_client_t;
 
+static_assert((BLOCK_FIFO_MAX_DEPTH & (BLOCK_FIFO_MAX_DEPTH - 1)) == 0, "");
+
+static void map_ring(fifo_client_t* client) {
+    zx_handle_t vmo;
+    uint32_t index;
+    if (zx_fifo_get_ring(client->fifo, &vmo, &index) != ZX_OK) {
+        return;
+    }
+    uintptr_t addr;
+    zx_status_t status = zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, ZX_FIFO_RING_VMO_SIZE,
+                                     ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE, &addr);
+    zx_handle_close(vmo);
+    if (status != ZX_OK) {
+        return;
+    }
+    client->ring_mapping = addr;
+    client->tx_ring = (zx_fifo_ring_t*)(addr + ZX_FIFO_RING_HEADER_OFFSET(index));
+    client->tx_slots = (block_fifo_request_t*)(addr + ZX_FIFO_RING_DATA_OFFSET(index));
+}
+
+// Queues requests into the mapped ring, waking the server if it is waiting
+// for them. Whatever does not fit goes through the syscall, which waits for
+// the server to make room; the lock keeps the kernel and this process from
+// producing into the ring at the same time.
+static zx_status_t ring_write(fifo_client_t* client, block_fifo_request_t* request,
+                              size_t count) {
+    zx_fifo_ring_t* ring = client->tx_ring;
+
+    mtx_lock(&client->tx_lock);
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    uint32_t used = head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    size_t avail = (used >= BLOCK_FIFO_MAX_DEPTH) ? 0 : BLOCK_FIFO_MAX_DEPTH - used;
+    size_t n = (count > avail) ? avail : count;
+    for (size_t i = 0; i < n; i++) {
+        client->tx_slots[(head + i) & (BLOCK_FIFO_MAX_DEPTH - 1)] = request[i];
+    }
+
+    zx_status_t status = ZX_OK;
+    if (n > 0) {
+        // Publish before looking at the waiter bits; the server sets its bit
+        // before checking the ring a last time.
+        __atomic_store_n(&ring->head, head + (uint32_t)n, __ATOMIC_SEQ_CST);
+        if (__atomic_fetch_and(&ring->waiters, ~ZX_FIFO_RING_READER_WAITING,
+                               __ATOMIC_SEQ_CST) & ZX_FIFO_RING_READER_WAITING) {
+            status = zx_fifo_ring_update(client->fifo);
+        }
+    }
+    if (status == ZX_OK && n < count) {
+        status = do_write(client->fifo, &request[n], count - n);
+    }
+    mtx_unlock(&client->tx_lock);
+    return status;
+}
+
 zx_status_t block_fifo_create_client(zx_handle_t fifo, fifo_client_t** out) {
     fifo_client_t* client = calloc(sizeof(fifo_client_t), 1);
     if (client == NULL) {
         return ZX_ERR_NO_MEMORY;
     }
     client->fifo = fifo;
+    mtx_init(&client->tx_lock, mtx_plain);
+    map_ring(client);
     *out = client;
     return ZX_OK;
 }
@@ -86,6 +153,10 @@ void block_fifo_release_client(fifo_client_t* client) {
         return;
     }
 
+    if (client->ring_mapping) {
+        zx_vmar_unmap(zx_vmar_root_self(), client->ring_mapping, ZX_FIFO_RING_VMO_SIZE);
+    }
+    mtx_destroy(&client->tx_lock);
     zx_handle_close(client->fifo);
     free(client);
 }
@@ -108,7 +179,12 @@ zx_status_t block_fifo_txn(fifo_client_t* client, block_fifo_request_t* requests
         requests[i].opcode = (requests[i].opcode & BLOCKIO_OP_MASK) |
                              (i == count - 1 ? BLOCKIO_TXN_END : 0);
     }
-    if ((status = do_write(client->fifo, &requests[0], count)) != ZX_OK) {
+    if (client->tx_ring) {
+        status = ring_write(client, requests, count);
+    } else {
+        status = do_write(client->fifo, &requests[0], count);
+    }
+    if (status != ZX_OK) {
         return status;
     }
 
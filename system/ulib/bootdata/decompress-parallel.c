@@ -0,0 +1,164 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <bootdata/decompress.h>
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include <lz4/lz4.h>
+
+#include "decompress-private.h"
+
+typedef struct {
+    const uint8_t* data;
+    // Block size word from the frame; the high bit marks uncompressed data.
+    uint32_t size;
+} lz4_block_t;
+
+typedef struct {
+    const lz4_block_t* blocks;
+    size_t count;
+    uint8_t* dst;
+    size_t content_size;
+
+    atomic_size_t next;
+    // Cleared if any block is corrupt or doesn't fill its slot.
+    atomic_bool ok;
+} parallel_state_t;
+
+// Each thread takes the next block until there are none left. Block |i|
+// decompresses to offset |i| * ZX_LZ4_BLOCK_MAX_SIZE, so no thread needs to
+// know how much any other block produced.
+static int decompress_thread(void* arg) {
+    parallel_state_t* state = arg;
+    for (;;) {
+        size_t i = atomic_fetch_add(&state->next, 1);
+        if (i >= state->count || !atomic_load(&state->ok)) {
+            break;
+        }
+        const lz4_block_t* block = &state->blocks[i];
+        size_t offset = i * ZX_LZ4_BLOCK_MAX_SIZE;
+        size_t expected = state->content_size - offset;
+        if (expected > ZX_LZ4_BLOCK_MAX_SIZE) {
+            expected = ZX_LZ4_BLOCK_MAX_SIZE;
+        }
+
+        size_t actual;
+        if (block->size >> 31) {
+            actual = block->size & 0x7fffffff;
+            if (actual == expected) {
+                memcpy(state->dst + offset, block->data, actual);
+            }
+        } else {
+            int dcmp = LZ4_decompress_safe((const char*)block->data,
+                                           (char*)state->dst + offset,
+                                           block->size, expected);
+            actual = dcmp < 0 ? 0 : (size_t)dcmp;
+        }
+        if (actual != expected) {
+            atomic_store(&state->ok, false);
+            break;
+        }
+    }
+    return 0;
+}
+
+static zx_status_t decompress_lz4_blocks_parallel(void* cookie, const uint8_t* data,
+                                                  const uint8_t* end, uint8_t* dst,
+                                                  size_t content_size, size_t outsize,
+                                                  const char** err) {
+    size_t num_threads = *(const size_t*)cookie;
+    size_t count = (content_size + ZX_LZ4_BLOCK_MAX_SIZE - 1) / ZX_LZ4_BLOCK_MAX_SIZE;
+    if (num_threads < 2 || count < 2) {
+        return decompress_lz4_blocks(NULL, data, end, dst, content_size, outsize, err);
+    }
+
+    // Find where each block starts by walking the block size words.
+    lz4_block_t* blocks = malloc(count * sizeof(lz4_block_t));
+    if (blocks == NULL) {
+        *err = "out of memory for lz4 block index";
+        return ZX_ERR_NO_MEMORY;
+    }
+    const uint8_t* p = data;
+    size_t n = 0;
+    uint32_t blocksize;
+    for (;;) {
+        if ((size_t)(end - p) < sizeof(uint32_t)) {
+            free(blocks);
+            *err = "lz4 frame truncated";
+            return ZX_ERR_INVALID_ARGS;
+        }
+        memcpy(&blocksize, p, sizeof(uint32_t));
+        p += sizeof(uint32_t);
+        if (blocksize == 0) {
+            break;
+        }
+        if ((size_t)(end - p) < (blocksize & 0x7fffffff)) {
+            free(blocks);
+            *err = "lz4 frame truncated";
+            return ZX_ERR_INVALID_ARGS;
+        }
+        if (n == count) {
+            break;
+        }
+        blocks[n].data = p;
+        blocks[n].size = blocksize;
+        ++n;
+        p += blocksize & 0x7fffffff;
+    }
+    if (n != count || blocksize != 0) {
+        // Not the number of blocks that full ones would need; they can't be
+        // placed without decompressing them in order.
+        free(blocks);
+        return decompress_lz4_blocks(NULL, data, end, dst, content_size, outsize, err);
+    }
+
+    parallel_state_t state = {
+        .blocks = blocks,
+        .count = count,
+        .dst = dst,
+        .content_size = content_size,
+    };
+    atomic_init(&state.next, 0);
+    atomic_init(&state.ok, true);
+
+    if (num_threads > count) {
+        num_threads = count;
+    }
+    thrd_t* threads = malloc((num_threads - 1) * sizeof(thrd_t));
+    size_t started = 0;
+    for (; threads != NULL && started < num_threads - 1; ++started) {
+        if (thrd_create_with_name(&threads[started], decompress_thread, &state,
+                                  "bootdata-lz4") != thrd_success) {
+            // The threads we have will pick up the slack.
+            break;
+        }
+    }
+    decompress_thread(&state);
+    for (size_t i = 0; i < started; ++i) {
+        thrd_join(threads[i], NULL);
+    }
+    free(threads);
+    free(blocks);
+
+    // A corrupt frame, or one whose blocks aren't all full, gets a second
+    // pass in order, which either copes with the layout or reports the error.
+    if (!atomic_load(&state.ok)) {
+        return decompress_lz4_blocks(NULL, data, end, dst, content_size, outsize, err);
+    }
+    return ZX_OK;
+}
+
+zx_status_t decompress_bootdata_parallel(zx_handle_t vmar, zx_handle_t vmo,
+                                         size_t offset, size_t length,
+                                         size_t num_threads,
+                                         zx_handle_t* out, const char** err) {
+    return decompress_bootdata_with(vmar, vmo, offset, length,
+                                    decompress_lz4_blocks_parallel, &num_threads,
+                                    out, err);
+}
@@ -0,0 +1,41 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#pragma GCC visibility push(hidden)
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zircon/types.h>
+
+// Every block of a compressed bootfs but the last holds exactly this much
+// data, since the frame must use 64kB blocks and the compressor only emits
+// a short block at the end of the frame.
+#define ZX_LZ4_BLOCK_MAX_SIZE (64 * 1024)
+
+// Decompresses the LZ4 frame blocks (everything after the frame descriptor)
+// between |data| and |end| into |dst|, which has room for |outsize| bytes.
+// |content_size| is the size recorded in the frame descriptor.
+typedef zx_status_t (*lz4_blocks_func_t)(void* cookie, const uint8_t* data,
+                                         const uint8_t* end, uint8_t* dst,
+                                         size_t content_size, size_t outsize,
+                                         const char** err);
+
+// Decompresses the blocks one after the other; |cookie| is unused.
+zx_status_t decompress_lz4_blocks(void* cookie, const uint8_t* data,
+                                  const uint8_t* end, uint8_t* dst,
+                                  size_t content_size, size_t outsize,
+                                  const char** err);
+
+// Common implementation of decompress_bootdata() and
+// decompress_bootdata_parallel(), using |decompress_blocks| on the payload.
+zx_status_t decompress_bootdata_with(zx_handle_t vmar, zx_handle_t vmo,
+                                     size_t offset, size_t length,
+                                     lz4_blocks_func_t decompress_blocks,
+                                     void* cookie, zx_handle_t* out,
+                                     const char** err);
+
+#pragma GCC visibility pop
@@ -13,6 +13,8 @@
 
 #include <lz4/lz4.h>
 
+#include "decompress-private.h"
+
 // The LZ4 Frame format is used to compress a bootfs image, but we cannot use
 // the LZ4 library's decompression functions in userboot. The following
 // definitions are used in the reimplementation of LZ4 Frame decompression, with
@@ -85,58 +87,37 @@ static zx_status_t check_lz4_frame(const lz4_frame_desc* fd,
     return ZX_OK;
 }
 
-static zx_status_t decompress_bootfs_vmo(zx_handle_t vmar, const uint8_t* data,
-                                         size_t _outsize, zx_handle_t* out,
-                                         const char** err) {
-    if (*(const uint32_t*)data != ZX_LZ4_MAGIC) {
-        *err = "bad magic number for compressed bootfs";
-        return ZX_ERR_INVALID_ARGS;
-    }
-    data += sizeof(uint32_t);
-
-    check_lz4_frame((const lz4_frame_desc*)data, _outsize, err);
-    data += sizeof(lz4_frame_desc);
-
-    size_t outsize = (_outsize + 4095) & ~4095;
-    if (outsize < _outsize) {
-        // newsize wrapped, which means the outsize was too large
-        *err = "lz4 output size too large";
-        return ZX_ERR_NO_MEMORY;
-    }
-    zx_handle_t dst_vmo;
-    zx_status_t status = zx_vmo_create((uint64_t)outsize, 0, &dst_vmo);
-    if (status < 0) {
-        *err = "zx_vmo_create failed for decompressing bootfs";
-        return status;
-    }
-    zx_object_set_property(dst_vmo, ZX_PROP_NAME, "bootfs", 6);
-
-    uintptr_t dst_addr = 0;
-    status = zx_vmar_map(vmar, 0, dst_vmo, 0, outsize,
-            ZX_VM_FLAG_PERM_READ|ZX_VM_FLAG_PERM_WRITE, &dst_addr);
-    if (status < 0) {
-        *err = "zx_vmar_map failed on bootfs vmo during decompression";
-        return status;
-    }
-
+zx_status_t decompress_lz4_blocks(void* cookie, const uint8_t* data,
+                                  const uint8_t* end, uint8_t* dst,
+                                  size_t content_size, size_t outsize,
+                                  const char** err) {
     size_t remaining = outsize;
-    uint8_t* dst = (uint8_t*)dst_addr;
 
     // Read each LZ4 block and decompress it. Block sizes are 32 bits.
-    uint32_t blocksize = *(const uint32_t*)data;
+    uint32_t blocksize;
+    if ((size_t)(end - data) < sizeof(uint32_t)) {
+        *err = "lz4 frame truncated";
+        return ZX_ERR_INVALID_ARGS;
+    }
+    memcpy(&blocksize, data, sizeof(uint32_t));
     data += sizeof(uint32_t);
     while (blocksize) {
+        // Each block is followed by at least the next block size.
+        if ((size_t)(end - data) < (blocksize & 0x7fffffff) + sizeof(uint32_t)) {
+            *err = "lz4 frame truncated";
+            return ZX_ERR_INVALID_ARGS;
+        }
         // If the data is uncompressed, the high bit is 1.
         if (blocksize >> 31) {
             uint32_t actual = blocksize & 0x7fffffff;
-            memcpy(dst, data, actual);
-            dst += actual;
-            data += actual;
             if (remaining - actual > remaining) {
                 // Remaining wrapped around (would be negative if signed)
                 *err = "bootdata outsize too small for lz4 decompression";
                 return ZX_ERR_INVALID_ARGS;
             }
+            memcpy(dst, data, actual);
+            dst += actual;
+            data += actual;
             remaining -= actual;
         } else {
             int dcmp = LZ4_decompress_safe((const char*)data, (char*)dst, blocksize, remaining);
@@ -154,7 +135,7 @@ static zx_status_t decompress_bootfs_vmo(zx_handle_t vmar, const uint8_t* data,
             remaining -= dcmp;
         }
 
-        blocksize = *(uint32_t*)data;
+        memcpy(&blocksize, data, sizeof(uint32_t));
         data += sizeof(uint32_t);
     }
 
@@ -165,6 +146,58 @@ static zx_status_t decompress_bootfs_vmo(zx_handle_t vmar, const uint8_t* data,
         *err = "bootdata size error; outsize does not match decompressed size";
         return ZX_ERR_INVALID_ARGS;
     }
+    return ZX_OK;
+}
+
+static zx_status_t decompress_bootfs_vmo(zx_handle_t vmar, const uint8_t* data,
+                                         const uint8_t* end, size_t _outsize,
+                                         lz4_blocks_func_t decompress_blocks,
+                                         void* cookie, zx_handle_t* out,
+                                         const char** err) {
+    if ((size_t)(end - data) < sizeof(uint32_t) + sizeof(lz4_frame_desc)) {
+        *err = "lz4 frame truncated";
+        return ZX_ERR_INVALID_ARGS;
+    }
+    if (*(const uint32_t*)data != ZX_LZ4_MAGIC) {
+        *err = "bad magic number for compressed bootfs";
+        return ZX_ERR_INVALID_ARGS;
+    }
+    data += sizeof(uint32_t);
+
+    zx_status_t status = check_lz4_frame((const lz4_frame_desc*)data, _outsize, err);
+    if (status < 0) {
+        return status;
+    }
+    data += sizeof(lz4_frame_desc);
+
+    size_t outsize = (_outsize + 4095) & ~4095;
+    if (outsize < _outsize) {
+        // newsize wrapped, which means the outsize was too large
+        *err = "lz4 output size too large";
+        return ZX_ERR_NO_MEMORY;
+    }
+    zx_handle_t dst_vmo;
+    status = zx_vmo_create((uint64_t)outsize, 0, &dst_vmo);
+    if (status < 0) {
+        *err = "zx_vmo_create failed for decompressing bootfs";
+        return status;
+    }
+    zx_object_set_property(dst_vmo, ZX_PROP_NAME, "bootfs", 6);
+
+    uintptr_t dst_addr = 0;
+    status = zx_vmar_map(vmar, 0, dst_vmo, 0, outsize,
+            ZX_VM_FLAG_PERM_READ|ZX_VM_FLAG_PERM_WRITE, &dst_addr);
+    if (status < 0) {
+        *err = "zx_vmar_map failed on bootfs vmo during decompression";
+        return status;
+    }
+
+    // Decompress straight into the destination VMO.
+    status = decompress_blocks(cookie, data, end, (uint8_t*)dst_addr,
+                               _outsize, outsize, err);
+    if (status < 0) {
+        return status;
+    }
 
     status = zx_vmar_unmap(vmar, dst_addr, outsize);
     if (status < 0) {
@@ -175,9 +208,11 @@ static zx_status_t decompress_bootfs_vmo(zx_handle_t vmar, const uint8_t* data,
     return ZX_OK;
 }
 
-zx_status_t decompress_bootdata(zx_handle_t vmar, zx_handle_t vmo,
-                                size_t offset, size_t length,
-                                zx_handle_t* out, const char** err) {
+zx_status_t decompress_bootdata_with(zx_handle_t vmar, zx_handle_t vmo,
+                                     size_t offset, size_t length,
+                                     lz4_blocks_func_t decompress_blocks,
+                                     void* cookie, zx_handle_t* out,
+                                     const char** err) {
     *err = "none";
 
     if (length > SIZE_MAX) {
@@ -198,13 +233,19 @@ zx_status_t decompress_bootdata(zx_handle_t vmar, zx_handle_t vmo,
 
     const bootdata_t* hdr = (bootdata_t*)bootdata_addr;
     bootdata_addr += sizeof(bootdata_t);
+    const uint8_t* bootdata_end = (const uint8_t*)addr + length;
+    if (hdr->length < (size_t)(bootdata_end - (const uint8_t*)bootdata_addr)) {
+        bootdata_end = (const uint8_t*)bootdata_addr + hdr->length;
+    }
 
     switch (hdr->type) {
     case BOOTDATA_BOOTFS_BOOT:
     case BOOTDATA_BOOTFS_SYSTEM:
     case BOOTDATA_RAMDISK:
         if (hdr->flags & BOOTDATA_BOOTFS_FLAG_COMPRESSED) {
-            status = decompress_bootfs_vmo(vmar, (const uint8_t*)bootdata_addr, hdr->extra, out, err);
+            status = decompress_bootfs_vmo(vmar, (const uint8_t*)bootdata_addr,
+                                           bootdata_end, hdr->extra,
+                                           decompress_blocks, cookie, out, err);
         }
         break;
     default:
@@ -221,3 +262,10 @@ zx_status_t decompress_bootdata(zx_handle_t vmar, zx_handle_t vmo,
 
     return status;
 }
+
+zx_status_t decompress_bootdata(zx_handle_t vmar, zx_handle_t vmo,
+                                size_t offset, size_t length,
+                                zx_handle_t* out, const char** err) {
+    return decompress_bootdata_with(vmar, vmo, offset, length,
+                                    decompress_lz4_blocks, NULL, out, err);
+}
@@ -16,4 +16,13 @@ zx_status_t decompress_bootdata(zx_handle_t vmar, zx_handle_t vmo,
                                 size_t offset, size_t length,
                                 zx_handle_t* out, const char** errmsg);
 
+// Like decompress_bootdata(), but decompresses the LZ4 blocks on up to
+// |num_threads| threads at once, each writing straight into the new VMO.
+// This relies on the blocks being independent, which decompress_bootdata()
+// also requires. Not available in userboot, which cannot create threads.
+zx_status_t decompress_bootdata_parallel(zx_handle_t vmar, zx_handle_t vmo,
+                                         size_t offset, size_t length,
+                                         size_t num_threads,
+                                         zx_handle_t* out, const char** errmsg);
+
 #pragma GCC visibility pop
@@ -29,6 +29,11 @@ using GetFormatsResp = camera_stream_cmd_get_formats_resp_t;
 using SetFormatReq  = camera_stream_cmd_set_format_req_t;
 using SetFormatResp = camera_stream_cmd_set_format_resp_t;
 
+// CAMERA_STREAM_CMD_SET_FRAME_RING
+using SetFrameRingReq  = camera_stream_cmd_set_frame_ring_req_t;
+using SetFrameRingResp = camera_stream_cmd_set_frame_ring_resp_t;
+using FrameNotify      = camera_frame_notify_t;
+
 // CAMERA_RB_CMD_GET_DATA_BUFFER
 using RingBufGetDataBufferReq  = camera_rb_cmd_get_data_buffer_req_t;
 using RingBufGetDataBufferResp = camera_rb_cmd_get_data_buffer_resp_t;
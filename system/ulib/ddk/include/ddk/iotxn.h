@@ -38,6 +38,9 @@ typedef struct iotxn iotxn_t;
 // opcodes
 #define IOTXN_OP_READ      1
 #define IOTXN_OP_WRITE     2
+// Discards the |length| bytes at |offset| (block devices reporting
+// BLOCK_FLAG_TRIM_SUPPORT only). Trims move no data and have no vmo.
+#define IOTXN_OP_TRIM      3
 
 // cache maintenance ops
 #define IOTXN_CACHE_INVALIDATE        ZX_VMO_OP_CACHE_INVALIDATE
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <assert.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <zircon/device/block.h>
 
@@ -45,7 +46,10 @@ struct block_op {
         // BLOCK_OP_TRIM
         struct {
             uint32_t command;            // command and flags
-            // ???
+            uint32_t extra;              // available for temporary use
+            zx_handle_t unused;          // laid out like rw, which has a vmo here
+            uint32_t length;             // blocks to discard (0 is invalid)
+            uint64_t offset_dev;         // device offset in blocks
         } trim;
     };
 
@@ -57,6 +61,10 @@ struct block_op {
 };
 
 static_assert(sizeof(block_op_t) == 56, "");
+// Drivers which only look at the extent of an op may use the rw fields for
+// either kind.
+static_assert(offsetof(block_op_t, trim.length) == offsetof(block_op_t, rw.length), "");
+static_assert(offsetof(block_op_t, trim.offset_dev) == offsetof(block_op_t, rw.offset_dev), "");
 
 typedef struct block_protocol_ops {
     // Obtain the parameters of the block device (block_info_t) and
@@ -93,7 +101,9 @@ typedef struct block_protocol {
 // and later operations will not start until it is done.
 #define BLOCK_OP_FLUSH               0x00000003
 
-// TBD
+// Discard the blocks described by u.trim, which hold no data anyone
+// needs. Reads of them return unspecified data until they are written
+// again. Only sent to devices which report BLOCK_FLAG_TRIM_SUPPORT.
 #define BLOCK_OP_TRIM                0x00000004
 
 #define BLOCK_OP_MASK                0x000000FF
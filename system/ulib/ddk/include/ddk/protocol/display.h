@@ -17,6 +17,11 @@ __BEGIN_CDECLS;
 
 typedef void (*zx_display_cb_t)(bool acquired, void* cookie);
 
+typedef void (*zx_display_present_cb_t)(uint64_t image_id, zx_time_t timestamp, void* cookie);
+
+// Cursor images are DISPLAY_CURSOR_SIZE pixels square (see
+// zircon/device/display.h), in the ZX_PIXEL_FORMAT_ARGB_8888 format.
+
 typedef struct display_protocol_ops {
     // sets the display mode
     zx_status_t (*set_mode)(void* ctx, zx_display_info_t* info);
@@ -30,6 +35,10 @@ typedef struct display_protocol_ops {
     // flushes the framebuffer
     void (*flush)(void* ctx);
 
+    // Optional. Flushes a region of the framebuffer.  Displays without it
+    // get flush() instead.
+    void (*flush_region)(void* ctx, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
     // Controls ownership of the display between multiple display clients.
     // Useful for switching to and from the gfxconsole.
     // If the framebuffer is visible, release ownership of the display and
@@ -44,6 +53,41 @@ typedef struct display_protocol_ops {
     // The provided callback will be invoked with a value of true if the display
     // has been acquired, false if it has been released.
     void (*set_ownership_change_callback)(void* ctx, zx_display_cb_t callback, void* cookie);
+
+    // The following are optional, for displays that can scan out of client
+    // memory and flip between images at vblank.
+
+    // Imports a vmo holding one frame in the current mode as an image and
+    // returns its id, which is never 0.  Takes ownership of |vmo|.
+    zx_status_t (*import_vmo)(void* ctx, zx_handle_t vmo, uint64_t* image_id_out);
+
+    // Releases an imported image.  If it is on screen or pending, the display
+    // goes back to its own framebuffer.
+    void (*release_image)(void* ctx, uint64_t image_id);
+
+    // Flips to an image at the next vblank.  Image id 0 is the display's own
+    // framebuffer.
+    zx_status_t (*present_image)(void* ctx, uint64_t image_id);
+
+    // Registers a callback to be invoked, from the driver's interrupt
+    // thread, when a presented image reaches the screen.
+    void (*set_present_callback)(void* ctx, zx_display_present_cb_t callback, void* cookie);
+
+    // Optional. Sets the hardware cursor image, or hides the cursor if
+    // |pixels| is NULL.
+    zx_status_t (*set_cursor)(void* ctx, const void* pixels, uint32_t hot_x, uint32_t hot_y);
+
+    // Optional. Moves the hotspot of the hardware cursor to (x, y).
+    void (*move_cursor)(void* ctx, int32_t x, int32_t y);
+
+    // Optional. Shows the top left |width| by |height| pixels of an
+    // imported image at (x, y) on overlay plane |overlay|, or hides the
+    // overlay if |image_id| is 0.  Overlays are stacked in order above the
+    // image presented with present_image(), and take effect with it at the
+    // next vblank.  Returns ZX_ERR_OUT_OF_RANGE for an overlay the display
+    // doesn't have.
+    zx_status_t (*set_overlay)(void* ctx, uint32_t overlay, uint64_t image_id,
+                               uint32_t x, uint32_t y, uint32_t width, uint32_t height);
 } display_protocol_ops_t;
 
 typedef struct zx_display_protocol {
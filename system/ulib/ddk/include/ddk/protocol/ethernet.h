@@ -16,9 +16,10 @@ __BEGIN_CDECLS;
 // The ethermac interface supports both synchronous and asynchronous transmissions using the
 // proto->queue_tx() and ifc->complete_tx() methods.
 //
-// Receive operations are supported with the ifc->recv() interface.
-// TODO: implement netbuf-based receive operations by implementing proto->queue_rx() and
-// ifc->complete_rx()
+// Receive operations are supported with the ifc->recv() interface, which hands the generic
+// ethernet driver a buffer owned by the ethmac driver to copy from.  A FEATURE_DMA device may
+// also implement proto->queue_rx(), in which case it is handed buffers in a client's io buffer
+// to receive into directly and returns them with ifc->complete_rx().
 //
 // The FEATURE_WLAN flag indicates a device that supports wlan operations.
 //
@@ -26,17 +27,35 @@ __BEGIN_CDECLS;
 //
 // The FEATURE_DMA flag indicates that the device can copy the buffer data using DMA and will ensure
 // that physical addresses are provided in netbufs.
+//
+// A device with more than one hardware queue pair reports |queue_count| and hands received
+// packets to ifc->recv_hashed() along with the receive-side-scaling hash of the packet's flow,
+// possibly from one thread per queue at the same time.  The generic ethernet driver steers each
+// packet to a client queue by that hash, and tells queue_tx() which queue a packet came from with
+// ETHMAC_TX_OPT_QUEUE().
+//
+// The TX_CSUM, TSO, RX_CSUM and LRO flags advertise checksum and segmentation offloads.  The
+// generic ethernet driver parses the headers of each frame that asks for an offload and describes
+// it in the netbuf; see ETHMAC_NETBUF_CSUM.  A device with RX_CSUM passes ETHMAC_RECV_CSUM_OK for
+// packets whose TCP/UDP checksum it has verified, and one with LRO merges received segments only
+// while ETHMAC_SETPARAM_LRO is on.
 
 #define ETHMAC_FEATURE_WLAN     (1u)
 #define ETHMAC_FEATURE_SYNTH    (2u)
 #define ETHMAC_FEATURE_DMA      (4u)
+#define ETHMAC_FEATURE_TX_CSUM  (8u)
+#define ETHMAC_FEATURE_RX_CSUM  (0x10u)
+#define ETHMAC_FEATURE_TSO      (0x20u)
+#define ETHMAC_FEATURE_LRO      (0x40u)
 
 typedef struct ethmac_info {
     uint32_t features;
     uint32_t mtu;
     uint8_t mac[ETH_MAC_SIZE];
     uint8_t reserved0[2];
-    uint32_t reserved1[4];
+    // number of hardware queue pairs; 0 is the same as 1
+    uint32_t queue_count;
+    uint32_t reserved1[3];
 } ethmac_info_t;
 
 typedef struct ethmac_netbuf {
@@ -47,6 +66,12 @@ typedef struct ethmac_netbuf {
     uint16_t reserved;
     uint32_t flags;
 
+    // Offload requests, valid with ETHMAC_NETBUF_CSUM or ETHMAC_NETBUF_TSO_* in |flags|
+    uint16_t csum_start;   // offset of the TCP/UDP header
+    uint16_t csum_offset;  // offset of the checksum field from csum_start
+    uint16_t hdr_len;      // length of all headers, repeated in each segment
+    uint16_t mss;          // TCP payload bytes per segment
+
     // Shared between the generic ethernet and ethmac drivers
     list_node_t node;
 
@@ -57,6 +82,17 @@ typedef struct ethmac_netbuf {
     };
 } ethmac_netbuf_t;
 
+// netbuf flags.  With CSUM, the device stores the one's complement checksum of the bytes from
+// csum_start to the end of the frame at csum_start + csum_offset; the field already holds the
+// pseudo-header sum.  TSO_V4 and TSO_V6 imply CSUM: the frame is split into segments of |mss|
+// payload bytes, each with a copy of the first |hdr_len| bytes, fixed up as a TCP stack would.
+#define ETHMAC_NETBUF_CSUM      (1u)
+#define ETHMAC_NETBUF_TSO_V4    (2u)
+#define ETHMAC_NETBUF_TSO_V6    (4u)
+
+// recv() flags
+#define ETHMAC_RECV_CSUM_OK     (1u)  // the TCP/UDP checksum was verified
+
 typedef struct ethmac_ifc_virt {
     void (*status)(void* cookie, uint32_t status);
 
@@ -64,12 +100,24 @@ typedef struct ethmac_ifc_virt {
 
     // complete_tx() is called to return ownership of a netbuf to the generic ethernet driver.
     void (*complete_tx)(void* cookie, ethmac_netbuf_t* netbuf, zx_status_t status);
+
+    // Like recv(), for a packet whose flow hashes to |hash|.
+    void (*recv_hashed)(void* cookie, void* data, size_t length, uint32_t flags, uint32_t hash);
+
+    // complete_rx() returns a netbuf passed to queue_rx(), holding a packet of |length| bytes
+    // if |status| is ZX_OK.  The device sets netbuf->flags to the recv() flags for the packet.
+    void (*complete_rx)(void* cookie, ethmac_netbuf_t* netbuf, size_t length, zx_status_t status);
 } ethmac_ifc_t;
 
 // Indicates that additional data is available to be sent after this call finishes. Allows a ethmac
 // driver to batch tx to hardware if possible.
 #define ETHMAC_TX_OPT_MORE (1u)
 
+// The client queue a packet was sent on, which a device with several hardware queues may use to
+// pick a tx ring.
+#define ETHMAC_TX_OPT_QUEUE(q) ((uint32_t)(q) << 8)
+#define ETHMAC_TX_OPT_QUEUE_INDEX(opts) (((opts) >> 8) & 0xffu)
+
 // SETPARAM_ values identify the parameter to set. Each call to set_param()
 // takes an int32_t |value| and void* |data| which have meaning specific to
 // the parameter being set.
@@ -77,6 +125,15 @@ typedef struct ethmac_ifc_virt {
 // |value| param = bool. |data| param = unused.
 #define ETHMAC_SETPARAM_PROMISC (1u)
 
+// Return every netbuf queued with queue_rx() through complete_rx(), with ZX_ERR_CANCELED for
+// those not yet filled, before returning.
+// |value| param = unused. |data| param = unused.
+#define ETHMAC_SETPARAM_RX_FLUSH (2u)
+
+// Merge received TCP segments, for an ETHMAC_FEATURE_LRO device.
+// |value| param = bool. |data| param = unused.
+#define ETHMAC_SETPARAM_LRO (3u)
+
 // The ethernet midlayer will never call ethermac_protocol
 // methods from multiple threads simultaneously, but it
 // can call send() methods at the same time as non-send
@@ -88,6 +145,7 @@ typedef struct ethmac_protocol_ops {
 
     // Shut down a running ethermac
     // Safe to call if the ethermac is already stopped.
+    // Any netbufs queued with queue_rx() are returned before this returns.
     void (*stop)(void* ctx);
 
     // Start ethermac running with ifc_virt
@@ -117,6 +175,15 @@ typedef struct ethmac_protocol_ops {
     // set_param() may be called at any time after start() is called including from multiple threads
     // simultaneously.
     zx_status_t (*set_param)(void* ctx, uint32_t param, int32_t value, void* data);
+
+    // Optional.  Offer a buffer for receiving one packet of up to netbuf->len bytes into
+    // netbuf->phys.  The driver takes ownership of the netbuf and must return it with
+    // complete_rx(), never from within queue_rx().  From the first queue_rx() until the next
+    // stop() or ETHMAC_SETPARAM_RX_FLUSH, the device receives only into queued netbufs, in the
+    // order they were queued, and not through recv() or recv_hashed().
+    //
+    // queue_rx() is only called between start() and stop(), from one thread at a time.
+    zx_status_t (*queue_rx)(void* ctx, ethmac_netbuf_t* netbuf);
 } ethmac_protocol_ops_t;
 
 typedef struct ethmac_protocol {
@@ -93,6 +93,8 @@ typedef struct usb_request {
 typedef struct {
     list_node_t free_reqs;
     mtx_t lock;
+    // backing storage created by usb_request_pool_alloc()
+    list_node_t blocks;
 } usb_request_pool_t;
 
 // usb_request_alloc() creates a new usb request with payload space of data_size.
@@ -171,4 +173,18 @@ void usb_request_pool_add(usb_request_pool_t* pool, usb_request_t* req);
 // The request is not re-initialized in any way and should be set accordingly by the user.
 usb_request_t* usb_request_pool_get(usb_request_pool_t* pool, size_t length);
 
+// usb_request_pool_alloc() preallocates |count| requests with payload space of
+// |data_size| and adds them to the pool. The payloads are carved out of a single
+// VMO that is committed, mapped and physmapped once, so getting a request from
+// the pool, queueing it and adding it back never makes a syscall or allocates.
+// usb_request_release() is a no-op for these requests; their memory is freed by
+// usb_request_pool_release().
+zx_status_t usb_request_pool_alloc(usb_request_pool_t* pool, size_t count, uint64_t data_size,
+                                   uint8_t ep_address);
+
+// usb_request_pool_release() releases every request in the pool along with any
+// storage created by usb_request_pool_alloc(). All requests taken from the pool
+// must have been added back first.
+void usb_request_pool_release(usb_request_pool_t* pool);
+
 __END_CDECLS;
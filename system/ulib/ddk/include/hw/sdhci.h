@@ -36,6 +36,8 @@ typedef struct sdhci_regs {
 #define SDHCI_HOSTCTRL_FOUR_BIT_BUS_WIDTH  (1 << 1)
 #define SDHCI_HOSTCTRL_HIGHSPEED_ENABLE    (1 << 2)
 #define SDHCI_HOSTCTRL_DMA_SELECT_ADMA2    (3 << 3)
+#define SDHCI_HOSTCTRL_DMA_SELECT_ADMA2_32 (2 << 3)
+#define SDHCI_HOSTCTRL_DMA_SELECT_MASK     (3 << 3)
 #define SDHCI_HOSTCTRL_EXT_DATA_WIDTH      (1 << 5)
 #define SDHCI_PWRCTRL_SD_BUS_POWER         (1 << 8)
 #define SDHCI_PWRCTRL_SD_BUS_VOLTAGE_MASK  (7 << 9)
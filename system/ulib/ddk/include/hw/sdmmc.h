@@ -103,6 +103,11 @@ __BEGIN_CDECLS;
 #define MMC_SEND_CSD                  (SDMMC_COMMAND(9) | SDMMC_RESP_R2)
 #define MMC_SEND_STATUS               (SDMMC_COMMAND(13) | SDMMC_RESP_R1)
 #define MMC_SEND_TUNING_BLOCK         (SDMMC_COMMAND(21) | SDMMC_RESP_R1)
+#define MMC_ERASE_GROUP_START         (SDMMC_COMMAND(35) | SDMMC_RESP_R1)
+#define MMC_ERASE_GROUP_END           (SDMMC_COMMAND(36) | SDMMC_RESP_R1)
+
+// ERASE argument (MMC)
+#define MMC_ERASE_TRIM_ARG      0x00000001
 
 // CID fields (SD/MMC)
 #define MMC_CID_SPEC_VRSN_40    3
@@ -123,6 +128,9 @@ __BEGIN_CDECLS;
 
 #define MMC_EXT_CSD_DEVICE_TYPE 196
 
+#define MMC_EXT_CSD_SEC_FEATURE_SUPPORT 231
+#define MMC_EXT_CSD_SEC_GB_CL_EN        (1 << 4)
+
 // Device register (CMD13 response) fields (SD/MMC)
 #define MMC_STATUS_ADDR_OUT_OF_RANGE    (1 << 31)
 #define MMC_STATUS_ADDR_MISALIGN        (1 << 30)
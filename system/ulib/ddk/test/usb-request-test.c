@@ -73,10 +73,59 @@ static bool test_pool(void) {
     END_TEST;
 }
 
+static bool test_pool_alloc(void) {
+    BEGIN_TEST;
+    usb_request_pool_t pool;
+    usb_request_pool_init(&pool);
+
+    ASSERT_EQ(usb_request_pool_alloc(&pool, 4, 100u, 1), ZX_OK, "");
+    ASSERT_EQ(usb_request_pool_alloc(&pool, 2, PAGE_SIZE + 1, 2), ZX_OK, "");
+
+    usb_request_t* small[4];
+    for (int i = 0; i < 4; i++) {
+        small[i] = usb_request_pool_get(&pool, 100u);
+        ASSERT_NONNULL(small[i], "");
+        ASSERT_EQ(small[i]->header.length, 100u, "");
+        ASSERT_EQ(small[i]->header.ep_address, 1u, "");
+        ASSERT_EQ(small[i]->buffer.vmo_handle, small[0]->buffer.vmo_handle,
+                  "expected requests to share a vmo");
+        ASSERT_EQ(small[i]->buffer.phys_count, 1u, "expected phys list to be set");
+        ASSERT_EQ(usb_request_physmap(small[i]), ZX_OK, "");
+    }
+    ASSERT_EQ(usb_request_pool_get(&pool, 100u), NULL, "");
+
+    // Writes to one request must not be visible in its neighbours.
+    uint8_t data[100];
+    memset(data, 0xa5, sizeof(data));
+    ASSERT_EQ(usb_request_copyto(small[1], data, sizeof(data) * 2, 0), 100, "");
+    uint8_t out_data[100];
+    ASSERT_EQ(usb_request_copyfrom(small[0], out_data, sizeof(out_data), 0), 100, "");
+    ASSERT_NE(memcmp(data, out_data, sizeof(data)), 0, "");
+    ASSERT_EQ(usb_request_copyfrom(small[1], out_data, sizeof(out_data), 0), 100, "");
+    ASSERT_EQ(memcmp(data, out_data, sizeof(data)), 0, "");
+
+    usb_request_t* large = usb_request_pool_get(&pool, PAGE_SIZE + 1);
+    ASSERT_NONNULL(large, "");
+    ASSERT_EQ(large->buffer.phys_count, 2u, "");
+    ASSERT_EQ(io_buffer_phys(&large->buffer), large->buffer.phys_list[0], "");
+
+    // Releasing a pooled request leaves it usable.
+    usb_request_release(small[0]);
+    ASSERT_EQ(io_buffer_size(&small[0]->buffer, 0), 100u, "");
+
+    for (int i = 0; i < 4; i++) {
+        usb_request_pool_add(&pool, small[i]);
+    }
+    usb_request_pool_add(&pool, large);
+    usb_request_pool_release(&pool);
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(usb_request_tests)
 RUN_TEST(test_alloc_simple)
 RUN_TEST(test_alloc_vmo)
 RUN_TEST(test_pool)
+RUN_TEST(test_pool_alloc)
 END_TEST_CASE(usb_request_tests)
 
 struct test_case_element* test_case_ddk_usb_request = TEST_CASE_ELEMENT(usb_request_tests);
@@ -11,6 +11,19 @@
 
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 
+// Payloads smaller than a page are packed at cache line granularity so that
+// cache maintenance on one request never touches its neighbours.
+#define USB_REQUEST_POOL_ALIGN 64
+
+// Backing storage for requests created by usb_request_pool_alloc().
+typedef struct {
+    list_node_t node;
+    // the shared payload VMO, mapped and physmapped once
+    io_buffer_t buffer;
+    size_t req_count;
+    usb_request_t reqs[];
+} usb_request_block_t;
+
 // Frees any resources allocated by the usb request, but not the usb request itself.
 static void usb_request_release_static(usb_request_t* req) {
     io_buffer_release(&req->buffer);
@@ -22,6 +35,10 @@ static void usb_request_release_free(usb_request_t* req) {
     free(req);
 }
 
+// Pooled requests are owned by their block and freed by usb_request_pool_release().
+static void usb_request_release_pooled(usb_request_t* req) {
+}
+
 zx_status_t usb_request_alloc(usb_request_t** out, uint64_t data_size, uint8_t ep_address) {
     usb_request_t* req = calloc(1, sizeof(usb_request_t));
     if (!req) {
@@ -139,6 +156,7 @@ size_t usb_request_phys_iter_next(phys_iter_t* iter, zx_paddr_t* out_paddr) {
 void usb_request_pool_init(usb_request_pool_t* pool) {
     mtx_init(&pool->lock, mtx_plain);
     list_initialize(&pool->free_reqs);
+    list_initialize(&pool->blocks);
 }
 
 void usb_request_pool_add(usb_request_pool_t* pool, usb_request_t* req) {
@@ -155,7 +173,7 @@ usb_request_t* usb_request_pool_get(usb_request_pool_t* pool, size_t length) {
 
     mtx_lock(&pool->lock);
     list_for_every_entry (&pool->free_reqs, req, usb_request_t, node) {
-        if (req->buffer.size == length) {
+        if (io_buffer_size(&req->buffer, 0) == length) {
             found = true;
             break;
         }
@@ -167,3 +185,75 @@ usb_request_t* usb_request_pool_get(usb_request_pool_t* pool, size_t length) {
 
     return found ? req : NULL;
 }
+
+zx_status_t usb_request_pool_alloc(usb_request_pool_t* pool, size_t count, uint64_t data_size,
+                                   uint8_t ep_address) {
+    if (count == 0 || data_size == 0) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    uint64_t stride = data_size < PAGE_SIZE ? ROUNDUP(data_size, USB_REQUEST_POOL_ALIGN)
+                                            : ROUNDUP(data_size, PAGE_SIZE);
+
+    usb_request_block_t* block = calloc(1, sizeof(usb_request_block_t) +
+                                           count * sizeof(usb_request_t));
+    if (!block) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    zx_status_t status = io_buffer_init(&block->buffer, ROUNDUP(stride * count, PAGE_SIZE),
+                                        IO_BUFFER_RW);
+    if (status == ZX_OK) {
+        status = io_buffer_physmap(&block->buffer);
+    }
+    if (status != ZX_OK) {
+        io_buffer_release(&block->buffer);
+        free(block);
+        return status;
+    }
+    block->req_count = count;
+
+    for (size_t i = 0; i < count; i++) {
+        usb_request_t* req = &block->reqs[i];
+        uint64_t offset = i * stride;
+        uint64_t first_page = offset / PAGE_SIZE;
+        uint64_t end_page = ROUNDUP(offset + data_size, PAGE_SIZE) / PAGE_SIZE;
+
+        // The request sees the shared VMO through an io_buffer window that
+        // starts at its slot, with the physical page list already filled in.
+        req->buffer.vmo_handle = block->buffer.vmo_handle;
+        req->buffer.size = offset + data_size;
+        req->buffer.offset = offset;
+        req->buffer.virt = block->buffer.virt;
+        req->buffer.phys = block->buffer.phys_list[first_page] - first_page * PAGE_SIZE;
+        req->buffer.phys_list = block->buffer.phys_list + first_page;
+        req->buffer.phys_count = end_page - first_page;
+
+        req->header.ep_address = ep_address;
+        req->header.length = data_size;
+        req->release_cb = usb_request_release_pooled;
+    }
+
+    mtx_lock(&pool->lock);
+    list_add_tail(&pool->blocks, &block->node);
+    for (size_t i = 0; i < count; i++) {
+        list_add_tail(&pool->free_reqs, &block->reqs[i].node);
+    }
+    mtx_unlock(&pool->lock);
+
+    return ZX_OK;
+}
+
+void usb_request_pool_release(usb_request_pool_t* pool) {
+    mtx_lock(&pool->lock);
+
+    usb_request_t* req;
+    while ((req = list_remove_head_type(&pool->free_reqs, usb_request_t, node)) != NULL) {
+        usb_request_release(req);
+    }
+    usb_request_block_t* block;
+    while ((block = list_remove_head_type(&pool->blocks, usb_request_block_t, node)) != NULL) {
+        io_buffer_release(&block->buffer);
+        free(block);
+    }
+
+    mtx_unlock(&pool->lock);
+}
@@ -21,6 +21,13 @@ DECLARE_HAS_MEMBER_FN(has_get_framebuffer, GetFramebuffer);
 DECLARE_HAS_MEMBER_FN(has_flush, Flush);
 DECLARE_HAS_MEMBER_FN(has_acquire_or_release_display, AcquireOrReleaseDisplay);
 DECLARE_HAS_MEMBER_FN(has_set_ownership_change_callback, SetOwnershipChangeCallback);
+DECLARE_HAS_MEMBER_FN(has_import_vmo, ImportVmo);
+DECLARE_HAS_MEMBER_FN(has_release_image, ReleaseImage);
+DECLARE_HAS_MEMBER_FN(has_present_image, PresentImage);
+DECLARE_HAS_MEMBER_FN(has_set_present_callback, SetPresentCallback);
+DECLARE_HAS_MEMBER_FN(has_set_cursor, SetCursor);
+DECLARE_HAS_MEMBER_FN(has_move_cursor, MoveCursor);
+DECLARE_HAS_MEMBER_FN(has_set_overlay, SetOverlay);
 
 template <typename D>
 constexpr void CheckDisplayProtocolSubclass() {
@@ -56,6 +63,64 @@ constexpr void CheckDisplayProtocolSubclass() {
                   "'void Flush()', and be visible to "
                   "ddk::DisplayProtocol<D> (either because they are public, or because of "
                   "friendship).");
+    static_assert(internal::has_import_vmo<D>::value,
+                  "DisplayProtocol subclasses must implement ImportVmo");
+    static_assert(fbl::is_same<decltype(&D::ImportVmo),
+                                zx_status_t (D::*)(zx_handle_t, uint64_t*)>::value,
+                  "ImportVmo must be a non-static member function with signature "
+                  "'zx_status_t ImportVmo(zx_handle_t vmo, uint64_t* image_id_out)', and be visible to "
+                  "ddk::DisplayProtocol<D> (either because they are public, or because of "
+                  "friendship).");
+    static_assert(internal::has_release_image<D>::value,
+                  "DisplayProtocol subclasses must implement ReleaseImage");
+    static_assert(fbl::is_same<decltype(&D::ReleaseImage),
+                                void (D::*)(uint64_t)>::value,
+                  "ReleaseImage must be a non-static member function with signature "
+                  "'void ReleaseImage(uint64_t image_id)', and be visible to "
+                  "ddk::DisplayProtocol<D> (either because they are public, or because of "
+                  "friendship).");
+    static_assert(internal::has_present_image<D>::value,
+                  "DisplayProtocol subclasses must implement PresentImage");
+    static_assert(fbl::is_same<decltype(&D::PresentImage),
+                                zx_status_t (D::*)(uint64_t)>::value,
+                  "PresentImage must be a non-static member function with signature "
+                  "'zx_status_t PresentImage(uint64_t image_id)', and be visible to "
+                  "ddk::DisplayProtocol<D> (either because they are public, or because of "
+                  "friendship).");
+    static_assert(internal::has_set_present_callback<D>::value,
+                  "DisplayProtocol subclasses must implement SetPresentCallback");
+    static_assert(fbl::is_same<decltype(&D::SetPresentCallback),
+                                void (D::*)(zx_display_present_cb_t, void*)>::value,
+                  "SetPresentCallback must be a non-static member function with signature "
+                  "'void SetPresentCallback(zx_display_present_cb_t callback, void* cookie)', and be visible to "
+                  "ddk::DisplayProtocol<D> (either because they are public, or because of "
+                  "friendship).");
+    static_assert(internal::has_set_cursor<D>::value,
+                  "DisplayProtocol subclasses must implement SetCursor");
+    static_assert(fbl::is_same<decltype(&D::SetCursor),
+                                zx_status_t (D::*)(const void*, uint32_t, uint32_t)>::value,
+                  "SetCursor must be a non-static member function with signature "
+                  "'zx_status_t SetCursor(const void* pixels, uint32_t hot_x, uint32_t hot_y)', and be visible to "
+                  "ddk::DisplayProtocol<D> (either because they are public, or because of "
+                  "friendship).");
+    static_assert(internal::has_move_cursor<D>::value,
+                  "DisplayProtocol subclasses must implement MoveCursor");
+    static_assert(fbl::is_same<decltype(&D::MoveCursor),
+                                void (D::*)(int32_t, int32_t)>::value,
+                  "MoveCursor must be a non-static member function with signature "
+                  "'void MoveCursor(int32_t x, int32_t y)', and be visible to "
+                  "ddk::DisplayProtocol<D> (either because they are public, or because of "
+                  "friendship).");
+    static_assert(internal::has_set_overlay<D>::value,
+                  "DisplayProtocol subclasses must implement SetOverlay");
+    static_assert(fbl::is_same<decltype(&D::SetOverlay),
+                                zx_status_t (D::*)(uint32_t, uint64_t, uint32_t, uint32_t,
+                                                   uint32_t, uint32_t)>::value,
+                  "SetOverlay must be a non-static member function with signature "
+                  "'zx_status_t SetOverlay(uint32_t overlay, uint64_t image_id, uint32_t x, "
+                  "uint32_t y, uint32_t width, uint32_t height)', and be visible to "
+                  "ddk::DisplayProtocol<D> (either because they are public, or because of "
+                  "friendship).");
 }
 
 }  // namespace internal
@@ -20,6 +20,13 @@ class DisplayProtocol : public internal::base_protocol {
         ops_.get_mode = GetMode;
         ops_.get_framebuffer = GetFramebuffer;
         ops_.flush = FlushThunk;
+        ops_.import_vmo = ImportVmo;
+        ops_.release_image = ReleaseImage;
+        ops_.present_image = PresentImage;
+        ops_.set_present_callback = SetPresentCallback;
+        ops_.set_cursor = SetCursor;
+        ops_.move_cursor = MoveCursor;
+        ops_.set_overlay = SetOverlay;
 
         // Can only inherit from one base_protocol implemenation
         ZX_ASSERT(ddk_proto_id_ == 0);
@@ -44,6 +51,35 @@ class DisplayProtocol : public internal::base_protocol {
         static_cast<D*>(ctx)->Flush();
     }
 
+    static zx_status_t ImportVmo(void* ctx, zx_handle_t vmo, uint64_t* image_id_out) {
+        return static_cast<D*>(ctx)->ImportVmo(vmo, image_id_out);
+    }
+
+    static void ReleaseImage(void* ctx, uint64_t image_id) {
+        static_cast<D*>(ctx)->ReleaseImage(image_id);
+    }
+
+    static zx_status_t PresentImage(void* ctx, uint64_t image_id) {
+        return static_cast<D*>(ctx)->PresentImage(image_id);
+    }
+
+    static void SetPresentCallback(void* ctx, zx_display_present_cb_t callback, void* cookie) {
+        static_cast<D*>(ctx)->SetPresentCallback(callback, cookie);
+    }
+
+    static zx_status_t SetCursor(void* ctx, const void* pixels, uint32_t hot_x, uint32_t hot_y) {
+        return static_cast<D*>(ctx)->SetCursor(pixels, hot_x, hot_y);
+    }
+
+    static void MoveCursor(void* ctx, int32_t x, int32_t y) {
+        static_cast<D*>(ctx)->MoveCursor(x, y);
+    }
+
+    static zx_status_t SetOverlay(void* ctx, uint32_t overlay, uint64_t image_id,
+                                  uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+        return static_cast<D*>(ctx)->SetOverlay(overlay, image_id, x, y, width, height);
+    }
+
     display_protocol_ops_t ops_ = {};
 };
 
@@ -14,6 +14,8 @@
 #include <zircon/assert.h>
 #include <zircon/errors.h>
 
+#include "node-digest.h"
+
 namespace digest {
 
 // Size of a node in bytes.  Defined in tree.h.
@@ -75,6 +77,19 @@ void DigestFinal(Digest* digest, size_t offset) {
     digest->Final();
 }
 
+// Computes the digests of the |internal::kNodeBatch| full nodes at |in|, the
+// first of which is at |offset| in a level of the tree at height |level|, and
+// writes them to |out|.
+void DigestBatch(const uint8_t* in, size_t offset, uint64_t level, uint8_t* out) {
+    const uint8_t* nodes[internal::kNodeBatch];
+    uint64_t locality[internal::kNodeBatch];
+    for (size_t i = 0; i < internal::kNodeBatch; ++i) {
+        nodes[i] = in + i * MerkleTree::kNodeSize;
+        locality[i] = (offset + i * MerkleTree::kNodeSize) | level;
+    }
+    internal::HashNodes(nodes, locality, out);
+}
+
 ////////
 // Helper functions for working between levels of the tree.
 
@@ -168,8 +183,27 @@ zx_status_t MerkleTree::CreateUpdate(const void* data, size_t length, void* tree
     uint8_t* out = static_cast<uint8_t*>(tree) + tree_off;
     void* next = static_cast<uint8_t*>(tree) + NextAligned(length_);
     // Consume the data.
+    const bool batch = internal::NodeDigestAccelerated() && length_ > kNodeSize;
+    const size_t batch_len = internal::kNodeBatch * kNodeSize;
+    const size_t batch_digests = internal::kNodeBatch * Digest::kLength;
     zx_status_t rc = ZX_OK;
     while (length > 0 && rc == ZX_OK) {
+        // Hash whole batches of full nodes at once when the CPU can.
+        if (batch && offset_ % kNodeSize == 0 && length >= batch_len) {
+            for (size_t i = 0; i < batch_digests; i += Digest::kLength) {
+                if ((tree_off + i) % kNodeSize == 0) {
+                    memset(out + i, 0, kNodeSize);
+                }
+            }
+            DigestBatch(in, offset_, level_, out);
+            in += batch_len;
+            offset_ += batch_len;
+            length -= batch_len;
+            rc = next_->CreateUpdate(out, batch_digests, next);
+            out += batch_digests;
+            tree_off += batch_digests;
+            continue;
+        }
         // Check if this is the start of a node.
         if (offset_ % kNodeSize == 0 &&
             (rc = DigestInit(&digest_, offset_ | level_, length_ - offset_)) != ZX_OK) {
@@ -254,7 +288,11 @@ zx_status_t MerkleTree::Verify(const void* data, size_t data_len, const void* tr
         if ((rc = VerifyLevel(data, data_len, tree, offset, length, level)) != ZX_OK) {
             return rc;
         }
-        // Ascend to the next level up.
+        // Ascend to the next level up, to the digests of the nodes that were
+        // just checked. Round out to whole nodes first, so that a short range
+        // still covers at least one digest on every level.
+        size_t finish = fbl::round_up(offset + length, kNodeSize);
+        offset -= offset % kNodeSize;
         data = tree;
         root_len = NextLength(data_len);
         data_len = NextAligned(data_len);
@@ -264,7 +302,7 @@ zx_status_t MerkleTree::Verify(const void* data, size_t data_len, const void* tr
         }
         tree_len -= data_len;
         offset /= kDigestsPerNode;
-        length /= kDigestsPerNode;
+        length = finish / kDigestsPerNode - offset;
         ++level;
     }
     return VerifyRoot(data, root_len, level, root);
@@ -308,7 +346,23 @@ zx_status_t MerkleTree::VerifyLevel(const void* data, size_t data_len, const voi
     // The digests are in the next level up.
     Digest actual;
     const uint8_t* expected = static_cast<const uint8_t*>(tree) + (offset / kDigestsPerNode);
-    // Check the data of this level against the digests.
+    // Check the data of this level against the digests, in whole batches of
+    // full nodes at once when the CPU can.
+    if (internal::NodeDigestAccelerated()) {
+        const size_t batch_len = internal::kNodeBatch * kNodeSize;
+        const size_t batch_digests = internal::kNodeBatch * Digest::kLength;
+        uint8_t batch[batch_digests];
+        while (length >= batch_len) {
+            DigestBatch(in, offset, level, batch);
+            if (memcmp(batch, expected, batch_digests) != 0) {
+                return ZX_ERR_IO_DATA_INTEGRITY;
+            }
+            in += batch_len;
+            offset += batch_len;
+            length -= batch_len;
+            expected += batch_digests;
+        }
+    }
     while (length > 0) {
         if ((rc = DigestInit(&actual, offset | level, data_len - offset)) != ZX_OK) {
             return rc;
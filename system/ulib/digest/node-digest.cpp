@@ -0,0 +1,367 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "node-digest.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <digest/digest.h>
+#include <digest/merkle-tree.h>
+#include <fbl/atomic.h>
+#include <zircon/assert.h>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+namespace digest {
+namespace internal {
+namespace {
+
+enum Backend : int {
+    kBackendUnknown = 0,
+    kBackendNone,
+    kBackendShaNi,
+    kBackendAvx2,
+};
+
+#if defined(__x86_64__)
+
+// Each node is hashed as a header of its locality and length, followed by the
+// node data. The message is split into SHA-256 blocks; all but the first and
+// last of them can be read straight out of the node data.
+constexpr size_t kHeaderLen = sizeof(uint64_t) + sizeof(uint32_t);
+constexpr size_t kBlockLen = 64;
+constexpr size_t kMessageLen = kHeaderLen + MerkleTree::kNodeSize;
+constexpr size_t kFullBlocks = kMessageLen / kBlockLen;
+constexpr size_t kTailLen = kMessageLen % kBlockLen;
+constexpr size_t kBlocks = kFullBlocks + 1;
+static_assert(kTailLen + 1 + sizeof(uint64_t) <= kBlockLen,
+              "SHA-256 padding must fit in the last block");
+
+// The first and last blocks of a node's message.
+struct Edges {
+    uint8_t first[kBlockLen];
+    uint8_t last[kBlockLen];
+};
+
+void MakeEdges(const uint8_t* node, uint64_t locality, Edges* edges) {
+    uint32_t len32 = static_cast<uint32_t>(MerkleTree::kNodeSize);
+    memcpy(edges->first, &locality, sizeof(locality));
+    memcpy(edges->first + sizeof(locality), &len32, sizeof(len32));
+    memcpy(edges->first + kHeaderLen, node, kBlockLen - kHeaderLen);
+
+    memset(edges->last, 0, kBlockLen);
+    memcpy(edges->last, node + MerkleTree::kNodeSize - kTailLen, kTailLen);
+    edges->last[kTailLen] = 0x80;
+    uint64_t bits = kMessageLen * 8;
+    for (size_t i = 0; i < sizeof(bits); ++i) {
+        edges->last[kBlockLen - 1 - i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+}
+
+// Returns block |n| of the message for |node|.
+const uint8_t* Block(const uint8_t* node, const Edges& edges, size_t n) {
+    if (n == 0) {
+        return edges.first;
+    } else if (n == kFullBlocks) {
+        return edges.last;
+    }
+    return node + n * kBlockLen - kHeaderLen;
+}
+
+const uint32_t kInit[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+const uint32_t kRound[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+// CPUID leaf 7 feature bits.
+constexpr uint32_t kCpuid7EbxAvx2 = 1u << 5;
+constexpr uint32_t kCpuid7EbxSha = 1u << 29;
+
+int DetectBackend() {
+    uint32_t eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0, nullptr) < 7) {
+        return kBackendNone;
+    }
+    __cpuid(1, eax, ebx, ecx, edx);
+    bool ssse3 = (ecx & bit_SSSE3) && (ecx & bit_SSE4_1);
+    bool avx = false;
+    if ((ecx & bit_AVX) && (ecx & bit_OSXSAVE)) {
+        // The OS must be saving the YMM registers too.
+        uint32_t xcr0_lo, xcr0_hi;
+        __asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+        avx = (xcr0_lo & 0x6) == 0x6;
+    }
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+
+    // The SHA extensions hash a single node faster than AVX2 hashes eight.
+    if ((ebx & kCpuid7EbxSha) && ssse3) {
+        return kBackendShaNi;
+    } else if ((ebx & kCpuid7EbxAvx2) && avx) {
+        return kBackendAvx2;
+    }
+    return kBackendNone;
+}
+
+void StoreDigest(const uint32_t* state, uint8_t* out) {
+    for (size_t i = 0; i < 8; ++i) {
+        out[4 * i + 0] = static_cast<uint8_t>(state[i] >> 24);
+        out[4 * i + 1] = static_cast<uint8_t>(state[i] >> 16);
+        out[4 * i + 2] = static_cast<uint8_t>(state[i] >> 8);
+        out[4 * i + 3] = static_cast<uint8_t>(state[i]);
+    }
+}
+
+////////
+// SHA extensions: one node at a time, four rounds per pair of instructions.
+
+#define SHA_NI_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+
+SHA_NI_TARGET inline __m128i LoadBlock128(const uint8_t* block, size_t i) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+}
+
+// Returns the next four message words, given the previous sixteen.
+SHA_NI_TARGET inline __m128i ShaSchedule(__m128i w16, __m128i w12, __m128i w8, __m128i w4) {
+    __m128i msg = _mm_sha256msg1_epu32(w16, w12);
+    msg = _mm_add_epi32(msg, _mm_alignr_epi8(w4, w8, 4));
+    return _mm_sha256msg2_epu32(msg, w4);
+}
+
+// Runs rounds |4 * g| through |4 * g + 3| with message words |w|.
+SHA_NI_TARGET inline void ShaRounds(__m128i* state0, __m128i* state1, __m128i w, size_t g) {
+    __m128i msg = _mm_add_epi32(
+        w, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&kRound[4 * g])));
+    *state1 = _mm_sha256rnds2_epu32(*state1, *state0, msg);
+    *state0 = _mm_sha256rnds2_epu32(*state0, *state1, _mm_shuffle_epi32(msg, 0x0e));
+}
+
+SHA_NI_TARGET void HashNodesShaNi(const uint8_t* const* nodes, const uint64_t* locality,
+                                  uint8_t* out) {
+    const __m128i swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    for (size_t i = 0; i < kNodeBatch; ++i) {
+        Edges edges;
+        MakeEdges(nodes[i], locality[i], &edges);
+
+        // The instructions want the state as ABEF and CDGH.
+        __m128i tmp = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&kInit[0]));
+        __m128i state1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&kInit[4]));
+        tmp = _mm_shuffle_epi32(tmp, 0xb1);
+        state1 = _mm_shuffle_epi32(state1, 0x1b);
+        __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+        state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+        for (size_t n = 0; n < kBlocks; ++n) {
+            const uint8_t* block = Block(nodes[i], edges, n);
+            __m128i abef = state0;
+            __m128i cdgh = state1;
+            __m128i w0 = _mm_shuffle_epi8(LoadBlock128(block, 0), swap);
+            ShaRounds(&state0, &state1, w0, 0);
+            __m128i w1 = _mm_shuffle_epi8(LoadBlock128(block, 1), swap);
+            ShaRounds(&state0, &state1, w1, 1);
+            __m128i w2 = _mm_shuffle_epi8(LoadBlock128(block, 2), swap);
+            ShaRounds(&state0, &state1, w2, 2);
+            __m128i w3 = _mm_shuffle_epi8(LoadBlock128(block, 3), swap);
+            ShaRounds(&state0, &state1, w3, 3);
+            for (size_t g = 4; g < 16; g += 4) {
+                w0 = ShaSchedule(w0, w1, w2, w3);
+                ShaRounds(&state0, &state1, w0, g);
+                w1 = ShaSchedule(w1, w2, w3, w0);
+                ShaRounds(&state0, &state1, w1, g + 1);
+                w2 = ShaSchedule(w2, w3, w0, w1);
+                ShaRounds(&state0, &state1, w2, g + 2);
+                w3 = ShaSchedule(w3, w0, w1, w2);
+                ShaRounds(&state0, &state1, w3, g + 3);
+            }
+            state0 = _mm_add_epi32(state0, abef);
+            state1 = _mm_add_epi32(state1, cdgh);
+        }
+
+        // Back to ABCD and EFGH.
+        tmp = _mm_shuffle_epi32(state0, 0x1b);
+        state1 = _mm_shuffle_epi32(state1, 0xb1);
+        state0 = _mm_blend_epi16(tmp, state1, 0xf0);
+        state1 = _mm_alignr_epi8(state1, tmp, 8);
+        uint32_t state[8];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), state0);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), state1);
+        StoreDigest(state, out + i * Digest::kLength);
+    }
+}
+
+////////
+// AVX2: eight nodes at once, one in each 32-bit lane.
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+static_assert(kNodeBatch == 8, "one node per 32-bit lane");
+
+template <int n>
+AVX2_TARGET inline __m256i Ror(__m256i x) {
+    return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+
+// Turns eight rows of eight words into eight columns.
+AVX2_TARGET inline void Transpose(__m256i* r) {
+    __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+    __m256i t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+    __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+    __m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+    __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+    __m256i t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+    __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+    __m256i t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+    r[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+    r[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+    r[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+    r[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+    r[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+    r[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+    r[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+    r[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+AVX2_TARGET void HashNodesAvx2(const uint8_t* const* nodes, const uint64_t* locality,
+                               uint8_t* out) {
+    const __m256i swap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                          3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    Edges edges[kNodeBatch];
+    for (size_t i = 0; i < kNodeBatch; ++i) {
+        MakeEdges(nodes[i], locality[i], &edges[i]);
+    }
+    __m256i state[8];
+    for (size_t i = 0; i < 8; ++i) {
+        state[i] = _mm256_set1_epi32(static_cast<int>(kInit[i]));
+    }
+
+    for (size_t n = 0; n < kBlocks; ++n) {
+        __m256i w[16];
+        for (size_t half = 0; half < 2; ++half) {
+            for (size_t i = 0; i < kNodeBatch; ++i) {
+                const uint8_t* block = Block(nodes[i], edges[i], n) + 32 * half;
+                w[8 * half + i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+            }
+            Transpose(&w[8 * half]);
+            for (size_t i = 0; i < 8; ++i) {
+                w[8 * half + i] = _mm256_shuffle_epi8(w[8 * half + i], swap);
+            }
+        }
+
+        __m256i a = state[0], b = state[1], c = state[2], d = state[3];
+        __m256i e = state[4], f = state[5], g = state[6], h = state[7];
+        for (size_t t = 0; t < 64; ++t) {
+            if (t >= 16) {
+                __m256i w2 = w[(t - 2) % 16];
+                __m256i w15 = w[(t - 15) % 16];
+                __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(Ror<7>(w15), Ror<18>(w15)),
+                                              _mm256_srli_epi32(w15, 3));
+                __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(Ror<17>(w2), Ror<19>(w2)),
+                                              _mm256_srli_epi32(w2, 10));
+                w[t % 16] = _mm256_add_epi32(_mm256_add_epi32(w[t % 16], s0),
+                                             _mm256_add_epi32(w[(t - 7) % 16], s1));
+            }
+            __m256i sum1 = _mm256_xor_si256(_mm256_xor_si256(Ror<6>(e), Ror<11>(e)), Ror<25>(e));
+            __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+            __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, sum1), ch);
+            t1 = _mm256_add_epi32(t1, _mm256_add_epi32(
+                                          _mm256_set1_epi32(static_cast<int>(kRound[t])), w[t % 16]));
+            __m256i sum0 = _mm256_xor_si256(_mm256_xor_si256(Ror<2>(a), Ror<13>(a)), Ror<22>(a));
+            __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b),
+                                          _mm256_and_si256(_mm256_or_si256(a, b), c));
+            h = g;
+            g = f;
+            f = e;
+            e = _mm256_add_epi32(d, t1);
+            d = c;
+            c = b;
+            b = a;
+            a = _mm256_add_epi32(t1, _mm256_add_epi32(sum0, maj));
+        }
+        state[0] = _mm256_add_epi32(state[0], a);
+        state[1] = _mm256_add_epi32(state[1], b);
+        state[2] = _mm256_add_epi32(state[2], c);
+        state[3] = _mm256_add_epi32(state[3], d);
+        state[4] = _mm256_add_epi32(state[4], e);
+        state[5] = _mm256_add_epi32(state[5], f);
+        state[6] = _mm256_add_epi32(state[6], g);
+        state[7] = _mm256_add_epi32(state[7], h);
+    }
+
+    uint32_t words[8][kNodeBatch];
+    for (size_t i = 0; i < 8; ++i) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(words[i]), state[i]);
+    }
+    for (size_t i = 0; i < kNodeBatch; ++i) {
+        uint32_t digest[8];
+        for (size_t j = 0; j < 8; ++j) {
+            digest[j] = words[j][i];
+        }
+        StoreDigest(digest, out + i * Digest::kLength);
+    }
+}
+
+#else // !defined(__x86_64__)
+
+int DetectBackend() {
+    return kBackendNone;
+}
+
+#endif // defined(__x86_64__)
+
+fbl::atomic<int> backend(kBackendUnknown);
+
+int GetBackend() {
+    int b = backend.load(fbl::memory_order_relaxed);
+    if (b == kBackendUnknown) {
+        b = DetectBackend();
+        backend.store(b, fbl::memory_order_relaxed);
+    }
+    return b;
+}
+
+} // namespace
+
+bool NodeDigestAccelerated() {
+    return GetBackend() != kBackendNone;
+}
+
+void HashNodes(const uint8_t* const* nodes, const uint64_t* locality, uint8_t* out) {
+    switch (GetBackend()) {
+#if defined(__x86_64__)
+    case kBackendShaNi:
+        HashNodesShaNi(nodes, locality, out);
+        return;
+    case kBackendAvx2:
+        HashNodesAvx2(nodes, locality, out);
+        return;
+#endif
+    default:
+        ZX_PANIC("no accelerated SHA-256 backend\n");
+    }
+}
+
+} // namespace internal
+} // namespace digest
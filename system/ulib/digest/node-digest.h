@@ -0,0 +1,28 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace digest {
+namespace internal {
+
+// The number of nodes hashed by each call to |HashNodes|.
+constexpr size_t kNodeBatch = 8;
+
+// Returns true if this CPU has an accelerated SHA-256 backend, in which case
+// |HashNodes| is faster than hashing the nodes one at a time with Digest.
+bool NodeDigestAccelerated();
+
+// Computes the digests of |kNodeBatch| full Merkle tree nodes, exactly as
+// MerkleTree would hash each of them:
+//    digest[i] = Hash(locality[i] + kNodeSize + nodes[i])
+// The digests are written one after another to |out|, which must have room for
+// |kNodeBatch * Digest::kLength| bytes.
+void HashNodes(const uint8_t* const* nodes, const uint64_t* locality, uint8_t* out);
+
+} // namespace internal
+} // namespace digest
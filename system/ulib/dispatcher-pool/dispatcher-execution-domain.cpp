@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <zircon/syscalls.h>
 #include <zx/event.h>
 
 #include <dispatcher-pool/dispatcher-execution-domain.h>
@@ -186,6 +187,7 @@ bool ExecutionDomain::AddPendingWork(EventSource* event_source) {
     }
 
     event_source->dispatch_state_ = DispatchState::DispatchPending;
+    event_source->pending_time_ = zx_time_get(ZX_CLOCK_MONOTONIC);
     pending_work_.push_back(fbl::WrapRefPtr(event_source));
 
     return ret;
@@ -204,7 +206,18 @@ bool ExecutionDomain::RemovePendingWork(EventSource* event_source) {
     return true;
 }
 
-void ExecutionDomain::DispatchPendingWork() {
+void ExecutionDomain::GetStats(Stats* stats_out) {
+    ZX_DEBUG_ASSERT(stats_out != nullptr);
+    fbl::AutoLock sources_lock(&sources_lock_);
+    *stats_out = stats_;
+}
+
+void ExecutionDomain::DispatchPendingWork(uint32_t thread_id, bool handed_off) {
+    // Note which thread is running us, so that the next run may be handed
+    // back to it while its caches are still warm.
+    uint32_t prev_thread_id = last_thread_id_.exchange(thread_id, fbl::memory_order_acq_rel);
+    bool first = true;
+
     // While we have work waiting in the pending queue, dispatch it.
     //
     // TODO(johngro) : To prevent starvation issues, we should probably only
@@ -219,6 +232,15 @@ void ExecutionDomain::DispatchPendingWork() {
         {
             fbl::AutoLock sources_lock(&sources_lock_);
             ZX_DEBUG_ASSERT(dispatch_in_progress_);
+            if (first) {
+                first = false;
+                stats_.run_count++;
+                if ((prev_thread_id != kNoThread) && (prev_thread_id != thread_id))
+                    stats_.migration_count++;
+                if (handed_off)
+                    stats_.handoff_count++;
+            }
+
             if (deactivated() || pending_work_.is_empty()) {
                 // Clear the pending work queue and the dispatch in progress
                 // flag.  If someone is attempting to synchronize with dispatch
@@ -235,6 +257,12 @@ void ExecutionDomain::DispatchPendingWork() {
             }
 
             source = pending_work_.begin().CopyPointer();
+
+            zx_duration_t latency = zx_time_get(ZX_CLOCK_MONOTONIC) - source->pending_time_;
+            stats_.dispatch_count++;
+            stats_.total_queue_latency += latency;
+            if (stats_.max_queue_latency < latency)
+                stats_.max_queue_latency = latency;
         }
 
         // Attempt to transition to the Dispatching state.  If this fails, it
@@ -105,16 +105,18 @@ zx_status_t ThreadPool::AddDomainToPool(fbl::RefPtr<ExecutionDomain> domain) {
     ++active_domain_count_;
 
     while ((active_thread_count_ < active_domain_count_) &&
-           (active_thread_count_ < zx_system_get_num_cpus())) {
+           (active_thread_count_ < max_thread_count_)) {
         auto thread = Thread::Create(fbl::WrapRefPtr(this), active_thread_count_);
         if (thread == nullptr) {
             LOG("Failed to create new thread\n");
             break;
         }
 
+        threads_by_id_[active_thread_count_] = thread.get();
         active_threads_.push_front(fbl::move(thread));
         if (active_threads_.front().Start() != ZX_OK) {
             LOG("Failed to start new thread\n");
+            threads_by_id_[active_thread_count_] = nullptr;
             thread = active_threads_.pop_front();
             break;
         }
@@ -165,12 +167,22 @@ void ThreadPool::PrintDebugPrefix() {
 zx_status_t ThreadPool::Init() {
     ZX_DEBUG_ASSERT(!port_.is_valid());
 
-    zx_status_t res = zx::port::create(0, &port_);
+    // Wake the most recently idled thread first so that a lightly loaded
+    // pool keeps running on the same few warm threads.
+    zx_status_t res = zx::port::create(ZX_PORT_LIFO, &port_);
     if (res != ZX_OK) {
         LOG("Failed to create therad pool port (res %d)!\n", res);
         return res;
     }
 
+    fbl::AllocChecker ac;
+    max_thread_count_ = zx_system_get_num_cpus();
+    threads_by_id_.reset(new (&ac) Thread*[max_thread_count_]());
+    if (!ac.check()) {
+        LOG("Failed to allocate thread table (count %u)!\n", max_thread_count_);
+        return ZX_ERR_NO_MEMORY;
+    }
+
     return ZX_OK;
 }
 
@@ -229,6 +241,13 @@ void ThreadPool::InternalShutdown() {
 
         thread->Join();
     }
+
+    // Now that nobody can be handing work to them, forget the threads.
+    {
+        fbl::AutoLock lock(&pool_lock_);
+        for (uint32_t i = 0; i < max_thread_count_; ++i)
+            threads_by_id_[i] = nullptr;
+    }
 }
 
 // static
@@ -271,6 +290,57 @@ void ThreadPool::Thread::Join() {
     ZX_DEBUG_ASSERT(pool_ == nullptr);
 }
 
+bool ThreadPool::Thread::TryHandoff(fbl::RefPtr<ExecutionDomain>* domain) {
+    ZX_DEBUG_ASSERT((domain != nullptr) && (*domain != nullptr));
+    fbl::AutoLock lock(&handoff_lock_);
+
+    // An idle thread is blocked on the port and cannot be woken individually,
+    // and a thread which is deep into a dispatch might not finish soon.  In
+    // either case the caller is better off running the domain itself.
+    if (idle_ || (handoff_ != nullptr) ||
+        ((zx_time_get(ZX_CLOCK_MONOTONIC) - dispatch_start_) > kHandoffWindow))
+        return false;
+
+    handoff_ = fbl::move(*domain);
+    return true;
+}
+
+void ThreadPool::Thread::DispatchDomain(fbl::RefPtr<ExecutionDomain> domain) {
+    // If another thread ran this domain last and is about to come up for air,
+    // let it run the domain again instead of pulling the domain's state into
+    // our cache.
+    uint32_t last_id = domain->last_thread_id();
+    if ((last_id != id_) && (last_id < pool_->max_thread_count_)) {
+        Thread* last = pool_->threads_by_id_[last_id];
+        if ((last != nullptr) && last->TryHandoff(&domain))
+            return;
+    }
+
+    {
+        fbl::AutoLock lock(&handoff_lock_);
+        dispatch_start_ = zx_time_get(ZX_CLOCK_MONOTONIC);
+    }
+    domain->DispatchPendingWork(id_, false);
+}
+
+void ThreadPool::Thread::DrainHandoffs() {
+    while (true) {
+        fbl::RefPtr<ExecutionDomain> domain;
+        {
+            fbl::AutoLock lock(&handoff_lock_);
+            if (handoff_ == nullptr) {
+                idle_ = true;
+                return;
+            }
+
+            domain = fbl::move(handoff_);
+            dispatch_start_ = zx_time_get(ZX_CLOCK_MONOTONIC);
+        }
+
+        domain->DispatchPendingWork(id_, true);
+    }
+}
+
 void ThreadPool::Thread::PrintDebugPrefix() const {
     printf("[Thread %03u-%02u] ", id_, pool_->priority());
 }
@@ -292,11 +362,21 @@ int ThreadPool::Thread::Main() {
         // TODO(johngro) : consider automatically shutting down if we have more
         // threads than clients.
 
+        // Run anything which was handed to us while we were busy before we
+        // go idle.
+        DrainHandoffs();
+
         // Wait for there to be work to dispatch.  We should never encounter an
         // error, but if we do, shut down.
         res = pool_->port().wait(ZX_TIME_INFINITE, &pkt, 0);
         ZX_DEBUG_ASSERT(res == ZX_OK);
 
+        {
+            fbl::AutoLock lock(&handoff_lock_);
+            idle_ = false;
+            dispatch_start_ = zx_time_get(ZX_CLOCK_MONOTONIC);
+        }
+
         // Is it time to exit?
         if ((res != ZX_OK) || (pkt.type == ZX_PKT_TYPE_USER)) {
             break;
@@ -321,9 +401,12 @@ int ThreadPool::Thread::Main() {
         fbl::RefPtr<ExecutionDomain> domain = event_source->ScheduleDispatch(pkt);
 
         if (domain != nullptr)
-            domain->DispatchPendingWork();
+            DispatchDomain(fbl::move(domain));
     }
 
+    // Someone may have handed us work after we woke up to exit.
+    DrainHandoffs();
+
     DEBUG_LOG("Client work thread shutting down\n");
     pool_.reset();
 
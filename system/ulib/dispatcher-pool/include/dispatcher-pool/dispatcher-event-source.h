@@ -89,6 +89,10 @@ protected:
     DispatchState                dispatch_state_ __TA_GUARDED(obj_lock_) = DispatchState::Idle;
     zx_port_packet_t             pending_pkt_;
 
+    // The time at which we joined our domain's pending work queue.  Guarded
+    // by the domain's sources lock.
+    zx_time_t                    pending_time_ = 0;
+
 private:
     friend class fbl::RefPtr<EventSource>;
     friend class ExecutionDomain;
@@ -8,6 +8,7 @@
 #include <zircon/compiler.h>
 #include <zircon/types.h>
 #include <zx/event.h>
+#include <fbl/atomic.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/mutex.h>
 #include <fbl/ref_counted.h>
@@ -95,9 +96,26 @@ public:
         ~ScopedToken() __TA_RELEASE() { }
     };
 
+    // Statistics about how a domain's work has been dispatched.  Queue
+    // latency is measured from the time an event source joins the domain's
+    // pending work queue until its handler starts to run.  A dispatch run
+    // migrates when it starts on a different pool thread than the run before
+    // it, and is handed off when the thread which received the work passes it
+    // to the thread which ran the domain last.
+    struct Stats {
+        uint64_t      dispatch_count;
+        uint64_t      run_count;
+        uint64_t      migration_count;
+        uint64_t      handoff_count;
+        zx_duration_t total_queue_latency;
+        zx_duration_t max_queue_latency;
+    };
+
     static constexpr uint32_t DEFAULT_PRIORITY = 16;
     static fbl::RefPtr<ExecutionDomain> Create(uint32_t priority = DEFAULT_PRIORITY);
 
+    void GetStats(Stats* stats_out) __TA_EXCLUDES(sources_lock_);
+
     void Deactivate() __TA_EXCLUDES(domain_token_) { Deactivate(true); }
     void DeactivateFromWithinDomain() __TA_REQUIRES(domain_token_) { Deactivate(false); }
 
@@ -148,8 +166,15 @@ private:
     bool RemovePendingWork(EventSource* source)
         __TA_REQUIRES(source->obj_lock_) __TA_EXCLUDES(sources_lock_);
 
-    // Process the pending work queue.
-    void DispatchPendingWork();
+    // Process the pending work queue on the pool thread identified by
+    // |thread_id|.  |handed_off| is true if another thread received the work
+    // and passed it to this one.
+    void DispatchPendingWork(uint32_t thread_id, bool handed_off);
+
+    // The ID of the pool thread which last dispatched our work, or
+    // kNoThread if none has yet.
+    static constexpr uint32_t kNoThread = UINT32_MAX;
+    uint32_t last_thread_id() const { return last_thread_id_.load(fbl::memory_order_acquire); }
 
     fbl::Mutex sources_lock_;
     Token domain_token_;
@@ -158,6 +183,8 @@ private:
     bool dispatch_sync_in_progress_ __TA_GUARDED(sources_lock_) = false;
     fbl::RefPtr<ThreadPool> thread_pool_ __TA_GUARDED(sources_lock_);
     zx::event dispatch_idle_evt_;
+    fbl::atomic<uint32_t> last_thread_id_{kNoThread};
+    Stats stats_ __TA_GUARDED(sources_lock_) = { };
 
     // The list of all sources bound to us, as well as the sources which are
     // currently waiting to be dispatched.
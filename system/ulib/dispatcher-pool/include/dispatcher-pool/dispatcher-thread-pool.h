@@ -48,12 +48,24 @@ private:
         zx_status_t Start();
         void Join();
 
+        // Accept responsibility for dispatching |domain|'s pending work if
+        // this thread is running and not already holding a handoff.  Returns
+        // false, and leaves |domain| untouched, if the thread is busy or idle.
+        bool TryHandoff(fbl::RefPtr<ExecutionDomain>* domain) __TA_EXCLUDES(handoff_lock_);
+
     private:
         Thread(fbl::RefPtr<ThreadPool> pool, uint32_t id);
 
         void PrintDebugPrefix() const;
         int Main();
 
+        // Dispatch |domain|'s pending work, preferring the thread which ran
+        // the domain last.
+        void DispatchDomain(fbl::RefPtr<ExecutionDomain> domain);
+
+        // Dispatch any domain handed off to us, then flag ourselves as idle.
+        void DrainHandoffs() __TA_EXCLUDES(handoff_lock_);
+
         // TODO(johngro) : migrate away from C11 threads, use native zircon
         // primatives instead.
         //
@@ -62,8 +74,18 @@ private:
         thrd_t thread_handle_;
         fbl::RefPtr<ThreadPool> pool_;
         const uint32_t id_;
+
+        // A thread is idle while it waits on the pool's port.  A thread
+        // holding a handoff, or which has been dispatching a single domain
+        // for longer than kHandoffWindow, is busy and accepts no new work.
+        fbl::Mutex handoff_lock_;
+        bool idle_ __TA_GUARDED(handoff_lock_) = true;
+        zx_time_t dispatch_start_ __TA_GUARDED(handoff_lock_) = 0;
+        fbl::RefPtr<ExecutionDomain> handoff_ __TA_GUARDED(handoff_lock_);
     };
 
+    static constexpr zx_duration_t kHandoffWindow = ZX_USEC(50);
+
     explicit ThreadPool(uint32_t priority) : priority_(priority) { }
     ~ThreadPool() { }
 
@@ -93,6 +115,14 @@ private:
 
     fbl::DoublyLinkedList<fbl::unique_ptr<Thread>> active_threads_
         __TA_GUARDED(pool_lock_);
+
+    // Threads indexed by ID, for handing domains back to the thread which
+    // last ran them.  Each slot is written under the pool lock before its
+    // thread starts and is cleared only after every thread has been joined,
+    // so anyone who has learned a thread's ID from a domain may read it
+    // without the lock.
+    fbl::unique_ptr<Thread*[]> threads_by_id_;
+    uint32_t max_thread_count_ = 0;
 };
 
 }  // namespace dispatcher
@@ -0,0 +1,456 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/macros.h>
+#include <fbl/new.h>
+#include <fbl/type_support.h>
+#include <fbl/vector.h>
+#include <zircon/assert.h>
+
+namespace fbl {
+
+namespace internal {
+
+// Finalizer from MurmurHash3.  Spreads every bit of the input across the
+// output, so keys which differ only in their high bits (or only in their low
+// bits) still land in different groups and get different control bytes.
+static inline uint64_t FlatHashMix(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ull;
+    k ^= k >> 33;
+    return k;
+}
+
+} // namespace internal
+
+// DefaultFlatHashKeyTraits hashes and compares integer, enum and pointer keys.
+//
+// Key traits for other key types must provide...
+//
+// GetHash : A static method which takes a constant reference to a key and
+//           returns a well mixed uint64_t.  All 64 bits are used, so a hash
+//           which only varies in its low bits will perform poorly.
+// EqualTo : A static method which takes two constant references to keys and
+//           returns true if they are equal.
+template <typename KeyType, typename Enable = void>
+struct DefaultFlatHashKeyTraits;
+
+template <typename KeyType>
+struct DefaultFlatHashKeyTraits<
+    KeyType, typename enable_if<is_integral<KeyType>::value || is_enum<KeyType>::value>::type> {
+    static uint64_t GetHash(const KeyType& key) {
+        return internal::FlatHashMix(static_cast<uint64_t>(key));
+    }
+    static bool EqualTo(const KeyType& a, const KeyType& b) { return a == b; }
+};
+
+template <typename KeyType>
+struct DefaultFlatHashKeyTraits<KeyType, typename enable_if<is_pointer<KeyType>::value>::type> {
+    static uint64_t GetHash(const KeyType& key) {
+        return internal::FlatHashMix(reinterpret_cast<uintptr_t>(key));
+    }
+    static bool EqualTo(const KeyType& a, const KeyType& b) { return a == b; }
+};
+
+// FlatHashMap<> is a non-intrusive, open addressing hash map.
+//
+// Where HashTable<> chains the objects it holds through node state in the
+// objects themselves, FlatHashMap<> stores keys and values by value in one
+// flat array, with no per-entry allocation.  This suits lookup heavy maps of
+// small keys and values (numbers to pointers, say), where following a bucket
+// chain to objects scattered around the heap costs a cache miss per link.
+//
+// The layout follows the "SwissTable" design.  Each slot has a control byte
+// which is either empty, deleted, or holds 7 bits of the key's hash.  Control
+// bytes are examined in groups of eight, and a lookup compares the hash bits
+// against the whole group at once, only comparing keys for slots whose bits
+// match.  The kernel is built without SIMD registers, so the group comparisons
+// are done 64 bits at a time in general purpose registers rather than with SSE
+// or NEON; this keeps one implementation usable everywhere.
+//
+// Inserting may move entries, invalidating iterators and pointers into the
+// map.  Erasing invalidates only iterators and pointers to the erased entry.
+//
+// Allocation failures are reported through AllocChecker, as with Vector<>.
+// Outside the kernel, methods without an AllocChecker assert on failure.
+template <typename KeyType,
+          typename ValueType,
+          typename KeyTraits = DefaultFlatHashKeyTraits<KeyType>,
+          typename AllocatorTraits = DefaultAllocatorTraits>
+class FlatHashMap {
+public:
+    struct Entry {
+        const KeyType key;
+        ValueType value;
+    };
+
+private:
+    template <typename MapType, typename EntryType> class iterator_impl;
+
+public:
+    using iterator       = iterator_impl<FlatHashMap, Entry>;
+    using const_iterator = iterator_impl<const FlatHashMap, const Entry>;
+
+    // move semantics only
+    DISALLOW_COPY_AND_ASSIGN_ALLOW_MOVE(FlatHashMap);
+
+    constexpr FlatHashMap() { }
+
+    FlatHashMap(FlatHashMap&& other) { swap(other); }
+
+    FlatHashMap& operator=(FlatHashMap&& other) {
+        reset();
+        swap(other);
+        return *this;
+    }
+
+    ~FlatHashMap() { reset(); }
+
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+    bool is_empty() const { return size_ == 0; }
+
+    iterator begin() { return iterator(this, NextFull(0)); }
+    iterator end() { return iterator(this, capacity_); }
+    const_iterator begin() const { return const_iterator(this, NextFull(0)); }
+    const_iterator end() const { return const_iterator(this, capacity_); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    // Returns an iterator to the entry for |key|, which is invalid if there is
+    // no such entry.
+    iterator find(const KeyType& key) { return iterator(this, FindIndex(key)); }
+    const_iterator find(const KeyType& key) const { return const_iterator(this, FindIndex(key)); }
+
+    // Inserts |value| under |key|, replacing the value already there if |key|
+    // is present.  On allocation failure the map is unchanged.
+    template <typename K, typename V>
+    void insert(K&& key, V&& value, AllocChecker* ac) {
+        insert_internal(fbl::forward<K>(key), fbl::forward<V>(value), ac);
+    }
+
+    // Removes the entry for |key|.  Returns false if there was none.
+    bool erase(const KeyType& key) {
+        size_t index = FindIndex(key);
+        if (index == capacity_)
+            return false;
+        erase(iterator(this, index));
+        return true;
+    }
+
+    // Removes the entry |iter| refers to, which must be valid.
+    void erase(iterator iter) {
+        ZX_DEBUG_ASSERT(iter.IsValid());
+        size_t index = iter.index_;
+        slots_[index].~Entry();
+        --size_;
+
+        // A lookup stops at the first group with an empty slot in it.  If this
+        // slot's group already has one, no lookup can have needed to continue
+        // past it, so the slot can become empty again.  Otherwise it must be
+        // marked deleted, so lookups keep going.
+        if (MatchEmpty(LoadGroup(index / kGroupWidth))) {
+            ctrl_[index] = kEmpty;
+            ++growth_left_;
+        } else {
+            ctrl_[index] = kDeleted;
+        }
+    }
+
+    // Makes room for at least |count| entries without further allocation.
+    void reserve(size_t count, AllocChecker* ac) {
+        size_t capacity = CapacityFor(count);
+        if (capacity <= capacity_) {
+            ac->arm(0u, true);
+            return;
+        }
+        Rehash(capacity, ac);
+    }
+
+#ifndef _KERNEL
+    template <typename K, typename V>
+    void insert(K&& key, V&& value) {
+        AllocChecker ac;
+        insert_internal(fbl::forward<K>(key), fbl::forward<V>(value), &ac);
+        ZX_ASSERT(ac.check());
+    }
+
+    void reserve(size_t count) {
+        AllocChecker ac;
+        reserve(count, &ac);
+        ZX_ASSERT(ac.check());
+    }
+#endif // _KERNEL
+
+    // Removes every entry, keeping the storage.
+    void clear() {
+        for (size_t i = 0; i < capacity_; ++i) {
+            if (IsFull(ctrl_[i]))
+                slots_[i].~Entry();
+        }
+        if (capacity_ > 0)
+            memset(ctrl_, kEmpty, capacity_);
+        size_ = 0;
+        growth_left_ = MaxLoad(capacity_);
+    }
+
+    // Removes every entry and frees the storage.
+    void reset() {
+        clear();
+        AllocatorTraits::Deallocate(slots_);
+        slots_ = nullptr;
+        ctrl_ = nullptr;
+        capacity_ = 0;
+        growth_left_ = 0;
+    }
+
+    void swap(FlatHashMap& other) {
+        Swap(slots_, other.slots_);
+        Swap(ctrl_, other.ctrl_);
+        Swap(capacity_, other.capacity_);
+        Swap(size_, other.size_);
+        Swap(growth_left_, other.growth_left_);
+    }
+
+private:
+    // Control bytes.  Full slots hold the low 7 bits of their key's hash, so
+    // the top bit tells full slots from the others.  The bit patterns of
+    // kEmpty and kDeleted are chosen for MatchEmpty and MatchEmptyOrDeleted.
+    static constexpr uint8_t kEmpty   = 0x80;
+    static constexpr uint8_t kDeleted = 0xfe;
+
+    static constexpr size_t   kGroupWidth = 8;
+    static constexpr uint64_t kLsbs = 0x0101010101010101ull;
+    static constexpr uint64_t kMsbs = 0x8080808080808080ull;
+
+    static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+                  "Group matching assumes the first control byte is the least significant");
+
+    template <typename MapType, typename EntryType>
+    class iterator_impl {
+    public:
+        iterator_impl() { }
+
+        bool IsValid() const { return (map_ != nullptr) && (index_ < map_->capacity_); }
+        bool operator==(const iterator_impl& other) const { return index_ == other.index_; }
+        bool operator!=(const iterator_impl& other) const { return index_ != other.index_; }
+
+        iterator_impl& operator++() {
+            if (IsValid())
+                index_ = map_->NextFull(index_ + 1);
+            return *this;
+        }
+
+        iterator_impl operator++(int) {
+            iterator_impl ret(*this);
+            ++(*this);
+            return ret;
+        }
+
+        EntryType& operator*() const {
+            ZX_DEBUG_ASSERT(IsValid());
+            return map_->slots_[index_];
+        }
+        EntryType* operator->() const {
+            ZX_DEBUG_ASSERT(IsValid());
+            return &map_->slots_[index_];
+        }
+
+    private:
+        friend class FlatHashMap;
+
+        iterator_impl(MapType* map, size_t index) : map_(map), index_(index) { }
+
+        MapType* map_ = nullptr;
+        size_t index_ = 0;
+    };
+
+    template <typename T>
+    static void Swap(T& a, T& b) {
+        T tmp = a;
+        a = b;
+        b = tmp;
+    }
+
+    static bool IsFull(uint8_t ctrl) { return (ctrl & 0x80) == 0; }
+
+    // The hash picks the group a probe starts at (H1) and the 7 bits stored in
+    // the control byte (H2).
+    static size_t H1(uint64_t hash) { return static_cast<size_t>(hash >> 7); }
+    static uint8_t H2(uint64_t hash) { return static_cast<uint8_t>(hash & 0x7f); }
+
+    // Up to 7/8ths of the slots may be full or deleted, so every probe reaches
+    // an empty slot.
+    static size_t MaxLoad(size_t capacity) { return capacity - capacity / 8; }
+
+    // The smallest power of two capacity which holds |count| entries.
+    static size_t CapacityFor(size_t count) {
+        size_t capacity = kGroupWidth;
+        while (MaxLoad(capacity) < count)
+            capacity *= 2;
+        return capacity;
+    }
+
+    uint64_t LoadGroup(size_t group) const {
+        uint64_t bytes;
+        memcpy(&bytes, ctrl_ + group * kGroupWidth, sizeof(bytes));
+        return bytes;
+    }
+
+    // Each of these returns a mask with the top bit of byte i set if control
+    // byte i of |group| matches.  MatchByte may also flag a byte just above a
+    // true match (the subtraction borrows), so its hits must be confirmed.
+    static uint64_t MatchByte(uint64_t group, uint8_t h2) {
+        uint64_t x = group ^ (kLsbs * h2);
+        return (x - kLsbs) & ~x & kMsbs;
+    }
+    static uint64_t MatchEmpty(uint64_t group) {
+        return group & (~group << 6) & kMsbs;
+    }
+    static uint64_t MatchEmptyOrDeleted(uint64_t group) {
+        return group & (~group << 7) & kMsbs;
+    }
+    static size_t LowestMatch(uint64_t mask) {
+        return static_cast<size_t>(__builtin_ctzll(mask)) / 8;
+    }
+
+    // Returns the index of the slot holding |key|, or capacity_ if none does.
+    size_t FindIndex(const KeyType& key) const {
+        if (size_ == 0)
+            return capacity_;
+
+        uint64_t hash = KeyTraits::GetHash(key);
+        uint8_t h2 = H2(hash);
+        size_t mask = capacity_ / kGroupWidth - 1;
+        size_t group = H1(hash) & mask;
+
+        // Triangular probing visits every group when the group count is a
+        // power of two.
+        for (size_t step = 1;; ++step) {
+            uint64_t bytes = LoadGroup(group);
+            for (uint64_t match = MatchByte(bytes, h2); match; match &= match - 1) {
+                size_t index = group * kGroupWidth + LowestMatch(match);
+                if ((ctrl_[index] == h2) && KeyTraits::EqualTo(slots_[index].key, key))
+                    return index;
+            }
+            if (MatchEmpty(bytes))
+                return capacity_;
+            group = (group + step) & mask;
+        }
+    }
+
+    // Returns the first empty or deleted slot on |hash|'s probe sequence.
+    size_t FindInsertIndex(uint64_t hash) const {
+        size_t mask = capacity_ / kGroupWidth - 1;
+        size_t group = H1(hash) & mask;
+        for (size_t step = 1;; ++step) {
+            uint64_t match = MatchEmptyOrDeleted(LoadGroup(group));
+            if (match)
+                return group * kGroupWidth + LowestMatch(match);
+            group = (group + step) & mask;
+        }
+    }
+
+    size_t NextFull(size_t index) const {
+        while ((index < capacity_) && !IsFull(ctrl_[index]))
+            ++index;
+        return index;
+    }
+
+    template <typename K, typename V>
+    void insert_internal(K&& key, V&& value, AllocChecker* ac) {
+        size_t index = FindIndex(key);
+        if (index != capacity_) {
+            slots_[index].value = fbl::forward<V>(value);
+            ac->arm(0u, true);
+            return;
+        }
+
+        uint64_t hash = KeyTraits::GetHash(key);
+        if (capacity_ > 0)
+            index = FindInsertIndex(hash);
+
+        // Only filling an empty slot uses up growth; a deleted one was already
+        // counted.  When growth runs out, rehash, which also clears out the
+        // deleted slots.  If those make up at least half the load, that frees
+        // enough room without growing.
+        if ((capacity_ == 0) || ((ctrl_[index] == kEmpty) && (growth_left_ == 0))) {
+            size_t capacity;
+            if (capacity_ == 0)
+                capacity = kGroupWidth;
+            else if ((size_ + 1) <= MaxLoad(capacity_) / 2)
+                capacity = capacity_;
+            else
+                capacity = capacity_ * 2;
+            if (!Rehash(capacity, ac))
+                return;
+            index = FindInsertIndex(hash);
+        }
+
+        new (&slots_[index]) Entry{fbl::forward<K>(key), fbl::forward<V>(value)};
+        if (ctrl_[index] == kEmpty)
+            --growth_left_;
+        ctrl_[index] = H2(hash);
+        ++size_;
+        ac->arm(0u, true);
+    }
+
+    // Moves every entry into new storage with room for |capacity| slots.
+    // Returns false, leaving the map unchanged, if the storage can't be
+    // allocated.
+    bool Rehash(size_t capacity, AllocChecker* ac) {
+        ZX_DEBUG_ASSERT(capacity >= kGroupWidth);
+        ZX_DEBUG_ASSERT((capacity & (capacity - 1)) == 0);
+        ZX_DEBUG_ASSERT(MaxLoad(capacity) >= size_);
+
+        // Slots come first, so they get the allocation's alignment, and the
+        // control bytes follow.
+        void* storage = AllocatorTraits::Allocate(capacity * (sizeof(Entry) + 1));
+        if (storage == nullptr) {
+            ac->arm(1u, false);
+            return false;
+        }
+
+        Entry* old_slots = slots_;
+        uint8_t* old_ctrl = ctrl_;
+        size_t old_capacity = capacity_;
+
+        slots_ = reinterpret_cast<Entry*>(storage);
+        ctrl_ = reinterpret_cast<uint8_t*>(slots_ + capacity);
+        capacity_ = capacity;
+        memset(ctrl_, kEmpty, capacity);
+
+        for (size_t i = 0; i < old_capacity; ++i) {
+            if (!IsFull(old_ctrl[i]))
+                continue;
+            uint64_t hash = KeyTraits::GetHash(old_slots[i].key);
+            size_t index = FindInsertIndex(hash);
+            new (&slots_[index]) Entry(fbl::move(old_slots[i]));
+            ctrl_[index] = H2(hash);
+            old_slots[i].~Entry();
+        }
+
+        growth_left_ = MaxLoad(capacity) - size_;
+        AllocatorTraits::Deallocate(old_slots);
+        ac->arm(0u, true);
+        return true;
+    }
+
+    Entry* slots_ = nullptr;
+    uint8_t* ctrl_ = nullptr;
+    size_t capacity_ = 0;
+    size_t size_ = 0;
+    // Empty slots which may still be filled before the map must be rehashed.
+    size_t growth_left_ = 0;
+};
+
+} // namespace fbl
@@ -183,6 +183,13 @@ public:
     // make_iterator : construct an iterator out of a pointer to an object
     iterator make_iterator(ValueType& obj) { return iterator(&obj); }
 
+    // root : an iterator to the node at the root of the tree, which is invalid
+    // if the tree is empty.  Together with the iterators' left(), right() and
+    // parent(), this lets users who keep augmented per-subtree state in their
+    // Observer search the tree by it.
+    iterator        root()       { return iterator(PtrTraits::GetRaw(root_)); }
+    const_iterator  root() const { return const_iterator(PtrTraits::GetRaw(root_)); }
+
     // is_empty : True if the tree has at least one element in it, false otherwise.
     bool is_empty() const { return root_ == nullptr; }
 
@@ -563,6 +570,22 @@ private:
         }
 
         bool IsValid() const { return PtrTraits::IsValid(node_); }
+
+        // The node's children and parent in the tree.  The iterator returned
+        // is invalid if there is no such node.
+        iterator_impl left() const {
+            ZX_DEBUG_ASSERT(IsValid());
+            return iterator_impl(PtrTraits::GetRaw(NodeTraits::node_state(*node_).left_));
+        }
+        iterator_impl right() const {
+            ZX_DEBUG_ASSERT(IsValid());
+            return iterator_impl(PtrTraits::GetRaw(NodeTraits::node_state(*node_).right_));
+        }
+        iterator_impl parent() const {
+            ZX_DEBUG_ASSERT(IsValid());
+            return iterator_impl(NodeTraits::node_state(*node_).parent_);
+        }
+
         bool operator==(const iterator_impl& other) const { return node_ == other.node_; }
         bool operator!=(const iterator_impl& other) const { return node_ != other.node_; }
 
@@ -694,6 +717,7 @@ private:
 
             ++count_;
             Observer::RecordInsert();
+            Observer::RecordSubtreeChange(iterator(PtrTraits::GetRaw(root_)));
             return;
         }
 
@@ -769,6 +793,7 @@ private:
 
         ++count_;
         Observer::RecordInsert();
+        Observer::RecordSubtreeChange(iterator(PtrTraits::GetRaw(*owner)));
 
         // Finally, perform post-insert balance operations.
         BalancePostInsert(PtrTraits::GetRaw(*owner));
@@ -913,6 +938,10 @@ private:
         // Time to rebalance.  We know that we don't need to rebalance if we
         // just removed the root (IOW - its parent was the sentinel value).
         if (!PtrTraits::IsSentinel(parent)) {
+            // The removed node's old parent has lost a descendant.  Any node
+            // swapped into the target's place is on the path above it.
+            Observer::RecordSubtreeChange(iterator(parent));
+
             if (was_one_child) {
                 // If the node we removed was a 1-child, then we may have just
                 // turned its parent into a 2,2 leaf node.  If so, we have a
@@ -990,6 +1019,7 @@ private:
         // caller.
         PtrTraits::Swap(GetLinkPtrToNode(old_node), new_node);
         pod_swap(old_ns.parent_, new_ns.parent_);
+        Observer::RecordSubtreeChange(iterator(new_raw));
         return fbl::move(new_node);
     }
 
@@ -1348,6 +1378,10 @@ private:
         Z_ns.parent_ = X;
         if (Y)
             NodeTraits::node_state(*Y).parent_ = Z;
+
+        // X's subtree now holds what Z's did, so only Z and X themselves need
+        // their augmented state recomputed, Z first.
+        Observer::RecordRotation(iterator(Z), iterator(X));
     }
 
     // PostInsertFixupLR<LRTraits>
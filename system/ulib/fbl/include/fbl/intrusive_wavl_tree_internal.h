@@ -26,6 +26,24 @@ class WAVLTreeChecker;
 // phase of rebalancing are considered to be part of the cost of rotation and
 // are not tallied in the overall promote/demote accounting.
 //
+// Observers may also keep augmented state in each node which summarizes the
+// node's subtree (for example, its size, or the largest key gap in it).  Two
+// hooks, called with tree iterators, let them keep it current.
+//
+// RecordSubtreeChange(node)
+//   |node|'s subtree has gained or lost a node, or |node| itself has just
+//   been linked in.  Recompute |node|'s state from its children, then that of
+//   each of its ancestors up to the root.
+// RecordRotation(child, parent)
+//   A rotation has just made |child| (which was |parent|'s parent) a child of
+//   |parent|.  The subtree at |parent| holds the same nodes as the one at
+//   |child| did, so only these two need their state recomputed, |child|
+//   first.
+//
+// Users whose augmented state depends on the contents of a node (rather than
+// just its key and position) must make a RecordSubtreeChange style update of
+// their own when those contents change.
+//
 struct DefaultWAVLTreeObserver {
     static void RecordInsert()               { }
     static void RecordInsertPromote()        { }
@@ -37,6 +55,9 @@ struct DefaultWAVLTreeObserver {
     static void RecordEraseRotation()        { }
     static void RecordEraseDoubleRotation()  { }
 
+    template <typename Iter> static void RecordSubtreeChange(Iter node)          { }
+    template <typename Iter> static void RecordRotation(Iter child, Iter parent) { }
+
     template <typename TreeType>
     static bool VerifyRankRule(const TreeType& tree, typename TreeType::RawPtrType node) {
         return true;
@@ -20,6 +20,24 @@ namespace internal {
 template <typename U>
 using remove_cv_ref = typename remove_cv<typename remove_reference<U>::type>::type;
 
+// Storage for the elements a Vector<> holds before it needs the heap.
+template <typename T, size_t N>
+class VectorInlineStorage {
+protected:
+    T* inline_data() { return reinterpret_cast<T*>(inline_storage_); }
+    const T* inline_data() const { return reinterpret_cast<const T*>(inline_storage_); }
+
+private:
+    alignas(T) char inline_storage_[N * sizeof(T)];
+};
+
+// With no inline elements this is empty, and costs nothing as a base class.
+template <typename T>
+class VectorInlineStorage<T, 0> {
+protected:
+    constexpr T* inline_data() const { return nullptr; }
+};
+
 } // namespace internal
 
 struct DefaultAllocatorTraits {
@@ -58,27 +76,33 @@ struct DefaultAllocatorTraits {
 // This Vector supports O(1) indexing and O(1) (amortized) insertion and
 // deletion at the end (due to possible reallocations during push_back
 // and pop_back).
-template <typename T, typename AllocatorTraits = DefaultAllocatorTraits>
-class Vector {
+//
+// If |InlineCapacity| is non-zero, the first |InlineCapacity| elements are
+// stored within the Vector itself, and the heap is only used once it grows
+// beyond that (see InlineVector<>, below). Moving or swapping such a Vector
+// moves its elements one by one while they are stored inline.
+template <typename T, typename AllocatorTraits = DefaultAllocatorTraits,
+          size_t InlineCapacity = 0>
+class Vector : private internal::VectorInlineStorage<T, InlineCapacity> {
 public:
     // move semantics only
     DISALLOW_COPY_AND_ASSIGN_ALLOW_MOVE(Vector);
 
     constexpr Vector()
-        : ptr_(nullptr), size_(0U), capacity_(0U) {}
+        : ptr_(this->inline_data()), size_(0U), capacity_(InlineCapacity) {}
 
     Vector(Vector&& other)
-        : ptr_(nullptr), size_(other.size_), capacity_(other.capacity_) {
-        ptr_ = other.release();
+        : ptr_(this->inline_data()), size_(0U), capacity_(InlineCapacity) {
+        take(other);
     }
 
 #ifndef _KERNEL
     Vector(fbl::initializer_list<T> init)
-        : ptr_(init.size() != 0u ? reinterpret_cast<T*>(AllocatorTraits::Allocate(
-                                       init.size() * sizeof(T)))
-                                 : nullptr),
+        : ptr_(init.size() > InlineCapacity ? reinterpret_cast<T*>(AllocatorTraits::Allocate(
+                                                  init.size() * sizeof(T)))
+                                            : this->inline_data()),
           size_(init.size()),
-          capacity_(size_) {
+          capacity_(init.size() > InlineCapacity ? size_ : InlineCapacity) {
         T* out = ptr_;
         for (const T* in = init.begin(); in != init.end(); ++in, ++out) {
             new (out) T(*in);
@@ -87,9 +111,10 @@ public:
 #endif
 
     Vector& operator=(Vector&& o) {
-        auto size = o.size_;
-        auto capacity = o.capacity_;
-        reset(o.release(), size, capacity);
+        if (this != &o) {
+            reset();
+            take(o);
+        }
         return *this;
     }
 
@@ -123,11 +148,26 @@ public:
     }
 #endif // _KERNEL
 
+    // Destroys every element and releases any heap storage.
     void reset() {
-        reset(nullptr, 0U, 0U);
+        while (size_ > 0) {
+            ptr_[--size_].~T();
+        }
+        if (!is_inline()) {
+            AllocatorTraits::Deallocate(ptr_);
+        }
+        ptr_ = this->inline_data();
+        capacity_ = InlineCapacity;
     }
 
     void swap(Vector& other) {
+        if (is_inline() || other.is_inline()) {
+            // Inline elements can't trade places by pointer.
+            Vector tmp(fbl::move(other));
+            other = fbl::move(*this);
+            *this = fbl::move(tmp);
+            return;
+        }
         T* t = ptr_;
         ptr_ = other.ptr_;
         other.ptr_ = t;
@@ -368,7 +408,7 @@ private:
     // under the shrink factor.
     void consider_shrinking() {
         if (size_ * kCapacityShrinkFactor < capacity_ &&
-            capacity_ > kCapacityMinimum) {
+            capacity_ > kCapacityMinimum && !is_inline()) {
             // Try to shrink the underlying storage
             static_assert((kCapacityMinimum + 1) >= kCapacityShrinkFactor,
                           "Capacity heuristics risk reallocating to zero capacity");
@@ -385,18 +425,23 @@ private:
     // Forces capacity to become newCapcity.
     // Returns true on success, false on failure.
     // If reallocate fails, the old "ptr_" array is unmodified.
+    //
+    // A capacity which fits in the inline storage moves the elements back
+    // there, and never fails.
     bool reallocate(size_t newCapacity, AllocChecker* ac) {
         ZX_DEBUG_ASSERT(newCapacity > 0);
         ZX_DEBUG_ASSERT(newCapacity >= size_);
+        if (newCapacity <= InlineCapacity) {
+            move_to_inline();
+            ac->arm(0u, true);
+            return true;
+        }
         auto newPtr = reinterpret_cast<T*>(AllocatorTraits::Allocate(newCapacity * sizeof(T)));
         if (newPtr == nullptr) {
             ac->arm(1u, false);
             return false;
         }
-        transfer_to(newPtr, size_);
-        AllocatorTraits::Deallocate(ptr_);
-        capacity_ = newCapacity;
-        ptr_ = newPtr;
+        replace_storage(newPtr, newCapacity);
         ac->arm(0u, true);
         return true;
     }
@@ -405,35 +450,52 @@ private:
     void reallocate(size_t newCapacity) {
         ZX_DEBUG_ASSERT(newCapacity > 0);
         ZX_DEBUG_ASSERT(newCapacity >= size_);
+        if (newCapacity <= InlineCapacity) {
+            move_to_inline();
+            return;
+        }
         auto newPtr = reinterpret_cast<T*>(AllocatorTraits::Allocate(newCapacity * sizeof(T)));
+        replace_storage(newPtr, newCapacity);
+    }
+#endif
+
+    void move_to_inline() {
+        if (InlineCapacity > 0 && !is_inline()) {
+            replace_storage(this->inline_data(), InlineCapacity);
+        }
+    }
+
+    void replace_storage(T* newPtr, size_t newCapacity) {
         transfer_to(newPtr, size_);
-        AllocatorTraits::Deallocate(ptr_);
+        if (!is_inline()) {
+            AllocatorTraits::Deallocate(ptr_);
+        }
         capacity_ = newCapacity;
         ptr_ = newPtr;
     }
-#endif
 
-    // Release returns the underlying storage of the vector,
-    // while emptying out the vector itself (so it can be destroyed
-    // without deleting the release storage).
-    T* release() {
-        T* t = ptr_;
-        ptr_ = nullptr;
-        size_ = 0;
-        capacity_ = 0;
-        return t;
+    // True if the elements live in the inline storage. Always false when
+    // there is none.
+    bool is_inline() const {
+        return InlineCapacity > 0 && ptr_ == this->inline_data();
     }
 
-    void reset(T* t, size_t size, size_t capacity) {
-        ZX_DEBUG_ASSERT(size <= capacity);
-        while (size_ > 0) {
-            ptr_[--size_].~T();
+    // Takes the contents of |other|, leaving it empty. This vector must
+    // already be empty and using its inline storage (if any).
+    void take(Vector& other) {
+        ZX_DEBUG_ASSERT(size_ == 0);
+        if (other.is_inline()) {
+            other.transfer_to(ptr_, other.size_);
+            size_ = other.size_;
+            other.size_ = 0;
+            return;
         }
-        T* ptr = ptr_;
-        ptr_ = t;
-        size_ = size;
-        capacity_ = capacity;
-        AllocatorTraits::Deallocate(ptr);
+        ptr_ = other.ptr_;
+        size_ = other.size_;
+        capacity_ = other.capacity_;
+        other.ptr_ = other.inline_data();
+        other.size_ = 0;
+        other.capacity_ = InlineCapacity;
     }
 
     T* ptr_;
@@ -445,4 +507,9 @@ private:
     static constexpr size_t kCapacityShrinkFactor = 4;
 };
 
+// InlineVector<> is a Vector<> which keeps its first |N| elements within
+// itself, so vectors which usually stay short don't allocate at all.
+template <typename T, size_t N, typename AllocatorTraits = DefaultAllocatorTraits>
+using InlineVector = Vector<T, AllocatorTraits, N>;
+
 } // namespace fbl
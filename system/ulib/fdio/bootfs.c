@@ -29,9 +29,13 @@ zx_status_t bootfs_create(bootfs_t* bfs, zx_handle_t vmo) {
     if ((r = zx_handle_duplicate(vmo, ZX_RIGHT_SAME_RIGHTS, &bfs->vmo)) < 0) {
         return r;
     }
+    // The hash index, if any, directly follows the directory.
+    // Ignore one that is malformed; lookups will walk the directory.
+    bool hashed = (hdr.hashsize >= sizeof(bootfs_hash_t)) &&
+                  (hdr.hashsize <= UINT32_MAX - sizeof(hdr) - hdr.dirsize);
+    size_t mapsize = sizeof(hdr) + hdr.dirsize + (hashed ? hdr.hashsize : 0);
     uintptr_t addr;
-    if ((r = zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0,
-                         sizeof(hdr) + hdr.dirsize,
+    if ((r = zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, mapsize,
                          ZX_VM_FLAG_PERM_READ, &addr)) < 0) {
         printf("boofts_create: couldn't map directory: %d\n", r);
         zx_handle_close(bfs->vmo);
@@ -39,14 +43,23 @@ zx_status_t bootfs_create(bootfs_t* bfs, zx_handle_t vmo) {
     }
     bfs->dirsize = hdr.dirsize;
     bfs->dir = (void*)addr + sizeof(hdr);
+    bfs->hash = NULL;
+    if (hashed) {
+        const bootfs_hash_t* hash = bfs->dir + hdr.dirsize;
+        uint32_t count = hash->slot_count;
+        if ((count != 0) && ((count & (count - 1)) == 0) &&
+            (count <= (hdr.hashsize - sizeof(bootfs_hash_t)) / sizeof(uint32_t))) {
+            bfs->hash = hash;
+        }
+    }
     return ZX_OK;
 }
 
 void bootfs_destroy(bootfs_t* bfs) {
+    const bootfs_header_t* hdr = bfs->dir - sizeof(bootfs_header_t);
+    size_t mapsize = sizeof(*hdr) + bfs->dirsize + (bfs->hash ? hdr->hashsize : 0);
     zx_handle_close(bfs->vmo);
-    zx_vmar_unmap(zx_vmar_root_self(),
-                  (uintptr_t)bfs->dir - sizeof(bootfs_header_t),
-                  bfs->dirsize);
+    zx_vmar_unmap(zx_vmar_root_self(), (uintptr_t)hdr, mapsize);
 }
 
 zx_status_t bootfs_parse(bootfs_t* bfs,
@@ -72,11 +85,58 @@ zx_status_t bootfs_parse(bootfs_t* bfs,
     return ZX_OK;
 }
 
+static bool bootfs_entry_valid(const bootfs_entry_t* e, size_t avail) {
+    return (avail > sizeof(bootfs_entry_t)) &&
+           (e->name_len >= 1) && (e->name_len <= BOOTFS_MAX_NAME_LEN) &&
+           (BOOTFS_RECSIZE(e) <= avail) && (e->name[e->name_len - 1] == 0);
+}
+
+// Find |name| through the hash index, without walking the directory.
+static zx_status_t bootfs_lookup(bootfs_t* bfs, const char* name, size_t name_len,
+                                 bootfs_entry_t** out) {
+    const bootfs_hash_t* hash = bfs->hash;
+    uint32_t mask = hash->slot_count - 1;
+    uint32_t slot = bootfs_hash_name(name, name_len - 1) & mask;
+    for (uint32_t n = 0; n <= mask; n++) {
+        uint32_t off = hash->slot[slot];
+        if (off == 0) {
+            return ZX_ERR_NOT_FOUND;
+        }
+        off--;
+        if ((off >= bfs->dirsize) || (off % 4)) {
+            printf("bootfs: bogus hash entry!\n");
+            return ZX_ERR_IO;
+        }
+        bootfs_entry_t* e = bfs->dir + off;
+        if (!bootfs_entry_valid(e, bfs->dirsize - off)) {
+            printf("bootfs: bogus entry!\n");
+            return ZX_ERR_IO;
+        }
+        if ((name_len == e->name_len) && (memcmp(name, e->name, name_len) == 0)) {
+            *out = e;
+            return ZX_OK;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return ZX_ERR_NOT_FOUND;
+}
+
 zx_status_t bootfs_open(bootfs_t* bfs, const char* name, zx_handle_t* vmo_out) {
     size_t name_len = strlen(name) + 1;
     size_t avail = bfs->dirsize;
     void* p = bfs->dir;
     bootfs_entry_t* e;
+    if (bfs->hash != NULL) {
+        zx_status_t r = bootfs_lookup(bfs, name, name_len, &e);
+        if (r == ZX_OK) {
+            goto found;
+        }
+        if (r == ZX_ERR_NOT_FOUND) {
+            printf("bootfs_open: '%s' not found\n", name);
+            return r;
+        }
+        // a damaged index; fall back to walking the directory
+    }
     while (avail > sizeof(bootfs_entry_t)) {
         e = p;
         size_t sz = BOOTFS_RECSIZE(e);
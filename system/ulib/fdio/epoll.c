@@ -0,0 +1,409 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <threads.h>
+
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
+#include <fdio/io.h>
+#include <fdio/util.h>
+
+#include "private.h"
+#include "unistd.h"
+
+// The wait hooks take and return poll events, which epoll events are.
+static_assert(EPOLLIN == POLLIN, "");
+static_assert(EPOLLPRI == POLLPRI, "");
+static_assert(EPOLLOUT == POLLOUT, "");
+static_assert(EPOLLERR == POLLERR, "");
+static_assert(EPOLLHUP == POLLHUP, "");
+static_assert(EPOLLRDHUP == POLLRDHUP, "");
+
+// Interest in one fd. Unlike poll() and select(), which set up a wait on
+// every fd each time they are called, the wait stays registered with the
+// epoll port from one epoll_wait() to the next, so a wait only costs as much
+// as the fds that became ready.
+//
+// Level-triggered items wait once. After they report, the next epoll_wait()
+// arms them again, and so reports them again for as long as the fd is ready.
+// Edge-triggered items wait repeatedly, reporting whenever the fd's signals
+// change while it is ready, and are never armed again.
+typedef struct epoll_item epoll_item_t;
+struct epoll_item {
+    int fd;
+    // Holds a reference while the item is registered.
+    fdio_t* io;
+    // As given to epoll_ctl(), including EPOLLET and EPOLLONESHOT.
+    uint32_t events;
+    epoll_data_t data;
+
+    // From the wait_begin hook. The handle belongs to |io|.
+    zx_handle_t handle;
+    zx_signals_t signals;
+    // Of the current wait, so that packets from earlier ones can be told
+    // apart: the generation in the high word and the fd in the low word.
+    uint64_t key;
+    bool armed;
+
+    bool rearm_pending;
+    epoll_item_t* next_rearm;
+};
+
+typedef struct fdio_epoll {
+    fdio_t io;
+    zx_handle_t port;
+
+    mtx_t lock;
+    uint32_t generation;
+    // Level-triggered items to arm at the start of the next epoll_wait().
+    epoll_item_t* rearm;
+    epoll_item_t* items[FDIO_MAX_FD];
+} fdio_epoll_t;
+
+static zx_status_t epoll_arm(fdio_epoll_t* ep, epoll_item_t* item) {
+    item->armed = false;
+    item->io->ops->wait_begin(item->io, item->events & ~(EPOLLET | EPOLLONESHOT),
+                              &item->handle, &item->signals);
+    if (item->handle == ZX_HANDLE_INVALID) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    item->key = ((uint64_t)++ep->generation << 32) | (uint32_t)item->fd;
+    if (item->signals == 0) {
+        return ZX_OK;
+    }
+    uint32_t options = (item->events & EPOLLET) ? ZX_WAIT_ASYNC_REPEATING : ZX_WAIT_ASYNC_ONCE;
+    zx_status_t status = zx_object_wait_async(item->handle, ep->port, item->key,
+                                              item->signals, options);
+    if (status == ZX_OK) {
+        item->armed = true;
+    }
+    return status;
+}
+
+static void epoll_disarm(fdio_epoll_t* ep, epoll_item_t* item) {
+    if (item->rearm_pending) {
+        epoll_item_t** link = &ep->rearm;
+        while (*link != item) {
+            link = &(*link)->next_rearm;
+        }
+        *link = item->next_rearm;
+        item->rearm_pending = false;
+    }
+    if (item->armed) {
+        // This also takes back its packet, if one is queued. It fails if
+        // the fd has been closed, which cancelled the wait already.
+        zx_port_cancel(ep->port, item->handle, item->key);
+        item->armed = false;
+    }
+}
+
+static void epoll_remove(fdio_epoll_t* ep, epoll_item_t* item) {
+    epoll_disarm(ep, item);
+    ep->items[item->fd] = NULL;
+    fdio_release(item->io);
+    free(item);
+}
+
+static void epoll_rearm_all(fdio_epoll_t* ep) {
+    while (ep->rearm != NULL) {
+        epoll_item_t* item = ep->rearm;
+        ep->rearm = item->next_rearm;
+        item->rearm_pending = false;
+        // If this fails the fd has been closed, and will never be ready.
+        epoll_arm(ep, item);
+    }
+}
+
+// Returns the events |packet| reports, if it is from the current wait of
+// one of the items, and sets |*item_out| to that item.
+static uint32_t epoll_deliver(fdio_epoll_t* ep, const zx_port_packet_t* packet,
+                              epoll_item_t** item_out) {
+    uint32_t fd = (uint32_t)packet->key;
+    if (fd >= FDIO_MAX_FD) {
+        return 0;
+    }
+    epoll_item_t* item = ep->items[fd];
+    if (item == NULL || item->key != packet->key) {
+        return 0;
+    }
+
+    uint32_t events = 0;
+    item->io->ops->wait_end(item->io, packet->signal.observed, &events);
+    // As with poll(), errors and hangups are reported whether asked for or not.
+    events &= item->events | EPOLLERR | EPOLLHUP;
+
+    if (item->events & EPOLLET) {
+        if (events != 0 && (item->events & EPOLLONESHOT)) {
+            epoll_disarm(ep, item);
+        } else {
+            // The fd may want to wait for other signals now, as a socket
+            // does once it has connected.
+            zx_handle_t handle;
+            zx_signals_t signals;
+            item->io->ops->wait_begin(item->io, item->events & ~(EPOLLET | EPOLLONESHOT),
+                                      &handle, &signals);
+            if (handle != item->handle || signals != item->signals) {
+                epoll_disarm(ep, item);
+                epoll_arm(ep, item);
+            }
+        }
+    } else {
+        item->armed = false;
+        if (events == 0 || !(item->events & EPOLLONESHOT)) {
+            item->rearm_pending = true;
+            item->next_rearm = ep->rearm;
+            ep->rearm = item;
+        }
+    }
+
+    *item_out = item;
+    return events;
+}
+
+static zx_status_t epoll_close(fdio_t* io) {
+    fdio_epoll_t* ep = (fdio_epoll_t*)io;
+    mtx_lock(&ep->lock);
+    for (int fd = 0; fd < FDIO_MAX_FD; fd++) {
+        if (ep->items[fd] != NULL) {
+            // Closing the port cancels all the waits at once.
+            ep->items[fd]->armed = false;
+            ep->items[fd]->rearm_pending = false;
+            epoll_remove(ep, ep->items[fd]);
+        }
+    }
+    ep->rearm = NULL;
+    zx_handle_t port = ep->port;
+    ep->port = ZX_HANDLE_INVALID;
+    mtx_unlock(&ep->lock);
+    return zx_handle_close(port);
+}
+
+static fdio_ops_t fdio_epoll_ops = {
+    .read = fdio_default_read,
+    .read_at = fdio_default_read_at,
+    .write = fdio_default_write,
+    .write_at = fdio_default_write_at,
+    .recvfrom = fdio_default_recvfrom,
+    .sendto = fdio_default_sendto,
+    .recvmsg = fdio_default_recvmsg,
+    .sendmsg = fdio_default_sendmsg,
+    .seek = fdio_default_seek,
+    .misc = fdio_default_misc,
+    .close = epoll_close,
+    .open = fdio_default_open,
+    .clone = fdio_default_clone,
+    .ioctl = fdio_default_ioctl,
+    .unwrap = fdio_default_unwrap,
+    .shutdown = fdio_default_shutdown,
+    .wait_begin = fdio_default_wait_begin,
+    .wait_end = fdio_default_wait_end,
+    .posix_ioctl = fdio_default_posix_ioctl,
+    .get_vmo = fdio_default_get_vmo,
+};
+
+// Returns the epoll object of |epfd| with a reference held, or NULL having
+// set errno.
+static fdio_epoll_t* fd_to_epoll(int epfd) {
+    fdio_t* io = fd_to_io(epfd);
+    if (io == NULL) {
+        errno = EBADF;
+        return NULL;
+    }
+    if (!(io->flags & FDIO_FLAG_EPOLL)) {
+        fdio_release(io);
+        errno = EINVAL;
+        return NULL;
+    }
+    return (fdio_epoll_t*)io;
+}
+
+int epoll_create1(int flags) {
+    if (flags & ~EPOLL_CLOEXEC) {
+        return ERRNO(EINVAL);
+    }
+    fdio_epoll_t* ep = calloc(1, sizeof(*ep));
+    if (ep == NULL) {
+        return ERRNO(ENOMEM);
+    }
+    zx_status_t status = zx_port_create(0, &ep->port);
+    if (status != ZX_OK) {
+        free(ep);
+        return ERROR(status);
+    }
+    ep->io.ops = &fdio_epoll_ops;
+    ep->io.magic = FDIO_MAGIC;
+    ep->io.refcount = 1;
+    ep->io.flags = FDIO_FLAG_EPOLL;
+    mtx_init(&ep->lock, mtx_plain);
+
+    int fd = fdio_bind_to_fd(&ep->io, -1, 0);
+    if (fd < 0) {
+        int errno_ = errno;
+        fdio_close(&ep->io);
+        fdio_release(&ep->io);
+        return ERRNO(errno_);
+    }
+    return fd;
+}
+
+int epoll_create(int size) {
+    if (size <= 0) {
+        return ERRNO(EINVAL);
+    }
+    return epoll_create1(0);
+}
+
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event* event) {
+    if (op != EPOLL_CTL_DEL && event == NULL) {
+        return ERRNO(EFAULT);
+    }
+    fdio_epoll_t* ep = fd_to_epoll(epfd);
+    if (ep == NULL) {
+        return -1;
+    }
+    if (fd < 0 || fd >= FDIO_MAX_FD) {
+        fdio_release(&ep->io);
+        return ERRNO(EBADF);
+    }
+    fdio_t* io = fd_to_io(fd);
+    if (io != NULL && (io->flags & FDIO_FLAG_EPOLL)) {
+        // Nor can epoll fds be waited for by poll() or select().
+        fdio_release(io);
+        fdio_release(&ep->io);
+        return ERRNO(EINVAL);
+    }
+
+    int r = 0;
+    zx_status_t status = ZX_OK;
+    mtx_lock(&ep->lock);
+    epoll_item_t* item = ep->items[fd];
+    if (item != NULL && item->io != io) {
+        // The fd was closed, and perhaps reused, since it was added, so
+        // forget it as Linux would have done when it was closed.
+        epoll_remove(ep, item);
+        item = NULL;
+    }
+    if (io == NULL) {
+        r = ERRNO(EBADF);
+        goto done;
+    }
+
+    switch (op) {
+    case EPOLL_CTL_ADD:
+        if (item != NULL) {
+            r = ERRNO(EEXIST);
+            break;
+        }
+        item = calloc(1, sizeof(*item));
+        if (item == NULL) {
+            r = ERRNO(ENOMEM);
+            break;
+        }
+        item->fd = fd;
+        item->io = io;
+        io = NULL; // the item holds the reference now
+        item->events = event->events;
+        item->data = event->data;
+        ep->items[fd] = item;
+        if ((status = epoll_arm(ep, item)) != ZX_OK) {
+            epoll_remove(ep, item);
+        }
+        break;
+    case EPOLL_CTL_MOD:
+        if (item == NULL) {
+            r = ERRNO(ENOENT);
+            break;
+        }
+        epoll_disarm(ep, item);
+        item->events = event->events;
+        item->data = event->data;
+        status = epoll_arm(ep, item);
+        break;
+    case EPOLL_CTL_DEL:
+        if (item == NULL) {
+            r = ERRNO(ENOENT);
+            break;
+        }
+        epoll_remove(ep, item);
+        break;
+    default:
+        r = ERRNO(EINVAL);
+        break;
+    }
+    if (status == ZX_ERR_NOT_SUPPORTED) {
+        // As Linux says for regular files, which are always ready.
+        r = ERRNO(EPERM);
+    } else if (status != ZX_OK) {
+        r = ERROR(status);
+    }
+
+done:
+    mtx_unlock(&ep->lock);
+    if (io != NULL) {
+        fdio_release(io);
+    }
+    fdio_release(&ep->io);
+    return r;
+}
+
+int epoll_pwait(int epfd, struct epoll_event* events, int maxevents, int timeout,
+                const sigset_t* sigmask) {
+    if (sigmask) {
+        return ERRNO(ENOSYS);
+    }
+    if (maxevents <= 0) {
+        return ERRNO(EINVAL);
+    }
+    fdio_epoll_t* ep = fd_to_epoll(epfd);
+    if (ep == NULL) {
+        return -1;
+    }
+
+    zx_time_t deadline = timeout < 0 ? ZX_TIME_INFINITE : zx_deadline_after(ZX_MSEC(timeout));
+    zx_port_packet_t packets[ZX_PORT_MAX_BATCH_PACKETS];
+    size_t max = (size_t)maxevents < countof(packets) ? (size_t)maxevents : countof(packets);
+
+    int n = 0;
+    zx_status_t status;
+    do {
+        mtx_lock(&ep->lock);
+        epoll_rearm_all(ep);
+        mtx_unlock(&ep->lock);
+
+        size_t count;
+        status = zx_port_wait_many(ep->port, deadline, packets, max, &count);
+        if (status != ZX_OK) {
+            break;
+        }
+
+        mtx_lock(&ep->lock);
+        for (size_t i = 0; i < count; i++) {
+            if (packets[i].type != ZX_PKT_TYPE_SIGNAL_ONE &&
+                packets[i].type != ZX_PKT_TYPE_SIGNAL_REP) {
+                continue;
+            }
+            epoll_item_t* item;
+            uint32_t revents = epoll_deliver(ep, &packets[i], &item);
+            if (revents != 0) {
+                events[n].events = revents;
+                events[n].data = item->data;
+                n++;
+            }
+        }
+        mtx_unlock(&ep->lock);
+    } while (n == 0);
+
+    fdio_release(&ep->io);
+    return (n > 0 || status == ZX_ERR_TIMED_OUT) ? n : ERROR(status);
+}
+
+int epoll_wait(int epfd, struct epoll_event* events, int maxevents, int timeout) {
+    return epoll_pwait(epfd, events, maxevents, timeout, NULL);
+}
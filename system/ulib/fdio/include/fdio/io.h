@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <dirent.h>
 #include <limits.h>
 #include <poll.h>
 #include <stdbool.h>
@@ -36,6 +37,8 @@
 #define FDIO_EVT_PEER_CLOSED POLLRDHUP
 #define FDIO_EVT_ALL (POLLIN | POLLOUT | POLLERR | POLLRDHUP)
 
+struct stat;
+
 __BEGIN_CDECLS
 
 // wait until one or more events are pending
@@ -47,6 +50,21 @@ zx_status_t fdio_wait_fd(int fd, uint32_t events, uint32_t* pending, zx_time_t d
 // shared_handle is true.
 int fdio_handle_fd(zx_handle_t h, zx_signals_t signals_in, zx_signals_t signals_out, bool shared_handle);
 
+// Stats the |count| entries of the directory |dirfd| named by |names|, as
+// fstatat() would, storing each entry's attributes in |stats| and status in
+// |statuses|. The opens and stats of many entries of a remote directory are
+// kept in flight at once, so this is much faster than calling fstatat() for
+// each of them, as ls-style traversals do.
+zx_status_t fdio_stat_entries(int dirfd, const char* const* names, size_t count,
+                              struct stat* stats, zx_status_t* statuses);
+
+// Reads the next entry of |dir| as readdir() would, also storing the
+// attributes of the node it names in |st|, as fstatat() would. Remote
+// directories return the attributes together with the entries, so this is
+// much faster than calling fstatat() for each entry. |st| is zeroed if the
+// entry's attributes cannot be read.
+struct dirent* fdio_readdir_stat(DIR* dir, struct stat* st);
+
 // invoke a raw fdio ioctl
 ssize_t fdio_ioctl(int fd, int op, const void* in_buf, size_t in_len, void* out_buf, size_t out_len);
 
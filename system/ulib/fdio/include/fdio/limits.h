@@ -16,6 +16,10 @@
 // at least this size.
 #define FDIO_CHUNK_SIZE 8192
 
+// Maximum size of the VMO through which a remoteio connection may move
+// file data, and so of a single READ_VMO or WRITE_VMO transfer.
+#define FDIO_IO_VMO_SIZE (1024 * 1024)
+
 // Maximum size for an ioctl input.
 #define FDIO_IOCTL_MAX_INPUT 1024
 
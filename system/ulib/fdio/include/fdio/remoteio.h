@@ -58,7 +58,14 @@ __BEGIN_CDECLS
 #define ZXRIO_LINK        (0x0000001a | ZXRIO_ONE_HANDLE)
 #define ZXRIO_MMAP         0x0000001b
 #define ZXRIO_FCNTL        0x0000001c
-#define ZXRIO_NUM_OPS      29
+#define ZXRIO_IO_VMO      (0x0000001d | ZXRIO_ONE_HANDLE)
+#define ZXRIO_READ_VMO     0x0000001e
+#define ZXRIO_READ_AT_VMO  0x0000001f
+#define ZXRIO_WRITE_VMO    0x00000020
+#define ZXRIO_WRITE_AT_VMO 0x00000021
+#define ZXRIO_SHARE_VMO    0x00000022
+#define ZXRIO_READDIR_PLUS 0x00000023
+#define ZXRIO_NUM_OPS      36
 
 #define ZXRIO_OP(n)        ((n) & 0x3FF) // opcode
 #define ZXRIO_HC(n)        (((n) >> 8) & 3) // handle count
@@ -71,7 +78,9 @@ __BEGIN_CDECLS
     "read_at", "write_at", "truncate", "rename", \
     "connect", "bind", "listen", "getsockname", \
     "getpeername", "getsockopt", "setsockopt", "getaddrinfo", \
-    "setattr", "sync", "link", "mmap", "fcntl" }
+    "setattr", "sync", "link", "mmap", \
+    "fcntl", "io_vmo", "read_vmo", "read_at_vmo", \
+    "write_vmo", "write_at_vmo", "share_vmo", "readdir_plus" }
 
 // dispatcher callback return code that there were no messages to read
 #define ERR_DISPATCHER_NO_WORK ZX_ERR_SHOULD_WAIT
@@ -118,6 +127,15 @@ zx_status_t zxrio_handle_close(zxrio_cb_t cb, void* cookie);
 // Transmits a response message |msg| back to the client on the peer end of |h|.
 zx_status_t zxrio_respond(zx_handle_t h, zxrio_msg_t* msg);
 
+// A process that also serves remoteio may install a local transaction
+// function.  Before sending a transaction over |h|, clients offer it to
+// this function, which either returns ZX_ERR_NEXT to decline (the
+// message is unchanged and goes over the channel as usual) or handles
+// it in-process and leaves the reply in |msg|, exactly as it would have
+// been read from the channel.  OPEN, CLONE and CLOSE are never offered.
+typedef zx_status_t (*zxrio_local_txn_t)(zx_handle_t h, zxrio_msg_t* msg);
+void zxrio_set_local_txn(zxrio_local_txn_t fn);
+
 // OPEN and CLOSE messages, can be forwarded to another remoteio server,
 // without any need to wait for a reply.  The reply channel from the initial
 // request is passed along to the new server.
@@ -189,6 +207,11 @@ typedef struct zxrio_mmap_data {
     int32_t flags;
 } zxrio_mmap_data_t;
 
+typedef struct zxrio_share_vmo {
+    uint64_t length;
+    uint64_t offset;
+} zxrio_share_vmo_t;
+
 static_assert(FDIO_CHUNK_SIZE >= PATH_MAX, "FDIO_CHUNK_SIZE must be large enough to contain paths");
 
 #define READDIR_CMD_NONE  0
@@ -227,6 +250,27 @@ static_assert(FDIO_CHUNK_SIZE >= PATH_MAX, "FDIO_CHUNK_SIZE must be large enough
 // LINK        0          0        <name1>0<name2>0  0           -               -
 // MMAP        maxreply   0        mmap_data_msg     0           mmap_data_msg   vmohandle
 // FCNTL       cmd        flags    0                 flags       -               -
+// IO_VMO      0          0        -                 0           -               -
+// READ_VMO    maxread    0        -                 newoffset   -               -
+// READ_AT_VMO maxread    offset   -                 0           -               -
+// WRITE_VMO   len        0        -                 newoffset   -               -
+// WRITE_AT_VMO len       offset   -                 0           -               -
+// SHARE_VMO   0          0        -                 0           share_vmo_msg   vmohandle, event
+// READDIR_PLUS maxreply  cmd      -                 0           <vdirent_plus_t[]> -
+//
+// IO_VMO hands the server a VMO (handle[0]) of at most FDIO_IO_VMO_SIZE bytes,
+// through which the *_VMO calls on that connection move their data: reads
+// leave the bytes read at the start of the VMO, and writes take the bytes to
+// write from the start of the VMO.
+//
+// SHARE_VMO returns a read-only handle to the VMO holding a file's contents,
+// which the client may read from directly instead of sending READs, the file's
+// length and the connection's seek offset, and an event which is signalled
+// with ZX_USER_SIGNAL_0 once that length is out of date.
+//
+// READDIR_PLUS is READDIR, sharing its position, except that each entry also
+// carries the attributes of the node it names, sparing the client a STAT of
+// each entry.
 //
 // proposed:
 //
@@ -37,11 +37,14 @@ zx_status_t fdio_transfer_fd(int fd, int newfd, zx_handle_t* handles, uint32_t*
 zx_status_t fdio_create_fd(zx_handle_t* handles, uint32_t* types, size_t hcount, int* fd_out);
 
 typedef struct bootfs_entry bootfs_entry_t;
+typedef struct bootfs_hash bootfs_hash_t;
 
 typedef struct bootfs {
     zx_handle_t vmo;
     uint32_t dirsize;
     void* dir;
+    // hash index of dir, or NULL if the image has none
+    const bootfs_hash_t* hash;
 } bootfs_t;
 
 zx_status_t bootfs_create(bootfs_t* bfs, zx_handle_t vmo);
@@ -80,4 +80,22 @@ typedef struct vdirent {
     char name[0];
 } vdirent_t;
 
+// A directory entry together with the attributes of the node it names, as
+// returned by READDIR_PLUS. |size| covers the whole record, which is padded
+// to keep |attr| 8-byte aligned. |attr.mode| is zero if the attributes could
+// not be read, in which case the client must stat the entry itself.
+typedef struct vdirent_plus {
+    uint32_t size;
+    uint32_t type;
+    vnattr_t attr;
+    char name[0];
+} vdirent_plus_t;
+
+// The most bytes of vdirent_t records which are certain to fit in |len| bytes
+// once converted to vdirent_plus_t records. No record is smaller than
+// sizeof(vdirent_t) + 4 bytes, and none grows by more than sizeof(vnattr_t)
+// plus 7 bytes of padding.
+#define VDIRENT_PLUS_SOURCE_LEN(len) \
+    ((len) * (sizeof(vdirent_t) + 4) / (sizeof(vdirent_t) + 4 + sizeof(vnattr_t) + 7))
+
 __END_CDECLS
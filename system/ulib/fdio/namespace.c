@@ -450,6 +450,10 @@ static zx_status_t mxdir_misc(fdio_t* io, uint32_t op, int64_t off,
         }
         mtx_unlock(&dir->ns->lock);
         return r;
+    case ZXRIO_READDIR_PLUS:
+        // The local children have no attributes to return, so leave it
+        // to the client to stat them.
+        return ZX_ERR_NOT_SUPPORTED;
     case ZXRIO_STAT:
         if (maxreply < sizeof(vnattr_t)) {
             return ZX_ERR_INVALID_ARGS;
@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <fdio/vfs.h>
+
 #include "private.h"
 
 typedef struct zxrio zxrio_t;
@@ -19,15 +21,61 @@ struct zxrio {
 
     // transaction id used for synchronous remoteio calls
     _Atomic zx_txid_t txid;
+
+    // VMO shared with the server for large reads and writes, created on
+    // first use, and whether the server turned it down. The VMO carries the
+    // data of one transfer at a time, which holds io_vmo_lock throughout.
+    mtx_t io_vmo_lock;
+    zx_handle_t io_vmo;
+    bool io_vmo_unsupported;
+
+    // Held by a thread which has requests in flight without waiting in
+    // zx_channel_call(), so that it alone reads the replies from the channel.
+    mtx_t pipeline_lock;
+
+    // Read-only view of the file's contents shared by the server (see
+    // ZXRIO_SHARE_VMO), from which reads are served without a round trip.
+    // file_token is signalled once file_len is out of date.
+    //
+    // While file_vmo is valid and file_offset_known, the client keeps the
+    // seek offset, and brings the server's copy up to date (if
+    // file_offset_dirty) before sending anything which uses it.
+    mtx_t file_lock;
+    zx_handle_t file_vmo;
+    zx_handle_t file_token;
+    uint64_t file_len;
+    uint64_t file_offset;
+    bool file_offset_known;
+    bool file_offset_dirty;
+    bool file_vmo_unsupported;
 };
 
+// The most entries zxrio_stat_entries() handles at once.
+#define ZXRIO_STAT_BATCH 16
+
 // These are for the benefit of namespace.c
 // which needs lower level access to remoteio internals
 
+// Opens each of the |count| (at most ZXRIO_STAT_BATCH) entries |names| of the
+// remote directory |io| and stats it, with all the requests in flight at once.
+// Each name must be a single path component other than "..". The attributes
+// of each entry are stored in |attrs| and its status in |statuses|.
+// Returns ZX_ERR_NOT_SUPPORTED if |io| isn't a remote directory.
+zx_status_t zxrio_stat_entries(fdio_t* io, const char* const* names, size_t count,
+                               vnattr_t* attrs, zx_status_t* statuses);
+
 // open operation directly on remoteio handle
 zx_status_t zxrio_open_handle(zx_handle_t h, const char* path, uint32_t flags,
                               uint32_t mode, fdio_t** out);
 
+// Opens each of the |count| (at most ZXRIO_STAT_BATCH) entries |names| of the
+// remote directory |io| and stats it, with all the requests in flight at once.
+// Each name must be a single path component other than "..". The attributes
+// of each entry are stored in |attrs| and its status in |statuses|.
+// Returns ZX_ERR_NOT_SUPPORTED if |io| isn't a remote directory.
+zx_status_t zxrio_stat_entries(fdio_t* io, const char* const* names, size_t count,
+                               vnattr_t* attrs, zx_status_t* statuses);
+
 // open operation directly on remoteio handle
 // returns new remoteio handle on success
 // fails and discards non-REMOTE protocols
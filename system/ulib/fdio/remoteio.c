@@ -30,6 +30,9 @@
 
 #define MXDEBUG 0
 
+// The most READ_AT requests a pipelined read keeps in flight.
+#define ZXRIO_PIPELINE_DEPTH 4
+
 // POLL_MASK and POLL_SHIFT intend to convert the lower five POLL events into
 // ZX_USER_SIGNALs and vice-versa. Other events need to be manually converted to
 // an zx_signal_t, if they are desired.
@@ -197,6 +200,12 @@ zx_status_t zxrio_txn_handoff(zx_handle_t srv, zx_handle_t reply, zxrio_msg_t* m
     return r;
 }
 
+static _Atomic(zxrio_local_txn_t) local_txn;
+
+void zxrio_set_local_txn(zxrio_local_txn_t fn) {
+    atomic_store(&local_txn, fn);
+}
+
 // on success, msg->hcount indicates number of valid handles in msg->handle
 // on error there are never any handles
 static zx_status_t zxrio_txn(zxrio_t* rio, zxrio_msg_t* msg) {
@@ -221,7 +230,15 @@ static zx_status_t zxrio_txn(zxrio_t* rio, zxrio_msg_t* msg) {
     args.rd_num_bytes = ZXRIO_HDR_SZ + FDIO_CHUNK_SIZE;
     args.rd_num_handles = FDIO_MAX_HANDLES;
 
-    r = zx_channel_call(rio->h, 0, ZX_TIME_INFINITE, &args, &dsize, &msg->hcount, &rs);
+    zxrio_local_txn_t local = atomic_load(&local_txn);
+    if ((local != NULL) && (ZXRIO_OP(msg->op) != ZXRIO_CLOSE) &&
+        (local(rio->h, msg) == ZX_OK)) {
+        // handled in-process; the reply is already in msg
+        dsize = ZXRIO_HDR_SZ + msg->datalen;
+        r = ZX_OK;
+    } else {
+        r = zx_channel_call(rio->h, 0, ZX_TIME_INFINITE, &args, &dsize, &msg->hcount, &rs);
+    }
     if (r < 0) {
         if (r == ZX_ERR_CALL_FAILED) {
             // read phase failed, true status is in rs
@@ -352,6 +369,102 @@ ssize_t zxrio_ioctl(fdio_t* io, uint32_t op, const void* in_buf,
     return r;
 }
 
+// Sets up the VMO shared with the server for large transfers, unless it
+// already exists. Returns ZX_ERR_NOT_SUPPORTED if the server can't use one.
+static zx_status_t zxrio_io_vmo_locked(zxrio_t* rio) {
+    if (rio->io_vmo != ZX_HANDLE_INVALID) {
+        return ZX_OK;
+    } else if (rio->io_vmo_unsupported) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    zx_handle_t vmo;
+    zx_status_t r;
+    if ((r = zx_vmo_create(FDIO_IO_VMO_SIZE, 0, &vmo)) != ZX_OK) {
+        return r;
+    }
+    zxrio_msg_t msg;
+    memset(&msg, 0, ZXRIO_HDR_SZ);
+    msg.op = ZXRIO_IO_VMO;
+    msg.hcount = 1;
+    if ((r = zx_handle_duplicate(vmo, ZX_RIGHT_READ | ZX_RIGHT_WRITE | ZX_RIGHT_TRANSFER,
+                                 &msg.handle[0])) != ZX_OK) {
+        zx_handle_close(vmo);
+        return r;
+    }
+    if ((r = zxrio_txn(rio, &msg)) < 0) {
+        // Servers which don't know the op (devices, older filesystems) fail
+        // it; don't ask them again.
+        zx_handle_close(vmo);
+        rio->io_vmo_unsupported = true;
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    discard_handles(msg.handle, msg.hcount);
+    rio->io_vmo = vmo;
+    return ZX_OK;
+}
+
+static void zxrio_io_vmo_release(zxrio_t* rio) {
+    mtx_lock(&rio->io_vmo_lock);
+    if (rio->io_vmo != ZX_HANDLE_INVALID) {
+        zx_handle_close(rio->io_vmo);
+        rio->io_vmo = ZX_HANDLE_INVALID;
+    }
+    mtx_unlock(&rio->io_vmo_lock);
+}
+
+// Transfers more than FDIO_CHUNK_SIZE bytes through the VMO shared with the
+// server, so that each round trip moves up to FDIO_IO_VMO_SIZE bytes and the
+// data is never copied through the channel. Returns ZX_ERR_NOT_SUPPORTED,
+// without transferring anything, if the server can't do this.
+static ssize_t write_vmo_common(uint32_t op, zxrio_t* rio, const uint8_t* data, size_t len,
+                                off_t offset) {
+    ssize_t count = 0;
+    zx_status_t r;
+    zxrio_msg_t msg;
+    size_t xfer;
+    size_t actual;
+
+    mtx_lock(&rio->io_vmo_lock);
+    if ((r = zxrio_io_vmo_locked(rio)) != ZX_OK) {
+        mtx_unlock(&rio->io_vmo_lock);
+        return r;
+    }
+    while (len > 0) {
+        xfer = (len > FDIO_IO_VMO_SIZE) ? FDIO_IO_VMO_SIZE : len;
+        if ((r = zx_vmo_write(rio->io_vmo, data, 0, xfer, &actual)) != ZX_OK) {
+            break;
+        }
+
+        memset(&msg, 0, ZXRIO_HDR_SZ);
+        msg.op = op;
+        msg.arg = xfer;
+        if (op == ZXRIO_WRITE_AT_VMO)
+            msg.arg2.off = offset;
+
+        if ((r = zxrio_txn(rio, &msg)) < 0) {
+            break;
+        }
+        discard_handles(msg.handle, msg.hcount);
+
+        if ((size_t)r > xfer) {
+            r = ZX_ERR_IO;
+            break;
+        }
+        count += r;
+        data += r;
+        len -= r;
+        if (op == ZXRIO_WRITE_AT_VMO)
+            offset += r;
+        // stop at short write
+        if ((size_t)r < xfer) {
+            break;
+        }
+    }
+    mtx_unlock(&rio->io_vmo_lock);
+    return count ? count : r;
+}
+
 static ssize_t write_common(uint32_t op, fdio_t* io, const void* _data, size_t len, off_t offset) {
     zxrio_t* rio = (zxrio_t*)io;
     const uint8_t* data = _data;
@@ -360,6 +473,14 @@ static ssize_t write_common(uint32_t op, fdio_t* io, const void* _data, size_t l
     zxrio_msg_t msg;
     ssize_t xfer;
 
+    if (len > FDIO_CHUNK_SIZE) {
+        uint32_t vmo_op = (op == ZXRIO_WRITE_AT) ? ZXRIO_WRITE_AT_VMO : ZXRIO_WRITE_VMO;
+        ssize_t n = write_vmo_common(vmo_op, rio, data, len, offset);
+        if (n != ZX_ERR_NOT_SUPPORTED) {
+            return n;
+        }
+    }
+
     while (len > 0) {
         xfer = (len > FDIO_CHUNK_SIZE) ? FDIO_CHUNK_SIZE : len;
 
@@ -392,14 +513,304 @@ static ssize_t write_common(uint32_t op, fdio_t* io, const void* _data, size_t l
     return count ? count : r;
 }
 
+// Brings the server's seek offset up to date with the client's, before
+// sending something which uses or moves it. Afterwards the client no longer
+// knows the offset.
+static zx_status_t zxrio_file_offset_sync_locked(zxrio_t* rio) {
+    if (rio->file_offset_dirty) {
+        zxrio_msg_t msg;
+        zx_status_t r;
+        memset(&msg, 0, ZXRIO_HDR_SZ);
+        msg.op = ZXRIO_SEEK;
+        msg.arg2.off = rio->file_offset;
+        msg.arg = SEEK_SET;
+        if ((r = zxrio_txn(rio, &msg)) < 0) {
+            return r;
+        }
+        discard_handles(msg.handle, msg.hcount);
+        rio->file_offset_dirty = false;
+    }
+    rio->file_offset_known = false;
+    return ZX_OK;
+}
+
+static void zxrio_file_vmo_drop_locked(zxrio_t* rio) {
+    if (rio->file_vmo != ZX_HANDLE_INVALID) {
+        zx_handle_close(rio->file_vmo);
+        zx_handle_close(rio->file_token);
+        rio->file_vmo = ZX_HANDLE_INVALID;
+        rio->file_token = ZX_HANDLE_INVALID;
+    }
+}
+
+// Sets up the shared view of the file, or refreshes it if its length is out
+// of date. Returns ZX_ERR_NOT_SUPPORTED if reads must go to the server.
+static zx_status_t zxrio_file_vmo_locked(zxrio_t* rio) {
+    if (rio->file_vmo != ZX_HANDLE_INVALID) {
+        zx_signals_t pending = 0;
+        zx_object_wait_one(rio->file_token, ZX_USER_SIGNAL_0, 0, &pending);
+        if (!(pending & ZX_USER_SIGNAL_0)) {
+            return ZX_OK;
+        }
+    } else if (rio->file_vmo_unsupported) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    zxrio_msg_t msg;
+    zx_status_t r;
+    memset(&msg, 0, ZXRIO_HDR_SZ);
+    msg.op = ZXRIO_SHARE_VMO;
+    if ((r = zxrio_txn(rio, &msg)) >= 0 &&
+        (msg.hcount != 2 || msg.datalen != sizeof(zxrio_share_vmo_t))) {
+        discard_handles(msg.handle, msg.hcount);
+        r = ZX_ERR_IO;
+    }
+    if (r < 0) {
+        // Servers which don't know the op (anything but memfs files, for
+        // now) fail it; don't ask them again.
+        zxrio_file_offset_sync_locked(rio);
+        zxrio_file_vmo_drop_locked(rio);
+        rio->file_vmo_unsupported = true;
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    zxrio_share_vmo_t info;
+    memcpy(&info, msg.data, sizeof(info));
+    zxrio_file_vmo_drop_locked(rio);
+    rio->file_vmo = msg.handle[0];
+    rio->file_token = msg.handle[1];
+    rio->file_len = info.length;
+    if (!rio->file_offset_known) {
+        rio->file_offset = info.offset;
+        rio->file_offset_known = true;
+        rio->file_offset_dirty = false;
+    }
+    return ZX_OK;
+}
+
+// Reads from the file's shared VMO, at |offset| if |at|, or else at the seek
+// offset. Returns ZX_ERR_NOT_SUPPORTED, having done nothing, if the read must
+// go to the server instead, with the server's seek offset up to date.
+static ssize_t read_local_locked(zxrio_t* rio, void* data, size_t len, off_t offset, bool at) {
+    if ((at && offset < 0) || zxrio_file_vmo_locked(rio) != ZX_OK) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    if (!at && !rio->file_offset_known) {
+        // Something went to the server since the offset was last known.
+        zxrio_msg_t msg;
+        zx_status_t r;
+        memset(&msg, 0, ZXRIO_HDR_SZ);
+        msg.op = ZXRIO_SEEK;
+        msg.arg = SEEK_CUR;
+        if ((r = zxrio_txn(rio, &msg)) < 0) {
+            return r;
+        }
+        discard_handles(msg.handle, msg.hcount);
+        rio->file_offset = msg.arg2.off;
+        rio->file_offset_known = true;
+    }
+
+    uint64_t off = at ? (uint64_t)offset : rio->file_offset;
+    size_t actual = 0;
+    if (off < rio->file_len) {
+        if (len > rio->file_len - off) {
+            len = rio->file_len - off;
+        }
+        if (zx_vmo_read(rio->file_vmo, data, off, len, &actual) != ZX_OK) {
+            // The file shrank since its length was last checked.
+            zxrio_file_offset_sync_locked(rio);
+            zxrio_file_vmo_drop_locked(rio);
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+    }
+    if (!at && actual > 0) {
+        rio->file_offset += actual;
+        rio->file_offset_dirty = true;
+    }
+    return actual;
+}
+
 static ssize_t zxrio_write(fdio_t* io, const void* _data, size_t len) {
-    return write_common(ZXRIO_WRITE, io, _data, len, 0);
+    zxrio_t* rio = (zxrio_t*)io;
+    mtx_lock(&rio->file_lock);
+    ssize_t r = zxrio_file_offset_sync_locked(rio);
+    if (r == ZX_OK) {
+        r = write_common(ZXRIO_WRITE, io, _data, len, 0);
+    }
+    mtx_unlock(&rio->file_lock);
+    return r;
 }
 
 static ssize_t zxrio_write_at(fdio_t* io, const void* _data, size_t len, off_t offset) {
     return write_common(ZXRIO_WRITE_AT, io, _data, len, offset);
 }
 
+// Reads the next reply from |h|, waiting for one if need be. Replies which
+// aren't valid are dropped.
+static zx_status_t zxrio_wait_read_msg(zx_handle_t h, zxrio_msg_t* msg) {
+    for (;;) {
+        zx_status_t r = zxrio_read_msg(h, msg);
+        if (r == ZX_ERR_SHOULD_WAIT) {
+            zx_object_wait_one(h, ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED,
+                               ZX_TIME_INFINITE, NULL);
+        } else if (r != ZX_ERR_INVALID_ARGS) {
+            return r;
+        }
+    }
+}
+
+typedef struct {
+    zx_txid_t txid;
+    size_t xfer;
+    zx_status_t r;
+    bool pending;
+} zxrio_pipeline_slot_t;
+
+// Reads |len| bytes at |offset| in FDIO_CHUNK_SIZE pieces, keeping up to
+// ZXRIO_PIPELINE_DEPTH READ_AT requests in flight rather than waiting for each
+// piece before asking for the next. Replies are matched to requests by txid.
+// Replies to other threads' zx_channel_call()s never show up here, as the
+// kernel hands those straight to their callers.
+static ssize_t read_at_pipelined(zxrio_t* rio, uint8_t* data, size_t len, off_t offset) {
+    zxrio_pipeline_slot_t slot[ZXRIO_PIPELINE_DEPTH];
+    ssize_t count = 0;
+    zx_status_t r = ZX_OK;
+    zxrio_msg_t msg;
+
+    mtx_lock(&rio->pipeline_lock);
+    while (len > 0) {
+        size_t issued = 0;
+        size_t window = 0;
+        while (issued < ZXRIO_PIPELINE_DEPTH && window < len) {
+            size_t xfer = (len - window > FDIO_CHUNK_SIZE) ? FDIO_CHUNK_SIZE : len - window;
+            memset(&msg, 0, ZXRIO_HDR_SZ);
+            msg.txid = atomic_fetch_add(&rio->txid, 1);
+            msg.op = ZXRIO_READ_AT;
+            msg.arg = xfer;
+            msg.arg2.off = offset + window;
+            if ((r = zx_channel_write(rio->h, 0, &msg, ZXRIO_HDR_SZ, NULL, 0)) != ZX_OK) {
+                break;
+            }
+            slot[issued].txid = msg.txid;
+            slot[issued].xfer = xfer;
+            slot[issued].r = ZX_ERR_INTERNAL;
+            slot[issued].pending = true;
+            issued++;
+            window += xfer;
+        }
+
+        // Every piece but the last is a whole chunk, so piece i goes at
+        // i * FDIO_CHUNK_SIZE.
+        size_t outstanding = issued;
+        while (outstanding > 0) {
+            zx_status_t rs = zxrio_wait_read_msg(rio->h, &msg);
+            if (rs != ZX_OK) {
+                for (size_t i = 0; i < issued; i++) {
+                    if (slot[i].pending) {
+                        slot[i].r = rs;
+                    }
+                }
+                break;
+            }
+            discard_handles(msg.handle, msg.hcount);
+            size_t i = 0;
+            while (i < issued && !(slot[i].pending && slot[i].txid == msg.txid)) {
+                i++;
+            }
+            if (i == issued) {
+                continue;
+            }
+            slot[i].pending = false;
+            outstanding--;
+            if (ZXRIO_OP(msg.op) != ZXRIO_STATUS) {
+                slot[i].r = ZX_ERR_IO;
+            } else if ((slot[i].r = msg.arg) >= 0) {
+                if (((uint32_t)msg.arg > msg.datalen) || ((size_t)msg.arg > slot[i].xfer)) {
+                    slot[i].r = ZX_ERR_IO;
+                } else {
+                    memcpy(data + i * FDIO_CHUNK_SIZE, msg.data, msg.arg);
+                }
+            }
+        }
+
+        // Take the pieces up to the first short or failed one.
+        bool more = (issued > 0) && (r == ZX_OK);
+        size_t got = 0;
+        for (size_t i = 0; i < issued; i++) {
+            if (slot[i].r < 0) {
+                r = slot[i].r;
+                more = false;
+                break;
+            }
+            got += slot[i].r;
+            if ((size_t)slot[i].r < slot[i].xfer) {
+                more = false;
+                break;
+            }
+        }
+        count += got;
+        data += got;
+        len -= got;
+        offset += got;
+        if (!more) {
+            break;
+        }
+    }
+    mtx_unlock(&rio->pipeline_lock);
+    return count ? count : r;
+}
+
+// The counterpart of write_vmo_common() for reads.
+static ssize_t read_vmo_common(uint32_t op, zxrio_t* rio, uint8_t* data, size_t len,
+                               off_t offset) {
+    ssize_t count = 0;
+    zx_status_t r;
+    zxrio_msg_t msg;
+    size_t xfer;
+    size_t actual;
+
+    mtx_lock(&rio->io_vmo_lock);
+    if ((r = zxrio_io_vmo_locked(rio)) != ZX_OK) {
+        mtx_unlock(&rio->io_vmo_lock);
+        return r;
+    }
+    while (len > 0) {
+        xfer = (len > FDIO_IO_VMO_SIZE) ? FDIO_IO_VMO_SIZE : len;
+
+        memset(&msg, 0, ZXRIO_HDR_SZ);
+        msg.op = op;
+        msg.arg = xfer;
+        if (op == ZXRIO_READ_AT_VMO)
+            msg.arg2.off = offset;
+
+        if ((r = zxrio_txn(rio, &msg)) < 0) {
+            break;
+        }
+        discard_handles(msg.handle, msg.hcount);
+
+        if ((size_t)r > xfer) {
+            r = ZX_ERR_IO;
+            break;
+        }
+        size_t got = r;
+        if ((r = zx_vmo_read(rio->io_vmo, data, 0, got, &actual)) != ZX_OK) {
+            break;
+        }
+        count += got;
+        data += got;
+        len -= got;
+        if (op == ZXRIO_READ_AT_VMO)
+            offset += got;
+
+        // stop at short read
+        if (got < xfer) {
+            break;
+        }
+    }
+    mtx_unlock(&rio->io_vmo_lock);
+    return count ? count : r;
+}
+
 static ssize_t read_common(uint32_t op, fdio_t* io, void* _data, size_t len, off_t offset) {
     zxrio_t* rio = (zxrio_t*)io;
     uint8_t* data = _data;
@@ -408,6 +819,19 @@ static ssize_t read_common(uint32_t op, fdio_t* io, void* _data, size_t len, off
     zxrio_msg_t msg;
     ssize_t xfer;
 
+    if (len > FDIO_CHUNK_SIZE) {
+        uint32_t vmo_op = (op == ZXRIO_READ_AT) ? ZXRIO_READ_AT_VMO : ZXRIO_READ_VMO;
+        ssize_t n = read_vmo_common(vmo_op, rio, data, len, offset);
+        if (n != ZX_ERR_NOT_SUPPORTED) {
+            return n;
+        }
+        // The pieces of a positional read don't depend on one another, so
+        // they may all be asked for at once.
+        if (op == ZXRIO_READ_AT) {
+            return read_at_pipelined(rio, data, len, offset);
+        }
+    }
+
     while (len > 0) {
         xfer = (len > FDIO_CHUNK_SIZE) ? FDIO_CHUNK_SIZE : len;
 
@@ -442,11 +866,63 @@ static ssize_t read_common(uint32_t op, fdio_t* io, void* _data, size_t len, off
 }
 
 static ssize_t zxrio_read(fdio_t* io, void* _data, size_t len) {
-    return read_common(ZXRIO_READ, io, _data, len, 0);
+    zxrio_t* rio = (zxrio_t*)io;
+    mtx_lock(&rio->file_lock);
+    ssize_t r = read_local_locked(rio, _data, len, 0, false);
+    if (r == ZX_ERR_NOT_SUPPORTED) {
+        if ((r = zxrio_file_offset_sync_locked(rio)) == ZX_OK) {
+            r = read_common(ZXRIO_READ, io, _data, len, 0);
+        }
+    }
+    mtx_unlock(&rio->file_lock);
+    return r;
 }
 
 static ssize_t zxrio_read_at(fdio_t* io, void* _data, size_t len, off_t offset) {
-    return read_common(ZXRIO_READ_AT, io, _data, len, offset);
+    zxrio_t* rio = (zxrio_t*)io;
+    mtx_lock(&rio->file_lock);
+    ssize_t r = read_local_locked(rio, _data, len, offset, true);
+    mtx_unlock(&rio->file_lock);
+    if (r == ZX_ERR_NOT_SUPPORTED) {
+        r = read_common(ZXRIO_READ_AT, io, _data, len, offset);
+    }
+    return r;
+}
+
+// Seeks without a round trip, following the same rules as the server, while
+// the client keeps the seek offset. Returns ZX_ERR_NOT_SUPPORTED otherwise.
+static off_t seek_local_locked(zxrio_t* rio, off_t offset, int whence) {
+    if (rio->file_vmo == ZX_HANDLE_INVALID || !rio->file_offset_known) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    uint64_t base;
+    switch (whence) {
+    case SEEK_SET:
+        base = 0;
+        break;
+    case SEEK_CUR:
+        base = rio->file_offset;
+        break;
+    case SEEK_END:
+        if (zxrio_file_vmo_locked(rio) != ZX_OK || !rio->file_offset_known) {
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+        base = rio->file_len;
+        break;
+    default:
+        return ZX_ERR_INVALID_ARGS;
+    }
+    uint64_t n = base + offset;
+    if ((offset < 0) ? (n > base) : (n < base)) {
+        return ZX_ERR_INVALID_ARGS;
+    } else if (n > INT64_MAX) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    if (n != rio->file_offset) {
+        rio->file_offset = n;
+        rio->file_offset_dirty = true;
+    }
+    return n;
 }
 
 static off_t zxrio_seek(fdio_t* io, off_t offset, int whence) {
@@ -454,6 +930,18 @@ static off_t zxrio_seek(fdio_t* io, off_t offset, int whence) {
     zxrio_msg_t msg;
     zx_status_t r;
 
+    mtx_lock(&rio->file_lock);
+    off_t n = seek_local_locked(rio, offset, whence);
+    if (n != ZX_ERR_NOT_SUPPORTED) {
+        mtx_unlock(&rio->file_lock);
+        return n;
+    }
+    if ((r = zxrio_file_offset_sync_locked(rio)) != ZX_OK) {
+        mtx_unlock(&rio->file_lock);
+        return r;
+    }
+    mtx_unlock(&rio->file_lock);
+
     memset(&msg, 0, ZXRIO_HDR_SZ);
     msg.op = ZXRIO_SEEK;
     msg.arg2.off = offset;
@@ -487,10 +975,124 @@ zx_status_t zxrio_close(fdio_t* io) {
         rio->h2 = 0;
         zx_handle_close(h);
     }
+    zxrio_io_vmo_release(rio);
+    mtx_lock(&rio->file_lock);
+    zxrio_file_vmo_drop_locked(rio);
+    mtx_unlock(&rio->file_lock);
 
     return r;
 }
 
+static fdio_ops_t zx_remote_ops;
+
+typedef struct {
+    zx_handle_t h;
+    zx_status_t status;
+} zxrio_stat_entry_t;
+
+// Reads the next message from |h| into |buf|, waiting for one if need be.
+static zx_status_t zxrio_stat_read(zx_handle_t h, void* buf, uint32_t size, zx_handle_t* handles,
+                                   uint32_t* actual, uint32_t* actual_handles) {
+    zx_object_wait_one(h, ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED,
+                       ZX_TIME_INFINITE, NULL);
+    return zx_channel_read(h, 0, buf, handles, size, FDIO_MAX_HANDLES, actual, actual_handles);
+}
+
+zx_status_t zxrio_stat_entries(fdio_t* io, const char* const* names, size_t count,
+                               vnattr_t* attrs, zx_status_t* statuses) {
+    if (io->ops != &zx_remote_ops) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    if (count > ZXRIO_STAT_BATCH) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    zxrio_t* rio = (zxrio_t*)io;
+    zxrio_stat_entry_t entry[ZXRIO_STAT_BATCH];
+    zxrio_msg_t msg;
+
+    // Send every open, each followed on its new channel by a stat. The
+    // server only reads the stat once the open is done, after describing
+    // the result of the open.
+    for (size_t i = 0; i < count; i++) {
+        entry[i].h = ZX_HANDLE_INVALID;
+        size_t len = strlen(names[i]);
+        if (len == 0 || len >= PATH_MAX) {
+            entry[i].status = ZX_ERR_BAD_PATH;
+            continue;
+        }
+        zx_handle_t server;
+        if ((entry[i].status = zx_channel_create(0, &entry[i].h, &server)) != ZX_OK) {
+            entry[i].h = ZX_HANDLE_INVALID;
+            continue;
+        }
+        memset(&msg, 0, ZXRIO_HDR_SZ);
+        msg.op = ZXRIO_OPEN;
+        msg.datalen = len;
+        msg.arg = ZX_FS_FLAG_VNODE_REF_ONLY | ZX_FS_FLAG_DESCRIBE;
+        memcpy(msg.data, names[i], len);
+        if ((entry[i].status = zx_channel_write(rio->h, 0, &msg, ZXRIO_HDR_SZ + len,
+                                                &server, 1)) != ZX_OK) {
+            zx_handle_close(server);
+            zx_handle_close(entry[i].h);
+            entry[i].h = ZX_HANDLE_INVALID;
+            continue;
+        }
+        memset(&msg, 0, ZXRIO_HDR_SZ);
+        msg.txid = 1;
+        msg.op = ZXRIO_STAT;
+        msg.arg = sizeof(vnattr_t);
+        if ((entry[i].status = zx_channel_write(entry[i].h, 0, &msg, ZXRIO_HDR_SZ,
+                                                NULL, 0)) != ZX_OK) {
+            zx_handle_close(entry[i].h);
+            entry[i].h = ZX_HANDLE_INVALID;
+        }
+    }
+
+    // Collect the descriptions and attributes.
+    for (size_t i = 0; i < count; i++) {
+        if (entry[i].h == ZX_HANDLE_INVALID) {
+            statuses[i] = entry[i].status;
+            continue;
+        }
+        zxrio_describe_t info;
+        zx_handle_t handles[FDIO_MAX_HANDLES];
+        uint32_t dsize;
+        uint32_t hcount;
+        zx_status_t r = zxrio_stat_read(entry[i].h, &info, sizeof(info), handles,
+                                        &dsize, &hcount);
+        if (r == ZX_OK) {
+            discard_handles(handles, hcount);
+            if (dsize != sizeof(zxrio_describe_t) || info.op != ZXRIO_ON_OPEN) {
+                r = ZX_ERR_IO;
+            } else {
+                r = info.status;
+            }
+        }
+        if (r == ZX_OK) {
+            r = zxrio_stat_read(entry[i].h, &msg, sizeof(msg), msg.handle, &dsize, &hcount);
+        }
+        if (r == ZX_OK) {
+            discard_handles(msg.handle, hcount);
+            if ((dsize < ZXRIO_HDR_SZ) || (ZXRIO_OP(msg.op) != ZXRIO_STATUS) ||
+                (msg.datalen != dsize - ZXRIO_HDR_SZ)) {
+                r = ZX_ERR_IO;
+            } else if ((r = msg.arg) >= 0) {
+                if (msg.datalen < sizeof(vnattr_t)) {
+                    r = ZX_ERR_IO;
+                } else {
+                    memcpy(&attrs[i], msg.data, sizeof(vnattr_t));
+                    r = ZX_OK;
+                }
+            }
+        }
+        // Closing the channel closes the connection; there's no need to wait
+        // for a reply to an explicit close.
+        zx_handle_close(entry[i].h);
+        statuses[i] = r;
+    }
+    return ZX_OK;
+}
+
 // Synchronously (non-pipelined) open an object
 static zx_status_t zxrio_sync_open_connection(zx_handle_t rio_h, zxrio_msg_t* msg,
                                               zxrio_describe_t* info, zx_handle_t* out) {
@@ -951,6 +1553,13 @@ static zx_status_t zxrio_unwrap(fdio_t* io, zx_handle_t* handles, uint32_t* type
     } else {
         r = 1;
     }
+    zxrio_io_vmo_release(rio);
+    // Whoever gets the connection next expects the server's offset to be
+    // right.
+    mtx_lock(&rio->file_lock);
+    zxrio_file_offset_sync_locked(rio);
+    zxrio_file_vmo_drop_locked(rio);
+    mtx_unlock(&rio->file_lock);
     free(io);
     return r;
 }
@@ -1014,5 +1623,8 @@ fdio_t* fdio_remote_create(zx_handle_t h, zx_handle_t e) {
     rio->h = h;
     rio->h2 = e;
     atomic_init(&rio->txid, 1);
+    mtx_init(&rio->io_vmo_lock, mtx_plain);
+    mtx_init(&rio->pipeline_lock, mtx_plain);
+    mtx_init(&rio->file_lock, mtx_plain);
     return &rio->io;
 }
@@ -20,9 +20,8 @@
 #include "private-remoteio.h"
 
 
-static ssize_t zxsio_read_stream(fdio_t* io, void* data, size_t len) {
+static ssize_t zxsio_read(fdio_t* io, void* data, size_t len, bool nonblock) {
     zxrio_t* rio = (zxrio_t*)io;
-    int nonblock = rio->io.flags & FDIO_FLAG_NONBLOCK;
 
     // TODO: let the generic read() to do this loop
     for (;;) {
@@ -82,9 +81,8 @@ static ssize_t zxsio_recvfrom(fdio_t* io, void* data, size_t len, int flags, str
     return r;
 }
 
-static ssize_t zxsio_write_stream(fdio_t* io, const void* data, size_t len) {
+static ssize_t zxsio_write(fdio_t* io, const void* data, size_t len, bool nonblock) {
     zxrio_t* rio = (zxrio_t*)io;
-    int nonblock = rio->io.flags & FDIO_FLAG_NONBLOCK;
 
     // TODO: let the generic write() to do this loop
     for (;;) {
@@ -113,6 +111,14 @@ static ssize_t zxsio_write_stream(fdio_t* io, const void* data, size_t len) {
     }
 }
 
+static ssize_t zxsio_read_stream(fdio_t* io, void* data, size_t len) {
+    return zxsio_read(io, data, len, io->flags & FDIO_FLAG_NONBLOCK);
+}
+
+static ssize_t zxsio_write_stream(fdio_t* io, const void* data, size_t len) {
+    return zxsio_write(io, data, len, io->flags & FDIO_FLAG_NONBLOCK);
+}
+
 static ssize_t zxsio_sendto(fdio_t* io, const void* data, size_t len, int flags, const struct sockaddr* addr, socklen_t addrlen) {
     struct iovec iov;
     iov.iov_base = (void*)data;
@@ -328,12 +334,14 @@ static ssize_t zxsio_posix_ioctl_stream(fdio_t* io, int req, va_list va) {
     }
 }
 
-static ssize_t zxsio_rx_dgram(fdio_t* io, void* buf, size_t buflen) {
-    return zxsio_read_stream(io, buf, buflen);
+static ssize_t zxsio_rx_dgram(fdio_t* io, void* buf, size_t buflen, int flags) {
+    return zxsio_read(io, buf, buflen,
+                      (io->flags & FDIO_FLAG_NONBLOCK) || (flags & MSG_DONTWAIT));
 }
 
-static ssize_t zxsio_tx_dgram(fdio_t* io, const void* buf, size_t buflen) {
-    zx_status_t r = zxsio_write_stream(io, buf, buflen);
+static ssize_t zxsio_tx_dgram(fdio_t* io, const void* buf, size_t buflen, int flags) {
+    zx_status_t r = zxsio_write(io, buf, buflen,
+                                (io->flags & FDIO_FLAG_NONBLOCK) || (flags & MSG_DONTWAIT));
     return (r < 0) ? r : ZX_OK;
 }
 
@@ -375,7 +383,7 @@ static ssize_t zxsio_write_dgram(fdio_t* io, const void* data, size_t len) {
 }
 
 static ssize_t zxsio_recvmsg_dgram(fdio_t* io, struct msghdr* msg, int flags) {
-    if (flags != 0) {
+    if (flags & ~MSG_DONTWAIT) {
         // TODO: support MSG_OOB
         return ZX_ERR_NOT_SUPPORTED;
     }
@@ -392,7 +400,7 @@ static ssize_t zxsio_recvmsg_dgram(fdio_t* io, struct msghdr* msg, int flags) {
 
     // TODO: avoid malloc
     fdio_socket_msg_t* m = malloc(mlen);
-    ssize_t n = zxsio_rx_dgram(io, m, mlen);
+    ssize_t n = zxsio_rx_dgram(io, m, mlen, flags);
     if (n < 0) {
         free(m);
         return n;
@@ -433,7 +441,7 @@ static ssize_t zxsio_recvmsg_dgram(fdio_t* io, struct msghdr* msg, int flags) {
 }
 
 static ssize_t zxsio_sendmsg_dgram(fdio_t* io, const struct msghdr* msg, int flags) {
-    if (flags != 0) {
+    if (flags & ~MSG_DONTWAIT) {
         // TODO: MSG_OOB
         return ZX_ERR_NOT_SUPPORTED;
     }
@@ -460,14 +468,14 @@ static ssize_t zxsio_sendmsg_dgram(fdio_t* io, const struct msghdr* msg, int fla
         memcpy(&m->addr, msg->msg_name, msg->msg_namelen);
     }
     m->addrlen = msg->msg_namelen;
-    m->flags = flags;
+    m->flags = flags & ~MSG_DONTWAIT;
     char* data = m->data;
     for (int i = 0; i < msg->msg_iovlen; i++) {
         struct iovec *iov = &msg->msg_iov[i];
         memcpy(data, iov->iov_base, iov->iov_len);
         data += iov->iov_len;
     }
-    ssize_t r = zxsio_tx_dgram(io, m, mlen);
+    ssize_t r = zxsio_tx_dgram(io, m, mlen, flags);
     free(m);
     return r == ZX_OK ? n : r;
 }
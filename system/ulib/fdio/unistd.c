@@ -39,6 +39,7 @@
 #include <fdio/socket.h>
 
 #include "private.h"
+#include "private-remoteio.h"
 #include "unistd.h"
 
 static_assert(FDIO_FLAG_CLOEXEC == FD_CLOEXEC, "Unexpected fdio flags value");
@@ -776,6 +777,20 @@ zx_status_t fdio_wait_fd(int fd, uint32_t events, uint32_t* _pending, zx_time_t
     return status;
 }
 
+static void vnattr_to_stat(const vnattr_t* attr, struct stat* s) {
+    memset(s, 0, sizeof(struct stat));
+    s->st_mode = attr->mode;
+    s->st_ino = attr->inode;
+    s->st_size = attr->size;
+    s->st_blksize = attr->blksize;
+    s->st_blocks = attr->blkcount;
+    s->st_nlink = attr->nlink;
+    s->st_ctim.tv_sec = attr->create_time / ZX_SEC(1);
+    s->st_ctim.tv_nsec = attr->create_time % ZX_SEC(1);
+    s->st_mtim.tv_sec = attr->modify_time / ZX_SEC(1);
+    s->st_mtim.tv_nsec = attr->modify_time % ZX_SEC(1);
+}
+
 int fdio_stat(fdio_t* io, struct stat* s) {
     vnattr_t attr;
     int r = io->ops->misc(io, ZXRIO_STAT, 0, sizeof(attr), &attr, 0);
@@ -785,17 +800,7 @@ int fdio_stat(fdio_t* io, struct stat* s) {
     if (r < (int)sizeof(attr)) {
         return ZX_ERR_IO;
     }
-    memset(s, 0, sizeof(struct stat));
-    s->st_mode = attr.mode;
-    s->st_ino = attr.inode;
-    s->st_size = attr.size;
-    s->st_blksize = attr.blksize;
-    s->st_blocks = attr.blkcount;
-    s->st_nlink = attr.nlink;
-    s->st_ctim.tv_sec = attr.create_time / ZX_SEC(1);
-    s->st_ctim.tv_nsec = attr.create_time % ZX_SEC(1);
-    s->st_mtim.tv_sec = attr.modify_time / ZX_SEC(1);
-    s->st_mtim.tv_nsec = attr.modify_time % ZX_SEC(1);
+    vnattr_to_stat(&attr, s);
     return 0;
 }
 
@@ -1265,6 +1270,18 @@ static int getdirents(int fd, void* ptr, size_t len, long cmd) {
     return r;
 }
 
+// Like getdirents(), but reads vdirent_plus_t records, and returns a
+// zx_status_t rather than setting errno.
+static zx_status_t getdirents_plus(int fd, void* ptr, size_t len, long cmd) {
+    fdio_t* io = fd_to_io(fd);
+    if (io == NULL) {
+        return ZX_ERR_BAD_HANDLE;
+    }
+    zx_status_t r = io->ops->misc(io, ZXRIO_READDIR_PLUS, cmd, len, ptr, 0);
+    fdio_release(io);
+    return r;
+}
+
 static int truncateat(int dirfd, const char* path, off_t len) {
     fdio_t* io;
     zx_status_t r;
@@ -1481,6 +1498,85 @@ int stat(const char* fn, struct stat* s) {
     return fstatat(AT_FDCWD, fn, s, 0);
 }
 
+static zx_status_t getattr_entry_at(int dirfd, const char* name, vnattr_t* attr) {
+    fdio_t* io;
+    zx_status_t r;
+    if ((r = __fdio_open_at(&io, dirfd, name, O_PATH, 0)) < 0) {
+        return r;
+    }
+    r = io->ops->misc(io, ZXRIO_STAT, 0, sizeof(*attr), attr, 0);
+    if (r >= 0) {
+        r = (r < (int)sizeof(*attr)) ? ZX_ERR_IO : ZX_OK;
+    }
+    fdio_close(io);
+    fdio_release(io);
+    return r;
+}
+
+// Names which a remote directory can open directly, without the path
+// cleaning which __fdio_open_at() does.
+static bool is_plain_entry_name(const char* name) {
+    return (name[0] != 0) && (strchr(name, '/') == NULL) && (strcmp(name, "..") != 0);
+}
+
+// Reads the attributes of up to ZXRIO_STAT_BATCH entries of |dirfd| at once,
+// storing each entry's status in |statuses|.
+static zx_status_t getattr_entries(int dirfd, const char* const* names, size_t count,
+                                   vnattr_t* attrs, zx_status_t* statuses) {
+    const char* path = ".";
+    fdio_t* iodir = fdio_iodir(&path, dirfd);
+    if (iodir == NULL) {
+        return ZX_ERR_BAD_HANDLE;
+    }
+
+    const char* batch[ZXRIO_STAT_BATCH];
+    size_t index[ZXRIO_STAT_BATCH];
+    vnattr_t batch_attrs[ZXRIO_STAT_BATCH];
+    zx_status_t batch_statuses[ZXRIO_STAT_BATCH];
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (is_plain_entry_name(names[i])) {
+            batch[n] = names[i];
+            index[n] = i;
+            n++;
+        } else {
+            statuses[i] = getattr_entry_at(dirfd, names[i], &attrs[i]);
+        }
+    }
+    if (n > 0 && zxrio_stat_entries(iodir, batch, n, batch_attrs, batch_statuses) == ZX_OK) {
+        for (size_t j = 0; j < n; j++) {
+            statuses[index[j]] = batch_statuses[j];
+            if (batch_statuses[j] == ZX_OK) {
+                attrs[index[j]] = batch_attrs[j];
+            }
+        }
+    } else {
+        for (size_t j = 0; j < n; j++) {
+            statuses[index[j]] = getattr_entry_at(dirfd, batch[j], &attrs[index[j]]);
+        }
+    }
+    fdio_release(iodir);
+    return ZX_OK;
+}
+
+zx_status_t fdio_stat_entries(int dirfd, const char* const* names, size_t count,
+                              struct stat* stats, zx_status_t* statuses) {
+    vnattr_t attrs[ZXRIO_STAT_BATCH];
+    for (size_t i = 0; i < count; i += ZXRIO_STAT_BATCH) {
+        size_t n = count - i < ZXRIO_STAT_BATCH ? count - i : ZXRIO_STAT_BATCH;
+        zx_status_t r = getattr_entries(dirfd, names + i, n, attrs, statuses + i);
+        if (r != ZX_OK) {
+            return r;
+        }
+        for (size_t j = 0; j < n; j++) {
+            if (statuses[i + j] == ZX_OK) {
+                vnattr_to_stat(&attrs[j], &stats[i + j]);
+            }
+        }
+    }
+    return ZX_OK;
+}
+
 int lstat(const char* path, struct stat* buf) {
     return stat(path, buf);
 }
@@ -1697,11 +1793,15 @@ int chdir(const char* path) {
     return 0;
 }
 
-#define DIR_BUFSIZE 2048
+#define DIR_BUFSIZE FDIO_CHUNK_SIZE
 
 struct __dirstream {
     mtx_t lock;
     int fd;
+    // Whether 'data' holds vdirent_plus_t records, rather than vdirent_t
+    bool plus;
+    // Whether the directory does not answer READDIR_PLUS
+    bool plus_unsupported;
     // Total size of 'data' which has been filled with dirents
     size_t size;
     // Offset into 'data' of next ptr. NULL to reset the
@@ -1754,40 +1854,156 @@ int closedir(DIR* dir) {
     return 0;
 }
 
-struct dirent* readdir(DIR* dir) {
-    mtx_lock(&dir->lock);
-    struct dirent* de = &dir->de;
-    for (;;) {
-        if (dir->size >= sizeof(vdirent_t)) {
-            vdirent_t* vde = (void*)dir->ptr;
-            if (dir->size >= vde->size) {
-                dir->ptr += vde->size;
-                dir->size -= vde->size;
-                if (vde->name[0]) {
-                    de->d_ino = 0;
-                    de->d_off = 0;
-                    de->d_reclen = 0;
-                    de->d_type = vde->type;
-                    strcpy(de->d_name, vde->name);
+// Takes the next named entry from the dirents cached in |dir|, copying it to
+// |dir->de|. Points |*out_attr| at its attributes if the cache holds them,
+// or sets it to NULL.
+static bool readdir_cached_locked(DIR* dir, const vnattr_t** out_attr) {
+    size_t hdrsize = dir->plus ? sizeof(vdirent_plus_t) : sizeof(vdirent_t);
+    while (dir->size >= hdrsize) {
+        vdirent_t* vde = (void*)dir->ptr;
+        if ((vde->size < hdrsize) || (dir->size < vde->size)) {
+            break;
+        }
+        dir->ptr += vde->size;
+        dir->size -= vde->size;
+        vdirent_plus_t* vdp = (void*)vde;
+        const char* name = dir->plus ? vdp->name : vde->name;
+        if (name[0] == 0) {
+            // skip nameless entries.
+            // (they may be generated by filtering filesystems)
+            continue;
+        }
+        struct dirent* de = &dir->de;
+        de->d_ino = 0;
+        de->d_off = 0;
+        de->d_reclen = 0;
+        de->d_type = vde->type;
+        strcpy(de->d_name, name);
+        *out_attr = dir->plus ? &vdp->attr : NULL;
+        return true;
+    }
+    dir->size = 0;
+    return false;
+}
+
+// Refills the cache of |dir| with vdirent_plus_t records. For directories
+// which do not answer READDIR_PLUS, the entries are read with READDIR, and
+// their attributes fetched a batch at a time.
+static int getdirents_plus_locked(DIR* dir, long cmd) {
+    if (!dir->plus_unsupported) {
+        zx_status_t r = getdirents_plus(dir->fd, dir->data, DIR_BUFSIZE, cmd);
+        if (r != ZX_ERR_NOT_SUPPORTED) {
+            dir->plus = true;
+            return STATUS(r);
+        }
+        dir->plus_unsupported = true;
+    }
+
+    // Entries with no name are dropped, so read on until some are left.
+    uint8_t buf[VDIRENT_PLUS_SOURCE_LEN(DIR_BUFSIZE)];
+    size_t filled = 0;
+    while (filled == 0) {
+        int r = getdirents(dir->fd, buf, sizeof(buf), cmd);
+        if (r <= 0) {
+            return r;
+        }
+        cmd = READDIR_CMD_NONE;
+        size_t len = r;
+        size_t pos = 0;
+        while (len - pos >= sizeof(vdirent_t)) {
+            const char* names[ZXRIO_STAT_BATCH];
+            uint32_t types[ZXRIO_STAT_BATCH];
+            vnattr_t attrs[ZXRIO_STAT_BATCH];
+            zx_status_t statuses[ZXRIO_STAT_BATCH];
+            size_t n = 0;
+            while ((n < ZXRIO_STAT_BATCH) && (len - pos >= sizeof(vdirent_t))) {
+                vdirent_t* vde = (void*)(buf + pos);
+                if ((vde->size < sizeof(vdirent_t)) || (vde->size > len - pos)) {
+                    pos = len;
                     break;
+                }
+                pos += vde->size;
+                if (vde->name[0] != 0) {
+                    names[n] = vde->name;
+                    types[n] = vde->type;
+                    n++;
+                }
+            }
+            if (n > 0 && getattr_entries(dir->fd, names, n, attrs, statuses) != ZX_OK) {
+                return ERRNO(EBADF);
+            }
+            for (size_t i = 0; i < n; i++) {
+                size_t namelen = strlen(names[i]);
+                size_t size = (sizeof(vdirent_plus_t) + namelen + 1 + 7) & ~7;
+                vdirent_plus_t* vdp = (void*)(dir->data + filled);
+                vdp->size = size;
+                vdp->type = types[i];
+                if (statuses[i] == ZX_OK) {
+                    vdp->attr = attrs[i];
                 } else {
-                    // skip nameless entries.
-                    // (they may be generated by filtering filesystems)
-                    continue;
+                    memset(&vdp->attr, 0, sizeof(vdp->attr));
                 }
+                memcpy(vdp->name, names[i], namelen + 1);
+                filled += size;
             }
-            dir->size = 0;
+        }
+    }
+    dir->plus = true;
+    return filled;
+}
+
+// Reads the next entry of |dir|, and if |st| is not NULL, the attributes of
+// the node it names.
+static struct dirent* readdir_locked(DIR* dir, struct stat* st) {
+    const vnattr_t* attr;
+    for (;;) {
+        if (readdir_cached_locked(dir, &attr)) {
+            break;
         }
         int64_t cmd = (dir->ptr == NULL) ? READDIR_CMD_RESET : READDIR_CMD_NONE;
-        int r = getdirents(dir->fd, dir->data, DIR_BUFSIZE, cmd);
+        int r;
+        if (st != NULL) {
+            r = getdirents_plus_locked(dir, cmd);
+        } else {
+            dir->plus = false;
+            r = getdirents(dir->fd, dir->data, DIR_BUFSIZE, cmd);
+        }
         if (r > 0) {
             dir->ptr = dir->data;
             dir->size = r;
             continue;
         }
-        de = NULL;
-        break;
+        return NULL;
     }
+    if (st != NULL) {
+        vnattr_t entry_attr;
+        if ((attr == NULL) || (attr->mode == 0)) {
+            // The attributes were not read with the entry; for instance, it
+            // may be a mount point, or have been cached by readdir().
+            attr = NULL;
+            if (getattr_entry_at(dir->fd, dir->de.d_name, &entry_attr) == ZX_OK) {
+                attr = &entry_attr;
+            }
+        }
+        if (attr != NULL) {
+            vnattr_to_stat(attr, st);
+        } else {
+            memset(st, 0, sizeof(*st));
+        }
+    }
+    return &dir->de;
+}
+
+struct dirent* readdir(DIR* dir) {
+    mtx_lock(&dir->lock);
+    struct dirent* de = readdir_locked(dir, NULL);
+    mtx_unlock(&dir->lock);
+    return de;
+}
+
+struct dirent* fdio_readdir_stat(DIR* dir, struct stat* st) {
+    mtx_lock(&dir->lock);
+    struct dirent* de = readdir_locked(dir, st);
     mtx_unlock(&dir->lock);
     return de;
 }
@@ -2137,6 +2353,65 @@ ssize_t recvmsg(int fd, struct msghdr* msg, int flags) {
     return r < 0 ? STATUS(r) : r;
 }
 
+// Each datagram is still its own zx_socket message, as that is what the
+// netstack expects, but a batch takes one fd lookup, and recvmmsg() can stop
+// blocking once it has something to return.
+int sendmmsg(int fd, struct mmsghdr* msgvec, unsigned int vlen, unsigned int flags) {
+    fdio_t* io = fd_to_io(fd);
+    if (io == NULL) {
+        return ERRNO(EBADF);
+    }
+    if (vlen > UIO_MAXIOV) {
+        vlen = UIO_MAXIOV;
+    }
+    ssize_t r = 0;
+    unsigned int i;
+    for (i = 0; i < vlen; i++) {
+        if ((r = io->ops->sendmsg(io, &msgvec[i].msg_hdr, flags)) < 0) {
+            break;
+        }
+        msgvec[i].msg_len = r;
+    }
+    fdio_release(io);
+    // As with Linux, an error after the first datagram is left for the next
+    // call to report.
+    return (i > 0 || r >= 0) ? (int)i : STATUS(r);
+}
+
+int recvmmsg(int fd, struct mmsghdr* msgvec, unsigned int vlen, unsigned int flags,
+             struct timespec* timeout) {
+    fdio_t* io = fd_to_io(fd);
+    if (io == NULL) {
+        return ERRNO(EBADF);
+    }
+    if (vlen > UIO_MAXIOV) {
+        vlen = UIO_MAXIOV;
+    }
+    zx_time_t deadline = ZX_TIME_INFINITE;
+    if (timeout != NULL) {
+        deadline = zx_deadline_after(ZX_SEC(timeout->tv_sec) + timeout->tv_nsec);
+    }
+    int msg_flags = flags & ~MSG_WAITFORONE;
+    ssize_t r = 0;
+    unsigned int i;
+    for (i = 0; i < vlen; i++) {
+        if ((r = io->ops->recvmsg(io, &msgvec[i].msg_hdr, msg_flags)) < 0) {
+            break;
+        }
+        msgvec[i].msg_len = r;
+        if (flags & MSG_WAITFORONE) {
+            msg_flags |= MSG_DONTWAIT;
+        }
+        // As with Linux, the timeout is only checked between datagrams.
+        if (zx_time_get(ZX_CLOCK_MONOTONIC) >= deadline) {
+            i++;
+            break;
+        }
+    }
+    fdio_release(io);
+    return (i > 0 || r >= 0) ? (int)i : STATUS(r);
+}
+
 int shutdown(int fd, int how) {
     fdio_t* io;
     if ((io = fd_to_io(fd)) == NULL) {
@@ -281,6 +281,17 @@ zx_status_t FidlDecoder::DecodeMessage() {
         return WithError("Message size is smaller than expected");
     }
 
+    // The coding tables only list the fields which need work: handles and
+    // out-of-line objects. A struct without any such fields is a fixed-size
+    // message whose decoded form is identical to its in-memory form, so all
+    // there is to check is its size.
+    if (type_->coded_struct.field_count == 0u) {
+        if (type_->coded_struct.size != num_bytes_) {
+            return WithError("message did not decode all provided bytes");
+        }
+        return ZX_OK;
+    }
+
     // Any type that calls into ClaimOutOfLineStorage will have a
     // string, vector, struct pointer, or union pointer in the primary
     // message struct. This will force the size of that struct to be a
@@ -26,6 +26,9 @@ namespace fidl {
 // the buffer appropriately.
 class Builder {
 public:
+    // Creates a buffer without any storage.
+    Builder();
+
     // Creates a buffer that stores objects in the given memory.
     //
     // The constructed |Builder| object does not take ownership of the given
@@ -36,6 +39,9 @@ public:
     Builder(const Builder& other) = delete;
     Builder& operator=(const Builder& other) = delete;
 
+    Builder(Builder&& other);
+    Builder& operator=(Builder&& other);
+
     // Allocates storage in the buffer of sufficient size to store an object of
     // type |T|. The object must have alignment constraints that are compatible
     // with FIDL messages.
@@ -77,6 +83,12 @@ public:
     // provided to this builder in its constructor.
     BytePart Finalize();
 
+    // Attaches this builder to the given storage.
+    //
+    // Any objects allocated in the builder's previous storage are abandoned,
+    // and new objects are allocated starting at the beginning of |buffer|.
+    void Reset(void* buffer, uint32_t capacity);
+
 protected:
     uint8_t* buffer() const { return buffer_; }
     uint32_t capacity() const { return capacity_; }
@@ -87,7 +99,7 @@ private:
 
     uint32_t capacity_;
     uint32_t at_;
-    uint8_t* const buffer_;
+    uint8_t* buffer_;
 };
 
 } // namespace fidl
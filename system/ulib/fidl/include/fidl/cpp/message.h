@@ -65,6 +65,20 @@ public:
         return BytePart(bytes_.TrimStart(sizeof(fidl_message_header_t)));
     }
 
+    // The message payload viewed as an object of type |T|.
+    //
+    // After the message has been decoded, the strings, vectors, and other
+    // out-of-line objects reachable from the payload are views into bytes()
+    // rather than copies, so they remain valid only as long as the storage for
+    // bytes() does.
+    //
+    // Valid only if bytes().actual() is at least
+    // sizeof(fidl_message_header_t) + sizeof(T).
+    template <typename T>
+    T* GetPayloadAs() const {
+        return reinterpret_cast<T*>(bytes_.data() + sizeof(fidl_message_header_t));
+    }
+
     // The storage for the bytes of the message.
     BytePart& bytes() { return bytes_; }
     const BytePart& bytes() const { return bytes_; }
@@ -0,0 +1,68 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <fidl/cpp/builder.h>
+#include <fidl/cpp/message.h>
+#include <zircon/types.h>
+
+namespace fidl {
+
+// Heap storage for the bytes and handles of one FIDL message at a time.
+//
+// A |MessageBuffer| allocates its storage once and is meant to be reused for
+// every message a client or server reads or writes. Messages are read and
+// decoded in place, so the strings and vectors of a decoded message are views
+// into this storage, and messages are built in place using |CreateBuilder|, so
+// their out-of-line objects are already in their encoded positions.
+//
+// Messages created from a |MessageBuffer| do not own their storage and must not
+// be used after the next message is created or after the |MessageBuffer| is
+// destroyed.
+class MessageBuffer {
+public:
+    // Creates a |MessageBuffer| that allocates buffers for message of the
+    // given capacities.
+    //
+    // If the allocation fails, the capacities of the buffer are zero.
+    explicit MessageBuffer(
+        uint32_t capacity = ZX_CHANNEL_MAX_MSG_BYTES,
+        uint32_t handle_capacity = ZX_CHANNEL_MAX_MSG_HANDLES);
+
+    // The memory that backs the message is freed by this destructor.
+    ~MessageBuffer();
+
+    MessageBuffer(const MessageBuffer& other) = delete;
+    MessageBuffer& operator=(const MessageBuffer& other) = delete;
+
+    // The memory in which bytes can be stored in this buffer.
+    uint8_t* bytes() const { return buffer_; }
+
+    // The total number of bytes that can be stored in this buffer.
+    uint32_t capacity() const { return capacity_; }
+
+    // The memory in which handles can be stored in this buffer.
+    zx_handle_t* handles() const;
+
+    // The total number of handles that can be stored in this buffer.
+    uint32_t handle_capacity() const { return handle_capacity_; }
+
+    // Creates a |Message| with no actual bytes or handles whose storage is
+    // this buffer, suitable for reading a message from a channel.
+    Message CreateEmptyMessage();
+
+    // Creates a |Builder| that allocates objects in this buffer, starting at
+    // its beginning.
+    Builder CreateBuilder();
+
+private:
+    uint8_t* const buffer_;
+    const uint32_t capacity_;
+    const uint32_t handle_capacity_;
+};
+
+} // namespace fidl
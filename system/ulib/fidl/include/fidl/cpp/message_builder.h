@@ -8,6 +8,7 @@
 
 #include <fidl/cpp/builder.h>
 #include <fidl/cpp/message.h>
+#include <fidl/cpp/message_buffer.h>
 #include <fidl/types.h>
 #include <zircon/types.h>
 
@@ -19,6 +20,11 @@ namespace fidl {
 // the message. If you wish to manage the memory yourself, you can use |Builder|
 // and |Message| directly.
 //
+// Objects are built directly in their encoded positions, so encoding the
+// message only fixes up pointers and handles in place. A |MessageBuilder| can
+// be reused for any number of messages by calling |Reset| after each one has
+// been sent, which avoids allocating new buffers for every message.
+//
 // Upon creation, the |MessageBuilder| creates a FIDL message header, which you
 // can modify using |header()|.
 class MessageBuilder : public Builder {
@@ -45,7 +51,7 @@ public:
     //
     // The message header is allocated by the |MessageBuilder| itself.
     fidl_message_header_t* header() const {
-        return reinterpret_cast<fidl_message_header_t*>(buffer());
+        return reinterpret_cast<fidl_message_header_t*>(buffer_.bytes());
     }
 
     // Encodes a message of the given |type|.
@@ -58,10 +64,15 @@ public:
     // error.
     zx_status_t Encode(Message* message_out, const char** error_msg_out);
 
+    // Discards the objects allocated so far and starts a new message in the
+    // same memory, beginning with a new |fidl_message_header_t| header.
+    //
+    // Any |Message| previously returned by |Encode| must no longer be in use.
+    void Reset();
+
 private:
-    // Builder::buffer() is owned by this object.
     const fidl_type_t* type_;
-    const uint32_t handles_capacity_;
+    MessageBuffer buffer_;
 };
 
 } // namespace fidl
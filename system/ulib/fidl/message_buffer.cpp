@@ -0,0 +1,48 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fidl/cpp/message_buffer.h>
+
+#include <stdlib.h>
+
+namespace fidl {
+namespace {
+
+// Returns |offset| rounded up to the alignment of a handle.
+uint64_t AddPadding(uint32_t offset) {
+    constexpr uint32_t kMask = alignof(zx_handle_t) - 1;
+    // Cast before addition to avoid overflow.
+    return static_cast<uint64_t>(offset) + static_cast<uint64_t>((0u - offset) & kMask);
+}
+
+size_t GetAllocSize(uint32_t capacity, uint32_t handle_capacity) {
+    return AddPadding(capacity) + sizeof(zx_handle_t) * handle_capacity;
+}
+
+} // namespace
+
+MessageBuffer::MessageBuffer(uint32_t capacity, uint32_t handle_capacity)
+    : buffer_(static_cast<uint8_t*>(malloc(GetAllocSize(capacity, handle_capacity)))),
+      capacity_(buffer_ ? capacity : 0u),
+      handle_capacity_(buffer_ ? handle_capacity : 0u) {
+}
+
+MessageBuffer::~MessageBuffer() {
+    free(buffer_);
+}
+
+zx_handle_t* MessageBuffer::handles() const {
+    return reinterpret_cast<zx_handle_t*>(buffer_ + AddPadding(capacity_));
+}
+
+Message MessageBuffer::CreateEmptyMessage() {
+    return Message(BytePart(bytes(), capacity()),
+                   HandlePart(handles(), handle_capacity()));
+}
+
+Builder MessageBuffer::CreateBuilder() {
+    return Builder(bytes(), capacity());
+}
+
+} // namespace fidl
@@ -61,6 +61,8 @@ typedef struct mount_options {
     // Create the mountpoint directory if it doesn't already exist.
     // Must be false if passed to "fmount".
     bool create_mountpoint;
+    // Compress data as it is written. Only supported by blobstore.
+    bool compress;
 } mount_options_t;
 
 static const mount_options_t default_mount_options = {
@@ -68,6 +70,7 @@ static const mount_options_t default_mount_options = {
     .verbose_mount = false,
     .wait_until_ready = true,
     .create_mountpoint = false,
+    .compress = false,
 };
 
 typedef struct mkfs_options {
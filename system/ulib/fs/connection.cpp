@@ -15,6 +15,8 @@
 #include <fdio/io.h>
 #include <fdio/remoteio.h>
 #include <fdio/vfs.h>
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
 #include <fs/trace.h>
 #include <fs/vnode.h>
 #include <zircon/assert.h>
@@ -24,6 +26,10 @@
 namespace fs {
 namespace {
 
+// The size of the pieces in which data is copied between the I/O VMO and the
+// vnode.
+constexpr size_t kIoBufferSize = 64 * 1024;
+
 void WriteDescribeError(zx::channel channel, zx_status_t status) {
     zxrio_describe_t msg;
     memset(&msg, 0, sizeof(msg));
@@ -131,8 +137,12 @@ Connection::Connection(Vfs* vfs, fbl::RefPtr<Vnode> vnode,
         }
 
         // Tell the VFS that the connection closed remotely.
-        // This might have the side-effect of destroying this object.
-        vfs_->OnConnectionClosedRemotely(this);
+        // This might have the side-effect of destroying this object, and
+        // releasing the last reference to the vnode, so this is done alone.
+        Vfs* vfs = vfs_;
+        bool exclusive = vfs->BeginDispatch(nullptr, 0);
+        vfs->OnConnectionClosedRemotely(this);
+        vfs->EndDispatch(exclusive);
         return ASYNC_WAIT_FINISHED;
     });
 }
@@ -171,7 +181,73 @@ zx_status_t Connection::CallHandler() {
 
 zx_status_t Connection::HandleMessageThunk(zxrio_msg_t* msg, void* cookie) {
     Connection* connection = static_cast<Connection*>(cookie);
-    return connection->HandleMessage(msg);
+    Vfs* vfs = connection->vfs_;
+    bool exclusive = vfs->BeginDispatch(connection->vnode_.get(), ZXRIO_OP(msg->op));
+    zx_status_t status = connection->HandleMessage(msg);
+    vfs->EndDispatch(exclusive);
+    return status;
+}
+
+zx_status_t Connection::ReadToIoVmo(size_t len, size_t off, size_t* out_actual) {
+    size_t total = 0;
+    while (total < len) {
+        size_t xfer = fbl::min(len - total, kIoBufferSize);
+        size_t actual;
+        zx_status_t status = vnode_->Read(io_buffer_.get(), xfer, off + total, &actual);
+        if (status != ZX_OK) {
+            if (total > 0) {
+                break;
+            }
+            return status;
+        }
+        ZX_DEBUG_ASSERT(actual <= xfer);
+        size_t written;
+        if ((status = io_vmo_.write(io_buffer_.get(), total, actual, &written)) != ZX_OK) {
+            return status;
+        }
+        total += actual;
+        // Stop at short read.
+        if (actual < xfer) {
+            break;
+        }
+    }
+    *out_actual = total;
+    return ZX_OK;
+}
+
+zx_status_t Connection::WriteFromIoVmo(size_t len, size_t off, bool append, size_t* out_end,
+                                       size_t* out_actual) {
+    size_t total = 0;
+    size_t end = off;
+    while (total < len) {
+        size_t xfer = fbl::min(len - total, kIoBufferSize);
+        size_t actual;
+        zx_status_t status = io_vmo_.read(io_buffer_.get(), total, xfer, &actual);
+        if (status != ZX_OK) {
+            return status;
+        }
+        if (append) {
+            status = vnode_->Append(io_buffer_.get(), xfer, &end, &actual);
+        } else {
+            status = vnode_->Write(io_buffer_.get(), xfer, off + total, &actual);
+            end = off + total + actual;
+        }
+        if (status != ZX_OK) {
+            if (total > 0) {
+                break;
+            }
+            return status;
+        }
+        ZX_DEBUG_ASSERT(actual <= xfer);
+        total += actual;
+        // Stop at short write.
+        if (actual < xfer) {
+            break;
+        }
+    }
+    *out_end = end;
+    *out_actual = total;
+    return ZX_OK;
 }
 
 zx_status_t Connection::HandleMessage(zxrio_msg_t* msg) {
@@ -304,6 +380,94 @@ zx_status_t Connection::HandleMessage(zxrio_msg_t* msg) {
         }
         return status;
     }
+    case ZXRIO_IO_VMO: {
+        TRACE_DURATION("vfs", "ZXRIO_IO_VMO");
+        zx::vmo vmo(msg->handle[0]);
+        if (IsPathOnly(flags_)) {
+            return ZX_ERR_BAD_HANDLE;
+        }
+        uint64_t size;
+        zx_status_t status = vmo.get_size(&size);
+        if (status != ZX_OK) {
+            return status;
+        } else if (size == 0 || size > FDIO_IO_VMO_SIZE) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        if (!io_buffer_) {
+            fbl::AllocChecker ac;
+            io_buffer_.reset(new (&ac) uint8_t[kIoBufferSize]);
+            if (!ac.check()) {
+                return ZX_ERR_NO_MEMORY;
+            }
+        }
+        io_vmo_ = fbl::move(vmo);
+        io_vmo_size_ = size;
+        return ZX_OK;
+    }
+    case ZXRIO_READ_VMO:
+    case ZXRIO_READ_AT_VMO: {
+        TRACE_DURATION("vfs", "ZXRIO_READ_VMO", "len", arg);
+        if (!IsReadable(flags_)) {
+            return ZX_ERR_BAD_HANDLE;
+        } else if (!io_vmo_) {
+            return ZX_ERR_BAD_STATE;
+        } else if (arg < 0 || static_cast<size_t>(arg) > io_vmo_size_) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        bool at = ZXRIO_OP(msg->op) == ZXRIO_READ_AT_VMO;
+        size_t actual;
+        zx_status_t status = ReadToIoVmo(arg, at ? msg->arg2.off : offset_, &actual);
+        if (status != ZX_OK) {
+            return status;
+        }
+        if (!at) {
+            offset_ += actual;
+            msg->arg2.off = offset_;
+        }
+        return static_cast<zx_status_t>(actual);
+    }
+    case ZXRIO_WRITE_VMO:
+    case ZXRIO_WRITE_AT_VMO: {
+        TRACE_DURATION("vfs", "ZXRIO_WRITE_VMO", "len", arg);
+        if (!IsWritable(flags_)) {
+            return ZX_ERR_BAD_HANDLE;
+        } else if (!io_vmo_) {
+            return ZX_ERR_BAD_STATE;
+        } else if (arg < 0 || static_cast<size_t>(arg) > io_vmo_size_) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        bool at = ZXRIO_OP(msg->op) == ZXRIO_WRITE_AT_VMO;
+        bool append = !at && (flags_ & ZX_FS_FLAG_APPEND);
+        size_t end;
+        size_t actual;
+        zx_status_t status = WriteFromIoVmo(arg, at ? msg->arg2.off : offset_, append, &end,
+                                            &actual);
+        if (status != ZX_OK) {
+            return status;
+        }
+        if (!at) {
+            offset_ = end;
+            msg->arg2.off = offset_;
+        }
+        return static_cast<zx_status_t>(actual);
+    }
+    case ZXRIO_SHARE_VMO: {
+        TRACE_DURATION("vfs", "ZXRIO_SHARE_VMO");
+        if (!IsReadable(flags_)) {
+            return ZX_ERR_BAD_HANDLE;
+        }
+        zxrio_share_vmo_t* info = reinterpret_cast<zxrio_share_vmo_t*>(msg->data);
+        size_t length;
+        zx_status_t status = vnode_->ShareVmo(&msg->handle[0], &msg->handle[1], &length);
+        if (status != ZX_OK) {
+            return status;
+        }
+        info->length = length;
+        info->offset = offset_;
+        msg->datalen = sizeof(zxrio_share_vmo_t);
+        msg->hcount = 2;
+        return ZX_OK;
+    }
     case ZXRIO_SEEK: {
         TRACE_DURATION("vfs", "ZXRIO_SEEK");
         if (IsPathOnly(flags_)) {
@@ -414,6 +578,24 @@ zx_status_t Connection::HandleMessage(zxrio_msg_t* msg) {
         }
         return r < 0 ? r : msg->datalen;
     }
+    case ZXRIO_READDIR_PLUS: {
+        TRACE_DURATION("vfs", "ZXRIO_READDIR_PLUS");
+        if (IsPathOnly(flags_)) {
+            return ZX_ERR_BAD_HANDLE;
+        }
+        if (arg > FDIO_CHUNK_SIZE) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        if (msg->arg2.off == READDIR_CMD_RESET) {
+            dircookie_.Reset();
+        }
+        size_t actual;
+        zx_status_t r = vfs_->ReaddirPlus(vnode_.get(), &dircookie_, msg->data, arg, &actual);
+        if (r == ZX_OK) {
+            msg->datalen = static_cast<uint32_t>(actual);
+        }
+        return r < 0 ? r : msg->datalen;
+    }
     case ZXRIO_IOCTL_1H: {
         if (IsPathOnly(flags_)) {
             zx_handle_close(msg->handle[0]);
@@ -38,7 +38,7 @@ template <bool Write, size_t BlockSize, typename TxnHandler>
 class BlockTxn <vmoid_t, Write, BlockSize, TxnHandler> {
 public:
     DISALLOW_COPY_AND_ASSIGN_ALLOW_MOVE(BlockTxn);
-    explicit BlockTxn(TxnHandler* handler) : handler_(handler), count_(0) {}
+    explicit BlockTxn(TxnHandler* handler) : handler_(handler), count_(0), trim_count_(0) {}
     ~BlockTxn() {
         Flush();
     }
@@ -82,6 +82,30 @@ public:
         }
     }
 
+    // Identify that blocks no longer hold data, so the device may discard
+    // them. They are trimmed by Flush(), after the writes, so a trim may
+    // follow the metadata update which freed its blocks. The handler must
+    // only enqueue trims if the device accepts BLOCKIO_TRIM.
+    void EnqueueTrim(uint64_t absolute_block, uint64_t nblocks) {
+        for (size_t i = 0; i < trim_count_; i++) {
+            if (trims_[i].dev_offset + trims_[i].length == absolute_block) {
+                trims_[i].length += nblocks;
+                return;
+            }
+        }
+
+        trims_[trim_count_].txnid = handler_->TxnId();
+        trims_[trim_count_].vmoid = VMOID_INVALID;
+        trims_[trim_count_].vmo_offset = 0;
+        trims_[trim_count_].dev_offset = absolute_block;
+        trims_[trim_count_].length = nblocks;
+        trim_count_++;
+
+        if (trim_count_ == MAX_TXN_MESSAGES) {
+            Flush();
+        }
+    }
+
     // Activate the transaction
     zx_status_t Flush();
 
@@ -89,6 +113,8 @@ private:
     TxnHandler* handler_;
     size_t count_;
     block_fifo_request_t requests_[MAX_TXN_MESSAGES];
+    size_t trim_count_;
+    block_fifo_request_t trims_[MAX_TXN_MESSAGES];
 };
 
 template <bool Write, size_t BlockSize, typename TxnHandler>
@@ -104,6 +130,18 @@ inline zx_status_t BlockTxn<vmoid_t, Write, BlockSize, TxnHandler>::Flush() {
         status = handler_->Txn(requests_, count_);
     }
     count_ = 0;
+
+    if (trim_count_ != 0) {
+        for (size_t i = 0; i < trim_count_; i++) {
+            trims_[i].opcode = BLOCKIO_TRIM;
+            trims_[i].dev_offset *= BlockSize;
+            trims_[i].length *= BlockSize;
+        }
+        // Trims only give the device a hint, so their failure isn't the
+        // caller's.
+        handler_->Txn(trims_, trim_count_);
+        trim_count_ = 0;
+    }
     return status;
 }
 
@@ -136,6 +174,9 @@ public:
         }
     }
 
+    // Files on the host aren't trimmed.
+    void EnqueueTrim(uint64_t absolute_block, uint64_t nblocks) {}
+
     // Activate the transaction (do nothing)
     zx_status_t Flush() { return ZX_OK; }
 
@@ -17,6 +17,7 @@
 #include <fs/vfs.h>
 #include <fs/vnode.h>
 #include <zx/event.h>
+#include <zx/vmo.h>
 
 namespace fs {
 
@@ -62,6 +63,12 @@ private:
 
     bool is_waiting() const { return wait_.object() != ZX_HANDLE_INVALID; }
 
+    // Move data between the vnode and the start of |io_vmo_|, for the
+    // READ_VMO and WRITE_VMO families of messages.
+    zx_status_t ReadToIoVmo(size_t len, size_t off, size_t* out_actual);
+    zx_status_t WriteFromIoVmo(size_t len, size_t off, bool append, size_t* out_end,
+                               size_t* out_actual);
+
     fs::Vfs* const vfs_;
     fbl::RefPtr<fs::Vnode> const vnode_;
 
@@ -85,6 +92,14 @@ private:
 
     // Current seek offset.
     size_t offset_{};
+
+    // VMO provided by the client for large transfers, its size, and the
+    // buffer through which data is copied between it and the vnode. The VMO
+    // is accessed with zx_vmo_read() and zx_vmo_write() rather than mapped,
+    // as the client could shrink it under a mapping.
+    zx::vmo io_vmo_{};
+    size_t io_vmo_size_{};
+    fbl::unique_ptr<uint8_t[]> io_buffer_{};
 };
 
 } // namespace fs
@@ -24,6 +24,7 @@
 #include <zx/event.h>
 #include <zx/vmo.h>
 #include <fbl/mutex.h>
+#include <threads.h>
 #endif // __Fuchsia__
 
 #include <fbl/intrusive_double_list.h>
@@ -139,12 +140,31 @@ public:
     // modification operations for the duration of the operation.
     zx_status_t Readdir(Vnode* vn, vdircookie_t* cookie,
                         void* dirents, size_t len, size_t* out_actual) __TA_EXCLUDES(vfs_lock_);
+    // Like |Readdir()|, but fills |dirents| with vdirent_plus_t records,
+    // carrying the attributes of each entry. |len| is at most
+    // FDIO_CHUNK_SIZE.
+    zx_status_t ReaddirPlus(Vnode* vn, vdircookie_t* cookie,
+                            void* dirents, size_t len, size_t* out_actual) __TA_EXCLUDES(vfs_lock_);
 
     Vfs(async_t* async);
 
     async_t* async() { return async_; }
     void set_async(async_t* async) { async_ = async; }
 
+    // Sets whether connections may be dispatched from more than one thread of
+    // |async()| at a time. If so, each message is handled alone, unless its
+    // vnode allows otherwise with |Vnode::CanDispatchConcurrently()|.
+    //
+    // Must be set before any connection is served.
+    void SetConcurrent(bool value) { concurrent_ = value; }
+
+    // Called by |Connection| before handling a message with opcode |op| on
+    // |vn|, or before tearing down a connection with a null |vn|. Blocks
+    // until the message may be handled, and returns whether it is being
+    // handled alone, which must be passed to |EndDispatch()| afterwards.
+    bool BeginDispatch(Vnode* vn, uint32_t op) __TA_EXCLUDES(dispatch_lock_);
+    void EndDispatch(bool exclusive) __TA_EXCLUDES(dispatch_lock_);
+
     // Begins serving VFS messages over the specified connection.
     zx_status_t ServeConnection(fbl::unique_ptr<Connection> connection) __TA_EXCLUDES(vfs_lock_);
 
@@ -226,6 +246,14 @@ private:
 
     async_t* async_{};
 
+    // State of the messages being dispatched, when |concurrent_|.
+    bool concurrent_{};
+    mtx_t dispatch_lock_{};
+    cnd_t dispatch_cvar_{};
+    uint32_t dispatch_shared_ __TA_GUARDED(dispatch_lock_){};
+    uint32_t dispatch_waiting_ __TA_GUARDED(dispatch_lock_){};
+    bool dispatch_exclusive_ __TA_GUARDED(dispatch_lock_){};
+
 protected:
     // A lock which should be used to protect lookup and walk operations
     mtx_t vfs_lock_{};
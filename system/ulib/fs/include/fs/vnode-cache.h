@@ -0,0 +1,106 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+
+#include <async/dispatcher.h>
+#include <async/wait.h>
+#include <fbl/intrusive_double_list.h>
+#include <fbl/macros.h>
+#include <fbl/mutex.h>
+#include <fbl/ref_ptr.h>
+#include <fs/vnode.h>
+#include <zircon/thread_annotations.h>
+#include <zircon/types.h>
+#include <zx/event.h>
+
+namespace fs {
+
+// Keeps recently closed vnodes alive, so that opening them again doesn't
+// have to load them again.
+//
+// Filesystems keep looking vnodes up in their own maps, which only hold raw
+// pointers and forget a vnode once its last reference goes away. The cache
+// holds a reference to the most recently retained vnodes, bounded both by
+// their number and by the memory the filesystem says each one uses, and
+// drops the least recently retained ones first.
+//
+// This class is thread-safe.
+class VnodeCache {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(VnodeCache);
+
+    VnodeCache(size_t max_vnodes, size_t max_bytes);
+    ~VnodeCache();
+
+    // Keeps |vn| as the most recently used vnode, accounting |bytes| to it,
+    // and drops the least recently used vnodes which no longer fit.
+    //
+    // Called as a vnode is closed. Retaining a vnode which is already
+    // cached moves it to the front.
+    void Retain(fbl::RefPtr<Vnode> vn, size_t bytes);
+
+    // Drops the cache's reference to |vn|, if it has one, for example as the
+    // vnode is unlinked. The caller must hold a reference to |vn|.
+    void Evict(Vnode* vn);
+
+    // Drops every cached vnode. Filesystems call this before tearing
+    // themselves down, since the vnodes refer back to them.
+    void Clear();
+
+    // Shrinks the cache to a quarter of its limits while |warning| is
+    // signaled and empties it while |critical| is: the events which
+    // zx_system_get_event() returns for those memory pressure levels.
+    zx_status_t WatchMemoryPressure(async_t* async, zx::event warning, zx::event critical);
+
+private:
+    enum class Pressure {
+        kNormal,
+        kWarning,
+        kCritical,
+    };
+
+    struct CacheTraits {
+        static fbl::DoublyLinkedListNodeState<fbl::RefPtr<Vnode>>& node_state(Vnode& vn) {
+            return vn.cache_node_;
+        }
+    };
+    using VnodeList = fbl::DoublyLinkedList<fbl::RefPtr<Vnode>, CacheTraits>;
+
+    fbl::RefPtr<Vnode> RemoveLocked(Vnode* vn) __TA_REQUIRES(lock_);
+
+    // Rechecks the memory pressure level after the waits for it have fired,
+    // and waits again for the levels which aren't current.
+    void UpdatePressureLocked() __TA_REQUIRES(lock_);
+
+    // Drops vnodes, least recently used first, until the cache fits within
+    // the limits for the current memory pressure level.
+    void Trim() __TA_EXCLUDES(lock_);
+
+    async_wait_result_t OnWarning(async_t* async, zx_status_t status,
+                                  const zx_packet_signal_t* signal);
+    async_wait_result_t OnCritical(async_t* async, zx_status_t status,
+                                   const zx_packet_signal_t* signal);
+
+    const size_t max_vnodes_;
+    const size_t max_bytes_;
+
+    fbl::Mutex lock_;
+    VnodeList lru_ __TA_GUARDED(lock_);
+    size_t count_ __TA_GUARDED(lock_) = 0;
+    size_t bytes_ __TA_GUARDED(lock_) = 0;
+
+    async_t* async_ = nullptr;
+    zx::event warning_;
+    zx::event critical_;
+    async::WaitMethod<VnodeCache, &VnodeCache::OnWarning> warning_wait_{this};
+    async::WaitMethod<VnodeCache, &VnodeCache::OnCritical> critical_wait_{this};
+    Pressure pressure_ __TA_GUARDED(lock_) = Pressure::kNormal;
+    bool warning_pending_ __TA_GUARDED(lock_) = false;
+    bool critical_pending_ __TA_GUARDED(lock_) = false;
+};
+
+} // namespace fs
@@ -27,6 +27,8 @@
 
 namespace fs {
 
+class VnodeCache;
+
 inline bool vfs_valid_name(fbl::StringPiece name) {
     return name.length() <= NAME_MAX &&
            memchr(name.data(), '/', name.length()) == nullptr &&
@@ -99,6 +101,16 @@ public:
                                    zxrio_object_info_t* extra);
 
     virtual zx_status_t WatchDir(Vfs* vfs, const vfs_watch_dir_t* cmd);
+
+    // Returns true if RIO messages with opcode |op| on this vnode may be handled
+    // at the same time as other such messages, on this and other vnodes, when
+    // the VFS dispatches from more than one thread (see |Vfs::SetConcurrent()|).
+    // All other messages are handled alone. This is only called while nothing
+    // is being handled alone, so the answer may depend on the vnode's state.
+    //
+    // Vnodes which return true must serialize whatever those messages share
+    // among themselves, such as state which is initialized on first use.
+    virtual bool CanDispatchConcurrently(uint32_t op);
 #endif
 
     // Closes vn. Will be called once for each successful Open().
@@ -145,6 +157,15 @@ public:
     // 2) The mapping by writing to the underlying file.
     virtual zx_status_t Mmap(int flags, size_t len, size_t* off, zx_handle_t* out);
 
+    // Shares the VMO holding the file's contents, so that the client may read
+    // from it directly. The VMO must always be coherent with |Read()|.
+    //
+    // Returns a read-only handle to the VMO, the file's current length, and
+    // an event on which the vnode raises ZX_USER_SIGNAL_0 the next time the
+    // length changes, after which the client must ask again.
+    virtual zx_status_t ShareVmo(zx_handle_t* out_vmo, zx_handle_t* out_token,
+                                 size_t* out_length);
+
     // Syncs the vnode with its underlying storage
     virtual zx_status_t Sync();
 
@@ -209,6 +230,15 @@ public:
 protected:
     DISALLOW_COPY_ASSIGN_AND_MOVE(Vnode);
     Vnode();
+
+#ifdef __Fuchsia__
+private:
+    friend class VnodeCache;
+
+    // Links the vnode into the VnodeCache keeping it alive, if any.
+    fbl::DoublyLinkedListNodeState<fbl::RefPtr<Vnode>> cache_node_;
+    size_t cache_bytes_ = 0;
+#endif
 };
 
 // Opens a vnode by reference.
@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <fbl/algorithm.h>
 #include <fbl/auto_call.h>
 #include <fdio/remoteio.h>
 #include <fdio/watcher.h>
@@ -354,6 +355,77 @@ zx_status_t Vfs::Readdir(Vnode* vn, vdircookie_t* cookie,
     return vn->Readdir(cookie, dirents, len, out_actual);
 }
 
+namespace {
+
+// Reads the attributes of the entry |name| of the directory |vn|, leaving
+// them zeroed if they cannot be read here. Remote entries are left zeroed
+// too, as their attributes belong to the filesystem mounted on them.
+void GetattrEntry(Vnode* vn, fbl::StringPiece name, vnattr_t* attr) {
+    memset(attr, 0, sizeof(*attr));
+    zx_status_t status;
+    if (name == ".") {
+        status = vn->Getattr(attr);
+    } else {
+        fbl::RefPtr<Vnode> child;
+        if ((status = vn->Lookup(&child, name)) == ZX_OK) {
+            status = child->IsRemote() ? ZX_ERR_UNAVAILABLE : child->Getattr(attr);
+        }
+    }
+    if (status != ZX_OK) {
+        memset(attr, 0, sizeof(*attr));
+    }
+}
+
+} // namespace
+
+zx_status_t Vfs::ReaddirPlus(Vnode* vn, vdircookie_t* cookie,
+                             void* dirents, size_t len, size_t* out_actual) {
+    ZX_DEBUG_ASSERT(len <= FDIO_CHUNK_SIZE);
+    fbl::AutoLock lock(&vfs_lock_);
+    char buf[VDIRENT_PLUS_SOURCE_LEN(FDIO_CHUNK_SIZE)];
+    char* out = static_cast<char*>(dirents);
+    size_t filled = 0;
+
+    // Each pass reads no more entries than are certain to fit in what is
+    // left of the reply once their attributes are added, so the directory's
+    // position never moves past an entry which is not returned.
+    while (true) {
+        size_t actual;
+        zx_status_t status = vn->Readdir(cookie, buf, VDIRENT_PLUS_SOURCE_LEN(len - filled),
+                                         &actual);
+        if (status != ZX_OK) {
+            if (filled > 0) {
+                break;
+            }
+            return status;
+        } else if (actual == 0) {
+            break;
+        }
+
+        size_t pos = 0;
+        while (actual - pos >= sizeof(vdirent_t)) {
+            auto de = reinterpret_cast<vdirent_t*>(buf + pos);
+            if (de->size < sizeof(vdirent_t) || de->size > actual - pos) {
+                break;
+            }
+            size_t namelen = strnlen(de->name, de->size - sizeof(vdirent_t));
+            size_t size = fbl::round_up(sizeof(vdirent_plus_t) + namelen + 1, 8u);
+            ZX_DEBUG_ASSERT(size <= len - filled);
+            auto dp = reinterpret_cast<vdirent_plus_t*>(out + filled);
+            dp->size = static_cast<uint32_t>(size);
+            dp->type = de->type;
+            GetattrEntry(vn, fbl::StringPiece(de->name, namelen), &dp->attr);
+            memcpy(dp->name, de->name, namelen);
+            dp->name[namelen] = 0;
+            filled += size;
+            pos += de->size;
+        }
+    }
+
+    *out_actual = filled;
+    return ZX_OK;
+}
+
 zx_status_t Vfs::Link(zx::event token, fbl::RefPtr<Vnode> oldparent,
                       fbl::StringPiece oldStr, fbl::StringPiece newStr) {
     fbl::AutoLock lock(&vfs_lock_);
@@ -433,6 +505,44 @@ zx_status_t Vfs::ServeDirectory(fbl::RefPtr<fs::Vnode> vn, zx::channel channel)
     return vn->Serve(this, fbl::move(channel), ZX_FS_RIGHT_ADMIN);
 }
 
+bool Vfs::BeginDispatch(Vnode* vn, uint32_t op) {
+    if (!concurrent_) {
+        return true;
+    }
+    fbl::AutoLock lock(&dispatch_lock_);
+    // Messages which must be handled alone go ahead of any which arrive after
+    // them, so that a stream of reads can't hold them off forever.
+    while (dispatch_exclusive_ || dispatch_waiting_ > 0) {
+        cnd_wait(&dispatch_cvar_, &dispatch_lock_);
+    }
+    if (vn != nullptr && vn->CanDispatchConcurrently(op)) {
+        dispatch_shared_++;
+        return false;
+    }
+    dispatch_waiting_++;
+    while (dispatch_exclusive_ || dispatch_shared_ > 0) {
+        cnd_wait(&dispatch_cvar_, &dispatch_lock_);
+    }
+    dispatch_waiting_--;
+    dispatch_exclusive_ = true;
+    return true;
+}
+
+void Vfs::EndDispatch(bool exclusive) {
+    if (!concurrent_) {
+        return;
+    }
+    fbl::AutoLock lock(&dispatch_lock_);
+    if (exclusive) {
+        dispatch_exclusive_ = false;
+    } else {
+        dispatch_shared_--;
+    }
+    if (exclusive || dispatch_shared_ == 0) {
+        cnd_broadcast(&dispatch_cvar_);
+    }
+}
+
 void Vfs::RegisterConnection(fbl::unique_ptr<Connection> connection) {
     // The connection will be destroyed by |UnregisterAndDestroyConnection()|
     connection.release();
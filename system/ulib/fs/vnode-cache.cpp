@@ -0,0 +1,168 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fbl/auto_lock.h>
+#include <fs/vnode-cache.h>
+#include <zircon/syscalls.h>
+
+namespace fs {
+namespace {
+
+// While memory is short, the cache is held to this fraction of its limits.
+constexpr size_t kWarningShrink = 4;
+
+bool IsSignaled(const zx::event& event) {
+    return event.wait_one(ZX_EVENT_SIGNALED, 0, nullptr) == ZX_OK;
+}
+
+} // namespace
+
+VnodeCache::VnodeCache(size_t max_vnodes, size_t max_bytes)
+    : max_vnodes_(max_vnodes), max_bytes_(max_bytes) {}
+
+VnodeCache::~VnodeCache() {
+    if (async_ != nullptr) {
+        warning_wait_.Cancel(async_);
+        critical_wait_.Cancel(async_);
+    }
+    Clear();
+}
+
+void VnodeCache::Retain(fbl::RefPtr<Vnode> vn, size_t bytes) {
+    {
+        fbl::AutoLock lock(&lock_);
+        if (vn->cache_node_.InContainer()) {
+            // |vn| still holds a reference, so this can't be the last one.
+            RemoveLocked(vn.get());
+        }
+        UpdatePressureLocked();
+        vn->cache_bytes_ = bytes;
+        count_++;
+        bytes_ += bytes;
+        lru_.push_front(fbl::move(vn));
+    }
+    Trim();
+}
+
+void VnodeCache::Evict(Vnode* vn) {
+    fbl::RefPtr<Vnode> evicted;
+    fbl::AutoLock lock(&lock_);
+    if (vn->cache_node_.InContainer()) {
+        evicted = RemoveLocked(vn);
+    }
+}
+
+void VnodeCache::Clear() {
+    for (;;) {
+        fbl::RefPtr<Vnode> evicted;
+        fbl::AutoLock lock(&lock_);
+        if (lru_.is_empty()) {
+            return;
+        }
+        evicted = RemoveLocked(&lru_.back());
+    }
+}
+
+zx_status_t VnodeCache::WatchMemoryPressure(async_t* async, zx::event warning,
+                                            zx::event critical) {
+    fbl::AutoLock lock(&lock_);
+    ZX_DEBUG_ASSERT(async_ == nullptr);
+    async_ = async;
+    warning_ = fbl::move(warning);
+    critical_ = fbl::move(critical);
+    warning_wait_.set_object(warning_.get());
+    warning_wait_.set_trigger(ZX_EVENT_SIGNALED);
+    critical_wait_.set_object(critical_.get());
+    critical_wait_.set_trigger(ZX_EVENT_SIGNALED);
+
+    zx_status_t status;
+    if ((status = warning_wait_.Begin(async_)) != ZX_OK) {
+        return status;
+    }
+    warning_pending_ = true;
+    if ((status = critical_wait_.Begin(async_)) != ZX_OK) {
+        return status;
+    }
+    critical_pending_ = true;
+    return ZX_OK;
+}
+
+fbl::RefPtr<Vnode> VnodeCache::RemoveLocked(Vnode* vn) {
+    count_--;
+    bytes_ -= vn->cache_bytes_;
+    return lru_.erase(*vn);
+}
+
+void VnodeCache::UpdatePressureLocked() {
+    if (pressure_ == Pressure::kNormal) {
+        return;
+    }
+    // The waits don't repeat, since the events stay signaled for as long as
+    // their level lasts. Once a level is over, wait for it to come back.
+    bool warning = IsSignaled(warning_);
+    bool critical = IsSignaled(critical_);
+    pressure_ = critical ? Pressure::kCritical :
+                warning ? Pressure::kWarning : Pressure::kNormal;
+    if (!warning && !warning_pending_) {
+        warning_pending_ = warning_wait_.Begin(async_) == ZX_OK;
+    }
+    if (!critical && !critical_pending_) {
+        critical_pending_ = critical_wait_.Begin(async_) == ZX_OK;
+    }
+}
+
+void VnodeCache::Trim() {
+    // Vnodes are released one at a time, without holding |lock_|: dropping
+    // the last reference to a vnode calls into its filesystem, which may
+    // use the cache again.
+    for (;;) {
+        fbl::RefPtr<Vnode> evicted;
+        fbl::AutoLock lock(&lock_);
+        size_t max_vnodes = max_vnodes_;
+        size_t max_bytes = max_bytes_;
+        if (pressure_ == Pressure::kWarning) {
+            max_vnodes /= kWarningShrink;
+            max_bytes /= kWarningShrink;
+        } else if (pressure_ == Pressure::kCritical) {
+            max_vnodes = 0;
+            max_bytes = 0;
+        }
+        if (count_ <= max_vnodes && bytes_ <= max_bytes) {
+            return;
+        }
+        evicted = RemoveLocked(&lru_.back());
+    }
+}
+
+async_wait_result_t VnodeCache::OnWarning(async_t* async, zx_status_t status,
+                                          const zx_packet_signal_t* signal) {
+    {
+        fbl::AutoLock lock(&lock_);
+        warning_pending_ = false;
+        if (status != ZX_OK) {
+            return ASYNC_WAIT_FINISHED;
+        }
+        if (pressure_ == Pressure::kNormal) {
+            pressure_ = Pressure::kWarning;
+        }
+    }
+    Trim();
+    return ASYNC_WAIT_FINISHED;
+}
+
+async_wait_result_t VnodeCache::OnCritical(async_t* async, zx_status_t status,
+                                           const zx_packet_signal_t* signal) {
+    {
+        fbl::AutoLock lock(&lock_);
+        critical_pending_ = false;
+        if (status != ZX_OK) {
+            return ASYNC_WAIT_FINISHED;
+        }
+        pressure_ = Pressure::kCritical;
+    }
+    Trim();
+    return ASYNC_WAIT_FINISHED;
+}
+
+} // namespace fs
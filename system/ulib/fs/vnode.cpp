@@ -29,6 +29,10 @@ zx_status_t Vnode::GetHandles(uint32_t flags, zx_handle_t* hnd, uint32_t* type,
 zx_status_t Vnode::WatchDir(Vfs* vfs, const vfs_watch_dir_t* cmd) {
     return ZX_ERR_NOT_SUPPORTED;
 }
+
+bool Vnode::CanDispatchConcurrently(uint32_t op) {
+    return false;
+}
 #endif
 
 void Vnode::Notify(fbl::StringPiece name, unsigned event) {}
@@ -104,6 +108,10 @@ zx_status_t Vnode::Mmap(int flags, size_t len, size_t* off, zx_handle_t* out) {
     return ZX_ERR_NOT_SUPPORTED;
 }
 
+zx_status_t Vnode::ShareVmo(zx_handle_t* out_vmo, zx_handle_t* out_token, size_t* out_length) {
+    return ZX_ERR_NOT_SUPPORTED;
+}
+
 zx_status_t Vnode::Sync() {
     return ZX_ERR_NOT_SUPPORTED;
 }
@@ -0,0 +1,119 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "blit.h"
+
+#include <stdbool.h>
+#include <threads.h>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+static void fill32_scalar(uint32_t* dst, uint32_t color, size_t count) {
+    while (count--) {
+        *dst++ = color;
+    }
+}
+
+#if defined(__x86_64__)
+
+// SSE2 is part of the x86-64 baseline so it never needs to be detected.
+static void fill32_sse2(uint32_t* dst, uint32_t color, size_t count) {
+    __m128i v = _mm_set1_epi32((int)color);
+    for (; count >= 16; count -= 16, dst += 16) {
+        _mm_storeu_si128((__m128i*)dst, v);
+        _mm_storeu_si128((__m128i*)(dst + 4), v);
+        _mm_storeu_si128((__m128i*)(dst + 8), v);
+        _mm_storeu_si128((__m128i*)(dst + 12), v);
+    }
+    for (; count >= 4; count -= 4, dst += 4) {
+        _mm_storeu_si128((__m128i*)dst, v);
+    }
+    fill32_scalar(dst, color, count);
+}
+
+__attribute__((target("avx2")))
+static void fill32_avx2(uint32_t* dst, uint32_t color, size_t count) {
+    __m256i v = _mm256_set1_epi32((int)color);
+    for (; count >= 32; count -= 32, dst += 32) {
+        _mm256_storeu_si256((__m256i*)dst, v);
+        _mm256_storeu_si256((__m256i*)(dst + 8), v);
+        _mm256_storeu_si256((__m256i*)(dst + 16), v);
+        _mm256_storeu_si256((__m256i*)(dst + 24), v);
+    }
+    for (; count >= 8; count -= 8, dst += 8) {
+        _mm256_storeu_si256((__m256i*)dst, v);
+    }
+    fill32_scalar(dst, color, count);
+}
+
+static bool cpu_has_avx2(void) {
+    uint32_t eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0, NULL) < 7) {
+        return false;
+    }
+    __cpuid(1, eax, ebx, ecx, edx);
+    if (!(ecx & bit_AVX) || !(ecx & bit_OSXSAVE)) {
+        return false;
+    }
+    // The OS must be saving the YMM registers too.
+    uint32_t xcr0_lo, xcr0_hi;
+    __asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    if ((xcr0_lo & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return ebx & bit_AVX2;
+}
+
+#elif defined(__aarch64__)
+
+// NEON is mandatory on arm64.
+static void fill32_neon(uint32_t* dst, uint32_t color, size_t count) {
+    uint32x4_t v = vdupq_n_u32(color);
+    for (; count >= 16; count -= 16, dst += 16) {
+        vst1q_u32(dst, v);
+        vst1q_u32(dst + 4, v);
+        vst1q_u32(dst + 8, v);
+        vst1q_u32(dst + 12, v);
+    }
+    for (; count >= 4; count -= 4, dst += 4) {
+        vst1q_u32(dst, v);
+    }
+    fill32_scalar(dst, color, count);
+}
+
+#endif
+
+static void (*fill32_impl)(uint32_t* dst, uint32_t color, size_t count) = fill32_scalar;
+static once_flag select_once = ONCE_FLAG_INIT;
+
+static void select_kernels(void) {
+#if defined(__x86_64__)
+    fill32_impl = cpu_has_avx2() ? fill32_avx2 : fill32_sse2;
+#elif defined(__aarch64__)
+    fill32_impl = fill32_neon;
+#endif
+}
+
+void gfx_fill32(uint32_t* dst, uint32_t color, size_t count) {
+    call_once(&select_once, select_kernels);
+    fill32_impl(dst, color, count);
+}
+
+void gfx_fill16(uint16_t* dst, uint16_t color, size_t count) {
+    if (count > 0 && ((uintptr_t)dst & 2)) {
+        *dst++ = color;
+        count--;
+    }
+    // Fill the 4-byte aligned middle two pixels at a time.
+    gfx_fill32((uint32_t*)dst, ((uint32_t)color << 16) | color, count / 2);
+    if (count & 1) {
+        dst[count - 1] = color;
+    }
+}
@@ -0,0 +1,23 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS
+
+// Span kernels used by the surface drawing routines. The vector variants are
+// picked the first time one is called, based on what the CPU supports.
+
+// Fills |count| 32-bit pixels starting at |dst| with |color|.
+void gfx_fill32(uint32_t* dst, uint32_t color, size_t count);
+
+// Fills |count| 16-bit pixels starting at |dst| with |color|.
+void gfx_fill16(uint16_t* dst, uint16_t color, size_t count);
+
+__END_CDECLS
@@ -15,6 +15,7 @@ MODULE_LIBS := \
     system/ulib/c \
 
 MODULE_SRCS += \
+    $(LOCAL_DIR)/blit.c \
     $(LOCAL_DIR)/gfx.c \
 
 include make/module.mk
@@ -12,7 +12,9 @@ namespace hid {
 // The hid report descriptor parser consists of a single function
 // ParseReportDescriptor() that takes as input a USB report descriptor
 // byte stream and on success returns a heap-allocated DeviceDescriptor
-// structure. When not needed it can be freed by standard C++ delete.
+// structure. When not needed it must be freed with FreeDeviceDescriptor().
+//
+// To decode the reports themselves, see hid-parser/report.h.
 //
 // The DeviceDescriptor data is organized at the first level by the
 // array |report[rep_count]| in which each entry points to the first
@@ -235,4 +237,6 @@ ParseResult ParseReportDescriptor(
     const uint8_t* rpt_desc, size_t desc_len,
     DeviceDescriptor** dev_desc);
 
+void FreeDeviceDescriptor(DeviceDescriptor* dev_desc);
+
 }  // namespace hid
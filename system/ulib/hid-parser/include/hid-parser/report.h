@@ -0,0 +1,93 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <hid-parser/parser.h>
+
+namespace hid {
+
+// Walking the DeviceDescriptor for every report the device sends is
+// wasteful for high-rate devices such as touchscreens and sensors. Instead,
+// CompileReports() reduces the descriptor to one ReportProgram per report
+// id, which lists only where each data field lives:
+//
+//    ReportPrograms (type: kInput)
+//      programs[0] report_id: 3  byte_sz: 3
+//                  fields[0]  bit_offset:  8  bit_sz: 8  signed  desktop,X
+//                  fields[1]  bit_offset: 16  bit_sz: 8  signed  desktop,Y
+//      programs[1] ...
+//
+// Constant (padding) fields take up space in the report but are left out
+// of the program. Decoding a report is then a matter of finding its
+// program and running ExtractFields() over it.
+
+// Where a single data field is stored in a report.
+struct FieldExtractor {
+    Usage usage;
+    // Offset from the start of the report, counting the report id byte
+    // if there is one.
+    uint32_t bit_offset;
+    // Between 1 and 32.
+    uint8_t bit_sz;
+    // True if the logical minimum is negative, in which case the value is
+    // sign-extended.
+    bool is_signed;
+};
+
+struct ReportProgram {
+    // Zero if the device doesn't use report ids.
+    uint8_t report_id;
+    // The length of the report in bytes, including the report id byte.
+    uint32_t byte_sz;
+    size_t field_count;
+    const FieldExtractor* fields;
+};
+
+struct ReportPrograms {
+    NodeType type;
+    size_t count;
+    const ReportProgram* programs;
+};
+
+// Compiles the reports of |type| described by |dev_desc|. On success the
+// result must be freed with FreeReportPrograms(). Fields wider than 32
+// bits (usually vendor-specific byte buffers) are left out of the
+// programs, like padding.
+ParseResult CompileReports(const DeviceDescriptor* dev_desc, NodeType type,
+                           ReportPrograms** programs);
+
+void FreeReportPrograms(ReportPrograms* programs);
+
+// Returns the program that decodes |report|, or null if there is none.
+const ReportProgram* FindReportProgram(const ReportPrograms* programs,
+                                       const uint8_t* report, size_t len);
+
+// Reads the field described by |field| out of |report|, which must be at
+// least as long as the field's program says.
+inline int32_t ExtractField(const FieldExtractor& field, const uint8_t* report) {
+    const uint8_t* data = report + (field.bit_offset / 8);
+    const uint32_t shift = field.bit_offset % 8;
+    const uint32_t nbytes = (shift + field.bit_sz + 7) / 8;
+    uint64_t raw = 0;
+    for (uint32_t ix = 0; ix != nbytes; ++ix)
+        raw |= static_cast<uint64_t>(data[ix]) << (8 * ix);
+    raw >>= shift;
+
+    const uint32_t unused = 64 - field.bit_sz;
+    if (field.is_signed)
+        return static_cast<int32_t>(static_cast<int64_t>(raw << unused) >> unused);
+    return static_cast<int32_t>((raw << unused) >> unused);
+}
+
+// Extracts every field of |program| from |report| into |values|, which
+// must have room for program->field_count values. Returns false if
+// |report| is too short.
+bool ExtractFields(const ReportProgram* program, const uint8_t* report,
+                   size_t len, int32_t* values);
+
+}  // namespace hid
@@ -5,6 +5,7 @@
 #include <hid-parser/parser.h>
 #include <hid-parser/item.h>
 
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/type_support.h>
@@ -13,11 +14,11 @@
 
 namespace {
 // Takes a every bit from 0 to 15 and converts them into a
-// 01 if 1 or 10 if 0.
+// 10 if 1 or 01 if 0.
 uint32_t expand_bitfield(uint32_t bitfield) {
     uint32_t result = 0u;
     for (uint8_t ix = 0; ix != 16; ++ix) {
-        uint32_t twobit = (bitfield & 0x1) ? 0x10 : 0x01;
+        uint32_t twobit = (bitfield & 0x1) ? 0x02 : 0x01;
         result |= twobit << (2 * ix);
         bitfield >>= 1;
     }
@@ -291,6 +292,72 @@ public:
         return kParseOk;
     }
 
+    // Post-processing: copies the collections and fields into a single
+    // allocation, grouping the fields by report id as described in
+    // parser.h.
+    ParseResult MakeDeviceDescriptor(DeviceDescriptor** device) {
+        // Report ids in order of first appearance.
+        uint8_t ids[UINT8_MAX + 1];
+        bool seen[UINT8_MAX + 1] = {};
+        size_t rep_count = 0;
+        for (const auto& field : fields_) {
+            if (!seen[field.report_id]) {
+                seen[field.report_id] = true;
+                ids[rep_count++] = field.report_id;
+            }
+        }
+
+        const size_t fields_offset = fbl::round_up(
+            sizeof(DeviceDescriptor) + rep_count * sizeof(ReportField*),
+            alignof(ReportField));
+        const size_t coll_offset = fbl::round_up(
+            fields_offset + fields_.size() * sizeof(ReportField),
+            alignof(Collection));
+        const size_t total = coll_offset + coll_.size() * sizeof(Collection);
+
+        fbl::AllocChecker ac;
+        uint8_t* mem = new (&ac) uint8_t[total];
+        if (!ac.check())
+            return kParseNoMemory;
+
+        auto dev = reinterpret_cast<DeviceDescriptor*>(mem);
+        auto fields = reinterpret_cast<ReportField*>(mem + fields_offset);
+        auto colls = reinterpret_cast<Collection*>(mem + coll_offset);
+
+        for (size_t ix = 0; ix != coll_.size(); ++ix) {
+            colls[ix] = coll_[ix];
+            if (coll_[ix].parent != nullptr)
+                colls[ix].parent = &colls[coll_[ix].parent - &coll_[0]];
+        }
+
+        ReportField* last[UINT8_MAX + 1] = {};
+        dev->rep_count = rep_count;
+        for (size_t ix = 0; ix != rep_count; ++ix)
+            dev->report[ix] = nullptr;
+
+        for (size_t ix = 0; ix != fields_.size(); ++ix) {
+            ReportField* field = &fields[ix];
+            *field = fields_[ix];
+            field->col = &colls[fields_[ix].col - &coll_[0]];
+            if (field->col->node == nullptr)
+                field->col->node = field;
+
+            const uint8_t id = field->report_id;
+            if (last[id] == nullptr) {
+                for (size_t r = 0; r != rep_count; ++r) {
+                    if (ids[r] == id)
+                        dev->report[r] = field;
+                }
+            } else {
+                last[id]->next = field;
+            }
+            last[id] = field;
+        }
+
+        *device = dev;
+        return kParseOk;
+    }
+
 private:
     struct StateTable {
         Attributes attributes;
@@ -470,7 +537,11 @@ ParseResult ParseReportDescriptor(
         buf += actual;
     }
 
-    return kParseOk;
+    return state.MakeDeviceDescriptor(device);
+}
+
+void FreeDeviceDescriptor(DeviceDescriptor* dev_desc) {
+    delete[] reinterpret_cast<uint8_t*>(dev_desc);
 }
 
 }  // namespace hid
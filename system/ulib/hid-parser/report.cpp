@@ -0,0 +1,132 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <hid-parser/report.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+
+namespace hid {
+namespace {
+
+constexpr uint8_t kMaxExtractBits = 32u;
+
+bool is_constant(const ReportField* field) {
+    return ((field->field_type >> static_cast<uint8_t>(FieldTypeFlags::kConstant)) & 0x1) == 0x1;
+}
+
+bool is_extracted(const ReportField* field) {
+    return !is_constant(field) &&
+           (field->attr.bit_sz > 0) && (field->attr.bit_sz <= kMaxExtractBits);
+}
+
+}  // namespace
+
+ParseResult CompileReports(const DeviceDescriptor* dev_desc, NodeType type,
+                           ReportPrograms** programs) {
+    // First pass: size everything, so the result is a single allocation.
+    size_t prog_count = 0;
+    size_t field_count = 0;
+    for (size_t r = 0; r != dev_desc->rep_count; ++r) {
+        bool has_type = false;
+        for (auto field = dev_desc->report[r]; field != nullptr; field = field->next) {
+            if (field->type != type)
+                continue;
+            has_type = true;
+            if (is_extracted(field))
+                ++field_count;
+        }
+        if (has_type)
+            ++prog_count;
+    }
+
+    const size_t progs_offset = fbl::round_up(sizeof(ReportPrograms), alignof(ReportProgram));
+    const size_t fields_offset = fbl::round_up(progs_offset + prog_count * sizeof(ReportProgram),
+                                               alignof(FieldExtractor));
+    const size_t total = fields_offset + field_count * sizeof(FieldExtractor);
+
+    fbl::AllocChecker ac;
+    uint8_t* mem = new (&ac) uint8_t[total];
+    if (!ac.check())
+        return kParseNoMemory;
+
+    auto result = reinterpret_cast<ReportPrograms*>(mem);
+    auto progs = reinterpret_cast<ReportProgram*>(mem + progs_offset);
+    auto extractors = reinterpret_cast<FieldExtractor*>(mem + fields_offset);
+
+    result->type = type;
+    result->count = prog_count;
+    result->programs = progs;
+
+    // Second pass: lay out the fields of each report.
+    ReportProgram* prog = progs;
+    FieldExtractor* extractor = extractors;
+    for (size_t r = 0; r != dev_desc->rep_count; ++r) {
+        const ReportField* first = dev_desc->report[r];
+        uint32_t bit_offset = (first->report_id != 0) ? 8u : 0u;
+        const FieldExtractor* prog_fields = extractor;
+        bool has_type = false;
+
+        for (auto field = first; field != nullptr; field = field->next) {
+            if (field->type != type)
+                continue;
+            has_type = true;
+            if (is_extracted(field)) {
+                *extractor++ = FieldExtractor {
+                    field->attr.usage,
+                    bit_offset,
+                    field->attr.bit_sz,
+                    field->attr.logc_mm.min < 0
+                };
+            }
+            bit_offset += field->attr.bit_sz;
+        }
+
+        if (!has_type)
+            continue;
+        *prog++ = ReportProgram {
+            first->report_id,
+            (bit_offset + 7) / 8,
+            static_cast<size_t>(extractor - prog_fields),
+            prog_fields
+        };
+    }
+
+    *programs = result;
+    return kParseOk;
+}
+
+void FreeReportPrograms(ReportPrograms* programs) {
+    delete[] reinterpret_cast<uint8_t*>(programs);
+}
+
+const ReportProgram* FindReportProgram(const ReportPrograms* programs,
+                                       const uint8_t* report, size_t len) {
+    if (programs->count == 0 || len == 0)
+        return nullptr;
+
+    // Either every report of a device starts with its id, or there is only
+    // one report and it has none.
+    if (programs->programs[0].report_id == 0)
+        return &programs->programs[0];
+
+    for (size_t ix = 0; ix != programs->count; ++ix) {
+        if (programs->programs[ix].report_id == report[0])
+            return &programs->programs[ix];
+    }
+    return nullptr;
+}
+
+bool ExtractFields(const ReportProgram* program, const uint8_t* report,
+                   size_t len, int32_t* values) {
+    if (len < program->byte_sz)
+        return false;
+
+    const FieldExtractor* field = program->fields;
+    for (size_t ix = 0; ix != program->field_count; ++ix, ++field)
+        values[ix] = ExtractField(*field, report);
+    return true;
+}
+
+}  // namespace hid
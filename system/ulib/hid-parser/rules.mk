@@ -10,7 +10,8 @@ MODULE_TYPE := userlib
 
 MODULE_SRCS += \
     $(LOCAL_DIR)/item.cpp \
-    $(LOCAL_DIR)/parser.cpp
+    $(LOCAL_DIR)/parser.cpp \
+    $(LOCAL_DIR)/report.cpp
 
 MODULE_STATIC_LIBS := \
     system/ulib/fbl \
@@ -32,7 +32,7 @@ static zx_status_t guest_get_resource(zx_handle_t* resource) {
     return n < 0 ? ZX_ERR_IO : ZX_OK;
 }
 
-zx_status_t Guest::Init(size_t mem_size) {
+zx_status_t Guest::Init(size_t mem_size, bool populate) {
     zx_status_t status = phys_mem_.Init(mem_size);
     if (status != ZX_OK) {
         fprintf(stderr, "Failed to create guest physical memory.\n");
@@ -46,7 +46,8 @@ zx_status_t Guest::Init(size_t mem_size) {
         return status;
     }
 
-    status = zx_guest_create(resource, 0, phys_mem_.vmo(), &guest_);
+    uint32_t options = populate ? ZX_GUEST_OPT_POPULATE : 0;
+    status = zx_guest_create(resource, options, phys_mem_.vmo(), &guest_);
     if (status != ZX_OK) {
         fprintf(stderr, "Failed to create guest.\n");
         return status;
@@ -27,7 +27,10 @@ class Guest {
 public:
     ~Guest();
 
-    zx_status_t Init(size_t mem_size);
+    // Creates a guest with |mem_size| bytes of physical memory. If |populate|
+    // is set, all of that memory is committed and mapped into the guest up
+    // front, rather than as the guest first touches it.
+    zx_status_t Init(size_t mem_size, bool populate = false);
 
     const PhysMem& phys_mem() const { return phys_mem_; }
     zx_handle_t handle() const { return guest_; }
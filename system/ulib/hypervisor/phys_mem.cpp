@@ -10,7 +10,9 @@
 static const uint32_t kMapFlags = ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE;
 
 zx_status_t PhysMem::Init(size_t size) {
-    zx_status_t status = zx::vmo::create(size, 0, &vmo_);
+    // Large pages let the guest's physical memory be mapped with large EPT
+    // entries, both when faulted in and when populated up front.
+    zx_status_t status = zx::vmo::create(size, ZX_VMO_LARGE_PAGES, &vmo_);
     if (status != ZX_OK)
         return status;
 
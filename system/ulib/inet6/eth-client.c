@@ -20,6 +20,8 @@
 void eth_destroy(eth_client_t* eth) {
     zx_handle_close(eth->rx_fifo);
     zx_handle_close(eth->tx_fifo);
+    free(eth->tx_pending);
+    free(eth->rx_pending);
     free(eth);
 }
 
@@ -59,6 +61,14 @@ zx_status_t eth_create(int fd, zx_handle_t io_vmo, void* io_mem, eth_client_t**
     eth->tx_size = fifos.tx_depth;
     eth->iobuf = io_mem;
 
+    eth->tx_pending = calloc(eth->tx_size, sizeof(eth_fifo_entry_t));
+    eth->rx_pending = calloc(eth->rx_size, sizeof(eth_fifo_entry_t));
+    if ((eth->tx_pending == NULL) || (eth->rx_pending == NULL)) {
+        // the fifos now belong to eth, and are closed by eth_destroy()
+        eth_destroy(eth);
+        return ZX_ERR_NO_MEMORY;
+    }
+
     *out = eth;
     return ZX_OK;
 
@@ -69,32 +79,69 @@ fail:
     return status;
 }
 
+// Write out as many of the |*count| entries at |pending| as the fifo takes,
+// keeping any it does not at the front of |pending|.
+static zx_status_t eth_flush(zx_handle_t fifo, eth_fifo_entry_t* pending, uint32_t* count) {
+    uint32_t done = 0;
+    zx_status_t status = ZX_OK;
+    while (done < *count) {
+        uint32_t actual;
+        status = zx_fifo_write(fifo, pending + done, (*count - done) * sizeof(*pending),
+                               &actual);
+        if (status < 0) {
+            break;
+        }
+        done += actual;
+    }
+    if (done > 0 && done < *count) {
+        memmove(pending, pending + done, (*count - done) * sizeof(*pending));
+    }
+    *count -= done;
+    return status;
+}
+
+zx_status_t eth_flush_tx(eth_client_t* eth) {
+    return eth_flush(eth->tx_fifo, eth->tx_pending, &eth->tx_pending_count);
+}
+
+zx_status_t eth_flush_rx(eth_client_t* eth) {
+    return eth_flush(eth->rx_fifo, eth->rx_pending, &eth->rx_pending_count);
+}
+
 zx_status_t eth_queue_tx(eth_client_t* eth, void* cookie,
                          void* data, size_t len, uint32_t options) {
-    eth_fifo_entry_t e = {
-        .offset = data - eth->iobuf,
-        .length = len,
-        .flags = options,
-        .cookie = cookie,
-    };
-    uint32_t actual;
+    if (eth->tx_pending_count == eth->tx_size) {
+        zx_status_t status;
+        if ((status = eth_flush_tx(eth)) < 0) {
+            return status;
+        }
+    }
+    eth_fifo_entry_t* e = &eth->tx_pending[eth->tx_pending_count++];
+    e->offset = data - eth->iobuf;
+    e->length = len;
+    e->flags = options;
+    e->cookie = cookie;
     IORING_TRACE("eth:tx+ c=%p o=%u l=%u f=%u\n",
-                 e.cookie, e.offset, e.length, e.flags);
-    return zx_fifo_write(eth->tx_fifo, &e, sizeof(e), &actual);
+                 e->cookie, e->offset, e->length, e->flags);
+    return ZX_OK;
 }
 
 zx_status_t eth_queue_rx(eth_client_t* eth, void* cookie,
                          void* data, size_t len, uint32_t options) {
-    eth_fifo_entry_t e = {
-        .offset = data - eth->iobuf,
-        .length = len,
-        .flags = options,
-        .cookie = cookie,
-    };
-    uint32_t actual;
+    if (eth->rx_pending_count == eth->rx_size) {
+        zx_status_t status;
+        if ((status = eth_flush_rx(eth)) < 0) {
+            return status;
+        }
+    }
+    eth_fifo_entry_t* e = &eth->rx_pending[eth->rx_pending_count++];
+    e->offset = data - eth->iobuf;
+    e->length = len;
+    e->flags = options;
+    e->cookie = cookie;
     IORING_TRACE("eth:rx+ c=%p o=%u l=%u f=%u\n",
-                 e.cookie, e.offset, e.length, e.flags);
-    return zx_fifo_write(eth->rx_fifo, &e, sizeof(e), &actual);
+                 e->cookie, e->offset, e->length, e->flags);
+    return ZX_OK;
 }
 
 zx_status_t eth_complete_tx(eth_client_t* eth, void* ctx,
@@ -136,7 +183,9 @@ zx_status_t eth_complete_rx(eth_client_t* eth, void* ctx,
                      e->cookie, e->offset, e->length, e->flags);
         func(ctx, e->cookie, e->length, e->flags);
     }
-    return ZX_OK;
+    // Anything the fifo can't take yet stays batched for the next flush
+    status = eth_flush_rx(eth);
+    return (status == ZX_ERR_SHOULD_WAIT) ? ZX_OK : status;
 }
 
 
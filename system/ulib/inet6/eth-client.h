@@ -16,25 +16,41 @@ typedef struct eth_client {
     uint32_t tx_size;
     uint32_t rx_size;
     void* iobuf;
+
+    // Entries queued but not yet written to the fifos, so that a whole batch
+    // goes out in a single zx_fifo_write().
+    eth_fifo_entry_t* tx_pending;
+    eth_fifo_entry_t* rx_pending;
+    uint32_t tx_pending_count;
+    uint32_t rx_pending_count;
 } eth_client_t;
 
 zx_status_t eth_create(int fd, zx_handle_t io_vmo, void* io_mem, eth_client_t** out);
 
 void eth_destroy(eth_client_t* eth);
 
-// Enqueue a packet for transmit
+// Enqueue a packet for transmit. The packet is batched with others and only
+// handed to the driver once the batch fills or on eth_flush_tx().
 zx_status_t eth_queue_tx(eth_client_t* eth, void* cookie,
                          void* data, size_t len, uint32_t options);
 
+// Hand all batched transmit packets to the driver
+zx_status_t eth_flush_tx(eth_client_t* eth);
+
 // Process all transmitted buffers
 zx_status_t eth_complete_tx(eth_client_t* eth, void* ctx,
                             void (*func)(void* ctx, void* cookie));
 
-// Enqueue a packet for reception.
+// Enqueue a packet for reception. As with eth_queue_tx(), buffers are
+// batched until the batch fills or eth_flush_rx() is called.
 zx_status_t eth_queue_rx(eth_client_t* eth, void* cookie,
                          void* data, size_t len, uint32_t options);
 
-// Process all received buffers
+// Hand all batched receive buffers to the driver
+zx_status_t eth_flush_rx(eth_client_t* eth);
+
+// Process all received buffers. Buffers that |func| requeues with
+// eth_queue_rx() are flushed back to the driver before returning.
 zx_status_t eth_complete_rx(eth_client_t* eth, void* ctx,
                             void (*func)(void* ctx, void* cookie, size_t len, uint32_t flags));
 
@@ -151,11 +151,24 @@ zx_status_t udp6_send(const void* data, size_t len,
                       const ip6_addr_t* daddr, uint16_t dport,
                       uint16_t sport, bool block);
 
-// implement to recive UDP packets
+// implement to recive UDP packets for ports without a handler registered
+// through udp6_register(); by default these are dropped
 void udp6_recv(void* data, size_t len,
                const ip6_addr_t* daddr, uint16_t dport,
                const ip6_addr_t* saddr, uint16_t sport);
 
+typedef void (*udp6_recv_cb_t)(void* cookie, void* data, size_t len,
+                               const ip6_addr_t* daddr, uint16_t dport,
+                               const ip6_addr_t* saddr, uint16_t sport);
+
+// Deliver UDP packets for |port| to |func|. Ports are looked up in a hash
+// table, so the cost per packet does not grow with the number of ports.
+// ZX_ERR_ALREADY_EXISTS - port already has a handler
+// ZX_ERR_NO_RESOURCES - too many ports registered
+zx_status_t udp6_register(uint16_t port, udp6_recv_cb_t func, void* cookie);
+
+void udp6_unregister(uint16_t port);
+
 unsigned ip6_checksum(ip6_hdr_t* ip, unsigned type, size_t length);
 
 // NOTES
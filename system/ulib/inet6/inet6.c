@@ -323,6 +323,100 @@ static void report_bad_packet(ip6_addr_t* ip6_addr, const char* msg) {
 }
 #endif
 
+// Registered UDP ports, hashed on port number into buckets of chained
+// entries. Registration is rare, so entries come from a fixed pool.
+#define UDP6_PORT_BUCKETS 32
+#define UDP6_MAX_PORTS 32
+
+typedef struct udp6_port udp6_port_t;
+struct udp6_port {
+    udp6_port_t* next;
+    udp6_recv_cb_t func;
+    void* cookie;
+    uint16_t port;
+    bool in_use;
+};
+
+static mtx_t udp6_port_lock = MTX_INIT;
+static udp6_port_t udp6_port_pool[UDP6_MAX_PORTS] __TA_GUARDED(udp6_port_lock);
+static udp6_port_t* udp6_ports[UDP6_PORT_BUCKETS] __TA_GUARDED(udp6_port_lock);
+
+static inline unsigned udp6_port_hash(uint16_t port) {
+    // Fibonacci hashing spreads runs of adjacent ports across buckets
+    return (uint16_t)(port * 40503u) >> (16 - 5);
+}
+static_assert(UDP6_PORT_BUCKETS == (1 << 5), "udp6_port_hash() assumes 32 buckets");
+
+zx_status_t udp6_register(uint16_t port, udp6_recv_cb_t func, void* cookie) {
+    unsigned key = udp6_port_hash(port);
+    zx_status_t status = ZX_ERR_NO_RESOURCES;
+
+    mtx_lock(&udp6_port_lock);
+    for (udp6_port_t* p = udp6_ports[key]; p != NULL; p = p->next) {
+        if (p->port == port) {
+            status = ZX_ERR_ALREADY_EXISTS;
+            goto done;
+        }
+    }
+    for (size_t n = 0; n < UDP6_MAX_PORTS; n++) {
+        udp6_port_t* p = &udp6_port_pool[n];
+        if (!p->in_use) {
+            p->in_use = true;
+            p->port = port;
+            p->func = func;
+            p->cookie = cookie;
+            p->next = udp6_ports[key];
+            udp6_ports[key] = p;
+            status = ZX_OK;
+            break;
+        }
+    }
+done:
+    mtx_unlock(&udp6_port_lock);
+    return status;
+}
+
+void udp6_unregister(uint16_t port) {
+    mtx_lock(&udp6_port_lock);
+    for (udp6_port_t** pp = &udp6_ports[udp6_port_hash(port)]; *pp != NULL; pp = &(*pp)->next) {
+        if ((*pp)->port == port) {
+            udp6_port_t* p = *pp;
+            *pp = p->next;
+            p->in_use = false;
+            break;
+        }
+    }
+    mtx_unlock(&udp6_port_lock);
+}
+
+__WEAK void udp6_recv(void* data, size_t len,
+                      const ip6_addr_t* daddr, uint16_t dport,
+                      const ip6_addr_t* saddr, uint16_t sport) {
+}
+
+static void udp6_dispatch(void* data, size_t len,
+                          const ip6_addr_t* daddr, uint16_t dport,
+                          const ip6_addr_t* saddr, uint16_t sport) {
+    udp6_recv_cb_t func = NULL;
+    void* cookie = NULL;
+
+    mtx_lock(&udp6_port_lock);
+    for (udp6_port_t* p = udp6_ports[udp6_port_hash(dport)]; p != NULL; p = p->next) {
+        if (p->port == dport) {
+            func = p->func;
+            cookie = p->cookie;
+            break;
+        }
+    }
+    mtx_unlock(&udp6_port_lock);
+
+    if (func != NULL) {
+        func(cookie, data, len, daddr, dport, saddr, sport);
+    } else {
+        udp6_recv(data, len, daddr, dport, saddr, sport);
+    }
+}
+
 void _udp6_recv(ip6_hdr_t* ip, void* _data, size_t len) {
     udp_hdr_t* udp = _data;
     uint16_t sum, n;
@@ -356,9 +450,9 @@ void _udp6_recv(ip6_hdr_t* ip, void* _data, size_t len) {
     }
     len = n - UDP_HDR_LEN;
 
-    udp6_recv((uint8_t*)_data + UDP_HDR_LEN, len,
-              (void*)&ip->dst, ntohs(udp->dst_port),
-              (void*)&ip->src, ntohs(udp->src_port));
+    udp6_dispatch((uint8_t*)_data + UDP_HDR_LEN, len,
+                  (void*)&ip->dst, ntohs(udp->dst_port),
+                  (void*)&ip->src, ntohs(udp->src_port));
 }
 
 void icmp6_recv(ip6_hdr_t* ip, void* _data, size_t len) {
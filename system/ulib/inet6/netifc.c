@@ -58,6 +58,9 @@ static int rxc;
 static mtx_t eth_lock = MTX_INIT;
 static int netfd = -1;
 static eth_client_t* eth;
+// While set, eth_send() leaves packets batched in eth and netifc_poll()
+// flushes them all at once after handling a batch of rx packets.
+static bool eth_tx_batching __TA_GUARDED(eth_lock);
 static uint8_t netmac[6];
 static size_t netmtu;
 
@@ -66,6 +69,8 @@ static void* iobuf;
 
 #define NET_BUFFERS 256
 #define NET_BUFFERSZ 2048
+// Most pending packets to send between checks for incoming ones
+#define NET_TX_BATCH 16
 
 #define ETH_BUFFER_MAGIC 0x424201020304A7A7UL
 
@@ -213,6 +218,11 @@ zx_status_t eth_send(eth_buffer_t* ethbuf, size_t skip, size_t len) {
         eth_put_buffer_locked(ethbuf, ETH_BUFFER_TX);
         goto fail;
     }
+    if (!eth_tx_batching) {
+        // Once queued the packet is sent; a full fifo just delays it until
+        // the next flush.
+        eth_flush_tx(eth);
+    }
 
     mtx_unlock(&eth_lock);
     return ZX_OK;
@@ -333,6 +343,7 @@ static zx_status_t netifc_open_cb(int dirfd, int event, const char* fn, void* co
         }
         eth_queue_rx(eth, ethbuf, ethbuf->data, NET_BUFFERSZ, 0);
     }
+    eth_flush_rx(eth);
 
     mtx_unlock(&eth_lock);
 
@@ -405,11 +416,33 @@ static void rx_complete(void* ctx, void* cookie, size_t len, uint32_t flags) {
     eth_queue_rx(eth, ethbuf, ethbuf->data, NET_BUFFERSZ, 0);
 }
 
+static void netifc_tx_batch_begin(void) {
+    mtx_lock(&eth_lock);
+    eth_tx_batching = true;
+    mtx_unlock(&eth_lock);
+}
+
+static void netifc_tx_batch_end(void) {
+    mtx_lock(&eth_lock);
+    eth_tx_batching = false;
+    if (eth != NULL) {
+        eth_flush_tx(eth);
+    }
+    mtx_unlock(&eth_lock);
+}
+
 int netifc_poll(void) {
     for (;;) {
-        // Handle any completed rx packets
-        zx_status_t status;
-        if ((status = eth_complete_rx(eth, NULL, rx_complete)) < 0) {
+        // Handle any completed rx packets and the next few outgoing packets,
+        // and hand everything they send to the driver in one batch
+        netifc_tx_batch_begin();
+        zx_status_t status = eth_complete_rx(eth, NULL, rx_complete);
+        bool pending = (status >= 0);
+        for (unsigned n = 0; pending && n < NET_TX_BATCH; n++) {
+            pending = netifc_send_pending();
+        }
+        netifc_tx_batch_end();
+        if (status < 0) {
             printf("netifc: eth rx failed: %d\n", status);
             return -1;
         }
@@ -419,7 +452,7 @@ int netifc_poll(void) {
             return 0;
         }
 
-        if (netifc_send_pending()) {
+        if (pending) {
             continue;
         }
 
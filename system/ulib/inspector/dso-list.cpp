@@ -142,6 +142,14 @@ inspector_dsoinfo_t* inspector_dso_lookup(inspector_dsoinfo_t* dso_list,
     return nullptr;
 }
 
+const char* inspector_dso_name(inspector_dsoinfo_t* dso) {
+    return dso->name;
+}
+
+zx_vaddr_t inspector_dso_base(inspector_dsoinfo_t* dso) {
+    return dso->base;
+}
+
 void inspector_dso_print_list(FILE* f, inspector_dsoinfo_t* dso_list) {
     for (inspector_dsoinfo_t* dso = dso_list; dso != nullptr; dso = dso->next) {
         fprintf(f, "dso: id=%s base=%p name=%s\n",
@@ -57,6 +57,10 @@ extern void inspector_dso_free_list(inspector_dsoinfo_t*);
 extern inspector_dsoinfo_t* inspector_dso_lookup (inspector_dsoinfo_t* dso_list,
                                                   zx_vaddr_t pc);
 
+// Return the name of |dso|, and the address it is loaded at.
+extern const char* inspector_dso_name(inspector_dsoinfo_t* dso);
+extern zx_vaddr_t inspector_dso_base(inspector_dsoinfo_t* dso);
+
 // Print |dso_list| to |f|.
 // The format of the output is verify specific: It is read by
 // zircon/scripts/symbolize in order to add source location to the output.
@@ -196,6 +196,9 @@ constexpr uint8_t HDA_REG_RIRBSIZE_CAP_2ENT   = 0x10u;
 constexpr uint8_t HDA_REG_RIRBSIZE_CAP_16ENT  = 0x20u;
 constexpr uint8_t HDA_REG_RIRBSIZE_CAP_256ENT = 0x40u;
 
+/* DMA Position Buffer Lower Base (DPLBASE - offset 0x70) */
+constexpr uint32_t HDA_REG_DPLBASE_ENABLE = 0x00000001u;  // DMA Position Buffer Enable
+
 // Stream Descriptor Control Register bits.
 constexpr uint32_t HDA_SD_REG_CTRL_SRST    = (1u << 0); // Stream Reset
 constexpr uint32_t HDA_SD_REG_CTRL_RUN     = (1u << 1); // Stream Run
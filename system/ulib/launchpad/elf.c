@@ -9,6 +9,7 @@
 #include <zircon/process.h>
 #include <zircon/syscalls.h>
 #include <stdlib.h>
+#include <string.h>
 
 struct elf_load_info {
     elf_load_header_t header;
@@ -19,6 +20,14 @@ void elf_load_destroy(elf_load_info_t* info) {
     free(info);
 }
 
+elf_load_info_t* elf_load_dup(const elf_load_info_t* info) {
+    size_t size = sizeof(*info) + (size_t)info->header.e_phnum * sizeof(elf_phdr_t);
+    elf_load_info_t* copy = malloc(size);
+    if (copy != NULL)
+        memcpy(copy, info, size);
+    return copy;
+}
+
 zx_status_t elf_load_start(zx_handle_t vmo, const void* hdr_buf, size_t buf_sz,
                            elf_load_info_t** infop) {
     elf_load_header_t header;
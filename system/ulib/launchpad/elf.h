@@ -19,6 +19,10 @@ zx_status_t elf_load_start(zx_handle_t vmo, const void* buf, size_t buf_sz,
 // Clean up and free the data structure created by elf_load_start.
 void elf_load_destroy(elf_load_info_t* info);
 
+// Return a copy of |info|, or NULL if out of memory.
+// The copy must also be passed to elf_load_destroy when finished.
+elf_load_info_t* elf_load_dup(const elf_load_info_t* info);
+
 // Check if the ELF file has a PT_INTERP header.  On success, *interp
 // is NULL if it had none or a malloc'd string of the contents;
 // *interp_len is strlen(*interp).
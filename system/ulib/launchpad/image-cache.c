@@ -0,0 +1,173 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "image-cache.h"
+
+#include <fdio/io.h>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <threads.h>
+#include <unistd.h>
+
+#include <zircon/compiler.h>
+#include <zircon/syscalls.h>
+
+// Enough to hold the dynamic linker and the libraries that nearly every
+// process uses, without pinning an unbounded amount of memory.
+#define IMAGE_CACHE_ENTRIES 32
+
+typedef struct image_cache_entry {
+    char* path;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    zx_handle_t vmo;
+    elf_load_info_t* elf;
+    uint64_t last_use;
+} image_cache_entry_t;
+
+static mtx_t image_cache_lock = MTX_INIT;
+static image_cache_entry_t image_cache[IMAGE_CACHE_ENTRIES] __TA_GUARDED(image_cache_lock);
+static uint64_t image_cache_clock __TA_GUARDED(image_cache_lock);
+
+static bool entry_matches(const image_cache_entry_t* e, const struct stat* st) {
+    return e->ino == st->st_ino && e->size == st->st_size &&
+        e->mtime.tv_sec == st->st_mtim.tv_sec &&
+        e->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+static void entry_clear(image_cache_entry_t* e) {
+    free(e->path);
+    zx_handle_close(e->vmo);
+    if (e->elf != NULL)
+        elf_load_destroy(e->elf);
+    memset(e, 0, sizeof(*e));
+}
+
+// Hand out a clone of |vmo| (and a copy of its headers), leaving |vmo| as is.
+static zx_status_t clone_image(zx_handle_t vmo, const elf_load_info_t* cached,
+                               zx_handle_t* out, elf_load_info_t** elf) {
+    uint64_t size;
+    zx_status_t status = zx_vmo_get_size(vmo, &size);
+    if (status != ZX_OK)
+        return status;
+    elf_load_info_t* copy = NULL;
+    if (elf != NULL && cached != NULL && (copy = elf_load_dup(cached)) == NULL)
+        return ZX_ERR_NO_MEMORY;
+    status = zx_vmo_clone(vmo, ZX_VMO_CLONE_COPY_ON_WRITE, 0, size, out);
+    if (status != ZX_OK) {
+        if (copy != NULL)
+            elf_load_destroy(copy);
+        return status;
+    }
+    if (elf != NULL)
+        *elf = copy;
+    return ZX_OK;
+}
+
+zx_status_t image_cache_get_vmo(int fd, const char* path,
+                                zx_handle_t* out, elf_load_info_t** elf) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_ino == 0) {
+        // Nothing to tell one version of the file from the next,
+        // so it cannot be cached.
+        if (elf != NULL)
+            *elf = NULL;
+        return fdio_get_vmo(fd, out);
+    }
+
+    zx_status_t status;
+    mtx_lock(&image_cache_lock);
+    for (size_t i = 0; i < IMAGE_CACHE_ENTRIES; ++i) {
+        image_cache_entry_t* e = &image_cache[i];
+        if (e->path == NULL || strcmp(e->path, path) != 0)
+            continue;
+        if (entry_matches(e, &st)) {
+            e->last_use = ++image_cache_clock;
+            status = clone_image(e->vmo, e->elf, out, elf);
+            mtx_unlock(&image_cache_lock);
+            return status;
+        }
+        // The file changed underneath us; forget the old contents.
+        entry_clear(e);
+        break;
+    }
+    mtx_unlock(&image_cache_lock);
+
+    // Miss: do the I/O without holding the lock.
+    zx_handle_t vmo;
+    if ((status = fdio_get_vmo(fd, &vmo)) != ZX_OK)
+        return status;
+    elf_load_info_t* info;
+    if (elf_load_start(vmo, NULL, 0, &info) != ZX_OK)
+        info = NULL;
+    if ((status = clone_image(vmo, info, out, elf)) != ZX_OK) {
+        if (info != NULL)
+            elf_load_destroy(info);
+        zx_handle_close(vmo);
+        return status;
+    }
+
+    image_cache_entry_t entry = {
+        .path = strdup(path),
+        .ino = st.st_ino,
+        .size = st.st_size,
+        .mtime = st.st_mtim,
+        .vmo = vmo,
+        .elf = info,
+    };
+    if (entry.path == NULL) {
+        entry_clear(&entry);
+        return ZX_OK;
+    }
+
+    mtx_lock(&image_cache_lock);
+    image_cache_entry_t* victim = &image_cache[0];
+    for (size_t i = 0; i < IMAGE_CACHE_ENTRIES; ++i) {
+        image_cache_entry_t* e = &image_cache[i];
+        if (e->path != NULL && strcmp(e->path, path) == 0) {
+            // Another thread loaded the same path while we were reading.
+            victim = e;
+            break;
+        }
+        if (e->path == NULL ||
+            (victim->path != NULL && e->last_use < victim->last_use))
+            victim = e;
+    }
+    image_cache_entry_t old = *victim;
+    entry.last_use = ++image_cache_clock;
+    *victim = entry;
+    mtx_unlock(&image_cache_lock);
+
+    // Drop the evicted entry's handles outside the lock.
+    if (old.path != NULL)
+        entry_clear(&old);
+    return ZX_OK;
+}
+
+zx_status_t image_cache_load_path(const char* path,
+                                  zx_handle_t* out, elf_load_info_t** elf) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return ZX_ERR_IO;
+    zx_status_t status = image_cache_get_vmo(fd, path, out, elf);
+    close(fd);
+
+    if (status == ZX_OK) {
+        const char* name = path;
+        if (strlen(name) >= ZX_MAX_NAME_LEN) {
+            const char* p = strrchr(name, '/');
+            if (p != NULL) {
+                name = p + 1;
+            }
+        }
+        zx_object_set_property(*out, ZX_PROP_NAME, name, strlen(name));
+    }
+
+    return status;
+}
@@ -0,0 +1,30 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include "elf.h"
+
+#include <zircon/types.h>
+
+#pragma GCC visibility push(hidden)
+
+// Get a VMO holding the contents of the file open on |fd|, which was
+// opened from |path|.  The first load of a path reads the file and keeps
+// its VMO, along with its parsed ELF headers, in a process-wide cache.
+// Later loads of the same unchanged file (same inode, size and mtime) are
+// satisfied with a copy-on-write clone of the cached VMO and do no I/O.
+//
+// If |elf| is not NULL, on success *elf is either NULL (the file is not
+// an ELF file) or a copy of its parsed headers that matches *out and must
+// be passed to elf_load_destroy.  Does not consume |fd|.
+zx_status_t image_cache_get_vmo(int fd, const char* path,
+                                zx_handle_t* out, elf_load_info_t** elf);
+
+// Open |path| and call image_cache_get_vmo, naming the VMO for the file.
+// Returns ZX_ERR_IO, with errno set, if the file cannot be opened.
+zx_status_t image_cache_load_path(const char* path,
+                                  zx_handle_t* out, elf_load_info_t** elf);
+
+#pragma GCC visibility pop
@@ -133,6 +133,49 @@ zx_status_t launchpad_load_from_fd(launchpad_t* lp, int fd);
 zx_status_t launchpad_load_from_vmo(launchpad_t* lp, zx_handle_t vmo);
 
 
+// PROCESS TEMPLATES
+// A template does the work common to every launch of one executable
+// once: it reads the file, parses its ELF headers, and fetches and parses
+// the dynamic linker named by its PT_INTERP.  Launching from a template
+// then only maps copy-on-write clones of those images into the new
+// process, which still gets its own randomized address space layout.
+// -------------------------------------------------------------------
+
+typedef struct launchpad_template launchpad_template_t;
+
+// Create a template for the ELF executable at path, fetching its
+// dynamic linker from the default loader service.  #! scripts are not
+// supported.
+zx_status_t launchpad_template_create(const char* path,
+                                      launchpad_template_t** result);
+
+// Free a template.  Launchpads created from it are not affected.
+void launchpad_template_destroy(launchpad_template_t* tmpl);
+
+// Set the arguments or environment that every launchpad created from
+// the template starts out with, as for launchpad_set_args and
+// launchpad_set_environ.
+zx_status_t launchpad_template_set_args(launchpad_template_t* tmpl,
+                                        int argc, const char* const* argv);
+zx_status_t launchpad_template_set_environ(launchpad_template_t* tmpl,
+                                           const char* const* envp);
+
+// Add a handle to the template, taking ownership of it.  Every launchpad
+// created from the template is given a duplicate of it.
+zx_status_t launchpad_template_add_handle(launchpad_template_t* tmpl,
+                                          zx_handle_t h, uint32_t id);
+
+// Create a new process in job, as for launchpad_create, with the
+// template's executable, dynamic linker and vDSO already loaded and its
+// arguments, environment and handles already added.  The launchpad can
+// be set up further as usual before launchpad_go.
+// Several threads may create launchpads from the same template at once,
+// as long as none of them is changing it.
+zx_status_t launchpad_create_from_template(zx_handle_t job, const char* name,
+                                           launchpad_template_t* tmpl,
+                                           launchpad_t** result);
+
+
 // ADDING ARGUMENTS, ENVIRONMENT, AND HANDLES
 // These functions setup arguments, environment, or handles to be
 // passed to the new process via the processargs protocol.
@@ -47,7 +47,9 @@ zx_status_t loader_service_simple(loader_service_fn_t loader,
 typedef struct loader_service loader_service_t;
 
 // Create a new file-system backed loader service capable of handling
-// any number of clients.
+// any number of clients.  Requests from different clients are served
+// concurrently by a small pool of threads; each client's requests are
+// still answered in order.
 zx_status_t loader_service_create_fs(const char* name, loader_service_t** out);
 
 // Returns a new dl_set_loader_service-compatible loader service channel.
@@ -57,6 +59,7 @@ zx_status_t loader_service_connect(loader_service_t* svc, zx_handle_t* out);
 // is connected on success, closed on failure)
 zx_status_t loader_service_attach(loader_service_t* svc, zx_handle_t channel);
 
+// These may be called from several threads at once.
 typedef struct loader_service_ops {
     // attempt to load a DSO from suitable library paths
     zx_status_t (*load_object)(void* ctx, const char* name, zx_handle_t* vmo);
@@ -5,6 +5,7 @@
 #include <launchpad/launchpad.h>
 #include <launchpad/vmo.h>
 #include "elf.h"
+#include "image-cache.h"
 
 #include <zircon/assert.h>
 #include <zircon/process.h>
@@ -190,13 +191,14 @@ zx_handle_t launchpad_get_root_vmar_handle(launchpad_t* lp) {
     return lp_vmar(lp);
 }
 
-static zx_status_t build_stringtable(launchpad_t* lp,
-                                    int count, const char* const* item,
-                                    size_t* total_out, char** out) {
-    if (lp->error)
-        return lp->error;
-    if (count < 0)
-        return lp_error(lp, ZX_ERR_INVALID_ARGS, "negative string array count");
+// On failure, *errmsg says what went wrong.
+static zx_status_t make_stringtable(int count, const char* const* item,
+                                   size_t* total_out, char** out,
+                                   const char** errmsg) {
+    if (count < 0) {
+        *errmsg = "negative string array count";
+        return ZX_ERR_INVALID_ARGS;
+    }
 
     size_t total = 0;
     for (int i = 0; i < count; ++i)
@@ -205,8 +207,10 @@ static zx_status_t build_stringtable(launchpad_t* lp,
     char* buffer = NULL;
     if (total > 0) {
         buffer = malloc(total);
-        if (buffer == NULL)
-            return lp_error(lp, ZX_ERR_NO_MEMORY, "out of memory for string array");
+        if (buffer == NULL) {
+            *errmsg = "out of memory for string array";
+            return ZX_ERR_NO_MEMORY;
+        }
 
         char* p = buffer;
         for (int i = 0; i < count; ++i)
@@ -215,7 +219,8 @@ static zx_status_t build_stringtable(launchpad_t* lp,
         if ((size_t) (p - buffer) != total) {
             // The strings changed in parallel.  Not kosher!
             free(buffer);
-            return lp_error(lp, ZX_ERR_INVALID_ARGS, "string array modified during use");
+            *errmsg = "string array modified during use";
+            return ZX_ERR_INVALID_ARGS;
         }
     }
 
@@ -224,6 +229,18 @@ static zx_status_t build_stringtable(launchpad_t* lp,
     return ZX_OK;
 }
 
+static zx_status_t build_stringtable(launchpad_t* lp,
+                                    int count, const char* const* item,
+                                    size_t* total_out, char** out) {
+    if (lp->error)
+        return lp->error;
+    const char* errmsg;
+    zx_status_t status = make_stringtable(count, item, total_out, out, &errmsg);
+    if (status != ZX_OK)
+        return lp_error(lp, status, errmsg);
+    return ZX_OK;
+}
+
 zx_status_t launchpad_set_args(launchpad_t* lp,
                                int argc, const char* const* argv) {
     size_t total;
@@ -523,20 +540,16 @@ static zx_status_t reserve_low_address_space(launchpad_t* lp) {
     return ZX_OK;
 }
 
+// Map the dynamic linker |interp_vmo|, whose headers are |interp_elf|,
+// to start the process and load the executable |vmo| itself.
 // Consumes 'vmo' on success, not on failure.
-static zx_status_t handle_interp(launchpad_t* lp, zx_handle_t vmo,
-                                 const char* interp, size_t interp_len) {
+static zx_status_t load_interp(launchpad_t* lp, zx_handle_t vmo,
+                               zx_handle_t interp_vmo,
+                               elf_load_info_t* interp_elf) {
     zx_status_t status = setup_loader_svc(lp);
     if (status != ZX_OK)
         return status;
 
-    zx_handle_t interp_vmo;
-    status = loader_svc_rpc(
-        lp->special_handles[HND_LOADER_SVC], LOADER_SVC_OP_LOAD_OBJECT,
-        interp, interp_len, &interp_vmo);
-    if (status != ZX_OK)
-        return status;
-
     if (lp->fresh_process) {
         // A fresh process using PT_INTERP might be loading a libc.so that
         // supports sanitizers, so in that case (the most common case)
@@ -546,16 +559,9 @@ static zx_status_t handle_interp(launchpad_t* lp, zx_handle_t vmo,
             return status;
     }
 
-    elf_load_info_t* elf;
     zx_handle_t segments_vmar;
-    status = elf_load_start(interp_vmo, NULL, 0, &elf);
-    if (status == ZX_OK) {
-        status = elf_load_finish(lp_vmar(lp), elf, interp_vmo,
-                                 &segments_vmar, &lp->base, &lp->entry);
-        elf_load_destroy(elf);
-    }
-    zx_handle_close(interp_vmo);
-
+    status = elf_load_finish(lp_vmar(lp), interp_elf, interp_vmo,
+                             &segments_vmar, &lp->base, &lp->entry);
     if (status == ZX_OK) {
         if (lp->special_handles[HND_EXEC_VMO] != ZX_HANDLE_INVALID)
             zx_handle_close(lp->special_handles[HND_EXEC_VMO]);
@@ -569,14 +575,45 @@ static zx_status_t handle_interp(launchpad_t* lp, zx_handle_t vmo,
     return status;
 }
 
-static zx_status_t launchpad_elf_load_body(launchpad_t* lp, const char* hdr_buf,
-                                           size_t buf_sz, zx_handle_t vmo) {
+// Consumes 'vmo' on success, not on failure.
+static zx_status_t handle_interp(launchpad_t* lp, zx_handle_t vmo,
+                                 const char* interp, size_t interp_len) {
+    zx_status_t status = setup_loader_svc(lp);
+    if (status != ZX_OK)
+        return status;
+
+    zx_handle_t interp_vmo;
+    status = loader_svc_rpc(
+        lp->special_handles[HND_LOADER_SVC], LOADER_SVC_OP_LOAD_OBJECT,
+        interp, interp_len, &interp_vmo);
+    if (status != ZX_OK)
+        return status;
+
     elf_load_info_t* elf;
+    status = elf_load_start(interp_vmo, NULL, 0, &elf);
+    if (status == ZX_OK) {
+        status = load_interp(lp, vmo, interp_vmo, elf);
+        elf_load_destroy(elf);
+    }
+    zx_handle_close(interp_vmo);
+
+    return status;
+}
+
+// If |elf| is not NULL, it holds the already-parsed headers of |vmo|.
+// Always consumes |elf|.
+static zx_status_t launchpad_elf_load_body(launchpad_t* lp, const char* hdr_buf,
+                                           size_t buf_sz, zx_handle_t vmo,
+                                           elf_load_info_t* elf) {
     zx_status_t status;
 
-    if (lp->error)
+    if (lp->error) {
+        if (elf != NULL)
+            elf_load_destroy(elf);
         goto done;
-    if ((status = elf_load_start(vmo, hdr_buf, buf_sz, &elf)) != ZX_OK) {
+    }
+    if (elf == NULL &&
+        (status = elf_load_start(vmo, hdr_buf, buf_sz, &elf)) != ZX_OK) {
         lp_error(lp, status, "elf_load: elf_load_start() failed");
     } else {
         char* interp;
@@ -658,9 +695,9 @@ static zx_status_t parse_interp_spec(char *line, char **interp_start,
     return ZX_OK;
 }
 
-zx_status_t launchpad_file_load(launchpad_t* lp, zx_handle_t vmo) {
-    if (vmo == ZX_HANDLE_INVALID)
-        return lp_error(lp, ZX_ERR_INVALID_ARGS, "file_load: invalid vmo");
+// Always consumes |elf|, the cached headers of |vmo| if not NULL.
+static zx_status_t file_load_body(launchpad_t* lp, zx_handle_t vmo,
+                                  elf_load_info_t* elf) {
 
     if (lp->script_args != NULL) {
         free(lp->script_args);
@@ -685,6 +722,11 @@ zx_status_t launchpad_file_load(launchpad_t* lp, zx_handle_t vmo) {
             break;
 
         zx_handle_close(vmo);
+        if (elf != NULL) {
+            // Not reached for a cached ELF file, which can't start with #!.
+            elf_load_destroy(elf);
+            elf = NULL;
+        }
 
         if (status != ZX_OK)
             return lp_error(lp, status, "file_load: zx_vmo_read() failed");
@@ -755,7 +797,7 @@ zx_status_t launchpad_file_load(launchpad_t* lp, zx_handle_t vmo) {
     }
 
     // Finally, load the interpreter itself
-    status = launchpad_elf_load_body(lp, first_line, chars_read, vmo);
+    status = launchpad_elf_load_body(lp, first_line, chars_read, vmo, elf);
 
     if (status != ZX_OK)
         lp_error(lp, status, "file_load: failed to load ELF file");
@@ -763,11 +805,18 @@ zx_status_t launchpad_file_load(launchpad_t* lp, zx_handle_t vmo) {
     return status;
 }
 
+zx_status_t launchpad_file_load(launchpad_t* lp, zx_handle_t vmo) {
+    if (vmo == ZX_HANDLE_INVALID)
+        return lp_error(lp, ZX_ERR_INVALID_ARGS, "file_load: invalid vmo");
+
+    return file_load_body(lp, vmo, NULL);
+}
+
 zx_status_t launchpad_elf_load(launchpad_t* lp, zx_handle_t vmo) {
     if (vmo == ZX_HANDLE_INVALID)
         return lp_error(lp, ZX_ERR_INVALID_ARGS, "elf_load: invalid vmo");
 
-    return launchpad_elf_load_body(lp, NULL, 0, vmo);
+    return launchpad_elf_load_body(lp, NULL, 0, vmo, NULL);
 }
 
 static zx_handle_t vdso_vmo = ZX_HANDLE_INVALID;
@@ -1289,10 +1338,15 @@ static zx_status_t launchpad_file_load_with_vdso(launchpad_t* lp, zx_handle_t vm
 }
 
 zx_status_t launchpad_load_from_file(launchpad_t* lp, const char* path) {
+    // Repeated launches of the same binary take a clone of the cached
+    // image and its already-parsed headers rather than rereading the file.
     zx_handle_t vmo;
-    zx_status_t status = launchpad_vmo_from_file(path, &vmo);
+    elf_load_info_t* elf;
+    zx_status_t status = image_cache_load_path(path, &vmo, &elf);
     if (status == ZX_OK) {
-        return launchpad_file_load_with_vdso(lp, vmo);
+        file_load_body(lp, vmo, elf);
+        launchpad_load_vdso(lp, ZX_HANDLE_INVALID);
+        return launchpad_add_vdso_vmo(lp);
     } else {
         return status;
     }
@@ -1311,3 +1365,225 @@ zx_status_t launchpad_load_from_fd(launchpad_t* lp, int fd) {
 zx_status_t launchpad_load_from_vmo(launchpad_t* lp, zx_handle_t vmo) {
     return launchpad_file_load_with_vdso(lp, vmo);
 }
+
+struct launchpad_template {
+    zx_handle_t exec_vmo;
+    elf_load_info_t* exec_elf;
+    // ZX_HANDLE_INVALID if the executable has no PT_INTERP.
+    zx_handle_t interp_vmo;
+    elf_load_info_t* interp_elf;
+
+    uint32_t argc;
+    uint32_t envc;
+    char* args;
+    size_t args_len;
+    char* env;
+    size_t env_len;
+
+    zx_handle_t* handles;
+    uint32_t* handles_info;
+    size_t handle_count;
+};
+
+void launchpad_template_destroy(launchpad_template_t* tmpl) {
+    if (tmpl == NULL)
+        return;
+    close_handles(&tmpl->exec_vmo, 1);
+    close_handles(&tmpl->interp_vmo, 1);
+    if (tmpl->exec_elf != NULL)
+        elf_load_destroy(tmpl->exec_elf);
+    if (tmpl->interp_elf != NULL)
+        elf_load_destroy(tmpl->interp_elf);
+    close_handles(tmpl->handles, tmpl->handle_count);
+    free(tmpl->handles);
+    free(tmpl->handles_info);
+    free(tmpl->args);
+    free(tmpl->env);
+    free(tmpl);
+}
+
+// Fetch and parse the dynamic linker named by the executable's PT_INTERP.
+static zx_status_t template_load_interp(launchpad_template_t* tmpl) {
+    char* interp;
+    size_t interp_len;
+    zx_status_t status = elf_load_get_interp(tmpl->exec_elf, tmpl->exec_vmo,
+                                             &interp, &interp_len);
+    if (status != ZX_OK || interp == NULL)
+        return status;
+
+    zx_handle_t loader_svc;
+    status = loader_service_get_default(&loader_svc);
+    if (status == ZX_OK) {
+        status = loader_svc_rpc(loader_svc, LOADER_SVC_OP_LOAD_OBJECT,
+                                interp, interp_len, &tmpl->interp_vmo);
+        zx_handle_close(loader_svc);
+    }
+    free(interp);
+    if (status != ZX_OK)
+        return status;
+    return elf_load_start(tmpl->interp_vmo, NULL, 0, &tmpl->interp_elf);
+}
+
+zx_status_t launchpad_template_create(const char* path,
+                                      launchpad_template_t** result) {
+    launchpad_template_t* tmpl = calloc(1, sizeof(*tmpl));
+    if (tmpl == NULL)
+        return ZX_ERR_NO_MEMORY;
+
+    zx_status_t status = image_cache_load_path(path, &tmpl->exec_vmo,
+                                               &tmpl->exec_elf);
+    if (status == ZX_OK && tmpl->exec_elf == NULL) {
+        // Either the file could not be cached, or it is not an ELF file.
+        // Templates don't support #! scripts.
+        status = elf_load_start(tmpl->exec_vmo, NULL, 0, &tmpl->exec_elf);
+    }
+    if (status == ZX_OK)
+        status = template_load_interp(tmpl);
+    if (status != ZX_OK) {
+        launchpad_template_destroy(tmpl);
+        return status;
+    }
+
+    *result = tmpl;
+    return ZX_OK;
+}
+
+zx_status_t launchpad_template_set_args(launchpad_template_t* tmpl,
+                                        int argc, const char* const* argv) {
+    size_t total;
+    char* buffer;
+    const char* errmsg;
+    zx_status_t status = make_stringtable(argc, argv, &total, &buffer, &errmsg);
+    if (status != ZX_OK)
+        return status;
+
+    free(tmpl->args);
+    tmpl->argc = argc;
+    tmpl->args = buffer;
+    tmpl->args_len = total;
+    return ZX_OK;
+}
+
+zx_status_t launchpad_template_set_environ(launchpad_template_t* tmpl,
+                                           const char* const* envp) {
+    uint32_t count = 0;
+    if (envp != NULL) {
+        for (const char* const* ep = envp; *ep != NULL; ++ep) {
+            ++count;
+        }
+    }
+
+    size_t total;
+    char* buffer;
+    const char* errmsg;
+    zx_status_t status = make_stringtable(count, envp, &total, &buffer, &errmsg);
+    if (status != ZX_OK)
+        return status;
+
+    free(tmpl->env);
+    tmpl->envc = count;
+    tmpl->env = buffer;
+    tmpl->env_len = total;
+    return ZX_OK;
+}
+
+zx_status_t launchpad_template_add_handle(launchpad_template_t* tmpl,
+                                          zx_handle_t h, uint32_t id) {
+    if (h == ZX_HANDLE_INVALID)
+        return ZX_ERR_BAD_HANDLE;
+    if (tmpl->handle_count == ZX_CHANNEL_MAX_MSG_HANDLES) {
+        zx_handle_close(h);
+        return ZX_ERR_NO_MEMORY;
+    }
+    size_t n = tmpl->handle_count + 1;
+    zx_handle_t* handles = realloc(tmpl->handles, n * sizeof(handles[0]));
+    if (handles != NULL)
+        tmpl->handles = handles;
+    uint32_t* info = realloc(tmpl->handles_info, n * sizeof(info[0]));
+    if (info != NULL)
+        tmpl->handles_info = info;
+    if (handles == NULL || info == NULL) {
+        zx_handle_close(h);
+        return ZX_ERR_NO_MEMORY;
+    }
+    tmpl->handles[tmpl->handle_count] = h;
+    tmpl->handles_info[tmpl->handle_count] = id;
+    tmpl->handle_count = n;
+    return ZX_OK;
+}
+
+static char* dup_buffer(launchpad_t* lp, const char* buf, size_t len) {
+    if (len == 0)
+        return NULL;
+    char* copy = malloc(len);
+    if (copy == NULL) {
+        lp_error(lp, ZX_ERR_NO_MEMORY, "template: out of memory for string array");
+        return NULL;
+    }
+    return memcpy(copy, buf, len);
+}
+
+// Load copy-on-write clones of the template's images into the process.
+static zx_status_t template_load(launchpad_t* lp, launchpad_template_t* tmpl) {
+    uint64_t size;
+    zx_handle_t vmo;
+    zx_status_t status = zx_vmo_get_size(tmpl->exec_vmo, &size);
+    if (status == ZX_OK)
+        status = zx_vmo_clone(tmpl->exec_vmo, ZX_VMO_CLONE_COPY_ON_WRITE,
+                              0, size, &vmo);
+    if (status != ZX_OK)
+        return lp_error(lp, status, "template: cannot clone executable");
+
+    if (tmpl->interp_vmo == ZX_HANDLE_INVALID) {
+        elf_load_info_t* elf = elf_load_dup(tmpl->exec_elf);
+        if (elf == NULL) {
+            zx_handle_close(vmo);
+            return lp_error(lp, ZX_ERR_NO_MEMORY, "template: out of memory");
+        }
+        return launchpad_elf_load_body(lp, NULL, 0, vmo, elf);
+    }
+
+    // The dynamic linker's headers are only read, so every launch can
+    // share them, and mapping its segments never modifies its VMO.
+    status = load_interp(lp, vmo, tmpl->interp_vmo, tmpl->interp_elf);
+    if (status != ZX_OK) {
+        zx_handle_close(vmo);
+        return lp_error(lp, status, "template: load_interp failed");
+    }
+    return ZX_OK;
+}
+
+zx_status_t launchpad_create_from_template(zx_handle_t job, const char* name,
+                                           launchpad_template_t* tmpl,
+                                           launchpad_t** result) {
+    launchpad_t* lp;
+    launchpad_create(job, name, &lp);
+
+    if (lp->error == ZX_OK) {
+        lp->argc = tmpl->argc;
+        lp->args = dup_buffer(lp, tmpl->args, tmpl->args_len);
+        lp->args_len = lp->args == NULL ? 0 : tmpl->args_len;
+        lp->envc = tmpl->envc;
+        lp->env = dup_buffer(lp, tmpl->env, tmpl->env_len);
+        lp->env_len = lp->env == NULL ? 0 : tmpl->env_len;
+    }
+
+    for (size_t i = 0; i < tmpl->handle_count && lp->error == ZX_OK; ++i) {
+        zx_handle_t h;
+        zx_status_t status = zx_handle_duplicate(tmpl->handles[i],
+                                                 ZX_RIGHT_SAME_RIGHTS, &h);
+        if (status != ZX_OK) {
+            lp_error(lp, status, "template: cannot duplicate handle");
+            break;
+        }
+        launchpad_add_handle(lp, h, tmpl->handles_info[i]);
+    }
+
+    if (lp->error == ZX_OK)
+        template_load(lp, tmpl);
+    launchpad_load_vdso(lp, ZX_HANDLE_INVALID);
+    launchpad_add_vdso_vmo(lp);
+
+    *result = lp;
+    return lp->error;
+}
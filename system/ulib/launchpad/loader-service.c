@@ -4,9 +4,13 @@
 
 #include <launchpad/loader-service.h>
 
+#include "image-cache.h"
+
+#include <async/loop.h>
+#include <async/wait.h>
 #include <fdio/debug.h>
-#include <fdio/dispatcher.h>
 #include <fdio/io.h>
+#include <trace/event.h>
 
 #include <errno.h>
 #include <fcntl.h>
@@ -50,19 +54,31 @@ static void __PRINTFLIKE(2, 3) log_printf(zx_handle_t log,
 
 #define PREFIX_MAX 32
 
+// Requests from different clients are served by this many threads at once.
+// Each request is mostly waiting on a filesystem, so a few threads are
+// enough to keep a burst of process launches from queueing up.
+#define LOADER_SERVICE_THREADS 4
+
 struct loader_service {
     char name[ZX_MAX_NAME_LEN];
-    mtx_t dispatcher_lock;
-    fdio_dispatcher_t* dispatcher;
-    zx_handle_t dispatcher_log;
+    mtx_t async_lock;
+    async_t* async __TA_GUARDED(async_lock);
+    zx_handle_t async_log;
 
     const loader_service_ops_t* ops;
     void* ctx;
 
-    char config_prefix[PREFIX_MAX];
-    bool config_exclusive;
+    mtx_t config_lock;
+    char config_prefix[PREFIX_MAX] __TA_GUARDED(config_lock);
+    bool config_exclusive __TA_GUARDED(config_lock);
 };
 
+// One client channel of a multi-client loader service.
+typedef struct loader_conn {
+    async_wait_t wait;
+    loader_service_t* svc;
+} loader_conn_t;
+
 static const char* const libpaths[] = {
     "/system/lib",
     "/boot/lib",
@@ -134,19 +150,21 @@ zx_status_t loader_service_publish_data_sink_fs(const char* sink_name, zx_handle
 
 
 // When loading a library object, search in the hard-coded locations.
-static int open_from_libpath(const char* fn) {
+// On success, |path| holds the path that was opened.
+static int open_from_libpath(const char* fn, char path[PATH_MAX]) {
     int fd = -1;
     for (size_t n = 0; fd < 0 && n < countof(libpaths); ++n) {
-        char path[PATH_MAX];
-        snprintf(path, sizeof(path), "%s/%s", libpaths[n], fn);
+        snprintf(path, PATH_MAX, "%s/%s", libpaths[n], fn);
         fd = open(path, O_RDONLY);
     }
     return fd;
 }
 
-// Always consumes the fd.
-static zx_handle_t load_object_fd(int fd, const char* fn, zx_handle_t* out) {
-    zx_status_t status = fdio_get_vmo(fd, out);
+// Always consumes the fd.  Libraries are served out of launchpad's image
+// cache, so every process after the first gets a copy-on-write clone.
+static zx_handle_t load_object_fd(int fd, const char* path, const char* fn,
+                                  zx_handle_t* out) {
+    zx_status_t status = image_cache_get_vmo(fd, path, out, NULL);
     close(fd);
     if (status == ZX_OK)
         zx_object_set_property(*out, ZX_PROP_NAME, fn, strlen(fn));
@@ -154,16 +172,17 @@ static zx_handle_t load_object_fd(int fd, const char* fn, zx_handle_t* out) {
 }
 
 static zx_status_t fs_load_object(void *ctx, const char* name, zx_handle_t* out) {
-    int fd = open_from_libpath(name);
+    char path[PATH_MAX];
+    int fd = open_from_libpath(name, path);
     if (fd >= 0)
-        return load_object_fd(fd, name, out);
+        return load_object_fd(fd, path, name, out);
     return ZX_ERR_NOT_FOUND;
 }
 
 static zx_status_t fs_load_abspath(void *ctx, const char* path, zx_handle_t* out) {
     int fd = open(path, O_RDONLY);
     if (fd >= 0)
-        return load_object_fd(fd, path, out);
+        return load_object_fd(fd, path, path, out);
     return ZX_ERR_NOT_FOUND;
 }
 
@@ -193,6 +212,7 @@ static zx_status_t default_load_fn(void* cookie, uint32_t load_op,
             status = ZX_ERR_INVALID_ARGS;
             break;
         }
+        mtx_lock(&svc->config_lock);
         strncpy(svc->config_prefix, fn, len + 1);
         svc->config_exclusive = false;
         if (svc->config_prefix[len - 1] == '!') {
@@ -201,17 +221,26 @@ static zx_status_t default_load_fn(void* cookie, uint32_t load_op,
         }
         svc->config_prefix[len] = '/';
         svc->config_prefix[len + 1] = '\0';
+        mtx_unlock(&svc->config_lock);
         status = ZX_OK;
         break;
     }
-    case LOADER_SVC_OP_LOAD_OBJECT:
+    case LOADER_SVC_OP_LOAD_OBJECT: {
+        // Take a snapshot of the configuration, since other clients'
+        // requests may be running on other threads.
+        char prefix[PREFIX_MAX];
+        mtx_lock(&svc->config_lock);
+        memcpy(prefix, svc->config_prefix, sizeof(prefix));
+        bool exclusive = svc->config_exclusive;
+        mtx_unlock(&svc->config_lock);
+
         // If a prefix is configured, try loading with that prefix first
-        if (svc->config_prefix[0] != '\0') {
+        if (prefix[0] != '\0') {
             size_t maxlen = PREFIX_MAX + strlen(fn) + 1;
             char pfn[maxlen];
-            snprintf(pfn, maxlen, "%s%s", svc->config_prefix, fn);
+            snprintf(pfn, maxlen, "%s%s", prefix, fn);
             if (((status = svc->ops->load_object(svc->ctx, pfn, out)) == ZX_OK) ||
-                svc->config_exclusive) {
+                exclusive) {
                 // if loading with prefix succeeds, or loading
                 // with prefix is configured to be exclusive of
                 // non-prefix loading, stop here
@@ -221,6 +250,7 @@ static zx_status_t default_load_fn(void* cookie, uint32_t load_op,
         }
         status = svc->ops->load_object(svc->ctx, fn, out);
         break;
+    }
     case LOADER_SVC_OP_LOAD_SCRIPT_INTERP:
     case LOADER_SVC_OP_LOAD_DEBUG_CONFIG:
         // When loading a script interpreter or debug configuration file,
@@ -297,9 +327,11 @@ static zx_status_t handle_loader_rpc(zx_handle_t h,
     case LOADER_SVC_OP_LOAD_SCRIPT_INTERP:
     case LOADER_SVC_OP_LOAD_DEBUG_CONFIG:
     case LOADER_SVC_OP_PUBLISH_DATA_SINK:
-    case LOADER_SVC_OP_CLONE:
-        // TODO(ZX-491): Use a threadpool for loading, and guard against
-        // other starvation attacks.
+    case LOADER_SVC_OP_CLONE: {
+        // TODO(ZX-491): Guard against other starvation attacks.
+        TRACE_DURATION("launchpad", "loader_service_request",
+                       "opcode", TA_UINT32(msg->opcode),
+                       "name", TA_STRING((const char*) msg->data));
         r = (*loader)(loader_arg, msg->opcode,
                       request_handle, (const char*) msg->data, &handle);
         if (r == ZX_ERR_NOT_FOUND) {
@@ -309,6 +341,7 @@ static zx_status_t handle_loader_rpc(zx_handle_t h,
         request_handle = ZX_HANDLE_INVALID;
         msg->arg = r;
         break;
+    }
     case LOADER_SVC_OP_DEBUG_PRINT:
         log_printf(sys_log, "dlsvc: debug: %s\n", (const char*) msg->data);
         msg->arg = ZX_OK;
@@ -392,46 +425,74 @@ zx_status_t loader_service_create_fs(const char* name,
     return loader_service_create(name, &fs_ops, NULL, out);
 }
 
-static zx_status_t multiloader_cb(zx_handle_t h, void* cb, void* cookie) {
-    if (h == 0) {
-        // close notification, which we can ignore
-        return 0;
+static async_wait_result_t multiloader_cb(async_t* async, async_wait_t* wait,
+                                          zx_status_t status,
+                                          const zx_packet_signal_t* signal) {
+    loader_conn_t* conn = (loader_conn_t*)wait;
+    // This uses svc->async_log without grabbing the lock, but
+    // it will never change once the loop that called us is created.
+    loader_service_t* svc = conn->svc;
+
+    // A client's requests are handled one at a time, in order, because
+    // the wait is not re-armed until this one has been answered.  Other
+    // clients' requests run concurrently on the loop's other threads.
+    if (status == ZX_OK && (signal->observed & ZX_CHANNEL_READABLE) &&
+        handle_loader_rpc(wait->object, default_load_fn, svc,
+                          svc->async_log) == ZX_OK) {
+        return ASYNC_WAIT_AGAIN;
     }
-    // This uses svc->dispatcher_log without grabbing the lock, but
-    // it will never change once the dispatcher that called us is created.
-    loader_service_t* svc = cookie;
-    return handle_loader_rpc(h, default_load_fn, svc, svc->dispatcher_log);
+
+    zx_handle_close(wait->object);
+    free(conn);
+    return ASYNC_WAIT_FINISHED;
 }
 
 zx_status_t loader_service_attach(loader_service_t* svc, zx_handle_t h) {
     if (svc == NULL) {
+        zx_handle_close(h);
         return ZX_ERR_INVALID_ARGS;
     }
 
-    mtx_lock(&svc->dispatcher_lock);
-    zx_status_t r;
-    if (svc->dispatcher == NULL) {
-        if ((r = fdio_dispatcher_create(&svc->dispatcher,
-                                        multiloader_cb)) < 0) {
+    mtx_lock(&svc->async_lock);
+    zx_status_t r = ZX_OK;
+    if (svc->async == NULL) {
+        async_t* async;
+        if ((r = async_loop_create(NULL, &async)) < 0) {
             goto done;
         }
-        if ((r = fdio_dispatcher_start(svc->dispatcher, svc->name)) < 0) {
-            //TODO: destroy dispatcher once support exists
-            svc->dispatcher = NULL;
+        for (int i = 0; i < LOADER_SERVICE_THREADS; i++) {
+            if ((r = async_loop_start_thread(async, svc->name, NULL)) < 0) {
+                break;
+            }
+        }
+        if (r != ZX_OK) {
+            async_loop_destroy(async);
             goto done;
         }
-        if (zx_log_create(0, &svc->dispatcher_log) < 0) {
+        svc->async = async;
+        if (zx_log_create(0, &svc->async_log) < 0) {
             // unlikely to fail, but we'll keep going without it if so
-            svc->dispatcher_log = ZX_HANDLE_INVALID;
+            svc->async_log = ZX_HANDLE_INVALID;
         }
     }
 
-    r = fdio_dispatcher_add(svc->dispatcher, h, NULL, svc);
+    loader_conn_t* conn = calloc(1, sizeof(*conn));
+    if (conn == NULL) {
+        r = ZX_ERR_NO_MEMORY;
+        goto done;
+    }
+    conn->wait.handler = multiloader_cb;
+    conn->wait.object = h;
+    conn->wait.trigger = ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED;
+    conn->svc = svc;
+    if ((r = async_begin_wait(svc->async, &conn->wait)) != ZX_OK) {
+        free(conn);
+    }
 
 done:
-    mtx_unlock(&svc->dispatcher_lock);
+    mtx_unlock(&svc->async_lock);
     if (r != ZX_OK) {
-        zx_handle_close(r);
+        zx_handle_close(h);
     }
     return r;
 }
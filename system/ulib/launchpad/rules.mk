@@ -10,6 +10,7 @@ MODULE_TYPE := userlib
 
 MODULE_SRCS += \
     $(LOCAL_DIR)/elf.c \
+    $(LOCAL_DIR)/image-cache.c \
     $(LOCAL_DIR)/launchpad.c \
     $(LOCAL_DIR)/loader-service.c \
     $(LOCAL_DIR)/fdio.c \
@@ -18,7 +19,19 @@ MODULE_SRCS += \
 MODULE_EXPORT := so
 
 MODULE_SO_NAME := launchpad
-MODULE_STATIC_LIBS := system/ulib/elfload
-MODULE_LIBS := system/ulib/fdio system/ulib/zircon system/ulib/c
+MODULE_STATIC_LIBS := \
+    system/ulib/elfload \
+    system/ulib/async \
+    system/ulib/async.loop \
+    system/ulib/trace \
+    system/ulib/zx \
+    system/ulib/fbl \
+    system/ulib/zxcpp
+MODULE_LIBS := \
+    system/ulib/async.default \
+    system/ulib/trace-engine \
+    system/ulib/fdio \
+    system/ulib/zircon \
+    system/ulib/c
 
 include make/module.mk
@@ -11,10 +11,21 @@
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_ptr.h>
 #include <memfs/vnode.h>
+#include <zircon/misc/fnv1hash.h>
 
 #include "dnode.h"
 
 namespace memfs {
+namespace {
+
+// Directories with fewer children than this are searched linearly.
+constexpr size_t kMinIndexedChildren = 16;
+
+uint32_t HashName(fbl::StringPiece name) {
+    return fnv1a32(name.data(), name.length());
+}
+
+} // namespace
 
 // Create a new dnode and attach it to a vnode
 fbl::RefPtr<Dnode> Dnode::Create(fbl::StringPiece name, fbl::RefPtr<VnodeMemfs> vn) {
@@ -43,6 +54,7 @@ void Dnode::RemoveFromParent() {
 
     // Detach from parent
     if (parent_) {
+        parent_->UnindexChild(this);
         parent_->children_.erase(*this);
         if (IsDirectory()) {
             // '..' no longer references parent.
@@ -85,11 +97,70 @@ void Dnode::AddChild(fbl::RefPtr<Dnode> parent, fbl::RefPtr<Dnode> child) {
     } else {
         child->ordering_token_ = parent->children_.back().ordering_token_ + 1;
     }
+    Dnode* dn = child.get();
     parent->children_.push_back(fbl::move(child));
+    parent->IndexChild(dn);
     parent->vnode_->UpdateModified();
 }
 
+void Dnode::IndexChild(Dnode* child) {
+    child_count_++;
+    if (child_count_ >= kMinIndexedChildren && child_count_ > child_buckets_.size()) {
+        size_t buckets = child_buckets_.size() ? child_buckets_.size() * 2 : kMinIndexedChildren;
+        if (RebuildIndex(buckets)) {
+            return;
+        }
+    }
+    if (child_buckets_.size()) {
+        Dnode** bucket = &child_buckets_[child->name_hash_ & (child_buckets_.size() - 1)];
+        child->hash_next_ = *bucket;
+        *bucket = child;
+    }
+}
+
+void Dnode::UnindexChild(Dnode* child) {
+    child_count_--;
+    if (child_buckets_.size()) {
+        Dnode** link = &child_buckets_[child->name_hash_ & (child_buckets_.size() - 1)];
+        while (*link != child) {
+            ZX_DEBUG_ASSERT(*link != nullptr);
+            link = &(*link)->hash_next_;
+        }
+        *link = child->hash_next_;
+        child->hash_next_ = nullptr;
+    }
+}
+
+bool Dnode::RebuildIndex(size_t buckets) {
+    fbl::AllocChecker ac;
+    fbl::Array<Dnode*> table(new (&ac) Dnode*[buckets](), buckets);
+    if (!ac.check()) {
+        return false;
+    }
+    for (auto& dn : children_) {
+        Dnode** bucket = &table[dn.name_hash_ & (buckets - 1)];
+        dn.hash_next_ = *bucket;
+        *bucket = &dn;
+    }
+    child_buckets_ = fbl::move(table);
+    return true;
+}
+
 zx_status_t Dnode::Lookup(fbl::StringPiece name, fbl::RefPtr<Dnode>* out) const {
+    if (child_buckets_.size()) {
+        uint32_t hash = HashName(name);
+        for (Dnode* dn = child_buckets_[hash & (child_buckets_.size() - 1)]; dn != nullptr;
+             dn = dn->hash_next_) {
+            if (dn->name_hash_ == hash && dn->NameMatch(name)) {
+                if (out != nullptr) {
+                    *out = fbl::RefPtr<Dnode>(dn);
+                }
+                return ZX_OK;
+            }
+        }
+        return ZX_ERR_NOT_FOUND;
+    }
+
     auto dn = children_.find_if([&name](const Dnode& elem) -> bool {
         return elem.NameMatch(name);
     });
@@ -184,12 +255,15 @@ fbl::unique_ptr<char[]> Dnode::TakeName() {
 void Dnode::PutName(fbl::unique_ptr<char[]> name, size_t len) {
     flags_ = static_cast<uint32_t>((flags_ & ~kDnodeNameMax) | len);
     name_ = fbl::move(name);
+    name_hash_ = HashName(fbl::StringPiece(name_.get(), len));
 }
 
 bool Dnode::IsDirectory() const { return vnode_->IsDirectory(); }
 
 Dnode::Dnode(fbl::RefPtr<VnodeMemfs> vn, fbl::unique_ptr<char[]> name, uint32_t flags) :
-    vnode_(fbl::move(vn)), parent_(nullptr), ordering_token_(0), flags_(flags), name_(fbl::move(name)) {
+    vnode_(fbl::move(vn)), parent_(nullptr), ordering_token_(0), child_count_(0),
+    hash_next_(nullptr), name_hash_(HashName(fbl::StringPiece(name.get(), flags & kDnodeNameMax))),
+    flags_(flags), name_(fbl::move(name)) {
 };
 
 size_t Dnode::NameLen() const {
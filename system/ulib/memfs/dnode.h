@@ -10,6 +10,7 @@
 #include <fs/vfs.h>
 #include <fs/vnode.h>
 #include <fdio/vfs.h>
+#include <fbl/array.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/ref_counted.h>
 #include <fbl/ref_ptr.h>
@@ -103,6 +104,13 @@ private:
     size_t NameLen() const;
     bool NameMatch(fbl::StringPiece name) const;
 
+    // Maintain the name index of |children_|. The index is only built once
+    // a directory has enough children for scanning the list to be slow, and
+    // it is left as it is if growing it runs out of memory.
+    void IndexChild(Dnode* child);
+    void UnindexChild(Dnode* child);
+    bool RebuildIndex(size_t buckets);
+
     NodeState type_child_state_;
     NodeState type_device_state_;
     fbl::RefPtr<VnodeMemfs> vnode_;
@@ -110,6 +118,12 @@ private:
     // Used to impose an absolute order on dnodes within a directory.
     size_t ordering_token_;
     ChildList children_;
+    // Chains of children hashed by name, linked through |hash_next_|. The
+    // number of buckets is a power of two.
+    fbl::Array<Dnode*> child_buckets_;
+    size_t child_count_;
+    Dnode* hash_next_;
+    uint32_t name_hash_;
     uint32_t flags_;
     fbl::unique_ptr<char[]> name_;
 };
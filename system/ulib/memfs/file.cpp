@@ -81,6 +81,7 @@ zx_status_t VnodeFile::Write(const void* data, size_t len, size_t offset,
 
     if (newlen > length_) {
         length_ = newlen;
+        LengthChanged();
     }
     if (*out_actual == 0 && offset >= kMemfsMaxFileSize) {
         // short write because we're beyond the end of the permissible length
@@ -117,6 +118,38 @@ zx_status_t VnodeFile::Mmap(int flags, size_t len, size_t* off, zx_handle_t* out
     return zx_handle_duplicate(vmo_, rights, out);
 }
 
+zx_status_t VnodeFile::ShareVmo(zx_handle_t* out_vmo, zx_handle_t* out_token,
+                                size_t* out_length) {
+    zx_status_t status;
+    if (vmo_ == ZX_HANDLE_INVALID) {
+        // First access to the file? Allocate it.
+        if ((status = zx_vmo_create(0, 0, &vmo_)) != ZX_OK) {
+            return status;
+        }
+    }
+    if (!length_token_ && (status = zx::event::create(0, &length_token_)) != ZX_OK) {
+        return status;
+    }
+
+    zx::event token;
+    if ((status = length_token_.duplicate(ZX_RIGHT_TRANSFER | ZX_RIGHT_READ, &token)) != ZX_OK) {
+        return status;
+    }
+    if ((status = zx_handle_duplicate(vmo_, ZX_RIGHT_TRANSFER | ZX_RIGHT_READ, out_vmo)) != ZX_OK) {
+        return status;
+    }
+    *out_token = token.release();
+    *out_length = length_;
+    return ZX_OK;
+}
+
+void VnodeFile::LengthChanged() {
+    if (length_token_) {
+        length_token_.signal(0, ZX_USER_SIGNAL_0);
+        length_token_.reset();
+    }
+}
+
 zx_status_t VnodeFile::Getattr(vnattr_t* attr) {
     memset(attr, 0, sizeof(vnattr_t));
     attr->inode = ino_;
@@ -163,7 +196,10 @@ zx_status_t VnodeFile::Truncate(size_t len) {
         return status;
     }
 
-    length_ = len;
+    if (len != length_) {
+        length_ = len;
+        LengthChanged();
+    }
     modify_time_ = zx_time_get(ZX_CLOCK_UTC);
     return ZX_OK;
 }
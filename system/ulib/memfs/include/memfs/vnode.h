@@ -23,6 +23,7 @@
 #include <fbl/unique_ptr.h>
 #include <fs/remote.h>
 #include <fs/watcher.h>
+#include <zx/event.h>
 
 namespace memfs {
 
@@ -35,6 +36,7 @@ class VnodeMemfs : public fs::Vnode {
 public:
     virtual zx_status_t Setattr(const vnattr_t* a) final;
     virtual zx_status_t Sync() final;
+    bool CanDispatchConcurrently(uint32_t op) final;
     zx_status_t Ioctl(uint32_t op, const void* in_buf, size_t in_len,
                       void* out_buf, size_t out_len, size_t* out_actual) override;
     zx_status_t AttachRemote(fs::MountChannel h) final;
@@ -80,9 +82,16 @@ private:
     zx_status_t Truncate(size_t len) final;
     zx_status_t Getattr(vnattr_t* a) final;
     zx_status_t Mmap(int flags, size_t len, size_t* off, zx_handle_t* out) final;
+    zx_status_t ShareVmo(zx_handle_t* out_vmo, zx_handle_t* out_token,
+                         size_t* out_length) final;
+
+    // Tells clients reading from the shared VMO that |length_| changed.
+    void LengthChanged();
 
     zx_handle_t vmo_;
     zx_off_t length_;
+    // Event handed out by |ShareVmo()| for the current length, if any.
+    zx::event length_token_;
 };
 
 class VnodeDir final : public VnodeMemfs {
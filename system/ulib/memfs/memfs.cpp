@@ -58,6 +58,22 @@ zx_status_t VnodeMemfs::Setattr(const vnattr_t* attr) {
     return ZX_OK;
 }
 
+bool VnodeMemfs::CanDispatchConcurrently(uint32_t op) {
+    // Reads only touch the VMO, and attributes only change while nothing
+    // else is being handled.
+    switch (op) {
+    case ZXRIO_READ:
+    case ZXRIO_READ_AT:
+    case ZXRIO_READ_VMO:
+    case ZXRIO_READ_AT_VMO:
+    case ZXRIO_STAT:
+    case ZXRIO_SEEK:
+        return true;
+    default:
+        return false;
+    }
+}
+
 zx_status_t VnodeMemfs::Sync() {
     // Since this filesystem is in-memory, all data is already up-to-date in
     // the underlying storage
@@ -8,6 +8,7 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_ptr.h>
@@ -19,7 +20,7 @@
 
 namespace minfs {
 
-zx_status_t Bcache::Readblk(blk_t bno, void* data) {
+zx_status_t Bcache::ReadRaw(blk_t bno, blk_t count, void* data, blk_t* actual) {
     off_t off = static_cast<off_t>(bno) * kMinfsBlockSize;
     assert(off / kMinfsBlockSize == bno); // Overflow
 #ifndef __Fuchsia__
@@ -29,14 +30,18 @@ zx_status_t Bcache::Readblk(blk_t bno, void* data) {
         FS_TRACE_ERROR("minfs: cannot seek to block %u\n", bno);
         return ZX_ERR_IO;
     }
-    if (read(fd_.get(), data, kMinfsBlockSize) != kMinfsBlockSize) {
+    // Readahead may run off the end of the device; that's fine as long as
+    // the block which was asked for made it.
+    ssize_t r = read(fd_.get(), data, count * kMinfsBlockSize);
+    if (r < static_cast<ssize_t>(kMinfsBlockSize)) {
         FS_TRACE_ERROR("minfs: cannot read block %u\n", bno);
         return ZX_ERR_IO;
     }
+    *actual = static_cast<blk_t>(r / kMinfsBlockSize);
     return ZX_OK;
 }
 
-zx_status_t Bcache::Writeblk(blk_t bno, const void* data) {
+zx_status_t Bcache::WriteRaw(blk_t bno, const void* data) {
     off_t off = static_cast<off_t>(bno) * kMinfsBlockSize;
     assert(off / kMinfsBlockSize == bno); // Overflow
 #ifndef __Fuchsia__
@@ -53,6 +58,173 @@ zx_status_t Bcache::Writeblk(blk_t bno, const void* data) {
     return ZX_OK;
 }
 
+zx_status_t Bcache::Readblk(blk_t bno, void* data) {
+    blk_t count = 1;
+    uint64_t generation;
+    {
+        fbl::AutoLock lock(&cache_lock_);
+        CacheBlock* block = CacheFindLocked(bno);
+        if (block != nullptr) {
+            cache_lru_.erase(*block);
+            cache_lru_.push_front(block);
+            memcpy(data, block->data, kMinfsBlockSize);
+            cache_info_.hits++;
+            return ZX_OK;
+        }
+        cache_info_.misses++;
+        if (bno == last_miss_ + 1 && bno < blockmax_) {
+            count = fbl::min(kCacheReadahead, blockmax_ - bno);
+        }
+        generation = cache_generation_;
+    }
+
+    fbl::unique_ptr<uint8_t[]> buf;
+    if (count > 1) {
+        fbl::AllocChecker ac;
+        buf.reset(new (&ac) uint8_t[count * kMinfsBlockSize]);
+        if (!ac.check()) {
+            count = 1;
+        }
+    }
+
+    zx_status_t status;
+    blk_t actual;
+    void* dst = count > 1 ? buf.get() : data;
+    if ((status = ReadRaw(bno, count, dst, &actual)) != ZX_OK) {
+        return status;
+    }
+    if (dst != data) {
+        memcpy(data, dst, kMinfsBlockSize);
+    }
+
+    fbl::AutoLock lock(&cache_lock_);
+    last_miss_ = bno + actual - 1;
+    cache_info_.readahead += actual - 1;
+    if (generation == cache_generation_) {
+        for (blk_t n = 0; n < actual; n++) {
+            CacheInsertLocked(bno + n, static_cast<uint8_t*>(dst) + n * kMinfsBlockSize);
+        }
+    }
+    return ZX_OK;
+}
+
+zx_status_t Bcache::Writeblk(blk_t bno, const void* data) {
+    zx_status_t status = WriteRaw(bno, data);
+
+    fbl::AutoLock lock(&cache_lock_);
+    cache_generation_++;
+    if (status != ZX_OK) {
+        CacheInvalidateLocked(bno, 1);
+        return status;
+    }
+    CacheInsertLocked(bno, data);
+    return ZX_OK;
+}
+
+void Bcache::GetCacheInfo(vfs_cache_info_t* info) {
+    fbl::AutoLock lock(&cache_lock_);
+    *info = cache_info_;
+    info->capacity = kCacheBlocks;
+    info->block_size = kMinfsBlockSize;
+}
+
+zx_status_t Bcache::InitCache() {
+    static_assert((kCacheBlocks & (kCacheBlocks - 1)) == 0, "Cache size must be a power of two");
+    fbl::AllocChecker ac;
+    cache_data_.reset(new (&ac) uint8_t[kCacheBlocks * kMinfsBlockSize],
+                      kCacheBlocks * kMinfsBlockSize);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    cache_blocks_.reset(new (&ac) CacheBlock[kCacheBlocks], kCacheBlocks);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    cache_buckets_.reset(new (&ac) CacheBlock*[kCacheBlocks], kCacheBlocks);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    for (uint32_t i = 0; i < kCacheBlocks; i++) {
+        cache_buckets_[i] = nullptr;
+        cache_blocks_[i].bno = 0;
+        cache_blocks_[i].valid = false;
+        cache_blocks_[i].hash_next = nullptr;
+        cache_blocks_[i].data = &cache_data_[i * kMinfsBlockSize];
+        cache_lru_.push_back(&cache_blocks_[i]);
+    }
+    return ZX_OK;
+}
+
+Bcache::CacheBlock* Bcache::CacheFindLocked(blk_t bno) const {
+    for (CacheBlock* b = cache_buckets_[bno & (kCacheBlocks - 1)]; b != nullptr;
+         b = b->hash_next) {
+        if (b->bno == bno) {
+            return b;
+        }
+    }
+    return nullptr;
+}
+
+void Bcache::CacheInsertLocked(blk_t bno, const void* data) {
+    CacheBlock* block = CacheFindLocked(bno);
+    if (block != nullptr) {
+        cache_lru_.erase(*block);
+    } else {
+        // Invalid blocks are kept at the back, so they are used up before
+        // anything is evicted.
+        block = cache_lru_.pop_back();
+        if (block->valid) {
+            CacheRemoveLocked(block);
+            cache_info_.evictions++;
+        }
+        block->bno = bno;
+        block->valid = true;
+        CacheBlock** bucket = &cache_buckets_[bno & (kCacheBlocks - 1)];
+        block->hash_next = *bucket;
+        *bucket = block;
+    }
+    memcpy(block->data, data, kMinfsBlockSize);
+    cache_lru_.push_front(block);
+}
+
+void Bcache::CacheRemoveLocked(CacheBlock* block) {
+    CacheBlock** b = &cache_buckets_[block->bno & (kCacheBlocks - 1)];
+    while (*b != block) {
+        b = &(*b)->hash_next;
+    }
+    *b = block->hash_next;
+    block->hash_next = nullptr;
+    block->valid = false;
+}
+
+void Bcache::CacheDropLocked(CacheBlock* block) {
+    CacheRemoveLocked(block);
+    cache_lru_.erase(*block);
+    cache_lru_.push_back(block);
+    cache_info_.invalidations++;
+}
+
+void Bcache::CacheInvalidateLocked(blk_t bno, blk_t count) {
+    cache_generation_++;
+    if (count > kCacheBlocks) {
+        // Cheaper to look at everything in the cache than every block in
+        // the range.
+        for (uint32_t i = 0; i < kCacheBlocks; i++) {
+            CacheBlock* block = &cache_blocks_[i];
+            if (block->valid && block->bno >= bno && block->bno - bno < count) {
+                CacheDropLocked(block);
+            }
+        }
+        return;
+    }
+    for (blk_t n = 0; n < count; n++) {
+        CacheBlock* block = CacheFindLocked(bno + n);
+        if (block != nullptr) {
+            CacheDropLocked(block);
+        }
+    }
+}
+
 int Bcache::Sync() {
     return fsync(fd_.get());
 }
@@ -63,8 +235,11 @@ zx_status_t Bcache::Create(fbl::unique_ptr<Bcache>* out, fbl::unique_fd fd, uint
     if (!ac.check()) {
         return ZX_ERR_NO_MEMORY;
     }
-#ifdef __Fuchsia__
     zx_status_t status;
+    if ((status = bc->InitCache()) != ZX_OK) {
+        return status;
+    }
+#ifdef __Fuchsia__
     zx_handle_t fifo;
     ssize_t r;
 
@@ -78,6 +253,11 @@ zx_status_t Bcache::Create(fbl::unique_ptr<Bcache>* out, fbl::unique_fd fd, uint
         zx_handle_close(fifo);
         return status;
     }
+
+    block_info_t info;
+    if (ioctl_block_get_info(bc->fd_.get(), &info) >= 0) {
+        bc->trim_supported_ = (info.flags & BLOCK_FLAG_TRIM_SUPPORT) != 0;
+    }
 #endif
 
     *out = fbl::move(bc);
@@ -85,6 +265,23 @@ zx_status_t Bcache::Create(fbl::unique_ptr<Bcache>* out, fbl::unique_fd fd, uint
 }
 
 #ifdef __Fuchsia__
+zx_status_t Bcache::Txn(block_fifo_request_t* requests, size_t count) {
+    zx_status_t status = block_fifo_txn(fifo_client_, requests, count);
+
+    // Drop overwritten or trimmed blocks once the requests have landed; a
+    // Readblk which raced with them sees the generation change and won't
+    // cache what it read.
+    fbl::AutoLock lock(&cache_lock_);
+    for (size_t i = 0; i < count; i++) {
+        uint32_t op = requests[i].opcode & BLOCKIO_OP_MASK;
+        if (op == BLOCKIO_WRITE || op == BLOCKIO_TRIM) {
+            CacheInvalidateLocked(static_cast<blk_t>(requests[i].dev_offset / kMinfsBlockSize),
+                                  static_cast<blk_t>(requests[i].length / kMinfsBlockSize));
+        }
+    }
+    return status;
+}
+
 ssize_t Bcache::GetDevicePath(char* out, size_t out_len) {
     return ioctl_device_get_topo_path(fd_.get(), out, out_len);
 }
@@ -50,6 +50,7 @@ private:
                                ino_t parent, uint32_t flags);
     const char* CheckDataBlock(blk_t bno);
     zx_status_t CheckFile(minfs_inode_t* inode, ino_t ino);
+    zx_status_t CheckInlineFile(minfs_inode_t* inode, ino_t ino);
 
     fbl::RefPtr<Minfs> fs_;
     RawBitmap checked_inodes_;
@@ -187,6 +188,9 @@ zx_status_t MinfsChecker::CheckDirectory(minfs_inode_t* inode, ino_t ino,
     bool dot = false;
     bool dotdot = false;
     uint32_t dirent_count = 0;
+    // Lookups through the directory index stop at the first match, so names
+    // must be unique.
+    DirectoryIndex names;
 
     zx_status_t status;
     fbl::RefPtr<VnodeMinfs> vn;
@@ -257,6 +261,23 @@ zx_status_t MinfsChecker::CheckDirectory(minfs_inode_t* inode, ino_t ino,
                     FS_TRACE_ERROR("check: ino#%u: de[%u]: '..' ino=%u (not parent!)\n", ino, eno, de->ino);
                 }
             }
+            fbl::StringPiece name(de->name, de->namelen);
+            uint32_t hash = DirectoryIndex::Hash(name);
+            for (uint32_t i = names.First(hash); i != DirectoryIndex::kEnd;
+                 i = names.Next(i, hash)) {
+                uint32_t other_full[DirentSize(NAME_MAX)];
+                minfs_dirent_t* other = reinterpret_cast<minfs_dirent_t*>(other_full);
+                status = vn->ReadInternal(other_full, DirentSize(de->namelen), names.Offset(i),
+                                          &actual);
+                if (status == ZX_OK && actual == DirentSize(de->namelen) &&
+                    fbl::StringPiece(other->name, other->namelen) == name) {
+                    FS_TRACE_ERROR("check: ino#%u: de[%u]: duplicate entry '%.*s'\n", ino, eno,
+                                   de->namelen, de->name);
+                    return ZX_ERR_IO_DATA_INTEGRITY;
+                }
+            }
+            names.Insert(hash, static_cast<uint32_t>(off));
+
             //TODO: check for cycles (non-dot/dotdot dir ref already in checked bitmap)
             if (flags & CD_DUMP) {
                 xprintf("ino#%u: de[%u]: ino=%u type=%u '%.*s' %s\n", ino, eno, de->ino, de->type,
@@ -309,6 +330,10 @@ const char* MinfsChecker::CheckDataBlock(blk_t bno) {
 }
 
 zx_status_t MinfsChecker::CheckFile(minfs_inode_t* inode, ino_t ino) {
+    if (inode->flags & kMinfsInodeFlagInline) {
+        return CheckInlineFile(inode, ino);
+    }
+
     xprintf("Direct blocks: \n");
     for (unsigned n = 0; n < kMinfsDirect; n++) {
         xprintf(" %d,", inode->dnum[n]);
@@ -408,6 +433,32 @@ zx_status_t MinfsChecker::CheckFile(minfs_inode_t* inode, ino_t ino) {
     return ZX_OK;
 }
 
+zx_status_t MinfsChecker::CheckInlineFile(minfs_inode_t* inode, ino_t ino) {
+    if (inode->magic != kMinfsMagicFile) {
+        FS_TRACE_ERROR("check: ino#%u: directory marked inline\n", ino);
+        return ZX_ERR_BAD_STATE;
+    }
+    if (inode->size > kMinfsInlineMax) {
+        FS_TRACE_ERROR("check: ino#%u: inline size %u larger than %u\n", ino, inode->size,
+                       kMinfsInlineMax);
+        return ZX_ERR_BAD_STATE;
+    }
+    if (inode->block_count != 0) {
+        FS_TRACE_WARN("check: ino#%u: block count %u, inline file has no blocks\n",
+                      ino, inode->block_count);
+        conforming_ = false;
+    }
+    const uint8_t* data = MinfsInlineData(inode);
+    for (uint32_t i = inode->size; i < kMinfsInlineMax; i++) {
+        if (data[i] != 0) {
+            FS_TRACE_WARN("check: ino#%u: inline data past its size is not zero\n", ino);
+            conforming_ = false;
+            break;
+        }
+    }
+    return ZX_OK;
+}
+
 zx_status_t MinfsChecker::CheckInode(ino_t ino, ino_t parent, bool dot_or_dotdot) {
     minfs_inode_t inode;
     zx_status_t status;
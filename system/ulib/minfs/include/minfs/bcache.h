@@ -18,7 +18,12 @@
 #endif
 
 #include <fbl/algorithm.h>
+#include <fbl/array.h>
+#include <fbl/auto_lock.h>
+#include <fbl/intrusive_double_list.h>
 #include <fbl/macros.h>
+#include <fbl/mutex.h>
+#include <fbl/null_lock.h>
 #include <fbl/unique_ptr.h>
 #include <fbl/unique_fd.h>
 #include <fs/block-txn.h>
@@ -37,11 +42,19 @@ public:
 
     static zx_status_t Create(fbl::unique_ptr<Bcache>* out, fbl::unique_fd fd, uint32_t blockmax);
 
-    // Raw block read functions.
-    // These do not track blocks (or attempt to access the block cache)
+    // Single block read and write functions.
+    // These go through a small write-through LRU cache of recently used
+    // blocks. A miss which directly follows the last missed block reads
+    // ahead |kCacheReadahead| blocks in one request.
     zx_status_t Readblk(blk_t bno, void* data);
     zx_status_t Writeblk(blk_t bno, const void* data);
 
+    // Reports the hit rate of the block cache.
+    void GetCacheInfo(vfs_cache_info_t* info);
+
+    static constexpr uint32_t kCacheBlocks = 64;
+    static constexpr uint32_t kCacheReadahead = 8;
+
     // Returns the maximum number of available blocks,
     // assuming the filesystem is non-resizable.
     uint32_t Maxblk() const { return blockmax_; };
@@ -49,9 +62,12 @@ public:
 #ifdef __Fuchsia__
     ssize_t GetDevicePath(char* out, size_t out_len);
     zx_status_t AttachVmo(zx_handle_t vmo, vmoid_t* out);
-    zx_status_t Txn(block_fifo_request_t* requests, size_t count) {
-        return block_fifo_txn(fifo_client_, requests, count);
-    }
+    // Writes issued here bypass the block cache, so any blocks they
+    // overwrite are dropped from it.
+    zx_status_t Txn(block_fifo_request_t* requests, size_t count);
+
+    // Whether the device accepts BLOCKIO_TRIM.
+    bool TrimSupported() const { return trim_supported_; }
 
     zx_status_t FVMQuery(fvm_info_t* info) {
         ssize_t r = ioctl_block_fvm_query(fd_.get(), info);
@@ -131,8 +147,46 @@ public:
 private:
     Bcache(fbl::unique_fd fd, uint32_t blockmax);
 
+    struct CacheBlock : public fbl::DoublyLinkedListable<CacheBlock*> {
+        blk_t bno;
+        bool valid;
+        CacheBlock* hash_next;
+        uint8_t* data;
+    };
+
+#ifdef __Fuchsia__
+    // The writeback thread invalidates blocks from under the dispatcher.
+    using CacheLock = fbl::Mutex;
+#else
+    using CacheLock = fbl::NullLock;
+#endif
+
+    zx_status_t InitCache();
+    zx_status_t ReadRaw(blk_t bno, blk_t count, void* data, blk_t* actual);
+    zx_status_t WriteRaw(blk_t bno, const void* data);
+    CacheBlock* CacheFindLocked(blk_t bno) const;
+    void CacheInsertLocked(blk_t bno, const void* data);
+    // Unhooks |block| from the hash, leaving its place in the LRU alone.
+    void CacheRemoveLocked(CacheBlock* block);
+    // Forgets |block| and moves it to the back of the LRU for reuse.
+    void CacheDropLocked(CacheBlock* block);
+    void CacheInvalidateLocked(blk_t bno, blk_t count);
+
+    CacheLock cache_lock_;
+    fbl::Array<uint8_t> cache_data_;
+    fbl::Array<CacheBlock> cache_blocks_;
+    fbl::Array<CacheBlock*> cache_buckets_;
+    // Most recently used blocks at the front.
+    fbl::DoublyLinkedList<CacheBlock*> cache_lru_;
+    // Bumped by every invalidation, so a read which raced with a write
+    // doesn't put stale data back in the cache.
+    uint64_t cache_generation_{};
+    blk_t last_miss_{};
+    vfs_cache_info_t cache_info_{};
+
 #ifdef __Fuchsia__
     fifo_client_t* fifo_client_{}; // Fast path to interact with block device
+    bool trim_supported_{};
 #else
     off_t offset_{};
 #endif
@@ -19,6 +19,7 @@
 #include <assert.h>
 #include <limits.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 // clang-format off
@@ -35,7 +36,7 @@ typedef uint32_t ino_t;
 
 constexpr uint64_t kMinfsMagic0         = (0x002153466e694d21ULL);
 constexpr uint64_t kMinfsMagic1         = (0x385000d3d3d3d304ULL);
-constexpr uint32_t kMinfsVersion        = 0x00000005;
+constexpr uint32_t kMinfsVersion        = 0x00000006;
 
 constexpr ino_t kMinfsRootIno           = 1;
 constexpr uint32_t kMinfsFlagClean      = 0x00000001; // Currently unused
@@ -61,6 +62,8 @@ constexpr uint64_t kMinfsMaxFileBlock = (fbl::numeric_limits<uint32_t>::max() /
                                         - 1;
 constexpr uint64_t kMinfsMaxFileSize  = kMinfsMaxFileBlock * kMinfsBlockSize;
 
+constexpr uint32_t kMinfsInodeFlagInline = 0x00000001; // File data is held in the inode
+
 constexpr uint32_t kMinfsTypeFile = 8;
 constexpr uint32_t kMinfsTypeDir  = 4;
 
@@ -122,7 +125,8 @@ typedef struct {
     uint32_t seq_num;               // bumped when modified
     uint32_t gen_num;               // bumped when deleted
     uint32_t dirent_count;          // for directories
-    uint32_t rsvd[5];
+    uint32_t flags;                 // kMinfsInodeFlag*
+    uint32_t rsvd[4];
     blk_t dnum[kMinfsDirect];    // direct blocks
     blk_t inum[kMinfsIndirect];  // indirect blocks
     blk_t dinum[kMinfsDoublyIndirect]; // doubly indirect blocks
@@ -131,6 +135,31 @@ typedef struct {
 static_assert(sizeof(minfs_inode_t) == kMinfsInodeSize,
               "minfs inode size is wrong");
 
+// Notes:
+// - a file with kMinfsInodeFlagInline set keeps its data in place of its
+//   block pointers (dnum, inum and dinum), rather than in data blocks. Its
+//   size is at most kMinfsInlineMax, its block_count is zero, and the bytes
+//   past its size are zero.
+// - a file is moved out to a data block when it grows past kMinfsInlineMax,
+//   and stays there. Directories are never inline.
+// - data blocks are always mapped through dnum, inum and dinum; there is no
+//   extent format. The allocator instead places each file's blocks in
+//   contiguous runs where it can (see Minfs::BlockFindRun), so the writeback
+//   and read paths can merge them into large block ops.
+constexpr uint32_t kMinfsInlineMax =
+    (kMinfsDirect + kMinfsIndirect + kMinfsDoublyIndirect) * sizeof(blk_t);
+
+static_assert(offsetof(minfs_inode_t, dnum) + kMinfsInlineMax == kMinfsInodeSize,
+              "minfs inline data must span the block pointers");
+
+inline uint8_t* MinfsInlineData(minfs_inode_t* inode) {
+    return reinterpret_cast<uint8_t*>(inode->dnum);
+}
+
+inline const uint8_t* MinfsInlineData(const minfs_inode_t* inode) {
+    return reinterpret_cast<const uint8_t*>(inode->dnum);
+}
+
 typedef struct {
     ino_t ino;                      // inode number
     uint32_t reclen;                // Low 28 bits: Length of record
@@ -15,6 +15,10 @@
 
 #include <minfs/format.h>
 
+#ifdef __Fuchsia__
+#include <zx/event.h>
+#endif
+
 namespace minfs {
 
 // Format the partition backed by |bc| as MinFS.
@@ -27,7 +31,11 @@ zx_status_t Mkfs(fbl::unique_ptr<Bcache> bc);
 // This function does not start the async_t object owned by |vfs|;
 // requests will not be dispatched if that async_t object is not
 // active.
-zx_status_t MountAndServe(fs::Vfs* vfs, fbl::unique_ptr<Bcache> bc, zx::channel mount_channel);
+//
+// If they are valid, caches are shrunk while |memory_warning| or
+// |memory_critical| is signaled; see zx_system_get_event().
+zx_status_t MountAndServe(fs::Vfs* vfs, fbl::unique_ptr<Bcache> bc, zx::channel mount_channel,
+                          zx::event memory_warning, zx::event memory_critical);
 #endif
 
 } // namespace minfs
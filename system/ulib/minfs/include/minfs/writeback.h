@@ -7,6 +7,7 @@
 #ifdef __Fuchsia__
 #include <fbl/auto_lock.h>
 #include <fbl/mutex.h>
+#include <sync/completion.h>
 #include <zx/vmo.h>
 #endif
 
@@ -16,6 +17,7 @@
 #include <fbl/macros.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
 
 #include <fs/block-txn.h>
 #include <fs/mapped-vmo.h>
@@ -41,6 +43,11 @@ typedef struct {
     size_t length;
 } write_request_t;
 
+typedef struct {
+    size_t dev_offset;
+    size_t length;
+} trim_request_t;
+
 class WritebackBuffer;
 
 // A transaction consisting of enqueued VMOs to be written
@@ -70,13 +77,30 @@ public:
     // transactions should be all reading from a single in-memory buffer.
     zx_status_t Flush(zx_handle_t vmo, vmoid_t vmoid);
 
+    // The two halves of Flush(), for callers which send several transactions
+    // to the device at once. GetRequests() writes Count() block FIFO requests
+    // reading from |vmoid| to |out|; Finish() releases the pages of |vmo|
+    // they used and empties the transaction once they have been sent.
+    void GetRequests(vmoid_t vmoid, block_fifo_request_t* out) const;
+    void Finish(zx_handle_t vmo);
+
     size_t BlkCount() const;
 
+    // Identify that |nblocks| blocks at |absolute_block| no longer hold
+    // data, so the device may discard them. Adjacent ranges are merged, and
+    // a range which can't be remembered is simply not trimmed.
+    void EnqueueTrim(uint64_t absolute_block, uint64_t nblocks);
+
+    // Sends the enqueued trims to the device, and forgets them. This must
+    // happen before any of the blocks can be allocated again.
+    zx_status_t FlushTrims();
+
 private:
     friend class WritebackBuffer;
     Bcache* bc_;
     size_t count_ = 0;
     write_request_t requests_[MAX_TXN_MESSAGES];
+    fbl::Vector<trim_request_t> trims_;
 };
 
 #else
@@ -85,6 +109,16 @@ using WriteTxn = fs::WriteTxn<kMinfsBlockSize, Bcache>;
 
 #endif
 
+#ifdef __Fuchsia__
+// Lets a caller wait until everything enqueued before it has been written out
+// and the device has been flushed. Requests which arrive close together share
+// a single flush.
+struct SyncRequest : public fbl::SinglyLinkedListable<SyncRequest*> {
+    completion_t completion;
+    zx_status_t status = ZX_OK;
+};
+#endif
+
 // A wrapper around a WriteTxn, holding references to the underlying Vnodes
 // corresponding to the txn, so their Vnodes (and VMOs) are not released
 // while being written out to disk.
@@ -100,12 +134,13 @@ public:
     void Reset();
 
 #ifdef __Fuchsia__
-    // Actually transacts the enqueued work, and resets the WritebackWork to
-    // its initial state.
+    // Finishes the enqueued work once the writeback thread has sent its
+    // transaction out to disk (as part of a larger batch), and resets the
+    // WritebackWork to its initial state.
     //
     // Returns the number of blocks of the writeback buffer that have been
     // consumed.
-    size_t Complete(zx_handle_t vmo, vmoid_t vmoid);
+    size_t Complete(zx_handle_t vmo);
 
     // Adds a completion to the WritebackWork, such that it will be signalled
     // when the WritebackWork is flushed to disk.
@@ -113,6 +148,12 @@ public:
     //
     // Only one completion may be set for each WritebackWork unit.
     void SetCompletion(completion_t* completion);
+
+    // Attaches a sync to the WritebackWork. Unlike a completion, it is not
+    // signalled by Complete(); the writeback thread answers it after the
+    // device has been flushed.
+    void SetSyncRequest(SyncRequest* request);
+    SyncRequest* TakeSyncRequest();
 #else
     void Complete();
 #endif
@@ -125,6 +166,7 @@ public:
 private:
 #ifdef __Fuchsia__
     completion_t* completion_; // Optional.
+    SyncRequest* sync_;        // Optional.
 #endif
     WriteTxn txn_;
     size_t node_count_;
@@ -155,6 +197,9 @@ public:
     // enqueued, preventing them from closing while the writeback is pending.
     void Enqueue(fbl::unique_ptr<WritebackWork> work) __TA_EXCLUDES(writeback_lock_);
 
+    // Adds the state of the writeback buffer to |info|.
+    void GetInfo(vfs_cache_info_t* info) __TA_EXCLUDES(writeback_lock_);
+
 private:
     WritebackBuffer(Bcache* bc, fbl::unique_ptr<MappedVmo> buffer);
 
@@ -177,6 +222,15 @@ private:
 
     static int WritebackThread(void* arg);
 
+    // Takes as many units of work from the front of the queue as can be sent
+    // to the device in a single transaction, up to |max|, putting them in
+    // |out|. Returns how many were taken.
+    size_t PopBatchLocked(fbl::unique_ptr<WritebackWork>* out, size_t max)
+        __TA_REQUIRES(writeback_lock_);
+
+    // Flushes the device once on behalf of all of |syncs|, then answers them.
+    void FlushSyncs(fbl::SinglyLinkedList<SyncRequest*>* syncs, zx_status_t write_status);
+
     // The waiter struct may be used as a stack-allocated queue for producers.
     // It allows them to take turns putting data into the buffer when it is
     // mostly full.
@@ -210,6 +264,12 @@ private:
     size_t start_ __TA_GUARDED(writeback_lock_){};
     size_t len_ __TA_GUARDED(writeback_lock_){};
     const size_t cap_ = 0;
+
+    // The most of the buffer that has been in use at once, and how often and
+    // for how long producers have had to wait for room in it.
+    size_t peak_len_ __TA_GUARDED(writeback_lock_){};
+    uint64_t stalls_ __TA_GUARDED(writeback_lock_){};
+    zx_duration_t stall_time_ __TA_GUARDED(writeback_lock_){};
 };
 
 #endif
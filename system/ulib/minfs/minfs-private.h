@@ -10,19 +10,24 @@
 #include <inttypes.h>
 
 #ifdef __Fuchsia__
+#include <async/auto_task.h>
 #include <fbl/auto_lock.h>
 #include <fs/remote.h>
+#include <fs/vnode-cache.h>
 #include <fs/watcher.h>
 #include <sync/completion.h>
+#include <zx/event.h>
 #include <zx/vmo.h>
 #endif
 
 #include <fbl/algorithm.h>
+#include <fbl/array.h>
 #include <fbl/intrusive_hash_table.h>
 #include <fbl/intrusive_single_list.h>
 #include <fbl/macros.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
 
 #include <fs/block-txn.h>
 #include <fs/mapped-vmo.h>
@@ -78,6 +83,10 @@ constexpr uint32_t kMxFsSyncCtime = (1 << 1);
 
 constexpr uint32_t kMinfsBlockCacheSize = 64;
 
+// Closed vnodes are kept around up to these limits.
+constexpr size_t kMinfsVnodeCacheSize = 256;
+constexpr size_t kMinfsVnodeCacheBytes = 8 * (1LU << 20);
+
 // Used by fsck
 class MinfsChecker;
 class VnodeMinfs;
@@ -108,6 +117,10 @@ public:
     // Allocate a new data block.
     zx_status_t BlockNew(WriteTxn* txn, blk_t hint, blk_t* out_bno);
 
+    // Returns the start of a run of |count| free blocks, preferring one at or
+    // after |hint|. Returns |hint| if there is no such run.
+    blk_t BlockFindRun(blk_t hint, blk_t count) const;
+
     // free block in block bitmap
     zx_status_t BlockFree(WriteTxn* txn, blk_t bno);
 
@@ -125,6 +138,10 @@ public:
 
     void EnqueueWork(fbl::unique_ptr<WritebackWork> work) {
 #ifdef __Fuchsia__
+        // Trims go out now, in order with any blocks written directly
+        // through the cache, rather than after the allocations which may
+        // follow them through the writeback buffer.
+        work->txn()->FlushTrims();
         writeback_->Enqueue(fbl::move(work));
 #else
         work->Complete();
@@ -138,7 +155,18 @@ public:
     // Signals the completion object as soon as...
     // (1) A sync probe has entered and exited the writeback queue, and
     // (2) The block cache has sync'd with the underlying block device.
-    zx_status_t Sync(completion_t* completion);
+    zx_status_t Sync(SyncRequest* request);
+#endif
+
+    // Reports on the block cache and the writeback buffer.
+    void GetCacheInfo(vfs_cache_info_t* info);
+
+#ifdef __Fuchsia__
+    // Sets the dispatcher on which spare FVM slices are given back.
+    void SetAsync(async_t* async);
+
+    // Shrinks |vnode_cache_| while the system is short of memory.
+    zx_status_t WatchMemoryPressure(async_t* async, zx::event warning, zx::event critical);
 #endif
 
     // The following methods are used to read one block from the specified extent,
@@ -156,6 +184,9 @@ public:
     minfs_info_t info_{};
 #ifdef __Fuchsia__
     fbl::Mutex hash_lock_;
+    // Keeps recently closed vnodes in |vnode_hash_|, so that they don't
+    // need to be loaded again when they're reopened.
+    fs::VnodeCache vnode_cache_{kMinfsVnodeCacheSize, kMinfsVnodeCacheBytes};
 #endif
 
 private:
@@ -176,6 +207,17 @@ private:
     zx_status_t AddInodes();
     zx_status_t AddBlocks();
 
+#ifdef __Fuchsia__
+    // Returns how many data slices AddBlocks() should ask for. Growth which
+    // follows closely on the last takes twice as many slices as it did,
+    // since a volume which is filling quickly will soon need them.
+    uint32_t DataGrowthSlices(zx_time_t now);
+
+    // Gives back the data slices which AddBlocks() took ahead of demand and
+    // which are still entirely free at the end of the volume.
+    void ReleaseSpareSlices();
+#endif
+
     // Creates an unique identifier for this instance. This is to be called only during
     // "construction".
     zx_status_t CreateFsId();
@@ -203,6 +245,14 @@ private:
     vmoid_t info_vmoid_{};
     fbl::unique_ptr<WritebackBuffer> writeback_;
     uint64_t fs_id_{};
+
+    // Speculative growth of the data region. |dat_spare_slices_| were taken
+    // beyond what the last AddBlocks() needed, and are given back by
+    // |release_task_| if they're still unused once growth has settled.
+    zx_time_t dat_grow_time_{};
+    uint32_t dat_grow_slices_{};
+    uint32_t dat_spare_slices_{};
+    fbl::unique_ptr<async::AutoTask> release_task_{};
 #else
     // Store start block + length for all extents. These may differ from info block for
     // sparse files.
@@ -233,6 +283,49 @@ struct DirectoryOffset {
     size_t off_prev; // Offset in directory of previous record
 };
 
+// An in-memory index over the live entries of a directory, from the hash of
+// each name to the offset of its dirent. Live dirents never move, so the index
+// only changes as names are added and removed. Hashes collide; callers still
+// compare the name stored in the dirent.
+class DirectoryIndex {
+public:
+    static constexpr uint32_t kEnd = UINT32_MAX;
+
+    static uint32_t Hash(fbl::StringPiece name) {
+        return fnv1a32(name.data(), name.length());
+    }
+
+    zx_status_t Insert(uint32_t hash, uint32_t off);
+    void Remove(uint32_t hash, uint32_t off);
+    size_t size() const { return count_; }
+
+    // Walks the entries whose names may hash to |hash|:
+    //
+    // for (uint32_t i = index.First(hash); i != DirectoryIndex::kEnd; i = index.Next(i, hash)) {
+    //     ... index.Offset(i) ...
+    // }
+    //
+    // The entry at |i| may be removed once Next() has been called on it.
+    uint32_t First(uint32_t hash) const;
+    uint32_t Next(uint32_t i, uint32_t hash) const;
+    uint32_t Offset(uint32_t i) const { return entries_[i].off; }
+
+private:
+    struct Entry {
+        uint32_t hash;
+        uint32_t off;
+        uint32_t next;
+    };
+
+    zx_status_t Rehash(size_t bucket_count);
+    uint32_t Skip(uint32_t i, uint32_t hash) const;
+
+    fbl::Vector<Entry> entries_;
+    fbl::Array<uint32_t> buckets_;
+    uint32_t free_ = kEnd;
+    size_t count_ = 0;
+};
+
 class VnodeMinfs final : public fs::Vnode,
                          public fbl::SinglyLinkedListable<VnodeMinfs*>,
                          public fbl::Recyclable<VnodeMinfs> {
@@ -255,6 +348,7 @@ public:
                                 fbl::RefPtr<VnodeMinfs>* out);
 
     bool IsDirectory() const { return inode_.magic == kMinfsMagicDir; }
+    bool IsInline() const { return (inode_.flags & kMinfsInodeFlagInline) != 0; }
     bool IsUnlinked() const { return inode_.link_count == 0; }
     zx_status_t CanUnlink() const;
 
@@ -311,6 +405,9 @@ private:
     zx_status_t WriteExactInternal(WriteTxn* txn, const void* data, size_t len,
                                    size_t off);
     zx_status_t TruncateInternal(WriteTxn* txn, size_t len);
+    // Moves the data of an inline file out to its first data block, so that
+    // the file can grow past |kMinfsInlineMax|.
+    zx_status_t InlinePromote(WriteTxn* txn);
     // Lookup which can traverse '..'
     zx_status_t LookupInternal(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece name);
 
@@ -322,8 +419,19 @@ private:
                                            minfs_dirent_t*, DirArgs*,
                                            DirectoryOffset*);
 
-    // Enumerates directories.
-    zx_status_t ForEachDirent(DirArgs* args, const DirentCallback func);
+    // Enumerates directories, starting from the dirent at |off|.
+    zx_status_t ForEachDirent(DirArgs* args, const DirentCallback func, size_t off = 0);
+
+    // Like |ForEachDirent|, but only visits the dirent named |args->name|.
+    // Large directories find it through |dir_index_| rather than a scan; in
+    // that case the callback sees no previous dirent (|off_prev| == |off|).
+    zx_status_t ForEachNamedDirent(DirArgs* args, const DirentCallback func);
+    zx_status_t FinishDirentCallback(DirArgs* args, zx_status_t status);
+
+    // Builds |dir_index_| from the contents of the directory.
+    zx_status_t BuildDirIndex();
+    void DirIndexInsert(fbl::StringPiece name, size_t off);
+    void DirIndexRemove(fbl::StringPiece name, size_t off);
 
     // Directory callback functions.
     //
@@ -342,6 +450,8 @@ private:
                                                  DirectoryOffset*);
     static zx_status_t DirentCallbackAppend(fbl::RefPtr<VnodeMinfs>, minfs_dirent_t*, DirArgs*,
                                             DirectoryOffset*);
+    static zx_status_t DirentCallbackIndex(fbl::RefPtr<VnodeMinfs>, minfs_dirent_t*, DirArgs*,
+                                           DirectoryOffset*);
 
     zx_status_t UnlinkChild(WritebackWork* wb, fbl::RefPtr<VnodeMinfs> child,
                             minfs_dirent_t* de, DirectoryOffset* offs);
@@ -459,6 +569,7 @@ private:
 
 #ifdef __Fuchsia__
     zx_status_t Sync() final;
+    bool CanDispatchConcurrently(uint32_t op) final;
     zx_status_t AttachRemote(fs::MountChannel h) final;
     zx_status_t InitVmo();
     zx_status_t InitIndirectVmo();
@@ -523,6 +634,16 @@ private:
     ino_t ino_{};
     minfs_inode_t inode_{};
 
+    // Where the next data block of this vnode is allocated from, so that
+    // consecutive writes land in one contiguous run on disk.
+    blk_t alloc_hint_{};
+
+    // Only built for directories once they have grown large.
+    fbl::unique_ptr<DirectoryIndex> dir_index_{};
+    // No dirent before this offset has room for another entry, so appends
+    // may start looking here.
+    size_t dir_free_hint_{};
+
     // This field tracks the current number of file descriptors with
     // an open reference to this Vnode. Notably, this is distinct from the
     // VnodeMinfs's own refcount, since there may still be filesystem
@@ -259,14 +259,21 @@ zx_status_t Minfs::InodeSync(WriteTxn* txn, ino_t ino, const minfs_inode_t* inod
 }
 
 #ifdef __Fuchsia__
-zx_status_t Minfs::Sync(completion_t* completion) {
+zx_status_t Minfs::Sync(SyncRequest* request) {
     fbl::unique_ptr<WritebackWork> wb(new WritebackWork(bc_.get()));
-    wb->SetCompletion(completion);
+    wb->SetSyncRequest(request);
     EnqueueWork(fbl::move(wb));
     return ZX_OK;
 }
 #endif
 
+void Minfs::GetCacheInfo(vfs_cache_info_t* info) {
+    bc_->GetCacheInfo(info);
+#ifdef __Fuchsia__
+    writeback_->GetInfo(info);
+#endif
+}
+
 Minfs::Minfs(fbl::unique_ptr<Bcache> bc, const minfs_info_t* info) : bc_(fbl::move(bc)) {
     memcpy(&info_, info, sizeof(minfs_info_t));
 
@@ -491,6 +498,86 @@ zx_status_t Minfs::AddInodes() {
 #endif
 }
 
+#ifdef __Fuchsia__
+// Growth this soon after the last is taken as a sign of more to come.
+constexpr zx_duration_t kGrowthWindow = ZX_SEC(1);
+// The most data slices taken at once.
+constexpr uint32_t kMaxGrowthSlices = 16;
+// How long spare slices are kept after the last growth.
+constexpr zx_duration_t kSpareSliceLinger = ZX_SEC(10);
+
+uint32_t Minfs::DataGrowthSlices(zx_time_t now) {
+    if (dat_grow_slices_ != 0 && now - dat_grow_time_ < kGrowthWindow) {
+        dat_grow_slices_ = fbl::min(dat_grow_slices_ * 2, kMaxGrowthSlices);
+    } else {
+        dat_grow_slices_ = 1;
+    }
+    dat_grow_time_ = now;
+    return dat_grow_slices_;
+}
+
+void Minfs::SetAsync(async_t* async) {
+    fbl::AllocChecker ac;
+    release_task_.reset(new (&ac) async::AutoTask(async));
+    if (!ac.check()) {
+        // Spare slices are then kept until they are used.
+        return;
+    }
+    release_task_->set_handler([this](async_t* async, zx_status_t status) {
+        if (status == ZX_OK) {
+            ReleaseSpareSlices();
+        }
+        return ASYNC_TASK_FINISHED;
+    });
+}
+
+zx_status_t Minfs::WatchMemoryPressure(async_t* async, zx::event warning, zx::event critical) {
+    return vnode_cache_.WatchMemoryPressure(async, fbl::move(warning), fbl::move(critical));
+}
+
+void Minfs::ReleaseSpareSlices() {
+    TRACE_DURATION("minfs", "Minfs::ReleaseSpareSlices");
+    const size_t kBlocksPerSlice = info_.slice_size / kMinfsBlockSize;
+    uint32_t release = 0;
+    while (release < dat_spare_slices_ && release + 1 < info_.dat_slices) {
+        size_t end = (info_.dat_slices - release) * kBlocksPerSlice;
+        size_t used;
+        if (block_map_.Find(true, end - kBlocksPerSlice, end, 1, &used) == ZX_OK) {
+            break;
+        }
+        release++;
+    }
+    dat_spare_slices_ = 0;
+    if (release == 0) {
+        return;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<WritebackWork> wb(new (&ac) WritebackWork(bc_.get()));
+    if (!ac.check()) {
+        return;
+    }
+
+    // Should the superblock not follow, mounting frees the slices which it
+    // no longer counts.
+    extend_request_t request;
+    request.length = release;
+    request.offset = (kFVMBlockDataStart / kBlocksPerSlice) + info_.dat_slices - release;
+    if (bc_->FVMShrink(&request) != ZX_OK) {
+        return;
+    }
+
+    uint32_t blocks = static_cast<uint32_t>((info_.dat_slices - release) * kBlocksPerSlice);
+    block_map_.Shrink(blocks);
+    info_.vslice_count -= release;
+    info_.dat_slices -= release;
+    info_.block_count = blocks;
+    abmblks_ = (blocks + kMinfsBlockBits - 1) / kMinfsBlockBits;
+    wb->txn()->Enqueue(info_vmo_->GetVmo(), 0, 0, 1);
+    EnqueueWork(fbl::move(wb));
+}
+#endif
+
 zx_status_t Minfs::AddBlocks() {
     TRACE_DURATION("minfs", "Minfs::AddBlocks");
 #ifdef __Fuchsia__
@@ -499,28 +586,39 @@ zx_status_t Minfs::AddBlocks() {
     }
 
     const size_t kBlocksPerSlice = info_.slice_size / kMinfsBlockSize;
-    extend_request_t request;
-    request.length = 1;
-    request.offset = (kFVMBlockDataStart / kBlocksPerSlice) + info_.dat_slices;
-    uint64_t blocks64 = (info_.dat_slices + request.length) * kBlocksPerSlice;
-    ZX_DEBUG_ASSERT(blocks64 <= fbl::numeric_limits<uint32_t>::max());
-    uint32_t blocks = static_cast<uint32_t>(blocks64);
-    uint32_t abmblks = (blocks + kMinfsBlockBits - 1) / kMinfsBlockBits;
     uint32_t abmblks_old = (info_.block_count + kMinfsBlockBits - 1) / kMinfsBlockBits;
-    ZX_DEBUG_ASSERT(abmblks_old <= abmblks);
-
-    if (abmblks > kBlocksPerSlice) {
+    // The block bitmap has a single slice, which covers kMinfsBlockBits
+    // slices of data.
+    const size_t max_slices = kMinfsBlockBits;
+    if (info_.dat_slices >= max_slices) {
         // TODO(smklein): Increase the size of the block bitmap.
         fprintf(stderr, "Minfs::AddBlocks needs to increase block bitmap size\n");
         return ZX_ERR_NO_SPACE;
     }
 
-    if (bc_->FVMExtend(&request) != ZX_OK) {
+    extend_request_t request;
+    request.length = fbl::min(static_cast<size_t>(DataGrowthSlices(zx_time_get(ZX_CLOCK_MONOTONIC))),
+                              max_slices - info_.dat_slices);
+    request.offset = (kFVMBlockDataStart / kBlocksPerSlice) + info_.dat_slices;
+    zx_status_t status = bc_->FVMExtend(&request);
+    if (status != ZX_OK && request.length > 1) {
+        // The volume may still have the one slice which is needed.
+        request.length = 1;
+        dat_grow_slices_ = 1;
+        status = bc_->FVMExtend(&request);
+    }
+    if (status != ZX_OK) {
         // TODO(smklein): Query FVM on reboot to verify our
         // superblock matches our allocated extents.
         fprintf(stderr, "Minfs::AddBlocks FVM Extend failure\n");
         return ZX_ERR_NO_SPACE;
     }
+    uint64_t blocks64 = (info_.dat_slices + request.length) * kBlocksPerSlice;
+    ZX_DEBUG_ASSERT(blocks64 <= fbl::numeric_limits<uint32_t>::max());
+    uint32_t blocks = static_cast<uint32_t>(blocks64);
+    uint32_t abmblks = (blocks + kMinfsBlockBits - 1) / kMinfsBlockBits;
+    ZX_DEBUG_ASSERT(abmblks_old <= abmblks);
+    ZX_DEBUG_ASSERT(abmblks <= kBlocksPerSlice);
 
     fbl::AllocChecker ac;
     fbl::unique_ptr<WritebackWork> wb(new (&ac) WritebackWork(bc_.get()));
@@ -549,6 +647,16 @@ zx_status_t Minfs::AddBlocks() {
     abmblks_ = abmblks;
     txn->Enqueue(info_vmo_->GetVmo(), 0, 0, 1);
     EnqueueWork(fbl::move(wb));
+
+    // Whatever spare slices were left before have been used up.
+    dat_spare_slices_ = static_cast<uint32_t>(request.length - 1);
+    if (release_task_ != nullptr) {
+        release_task_->Cancel();
+        if (dat_spare_slices_ != 0) {
+            release_task_->set_deadline(zx_deadline_after(kSpareSliceLinger));
+            release_task_->Post();
+        }
+    }
     return ZX_OK;
 #else
     return ZX_ERR_NO_SPACE;
@@ -733,6 +841,11 @@ zx_status_t Minfs::BlockFree(WriteTxn* txn, blk_t bno) {
 
     block_map_.Clear(bno, bno + 1);
     info_.alloc_block_count--;
+#ifdef __Fuchsia__
+    if (bc_->TrimSupported()) {
+        txn->EnqueueTrim(info_.dat_block + bno, 1);
+    }
+#endif
     blk_t bitbno = bno / kMinfsBlockBits;
     txn->Enqueue(bbm_id, bitbno, info_.abm_block + bitbno, 1);
     return CountUpdate(txn);
@@ -780,6 +893,15 @@ zx_status_t Minfs::BlockNew(WriteTxn* txn, blk_t hint, blk_t* out_bno) {
     return ZX_OK;
 }
 
+blk_t Minfs::BlockFindRun(blk_t hint, blk_t count) const {
+    size_t start;
+    if (block_map_.Find(false, hint, block_map_.size(), count, &start) == ZX_OK ||
+        block_map_.Find(false, 0, hint, count, &start) == ZX_OK) {
+        return static_cast<blk_t>(start);
+    }
+    return hint;
+}
+
 zx_status_t Minfs::CountUpdate(WriteTxn* txn) {
     zx_status_t status = ZX_OK;
 
@@ -945,6 +1067,15 @@ zx_status_t Minfs::Create(fbl::unique_ptr<Bcache> bc, const minfs_info_t* info,
     }
 #endif
 
+    // The bitmaps were read into their storage directly, so their summaries
+    // are built from what was loaded.
+    if ((status = fs->block_map_.EnableSummary()) != ZX_OK) {
+        return status;
+    }
+    if ((status = fs->inode_map_.EnableSummary()) != ZX_OK) {
+        return status;
+    }
+
     *out = fs;
     return ZX_OK;
 }
@@ -978,7 +1109,8 @@ zx_status_t minfs_mount(fbl::unique_ptr<minfs::Bcache> bc, fbl::RefPtr<VnodeMinf
 }
 
 #ifdef __Fuchsia__
-zx_status_t MountAndServe(fs::Vfs *vfs, fbl::unique_ptr<Bcache> bc, zx::channel mount_channel) {
+zx_status_t MountAndServe(fs::Vfs *vfs, fbl::unique_ptr<Bcache> bc, zx::channel mount_channel,
+                          zx::event memory_warning, zx::event memory_critical) {
     TRACE_DURATION("minfs", "MountAndServe");
 
     fbl::RefPtr<VnodeMinfs> vn;
@@ -987,12 +1119,19 @@ zx_status_t MountAndServe(fs::Vfs *vfs, fbl::unique_ptr<Bcache> bc, zx::channel
         return status;
     }
 
+    vn->fs_->SetAsync(vfs->async());
+    if (memory_warning.is_valid() && memory_critical.is_valid()) {
+        vn->fs_->WatchMemoryPressure(vfs->async(), fbl::move(memory_warning),
+                                     fbl::move(memory_critical));
+    }
     return vfs->ServeDirectory(fbl::move(vn), fbl::move(mount_channel));
 }
 #endif
 
 zx_status_t Minfs::Unmount() {
 #ifdef __Fuchsia__
+    // Cached vnodes refer back to the filesystem.
+    vnode_cache_.Clear();
     // Ensure writeback buffer completes before auxilliary structures
     // are deleted.
     writeback_ = nullptr;
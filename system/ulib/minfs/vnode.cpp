@@ -12,6 +12,7 @@
 
 #include <fs/block-txn.h>
 #include <fbl/algorithm.h>
+#include <fbl/auto_call.h>
 #include <zircon/device/vfs.h>
 
 #ifdef __Fuchsia__
@@ -363,6 +364,8 @@ zx_status_t VnodeMinfs::InitVmo() {
     if (vmo_.is_valid()) {
         return ZX_OK;
     }
+    // Inline files are read and written in the inode itself.
+    ZX_DEBUG_ASSERT(!IsInline());
 
     zx_status_t status;
     const size_t vmo_size = fbl::round_up(inode_.size, kMinfsBlockSize);
@@ -464,18 +467,17 @@ zx_status_t VnodeMinfs::InitVmo() {
 
 zx_status_t VnodeMinfs::GetBnoDirect(WriteTxn* txn, blk_t* bno, bool* dirty) {
     // direct blocks are simple... is there an entry in dnum[]?
-    blk_t hint = 0;
-
     if (*bno == 0) {
         if (txn == nullptr) {
             *bno = 0;
             return ZX_OK;
         }
-        // allocate a new block
-        zx_status_t status = fs_->BlockNew(txn, hint, bno);
+        // allocate a new block, following on from the last one
+        zx_status_t status = fs_->BlockNew(txn, alloc_hint_, bno);
         if (status != ZX_OK) {
             return status;
         }
+        alloc_hint_ = *bno + 1;
         inode_.block_count++;
         *dirty = true;
     }
@@ -716,6 +718,96 @@ zx_status_t VnodeMinfs::WriteExactInternal(WriteTxn* txn, const void* data,
     return ZX_OK;
 }
 
+// The longest run of blocks a single write looks for when allocating.
+constexpr blk_t kAllocRunMax = 256;
+
+// Directories with at least this many entries get a |DirectoryIndex|.
+constexpr uint32_t kDirIndexMinEntries = 64;
+
+zx_status_t DirectoryIndex::Rehash(size_t bucket_count) {
+    fbl::AllocChecker ac;
+    fbl::Array<uint32_t> buckets(new (&ac) uint32_t[bucket_count], bucket_count);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    for (size_t i = 0; i < bucket_count; i++) {
+        buckets[i] = kEnd;
+    }
+    // Free entries stay chained on the free list.
+    for (uint32_t i = 0; i < entries_.size(); i++) {
+        if (entries_[i].off != kEnd) {
+            uint32_t* bucket = &buckets[entries_[i].hash & (bucket_count - 1)];
+            entries_[i].next = *bucket;
+            *bucket = i;
+        }
+    }
+    buckets_ = fbl::move(buckets);
+    return ZX_OK;
+}
+
+zx_status_t DirectoryIndex::Insert(uint32_t hash, uint32_t off) {
+    zx_status_t status;
+    if (count_ >= buckets_.size() &&
+        (status = Rehash(fbl::max(buckets_.size() * 2, static_cast<size_t>(16)))) != ZX_OK) {
+        return status;
+    }
+    uint32_t i = free_;
+    if (i != kEnd) {
+        free_ = entries_[i].next;
+    } else {
+        fbl::AllocChecker ac;
+        entries_.push_back(Entry{}, &ac);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        i = static_cast<uint32_t>(entries_.size() - 1);
+    }
+    uint32_t* bucket = &buckets_[hash & (buckets_.size() - 1)];
+    entries_[i].hash = hash;
+    entries_[i].off = off;
+    entries_[i].next = *bucket;
+    *bucket = i;
+    count_++;
+    return ZX_OK;
+}
+
+void DirectoryIndex::Remove(uint32_t hash, uint32_t off) {
+    if (buckets_.size() == 0) {
+        return;
+    }
+    for (uint32_t* i = &buckets_[hash & (buckets_.size() - 1)]; *i != kEnd;
+         i = &entries_[*i].next) {
+        Entry* entry = &entries_[*i];
+        if (entry->off == off) {
+            uint32_t removed = *i;
+            *i = entry->next;
+            entry->off = kEnd;
+            entry->next = free_;
+            free_ = removed;
+            count_--;
+            return;
+        }
+    }
+}
+
+uint32_t DirectoryIndex::Skip(uint32_t i, uint32_t hash) const {
+    while (i != kEnd && entries_[i].hash != hash) {
+        i = entries_[i].next;
+    }
+    return i;
+}
+
+uint32_t DirectoryIndex::First(uint32_t hash) const {
+    if (buckets_.size() == 0) {
+        return kEnd;
+    }
+    return Skip(buckets_[hash & (buckets_.size() - 1)], hash);
+}
+
+uint32_t DirectoryIndex::Next(uint32_t i, uint32_t hash) const {
+    return Skip(entries_[i].next, hash);
+}
+
 static zx_status_t validate_dirent(minfs_dirent_t* de, size_t bytes_read, size_t off) {
     uint32_t reclen = static_cast<uint32_t>(MinfsReclen(de, off));
     if ((bytes_read < MINFS_DIRENT_SIZE) || (reclen < MINFS_DIRENT_SIZE)) {
@@ -825,6 +917,8 @@ zx_status_t VnodeMinfs::UnlinkChild(WritebackWork* wb,
     if ((status = WriteExactInternal(wb->txn(), de, MINFS_DIRENT_SIZE, off)) != ZX_OK) {
         return status;
     }
+    DirIndexRemove(fbl::StringPiece(de->name, de->namelen), offs->off);
+    dir_free_hint_ = fbl::min(dir_free_hint_, off);
 
     if (de->reclen & kMinfsReclenLast) {
         // Truncating the directory merely removed unused space; if it fails,
@@ -980,6 +1074,7 @@ zx_status_t VnodeMinfs::DirentCallbackAppend(fbl::RefPtr<VnodeMinfs> vndir, minf
         if (status != ZX_OK) {
             return status;
         }
+        vndir->DirIndexInsert(args->name, off);
         vndir->inode_.dirent_count++;
         if (args->type == kMinfsTypeDir) {
             // Child directory has '..' which will point to parent directory
@@ -990,6 +1085,12 @@ zx_status_t VnodeMinfs::DirentCallbackAppend(fbl::RefPtr<VnodeMinfs> vndir, minf
     };
 
     uint32_t reclen = static_cast<uint32_t>(MinfsReclen(de, offs->off));
+    uint32_t used = (de->ino == 0) ? 0 : DirentSize(de->namelen);
+    if (offs->off == vndir->dir_free_hint_ && used <= reclen &&
+        reclen - used < DirentSize(1)) {
+        // Nothing will ever fit here; later appends can start further along.
+        vndir->dir_free_hint_ = offs->off + reclen;
+    }
     if (de->ino == 0) {
         // empty entry, do we fit?
         if (args->reclen > reclen) {
@@ -1025,6 +1126,19 @@ zx_status_t VnodeMinfs::DirentCallbackAppend(fbl::RefPtr<VnodeMinfs> vndir, minf
     }
 }
 
+zx_status_t VnodeMinfs::DirentCallbackIndex(fbl::RefPtr<VnodeMinfs> vndir, minfs_dirent_t* de,
+                                            DirArgs* args, DirectoryOffset* offs) {
+    if (de->ino != 0) {
+        zx_status_t status = vndir->dir_index_->Insert(
+            DirectoryIndex::Hash(fbl::StringPiece(de->name, de->namelen)),
+            static_cast<uint32_t>(offs->off));
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+    return do_next_dirent(de, offs);
+}
+
 // Calls a callback 'func' on all direntries in a directory 'vn' with the
 // provided arguments, reacting to the return code of the callback.
 //
@@ -1037,12 +1151,12 @@ zx_status_t VnodeMinfs::DirentCallbackAppend(fbl::RefPtr<VnodeMinfs> vndir, minf
 //  'offs': Offset info about where in the directory this direntry is located.
 //          Since 'func' may create / remove surrounding dirents, it is responsible for
 //          updating the offset information to access the next dirent.
-zx_status_t VnodeMinfs::ForEachDirent(DirArgs* args, const DirentCallback func) {
+zx_status_t VnodeMinfs::ForEachDirent(DirArgs* args, const DirentCallback func, size_t off) {
     char data[kMinfsMaxDirentSize];
     minfs_dirent_t* de = (minfs_dirent_t*) data;
     DirectoryOffset offs = {
-        .off = 0,
-        .off_prev = 0,
+        .off = off,
+        .off_prev = off,
     };
     while (offs.off + MINFS_DIRENT_SIZE < kMinfsMaxDirectorySize) {
         xprintf("Reading dirent at offset %zd\n", offs.off);
@@ -1054,22 +1168,94 @@ zx_status_t VnodeMinfs::ForEachDirent(DirArgs* args, const DirentCallback func)
             return status;
         }
 
-        switch ((status = func(fbl::RefPtr<VnodeMinfs>(this), de, args, &offs))) {
-        case DIR_CB_NEXT:
-            break;
-        case DIR_CB_SAVE_SYNC:
-            inode_.seq_num++;
-            InodeSync(args->wb->txn(), kMxFsSyncMtime);
-            args->wb->PinVnode(fbl::move(fbl::WrapRefPtr(this)));
-            return ZX_OK;
-        case DIR_CB_DONE:
-        default:
+        if ((status = func(fbl::RefPtr<VnodeMinfs>(this), de, args, &offs)) != DIR_CB_NEXT) {
+            return FinishDirentCallback(args, status);
+        }
+    }
+    return ZX_ERR_NOT_FOUND;
+}
+
+zx_status_t VnodeMinfs::FinishDirentCallback(DirArgs* args, zx_status_t status) {
+    switch (status) {
+    case DIR_CB_SAVE_SYNC:
+        inode_.seq_num++;
+        InodeSync(args->wb->txn(), kMxFsSyncMtime);
+        args->wb->PinVnode(fbl::move(fbl::WrapRefPtr(this)));
+        return ZX_OK;
+    case DIR_CB_DONE:
+    default:
+        return status;
+    }
+}
+
+zx_status_t VnodeMinfs::ForEachNamedDirent(DirArgs* args, const DirentCallback func) {
+    if (dir_index_ == nullptr && inode_.dirent_count >= kDirIndexMinEntries) {
+        // Without an index, fall back to scanning.
+        BuildDirIndex();
+    }
+    if (dir_index_ == nullptr) {
+        return ForEachDirent(args, func);
+    }
+
+    char data[kMinfsMaxDirentSize];
+    minfs_dirent_t* de = (minfs_dirent_t*) data;
+    uint32_t hash = DirectoryIndex::Hash(args->name);
+    for (uint32_t i = dir_index_->First(hash); i != DirectoryIndex::kEnd;) {
+        DirectoryOffset offs = {
+            .off = dir_index_->Offset(i),
+            .off_prev = dir_index_->Offset(i),
+        };
+        // The callback may remove this entry from the index.
+        i = dir_index_->Next(i, hash);
+
+        size_t r;
+        zx_status_t status = ReadInternal(data, kMinfsMaxDirentSize, offs.off, &r);
+        if (status != ZX_OK) {
+            return status;
+        } else if ((status = validate_dirent(de, r, offs.off)) != ZX_OK) {
             return status;
+        } else if ((de->ino == 0) || fbl::StringPiece(de->name, de->namelen) != args->name) {
+            continue;
+        }
+
+        if ((status = func(fbl::RefPtr<VnodeMinfs>(this), de, args, &offs)) != DIR_CB_NEXT) {
+            return FinishDirentCallback(args, status);
         }
     }
     return ZX_ERR_NOT_FOUND;
 }
 
+zx_status_t VnodeMinfs::BuildDirIndex() {
+    fbl::AllocChecker ac;
+    dir_index_.reset(new (&ac) DirectoryIndex());
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    DirArgs args = DirArgs();
+    zx_status_t status = ForEachDirent(&args, DirentCallbackIndex);
+    if (status != ZX_ERR_NOT_FOUND) {
+        // Scanning to the end is the only way out which saw every dirent.
+        dir_index_.reset();
+        return (status == ZX_OK) ? ZX_ERR_INTERNAL : status;
+    }
+    return ZX_OK;
+}
+
+void VnodeMinfs::DirIndexInsert(fbl::StringPiece name, size_t off) {
+    if (dir_index_ != nullptr &&
+        dir_index_->Insert(DirectoryIndex::Hash(name), static_cast<uint32_t>(off)) != ZX_OK) {
+        // An index which is missing names is worse than none; it can be
+        // rebuilt later.
+        dir_index_.reset();
+    }
+}
+
+void VnodeMinfs::DirIndexRemove(fbl::StringPiece name, size_t off) {
+    if (dir_index_ != nullptr) {
+        dir_index_->Remove(DirectoryIndex::Hash(name), static_cast<uint32_t>(off));
+    }
+}
+
 void VnodeMinfs::fbl_recycle() {
     if (fd_count_ != 0 || !IsUnlinked()) {
         // If this node has not been purged already, remove it from the
@@ -1128,7 +1314,13 @@ zx_status_t VnodeMinfs::Open(uint32_t flags, fbl::RefPtr<Vnode>* out_redirect) {
 void VnodeMinfs::Purge(WriteTxn* txn) {
     ZX_DEBUG_ASSERT(fd_count_ == 0);
     ZX_DEBUG_ASSERT(IsUnlinked());
+    if (IsInline()) {
+        // Inline data is not block pointers; there is nothing to free.
+        memset(MinfsInlineData(&inode_), 0, kMinfsInlineMax);
+        inode_.flags &= ~kMinfsInodeFlagInline;
+    }
 #ifdef __Fuchsia__
+    fs_->vnode_cache_.Evict(this);
     {
         fbl::AutoLock lock(&fs_->hash_lock_);
         fs_->VnodeReleaseLocked(this);
@@ -1154,6 +1346,16 @@ zx_status_t VnodeMinfs::Close() {
         Purge(wb->txn());
         fs_->EnqueueWork(fbl::move(wb));
     }
+#ifdef __Fuchsia__
+    else if (fd_count_ == 0) {
+        // Most of what a closed vnode holds on to is the data in its VMO.
+        size_t bytes = sizeof(*this);
+        if (vmo_.is_valid()) {
+            bytes += fbl::round_up(inode_.size, kMinfsBlockSize);
+        }
+        fs_->vnode_cache_.Retain(fbl::RefPtr<VnodeMinfs>(this), bytes);
+    }
+#endif
     return ZX_OK;
 }
 
@@ -1182,6 +1384,12 @@ zx_status_t VnodeMinfs::ReadInternal(void* data, size_t len, size_t off, size_t*
         len = inode_.size - off;
     }
 
+    if (IsInline()) {
+        memcpy(data, MinfsInlineData(&inode_) + off, len);
+        *actual = len;
+        return ZX_OK;
+    }
+
     zx_status_t status;
 #ifdef __Fuchsia__
     if ((status = InitVmo()) != ZX_OK) {
@@ -1269,6 +1477,20 @@ zx_status_t VnodeMinfs::WriteInternal(WriteTxn* txn, const void* data,
     }
 
     zx_status_t status;
+    if (IsInline()) {
+        if (off + len <= kMinfsInlineMax) {
+            // Any gap between the old size and |off| is already zero.
+            memcpy(MinfsInlineData(&inode_) + off, data, len);
+            if (off + len > inode_.size) {
+                inode_.size = static_cast<uint32_t>(off + len);
+            }
+            *actual = len;
+            return ZX_OK;
+        } else if ((status = InlinePromote(txn)) != ZX_OK) {
+            return status;
+        }
+    }
+
 #ifdef __Fuchsia__
     if ((status = InitVmo()) != ZX_OK) {
         return status;
@@ -1280,6 +1502,18 @@ zx_status_t VnodeMinfs::WriteInternal(WriteTxn* txn, const void* data,
     uint32_t n = static_cast<uint32_t>(off / kMinfsBlockSize);
     size_t adjust = off % kMinfsBlockSize;
 
+    if (off + len > fbl::round_up(inode_.size, kMinfsBlockSize)) {
+        // This write allocates blocks. Carry on from the end of the file if
+        // there's room there, otherwise find a gap that holds the whole
+        // write, so it goes out as a few large ops rather than many small ones.
+        blk_t last;
+        if (alloc_hint_ == 0 && n > 0 && GetBno(nullptr, n - 1, &last) == ZX_OK && last != 0) {
+            alloc_hint_ = last + 1;
+        }
+        blk_t count = static_cast<blk_t>((off + len - 1) / kMinfsBlockSize - n + 1);
+        alloc_hint_ = fs_->BlockFindRun(alloc_hint_, fbl::min(count, kAllocRunMax));
+    }
+
     while ((len > 0) && (n < kMinfsMaxFileBlock)) {
         size_t xfer;
         if (len > (kMinfsBlockSize - adjust)) {
@@ -1371,7 +1605,7 @@ zx_status_t VnodeMinfs::LookupInternal(fbl::RefPtr<fs::Vnode>* out, fbl::StringP
     DirArgs args = DirArgs();
     args.name = name;
     zx_status_t status;
-    if ((status = ForEachDirent(&args, DirentCallbackFind)) < 0) {
+    if ((status = ForEachNamedDirent(&args, DirentCallbackFind)) < 0) {
         return status;
     }
     fbl::RefPtr<VnodeMinfs> vn;
@@ -1530,6 +1764,9 @@ zx_status_t VnodeMinfs::Allocate(Minfs* fs, uint32_t type, fbl::RefPtr<VnodeMinf
     (*out)->inode_.magic = MinfsMagic(type);
     (*out)->inode_.create_time = (*out)->inode_.modify_time = minfs_gettime_utc();
     (*out)->inode_.link_count = (type == kMinfsTypeDir ? 2 : 1);
+    if (type == kMinfsTypeFile) {
+        (*out)->inode_.flags = kMinfsInodeFlagInline;
+    }
     return ZX_OK;
 }
 
@@ -1560,7 +1797,7 @@ zx_status_t VnodeMinfs::Create(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece nam
     args.name = name;
     // ensure file does not exist
     zx_status_t status;
-    if ((status = ForEachDirent(&args, DirentCallbackFind)) != ZX_ERR_NOT_FOUND) {
+    if ((status = ForEachNamedDirent(&args, DirentCallbackFind)) != ZX_ERR_NOT_FOUND) {
         return ZX_ERR_ALREADY_EXISTS;
     }
 
@@ -1596,7 +1833,7 @@ zx_status_t VnodeMinfs::Create(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece nam
     args.type = type;
     args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(name.length())));
     args.wb = wb.get();
-    if ((status = ForEachDirent(&args, DirentCallbackAppend)) < 0) {
+    if ((status = ForEachDirent(&args, DirentCallbackAppend, dir_free_hint_)) < 0) {
         return status;
     }
 
@@ -1635,6 +1872,14 @@ zx_status_t VnodeMinfs::Ioctl(uint32_t op, const void* in_buf, size_t in_len, vo
             *out_actual = sizeof(vfs_query_info_t) + strlen(kFsName);
             return ZX_OK;
         }
+        case IOCTL_VFS_QUERY_CACHE: {
+            if (out_len < sizeof(vfs_cache_info_t)) {
+                return ZX_ERR_INVALID_ARGS;
+            }
+            fs_->GetCacheInfo(static_cast<vfs_cache_info_t*>(out_buf));
+            *out_actual = sizeof(vfs_cache_info_t);
+            return ZX_OK;
+        }
         case IOCTL_VFS_UNMOUNT_FS: {
             zx_status_t status = Sync();
             if (status != ZX_OK) {
@@ -1679,7 +1924,7 @@ zx_status_t VnodeMinfs::Unlink(fbl::StringPiece name, bool must_be_dir) {
     args.name = name;
     args.type = must_be_dir ? kMinfsTypeDir : 0;
     args.wb = wb.get();
-    zx_status_t status = ForEachDirent(&args, DirentCallbackUnlink);
+    zx_status_t status = ForEachNamedDirent(&args, DirentCallbackUnlink);
     if (status == ZX_OK) {
         wb->PinVnode(fbl::move(fbl::WrapRefPtr(this)));
         fs_->EnqueueWork(fbl::move(wb));
@@ -1710,6 +1955,20 @@ zx_status_t VnodeMinfs::Truncate(size_t len) {
 
 zx_status_t VnodeMinfs::TruncateInternal(WriteTxn* txn, size_t len) {
     zx_status_t r = 0;
+    if (IsInline()) {
+        if (len <= kMinfsInlineMax) {
+            if (len < inode_.size) {
+                memset(MinfsInlineData(&inode_) + len, 0, inode_.size - len);
+            }
+            inode_.size = static_cast<uint32_t>(len);
+            return ZX_OK;
+        } else if (kMinfsMaxFileSize < len) {
+            return ZX_ERR_INVALID_ARGS;
+        } else if ((r = InlinePromote(txn)) != ZX_OK) {
+            return r;
+        }
+    }
+
 #ifdef __Fuchsia__
     // TODO(smklein): We should only init up to 'len'; no need
     // to read in the portion of a large file we plan on deleting.
@@ -1786,6 +2045,51 @@ zx_status_t VnodeMinfs::TruncateInternal(WriteTxn* txn, size_t len) {
     return ZX_OK;
 }
 
+zx_status_t VnodeMinfs::InlinePromote(WriteTxn* txn) {
+    ZX_DEBUG_ASSERT(IsInline());
+    uint8_t inline_data[kMinfsInlineMax];
+    memcpy(inline_data, MinfsInlineData(&inode_), kMinfsInlineMax);
+    auto restore = fbl::MakeAutoCall([this, &inline_data]() {
+        memcpy(MinfsInlineData(&inode_), inline_data, kMinfsInlineMax);
+        inode_.flags |= kMinfsInodeFlagInline;
+    });
+    memset(MinfsInlineData(&inode_), 0, kMinfsInlineMax);
+    inode_.flags &= ~kMinfsInodeFlagInline;
+    if (inode_.size == 0) {
+        restore.cancel();
+        return ZX_OK;
+    }
+
+    zx_status_t status;
+#ifdef __Fuchsia__
+    if ((status = InitVmo()) != ZX_OK) {
+        return status;
+    } else if ((status = VmoWriteExact(inline_data, 0, inode_.size)) != ZX_OK) {
+        vmo_.reset();
+        return status;
+    }
+#endif
+    blk_t bno;
+    if ((status = GetBno(txn, 0, &bno)) != ZX_OK) {
+#ifdef __Fuchsia__
+        vmo_.reset();
+#endif
+        return status;
+    }
+    restore.cancel();
+#ifdef __Fuchsia__
+    txn->Enqueue(vmo_.get(), 0, bno + fs_->info_.dat_block, 1);
+#else
+    char bdata[kMinfsBlockSize];
+    memset(bdata, 0, sizeof(bdata));
+    memcpy(bdata, inline_data, inode_.size);
+    if (fs_->bc_->Writeblk(bno + fs_->info_.dat_block, bdata)) {
+        return ZX_ERR_IO;
+    }
+#endif
+    return ZX_OK;
+}
+
 // Verify that the 'newdir' inode is not a subdirectory of the source.
 zx_status_t VnodeMinfs::CheckNotSubdirectory(fbl::RefPtr<VnodeMinfs> newdir) {
     fbl::RefPtr<VnodeMinfs> vn = newdir;
@@ -1822,7 +2126,7 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
     // acquire the 'oldname' node (it must exist)
     DirArgs args = DirArgs();
     args.name = oldname;
-    if ((status = ForEachDirent(&args, DirentCallbackFind)) < 0) {
+    if ((status = ForEachNamedDirent(&args, DirentCallbackFind)) < 0) {
         return status;
     } else if ((status = fs_->VnodeGet(&oldvn, args.ino)) < 0) {
         return status;
@@ -1846,11 +2150,12 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
     args.name = newname;
     args.ino = oldvn->ino_;
     args.type = oldvn->IsDirectory() ? kMinfsTypeDir : kMinfsTypeFile;
-    status = newdir->ForEachDirent(&args, DirentCallbackAttemptRename);
+    status = newdir->ForEachNamedDirent(&args, DirentCallbackAttemptRename);
     if (status == ZX_ERR_NOT_FOUND) {
         // if 'newname' does not exist, create it
         args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(newname.length())));
-        if ((status = newdir->ForEachDirent(&args, DirentCallbackAppend)) < 0) {
+        if ((status = newdir->ForEachDirent(&args, DirentCallbackAppend,
+                                            newdir->dir_free_hint_)) < 0) {
             return status;
         }
     } else if (status != ZX_OK) {
@@ -1867,7 +2172,7 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
         auto vn = fbl::RefPtr<VnodeMinfs>::Downcast(vn_fs);
         args.name = "..";
         args.ino = newdir->ino_;
-        if ((status = vn->ForEachDirent(&args, DirentCallbackUpdateInode)) < 0) {
+        if ((status = vn->ForEachNamedDirent(&args, DirentCallbackUpdateInode)) < 0) {
             return status;
         }
     }
@@ -1878,7 +2183,7 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
 
     // finally, remove oldname from its original position
     args.name = oldname;
-    status = ForEachDirent(&args, DirentCallbackForceUnlink);
+    status = ForEachNamedDirent(&args, DirentCallbackForceUnlink);
     wb->PinVnode(oldvn);
     wb->PinVnode(newdir);
     fs_->EnqueueWork(fbl::move(wb));
@@ -1905,7 +2210,7 @@ zx_status_t VnodeMinfs::Link(fbl::StringPiece name, fbl::RefPtr<fs::Vnode> _targ
     DirArgs args = DirArgs();
     args.name = name;
     zx_status_t status;
-    if ((status = ForEachDirent(&args, DirentCallbackFind)) != ZX_ERR_NOT_FOUND) {
+    if ((status = ForEachNamedDirent(&args, DirentCallbackFind)) != ZX_ERR_NOT_FOUND) {
         return (status == ZX_OK) ? ZX_ERR_ALREADY_EXISTS : status;
     }
 
@@ -1918,7 +2223,7 @@ zx_status_t VnodeMinfs::Link(fbl::StringPiece name, fbl::RefPtr<fs::Vnode> _targ
     args.type = kMinfsTypeFile; // We can't hard link directories
     args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(name.length())));
     args.wb = wb.get();
-    if ((status = ForEachDirent(&args, DirentCallbackAppend)) < 0) {
+    if ((status = ForEachDirent(&args, DirentCallbackAppend, dir_free_hint_)) < 0) {
         return status;
     }
 
@@ -1937,21 +2242,45 @@ zx_status_t VnodeMinfs::Link(fbl::StringPiece name, fbl::RefPtr<fs::Vnode> _targ
 // when the completion is signalled.
 zx_status_t VnodeMinfs::Sync() {
     TRACE_DURATION("minfs", "VnodeMinfs::Sync");
-    completion_t completion;
+    // The writeback thread flushes the device once for every sync waiting
+    // on it, so concurrent syncs don't each pay for a flush. It holds on to
+    // |request| until then, so wait for it however long it takes.
+    SyncRequest request;
     zx_status_t status;
-    if ((status = fs_->Sync(&completion)) != ZX_OK) {
+    if ((status = fs_->Sync(&request)) != ZX_OK) {
         FS_TRACE_ERROR("VnodeMinfs::Sync fs sync failure: %d\n", status);
         return status;
-    } else if ((status = completion_wait(&completion, ZX_SEC(15))) != ZX_OK) {
+    } else if ((status = completion_wait(&request.completion, ZX_TIME_INFINITE)) != ZX_OK) {
         FS_TRACE_ERROR("VnodeMinfs::Sync Completion wait failure: %d\n", status);
         return status;
-    } else if ((status = fs_->bc_->Sync()) != ZX_OK) {
+    } else if ((status = request.status) != ZX_OK) {
         FS_TRACE_ERROR("VnodeMinfs::Sync block device sync failure: %d\n", status);
         return status;
     }
     return ZX_OK;
 }
 
+bool VnodeMinfs::CanDispatchConcurrently(uint32_t op) {
+    switch (op) {
+    case ZXRIO_READ:
+    case ZXRIO_READ_AT:
+    case ZXRIO_READ_VMO:
+    case ZXRIO_READ_AT_VMO:
+        // Once a file's contents have been read into its VMO, reads only
+        // touch the VMO.
+        return !IsDirectory() && vmo_.is_valid();
+    case ZXRIO_STAT:
+    case ZXRIO_SEEK:
+        return true;
+    case ZXRIO_SYNC:
+        // Syncs only queue up work for the writeback thread, so that those
+        // from many clients can share one flush of the device.
+        return true;
+    default:
+        return false;
+    }
+}
+
 zx_status_t VnodeMinfs::AttachRemote(fs::MountChannel h) {
     if (kMinfsRootIno == ino_) {
         return ZX_ERR_ACCESS_DENIED;
@@ -16,6 +16,7 @@
 #include <fbl/macros.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
 #include <fs/block-txn.h>
 #include <fs/mapped-vmo.h>
 #include <fs/vfs.h>
@@ -66,35 +67,44 @@ zx_status_t WriteTxn::Flush(zx_handle_t vmo, vmoid_t vmoid) {
     ZX_DEBUG_ASSERT(vmo != ZX_HANDLE_INVALID);
     ZX_DEBUG_ASSERT(vmoid != VMOID_INVALID);
 
-    // Update all the outgoing transactions to be in "bytes", not blocks
+    // Actually send the operations to the underlying block device.
     block_fifo_request_t blk_reqs[MAX_TXN_MESSAGES];
+    GetRequests(vmoid, blk_reqs);
+    zx_status_t status = bc_->Txn(blk_reqs, count_);
+    Finish(vmo);
+    return status;
+}
+
+void WriteTxn::GetRequests(vmoid_t vmoid, block_fifo_request_t* out) const {
+    // Update all the outgoing transactions to be in "bytes", not blocks
     for (size_t i = 0; i < count_; i++) {
-        blk_reqs[i].txnid = bc_->TxnId();
-        blk_reqs[i].vmoid = vmoid;
-        blk_reqs[i].opcode = BLOCKIO_WRITE;
-        blk_reqs[i].vmo_offset = requests_[i].vmo_offset * kMinfsBlockSize;
-        blk_reqs[i].dev_offset = requests_[i].dev_offset * kMinfsBlockSize;
-        blk_reqs[i].length = requests_[i].length * kMinfsBlockSize;
+        out[i].txnid = bc_->TxnId();
+        out[i].vmoid = vmoid;
+        out[i].opcode = BLOCKIO_WRITE;
+        out[i].vmo_offset = requests_[i].vmo_offset * kMinfsBlockSize;
+        out[i].dev_offset = requests_[i].dev_offset * kMinfsBlockSize;
+        out[i].length = requests_[i].length * kMinfsBlockSize;
     }
+}
 
-    // Actually send the operations to the underlying block device.
-    zx_status_t status = bc_->Txn(blk_reqs, count_);
-
+void WriteTxn::Finish(zx_handle_t vmo) {
     // Decommit the pages that we used in the buffer to store the outgoing data
     size_t decommit_offset = 0;
     size_t decommit_length = 0;
     for (size_t i = 0; i < count_; i++) {
-        if (i == 0 || blk_reqs[i].vmo_offset != decommit_offset + blk_reqs[i - 1].length) {
+        size_t offset = requests_[i].vmo_offset * kMinfsBlockSize;
+        size_t length = requests_[i].length * kMinfsBlockSize;
+        if (i == 0 || offset != decommit_offset + decommit_length) {
             // Reset case, either because we're initializing or because we have
             // found a request at a noncontiguous offset (it wrapped around).
             if (decommit_length != 0) {
                 ZX_ASSERT(zx_vmo_op_range(vmo, ZX_VMO_OP_DECOMMIT, decommit_offset,
                                           decommit_length, nullptr, 0) == ZX_OK);
             }
-            decommit_offset = blk_reqs[i].vmo_offset;
-            decommit_length = blk_reqs[i].length;
+            decommit_offset = offset;
+            decommit_length = length;
         } else {
-            decommit_length += blk_reqs[i].length;
+            decommit_length += length;
         }
     }
     if (decommit_length != 0) {
@@ -103,7 +113,6 @@ zx_status_t WriteTxn::Flush(zx_handle_t vmo, vmoid_t vmoid) {
     }
 
     count_ = 0;
-    return status;
 }
 
 size_t WriteTxn::BlkCount() const {
@@ -114,17 +123,57 @@ size_t WriteTxn::BlkCount() const {
     return blocks_needed;
 }
 
+void WriteTxn::EnqueueTrim(uint64_t absolute_block, uint64_t nblocks) {
+    for (size_t i = 0; i < trims_.size(); i++) {
+        if (trims_[i].dev_offset + trims_[i].length == absolute_block) {
+            trims_[i].length += nblocks;
+            return;
+        } else if (absolute_block + nblocks == trims_[i].dev_offset) {
+            trims_[i].dev_offset = absolute_block;
+            trims_[i].length += nblocks;
+            return;
+        }
+    }
+    fbl::AllocChecker ac;
+    trims_.push_back({absolute_block, nblocks}, &ac);
+}
+
+zx_status_t WriteTxn::FlushTrims() {
+    zx_status_t status = ZX_OK;
+    block_fifo_request_t blk_reqs[MAX_TXN_MESSAGES];
+    size_t i = 0;
+    while (i < trims_.size()) {
+        size_t n = fbl::min(trims_.size() - i, static_cast<size_t>(MAX_TXN_MESSAGES));
+        for (size_t j = 0; j < n; j++) {
+            blk_reqs[j].txnid = bc_->TxnId();
+            blk_reqs[j].vmoid = VMOID_INVALID;
+            blk_reqs[j].opcode = BLOCKIO_TRIM;
+            blk_reqs[j].vmo_offset = 0;
+            blk_reqs[j].dev_offset = trims_[i + j].dev_offset * kMinfsBlockSize;
+            blk_reqs[j].length = trims_[i + j].length * kMinfsBlockSize;
+        }
+        zx_status_t r = bc_->Txn(blk_reqs, n);
+        if (r != ZX_OK) {
+            status = r;
+        }
+        i += n;
+    }
+    trims_.reset();
+    return status;
+}
+
 #endif  // __Fuchsia__
 
 WritebackWork::WritebackWork(Bcache* bc) :
 #ifdef __Fuchsia__
-    completion_(nullptr),
+    completion_(nullptr), sync_(nullptr),
 #endif
     txn_(bc), node_count_(0) {}
 
 void WritebackWork::Reset() {
 #ifdef __Fuchsia__
     ZX_DEBUG_ASSERT(txn_.Count() == 0);
+    ZX_DEBUG_ASSERT(sync_ == nullptr);
     completion_ = nullptr;
 #endif
     while (0 < node_count_) {
@@ -135,9 +184,9 @@ void WritebackWork::Reset() {
 #ifdef __Fuchsia__
 // Returns the number of blocks of the writeback buffer that have been
 // consumed
-size_t WritebackWork::Complete(zx_handle_t vmo, vmoid_t vmoid) {
+size_t WritebackWork::Complete(zx_handle_t vmo) {
     size_t blk_count = txn_.BlkCount();
-    txn_.Flush(vmo, vmoid);
+    txn_.Finish(vmo);
     if (completion_ != nullptr) {
         completion_signal(completion_);
     }
@@ -149,6 +198,17 @@ void WritebackWork::SetCompletion(completion_t* completion) {
     ZX_DEBUG_ASSERT(completion_ == nullptr);
     completion_ = completion;
 }
+
+void WritebackWork::SetSyncRequest(SyncRequest* request) {
+    ZX_DEBUG_ASSERT(sync_ == nullptr);
+    sync_ = request;
+}
+
+SyncRequest* WritebackWork::TakeSyncRequest() {
+    SyncRequest* request = sync_;
+    sync_ = nullptr;
+    return request;
+}
 #else
 void WritebackWork::Complete() {
     txn_.Flush();
@@ -223,18 +283,28 @@ zx_status_t WritebackBuffer::EnsureSpaceLocked(size_t blocks) {
         // for this request.
         return ZX_ERR_NO_RESOURCES;
     }
-    while (len_ + blocks > cap_) {
-        // Not enough room to write back work, yet. Wait until
-        // room is available.
+    if (len_ + blocks > cap_ || !producer_queue_.is_empty()) {
+        // Not enough room to write back work, yet, or others are already
+        // waiting for it. Wait until room is available. The writeback thread
+        // makes room as each batch of work goes out, not just once the buffer
+        // has drained.
+        TRACE_DURATION("minfs", "WritebackBuffer::EnsureSpaceLocked::Stall");
+        zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
         Waiter w;
         producer_queue_.push(&w);
 
-        do {
+        while ((&producer_queue_.front() != &w) || // We are first in line to enqueue...
+               (len_ + blocks > cap_)) { // ... and there is enough space for us.
             cnd_wait(&producer_cvar_, writeback_lock_.GetInternal());
-        } while ((&producer_queue_.front() != &w) && // We are first in line to enqueue...
-                 (len_ + blocks > cap_)); // ... and there is enough space for us.
+        }
 
         producer_queue_.pop();
+        if (!producer_queue_.is_empty()) {
+            // Let the next in line see whether what's left is enough for it.
+            cnd_broadcast(&producer_cvar_);
+        }
+        stalls_++;
+        stall_time_ += zx_time_get(ZX_CLOCK_MONOTONIC) - start;
     }
     return ZX_OK;
 }
@@ -331,34 +401,131 @@ void WritebackBuffer::Enqueue(fbl::unique_ptr<WritebackWork> work) {
         CopyToBufferLocked(work->txn());
     }
 
+    peak_len_ = fbl::max(peak_len_, len_);
     work_queue_.push(fbl::move(work));
     cnd_signal(&consumer_cvar_);
 }
 
+void WritebackBuffer::GetInfo(vfs_cache_info_t* info) {
+    fbl::AutoLock lock(&writeback_lock_);
+    info->writeback_capacity = static_cast<uint32_t>(cap_);
+    info->writeback_used = static_cast<uint32_t>(len_);
+    info->writeback_peak = static_cast<uint32_t>(peak_len_);
+    info->writeback_stalls = stalls_;
+    info->writeback_stall_ns = stall_time_;
+}
+
+size_t WritebackBuffer::PopBatchLocked(fbl::unique_ptr<WritebackWork>* out, size_t max) {
+    size_t count = 0;
+    size_t requests = 0;
+    while (count < max && !work_queue_.is_empty()) {
+        size_t next = work_queue_.front().txn()->Count();
+        if (count != 0 && requests + next > MAX_TXN_MESSAGES) {
+            break;
+        }
+        requests += next;
+        out[count++] = work_queue_.pop();
+    }
+    return count;
+}
+
+// The most units of work sent to the device in a single block transaction.
+constexpr size_t kMaxWorkBatch = 16;
+
+// The most units of work written out after a sync arrives before the device is
+// flushed for it. Until then, later syncs can join the same flush.
+constexpr size_t kMaxSyncBatch = 32;
+
+void WritebackBuffer::FlushSyncs(fbl::SinglyLinkedList<SyncRequest*>* syncs,
+                                 zx_status_t write_status) {
+    TRACE_DURATION("minfs", "WritebackBuffer::FlushSyncs");
+    zx_status_t status = write_status;
+    if (bc_->Sync() != 0 && status == ZX_OK) {
+        status = ZX_ERR_IO;
+    }
+    while (!syncs->is_empty()) {
+        // The waiter may go away as soon as it is signalled.
+        SyncRequest* request = syncs->pop_front();
+        request->status = status;
+        completion_signal(&request->completion);
+    }
+}
+
 int WritebackBuffer::WritebackThread(void* arg) {
     WritebackBuffer* b = reinterpret_cast<WritebackBuffer*>(arg);
 
+    // Syncs waiting for the device to be flushed, and how the writes since
+    // the first of them went.
+    fbl::SinglyLinkedList<SyncRequest*> syncs;
+    zx_status_t write_status = ZX_OK;
+    size_t batch = 0;
+
     b->writeback_lock_.Acquire();
     while (true) {
         while (!b->work_queue_.is_empty()) {
-            auto work = b->work_queue_.pop();
             TRACE_DURATION("minfs", "WritebackBuffer::WritebackThread");
 
-            // Stay unlocked while processing a unit of work
+            // Send as much of the queue as fits in one block transaction, so
+            // the device has several units of work in flight at once rather
+            // than one round trip for each.
+            fbl::unique_ptr<WritebackWork> works[kMaxWorkBatch];
+            size_t count = b->PopBatchLocked(works, fbl::count_of(works));
+
+            // Stay unlocked while processing the batch
             b->writeback_lock_.Release();
 
             // TODO(smklein): We could add additional validation that the blocks
             // in "work" are contiguous and in the range of [start_, len_) (including
             // wraparound).
-            size_t blks_consumed = work->Complete(b->buffer_->GetVmo(), b->buffer_vmoid_);
-            TRACE_FLOW_END("minfs", "writeback", reinterpret_cast<trace_flow_id_t>(work.get()));
-            work = nullptr;
+            block_fifo_request_t requests[MAX_TXN_MESSAGES];
+            size_t request_count = 0;
+            for (size_t i = 0; i < count; i++) {
+                works[i]->txn()->GetRequests(b->buffer_vmoid_, &requests[request_count]);
+                request_count += works[i]->txn()->Count();
+            }
+            zx_status_t status = ZX_OK;
+            if (request_count != 0) {
+                status = b->bc_->Txn(requests, request_count);
+            }
+            if (status != ZX_OK) {
+                write_status = status;
+            }
+
+            size_t blks_consumed = 0;
+            for (size_t i = 0; i < count; i++) {
+                SyncRequest* sync = works[i]->TakeSyncRequest();
+                if (sync != nullptr) {
+                    syncs.push_front(sync);
+                }
+                blks_consumed += works[i]->Complete(b->buffer_->GetVmo());
+                TRACE_FLOW_END("minfs", "writeback",
+                               reinterpret_cast<trace_flow_id_t>(works[i].get()));
+                works[i] = nullptr;
+            }
 
-            // Relock before checking the state of the queue
+            // Relock before checking the state of the queue, and let the
+            // producers know there is room again.
             b->writeback_lock_.Acquire();
             b->start_ = (b->start_ + blks_consumed) % b->cap_;
             b->len_ -= blks_consumed;
-            cnd_signal(&b->producer_cvar_);
+            cnd_broadcast(&b->producer_cvar_);
+
+            if (syncs.is_empty()) {
+                write_status = ZX_OK;
+            } else if ((batch += count) >= kMaxSyncBatch) {
+                break;
+            }
+        }
+
+        // Everything that was waiting has been written out; one flush makes
+        // all of it durable.
+        if (!syncs.is_empty()) {
+            b->writeback_lock_.Release();
+            b->FlushSyncs(&syncs, write_status);
+            write_status = ZX_OK;
+            batch = 0;
+            b->writeback_lock_.Acquire();
+            continue;
         }
 
         // Before waiting, we should check if we're unmounting.
@@ -0,0 +1,103 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <fbl/function.h>
+#include <zircon/types.h>
+
+// A harness for microbenchmarks. A test runs the operation it measures once
+// for each time KeepRunning() returns true:
+//
+//   bool NullSyscallTest(perftest::RepeatState* state) {
+//       while (state->KeepRunning()) {
+//           if (zx_syscall_test_0() != ZX_OK)
+//               return false;
+//       }
+//       return true;
+//   }
+//
+//   void RegisterTests() {
+//       perftest::RegisterTest("Syscall/Null", NullSyscallTest);
+//   }
+//   PERFTEST_CTOR(RegisterTests);
+//
+// Each test first runs untimed for a while to warm up caches and the cpu's
+// clock, which also gives an estimate of how long an iteration takes. That
+// decides how many iterations the timed run does. Each of those is timed on
+// its own, from one KeepRunning() call to the next, and the times are
+// summarized as below.
+
+namespace perftest {
+
+class RepeatState {
+public:
+    // Returns false once the test has done all its iterations. The test
+    // must keep going until then, and not return early.
+    virtual bool KeepRunning() = 0;
+};
+
+// Returns false if the test failed.
+using TestFunc = fbl::Function<bool(RepeatState* state)>;
+
+// Adds a test for RunTests() to run. Names are like "Vmo/CreateClose".
+void RegisterTest(const char* name, TestFunc test_func);
+
+// Registers a test that is one call of |Func| for each iteration.
+template <bool (*Func)()>
+void RegisterSimpleTest(const char* name) {
+    RegisterTest(name, [](RepeatState* state) {
+        while (state->KeepRunning()) {
+            if (!Func())
+                return false;
+        }
+        return true;
+    });
+}
+
+// Statistics over a test's iteration times, in nanoseconds.
+struct Summary {
+    uint64_t iterations;
+    double min;
+    double max;
+    double mean;
+    double std_dev;
+    double median;
+    double p99;
+};
+
+// Summarizes |count| iteration times, sorting |times_ns| while at it.
+void Summarize(uint64_t* times_ns, size_t count, Summary* summary);
+
+struct RunOptions {
+    // How long each test runs untimed before the timed run.
+    zx_duration_t warmup_time = ZX_MSEC(10);
+    // How long each test's timed run should take, within the bounds of
+    // |min_iterations| and |max_iterations|.
+    zx_duration_t target_time = ZX_MSEC(100);
+    uint32_t min_iterations = 10;
+    uint32_t max_iterations = 1000000;
+    // If set, only the tests whose names contain this are run.
+    const char* filter = nullptr;
+};
+
+// Runs one test. Returns false if it failed.
+bool RunTest(TestFunc* test_func, const RunOptions& options, Summary* summary);
+
+// Runs the registered tests, printing a line for each to |log|, and writing
+// all their summaries to |json| as a JSON array if it is not null. Returns
+// false if any test failed.
+bool RunTests(const RunOptions& options, FILE* log, FILE* json);
+
+// A main() for a binary of tests, taking options for RunTests().
+int PerfTestMain(int argc, char** argv);
+
+} // namespace perftest
+
+// Runs |func|, which registers tests, before main().
+#define PERFTEST_CTOR(func) \
+    __attribute__((constructor)) static void func##_perftest_ctor() { func(); }
@@ -0,0 +1,260 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <perftest/perftest.h>
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
+#include <zircon/syscalls.h>
+
+namespace perftest {
+namespace {
+
+struct NamedTest {
+    const char* name;
+    TestFunc test_func;
+};
+
+// Tests are registered from static constructors, which may run before this
+// file's own, so the list is made on first use.
+fbl::Vector<NamedTest>* registered_tests() {
+    static fbl::Vector<NamedTest>* tests = new fbl::Vector<NamedTest>;
+    return tests;
+}
+
+uint64_t ticks_to_ns(uint64_t ticks) {
+    return static_cast<uint64_t>(static_cast<__uint128_t>(ticks) * ZX_SEC(1) /
+                                 zx_ticks_per_second());
+}
+
+uint64_t ns_to_ticks(zx_duration_t ns) {
+    return static_cast<uint64_t>(static_cast<__uint128_t>(ns) * zx_ticks_per_second() /
+                                 ZX_SEC(1));
+}
+
+// Lets a test run until it has done |max_iterations|, or until |limit_ticks|
+// have passed, but always at least one iteration. If |timestamps| is given,
+// it gets the time at the start of each iteration and after the last one.
+class RepeatStateImpl : public RepeatState {
+public:
+    RepeatStateImpl(uint64_t max_iterations, uint64_t limit_ticks, uint64_t* timestamps)
+        : max_iterations_(max_iterations), limit_ticks_(limit_ticks),
+          timestamps_(timestamps) {}
+
+    bool KeepRunning() override {
+        uint64_t now = zx_ticks_get();
+        if (timestamps_)
+            timestamps_[iterations_] = now;
+        if (iterations_ == 0) {
+            start_ = now;
+        } else if (iterations_ == max_iterations_ || now - start_ >= limit_ticks_) {
+            finished_ = true;
+            end_ = now;
+            return false;
+        }
+        iterations_++;
+        return true;
+    }
+
+    uint64_t iterations() const { return iterations_; }
+    uint64_t elapsed_ticks() const { return end_ - start_; }
+    bool finished() const { return finished_; }
+
+private:
+    const uint64_t max_iterations_;
+    const uint64_t limit_ticks_;
+    uint64_t* const timestamps_;
+    uint64_t iterations_ = 0;
+    uint64_t start_ = 0;
+    uint64_t end_ = 0;
+    bool finished_ = false;
+};
+
+bool run_once(const char* what, TestFunc* test_func, RepeatStateImpl* state) {
+    if (!(*test_func)(state)) {
+        fprintf(stderr, "perftest: test failed during %s\n", what);
+        return false;
+    }
+    if (!state->finished()) {
+        fprintf(stderr, "perftest: test returned before KeepRunning() returned false during %s\n",
+                what);
+        return false;
+    }
+    return true;
+}
+
+int compare_u64(const void* a, const void* b) {
+    uint64_t va = *static_cast<const uint64_t*>(a);
+    uint64_t vb = *static_cast<const uint64_t*>(b);
+    return va < vb ? -1 : va > vb;
+}
+
+} // namespace
+
+void RegisterTest(const char* name, TestFunc test_func) {
+    registered_tests()->push_back(NamedTest{name, fbl::move(test_func)});
+}
+
+void Summarize(uint64_t* times_ns, size_t count, Summary* summary) {
+    *summary = {};
+    summary->iterations = count;
+    if (count == 0)
+        return;
+
+    qsort(times_ns, count, sizeof(times_ns[0]), compare_u64);
+
+    double sum = 0;
+    for (size_t i = 0; i < count; i++)
+        sum += static_cast<double>(times_ns[i]);
+    summary->mean = sum / static_cast<double>(count);
+
+    double sum_sq = 0;
+    for (size_t i = 0; i < count; i++) {
+        double d = static_cast<double>(times_ns[i]) - summary->mean;
+        sum_sq += d * d;
+    }
+    summary->std_dev = sqrt(sum_sq / static_cast<double>(count));
+
+    summary->min = static_cast<double>(times_ns[0]);
+    summary->max = static_cast<double>(times_ns[count - 1]);
+    summary->median = (count % 2)
+                          ? static_cast<double>(times_ns[count / 2])
+                          : (static_cast<double>(times_ns[count / 2 - 1]) +
+                             static_cast<double>(times_ns[count / 2])) / 2;
+    summary->p99 = static_cast<double>(times_ns[fbl::min(count * 99 / 100, count - 1)]);
+}
+
+bool RunTest(TestFunc* test_func, const RunOptions& options, Summary* summary) {
+    // Warm up, and see how many iterations fit in the target time.
+    RepeatStateImpl warmup(options.max_iterations, ns_to_ticks(options.warmup_time), nullptr);
+    if (!run_once("warm-up", test_func, &warmup))
+        return false;
+    uint64_t per_iteration = fbl::max<uint64_t>(ticks_to_ns(warmup.elapsed_ticks()) /
+                                                    warmup.iterations(), 1u);
+    uint64_t iterations = fbl::clamp<uint64_t>(options.target_time / per_iteration,
+                                               options.min_iterations, options.max_iterations);
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint64_t[]> timestamps(new (&ac) uint64_t[iterations + 1]);
+    if (!ac.check()) {
+        fprintf(stderr, "perftest: no memory for %" PRIu64 " iterations\n", iterations);
+        return false;
+    }
+
+    RepeatStateImpl timed(iterations, UINT64_MAX, timestamps.get());
+    if (!run_once("timed run", test_func, &timed))
+        return false;
+
+    // Each iteration's time, in place of its start time.
+    for (uint64_t i = 0; i < iterations; i++)
+        timestamps[i] = ticks_to_ns(timestamps[i + 1] - timestamps[i]);
+    Summarize(timestamps.get(), iterations, summary);
+    return true;
+}
+
+bool RunTests(const RunOptions& options, FILE* log, FILE* json) {
+    bool ok = true;
+    bool first = true;
+
+    if (json)
+        fprintf(json, "[");
+    fprintf(log, "%-40s %10s %10s %10s %10s %10s %10s %10s\n", "test (times in ns)",
+            "iterations", "mean", "std dev", "median", "p99", "min", "max");
+
+    for (NamedTest& test : *registered_tests()) {
+        if (options.filter && !strstr(test.name, options.filter))
+            continue;
+
+        Summary s;
+        if (!RunTest(&test.test_func, options, &s)) {
+            fprintf(log, "%-40s FAILED\n", test.name);
+            ok = false;
+            continue;
+        }
+        fprintf(log, "%-40s %10" PRIu64 " %10.0f %10.0f %10.0f %10.0f %10.0f %10.0f\n",
+                test.name, s.iterations, s.mean, s.std_dev, s.median, s.p99, s.min, s.max);
+        if (json) {
+            fprintf(json, "%s\n  {\"label\": \"%s\", \"unit\": \"nanoseconds\", "
+                          "\"iterations\": %" PRIu64 ", \"mean\": %.1f, \"std_dev\": %.1f, "
+                          "\"median\": %.1f, \"p99\": %.1f, \"min\": %.1f, \"max\": %.1f}",
+                    first ? "" : ",", test.name, s.iterations, s.mean, s.std_dev, s.median,
+                    s.p99, s.min, s.max);
+            first = false;
+        }
+    }
+
+    if (json)
+        fprintf(json, "\n]\n");
+    return ok;
+}
+
+int PerfTestMain(int argc, char** argv) {
+    static constexpr char help[] =
+        "Usage: %s [options ...]\n"
+        "\n"
+        "Options:\n"
+        "  -h          show help (this)\n"
+        "  -f FILTER   only run tests whose names contain FILTER\n"
+        "  -o FILE     write the results to FILE as JSON\n"
+        "  -t MS       run each test for about MS milliseconds (default: 100)\n"
+        "  -w MS       warm each test up for MS milliseconds first (default: 10)\n";
+
+    RunOptions options;
+    const char* json_path = nullptr;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "hf:o:t:w:")) != -1) {
+        switch (opt) {
+        case 'h':
+            printf(help, argv[0]);
+            return 0;
+        case 'f':
+            options.filter = optarg;
+            break;
+        case 'o':
+            json_path = optarg;
+            break;
+        case 't':
+        case 'w': {
+            char* end;
+            errno = 0;
+            unsigned long ms = strtoul(optarg, &end, 10);
+            if (errno != 0 || *end != '\0' || ms == 0) {
+                fprintf(stderr, "%s: invalid time: %s\n", argv[0], optarg);
+                return 1;
+            }
+            (opt == 't' ? options.target_time : options.warmup_time) = ZX_MSEC(ms);
+            break;
+        }
+        default:
+            fprintf(stderr, "Run with -h for help.\n");
+            return 1;
+        }
+    }
+
+    FILE* json = nullptr;
+    if (json_path && !(json = fopen(json_path, "w"))) {
+        fprintf(stderr, "%s: cannot open %s: %s\n", argv[0], json_path, strerror(errno));
+        return 1;
+    }
+
+    bool ok = RunTests(options, stdout, json);
+
+    if (json && fclose(json) != 0) {
+        fprintf(stderr, "%s: error writing %s\n", argv[0], json_path);
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}
+
+} // namespace perftest
@@ -261,6 +261,36 @@ public:
             static WAVLTreeNodeState& node_state(Region& r) { return r.ns_tree_sort_by_size_; }
         };
 
+        // Keeps |subtree_max_align_| current as the size index changes shape.
+        // A region's base and size never change while it is in the size
+        // index, so the structural hooks are all that is needed.
+        struct WAVLTreeObserverSortBySize
+            : public fbl::tests::intrusive_containers::DefaultWAVLTreeObserver {
+            template <typename Iter>
+            static void RecordSubtreeChange(Iter node) {
+                for (; node.IsValid(); node = node.parent())
+                    UpdateSubtreeMaxAlign(node);
+            }
+
+            template <typename Iter>
+            static void RecordRotation(Iter child, Iter parent) {
+                UpdateSubtreeMaxAlign(child);
+                UpdateSubtreeMaxAlign(parent);
+            }
+
+            template <typename Iter>
+            static void UpdateSubtreeMaxAlign(Iter node) {
+                uint64_t max_align = MaxAlignment(*node);
+                Iter left = node.left();
+                if (left.IsValid() && (left->subtree_max_align_ > max_align))
+                    max_align = left->subtree_max_align_;
+                Iter right = node.right();
+                if (right.IsValid() && (right->subtree_max_align_ > max_align))
+                    max_align = right->subtree_max_align_;
+                node->subtree_max_align_ = max_align;
+            }
+        };
+
         struct KeyTraitsSortBySize {
             static const ralloc_region_t& GetKey(const Region& r) { return r; }
 
@@ -278,11 +308,25 @@ public:
                                                   WAVLTreeNodeTraitsSortByBase>;
         using WAVLTreeSortBySize = fbl::WAVLTree<ralloc_region_t, Region*,
                                                   KeyTraitsSortBySize,
-                                                  WAVLTreeNodeTraitsSortBySize>;
+                                                  WAVLTreeNodeTraitsSortBySize,
+                                                  WAVLTreeObserverSortBySize>;
 
         // Used by SortByBase key traits
         uint64_t GetKey() const { return base; }
 
+        // The largest power of two which divides the address of at least one
+        // byte of the region.  No allocation with a larger alignment can come
+        // from this region.
+        static uint64_t MaxAlignment(const ralloc_region_t& r) {
+            if (r.base == 0)
+                return static_cast<uint64_t>(1) << 63;
+
+            // [base, last] holds a multiple of 2^k iff (base - 1) and last
+            // differ somewhere at or above bit k.
+            uint64_t last = r.base + r.size - 1;
+            return static_cast<uint64_t>(1) << (63 - __builtin_clzll((r.base - 1) ^ last));
+        }
+
         // So many friends!  I'm the most popular class in the build!!
         friend class  RegionAllocator;
         friend class  RegionPool;
@@ -292,6 +336,7 @@ public:
         friend struct KeyTraitsSortBySize;
         friend struct WAVLTreeNodeTraitsSortByBase;
         friend struct WAVLTreeNodeTraitsSortBySize;
+        friend struct WAVLTreeObserverSortBySize;
 
         // Regions can only be placement new'ed by the RegionPool slab
         // allocator.  They cannot be copied, assigned, or deleted.  Externally,
@@ -314,6 +359,11 @@ public:
         RegionAllocator* owner_;
         WAVLTreeNodeState ns_tree_sort_by_base_;
         WAVLTreeNodeState ns_tree_sort_by_size_;
+
+        // The largest MaxAlignment() of any region in this region's subtree of
+        // the size index.  Lets GetRegion skip subtrees which cannot satisfy
+        // an aligned request without visiting them.
+        uint64_t subtree_max_align_ = 0;
     };
 
     class RegionPool : public fbl::RefCounted<RegionPool>,
@@ -436,6 +486,28 @@ public:
     // currently available regions which can satisfy the request.
     zx_status_t GetRegion(const ralloc_region_t& requested_region, Region::UPtr& out_region);
 
+    // A size/alignment pair for GetRegions.  As with GetRegion, the alignment
+    // must be a power of two.
+    struct SizeRequest {
+        uint64_t size;
+        uint64_t alignment;
+    };
+
+    // Get a batch of regions out of the set of currently available regions, one
+    // for each of the |count| requests, in order.  out_regions[i] receives the
+    // region for requests[i], and must be empty on entry.  The batch is all or
+    // nothing; if any request cannot be satisfied, the regions already taken
+    // for the batch are returned and every entry of |out_regions| is left
+    // empty.
+    //
+    // The allocator's lock is held once for the whole batch, which makes this
+    // cheaper than |count| calls to GetRegion for users which reserve many
+    // ranges at once.
+    //
+    // Possible return values are the same as for size/alignment based
+    // GetRegion.
+    zx_status_t GetRegions(const SizeRequest* requests, size_t count, Region::UPtr* out_regions);
+
     // Helper which defaults the alignment of a size/alignment based allocation
     // to pointer-aligned.
     zx_status_t GetRegion(uint64_t size, Region::UPtr& out_region) {
@@ -475,7 +547,9 @@ public:
 
 private:
     zx_status_t AddSubtractSanityCheckLocked(const ralloc_region_t& region);
+    zx_status_t GetRegionLocked(uint64_t size, uint64_t alignment, Region::UPtr& out_region);
     void ReleaseRegion(Region* region);
+    void ReleaseRegionLocked(Region* region);
     void AddRegionToAvailLocked(Region* region, bool allow_overlap = false);
 
     zx_status_t AllocFromAvailLocked(Region::WAVLTreeSortBySize::iterator source,
@@ -483,6 +557,15 @@ private:
                                      uint64_t base,
                                      uint64_t size);
 
+    // Find the first region in the size index, at or below |node|, which can
+    // hold |size| bytes at the given alignment.  Returns the aligned base of
+    // the allocation in |out_base|.
+    static Region::WAVLTreeSortBySize::iterator FindBySizeLocked(
+            Region::WAVLTreeSortBySize::iterator node,
+            uint64_t size,
+            uint64_t alignment,
+            uint64_t* out_base);
+
     static bool IntersectsLocked(const Region::WAVLTreeSortByBase& tree,
                                  const ralloc_region_t& region);
 
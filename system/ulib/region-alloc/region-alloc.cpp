@@ -282,43 +282,92 @@ zx_status_t RegionAllocator::GetRegion(uint64_t size,
     if (region_pool_ == nullptr)
         return ZX_ERR_BAD_STATE;
 
-    // Sanity check the arguments.
     out_region = nullptr;
-    if (!size || !alignment || !fbl::is_pow2(alignment))
+    return GetRegionLocked(size, alignment, out_region);
+}
+
+zx_status_t RegionAllocator::GetRegions(const SizeRequest* requests,
+                                        size_t count,
+                                        Region::UPtr* out_regions) {
+    fbl::AutoLock alloc_lock(&alloc_lock_);
+
+    // Check our RegionPool
+    if (region_pool_ == nullptr)
+        return ZX_ERR_BAD_STATE;
+
+    if (count && (!requests || !out_regions))
         return ZX_ERR_INVALID_ARGS;
 
-    // Compute the things we will need round-up align base addresses.
-    uint64_t mask     = alignment - 1;
-    uint64_t inv_mask = ~mask;
+    for (size_t i = 0; i < count; ++i) {
+        // Regions handed back to the caller would be released through
+        // ReleaseRegion, which takes the lock we are holding.
+        ZX_DEBUG_ASSERT(out_regions[i] == nullptr);
+
+        zx_status_t res = GetRegionLocked(requests[i].size, requests[i].alignment, out_regions[i]);
+        if (res != ZX_OK) {
+            // Undo the batch, newest first, so that each region merges back
+            // into the space it was carved out of.
+            while (i-- > 0) {
+                Region* region = const_cast<Region*>(out_regions[i].release());
+                ReleaseRegionLocked(region);
+            }
+            return res;
+        }
+    }
 
-    // Start by using our size index to look up the first available region which
-    // is large enough to hold this allocation (if any)
-    auto iter = avail_regions_by_size_.lower_bound({ .base = 0, .size = size });
+    return ZX_OK;
+}
 
-    // Consider all of the regions which are large enough to hold our
-    // allocation.  Stop as soon as we find one which can satisfy the alignment
-    // restrictions.
+zx_status_t RegionAllocator::GetRegionLocked(uint64_t size,
+                                             uint64_t alignment,
+                                             Region::UPtr& out_region) {
+    // Sanity check the arguments.
+    if (!size || !alignment || !fbl::is_pow2(alignment))
+        return ZX_ERR_INVALID_ARGS;
+
+    // Find the smallest available region (ties going to the lowest base
+    // address) which can hold this allocation once its base has been aligned.
     uint64_t aligned_base;
-    while (iter.IsValid()) {
-        ZX_DEBUG_ASSERT(iter->size >= size);
-        aligned_base = (iter->base + mask) & inv_mask;
-        uint64_t overhead = aligned_base - iter->base;
-        uint64_t leftover = iter->size - size;
+    auto iter = FindBySizeLocked(avail_regions_by_size_.root(), size, alignment, &aligned_base);
+    if (!iter.IsValid())
+        return ZX_ERR_NOT_FOUND;
+
+    return AllocFromAvailLocked(iter, out_region, aligned_base, size);
+}
+
+RegionAllocator::Region::WAVLTreeSortBySize::iterator RegionAllocator::FindBySizeLocked(
+        Region::WAVLTreeSortBySize::iterator node,
+        uint64_t size,
+        uint64_t alignment,
+        uint64_t* out_base) {
+    // Nothing in this subtree has an address with the alignment we need, so
+    // nothing in it can satisfy the request.
+    if (!node.IsValid() || (node->subtree_max_align_ < alignment))
+        return Region::WAVLTreeSortBySize::iterator();
+
+    // Everything to the left of a region which is too small is also too
+    // small, so only look left if this region is large enough.  Regions to the
+    // left come first in the size index, so they are the better fit.
+    if (node->size >= size) {
+        auto iter = FindBySizeLocked(node.left(), size, alignment, out_base);
+        if (iter.IsValid())
+            return iter;
 
         // We have a usable region if the aligned base address has not wrapped
         // the address space, and if overhead required to align the allocation
         // is not larger than what is leftover in the region after performing
         // the allocation.
-        if ((aligned_base >= iter->base) && (overhead <= leftover))
-            break;
-
-        ++iter;
+        uint64_t mask         = alignment - 1;
+        uint64_t aligned_base = (node->base + mask) & ~mask;
+        uint64_t overhead     = aligned_base - node->base;
+        uint64_t leftover     = node->size - size;
+        if ((aligned_base >= node->base) && (overhead <= leftover)) {
+            *out_base = aligned_base;
+            return node;
+        }
     }
 
-    if (!iter.IsValid())
-        return ZX_ERR_NOT_FOUND;
-
-    return AllocFromAvailLocked(iter, out_region, aligned_base, size);
+    return FindBySizeLocked(node.right(), size, alignment, out_base);
 }
 
 zx_status_t RegionAllocator::GetRegion(const ralloc_region_t& requested_region,
@@ -392,7 +441,10 @@ zx_status_t RegionAllocator::AddSubtractSanityCheckLocked(const ralloc_region_t&
 
 void RegionAllocator::ReleaseRegion(Region* region) {
     fbl::AutoLock alloc_lock(&alloc_lock_);
+    ReleaseRegionLocked(region);
+}
 
+void RegionAllocator::ReleaseRegionLocked(Region* region) {
     ZX_DEBUG_ASSERT(region != nullptr);
 
     // When a region comes back from a user, it should be in the
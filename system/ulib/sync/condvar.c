@@ -0,0 +1,55 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <sync/condvar.h>
+
+#include <limits.h>
+#include <zircon/syscalls.h>
+#include <stdatomic.h>
+
+zx_status_t sync_condvar_timedwait(sync_condvar_t* condvar, sync_mutex_t* mutex,
+                                   zx_time_t deadline) {
+    atomic_int* seq = &condvar->seq.futex;
+    int old_seq = atomic_load(seq);
+    __atomic_store_n(&condvar->mutex, mutex, __ATOMIC_RELAXED);
+
+    sync_mutex_unlock(mutex);
+    zx_status_t status = _zx_futex_wait(seq, old_seq, deadline);
+
+    // We may have been requeued onto the mutex's futex, in which case the
+    // threads requeued with us are only woken by unlocks of a mutex that is
+    // marked as having waiters.
+    sync_mutex_lock_with_waiter(mutex);
+
+    return status == ZX_ERR_TIMED_OUT ? ZX_ERR_TIMED_OUT : ZX_OK;
+}
+
+void sync_condvar_wait(sync_condvar_t* condvar, sync_mutex_t* mutex) {
+    sync_condvar_timedwait(condvar, mutex, ZX_TIME_INFINITE);
+}
+
+void sync_condvar_signal(sync_condvar_t* condvar) {
+    atomic_fetch_add(&condvar->seq.futex, 1);
+    _zx_futex_wake(&condvar->seq.futex, 1);
+}
+
+void sync_condvar_broadcast(sync_condvar_t* condvar) {
+    atomic_int* seq = &condvar->seq.futex;
+    int new_seq = atomic_fetch_add(seq, 1) + 1;
+
+    sync_mutex_t* mutex = __atomic_load_n(&condvar->mutex, __ATOMIC_RELAXED);
+    if (mutex == NULL) {
+        // Nobody has ever waited.
+        _zx_futex_wake(seq, UINT32_MAX);
+        return;
+    }
+
+    // Wake one waiter and move the rest onto the mutex.  The requeue fails
+    // if another signal or broadcast changed |seq| first, in which case we
+    // retry with the new value so that no waiter is left behind.
+    while (_zx_futex_requeue(seq, 1, new_seq, &mutex->futex.futex, UINT32_MAX) ==
+           ZX_ERR_BAD_STATE) {
+        new_seq = atomic_load(seq);
+    }
+}
@@ -0,0 +1,49 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <sync/futex.h>
+#include <sync/mutex.h>
+#include <zircon/types.h>
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS;
+
+// A condition variable for use with sync_mutex_t.
+//
+// Broadcasting wakes a single waiter and requeues the rest directly onto the
+// mutex's futex, so they are woken one at a time as the mutex is released
+// instead of all waking at once only to contend for it.
+typedef struct sync_condvar {
+    futex_t seq;
+    // The mutex used by the most recent waiter, or null.  All concurrent
+    // waiters must use the same mutex.
+    sync_mutex_t* mutex;
+
+#ifdef __cplusplus
+    sync_condvar() : seq(0), mutex(nullptr) {}
+#endif
+} sync_condvar_t;
+
+#if !defined(__cplusplus)
+#define SYNC_CONDVAR_INIT ((sync_condvar_t){0})
+#endif
+
+// Releases |mutex|, which the caller must hold, waits for a signal or
+// broadcast, and reacquires |mutex|.  Returns ZX_ERR_TIMED_OUT if |deadline|
+// passed first; the mutex is reacquired in either case.  Wakeups may be
+// spurious.
+zx_status_t sync_condvar_timedwait(sync_condvar_t* condvar, sync_mutex_t* mutex,
+                                   zx_time_t deadline);
+
+void sync_condvar_wait(sync_condvar_t* condvar, sync_mutex_t* mutex);
+
+// Wakes one waiter.
+void sync_condvar_signal(sync_condvar_t* condvar);
+
+// Wakes all waiters.
+void sync_condvar_broadcast(sync_condvar_t* condvar);
+
+__END_CDECLS;
@@ -0,0 +1,41 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <sync/futex.h>
+#include <zircon/types.h>
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS;
+
+// A plain futex-based mutex.  Its futex protocol is known to
+// sync_condvar_t, which moves broadcast waiters straight onto it.
+typedef struct sync_mutex {
+    futex_t futex;
+
+#ifdef __cplusplus
+    sync_mutex() : futex(0) {}
+#endif
+} sync_mutex_t;
+
+#if !defined(__cplusplus)
+#define SYNC_MUTEX_INIT ((sync_mutex_t){0})
+#endif
+
+// Returns ZX_ERR_BAD_STATE if the mutex is already held.
+zx_status_t sync_mutex_trylock(sync_mutex_t* mutex);
+
+// Returns ZX_ERR_TIMED_OUT if |deadline| passes before the mutex is acquired.
+zx_status_t sync_mutex_timedlock(sync_mutex_t* mutex, zx_time_t deadline);
+
+void sync_mutex_lock(sync_mutex_t* mutex);
+
+// Same as sync_mutex_lock() but always marks the mutex as having waiters, so
+// that threads requeued onto its futex by a condvar are woken on unlock.
+void sync_mutex_lock_with_waiter(sync_mutex_t* mutex);
+
+void sync_mutex_unlock(sync_mutex_t* mutex);
+
+__END_CDECLS;
@@ -0,0 +1,45 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <sync/futex.h>
+#include <zircon/types.h>
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS;
+
+// A mutex whose owner inherits the priority of the threads waiting for it.
+// While a thread is blocked in pi_mutex_lock(), the kernel runs the holder of
+// the mutex at no lower a priority than the blocked thread, so a low priority
+// holder cannot be starved by medium priority work while a high priority
+// thread waits.
+//
+// The futex holds the handle of the owning thread, or 0 when unlocked. The
+// mutex must be unlocked by the thread that locked it.
+typedef struct pi_mutex {
+    futex_t futex;
+
+#ifdef __cplusplus
+    pi_mutex() : futex(0) {}
+#endif
+} pi_mutex_t;
+
+#if !defined(__cplusplus)
+#define PI_MUTEX_INIT ((pi_mutex_t){0})
+#endif
+
+// Returns ZX_ERR_BAD_STATE if the mutex is already held.
+zx_status_t pi_mutex_trylock(pi_mutex_t* mutex);
+
+// Returns ZX_ERR_TIMED_OUT if |deadline| passes before the mutex is acquired.
+zx_status_t pi_mutex_timedlock(pi_mutex_t* mutex, zx_time_t deadline);
+
+void pi_mutex_lock(pi_mutex_t* mutex);
+
+// Hands the mutex to the first waiter, if any, along with the priority of the
+// threads still waiting.
+void pi_mutex_unlock(pi_mutex_t* mutex);
+
+__END_CDECLS;
@@ -0,0 +1,57 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <sync/futex.h>
+#include <zircon/types.h>
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS;
+
+// A reader-writer lock which prefers writers.
+//
+// Once a writer is waiting, new readers wait behind it rather than keep the
+// lock read-locked indefinitely.  Readers which had to wait are released all
+// at once when the lock next becomes available to them.
+//
+// |state| holds the reader count (or the write-locked value) and flags for
+// waiting readers and writers; readers sleep on it.  Writers sleep on
+// |writer_notify|, which counts the sleeping writers in its low 16 bits and
+// a wakeup sequence number in the rest, so an unlock only pays for waking a
+// writer when one is actually waiting.
+typedef struct sync_rwlock {
+    futex_t state;
+    futex_t writer_notify;
+
+#ifdef __cplusplus
+    sync_rwlock() : state(0), writer_notify(0) {}
+#endif
+} sync_rwlock_t;
+
+#if !defined(__cplusplus)
+#define SYNC_RWLOCK_INIT ((sync_rwlock_t){0})
+#endif
+
+// Returns ZX_ERR_BAD_STATE if the lock cannot be read-locked without
+// waiting, including when a writer is waiting for it.
+zx_status_t sync_rwlock_tryrdlock(sync_rwlock_t* rwlock);
+
+// Returns ZX_ERR_TIMED_OUT if |deadline| passes before the lock is acquired.
+zx_status_t sync_rwlock_timedrdlock(sync_rwlock_t* rwlock, zx_time_t deadline);
+
+void sync_rwlock_rdlock(sync_rwlock_t* rwlock);
+
+// Returns ZX_ERR_BAD_STATE if the lock is held.
+zx_status_t sync_rwlock_trywrlock(sync_rwlock_t* rwlock);
+
+// Returns ZX_ERR_TIMED_OUT if |deadline| passes before the lock is acquired.
+zx_status_t sync_rwlock_timedwrlock(sync_rwlock_t* rwlock, zx_time_t deadline);
+
+void sync_rwlock_wrlock(sync_rwlock_t* rwlock);
+
+// Releases a read or write lock held by the caller.
+void sync_rwlock_unlock(sync_rwlock_t* rwlock);
+
+__END_CDECLS;
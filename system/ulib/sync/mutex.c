@@ -0,0 +1,97 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <sync/mutex.h>
+
+#include <zircon/syscalls.h>
+#include <stdatomic.h>
+
+// This is the "Mutex, Take 2" design from Ulrich Drepper's "Futexes Are
+// Tricky", with an atomic swap on unlock, as in the runtime's zxr_mutex_t.
+
+// The value of UNLOCKED must be 0 so that mutexes can be allocated in BSS
+// segments (zero-initialized data).
+enum {
+    UNLOCKED = 0,
+    LOCKED_WITHOUT_WAITERS = 1,
+    LOCKED_WITH_WAITERS = 2,
+};
+
+// On success, this leaves the mutex in the LOCKED_WITH_WAITERS state.
+static zx_status_t lock_slow_path(sync_mutex_t* mutex, zx_time_t deadline,
+                                  int old_state) {
+    atomic_int* futex = &mutex->futex.futex;
+    for (;;) {
+        // If the state shows there are already waiters, or we can update
+        // it to indicate that there are waiters, then wait.
+        if (old_state == LOCKED_WITH_WAITERS ||
+            (old_state == LOCKED_WITHOUT_WAITERS &&
+             atomic_compare_exchange_strong(futex, &old_state,
+                                            LOCKED_WITH_WAITERS))) {
+            zx_status_t status = _zx_futex_wait(futex, LOCKED_WITH_WAITERS, deadline);
+            if (status == ZX_ERR_TIMED_OUT)
+                return ZX_ERR_TIMED_OUT;
+        }
+
+        // We could have been woken with more threads still waiting, so the
+        // mutex has to stay marked as having waiters.
+        old_state = UNLOCKED;
+        if (atomic_compare_exchange_strong(futex, &old_state, LOCKED_WITH_WAITERS))
+            return ZX_OK;
+    }
+}
+
+zx_status_t sync_mutex_trylock(sync_mutex_t* mutex) {
+    int old_state = UNLOCKED;
+    if (atomic_compare_exchange_strong(&mutex->futex.futex, &old_state,
+                                       LOCKED_WITHOUT_WAITERS)) {
+        return ZX_OK;
+    }
+    return ZX_ERR_BAD_STATE;
+}
+
+zx_status_t sync_mutex_timedlock(sync_mutex_t* mutex, zx_time_t deadline) {
+    // Try to claim the mutex.  This compare-and-swap executes the full
+    // memory barrier that locking a mutex is required to execute.
+    int old_state = UNLOCKED;
+    if (atomic_compare_exchange_strong(&mutex->futex.futex, &old_state,
+                                       LOCKED_WITHOUT_WAITERS)) {
+        return ZX_OK;
+    }
+    return lock_slow_path(mutex, deadline, old_state);
+}
+
+void sync_mutex_lock(sync_mutex_t* mutex) {
+    zx_status_t status = sync_mutex_timedlock(mutex, ZX_TIME_INFINITE);
+    if (status != ZX_OK)
+        __builtin_trap();
+}
+
+void sync_mutex_lock_with_waiter(sync_mutex_t* mutex) {
+    int old_state = UNLOCKED;
+    if (atomic_compare_exchange_strong(&mutex->futex.futex, &old_state,
+                                       LOCKED_WITH_WAITERS)) {
+        return;
+    }
+    zx_status_t status = lock_slow_path(mutex, ZX_TIME_INFINITE, old_state);
+    if (status != ZX_OK)
+        __builtin_trap();
+}
+
+void sync_mutex_unlock(sync_mutex_t* mutex) {
+    atomic_int* futex = &mutex->futex.futex;
+    int old_state = atomic_exchange(futex, UNLOCKED);
+    switch (old_state) {
+    case LOCKED_WITHOUT_WAITERS:
+        // Nothing to do.
+        break;
+    case LOCKED_WITH_WAITERS:
+        _zx_futex_wake(futex, 1);
+        break;
+    case UNLOCKED:
+    default:
+        // Unlocking an unlocked mutex, or the state is corrupt.
+        __builtin_trap();
+    }
+}
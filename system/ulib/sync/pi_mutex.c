@@ -0,0 +1,111 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <sync/pi_mutex.h>
+
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+// The value of UNLOCKED must be 0 so that mutexes can be allocated in BSS
+// segments (zero-initialized data).
+//
+// A locked mutex holds the handle of its owner. Handle values always have the
+// low bit set, so clearing it marks the mutex as possibly having waiters,
+// and the owner's handle can still be recovered by setting it again.
+enum {
+    UNLOCKED = 0,
+    UNCONTESTED_BIT = 1,
+};
+
+static int owner_handle(int state) {
+    return state | UNCONTESTED_BIT;
+}
+
+static bool is_contested(int state) {
+    return (state & UNCONTESTED_BIT) == 0;
+}
+
+zx_status_t pi_mutex_trylock(pi_mutex_t* mutex) {
+    int old_state = UNLOCKED;
+    if (atomic_compare_exchange_strong(&mutex->futex.futex, &old_state,
+                                       (int)zx_thread_self())) {
+        return ZX_OK;
+    }
+    return ZX_ERR_BAD_STATE;
+}
+
+zx_status_t pi_mutex_timedlock(pi_mutex_t* mutex, zx_time_t deadline) {
+    atomic_int* futex = &mutex->futex.futex;
+    const int self = (int)zx_thread_self();
+
+    // Try to claim the mutex.  This compare-and-swap executes the full
+    // memory barrier that locking a mutex is required to execute.
+    int old_state = UNLOCKED;
+    if (atomic_compare_exchange_strong(futex, &old_state, self))
+        return ZX_OK;
+
+    for (;;) {
+        if (old_state == UNLOCKED) {
+            // We may have been woken with other threads still waiting, so
+            // the mutex has to stay marked as contested.
+            if (atomic_compare_exchange_strong(futex, &old_state,
+                                               self & ~UNCONTESTED_BIT)) {
+                return ZX_OK;
+            }
+            continue;
+        }
+
+        // Tell the owner to wake us when it unlocks.
+        if (!is_contested(old_state)) {
+            int contested = old_state & ~UNCONTESTED_BIT;
+            if (!atomic_compare_exchange_strong(futex, &old_state, contested))
+                continue;
+            old_state = contested;
+        }
+
+        zx_status_t status = zx_futex_wait_owned(futex, old_state,
+                                                 owner_handle(old_state), deadline);
+        switch (status) {
+        case ZX_OK:
+        case ZX_ERR_BAD_STATE:
+            break;
+        case ZX_ERR_TIMED_OUT:
+            return ZX_ERR_TIMED_OUT;
+        case ZX_ERR_BAD_HANDLE:
+        case ZX_ERR_WRONG_TYPE:
+            // The owner exited without unlocking, or its handle was closed
+            // and reused. There is nobody to lend our priority to.
+            status = zx_futex_wait(futex, old_state, deadline);
+            if (status == ZX_ERR_TIMED_OUT)
+                return ZX_ERR_TIMED_OUT;
+            break;
+        default:
+            __builtin_trap();
+        }
+
+        old_state = atomic_load(futex);
+    }
+}
+
+void pi_mutex_lock(pi_mutex_t* mutex) {
+    zx_status_t status = pi_mutex_timedlock(mutex, ZX_TIME_INFINITE);
+    if (status != ZX_OK)
+        __builtin_trap();
+}
+
+void pi_mutex_unlock(pi_mutex_t* mutex) {
+    // Attempt to release the mutex.  This atomic swap executes the full
+    // memory barrier that unlocking a mutex is required to execute.
+    int old_state = atomic_exchange(&mutex->futex.futex, UNLOCKED);
+    if (old_state == UNLOCKED)
+        __builtin_trap();
+
+    if (is_contested(old_state)) {
+        zx_status_t status = zx_futex_wake_single_owner(&mutex->futex.futex);
+        if (status != ZX_OK)
+            __builtin_trap();
+    }
+}
@@ -10,6 +10,10 @@ MODULE_TYPE := userlib
 
 MODULE_SRCS += \
     $(LOCAL_DIR)/completion.c \
+    $(LOCAL_DIR)/condvar.c \
+    $(LOCAL_DIR)/mutex.c \
+    $(LOCAL_DIR)/pi_mutex.c \
+    $(LOCAL_DIR)/rwlock.c \
 
 MODULE_LIBS := \
     system/ulib/zircon \
@@ -19,4 +23,8 @@ MODULE_HEADER_DEPS := \
 
 MODULE_EXPORT := a
 
+# libc implements pthread_rwlock_t with this library, so it must not depend
+# on safe-stack or sanitizer runtime support.
+MODULE_COMPILEFLAGS += $(NO_SAFESTACK) $(NO_SANITIZERS)
+
 include make/module.mk
@@ -0,0 +1,219 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <sync/rwlock.h>
+
+#include <limits.h>
+#include <zircon/syscalls.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+// Layout of |state|.  The low bits are the number of readers holding the
+// lock, or MASK if a writer holds it.
+enum {
+    MASK = (1 << 29) - 1,
+    WRITE_LOCKED = MASK,
+    MAX_READERS = MASK - 1,
+    READERS_WAITING = 1 << 29,
+    WRITERS_WAITING = 1 << 30,
+};
+
+// Layout of |writer_notify|.
+enum {
+    WRITER_COUNT_MASK = 0xffff,
+    WRITER_SEQUENCE_ONE = 0x10000,
+};
+
+static bool is_unlocked(int state) {
+    return (state & MASK) == 0;
+}
+
+static bool is_write_locked(int state) {
+    return (state & MASK) == WRITE_LOCKED;
+}
+
+// Readers wait behind any waiting writer, and behind readers which are
+// already waiting so that they are all released together.
+static bool is_read_lockable(int state) {
+    return (state & MASK) < MAX_READERS &&
+           (state & (READERS_WAITING | WRITERS_WAITING)) == 0;
+}
+
+// Wakes one writer if any is sleeping.  Returns whether one was.
+static bool wake_writer(sync_rwlock_t* rwlock) {
+    atomic_int* notify = &rwlock->writer_notify.futex;
+    int old = atomic_fetch_add(notify, WRITER_SEQUENCE_ONE);
+    if ((old & WRITER_COUNT_MASK) == 0)
+        return false;
+    _zx_futex_wake(notify, 1);
+    return true;
+}
+
+// Called with the lock unlocked and some waiter flag set.  A waiting writer
+// gets the lock ahead of waiting readers; if there is none, all waiting
+// readers are woken together.
+static void wake_writer_or_readers(sync_rwlock_t* rwlock, int state) {
+    atomic_int* futex = &rwlock->state.futex;
+
+    if (state == WRITERS_WAITING) {
+        if (atomic_compare_exchange_strong(futex, &state, 0)) {
+            wake_writer(rwlock);
+            return;
+        }
+    }
+
+    if (state == (READERS_WAITING | WRITERS_WAITING)) {
+        // The readers stay flagged as waiting so that they go after the
+        // writer.  If the state changed, whoever changed it will wake them.
+        if (!atomic_compare_exchange_strong(futex, &state, READERS_WAITING))
+            return;
+        if (wake_writer(rwlock))
+            return;
+        state = READERS_WAITING;
+    }
+
+    if (state == READERS_WAITING) {
+        if (atomic_compare_exchange_strong(futex, &state, 0))
+            _zx_futex_wake(futex, UINT32_MAX);
+    }
+}
+
+zx_status_t sync_rwlock_tryrdlock(sync_rwlock_t* rwlock) {
+    atomic_int* futex = &rwlock->state.futex;
+    int state = atomic_load(futex);
+    while (is_read_lockable(state)) {
+        if (atomic_compare_exchange_weak(futex, &state, state + 1))
+            return ZX_OK;
+    }
+    return ZX_ERR_BAD_STATE;
+}
+
+zx_status_t sync_rwlock_timedrdlock(sync_rwlock_t* rwlock, zx_time_t deadline) {
+    atomic_int* futex = &rwlock->state.futex;
+    int state = atomic_load(futex);
+    for (;;) {
+        if (is_read_lockable(state)) {
+            if (atomic_compare_exchange_weak(futex, &state, state + 1))
+                return ZX_OK;
+            continue;
+        }
+
+        if ((state & MASK) == MAX_READERS)
+            __builtin_trap();
+
+        // Flag that there are waiting readers so that the unlock wakes us.
+        if (!(state & READERS_WAITING)) {
+            if (!atomic_compare_exchange_weak(futex, &state, state | READERS_WAITING))
+                continue;
+            state |= READERS_WAITING;
+        }
+
+        // If we time out the flag is left set, which at worst costs the
+        // next unlock a futex wake.
+        if (_zx_futex_wait(futex, state, deadline) == ZX_ERR_TIMED_OUT)
+            return ZX_ERR_TIMED_OUT;
+        state = atomic_load(futex);
+    }
+}
+
+void sync_rwlock_rdlock(sync_rwlock_t* rwlock) {
+    zx_status_t status = sync_rwlock_timedrdlock(rwlock, ZX_TIME_INFINITE);
+    if (status != ZX_OK)
+        __builtin_trap();
+}
+
+zx_status_t sync_rwlock_trywrlock(sync_rwlock_t* rwlock) {
+    atomic_int* futex = &rwlock->state.futex;
+    int state = atomic_load(futex);
+    while (is_unlocked(state)) {
+        if (atomic_compare_exchange_weak(futex, &state, state | WRITE_LOCKED))
+            return ZX_OK;
+    }
+    return ZX_ERR_BAD_STATE;
+}
+
+// Sleeps on |writer_notify| until an unlock wakes a writer, the lock looks
+// available, or |deadline| passes.
+static zx_status_t wait_for_writer_wakeup(sync_rwlock_t* rwlock, zx_time_t deadline) {
+    atomic_int* notify = &rwlock->writer_notify.futex;
+    int value = atomic_fetch_add(notify, 1) + 1;
+    int sequence = value & ~WRITER_COUNT_MASK;
+    zx_status_t status = ZX_OK;
+    for (;;) {
+        int state = atomic_load(&rwlock->state.futex);
+        if (is_unlocked(state) || !(state & WRITERS_WAITING))
+            break;
+        status = _zx_futex_wait(notify, value, deadline);
+        if (status != ZX_ERR_BAD_STATE)
+            break;
+        // Another writer came or went; keep waiting unless we were woken.
+        value = atomic_load(notify);
+        if ((value & ~WRITER_COUNT_MASK) != sequence) {
+            status = ZX_OK;
+            break;
+        }
+    }
+    atomic_fetch_sub(notify, 1);
+
+    if (status == ZX_ERR_TIMED_OUT) {
+        // An unlock may have counted on us to take the lock instead of
+        // waking the readers, so pass the wakeup on.
+        int state = atomic_load(&rwlock->state.futex);
+        if (is_unlocked(state) && (state & (READERS_WAITING | WRITERS_WAITING)))
+            wake_writer_or_readers(rwlock, state);
+    }
+    return status;
+}
+
+zx_status_t sync_rwlock_timedwrlock(sync_rwlock_t* rwlock, zx_time_t deadline) {
+    atomic_int* futex = &rwlock->state.futex;
+    int state = 0;
+    if (atomic_compare_exchange_strong(futex, &state, WRITE_LOCKED))
+        return ZX_OK;
+
+    // Once we have slept, other writers may be sleeping too, so we keep
+    // the lock flagged as having waiting writers when we take it.
+    int other_writers_waiting = 0;
+    for (;;) {
+        if (is_unlocked(state)) {
+            if (atomic_compare_exchange_weak(futex, &state,
+                                             state | WRITE_LOCKED | other_writers_waiting))
+                return ZX_OK;
+            continue;
+        }
+
+        if (!(state & WRITERS_WAITING)) {
+            if (!atomic_compare_exchange_weak(futex, &state, state | WRITERS_WAITING))
+                continue;
+        }
+
+        other_writers_waiting = WRITERS_WAITING;
+        if (wait_for_writer_wakeup(rwlock, deadline) == ZX_ERR_TIMED_OUT)
+            return ZX_ERR_TIMED_OUT;
+        state = atomic_load(futex);
+    }
+}
+
+void sync_rwlock_wrlock(sync_rwlock_t* rwlock) {
+    zx_status_t status = sync_rwlock_timedwrlock(rwlock, ZX_TIME_INFINITE);
+    if (status != ZX_OK)
+        __builtin_trap();
+}
+
+void sync_rwlock_unlock(sync_rwlock_t* rwlock) {
+    atomic_int* futex = &rwlock->state.futex;
+    int state = atomic_load(futex);
+    if (is_unlocked(state))
+        __builtin_trap();
+
+    if (is_write_locked(state)) {
+        state = atomic_fetch_sub(futex, WRITE_LOCKED) - WRITE_LOCKED;
+        if (state != 0)
+            wake_writer_or_readers(rwlock, state);
+    } else {
+        state = atomic_fetch_sub(futex, 1) - 1;
+        if (is_unlocked(state) && (state & (READERS_WAITING | WRITERS_WAITING)))
+            wake_writer_or_readers(rwlock, state);
+    }
+}
@@ -256,6 +256,16 @@ tftp_status tftp_set_options(tftp_session* session,
                              const uint8_t* timeout,
                              const uint16_t* window_size);
 
+// When acting as a server, the largest block size and window size that will
+// be agreed to, e.g. to keep blocks within the path MTU and the size of the
+// transport buffers. Larger requests are negotiated down to these limits, as
+// RFC 2348 and RFC 7440 allow; forced ("!") requests above them are refused.
+// Limits apply after any values from tftp_set_options(). Passing NULL for
+// either removes that limit.
+tftp_status tftp_set_max_options(tftp_session* session,
+                                 const uint16_t* block_size,
+                                 const uint16_t* window_size);
+
 // tftp_session_has_pending returns true if the tftp_session has more data to
 // send before waiting for an ack. It is recommended that the caller do a
 // non-blocking read to see if an out-of-order ACK was sent by the remote host
@@ -146,6 +146,10 @@ struct tftp_session_t {
     // will override, if possible, when we receive a write request.
     tftp_options options;
 
+    // For a server, the largest block and window sizes we will agree to. Requests for more are
+    // negotiated down to these.
+    tftp_options max_options;
+
     // Tracks the options we used on the last request, so we can compare them to the options
     // we get back.
     tftp_options client_sent_opts;
@@ -700,6 +700,75 @@ static bool test_tftp_receive_force_rrq_have_overrides(void) {
                               true, true, true);
 }
 
+// Verify that requests above the server's limits are negotiated down to them, and that
+// forced requests above them are refused.
+static bool test_tftp_receive_request_max_options(tftp_file_direction dir, bool force) {
+    BEGIN_TEST;
+
+    test_state ts;
+    ts.reset(1024, 1024, 1500);
+    tftp_file_interface ifc = {dummy_open_read, dummy_open_write, NULL, NULL, NULL};
+    tftp_session_set_file_interface(ts.session, &ifc);
+    constexpr uint16_t kMaxBlockSize = 1428;
+    constexpr uint16_t kMaxWindowSize = 64;
+    tftp_status status = tftp_set_max_options(ts.session, &kMaxBlockSize, &kMaxWindowSize);
+    ASSERT_EQ(TFTP_NO_ERROR, status, "failed to set server limits");
+
+    size_t req_file_size = (dir == SEND_FILE) ? 1024 : 0;
+    char buf[256];
+    buf[0] = 0x00;
+    buf[1] = (dir == SEND_FILE) ? OPCODE_WRQ : OPCODE_RRQ;
+    size_t buf_sz = 2;
+    buf_sz += snprintf(&buf[buf_sz], sizeof(buf) - buf_sz,
+                       "%s%cOCTET%cTSIZE%c%zu",
+                       kRemoteFilename, '\0', '\0', '\0', req_file_size) + 1;
+    buf_sz += snprintf(&buf[buf_sz], sizeof(buf) - buf_sz,
+                       "BLKSIZE%s%c%d", force ? "!" : "", '\0', 8192) + 1;
+    buf_sz += snprintf(&buf[buf_sz], sizeof(buf) - buf_sz,
+                       "WINDOWSIZE%c%d", '\0', 1024) + 1;
+    ASSERT_LT(buf_sz, (int)sizeof(buf), "insufficient space for request");
+
+    status = tftp_process_msg(ts.session, buf, buf_sz, ts.out, &ts.outlen, &ts.timeout, nullptr);
+    if (force) {
+        EXPECT_LT(status, 0, "forced block size above limit should be refused");
+        EXPECT_TRUE(verify_response_opcode(ts, OPCODE_ERROR), "bad response");
+    } else {
+        EXPECT_EQ(TFTP_NO_ERROR, status, "receive request failed");
+        EXPECT_TRUE(verify_response_opcode(ts, OPCODE_OACK), "bad response");
+        EXPECT_EQ(kMaxBlockSize, ts.session->block_size, "bad session: block size");
+        EXPECT_EQ(kMaxWindowSize, ts.session->window_size, "bad session: window size");
+
+        const char* msg = static_cast<const char*>(ts.out);
+        char opt_str[256];
+        size_t opt_str_sz = snprintf(opt_str, sizeof(opt_str),
+                                     "BLKSIZE%c%d", '\0', kMaxBlockSize) + 1;
+        EXPECT_TRUE(find_str_in_mem(opt_str, opt_str_sz, msg, ts.outlen),
+                    "block size not correct in oack");
+        opt_str_sz = snprintf(opt_str, sizeof(opt_str),
+                              "WINDOWSIZE%c%d", '\0', kMaxWindowSize) + 1;
+        EXPECT_TRUE(find_str_in_mem(opt_str, opt_str_sz, msg, ts.outlen),
+                    "window size not correct in oack");
+    }
+
+    END_TEST;
+}
+
+static bool test_tftp_receive_wrq_max_options(void) {
+    return test_tftp_receive_request_max_options(SEND_FILE, false);
+}
+
+static bool test_tftp_receive_force_wrq_max_options(void) {
+    return test_tftp_receive_request_max_options(SEND_FILE, true);
+}
+
+static bool test_tftp_receive_rrq_max_options(void) {
+    return test_tftp_receive_request_max_options(RECV_FILE, false);
+}
+
+static bool test_tftp_receive_force_rrq_max_options(void) {
+    return test_tftp_receive_request_max_options(RECV_FILE, true);
+}
+
 struct tx_test_data {
     struct {
         uint16_t block;
@@ -2006,6 +2075,8 @@ RUN_TEST(test_tftp_receive_wrq_windowsize)
 RUN_TEST(test_tftp_receive_wrq_have_overrides)
 RUN_TEST(test_tftp_receive_force_wrq_no_overrides)
 RUN_TEST(test_tftp_receive_force_wrq_have_overrides)
+RUN_TEST(test_tftp_receive_wrq_max_options)
+RUN_TEST(test_tftp_receive_force_wrq_max_options)
 END_TEST_CASE(tftp_receive_wrq)
 
 BEGIN_TEST_CASE(tftp_receive_rrq)
@@ -2019,6 +2090,8 @@ RUN_TEST(test_tftp_receive_rrq_windowsize)
 RUN_TEST(test_tftp_receive_rrq_have_overrides)
 RUN_TEST(test_tftp_receive_force_rrq_no_overrides)
 RUN_TEST(test_tftp_receive_force_rrq_have_overrides)
+RUN_TEST(test_tftp_receive_rrq_max_options)
+RUN_TEST(test_tftp_receive_force_rrq_max_options)
 END_TEST_CASE(tftp_receive_rrq)
 
 BEGIN_TEST_CASE(tftp_receive_oack)
@@ -293,6 +293,26 @@ tftp_status tftp_set_options(tftp_session* session, const uint16_t* block_size,
     return TFTP_NO_ERROR;
 }
 
+tftp_status tftp_set_max_options(tftp_session* session, const uint16_t* block_size,
+                                 const uint16_t* window_size) {
+    session->max_options.mask = 0;
+    if (block_size) {
+        if (*block_size < 8) {
+            return TFTP_ERR_INVALID_ARGS;
+        }
+        session->max_options.block_size = *block_size;
+        session->max_options.mask |= BLOCKSIZE_OPTION;
+    }
+    if (window_size) {
+        if (*window_size < 1) {
+            return TFTP_ERR_INVALID_ARGS;
+        }
+        session->max_options.window_size = *window_size;
+        session->max_options.mask |= WINDOWSIZE_OPTION;
+    }
+    return TFTP_NO_ERROR;
+}
+
 tftp_status tftp_generate_request(tftp_session* session,
                                   tftp_file_direction direction,
                                   const char* local_filename,
@@ -473,6 +493,7 @@ tftp_status tftp_handle_request(tftp_session* session,
     bool file_size_seen = false;
     tftp_options requested_options = {.mask = 0};
     tftp_options* override_opts = &session->options;
+    tftp_options* max_opts = &session->max_options;
     while (offset > 0 && left > 0) {
         offset = next_option(cur, left, &option, &value);
         if (!offset) {
@@ -497,7 +518,7 @@ tftp_status tftp_handle_request(tftp_session* session,
             bool force_block_size = (option[kBlkSizeLen] == '!');
             // Valid values range between "8" and "65464" octets, inclusive
             long val = atol(value);
-            // TODO(tkilbourn): with an MTU of 1500, shouldn't be more than 1428
+            // Servers with smaller buffers or MTUs limit this with tftp_set_max_options()
             if (val < 8 || val > 65464) {
                 xprintf("invalid block size\n");
                 set_error(session, TFTP_ERR_CODE_BAD_OPTIONS, resp, resp_len, "invalid block size");
@@ -510,6 +531,16 @@ tftp_status tftp_handle_request(tftp_session* session,
             } else {
                 session->block_size = override_opts->block_size;
             }
+            if ((max_opts->mask & BLOCKSIZE_OPTION) &&
+                session->block_size > max_opts->block_size) {
+                if (force_block_size) {
+                    xprintf("forced block size too large\n");
+                    set_error(session, TFTP_ERR_CODE_BAD_OPTIONS, resp, resp_len,
+                              "block size too large");
+                    return TFTP_ERR_INTERNAL;
+                }
+                session->block_size = max_opts->block_size;
+            }
         } else if (!strncasecmp(option, kTimeout, kTimeoutLen)) { // RFC 2349
             bool force_timeout_val = (option[kTimeoutLen] == '!');
             // Valid values range between "1" and "255" seconds inclusive.
@@ -543,6 +574,16 @@ tftp_status tftp_handle_request(tftp_session* session,
             } else {
                 session->window_size = override_opts->window_size;
             }
+            if ((max_opts->mask & WINDOWSIZE_OPTION) &&
+                session->window_size > max_opts->window_size) {
+                if (force_window_size) {
+                    xprintf("forced window size too large\n");
+                    set_error(session, TFTP_ERR_CODE_BAD_OPTIONS, resp, resp_len,
+                              "window size too large");
+                    return TFTP_ERR_INTERNAL;
+                }
+                session->window_size = max_opts->window_size;
+            }
         } else {
             // Options which the server does not support should be omitted from the
             // OACK; they should not cause an ERROR packet to be generated.
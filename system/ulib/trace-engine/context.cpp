@@ -9,6 +9,7 @@
 
 #include <fbl/algorithm.h>
 #include <fbl/atomic.h>
+#include <fbl/auto_lock.h>
 #include <fbl/intrusive_hash_table.h>
 #include <fbl/unique_ptr.h>
 #include <zx/process.h>
@@ -64,6 +65,54 @@ void GetObjectName(zx_handle_t handle, char* name_buf, size_t name_buf_size,
 // The next context generation number.
 fbl::atomic<uint32_t> g_next_generation{1u};
 
+// Size of the chunks of rolling buffer handed out to per-thread lanes.
+constexpr size_t kLaneBytes = 4096u;
+
+// Records larger than this are allocated straight from the shared rolling
+// buffer so that switching lanes never strands much space.
+constexpr size_t kMaxLaneRecordBytes = kLaneBytes / 4u;
+
+// Smallest rolling buffer accepted by the circular and streaming modes.
+constexpr size_t kMinRollingBufferSize = 2u * kLaneBytes;
+
+// Rolling buffer offsets are kept in 32 bits.
+constexpr size_t kMaxRollingBufferSize = UINT32_MAX & ~size_t(7);
+
+// A chunk of the rolling buffer reserved for the records of one thread.
+// The unused tail of the lane is always covered by a padding record so the
+// buffer stays readable no matter where the thread stops writing.
+struct Lane {
+    // The generation and rolling buffer the lane was carved out of.
+    uint32_t generation;
+    uint32_t wrapped_count;
+    uint8_t* ptr;
+    uint8_t* end;
+};
+thread_local Lane tls_lane{};
+
+size_t DurableBufferSize(trace_buffering_mode_t buffering_mode,
+                         size_t buffer_num_bytes) {
+    if (buffering_mode == TRACE_BUFFERING_MODE_ONESHOT ||
+        buffer_num_bytes < sizeof(trace_buffer_header_t))
+        return 0u;
+    return ((buffer_num_bytes - sizeof(trace_buffer_header_t)) / 8u) & ~size_t(7);
+}
+
+size_t RollingBufferSize(trace_buffering_mode_t buffering_mode,
+                         size_t buffer_num_bytes) {
+    size_t size;
+    if (buffering_mode == TRACE_BUFFERING_MODE_ONESHOT) {
+        size = buffer_num_bytes & ~size_t(7);
+    } else {
+        if (buffer_num_bytes < sizeof(trace_buffer_header_t))
+            return 0u;
+        size_t usable = buffer_num_bytes - sizeof(trace_buffer_header_t) -
+                        DurableBufferSize(buffering_mode, buffer_num_bytes);
+        size = (usable / 2u) & ~size_t(7);
+    }
+    return fbl::min(size, kMaxRollingBufferSize);
+}
+
 // A string table entry.
 struct StringEntry : public fbl::SinglyLinkedListable<StringEntry*> {
     // Attempted to assign an index.
@@ -167,6 +216,16 @@ inline constexpr uint64_t MakeArgumentHeader(ArgumentType type, size_t size,
            ArgumentFields::NameRef::Make(name_ref->encoded_value);
 }
 
+// Covers [ptr, end) with a record which readers skip.
+void WritePadding(uint8_t* ptr, uint8_t* end) {
+    if (ptr == end)
+        return;
+    ZX_DEBUG_ASSERT(static_cast<size_t>(end - ptr) <= RecordFields::kMaxRecordSizeBytes);
+    *reinterpret_cast<uint64_t*>(ptr) =
+        MakeRecordHeader(RecordType::kMetadata, end - ptr) |
+        MetadataRecordFields::MetadataType::Make(ToUnderlyingType(MetadataType::kPadding));
+}
+
 size_t SizeOfEncodedStringRef(const trace_string_ref_t* string_ref) {
     return trace_is_inline_string_ref(string_ref)
                ? Pad(trace_inline_string_ref_length(string_ref))
@@ -226,6 +285,9 @@ public:
     explicit Payload(trace_context_t* context, size_t num_bytes)
         : ptr_(context->AllocRecord(num_bytes)) {}
 
+    explicit Payload(uint64_t* ptr)
+        : ptr_(ptr) {}
+
     explicit operator bool() const {
         return ptr_ != nullptr;
     }
@@ -862,7 +924,7 @@ void trace_context_write_initialization_record(
     uint64_t ticks_per_second) {
     const size_t record_size = sizeof(trace::RecordHeader) +
                                trace::WordsToBytes(1);
-    trace::Payload payload(context, record_size);
+    trace::Payload payload(context->AllocDurableRecord(record_size));
     if (payload) {
         payload
             .WriteUint64(trace::MakeRecordHeader(trace::RecordType::kInitialization, record_size))
@@ -881,7 +943,7 @@ void trace_context_write_string_record(
 
     const size_t record_size = sizeof(trace::RecordHeader) +
                                trace::Pad(length);
-    trace::Payload payload(context, record_size);
+    trace::Payload payload(context->AllocDurableRecord(record_size));
     if (payload) {
         payload
             .WriteUint64(trace::MakeRecordHeader(trace::RecordType::kString, record_size) |
@@ -901,7 +963,7 @@ void trace_context_write_thread_record(
 
     const size_t record_size = sizeof(trace::RecordHeader) +
                                trace::WordsToBytes(2);
-    trace::Payload payload(context, record_size);
+    trace::Payload payload(context->AllocDurableRecord(record_size));
     if (payload) {
         payload
             .WriteUint64(trace::MakeRecordHeader(trace::RecordType::kThread, record_size) |
@@ -918,48 +980,226 @@ void* trace_context_alloc_record(trace_context_t* context, size_t num_bytes) {
 /* struct trace_context */
 
 trace_context::trace_context(void* buffer, size_t buffer_num_bytes,
+                             trace_buffering_mode_t buffering_mode,
                              trace_handler_t* handler)
     : generation_(trace::g_next_generation.fetch_add(1u, fbl::memory_order_relaxed) + 1u),
+      buffering_mode_(buffering_mode),
       buffer_start_(static_cast<uint8_t*>(buffer)),
       buffer_end_(buffer_start_ + buffer_num_bytes),
-      buffer_current_(reinterpret_cast<uintptr_t>(buffer_start_)),
-      buffer_full_mark_(0u),
+      header_(buffering_mode == TRACE_BUFFERING_MODE_ONESHOT
+                  ? nullptr
+                  : reinterpret_cast<trace_buffer_header_t*>(buffer_start_)),
+      durable_start_(header_ ? buffer_start_ + sizeof(trace_buffer_header_t)
+                             : buffer_start_),
+      durable_size_(trace::DurableBufferSize(buffering_mode, buffer_num_bytes)),
+      rolling_size_(trace::RollingBufferSize(buffering_mode, buffer_num_bytes)),
       handler_(handler) {
     ZX_DEBUG_ASSERT(generation_ != 0u);
+    ZX_DEBUG_ASSERT(IsBufferSizeValid(buffering_mode, buffer_num_bytes));
+
+    rolling_start_[0] = durable_start_ + durable_size_;
+    rolling_start_[1] = rolling_start_[0] + rolling_size_;
+
+    if (header_) {
+        fbl::AutoLock lock(&rolling_mutex_);
+        WriteBufferHeaderLocked();
+    }
 }
 
 trace_context::~trace_context() = default;
 
+bool trace_context::IsBufferSizeValid(trace_buffering_mode_t buffering_mode,
+                                      size_t buffer_num_bytes) {
+    switch (buffering_mode) {
+    case TRACE_BUFFERING_MODE_ONESHOT:
+        return true;
+    case TRACE_BUFFERING_MODE_CIRCULAR:
+    case TRACE_BUFFERING_MODE_STREAMING:
+        return trace::RollingBufferSize(buffering_mode, buffer_num_bytes) >=
+               trace::kMinRollingBufferSize;
+    default:
+        return false;
+    }
+}
+
 uint64_t* trace_context::AllocRecord(size_t num_bytes) {
     ZX_DEBUG_ASSERT((num_bytes & 7) == 0);
     if (unlikely(num_bytes > TRACE_ENCODED_RECORD_MAX_LENGTH))
         return nullptr;
 
-    uint8_t* ptr = reinterpret_cast<uint8_t*>(
-        buffer_current_.fetch_add(num_bytes,
-                                  fbl::memory_order_relaxed));
-    if (likely(ptr + num_bytes <= buffer_end_)) {
-        ZX_DEBUG_ASSERT(ptr + num_bytes >= buffer_start_);
-        return reinterpret_cast<uint64_t*>(ptr); // success!
-    }
-
-    // Buffer is full!
-    // Snap to the endpoint to reduce likelihood of pointer wrap-around.
-    buffer_current_.store(reinterpret_cast<uintptr_t>(buffer_end_),
-                          fbl::memory_order_relaxed);
-
-    // Mark the end point if not already marked.
-    uintptr_t expected_mark = 0u;
-    if (buffer_full_mark_.compare_exchange_strong(&expected_mark,
-                                                  reinterpret_cast<uintptr_t>(ptr),
-                                                  fbl::memory_order_relaxed,
-                                                  fbl::memory_order_relaxed)) {
+    size_t lane_bytes;
+    uint32_t wrapped_count;
+    if (unlikely(num_bytes > trace::kMaxLaneRecordBytes)) {
+        return reinterpret_cast<uint64_t*>(
+            AllocRollingBytes(num_bytes, num_bytes, &lane_bytes, &wrapped_count));
+    }
+
+    // Carve the record out of this thread's lane if it still belongs to the
+    // rolling buffer being written.
+    trace::Lane* lane = &trace::tls_lane;
+    uint64_t state = rolling_state_.load(fbl::memory_order_relaxed);
+    if (likely(lane->generation == generation_ &&
+               lane->wrapped_count == RollingWrappedCount(state) &&
+               static_cast<size_t>(lane->end - lane->ptr) >= num_bytes)) {
+        uint8_t* ptr = lane->ptr;
+        lane->ptr += num_bytes;
+        trace::WritePadding(lane->ptr, lane->end);
+        return reinterpret_cast<uint64_t*>(ptr);
+    }
+
+    // Start a new lane.  The rest of the old one is already padded.
+    uint8_t* ptr = AllocRollingBytes(num_bytes, trace::kLaneBytes,
+                                     &lane_bytes, &wrapped_count);
+    if (unlikely(!ptr))
+        return nullptr;
+    lane->generation = generation_;
+    lane->wrapped_count = wrapped_count;
+    lane->ptr = ptr + num_bytes;
+    lane->end = ptr + lane_bytes;
+    trace::WritePadding(lane->ptr, lane->end);
+    return reinterpret_cast<uint64_t*>(ptr);
+}
+
+uint64_t* trace_context::AllocDurableRecord(size_t num_bytes) {
+    if (buffering_mode_ == TRACE_BUFFERING_MODE_ONESHOT)
+        return AllocRecord(num_bytes);
+
+    ZX_DEBUG_ASSERT((num_bytes & 7) == 0);
+    if (unlikely(num_bytes > TRACE_ENCODED_RECORD_MAX_LENGTH))
+        return nullptr;
+
+    uint64_t offset = durable_current_.load(fbl::memory_order_relaxed);
+    do {
+        if (unlikely(durable_size_ - offset < num_bytes)) {
+            num_records_dropped_.fetch_add(1u, fbl::memory_order_relaxed);
+            return nullptr;
+        }
+    } while (!durable_current_.compare_exchange_weak(&offset, offset + num_bytes,
+                                                     fbl::memory_order_relaxed,
+                                                     fbl::memory_order_relaxed));
+    return reinterpret_cast<uint64_t*>(durable_start_ + offset);
+}
+
+uint8_t* trace_context::AllocRollingBytes(size_t min_bytes, size_t max_bytes,
+                                          size_t* out_num_bytes,
+                                          uint32_t* out_wrapped_count) {
+    uint64_t state = rolling_state_.load(fbl::memory_order_relaxed);
+    for (;;) {
+        uint32_t offset = RollingOffset(state);
+        size_t available = rolling_size_ - offset;
+        if (likely(available >= min_bytes)) {
+            size_t num_bytes = fbl::min(available, max_bytes);
+            if (rolling_state_.compare_exchange_weak(&state, state + num_bytes,
+                                                     fbl::memory_order_relaxed,
+                                                     fbl::memory_order_relaxed)) {
+                uint32_t wrapped_count = RollingWrappedCount(state);
+                *out_num_bytes = num_bytes;
+                *out_wrapped_count = wrapped_count;
+                return rolling_start_[wrapped_count & 1u] + offset;
+            }
+            continue;
+        }
+
+        if (!SwitchRollingBuffer(state))
+            return nullptr;
+        state = rolling_state_.load(fbl::memory_order_relaxed);
+    }
+}
+
+bool trace_context::SwitchRollingBuffer(uint64_t state) {
+    if (buffering_mode_ == TRACE_BUFFERING_MODE_ONESHOT) {
+        MarkBufferFull();
+        return false;
+    }
+
+    uint32_t wrapped_count = RollingWrappedCount(state);
+    uint64_t durable_data_end;
+    {
+        fbl::AutoLock lock(&rolling_mutex_);
+
+        // Another writer may have switched buffers or taken the last few
+        // bytes in the meantime.
+        if (rolling_state_.load(fbl::memory_order_relaxed) != state)
+            return true;
+
+        uint32_t current = wrapped_count & 1u;
+        uint32_t next = current ^ 1u;
+        if (rolling_busy_[next]) {
+            // The handler has yet to save the other buffer.
+            num_records_dropped_.fetch_add(1u, fbl::memory_order_relaxed);
+            return false;
+        }
+
+        // Writers still holding a lane in the buffer we are about to reuse
+        // in circular mode can race with the new records; their lanes are
+        // retired as soon as they notice the new wrapped count.
+        rolling_data_end_[current] = RollingOffset(state);
+        rolling_data_end_[next] = 0u;
+        if (buffering_mode_ == TRACE_BUFFERING_MODE_STREAMING)
+            rolling_busy_[current] = true;
+        rolling_state_.store(MakeRollingState(wrapped_count + 1u, 0u),
+                             fbl::memory_order_relaxed);
+        WriteBufferHeaderLocked();
+        durable_data_end = durable_current_.load(fbl::memory_order_relaxed);
+    }
+
+    // Notify outside the lock in case the handler saves the buffer and
+    // calls back into the engine right away.
+    if (buffering_mode_ == TRACE_BUFFERING_MODE_STREAMING)
+        handler_->ops->notify_buffer_full(handler_, wrapped_count, durable_data_end);
+    return true;
+}
+
+void trace_context::MarkBufferFull() {
+    num_records_dropped_.fetch_add(1u, fbl::memory_order_relaxed);
+
+    uint32_t expected = 0u;
+    if (buffer_full_.compare_exchange_strong(&expected, 1u,
+                                             fbl::memory_order_relaxed,
+                                             fbl::memory_order_relaxed)) {
         // Notify the trace manager so it can notify the user that a record
         // (likely) got dropped.
         handler_->ops->buffer_overflow(handler_);
     }
+}
+
+zx_status_t trace_context::MarkRollingBufferSaved(uint32_t wrapped_count) {
+    if (buffering_mode_ != TRACE_BUFFERING_MODE_STREAMING)
+        return ZX_ERR_BAD_STATE;
+
+    fbl::AutoLock lock(&rolling_mutex_);
+    uint32_t index = wrapped_count & 1u;
+    uint64_t state = rolling_state_.load(fbl::memory_order_relaxed);
+    if (!rolling_busy_[index] || wrapped_count >= RollingWrappedCount(state))
+        return ZX_ERR_BAD_STATE;
+    rolling_busy_[index] = false;
+    return ZX_OK;
+}
+
+void trace_context::UpdateBufferHeaderAfterStopped() {
+    if (!header_)
+        return;
+
+    fbl::AutoLock lock(&rolling_mutex_);
+    uint64_t state = rolling_state_.load(fbl::memory_order_relaxed);
+    rolling_data_end_[RollingWrappedCount(state) & 1u] = RollingOffset(state);
+    WriteBufferHeaderLocked();
+}
 
-    return nullptr;
+void trace_context::WriteBufferHeaderLocked() {
+    uint64_t state = rolling_state_.load(fbl::memory_order_relaxed);
+    header_->magic = TRACE_BUFFER_HEADER_MAGIC;
+    header_->version = TRACE_BUFFER_HEADER_VERSION;
+    header_->buffering_mode = static_cast<uint8_t>(buffering_mode_);
+    header_->reserved1 = 0u;
+    header_->wrapped_count = RollingWrappedCount(state);
+    header_->total_size = buffer_end_ - buffer_start_;
+    header_->durable_buffer_size = durable_size_;
+    header_->rolling_buffer_size = rolling_size_;
+    header_->durable_data_end = durable_current_.load(fbl::memory_order_relaxed);
+    header_->rolling_data_end[0] = rolling_data_end_[0];
+    header_->rolling_data_end[1] = rolling_data_end_[1];
+    header_->num_records_dropped = num_records_dropped_.load(fbl::memory_order_relaxed);
 }
 
 bool trace_context::AllocThreadIndex(trace_thread_index_t* out_index) {
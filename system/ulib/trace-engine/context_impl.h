@@ -7,6 +7,7 @@
 #include <zircon/assert.h>
 
 #include <fbl/atomic.h>
+#include <fbl/mutex.h>
 
 #include <trace-engine/context.h>
 #include <trace-engine/handler.h>
@@ -16,46 +17,127 @@
 // context references.
 // Implements the opaque type declared in <trace-engine/context.h>.
 struct trace_context {
-    trace_context(void* buffer, size_t buffer_num_bytes, trace_handler_t* handler);
+    trace_context(void* buffer, size_t buffer_num_bytes,
+                  trace_buffering_mode_t buffering_mode,
+                  trace_handler_t* handler);
 
     ~trace_context();
 
+    // Returns true if a buffer of |buffer_num_bytes| can be used in
+    // |buffering_mode|.
+    static bool IsBufferSizeValid(trace_buffering_mode_t buffering_mode,
+                                  size_t buffer_num_bytes);
+
     uint32_t generation() const { return generation_; }
 
     trace_handler_t* handler() const { return handler_; }
 
+    trace_buffering_mode_t buffering_mode() const { return buffering_mode_; }
+
+    // Only meaningful in oneshot mode: the other modes never run out of room
+    // for good.
     bool is_buffer_full() const {
-        return buffer_full_mark_.load(fbl::memory_order_relaxed) != 0u;
+        return buffer_full_.load(fbl::memory_order_relaxed) != 0u;
     }
 
+    // In oneshot mode, the number of bytes at the start of the buffer which
+    // hold records.  In the other modes the header describes where the
+    // records are, so this is the whole buffer.
     size_t bytes_allocated() const {
-        uintptr_t tail = buffer_full_mark_.load(fbl::memory_order_relaxed);
-        if (!tail)
-            tail = buffer_current_.load(fbl::memory_order_relaxed);
-        return reinterpret_cast<uint8_t*>(tail) - buffer_start_;
+        if (buffering_mode_ != TRACE_BUFFERING_MODE_ONESHOT)
+            return buffer_end_ - buffer_start_;
+        return RollingOffset(rolling_state_.load(fbl::memory_order_relaxed));
     }
 
+    // Allocates space for a record in the rolling buffer.
+    // Small records are carved out of a per-thread lane so that concurrent
+    // writers rarely touch the shared allocation state.
     uint64_t* AllocRecord(size_t num_bytes);
+
+    // Allocates space for a record which other records refer to and which
+    // must therefore outlive the rolling buffers: the initialization record
+    // and string and thread records.  Same as |AllocRecord()| in oneshot mode.
+    uint64_t* AllocDurableRecord(size_t num_bytes);
+
     bool AllocThreadIndex(trace_thread_index_t* out_index);
     bool AllocStringIndex(trace_string_index_t* out_index);
 
+    // Streaming mode: the handler has saved rolling buffer |wrapped_count & 1|.
+    zx_status_t MarkRollingBufferSaved(uint32_t wrapped_count);
+
+    // Brings the buffer header up to date once all writers are gone.
+    void UpdateBufferHeaderAfterStopped();
+
 private:
+    // The rolling allocation state packs the number of times the rolling
+    // buffers were switched in the upper 32 bits and the offset into the
+    // current rolling buffer in the lower 32 bits, so both change atomically.
+    static uint32_t RollingWrappedCount(uint64_t state) {
+        return static_cast<uint32_t>(state >> 32);
+    }
+    static uint32_t RollingOffset(uint64_t state) {
+        return static_cast<uint32_t>(state);
+    }
+    static uint64_t MakeRollingState(uint32_t wrapped_count, uint32_t offset) {
+        return (static_cast<uint64_t>(wrapped_count) << 32) | offset;
+    }
+
+    // Reserves between |min_bytes| and |max_bytes| in the current rolling
+    // buffer, switching buffers if it is full and the mode allows it.
+    // Returns null if not even |min_bytes| could be had.
+    uint8_t* AllocRollingBytes(size_t min_bytes, size_t max_bytes,
+                               size_t* out_num_bytes, uint32_t* out_wrapped_count);
+
+    // Called when the rolling buffer described by |state| cannot satisfy an
+    // allocation.  Returns true if the caller should try again.
+    bool SwitchRollingBuffer(uint64_t state);
+
+    void MarkBufferFull();
+    void WriteBufferHeaderLocked() __TA_REQUIRES(rolling_mutex_);
+
     // The generation counter associated with this context to distinguish
     // it from previously created contexts.
     uint32_t const generation_;
 
+    trace_buffering_mode_t const buffering_mode_;
+
     // Buffer start and end pointers.
     uint8_t* const buffer_start_;
     uint8_t* const buffer_end_;
 
-    // Current allocation pointer.
-    // Starts at |buffer_start| and grows from there.
-    // May exceed |buffer_end| when the buffer is full.
-    fbl::atomic<uintptr_t> buffer_current_;
+    // The header at |buffer_start_|, or null in oneshot mode.
+    trace_buffer_header_t* const header_;
+
+    // The durable region, empty in oneshot mode.
+    uint8_t* const durable_start_;
+    size_t const durable_size_;
+
+    // Number of bytes allocated from the durable region.
+    // Never exceeds |durable_size_|.
+    fbl::atomic<uint64_t> durable_current_{0u};
+
+    // The rolling buffers.  In oneshot mode there is just the one, spanning
+    // the whole buffer.
+    uint8_t* rolling_start_[2];
+    size_t const rolling_size_;
+
+    // See |MakeRollingState()|.  The offset never exceeds |rolling_size_|.
+    fbl::atomic<uint64_t> rolling_state_{0u};
+
+    // Set once when the buffer first fills up in oneshot mode.
+    fbl::atomic<uint32_t> buffer_full_{0u};
+
+    // Number of records dropped for lack of space.
+    fbl::atomic<uint64_t> num_records_dropped_{0u};
+
+    // Guards switching rolling buffers and the header.
+    fbl::Mutex rolling_mutex_;
+
+    // Bytes written to each rolling buffer as of the last switch.
+    uint64_t rolling_data_end_[2] __TA_GUARDED(rolling_mutex_) = {};
 
-    // Pointer beyond the last successful allocation, or null if not full.
-    // Only ever set to non-null once in the lifetime of the trace context.
-    fbl::atomic<uintptr_t> buffer_full_mark_;
+    // Streaming mode: whether each rolling buffer is waiting to be saved.
+    bool rolling_busy_[2] __TA_GUARDED(rolling_mutex_) = {};
 
     // Handler associated with the trace session.
     trace_handler_t* const handler_;
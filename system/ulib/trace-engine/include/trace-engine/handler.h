@@ -18,6 +18,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include <zircon/compiler.h>
 #include <zircon/types.h>
@@ -30,9 +31,62 @@ __BEGIN_CDECLS
 // Trace handler interface.
 //
 // Implementations must supply valid function pointers for each function
-// defined in the |ops| structure.
+// defined in the |ops| structure unless noted otherwise.
 typedef struct trace_handler_ops trace_handler_ops_t;
 
+// Describes how the trace engine uses the trace buffer.
+typedef enum {
+    // Records are written sequentially until the buffer fills up, after
+    // which further records are dropped.
+    TRACE_BUFFERING_MODE_ONESHOT = 0,
+    // The buffer is split into a durable region which holds records that
+    // others refer to (initialization, strings, threads) and two rolling
+    // halves.  When one half fills up the engine switches to the other,
+    // discarding whatever it held, so the buffer retains the most recent
+    // records.
+    TRACE_BUFFERING_MODE_CIRCULAR = 1,
+    // Laid out like |TRACE_BUFFERING_MODE_CIRCULAR| but the engine only
+    // switches to a half once the handler has saved its contents: the handler
+    // is told through |notify_buffer_full()| when a half fills up and reports
+    // back with |trace_engine_mark_buffer_saved()|.  Records written while
+    // neither half is available are dropped.
+    TRACE_BUFFERING_MODE_STREAMING = 2,
+} trace_buffering_mode_t;
+
+// Magic number identifying a |trace_buffer_header_t|.
+#define TRACE_BUFFER_HEADER_MAGIC ((uint64_t)0x7472616365627566ull) // "tracebuf"
+
+// Version of the |trace_buffer_header_t| layout.
+#define TRACE_BUFFER_HEADER_VERSION 0
+
+// Header written at the start of the trace buffer in the circular and
+// streaming buffering modes.  The buffer is laid out as follows:
+//
+//   [header][durable region][rolling buffer 0][rolling buffer 1]
+//
+// All offsets are relative to the start of their region and all sizes are
+// multiples of 8 bytes.  The header is kept up to date each time the engine
+// switches rolling buffers and when tracing stops.
+typedef struct trace_buffer_header {
+    uint64_t magic;
+    uint16_t version;
+    uint8_t buffering_mode;
+    uint8_t reserved1;
+    // Number of times the engine has switched rolling buffers.
+    // The rolling buffer currently being written is |wrapped_count & 1|.
+    uint32_t wrapped_count;
+    uint64_t total_size;
+    uint64_t durable_buffer_size;
+    uint64_t rolling_buffer_size;
+    // Bytes written to the durable region.
+    uint64_t durable_data_end;
+    // Bytes written to each rolling buffer.
+    uint64_t rolling_data_end[2];
+    // Number of records which could not be written because there was no
+    // room for them.
+    uint64_t num_records_dropped;
+} trace_buffer_header_t;
+
 typedef struct trace_handler {
     const trace_handler_ops_t* ops;
 } trace_handler_t;
@@ -73,6 +127,23 @@ struct trace_handler_ops {
     //
     // Called by instrumentation on any thread.  Must be thread-safe.
     void (*buffer_overflow)(trace_handler_t* handler);
+
+    // Called by the trace engine in |TRACE_BUFFERING_MODE_STREAMING| when a
+    // rolling buffer has filled up and is ready to be saved.
+    //
+    // |handler| is the trace handler object itself.
+    // |wrapped_count| identifies the rolling buffer which filled up; it is
+    // rolling buffer |wrapped_count & 1|.  The handler must pass the same
+    // value to |trace_engine_mark_buffer_saved()| once it has saved the
+    // buffer's contents.
+    // |durable_data_end| is the number of bytes written to the durable region
+    // so far.
+    //
+    // Called by instrumentation on any thread.  Must be thread-safe and must
+    // not block.  May be null if the handler never starts the engine in
+    // streaming mode.
+    void (*notify_buffer_full)(trace_handler_t* handler, uint32_t wrapped_count,
+                               uint64_t durable_data_end);
 };
 
 // Asynchronously starts the trace engine.
@@ -109,6 +180,23 @@ zx_status_t trace_start_engine(async_t* async,
                                void* buffer,
                                size_t buffer_num_bytes);
 
+// Like |trace_start_engine()| but with an explicit buffering mode.
+//
+// |trace_start_engine()| is equivalent to passing |TRACE_BUFFERING_MODE_ONESHOT|.
+// In the other modes the buffer begins with a |trace_buffer_header_t| which
+// describes where the records are, and the |buffer_bytes_written| reported to
+// |trace_handler_ops.trace_stopped()| covers the whole buffer.
+//
+// Returns |ZX_ERR_INVALID_ARGS| if |buffering_mode| is not recognized, if the
+// buffer is too small for it, or if streaming mode is requested and the
+// handler does not implement |notify_buffer_full()|.
+// Otherwise behaves like |trace_start_engine()|.
+zx_status_t trace_start_engine_with_mode(async_t* async,
+                                         trace_handler_t* handler,
+                                         trace_buffering_mode_t buffering_mode,
+                                         void* buffer,
+                                         size_t buffer_num_bytes);
+
 // Asynchronously stops the trace engine.
 //
 // The trace handler's |trace_stopped()| method will be invoked asynchronously
@@ -123,4 +211,17 @@ zx_status_t trace_start_engine(async_t* async,
 // This function is thread-safe.
 zx_status_t trace_stop_engine(zx_status_t disposition);
 
+// Tells the trace engine that the handler has saved the contents of the
+// rolling buffer reported by |trace_handler_ops.notify_buffer_full()|, so the
+// engine may write into it again.
+//
+// |wrapped_count| is the value passed to |notify_buffer_full()|.
+//
+// Returns |ZX_OK| on success.
+// Returns |ZX_ERR_BAD_STATE| if tracing is not running in streaming mode or
+// the buffer was not waiting to be saved.
+//
+// This function is thread-safe.
+zx_status_t trace_engine_mark_buffer_saved(uint32_t wrapped_count);
+
 __END_CDECLS
@@ -0,0 +1,118 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <trace-reader/reader.h>
+#include <trace-reader/records.h>
+
+#include <fbl/function.h>
+#include <fbl/macros.h>
+#include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
+
+namespace trace {
+
+// Reads large traces without decoding them front to back.
+//
+// The trace is memory-mapped and indexed up front by a pass which only looks
+// at record headers: it splits the trace into segments at record boundaries,
+// notes the range of timestamps within each segment, and remembers where the
+// records which define the string and thread tables and select the current
+// provider are.  Any segment can then be decoded on its own by first replaying
+// the definitions which precede it, so segments can be decoded in parallel
+// and time range queries only decode the segments which overlap the range.
+class IndexedTraceReader final {
+public:
+    using RecordConsumer = TraceReader::RecordConsumer;
+    using ErrorHandler = TraceReader::ErrorHandler;
+
+    // Called once for each record read by |ReadAllParallel|, along with the
+    // index of the segment it came from.
+    using SegmentRecordConsumer = fbl::Function<void(size_t segment_index, Record)>;
+
+    static constexpr size_t kDefaultSegmentSizeBytes = 4u * 1024u * 1024u;
+
+    struct Segment {
+        // Range of words in the trace covered by the segment.
+        size_t begin_word;
+        size_t end_word;
+
+        // Number of definition records which precede the segment.
+        size_t definition_count;
+
+        // Smallest and largest timestamp of the records in the segment.
+        // |min_timestamp| is greater than |max_timestamp| if none of the
+        // records have timestamps.
+        trace_ticks_t min_timestamp;
+        trace_ticks_t max_timestamp;
+    };
+
+    ~IndexedTraceReader();
+
+    // Maps the trace file at |path| and indexes it.
+    // Segments are cut after the first record which takes them to at least
+    // |segment_size_bytes|.
+    // Returns false and reports an error if the file could not be mapped.
+    // Corruption found while indexing is reported but only truncates the index.
+    static bool OpenFile(const char* path, ErrorHandler error_handler,
+                         fbl::unique_ptr<IndexedTraceReader>* out_reader,
+                         size_t segment_size_bytes = kDefaultSegmentSizeBytes);
+
+    // Indexes a trace which is already in memory.
+    // |data| must be 8-byte aligned and outlive the reader.
+    static bool Create(const void* data, size_t num_bytes, ErrorHandler error_handler,
+                       fbl::unique_ptr<IndexedTraceReader>* out_reader,
+                       size_t segment_size_bytes = kDefaultSegmentSizeBytes);
+
+    size_t segment_count() const { return segments_.size(); }
+    const Segment& segment(size_t index) const { return segments_[index]; }
+
+    // Decodes the records of one segment, invoking |record_consumer| for
+    // each.  Returns false if the segment is unrecoverably corrupt.
+    //
+    // This function is thread-safe.
+    bool ReadSegment(size_t index, RecordConsumer record_consumer,
+                     ErrorHandler error_handler) const;
+
+    // Decodes every segment using up to |num_threads| threads.  Records
+    // arrive in order within a segment but segments are decoded concurrently,
+    // so |record_consumer| and |error_handler| must be thread-safe.
+    // Returns false if any segment is unrecoverably corrupt.
+    bool ReadAllParallel(size_t num_threads, SegmentRecordConsumer record_consumer,
+                         ErrorHandler error_handler) const;
+
+    // Decodes only the segments which may hold records with timestamps in
+    // [begin, end] and invokes |record_consumer| for those records, in order.
+    // Records without timestamps from those segments are passed along too.
+    // Returns false if any segment read is unrecoverably corrupt.
+    bool ReadTimeRange(trace_ticks_t begin, trace_ticks_t end,
+                       RecordConsumer record_consumer,
+                       ErrorHandler error_handler) const;
+
+private:
+    IndexedTraceReader(const uint64_t* words, size_t num_words,
+                       void* mapping, size_t mapping_size);
+
+    void BuildIndex(size_t segment_size_bytes, const ErrorHandler& error_handler);
+
+    const uint64_t* const words_;
+    size_t num_words_;
+
+    // The file mapping owned by the reader, or null.
+    void* const mapping_;
+    size_t const mapping_size_;
+
+    fbl::Vector<Segment> segments_;
+
+    // Word offsets of the provider, string and thread definition records.
+    fbl::Vector<size_t> definitions_;
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(IndexedTraceReader);
+};
+
+} // namespace trace
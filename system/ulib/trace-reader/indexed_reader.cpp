@@ -0,0 +1,259 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <trace-reader/indexed_reader.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/atomic.h>
+#include <fbl/string_printf.h>
+#include <trace-engine/fields.h>
+
+namespace trace {
+namespace {
+
+// Gets the timestamp of records which have one.
+bool GetRecordTimestamp(const Record& record, trace_ticks_t* out_timestamp) {
+    switch (record.type()) {
+    case RecordType::kEvent:
+        *out_timestamp = record.GetEvent().timestamp;
+        return true;
+    case RecordType::kContextSwitch:
+        *out_timestamp = record.GetContextSwitch().timestamp;
+        return true;
+    case RecordType::kLog:
+        *out_timestamp = record.GetLog().timestamp;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// State shared by the threads of |ReadAllParallel()|.
+struct ParallelRead {
+    const IndexedTraceReader* reader;
+    const IndexedTraceReader::SegmentRecordConsumer* record_consumer;
+    const IndexedTraceReader::ErrorHandler* error_handler;
+    fbl::atomic<size_t> next_segment{0u};
+    fbl::atomic<bool> ok{true};
+};
+
+void* ParallelReadThread(void* arg) {
+    auto state = static_cast<ParallelRead*>(arg);
+    for (;;) {
+        size_t index = state->next_segment.fetch_add(1u);
+        if (index >= state->reader->segment_count())
+            break;
+        bool ok = state->reader->ReadSegment(
+            index,
+            [state, index](Record record) {
+                (*state->record_consumer)(index, fbl::move(record));
+            },
+            [state](fbl::String error) {
+                (*state->error_handler)(fbl::move(error));
+            });
+        if (!ok)
+            state->ok.store(false);
+    }
+    return nullptr;
+}
+
+} // namespace
+
+IndexedTraceReader::IndexedTraceReader(const uint64_t* words, size_t num_words,
+                                       void* mapping, size_t mapping_size)
+    : words_(words), num_words_(num_words),
+      mapping_(mapping), mapping_size_(mapping_size) {}
+
+IndexedTraceReader::~IndexedTraceReader() {
+    if (mapping_)
+        munmap(mapping_, mapping_size_);
+}
+
+bool IndexedTraceReader::OpenFile(const char* path, ErrorHandler error_handler,
+                                  fbl::unique_ptr<IndexedTraceReader>* out_reader,
+                                  size_t segment_size_bytes) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        error_handler(fbl::StringPrintf("Failed to open %s: %s", path, strerror(errno)));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        error_handler(fbl::StringPrintf("Failed to stat %s: %s", path, strerror(errno)));
+        close(fd);
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    void* mapping = nullptr;
+    if (size) {
+        mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            error_handler(fbl::StringPrintf("Failed to map %s: %s", path, strerror(errno)));
+            close(fd);
+            return false;
+        }
+    }
+    close(fd);
+
+    out_reader->reset(new IndexedTraceReader(static_cast<const uint64_t*>(mapping),
+                                             size / sizeof(uint64_t), mapping, size));
+    (*out_reader)->BuildIndex(segment_size_bytes, error_handler);
+    return true;
+}
+
+bool IndexedTraceReader::Create(const void* data, size_t num_bytes, ErrorHandler error_handler,
+                                fbl::unique_ptr<IndexedTraceReader>* out_reader,
+                                size_t segment_size_bytes) {
+    if (reinterpret_cast<uintptr_t>(data) & 7u) {
+        error_handler("Trace data is not 8-byte aligned");
+        return false;
+    }
+
+    out_reader->reset(new IndexedTraceReader(static_cast<const uint64_t*>(data),
+                                             num_bytes / sizeof(uint64_t), nullptr, 0u));
+    (*out_reader)->BuildIndex(segment_size_bytes, error_handler);
+    return true;
+}
+
+void IndexedTraceReader::BuildIndex(size_t segment_size_bytes,
+                                    const ErrorHandler& error_handler) {
+    const size_t segment_words = fbl::max(segment_size_bytes / sizeof(uint64_t), size_t(1));
+
+    Segment segment{0u, 0u, 0u, UINT64_MAX, 0u};
+    size_t pos = 0u;
+    while (pos < num_words_) {
+        RecordHeader header = words_[pos];
+        auto size = RecordFields::RecordSize::Get<size_t>(header);
+        if (size == 0u || size > num_words_ - pos) {
+            error_handler(fbl::StringPrintf(
+                "Trace is corrupt or truncated at word %zu, ignoring the rest", pos));
+            num_words_ = pos;
+            break;
+        }
+
+        switch (RecordFields::Type::Get<RecordType>(header)) {
+        case RecordType::kMetadata: {
+            auto type = MetadataRecordFields::MetadataType::Get<MetadataType>(header);
+            if (type == MetadataType::kProviderInfo ||
+                type == MetadataType::kProviderSection)
+                definitions_.push_back(pos);
+            break;
+        }
+        case RecordType::kString:
+        case RecordType::kThread:
+            definitions_.push_back(pos);
+            break;
+        case RecordType::kEvent:
+        case RecordType::kContextSwitch:
+        case RecordType::kLog:
+            // The timestamp always follows the header.
+            if (size >= 2u) {
+                trace_ticks_t timestamp = words_[pos + 1];
+                segment.min_timestamp = fbl::min(segment.min_timestamp, timestamp);
+                segment.max_timestamp = fbl::max(segment.max_timestamp, timestamp);
+            }
+            break;
+        default:
+            break;
+        }
+
+        pos += size;
+        if (pos - segment.begin_word >= segment_words) {
+            segment.end_word = pos;
+            segments_.push_back(segment);
+            segment = Segment{pos, pos, definitions_.size(), UINT64_MAX, 0u};
+        }
+    }
+
+    if (pos > segment.begin_word) {
+        segment.end_word = pos;
+        segments_.push_back(segment);
+    }
+}
+
+bool IndexedTraceReader::ReadSegment(size_t index, RecordConsumer record_consumer,
+                                     ErrorHandler error_handler) const {
+    ZX_DEBUG_ASSERT(index < segments_.size());
+    const Segment& segment = segments_[index];
+
+    // Rebuild the provider, string and thread tables as they stood at the
+    // start of the segment without reporting anything.
+    bool replaying = true;
+    TraceReader reader(
+        [&replaying, &record_consumer](Record record) {
+            if (!replaying)
+                record_consumer(fbl::move(record));
+        },
+        [&replaying, &error_handler](fbl::String error) {
+            if (!replaying)
+                error_handler(fbl::move(error));
+        });
+    for (size_t i = 0u; i < segment.definition_count; i++) {
+        const uint64_t* record = words_ + definitions_[i];
+        Chunk chunk(record, RecordFields::RecordSize::Get<size_t>(*record));
+        reader.ReadRecords(chunk);
+    }
+    replaying = false;
+
+    Chunk chunk(words_ + segment.begin_word, segment.end_word - segment.begin_word);
+    return reader.ReadRecords(chunk);
+}
+
+bool IndexedTraceReader::ReadAllParallel(size_t num_threads,
+                                         SegmentRecordConsumer record_consumer,
+                                         ErrorHandler error_handler) const {
+    ParallelRead state;
+    state.reader = this;
+    state.record_consumer = &record_consumer;
+    state.error_handler = &error_handler;
+
+    num_threads = fbl::min(num_threads, segments_.size());
+    fbl::Vector<pthread_t> threads;
+    for (size_t i = 1u; i < num_threads; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, nullptr, &ParallelReadThread, &state) != 0)
+            break; // the threads we have will pick up the slack
+        threads.push_back(thread);
+    }
+    ParallelReadThread(&state);
+    for (pthread_t thread : threads)
+        pthread_join(thread, nullptr);
+
+    return state.ok.load();
+}
+
+bool IndexedTraceReader::ReadTimeRange(trace_ticks_t begin, trace_ticks_t end,
+                                       RecordConsumer record_consumer,
+                                       ErrorHandler error_handler) const {
+    bool ok = true;
+    for (size_t i = 0u; i < segments_.size(); i++) {
+        const Segment& segment = segments_[i];
+        if (segment.min_timestamp > end || segment.max_timestamp < begin)
+            continue;
+
+        ok &= ReadSegment(
+            i,
+            [begin, end, &record_consumer](Record record) {
+                trace_ticks_t timestamp;
+                if (GetRecordTimestamp(record, &timestamp) &&
+                    (timestamp < begin || timestamp > end))
+                    return;
+                record_consumer(fbl::move(record));
+            },
+            [&error_handler](fbl::String error) { error_handler(fbl::move(error)); });
+    }
+    return ok;
+}
+
+} // namespace trace
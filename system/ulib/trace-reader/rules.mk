@@ -11,6 +11,7 @@ MODULE := $(LOCAL_DIR)
 MODULE_TYPE := userlib
 
 MODULE_SRCS = \
+    $(LOCAL_DIR)/indexed_reader.cpp \
     $(LOCAL_DIR)/reader.cpp \
     $(LOCAL_DIR)/records.cpp
 
@@ -33,6 +34,7 @@ MODULE := $(LOCAL_DIR).hostlib
 MODULE_TYPE := hostlib
 
 MODULE_SRCS = \
+    $(LOCAL_DIR)/indexed_reader.cpp \
     $(LOCAL_DIR)/reader.cpp \
     $(LOCAL_DIR)/records.cpp
 
@@ -10,7 +10,8 @@ const trace_handler_ops_t TraceHandler::kOps =
     {.is_category_enabled = &TraceHandler::CallIsCategoryEnabled,
      .trace_started = &TraceHandler::CallTraceStarted,
      .trace_stopped = &TraceHandler::CallTraceStopped,
-     .buffer_overflow = &TraceHandler::CallBufferOverflow};
+     .buffer_overflow = &TraceHandler::CallBufferOverflow,
+     .notify_buffer_full = &TraceHandler::CallNotifyBufferFull};
 
 TraceHandler::TraceHandler()
     : trace_handler{.ops = &kOps} {}
@@ -35,4 +36,9 @@ void TraceHandler::CallBufferOverflow(trace_handler_t* handler) {
     static_cast<TraceHandler*>(handler)->BufferOverflow();
 }
 
+void TraceHandler::CallNotifyBufferFull(trace_handler_t* handler, uint32_t wrapped_count,
+                                        uint64_t durable_data_end) {
+    static_cast<TraceHandler*>(handler)->NotifyBufferFull(wrapped_count, durable_data_end);
+}
+
 } // namespace trace
@@ -8,16 +8,17 @@
 #include <zircon/compiler.h>
 
 // clang-format off
-#define VIRTIO_BLK_F_BARRIER    (1u << 0)
-#define VIRTIO_BLK_F_SIZE_MAX   (1u << 1)
-#define VIRTIO_BLK_F_SEG_MAX    (1u << 2)
-#define VIRTIO_BLK_F_GEOMETRY   (1u << 4)
-#define VIRTIO_BLK_F_RO         (1u << 5)
-#define VIRTIO_BLK_F_BLK_SIZE   (1u << 6)
-#define VIRTIO_BLK_F_SCSI       (1u << 7)
-#define VIRTIO_BLK_F_FLUSH      (1u << 9)
-#define VIRTIO_BLK_F_TOPOLOGY   (1u << 10)
-#define VIRTIO_BLK_F_CONFIG_WCE (1u << 11)
+#define VIRTIO_BLK_F_BARRIER    0
+#define VIRTIO_BLK_F_SIZE_MAX   1
+#define VIRTIO_BLK_F_SEG_MAX    2
+#define VIRTIO_BLK_F_GEOMETRY   4
+#define VIRTIO_BLK_F_RO         5
+#define VIRTIO_BLK_F_BLK_SIZE   6
+#define VIRTIO_BLK_F_SCSI       7
+#define VIRTIO_BLK_F_FLUSH      9
+#define VIRTIO_BLK_F_TOPOLOGY   10
+#define VIRTIO_BLK_F_CONFIG_WCE 11
+#define VIRTIO_BLK_F_MQ         12
 
 #define VIRTIO_BLK_T_IN         0
 #define VIRTIO_BLK_T_OUT        1
@@ -42,6 +43,14 @@ typedef struct virtio_blk_config {
     uint32_t seg_max;
     virtio_blk_geometry_t geometry;
     uint32_t blk_size;
+    uint8_t physical_block_exp;
+    uint8_t alignment_offset;
+    uint16_t min_io_size;
+    uint32_t opt_io_size;
+    uint8_t writeback;
+    uint8_t unused0;
+    // Only valid if VIRTIO_BLK_F_MQ has been negotiated.
+    uint16_t num_queues;
 } __PACKED virtio_blk_config_t;
 
 typedef struct virtio_blk_req {
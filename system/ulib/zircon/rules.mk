@@ -11,7 +11,7 @@ MODULE_TYPE := userlib
 # This library should not depend on libc.
 MODULE_COMPILEFLAGS := -ffreestanding $(NO_SAFESTACK) $(NO_SANITIZERS)
 
-MODULE_HEADER_DEPS := kernel/lib/vdso
+MODULE_HEADER_DEPS := kernel/lib/vdso kernel/lib/fixed_point
 
 MODULE_SRCS := \
     $(LOCAL_DIR)/data.S \
@@ -24,6 +24,7 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/zx_system_get_version.cpp \
     $(LOCAL_DIR)/zx_ticks_get.cpp \
     $(LOCAL_DIR)/zx_ticks_per_second.cpp \
+    $(LOCAL_DIR)/zx_time_get.cpp \
     $(LOCAL_DIR)/syscall-wrappers.cpp \
 
 ifeq ($(ARCH),arm64)
@@ -0,0 +1,25 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <zircon/syscalls.h>
+
+#include <lib/fixed_point.h>
+
+#include "private.h"
+
+zx_time_t _zx_time_get(uint32_t clock_id) {
+    // This is the same arithmetic as the kernel's current_time(), so the two
+    // agree exactly.
+    if (clock_id == ZX_CLOCK_MONOTONIC && DATA_CONSTANTS.monotonic_from_ticks) {
+        const struct fp_32_64 ns_per_tick = {
+            DATA_CONSTANTS.ns_per_tick_l0,
+            DATA_CONSTANTS.ns_per_tick_l32,
+            DATA_CONSTANTS.ns_per_tick_l64,
+        };
+        return u64_mul_u64_fp32_64(VDSO_zx_ticks_get(), ns_per_tick);
+    }
+    return SYSCALL_zx_time_get_kernel(clock_id);
+}
+
+VDSO_INTERFACE_FUNCTION(zx_time_get);
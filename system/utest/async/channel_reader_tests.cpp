@@ -0,0 +1,88 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <async/channel_reader.h>
+#include <async/loop.h>
+
+#include <zircon/syscalls.h>
+#include <zx/channel.h>
+#include <unittest/unittest.h>
+
+namespace {
+
+constexpr uint32_t kNumMessages = 40u;
+constexpr uint32_t kLargeMessage = 17u;
+constexpr uint32_t kLargeMessageBytes = 8192u;
+
+struct BatchHandler {
+    explicit BatchHandler(async::ChannelReader* reader) {
+        reader->set_handler([this](async_t* async, zx_status_t status,
+                                   const zx_channel_read_msg_t* msgs, uint32_t count) {
+            last_status = status;
+            if (status != ZX_OK)
+                return ASYNC_WAIT_FINISHED;
+            batch_count++;
+            for (uint32_t i = 0; i < count; i++) {
+                const uint8_t* bytes = static_cast<const uint8_t*>(msgs[i].bytes);
+                if (msgs[i].actual_bytes == 0u || bytes[0] != (message_count & 0xff))
+                    bad_messages++;
+                message_count++;
+            }
+            return ASYNC_WAIT_AGAIN;
+        });
+    }
+
+    zx_status_t last_status = ZX_ERR_INTERNAL;
+    uint32_t batch_count = 0u;
+    uint32_t message_count = 0u;
+    uint32_t bad_messages = 0u;
+};
+
+bool channel_reader_test() {
+    BEGIN_TEST;
+
+    async::Loop loop;
+    zx::channel local, remote;
+    ASSERT_EQ(ZX_OK, zx::channel::create(0u, &local, &remote), "create channel");
+
+    async::ChannelReader reader(loop.async(), local.get(), 16u, 64u);
+    BatchHandler handler(&reader);
+    EXPECT_EQ(ZX_OK, reader.Begin(), "begin");
+
+    // Queue every message before running the loop, with one that only fits
+    // in the first buffer of a batch.
+    static uint8_t payload[kNumMessages][kLargeMessageBytes];
+    zx_channel_write_msg_t msgs[kNumMessages];
+    for (uint32_t i = 0; i < kNumMessages; i++) {
+        payload[i][0] = static_cast<uint8_t>(i);
+        msgs[i] = zx_channel_write_msg_t{
+            payload[i], nullptr, i == kLargeMessage ? kLargeMessageBytes : 8u, 0u};
+    }
+    uint32_t actual = 0u;
+    EXPECT_EQ(ZX_OK, zx_channel_write_many(remote.get(), 0u, msgs, kNumMessages, &actual),
+              "write many");
+    EXPECT_EQ(kNumMessages, actual, "all messages written");
+
+    EXPECT_EQ(ZX_OK, loop.RunUntilIdle(), "run loop");
+    EXPECT_EQ(ZX_OK, handler.last_status, "status");
+    EXPECT_EQ(kNumMessages, handler.message_count, "message count");
+    EXPECT_EQ(0u, handler.bad_messages, "messages in order");
+    EXPECT_GE(handler.batch_count, 3u, "batched");
+    EXPECT_LT(handler.batch_count, kNumMessages, "batched");
+    EXPECT_TRUE(reader.is_pending(), "still reading");
+
+    // Closing the peer finishes the reader.
+    remote.reset();
+    EXPECT_EQ(ZX_OK, loop.RunUntilIdle(), "run loop");
+    EXPECT_EQ(ZX_ERR_PEER_CLOSED, handler.last_status, "peer closed");
+    EXPECT_FALSE(reader.is_pending(), "finished");
+
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(channel_reader_tests)
+RUN_TEST(channel_reader_test)
+END_TEST_CASE(channel_reader_tests)
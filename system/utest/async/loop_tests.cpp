@@ -2,6 +2,8 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <inttypes.h>
+#include <stdlib.h>
 #include <threads.h>
 
 #include <zircon/syscalls.h>
@@ -96,6 +98,26 @@ protected:
     }
 };
 
+class CancelOtherWait : public TestWait {
+public:
+    CancelOtherWait(zx_handle_t object, zx_signals_t trigger)
+        : TestWait(object, trigger) {}
+
+    void set_other(TestWait* other) { other_ = other; }
+
+    zx_status_t cancel_status = ZX_ERR_INTERNAL;
+
+protected:
+    TestWait* other_ = nullptr;
+
+    async_wait_result_t Handle(async_t* async, zx_status_t status,
+                               const zx_packet_signal_t* signal) override {
+        TestWait::Handle(async, status, signal);
+        cancel_status = other_->op.Cancel(async);
+        return ASYNC_WAIT_FINISHED;
+    }
+};
+
 class TestTask {
 public:
     TestTask(zx_time_t deadline)
@@ -172,6 +194,23 @@ protected:
     }
 };
 
+class OrderTask : public TestTask {
+public:
+    OrderTask(zx_time_t deadline, uint32_t id, uint32_t* order, uint32_t* count)
+        : TestTask(deadline), id_(id), order_(order), count_(count) {}
+
+protected:
+    uint32_t id_;
+    uint32_t* order_;
+    uint32_t* count_;
+
+    async_task_result_t Handle(async_t* async, zx_status_t status) override {
+        TestTask::Handle(async, status);
+        order_[(*count_)++] = id_;
+        return ASYNC_TASK_FINISHED;
+    }
+};
+
 class TestReceiver {
 public:
     TestReceiver() {
@@ -388,6 +427,32 @@ bool wait_test() {
     END_TEST;
 }
 
+bool wait_cancel_from_handler_test() {
+    BEGIN_TEST;
+
+    async::Loop loop;
+    zx::event event;
+    EXPECT_EQ(ZX_OK, zx::event::create(0u, &event), "create event");
+
+    // Both packets are pending when the loop wakes up, so they are dequeued
+    // together.  Whichever runs first cancels the other, which must then not
+    // run even though its packet has already left the port.
+    CancelOtherWait wait1(event.get(), ZX_USER_SIGNAL_0);
+    CancelOtherWait wait2(event.get(), ZX_USER_SIGNAL_1);
+    wait1.set_other(&wait2);
+    wait2.set_other(&wait1);
+    EXPECT_EQ(ZX_OK, wait1.op.Begin(loop.async()), "begin 1");
+    EXPECT_EQ(ZX_OK, wait2.op.Begin(loop.async()), "begin 2");
+
+    EXPECT_EQ(ZX_OK, event.signal(0u, ZX_USER_SIGNAL_0 | ZX_USER_SIGNAL_1), "signal");
+    EXPECT_EQ(ZX_OK, loop.RunUntilIdle(), "run loop");
+    EXPECT_EQ(1u, wait1.run_count + wait2.run_count, "only one ran");
+    CancelOtherWait& first = wait1.run_count ? wait1 : wait2;
+    EXPECT_EQ(ZX_OK, first.cancel_status, "canceled the other");
+
+    END_TEST;
+}
+
 bool wait_invalid_handle_test() {
     BEGIN_TEST;
 
@@ -615,6 +680,147 @@ bool task_shutdown_test() {
     END_TEST;
 }
 
+bool task_order_test() {
+    const uint32_t num_tasks = 500u;
+
+    BEGIN_TEST;
+
+    async::Loop loop;
+
+    // Post tasks with shuffled deadlines drawn from a handful of values so
+    // that many share a deadline, then cancel every third one.
+    zx_time_t start_time = now();
+    uint32_t order[num_tasks];
+    uint32_t count = 0u;
+    OrderTask* tasks[num_tasks];
+    srand(4);
+    for (uint32_t i = 0; i < num_tasks; i++) {
+        zx_time_t deadline = start_time - ZX_MSEC(1 + rand() % 16);
+        tasks[i] = new OrderTask(deadline, i, order, &count);
+        EXPECT_EQ(ZX_OK, tasks[i]->op.Post(loop.async()), "post");
+    }
+    for (uint32_t i = 0; i < num_tasks; i += 3u) {
+        EXPECT_EQ(ZX_OK, tasks[i]->op.Cancel(loop.async()), "cancel");
+    }
+    QuitTask quit(start_time);
+    EXPECT_EQ(ZX_OK, quit.op.Post(loop.async()), "post quit");
+
+    EXPECT_EQ(ZX_ERR_CANCELED, loop.Run(), "run loop");
+
+    // Tasks run earliest deadline first, and in posting order when their
+    // deadlines are equal.
+    EXPECT_EQ(num_tasks - (num_tasks + 2u) / 3u, count, "ran all but canceled");
+    for (uint32_t i = 1; i < count; i++) {
+        zx_time_t prev = tasks[order[i - 1]]->op.deadline();
+        zx_time_t cur = tasks[order[i]]->op.deadline();
+        EXPECT_TRUE(prev < cur || (prev == cur && order[i - 1] < order[i]), "dispatch order");
+    }
+    for (uint32_t i = 0; i < num_tasks; i++) {
+        EXPECT_EQ(i % 3u ? 1u : 0u, tasks[i]->run_count, "run count");
+        delete tasks[i];
+    }
+
+    loop.Shutdown();
+
+    END_TEST;
+}
+
+// Reports how long it takes to post and then cancel many tasks with random
+// deadlines.  Nothing is asserted about the timing; this is here to catch
+// regressions by eye.
+bool task_post_cancel_speed_test() {
+    const uint32_t num_tasks = 10000u;
+
+    BEGIN_TEST;
+
+    async::Loop loop;
+
+    TestTask** tasks = new TestTask*[num_tasks];
+    uint32_t* cancel_order = new uint32_t[num_tasks];
+    zx_time_t start_time = now();
+    srand(5);
+    for (uint32_t i = 0; i < num_tasks; i++) {
+        tasks[i] = new TestTask(start_time + ZX_SEC(3600) + ZX_USEC(rand() % 1000000));
+        cancel_order[i] = i;
+    }
+    for (uint32_t i = num_tasks - 1u; i > 0u; i--) {
+        uint32_t j = rand() % (i + 1u);
+        uint32_t t = cancel_order[i];
+        cancel_order[i] = cancel_order[j];
+        cancel_order[j] = t;
+    }
+
+    zx_time_t t0 = now();
+    for (uint32_t i = 0; i < num_tasks; i++) {
+        EXPECT_EQ(ZX_OK, tasks[i]->op.Post(loop.async()), "post");
+    }
+    zx_time_t t1 = now();
+    for (uint32_t i = 0; i < num_tasks; i++) {
+        EXPECT_EQ(ZX_OK, tasks[cancel_order[i]]->op.Cancel(loop.async()), "cancel");
+    }
+    zx_time_t t2 = now();
+
+    unittest_printf_critical("\n    %u tasks: post %" PRIu64 "ns/task, cancel %" PRIu64 "ns/task\n",
+                             num_tasks, (t1 - t0) / num_tasks, (t2 - t1) / num_tasks);
+
+    for (uint32_t i = 0; i < num_tasks; i++) {
+        EXPECT_EQ(0u, tasks[i]->run_count, "run count");
+        delete tasks[i];
+    }
+    delete[] cancel_order;
+    delete[] tasks;
+
+    loop.Shutdown();
+
+    END_TEST;
+}
+
+bool executor_task_test() {
+    BEGIN_TEST;
+
+    async_loop_config_t config{};
+    config.executor = true;
+    async::Loop loop(&config);
+
+    zx_time_t start_time = now();
+    TestTask task1(start_time);
+    RepeatingTask task2(start_time, 0, 3u);
+    TestTask task3(start_time);
+    TestTask task4(start_time + ZX_MSEC(1));
+
+    EXPECT_EQ(ZX_OK, task1.op.Post(loop.async()), "post 1");
+    EXPECT_EQ(ZX_OK, task2.op.Post(loop.async()), "post 2");
+    EXPECT_EQ(ZX_OK, task3.op.Post(loop.async()), "post 3");
+    EXPECT_EQ(ZX_OK, task4.op.Post(loop.async()), "post 4");
+
+    // Cancel ready task 3 before it runs.
+    EXPECT_EQ(ZX_OK, task3.op.Cancel(loop.async()), "cancel 3");
+    EXPECT_EQ(ZX_ERR_NOT_FOUND, task3.op.Cancel(loop.async()), "cancel 3 again");
+
+    // Ready tasks, including the repeats, run without waiting on the timer.
+    EXPECT_EQ(ZX_ERR_TIMED_OUT, loop.RunUntilIdle(), "run until idle");
+    EXPECT_EQ(1u, task1.run_count, "run count 1");
+    EXPECT_EQ(ZX_OK, task1.last_status, "status 1");
+    EXPECT_EQ(4u, task2.run_count, "run count 2");
+    EXPECT_EQ(ZX_OK, task2.last_status, "status 2");
+    EXPECT_EQ(0u, task3.run_count, "run count 3");
+
+    // Tasks with later deadlines still go through the timer.
+    EXPECT_EQ(ZX_ERR_TIMED_OUT, loop.Run(start_time + ZX_MSEC(10)), "run loop");
+    EXPECT_EQ(1u, task4.run_count, "run count 4");
+    EXPECT_EQ(ZX_OK, task4.last_status, "status 4");
+
+    // Ready tasks which are still queued at shutdown are canceled.
+    TestTask task5(start_time);
+    task5.op.set_flags(ASYNC_FLAG_HANDLE_SHUTDOWN);
+    EXPECT_EQ(ZX_OK, task5.op.Post(loop.async()), "post 5");
+    loop.Shutdown();
+    EXPECT_EQ(1u, task5.run_count, "run count 5");
+    EXPECT_EQ(ZX_ERR_CANCELED, task5.last_status, "status 5");
+
+    END_TEST;
+}
+
 bool receiver_test() {
     const zx_packet_user_t data1{.u64 = {11, 12, 13, 14}};
     const zx_packet_user_t data2{.u64 = {21, 22, 23, 24}};
@@ -941,6 +1147,48 @@ bool threads_receivers_run_concurrently_test() {
     END_TEST;
 }
 
+// The goal here is to check that ready tasks posted to a loop in executor
+// mode are spread across its threads instead of running one at a time.
+bool threads_executor_tasks_run_concurrently_test() {
+    const size_t num_threads = 4;
+    const size_t num_items = 100;
+
+    BEGIN_TEST;
+
+    async_loop_config_t config{};
+    config.executor = true;
+    async::Loop loop(&config);
+    for (size_t i = 0; i < num_threads; i++) {
+        EXPECT_EQ(ZX_OK, loop.StartThread(), "start thread");
+    }
+
+    ConcurrencyMeasure measure(num_items);
+
+    // Post a number of work items which are all due already.
+    ThreadAssertTask* items[num_items];
+    zx_time_t start_time = now();
+    for (size_t i = 0; i < num_items; i++) {
+        items[i] = new ThreadAssertTask(start_time, &measure);
+        EXPECT_EQ(ZX_OK, items[i]->op.Post(loop.async()), "post task");
+    }
+
+    // Wait until quitted.
+    loop.JoinThreads();
+
+    // Ensure all work items completed.
+    EXPECT_EQ(num_items, measure.count(), "item count");
+    for (size_t i = 0; i < num_items; i++) {
+        EXPECT_EQ(1u, items[i]->run_count, "run count");
+        EXPECT_EQ(ZX_OK, items[i]->last_status, "status");
+        delete items[i];
+    }
+
+    // Ensure that we actually ran many tasks concurrently on different threads.
+    EXPECT_NE(1u, measure.max_threads(), "tasks handled concurrently");
+
+    END_TEST;
+}
+
 } // namespace
 
 BEGIN_TEST_CASE(loop_tests)
@@ -949,11 +1197,15 @@ RUN_TEST(make_default_false_test)
 RUN_TEST(make_default_true_test)
 RUN_TEST(quit_test)
 RUN_TEST(wait_test)
+RUN_TEST(wait_cancel_from_handler_test)
 RUN_TEST(wait_invalid_handle_test)
 RUN_TEST(wait_shutdown_test)
 RUN_TEST(wait_method_test)
 RUN_TEST(task_test)
 RUN_TEST(task_shutdown_test)
+RUN_TEST(task_order_test)
+RUN_TEST(task_post_cancel_speed_test)
+RUN_TEST(executor_task_test)
 RUN_TEST(receiver_test)
 RUN_TEST(receiver_shutdown_test)
 RUN_TEST(threads_have_default_dispatcher)
@@ -963,5 +1215,6 @@ for (int i = 0; i < 3; i++) {
     RUN_TEST(threads_waits_run_concurrently_test)
     RUN_TEST(threads_tasks_run_sequentially_test)
     RUN_TEST(threads_receivers_run_concurrently_test)
+    RUN_TEST(threads_executor_tasks_run_concurrently_test)
 }
 END_TEST_CASE(loop_tests)
@@ -441,6 +441,70 @@ static bool GrowFailure(void) {
     END_TEST;
 }
 
+template <typename RawBitmap>
+static bool SummaryFind(void) {
+    BEGIN_TEST;
+
+    // Large enough for three summary levels.
+    constexpr size_t kSize = kBits * kBits * 4 + 17;
+    RawBitmap bitmap;
+    EXPECT_EQ(bitmap.Reset(kSize), ZX_OK);
+    EXPECT_EQ(bitmap.EnableSummary(), ZX_OK);
+
+    size_t out;
+    EXPECT_EQ(bitmap.Set(0, kSize), ZX_OK);
+    EXPECT_EQ(bitmap.Find(false, 0, kSize, 1, &out), ZX_ERR_NO_RESOURCES);
+    EXPECT_EQ(bitmap.Scan(0, kSize, true), kSize);
+
+    // Holes deep in a full bitmap are found, and only where they fit.
+    EXPECT_EQ(bitmap.Clear(kBits * kBits * 3 + 5, kBits * kBits * 3 + 7), ZX_OK);
+    EXPECT_EQ(bitmap.Clear(kSize - 4, kSize), ZX_OK);
+    EXPECT_EQ(bitmap.Find(false, 0, kSize, 2, &out), ZX_OK);
+    EXPECT_EQ(out, kBits * kBits * 3 + 5);
+    EXPECT_EQ(bitmap.Find(false, 0, kSize, 3, &out), ZX_OK);
+    EXPECT_EQ(out, kSize - 4);
+    EXPECT_EQ(bitmap.Find(false, 0, kSize, 5, &out), ZX_ERR_NO_RESOURCES);
+
+    // Filling the holes again is reflected in the summary.
+    EXPECT_EQ(bitmap.Set(kBits * kBits * 3 + 5, kBits * kBits * 3 + 7), ZX_OK);
+    EXPECT_EQ(bitmap.Find(false, 0, kSize, 1, &out), ZX_OK);
+    EXPECT_EQ(out, kSize - 4);
+
+    // Direct writes to the storage are picked up by a rebuild.
+    size_t* data = static_cast<size_t*>(
+        const_cast<void*>(bitmap.StorageUnsafe()->GetData()));
+    data[kBits * 2] = ~size_t(1);
+    bitmap.RebuildSummary();
+    EXPECT_EQ(bitmap.Find(false, 0, kSize, 1, &out), ZX_OK);
+    EXPECT_EQ(out, kBits * kBits * 2);
+
+    bitmap.ClearAll();
+    EXPECT_EQ(bitmap.Find(false, 0, kSize, kSize, &out), ZX_OK);
+    EXPECT_EQ(out, 0u);
+
+    END_TEST;
+}
+
+template <typename RawBitmap>
+static bool SummaryGrow(void) {
+    BEGIN_TEST;
+
+    RawBitmap bitmap;
+    EXPECT_EQ(bitmap.Reset(kBits * 3), ZX_OK);
+    EXPECT_EQ(bitmap.EnableSummary(), ZX_OK);
+    EXPECT_EQ(bitmap.Set(0, kBits * 3), ZX_OK);
+
+    size_t out;
+    EXPECT_EQ(bitmap.Grow(kBits * kBits * 2), ZX_OK);
+    EXPECT_EQ(bitmap.Find(false, 0, bitmap.size(), 1, &out), ZX_OK);
+    EXPECT_EQ(out, kBits * 3);
+
+    EXPECT_EQ(bitmap.Set(0, bitmap.size()), ZX_OK);
+    EXPECT_EQ(bitmap.Find(false, 0, bitmap.size(), 1, &out), ZX_ERR_NO_RESOURCES);
+
+    END_TEST;
+}
+
 #define RUN_TEMPLATIZED_TEST(test, specialization) RUN_TEST(test<specialization>)
 #define ALL_TESTS(specialization)                           \
     RUN_TEMPLATIZED_TEST(InitializedEmpty, specialization)  \
@@ -453,13 +517,15 @@ static bool GrowFailure(void) {
     RUN_TEMPLATIZED_TEST(ClearSubrange, specialization)     \
     RUN_TEMPLATIZED_TEST(BoundaryArguments, specialization) \
     RUN_TEMPLATIZED_TEST(ClearAll, specialization)          \
-    RUN_TEMPLATIZED_TEST(SetOutOfOrder, specialization)
+    RUN_TEMPLATIZED_TEST(SetOutOfOrder, specialization)     \
+    RUN_TEMPLATIZED_TEST(SummaryFind, specialization)
 
 BEGIN_TEST_CASE(raw_bitmap_tests)
 ALL_TESTS(RawBitmapGeneric<DefaultStorage>)
 ALL_TESTS(RawBitmapGeneric<VmoStorage>)
 RUN_TEST(GrowAcrossPage<RawBitmapGeneric<VmoStorage>>)
 RUN_TEST(GrowShrink<RawBitmapGeneric<VmoStorage>>)
+RUN_TEST(SummaryGrow<RawBitmapGeneric<VmoStorage>>)
 RUN_TEST(GrowFailure<RawBitmapGeneric<DefaultStorage>>)
 END_TEST_CASE(raw_bitmap_tests);
 
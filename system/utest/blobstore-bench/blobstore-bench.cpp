@@ -9,6 +9,7 @@
 #include <math.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <threads.h>
 #include <unistd.h>
 
 #include <digest/merkle-tree.h>
@@ -18,6 +19,7 @@
 #include <fbl/new.h>
 #include <fbl/unique_ptr.h>
 #include <fbl/vector.h>
+#include <lz4/lz4.h>
 #include <unittest/unittest.h>
 
 #include "blobstore-bench.h"
@@ -63,19 +65,30 @@ static int GetStartTime() {
     return 0;
 }
 
+// Fills |data| with random bytes. Compressible data is made of runs of
+// repeated random bytes, which LZ4 shrinks to roughly a third.
+static void FillData(char* data, size_t size, bool compressible) {
+    unsigned int seed = static_cast<unsigned int>(zx_ticks_get());
+    for (size_t i = 0; i < size;) {
+        size_t run = compressible ? 1 + rand_r(&seed) % 8 : 1;
+        char c = (char)rand_r(&seed);
+        for (; run > 0 && i < size; run--) {
+            data[i++] = c;
+        }
+    }
+}
+
 // Creates, writes, reads (to verify) and operates on a blob.
 // Returns the result of the post-processing 'func' (true == success).
-static bool GenerateBlob(fbl::unique_ptr<blob_info_t>* out, size_t blob_size) {
+static bool GenerateBlob(fbl::unique_ptr<blob_info_t>* out, size_t blob_size,
+                         bool compressible = false) {
     // Generate a Blob of random data
     fbl::AllocChecker ac;
     fbl::unique_ptr<blob_info_t> info(new (&ac) blob_info_t);
     EXPECT_EQ(ac.check(), true);
     info->data.reset(new (&ac) char[blob_size]);
     EXPECT_EQ(ac.check(), true);
-    unsigned int seed = static_cast<unsigned int>(zx_ticks_get());
-    for (size_t i = 0; i < blob_size; i++) {
-        info->data[i] = (char)rand_r(&seed);
-    }
+    FillData(info->data.get(), blob_size, compressible);
     info->size_data = blob_size;
 
     // Generate the Merkle Tree
@@ -227,6 +240,12 @@ void TestData::get_name_str(test_name_t name, char* name_str) {
     case OPEN:
         strcpy(name_str, "open");
         break;
+    case OPEN_WARM:
+        strcpy(name_str, "warm-open");
+        break;
+    case OPEN_MISS:
+        strcpy(name_str, "miss-open");
+        break;
     case READ:
         strcpy(name_str, "read");
         break;
@@ -386,12 +405,30 @@ bool TestData::read_blobs() {
         size_t index = indices[i];
         const char* path = paths[index];
 
-        // open
+        // open; every fd to the blob was closed after it was written, so
+        // this is a cold open which has to find the blob on disk
         zx_time_t start = zx_ticks_get();
         int fd = open(path, O_RDONLY);
         sample_end(start, OPEN, i);
         ASSERT_GT(fd, 0, "Failed to open blob");
 
+        // open again while the blob is already open
+        start = zx_ticks_get();
+        int warm_fd = open(path, O_RDONLY);
+        sample_end(start, OPEN_WARM, i);
+        ASSERT_GT(warm_fd, 0, "Failed to reopen blob");
+        ASSERT_EQ(close(warm_fd), 0, "Failed to close blob");
+
+        // open a name which is not in the blobstore
+        char miss_path[PATH_MAX];
+        strcpy(miss_path, path);
+        char* last = &miss_path[strlen(miss_path) - 1];
+        *last = (*last == '0') ? '1' : '0';
+        start = zx_ticks_get();
+        int miss_fd = open(miss_path, O_RDONLY);
+        sample_end(start, OPEN_MISS, i);
+        ASSERT_LT(miss_fd, 0, "Opened a blob which should not exist");
+
         fbl::AllocChecker ac;
         fbl::unique_ptr<char[]> buf(new (&ac) char[blob_size]);
         EXPECT_EQ(ac.check(), true);
@@ -411,6 +448,8 @@ bool TestData::read_blobs() {
     }
 
     ASSERT_TRUE(report_test(OPEN));
+    ASSERT_TRUE(report_test(OPEN_WARM));
+    ASSERT_TRUE(report_test(OPEN_MISS));
     ASSERT_TRUE(report_test(READ));
     ASSERT_TRUE(report_test(CLOSE));
     return true;
@@ -479,6 +518,189 @@ static bool benchmark_blob_basic() {
     END_TEST;
 }
 
+struct WriterArgs {
+    size_t blob_size;
+    size_t blob_count;
+    bool success;
+};
+
+// Generates and writes |blob_count| blobs, each of |blob_size| bytes. The
+// blobs are generated up front, so that only writing them is timed.
+static int WriterThread(void* arg) {
+    WriterArgs* args = static_cast<WriterArgs*>(arg);
+    args->success = false;
+
+    fbl::Vector<fbl::unique_ptr<blob_info_t>> blobs;
+    for (size_t i = 0; i < args->blob_count; i++) {
+        fbl::unique_ptr<blob_info_t> info;
+        if (!GenerateBlob(&info, args->blob_size)) {
+            return -1;
+        }
+        fbl::AllocChecker ac;
+        blobs.push_back(fbl::move(info), &ac);
+        if (!ac.check()) {
+            return -1;
+        }
+    }
+
+    for (const auto& info : blobs) {
+        int fd = open(info->path, O_CREAT | O_RDWR);
+        if (fd < 0) {
+            return -1;
+        }
+        bool ok = ftruncate(fd, args->blob_size) == 0 &&
+                  StreamAll(write, fd, info->data.get(), args->blob_size) == 0;
+        if (close(fd) != 0 || !ok) {
+            return -1;
+        }
+    }
+    args->success = true;
+    return 0;
+}
+
+// Writes |BlobCount| blobs split evenly between |Writers| threads, and
+// reports how long it took for all of them to be written.
+template <size_t BlobSize, size_t BlobCount, size_t Writers>
+static bool benchmark_blob_parallel_write() {
+    BEGIN_TEST;
+    static_assert(BlobCount % Writers == 0, "Blobs must divide evenly between writers");
+    ASSERT_TRUE(StartBlobstoreBenchmark(BlobSize, BlobCount, DEFAULT));
+
+    WriterArgs args[Writers];
+    thrd_t threads[Writers];
+    zx_time_t start = zx_ticks_get();
+    for (size_t i = 0; i < Writers; i++) {
+        args[i].blob_size = BlobSize;
+        args[i].blob_count = BlobCount / Writers;
+        ASSERT_EQ(thrd_create(&threads[i], WriterThread, &args[i]), thrd_success);
+    }
+    bool success = true;
+    for (size_t i = 0; i < Writers; i++) {
+        ASSERT_EQ(thrd_join(threads[i], nullptr), thrd_success);
+        success &= args[i].success;
+    }
+    zx_time_t total = (zx_ticks_get() - start) / (zx_ticks_per_second() / 1000);
+
+    printf("\nBenchmark parallel-write: %zu writers, [%10lu] msec for %zu blobs of %zu bytes",
+           Writers, total, BlobCount, BlobSize);
+    FILE* results = fopen(RESULT_FILE, "a");
+    ASSERT_NONNULL(results, "Failed to open results file");
+    fprintf(results, "%lu,%lu,%s,parallel-write,%zu-writers,%lu\n", BlobSize, BlobCount,
+            start_time, Writers, total);
+    fclose(results);
+
+    ASSERT_TRUE(EndBlobstoreBenchmark()); //clean up
+    ASSERT_TRUE(success, "Failed to write blobs");
+    END_TEST;
+}
+
+static bool UsedBytes(size_t* out) {
+    int mountfd = open(MOUNT_PATH, O_RDONLY);
+    ASSERT_GT(mountfd, 0, "Failed to open mount point");
+    char buf[sizeof(vfs_query_info_t) + MAX_FS_NAME_LEN + 1];
+    vfs_query_info_t* info = reinterpret_cast<vfs_query_info_t*>(buf);
+    ssize_t r = ioctl_vfs_query_fs(mountfd, info, sizeof(buf) - 1);
+    ASSERT_EQ(close(mountfd), 0, "Failed to close mount point");
+    ASSERT_GT(r, (ssize_t)sizeof(vfs_query_info_t), "Failed to query fs");
+    *out = info->used_bytes;
+    return true;
+}
+
+// Writes |BlobCount| blobs and then reads each of them back whole. Every fd
+// to a blob is closed once it is written, so reads go to disk (and through
+// decompression, if blobstore was mounted with compression enabled).
+// Reports read throughput and how much disk the blobs took.
+template <size_t BlobSize, size_t BlobCount, bool Compressible>
+static bool benchmark_blob_cold_read() {
+    BEGIN_TEST;
+    ASSERT_TRUE(StartBlobstoreBenchmark(BlobSize, BlobCount, DEFAULT));
+
+    size_t used_before;
+    ASSERT_TRUE(UsedBytes(&used_before));
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<char[][PATH_MAX]> paths(new (&ac) char[BlobCount][PATH_MAX]);
+    ASSERT_TRUE(ac.check());
+    for (size_t i = 0; i < BlobCount; i++) {
+        fbl::unique_ptr<blob_info_t> info;
+        ASSERT_TRUE(GenerateBlob(&info, BlobSize, Compressible));
+        strcpy(paths[i], info->path);
+        int fd = open(info->path, O_CREAT | O_RDWR);
+        ASSERT_GT(fd, 0, "Failed to create blob");
+        ASSERT_EQ(ftruncate(fd, BlobSize), 0, "Failed to truncate blob");
+        ASSERT_EQ(StreamAll(write, fd, info->data.get(), BlobSize), 0, "Failed to write Data");
+        ASSERT_EQ(close(fd), 0, "Failed to close blob");
+    }
+    size_t used_after;
+    ASSERT_TRUE(UsedBytes(&used_after));
+
+    fbl::unique_ptr<char[]> buf(new (&ac) char[BlobSize]);
+    ASSERT_TRUE(ac.check());
+    zx_time_t start = zx_ticks_get();
+    for (size_t i = 0; i < BlobCount; i++) {
+        int fd = open(paths[i], O_RDONLY);
+        ASSERT_GT(fd, 0, "Failed to open blob");
+        bool success = StreamAll(read, fd, &buf[0], BlobSize) == 0;
+        ASSERT_EQ(close(fd), 0, "Failed to close blob");
+        ASSERT_TRUE(success, "Failed to read data");
+    }
+    zx_time_t ticks = zx_ticks_get() - start;
+    double secs = static_cast<double>(ticks) / static_cast<double>(zx_ticks_per_second());
+    double mb_per_sec = static_cast<double>(BlobSize * BlobCount) / MB / secs;
+    size_t used_kb = (used_after - used_before) / KB;
+
+    const char* data = Compressible ? "compressible" : "random";
+    printf("\nBenchmark cold-read %12s: [%8.2f] MB/s, [%8zu] KB on disk for %zu KB of blobs",
+           data, mb_per_sec, used_kb, BlobSize * BlobCount / KB);
+    FILE* results = fopen(RESULT_FILE, "a");
+    ASSERT_NONNULL(results, "Failed to open results file");
+    fprintf(results, "%lu,%lu,%s,cold-read,%s,%f,%zu\n", BlobSize, BlobCount, start_time, data,
+            mb_per_sec, used_kb);
+    fclose(results);
+
+    ASSERT_TRUE(EndBlobstoreBenchmark()); //clean up
+    END_TEST;
+}
+
+// Measures LZ4 decompression of chunks the size blobstore compresses, on
+// their own, without the disk or the filesystem in the way.
+template <size_t ChunkSize, size_t Iterations>
+static bool benchmark_decompression() {
+    BEGIN_TEST;
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<char[]> data(new (&ac) char[ChunkSize]);
+    ASSERT_TRUE(ac.check());
+    const int bound = LZ4_compressBound(static_cast<int>(ChunkSize));
+    fbl::unique_ptr<char[]> compressed(new (&ac) char[bound]);
+    ASSERT_TRUE(ac.check());
+    fbl::unique_ptr<char[]> out(new (&ac) char[ChunkSize]);
+    ASSERT_TRUE(ac.check());
+
+    FillData(data.get(), ChunkSize, true);
+    int compressed_size = LZ4_compress_default(data.get(), compressed.get(),
+                                               static_cast<int>(ChunkSize), bound);
+    ASSERT_GT(compressed_size, 0, "Failed to compress");
+
+    zx_time_t start = zx_ticks_get();
+    for (size_t i = 0; i < Iterations; i++) {
+        ASSERT_EQ(LZ4_decompress_safe(compressed.get(), out.get(), compressed_size,
+                                      static_cast<int>(ChunkSize)),
+                  static_cast<int>(ChunkSize), "Failed to decompress");
+    }
+    zx_time_t ticks = zx_ticks_get() - start;
+    ASSERT_EQ(memcmp(data.get(), out.get(), ChunkSize), 0, "Decompressed data is bad");
+
+    double secs = static_cast<double>(ticks) / static_cast<double>(zx_ticks_per_second());
+    double mb_per_sec = static_cast<double>(ChunkSize * Iterations) / MB / secs;
+    printf("\nBenchmark decompress: [%8.2f] MB/s for %zu KB chunks (ratio %.2f)",
+           mb_per_sec, ChunkSize / KB,
+           static_cast<double>(ChunkSize) / static_cast<double>(compressed_size));
+    FILE* results = fopen(RESULT_FILE, "a");
+    ASSERT_NONNULL(results, "Failed to open results file");
+    fprintf(results, "%lu,%lu,%s,decompress,lz4,%f,%d\n", ChunkSize, Iterations, start_time,
+            mb_per_sec, compressed_size);
+    fclose(results);
+    END_TEST;
+}
 
 BEGIN_TEST_CASE(blobstore_benchmarks)
 
@@ -505,6 +727,15 @@ RUN_FOR_ALL_ORDER(benchmark_blob_basic, 512 * KB, 10000);
 RUN_FOR_ALL_ORDER(benchmark_blob_basic, MB, 500);
 RUN_FOR_ALL_ORDER(benchmark_blob_basic, MB, 1000);
 
+RUN_TEST_PERFORMANCE((benchmark_blob_parallel_write<128 * KB, 500, 1>))
+RUN_TEST_PERFORMANCE((benchmark_blob_parallel_write<128 * KB, 500, 4>))
+RUN_TEST_PERFORMANCE((benchmark_blob_parallel_write<MB, 100, 1>))
+RUN_TEST_PERFORMANCE((benchmark_blob_parallel_write<MB, 100, 4>))
+
+RUN_TEST_PERFORMANCE((benchmark_blob_cold_read<MB, 64, false>))
+RUN_TEST_PERFORMANCE((benchmark_blob_cold_read<MB, 64, true>))
+RUN_TEST_PERFORMANCE((benchmark_decompression<128 * KB, 1000>))
+
 END_TEST_CASE(blobstore_benchmarks)
 
 int main(int argc, char** argv) {
@@ -21,7 +21,9 @@ typedef enum {
     CREATE, // create blob
     TRUNCATE, // truncate blob
     WRITE, // write data to blob
-    OPEN, // open fd to blob
+    OPEN, // open fd to blob which is not open elsewhere
+    OPEN_WARM, // open another fd to a blob which is already open
+    OPEN_MISS, // open a blob which does not exist
     READ, // read data from blob
     CLOSE, // close blob fd
     UNLINK, // unlink blob
@@ -153,7 +153,8 @@ static int EndBlobstoreTest(test_info_t* test_info) {
     return 0;
 }
 
-static int MountBlobstore(const char* ramdisk_path) {
+static int MountBlobstore(const char* ramdisk_path,
+                          const mount_options_t* options = &default_mount_options) {
     int fd = open(ramdisk_path, O_RDWR);
     if (fd < 0) {
         fprintf(stderr, "Could not open ramdisk\n");
@@ -163,7 +164,7 @@ static int MountBlobstore(const char* ramdisk_path) {
     // fd consumed by mount. By default, mount waits until the filesystem is
     // ready to accept commands.
     zx_status_t status;
-    if ((status = mount(fd, MOUNT_PATH, DISK_FORMAT_BLOBFS, &default_mount_options,
+    if ((status = mount(fd, MOUNT_PATH, DISK_FORMAT_BLOBFS, options,
                         launch_stdio_async)) != ZX_OK) {
         fprintf(stderr, "Could not mount blobstore: %d\n", status);
         destroy_ramdisk(ramdisk_path);
@@ -349,7 +350,9 @@ typedef struct blob_info {
 
 // Creates, writes, reads (to verify) and operates on a blob.
 // Returns the result of the post-processing 'func' (true == success).
-static bool GenerateBlob(size_t size_data, fbl::unique_ptr<blob_info_t>* out) {
+// Compressible blobs are made of runs of repeated random bytes.
+static bool GenerateBlob(size_t size_data, fbl::unique_ptr<blob_info_t>* out,
+                         bool compressible = false) {
     // Generate a Blob of random data
     fbl::AllocChecker ac;
     fbl::unique_ptr<blob_info_t> info(new (&ac) blob_info_t);
@@ -358,8 +361,12 @@ static bool GenerateBlob(size_t size_data, fbl::unique_ptr<blob_info_t>* out) {
     EXPECT_EQ(ac.check(), true);
     static unsigned int seed = static_cast<unsigned int>(zx_ticks_get());
 
-    for (size_t i = 0; i < size_data; i++) {
-        info->data[i] = (char)rand_r(&seed);
+    for (size_t i = 0; i < size_data;) {
+        size_t run = compressible ? 1 + rand_r(&seed) % 32 : 1;
+        char c = (char)rand_r(&seed);
+        for (; run > 0 && i < size_data; run--) {
+            info->data[i++] = c;
+        }
     }
     info->size_data = size_data;
 
@@ -844,6 +851,119 @@ static bool CreateUmountRemountSmall(void) {
     END_TEST;
 }
 
+// Reads a large blob back from disk out of order, so that it is verified in
+// pieces rather than all at once.
+template <fs_test_type_t TestType>
+static bool PartialReadAfterRemount(void) {
+    BEGIN_TEST;
+    test_info_t test_info;
+    ASSERT_EQ(StartBlobstoreTest<TestType>(&test_info), 0, "Mounting Blobstore");
+
+    fbl::unique_ptr<blob_info_t> info;
+    ASSERT_TRUE(GenerateBlob(1 << 22, &info));
+    int fd;
+    ASSERT_TRUE(MakeBlob(info->path, info->merkle.get(), info->size_merkle,
+                         info->data.get(), info->size_data, &fd));
+    ASSERT_EQ(close(fd), 0);
+    ASSERT_EQ(umount(MOUNT_PATH), ZX_OK, "Could not unmount blobstore");
+    ASSERT_EQ(MountBlobstore(test_info.ramdisk_path), 0, "Could not re-mount blobstore");
+
+    fd = open(info->path, O_RDONLY);
+    ASSERT_GT(fd, 0, "Failed to open blob");
+    char buf[3 * blobstore::kBlobstoreBlockSize];
+    const size_t kOffsets[] = {
+        info->size_data - sizeof(buf), info->size_data / 2 + 17, 0,
+        info->size_data / 2 - blobstore::kBlobstoreBlockSize,
+    };
+    for (size_t off : kOffsets) {
+        ASSERT_EQ(pread(fd, buf, sizeof(buf), off), static_cast<ssize_t>(sizeof(buf)));
+        ASSERT_EQ(memcmp(buf, &info->data[off], sizeof(buf)), 0, "Read data, but it was bad");
+    }
+    ASSERT_TRUE(VerifyContents(fd, info->data.get(), info->size_data));
+    ASSERT_EQ(close(fd), 0);
+    ASSERT_EQ(unlink(info->path), 0);
+
+    ASSERT_EQ(EndBlobstoreTest<TestType>(&test_info), 0, "unmounting blobstore");
+    END_TEST;
+}
+
+static bool UsedBytes(size_t* out) {
+    int fd = open(MOUNT_PATH, O_RDONLY | O_DIRECTORY);
+    ASSERT_GT(fd, 0);
+    char buf[sizeof(vfs_query_info_t) + MAX_FS_NAME_LEN + 1];
+    vfs_query_info_t* info = reinterpret_cast<vfs_query_info_t*>(buf);
+    ssize_t rv = ioctl_vfs_query_fs(fd, info, sizeof(buf) - 1);
+    ASSERT_EQ(close(fd), 0);
+    ASSERT_GT(rv, (ssize_t)sizeof(vfs_query_info_t), "Failed to query filesystem");
+    *out = info->used_bytes;
+    return true;
+}
+
+// Writes blobs with compression enabled, and reads them back from disk both
+// in pieces and whole. Blobs which don't compress are stored as they are.
+template <fs_test_type_t TestType>
+static bool CompressedBlobs(void) {
+    BEGIN_TEST;
+    test_info_t test_info;
+    ASSERT_EQ(StartBlobstoreTest<TestType>(&test_info), 0, "Mounting Blobstore");
+    ASSERT_EQ(umount(MOUNT_PATH), ZX_OK, "Could not unmount blobstore");
+    mount_options_t options;
+    memcpy(&options, &default_mount_options, sizeof(options));
+    options.compress = true;
+    ASSERT_EQ(MountBlobstore(test_info.ramdisk_path, &options), 0,
+              "Could not re-mount blobstore");
+
+    size_t used_before;
+    ASSERT_TRUE(UsedBytes(&used_before));
+    fbl::unique_ptr<blob_info_t> compressible;
+    ASSERT_TRUE(GenerateBlob((1 << 21) + 1234, &compressible, true));
+    int fd;
+    ASSERT_TRUE(MakeBlob(compressible->path, compressible->merkle.get(),
+                         compressible->size_merkle, compressible->data.get(),
+                         compressible->size_data, &fd));
+    ASSERT_EQ(close(fd), 0);
+    size_t used_after;
+    ASSERT_TRUE(UsedBytes(&used_after));
+    ASSERT_LT(used_after - used_before, compressible->size_data / 2,
+              "Blob was not compressed");
+
+    fbl::unique_ptr<blob_info_t> random;
+    ASSERT_TRUE(GenerateBlob(1 << 20, &random));
+    ASSERT_TRUE(MakeBlob(random->path, random->merkle.get(), random->size_merkle,
+                         random->data.get(), random->size_data, &fd));
+    ASSERT_EQ(close(fd), 0);
+
+    ASSERT_EQ(umount(MOUNT_PATH), ZX_OK, "Could not unmount blobstore");
+    ASSERT_EQ(MountBlobstore(test_info.ramdisk_path), 0, "Could not re-mount blobstore");
+
+    fd = open(compressible->path, O_RDONLY);
+    ASSERT_GT(fd, 0, "Failed to open blob");
+    char buf[3 * blobstore::kBlobstoreBlockSize];
+    const size_t kOffsets[] = {
+        compressible->size_data - sizeof(buf), compressible->size_data / 2 + 17, 0,
+        blobstore::kBlobstoreChunkSize - blobstore::kBlobstoreBlockSize,
+    };
+    for (size_t off : kOffsets) {
+        ASSERT_EQ(pread(fd, buf, sizeof(buf), off), static_cast<ssize_t>(sizeof(buf)));
+        ASSERT_EQ(memcmp(buf, &compressible->data[off], sizeof(buf)), 0,
+                  "Read data, but it was bad");
+    }
+    ASSERT_TRUE(VerifyContents(fd, compressible->data.get(), compressible->size_data));
+    ASSERT_EQ(close(fd), 0);
+
+    fd = open(random->path, O_RDONLY);
+    ASSERT_GT(fd, 0, "Failed to open blob");
+    ASSERT_TRUE(VerifyContents(fd, random->data.get(), random->size_data));
+    ASSERT_EQ(close(fd), 0);
+
+    ASSERT_EQ(unlink(compressible->path), 0);
+    ASSERT_EQ(unlink(random->path), 0);
+    ASSERT_TRUE(UsedBytes(&used_after));
+    ASSERT_EQ(used_after, used_before);
+    ASSERT_EQ(EndBlobstoreTest<TestType>(&test_info), 0, "unmounting blobstore");
+    END_TEST;
+}
+
 enum TestState {
     empty,
     configured,
@@ -1608,6 +1728,8 @@ RUN_TEST_FOR_ALL_TYPES(MEDIUM, CorruptedBlob)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, CorruptedDigest)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, EdgeAllocation)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, CreateUmountRemountSmall)
+RUN_TEST_FOR_ALL_TYPES(MEDIUM, PartialReadAfterRemount)
+RUN_TEST_FOR_ALL_TYPES(MEDIUM, CompressedBlobs)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, EarlyRead)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, WaitForRead)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, WriteSeekIgnored)
@@ -3,13 +3,16 @@
 // found in the LICENSE file.
 
 #include <assert.h>
+#include <limits.h>
 #include <zircon/compiler.h>
+#include <zircon/process.h>
 #include <zircon/syscalls.h>
 #include <zircon/syscalls/object.h>
 #include <unittest/unittest.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <threads.h>
 #include <unistd.h>
 
@@ -858,6 +861,131 @@ static bool channel_disallow_write_to_self(void) {
     END_TEST;
 }
 
+static bool channel_write_read_many(void) {
+    BEGIN_TEST;
+
+    zx_handle_t channel[2];
+    ASSERT_EQ(zx_channel_create(0, &channel[0], &channel[1]), ZX_OK, "");
+
+    zx_handle_t event;
+    ASSERT_EQ(zx_event_create(0u, &event), ZX_OK, "");
+
+    // The third message carries a handle that is not valid, so only the
+    // first two are written.
+    uint32_t data[4] = {1u, 2u, 3u, 4u};
+    zx_handle_t bad_handle = ZX_HANDLE_INVALID;
+    zx_channel_write_msg_t wmsgs[4] = {
+        {&data[0], &event, sizeof(uint32_t), 1u},
+        {&data[1], NULL, sizeof(uint32_t), 0u},
+        {&data[2], &bad_handle, sizeof(uint32_t), 1u},
+        {&data[3], NULL, sizeof(uint32_t), 0u},
+    };
+    uint32_t actual = 0u;
+    EXPECT_EQ(zx_channel_write_many(channel[0], 0u, wmsgs, 4u, &actual), ZX_OK, "");
+    EXPECT_EQ(actual, 2u, "stops at the bad message");
+    EXPECT_EQ(zx_channel_write_many(channel[0], 0u, &wmsgs[2], 2u, &actual),
+              ZX_ERR_BAD_HANDLE, "");
+    EXPECT_EQ(zx_channel_write_many(channel[0], 0u, &wmsgs[3], 1u, &actual), ZX_OK, "");
+    EXPECT_EQ(actual, 1u, "");
+    EXPECT_EQ(zx_channel_write_many(channel[0], 0u, wmsgs, 0u, &actual),
+              ZX_ERR_OUT_OF_RANGE, "");
+
+    // The first buffer is too small: nothing is read.
+    uint32_t rdata[4] = {};
+    zx_handle_t rhandles[4] = {};
+    zx_channel_read_msg_t rmsgs[4] = {
+        {&rdata[0], &rhandles[0], 0u, 1u, 0u, 0u},
+    };
+    EXPECT_EQ(zx_channel_read_many(channel[1], 0u, rmsgs, 1u, &actual),
+              ZX_ERR_BUFFER_TOO_SMALL, "");
+    EXPECT_EQ(rmsgs[0].actual_bytes, sizeof(uint32_t), "");
+    EXPECT_EQ(rmsgs[0].actual_handles, 1u, "");
+
+    for (uint32_t i = 0; i < 4u; ++i) {
+        rmsgs[i] = (zx_channel_read_msg_t){&rdata[i], &rhandles[i], sizeof(uint32_t), 1u, 0u, 0u};
+    }
+    EXPECT_EQ(zx_channel_read_many(channel[1], 0u, rmsgs, 4u, &actual), ZX_OK, "");
+    EXPECT_EQ(actual, 3u, "");
+    EXPECT_EQ(rdata[0], 1u, "");
+    EXPECT_EQ(rdata[1], 2u, "");
+    EXPECT_EQ(rdata[2], 4u, "");
+    EXPECT_EQ(rmsgs[0].actual_handles, 1u, "");
+    EXPECT_EQ(rmsgs[1].actual_handles, 0u, "");
+    EXPECT_EQ(zx_object_signal(rhandles[0], 0u, ZX_USER_SIGNAL_0), ZX_OK,
+              "transferred handle is usable");
+
+    EXPECT_EQ(zx_channel_read_many(channel[1], 0u, rmsgs, 4u, &actual),
+              ZX_ERR_SHOULD_WAIT, "");
+
+    // Nothing is written once the peer is gone, and the handles stay with us.
+    EXPECT_EQ(zx_handle_close(channel[1]), ZX_OK, "");
+    zx_channel_write_msg_t wmsg = {&data[0], &rhandles[0], sizeof(uint32_t), 1u};
+    EXPECT_EQ(zx_channel_write_many(channel[0], 0u, &wmsg, 1u, &actual),
+              ZX_ERR_PEER_CLOSED, "");
+    EXPECT_EQ(zx_handle_close(rhandles[0]), ZX_OK, "");
+
+    EXPECT_EQ(zx_handle_close(channel[0]), ZX_OK, "");
+
+    END_TEST;
+}
+
+static bool channel_page_sized_messages(void) {
+    BEGIN_TEST;
+
+    const size_t size = 4 * PAGE_SIZE;
+    zx_handle_t channel[2];
+    ASSERT_EQ(zx_channel_create(0, &channel[0], &channel[1]), ZX_OK, "");
+
+    // Whole page payloads can be moved into a page aligned receive buffer
+    // rather than copied, that must look the same as a copy to both sides.
+    uint8_t* wbuf = malloc(size);
+    ASSERT_NONNULL(wbuf, "");
+    for (size_t i = 0; i < size; ++i)
+        wbuf[i] = (uint8_t)i;
+    ASSERT_EQ(zx_channel_write(channel[0], 0u, wbuf, size, NULL, 0u), ZX_OK, "");
+    ASSERT_EQ(zx_channel_write(channel[0], 0u, wbuf, size, NULL, 0u), ZX_OK, "");
+    memset(wbuf, 0xff, size);
+
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(size, 0u, &vmo), ZX_OK, "");
+    uintptr_t addr;
+    ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, size,
+                          ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE, &addr),
+              ZX_OK, "");
+    uint8_t* rbuf = (uint8_t*)addr;
+    memset(rbuf, 0xaa, size);
+
+    uint32_t actual_bytes = 0u;
+    ASSERT_EQ(zx_channel_read(channel[1], 0u, rbuf, NULL, size, 0u, &actual_bytes, NULL),
+              ZX_OK, "");
+    EXPECT_EQ(actual_bytes, size, "");
+    bool match = true;
+    for (size_t i = 0; i < size; ++i)
+        match &= rbuf[i] == (uint8_t)i;
+    EXPECT_TRUE(match, "mapped receive buffer has the payload");
+
+    uint8_t check[16];
+    size_t actual = 0u;
+    EXPECT_EQ(zx_vmo_read(vmo, check, PAGE_SIZE, sizeof(check), &actual), ZX_OK, "");
+    EXPECT_EQ(check[1], (uint8_t)(PAGE_SIZE + 1), "vmo has the payload");
+
+    // An unaligned buffer gets a copy.
+    uint8_t* ubuf = malloc(size + 1);
+    ASSERT_NONNULL(ubuf, "");
+    ASSERT_EQ(zx_channel_read(channel[1], 0u, ubuf + 1, NULL, size, 0u, &actual_bytes, NULL),
+              ZX_OK, "");
+    EXPECT_EQ(memcmp(ubuf + 1, rbuf, size), 0, "");
+
+    free(ubuf);
+    free(wbuf);
+    EXPECT_EQ(zx_vmar_unmap(zx_vmar_root_self(), addr, size), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(channel[0]), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(channel[1]), ZX_OK, "");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(channel_tests)
 RUN_TEST(channel_test)
 RUN_TEST(channel_read_error_test)
@@ -871,6 +999,8 @@ RUN_TEST(channel_call2)
 RUN_TEST(bad_channel_call_finish)
 RUN_TEST(channel_nest)
 RUN_TEST(channel_disallow_write_to_self)
+RUN_TEST(channel_write_read_many)
+RUN_TEST(channel_page_sized_messages)
 END_TEST_CASE(channel_tests)
 
 #ifndef BUILD_COMBINED_TESTS
@@ -9,7 +9,9 @@
 #include <threads.h>
 #include <unistd.h>
 
+#include <zircon/process.h>
 #include <zircon/syscalls.h>
+#include <zircon/syscalls/fifo.h>
 #include <unittest/unittest.h>
 
 static zx_signals_t get_signals(zx_handle_t h) {
@@ -118,8 +120,86 @@ static bool options_test(void) {
     END_TEST;
 }
 
+static bool mapped_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t a, b;
+    ASSERT_EQ(zx_fifo_create(8, 8, 0, &a, &b), ZX_OK, "");
+    zx_handle_t vmo;
+    uint32_t index;
+    EXPECT_EQ(zx_fifo_get_ring(a, &vmo, &index), ZX_ERR_NOT_SUPPORTED, "");
+    EXPECT_EQ(zx_fifo_ring_update(a), ZX_ERR_NOT_SUPPORTED, "");
+    zx_handle_close(a);
+    zx_handle_close(b);
+
+    ASSERT_EQ(zx_fifo_create(8, 8, ZX_FIFO_MAPPABLE, &a, &b), ZX_OK, "");
+    ASSERT_EQ(zx_fifo_get_ring(a, &vmo, &index), ZX_OK, "");
+
+    uintptr_t addr;
+    ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, ZX_FIFO_RING_VMO_SIZE,
+                          ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE, &addr), ZX_OK, "");
+    zx_handle_close(vmo);
+    zx_fifo_ring_t* tx = (zx_fifo_ring_t*)(addr + ZX_FIFO_RING_HEADER_OFFSET(index));
+    zx_fifo_ring_t* rx = (zx_fifo_ring_t*)(addr + ZX_FIFO_RING_HEADER_OFFSET(index ^ 1));
+    uint64_t* tx_slots = (uint64_t*)(addr + ZX_FIFO_RING_DATA_OFFSET(index));
+    uint64_t* rx_slots = (uint64_t*)(addr + ZX_FIFO_RING_DATA_OFFSET(index ^ 1));
+
+    // a reader that finds nothing asks to be woken
+    uint64_t n[8];
+    uint32_t actual;
+    EXPECT_EQ(zx_fifo_read(b, n, sizeof(n), &actual), ZX_ERR_SHOULD_WAIT, "");
+    EXPECT_EQ(tx->waiters & ZX_FIFO_RING_READER_WAITING, ZX_FIFO_RING_READER_WAITING, "");
+
+    // queue through the mapping and ring the doorbell
+    for (uint32_t i = 0; i < 3; i++)
+        tx_slots[(tx->head + i) & 7] = 100 + i;
+    __atomic_store_n(&tx->head, tx->head + 3, __ATOMIC_SEQ_CST);
+    EXPECT_SIGNALS(b, ZX_FIFO_WRITABLE);
+    __atomic_fetch_and(&tx->waiters, ~ZX_FIFO_RING_READER_WAITING, __ATOMIC_SEQ_CST);
+    EXPECT_EQ(zx_fifo_ring_update(a), ZX_OK, "");
+    EXPECT_SIGNALS(b, ZX_FIFO_WRITABLE | ZX_FIFO_READABLE);
+
+    EXPECT_EQ(zx_fifo_read(b, n, sizeof(n), &actual), ZX_OK, "");
+    ASSERT_EQ(actual, 3u, "");
+    EXPECT_EQ(n[0], 100u, "");
+    EXPECT_EQ(n[2], 102u, "");
+    EXPECT_SIGNALS(b, ZX_FIFO_WRITABLE);
+
+    // elements written with a syscall show up in the mapping
+    n[0] = 200;
+    n[1] = 201;
+    EXPECT_EQ(zx_fifo_write(b, n, 2 * sizeof(n[0]), &actual), ZX_OK, "");
+    EXPECT_EQ(actual, 2u, "");
+    EXPECT_EQ(rx->head - rx->tail, 2u, "");
+    EXPECT_EQ(rx_slots[rx->tail & 7], 200u, "");
+    EXPECT_EQ(rx_slots[(rx->tail + 1) & 7], 201u, "");
+    __atomic_store_n(&rx->tail, rx->head, __ATOMIC_SEQ_CST);
+    EXPECT_EQ(zx_fifo_ring_update(a), ZX_OK, "");
+    EXPECT_SIGNALS(a, ZX_FIFO_WRITABLE);
+
+    // a ring filled through the mapping stops the syscall writer, as does
+    // one whose indices have been corrupted
+    tx->head = tx->tail + 8;
+    EXPECT_EQ(zx_fifo_write(a, n, sizeof(n[0]), &actual), ZX_ERR_SHOULD_WAIT, "");
+    EXPECT_EQ(tx->waiters & ZX_FIFO_RING_WRITER_WAITING, ZX_FIFO_RING_WRITER_WAITING, "");
+    EXPECT_SIGNALS(a, 0u);
+    tx->head = tx->tail + 1000;
+    EXPECT_EQ(zx_fifo_write(a, n, sizeof(n[0]), &actual), ZX_ERR_SHOULD_WAIT, "");
+    tx->head = tx->tail + 8;
+    EXPECT_EQ(zx_fifo_read(b, n, sizeof(n), &actual), ZX_OK, "");
+    EXPECT_EQ(actual, 8u, "");
+    EXPECT_SIGNALS(a, ZX_FIFO_WRITABLE);
+
+    EXPECT_EQ(zx_vmar_unmap(zx_vmar_root_self(), addr, ZX_FIFO_RING_VMO_SIZE), ZX_OK, "");
+    zx_handle_close(a);
+    zx_handle_close(b);
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(fifo_tests)
 RUN_TEST(basic_test)
+RUN_TEST(mapped_test)
 END_TEST_CASE(fifo_tests)
 
 #ifndef BUILD_COMBINED_TESTS
@@ -378,6 +378,30 @@ bool test_futex_requeue_unqueued_on_timeout() {
     END_TEST;
 }
 
+// Futexes are spread over several independently locked tables in the
+// kernel.  Requeue between a spread of addresses so that at least some of
+// the source and destination futexes end up in different tables.
+bool test_futex_requeue_across_tables() {
+    BEGIN_TEST;
+    volatile int futex_values[64] = {};
+    for (size_t i = 1; i < countof(futex_values); i += 13) {
+        TestThread thread(&futex_values[0]);
+        zx_status_t rc = zx_futex_requeue(
+            const_cast<int*>(&futex_values[0]), 0, futex_values[0],
+            const_cast<int*>(&futex_values[i]), 1);
+        ASSERT_EQ(rc, ZX_OK, "Error in requeue");
+
+        // Nothing should be left waiting on the source futex.
+        rc = zx_futex_wake(const_cast<int*>(&futex_values[0]), INT_MAX);
+        ASSERT_EQ(rc, ZX_OK, "Error in wake");
+        thread.assert_thread_not_woken();
+
+        check_futex_wake(&futex_values[i], 1);
+        thread.assert_thread_woken();
+    }
+    END_TEST;
+}
+
 // Test that we can successfully kill a thread that is waiting on a futex,
 // and that we can join the thread afterwards.  This checks that waiting on
 // a futex does not leave the thread in an unkillable state.
@@ -541,6 +565,7 @@ RUN_TEST(test_futex_requeue_value_mismatch);
 RUN_TEST(test_futex_requeue_same_addr);
 RUN_TEST(test_futex_requeue);
 RUN_TEST(test_futex_requeue_unqueued_on_timeout);
+RUN_TEST(test_futex_requeue_across_tables);
 RUN_TEST(test_futex_thread_killed);
 RUN_TEST(test_futex_thread_suspended);
 RUN_TEST(test_futex_misaligned);
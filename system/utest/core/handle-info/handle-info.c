@@ -4,6 +4,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <threads.h>
 
 #include <zircon/process.h>
 #include <zircon/syscalls.h>
@@ -144,10 +145,69 @@ static bool handle_rights_test(void) {
     END_TEST;
 }
 
+#define RACE_HANDLES 16
+#define RACE_ROUNDS 1000
+
+typedef struct {
+    zx_handle_t handles[RACE_HANDLES];
+    volatile int done;
+    int bad_results;
+} race_args_t;
+
+// Looks up handles that the main thread is concurrently closing and
+// recreating. Each lookup must either find a live event or fail cleanly.
+static int race_lookup_thread(void* arg) {
+    race_args_t* args = arg;
+    while (!args->done) {
+        for (int i = 0; i < RACE_HANDLES; ++i) {
+            zx_handle_t h = __atomic_load_n(&args->handles[i], __ATOMIC_RELAXED);
+            zx_info_handle_basic_t info = {};
+            zx_status_t status = zx_object_get_info(h, ZX_INFO_HANDLE_BASIC,
+                                                    &info, sizeof(info), NULL, NULL);
+            if (status == ZX_OK) {
+                if (info.type != ZX_OBJ_TYPE_EVENT)
+                    args->bad_results++;
+            } else if (status != ZX_ERR_BAD_HANDLE) {
+                args->bad_results++;
+            }
+        }
+    }
+    return 0;
+}
+
+static bool handle_close_lookup_race_test(void) {
+    BEGIN_TEST;
+
+    race_args_t args = {};
+    for (int i = 0; i < RACE_HANDLES; ++i)
+        ASSERT_EQ(zx_event_create(0u, &args.handles[i]), ZX_OK, "");
+
+    thrd_t thread;
+    ASSERT_EQ(thrd_create(&thread, race_lookup_thread, &args), thrd_success, "");
+
+    for (int round = 0; round < RACE_ROUNDS; ++round) {
+        int i = round % RACE_HANDLES;
+        ASSERT_EQ(zx_handle_close(args.handles[i]), ZX_OK, "");
+        zx_handle_t event;
+        ASSERT_EQ(zx_event_create(0u, &event), ZX_OK, "");
+        __atomic_store_n(&args.handles[i], event, __ATOMIC_RELAXED);
+    }
+
+    args.done = 1;
+    ASSERT_EQ(thrd_join(thread, NULL), thrd_success, "");
+    EXPECT_EQ(args.bad_results, 0, "lookups racing with close returned bad results");
+
+    for (int i = 0; i < RACE_HANDLES; ++i)
+        EXPECT_EQ(zx_handle_close(args.handles[i]), ZX_OK, "");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(handle_info_tests)
 RUN_TEST(handle_info_test)
 RUN_TEST(handle_related_koid_test)
 RUN_TEST(handle_rights_test)
+RUN_TEST(handle_close_lookup_race_test)
 END_TEST_CASE(handle_info_tests)
 
 #ifndef BUILD_COMBINED_TESTS
@@ -4,6 +4,7 @@
 
 #include <unittest/unittest.h>
 #include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
 
 #include <errno.h>
 #include <fcntl.h>
@@ -82,7 +83,88 @@ static bool interrupt_test_multiple(void) {
     END_TEST;
 }
 
+// Tests that affinity can't be set on virtual or unbound slots
+static bool interrupt_test_affinity(void) {
+    const uint32_t BOUND_SLOT = 0;
+    const uint32_t UNBOUND_SLOT = 1;
+
+    BEGIN_TEST;
+
+    zx_handle_t handle;
+    zx_handle_t rsrc = get_root_resource();
+
+    ASSERT_EQ(zx_interrupt_create(rsrc, 0, &handle), ZX_OK, "");
+    ASSERT_EQ(zx_interrupt_bind(handle, BOUND_SLOT, rsrc, 0, ZX_INTERRUPT_VIRTUAL), ZX_OK, "");
+
+    ASSERT_EQ(zx_interrupt_set_affinity(handle, ZX_INTERRUPT_MAX_SLOTS + 1, 1),
+              ZX_ERR_INVALID_ARGS, "");
+    ASSERT_EQ(zx_interrupt_set_affinity(handle, UNBOUND_SLOT, 1), ZX_ERR_NOT_FOUND, "");
+    ASSERT_EQ(zx_interrupt_set_affinity(handle, BOUND_SLOT, 1), ZX_ERR_BAD_STATE, "");
+    ASSERT_EQ(zx_interrupt_set_affinity(handle, ZX_INTERRUPT_SLOT_USER, 1), ZX_ERR_BAD_STATE, "");
+
+    ASSERT_EQ(zx_handle_close(handle), ZX_OK, "");
+
+    END_TEST;
+}
+
+// Tests delivery of interrupts as port packets
+static bool interrupt_test_port(void) {
+    const uint32_t SLOT_A = 0;
+    const uint32_t SLOT_B = 1;
+    const uint64_t KEY = 0x1234;
+
+    BEGIN_TEST;
+
+    zx_handle_t handle;
+    zx_handle_t port;
+    zx_handle_t rsrc = get_root_resource();
+    uint64_t slots;
+    zx_time_t timestamp;
+    zx_port_packet_t packet;
+
+    ASSERT_EQ(zx_interrupt_create(rsrc, 0, &handle), ZX_OK, "");
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK, "");
+    ASSERT_EQ(zx_interrupt_bind(handle, SLOT_A, rsrc, 0, ZX_INTERRUPT_VIRTUAL), ZX_OK, "");
+    ASSERT_EQ(zx_interrupt_bind(handle, SLOT_B, rsrc, 0, ZX_INTERRUPT_VIRTUAL), ZX_OK, "");
+
+    ASSERT_EQ(zx_interrupt_ack(handle), ZX_ERR_BAD_STATE, "");
+    ASSERT_EQ(zx_interrupt_bind_port(handle, port, KEY, 1), ZX_ERR_INVALID_ARGS, "");
+
+    // Signaled before binding, reported on binding.
+    ASSERT_EQ(zx_interrupt_signal(handle, SLOT_A, 1), ZX_OK, "");
+    ASSERT_EQ(zx_interrupt_bind_port(handle, port, KEY, 0), ZX_OK, "");
+    ASSERT_EQ(zx_interrupt_bind_port(handle, port, KEY, 0), ZX_ERR_ALREADY_BOUND, "");
+    ASSERT_EQ(zx_interrupt_wait(handle, &slots), ZX_ERR_BAD_STATE, "");
+
+    ASSERT_EQ(zx_port_wait(port, 0, &packet, 1), ZX_OK, "");
+    ASSERT_EQ(packet.key, KEY, "");
+    ASSERT_EQ(packet.type, ZX_PKT_TYPE_INTERRUPT, "");
+    ASSERT_EQ(packet.interrupt.slots, (1ul << SLOT_A), "");
+    ASSERT_EQ(zx_interrupt_ack(handle), ZX_OK, "");
+
+    // Slots signaled while the packet is queued are merged into it.
+    ASSERT_EQ(zx_interrupt_signal(handle, SLOT_A, 2), ZX_OK, "");
+    ASSERT_EQ(zx_interrupt_signal(handle, SLOT_B, 3), ZX_OK, "");
+    ASSERT_EQ(zx_port_wait(port, 0, &packet, 1), ZX_OK, "");
+    ASSERT_EQ(packet.interrupt.slots, (1ul << SLOT_A) | (1ul << SLOT_B), "");
+    ASSERT_NE(packet.interrupt.timestamp, 0, "");
+    ASSERT_EQ(zx_port_wait(port, 0, &packet, 1), ZX_ERR_TIMED_OUT, "");
+    ASSERT_EQ(zx_interrupt_get_timestamp(handle, SLOT_B, &timestamp), ZX_OK, "");
+    ASSERT_EQ(timestamp, 3, "");
+
+    // Closing the interrupt takes its pending packet off the port.
+    ASSERT_EQ(zx_interrupt_signal(handle, SLOT_A, 4), ZX_OK, "");
+    ASSERT_EQ(zx_handle_close(handle), ZX_OK, "");
+    ASSERT_EQ(zx_port_wait(port, 0, &packet, 1), ZX_ERR_TIMED_OUT, "");
+
+    ASSERT_EQ(zx_handle_close(port), ZX_OK, "");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(interrupt_tests)
 RUN_TEST(interrupt_test)
 RUN_TEST(interrupt_test_multiple)
+RUN_TEST(interrupt_test_affinity)
+RUN_TEST(interrupt_test_port)
 END_TEST_CASE(interrupt_tests)
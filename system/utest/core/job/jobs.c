@@ -10,6 +10,7 @@
 #include <zircon/process.h>
 #include <zircon/syscalls.h>
 #include <zircon/syscalls/policy.h>
+#include <zircon/syscalls/system.h>
 
 #include <mini-process/mini-process.h>
 #include <unittest/unittest.h>
@@ -214,6 +215,28 @@ static bool max_height_smoke(void) {
     END_TEST;
 }
 
+static bool system_event_fails(void) {
+    BEGIN_TEST;
+
+    zx_handle_t job;
+    ASSERT_EQ(zx_job_create(zx_job_default(), 0u, &job), ZX_OK, "");
+
+    // Only the root job hands out system events.
+    zx_handle_t event;
+    EXPECT_EQ(zx_system_get_event(job, ZX_SYSTEM_EVENT_MEMORY_PRESSURE_NORMAL, &event),
+              ZX_ERR_ACCESS_DENIED, "");
+    EXPECT_EQ(zx_system_get_event(zx_process_self(), ZX_SYSTEM_EVENT_MEMORY_PRESSURE_NORMAL,
+                                  &event),
+              ZX_ERR_WRONG_TYPE, "");
+    EXPECT_EQ(zx_system_get_event(ZX_HANDLE_INVALID, ZX_SYSTEM_EVENT_MEMORY_PRESSURE_NORMAL,
+                                  &event),
+              ZX_ERR_BAD_HANDLE, "");
+
+    ASSERT_EQ(zx_handle_close(job), ZX_OK, "");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(job_tests)
 RUN_TEST(basic_test)
 RUN_TEST(policy_basic_test)
@@ -222,4 +245,5 @@ RUN_TEST(kill_test)
 RUN_TEST(wait_test)
 RUN_TEST(info_task_stats_fails)
 RUN_TEST(max_height_smoke)
+RUN_TEST(system_event_fails)
 END_TEST_CASE(job_tests)
@@ -861,6 +861,90 @@ bool job_children_smoke() {
     return jobch_helper_smoke(ZX_INFO_JOB_CHILDREN, kTestJobChildJobs);
 }
 
+// Tests that ZX_INFO_JOB_PROCESS_SNAPSHOT finds all of a job's descendants.
+bool job_process_snapshot_smoke() {
+    BEGIN_TEST;
+    zx_info_process_snapshot_t procs[32];
+    size_t actual;
+    size_t avail;
+    ASSERT_EQ(zx_object_get_info(get_test_job(), ZX_INFO_JOB_PROCESS_SNAPSHOT,
+                                 procs, sizeof(procs), &actual, &avail),
+              ZX_OK);
+    // The child processes and one grandchild under each child job.
+    EXPECT_EQ(kTestJobChildProcs + kTestJobChildJobs, actual);
+    EXPECT_EQ(actual, avail);
+
+    for (size_t i = 0; i < actual; i++) {
+        EXPECT_EQ(ZX_INFO_PROCESS_STATE_INITIAL, procs[i].state);
+        EXPECT_EQ(0u, procs[i].threads);
+        EXPECT_EQ(0, procs[i].cpu_time);
+        EXPECT_EQ(0u, procs[i].mem_committed_bytes);
+        EXPECT_NE(ZX_KOID_INVALID, procs[i].job_koid);
+    }
+    END_TEST;
+}
+
+// Finds this process in a snapshot of its job.
+bool snapshot_self(zx_info_process_snapshot_t* out) {
+    BEGIN_HELPER;
+    zx_info_handle_basic_t self;
+    ASSERT_EQ(zx_object_get_info(zx_process_self(), ZX_INFO_HANDLE_BASIC,
+                                 &self, sizeof(self), nullptr, nullptr),
+              ZX_OK);
+
+    size_t actual;
+    size_t avail;
+    ASSERT_EQ(zx_object_get_info(zx_job_default(), ZX_INFO_JOB_PROCESS_SNAPSHOT,
+                                 nullptr, 0, &actual, &avail),
+              ZX_OK);
+    // Leave room for processes started since.
+    size_t bufsize = (avail + 16) * sizeof(zx_info_process_snapshot_t);
+    zx_info_process_snapshot_t* procs = (zx_info_process_snapshot_t*)malloc(bufsize);
+    zx_status_t status = zx_object_get_info(zx_job_default(), ZX_INFO_JOB_PROCESS_SNAPSHOT,
+                                            procs, bufsize, &actual, &avail);
+
+    bool found = false;
+    for (size_t i = 0; status == ZX_OK && i < actual; i++) {
+        if (procs[i].koid == self.koid) {
+            *out = procs[i];
+            found = true;
+        }
+    }
+    free(procs);
+    ASSERT_EQ(status, ZX_OK);
+    ASSERT_TRUE(found, "this process is not in the snapshot");
+    END_HELPER;
+}
+
+// Tests that a snapshot of a running process counts the memory committed to
+// the VMOs it creates, as it is committed and decommitted.
+bool job_process_snapshot_self() {
+    BEGIN_TEST;
+    zx_info_process_snapshot_t before;
+    ASSERT_TRUE(snapshot_self(&before));
+    EXPECT_EQ(ZX_INFO_PROCESS_STATE_RUNNING, before.state);
+    EXPECT_GT(before.threads, 0u);
+    EXPECT_GT(before.cpu_time, 0);
+
+    const size_t kSize = 16 * PAGE_SIZE;
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(kSize, 0, &vmo), ZX_OK);
+    ASSERT_EQ(zx_vmo_op_range(vmo, ZX_VMO_OP_COMMIT, 0, kSize, nullptr, 0), ZX_OK);
+
+    // Other threads may allocate, but nothing here frees.
+    zx_info_process_snapshot_t committed;
+    ASSERT_TRUE(snapshot_self(&committed));
+    EXPECT_GE(committed.mem_committed_bytes, before.mem_committed_bytes + kSize);
+
+    ASSERT_EQ(zx_vmo_op_range(vmo, ZX_VMO_OP_DECOMMIT, 0, kSize, nullptr, 0), ZX_OK);
+    zx_info_process_snapshot_t decommitted;
+    ASSERT_TRUE(snapshot_self(&decommitted));
+    EXPECT_LE(decommitted.mem_committed_bytes + kSize, committed.mem_committed_bytes);
+
+    zx_handle_close(vmo);
+    END_TEST;
+}
+
 uint32_t handle_count_or_zero(zx_handle_t handle) {
     zx_info_handle_count_t info;
     if (ZX_OK != zx_object_get_info(
@@ -961,6 +1045,14 @@ RUN_TEST((wrong_handle_type_fails<ZX_INFO_JOB_CHILDREN, zx_koid_t, zx_thread_sel
 RUN_TEST((missing_rights_fails<ZX_INFO_JOB_CHILDREN, zx_koid_t, get_test_job,
                                ZX_RIGHT_ENUMERATE>));
 
+RUN_TEST(job_process_snapshot_smoke);
+RUN_TEST(job_process_snapshot_self);
+RUN_MULTI_ENTRY_TESTS(ZX_INFO_JOB_PROCESS_SNAPSHOT, zx_info_process_snapshot_t, get_test_job);
+RUN_TEST((wrong_handle_type_fails<ZX_INFO_JOB_PROCESS_SNAPSHOT, zx_info_process_snapshot_t,
+                                  get_test_process>));
+RUN_TEST((missing_rights_fails<ZX_INFO_JOB_PROCESS_SNAPSHOT, zx_info_process_snapshot_t,
+                               get_test_job, ZX_RIGHT_ENUMERATE>));
+
 // Basic tests for all other topics.
 
 RUN_SINGLE_ENTRY_TESTS(ZX_INFO_HANDLE_BASIC, zx_info_handle_basic_t, get_test_job);
@@ -0,0 +1,250 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+#include <threads.h>
+
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
+
+#include <unittest/unittest.h>
+
+namespace {
+
+constexpr uint64_t kKey = 0x1234u;
+constexpr size_t kVmoPages = 32u;
+constexpr size_t kBatchPages = 16u;
+
+struct Pager {
+    zx_handle_t pager = ZX_HANDLE_INVALID;
+    zx_handle_t port = ZX_HANDLE_INVALID;
+    zx_handle_t vmo = ZX_HANDLE_INVALID;
+
+    ~Pager() {
+        zx_handle_close(vmo);
+        zx_handle_close(port);
+        zx_handle_close(pager);
+    }
+};
+
+bool create_pager(Pager* p) {
+    BEGIN_HELPER;
+    ASSERT_EQ(zx_pager_create(0, &p->pager), ZX_OK);
+    ASSERT_EQ(zx_port_create(0, &p->port), ZX_OK);
+    ASSERT_EQ(zx_pager_create_vmo(p->pager, p->port, kKey, kVmoPages * PAGE_SIZE, 0, &p->vmo),
+              ZX_OK);
+    END_HELPER;
+}
+
+// fills |count| pages at |offset| of the pager vmo with bytes derived from their offset
+bool supply(const Pager& p, uint64_t offset, uint64_t count) {
+    BEGIN_HELPER;
+    zx_handle_t aux;
+    ASSERT_EQ(zx_vmo_create(count * PAGE_SIZE, 0, &aux), ZX_OK);
+    for (uint64_t i = 0; i < count; i++) {
+        uint8_t data[PAGE_SIZE];
+        memset(data, static_cast<uint8_t>((offset / PAGE_SIZE) + i + 1), sizeof(data));
+        size_t actual;
+        ASSERT_EQ(zx_vmo_write(aux, data, i * PAGE_SIZE, sizeof(data), &actual), ZX_OK);
+    }
+    EXPECT_EQ(zx_pager_supply_pages(p.pager, p.vmo, offset, count * PAGE_SIZE, aux, 0), ZX_OK);
+    zx_handle_close(aux);
+    END_HELPER;
+}
+
+bool wait_for_request(const Pager& p, uint16_t command, uint64_t offset, uint64_t length) {
+    BEGIN_HELPER;
+    zx_port_packet_t packet;
+    ASSERT_EQ(zx_port_wait(p.port, zx_deadline_after(ZX_SEC(10)), &packet, 0), ZX_OK);
+    EXPECT_EQ(packet.key, kKey);
+    EXPECT_EQ(packet.type, ZX_PKT_TYPE_PAGE_REQUEST);
+    EXPECT_EQ(packet.page_request.command, command);
+    EXPECT_EQ(packet.page_request.offset, offset);
+    EXPECT_EQ(packet.page_request.length, length);
+    END_HELPER;
+}
+
+struct Reader {
+    zx_handle_t vmo;
+    uint64_t offset;
+    uint8_t byte;
+    zx_status_t status;
+};
+
+int read_thread(void* arg) {
+    auto r = static_cast<Reader*>(arg);
+    size_t actual;
+    r->status = zx_vmo_read(r->vmo, &r->byte, r->offset, 1, &actual);
+    return 0;
+}
+
+int touch_thread(void* arg) {
+    auto r = static_cast<Reader*>(arg);
+    r->byte = *reinterpret_cast<volatile uint8_t*>(r->offset);
+    r->status = ZX_OK;
+    return 0;
+}
+
+bool read_test() {
+    BEGIN_TEST;
+    Pager p;
+    ASSERT_TRUE(create_pager(&p));
+
+    // a read of page 20 asks for the batch it sits in
+    Reader r = {p.vmo, 20 * PAGE_SIZE, 0, ZX_ERR_INTERNAL};
+    thrd_t t;
+    ASSERT_EQ(thrd_create(&t, read_thread, &r), thrd_success);
+    ASSERT_TRUE(wait_for_request(p, ZX_PAGER_VMO_READ, kBatchPages * PAGE_SIZE,
+                                 kBatchPages * PAGE_SIZE));
+
+    ASSERT_TRUE(supply(p, kBatchPages * PAGE_SIZE, kBatchPages));
+    ASSERT_EQ(thrd_join(t, nullptr), thrd_success);
+    EXPECT_EQ(r.status, ZX_OK);
+    EXPECT_EQ(r.byte, 21u);
+
+    // the rest of the batch came in with it, and doesn't ask again
+    uint8_t byte;
+    size_t actual;
+    EXPECT_EQ(zx_vmo_read(p.vmo, &byte, (kVmoPages - 1) * PAGE_SIZE, 1, &actual), ZX_OK);
+    EXPECT_EQ(byte, kVmoPages);
+    zx_port_packet_t packet;
+    EXPECT_EQ(zx_port_wait(p.port, 0, &packet, 0), ZX_ERR_TIMED_OUT);
+
+    END_TEST;
+}
+
+bool fault_test() {
+    BEGIN_TEST;
+    Pager p;
+    ASSERT_TRUE(create_pager(&p));
+
+    uintptr_t addr;
+    ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), 0, p.vmo, 0, kVmoPages * PAGE_SIZE,
+                          ZX_VM_FLAG_PERM_READ, &addr), ZX_OK);
+
+    Reader r = {p.vmo, addr + 3 * PAGE_SIZE, 0, ZX_ERR_INTERNAL};
+    thrd_t t;
+    ASSERT_EQ(thrd_create(&t, touch_thread, &r), thrd_success);
+    ASSERT_TRUE(wait_for_request(p, ZX_PAGER_VMO_READ, 0, kBatchPages * PAGE_SIZE));
+
+    // a partial supply that doesn't cover the page leaves the fault waiting
+    ASSERT_TRUE(supply(p, 0, 2));
+    ASSERT_TRUE(supply(p, 2 * PAGE_SIZE, kBatchPages - 2));
+    ASSERT_EQ(thrd_join(t, nullptr), thrd_success);
+    EXPECT_EQ(r.status, ZX_OK);
+    EXPECT_EQ(r.byte, 4u);
+
+    EXPECT_EQ(zx_vmar_unmap(zx_vmar_root_self(), addr, kVmoPages * PAGE_SIZE), ZX_OK);
+    END_TEST;
+}
+
+bool clone_test() {
+    BEGIN_TEST;
+    Pager p;
+    ASSERT_TRUE(create_pager(&p));
+
+    zx_handle_t clone;
+    ASSERT_EQ(zx_vmo_clone(p.vmo, ZX_VMO_CLONE_COPY_ON_WRITE, 0, kVmoPages * PAGE_SIZE, &clone),
+              ZX_OK);
+
+    // reads through the clone find the contents by way of the pager
+    Reader r = {clone, 5 * PAGE_SIZE, 0, ZX_ERR_INTERNAL};
+    thrd_t t;
+    ASSERT_EQ(thrd_create(&t, read_thread, &r), thrd_success);
+    ASSERT_TRUE(wait_for_request(p, ZX_PAGER_VMO_READ, 0, kBatchPages * PAGE_SIZE));
+    ASSERT_TRUE(supply(p, 0, kBatchPages));
+    ASSERT_EQ(thrd_join(t, nullptr), thrd_success);
+    EXPECT_EQ(r.status, ZX_OK);
+    EXPECT_EQ(r.byte, 6u);
+
+    uint8_t byte = 0xff;
+    size_t actual;
+    EXPECT_EQ(zx_vmo_write(clone, &byte, 5 * PAGE_SIZE, 1, &actual), ZX_OK);
+    EXPECT_EQ(zx_vmo_read(p.vmo, &byte, 5 * PAGE_SIZE, 1, &actual), ZX_OK);
+    EXPECT_EQ(byte, 6u);
+
+    zx_handle_close(clone);
+    END_TEST;
+}
+
+bool complete_test() {
+    BEGIN_TEST;
+    Pager p;
+    ASSERT_TRUE(create_pager(&p));
+
+    zx_handle_close(p.vmo);
+    p.vmo = ZX_HANDLE_INVALID;
+    ASSERT_TRUE(wait_for_request(p, ZX_PAGER_VMO_COMPLETE, 0, 0));
+
+    END_TEST;
+}
+
+bool close_pager_test() {
+    BEGIN_TEST;
+    Pager p;
+    ASSERT_TRUE(create_pager(&p));
+
+    Reader r = {p.vmo, 0, 0, ZX_ERR_INTERNAL};
+    thrd_t t;
+    ASSERT_EQ(thrd_create(&t, read_thread, &r), thrd_success);
+    ASSERT_TRUE(wait_for_request(p, ZX_PAGER_VMO_READ, 0, kBatchPages * PAGE_SIZE));
+
+    // with the pager gone nothing will supply the page
+    zx_handle_close(p.pager);
+    p.pager = ZX_HANDLE_INVALID;
+    ASSERT_EQ(thrd_join(t, nullptr), thrd_success);
+    EXPECT_EQ(r.status, ZX_ERR_BAD_STATE);
+
+    END_TEST;
+}
+
+bool invalid_args_test() {
+    BEGIN_TEST;
+    Pager p;
+    ASSERT_TRUE(create_pager(&p));
+
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_pager_create_vmo(p.pager, p.port, kKey, PAGE_SIZE, 1, &vmo),
+              ZX_ERR_INVALID_ARGS);
+
+    zx_handle_t aux;
+    ASSERT_EQ(zx_vmo_create(2 * PAGE_SIZE, 0, &aux), ZX_OK);
+    EXPECT_EQ(zx_pager_supply_pages(p.pager, p.vmo, 1, PAGE_SIZE, aux, 0), ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_pager_supply_pages(p.pager, p.vmo, 0, PAGE_SIZE, aux, 1), ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_pager_supply_pages(p.pager, p.vmo, kVmoPages * PAGE_SIZE, PAGE_SIZE, aux, 0),
+              ZX_ERR_OUT_OF_RANGE);
+
+    // only the pager that created the vmo can fill it in
+    zx_handle_t other;
+    ASSERT_EQ(zx_pager_create(0, &other), ZX_OK);
+    EXPECT_EQ(zx_pager_supply_pages(other, p.vmo, 0, PAGE_SIZE, aux, 0), ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_pager_supply_pages(p.pager, aux, 0, PAGE_SIZE, aux, 0), ZX_ERR_INVALID_ARGS);
+
+    // the pager decides how big its vmos are
+    EXPECT_EQ(zx_vmo_set_size(p.vmo, PAGE_SIZE), ZX_ERR_NOT_SUPPORTED);
+
+    zx_handle_close(other);
+    zx_handle_close(aux);
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(pager_tests)
+RUN_TEST(read_test)
+RUN_TEST(fault_test)
+RUN_TEST(clone_test)
+RUN_TEST(complete_test)
+RUN_TEST(close_pager_test)
+RUN_TEST(invalid_args_test)
+END_TEST_CASE(pager_tests)
+
+#ifndef BUILD_COMBINED_TESTS
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
+#endif
@@ -6,6 +6,7 @@
 #include <threads.h>
 
 #include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
 #include <zircon/syscalls/port.h>
 #include <fbl/algorithm.h>
 
@@ -139,6 +140,78 @@ static bool wait_count_invalid_test() {
     END_TEST;
 }
 
+static bool wait_many_test() {
+    BEGIN_TEST;
+
+    zx_handle_t port;
+    zx_status_t status = zx_port_create(0u, &port);
+    EXPECT_EQ(status, ZX_OK);
+
+    for (uint64_t key = 0u; key < 5u; ++key) {
+        const zx_port_packet_t in = {key, ZX_PKT_TYPE_USER, 0, {}};
+        EXPECT_EQ(zx_port_queue(port, &in, 1u), ZX_OK);
+    }
+
+    // Takes what is there, up to |count|, in order.
+    zx_port_packet_t out[ZX_PORT_MAX_BATCH_PACKETS] = {};
+    size_t actual = 0u;
+    status = zx_port_wait_many(port, ZX_TIME_INFINITE, out, 3u, &actual);
+    EXPECT_EQ(status, ZX_OK);
+    EXPECT_EQ(actual, 3u);
+    for (uint64_t i = 0u; i < actual; ++i)
+        EXPECT_EQ(out[i].key, i);
+
+    status = zx_port_wait_many(port, 0u, out, fbl::count_of(out), &actual);
+    EXPECT_EQ(status, ZX_OK);
+    EXPECT_EQ(actual, 2u);
+    EXPECT_EQ(out[0].key, 3u);
+    EXPECT_EQ(out[1].key, 4u);
+
+    status = zx_port_wait_many(port, 0u, out, fbl::count_of(out), &actual);
+    EXPECT_EQ(status, ZX_ERR_TIMED_OUT);
+
+    status = zx_port_wait_many(port, 0u, out, 0u, &actual);
+    EXPECT_EQ(status, ZX_ERR_OUT_OF_RANGE);
+    status = zx_port_wait_many(port, 0u, out, ZX_PORT_MAX_BATCH_PACKETS + 1u, &actual);
+    EXPECT_EQ(status, ZX_ERR_OUT_OF_RANGE);
+
+    EXPECT_EQ(zx_handle_close(port), ZX_OK);
+
+    END_TEST;
+}
+
+static bool info_test() {
+    BEGIN_TEST;
+
+    zx_handle_t port;
+    EXPECT_EQ(zx_port_create(ZX_PORT_LIFO, &port), ZX_OK);
+
+    zx_info_port_t info;
+    EXPECT_EQ(zx_object_get_info(port, ZX_INFO_PORT, &info, sizeof(info), nullptr, nullptr),
+              ZX_OK);
+    EXPECT_EQ(info.queue_depth, 0u);
+    EXPECT_EQ(info.packets_dequeued, 0u);
+
+    const zx_port_packet_t in = {};
+    for (int i = 0; i < 3; ++i)
+        EXPECT_EQ(zx_port_queue(port, &in, 1u), ZX_OK);
+    zx_port_packet_t out;
+    EXPECT_EQ(zx_port_wait(port, ZX_TIME_INFINITE, &out, 1u), ZX_OK);
+
+    EXPECT_EQ(zx_object_get_info(port, ZX_INFO_PORT, &info, sizeof(info), nullptr, nullptr),
+              ZX_OK);
+    EXPECT_EQ(info.queue_depth, 2u);
+    EXPECT_EQ(info.max_queue_depth, 3u);
+    EXPECT_EQ(info.packets_dequeued, 1u);
+    EXPECT_EQ(info.waits, 0u, "packets were already there");
+
+    EXPECT_EQ(zx_handle_close(port), ZX_OK);
+
+    EXPECT_EQ(zx_port_create(ZX_PORT_LIFO << 1, &port), ZX_ERR_INVALID_ARGS);
+
+    END_TEST;
+}
+
 static bool queue_and_close_test(void) {
     BEGIN_TEST;
     zx_status_t status;
@@ -746,6 +819,8 @@ RUN_TEST(wait_count_valid_test<0u>)
 RUN_TEST(wait_count_valid_test<1u>)
 RUN_TEST(wait_count_invalid_test<2u>)
 RUN_TEST(wait_count_invalid_test<23u>)
+RUN_TEST(wait_many_test)
+RUN_TEST(info_test)
 RUN_TEST(queue_and_close_test)
 RUN_TEST(async_wait_channel_test)
 RUN_TEST(async_wait_event_test_single)
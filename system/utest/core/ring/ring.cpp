@@ -0,0 +1,251 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
+#include <zircon/syscalls/ring.h>
+
+#include <unittest/unittest.h>
+
+namespace {
+
+struct Ring {
+    zx_handle_t ring = ZX_HANDLE_INVALID;
+    uintptr_t addr = 0;
+    zx_ring_queue_t* sq = nullptr;
+    zx_ring_queue_t* cq = nullptr;
+    zx_ring_sqe_t* sqes = nullptr;
+    zx_ring_cqe_t* cqes = nullptr;
+
+    ~Ring() {
+        if (addr)
+            zx_vmar_unmap(zx_vmar_root_self(), addr, ZX_RING_VMO_SIZE);
+        zx_handle_close(ring);
+    }
+
+    // Queues |sqe| without telling the kernel.
+    void Submit(const zx_ring_sqe_t& sqe) {
+        uint32_t head = __atomic_load_n(&sq->head, __ATOMIC_RELAXED);
+        sqes[head % ZX_RING_SQ_ENTRIES] = sqe;
+        __atomic_store_n(&sq->head, head + 1, __ATOMIC_RELEASE);
+    }
+
+    // Takes the oldest completion, returning false if there is none.
+    bool Complete(zx_ring_cqe_t* cqe) {
+        uint32_t tail = __atomic_load_n(&cq->tail, __ATOMIC_RELAXED);
+        if (__atomic_load_n(&cq->head, __ATOMIC_ACQUIRE) == tail)
+            return false;
+        *cqe = cqes[tail % ZX_RING_CQ_ENTRIES];
+        __atomic_store_n(&cq->tail, tail + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+};
+
+bool create_ring(Ring* r) {
+    BEGIN_HELPER;
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_ring_create(0, &r->ring, &vmo), ZX_OK);
+    ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, ZX_RING_VMO_SIZE,
+                          ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE, &r->addr), ZX_OK);
+    zx_handle_close(vmo);
+    r->sq = reinterpret_cast<zx_ring_queue_t*>(r->addr + ZX_RING_SQ_HEADER_OFFSET);
+    r->cq = reinterpret_cast<zx_ring_queue_t*>(r->addr + ZX_RING_CQ_HEADER_OFFSET);
+    r->sqes = reinterpret_cast<zx_ring_sqe_t*>(r->addr + ZX_RING_SQ_OFFSET);
+    r->cqes = reinterpret_cast<zx_ring_cqe_t*>(r->addr + ZX_RING_CQ_OFFSET);
+    END_HELPER;
+}
+
+zx_ring_sqe_t make_sqe(uint32_t op, zx_handle_t handle, uint64_t user_data) {
+    zx_ring_sqe_t sqe = {};
+    sqe.op = op;
+    sqe.handle = handle;
+    sqe.user_data = user_data;
+    return sqe;
+}
+
+uint64_t ptr_arg(const void* p) {
+    return reinterpret_cast<uintptr_t>(p);
+}
+
+bool batch_test() {
+    BEGIN_TEST;
+    Ring r;
+    ASSERT_TRUE(create_ring(&r));
+
+    zx_handle_t ch[2];
+    ASSERT_EQ(zx_channel_create(0, &ch[0], &ch[1]), ZX_OK);
+    zx_handle_t event;
+    ASSERT_EQ(zx_event_create(0, &event), ZX_OK);
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(PAGE_SIZE, 0, &vmo), ZX_OK);
+
+    const char msg[] = "ring";
+    zx_ring_sqe_t sqe = make_sqe(ZX_RING_OP_CHANNEL_WRITE, ch[0], 1u);
+    sqe.args[0] = ptr_arg(msg);
+    sqe.args[1] = sizeof(msg);
+    r.Submit(sqe);
+
+    char buf[16] = {};
+    uint32_t actual_bytes = 0, actual_handles = 0;
+    sqe = make_sqe(ZX_RING_OP_CHANNEL_READ, ch[1], 2u);
+    sqe.args[0] = ptr_arg(buf);
+    sqe.args[2] = sizeof(buf);
+    sqe.args[4] = ptr_arg(&actual_bytes);
+    sqe.args[5] = ptr_arg(&actual_handles);
+    r.Submit(sqe);
+
+    sqe = make_sqe(ZX_RING_OP_VMO_WRITE, vmo, 3u);
+    sqe.args[0] = ptr_arg(msg);
+    sqe.args[1] = 16u;
+    sqe.args[2] = sizeof(msg);
+    r.Submit(sqe);
+
+    sqe = make_sqe(ZX_RING_OP_OBJECT_SIGNAL, event, 4u);
+    sqe.args[1] = ZX_EVENT_SIGNALED;
+    r.Submit(sqe);
+
+    uint32_t actual;
+    ASSERT_EQ(zx_ring_enter(r.ring, 0, ZX_RING_SQ_ENTRIES, &actual), ZX_OK);
+    EXPECT_EQ(actual, 4u);
+
+    for (uint64_t i = 1; i <= 4; i++) {
+        zx_ring_cqe_t cqe;
+        ASSERT_TRUE(r.Complete(&cqe));
+        EXPECT_EQ(cqe.user_data, i);
+        EXPECT_EQ(cqe.status, ZX_OK);
+    }
+    zx_ring_cqe_t cqe;
+    EXPECT_FALSE(r.Complete(&cqe));
+
+    EXPECT_EQ(actual_bytes, sizeof(msg));
+    EXPECT_EQ(actual_handles, 0u);
+    EXPECT_EQ(memcmp(buf, msg, sizeof(msg)), 0);
+
+    char vmo_buf[sizeof(msg)];
+    size_t vmo_actual;
+    ASSERT_EQ(zx_vmo_read(vmo, vmo_buf, 16u, sizeof(vmo_buf), &vmo_actual), ZX_OK);
+    EXPECT_EQ(memcmp(vmo_buf, msg, sizeof(msg)), 0);
+
+    zx_signals_t pending;
+    EXPECT_EQ(zx_object_wait_one(event, ZX_EVENT_SIGNALED, 0, &pending), ZX_OK);
+
+    zx_handle_close(vmo);
+    zx_handle_close(event);
+    zx_handle_close(ch[0]);
+    zx_handle_close(ch[1]);
+    END_TEST;
+}
+
+bool errors_test() {
+    BEGIN_TEST;
+    Ring r;
+    ASSERT_TRUE(create_ring(&r));
+
+    // a failing operation completes with its status and doesn't stop the
+    // ones after it
+    r.Submit(make_sqe(ZX_RING_OP_OBJECT_SIGNAL, ZX_HANDLE_INVALID, 1u));
+    r.Submit(make_sqe(0xffffu, ZX_HANDLE_INVALID, 2u));
+    r.Submit(make_sqe(ZX_RING_OP_NOP, ZX_HANDLE_INVALID, 3u));
+
+    uint32_t actual;
+    ASSERT_EQ(zx_ring_enter(r.ring, 0, ZX_RING_SQ_ENTRIES, &actual), ZX_OK);
+    EXPECT_EQ(actual, 3u);
+
+    zx_ring_cqe_t cqe;
+    ASSERT_TRUE(r.Complete(&cqe));
+    EXPECT_EQ(cqe.status, ZX_ERR_BAD_HANDLE);
+    ASSERT_TRUE(r.Complete(&cqe));
+    EXPECT_EQ(cqe.status, ZX_ERR_NOT_SUPPORTED);
+    ASSERT_TRUE(r.Complete(&cqe));
+    EXPECT_EQ(cqe.status, ZX_OK);
+
+    // a submission queue holding more than it can isn't used
+    r.sq->head += ZX_RING_SQ_ENTRIES + 1;
+    EXPECT_EQ(zx_ring_enter(r.ring, 0, 1u, &actual), ZX_ERR_BAD_STATE);
+
+    EXPECT_EQ(zx_ring_enter(r.ring, 1u, 1u, &actual), ZX_ERR_INVALID_ARGS);
+    END_TEST;
+}
+
+bool partial_test() {
+    BEGIN_TEST;
+    Ring r;
+    ASSERT_TRUE(create_ring(&r));
+
+    for (uint64_t i = 0; i < 3; i++)
+        r.Submit(make_sqe(ZX_RING_OP_NOP, ZX_HANDLE_INVALID, i));
+
+    // only as many as asked for are taken
+    uint32_t actual;
+    ASSERT_EQ(zx_ring_enter(r.ring, 0, 2u, &actual), ZX_OK);
+    EXPECT_EQ(actual, 2u);
+    EXPECT_EQ(r.sq->tail, 2u);
+    ASSERT_EQ(zx_ring_enter(r.ring, 0, 2u, &actual), ZX_OK);
+    EXPECT_EQ(actual, 1u);
+    ASSERT_EQ(zx_ring_enter(r.ring, 0, 2u, &actual), ZX_OK);
+    EXPECT_EQ(actual, 0u);
+    END_TEST;
+}
+
+bool port_test() {
+    BEGIN_TEST;
+    Ring r;
+    ASSERT_TRUE(create_ring(&r));
+
+    zx_handle_t port;
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK);
+    ASSERT_EQ(zx_object_wait_async(r.ring, port, 1u, ZX_RING_READABLE, ZX_WAIT_ASYNC_ONCE),
+              ZX_OK);
+
+    // completions are announced on the port
+    zx_port_packet_t packet = {};
+    packet.key = 2u;
+    packet.type = ZX_PKT_TYPE_USER;
+    zx_ring_sqe_t sqe = make_sqe(ZX_RING_OP_PORT_QUEUE, port, 7u);
+    sqe.args[0] = ptr_arg(&packet);
+    r.Submit(sqe);
+
+    uint32_t actual;
+    ASSERT_EQ(zx_ring_enter(r.ring, 0, 1u, &actual), ZX_OK);
+    EXPECT_EQ(actual, 1u);
+
+    zx_port_packet_t out;
+    ASSERT_EQ(zx_port_wait(port, 0, &out, 0), ZX_OK);
+    EXPECT_EQ(out.key, 2u);
+    ASSERT_EQ(zx_port_wait(port, 0, &out, 0), ZX_OK);
+    EXPECT_EQ(out.key, 1u);
+    EXPECT_EQ(out.type, ZX_PKT_TYPE_SIGNAL_ONE);
+    EXPECT_TRUE(out.signal.observed & ZX_RING_READABLE);
+
+    // once the completions are taken the next entry clears the signal
+    zx_ring_cqe_t cqe;
+    ASSERT_TRUE(r.Complete(&cqe));
+    EXPECT_EQ(cqe.user_data, 7u);
+    ASSERT_EQ(zx_ring_enter(r.ring, 0, 1u, &actual), ZX_OK);
+    zx_signals_t pending;
+    EXPECT_EQ(zx_object_wait_one(r.ring, ZX_RING_READABLE, 0, &pending), ZX_ERR_TIMED_OUT);
+
+    zx_handle_close(port);
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(ring_tests)
+RUN_TEST(batch_test)
+RUN_TEST(errors_test)
+RUN_TEST(partial_test)
+RUN_TEST(port_test)
+END_TEST_CASE(ring_tests)
+
+#ifndef BUILD_COMBINED_TESTS
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
+#endif
@@ -3,11 +3,14 @@
 // found in the LICENSE file.
 
 #include <assert.h>
+#include <zircon/process.h>
 #include <zircon/syscalls.h>
+#include <zircon/syscalls/socket.h>
 #include <unittest/unittest.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 static zx_signals_t get_satisfied_signals(zx_handle_t handle) {
@@ -799,6 +802,96 @@ static bool socket_accept(void) {
     END_TEST;
 }
 
+static bool socket_ring_unsupported(void) {
+    BEGIN_TEST;
+
+    zx_handle_t h0, h1;
+    EXPECT_EQ(zx_socket_create(ZX_SOCKET_RING | ZX_SOCKET_DATAGRAM, &h0, &h1),
+              ZX_ERR_INVALID_ARGS, "");
+
+    ASSERT_EQ(zx_socket_create(0, &h0, &h1), ZX_OK, "");
+    zx_handle_t vmo;
+    uint32_t index;
+    EXPECT_EQ(zx_socket_get_ring(h0, &vmo, &index), ZX_ERR_NOT_SUPPORTED, "");
+    EXPECT_EQ(zx_socket_ring_update(h0), ZX_ERR_NOT_SUPPORTED, "");
+
+    zx_handle_close(h0);
+    zx_handle_close(h1);
+    END_TEST;
+}
+
+static bool socket_ring(void) {
+    BEGIN_TEST;
+
+    zx_handle_t h0, h1;
+    ASSERT_EQ(zx_socket_create(ZX_SOCKET_RING, &h0, &h1), ZX_OK, "");
+
+    zx_handle_t vmo0, vmo1;
+    uint32_t index0, index1;
+    ASSERT_EQ(zx_socket_get_ring(h0, &vmo0, &index0), ZX_OK, "");
+    ASSERT_EQ(zx_socket_get_ring(h1, &vmo1, &index1), ZX_OK, "");
+    EXPECT_EQ(index0 ^ 1u, index1, "");
+
+    uintptr_t addr;
+    ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), 0, vmo0, 0, ZX_SOCKET_RING_VMO_SIZE,
+                          ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE, &addr), ZX_OK, "");
+    zx_socket_ring_t* tx = (zx_socket_ring_t*)(addr + ZX_SOCKET_RING_HEADER_OFFSET(index0));
+    zx_socket_ring_t* rx = (zx_socket_ring_t*)(addr + ZX_SOCKET_RING_HEADER_OFFSET(index1));
+    char* tx_data = (char*)(addr + ZX_SOCKET_RING_DATA_OFFSET(index0));
+    char* rx_data = (char*)(addr + ZX_SOCKET_RING_DATA_OFFSET(index1));
+
+    // Produce through the mapping, wrapping around the end of the ring.
+    const uint32_t start = ZX_SOCKET_RING_SIZE - 4;
+    tx->head = tx->tail = start;
+    static const char msg[] = "ring data";
+    for (size_t i = 0; i < sizeof(msg); ++i)
+        tx_data[(start + i) % ZX_SOCKET_RING_SIZE] = msg[i];
+    __atomic_store_n(&tx->head, start + (uint32_t)sizeof(msg), __ATOMIC_RELEASE);
+
+    // The reader is not signaled until someone rings the doorbell.
+    EXPECT_FALSE(get_satisfied_signals(h1) & ZX_SOCKET_READABLE, "");
+    EXPECT_EQ(zx_socket_ring_update(h0), ZX_OK, "");
+    EXPECT_TRUE(get_satisfied_signals(h1) & ZX_SOCKET_READABLE, "");
+
+    size_t count;
+    EXPECT_EQ(zx_socket_read(h1, 0u, NULL, 0, &count), ZX_OK, "");
+    EXPECT_EQ(count, sizeof(msg), "");
+
+    char buf[sizeof(msg)];
+    EXPECT_EQ(zx_socket_read(h1, 0u, buf, sizeof(buf), &count), ZX_OK, "");
+    EXPECT_EQ(count, sizeof(msg), "");
+    EXPECT_EQ(memcmp(buf, msg, sizeof(msg)), 0, "");
+    EXPECT_EQ(__atomic_load_n(&tx->tail, __ATOMIC_ACQUIRE), tx->head, "");
+    EXPECT_FALSE(get_satisfied_signals(h1) & ZX_SOCKET_READABLE, "");
+
+    // Consume through the mapping what the kernel wrote into the other ring.
+    EXPECT_EQ(zx_socket_write(h1, 0u, msg, sizeof(msg), &count), ZX_OK, "");
+    EXPECT_EQ(count, sizeof(msg), "");
+    EXPECT_EQ(rx->head - rx->tail, sizeof(msg), "");
+    EXPECT_EQ(memcmp(rx_data + (rx->tail % ZX_SOCKET_RING_SIZE), msg, sizeof(msg)), 0, "");
+    __atomic_store_n(&rx->tail, rx->head, __ATOMIC_RELEASE);
+    EXPECT_EQ(zx_socket_ring_update(h0), ZX_OK, "");
+    EXPECT_FALSE(get_satisfied_signals(h0) & ZX_SOCKET_READABLE, "");
+
+    // A full ring clears the peer's writable signal.
+    tx->head = tx->tail + ZX_SOCKET_RING_SIZE;
+    EXPECT_EQ(zx_socket_ring_update(h1), ZX_OK, "");
+    EXPECT_FALSE(get_satisfied_signals(h0) & ZX_SOCKET_WRITABLE, "");
+    EXPECT_EQ(zx_socket_write(h0, 0u, msg, sizeof(msg), &count), ZX_ERR_SHOULD_WAIT, "");
+
+    // Indices further apart than the ring are clamped rather than trusted.
+    tx->head = tx->tail + 3 * ZX_SOCKET_RING_SIZE;
+    EXPECT_EQ(zx_socket_read(h1, 0u, NULL, 0, &count), ZX_OK, "");
+    EXPECT_EQ(count, ZX_SOCKET_RING_SIZE, "");
+
+    EXPECT_EQ(zx_vmar_unmap(zx_vmar_root_self(), addr, ZX_SOCKET_RING_VMO_SIZE), ZX_OK, "");
+    zx_handle_close(vmo0);
+    zx_handle_close(vmo1);
+    zx_handle_close(h0);
+    zx_handle_close(h1);
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(socket_tests)
 RUN_TEST(socket_basic)
 RUN_TEST(socket_signals)
@@ -814,6 +907,8 @@ RUN_TEST(socket_control_plane_absent)
 RUN_TEST(socket_control_plane)
 RUN_TEST(socket_control_plane_shutdown)
 RUN_TEST(socket_accept)
+RUN_TEST(socket_ring_unsupported)
+RUN_TEST(socket_ring)
 END_TEST_CASE(socket_tests)
 
 #ifndef BUILD_COMBINED_TESTS
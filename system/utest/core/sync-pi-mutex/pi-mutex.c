@@ -0,0 +1,112 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <sync/pi_mutex.h>
+
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+#include <unittest/unittest.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <threads.h>
+
+#define NUM_THREADS 8
+#define ITERATIONS 500
+
+static pi_mutex_t counter_mutex = PI_MUTEX_INIT;
+static int counter;
+
+static int counter_thread(void* arg) {
+    for (int i = 0; i < ITERATIONS; i++) {
+        pi_mutex_lock(&counter_mutex);
+        int value = counter;
+        if (i % 16 == 0)
+            zx_nanosleep(zx_deadline_after(ZX_USEC(1)));
+        counter = value + 1;
+        pi_mutex_unlock(&counter_mutex);
+    }
+    return 0;
+}
+
+static bool test_pi_mutex_contended(void) {
+    BEGIN_TEST;
+
+    counter = 0;
+    thrd_t threads[NUM_THREADS];
+    for (int i = 0; i < NUM_THREADS; i++) {
+        ASSERT_EQ(thrd_create_with_name(&threads[i], counter_thread, NULL, "pi mutex"),
+                  thrd_success, "thread creation failed");
+    }
+    for (int i = 0; i < NUM_THREADS; i++)
+        thrd_join(threads[i], NULL);
+
+    EXPECT_EQ(counter, NUM_THREADS * ITERATIONS, "lost an update under the mutex");
+    EXPECT_EQ(atomic_load(&counter_mutex.futex.futex), 0, "mutex left locked");
+
+    END_TEST;
+}
+
+static pi_mutex_t held_mutex = PI_MUTEX_INIT;
+
+static int timedlock_thread(void* arg) {
+    zx_status_t* status = arg;
+    *status = pi_mutex_timedlock(&held_mutex, zx_deadline_after(ZX_MSEC(10)));
+    if (*status == ZX_OK)
+        pi_mutex_unlock(&held_mutex);
+    return 0;
+}
+
+static bool test_pi_mutex_trylock_and_timeout(void) {
+    BEGIN_TEST;
+
+    pi_mutex_lock(&held_mutex);
+    EXPECT_EQ(pi_mutex_trylock(&held_mutex), ZX_ERR_BAD_STATE, "trylock of held mutex");
+
+    zx_status_t status = ZX_ERR_INTERNAL;
+    thrd_t thread;
+    ASSERT_EQ(thrd_create_with_name(&thread, timedlock_thread, &status, "pi timedlock"),
+              thrd_success, "thread creation failed");
+    thrd_join(thread, NULL);
+    EXPECT_EQ(status, ZX_ERR_TIMED_OUT, "timedlock of held mutex");
+
+    pi_mutex_unlock(&held_mutex);
+    EXPECT_EQ(pi_mutex_trylock(&held_mutex), ZX_OK, "trylock of free mutex");
+    pi_mutex_unlock(&held_mutex);
+
+    END_TEST;
+}
+
+static bool test_futex_wait_owned_args(void) {
+    BEGIN_TEST;
+
+    zx_futex_t futex = 1;
+
+    // a thread cannot wait on a futex it owns itself
+    EXPECT_EQ(zx_futex_wait_owned(&futex, 1, zx_thread_self(), ZX_TIME_INFINITE),
+              ZX_ERR_INVALID_ARGS, "wait with self as owner");
+
+    // the owner has to be a thread
+    EXPECT_EQ(zx_futex_wait_owned(&futex, 1, zx_process_self(), ZX_TIME_INFINITE),
+              ZX_ERR_WRONG_TYPE, "wait with a process as owner");
+
+    // without an owner it is a plain wait
+    EXPECT_EQ(zx_futex_wait_owned(&futex, 1, ZX_HANDLE_INVALID, zx_deadline_after(ZX_MSEC(1))),
+              ZX_ERR_TIMED_OUT, "wait without owner");
+
+    EXPECT_EQ(zx_futex_wake_single_owner(&futex), ZX_OK, "wake with no waiters");
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(pi_mutex_tests)
+RUN_TEST(test_pi_mutex_contended)
+RUN_TEST(test_pi_mutex_trylock_and_timeout)
+RUN_TEST(test_futex_wait_owned_args)
+END_TEST_CASE(pi_mutex_tests)
+
+#ifndef BUILD_COMBINED_TESTS
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
+#endif
@@ -0,0 +1,197 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <sync/condvar.h>
+#include <sync/rwlock.h>
+
+#include <zircon/syscalls.h>
+#include <unittest/unittest.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <threads.h>
+
+#define NUM_THREADS 8
+#define ITERATIONS 500
+
+static sync_rwlock_t counter_lock = SYNC_RWLOCK_INIT;
+static int counter;
+static atomic_int torn_reads;
+
+static int counter_thread(void* arg) {
+    for (int i = 0; i < ITERATIONS; i++) {
+        if (i % 4 == 0) {
+            sync_rwlock_wrlock(&counter_lock);
+            int value = counter;
+            if (i % 16 == 0)
+                zx_nanosleep(zx_deadline_after(ZX_USEC(1)));
+            counter = value + 1;
+            sync_rwlock_unlock(&counter_lock);
+        } else {
+            sync_rwlock_rdlock(&counter_lock);
+            int value = counter;
+            zx_nanosleep(zx_deadline_after(ZX_USEC(1)));
+            if (counter != value)
+                atomic_fetch_add(&torn_reads, 1);
+            sync_rwlock_unlock(&counter_lock);
+        }
+    }
+    return 0;
+}
+
+static bool test_rwlock_contended(void) {
+    BEGIN_TEST;
+
+    counter = 0;
+    atomic_store(&torn_reads, 0);
+    thrd_t threads[NUM_THREADS];
+    for (int i = 0; i < NUM_THREADS; i++) {
+        ASSERT_EQ(thrd_create_with_name(&threads[i], counter_thread, NULL, "rwlock"),
+                  thrd_success, "thread creation failed");
+    }
+    for (int i = 0; i < NUM_THREADS; i++)
+        thrd_join(threads[i], NULL);
+
+    EXPECT_EQ(counter, NUM_THREADS * ITERATIONS / 4, "lost an update under the lock");
+    EXPECT_EQ(atomic_load(&torn_reads), 0, "value changed under a read lock");
+    EXPECT_EQ(atomic_load(&counter_lock.state.futex), 0, "lock left held");
+
+    END_TEST;
+}
+
+static sync_rwlock_t held_lock = SYNC_RWLOCK_INIT;
+
+static int timedwrlock_thread(void* arg) {
+    zx_status_t* status = arg;
+    *status = sync_rwlock_timedwrlock(&held_lock, zx_deadline_after(ZX_MSEC(10)));
+    if (*status == ZX_OK)
+        sync_rwlock_unlock(&held_lock);
+    return 0;
+}
+
+static int wrlock_thread(void* arg) {
+    sync_rwlock_wrlock(&held_lock);
+    atomic_store((atomic_int*)arg, 1);
+    sync_rwlock_unlock(&held_lock);
+    return 0;
+}
+
+static bool test_rwlock_try_and_timeout(void) {
+    BEGIN_TEST;
+
+    sync_rwlock_rdlock(&held_lock);
+    EXPECT_EQ(sync_rwlock_tryrdlock(&held_lock), ZX_OK, "second reader");
+    EXPECT_EQ(sync_rwlock_trywrlock(&held_lock), ZX_ERR_BAD_STATE, "trywrlock while read-locked");
+
+    zx_status_t status = ZX_ERR_INTERNAL;
+    thrd_t thread;
+    ASSERT_EQ(thrd_create_with_name(&thread, timedwrlock_thread, &status, "rw timedlock"),
+              thrd_success, "thread creation failed");
+    thrd_join(thread, NULL);
+    EXPECT_EQ(status, ZX_ERR_TIMED_OUT, "timedwrlock while read-locked");
+
+    sync_rwlock_unlock(&held_lock);
+    sync_rwlock_unlock(&held_lock);
+
+    sync_rwlock_wrlock(&held_lock);
+    EXPECT_EQ(sync_rwlock_tryrdlock(&held_lock), ZX_ERR_BAD_STATE, "tryrdlock while write-locked");
+    EXPECT_EQ(sync_rwlock_timedrdlock(&held_lock, zx_deadline_after(ZX_MSEC(1))),
+              ZX_ERR_TIMED_OUT, "timedrdlock while write-locked");
+    sync_rwlock_unlock(&held_lock);
+
+    EXPECT_EQ(sync_rwlock_trywrlock(&held_lock), ZX_OK, "trywrlock of free lock");
+    sync_rwlock_unlock(&held_lock);
+
+    END_TEST;
+}
+
+static bool test_rwlock_writer_preference(void) {
+    BEGIN_TEST;
+
+    sync_rwlock_rdlock(&held_lock);
+
+    atomic_int writer_done = 0;
+    thrd_t thread;
+    ASSERT_EQ(thrd_create_with_name(&thread, wrlock_thread, &writer_done, "rw writer"),
+              thrd_success, "thread creation failed");
+
+    // Once the writer is waiting, new readers have to wait behind it.
+    while (sync_rwlock_tryrdlock(&held_lock) == ZX_OK) {
+        sync_rwlock_unlock(&held_lock);
+        zx_nanosleep(zx_deadline_after(ZX_USEC(100)));
+    }
+    EXPECT_EQ(atomic_load(&writer_done), 0, "writer ran while read-locked");
+
+    sync_rwlock_unlock(&held_lock);
+    thrd_join(thread, NULL);
+    EXPECT_EQ(atomic_load(&writer_done), 1, "writer did not run");
+    EXPECT_EQ(sync_rwlock_tryrdlock(&held_lock), ZX_OK, "reader after writer");
+    sync_rwlock_unlock(&held_lock);
+
+    END_TEST;
+}
+
+static sync_mutex_t cond_mutex = SYNC_MUTEX_INIT;
+static sync_condvar_t condvar = SYNC_CONDVAR_INIT;
+static int go;
+static int woken;
+
+static int condvar_thread(void* arg) {
+    sync_mutex_lock(&cond_mutex);
+    while (!go)
+        sync_condvar_wait(&condvar, &cond_mutex);
+    woken++;
+    sync_mutex_unlock(&cond_mutex);
+    return 0;
+}
+
+static bool test_condvar_broadcast(void) {
+    BEGIN_TEST;
+
+    go = 0;
+    woken = 0;
+    thrd_t threads[NUM_THREADS];
+    for (int i = 0; i < NUM_THREADS; i++) {
+        ASSERT_EQ(thrd_create_with_name(&threads[i], condvar_thread, NULL, "condvar"),
+                  thrd_success, "thread creation failed");
+    }
+    zx_nanosleep(zx_deadline_after(ZX_MSEC(10)));
+
+    sync_mutex_lock(&cond_mutex);
+    go = 1;
+    sync_condvar_broadcast(&condvar);
+    sync_mutex_unlock(&cond_mutex);
+
+    for (int i = 0; i < NUM_THREADS; i++)
+        thrd_join(threads[i], NULL);
+    EXPECT_EQ(woken, NUM_THREADS, "not every waiter woke");
+    EXPECT_EQ(atomic_load(&cond_mutex.futex.futex), 0, "mutex left locked");
+
+    END_TEST;
+}
+
+static bool test_condvar_timeout(void) {
+    BEGIN_TEST;
+
+    sync_mutex_lock(&cond_mutex);
+    EXPECT_EQ(sync_condvar_timedwait(&condvar, &cond_mutex, zx_deadline_after(ZX_MSEC(1))),
+              ZX_ERR_TIMED_OUT, "timedwait without a signal");
+    EXPECT_EQ(sync_mutex_trylock(&cond_mutex), ZX_ERR_BAD_STATE, "mutex reacquired");
+    sync_mutex_unlock(&cond_mutex);
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(sync_rwlock_tests)
+RUN_TEST(test_rwlock_contended)
+RUN_TEST(test_rwlock_try_and_timeout)
+RUN_TEST(test_rwlock_writer_preference)
+RUN_TEST(test_condvar_broadcast)
+RUN_TEST(test_condvar_timeout)
+END_TEST_CASE(sync_rwlock_tests)
+
+#ifndef BUILD_COMBINED_TESTS
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
+#endif
@@ -332,6 +332,36 @@ static bool test_thread_kills_itself(void) {
     END_TEST;
 }
 
+static bool test_thread_set_deadline(void) {
+    BEGIN_TEST;
+
+    zx_handle_t self = zx_thread_self();
+
+    // Inconsistent parameters are rejected.
+    ASSERT_EQ(zx_thread_set_deadline(self, ZX_MSEC(2), ZX_MSEC(1), ZX_MSEC(4)),
+              ZX_ERR_INVALID_ARGS, "capacity > deadline");
+    ASSERT_EQ(zx_thread_set_deadline(self, ZX_MSEC(1), ZX_MSEC(8), ZX_MSEC(4)),
+              ZX_ERR_INVALID_ARGS, "deadline > period");
+    ASSERT_EQ(zx_thread_set_deadline(self, ZX_USEC(1), ZX_USEC(5), ZX_USEC(10)),
+              ZX_ERR_INVALID_ARGS, "period too short");
+
+    // A single thread can never reserve a whole cpu.
+    ASSERT_EQ(zx_thread_set_deadline(self, ZX_MSEC(10), ZX_MSEC(10), ZX_MSEC(10)),
+              ZX_ERR_NO_RESOURCES, "");
+
+    // A modest reservation is admitted, and the thread keeps running fine.
+    ASSERT_EQ(zx_thread_set_deadline(self, ZX_MSEC(1), ZX_MSEC(5), ZX_MSEC(10)), ZX_OK, "");
+    for (int i = 0; i < 10; ++i) {
+        ASSERT_EQ(zx_nanosleep(zx_deadline_after(ZX_MSEC(1))), ZX_OK, "");
+    }
+
+    // Leaving the class is always allowed, and is idempotent.
+    ASSERT_EQ(zx_thread_set_deadline(self, 0, 0, 0), ZX_OK, "");
+    ASSERT_EQ(zx_thread_set_deadline(self, 0, 0, 0), ZX_OK, "");
+
+    END_TEST;
+}
+
 static bool test_info_task_stats_fails(void) {
     BEGIN_TEST;
     // Spin up a thread.
@@ -1048,6 +1078,7 @@ RUN_TEST(test_kill_sleep_thread)
 RUN_TEST(test_kill_wait_thread)
 RUN_TEST(test_bad_state_nonstarted_thread)
 RUN_TEST(test_thread_kills_itself)
+RUN_TEST(test_thread_set_deadline)
 RUN_TEST(test_info_task_stats_fails)
 RUN_TEST(test_resume_suspended)
 RUN_TEST(test_suspend_sleeping)
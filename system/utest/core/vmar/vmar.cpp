@@ -1793,6 +1793,142 @@ bool protect_large_uncommitted_test() {
 }
 
 // Attempt to unmap a large mostly uncommitted VMO
+// Maps resident pages with each of the access hints, and checks that pages
+// mapped in around a fault are the right ones, and that those of a clone
+// still copy on write.
+bool access_hint_test() {
+    BEGIN_TEST;
+
+    const size_t page_count = 64;
+    const size_t size = page_count * PAGE_SIZE;
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(size, 0, &vmo), ZX_OK);
+    for (size_t i = 0; i < page_count; i++) {
+        uint64_t val = i;
+        size_t actual;
+        ASSERT_EQ(zx_vmo_write(vmo, &val, i * PAGE_SIZE, sizeof(val), &actual), ZX_OK);
+    }
+
+    uintptr_t addr;
+    EXPECT_EQ(zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, size,
+                          ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_ACCESS_SEQUENTIAL |
+                          ZX_VM_FLAG_ACCESS_RANDOM, &addr),
+              ZX_ERR_INVALID_ARGS);
+
+    const uint32_t hints[] = {0, ZX_VM_FLAG_ACCESS_SEQUENTIAL, ZX_VM_FLAG_ACCESS_RANDOM};
+    for (uint32_t hint : hints) {
+        zx_handle_t clone;
+        ASSERT_EQ(zx_vmo_clone(vmo, ZX_VMO_CLONE_COPY_ON_WRITE, 0, size, &clone), ZX_OK);
+
+        const zx_handle_t targets[] = {vmo, clone};
+        for (zx_handle_t target : targets) {
+            ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), 0, target, 0, size,
+                                  ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE | hint, &addr),
+                      ZX_OK);
+            auto pages = reinterpret_cast<volatile uint64_t*>(addr);
+            const size_t page_words = PAGE_SIZE / sizeof(uint64_t);
+
+            // start in the middle so both directions of the window get used
+            for (size_t i = 0; i < page_count; i++) {
+                size_t page = (i + page_count / 2) % page_count;
+                EXPECT_EQ(page, pages[page * page_words], "page contents");
+            }
+            if (target == clone) {
+                for (size_t i = 0; i < page_count; i++)
+                    pages[i * page_words] = 0;
+            }
+            EXPECT_EQ(zx_vmar_unmap(zx_vmar_root_self(), addr, size), ZX_OK);
+        }
+
+        // writes to the clone must not have reached the parent
+        for (size_t i = 0; i < page_count; i++) {
+            uint64_t val;
+            size_t actual;
+            EXPECT_EQ(zx_vmo_read(vmo, &val, i * PAGE_SIZE, sizeof(val), &actual), ZX_OK);
+            EXPECT_EQ(i, val, "parent unchanged");
+        }
+        EXPECT_EQ(zx_handle_close(clone), ZX_OK);
+    }
+
+    // subregions take the hint of their parent
+    zx_handle_t region;
+    uintptr_t region_addr;
+    ASSERT_EQ(zx_vmar_allocate(zx_vmar_root_self(), 0, size,
+                               ZX_VM_FLAG_CAN_MAP_READ | ZX_VM_FLAG_ACCESS_SEQUENTIAL,
+                               &region, &region_addr),
+              ZX_OK);
+    EXPECT_EQ(zx_vmar_map(region, 0, vmo, 0, size, ZX_VM_FLAG_PERM_READ, &addr), ZX_OK);
+    EXPECT_EQ(*reinterpret_cast<volatile uint64_t*>(addr + PAGE_SIZE), 1u, "page contents");
+    EXPECT_EQ(zx_vmar_destroy(region), ZX_OK);
+    EXPECT_EQ(zx_handle_close(region), ZX_OK);
+
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK);
+
+    END_TEST;
+}
+
+// Checks that a populated mapping has every page it covers committed up
+// front, and nothing else.
+bool map_populate_test() {
+    BEGIN_TEST;
+
+    const size_t page_count = 32;
+    const size_t size = page_count * PAGE_SIZE;
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(size, 0, &vmo), ZX_OK);
+
+    // map the middle of the vmo
+    const size_t map_offset = 4 * PAGE_SIZE;
+    const size_t map_size = size - 2 * map_offset;
+    uintptr_t addr;
+    ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), 0, vmo, map_offset, map_size,
+                          ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE | ZX_VM_FLAG_MAP_POPULATE,
+                          &addr),
+              ZX_OK);
+
+    zx_paddr_t paddrs[page_count];
+    EXPECT_EQ(zx_vmo_op_range(vmo, ZX_VMO_OP_LOOKUP, map_offset, map_size, paddrs,
+                              sizeof(paddrs)),
+              ZX_OK);
+    EXPECT_EQ(zx_vmo_op_range(vmo, ZX_VMO_OP_LOOKUP, 0, PAGE_SIZE, paddrs, sizeof(paddrs)),
+              ZX_ERR_NO_MEMORY);
+    EXPECT_EQ(zx_vmo_op_range(vmo, ZX_VMO_OP_LOOKUP, size - PAGE_SIZE, PAGE_SIZE, paddrs,
+                              sizeof(paddrs)),
+              ZX_ERR_NO_MEMORY);
+
+    // the pages are the vmo's, and start out zeroed
+    auto bytes = reinterpret_cast<volatile uint8_t*>(addr);
+    EXPECT_EQ(bytes[0], 0u);
+    bytes[map_size - 1] = 0x5a;
+    uint8_t val;
+    size_t actual;
+    EXPECT_EQ(zx_vmo_read(vmo, &val, map_offset + map_size - 1, 1, &actual), ZX_OK);
+    EXPECT_EQ(val, 0x5a);
+    EXPECT_EQ(zx_vmar_unmap(zx_vmar_root_self(), addr, map_size), ZX_OK);
+
+    // a mapping running past the end of the vmo can't be populated, and the
+    // failed map leaves nothing behind in the region
+    zx_handle_t region;
+    uintptr_t region_addr;
+    ASSERT_EQ(zx_vmar_allocate(zx_vmar_root_self(), 0, 2 * size,
+                               ZX_VM_FLAG_CAN_MAP_READ | ZX_VM_FLAG_CAN_MAP_SPECIFIC,
+                               &region, &region_addr),
+              ZX_OK);
+    EXPECT_EQ(zx_vmar_map(region, 0, vmo, 0, 2 * size,
+                          ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_SPECIFIC | ZX_VM_FLAG_MAP_POPULATE,
+                          &addr),
+              ZX_ERR_OUT_OF_RANGE);
+    EXPECT_EQ(zx_vmar_map(region, 0, vmo, 0, 2 * size,
+                          ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_SPECIFIC, &addr),
+              ZX_OK);
+    EXPECT_EQ(zx_vmar_destroy(region), ZX_OK);
+    EXPECT_EQ(zx_handle_close(region), ZX_OK);
+
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK);
+
+    END_TEST;
+}
+
 bool unmap_large_uncommitted_test() {
     BEGIN_TEST;
 
@@ -1866,6 +2002,8 @@ RUN_TEST(protect_multiple_test);
 RUN_TEST(protect_over_demand_paged_test);
 RUN_TEST(protect_large_uncommitted_test);
 RUN_TEST(unmap_large_uncommitted_test);
+RUN_TEST(access_hint_test);
+RUN_TEST(map_populate_test);
 END_TEST_CASE(vmar_tests)
 
 #ifndef BUILD_COMBINED_TESTS
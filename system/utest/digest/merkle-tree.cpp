@@ -4,11 +4,14 @@
 
 #include <digest/merkle-tree.h>
 
+#include <inttypes.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 #include <digest/digest.h>
 #include <zircon/assert.h>
 #include <zircon/status.h>
+#include <zircon/syscalls.h>
 #include <unittest/unittest.h>
 
 namespace {
@@ -692,6 +695,63 @@ bool CreateAndVerifyHugePRNGData(void) {
     END_TEST;
 }
 
+// Returns the throughput in MB/s of hashing |len| bytes |iterations| times in
+// |ticks|.
+uint64_t Throughput(size_t len, size_t iterations, uint64_t ticks) {
+    return (len * iterations * zx_ticks_per_second()) / (ticks * (1U << 20));
+}
+
+// Compares hashing the leaves one node at a time with Digest, as MerkleTree
+// used to, against creating and verifying the whole tree with the CPU's best
+// SHA-256 backend. The digests of the leaves must match.
+bool BenchmarkCreateAndVerify(void) {
+    BEGIN_TEST_WITH_RC;
+    const size_t kIterations = 16;
+    size_t data_len = kLarge;
+    size_t tree_len = MerkleTree::GetTreeLength(data_len);
+    for (size_t i = 0; i < data_len; ++i) {
+        gData[i] = static_cast<uint8_t>(rand());
+    }
+    Digest digest;
+    ASSERT_OK(MerkleTree::Create(gData, data_len, gTree, tree_len, &digest));
+
+    uint64_t start = zx_ticks_get();
+    Digest node;
+    for (size_t n = 0; n < kIterations; ++n) {
+        for (size_t offset = 0; offset < data_len; offset += kNodeSize) {
+            uint64_t locality = offset;
+            uint32_t len32 = static_cast<uint32_t>(kNodeSize);
+            ASSERT_OK(node.Init());
+            node.Update(&locality, sizeof(locality));
+            node.Update(&len32, sizeof(len32));
+            node.Update(gData + offset, kNodeSize);
+            node.Final();
+            ASSERT_TRUE(node == gTree + (offset / kNodeSize) * Digest::kLength,
+                        "leaf digest mismatch");
+        }
+    }
+    uint64_t per_node = zx_ticks_get() - start;
+
+    start = zx_ticks_get();
+    for (size_t n = 0; n < kIterations; ++n) {
+        ASSERT_OK(MerkleTree::Create(gData, data_len, gTree, tree_len, &digest));
+    }
+    uint64_t create = zx_ticks_get() - start;
+
+    start = zx_ticks_get();
+    for (size_t n = 0; n < kIterations; ++n) {
+        ASSERT_OK(MerkleTree::Verify(gData, data_len, gTree, tree_len, 0, data_len, digest));
+    }
+    uint64_t verify = zx_ticks_get() - start;
+
+    printf("\n%zu bytes: one node at a time %" PRIu64 " MB/s, Create %" PRIu64
+           " MB/s, Verify %" PRIu64 " MB/s\n", data_len,
+           Throughput(data_len, kIterations, per_node),
+           Throughput(data_len, kIterations, create),
+           Throughput(data_len, kIterations, verify));
+    END_TEST;
+}
+
 } // namespace
 
 BEGIN_TEST_CASE(MerkleTreeTests)
@@ -740,4 +800,5 @@ RUN_TEST(VerifyBadTree)
 RUN_TEST(VerifyGoodPartOfBadLeaves)
 RUN_TEST(VerifyBadLeaves)
 RUN_TEST(CreateAndVerifyHugePRNGData)
+RUN_TEST_PERFORMANCE(BenchmarkCreateAndVerify)
 END_TEST_CASE(MerkleTreeTests)
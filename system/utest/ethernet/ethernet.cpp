@@ -523,6 +523,94 @@ static bool EthernetSetPromiscClearOnCloseTest() {
     END_TEST;
 }
 
+static bool EthernetQueueFifosTest() {
+    BEGIN_TEST;
+    // Create the ethertap device
+    zx::socket sock;
+    ASSERT_EQ(ZX_OK, CreateEthertap(1500, __func__, &sock));
+
+    // Open the ethernet device
+    int devfd = -1;
+    ASSERT_EQ(ZX_OK, OpenEthertapDev(&devfd));
+    ASSERT_GE(devfd, 0);
+
+    // ethertap has a single queue pair
+    eth_info_t info;
+    ASSERT_GE(ioctl_ethernet_get_info(devfd, &info), 0);
+    EXPECT_EQ(1u, info.queue_count);
+
+    // Extra queues need queue 0 first
+    uint32_t queue = 1;
+    eth_fifos_t fifos;
+    EXPECT_EQ(ZX_ERR_OUT_OF_RANGE, ioctl_ethernet_get_queue_fifos(devfd, &queue, &fifos));
+
+    EthernetClient client(devfd);
+    ASSERT_EQ(ZX_OK, client.Register(__func__, 32, 2048));
+
+    // Queue 0 comes from GET_FIFOS, and there is no queue 1
+    queue = 0;
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, ioctl_ethernet_get_queue_fifos(devfd, &queue, &fifos));
+    queue = 1;
+    EXPECT_EQ(ZX_ERR_OUT_OF_RANGE, ioctl_ethernet_get_queue_fifos(devfd, &queue, &fifos));
+
+    EXPECT_EQ(ZX_OK, client.Start());
+    EXPECT_EQ(ZX_OK, client.Stop());
+
+    // Clean up the ethertap device
+    sock.reset();
+
+    ETHTEST_CLEANUP_DELAY;
+    END_TEST;
+}
+
+static bool EthernetOffloadsTest() {
+    BEGIN_TEST;
+    zx::socket sock;
+    ASSERT_EQ(ZX_OK, CreateEthertap(1500, __func__, &sock));
+
+    int devfd = -1;
+    ASSERT_EQ(ZX_OK, OpenEthertapDev(&devfd));
+    ASSERT_GE(devfd, 0);
+
+    // ethertap offers no offloads, so none can be enabled
+    eth_info_t info;
+    ASSERT_GE(ioctl_ethernet_get_info(devfd, &info), 0);
+    EXPECT_EQ(0u, info.features & ETH_FEATURE_OFFLOADS);
+
+    uint32_t offloads = ETH_FEATURE_TX_CSUM;
+    EXPECT_EQ(ZX_ERR_NOT_SUPPORTED, ioctl_ethernet_set_offloads(devfd, &offloads));
+    offloads = 0;
+    EXPECT_GE(ioctl_ethernet_set_offloads(devfd, &offloads), 0);
+
+    EthernetClient client(devfd);
+    ASSERT_EQ(ZX_OK, client.Register(__func__, 32, 2048));
+    ASSERT_EQ(ZX_OK, client.Start());
+
+    // A frame asking for an offload that is not enabled is rejected
+    auto entry = client.GetTxBuffer();
+    ASSERT_TRUE(entry != nullptr);
+    memset(entry->cookie, 0, 64);
+    entry->length = 64;
+    entry->flags = ETH_FIFO_TX_CSUM;
+    uint32_t actual = 0;
+    ASSERT_EQ(ZX_OK, client.tx_fifo()->write(entry, sizeof(eth_fifo_entry_t), &actual));
+    EXPECT_EQ(1u, actual);
+
+    zx_signals_t obs;
+    EXPECT_EQ(ZX_OK, client.tx_fifo()->wait_one(ZX_FIFO_READABLE, FAIL_TIMEOUT, &obs));
+    eth_fifo_entry_t return_entry;
+    ASSERT_EQ(ZX_OK, client.tx_fifo()->read(&return_entry, sizeof(eth_fifo_entry_t), &actual));
+    EXPECT_EQ(1u, actual);
+    EXPECT_EQ(ETH_FIFO_INVALID, return_entry.flags);
+    client.ReturnTxBuffer(&return_entry);
+
+    EXPECT_EQ(ZX_OK, client.Stop());
+    sock.reset();
+
+    ETHTEST_CLEANUP_DELAY;
+    END_TEST;
+}
+
 static bool EthernetDataTest_Send() {
     BEGIN_TEST;
     // Set up the tap device and the ethernet client
@@ -593,6 +681,14 @@ static bool EthernetDataTest_Send() {
     // pending at the end of te test.
     client.ReturnTxBuffer(&return_entry);
 
+    // The frame was counted as a batch of one
+    eth_tx_stats_t stats;
+    ASSERT_GE(ioctl_ethernet_get_tx_stats(devfd, &stats), 0);
+    EXPECT_EQ(1u, stats.frames);
+    EXPECT_EQ(1u, stats.batches);
+    EXPECT_EQ(1u, stats.max_batch);
+    EXPECT_EQ(1u, stats.batch_sizes[0]);
+
     // Shutdown the client and cleanup the tap device
     EXPECT_EQ(ZX_OK, client.Stop());
     sock.reset();
@@ -670,6 +766,8 @@ END_TEST_CASE(EthernetSetupTests)
 BEGIN_TEST_CASE(EthernetConfigTests)
 RUN_TEST_MEDIUM(EthernetSetPromiscMultiClientTest)
 RUN_TEST_MEDIUM(EthernetSetPromiscClearOnCloseTest)
+RUN_TEST_MEDIUM(EthernetQueueFifosTest)
+RUN_TEST_MEDIUM(EthernetOffloadsTest)
 END_TEST_CASE(EthernetConfigTests)
 
 BEGIN_TEST_CASE(EthernetDataTests)
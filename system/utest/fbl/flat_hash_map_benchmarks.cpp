@@ -0,0 +1,131 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <inttypes.h>
+
+#include <fbl/flat_hash_map.h>
+#include <fbl/intrusive_hash_table.h>
+#include <fbl/intrusive_single_list.h>
+#include <fbl/tests/lfsr.h>
+#include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
+#include <unittest/unittest.h>
+#include <zircon/syscalls.h>
+
+// Not pass/fail tests; these report the cost of lookups in FlatHashMap<> next
+// to an intrusive HashTable<> holding the same keys, for maps of various sizes.
+
+namespace fbl {
+namespace tests {
+namespace {
+
+static constexpr size_t kNumBuckets = 1024;
+static constexpr size_t kLookupPasses = 16;
+static constexpr uint64_t kHitSeed = 0xa2328b73e323fd0f;
+static constexpr uint64_t kMissSeed = 0x5d9c8e1f2a3b4c6d;
+
+struct HashedObject : public SinglyLinkedListable<unique_ptr<HashedObject>> {
+    explicit HashedObject(uint64_t key) : key_(key), value_(key) { }
+
+    uint64_t GetKey() const { return key_; }
+    static size_t GetHash(uint64_t key) { return ::fbl::internal::FlatHashMix(key); }
+
+    uint64_t key_;
+    uint64_t value_;
+};
+
+using IntrusiveTable = HashTable<uint64_t, unique_ptr<HashedObject>,
+                                 SinglyLinkedList<unique_ptr<HashedObject>>,
+                                 size_t, kNumBuckets>;
+using FlatMap = FlatHashMap<uint64_t, uint64_t>;
+
+zx_time_t ticks_to_ns(uint64_t ticks) {
+    return static_cast<zx_time_t>(static_cast<__uint128_t>(ticks) * ZX_SEC(1) /
+                                  zx_ticks_per_second());
+}
+
+// Looks up |count| keys from |seed|'s sequence, kLookupPasses times over.
+// Returns the average time per lookup.
+template <typename LookupFn>
+zx_time_t TimeLookups(uint64_t seed, size_t count, LookupFn lookup) {
+    Lfsr<uint64_t> lfsr(seed);
+    uint64_t ticks = zx_ticks_get();
+    for (size_t pass = 0; pass < kLookupPasses; ++pass) {
+        lfsr.SetCore(seed);
+        for (size_t i = 0; i < count; ++i)
+            lookup(lfsr.GetNext());
+    }
+    ticks = zx_ticks_get() - ticks;
+    return ticks_to_ns(ticks) / static_cast<zx_time_t>(count * kLookupPasses);
+}
+
+template <size_t count>
+bool flat_hash_map_benchmark() {
+    BEGIN_TEST;
+
+    IntrusiveTable table;
+    FlatMap map;
+    Lfsr<uint64_t> lfsr(kHitSeed);
+
+    uint64_t ticks = zx_ticks_get();
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t key = lfsr.GetNext();
+        AllocChecker ac;
+        unique_ptr<HashedObject> obj(new (&ac) HashedObject(key));
+        ASSERT_TRUE(ac.check());
+        table.insert(fbl::move(obj));
+    }
+    zx_time_t table_insert = ticks_to_ns(zx_ticks_get() - ticks) / count;
+
+    lfsr.SetCore(kHitSeed);
+    ticks = zx_ticks_get();
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t key = lfsr.GetNext();
+        AllocChecker ac;
+        map.insert(key, key, &ac);
+        ASSERT_TRUE(ac.check());
+    }
+    zx_time_t map_insert = ticks_to_ns(zx_ticks_get() - ticks) / count;
+
+    // Sum what is found, so the lookups can't be optimized away.
+    uint64_t table_sum = 0;
+    uint64_t map_sum = 0;
+    zx_time_t table_hit = TimeLookups(kHitSeed, count, [&](uint64_t key) {
+        auto iter = table.find(key);
+        table_sum += iter.IsValid() ? iter->value_ : 0;
+    });
+    zx_time_t map_hit = TimeLookups(kHitSeed, count, [&](uint64_t key) {
+        auto iter = map.find(key);
+        map_sum += iter.IsValid() ? iter->value : 0;
+    });
+    EXPECT_EQ(table_sum, map_sum);
+
+    zx_time_t table_miss = TimeLookups(kMissSeed, count, [&](uint64_t key) {
+        table_sum += table.find(key).IsValid();
+    });
+    zx_time_t map_miss = TimeLookups(kMissSeed, count, [&](uint64_t key) {
+        map_sum += map.find(key).IsValid();
+    });
+    EXPECT_EQ(table_sum, map_sum);
+
+    unittest_printf("\n%6zu keys (ns) insert/hit/miss: HashTable %" PRId64 "/%" PRId64 "/%" PRId64
+                    ", FlatHashMap %" PRId64 "/%" PRId64 "/%" PRId64 "\n",
+                    count, table_insert, table_hit, table_miss, map_insert, map_hit, map_miss);
+
+    table.clear();
+
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(flat_hash_map_benchmarks)
+RUN_TEST(flat_hash_map_benchmark<64>)
+RUN_TEST(flat_hash_map_benchmark<1024>)
+RUN_TEST(flat_hash_map_benchmark<16384>)
+RUN_TEST(flat_hash_map_benchmark<262144>)
+END_TEST_CASE(flat_hash_map_benchmarks)
+
+} // namespace tests
+} // namespace fbl
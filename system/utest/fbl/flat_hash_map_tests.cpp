@@ -0,0 +1,340 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include <fbl/flat_hash_map.h>
+#include <fbl/tests/lfsr.h>
+#include <fbl/unique_ptr.h>
+#include <unittest/unittest.h>
+
+namespace fbl {
+namespace tests {
+namespace {
+
+// Counts live objects, so tests can check that the map destroys exactly what
+// it constructs, including across rehashes.
+struct TestObject {
+    DISALLOW_COPY_AND_ASSIGN_ALLOW_MOVE(TestObject);
+    explicit TestObject(uint64_t val) : alive_(true), val_(val) { ++live_obj_count_; }
+    TestObject(TestObject&& r) : alive_(r.alive_), val_(r.val_) { r.alive_ = false; }
+    TestObject& operator=(TestObject&& r) {
+        if (alive_)
+            --live_obj_count_;
+        val_ = r.val_;
+        alive_ = r.alive_;
+        r.alive_ = false;
+        return *this;
+    }
+    ~TestObject() {
+        if (alive_)
+            --live_obj_count_;
+    }
+
+    bool alive_;
+    uint64_t val_;
+
+    static size_t live_obj_count_;
+};
+
+size_t TestObject::live_obj_count_ = 0;
+
+struct TestAllocatorTraits : public DefaultAllocatorTraits {
+    static void* Allocate(size_t size) {
+        if (fail_allocations)
+            return nullptr;
+        ++allocation_count;
+        void* result = DefaultAllocatorTraits::Allocate(size);
+        // Make sure nothing depends on the heap handing back zeroed memory.
+        if (result)
+            memset(result, 'f', size);
+        return result;
+    }
+
+    static bool fail_allocations;
+    static size_t allocation_count;
+};
+
+bool TestAllocatorTraits::fail_allocations = false;
+size_t TestAllocatorTraits::allocation_count = 0;
+
+// Sends every key to the same group, so lookups depend on the control byte
+// filtering and on probing past full groups.
+struct CollidingKeyTraits {
+    static uint64_t GetHash(const uint64_t& key) { return key & 0x7f; }
+    static bool EqualTo(const uint64_t& a, const uint64_t& b) { return a == b; }
+};
+
+using Map = FlatHashMap<uint64_t, uint64_t, DefaultFlatHashKeyTraits<uint64_t>,
+                        TestAllocatorTraits>;
+
+bool flat_hash_map_test_basic() {
+    BEGIN_TEST;
+
+    Map map;
+    EXPECT_TRUE(map.is_empty());
+    EXPECT_EQ(0u, map.capacity());
+    EXPECT_FALSE(map.find(1).IsValid());
+    EXPECT_FALSE(map.erase(1));
+
+    AllocChecker ac;
+    map.insert(1u, 100u, &ac);
+    ASSERT_TRUE(ac.check());
+    map.insert(2u, 200u, &ac);
+    ASSERT_TRUE(ac.check());
+    EXPECT_EQ(2u, map.size());
+
+    auto iter = map.find(1);
+    ASSERT_TRUE(iter.IsValid());
+    EXPECT_EQ(1u, iter->key);
+    EXPECT_EQ(100u, iter->value);
+    EXPECT_FALSE(map.find(3).IsValid());
+
+    // Inserting an existing key replaces its value.
+    map.insert(1u, 101u, &ac);
+    ASSERT_TRUE(ac.check());
+    EXPECT_EQ(2u, map.size());
+    EXPECT_EQ(101u, map.find(1)->value);
+
+    // Values may be changed in place.
+    map.find(2)->value = 201;
+    EXPECT_EQ(201u, map.find(2)->value);
+
+    EXPECT_TRUE(map.erase(1));
+    EXPECT_FALSE(map.erase(1));
+    EXPECT_FALSE(map.find(1).IsValid());
+    EXPECT_EQ(1u, map.size());
+
+    map.clear();
+    EXPECT_TRUE(map.is_empty());
+    EXPECT_NE(0u, map.capacity());
+    EXPECT_FALSE(map.find(2).IsValid());
+
+    map.reset();
+    EXPECT_EQ(0u, map.capacity());
+
+    END_TEST;
+}
+
+template <typename KeyTraits, size_t count>
+bool flat_hash_map_test_many() {
+    BEGIN_TEST;
+
+    FlatHashMap<uint64_t, uint64_t, KeyTraits, TestAllocatorTraits> map;
+    Lfsr<uint64_t> lfsr(0xa2328b73e323fd0f);
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t key = lfsr.GetNext();
+        AllocChecker ac;
+        map.insert(key, key ^ i, &ac);
+        ASSERT_TRUE(ac.check());
+        ASSERT_EQ(i + 1, map.size());
+    }
+
+    // Every key can be found, and iteration visits each entry once.
+    lfsr.SetCore(0xa2328b73e323fd0f);
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t key = lfsr.GetNext();
+        auto iter = map.find(key);
+        ASSERT_TRUE(iter.IsValid());
+        EXPECT_EQ(key ^ i, iter->value);
+    }
+    size_t visited = 0;
+    for (const auto& entry : map) {
+        EXPECT_TRUE(map.find(entry.key).IsValid());
+        ++visited;
+    }
+    EXPECT_EQ(count, visited);
+
+    // Erase every other key, then check that the rest are intact.
+    lfsr.SetCore(0xa2328b73e323fd0f);
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t key = lfsr.GetNext();
+        if (i & 1)
+            ASSERT_TRUE(map.erase(key));
+    }
+    EXPECT_EQ(count - count / 2, map.size());
+    lfsr.SetCore(0xa2328b73e323fd0f);
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t key = lfsr.GetNext();
+        EXPECT_EQ(!(i & 1), map.find(key).IsValid());
+    }
+
+    END_TEST;
+}
+
+bool flat_hash_map_test_churn() {
+    BEGIN_TEST;
+
+    // Inserting and erasing keys forever, with a bounded number live at once,
+    // must not grow the map forever; deleted slots get reclaimed.
+    static constexpr size_t kLive = 100;
+    Map map;
+    for (uint64_t key = 0; key < 100 * kLive; ++key) {
+        AllocChecker ac;
+        map.insert(key, key, &ac);
+        ASSERT_TRUE(ac.check());
+        if (key >= kLive) {
+            ASSERT_TRUE(map.erase(key - kLive));
+        }
+        ASSERT_LE(map.size(), kLive + 1);
+    }
+    EXPECT_LE(map.capacity(), 4 * kLive);
+
+    for (uint64_t key = 99 * kLive; key < 100 * kLive; ++key) {
+        EXPECT_TRUE(map.find(key).IsValid());
+    }
+
+    END_TEST;
+}
+
+bool flat_hash_map_test_objects() {
+    BEGIN_TEST;
+
+    ASSERT_EQ(0u, TestObject::live_obj_count_);
+    {
+        FlatHashMap<uint64_t, TestObject, DefaultFlatHashKeyTraits<uint64_t>,
+                    TestAllocatorTraits> map;
+        for (uint64_t i = 0; i < 1000; ++i) {
+            AllocChecker ac;
+            map.insert(i, TestObject(i), &ac);
+            ASSERT_TRUE(ac.check());
+            ASSERT_EQ(i + 1, TestObject::live_obj_count_);
+        }
+
+        // Replacing a value destroys the old one.
+        AllocChecker ac;
+        map.insert(7u, TestObject(70), &ac);
+        ASSERT_TRUE(ac.check());
+        EXPECT_EQ(1000u, TestObject::live_obj_count_);
+        EXPECT_EQ(70u, map.find(7)->value.val_);
+
+        for (uint64_t i = 0; i < 500; ++i) {
+            ASSERT_TRUE(map.erase(i));
+        }
+        EXPECT_EQ(500u, TestObject::live_obj_count_);
+
+        // Moving the map moves the entries, not copies of them.
+        auto other = fbl::move(map);
+        EXPECT_TRUE(map.is_empty());
+        EXPECT_EQ(500u, other.size());
+        EXPECT_EQ(500u, TestObject::live_obj_count_);
+    }
+    EXPECT_EQ(0u, TestObject::live_obj_count_);
+
+    // Move-only values work too.
+    {
+        FlatHashMap<uint32_t, unique_ptr<TestObject>> map;
+        for (uint32_t i = 0; i < 100; ++i) {
+            AllocChecker ac;
+            unique_ptr<TestObject> obj(new (&ac) TestObject(i));
+            ASSERT_TRUE(ac.check());
+            map.insert(i, fbl::move(obj), &ac);
+            ASSERT_TRUE(ac.check());
+        }
+        EXPECT_EQ(100u, TestObject::live_obj_count_);
+        EXPECT_EQ(42u, map.find(42)->value->val_);
+    }
+    EXPECT_EQ(0u, TestObject::live_obj_count_);
+
+    END_TEST;
+}
+
+bool flat_hash_map_test_reserve() {
+    BEGIN_TEST;
+
+    Map map;
+    AllocChecker ac;
+    map.reserve(1000, &ac);
+    ASSERT_TRUE(ac.check());
+    size_t capacity = map.capacity();
+    EXPECT_GE(capacity, 1000u);
+
+    // Filling up to the reservation doesn't allocate again.
+    size_t allocations = TestAllocatorTraits::allocation_count;
+    for (uint64_t i = 0; i < 1000; ++i) {
+        map.insert(i, i, &ac);
+        ASSERT_TRUE(ac.check());
+    }
+    EXPECT_EQ(allocations, TestAllocatorTraits::allocation_count);
+    EXPECT_EQ(capacity, map.capacity());
+
+    // Reserving less than we have is a no-op.
+    map.reserve(10, &ac);
+    ASSERT_TRUE(ac.check());
+    EXPECT_EQ(capacity, map.capacity());
+
+    END_TEST;
+}
+
+bool flat_hash_map_test_allocation_failure() {
+    BEGIN_TEST;
+
+    Map map;
+    AllocChecker ac;
+    TestAllocatorTraits::fail_allocations = true;
+    map.insert(1u, 1u, &ac);
+    EXPECT_FALSE(ac.check());
+    EXPECT_TRUE(map.is_empty());
+    TestAllocatorTraits::fail_allocations = false;
+
+    // Fill the map until the next insert has to grow it, then make that fail.
+    map.insert(1u, 1u, &ac);
+    ASSERT_TRUE(ac.check());
+    size_t capacity = map.capacity();
+    uint64_t key = 2;
+    for (; map.size() < capacity - capacity / 8; ++key) {
+        map.insert(key, key, &ac);
+        ASSERT_TRUE(ac.check());
+    }
+    ASSERT_EQ(capacity, map.capacity());
+
+    TestAllocatorTraits::fail_allocations = true;
+    size_t size = map.size();
+    map.insert(key, key, &ac);
+    EXPECT_FALSE(ac.check());
+    EXPECT_EQ(size, map.size());
+    EXPECT_FALSE(map.find(key).IsValid());
+
+    // Existing keys can still be updated without allocating.
+    map.insert(1u, 10u, &ac);
+    EXPECT_TRUE(ac.check());
+    EXPECT_EQ(10u, map.find(1)->value);
+    TestAllocatorTraits::fail_allocations = false;
+
+    for (uint64_t i = 2; i < key; ++i) {
+        EXPECT_TRUE(map.find(i).IsValid());
+    }
+
+    END_TEST;
+}
+
+bool flat_hash_map_test_no_alloc_check() {
+    BEGIN_TEST;
+
+    FlatHashMap<int, const char*> map;
+    map.reserve(4);
+    map.insert(1, "one");
+    map.insert(2, "two");
+    EXPECT_EQ(2u, map.size());
+    EXPECT_EQ(0, strcmp("two", map.find(2)->value));
+
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(flat_hash_map_tests)
+RUN_TEST(flat_hash_map_test_basic)
+RUN_TEST((flat_hash_map_test_many<DefaultFlatHashKeyTraits<uint64_t>, 10>))
+RUN_TEST((flat_hash_map_test_many<DefaultFlatHashKeyTraits<uint64_t>, 10000>))
+RUN_TEST((flat_hash_map_test_many<CollidingKeyTraits, 1000>))
+RUN_TEST(flat_hash_map_test_churn)
+RUN_TEST(flat_hash_map_test_objects)
+RUN_TEST(flat_hash_map_test_reserve)
+RUN_TEST(flat_hash_map_test_allocation_failure)
+RUN_TEST(flat_hash_map_test_no_alloc_check)
+END_TEST_CASE(flat_hash_map_tests)
+
+} // namespace tests
+} // namespace fbl
@@ -138,6 +138,9 @@ public:
     static void RecordEraseRotation()           { ++op_counts_.erase_rotations_; }
     static void RecordEraseDoubleRotation()     { ++op_counts_.erase_double_rotations_; }
 
+    template <typename Iter> static void RecordSubtreeChange(Iter node)          { }
+    template <typename Iter> static void RecordRotation(Iter child, Iter parent) { }
+
     template <typename TreeType>
     static bool VerifyRankRule(const TreeType& tree, typename TreeType::RawPtrType node) {
         BEGIN_TEST;
@@ -421,6 +424,128 @@ static bool WAVLBalanceTest() {
     END_TEST;
 }
 
+// An Observer which keeps the size of each node's subtree in the node, to
+// check that the augmentation hooks are called everywhere the shape of the
+// tree changes.
+class AugmentTestObj;
+
+using AugmentTestObjPtr = unique_ptr<AugmentTestObj>;
+
+struct SubtreeSizeObserver : public DefaultWAVLTreeObserver {
+    template <typename Iter>
+    static void Update(Iter node) {
+        node->subtree_size_ = 1 + (node.left().IsValid() ? node.left()->subtree_size_ : 0) +
+                              (node.right().IsValid() ? node.right()->subtree_size_ : 0);
+    }
+
+    template <typename Iter>
+    static void RecordSubtreeChange(Iter node) {
+        for (; node.IsValid(); node = node.parent())
+            Update(node);
+    }
+
+    template <typename Iter>
+    static void RecordRotation(Iter child, Iter parent) {
+        Update(child);
+        Update(parent);
+    }
+};
+
+using AugmentTestTree = WAVLTree<uint64_t,
+                                 AugmentTestObjPtr,
+                                 DefaultKeyedObjectTraits<uint64_t, AugmentTestObj>,
+                                 DefaultWAVLTreeTraits<AugmentTestObjPtr>,
+                                 SubtreeSizeObserver>;
+
+class AugmentTestObj {
+public:
+    uint64_t GetKey() const { return key_; }
+    bool InContainer() const { return wavl_node_state_.InContainer(); }
+
+    uint64_t key_ = 0;
+    size_t subtree_size_ = 0;
+
+private:
+    friend DefaultWAVLTreeTraits<AugmentTestObjPtr>;
+
+    static void operator delete(void* ptr) {
+        // Deliberate no-op
+    }
+    friend class fbl::unique_ptr<AugmentTestObj[]>;
+    friend class fbl::unique_ptr<AugmentTestObj>;
+
+    WAVLTreeNodeState<AugmentTestObjPtr> wavl_node_state_;
+};
+
+// Counts the nodes under |node|, checking each one's recorded subtree size.
+static size_t CountAugmentedSubtree(AugmentTestTree::iterator node, bool* ok) {
+    if (!node.IsValid())
+        return 0;
+    size_t count = 1 + CountAugmentedSubtree(node.left(), ok) +
+                   CountAugmentedSubtree(node.right(), ok);
+    if (node->subtree_size_ != count)
+        *ok = false;
+    if (node.left().IsValid() && node.left().parent() != node)
+        *ok = false;
+    if (node.right().IsValid() && node.right().parent() != node)
+        *ok = false;
+    return count;
+}
+
+static bool CheckAugmentedTree(AugmentTestTree& tree) {
+    BEGIN_TEST;
+    bool ok = true;
+    EXPECT_EQ(tree.size(), CountAugmentedSubtree(tree.root(), &ok));
+    EXPECT_TRUE(ok, "subtree sizes are out of date");
+    EXPECT_FALSE(tree.root().IsValid() && tree.root().parent().IsValid());
+    END_TEST;
+}
+
+static bool WAVLAugmentTest() {
+    BEGIN_TEST;
+
+    static constexpr size_t kCount = 512;
+    unique_ptr<AugmentTestObj[]> objects;
+    AugmentTestTree tree;
+    {
+        AllocChecker ac;
+        objects.reset(new (&ac) AugmentTestObj[kCount]);
+        ASSERT_TRUE(ac.check(), "Failed to allocate test objects!");
+    }
+
+    Lfsr<uint64_t> rng(0x5c3e1b2a97d04f61u);
+    for (size_t i = 0; i < kCount; ++i)
+        objects[i].key_ = rng.GetNext();
+
+    ASSERT_FALSE(tree.root().IsValid());
+    for (size_t i = 0; i < kCount; ++i) {
+        tree.insert(AugmentTestObjPtr(&objects[i]));
+        ASSERT_TRUE(CheckAugmentedTree(tree));
+    }
+
+    // erase every other node, by key and directly
+    for (size_t i = 0; i < kCount; i += 2) {
+        if (i & 2) tree.erase(objects[i].key_);
+        else       tree.erase(objects[i]);
+        ASSERT_TRUE(CheckAugmentedTree(tree));
+    }
+
+    // swap half of the survivors for objects with the same keys
+    for (size_t i = 1; i < kCount; i += 4) {
+        objects[i - 1].key_ = objects[i].key_;
+        AugmentTestObjPtr old = tree.insert_or_replace(AugmentTestObjPtr(&objects[i - 1]));
+        ASSERT_EQ(&objects[i], old.get());
+        ASSERT_TRUE(CheckAugmentedTree(tree));
+    }
+
+    while (!tree.is_empty()) {
+        tree.erase(tree.root());
+        ASSERT_TRUE(CheckAugmentedTree(tree));
+    }
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(wavl_tree_tests)
 //////////////////////////////////////////
 // General container specific tests.
@@ -544,6 +669,7 @@ RUN_NAMED_TEST("LowerBound (RefPtr)",            RPTE::LowerBoundTest)
 // WAVLTree specific tests.
 ////////////////////////////
 RUN_NAMED_TEST("BalanceTest", WAVLBalanceTest)
+RUN_NAMED_TEST("AugmentTest", WAVLAugmentTest)
 
 END_TEST_CASE(wavl_tree_tests);
 
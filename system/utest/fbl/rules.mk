@@ -13,6 +13,7 @@ fbl_common_tests := \
     $(LOCAL_DIR)/array_tests.cpp \
     $(LOCAL_DIR)/atomic_tests.cpp \
     $(LOCAL_DIR)/auto_call_tests.cpp \
+    $(LOCAL_DIR)/flat_hash_map_tests.cpp \
     $(LOCAL_DIR)/forward_tests.cpp \
     $(LOCAL_DIR)/function_tests.cpp \
     $(LOCAL_DIR)/initializer_list_tests.cpp \
@@ -49,6 +50,10 @@ fbl_device_tests += \
 fbl_device_tests += \
     $(LOCAL_DIR)/vmo_vmar_tests.cpp \
 
+# These report timings using zx_ticks_get().
+fbl_device_tests += \
+    $(LOCAL_DIR)/flat_hash_map_benchmarks.cpp \
+
 fbl_host_tests := $(fbl_common_tests)
 
 # Userspace tests.
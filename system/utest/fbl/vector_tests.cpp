@@ -825,6 +825,127 @@ bool vector_test_implicit_conversion() {
     END_TEST;
 }
 
+constexpr size_t kInlineCount = 8;
+
+template <typename ItemTraits>
+using TestInlineVector = fbl::InlineVector<typename ItemTraits::ItemType, kInlineCount,
+                                           CountedAllocatorTraits>;
+
+// Fills |vector| with the next |count| items from |gen|.
+template <typename ItemTraits>
+bool FillInlineVector(Generator<ItemTraits>* gen, TestInlineVector<ItemTraits>* vector,
+                      size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        fbl::AllocChecker ac;
+        vector->push_back(gen->NextItem(), &ac);
+        if (!ac.check()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Checks that |vector| holds exactly the next |count| items from |gen|.
+template <typename ItemTraits>
+bool CheckInlineVector(Generator<ItemTraits>* gen, const TestInlineVector<ItemTraits>& vector,
+                       size_t count) {
+    if (vector.size() != count) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (ItemTraits::GetValue(vector[i]) != gen->NextValue()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename ItemTraits, size_t size>
+bool inline_vector_test_push_pop() {
+    BEGIN_TEST;
+
+    Generator<ItemTraits> gen;
+
+    CountedAllocatorTraits::allocation_count = 0;
+    ASSERT_TRUE(ItemTraits::CheckLiveCount(0));
+    ASSERT_TRUE(ItemTraits::CheckCtorDtorCount());
+    {
+        TestInlineVector<ItemTraits> vector;
+        ASSERT_EQ(vector.capacity(), kInlineCount);
+
+        // Nothing is allocated until the inline storage is full.
+        ASSERT_TRUE(FillInlineVector(&gen, &vector, size));
+        ASSERT_TRUE(ItemTraits::CheckLiveCount(size));
+        ASSERT_EQ(CountedAllocatorTraits::allocation_count == 0, size <= kInlineCount);
+        gen.Reset();
+        ASSERT_TRUE(CheckInlineVector(&gen, vector, size));
+
+        // Shrinking far enough moves the elements back inline; 100 elements
+        // go from a capacity of 128 to 32, and then to the inline 8.
+        while (vector.size() > 1) {
+            vector.pop_back();
+            ASSERT_TRUE(ItemTraits::CheckLiveCount(vector.size()));
+        }
+        if (size == 100) {
+            ASSERT_EQ(vector.capacity(), kInlineCount);
+        }
+        gen.Reset();
+        ASSERT_TRUE(CheckInlineVector(&gen, vector, 1));
+
+        vector.reset();
+        ASSERT_TRUE(ItemTraits::CheckLiveCount(0));
+        ASSERT_EQ(vector.capacity(), kInlineCount);
+    }
+    ASSERT_TRUE(ItemTraits::CheckLiveCount(0));
+    ASSERT_TRUE(ItemTraits::CheckCtorDtorCount());
+
+    END_TEST;
+}
+
+// Moves and swaps between a vector of |size| elements and one of
+// |other_size|, so that every mix of inline and heap storage is covered.
+template <typename ItemTraits, size_t size, size_t other_size>
+bool inline_vector_test_move_swap() {
+    BEGIN_TEST;
+
+    Generator<ItemTraits> gen;
+
+    ASSERT_TRUE(ItemTraits::CheckLiveCount(0));
+    ASSERT_TRUE(ItemTraits::CheckCtorDtorCount());
+    {
+        TestInlineVector<ItemTraits> vectorA;
+        ASSERT_TRUE(FillInlineVector(&gen, &vectorA, size));
+        TestInlineVector<ItemTraits> vectorB(fbl::move(vectorA));
+        ASSERT_TRUE(vectorA.is_empty());
+        ASSERT_EQ(vectorA.capacity(), kInlineCount);
+        ASSERT_TRUE(ItemTraits::CheckLiveCount(size));
+        gen.Reset();
+        ASSERT_TRUE(CheckInlineVector(&gen, vectorB, size));
+
+        // vectorA is usable again after being moved from.
+        TestInlineVector<ItemTraits> vectorC;
+        ASSERT_TRUE(FillInlineVector(&gen, &vectorA, other_size));
+        ASSERT_TRUE(ItemTraits::CheckLiveCount(size + other_size));
+        vectorB.swap(vectorA);
+        ASSERT_TRUE(ItemTraits::CheckLiveCount(size + other_size));
+        gen.Reset();
+        ASSERT_TRUE(CheckInlineVector(&gen, vectorA, size));
+        ASSERT_TRUE(CheckInlineVector(&gen, vectorB, other_size));
+
+        vectorC = fbl::move(vectorA);
+        ASSERT_TRUE(vectorA.is_empty());
+        vectorB = fbl::move(vectorC);
+        ASSERT_TRUE(vectorC.is_empty());
+        ASSERT_TRUE(ItemTraits::CheckLiveCount(size));
+        gen.Reset();
+        ASSERT_TRUE(CheckInlineVector(&gen, vectorB, size));
+    }
+    ASSERT_TRUE(ItemTraits::CheckLiveCount(0));
+    ASSERT_TRUE(ItemTraits::CheckCtorDtorCount());
+
+    END_TEST;
+}
+
 } // namespace
 
 #define RUN_FOR_ALL_TRAITS(test_base, test_size)       \
@@ -841,6 +962,19 @@ bool vector_test_implicit_conversion() {
     RUN_FOR_ALL_TRAITS(test_base, 64) \
     RUN_FOR_ALL_TRAITS(test_base, 100)
 
+#define RUN_FOR_ALL_TRAITS_PAIR(test_base, size_a, size_b)    \
+    RUN_TEST((test_base<ValueTypeTraits, size_a, size_b>))  \
+    RUN_TEST((test_base<StructTypeTraits, size_a, size_b>)) \
+    RUN_TEST((test_base<UniquePtrTraits, size_a, size_b>))  \
+    RUN_TEST((test_base<RefPtrTraits, size_a, size_b>))
+
+// Sizes on either side of the inline capacity.
+#define RUN_FOR_ALL_SIZE_PAIRS(test_base)      \
+    RUN_FOR_ALL_TRAITS_PAIR(test_base, 3, 5)  \
+    RUN_FOR_ALL_TRAITS_PAIR(test_base, 3, 20) \
+    RUN_FOR_ALL_TRAITS_PAIR(test_base, 20, 3) \
+    RUN_FOR_ALL_TRAITS_PAIR(test_base, 20, 40)
+
 BEGIN_TEST_CASE(vector_tests)
 RUN_FOR_ALL(vector_test_access_release)
 RUN_FOR_ALL(vector_test_push_back_in_capacity)
@@ -857,6 +991,8 @@ RUN_FOR_ALL(vector_test_no_alloc_check)
 RUN_TEST(vector_test_initializer_list<ValueTypeTraits>)
 RUN_TEST(vector_test_initializer_list<RefPtrTraits>)
 RUN_TEST(vector_test_implicit_conversion)
+RUN_FOR_ALL(inline_vector_test_push_pop)
+RUN_FOR_ALL_SIZE_PAIRS(inline_vector_test_move_swap)
 END_TEST_CASE(vector_tests)
 
 } // namespace tests
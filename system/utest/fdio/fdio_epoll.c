@@ -0,0 +1,148 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <stdbool.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <zircon/syscalls.h>
+#include <fdio/io.h>
+#include <unittest/unittest.h>
+
+bool epoll_level_triggered_test(void) {
+    BEGIN_TEST;
+
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0, "pipe() failed");
+    int epfd = epoll_create1(0);
+    ASSERT_GE(epfd, 0, "epoll_create1() failed");
+
+    struct epoll_event ev = {.events = EPOLLIN, .data.u64 = 42};
+    ASSERT_EQ(epoll_ctl(epfd, EPOLL_CTL_ADD, fds[0], &ev), 0, "");
+
+    struct epoll_event out[4];
+    EXPECT_EQ(epoll_wait(epfd, out, 4, 0), 0, "empty pipe should not be ready");
+
+    char c = 'x';
+    ASSERT_EQ(write(fds[1], &c, 1), 1, "");
+
+    // Reported for as long as the pipe has data, not only when it arrives.
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(epoll_wait(epfd, out, 4, 1000), 1, "");
+        EXPECT_EQ(out[0].events, (uint32_t)EPOLLIN, "");
+        EXPECT_EQ(out[0].data.u64, 42u, "");
+    }
+
+    ASSERT_EQ(read(fds[0], &c, 1), 1, "");
+    EXPECT_EQ(epoll_wait(epfd, out, 4, 0), 0, "drained pipe should not be ready");
+
+    close(epfd);
+    close(fds[0]);
+    close(fds[1]);
+    END_TEST;
+}
+
+bool epoll_edge_triggered_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t event;
+    ASSERT_EQ(zx_event_create(0u, &event), ZX_OK, "");
+    int fd = fdio_handle_fd(event, ZX_USER_SIGNAL_0, ZX_USER_SIGNAL_1, true);
+    ASSERT_GE(fd, 0, "fdio_handle_fd() failed");
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    ASSERT_GE(epfd, 0, "epoll_create1() failed");
+
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLET, .data.fd = fd};
+    ASSERT_EQ(epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev), 0, "");
+
+    ASSERT_EQ(zx_object_signal(event, 0u, ZX_USER_SIGNAL_0), ZX_OK, "");
+    struct epoll_event out[4];
+    ASSERT_EQ(epoll_wait(epfd, out, 4, 1000), 1, "");
+    EXPECT_EQ(out[0].data.fd, fd, "");
+
+    // Still readable, but nothing has changed since.
+    EXPECT_EQ(epoll_wait(epfd, out, 4, 0), 0, "");
+
+    ASSERT_EQ(zx_object_signal(event, ZX_USER_SIGNAL_0, 0u), ZX_OK, "");
+    ASSERT_EQ(zx_object_signal(event, 0u, ZX_USER_SIGNAL_0), ZX_OK, "");
+    EXPECT_EQ(epoll_wait(epfd, out, 4, 1000), 1, "");
+
+    close(epfd);
+    close(fd);
+    zx_handle_close(event);
+    END_TEST;
+}
+
+bool epoll_oneshot_test(void) {
+    BEGIN_TEST;
+
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0, "pipe() failed");
+    int epfd = epoll_create(1);
+    ASSERT_GE(epfd, 0, "epoll_create() failed");
+
+    struct epoll_event ev = {.events = EPOLLOUT | EPOLLONESHOT};
+    ASSERT_EQ(epoll_ctl(epfd, EPOLL_CTL_ADD, fds[1], &ev), 0, "");
+
+    struct epoll_event out[4];
+    ASSERT_EQ(epoll_wait(epfd, out, 4, 1000), 1, "");
+    EXPECT_EQ(out[0].events, (uint32_t)EPOLLOUT, "");
+    EXPECT_EQ(epoll_wait(epfd, out, 4, 0), 0, "disabled until modified");
+
+    ASSERT_EQ(epoll_ctl(epfd, EPOLL_CTL_MOD, fds[1], &ev), 0, "");
+    EXPECT_EQ(epoll_wait(epfd, out, 4, 1000), 1, "");
+
+    close(epfd);
+    close(fds[0]);
+    close(fds[1]);
+    END_TEST;
+}
+
+bool epoll_ctl_errors_test(void) {
+    BEGIN_TEST;
+
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0, "pipe() failed");
+    int epfd = epoll_create1(0);
+    ASSERT_GE(epfd, 0, "epoll_create1() failed");
+    struct epoll_event ev = {.events = EPOLLIN};
+
+    EXPECT_EQ(epoll_ctl(epfd, EPOLL_CTL_MOD, fds[0], &ev), -1, "");
+    EXPECT_EQ(errno, ENOENT, "");
+    EXPECT_EQ(epoll_ctl(epfd, EPOLL_CTL_ADD, fds[0], &ev), 0, "");
+    EXPECT_EQ(epoll_ctl(epfd, EPOLL_CTL_ADD, fds[0], &ev), -1, "");
+    EXPECT_EQ(errno, EEXIST, "");
+    EXPECT_EQ(epoll_ctl(epfd, EPOLL_CTL_ADD, epfd, &ev), -1, "");
+    EXPECT_EQ(errno, EINVAL, "");
+    EXPECT_EQ(epoll_ctl(fds[0], EPOLL_CTL_ADD, fds[1], &ev), -1, "");
+    EXPECT_EQ(errno, EINVAL, "not an epoll fd");
+    EXPECT_EQ(epoll_ctl(epfd, EPOLL_CTL_DEL, fds[0], NULL), 0, "");
+    EXPECT_EQ(epoll_ctl(epfd, EPOLL_CTL_DEL, fds[0], NULL), -1, "");
+    EXPECT_EQ(errno, ENOENT, "");
+
+    // Closing an fd forgets it, so its number can be added again.
+    EXPECT_EQ(epoll_ctl(epfd, EPOLL_CTL_ADD, fds[0], &ev), 0, "");
+    close(fds[0]);
+    int again[2];
+    ASSERT_EQ(pipe(again), 0, "pipe() failed");
+    EXPECT_EQ(epoll_ctl(epfd, EPOLL_CTL_ADD, again[0], &ev), 0, "");
+
+    struct epoll_event out[1];
+    EXPECT_EQ(epoll_wait(epfd, out, 0, 0), -1, "");
+    EXPECT_EQ(errno, EINVAL, "");
+
+    close(epfd);
+    close(fds[1]);
+    close(again[0]);
+    close(again[1]);
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(fdio_epoll_test)
+RUN_TEST(epoll_level_triggered_test);
+RUN_TEST(epoll_edge_triggered_test);
+RUN_TEST(epoll_oneshot_test);
+RUN_TEST(epoll_ctl_errors_test);
+END_TEST_CASE(fdio_epoll_test)
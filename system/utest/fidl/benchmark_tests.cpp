@@ -0,0 +1,88 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <inttypes.h>
+#include <string.h>
+
+#include <fidl/coding.h>
+#include <zircon/syscalls.h>
+
+#include <unittest/unittest.h>
+
+#include "fidl_coded_types.h"
+#include "fidl_structs.h"
+
+namespace fidl {
+namespace {
+
+constexpr uint32_t kIterations = 100000u;
+
+// Reports the average time taken to encode and then decode a message of the
+// given type. Nothing is asserted beyond success; this is here to catch
+// regressions by eye.
+template <typename Layout>
+bool RunBenchmark(const char* name, const fidl_type_t* type, Layout* message,
+                  void (*fill)(Layout*)) {
+    zx_handle_t handles[4] = {};
+
+    zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+    for (uint32_t i = 0; i < kIterations; i++) {
+        fill(message);
+        const char* error = nullptr;
+        uint32_t actual_handles = 0u;
+        zx_status_t status = fidl_encode(type, message, sizeof(*message), handles,
+                                         static_cast<uint32_t>(countof(handles)),
+                                         &actual_handles, &error);
+        ASSERT_EQ(status, ZX_OK, error);
+        status = fidl_decode(type, message, sizeof(*message), handles, actual_handles, &error);
+        ASSERT_EQ(status, ZX_OK, error);
+    }
+    zx_time_t elapsed = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+
+    unittest_printf_critical("\n    %-14s %" PRIu64 "ns per encode and decode",
+                             name, elapsed / kIterations);
+    return true;
+}
+
+void FillFixedLayout(fixed_layout_message_layout* message) {
+    message->inline_struct.data_0 = 1u;
+    message->inline_struct.data_1 = 2u;
+    message->inline_struct.data_2 = 3u;
+}
+
+void FillHandle(nonnullable_handle_message_layout* message) {
+    message->inline_struct.handle = static_cast<zx_handle_t>(23);
+}
+
+void FillString(unbounded_nonnullable_string_message_layout* message) {
+    message->inline_struct.string = fidl_string_t{6, &message->data[0]};
+    memcpy(message->data, "hello!", 6);
+}
+
+bool coding_speed_test() {
+    BEGIN_TEST;
+
+    fixed_layout_message_layout fixed = {};
+    EXPECT_TRUE(RunBenchmark("fixed layout", &fixed_layout_message_type, &fixed,
+                             FillFixedLayout));
+
+    nonnullable_handle_message_layout handle = {};
+    EXPECT_TRUE(RunBenchmark("one handle", &nonnullable_handle_message_type, &handle,
+                             FillHandle));
+
+    unbounded_nonnullable_string_message_layout string = {};
+    EXPECT_TRUE(RunBenchmark("one string", &unbounded_nonnullable_string_message_type, &string,
+                             FillString));
+
+    unittest_printf_critical("\n");
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(benchmarks)
+RUN_TEST(coding_speed_test)
+END_TEST_CASE(benchmarks)
+
+} // namespace
+} // namespace fidl
@@ -136,6 +136,42 @@ bool decode_null_decode_parameters() {
     END_TEST;
 }
 
+bool decode_fixed_layout_message() {
+    BEGIN_TEST;
+
+    fixed_layout_message_layout message = {};
+    message.inline_struct.data_0 = 1u;
+    message.inline_struct.data_1 = 2u;
+    message.inline_struct.data_2 = 3u;
+
+    const char* error = nullptr;
+    auto status = fidl_decode(&fixed_layout_message_type, &message, sizeof(message), nullptr, 0u,
+                              &error);
+
+    EXPECT_EQ(status, ZX_OK);
+    EXPECT_NULL(error, error);
+    EXPECT_EQ(message.inline_struct.data_0, 1u);
+    EXPECT_EQ(message.inline_struct.data_1, 2u);
+    EXPECT_EQ(message.inline_struct.data_2, 3u);
+
+    END_TEST;
+}
+
+bool decode_fixed_layout_message_wrong_size_error() {
+    BEGIN_TEST;
+
+    fixed_layout_message_layout message = {};
+
+    const char* error = nullptr;
+    auto status = fidl_decode(&fixed_layout_message_type, &message, sizeof(message) - 8u, nullptr,
+                              0u, &error);
+
+    EXPECT_NE(status, ZX_OK);
+    EXPECT_NONNULL(error);
+
+    END_TEST;
+}
+
 bool decode_single_present_handle() {
     BEGIN_TEST;
 
@@ -1438,6 +1474,11 @@ BEGIN_TEST_CASE(null_parameters)
 RUN_TEST(decode_null_decode_parameters)
 END_TEST_CASE(null_parameters)
 
+BEGIN_TEST_CASE(fixed_layout)
+RUN_TEST(decode_fixed_layout_message)
+RUN_TEST(decode_fixed_layout_message_wrong_size_error)
+END_TEST_CASE(fixed_layout)
+
 BEGIN_TEST_CASE(handles)
 RUN_TEST(decode_single_present_handle)
 RUN_TEST(decode_multiple_present_handles)
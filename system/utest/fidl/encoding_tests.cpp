@@ -156,6 +156,50 @@ bool encode_null_encode_parameters() {
     END_TEST;
 }
 
+bool encode_fixed_layout_message() {
+    BEGIN_TEST;
+
+    fixed_layout_message_layout message = {};
+    message.inline_struct.data_0 = 1u;
+    message.inline_struct.data_1 = 2u;
+    message.inline_struct.data_2 = 3u;
+
+    zx_handle_t handles[1] = {};
+
+    const char* error = nullptr;
+    uint32_t actual_handles = 42u;
+    auto status = fidl_encode(&fixed_layout_message_type, &message, sizeof(message), handles,
+                              ArrayCount(handles), &actual_handles, &error);
+
+    EXPECT_EQ(status, ZX_OK);
+    EXPECT_NULL(error, error);
+    EXPECT_EQ(actual_handles, 0u);
+    EXPECT_EQ(message.inline_struct.data_0, 1u);
+    EXPECT_EQ(message.inline_struct.data_1, 2u);
+    EXPECT_EQ(message.inline_struct.data_2, 3u);
+
+    END_TEST;
+}
+
+bool encode_fixed_layout_message_wrong_size_error() {
+    BEGIN_TEST;
+
+    struct {
+        fixed_layout_message_layout message;
+        uint64_t trailing;
+    } buffer = {};
+
+    const char* error = nullptr;
+    uint32_t actual_handles = 0u;
+    auto status = fidl_encode(&fixed_layout_message_type, &buffer, sizeof(buffer), nullptr, 0u,
+                              &actual_handles, &error);
+
+    EXPECT_NE(status, ZX_OK);
+    EXPECT_NONNULL(error);
+
+    END_TEST;
+}
+
 bool encode_single_present_handle() {
     BEGIN_TEST;
 
@@ -1446,6 +1490,11 @@ BEGIN_TEST_CASE(null_parameters)
 RUN_TEST(encode_null_encode_parameters)
 END_TEST_CASE(null_parameters)
 
+BEGIN_TEST_CASE(fixed_layout)
+RUN_TEST(encode_fixed_layout_message)
+RUN_TEST(encode_fixed_layout_message_wrong_size_error)
+END_TEST_CASE(fixed_layout)
+
 BEGIN_TEST_CASE(handles)
 RUN_TEST(encode_single_present_handle)
 RUN_TEST(encode_multiple_present_handles)
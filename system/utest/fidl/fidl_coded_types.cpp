@@ -76,6 +76,10 @@ static const fidl_type_t bounded_2_nullable_vector_of_handles = fidl_type_t(
 
 } // namespace
 
+// Fixed layout messages.
+const fidl_type_t fixed_layout_message_type = fidl_type_t(fidl::FidlCodedStruct(
+    nullptr, 0u, sizeof(fixed_layout_inline_data)));
+
 // Handle messages.
 static const fidl::FidlField nonnullable_handle_message_fields[] = {
     fidl::FidlField(&nonnullable_handle,
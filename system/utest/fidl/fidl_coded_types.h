@@ -10,6 +10,8 @@
 extern "C" {
 #endif
 
+extern const fidl_type_t fixed_layout_message_type;
+
 extern const fidl_type_t nonnullable_handle_message_type;
 extern const fidl_type_t multiple_nonnullable_handles_message_type;
 extern const fidl_type_t nullable_handle_message_type;
@@ -8,6 +8,17 @@
 
 #include <fidl/coding.h>
 
+// Fixed layout types.
+struct fixed_layout_inline_data {
+    fidl_message_header_t header;
+    uint32_t data_0;
+    uint32_t data_1;
+    uint64_t data_2;
+};
+struct fixed_layout_message_layout {
+    fixed_layout_inline_data inline_struct;
+};
+
 // Handle types.
 struct nonnullable_handle_inline_data {
     fidl_message_header_t header;
@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include <fidl/cpp/builder.h>
+#include <fidl/cpp/message_buffer.h>
 #include <fidl/cpp/message_builder.h>
 #include <fidl/cpp/message.h>
 #include <fidl/cpp/string_view.h>
@@ -12,6 +13,7 @@
 #include <unittest/unittest.h>
 
 #include "fidl_coded_types.h"
+#include "fidl_structs.h"
 
 namespace {
 
@@ -90,9 +92,67 @@ bool message_builder_test() {
     END_TEST;
 }
 
+bool message_builder_reset_test() {
+    BEGIN_TEST;
+
+    fidl::MessageBuilder builder(&nonnullable_handle_message_type);
+    fidl_message_header_t* header = builder.header();
+    zx_handle_t* handle = builder.New<zx_handle_t>();
+
+    // The next message is built in the same memory as the first.
+    builder.Reset();
+    EXPECT_EQ(builder.header(), header);
+    EXPECT_EQ(builder.New<zx_handle_t>(), handle);
+
+    END_TEST;
+}
+
+bool message_buffer_test() {
+    BEGIN_TEST;
+
+    fidl::MessageBuffer outgoing;
+    fidl::Builder builder = outgoing.CreateBuilder();
+
+    fidl_message_header_t* header = builder.New<fidl_message_header_t>();
+    header->txid = 5u;
+    header->ordinal = 42u;
+
+    fidl::StringView* view = builder.New<fidl::StringView>();
+    char* data = builder.NewArray<char>(5);
+    memcpy(data, "hello", 5);
+    view->set_data(data);
+    view->set_size(5);
+
+    fidl::Message message(builder.Finalize(),
+        fidl::HandlePart(outgoing.handles(), outgoing.handle_capacity()));
+    const char* error_msg = nullptr;
+    EXPECT_EQ(ZX_OK, message.Encode(&unbounded_nonnullable_string_message_type, &error_msg));
+
+    zx::channel h1, h2;
+    EXPECT_EQ(zx::channel::create(0, &h1, &h2), ZX_OK);
+    EXPECT_EQ(ZX_OK, message.Write(h1.get(), 0u));
+
+    fidl::MessageBuffer incoming;
+    fidl::Message received = incoming.CreateEmptyMessage();
+    EXPECT_EQ(ZX_OK, received.Read(h2.get(), 0u));
+    EXPECT_EQ(ZX_OK, received.Decode(&unbounded_nonnullable_string_message_type, &error_msg));
+    EXPECT_EQ(received.ordinal(), 42u);
+
+    // The decoded string is a view into the buffer the message was read into.
+    fidl::StringView* decoded = received.GetPayloadAs<fidl::StringView>();
+    EXPECT_EQ(decoded->size(), 5u);
+    EXPECT_EQ(decoded->data(), reinterpret_cast<char*>(incoming.bytes()) +
+                               sizeof(unbounded_nonnullable_string_inline_data));
+    EXPECT_EQ(memcmp(decoded->data(), "hello", 5), 0);
+
+    END_TEST;
+}
+
 }  // namespace
 
 BEGIN_TEST_CASE(message_tests)
 RUN_NAMED_TEST("Message test", message_test)
 RUN_NAMED_TEST("MessageBuilder test", message_builder_test)
+RUN_NAMED_TEST("MessageBuilder reset test", message_builder_reset_test)
+RUN_NAMED_TEST("MessageBuffer test", message_buffer_test)
 END_TEST_CASE(message_tests);
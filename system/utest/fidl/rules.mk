@@ -10,6 +10,7 @@ MODULE_TYPE := usertest
 
 MODULE_SRCS += \
     $(LOCAL_DIR)/abi_tests.cpp \
+    $(LOCAL_DIR)/benchmark_tests.cpp \
     $(LOCAL_DIR)/cpp_types_tests.cpp \
     $(LOCAL_DIR)/decoding_tests.cpp \
     $(LOCAL_DIR)/encoding_tests.cpp \
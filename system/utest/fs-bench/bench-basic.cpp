@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
@@ -11,8 +12,10 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <threads.h>
 #include <unistd.h>
 
+#include <fdio/io.h>
 #include <zircon/device/vfs.h>
 #include <zircon/syscalls.h>
 #include <fbl/alloc_checker.h>
@@ -202,6 +205,142 @@ bool benchmark_path_walk(void) {
     END_TEST;
 }
 
+constexpr size_t kConcurrentFileSize = 4 * MB;
+constexpr size_t kConcurrentReadSize = 16 * KB;
+constexpr int kConcurrentReadPasses = 8;
+
+int concurrent_read_thread(void* arg) {
+    int fd = *reinterpret_cast<int*>(arg);
+    uint8_t data[kConcurrentReadSize];
+    for (int pass = 0; pass < kConcurrentReadPasses; pass++) {
+        for (size_t off = 0; off < kConcurrentFileSize; off += sizeof(data)) {
+            if (pread(fd, data, sizeof(data), off) != static_cast<ssize_t>(sizeof(data)) ||
+                data[0] != kMagicByte) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+// The goal of this benchmark is to see how well reads of separate files on
+// separate connections scale as readers are added. Filesystems which dispatch
+// reads from several threads at once should take about as long for every
+// reader count, up to the number of dispatch threads; filesystems which
+// serialize requests take time proportional to the number of readers.
+template <size_t NumReaders>
+bool benchmark_concurrent_read(void) {
+    BEGIN_TEST;
+    printf("\nBenchmarking Concurrent Read (%lu readers, %lu MB each)\n", NumReaders,
+           kConcurrentReadPasses * kConcurrentFileSize / MB);
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> data(new (&ac) uint8_t[kConcurrentFileSize]);
+    ASSERT_EQ(ac.check(), true);
+    memset(data.get(), kMagicByte, kConcurrentFileSize);
+
+    int fds[NumReaders];
+    char path[PATH_MAX];
+    for (size_t i = 0; i < NumReaders; i++) {
+        snprintf(path, sizeof(path), MOUNT_POINT "/concurrent-%lu", i);
+        fds[i] = open(path, O_CREAT | O_RDWR, 0644);
+        ASSERT_GT(fds[i], 0, "Cannot create file");
+        ASSERT_EQ(write(fds[i], data.get(), kConcurrentFileSize), kConcurrentFileSize);
+    }
+    ASSERT_EQ(syncfs(fds[0]), 0);
+
+    thrd_t threads[NumReaders];
+    uint64_t start = zx_ticks_get();
+    for (size_t i = 0; i < NumReaders; i++) {
+        ASSERT_EQ(thrd_create(&threads[i], concurrent_read_thread, &fds[i]), thrd_success);
+    }
+    for (size_t i = 0; i < NumReaders; i++) {
+        int result;
+        ASSERT_EQ(thrd_join(threads[i], &result), thrd_success);
+        ASSERT_EQ(result, 0, "Reader failed");
+    }
+    time_end("read", start);
+
+    for (size_t i = 0; i < NumReaders; i++) {
+        ASSERT_EQ(close(fds[i]), 0);
+        snprintf(path, sizeof(path), MOUNT_POINT "/concurrent-%lu", i);
+        ASSERT_EQ(unlink(path), 0);
+    }
+
+    END_TEST;
+}
+
+// The goal of this benchmark is to compare stat()ing every entry of a
+// directory one at a time, as a naive "ls -l" would, with stat()ing them in
+// batches which keep many requests in flight at once, and with reading them
+// together with the entries.
+template <size_t NumFiles>
+bool benchmark_stat_entries(void) {
+    BEGIN_TEST;
+    printf("\nBenchmarking Directory Stat (%lu entries)\n", NumFiles);
+    ASSERT_EQ(mkdir(MOUNT_POINT "/stat", 0666), 0);
+
+    char path[PATH_MAX];
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<char[][NAME_MAX + 1]> names(new (&ac) char[NumFiles][NAME_MAX + 1]);
+    ASSERT_EQ(ac.check(), true);
+    for (size_t i = 0; i < NumFiles; i++) {
+        snprintf(names[i], NAME_MAX + 1, "file-%lu", i);
+        snprintf(path, sizeof(path), MOUNT_POINT "/stat/%s", names[i]);
+        int fd = open(path, O_CREAT | O_RDWR, 0644);
+        ASSERT_GT(fd, 0);
+        ASSERT_EQ(close(fd), 0);
+    }
+
+    int dirfd = open(MOUNT_POINT "/stat", O_DIRECTORY | O_RDONLY);
+    ASSERT_GE(dirfd, 0);
+
+    uint64_t start = zx_ticks_get();
+    for (size_t i = 0; i < NumFiles; i++) {
+        struct stat s;
+        ASSERT_EQ(fstatat(dirfd, names[i], &s, 0), 0);
+    }
+    time_end("fstatat", start);
+
+    fbl::unique_ptr<const char*[]> ptrs(new (&ac) const char*[NumFiles]);
+    ASSERT_EQ(ac.check(), true);
+    fbl::unique_ptr<struct stat[]> stats(new (&ac) struct stat[NumFiles]);
+    ASSERT_EQ(ac.check(), true);
+    fbl::unique_ptr<zx_status_t[]> statuses(new (&ac) zx_status_t[NumFiles]);
+    ASSERT_EQ(ac.check(), true);
+    for (size_t i = 0; i < NumFiles; i++) {
+        ptrs[i] = names[i];
+    }
+    start = zx_ticks_get();
+    ASSERT_EQ(fdio_stat_entries(dirfd, ptrs.get(), NumFiles, stats.get(), statuses.get()),
+              ZX_OK);
+    time_end("fdio_stat_entries", start);
+    for (size_t i = 0; i < NumFiles; i++) {
+        ASSERT_EQ(statuses[i], ZX_OK);
+        ASSERT_TRUE(S_ISREG(stats[i].st_mode));
+    }
+
+    DIR* dir = opendir(MOUNT_POINT "/stat");
+    ASSERT_NONNULL(dir);
+    size_t count = 0;
+    struct dirent* de;
+    struct stat s;
+    start = zx_ticks_get();
+    while ((de = fdio_readdir_stat(dir, &s)) != NULL) {
+        count++;
+    }
+    time_end("fdio_readdir_stat", start);
+    ASSERT_GE(count, NumFiles);
+    ASSERT_EQ(closedir(dir), 0);
+
+    for (size_t i = 0; i < NumFiles; i++) {
+        ASSERT_EQ(unlinkat(dirfd, names[i], 0), 0);
+    }
+    ASSERT_EQ(close(dirfd), 0);
+    ASSERT_EQ(rmdir(MOUNT_POINT "/stat"), 0);
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(basic_benchmarks)
 RUN_TEST_PERFORMANCE((benchmark_write_read<16 * KB, 1024>))
 RUN_TEST_PERFORMANCE((benchmark_write_read<16 * KB, 2048>))
@@ -212,4 +351,9 @@ RUN_TEST_PERFORMANCE((benchmark_path_walk<125>))
 RUN_TEST_PERFORMANCE((benchmark_path_walk<250>))
 RUN_TEST_PERFORMANCE((benchmark_path_walk<500>))
 RUN_TEST_PERFORMANCE((benchmark_path_walk<1000>))
+RUN_TEST_PERFORMANCE((benchmark_concurrent_read<1>))
+RUN_TEST_PERFORMANCE((benchmark_concurrent_read<2>))
+RUN_TEST_PERFORMANCE((benchmark_concurrent_read<4>))
+RUN_TEST_PERFORMANCE((benchmark_stat_entries<100>))
+RUN_TEST_PERFORMANCE((benchmark_stat_entries<1000>))
 END_TEST_CASE(basic_benchmarks)
@@ -2,8 +2,159 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include <unittest/unittest.h>
 
+#include "workload.h"
+
+namespace {
+
+constexpr char kWorkloadUsage[] =
+    "Usage: %s workload [options ...] DIR\n"
+    "\n"
+    "Runs one workload in DIR, which can be on any mounted filesystem.\n"
+    "Sizes take a K or M suffix.\n"
+    "\n"
+    "Options:\n"
+    "  -m io|metadata  the kind of workload (default: io)\n"
+    "  -t N            threads (default: 1)\n"
+    "\n"
+    "io workloads:\n"
+    "  -s SIZE         file size (default: 16M)\n"
+    "  -b SIZE         block size (default: 4K)\n"
+    "  -r N            percent of operations that are reads (default: 100)\n"
+    "  -R              random offsets, rather than sequential\n"
+    "  -n N            operations per thread (default: 4096)\n"
+    "  -S              all the threads share one file\n"
+    "  -f N            fsync after every N writes\n"
+    "  -F              fsync when done\n"
+    "\n"
+    "metadata workloads:\n"
+    "  -n N            files to create, stat and unlink (default: 1000)\n"
+    "  -d N            directories to spread them over (default: 1)\n"
+    "  -s SIZE         bytes to write to each file (default: 0)\n"
+    "  -F              fsync each file\n";
+
+bool parse_size(const char* arg, size_t* out) {
+    errno = 0;
+    char* end;
+    unsigned long long v = strtoull(arg, &end, 10);
+    if (errno != 0 || end == arg)
+        return false;
+    if (*end == 'K' || *end == 'k') {
+        v <<= 10;
+        end++;
+    } else if (*end == 'M' || *end == 'm') {
+        v <<= 20;
+        end++;
+    }
+    *out = static_cast<size_t>(v);
+    return *end == '\0';
+}
+
+int run_workload(int argc, char** argv) {
+    bool metadata = false;
+    size_t size = 0;
+    bool size_set = false;
+    size_t block_size = 4 << 10;
+    size_t read_percent = 100;
+    bool random = false;
+    size_t threads = 1;
+    size_t count = 0;
+    bool count_set = false;
+    bool shared = false;
+    size_t fsync_interval = 0;
+    bool fsync_flag = false;
+    size_t dirs = 1;
+
+    int opt;
+    bool ok = true;
+    while (ok && (opt = getopt(argc, argv, "hm:t:s:b:r:Rn:Sf:Fd:")) != -1) {
+        switch (opt) {
+        case 'h':
+            printf(kWorkloadUsage, argv[0]);
+            return 0;
+        case 'm':
+            metadata = !strcmp(optarg, "metadata");
+            ok = metadata || !strcmp(optarg, "io");
+            break;
+        case 't':
+            ok = parse_size(optarg, &threads);
+            break;
+        case 's':
+            ok = size_set = parse_size(optarg, &size);
+            break;
+        case 'b':
+            ok = parse_size(optarg, &block_size);
+            break;
+        case 'r':
+            ok = parse_size(optarg, &read_percent);
+            break;
+        case 'R':
+            random = true;
+            break;
+        case 'n':
+            ok = count_set = parse_size(optarg, &count);
+            break;
+        case 'S':
+            shared = true;
+            break;
+        case 'f':
+            ok = parse_size(optarg, &fsync_interval);
+            break;
+        case 'F':
+            fsync_flag = true;
+            break;
+        case 'd':
+            ok = parse_size(optarg, &dirs);
+            break;
+        default:
+            ok = false;
+            break;
+        }
+    }
+    if (!ok || optind != argc - 1) {
+        fprintf(stderr, kWorkloadUsage, argv[0]);
+        return 1;
+    }
+    const char* dir = argv[optind];
+
+    if (metadata) {
+        fs_bench::MetadataWorkload w = {};
+        w.name = "metadata";
+        w.files = static_cast<uint32_t>(count_set ? count : 1000);
+        w.dirs = static_cast<uint32_t>(dirs);
+        w.threads = static_cast<uint32_t>(threads);
+        w.file_size = size;
+        w.fsync = fsync_flag;
+        return fs_bench::RunMetadataWorkload(dir, w) ? 0 : 1;
+    }
+
+    fs_bench::IoWorkload w = {};
+    w.name = "io";
+    w.file_size = size_set ? size : 16 << 20;
+    w.block_size = block_size;
+    w.read_percent = static_cast<uint32_t>(read_percent);
+    w.random = random;
+    w.threads = static_cast<uint32_t>(threads);
+    w.ops = count_set ? count : 4096;
+    w.shared_file = shared;
+    w.fsync_interval = static_cast<uint32_t>(fsync_interval);
+    w.fsync_at_end = fsync_flag;
+    return fs_bench::RunIoWorkload(dir, w) ? 0 : 1;
+}
+
+} // namespace
+
 int main(int argc, char** argv) {
+    // "workload" runs a workload given on the command line instead of the
+    // benchmarks, on any filesystem.
+    if (argc > 1 && !strcmp(argv[1], "workload"))
+        return run_workload(argc - 1, argv + 1);
     return unittest_run_all_tests(argc, argv) ? 0 : -1;
 }
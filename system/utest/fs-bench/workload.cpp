@@ -0,0 +1,480 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "workload.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <threads.h>
+#include <unistd.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
+#include <unittest/unittest.h>
+#include <zircon/syscalls.h>
+
+#define MOUNT_POINT "/benchmark"
+
+namespace fs_bench {
+namespace {
+
+constexpr size_t KB = (1 << 10);
+constexpr size_t MB = (1 << 20);
+constexpr uint8_t kMagicByte = 0xee;
+constexpr uint32_t kMaxThreads = 64;
+
+zx_time_t now() {
+    return zx_time_get(ZX_CLOCK_MONOTONIC);
+}
+
+// Each thread has its own, so that runs are repeatable.
+uint32_t next_random(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+void print_rate(const char* what, uint64_t ops, uint64_t bytes, zx_duration_t elapsed) {
+    double seconds = static_cast<double>(elapsed) / ZX_SEC(1);
+    printf("  %s: %" PRIu64 " ops in %.3f s, %.0f ops/s", what, ops, seconds,
+           static_cast<double>(ops) / seconds);
+    if (bytes)
+        printf(", %.1f MB/s", static_cast<double>(bytes) / MB / seconds);
+    printf("\n");
+}
+
+// The directory a workload runs in, removed again afterwards.
+bool make_work_dir(const char* dir, char* path, size_t len) {
+    snprintf(path, len, "%s/fs-bench-workload", dir);
+    if (mkdir(path, 0755) != 0) {
+        fprintf(stderr, "Cannot create %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool remove_dir(const char* path) {
+    if (rmdir(path) != 0) {
+        fprintf(stderr, "Cannot remove %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+struct IoThread {
+    const IoWorkload* workload;
+    uint32_t index;
+    int fd;
+    uint64_t bytes;
+    LatencyHistogram reads;
+    LatencyHistogram writes;
+    LatencyHistogram fsyncs;
+    bool ok;
+};
+
+int io_thread(void* arg) {
+    IoThread* t = static_cast<IoThread*>(arg);
+    const IoWorkload& w = *t->workload;
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> buf(new (&ac) uint8_t[w.block_size]);
+    if (!ac.check())
+        return -1;
+    memset(buf.get(), kMagicByte, w.block_size);
+
+    const uint64_t blocks = w.file_size / w.block_size;
+    uint32_t rng = 0x9e3779b9u * (t->index + 1);
+    // Threads sharing a file each start at their own place in it.
+    uint64_t next_block = w.shared_file ? t->index * blocks / w.threads : 0;
+    uint32_t unsynced = 0;
+
+    for (uint64_t i = 0; i < w.ops; i++) {
+        uint64_t block;
+        if (w.random) {
+            block = next_random(&rng) % blocks;
+        } else {
+            block = next_block;
+            next_block = (next_block + 1) % blocks;
+        }
+        off_t off = static_cast<off_t>(block * w.block_size);
+        bool is_read = next_random(&rng) % 100 < w.read_percent;
+
+        zx_time_t start = now();
+        ssize_t r = is_read ? pread(t->fd, buf.get(), w.block_size, off)
+                            : pwrite(t->fd, buf.get(), w.block_size, off);
+        zx_duration_t latency = now() - start;
+        if (r != static_cast<ssize_t>(w.block_size)) {
+            fprintf(stderr, "%s at %jd failed: %s\n", is_read ? "read" : "write",
+                    static_cast<intmax_t>(off), r < 0 ? strerror(errno) : "short");
+            return -1;
+        }
+        t->bytes += w.block_size;
+        if (is_read) {
+            t->reads.Add(latency);
+            continue;
+        }
+        t->writes.Add(latency);
+
+        if (w.fsync_interval && ++unsynced == w.fsync_interval) {
+            unsynced = 0;
+            start = now();
+            if (fsync(t->fd) != 0)
+                return -1;
+            t->fsyncs.Add(now() - start);
+        }
+    }
+
+    if (w.fsync_at_end) {
+        zx_time_t start = now();
+        if (fsync(t->fd) != 0)
+            return -1;
+        t->fsyncs.Add(now() - start);
+    }
+    t->ok = true;
+    return 0;
+}
+
+struct MetadataThread {
+    const MetadataWorkload* workload;
+    const char* dir;
+    uint32_t index;
+    LatencyHistogram latency;
+    bool ok;
+};
+
+void metadata_path(const MetadataThread* t, uint32_t file, char* path, size_t len) {
+    snprintf(path, len, "%s/d%u/t%u-f%u", t->dir, file % t->workload->dirs, t->index, file);
+}
+
+// The files each thread works on.
+uint32_t thread_files(const MetadataThread* t) {
+    const MetadataWorkload& w = *t->workload;
+    return w.files / w.threads + (t->index < w.files % w.threads ? 1 : 0);
+}
+
+int create_thread(void* arg) {
+    MetadataThread* t = static_cast<MetadataThread*>(arg);
+    const MetadataWorkload& w = *t->workload;
+    uint8_t data[4 * KB];
+    memset(data, kMagicByte, sizeof(data));
+
+    char path[PATH_MAX];
+    for (uint32_t i = 0; i < thread_files(t); i++) {
+        metadata_path(t, i, path, sizeof(path));
+        zx_time_t start = now();
+        int fd = open(path, O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0) {
+            fprintf(stderr, "Cannot create %s: %s\n", path, strerror(errno));
+            return -1;
+        }
+        for (size_t done = 0; done < w.file_size;) {
+            size_t n = fbl::min(w.file_size - done, sizeof(data));
+            if (write(fd, data, n) != static_cast<ssize_t>(n))
+                return -1;
+            done += n;
+        }
+        if ((w.fsync && fsync(fd) != 0) || close(fd) != 0)
+            return -1;
+        t->latency.Add(now() - start);
+    }
+    t->ok = true;
+    return 0;
+}
+
+int stat_thread(void* arg) {
+    MetadataThread* t = static_cast<MetadataThread*>(arg);
+    char path[PATH_MAX];
+    for (uint32_t i = 0; i < thread_files(t); i++) {
+        metadata_path(t, i, path, sizeof(path));
+        struct stat s;
+        zx_time_t start = now();
+        if (stat(path, &s) != 0) {
+            fprintf(stderr, "Cannot stat %s: %s\n", path, strerror(errno));
+            return -1;
+        }
+        t->latency.Add(now() - start);
+    }
+    t->ok = true;
+    return 0;
+}
+
+int unlink_thread(void* arg) {
+    MetadataThread* t = static_cast<MetadataThread*>(arg);
+    char path[PATH_MAX];
+    for (uint32_t i = 0; i < thread_files(t); i++) {
+        metadata_path(t, i, path, sizeof(path));
+        zx_time_t start = now();
+        if (unlink(path) != 0) {
+            fprintf(stderr, "Cannot unlink %s: %s\n", path, strerror(errno));
+            return -1;
+        }
+        t->latency.Add(now() - start);
+    }
+    t->ok = true;
+    return 0;
+}
+
+// Runs |func| on every thread at once, and reports on them together.
+bool run_metadata_phase(const char* what, int (*func)(void*), MetadataThread* threads,
+                        uint32_t count) {
+    thrd_t thrds[kMaxThreads];
+    uint32_t started = 0;
+    bool ok = true;
+    zx_time_t start = now();
+    for (; started < count; started++) {
+        threads[started].ok = false;
+        threads[started].latency = LatencyHistogram();
+        if (thrd_create(&thrds[started], func, &threads[started]) != thrd_success) {
+            ok = false;
+            break;
+        }
+    }
+    LatencyHistogram latency;
+    for (uint32_t i = 0; i < started; i++) {
+        thrd_join(thrds[i], nullptr);
+        ok = ok && threads[i].ok;
+        latency.Merge(threads[i].latency);
+    }
+    zx_duration_t elapsed = now() - start;
+    if (!ok)
+        return false;
+
+    print_rate(what, latency.count(), 0, elapsed);
+    latency.Print(what);
+    return true;
+}
+
+} // namespace
+
+void LatencyHistogram::Add(zx_duration_t latency) {
+    uint64_t us = static_cast<uint64_t>(latency) / ZX_USEC(1);
+    size_t bucket = us ? 64 - __builtin_clzll(us) : 0;
+    buckets_[fbl::min(bucket, kBuckets - 1)]++;
+    count_++;
+    total_ += latency;
+    max_ = fbl::max(max_, latency);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < kBuckets; i++)
+        buckets_[i] += other.buckets_[i];
+    count_ += other.count_;
+    total_ += other.total_;
+    max_ = fbl::max(max_, other.max_);
+}
+
+zx_duration_t LatencyHistogram::Percentile(double p) const {
+    uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(count_));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; i++) {
+        seen += buckets_[i];
+        if (seen > rank)
+            return fbl::min(max_, static_cast<zx_duration_t>(ZX_USEC(1) << i));
+    }
+    return max_;
+}
+
+void LatencyHistogram::Print(const char* label) const {
+    if (count_ == 0)
+        return;
+    printf("    %s latency (us): mean %" PRIu64 ", p50 < %" PRIu64 ", p99 < %" PRIu64
+           ", p99.9 < %" PRIu64 ", max %" PRIu64 "\n",
+           label, static_cast<uint64_t>(total_ / count_ / ZX_USEC(1)),
+           static_cast<uint64_t>(Percentile(0.5) / ZX_USEC(1)),
+           static_cast<uint64_t>(Percentile(0.99) / ZX_USEC(1)),
+           static_cast<uint64_t>(Percentile(0.999) / ZX_USEC(1)),
+           static_cast<uint64_t>(max_ / ZX_USEC(1)));
+
+    uint64_t most = 0;
+    for (size_t i = 0; i < kBuckets; i++)
+        most = fbl::max(most, buckets_[i]);
+    for (size_t i = 0; i < kBuckets; i++) {
+        if (buckets_[i] == 0)
+            continue;
+        char bar[41];
+        size_t len = static_cast<size_t>(buckets_[i] * (sizeof(bar) - 1) / most);
+        memset(bar, '#', len);
+        bar[len] = '\0';
+        printf("      %10" PRIu64 " - %-10" PRIu64 " %10" PRIu64 " %s\n",
+               i ? uint64_t{1} << (i - 1) : 0, uint64_t{1} << i, buckets_[i], bar);
+    }
+}
+
+bool RunIoWorkload(const char* dir, const IoWorkload& w) {
+    if (w.threads == 0 || w.threads > kMaxThreads || w.block_size == 0 ||
+        w.file_size < w.block_size || w.read_percent > 100) {
+        fprintf(stderr, "Invalid workload %s\n", w.name);
+        return false;
+    }
+    printf("\nWorkload %s: %zu byte blocks, %u%% reads, %s, %u threads, %" PRIu64
+           " ops each, %zu KB %s\n",
+           w.name, w.block_size, w.read_percent, w.random ? "random" : "sequential",
+           w.threads, w.ops, w.file_size / KB, w.shared_file ? "shared file" : "files");
+
+    char work_dir[PATH_MAX];
+    if (!make_work_dir(dir, work_dir, sizeof(work_dir)))
+        return false;
+
+    // Lay the files out in full first, so reads find data.
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> data(new (&ac) uint8_t[w.block_size]);
+    if (!ac.check())
+        return false;
+    memset(data.get(), kMagicByte, w.block_size);
+
+    const uint32_t num_files = w.shared_file ? 1 : w.threads;
+    int fds[kMaxThreads];
+    uint32_t opened = 0;
+    char path[PATH_MAX];
+    bool ok = true;
+    for (; ok && opened < num_files; opened++) {
+        snprintf(path, sizeof(path), "%s/file-%u", work_dir, opened);
+        int fd = open(path, O_CREAT | O_RDWR, 0644);
+        if (fd < 0) {
+            fprintf(stderr, "Cannot create %s: %s\n", path, strerror(errno));
+            ok = false;
+            break;
+        }
+        fds[opened] = fd;
+        for (size_t off = 0; ok && off + w.block_size <= w.file_size; off += w.block_size)
+            ok = write(fd, data.get(), w.block_size) == static_cast<ssize_t>(w.block_size);
+    }
+    ok = ok && syncfs(fds[0]) == 0;
+
+    IoThread threads[kMaxThreads] = {};
+    thrd_t thrds[kMaxThreads];
+    uint32_t started = 0;
+    zx_time_t start = now();
+    for (; ok && started < w.threads; started++) {
+        IoThread* t = &threads[started];
+        t->workload = &w;
+        t->index = started;
+        t->fd = fds[w.shared_file ? 0 : started];
+        ok = thrd_create(&thrds[started], io_thread, t) == thrd_success;
+        if (!ok)
+            break;
+    }
+    LatencyHistogram reads, writes, fsyncs;
+    uint64_t bytes = 0;
+    for (uint32_t i = 0; i < started; i++) {
+        thrd_join(thrds[i], nullptr);
+        ok = ok && threads[i].ok;
+        reads.Merge(threads[i].reads);
+        writes.Merge(threads[i].writes);
+        fsyncs.Merge(threads[i].fsyncs);
+        bytes += threads[i].bytes;
+    }
+    zx_duration_t elapsed = now() - start;
+
+    if (ok) {
+        print_rate("total", reads.count() + writes.count(), bytes, elapsed);
+        reads.Print("read");
+        writes.Print("write");
+        fsyncs.Print("fsync");
+    }
+
+    for (uint32_t i = 0; i < opened; i++) {
+        snprintf(path, sizeof(path), "%s/file-%u", work_dir, i);
+        ok = close(fds[i]) == 0 && unlink(path) == 0 && ok;
+    }
+    return remove_dir(work_dir) && ok;
+}
+
+bool RunMetadataWorkload(const char* dir, const MetadataWorkload& w) {
+    if (w.threads == 0 || w.threads > kMaxThreads || w.dirs == 0) {
+        fprintf(stderr, "Invalid workload %s\n", w.name);
+        return false;
+    }
+    printf("\nWorkload %s: %u files of %zu bytes in %u directories, %u threads%s\n",
+           w.name, w.files, w.file_size, w.dirs, w.threads, w.fsync ? ", fsync each" : "");
+
+    char work_dir[PATH_MAX];
+    if (!make_work_dir(dir, work_dir, sizeof(work_dir)))
+        return false;
+
+    char path[PATH_MAX];
+    uint32_t made = 0;
+    bool ok = true;
+    for (; ok && made < w.dirs; made++) {
+        snprintf(path, sizeof(path), "%s/d%u", work_dir, made);
+        ok = mkdir(path, 0755) == 0;
+    }
+
+    MetadataThread threads[kMaxThreads] = {};
+    for (uint32_t i = 0; i < w.threads; i++) {
+        threads[i].workload = &w;
+        threads[i].dir = work_dir;
+        threads[i].index = i;
+    }
+    ok = ok && run_metadata_phase("create", create_thread, threads, w.threads) &&
+         run_metadata_phase("stat", stat_thread, threads, w.threads) &&
+         run_metadata_phase("unlink", unlink_thread, threads, w.threads);
+
+    // A failed run leaves files behind, and the directories with them.
+    for (uint32_t i = 0; i < made; i++) {
+        snprintf(path, sizeof(path), "%s/d%u", work_dir, i);
+        ok = remove_dir(path) && ok;
+    }
+    return remove_dir(work_dir) && ok;
+}
+
+namespace {
+
+template <const IoWorkload& W>
+bool benchmark_io(void) {
+    BEGIN_TEST;
+    ASSERT_TRUE(RunIoWorkload(MOUNT_POINT, W),
+                "FS benchmarks assume mounted FS exists at '/benchmark'");
+    END_TEST;
+}
+
+template <const MetadataWorkload& W>
+bool benchmark_metadata(void) {
+    BEGIN_TEST;
+    ASSERT_TRUE(RunMetadataWorkload(MOUNT_POINT, W),
+                "FS benchmarks assume mounted FS exists at '/benchmark'");
+    END_TEST;
+}
+
+// name, file size, block size, read %, random, threads, ops, shared, fsync interval, at end
+constexpr IoWorkload kSeqWrite = {"seq-write", 16 * MB, 64 * KB, 0, false, 1, 1024, false, 0, true};
+constexpr IoWorkload kSeqRead = {"seq-read", 16 * MB, 64 * KB, 100, false, 1, 1024, false, 0, false};
+constexpr IoWorkload kRandRead = {"rand-read", 16 * MB, 4 * KB, 100, true, 1, 8192, false, 0, false};
+constexpr IoWorkload kRandRead4 = {"rand-read", 16 * MB, 4 * KB, 100, true, 4, 8192, true, 0, false};
+constexpr IoWorkload kRandMix = {"rand-70r30w", 16 * MB, 4 * KB, 70, true, 4, 4096, false, 0, true};
+constexpr IoWorkload kRandWriteSync = {"rand-write-fsync16", 4 * MB, 4 * KB, 0, true, 1, 2048,
+                                       false, 16, false};
+
+// name, files, dirs, threads, file size, fsync
+constexpr MetadataWorkload kFlat = {"storm-flat", 2000, 1, 1, 0, false};
+constexpr MetadataWorkload kFanout = {"storm-fanout", 2000, 32, 1, 0, false};
+constexpr MetadataWorkload kFanout4 = {"storm-fanout", 2000, 32, 4, 0, false};
+constexpr MetadataWorkload kSmallFilesSync = {"small-files-fsync", 500, 8, 1, 4 * KB, true};
+
+} // namespace
+
+} // namespace fs_bench
+
+using namespace fs_bench;
+
+BEGIN_TEST_CASE(workload_benchmarks)
+RUN_TEST_PERFORMANCE((benchmark_io<kSeqWrite>))
+RUN_TEST_PERFORMANCE((benchmark_io<kSeqRead>))
+RUN_TEST_PERFORMANCE((benchmark_io<kRandRead>))
+RUN_TEST_PERFORMANCE((benchmark_io<kRandRead4>))
+RUN_TEST_PERFORMANCE((benchmark_io<kRandMix>))
+RUN_TEST_PERFORMANCE((benchmark_io<kRandWriteSync>))
+RUN_TEST_PERFORMANCE((benchmark_metadata<kFlat>))
+RUN_TEST_PERFORMANCE((benchmark_metadata<kFanout>))
+RUN_TEST_PERFORMANCE((benchmark_metadata<kFanout4>))
+RUN_TEST_PERFORMANCE((benchmark_metadata<kSmallFilesSync>))
+END_TEST_CASE(workload_benchmarks)
@@ -0,0 +1,72 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zircon/types.h>
+
+namespace fs_bench {
+
+// Counts latencies in power of two buckets of microseconds: bucket 0 is
+// under 1us, bucket n is [2^(n-1), 2^n) us.
+class LatencyHistogram {
+public:
+    static constexpr size_t kBuckets = 32;
+
+    void Add(zx_duration_t latency);
+    void Merge(const LatencyHistogram& other);
+
+    uint64_t count() const { return count_; }
+
+    // The upper bound of the bucket holding the |p|th fraction of the
+    // latencies, so an overestimate by up to a factor of two.
+    zx_duration_t Percentile(double p) const;
+
+    // Prints a summary line and the non-empty buckets under |label|.
+    void Print(const char* label) const;
+
+private:
+    uint64_t buckets_[kBuckets] = {};
+    uint64_t count_ = 0;
+    zx_duration_t total_ = 0;
+    zx_duration_t max_ = 0;
+};
+
+// Reads and writes of |block_size| blocks to files of |file_size|, from
+// |threads| threads at once, each doing |ops| of them. The threads each
+// have a file of their own unless |shared_file|.
+struct IoWorkload {
+    const char* name;
+    size_t file_size;
+    size_t block_size;
+    uint32_t read_percent; // the rest are writes
+    bool random;           // otherwise each thread goes through its file in order
+    uint32_t threads;
+    uint64_t ops;
+    bool shared_file;
+    uint32_t fsync_interval; // fsync after every this many writes, 0 for never
+    bool fsync_at_end;
+};
+
+// Creates |files| files, spread over |dirs| directories, then stats them all
+// and unlinks them all, split between |threads| threads.
+struct MetadataWorkload {
+    const char* name;
+    uint32_t files;
+    uint32_t dirs;
+    uint32_t threads;
+    size_t file_size;  // written into each file as it's created
+    bool fsync;        // each file as it's created
+};
+
+// Run the workload in a directory they make under |dir|, which can be on any
+// filesystem, and print what they measured. They return false, having said
+// why, if anything fails.
+bool RunIoWorkload(const char* dir, const IoWorkload& workload);
+bool RunMetadataWorkload(const char* dir, const MetadataWorkload& workload);
+
+} // namespace fs_bench
@@ -14,6 +14,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <fdio/io.h>
 #include <zircon/compiler.h>
 
 #include "filesystems.h"
@@ -74,6 +75,62 @@ bool test_directory_large(void) {
     END_TEST;
 }
 
+// Adds and removes names in a directory big enough to be indexed, checking that
+// lookups keep finding exactly the names which are present.
+bool test_directory_large_churn(void) {
+    BEGIN_TEST;
+
+    const int num_files = 512;
+    char path[LARGE_PATH_LENGTH + 1];
+    char other[LARGE_PATH_LENGTH + 1];
+    ASSERT_EQ(mkdir("::churn", 0755), 0, "");
+    for (int i = 0; i < num_files; i++) {
+        snprintf(path, sizeof(path), "::churn/%d", i);
+        int fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+        ASSERT_GT(fd, 0, "");
+        ASSERT_EQ(close(fd), 0, "");
+    }
+
+    // Remove the odd names, and rename the multiples of four.
+    for (int i = 1; i < num_files; i += 2) {
+        snprintf(path, sizeof(path), "::churn/%d", i);
+        ASSERT_EQ(unlink(path), 0, "");
+    }
+    for (int i = 0; i < num_files; i += 4) {
+        snprintf(path, sizeof(path), "::churn/%d", i);
+        snprintf(other, sizeof(other), "::churn/renamed-%d", i);
+        ASSERT_EQ(rename(path, other), 0, "");
+    }
+
+    struct stat st;
+    for (int i = 0; i < num_files; i++) {
+        snprintf(path, sizeof(path), "::churn/%d", i);
+        snprintf(other, sizeof(other), "::churn/renamed-%d", i);
+        bool present = (i % 2 == 0) && (i % 4 != 0);
+        ASSERT_EQ(stat(path, &st), present ? 0 : -1, "");
+        ASSERT_EQ(stat(other, &st), (i % 4 == 0) ? 0 : -1, "");
+        if (present) {
+            ASSERT_EQ(open(path, O_RDWR | O_CREAT | O_EXCL, 0644), -1, "");
+        }
+    }
+
+    // Put the removed names back into the holes they left.
+    for (int i = 1; i < num_files; i += 2) {
+        snprintf(path, sizeof(path), "::churn/%d", i);
+        int fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+        ASSERT_GT(fd, 0, "");
+        ASSERT_EQ(close(fd), 0, "");
+    }
+
+    for (int i = 0; i < num_files; i++) {
+        snprintf(path, sizeof(path), (i % 4 == 0) ? "::churn/renamed-%d" : "::churn/%d", i);
+        ASSERT_EQ(unlink(path), 0, "");
+    }
+    ASSERT_EQ(rmdir("::churn"), 0, "");
+
+    END_TEST;
+}
+
 bool test_directory_max(void) {
     BEGIN_TEST;
 
@@ -369,6 +426,67 @@ bool test_directory_readdir_rm_all(void) {
     END_TEST;
 }
 
+bool test_directory_readdir_stat(void) {
+    BEGIN_TEST;
+
+    // Enough entries that they take several replies to read.
+    size_t num_entries = 300;
+    ASSERT_EQ(mkdir("::dir", 0755), 0, "");
+    for (size_t i = 0; i < num_entries; i++) {
+        char name[100];
+        snprintf(name, sizeof(name), "::dir/%05lu", i);
+        if (i % 10 == 0) {
+            ASSERT_EQ(mkdir(name, 0755), 0, "");
+            continue;
+        }
+        int fd = open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+        ASSERT_GT(fd, 0, "");
+        char data[100];
+        memset(data, 'a', sizeof(data));
+        ASSERT_EQ(write(fd, data, i % sizeof(data)), static_cast<ssize_t>(i % sizeof(data)), "");
+        ASSERT_EQ(close(fd), 0, "");
+    }
+
+    DIR* dir = opendir("::dir");
+    ASSERT_NONNULL(dir, "");
+
+    // Each entry comes with the attributes fstatat() would return for it.
+    struct dirent* de;
+    struct stat st;
+    size_t num_seen = 0;
+    while ((de = fdio_readdir_stat(dir, &st)) != NULL) {
+        struct stat expected;
+        ASSERT_EQ(fstatat(dirfd(dir), de->d_name, &expected, 0), 0, "");
+        ASSERT_EQ(st.st_mode, expected.st_mode, "");
+        ASSERT_EQ(st.st_ino, expected.st_ino, "");
+        ASSERT_EQ(st.st_size, expected.st_size, "");
+        ASSERT_EQ(st.st_nlink, expected.st_nlink, "");
+        if (strcmp(de->d_name, ".")) {
+            num_seen++;
+        }
+    }
+    ASSERT_EQ(num_seen, num_entries, "Did not see all expected entries");
+
+    // Reading the entries without their attributes picks up where the
+    // stream was left, and both see the same entries.
+    rewinddir(dir);
+    ASSERT_NONNULL(fdio_readdir_stat(dir, &st), "");
+    num_seen = 1;
+    while ((de = readdir(dir)) != NULL) {
+        num_seen++;
+    }
+    ASSERT_EQ(num_seen, num_entries + 1, "");
+    ASSERT_EQ(closedir(dir), 0, "");
+
+    for (size_t i = 0; i < num_entries; i++) {
+        char name[100];
+        snprintf(name, sizeof(name), "::dir/%05lu", i);
+        ASSERT_EQ(unlink(name), 0, "");
+    }
+    ASSERT_EQ(rmdir("::dir"), 0, "");
+    END_TEST;
+}
+
 bool test_directory_rewind(void) {
     BEGIN_TEST;
 
@@ -457,9 +575,11 @@ RUN_FOR_ALL_FILESYSTEMS(directory_tests,
     RUN_TEST_MEDIUM(test_directory_coalesce_large_record)
     RUN_TEST_MEDIUM(test_directory_filename_max)
     RUN_TEST_LARGE(test_directory_large)
+    RUN_TEST_LARGE(test_directory_large_churn)
     RUN_TEST_MEDIUM(test_directory_trailing_slash)
     RUN_TEST_MEDIUM(test_directory_readdir)
     RUN_TEST_LARGE(test_directory_readdir_rm_all)
+    RUN_TEST_MEDIUM(test_directory_readdir_stat)
     RUN_TEST_MEDIUM(test_directory_rewind)
     RUN_TEST_MEDIUM(test_directory_after_rmdir)
 )
@@ -7,6 +7,7 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <minfs/format.h>
@@ -44,8 +45,74 @@ bool QueryInfo(size_t expected_nodes) {
     return true;
 }
 
+bool UsedBytes(uint64_t* out) {
+    int fd = open(MOUNT_PATH, O_RDONLY | O_DIRECTORY);
+    ASSERT_GT(fd, 0);
+    char buf[sizeof(vfs_query_info_t) + MAX_FS_NAME_LEN + 1];
+    vfs_query_info_t* info = reinterpret_cast<vfs_query_info_t*>(buf);
+    ssize_t rv = ioctl_vfs_query_fs(fd, info, sizeof(buf) - 1);
+    ASSERT_EQ(close(fd), 0);
+    ASSERT_GT(rv, static_cast<ssize_t>(sizeof(vfs_query_info_t)), "Failed to query filesystem");
+    *out = info->used_bytes;
+    return true;
+}
+
 }  // namespace
 
+bool TestInlineData(void) {
+    BEGIN_TEST;
+
+    uint64_t used_before;
+    ASSERT_TRUE(UsedBytes(&used_before));
+
+    const char* path = MOUNT_PATH "/inline";
+    int fd = open(path, O_CREAT | O_RDWR);
+    ASSERT_GT(fd, 0, "Failed to create file");
+    char data[minfs::kMinfsInlineMax + 1];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = static_cast<char>('a' + i % 26);
+    }
+
+    // Small files take no data blocks, and holes within them read as zeroes.
+    ASSERT_EQ(write(fd, data, 100), 100);
+    ASSERT_EQ(pwrite(fd, data + 150, 20, 150), 20);
+    uint64_t used;
+    ASSERT_TRUE(UsedBytes(&used));
+    ASSERT_EQ(used, used_before);
+    char buf[sizeof(data)];
+    ASSERT_EQ(pread(fd, buf, sizeof(buf), 0), 170);
+    ASSERT_EQ(memcmp(buf, data, 100), 0);
+    for (size_t i = 100; i < 150; i++) {
+        ASSERT_EQ(buf[i], 0);
+    }
+    ASSERT_EQ(memcmp(buf + 150, data + 150, 20), 0);
+
+    // Shrinking and regrowing leaves zeroes behind.
+    ASSERT_EQ(ftruncate(fd, 50), 0);
+    ASSERT_EQ(ftruncate(fd, 120), 0);
+    ASSERT_EQ(pread(fd, buf, sizeof(buf), 0), 120);
+    ASSERT_EQ(memcmp(buf, data, 50), 0);
+    for (size_t i = 50; i < 120; i++) {
+        ASSERT_EQ(buf[i], 0);
+    }
+
+    // Growing past the inode moves the data out to a block.
+    ASSERT_EQ(pwrite(fd, data, sizeof(data), 0), static_cast<ssize_t>(sizeof(data)));
+    ASSERT_TRUE(UsedBytes(&used));
+    ASSERT_EQ(used, used_before + minfs::kMinfsBlockSize);
+    ASSERT_EQ(close(fd), 0);
+    fd = open(path, O_RDONLY);
+    ASSERT_GT(fd, 0);
+    ASSERT_EQ(read(fd, buf, sizeof(buf)), static_cast<ssize_t>(sizeof(buf)));
+    ASSERT_EQ(memcmp(buf, data, sizeof(data)), 0);
+    ASSERT_EQ(close(fd), 0);
+
+    ASSERT_EQ(unlink(path), 0);
+    ASSERT_TRUE(UsedBytes(&used));
+    ASSERT_EQ(used, used_before);
+    END_TEST;
+}
+
 bool TestQueryInfo(void) {
     BEGIN_TEST;
 
@@ -64,9 +131,32 @@ bool TestQueryInfo(void) {
     END_TEST;
 }
 
+bool TestQueryCache(void) {
+    BEGIN_TEST;
+
+    int fd = open(MOUNT_PATH, O_RDONLY | O_DIRECTORY);
+    ASSERT_GT(fd, 0);
+
+    vfs_cache_info_t cache;
+    ASSERT_EQ(ioctl_vfs_query_cache(fd, &cache), sizeof(cache));
+    ASSERT_EQ(close(fd), 0);
+
+    ASSERT_EQ(cache.block_size, minfs::kMinfsBlockSize);
+    ASSERT_GT(cache.capacity, 0);
+    // Every readahead block comes in behind a miss.
+    ASSERT_LE(cache.readahead, cache.misses * cache.capacity);
+
+    ASSERT_GT(cache.writeback_capacity, 0);
+    ASSERT_LE(cache.writeback_used, cache.writeback_peak);
+    ASSERT_LE(cache.writeback_peak, cache.writeback_capacity);
+    END_TEST;
+}
+
 #define RUN_MINFS_TESTS(name, CASE_TESTS) \
     FS_TEST_CASE(name, DEFAULT_DISK_SIZE, CASE_TESTS, FS_TEST_FVM, minfs, 1)
 
 RUN_MINFS_TESTS(FsMinfsTestsFvm,
     RUN_TEST_MEDIUM(TestQueryInfo)
+    RUN_TEST_MEDIUM(TestQueryCache)
+    RUN_TEST_MEDIUM(TestInlineData)
 )
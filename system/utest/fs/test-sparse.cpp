@@ -97,4 +97,8 @@ RUN_FOR_ALL_FILESYSTEMS(sparse_tests,
     RUN_TEST_MEDIUM((test_sparse<kBlockSize * kDirectBlocks + kBlockSize,
                                  kBlockSize * kDirectBlocks + 2 * kBlockSize,
                                  kBlockSize * 32>))
+
+    // Larger than a single transfer through the shared I/O VMO.
+    RUN_TEST_MEDIUM((test_sparse<kBlockSize / 2, kBlockSize,
+                                 kBlockSize * 160 + kBlockSize / 2>))
 )
@@ -134,9 +134,40 @@ bool test_remove(void) {
     END_TEST;
 }
 
+// Filesystems may keep closed files around to reopen them quickly. Make sure
+// unlinking such a file still removes it.
+bool test_unlink_closed_reopened(void) {
+    BEGIN_TEST;
+
+    int fd = open("::kept", O_RDWR | O_CREAT | O_EXCL, 0644);
+    ASSERT_GT(fd, 0);
+    ASSERT_TRUE(simple_write_test(fd, 1));
+    ASSERT_EQ(close(fd), 0);
+
+    fd = open("::kept", O_RDWR, 0644);
+    ASSERT_GT(fd, 0);
+    ASSERT_TRUE(simple_read_test(fd, 1));
+    ASSERT_EQ(close(fd), 0);
+
+    ASSERT_EQ(unlink("::kept"), 0);
+    ASSERT_LT(open("::kept", O_RDWR, 0644), 0);
+    ASSERT_EQ(errno, ENOENT);
+
+    fd = open("::kept", O_RDWR | O_CREAT | O_EXCL, 0644);
+    ASSERT_GT(fd, 0);
+    struct stat st;
+    ASSERT_EQ(fstat(fd, &st), 0);
+    ASSERT_EQ(st.st_size, 0);
+    ASSERT_EQ(close(fd), 0);
+    ASSERT_EQ(unlink("::kept"), 0);
+
+    END_TEST;
+}
+
 RUN_FOR_ALL_FILESYSTEMS(unlink_tests,
     RUN_TEST_MEDIUM(test_unlink_simple)
     RUN_TEST_MEDIUM(test_unlink_use_afterwards)
     RUN_TEST_MEDIUM(test_unlink_open_elsewhere)
+    RUN_TEST_MEDIUM(test_unlink_closed_reopened)
     RUN_TEST_MEDIUM(test_remove);
 )
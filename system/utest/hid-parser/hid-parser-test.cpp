@@ -7,6 +7,7 @@
 
 #include <hid-parser/item.h>
 #include <hid-parser/parser.h>
+#include <hid-parser/report.h>
 
 #include <unistd.h>
 #include <unittest/unittest.h>
@@ -607,7 +608,8 @@ static bool parse_boot_mouse() {
     auto res = hid::ParseReportDescriptor(
         boot_mouse_r_desc, sizeof(boot_mouse_r_desc), &dd);
 
-    EXPECT_EQ(res, hid::ParseResult::kParseOk);
+    ASSERT_EQ(res, hid::ParseResult::kParseOk);
+    hid::FreeDeviceDescriptor(dd);
     END_TEST;
 }
 
@@ -618,7 +620,8 @@ static bool parse_adaf_trinket() {
     auto res = hid::ParseReportDescriptor(
         trinket_r_desc, sizeof(trinket_r_desc), &dd);
 
-    EXPECT_EQ(res, hid::ParseResult::kParseOk);
+    ASSERT_EQ(res, hid::ParseResult::kParseOk);
+    hid::FreeDeviceDescriptor(dd);
     END_TEST;
 }
 
@@ -629,7 +632,8 @@ static bool parse_ps3_controller() {
     auto res = hid::ParseReportDescriptor(
         ps3_ds_r_desc, sizeof(ps3_ds_r_desc), &dd);
 
-    EXPECT_EQ(res, hid::ParseResult::kParseOk);
+    ASSERT_EQ(res, hid::ParseResult::kParseOk);
+    hid::FreeDeviceDescriptor(dd);
     END_TEST;
 }
 
@@ -640,7 +644,118 @@ static bool parse_acer12_touch() {
     auto res = hid::ParseReportDescriptor(
         acer12_touch_r_desc, sizeof(acer12_touch_r_desc), &dd);
 
-    EXPECT_EQ(res, hid::ParseResult::kParseOk);
+    ASSERT_EQ(res, hid::ParseResult::kParseOk);
+    hid::FreeDeviceDescriptor(dd);
+    END_TEST;
+}
+
+static bool compile_boot_mouse() {
+    BEGIN_TEST;
+
+    hid::DeviceDescriptor* dd = nullptr;
+    auto res = hid::ParseReportDescriptor(
+        boot_mouse_r_desc, sizeof(boot_mouse_r_desc), &dd);
+    ASSERT_EQ(res, hid::ParseResult::kParseOk);
+    ASSERT_EQ(dd->rep_count, 1u);
+    EXPECT_EQ(dd->report[0]->report_id, 0u);
+
+    hid::ReportPrograms* progs = nullptr;
+    res = hid::CompileReports(dd, hid::NodeType::kInput, &progs);
+    ASSERT_EQ(res, hid::ParseResult::kParseOk);
+    ASSERT_EQ(progs->count, 1u);
+
+    // 3 buttons and X, Y; the 5 bits of padding are skipped.
+    const hid::ReportProgram* prog = &progs->programs[0];
+    EXPECT_EQ(prog->report_id, 0u);
+    EXPECT_EQ(prog->byte_sz, 3u);
+    ASSERT_EQ(prog->field_count, 5u);
+    EXPECT_EQ(prog->fields[3].bit_offset, 8u);
+    EXPECT_EQ(prog->fields[3].usage.usage, 0x30);
+    EXPECT_TRUE(prog->fields[3].is_signed);
+
+    // Buttons 1 and 3, X = -2, Y = 16.
+    const uint8_t report[] = { 0x05, 0xfe, 0x10 };
+    ASSERT_EQ(hid::FindReportProgram(progs, report, sizeof(report)), prog);
+    int32_t values[5] = {};
+    ASSERT_TRUE(hid::ExtractFields(prog, report, sizeof(report), values));
+    EXPECT_EQ(values[0], 1);
+    EXPECT_EQ(values[1], 0);
+    EXPECT_EQ(values[2], 1);
+    EXPECT_EQ(values[3], -2);
+    EXPECT_EQ(values[4], 16);
+
+    // Short reports are refused.
+    EXPECT_FALSE(hid::ExtractFields(prog, report, 2, values));
+
+    hid::FreeReportPrograms(progs);
+    hid::FreeDeviceDescriptor(dd);
+    END_TEST;
+}
+
+static bool compile_adaf_trinket() {
+    BEGIN_TEST;
+
+    hid::DeviceDescriptor* dd = nullptr;
+    auto res = hid::ParseReportDescriptor(
+        trinket_r_desc, sizeof(trinket_r_desc), &dd);
+    ASSERT_EQ(res, hid::ParseResult::kParseOk);
+
+    hid::ReportPrograms* progs = nullptr;
+    res = hid::CompileReports(dd, hid::NodeType::kInput, &progs);
+    ASSERT_EQ(res, hid::ParseResult::kParseOk);
+    ASSERT_GE(progs->count, 1u);
+
+    // The mouse report now follows a report id byte.
+    const uint8_t report[] = { 0x01, 0x02, 0x80, 0x7f };
+    const hid::ReportProgram* prog = hid::FindReportProgram(progs, report, sizeof(report));
+    ASSERT_NONNULL(prog);
+    EXPECT_EQ(prog->report_id, 1u);
+    EXPECT_EQ(prog->byte_sz, 4u);
+    ASSERT_EQ(prog->field_count, 5u);
+    EXPECT_EQ(prog->fields[0].bit_offset, 8u);
+
+    int32_t values[5] = {};
+    ASSERT_TRUE(hid::ExtractFields(prog, report, sizeof(report), values));
+    EXPECT_EQ(values[0], 0);
+    EXPECT_EQ(values[1], 1);
+    EXPECT_EQ(values[2], 0);
+    EXPECT_EQ(values[3], -128);
+    EXPECT_EQ(values[4], 127);
+
+    // Unknown report ids have no program.
+    const uint8_t unknown[] = { 0x09, 0x00 };
+    EXPECT_NULL(hid::FindReportProgram(progs, unknown, sizeof(unknown)));
+
+    hid::FreeReportPrograms(progs);
+    hid::FreeDeviceDescriptor(dd);
+    END_TEST;
+}
+
+static bool compile_acer12_touch() {
+    BEGIN_TEST;
+
+    hid::DeviceDescriptor* dd = nullptr;
+    auto res = hid::ParseReportDescriptor(
+        acer12_touch_r_desc, sizeof(acer12_touch_r_desc), &dd);
+    ASSERT_EQ(res, hid::ParseResult::kParseOk);
+
+    hid::ReportPrograms* progs = nullptr;
+    res = hid::CompileReports(dd, hid::NodeType::kInput, &progs);
+    ASSERT_EQ(res, hid::ParseResult::kParseOk);
+
+    // Every report has an id, and every field fits inside its report.
+    ASSERT_GT(progs->count, 1u);
+    for (size_t ix = 0; ix != progs->count; ++ix) {
+        const hid::ReportProgram& prog = progs->programs[ix];
+        EXPECT_NE(prog.report_id, 0u);
+        for (size_t f = 0; f != prog.field_count; ++f) {
+            EXPECT_LE(prog.fields[f].bit_offset + prog.fields[f].bit_sz,
+                      prog.byte_sz * 8);
+        }
+    }
+
+    hid::FreeReportPrograms(progs);
+    hid::FreeDeviceDescriptor(dd);
     END_TEST;
 }
 
@@ -650,6 +765,9 @@ RUN_TEST(parse_boot_mouse)
 RUN_TEST(parse_adaf_trinket)
 RUN_TEST(parse_ps3_controller)
 RUN_TEST(parse_acer12_touch)
+RUN_TEST(compile_boot_mouse)
+RUN_TEST(compile_adaf_trinket)
+RUN_TEST(compile_acer12_touch)
 END_TEST_CASE(hidparser_tests)
 
 int main(int argc, char** argv) {
@@ -49,8 +49,8 @@ static bool teardown(test_t* test) {
     return true;
 }
 
-static bool setup(test_t* test, const char* start, const char* end) {
-    zx_status_t status = test->guest.Init(VMO_SIZE);
+static bool setup(test_t* test, const char* start, const char* end, bool populate = false) {
+    zx_status_t status = test->guest.Init(VMO_SIZE, populate);
 
     test->supported = status != ZX_ERR_NOT_SUPPORTED;
     if (!test->supported) {
@@ -132,6 +132,26 @@ static bool vcpu_resume(void) {
     END_TEST;
 }
 
+static bool vcpu_resume_populated(void) {
+    BEGIN_TEST;
+
+    test_t test;
+    ASSERT_TRUE(setup(&test, vcpu_resume_start, vcpu_resume_end, true /* populate */));
+    if (!test.supported) {
+        // The hypervisor isn't supported, so don't run the test.
+        return true;
+    }
+
+    zx_port_packet_t packet = {};
+    ASSERT_EQ(zx_vcpu_resume(test.vcpu, &packet), ZX_OK);
+    EXPECT_EQ(packet.type, ZX_PKT_TYPE_GUEST_BELL);
+    EXPECT_EQ(packet.guest_bell.addr, EXIT_TEST_ADDR);
+
+    ASSERT_TRUE(teardown(&test));
+
+    END_TEST;
+}
+
 static bool vcpu_interrupt(void) {
     BEGIN_TEST;
 
@@ -403,6 +423,7 @@ static bool guest_set_trap_with_io(void) {
 
 BEGIN_TEST_CASE(guest)
 RUN_TEST(vcpu_resume)
+RUN_TEST(vcpu_resume_populated)
 RUN_TEST(vcpu_read_write_state)
 RUN_TEST(vcpu_interrupt)
 RUN_TEST(guest_set_trap_with_mem)
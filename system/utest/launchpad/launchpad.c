@@ -16,6 +16,7 @@
 #include <zircon/syscalls.h>
 #include <zircon/syscalls/object.h>
 #include <limits.h>
+#include <string.h>
 
 #include <fdio/util.h>
 
@@ -125,9 +126,79 @@ static bool argument_size_test(void) {
     return ok;
 }
 
+// A second load of the same file is served from the image cache; each
+// caller must still get its own copy of the data.
+static bool vmo_from_file_cached_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t first, second;
+    ASSERT_EQ(launchpad_vmo_from_file(program_path, &first), ZX_OK, "");
+    ASSERT_EQ(launchpad_vmo_from_file(program_path, &second), ZX_OK, "");
+    ASSERT_NE(first, second, "");
+
+    uint64_t first_size, second_size;
+    ASSERT_EQ(zx_vmo_get_size(first, &first_size), ZX_OK, "");
+    ASSERT_EQ(zx_vmo_get_size(second, &second_size), ZX_OK, "");
+    ASSERT_EQ(first_size, second_size, "");
+
+    char orig[4], junk[4] = {'j', 'u', 'n', 'k'}, buf[4];
+    size_t actual;
+    ASSERT_EQ(zx_vmo_read(second, orig, 0, sizeof(orig), &actual), ZX_OK, "");
+    ASSERT_EQ(zx_vmo_write(first, junk, 0, sizeof(junk), &actual), ZX_OK,
+              "clone should be writable");
+    ASSERT_EQ(zx_vmo_read(second, buf, 0, sizeof(buf), &actual), ZX_OK, "");
+    ASSERT_EQ(memcmp(buf, orig, sizeof(buf)), 0, "write leaked between loads");
+    zx_handle_close(first);
+
+    // A third load must not see the write either.
+    zx_handle_t third;
+    ASSERT_EQ(launchpad_vmo_from_file(program_path, &third), ZX_OK, "");
+    ASSERT_EQ(zx_vmo_read(third, buf, 0, sizeof(buf), &actual), ZX_OK, "");
+    ASSERT_EQ(memcmp(buf, orig, sizeof(buf)), 0, "write leaked into cache");
+    zx_handle_close(second);
+    zx_handle_close(third);
+
+    END_TEST;
+}
+
+// Every process launched from a template runs on its own.
+static bool template_test(void) {
+    BEGIN_TEST;
+
+    launchpad_template_t* tmpl;
+    ASSERT_EQ(launchpad_template_create("/boot/bin/sh", &tmpl), ZX_OK, "");
+    const char* const argv[] = { "/boot/bin/sh", "-c", "exit 7" };
+    ASSERT_EQ(launchpad_template_set_args(tmpl, countof(argv), argv), ZX_OK, "");
+
+    for (int i = 0; i < 3; ++i) {
+        launchpad_t* lp;
+        ASSERT_EQ(launchpad_create_from_template(ZX_HANDLE_INVALID, "template test",
+                                                 tmpl, &lp),
+                  ZX_OK, launchpad_error_message(lp));
+
+        zx_handle_t proc = ZX_HANDLE_INVALID;
+        const char* errmsg = "???";
+        ASSERT_EQ(launchpad_go(lp, &proc, &errmsg), ZX_OK, errmsg);
+
+        EXPECT_EQ(zx_object_wait_one(proc, ZX_PROCESS_TERMINATED,
+                                     ZX_TIME_INFINITE, NULL), ZX_OK, "");
+        zx_info_process_t info;
+        EXPECT_EQ(zx_object_get_info(proc, ZX_INFO_PROCESS,
+                                     &info, sizeof(info), NULL, NULL), ZX_OK, "");
+        EXPECT_EQ(zx_handle_close(proc), ZX_OK, "");
+        EXPECT_EQ(info.return_code, 7, "shell exit status");
+    }
+
+    launchpad_template_destroy(tmpl);
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(launchpad_tests)
 RUN_TEST(launchpad_test);
 RUN_TEST(argument_size_test);
+RUN_TEST(vmo_from_file_cached_test);
+RUN_TEST(template_test);
 END_TEST_CASE(launchpad_tests)
 
 int main(int argc, char **argv)
@@ -130,10 +130,71 @@ bool test_memfs_close_during_access() {
     END_TEST;
 }
 
+// Reads may be served straight from the file's VMO; check that they still
+// see what other connections do to the file, and that the seek offset they
+// move is the one writes and seeks use.
+bool test_memfs_shared_vmo_coherence() {
+    BEGIN_TEST;
+
+    async::Loop loop;
+    ASSERT_EQ(loop.StartThread(), ZX_OK);
+
+    memfs_filesystem_t* vfs;
+    zx_handle_t root;
+    ASSERT_EQ(memfs_create_filesystem(loop.async(), &vfs, &root), ZX_OK);
+    uint32_t type = PA_FDIO_REMOTE;
+    int fd;
+    ASSERT_EQ(fdio_create_fd(&root, &type, 1, &fd), ZX_OK);
+    DIR* d = fdopendir(fd);
+
+    int writer = openat(dirfd(d), "file", O_CREAT | O_RDWR);
+    ASSERT_GE(writer, 0);
+    int reader = openat(dirfd(d), "file", O_RDWR);
+    ASSERT_GE(reader, 0);
+
+    char buf[32];
+    ASSERT_EQ(read(reader, buf, sizeof(buf)), 0);
+    ASSERT_EQ(write(writer, "hello", 5), 5);
+    ASSERT_EQ(pread(reader, buf, sizeof(buf), 0), 5);
+    ASSERT_EQ(memcmp(buf, "hello", 5), 0);
+
+    // Overwrites are seen without the length changing, and extensions are
+    // seen once it does.
+    ASSERT_EQ(pwrite(writer, "j", 1, 0), 1);
+    ASSERT_EQ(write(writer, " world", 6), 6);
+    ASSERT_EQ(read(reader, buf, 3), 3);
+    ASSERT_EQ(memcmp(buf, "jel", 3), 0);
+    ASSERT_EQ(lseek(reader, 0, SEEK_CUR), 3);
+    ASSERT_EQ(read(reader, buf, sizeof(buf)), 8);
+    ASSERT_EQ(memcmp(buf, "lo world", 8), 0);
+    ASSERT_EQ(lseek(reader, 0, SEEK_END), 11);
+
+    // Writes through the reader go where its reads left the offset.
+    ASSERT_EQ(lseek(reader, 5, SEEK_SET), 5);
+    ASSERT_EQ(read(reader, buf, 1), 1);
+    ASSERT_EQ(write(reader, "W", 1), 1);
+    ASSERT_EQ(pread(writer, buf, sizeof(buf), 0), 11);
+    ASSERT_EQ(memcmp(buf, "jello World", 11), 0);
+
+    // Truncation is seen too.
+    ASSERT_EQ(ftruncate(writer, 2), 0);
+    ASSERT_EQ(pread(reader, buf, sizeof(buf), 0), 2);
+    ASSERT_EQ(lseek(reader, 0, SEEK_END), 2);
+
+    ASSERT_EQ(close(reader), 0);
+    ASSERT_EQ(close(writer), 0);
+    ASSERT_EQ(closedir(d), 0);
+    loop.Shutdown();
+    ASSERT_EQ(memfs_free_filesystem(vfs, 0), ZX_OK);
+
+    END_TEST;
+}
+
 } // namespace
 
 BEGIN_TEST_CASE(memfs_tests)
 RUN_TEST(test_memfs_null)
 RUN_TEST(test_memfs_basic)
 RUN_TEST(test_memfs_close_during_access)
+RUN_TEST(test_memfs_shared_vmo_coherence)
 END_TEST_CASE(memfs_tests)
@@ -0,0 +1,60 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <perftest/perftest.h>
+#include <zircon/syscalls.h>
+
+namespace {
+
+bool EventCreateClose() {
+    zx_handle_t event;
+    return zx_event_create(0u, &event) == ZX_OK && zx_handle_close(event) == ZX_OK;
+}
+
+bool HandleDuplicateClose(perftest::RepeatState* state) {
+    zx_handle_t event;
+    if (zx_event_create(0u, &event) != ZX_OK)
+        return false;
+    bool ok = true;
+    while (state->KeepRunning()) {
+        zx_handle_t dup;
+        if (zx_handle_duplicate(event, ZX_RIGHT_SAME_RIGHTS, &dup) != ZX_OK ||
+            zx_handle_close(dup) != ZX_OK) {
+            ok = false;
+        }
+    }
+    zx_handle_close(event);
+    return ok;
+}
+
+// Waits that don't block: the signal is already up, or the deadline has
+// already passed.
+bool WaitOne(perftest::RepeatState* state, zx_signals_t signals) {
+    zx_handle_t event;
+    if (zx_event_create(0u, &event) != ZX_OK)
+        return false;
+    bool ok = zx_object_signal(event, 0u, ZX_EVENT_SIGNALED) == ZX_OK;
+    while (state->KeepRunning()) {
+        zx_signals_t pending;
+        zx_status_t status = zx_object_wait_one(event, signals, 0u, &pending);
+        if (status != ((signals & ZX_EVENT_SIGNALED) ? ZX_OK : ZX_ERR_TIMED_OUT))
+            ok = false;
+    }
+    zx_handle_close(event);
+    return ok;
+}
+
+void RegisterTests() {
+    perftest::RegisterSimpleTest<EventCreateClose>("Event/CreateClose");
+    perftest::RegisterTest("Handle/DuplicateClose", HandleDuplicateClose);
+    perftest::RegisterTest("WaitOne/Signaled", [](perftest::RepeatState* state) {
+        return WaitOne(state, ZX_EVENT_SIGNALED);
+    });
+    perftest::RegisterTest("WaitOne/TimedOut", [](perftest::RepeatState* state) {
+        return WaitOne(state, ZX_USER_SIGNAL_0);
+    });
+}
+PERFTEST_CTOR(RegisterTests);
+
+} // namespace
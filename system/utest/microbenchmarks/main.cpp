@@ -0,0 +1,10 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <perftest/perftest.h>
+
+// Times of the kernel's basic operations. Each file registers its own tests.
+int main(int argc, char** argv) {
+    return perftest::PerfTestMain(argc, argv);
+}
@@ -0,0 +1,69 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <perftest/perftest.h>
+#include <zircon/device/pty.h>
+
+namespace {
+
+// Moves |Size| bytes through a pty for each iteration, writing as much as it
+// will take and then reading all of it back, so the time per iteration over
+// |Size| is the pty's throughput.
+template <size_t Size, bool FromServer>
+bool PtyThroughput(perftest::RepeatState* state) {
+    int server = open("/dev/misc/ptmx", O_RDWR | O_NONBLOCK);
+    if (server < 0)
+        return false;
+    int client = openat(server, "0", O_RDWR | O_NONBLOCK);
+    if (client < 0) {
+        close(server);
+        return false;
+    }
+    // Output is passed through as is only in raw mode.
+    pty_clr_set_t cs = {.clr = 0, .set = PTY_FEATURE_RAW};
+    bool ok = ioctl_pty_clr_set_feature(client, &cs) == 0;
+
+    int writer = FromServer ? server : client;
+    int reader = FromServer ? client : server;
+    static char buf[Size];
+    memset(buf, 'x', sizeof(buf));
+    while (state->KeepRunning()) {
+        size_t sent = 0;
+        size_t received = 0;
+        while (ok && received < Size) {
+            if (sent < Size) {
+                ssize_t r = write(writer, buf, Size - sent);
+                if (r > 0) {
+                    sent += r;
+                } else if (r < 0 && errno != EAGAIN) {
+                    ok = false;
+                }
+            }
+            ssize_t r = read(reader, buf, sizeof(buf));
+            if (r > 0) {
+                received += r;
+            } else if (r < 0 && errno != EAGAIN) {
+                ok = false;
+            }
+        }
+    }
+    close(client);
+    close(server);
+    return ok;
+}
+
+void RegisterTests() {
+    perftest::RegisterTest("Pty/ServerToClient/512", PtyThroughput<512, true>);
+    perftest::RegisterTest("Pty/ServerToClient/65536", PtyThroughput<65536, true>);
+    perftest::RegisterTest("Pty/ClientToServer/512", PtyThroughput<512, false>);
+    perftest::RegisterTest("Pty/ClientToServer/65536", PtyThroughput<65536, false>);
+}
+PERFTEST_CTOR(RegisterTests);
+
+} // namespace
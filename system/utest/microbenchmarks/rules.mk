@@ -0,0 +1,31 @@
+# Copyright 2018 The Fuchsia Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+MODULE := $(LOCAL_DIR)
+
+MODULE_TYPE := usertest
+
+MODULE_NAME := microbenchmarks
+
+MODULE_SRCS := \
+    $(LOCAL_DIR)/handles.cpp \
+    $(LOCAL_DIR)/main.cpp \
+    $(LOCAL_DIR)/pty.cpp \
+    $(LOCAL_DIR)/syscalls.cpp \
+    $(LOCAL_DIR)/threads.cpp \
+    $(LOCAL_DIR)/vmo.cpp \
+
+MODULE_STATIC_LIBS := \
+    system/ulib/perftest \
+    system/ulib/zxcpp \
+    system/ulib/fbl \
+
+MODULE_LIBS := \
+    system/ulib/c \
+    system/ulib/fdio \
+    system/ulib/zircon \
+
+include make/module.mk
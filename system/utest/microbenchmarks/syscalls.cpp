@@ -0,0 +1,26 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <perftest/perftest.h>
+#include <zircon/syscalls.h>
+
+namespace {
+
+// The cost of getting into the kernel and back.
+bool NullSyscall() {
+    return zx_syscall_test_0() == ZX_OK;
+}
+
+// For comparison, a call that stays in the vDSO.
+bool TicksGet() {
+    return zx_ticks_get() != 0;
+}
+
+void RegisterTests() {
+    perftest::RegisterSimpleTest<NullSyscall>("Syscall/Null");
+    perftest::RegisterSimpleTest<TicksGet>("Vdso/TicksGet");
+}
+PERFTEST_CTOR(RegisterTests);
+
+} // namespace
@@ -0,0 +1,72 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <threads.h>
+
+#include <perftest/perftest.h>
+#include <zircon/syscalls.h>
+
+namespace {
+
+int nothing(void* arg) {
+    return 0;
+}
+
+bool ThreadCreateJoin() {
+    thrd_t thread;
+    if (thrd_create(&thread, nothing, nullptr) != thrd_success)
+        return false;
+    return thrd_join(thread, nullptr) == thrd_success;
+}
+
+// Two threads take turns waking each other through futexes, so each
+// iteration is a round trip of two context switches, or two cross-cpu
+// wakeups if the threads are on different cpus.
+struct PingPong {
+    zx_futex_t futex[2];
+    bool stop;
+};
+
+void futex_signal(zx_futex_t* futex) {
+    __atomic_store_n(futex, 1, __ATOMIC_RELEASE);
+    zx_futex_wake(futex, 1u);
+}
+
+void futex_await(zx_futex_t* futex) {
+    while (__atomic_load_n(futex, __ATOMIC_ACQUIRE) == 0)
+        zx_futex_wait(futex, 0, ZX_TIME_INFINITE);
+    __atomic_store_n(futex, 0, __ATOMIC_RELAXED);
+}
+
+int ping_pong_peer(void* arg) {
+    PingPong* pp = static_cast<PingPong*>(arg);
+    for (;;) {
+        futex_await(&pp->futex[1]);
+        if (__atomic_load_n(&pp->stop, __ATOMIC_ACQUIRE))
+            return 0;
+        futex_signal(&pp->futex[0]);
+    }
+}
+
+bool ContextSwitch(perftest::RepeatState* state) {
+    PingPong pp = {};
+    thrd_t peer;
+    if (thrd_create(&peer, ping_pong_peer, &pp) != thrd_success)
+        return false;
+    while (state->KeepRunning()) {
+        futex_signal(&pp.futex[1]);
+        futex_await(&pp.futex[0]);
+    }
+    __atomic_store_n(&pp.stop, true, __ATOMIC_RELEASE);
+    futex_signal(&pp.futex[1]);
+    return thrd_join(peer, nullptr) == thrd_success;
+}
+
+void RegisterTests() {
+    perftest::RegisterSimpleTest<ThreadCreateJoin>("Thread/CreateJoin");
+    perftest::RegisterTest("ContextSwitch/Futex", ContextSwitch);
+}
+PERFTEST_CTOR(RegisterTests);
+
+} // namespace
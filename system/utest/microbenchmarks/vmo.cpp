@@ -0,0 +1,76 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <limits.h>
+
+#include <perftest/perftest.h>
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+
+namespace {
+
+constexpr size_t kSize = 64 * 1024;
+constexpr uint32_t kMapFlags = ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE;
+
+bool VmoCreateClose() {
+    zx_handle_t vmo;
+    return zx_vmo_create(kSize, 0u, &vmo) == ZX_OK && zx_handle_close(vmo) == ZX_OK;
+}
+
+// Writes to every page of a mapping, so that each one faults.
+void touch_pages(uintptr_t addr) {
+    for (size_t offset = 0; offset < kSize; offset += PAGE_SIZE)
+        *reinterpret_cast<volatile uint8_t*>(addr + offset) = 1;
+}
+
+// Maps a VMO and unmaps it again. With |fault|, each iteration also touches
+// every page, but the pages are only allocated in the first one: the faults
+// after that just map the pages the VMO already has.
+bool VmoMapUnmap(perftest::RepeatState* state, bool fault) {
+    zx_handle_t vmo;
+    if (zx_vmo_create(kSize, 0u, &vmo) != ZX_OK)
+        return false;
+    bool ok = true;
+    while (state->KeepRunning()) {
+        uintptr_t addr;
+        if (zx_vmar_map(zx_vmar_root_self(), 0u, vmo, 0u, kSize, kMapFlags, &addr) != ZX_OK) {
+            ok = false;
+            continue;
+        }
+        if (fault)
+            touch_pages(addr);
+        if (zx_vmar_unmap(zx_vmar_root_self(), addr, kSize) != ZX_OK)
+            ok = false;
+    }
+    zx_handle_close(vmo);
+    return ok;
+}
+
+// Every fault here allocates a fresh zero page.
+bool VmoCreateFaultClose() {
+    zx_handle_t vmo;
+    if (zx_vmo_create(kSize, 0u, &vmo) != ZX_OK)
+        return false;
+    uintptr_t addr;
+    bool ok = zx_vmar_map(zx_vmar_root_self(), 0u, vmo, 0u, kSize, kMapFlags, &addr) == ZX_OK;
+    if (ok) {
+        touch_pages(addr);
+        ok = zx_vmar_unmap(zx_vmar_root_self(), addr, kSize) == ZX_OK;
+    }
+    return zx_handle_close(vmo) == ZX_OK && ok;
+}
+
+void RegisterTests() {
+    perftest::RegisterSimpleTest<VmoCreateClose>("Vmo/CreateClose/64kbytes");
+    perftest::RegisterTest("Vmo/MapUnmap/64kbytes", [](perftest::RepeatState* state) {
+        return VmoMapUnmap(state, false);
+    });
+    perftest::RegisterTest("Vmo/MapFaultUnmap/64kbytes", [](perftest::RepeatState* state) {
+        return VmoMapUnmap(state, true);
+    });
+    perftest::RegisterSimpleTest<VmoCreateFaultClose>("Vmo/CreateMapFaultClose/64kbytes");
+}
+PERFTEST_CTOR(RegisterTests);
+
+} // namespace
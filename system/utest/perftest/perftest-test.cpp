@@ -0,0 +1,98 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <perftest/perftest.h>
+#include <unittest/unittest.h>
+#include <zircon/syscalls.h>
+
+namespace {
+
+bool summary_test() {
+    BEGIN_TEST;
+
+    uint64_t times[] = {40, 10, 30, 20};
+    perftest::Summary s;
+    perftest::Summarize(times, 4, &s);
+    EXPECT_EQ(4u, s.iterations);
+    EXPECT_EQ(10.0, s.min);
+    EXPECT_EQ(40.0, s.max);
+    EXPECT_EQ(25.0, s.mean);
+    EXPECT_EQ(25.0, s.median);
+    EXPECT_EQ(40.0, s.p99);
+    EXPECT_GT(s.std_dev, 11.18);
+    EXPECT_LT(s.std_dev, 11.19);
+
+    END_TEST;
+}
+
+bool iteration_count_test() {
+    BEGIN_TEST;
+
+    perftest::RunOptions options;
+    options.warmup_time = ZX_MSEC(1);
+    options.target_time = ZX_MSEC(1);
+    options.min_iterations = 5;
+    options.max_iterations = 7;
+
+    // However quick the test, it runs no more than |max_iterations| timed.
+    uint64_t count = 0;
+    perftest::TestFunc count_iterations = [&count](perftest::RepeatState* state) {
+        count = 0;
+        while (state->KeepRunning())
+            count++;
+        return true;
+    };
+    perftest::Summary s;
+    ASSERT_TRUE(perftest::RunTest(&count_iterations, options, &s));
+    EXPECT_EQ(7u, s.iterations);
+    EXPECT_EQ(7u, count);
+
+    // And however slow, at least |min_iterations|.
+    perftest::TestFunc slow = [&count](perftest::RepeatState* state) {
+        count = 0;
+        while (state->KeepRunning()) {
+            zx_nanosleep(zx_deadline_after(ZX_MSEC(1)));
+            count++;
+        }
+        return true;
+    };
+    ASSERT_TRUE(perftest::RunTest(&slow, options, &s));
+    EXPECT_EQ(5u, s.iterations);
+    EXPECT_EQ(5u, count);
+    EXPECT_GE(s.min, static_cast<double>(ZX_MSEC(1)));
+
+    END_TEST;
+}
+
+bool failure_test() {
+    BEGIN_TEST;
+
+    perftest::RunOptions options;
+    options.warmup_time = ZX_MSEC(1);
+    options.target_time = ZX_MSEC(1);
+    perftest::Summary s;
+
+    perftest::TestFunc fails = [](perftest::RepeatState* state) {
+        while (state->KeepRunning()) {}
+        return false;
+    };
+    EXPECT_FALSE(perftest::RunTest(&fails, options, &s));
+
+    // Stopping before KeepRunning() says to is a failure too.
+    perftest::TestFunc returns_early = [](perftest::RepeatState* state) {
+        state->KeepRunning();
+        return true;
+    };
+    EXPECT_FALSE(perftest::RunTest(&returns_early, options, &s));
+
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(perftest_tests)
+RUN_TEST(summary_test)
+RUN_TEST(iteration_count_test)
+RUN_TEST(failure_test)
+END_TEST_CASE(perftest_tests)
@@ -160,6 +160,51 @@ static bool invalid_calls_rel() {
     END_TEST;
 }
 
+static bool timer_slack_policy() {
+    BEGIN_TEST;
+
+    auto job = make_job();
+
+    zx_policy_timer_slack_t slack = { ZX_MSEC(1), ZX_TIMER_SLACK_LATE };
+    EXPECT_EQ(job.set_policy(ZX_JOB_POL_ABSOLUTE, ZX_JOB_POL_TIMER_SLACK, &slack, 1u), ZX_OK);
+
+    // Only one entry is accepted.
+    zx_policy_timer_slack_t two[] = { slack, slack };
+    EXPECT_EQ(job.set_policy(ZX_JOB_POL_ABSOLUTE, ZX_JOB_POL_TIMER_SLACK, two, 2u),
+              ZX_ERR_INVALID_ARGS);
+
+    // The same again will succeed, the slack is kept as a power of two so
+    // anything that rounds to the same is the same.
+    slack.min_slack = ZX_MSEC(1) + 1;
+    EXPECT_EQ(job.set_policy(ZX_JOB_POL_ABSOLUTE, ZX_JOB_POL_TIMER_SLACK, &slack, 1u), ZX_OK);
+
+    // A contradictory policy should fail, unless it is relative.
+    slack.min_slack = ZX_MSEC(10);
+    EXPECT_EQ(job.set_policy(ZX_JOB_POL_ABSOLUTE, ZX_JOB_POL_TIMER_SLACK, &slack, 1u),
+              ZX_ERR_ALREADY_EXISTS);
+    EXPECT_EQ(job.set_policy(ZX_JOB_POL_RELATIVE, ZX_JOB_POL_TIMER_SLACK, &slack, 1u), ZX_OK);
+
+    slack.default_mode = 100u;
+    EXPECT_EQ(job.set_policy(ZX_JOB_POL_RELATIVE, ZX_JOB_POL_TIMER_SLACK, &slack, 1u),
+              ZX_ERR_INVALID_ARGS);
+
+    // The slack policy doesn't get in the way of the basic one.
+    zx_policy_basic_t basic[] = { { ZX_POL_NEW_EVENT, ZX_POL_ACTION_DENY } };
+    EXPECT_EQ(job.set_policy(ZX_JOB_POL_ABSOLUTE, ZX_JOB_POL_BASIC, basic, 1u), ZX_OK);
+
+    zx_handle_t ctrl;
+    auto proc = make_test_process(job, nullptr, &ctrl);
+    ASSERT_TRUE(proc.is_valid());
+    ASSERT_NE(ctrl, ZX_HANDLE_INVALID);
+
+    zx_handle_t obj;
+    EXPECT_EQ(mini_process_cmd(ctrl, MINIP_CMD_CREATE_EVENT, &obj), ZX_ERR_ACCESS_DENIED);
+    EXPECT_EQ(mini_process_cmd(ctrl, MINIP_CMD_EXIT_NORMAL, nullptr), ZX_ERR_PEER_CLOSED);
+    zx_handle_close(ctrl);
+
+    END_TEST;
+}
+
 // Test that executing the given mini-process.h command (|minip_cmd|)
 // produces the given result (|expect|) when the given policy is in force.
 static bool test_invoking_policy(
@@ -420,6 +465,7 @@ BEGIN_TEST_CASE(job_policy)
 RUN_TEST(invalid_calls_abs)
 RUN_TEST(invalid_calls_rel)
 RUN_TEST(abs_then_rel)
+RUN_TEST(timer_slack_policy)
 RUN_TEST(enforce_deny_event)
 RUN_TEST(enforce_deny_channel)
 RUN_TEST(enforce_deny_any)
@@ -103,16 +103,20 @@ static bool pty_test(void) {
     ASSERT_EQ(memcmp(tmp, "xyzzy", 5), 0, "");
     ASSERT_EQ(fd_signals(ps), POLLOUT, "");
 
-    // write server until full, then drain
-    ASSERT_EQ(write_full(ps), 4096, "");
+    // write server until full, growing the fifo to its largest, then drain
+    ASSERT_EQ(write_full(ps), 65536, "");
     ASSERT_EQ(fd_signals(ps), 0, "");
-    ASSERT_EQ(read_all(pc), 4096, "");
+    // the writer is only woken once the fifo is half empty
+    char drain[4096];
+    ASSERT_EQ(read(pc, drain, sizeof(drain)), (ssize_t)sizeof(drain), "");
+    ASSERT_EQ(fd_signals(ps), 0, "");
+    ASSERT_EQ(read_all(pc), 65536 - (int)sizeof(drain), "");
     ASSERT_EQ(fd_signals(ps), POLLOUT, "");
 
     // write client until full, then drain
-    ASSERT_EQ(write_full(pc), 4096, "");
+    ASSERT_EQ(write_full(pc), 65536, "");
     ASSERT_EQ(fd_signals(pc), 0, "");
-    ASSERT_EQ(read_all(ps), 4096, "");
+    ASSERT_EQ(read_all(ps), 65536, "");
     ASSERT_EQ(fd_signals(pc), POLLOUT, "");
 
     // verify no events pending
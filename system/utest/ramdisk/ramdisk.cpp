@@ -18,6 +18,7 @@
 #include <block-client/client.h>
 #include <fs-management/ramdisk.h>
 #include <zircon/device/block.h>
+#include <zircon/device/device.h>
 #include <zircon/device/ramdisk.h>
 #include <zircon/syscalls.h>
 #include <fbl/algorithm.h>
@@ -232,6 +233,41 @@ bool ramdisk_test_bad_requests(void) {
     END_TEST;
 }
 
+bool ramdisk_test_workers(void) {
+    uint8_t buf[PAGE_SIZE];
+    uint8_t out[PAGE_SIZE];
+
+    BEGIN_TEST;
+    int fd = get_ramdisk(PAGE_SIZE, 512);
+
+    uint32_t workers = 0;
+    ASSERT_LT(ioctl_ramdisk_set_workers(fd, &workers), 0);
+    workers = RAMDISK_MAX_WORKERS + 1;
+    ASSERT_LT(ioctl_ramdisk_set_workers(fd, &workers), 0);
+
+    // Data written with one width reads back the same with another
+    const uint32_t kWidths[] = {1, RAMDISK_MAX_WORKERS, 2};
+    for (size_t i = 0; i < fbl::count_of(kWidths); i++) {
+        workers = kWidths[i];
+        ASSERT_GE(ioctl_ramdisk_set_workers(fd, &workers), 0);
+
+        memset(buf, 'a' + static_cast<int>(i), sizeof(buf));
+        ASSERT_EQ(lseek(fd, i * PAGE_SIZE, SEEK_SET), static_cast<off_t>(i * PAGE_SIZE));
+        ASSERT_EQ(write(fd, buf, sizeof(buf)), (ssize_t)sizeof(buf));
+        ASSERT_GE(ioctl_device_sync(fd), 0);
+    }
+    for (size_t i = 0; i < fbl::count_of(kWidths); i++) {
+        memset(buf, 'a' + static_cast<int>(i), sizeof(buf));
+        ASSERT_EQ(lseek(fd, i * PAGE_SIZE, SEEK_SET), static_cast<off_t>(i * PAGE_SIZE));
+        ASSERT_EQ(read(fd, out, sizeof(out)), (ssize_t)sizeof(out));
+        ASSERT_EQ(memcmp(out, buf, sizeof(out)), 0);
+    }
+
+    ASSERT_GE(ioctl_ramdisk_unlink(fd), 0, "Could not unlink ramdisk device");
+    close(fd);
+    END_TEST;
+}
+
 bool ramdisk_test_release_during_access(void) {
     BEGIN_TEST;
     int fd = get_ramdisk(PAGE_SIZE, 512);
@@ -463,6 +499,88 @@ bool ramdisk_test_fifo_basic(void) {
     END_TEST;
 }
 
+bool ramdisk_test_fifo_trim(void) {
+    BEGIN_TEST;
+    int fd = get_ramdisk(512, 64);
+    block_info_t info;
+    ASSERT_GE(ioctl_block_get_info(fd, &info), 0);
+    ASSERT_NE(info.flags & BLOCK_FLAG_TRIM_SUPPORT, 0u, "Ramdisk should accept trims");
+
+    zx_handle_t fifo;
+    ssize_t expected = sizeof(fifo);
+    ASSERT_EQ(ioctl_block_get_fifos(fd, &fifo), expected, "Failed to get FIFO");
+    txnid_t txnid;
+    expected = sizeof(txnid_t);
+    ASSERT_EQ(ioctl_block_alloc_txn(fd, &txnid), expected, "Failed to allocate txn");
+
+    uint64_t vmo_size = PAGE_SIZE * 3;
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(vmo_size, 0, &vmo), ZX_OK, "Failed to create VMO");
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> buf(new (&ac) uint8_t[vmo_size]);
+    ASSERT_TRUE(ac.check());
+    fill_random(buf.get(), vmo_size);
+    size_t actual;
+    ASSERT_EQ(zx_vmo_write(vmo, buf.get(), 0, vmo_size, &actual), ZX_OK);
+
+    vmoid_t vmoid;
+    expected = sizeof(vmoid_t);
+    zx_handle_t xfer_vmo;
+    ASSERT_EQ(zx_handle_duplicate(vmo, ZX_RIGHT_SAME_RIGHTS, &xfer_vmo), ZX_OK);
+    ASSERT_EQ(ioctl_block_attach_vmo(fd, &xfer_vmo, &vmoid), expected, "Failed to attach vmo");
+
+    fifo_client_t* client;
+    ASSERT_EQ(block_fifo_create_client(fifo, &client), ZX_OK);
+    block_fifo_request_t request;
+    request.txnid      = txnid;
+    request.vmoid      = vmoid;
+    request.opcode     = BLOCKIO_WRITE;
+    request.length     = vmo_size;
+    request.vmo_offset = 0;
+    request.dev_offset = 0;
+    ASSERT_EQ(block_fifo_txn(client, &request, 1), ZX_OK);
+
+    // Trim a range which starts and ends partway through pages. Trims don't
+    // use a vmo.
+    const uint64_t trim_offset = PAGE_SIZE / 2;
+    const uint64_t trim_length = PAGE_SIZE + 512;
+    request.vmoid      = VMOID_INVALID;
+    request.opcode     = BLOCKIO_TRIM;
+    request.length     = trim_length;
+    request.dev_offset = trim_offset;
+    ASSERT_EQ(block_fifo_txn(client, &request, 1), ZX_OK);
+
+    // Trims must cover whole blocks.
+    request.length     = 100;
+    ASSERT_EQ(block_fifo_txn(client, &request, 1), ZX_ERR_INVALID_ARGS);
+
+    // A ramdisk reads trimmed blocks back as zeroes, and leaves the rest.
+    memset(buf.get() + trim_offset, 0, trim_length);
+    fbl::unique_ptr<uint8_t[]> out(new (&ac) uint8_t[vmo_size]());
+    ASSERT_TRUE(ac.check());
+    ASSERT_EQ(zx_vmo_write(vmo, out.get(), 0, vmo_size, &actual), ZX_OK);
+    request.vmoid      = vmoid;
+    request.opcode     = BLOCKIO_READ;
+    request.length     = vmo_size;
+    request.dev_offset = 0;
+    ASSERT_EQ(block_fifo_txn(client, &request, 1), ZX_OK);
+    ASSERT_EQ(zx_vmo_read(vmo, out.get(), 0, vmo_size, &actual), ZX_OK);
+    ASSERT_EQ(memcmp(buf.get(), out.get(), vmo_size), 0, "Trim changed the wrong blocks");
+
+    block_fifo_stats_t stats;
+    ASSERT_GE(ioctl_block_fifo_get_stats(fd, &stats), 0);
+    EXPECT_EQ(stats.trims, 1u);
+    EXPECT_EQ(stats.bytes_trimmed, trim_length);
+
+    request.opcode = BLOCKIO_CLOSE_VMO;
+    ASSERT_EQ(block_fifo_txn(client, &request, 1), ZX_OK);
+    ASSERT_EQ(zx_handle_close(vmo), ZX_OK);
+    block_fifo_release_client(client);
+    ASSERT_GE(ioctl_ramdisk_unlink(fd), 0, "Could not unlink ramdisk device");
+    ASSERT_EQ(close(fd), 0);
+    END_TEST;
+}
+
 typedef struct {
     uint64_t vmo_size;
     zx_handle_t vmo;
@@ -1133,11 +1251,13 @@ RUN_TEST_SMALL(ramdisk_test_vmo)
 RUN_TEST_SMALL(ramdisk_test_filesystem)
 RUN_TEST_SMALL(ramdisk_test_rebind)
 RUN_TEST_SMALL(ramdisk_test_bad_requests)
+RUN_TEST_SMALL(ramdisk_test_workers)
 RUN_TEST_SMALL(ramdisk_test_release_during_access)
 RUN_TEST_SMALL(ramdisk_test_release_during_fifo_access)
 RUN_TEST_SMALL(ramdisk_test_multiple)
 RUN_TEST_SMALL(ramdisk_test_fifo_no_op)
 RUN_TEST_SMALL(ramdisk_test_fifo_basic)
+RUN_TEST_SMALL(ramdisk_test_fifo_trim)
 RUN_TEST_SMALL(ramdisk_test_fifo_multiple_vmo)
 RUN_TEST_SMALL(ramdisk_test_fifo_multiple_vmo_multithreaded)
 // TODO(smklein): Test ops across different vmos
@@ -2,9 +2,11 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <inttypes.h>
 #include <region-alloc/region-alloc.h>
 #include <stdio.h>
 #include <unittest/unittest.h>
+#include <zircon/syscalls.h>
 
 #include "common.h"
 
@@ -235,6 +237,167 @@ static bool ralloc_subtract_test() {
     END_TEST;
 }
 
+static bool ralloc_get_regions_test() {
+    BEGIN_TEST;
+
+    RegionAllocator alloc(RegionAllocator::RegionPool::Create(REGION_POOL_MAX_SIZE));
+    ASSERT_EQ(ZX_OK, alloc.AddRegion({ .base = 0x10000, .size = 0x10000 }));
+
+    // A batch which fits should be satisfied in order.
+    static const RegionAllocator::SizeRequest GOOD_BATCH[] = {
+        { .size = 0x1000, .alignment = 0x1000 },
+        { .size = 0x100,  .alignment = 0x100  },
+        { .size = 0x2000, .alignment = 0x2000 },
+        { .size = 1,      .alignment = 1      },
+    };
+    {
+        RegionAllocator::Region::UPtr regions[fbl::count_of(GOOD_BATCH)];
+        ASSERT_EQ(ZX_OK, alloc.GetRegions(GOOD_BATCH, fbl::count_of(GOOD_BATCH), regions));
+        EXPECT_EQ(fbl::count_of(GOOD_BATCH), alloc.AllocatedRegionCount());
+
+        for (size_t i = 0; i < fbl::count_of(GOOD_BATCH); ++i) {
+            ASSERT_NONNULL(regions[i]);
+            EXPECT_EQ(GOOD_BATCH[i].size, regions[i]->size);
+            EXPECT_EQ(0u, regions[i]->base & (GOOD_BATCH[i].alignment - 1));
+        }
+    }
+
+    // Everything went back when the regions went out of scope.
+    EXPECT_EQ(0u, alloc.AllocatedRegionCount());
+    EXPECT_EQ(1u, alloc.AvailableRegionCount());
+
+    // A batch whose last request can't be satisfied should leave the
+    // allocator as it found it.
+    static const RegionAllocator::SizeRequest BAD_BATCH[] = {
+        { .size = 0x1000,  .alignment = 0x1000 },
+        { .size = 0x3,     .alignment = 0x100  },
+        { .size = 0x10000, .alignment = 1      },
+    };
+    {
+        RegionAllocator::Region::UPtr regions[fbl::count_of(BAD_BATCH)];
+        EXPECT_EQ(ZX_ERR_NOT_FOUND,
+                  alloc.GetRegions(BAD_BATCH, fbl::count_of(BAD_BATCH), regions));
+        for (size_t i = 0; i < fbl::count_of(BAD_BATCH); ++i)
+            EXPECT_NULL(regions[i]);
+    }
+    EXPECT_EQ(0u, alloc.AllocatedRegionCount());
+    EXPECT_EQ(1u, alloc.AvailableRegionCount());
+
+    // Bad arguments anywhere in the batch fail the whole batch.
+    static const RegionAllocator::SizeRequest INVALID_BATCH[] = {
+        { .size = 0x1000, .alignment = 0x1000 },
+        { .size = 0x1000, .alignment = 0x1001 },
+    };
+    {
+        RegionAllocator::Region::UPtr regions[fbl::count_of(INVALID_BATCH)];
+        EXPECT_EQ(ZX_ERR_INVALID_ARGS,
+                  alloc.GetRegions(INVALID_BATCH, fbl::count_of(INVALID_BATCH), regions));
+        EXPECT_NULL(regions[0]);
+    }
+    EXPECT_EQ(0u, alloc.AllocatedRegionCount());
+    EXPECT_EQ(1u, alloc.AvailableRegionCount());
+
+    END_TEST;
+}
+
+// Adds |count| 64KB regions to |alloc|, each starting 4KB past a 1MB
+// boundary, so none of them can hold anything which must be 1MB aligned.
+static bool add_misaligned_fragments(RegionAllocator* alloc, size_t count) {
+    BEGIN_HELPER;
+    for (size_t i = 0; i < count; ++i) {
+        ralloc_region_t region = { .base = (i << 20) + 0x1000, .size = 0x10000 };
+        ASSERT_EQ(ZX_OK, alloc->AddRegion(region));
+    }
+    END_HELPER;
+}
+
+static bool ralloc_aligned_fragmented_test() {
+    BEGIN_TEST;
+
+    // Lots of regions which are large enough but can't be aligned, and one at
+    // the end which can.  The aligned request must find the last one.
+    static constexpr size_t FRAGMENTS = 1000;
+    RegionAllocator alloc(RegionAllocator::RegionPool::Create(256 << 10));
+    ASSERT_TRUE(add_misaligned_fragments(&alloc, FRAGMENTS));
+    ASSERT_EQ(ZX_OK, alloc.AddRegion({ .base = FRAGMENTS << 20, .size = 1 << 20 }));
+
+    RegionAllocator::Region::UPtr region;
+    ASSERT_EQ(ZX_OK, alloc.GetRegion(0x1000, 1 << 20, region));
+    ASSERT_NONNULL(region);
+    EXPECT_EQ(FRAGMENTS << 20, region->base);
+
+    // With that space taken, there is nothing left with the alignment.
+    RegionAllocator::Region::UPtr none;
+    EXPECT_EQ(ZX_ERR_NOT_FOUND, alloc.GetRegion(0x1000, 1 << 20, none));
+
+    // Smaller alignments still come from the best fitting fragment.
+    RegionAllocator::Region::UPtr small;
+    ASSERT_EQ(ZX_OK, alloc.GetRegion(0x10000, 0x1000, small));
+    ASSERT_NONNULL(small);
+    EXPECT_EQ(0x1000u, small->base);
+
+    END_TEST;
+}
+
+static zx_time_t ticks_to_ns(uint64_t ticks) {
+    return static_cast<zx_time_t>(
+            static_cast<__uint128_t>(ticks) * ZX_SEC(1) / zx_ticks_per_second());
+}
+
+// Not a pass/fail test; reports how the cost of allocation grows with the
+// number of available regions, for aligned requests which most of those
+// regions cannot satisfy, and for batched versus individual allocation.
+static bool ralloc_scaling_benchmark() {
+    BEGIN_TEST;
+
+    static const size_t FRAGMENT_COUNTS[] = { 100, 1000, 10000 };
+    static constexpr size_t ITERATIONS = 1000;
+    static constexpr size_t BATCH = 256;
+
+    for (size_t i = 0; i < fbl::count_of(FRAGMENT_COUNTS); ++i) {
+        size_t count = FRAGMENT_COUNTS[i];
+        RegionAllocator alloc(RegionAllocator::RegionPool::Create(4 << 20));
+        ASSERT_TRUE(add_misaligned_fragments(&alloc, count));
+        ASSERT_EQ(ZX_OK, alloc.AddRegion({ .base = count << 20, .size = 1 << 20 }));
+
+        // Aligned allocations which only the last region can satisfy.  Each
+        // is returned before the next, so the tree doesn't change shape.
+        uint64_t ticks = zx_ticks_get();
+        for (size_t j = 0; j < ITERATIONS; ++j) {
+            RegionAllocator::Region::UPtr region = alloc.GetRegion(0x1000, 1 << 20);
+            ASSERT_NONNULL(region);
+        }
+        ticks = zx_ticks_get() - ticks;
+        unittest_printf("%6zu regions: %8" PRId64 " ns per aligned GetRegion\n",
+                        count, ticks_to_ns(ticks) / ITERATIONS);
+
+        // BATCH small allocations, one call at a time and then all at once.
+        RegionAllocator::Region::UPtr regions[BATCH];
+        ticks = zx_ticks_get();
+        for (size_t j = 0; j < BATCH; ++j) {
+            ASSERT_EQ(ZX_OK, alloc.GetRegion(0x100, 0x100, regions[j]));
+        }
+        ticks = zx_ticks_get() - ticks;
+        for (size_t j = 0; j < BATCH; ++j)
+            regions[j].reset();
+        unittest_printf("%6zu regions: %8" PRId64 " ns for %zu GetRegion calls\n",
+                        count, ticks_to_ns(ticks), BATCH);
+
+        RegionAllocator::SizeRequest requests[BATCH];
+        for (size_t j = 0; j < BATCH; ++j)
+            requests[j] = { .size = 0x100, .alignment = 0x100 };
+        ticks = zx_ticks_get();
+        ASSERT_EQ(ZX_OK, alloc.GetRegions(requests, BATCH, regions));
+        ticks = zx_ticks_get() - ticks;
+        for (size_t j = 0; j < BATCH; ++j)
+            regions[j].reset();
+        unittest_printf("%6zu regions: %8" PRId64 " ns for one GetRegions of %zu\n",
+                        count, ticks_to_ns(ticks), BATCH);
+    }
+
+    END_TEST;
+}
+
 } //namespace
 
 BEGIN_TEST_CASE(ralloc_tests)
@@ -243,4 +406,7 @@ RUN_NAMED_TEST("Alloc by size",  ralloc_by_size_test)
 RUN_NAMED_TEST("Alloc specific", ralloc_specific_test)
 RUN_NAMED_TEST("Add/Overlap",    ralloc_add_overlap_test)
 RUN_NAMED_TEST("Subtract",       ralloc_subtract_test)
+RUN_NAMED_TEST("Get regions",    ralloc_get_regions_test)
+RUN_NAMED_TEST("Aligned, fragmented", ralloc_aligned_fragmented_test)
+RUN_NAMED_TEST("Scaling benchmark",   ralloc_scaling_benchmark)
 END_TEST_CASE(ralloc_tests)
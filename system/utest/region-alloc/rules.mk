@@ -23,6 +23,7 @@ MODULE_STATIC_LIBS := \
 MODULE_LIBS := \
     system/ulib/c \
     system/ulib/fdio \
-    system/ulib/unittest
+    system/ulib/unittest \
+    system/ulib/zircon
 
 include make/module.mk
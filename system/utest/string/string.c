@@ -0,0 +1,283 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <inttypes.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unittest/unittest.h>
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+
+// The vector versions read whole aligned blocks, so every routine is run
+// against buffers placed flush against unmapped pages on both sides.
+typedef struct {
+    zx_handle_t vmar;
+    uint8_t* page;
+} guarded_page;
+
+static bool guarded_page_init(guarded_page* g) {
+    zx_handle_t vmo;
+    uintptr_t base, addr;
+    if (zx_vmo_create(PAGE_SIZE, 0, &vmo) != ZX_OK)
+        return false;
+    zx_status_t status = zx_vmar_allocate(zx_vmar_root_self(), 0, 3 * PAGE_SIZE,
+                                          ZX_VM_FLAG_CAN_MAP_READ | ZX_VM_FLAG_CAN_MAP_WRITE |
+                                              ZX_VM_FLAG_CAN_MAP_SPECIFIC,
+                                          &g->vmar, &base);
+    if (status == ZX_OK) {
+        status = zx_vmar_map(g->vmar, PAGE_SIZE, vmo, 0, PAGE_SIZE,
+                             ZX_VM_FLAG_SPECIFIC | ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE,
+                             &addr);
+        if (status != ZX_OK)
+            zx_handle_close(g->vmar);
+    }
+    zx_handle_close(vmo);
+    if (status != ZX_OK)
+        return false;
+    g->page = (uint8_t*)addr;
+    return true;
+}
+
+static void guarded_page_destroy(guarded_page* g) {
+    zx_vmar_destroy(g->vmar);
+    zx_handle_close(g->vmar);
+}
+
+// Byte-at-a-time references. The volatile accesses keep the compiler from
+// turning these loops back into calls to the routines under test.
+static size_t ref_strlen(const char* s) {
+    const volatile char* p = s;
+    size_t n = 0;
+    while (p[n])
+        n++;
+    return n;
+}
+
+static const void* ref_memchr(const void* m, int c, size_t n) {
+    const volatile uint8_t* p = m;
+    for (size_t i = 0; i < n; i++) {
+        if (p[i] == (uint8_t)c)
+            return (const uint8_t*)m + i;
+    }
+    return NULL;
+}
+
+static const void* ref_memrchr(const void* m, int c, size_t n) {
+    const volatile uint8_t* p = m;
+    while (n--) {
+        if (p[n] == (uint8_t)c)
+            return (const uint8_t*)m + n;
+    }
+    return NULL;
+}
+
+static int ref_memcmp(const void* a, const void* b, size_t n) {
+    const volatile uint8_t* l = a;
+    const volatile uint8_t* r = b;
+    for (size_t i = 0; i < n; i++) {
+        if (l[i] != r[i])
+            return l[i] - r[i];
+    }
+    return 0;
+}
+
+static int ref_strcmp(const char* a, const char* b) {
+    const volatile uint8_t* l = (const uint8_t*)a;
+    const volatile uint8_t* r = (const uint8_t*)b;
+    size_t i = 0;
+    while (l[i] && l[i] == r[i])
+        i++;
+    return l[i] - r[i];
+}
+
+static const char* ref_strchr(const char* s, int c) {
+    const volatile char* p = s;
+    for (size_t i = 0;; i++) {
+        if (p[i] == (char)c)
+            return s + i;
+        if (!p[i])
+            return NULL;
+    }
+}
+
+static int sign(int x) {
+    return (x > 0) - (x < 0);
+}
+
+// Fills |len| bytes from a small alphabet so matches and mismatches are
+// both common, and terminates the string.
+static void fill(uint8_t* p, size_t len) {
+    for (size_t i = 0; i < len; i++)
+        p[i] = (uint8_t)(1 + rand() % 4);
+    p[len] = 0;
+}
+
+// Picks a spot for a |len| byte string plus terminator: against the end of
+// the page, against its start, or at a random offset near either.
+static uint8_t* place(uint8_t* page, size_t len) {
+    size_t max = PAGE_SIZE - len - 1;
+    switch (rand() % 4) {
+    case 0:
+        return page + max;
+    case 1:
+        return page;
+    case 2:
+        return page + max - rand() % (max < 64 ? max + 1 : 64);
+    default:
+        return page + rand() % (max < 64 ? max + 1 : 64);
+    }
+}
+
+static int pick_char(void) {
+    // Mostly present, sometimes the terminator, sometimes only the low byte
+    // matches.
+    switch (rand() % 8) {
+    case 0:
+        return 0;
+    case 1:
+        return 0x100 | (1 + rand() % 4);
+    default:
+        return rand() % 6;
+    }
+}
+
+static bool search_fuzz_test(void) {
+    BEGIN_TEST;
+
+    guarded_page g;
+    ASSERT_TRUE(guarded_page_init(&g), "");
+    srand(1);
+
+    for (int i = 0; i < 100000; i++) {
+        size_t len = (i & 1) ? rand() % 300 : rand() % (PAGE_SIZE - 1);
+        uint8_t* s = place(g.page, len);
+        fill(s, len);
+        int c = pick_char();
+        size_t n = rand() % (len + 1);
+
+        ASSERT_EQ(strlen((char*)s), ref_strlen((char*)s), "strlen");
+        ASSERT_EQ(memchr(s, c, n), ref_memchr(s, c, n), "memchr");
+        ASSERT_EQ(memrchr(s, c, n), ref_memrchr(s, c, n), "memrchr");
+        ASSERT_EQ(strchr((char*)s, c), ref_strchr((char*)s, c), "strchr");
+        const char* nul = ref_strchr((char*)s, c);
+        ASSERT_EQ(strchrnul((char*)s, c), nul ? nul : (char*)s + len, "strchrnul");
+    }
+
+    guarded_page_destroy(&g);
+
+    END_TEST;
+}
+
+static bool compare_fuzz_test(void) {
+    BEGIN_TEST;
+
+    guarded_page a, b;
+    ASSERT_TRUE(guarded_page_init(&a), "");
+    ASSERT_TRUE(guarded_page_init(&b), "");
+    srand(2);
+
+    for (int i = 0; i < 100000; i++) {
+        size_t len = (i & 1) ? rand() % 300 : rand() % (PAGE_SIZE - 1);
+        uint8_t* l = place(a.page, len);
+        fill(l, len);
+
+        // Mostly a copy with at most one difference, so the comparison has
+        // to look at a long common prefix.
+        size_t len2 = (rand() % 4) ? len : rand() % 300;
+        uint8_t* r = place(b.page, len2);
+        fill(r, len2);
+        memmove(r, l, len < len2 ? len : len2);
+        if (len2 && rand() % 2)
+            r[rand() % len2] = (uint8_t)(1 + rand() % 4);
+        if (len2 && rand() % 8 == 0)
+            r[rand() % len2] = 0x80;
+
+        size_t min = len < len2 ? len : len2;
+        size_t n = rand() % (min + 1);
+        ASSERT_EQ(sign(memcmp(l, r, n)), sign(ref_memcmp(l, r, n)), "memcmp");
+        ASSERT_EQ(sign(strcmp((char*)l, (char*)r)), sign(ref_strcmp((char*)l, (char*)r)),
+                  "strcmp");
+    }
+
+    guarded_page_destroy(&b);
+    guarded_page_destroy(&a);
+
+    END_TEST;
+}
+
+// Reports throughput of the routines on a long buffer. Nothing is asserted;
+// this is here to catch regressions by eye.
+static bool speed_test(void) {
+    BEGIN_TEST;
+
+    const size_t len = 1 << 20;
+    char* s = malloc(len + 1);
+    char* t = malloc(len + 1);
+    ASSERT_NONNULL(s, "");
+    ASSERT_NONNULL(t, "");
+    memset(s, 'a', len);
+    s[len] = 0;
+    memcpy(t, s, len + 1);
+
+    const int kIters = 100;
+    zx_time_t start, elapsed[6];
+    volatile size_t sink = 0;
+
+    start = zx_time_get(ZX_CLOCK_MONOTONIC);
+    for (int i = 0; i < kIters; i++)
+        sink += strlen(s);
+    elapsed[0] = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+
+    start = zx_time_get(ZX_CLOCK_MONOTONIC);
+    for (int i = 0; i < kIters; i++)
+        sink += (uintptr_t)memchr(s, 'b', len);
+    elapsed[1] = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+
+    start = zx_time_get(ZX_CLOCK_MONOTONIC);
+    for (int i = 0; i < kIters; i++)
+        sink += (uintptr_t)memrchr(s, 'b', len);
+    elapsed[2] = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+
+    start = zx_time_get(ZX_CLOCK_MONOTONIC);
+    for (int i = 0; i < kIters; i++)
+        sink += (uintptr_t)strchr(s, 'b');
+    elapsed[3] = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+
+    start = zx_time_get(ZX_CLOCK_MONOTONIC);
+    for (int i = 0; i < kIters; i++)
+        sink += memcmp(s, t, len);
+    elapsed[4] = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+
+    start = zx_time_get(ZX_CLOCK_MONOTONIC);
+    for (int i = 0; i < kIters; i++)
+        sink += strcmp(s, t);
+    elapsed[5] = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+
+    static const char* const kNames[] = {
+        "strlen", "memchr", "memrchr", "strchr", "memcmp", "strcmp",
+    };
+    unittest_printf_critical("\n");
+    for (size_t i = 0; i < countof(kNames); i++) {
+        // Bytes per microsecond is MB/s.
+        uint64_t mbps = elapsed[i] ? (uint64_t)len * kIters * 1000 / elapsed[i] : 0;
+        unittest_printf_critical("    %-8s %" PRIu64 " MB/s\n", kNames[i], mbps);
+    }
+
+    free(t);
+    free(s);
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(string_tests)
+RUN_TEST(search_fuzz_test)
+RUN_TEST(compare_fuzz_test)
+RUN_TEST(speed_test)
+END_TEST_CASE(string_tests)
+
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
@@ -0,0 +1,206 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <trace-reader/indexed_reader.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <fbl/atomic.h>
+#include <fbl/vector.h>
+#include <trace-engine/fields.h>
+#include <unittest/unittest.h>
+
+namespace {
+
+constexpr size_t kNumEvents = 1000u;
+
+uint64_t MakeHeader(trace::RecordType type, size_t num_words) {
+    return trace::RecordFields::Type::Make(trace::ToUnderlyingType(type)) |
+           trace::RecordFields::RecordSize::Make(num_words);
+}
+
+void AppendString(fbl::Vector<uint64_t>* words, trace_string_index_t index,
+                  const char* string) {
+    size_t length = strlen(string);
+    ZX_DEBUG_ASSERT(length <= sizeof(uint64_t));
+    uint64_t data = 0u;
+    memcpy(&data, string, length);
+    words->push_back(MakeHeader(trace::RecordType::kString, 2u) |
+                     trace::StringRecordFields::StringIndex::Make(index) |
+                     trace::StringRecordFields::StringLength::Make(length));
+    words->push_back(data);
+}
+
+// Builds a trace which defines its strings and thread once up front and then
+// has |kNumEvents| duration begin events whose timestamps count up from 0.
+void BuildTrace(fbl::Vector<uint64_t>* words) {
+    AppendString(words, 1u, "cat");
+    AppendString(words, 2u, "name");
+    words->push_back(MakeHeader(trace::RecordType::kThread, 3u) |
+                     trace::ThreadRecordFields::ThreadIndex::Make(1u));
+    words->push_back(1234u);
+    words->push_back(5678u);
+    for (size_t i = 0; i < kNumEvents; i++) {
+        words->push_back(
+            MakeHeader(trace::RecordType::kEvent, 2u) |
+            trace::EventRecordFields::EventType::Make(
+                trace::ToUnderlyingType(trace::EventType::kDurationBegin)) |
+            trace::EventRecordFields::ThreadRef::Make(1u) |
+            trace::EventRecordFields::CategoryStringRef::Make(1u) |
+            trace::EventRecordFields::NameStringRef::Make(2u));
+        words->push_back(i);
+    }
+}
+
+// The string and thread records come back too; only events are checked.
+bool IsEvent(const trace::Record& record) {
+    return record.type() == trace::RecordType::kEvent;
+}
+
+bool IsExpectedEvent(const trace::Record& record) {
+    const auto& event = record.GetEvent();
+    return event.category == "cat" && event.name == "name" &&
+           event.process_thread.process_koid() == 1234u &&
+           event.process_thread.thread_koid() == 5678u;
+}
+
+bool segments_test() {
+    BEGIN_TEST;
+
+    fbl::Vector<uint64_t> words;
+    BuildTrace(&words);
+
+    fbl::String error;
+    fbl::unique_ptr<trace::IndexedTraceReader> reader;
+    ASSERT_TRUE(trace::IndexedTraceReader::Create(
+        words.get(), words.size() * sizeof(uint64_t),
+        [&error](fbl::String e) { error = fbl::move(e); }, &reader, 1024u));
+    EXPECT_TRUE(error.empty());
+    ASSERT_GT(reader->segment_count(), 10u);
+
+    // Every segment resolves the strings and thread defined at the start.
+    size_t count = 0u;
+    for (size_t i = 0; i < reader->segment_count(); i++) {
+        const auto& segment = reader->segment(i);
+        EXPECT_LE(segment.min_timestamp, segment.max_timestamp);
+
+        fbl::Vector<trace::Record> records;
+        EXPECT_TRUE(reader->ReadSegment(
+            i,
+            [&records](trace::Record record) {
+                if (IsEvent(record))
+                    records.push_back(fbl::move(record));
+            },
+            [&error](fbl::String e) { error = fbl::move(e); }));
+        for (const auto& record : records) {
+            ASSERT_TRUE(IsExpectedEvent(record));
+            EXPECT_GE(record.GetEvent().timestamp, segment.min_timestamp);
+            EXPECT_LE(record.GetEvent().timestamp, segment.max_timestamp);
+        }
+        count += records.size();
+    }
+    EXPECT_EQ(kNumEvents, count);
+    EXPECT_TRUE(error.empty());
+
+    END_TEST;
+}
+
+bool parallel_test() {
+    BEGIN_TEST;
+
+    fbl::Vector<uint64_t> words;
+    BuildTrace(&words);
+
+    fbl::unique_ptr<trace::IndexedTraceReader> reader;
+    ASSERT_TRUE(trace::IndexedTraceReader::Create(
+        words.get(), words.size() * sizeof(uint64_t),
+        [](fbl::String e) {}, &reader, 512u));
+
+    fbl::atomic<uint64_t> count{0u};
+    fbl::atomic<uint64_t> timestamp_sum{0u};
+    fbl::atomic<uint64_t> unexpected{0u};
+    fbl::atomic<uint64_t> errors{0u};
+    EXPECT_TRUE(reader->ReadAllParallel(
+        4u,
+        [&](size_t segment_index, trace::Record record) {
+            if (!IsEvent(record))
+                return;
+            if (!IsExpectedEvent(record)) {
+                unexpected.fetch_add(1u);
+                return;
+            }
+            count.fetch_add(1u);
+            timestamp_sum.fetch_add(record.GetEvent().timestamp);
+        },
+        [&errors](fbl::String e) { errors.fetch_add(1u); }));
+
+    EXPECT_EQ(kNumEvents, count.load());
+    EXPECT_EQ(kNumEvents * (kNumEvents - 1u) / 2u, timestamp_sum.load());
+    EXPECT_EQ(0u, unexpected.load());
+    EXPECT_EQ(0u, errors.load());
+
+    END_TEST;
+}
+
+bool time_range_test() {
+    BEGIN_TEST;
+
+    fbl::Vector<uint64_t> words;
+    BuildTrace(&words);
+
+    fbl::unique_ptr<trace::IndexedTraceReader> reader;
+    ASSERT_TRUE(trace::IndexedTraceReader::Create(
+        words.get(), words.size() * sizeof(uint64_t),
+        [](fbl::String e) {}, &reader, 1024u));
+
+    fbl::Vector<trace_ticks_t> timestamps;
+    EXPECT_TRUE(reader->ReadTimeRange(
+        300u, 399u,
+        [&timestamps](trace::Record record) {
+            if (IsEvent(record))
+                timestamps.push_back(record.GetEvent().timestamp);
+        },
+        [](fbl::String e) {}));
+    ASSERT_EQ(100u, timestamps.size());
+    for (size_t i = 0; i < timestamps.size(); i++)
+        EXPECT_EQ(300u + i, timestamps[i]);
+
+    END_TEST;
+}
+
+bool truncated_trace_test() {
+    BEGIN_TEST;
+
+    fbl::Vector<uint64_t> words;
+    BuildTrace(&words);
+    // A record which claims to run past the end of the trace.
+    words.push_back(MakeHeader(trace::RecordType::kEvent, 10u));
+
+    fbl::String error;
+    fbl::unique_ptr<trace::IndexedTraceReader> reader;
+    ASSERT_TRUE(trace::IndexedTraceReader::Create(
+        words.get(), words.size() * sizeof(uint64_t),
+        [&error](fbl::String e) { error = fbl::move(e); }, &reader, 1024u));
+    EXPECT_FALSE(error.empty());
+
+    size_t count = 0u;
+    for (size_t i = 0; i < reader->segment_count(); i++) {
+        EXPECT_TRUE(reader->ReadSegment(
+            i, [&count](trace::Record record) { count += IsEvent(record); },
+            [](fbl::String e) {}));
+    }
+    EXPECT_EQ(kNumEvents, count);
+
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(indexed_reader_tests)
+RUN_TEST(segments_test)
+RUN_TEST(parallel_test)
+RUN_TEST(time_range_test)
+RUN_TEST(truncated_trace_test)
+END_TEST_CASE(indexed_reader_tests)
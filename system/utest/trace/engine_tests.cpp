@@ -6,12 +6,15 @@
 
 #include <threads.h>
 
+#include <async/loop.h>
 #include <fbl/function.h>
 #include <fbl/string.h>
 #include <fbl/string_printf.h>
 #include <fbl/vector.h>
 #include <zx/event.h>
+#include <trace-engine/handler.h>
 #include <trace-engine/instrumentation.h>
+#include <trace/handler.h>
 
 namespace {
 int RunClosure(void* arg) {
@@ -387,6 +390,112 @@ bool test_event_with_inline_everything() {
     END_TRACE_TEST;
 }
 
+// Writes |count| instant events numbered by their "n" argument.
+void WriteNumberedEvents(uint64_t count) {
+    trace_string_ref_t cat = trace_make_inline_c_string_ref("cat");
+    trace_string_ref_t name = trace_make_inline_c_string_ref("name");
+    trace_thread_ref_t thread = trace_make_inline_thread_ref(123, 456);
+
+    auto context = trace::TraceContext::Acquire();
+    for (uint64_t i = 0; i < count; i++) {
+        trace_arg_t args[] = {
+            trace_make_arg(trace_make_inline_c_string_ref("n"),
+                           trace_make_uint64_arg_value(i))};
+        trace_context_write_instant_event_record(context.get(), zx_ticks_get(),
+                                                 &thread, &cat, &name,
+                                                 TRACE_SCOPE_GLOBAL,
+                                                 args, fbl::count_of(args));
+    }
+}
+
+// Checks that |records| starts with the initialization record and ends with
+// an unbroken run of numbered events up to |count - 1|.
+bool CheckNumberedEvents(const fbl::Vector<trace::Record>& records, uint64_t count) {
+    BEGIN_HELPER;
+
+    ASSERT_GE(records.size(), 2u);
+    EXPECT_EQ(trace::RecordType::kInitialization, records[0].type());
+    uint64_t expected = count;
+    for (size_t i = records.size(); i-- > 1u;) {
+        if (records[i].type() != trace::RecordType::kEvent)
+            break;
+        const auto& event = records[i].GetEvent();
+        ASSERT_EQ(1u, event.arguments.size());
+        EXPECT_EQ(--expected, event.arguments[0].value().GetUint64());
+    }
+    EXPECT_LT(expected, count);
+
+    END_HELPER;
+}
+
+bool test_circular_mode() {
+    BEGIN_TRACE_TEST_ETC(TRACE_BUFFERING_MODE_CIRCULAR, 64u * 1024u);
+
+    fixture_start_tracing();
+
+    // Enough to wrap around the small buffer several times.
+    const uint64_t kNumEvents = 5000u;
+    WriteNumberedEvents(kNumEvents);
+
+    fbl::Vector<trace::Record> records;
+    ASSERT_TRUE(fixture_read_records(&records));
+    EXPECT_EQ(ZX_OK, fixture_get_disposition());
+
+    trace_buffer_header_t header;
+    ASSERT_TRUE(fixture_get_buffer_header(&header));
+    EXPECT_EQ(TRACE_BUFFERING_MODE_CIRCULAR, header.buffering_mode);
+    EXPECT_GT(header.wrapped_count, 1u);
+    EXPECT_EQ(0u, header.num_records_dropped);
+    EXPECT_LT(records.size(), kNumEvents);
+    EXPECT_TRUE(CheckNumberedEvents(records, kNumEvents));
+
+    END_TRACE_TEST;
+}
+
+bool test_streaming_mode() {
+    BEGIN_TRACE_TEST_ETC(TRACE_BUFFERING_MODE_STREAMING, 64u * 1024u);
+
+    fixture_start_tracing();
+
+    // The fixture marks each full buffer saved as soon as it hears about it
+    // so nothing should be dropped.
+    const uint64_t kNumEvents = 5000u;
+    WriteNumberedEvents(kNumEvents);
+
+    fbl::Vector<trace::Record> records;
+    ASSERT_TRUE(fixture_read_records(&records));
+    EXPECT_EQ(ZX_OK, fixture_get_disposition());
+
+    trace_buffer_header_t header;
+    ASSERT_TRUE(fixture_get_buffer_header(&header));
+    EXPECT_EQ(TRACE_BUFFERING_MODE_STREAMING, header.buffering_mode);
+    EXPECT_GT(header.wrapped_count, 1u);
+    EXPECT_EQ(header.wrapped_count, fixture_get_buffer_full_notification_count());
+    EXPECT_EQ(0u, header.num_records_dropped);
+    EXPECT_TRUE(CheckNumberedEvents(records, kNumEvents));
+
+    END_TRACE_TEST;
+}
+
+bool test_buffering_mode_errors() {
+    BEGIN_TEST;
+
+    async::Loop loop;
+    trace::TraceHandler handler;
+    uint8_t buffer[256];
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS,
+              trace_start_engine_with_mode(loop.async(), &handler,
+                                           TRACE_BUFFERING_MODE_CIRCULAR,
+                                           buffer, sizeof(buffer)));
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS,
+              trace_start_engine_with_mode(loop.async(), &handler,
+                                           static_cast<trace_buffering_mode_t>(42),
+                                           buffer, sizeof(buffer)));
+    EXPECT_EQ(ZX_ERR_BAD_STATE, trace_engine_mark_buffer_saved(0u));
+
+    END_TEST;
+}
+
 // NOTE: The functions for writing trace records are exercised by other trace tests.
 
 } // namespace
@@ -406,4 +515,7 @@ RUN_TEST(test_register_string_literal_multiple_threads)
 RUN_TEST(test_register_string_literal_table_overflow)
 RUN_TEST(test_maximum_record_length)
 RUN_TEST(test_event_with_inline_everything)
+RUN_TEST(test_circular_mode)
+RUN_TEST(test_streaming_mode)
+RUN_TEST(test_buffering_mode_errors)
 END_TEST_CASE(engine_tests)
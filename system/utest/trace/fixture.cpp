@@ -15,6 +15,7 @@
 #include <zx/event.h>
 #include <fbl/algorithm.h>
 #include <fbl/array.h>
+#include <fbl/atomic.h>
 #include <fbl/string.h>
 #include <fbl/string_buffer.h>
 #include <fbl/vector.h>
@@ -28,8 +29,9 @@ static constexpr size_t kBufferSizeBytes = 1024 * 1024;
 
 class Fixture : private trace::TraceHandler {
 public:
-    Fixture()
-        : buffer_(new uint8_t[kBufferSizeBytes], kBufferSizeBytes) {
+    Fixture(trace_buffering_mode_t buffering_mode, size_t buffer_size_bytes)
+        : buffering_mode_(buffering_mode),
+          buffer_(new uint8_t[buffer_size_bytes], buffer_size_bytes) {
         zx_status_t status = zx::event::create(0u, &trace_stopped_);
         ZX_DEBUG_ASSERT(status == ZX_OK);
     }
@@ -46,8 +48,9 @@ public:
         loop_.StartThread("trace test");
 
         // Asynchronously start the engine.
-        zx_status_t status = trace_start_engine(loop_.async(), this,
-                                                buffer_.get(), buffer_.size());
+        zx_status_t status = trace_start_engine_with_mode(loop_.async(), this,
+                                                          buffering_mode_,
+                                                          buffer_.get(), buffer_.size());
         ZX_DEBUG_ASSERT(status == ZX_OK);
     }
 
@@ -80,19 +83,51 @@ public:
         return disposition_;
     }
 
+    uint32_t buffer_full_notification_count() const {
+        return buffer_full_notification_count_.load(fbl::memory_order_relaxed);
+    }
+
+    bool GetBufferHeader(trace_buffer_header_t* out_header) const {
+        if (buffering_mode_ == TRACE_BUFFERING_MODE_ONESHOT ||
+            buffer_bytes_written_ < sizeof(trace_buffer_header_t))
+            return false;
+        memcpy(out_header, buffer_.get(), sizeof(*out_header));
+        return out_header->magic == TRACE_BUFFER_HEADER_MAGIC;
+    }
+
     bool ReadRecords(fbl::Vector<trace::Record>* out_records,
                      fbl::Vector<fbl::String>* out_errors) {
         trace::TraceReader reader(
             [out_records](trace::Record record) { out_records->push_back(fbl::move(record)); },
             [out_errors](fbl::String error) { out_errors->push_back(fbl::move(error)); });
-        trace::Chunk chunk(reinterpret_cast<uint64_t*>(buffer_.get()),
-                           buffer_bytes_written_ / 8u);
         if (buffer_bytes_written_ & 7u) {
             out_errors->push_back(fbl::String("Buffer contains extraneous bytes"));
         }
-        if (!reader.ReadRecords(chunk)) {
-            out_errors->push_back(fbl::String("Trace data is corrupted"));
+
+        if (buffering_mode_ == TRACE_BUFFERING_MODE_ONESHOT) {
+            ReadChunk(&reader, 0u, buffer_bytes_written_, out_errors);
+            return out_errors->is_empty();
+        }
+
+        trace_buffer_header_t header;
+        if (!GetBufferHeader(&header)) {
+            out_errors->push_back(fbl::String("Buffer header is missing"));
+            return false;
+        }
+
+        // The durable records come first since the others refer to them,
+        // followed by the rolling buffers from oldest to newest.  Rolling
+        // buffers handed to |NotifyBufferFull()| are gone.
+        size_t offset = sizeof(trace_buffer_header_t);
+        ReadChunk(&reader, offset, header.durable_data_end, out_errors);
+        offset += header.durable_buffer_size;
+        uint32_t current = header.wrapped_count & 1u;
+        if (buffering_mode_ == TRACE_BUFFERING_MODE_CIRCULAR && header.wrapped_count) {
+            ReadChunk(&reader, offset + (current ^ 1u) * header.rolling_buffer_size,
+                      header.rolling_data_end[current ^ 1u], out_errors);
         }
+        ReadChunk(&reader, offset + current * header.rolling_buffer_size,
+                  header.rolling_data_end[current], out_errors);
         return out_errors->is_empty();
     }
 
@@ -114,13 +149,31 @@ private:
         trace_stopped_.signal(0u, ZX_EVENT_SIGNALED);
     }
 
+    void NotifyBufferFull(uint32_t wrapped_count, uint64_t durable_data_end) override {
+        // Pretend the buffer was saved straight away.
+        buffer_full_notification_count_.fetch_add(1u, fbl::memory_order_relaxed);
+        zx_status_t status = trace_engine_mark_buffer_saved(wrapped_count);
+        ZX_DEBUG_ASSERT(status == ZX_OK);
+    }
+
+    void ReadChunk(trace::TraceReader* reader, size_t offset, size_t num_bytes,
+                   fbl::Vector<fbl::String>* out_errors) {
+        trace::Chunk chunk(reinterpret_cast<uint64_t*>(buffer_.get() + offset),
+                           num_bytes / 8u);
+        if (!reader->ReadRecords(chunk)) {
+            out_errors->push_back(fbl::String("Trace data is corrupted"));
+        }
+    }
+
     async::Loop loop_;
+    trace_buffering_mode_t const buffering_mode_;
     fbl::Array<uint8_t> buffer_;
     bool trace_running_ = false;
     zx_status_t disposition_ = ZX_ERR_INTERNAL;
     size_t buffer_bytes_written_ = 0u;
     zx::event trace_stopped_;
     bool observed_stopped_callback_ = false;
+    fbl::atomic<uint32_t> buffer_full_notification_count_{0u};
 };
 
 Fixture* g_fixture{nullptr};
@@ -128,8 +181,13 @@ Fixture* g_fixture{nullptr};
 } // namespace
 
 void fixture_set_up(void) {
+    fixture_set_up_with_buffering_mode(TRACE_BUFFERING_MODE_ONESHOT, kBufferSizeBytes);
+}
+
+void fixture_set_up_with_buffering_mode(trace_buffering_mode_t mode,
+                                        size_t buffer_size_bytes) {
     ZX_DEBUG_ASSERT(!g_fixture);
-    g_fixture = new Fixture();
+    g_fixture = new Fixture(mode, buffer_size_bytes);
 }
 
 void fixture_tear_down(void) {
@@ -158,6 +216,30 @@ zx_status_t fixture_get_disposition(void) {
     return g_fixture->disposition();
 }
 
+bool fixture_get_buffer_header(trace_buffer_header_t* out_header) {
+    ZX_DEBUG_ASSERT(g_fixture);
+    return g_fixture->GetBufferHeader(out_header);
+}
+
+uint32_t fixture_get_buffer_full_notification_count(void) {
+    ZX_DEBUG_ASSERT(g_fixture);
+    return g_fixture->buffer_full_notification_count();
+}
+
+bool fixture_read_records(fbl::Vector<trace::Record>* out_records) {
+    ZX_DEBUG_ASSERT(g_fixture);
+    BEGIN_HELPER;
+
+    g_fixture->StopTracing(false);
+
+    fbl::Vector<fbl::String> errors;
+    EXPECT_TRUE(g_fixture->ReadRecords(out_records, &errors), "read error");
+    for (const auto& error : errors)
+        printf("error: %s\n", error.c_str());
+
+    END_HELPER;
+}
+
 bool fixture_compare_records(const char* expected) {
     ZX_DEBUG_ASSERT(g_fixture);
     BEGIN_HELPER;
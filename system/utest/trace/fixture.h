@@ -10,17 +10,22 @@
 #pragma once
 
 #include <zircon/compiler.h>
+#include <trace-engine/handler.h>
 #include <unittest/unittest.h>
 
 __BEGIN_CDECLS
 
 void fixture_set_up(void);
+void fixture_set_up_with_buffering_mode(trace_buffering_mode_t mode,
+                                        size_t buffer_size_bytes);
 void fixture_tear_down(void);
 void fixture_start_tracing(void);
 void fixture_stop_tracing(void);
 void fixture_stop_tracing_hard(void);
 zx_status_t fixture_get_disposition(void);
 bool fixture_compare_records(const char* expected);
+bool fixture_get_buffer_header(trace_buffer_header_t* out_header);
+uint32_t fixture_get_buffer_full_notification_count(void);
 
 inline void fixture_scope_cleanup(bool* scope) {
     fixture_tear_down();
@@ -32,6 +37,12 @@ inline void fixture_scope_cleanup(bool* scope) {
     (void)__scope;                                                \
     fixture_set_up();
 
+#define BEGIN_TRACE_TEST_ETC(mode, buffer_size)                   \
+    BEGIN_TEST;                                                   \
+    __attribute__((cleanup(fixture_scope_cleanup))) bool __scope; \
+    (void)__scope;                                                \
+    fixture_set_up_with_buffering_mode((mode), (buffer_size));
+
 #define END_TRACE_TEST \
     END_TEST;
 
@@ -49,3 +60,14 @@ inline void fixture_scope_cleanup(bool* scope) {
 #endif // NTRACE
 
 __END_CDECLS
+
+#ifdef __cplusplus
+
+#include <fbl/vector.h>
+#include <trace-reader/records.h>
+
+// Stops tracing and reads back whatever the buffer holds, in the order the
+// records were written.
+bool fixture_read_records(fbl::Vector<trace::Record>* out_records);
+
+#endif // __cplusplus
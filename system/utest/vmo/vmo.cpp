@@ -95,6 +95,67 @@ bool vmo_read_write_test() {
     END_TEST;
 }
 
+bool vmo_read_write_vector_test() {
+    BEGIN_TEST;
+
+    zx_status_t status;
+    size_t size;
+    zx_handle_t vmo;
+
+    const size_t len = PAGE_SIZE * 4;
+    status = zx_vmo_create(len, 0, &vmo);
+    EXPECT_EQ(status, ZX_OK, "vm_object_create");
+
+    // scatter a write from three buffers, the middle one straddling a page
+    static char a[100], b[PAGE_SIZE + 1], c[PAGE_SIZE * 2];
+    memset(a, 'a', sizeof(a));
+    memset(b, 'b', sizeof(b));
+    memset(c, 'c', sizeof(c));
+    zx_iovec_t in[] = { {a, sizeof(a)}, {b, sizeof(b)}, {nullptr, 0}, {c, sizeof(c)} };
+    status = zx_vmo_write_vector(vmo, in, fbl::count_of(in), 10, &size);
+    EXPECT_EQ(status, ZX_OK, "vm_object_write_vector");
+    EXPECT_EQ(sizeof(a) + sizeof(b) + sizeof(c), size, "vm_object_write_vector");
+
+    char buf[len];
+    status = zx_vmo_read(vmo, buf, 0, sizeof(buf), &size);
+    EXPECT_EQ(status, ZX_OK, "vm_object_read");
+    for (size_t i = 0; i < sizeof(buf); i++) {
+        char expected = i < 10 ? 0 :
+                        i < 10 + sizeof(a) ? 'a' :
+                        i < 10 + sizeof(a) + sizeof(b) ? 'b' :
+                        i < 10 + sizeof(a) + sizeof(b) + sizeof(c) ? 'c' : 0;
+        if (buf[i] != expected) {
+            EXPECT_EQ(expected, buf[i], "vector write contents");
+            break;
+        }
+    }
+
+    // gather it back out in different pieces, trimmed at the end of the vmo
+    static char d[PAGE_SIZE * 3], e[PAGE_SIZE * 2];
+    zx_iovec_t out[] = { {d, sizeof(d)}, {e, sizeof(e)} };
+    status = zx_vmo_read_vector(vmo, out, fbl::count_of(out), 0, &size);
+    EXPECT_EQ(status, ZX_OK, "vm_object_read_vector");
+    EXPECT_EQ(len, size, "vm_object_read_vector");
+    EXPECT_BYTES_EQ((uint8_t*)buf, (uint8_t*)d, sizeof(d), "vector read contents");
+    EXPECT_BYTES_EQ((uint8_t*)buf + sizeof(d), (uint8_t*)e, len - sizeof(d),
+                    "vector read contents");
+
+    // too many vectors, or lengths that overflow
+    zx_iovec_t many[ZX_VMO_VECTOR_MAX_ITEMS + 1] = {};
+    status = zx_vmo_read_vector(vmo, many, fbl::count_of(many), 0, &size);
+    EXPECT_EQ(status, ZX_ERR_OUT_OF_RANGE, "too many vectors");
+    zx_iovec_t huge[] = { {d, SIZE_MAX / 2 + 1}, {e, SIZE_MAX / 2 + 1} };
+    status = zx_vmo_read_vector(vmo, huge, fbl::count_of(huge), 0, &size);
+    EXPECT_NE(status, ZX_OK, "overflowing vectors");
+    status = zx_vmo_read_vector(vmo, out, fbl::count_of(out), len, &size);
+    EXPECT_EQ(status, ZX_ERR_OUT_OF_RANGE, "read past the end");
+
+    status = zx_handle_close(vmo);
+    EXPECT_EQ(ZX_OK, status, "handle_close");
+
+    END_TEST;
+}
+
 bool vmo_map_test() {
     BEGIN_TEST;
 
@@ -142,6 +203,57 @@ bool vmo_map_test() {
     END_TEST;
 }
 
+bool vmo_large_pages_test() {
+    BEGIN_TEST;
+
+    const size_t large_page = 2 * 1024 * 1024;
+    const size_t len = 2 * large_page;
+    zx_handle_t vmo;
+
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, zx_vmo_create(len, ~ZX_VMO_LARGE_PAGES, &vmo),
+              "unknown options");
+    ASSERT_EQ(ZX_OK, zx_vmo_create(len, ZX_VMO_LARGE_PAGES, &vmo), "vm_object_create");
+
+    uintptr_t ptr;
+    ASSERT_EQ(ZX_OK, zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, len,
+                                 ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE, &ptr), "map");
+    EXPECT_EQ(0u, ptr % large_page, "mapping is large page aligned");
+
+    // fault everything in, starting in the middle of the first large page
+    auto words = reinterpret_cast<volatile uint32_t*>(ptr);
+    const size_t page_words = PAGE_SIZE / sizeof(uint32_t);
+    for (size_t i = 0; i < len / PAGE_SIZE; i++) {
+        size_t page = (i + 3) % (len / PAGE_SIZE);
+        EXPECT_EQ(0u, words[page * page_words], "fresh page is zero");
+        words[page * page_words] = static_cast<uint32_t>(page);
+    }
+
+    // the vmo sees the same data
+    uint32_t val;
+    size_t actual;
+    EXPECT_EQ(ZX_OK, zx_vmo_read(vmo, &val, 5 * PAGE_SIZE, sizeof(val), &actual), "vmo_read");
+    EXPECT_EQ(5u, val, "vmo contents");
+
+    // protecting and unmapping pages split the large pages up without losing the rest
+    EXPECT_EQ(ZX_OK, zx_vmar_protect(zx_vmar_root_self(), ptr + PAGE_SIZE, PAGE_SIZE,
+                                     ZX_VM_FLAG_PERM_READ), "protect");
+    EXPECT_EQ(ZX_OK, zx_vmar_unmap(zx_vmar_root_self(), ptr + large_page + PAGE_SIZE, PAGE_SIZE),
+              "unmap");
+    for (size_t page = 0; page < len / PAGE_SIZE; page++) {
+        if (page == large_page / PAGE_SIZE + 1)
+            continue;
+        EXPECT_EQ(static_cast<uint32_t>(page), words[page * page_words], "contents kept");
+    }
+    words[2 * page_words] = 0;
+    EXPECT_EQ(ZX_OK, zx_vmo_read(vmo, &val, 2 * PAGE_SIZE, sizeof(val), &actual), "vmo_read");
+    EXPECT_EQ(0u, val, "write after split");
+
+    EXPECT_EQ(ZX_OK, zx_vmar_unmap(zx_vmar_root_self(), ptr, len), "unmap");
+    EXPECT_EQ(ZX_OK, zx_handle_close(vmo), "handle_close");
+
+    END_TEST;
+}
+
 bool vmo_read_only_map_test() {
     BEGIN_TEST;
 
@@ -549,6 +661,12 @@ bool vmo_lookup_test() {
     status = zx_vmo_op_range(vmo, ZX_VMO_OP_LOOKUP, 0, size + 1, buf, sizeof(buf));
     EXPECT_EQ(ZX_ERR_BUFFER_TOO_SMALL, status, "buffer too small");
 
+    // the pages stay where the lookup found them
+    status = zx_vmo_op_range(vmo, ZX_VMO_OP_DECOMMIT, 0, size, nullptr, 0);
+    EXPECT_EQ(ZX_ERR_BAD_STATE, status, "decommit looked up pages");
+    status = zx_vmo_set_size(vmo, 0);
+    EXPECT_EQ(ZX_ERR_BAD_STATE, status, "shrink over looked up pages");
+
     // close the handle
     status = zx_handle_close(vmo);
     EXPECT_EQ(ZX_OK, status, "handle_close");
@@ -1410,7 +1528,9 @@ bool vmo_unmap_coherency() {
 BEGIN_TEST_CASE(vmo_tests)
 RUN_TEST(vmo_create_test);
 RUN_TEST(vmo_read_write_test);
+RUN_TEST(vmo_read_write_vector_test);
 RUN_TEST(vmo_map_test);
+RUN_TEST(vmo_large_pages_test);
 RUN_TEST(vmo_read_only_map_test);
 RUN_TEST(vmo_no_perm_map_test);
 RUN_TEST(vmo_no_perm_protect_test);
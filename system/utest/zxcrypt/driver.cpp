@@ -0,0 +1,50 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <fbl/algorithm.h>
+#include <unittest/unittest.h>
+#include <zircon/types.h>
+#include <zxcrypt/superblock.h>
+
+#include "test-device.h"
+
+namespace zxcrypt {
+namespace testing {
+namespace {
+
+// See test-device.h; the following macros allow reusing tests for each of the supported versions.
+#define EACH_PARAM(OP, Test) OP(Test, Superblock, AES256_XTS_SHA256)
+
+bool TestReadWrite(Superblock::Version version, bool fvm) {
+    BEGIN_TEST;
+
+    TestDevice device;
+    ASSERT_OK(device.DefaultInit(version, fvm));
+    ASSERT_OK(device.Bind());
+    size_t size = fbl::min(device.zxcrypt_size(), kDeviceSize);
+    ASSERT_GT(size, 0u);
+
+    // Data round-trips through the device...
+    ASSERT_OK(device.WriteAndRead(0, size));
+    EXPECT_TRUE(device.Matches(0, size));
+
+    // ...but never reaches the disk in the clear.
+    bool found;
+    ASSERT_OK(device.FindPlaintext(0, size, &found));
+    EXPECT_FALSE(found);
+
+    END_TEST;
+}
+DEFINE_EACH_DEVICE(TestReadWrite);
+
+BEGIN_TEST_CASE(DriverTest)
+RUN_EACH_DEVICE(TestReadWrite)
+END_TEST_CASE(DriverTest)
+
+} // namespace
+} // namespace testing
+} // namespace zxcrypt
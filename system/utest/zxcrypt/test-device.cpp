@@ -17,6 +17,7 @@
 #include <fdio/watcher.h>
 #include <fs-management/ramdisk.h>
 #include <fvm/fvm.h>
+#include <zircon/device/block.h>
 #include <zircon/types.h>
 #include <zx/time.h>
 #include <zxcrypt/superblock.h>
@@ -122,7 +123,7 @@ zx_status_t WaitForBlockDevice(char* driver, fbl::unique_fd* out_fd) {
 
 } // namespace
 
-TestDevice::TestDevice() : block_size_(0) {
+TestDevice::TestDevice() : zxcrypt_size_(0), block_size_(0) {
     Reset();
 }
 
@@ -181,6 +182,69 @@ zx_status_t TestDevice::DefaultInit(Superblock::Version version, bool fvm) {
     return ZX_OK;
 }
 
+zx_status_t TestDevice::Bind() {
+    zx_status_t rc;
+
+    fbl::unique_fd fd = parent();
+    ssize_t res;
+    if ((res = ioctl_device_bind(fd.get(), kZxcryptLib, kZxcryptLibLen)) < 0) {
+        rc = static_cast<zx_status_t>(res);
+        xprintf("%s: ioctl_device_bind(%d, %s, %zu) failed: %s\n", __PRETTY_FUNCTION__, fd.get(),
+                kZxcryptLib, kZxcryptLibLen, zx_status_get_string(rc));
+        return rc;
+    }
+    char driver[] = "zxcrypt";
+    if ((rc = WaitForBlockDevice(driver, &zxcrypt_)) != ZX_OK) {
+        return rc;
+    }
+
+    block_info_t info;
+    if ((res = ioctl_block_get_info(zxcrypt_.get(), &info)) < 0) {
+        rc = static_cast<zx_status_t>(res);
+        xprintf("%s: ioctl_block_get_info(%d, %p) failed: %s\n", __PRETTY_FUNCTION__,
+                zxcrypt_.get(), &info, zx_status_get_string(rc));
+        return rc;
+    }
+    zxcrypt_size_ = info.block_count * info.block_size;
+
+    return ZX_OK;
+}
+
+zx_status_t TestDevice::WriteAndRead(zx_off_t offset, size_t length) {
+    zx_status_t rc;
+
+    if ((rc = Write(zxcrypt_, to_write_.get(), offset, length)) != ZX_OK ||
+        (rc = Read(zxcrypt_, as_read_.get(), offset, length)) != ZX_OK) {
+        return rc;
+    }
+
+    return ZX_OK;
+}
+
+zx_status_t TestDevice::FindPlaintext(zx_off_t offset, size_t length, bool* out) {
+    size_t size = block_count_ * block_size_;
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> raw(new (&ac) uint8_t[size]);
+    if (!ac.check()) {
+        xprintf("%s: allocation failed: %zu bytes\n", __PRETTY_FUNCTION__, size);
+        return ZX_ERR_NO_MEMORY;
+    }
+    if (lseek(ramdisk_.get(), 0, SEEK_SET) < 0) {
+        xprintf("%s: lseek(%d, 0, SEEK_SET) failed: %s\n", __PRETTY_FUNCTION__, ramdisk_.get(),
+                strerror(errno));
+        return ZX_ERR_IO;
+    }
+    ssize_t actual;
+    if ((actual = read(ramdisk_.get(), raw.get(), size)) < 0 ||
+        static_cast<size_t>(actual) != size) {
+        xprintf("%s: read(%d, %p, %zu) failed: %s\n", __PRETTY_FUNCTION__, ramdisk_.get(),
+                raw.get(), size, strerror(errno));
+        return ZX_ERR_IO;
+    }
+    *out = memmem(raw.get(), size, to_write_.get() + offset, length) != nullptr;
+    return ZX_OK;
+}
+
 zx_status_t TestDevice::Corrupt(zx_off_t offset) {
     zx_status_t rc;
 
@@ -365,6 +429,8 @@ zx_status_t TestDevice::Read(const fbl::unique_fd& fd, uint8_t* buf, zx_off_t of
 }
 
 void TestDevice::Reset() {
+    zxcrypt_.reset();
+    zxcrypt_size_ = 0;
     fvm_part_.reset();
     ramdisk_.reset();
     if (strnlen(ramdisk_path_, PATH_MAX) != 0) {
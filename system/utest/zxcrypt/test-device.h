@@ -6,6 +6,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <fbl/macros.h>
@@ -66,6 +67,26 @@ public:
     // |fvm|.
     zx_status_t DefaultInit(Superblock::Version version, bool fvm);
 
+    // Binds the zxcrypt driver to the underlying device and opens the zxcrypt device it adds.  The
+    // device must already have been formatted with the ZX-1130 null key.
+    zx_status_t Bind();
+
+    // Returns the size in bytes of the zxcrypt device.  Only valid after |Bind|.
+    size_t zxcrypt_size() const { return zxcrypt_size_; }
+
+    // Writes |length| bytes of the pseudo-random test data to the zxcrypt device at |offset|, then
+    // reads the same range back.
+    zx_status_t WriteAndRead(zx_off_t offset, size_t length);
+
+    // Returns true if the data read back from |offset| matches what was written.
+    bool Matches(zx_off_t offset, size_t length) const {
+        return memcmp(to_write_.get() + offset, as_read_.get() + offset, length) == 0;
+    }
+
+    // Sets |out| to true if the |length| bytes of test data at |offset| appear in the clear anywhere
+    // on the underlying ramdisk.
+    zx_status_t FindPlaintext(zx_off_t offset, size_t length, bool* out);
+
     // Flips a (pseudo)random bit in the byte at the given |offset| on the block device.  The call
     // to |srand| in main.c guarantees the same bit will be chosen for a given test iteration.
     zx_status_t Corrupt(zx_off_t offset);
@@ -99,6 +120,9 @@ private:
     fbl::unique_fd ramdisk_;
     // File descriptor for the (optional) underlying FVM partition.
     fbl::unique_fd fvm_part_;
+    // File descriptor for the zxcrypt device, and its size in bytes.
+    fbl::unique_fd zxcrypt_;
+    size_t zxcrypt_size_;
     // The cached block count.
     size_t block_count_;
     // The cached block size.
@@ -16,6 +16,7 @@
 #include <unistd.h>
 
 #include <zircon/syscalls.h>
+#include <fdio/io.h>
 #include <pretty/hexdump.h>
 
 #include <zircon/device/dmctl.h>
@@ -76,8 +77,6 @@ static const char* modestr(uint32_t mode) {
 int zxc_ls(int argc, char** argv) {
     const char* dirn;
     struct stat s;
-    char tmp[2048];
-    size_t dirln;
     struct dirent* de;
     DIR* dir;
 
@@ -90,7 +89,6 @@ int zxc_ls(int argc, char** argv) {
     } else {
         dirn = argv[1];
     }
-    dirln = strlen(dirn);
 
     if (argc > 2) {
         fprintf(stderr, "usage: ls [ <file_or_directory> ]\n");
@@ -104,12 +102,9 @@ int zxc_ls(int argc, char** argv) {
         printf("%s %8jd %s\n", modestr(s.st_mode), (intmax_t)s.st_size, dirn);
         return 0;
     }
-    while((de = readdir(dir)) != NULL) {
-        memset(&s, 0, sizeof(struct stat));
-        if ((strlen(de->d_name) + dirln + 2) <= sizeof(tmp)) {
-            snprintf(tmp, sizeof(tmp), "%s/%s", dirn, de->d_name);
-            stat(tmp, &s);
-        }
+    // Read the attributes along with the entries, rather than with a
+    // stat() of each entry.
+    while((de = fdio_readdir_stat(dir, &s)) != NULL) {
         printf("%s %2ju %8jd %s\n", modestr(s.st_mode), s.st_nlink,
                (intmax_t)s.st_size, de->d_name);
     }
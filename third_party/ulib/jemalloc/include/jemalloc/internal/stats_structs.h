@@ -91,6 +91,15 @@ struct arena_stats_s {
 	uint64_t	nmadvise;
 	uint64_t	purged;
 
+	/*
+	 * Total number of successful commit and decommit operations, and total
+	 * pages they covered.  Protected via atomic_*_u64().
+	 */
+	uint64_t	ncommit;
+	uint64_t	committed;
+	uint64_t	ndecommit;
+	uint64_t	decommitted;
+
 	size_t		base;
 	size_t		internal; /* Protected via atomic_*_zu(). */
 	size_t		resident;
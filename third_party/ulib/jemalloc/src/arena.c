@@ -1610,6 +1610,10 @@ arena_stats_merge(tsdn_t *tsdn, arena_t *arena, unsigned *nthreads,
 	astats->npurge += arena->stats.npurge;
 	astats->nmadvise += arena->stats.nmadvise;
 	astats->purged += arena->stats.purged;
+	astats->ncommit += atomic_read_u64(&arena->stats.ncommit);
+	astats->committed += atomic_read_u64(&arena->stats.committed);
+	astats->ndecommit += atomic_read_u64(&arena->stats.ndecommit);
+	astats->decommitted += atomic_read_u64(&arena->stats.decommitted);
 	astats->base += base_allocated;
 	astats->internal += arena_internal_get(arena);
 	astats->resident += base_resident + (((arena->nactive + arena->ndirty)
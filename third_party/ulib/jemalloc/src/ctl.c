@@ -160,6 +160,10 @@ CTL_PROTO(stats_arenas_i_retained)
 CTL_PROTO(stats_arenas_i_npurge)
 CTL_PROTO(stats_arenas_i_nmadvise)
 CTL_PROTO(stats_arenas_i_purged)
+CTL_PROTO(stats_arenas_i_ncommit)
+CTL_PROTO(stats_arenas_i_committed)
+CTL_PROTO(stats_arenas_i_ndecommit)
+CTL_PROTO(stats_arenas_i_decommitted)
 CTL_PROTO(stats_arenas_i_base)
 CTL_PROTO(stats_arenas_i_internal)
 CTL_PROTO(stats_arenas_i_tcache_bytes)
@@ -382,6 +386,10 @@ static const ctl_named_node_t stats_arenas_i_node[] = {
 	{NAME("npurge"),	CTL(stats_arenas_i_npurge)},
 	{NAME("nmadvise"),	CTL(stats_arenas_i_nmadvise)},
 	{NAME("purged"),	CTL(stats_arenas_i_purged)},
+	{NAME("ncommit"),	CTL(stats_arenas_i_ncommit)},
+	{NAME("committed"),	CTL(stats_arenas_i_committed)},
+	{NAME("ndecommit"),	CTL(stats_arenas_i_ndecommit)},
+	{NAME("decommitted"),	CTL(stats_arenas_i_decommitted)},
 	{NAME("base"),		CTL(stats_arenas_i_base)},
 	{NAME("internal"),	CTL(stats_arenas_i_internal)},
 	{NAME("tcache_bytes"),	CTL(stats_arenas_i_tcache_bytes)},
@@ -600,6 +608,10 @@ ctl_arena_stats_sdmerge(ctl_arena_t *ctl_sdarena, ctl_arena_t *ctl_arena,
 		sdstats->astats.npurge += astats->astats.npurge;
 		sdstats->astats.nmadvise += astats->astats.nmadvise;
 		sdstats->astats.purged += astats->astats.purged;
+		sdstats->astats.ncommit += astats->astats.ncommit;
+		sdstats->astats.committed += astats->astats.committed;
+		sdstats->astats.ndecommit += astats->astats.ndecommit;
+		sdstats->astats.decommitted += astats->astats.decommitted;
 
 		if (!destroyed) {
 			sdstats->astats.base += astats->astats.base;
@@ -2142,6 +2154,14 @@ CTL_RO_CGEN(config_stats, stats_arenas_i_nmadvise,
     arenas_i(mib[2])->astats->astats.nmadvise, uint64_t)
 CTL_RO_CGEN(config_stats, stats_arenas_i_purged,
     arenas_i(mib[2])->astats->astats.purged, uint64_t)
+CTL_RO_CGEN(config_stats, stats_arenas_i_ncommit,
+    arenas_i(mib[2])->astats->astats.ncommit, uint64_t)
+CTL_RO_CGEN(config_stats, stats_arenas_i_committed,
+    arenas_i(mib[2])->astats->astats.committed, uint64_t)
+CTL_RO_CGEN(config_stats, stats_arenas_i_ndecommit,
+    arenas_i(mib[2])->astats->astats.ndecommit, uint64_t)
+CTL_RO_CGEN(config_stats, stats_arenas_i_decommitted,
+    arenas_i(mib[2])->astats->astats.decommitted, uint64_t)
 CTL_RO_CGEN(config_stats, stats_arenas_i_base,
     arenas_i(mib[2])->astats->astats.base, size_t)
 CTL_RO_CGEN(config_stats, stats_arenas_i_internal,
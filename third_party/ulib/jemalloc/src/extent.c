@@ -1117,6 +1117,10 @@ extent_commit_wrapper(tsdn_t *tsdn, arena_t *arena,
 	    (*r_extent_hooks)->commit(*r_extent_hooks, extent_base_get(extent),
 	    extent_size_get(extent), offset, length, arena_ind_get(arena)));
 	extent_committed_set(extent, extent_committed_get(extent) || !err);
+	if (config_stats && !err) {
+		atomic_add_u64(&arena->stats.ncommit, 1);
+		atomic_add_u64(&arena->stats.committed, length >> LG_PAGE);
+	}
 	return (err);
 }
 
@@ -1144,6 +1148,10 @@ extent_decommit_wrapper(tsdn_t *tsdn, arena_t *arena,
 	    extent_base_get(extent), extent_size_get(extent), offset, length,
 	    arena_ind_get(arena)));
 	extent_committed_set(extent, extent_committed_get(extent) && err);
+	if (config_stats && !err) {
+		atomic_add_u64(&arena->stats.ndecommit, 1);
+		atomic_add_u64(&arena->stats.decommitted, length >> LG_PAGE);
+	}
 	return (err);
 }
 
@@ -93,9 +93,26 @@ static void* fuchsia_pages_map(void* start, size_t len) {
 	return (void*)ptr;
 }
 
+// Every mapping places pages_vmo at the same offset it occupies in
+// pages_vmar, so an address identifies its backing pages directly.
+// Decommitting returns them to the system but leaves the mapping (and
+// jemalloc's claim to the address space) in place; the next touch
+// faults in zero pages.
+static zx_status_t fuchsia_pages_decommit(void* addr, size_t size) {
+	uintptr_t ptr = (uintptr_t)addr;
+	if (ptr < pages_base)
+		abort();
+	return _zx_vmo_op_range(pages_vmo, ZX_VMO_OP_DECOMMIT,
+	    ptr - pages_base, size, NULL, 0);
+}
+
 static zx_status_t fuchsia_pages_free(void* addr, size_t size) {
 	uintptr_t ptr = (uintptr_t)addr;
-	return _zx_vmar_unmap(pages_vmar, ptr, size);
+	zx_status_t status = _zx_vmar_unmap(pages_vmar, ptr, size);
+	if (status != ZX_OK)
+		return status;
+	// Unmapping alone would leave the pages committed in pages_vmo.
+	return fuchsia_pages_decommit(addr, size);
 }
 
 static void* fuchsia_pages_trim(void* ret, void* addr, size_t size,
@@ -234,7 +251,9 @@ pages_commit_impl(void *addr, size_t size, bool commit)
 	return (commit ? (addr != VirtualAlloc(addr, size, MEM_COMMIT,
 	    PAGE_READWRITE)) : (!VirtualFree(addr, size, MEM_DECOMMIT)));
 #elif __Fuchsia__
-	not_reached();
+	// The heap stays mapped read-write and pages are committed on first
+	// touch, so committing has nothing to do.
+	return (commit ? false : fuchsia_pages_decommit(addr, size) != ZX_OK);
 #else
 	{
 		int prot = commit ? PAGES_PROT_COMMIT : PAGES_PROT_DECOMMIT;
@@ -291,6 +310,8 @@ pages_purge_forced(void *addr, size_t size)
 
 #if defined(JEMALLOC_PURGE_MADVISE_DONTNEED)
 	return (madvise(addr, size, MADV_DONTNEED) != 0);
+#elif defined(__Fuchsia__)
+	return (fuchsia_pages_decommit(addr, size) != ZX_OK);
 #else
 	not_reached();
 #endif
@@ -406,7 +427,9 @@ pages_boot(void)
 #endif
 
 #if defined(__Fuchsia__)
-	os_overcommits = true;
+	// Decommit is cheap and keeps the mapping, so let jemalloc track
+	// committed extents and hand memory back through pages_decommit().
+	os_overcommits = false;
 #elif defined(JEMALLOC_SYSCTL_VM_OVERCOMMIT)
 	os_overcommits = os_overcommits_sysctl();
 #elif defined(JEMALLOC_PROC_SYS_VM_OVERCOMMIT_MEMORY)
@@ -256,6 +256,7 @@ stats_arena_print(void (*write_cb)(void *, const char *), void *cbopaque,
 	size_t page, pactive, pdirty, mapped, retained;
 	size_t base, internal, resident;
 	uint64_t npurge, nmadvise, purged;
+	uint64_t ncommit, committed, ndecommit, decommitted;
 	size_t small_allocated;
 	uint64_t small_nmalloc, small_ndalloc, small_nrequests;
 	size_t large_allocated;
@@ -316,6 +317,26 @@ stats_arena_print(void (*write_cb)(void *, const char *), void *cbopaque,
 		    ", purged: %"FMTu64"\n", pdirty, npurge, nmadvise, purged);
 	}
 
+	CTL_M2_GET("stats.arenas.0.ncommit", i, &ncommit, uint64_t);
+	CTL_M2_GET("stats.arenas.0.committed", i, &committed, uint64_t);
+	CTL_M2_GET("stats.arenas.0.ndecommit", i, &ndecommit, uint64_t);
+	CTL_M2_GET("stats.arenas.0.decommitted", i, &decommitted, uint64_t);
+	if (json) {
+		malloc_cprintf(write_cb, cbopaque,
+		    "\t\t\t\t\"ncommit\": %"FMTu64",\n", ncommit);
+		malloc_cprintf(write_cb, cbopaque,
+		    "\t\t\t\t\"committed\": %"FMTu64",\n", committed);
+		malloc_cprintf(write_cb, cbopaque,
+		    "\t\t\t\t\"ndecommit\": %"FMTu64",\n", ndecommit);
+		malloc_cprintf(write_cb, cbopaque,
+		    "\t\t\t\t\"decommitted\": %"FMTu64",\n", decommitted);
+	} else {
+		malloc_cprintf(write_cb, cbopaque,
+		    "commits: %"FMTu64", committed: %"FMTu64", decommits: %"FMTu64
+		    ", decommitted: %"FMTu64"\n", ncommit, committed, ndecommit,
+		    decommitted);
+	}
+
 	CTL_M2_GET("stats.arenas.0.small.allocated", i, &small_allocated,
 	    size_t);
 	CTL_M2_GET("stats.arenas.0.small.nmalloc", i, &small_nmalloc, uint64_t);
@@ -1083,7 +1083,7 @@ MODULE_CFLAGS := $(LOCAL_CFLAGS)
 MODULE_SRCS := $(LOCAL_SRCS)
 
 MODULE_LIBS := system/ulib/zircon
-MODULE_STATIC_LIBS := system/ulib/runtime
+MODULE_STATIC_LIBS := system/ulib/runtime system/ulib/sync
 
 # At link time and in DT_SONAME, musl is known as libc.so.  But the
 # (only) place it needs to be installed at runtime is where the
@@ -1,4 +1,8 @@
 #include "pthread_impl.h"
+#include <sync/rwlock.h>
+
+static_assert(sizeof(pthread_rwlock_t) == sizeof(sync_rwlock_t),
+              "pthread_rwlock_t must have room for a sync_rwlock_t");
 
 int pthread_rwlock_init(pthread_rwlock_t* restrict rw, const pthread_rwlockattr_t* restrict a) {
     *rw = (pthread_rwlock_t){};
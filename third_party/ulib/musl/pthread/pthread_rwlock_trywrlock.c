@@ -1,7 +1,8 @@
 #include "pthread_impl.h"
+#include <sync/rwlock.h>
 
 int pthread_rwlock_trywrlock(pthread_rwlock_t* rw) {
-    if (a_cas_shim(&rw->_rw_lock, 0, 0x7fffffff))
+    if (sync_rwlock_trywrlock((sync_rwlock_t*)rw) != ZX_OK)
         return EBUSY;
     return 0;
 }
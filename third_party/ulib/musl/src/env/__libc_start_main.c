@@ -22,6 +22,30 @@ struct start_params {
     pthread_t td;
 };
 
+#if defined(__x86_64__)
+#include <cpuid.h>
+
+// Lets the string routines pick their AVX2 variants.
+static __NO_SAFESTACK void init_hwcap(void) {
+    uint32_t eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0, NULL) < 7)
+        return;
+    __cpuid(1, eax, ebx, ecx, edx);
+    if (!(ecx & bit_AVX) || !(ecx & bit_OSXSAVE))
+        return;
+    // The kernel must be saving the YMM registers too.
+    uint32_t xcr0_lo, xcr0_hi;
+    __asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    if ((xcr0_lo & 0x6) != 0x6)
+        return;
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    if (ebx & bit_AVX2)
+        __hwcap |= HWCAP_X86_AVX2;
+}
+#else
+static __NO_SAFESTACK void init_hwcap(void) {}
+#endif
+
 // This gets called via inline assembly below, after switching onto
 // the newly-allocated (safe) stack.
 static _Noreturn void start_main(const struct start_params*)
@@ -73,6 +97,8 @@ __NO_SAFESTACK _Noreturn void __libc_start_main(
     // out the zeroing as dead stores.
     __asm__("# keepalive %0" :: "m"(randoms));
 
+    init_hwcap();
+
     // extract process startup information from channel in arg
     zx_handle_t bootstrap = (uintptr_t)arg;
 
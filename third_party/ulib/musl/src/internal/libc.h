@@ -44,6 +44,10 @@ extern struct __libc __libc ATTR_LIBC_VISIBILITY;
 #define libc __libc
 
 extern size_t __hwcap ATTR_LIBC_VISIBILITY;
+
+// Optional instruction set extensions in __hwcap, which __libc_start_main
+// fills in.  Anything that runs before then sees none of them.
+#define HWCAP_X86_AVX2 (1u << 0)
 extern char *__progname, *__progname_full;
 
 void __libc_start_init(void) ATTR_LIBC_VISIBILITY;
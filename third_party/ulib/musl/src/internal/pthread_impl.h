@@ -166,6 +166,11 @@ int __pthread_key_delete(tss_t k) ATTR_LIBC_VISIBILITY;
 int __timedwait(atomic_int*, int, clockid_t, const struct timespec*)
     ATTR_LIBC_VISIBILITY;
 
+// Converts an absolute time on |clk| into a deadline.  A null |at| means
+// no deadline.  Returns 0, EINVAL, or ETIMEDOUT if |at| has passed.
+int __timespec_to_deadline(clockid_t clk, const struct timespec* at, zx_time_t* deadline)
+    ATTR_LIBC_VISIBILITY;
+
 // Loading a library can introduce more thread_local variables. Thread
 // allocation bases bookkeeping decisions based on the current state
 // of thread_locals in the program, so thread creation needs to be
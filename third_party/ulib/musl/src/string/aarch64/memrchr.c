@@ -0,0 +1,39 @@
+#include "libc.h"
+#include <arm_neon.h>
+#include <stdint.h>
+#include <string.h>
+
+// Scans backwards a whole aligned vector at a time, so it may read bytes
+// just outside the buffer, but never from a page which holds none of it.
+// Not built for ASan, which would diagnose those reads.
+
+// Narrows a byte comparison result to four bits per byte.
+static inline uint64_t match_mask(uint8x16_t eq) {
+    uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+}
+
+void* __memrchr(const void* m, int c, size_t n) {
+    if (!n)
+        return 0;
+    const uint8x16_t k = vdupq_n_u8((uint8_t)c);
+    uintptr_t s = (uintptr_t)m;
+    uintptr_t last = s + n - 1;
+    uintptr_t p = last & ~(uintptr_t)15;
+    uint64_t mask = match_mask(vceqq_u8(vld1q_u8((const uint8_t*)p), k));
+    if (last - p < 15)
+        mask &= (1ull << ((last - p + 1) * 4)) - 1;
+    for (;;) {
+        if (p <= s) {
+            // The first block; ignore anything before the buffer.
+            mask &= ~0ull << ((s - p) * 4);
+            return mask ? (void*)(p + (63 - __builtin_clzll(mask)) / 4) : 0;
+        }
+        if (mask)
+            return (void*)(p + (63 - __builtin_clzll(mask)) / 4);
+        p -= 16;
+        mask = match_mask(vceqq_u8(vld1q_u8((const uint8_t*)p), k));
+    }
+}
+
+weak_alias(__memrchr, memrchr);
@@ -5,7 +5,6 @@ LOCAL_SRCS += \
     $(GET_LOCAL_DIR)/index.c \
     $(GET_LOCAL_DIR)/memccpy.c \
     $(GET_LOCAL_DIR)/memmem.c \
-    $(GET_LOCAL_DIR)/memrchr.c \
     $(GET_LOCAL_DIR)/rindex.c \
     $(GET_LOCAL_DIR)/stpcpy.c \
     $(GET_LOCAL_DIR)/stpncpy.c \
@@ -104,6 +103,21 @@ LOCAL_SRCS += \
     third_party/lib/cortex-strings/src/aarch64/strncmp.S \
     third_party/lib/cortex-strings/src/aarch64/strnlen.S \
 
+else ifeq ($(SUBARCH):$(call TOBOOL,$(USE_ASAN)),x86-64:false)
+
+# SSE2 is always available; strlen and memchr also have AVX2 variants which
+# are picked at runtime (see __libc_start_main).
+LOCAL_SRCS += \
+    $(GET_LOCAL_DIR)/x86_64/memchr.c \
+    $(GET_LOCAL_DIR)/x86_64/memcmp.c \
+    $(GET_LOCAL_DIR)/strchr.c \
+    $(GET_LOCAL_DIR)/x86_64/strchrnul.c \
+    $(GET_LOCAL_DIR)/x86_64/strcmp.c \
+    $(GET_LOCAL_DIR)/strcpy.c \
+    $(GET_LOCAL_DIR)/x86_64/strlen.c \
+    $(GET_LOCAL_DIR)/strncmp.c \
+    $(GET_LOCAL_DIR)/strnlen.c \
+
 else
 
 LOCAL_SRCS += \
@@ -118,3 +132,12 @@ LOCAL_SRCS += \
     $(GET_LOCAL_DIR)/strnlen.c \
 
 endif
+
+# memrchr scans aligned vectors, which ASan would diagnose.
+ifeq ($(ARCH):$(call TOBOOL,$(USE_ASAN)),arm64:false)
+LOCAL_SRCS += $(GET_LOCAL_DIR)/aarch64/memrchr.c
+else ifeq ($(SUBARCH):$(call TOBOOL,$(USE_ASAN)),x86-64:false)
+LOCAL_SRCS += $(GET_LOCAL_DIR)/x86_64/memrchr.c
+else
+LOCAL_SRCS += $(GET_LOCAL_DIR)/memrchr.c
+endif
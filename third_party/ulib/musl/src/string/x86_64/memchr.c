@@ -0,0 +1,62 @@
+#include "libc.h"
+#include <immintrin.h>
+#include <stdint.h>
+#include <string.h>
+
+// Whole aligned vectors are loaded, so up to a vector's worth of bytes on
+// either side of the buffer may be read, but never from a page which holds
+// none of it.  Not built for ASan.
+
+__attribute__((target("avx2"))) static void* memchr_avx2(const unsigned char* s, int c,
+                                                         size_t n) {
+    const __m256i k = _mm256_set1_epi8((char)c);
+    uintptr_t off = (uintptr_t)s & 31;
+    const unsigned char* p = s - off;
+    uint32_t mask = (uint32_t)_mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(_mm256_load_si256((const __m256i*)p), k)) >> off;
+    size_t done = 32 - off;
+    if (!mask) {
+        for (; done < n; done += 32) {
+            p += 32;
+            mask = _mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(_mm256_load_si256((const __m256i*)p), k));
+            if (mask) {
+                size_t i = done + __builtin_ctz(mask);
+                return i < n ? (void*)(s + i) : 0;
+            }
+        }
+        return 0;
+    }
+    size_t i = __builtin_ctz(mask);
+    return i < n ? (void*)(s + i) : 0;
+}
+
+static void* memchr_sse2(const unsigned char* s, int c, size_t n) {
+    const __m128i k = _mm_set1_epi8((char)c);
+    uintptr_t off = (uintptr_t)s & 15;
+    const unsigned char* p = s - off;
+    uint32_t mask = (uint32_t)_mm_movemask_epi8(
+        _mm_cmpeq_epi8(_mm_load_si128((const __m128i*)p), k)) >> off;
+    size_t done = 16 - off;
+    if (!mask) {
+        for (; done < n; done += 16) {
+            p += 16;
+            mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((const __m128i*)p), k));
+            if (mask) {
+                size_t i = done + __builtin_ctz(mask);
+                return i < n ? (void*)(s + i) : 0;
+            }
+        }
+        return 0;
+    }
+    size_t i = __builtin_ctz(mask);
+    return i < n ? (void*)(s + i) : 0;
+}
+
+void* memchr(const void* src, int c, size_t n) {
+    if (!n)
+        return 0;
+    if (__hwcap & HWCAP_X86_AVX2)
+        return memchr_avx2(src, c, n);
+    return memchr_sse2(src, c, n);
+}
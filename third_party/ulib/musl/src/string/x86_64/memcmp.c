@@ -0,0 +1,18 @@
+#include <immintrin.h>
+#include <stdint.h>
+#include <string.h>
+
+int memcmp(const void* vl, const void* vr, size_t n) {
+    const unsigned char *l = vl, *r = vr;
+    for (; n >= 16; n -= 16, l += 16, r += 16) {
+        uint32_t eq = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)l),
+                                                       _mm_loadu_si128((const __m128i*)r)));
+        if (eq != 0xffff) {
+            size_t i = __builtin_ctz(~eq);
+            return l[i] - r[i];
+        }
+    }
+    for (; n && *l == *r; n--, l++, r++)
+        ;
+    return n ? *l - *r : 0;
+}
@@ -0,0 +1,30 @@
+#include "libc.h"
+#include <immintrin.h>
+#include <stdint.h>
+#include <string.h>
+
+// Scans backwards a whole aligned vector at a time; see memchr.c.
+
+void* __memrchr(const void* m, int c, size_t n) {
+    if (!n)
+        return 0;
+    const __m128i k = _mm_set1_epi8((char)c);
+    uintptr_t s = (uintptr_t)m;
+    uintptr_t last = s + n - 1;
+    uintptr_t p = last & ~(uintptr_t)15;
+    uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((const __m128i*)p), k));
+    mask &= (2u << (last - p)) - 1;
+    for (;;) {
+        if (p <= s) {
+            // The first block; ignore anything before the buffer.
+            mask &= ~0u << (s - p);
+            return mask ? (void*)(p + 31 - __builtin_clz(mask)) : 0;
+        }
+        if (mask)
+            return (void*)(p + 31 - __builtin_clz(mask));
+        p -= 16;
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((const __m128i*)p), k));
+    }
+}
+
+weak_alias(__memrchr, memrchr);
@@ -0,0 +1,33 @@
+#include <immintrin.h>
+#include <stdint.h>
+#include <string.h>
+
+// The smallest page size we could be running with.  Neither string is read
+// past its terminator into a page it does not reach.
+#define PAGE 4096u
+
+int strcmp(const char* sl, const char* sr) {
+    const unsigned char* l = (const void*)sl;
+    const unsigned char* r = (const void*)sr;
+    const __m128i zero = _mm_setzero_si128();
+    for (;;) {
+        if (((uintptr_t)l % PAGE) <= PAGE - 16 && ((uintptr_t)r % PAGE) <= PAGE - 16) {
+            __m128i a = _mm_loadu_si128((const __m128i*)l);
+            __m128i b = _mm_loadu_si128((const __m128i*)r);
+            uint32_t stop = (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) ^ 0xffff) |
+                            _mm_movemask_epi8(_mm_cmpeq_epi8(a, zero));
+            if (stop) {
+                size_t i = __builtin_ctz(stop);
+                return l[i] - r[i];
+            }
+            l += 16;
+            r += 16;
+        } else {
+            // Step bytewise across the page boundary.
+            if (*l != *r || !*l)
+                return *l - *r;
+            l++;
+            r++;
+        }
+    }
+}
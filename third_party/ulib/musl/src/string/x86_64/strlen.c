@@ -0,0 +1,46 @@
+#include "libc.h"
+#include <immintrin.h>
+#include <stdint.h>
+#include <string.h>
+
+// These scan whole aligned vectors, which may read past the terminator but
+// never into the next page.  They are not built for ASan, which would
+// diagnose those reads.
+
+__attribute__((target("avx2"))) static size_t strlen_avx2(const char* s) {
+    const __m256i zero = _mm256_setzero_si256();
+    uintptr_t off = (uintptr_t)s & 31;
+    const __m256i* p = (const __m256i*)(s - off);
+    uint32_t mask = (uint32_t)_mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(_mm256_load_si256(p), zero)) >> off;
+    if (mask)
+        return __builtin_ctz(mask);
+    for (;;) {
+        ++p;
+        mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256(p), zero));
+        if (mask)
+            return (const char*)p - s + __builtin_ctz(mask);
+    }
+}
+
+static size_t strlen_sse2(const char* s) {
+    const __m128i zero = _mm_setzero_si128();
+    uintptr_t off = (uintptr_t)s & 15;
+    const __m128i* p = (const __m128i*)(s - off);
+    uint32_t mask = (uint32_t)_mm_movemask_epi8(
+        _mm_cmpeq_epi8(_mm_load_si128(p), zero)) >> off;
+    if (mask)
+        return __builtin_ctz(mask);
+    for (;;) {
+        ++p;
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(p), zero));
+        if (mask)
+            return (const char*)p - s + __builtin_ctz(mask);
+    }
+}
+
+size_t strlen(const char* s) {
+    if (__hwcap & HWCAP_X86_AVX2)
+        return strlen_avx2(s);
+    return strlen_sse2(s);
+}